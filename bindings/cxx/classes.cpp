@@ -28,6 +28,7 @@
 
 #include <sstream>
 #include <cmath>
+#include <thread>
 
 namespace sigrok
 {
@@ -329,7 +330,9 @@ shared_ptr<Packet> Context::create_logic_packet(
 	auto packet = g_new(struct sr_datafeed_packet, 1);
 	packet->type = SR_DF_LOGIC;
 	packet->payload = logic;
-	return shared_ptr<Packet>{new Packet{nullptr, packet}, default_delete<Packet>{}};
+	auto result = new Packet{nullptr, packet};
+	result->_created = true;
+	return shared_ptr<Packet>{result, default_delete<Packet>{}};
 }
 
 shared_ptr<Packet> Context::create_analog_packet(
@@ -376,7 +379,9 @@ shared_ptr<Packet> Context::create_analog_packet(
 	auto packet = g_new(struct sr_datafeed_packet, 1);
 	packet->type = SR_DF_ANALOG;
 	packet->payload = analog;
-	return shared_ptr<Packet>{new Packet{nullptr, packet}, default_delete<Packet>{}};
+	auto result = new Packet{nullptr, packet};
+	result->_created = true;
+	return shared_ptr<Packet>{result, default_delete<Packet>{}};
 }
 
 shared_ptr<Packet> Context::create_end_packet()
@@ -898,13 +903,32 @@ float TriggerMatch::value() const
 DatafeedCallbackData::DatafeedCallbackData(Session *session,
 		DatafeedCallbackFunction callback) :
 	_callback(move(callback)),
-	_session(session)
+	_session(session),
+	_last_sdi(nullptr),
+	_last_device(nullptr)
+{
+}
+
+DatafeedCallbackData::DatafeedCallbackData(Session *session,
+		DatafeedViewCallbackFunction callback) :
+	_view_callback(move(callback)),
+	_session(session),
+	_last_sdi(nullptr),
+	_last_device(nullptr)
 {
 }
 
 void DatafeedCallbackData::run(const struct sr_dev_inst *sdi,
 	const struct sr_datafeed_packet *pkt)
 {
+	if (_view_callback) {
+		if (sdi != _last_sdi) {
+			_last_device = &_session->get_device_ref(sdi);
+			_last_sdi = sdi;
+		}
+		_view_callback(*_last_device, PacketView{*_session, sdi, pkt});
+		return;
+	}
 	auto device = _session->get_device(sdi);
 	shared_ptr<Packet> packet {new Packet{device, pkt}, default_delete<Packet>{}};
 	_callback(move(device), move(packet));
@@ -965,11 +989,29 @@ shared_ptr<Device> Session::get_device(const struct sr_dev_inst *sdi)
 		throw Error(SR_ERR_BUG);
 }
 
+Device &Session::get_device_ref(const struct sr_dev_inst *sdi)
+{
+	const auto owned = _owned_devices.find(sdi);
+	if (owned != _owned_devices.end())
+		return *owned->second;
+	const auto other = _other_devices.find(sdi);
+	if (other != _other_devices.end())
+		return *other->second;
+	throw Error(SR_ERR_BUG);
+}
+
+void Session::forget_cached_devices()
+{
+	for (auto &cb_data : _datafeed_callbacks)
+		cb_data->_last_sdi = nullptr;
+}
+
 void Session::add_device(shared_ptr<Device> device)
 {
 	const auto dev_struct = device->_structure;
 	check(sr_session_dev_add(_structure, dev_struct));
 	_other_devices[dev_struct] = move(device);
+	forget_cached_devices();
 }
 
 vector<shared_ptr<Device>> Session::devices()
@@ -987,6 +1029,7 @@ vector<shared_ptr<Device>> Session::devices()
 
 void Session::remove_devices()
 {
+	forget_cached_devices();
 	_other_devices.clear();
 	check(sr_session_dev_remove_all(_structure));
 }
@@ -1001,6 +1044,25 @@ void Session::run()
 	check(sr_session_run(_structure));
 }
 
+future<void> Session::run_async()
+{
+	auto session = shared_from_this();
+	packaged_task<void()> task{[session] {
+		try {
+			session->run();
+		} catch (...) {
+			for (const auto &queue : session->_packet_queues)
+				queue->close();
+			throw;
+		}
+		for (const auto &queue : session->_packet_queues)
+			queue->close();
+	}};
+	auto result = task.get_future();
+	thread{move(task)}.detach();
+	return result;
+}
+
 void Session::stop()
 {
 	check(sr_session_stop(_structure));
@@ -1047,10 +1109,33 @@ void Session::add_datafeed_callback(DatafeedCallbackFunction callback)
 	_datafeed_callbacks.push_back(move(cb_data));
 }
 
+shared_ptr<PacketQueue> Session::add_datafeed_queue(size_t capacity)
+{
+	if (!capacity)
+		throw Error(SR_ERR_ARG);
+	shared_ptr<PacketQueue> queue{new PacketQueue{capacity}};
+	add_datafeed_callback([queue] (shared_ptr<Device> device,
+			shared_ptr<Packet> packet) {
+		queue->push(move(device), packet->copy());
+	});
+	_packet_queues.push_back(queue);
+	return queue;
+}
+
+void Session::add_datafeed_view_callback(DatafeedViewCallbackFunction callback)
+{
+	unique_ptr<DatafeedCallbackData> cb_data
+		{new DatafeedCallbackData{this, move(callback)}};
+	check(sr_session_datafeed_callback_add(_structure,
+			&datafeed_callback, cb_data.get()));
+	_datafeed_callbacks.push_back(move(cb_data));
+}
+
 void Session::remove_datafeed_callbacks()
 {
 	check(sr_session_datafeed_callback_remove_all(_structure));
 	_datafeed_callbacks.clear();
+	_packet_queues.clear();
 }
 
 shared_ptr<Trigger> Session::trigger()
@@ -1110,6 +1195,20 @@ Packet::Packet(shared_ptr<Device> device,
 
 Packet::~Packet()
 {
+	if (_owned)
+		sr_packet_free(const_cast<struct sr_datafeed_packet *>(_structure));
+	if (!_created)
+		return;
+	if (_structure->type == SR_DF_ANALOG) {
+		auto analog = static_cast<const struct sr_datafeed_analog *>(
+			_structure->payload);
+		g_slist_free(analog->meaning->channels);
+		g_free(analog->meaning);
+		g_free(analog->encoding);
+		g_free(analog->spec);
+	}
+	g_free(_structure->payload);
+	g_free(const_cast<struct sr_datafeed_packet *>(_structure));
 }
 
 const PacketType *Packet::type() const
@@ -1117,6 +1216,65 @@ const PacketType *Packet::type() const
 	return PacketType::get(_structure->type);
 }
 
+PacketQueue::PacketQueue(size_t capacity) :
+	_capacity(capacity)
+{
+}
+
+void PacketQueue::push(shared_ptr<Device> device, shared_ptr<Packet> packet)
+{
+	unique_lock<mutex> lock{_mutex};
+	const auto type = packet->type();
+
+	if (type == PacketType::HEADER)
+		_closed = false;
+	_not_full.wait(lock, [this] { return _packets.size() < _capacity; });
+	_packets.emplace_back(move(device), move(packet));
+	if (type == PacketType::END)
+		_closed = true;
+	_not_empty.notify_one();
+}
+
+void PacketQueue::close()
+{
+	lock_guard<mutex> lock{_mutex};
+	_closed = true;
+	_not_empty.notify_all();
+}
+
+bool PacketQueue::take(shared_ptr<Device> &device, shared_ptr<Packet> &packet)
+{
+	if (_packets.empty())
+		return false;
+	device = move(_packets.front().first);
+	packet = move(_packets.front().second);
+	_packets.pop_front();
+	_not_full.notify_one();
+	return true;
+}
+
+bool PacketQueue::pop(shared_ptr<Device> &device, shared_ptr<Packet> &packet)
+{
+	unique_lock<mutex> lock{_mutex};
+	_not_empty.wait(lock, [this] { return !_packets.empty() || _closed; });
+	return take(device, packet);
+}
+
+bool PacketQueue::try_pop(shared_ptr<Device> &device,
+	shared_ptr<Packet> &packet, chrono::milliseconds timeout)
+{
+	unique_lock<mutex> lock{_mutex};
+	_not_empty.wait_for(lock, timeout,
+		[this] { return !_packets.empty() || _closed; });
+	return take(device, packet);
+}
+
+bool PacketQueue::closed()
+{
+	lock_guard<mutex> lock{_mutex};
+	return _closed;
+}
+
 shared_ptr<PacketPayload> Packet::payload()
 {
 	if (_payload)
@@ -1125,6 +1283,15 @@ shared_ptr<PacketPayload> Packet::payload()
 		throw Error(SR_ERR_NA);
 }
 
+shared_ptr<Packet> Packet::copy()
+{
+	struct sr_datafeed_packet *copy;
+	check(sr_packet_copy(_structure, &copy));
+	auto packet = new Packet{_device, copy};
+	packet->_owned = true;
+	return shared_ptr<Packet>{packet, default_delete<Packet>{}};
+}
+
 PacketPayload::PacketPayload()
 {
 }
@@ -1218,6 +1385,15 @@ unsigned int Logic::unit_size() const
 	return _structure->unitsize;
 }
 
+void Logic::set_data(void *data_pointer, size_t data_length)
+{
+	if (!_parent->_created)
+		throw Error(SR_ERR_NA);
+	auto logic = const_cast<struct sr_datafeed_logic *>(_structure);
+	logic->data = data_pointer;
+	logic->length = data_length;
+}
+
 Analog::Analog(const struct sr_datafeed_analog *structure) :
 	PacketPayload(),
 	_structure(structure)
@@ -1239,16 +1415,97 @@ void *Analog::data_pointer()
 	return _structure->data;
 }
 
+/* Byte distances between samples and channels, as sr_analog_to_float() uses. */
+static void analog_strides(const struct sr_datafeed_analog *analog,
+	size_t *sample_stride, size_t *channel_stride)
+{
+	const auto encoding = analog->encoding;
+
+	if (encoding->is_planar) {
+		*sample_stride = encoding->unitsize;
+		*channel_stride = encoding->unitsize * analog->num_samples;
+	} else {
+		*sample_stride = encoding->unitsize *
+			g_slist_length(analog->meaning->channels);
+		*channel_stride = encoding->unitsize;
+	}
+	if (encoding->sample_stride)
+		*sample_stride = encoding->sample_stride;
+	if (encoding->channel_stride)
+		*channel_stride = encoding->channel_stride;
+}
+
+/* Bytes from the first to past the last sample, for any strides. */
+static size_t analog_raw_size(const struct sr_datafeed_analog *analog)
+{
+	const size_t num_channels = g_slist_length(analog->meaning->channels);
+	size_t sample_stride, channel_stride;
+
+	if (!analog->num_samples || !num_channels)
+		return 0;
+	analog_strides(analog, &sample_stride, &channel_stride);
+
+	return (analog->num_samples - 1) * sample_stride +
+		(num_channels - 1) * channel_stride + analog->encoding->unitsize;
+}
+
+static void analog_to_float(const struct sr_datafeed_analog *analog,
+	vector<float> &dest)
+{
+	dest.resize(analog->num_samples *
+		g_slist_length(analog->meaning->channels));
+	if (!dest.empty())
+		check(sr_analog_to_float(analog, dest.data()));
+}
+
+Span<const uint8_t> Analog::raw() const
+{
+	return Span<const uint8_t>(static_cast<const uint8_t *>(_structure->data),
+		analog_raw_size(_structure));
+}
+
 void Analog::get_data_as_float(float *dest)
 {
 	check(sr_analog_to_float(_structure, dest));
 }
 
+void Analog::to_float(vector<float> &dest) const
+{
+	analog_to_float(_structure, dest);
+}
+
+size_t Analog::sample_stride() const
+{
+	size_t sample_stride, channel_stride;
+
+	analog_strides(_structure, &sample_stride, &channel_stride);
+
+	return sample_stride;
+}
+
+size_t Analog::channel_stride() const
+{
+	size_t sample_stride, channel_stride;
+
+	analog_strides(_structure, &sample_stride, &channel_stride);
+
+	return channel_stride;
+}
+
 unsigned int Analog::num_samples() const
 {
 	return _structure->num_samples;
 }
 
+void Analog::set_data(const float *data_pointer, unsigned int num_samples)
+{
+	if (!_parent->_created)
+		throw Error(SR_ERR_NA);
+	auto analog = const_cast<struct sr_datafeed_analog *>(_structure);
+	analog->data = const_cast<float *>(data_pointer);
+	analog->num_samples = num_samples;
+}
+
 vector<shared_ptr<Channel>> Analog::channels()
 {
 	vector<shared_ptr<Channel>> result;
@@ -1347,6 +1604,30 @@ shared_ptr<Logic> Analog::get_logic_via_threshold(float threshold,
 	return logic;
 }
 
+shared_ptr<Logic> Analog::get_logic_via_thresholds(
+	const vector<float> &thresholds, uint8_t *data_ptr) const
+{
+	if (thresholds.size() != g_slist_length(_structure->meaning->channels))
+		throw Error(SR_ERR_ARG);
+
+	auto datafeed = g_new(struct sr_datafeed_logic, 1);
+	datafeed->unitsize = (thresholds.size() + 7) / 8;
+	datafeed->length = num_samples() * datafeed->unitsize;
+
+	if (data_ptr)
+		datafeed->data = data_ptr;
+	else
+		datafeed->data = g_malloc(datafeed->length);
+
+	shared_ptr<Logic> logic =
+		shared_ptr<Logic>{new Logic{datafeed}, default_delete<Logic>{}};
+
+	check(sr_a2l_threshold_multi(_structure, thresholds.data(),
+		(uint8_t*)datafeed->data, num_samples()));
+
+	return logic;
+}
+
 shared_ptr<Logic> Analog::get_logic_via_schmitt_trigger(float lo_thr,
 	float hi_thr, uint8_t *state, uint8_t *data_ptr) const
 {
@@ -1368,6 +1649,143 @@ shared_ptr<Logic> Analog::get_logic_via_schmitt_trigger(float lo_thr,
 	return logic;
 }
 
+PacketView::PacketView(Session &session, const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *structure) :
+	_session(session),
+	_sdi(sdi),
+	_structure(structure)
+{
+}
+
+const PacketType *PacketView::type() const
+{
+	return PacketType::get(_structure->type);
+}
+
+LogicView PacketView::logic() const
+{
+	if (_structure->type != SR_DF_LOGIC)
+		throw Error(SR_ERR_NA);
+	return LogicView{static_cast<const struct sr_datafeed_logic *>(
+		_structure->payload)};
+}
+
+AnalogView PacketView::analog() const
+{
+	if (_structure->type != SR_DF_ANALOG)
+		throw Error(SR_ERR_NA);
+	return AnalogView{_session, _sdi,
+		static_cast<const struct sr_datafeed_analog *>(_structure->payload)};
+}
+
+LogicView::LogicView(const struct sr_datafeed_logic *structure) :
+	_structure(structure)
+{
+}
+
+const void *LogicView::data_pointer() const
+{
+	return _structure->data;
+}
+
+size_t LogicView::data_length() const
+{
+	return _structure->length;
+}
+
+unsigned int LogicView::unit_size() const
+{
+	return _structure->unitsize;
+}
+
+AnalogView::AnalogView(Session &session, const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_analog *structure) :
+	_session(session),
+	_sdi(sdi),
+	_structure(structure)
+{
+}
+
+const void *AnalogView::data_pointer() const
+{
+	return _structure->data;
+}
+
+Span<const uint8_t> AnalogView::raw() const
+{
+	return Span<const uint8_t>(static_cast<const uint8_t *>(_structure->data),
+		analog_raw_size(_structure));
+}
+
+void AnalogView::get_data_as_float(float *dest) const
+{
+	check(sr_analog_to_float(_structure, dest));
+}
+
+void AnalogView::to_float(vector<float> &dest) const
+{
+	analog_to_float(_structure, dest);
+}
+
+unsigned int AnalogView::num_samples() const
+{
+	return _structure->num_samples;
+}
+
+unsigned int AnalogView::num_channels() const
+{
+	return g_slist_length(_structure->meaning->channels);
+}
+
+shared_ptr<Channel> AnalogView::channel(unsigned int index) const
+{
+	auto *const ch = static_cast<struct sr_channel *>(
+		g_slist_nth_data(_structure->meaning->channels, index));
+	if (!ch)
+		throw Error(SR_ERR_ARG);
+	return _session.get_device(_sdi)->get_channel(ch);
+}
+
+unsigned int AnalogView::unitsize() const
+{
+	return _structure->encoding->unitsize;
+}
+
+bool AnalogView::is_signed() const
+{
+	return _structure->encoding->is_signed;
+}
+
+bool AnalogView::is_float() const
+{
+	return _structure->encoding->is_float;
+}
+
+bool AnalogView::is_bigendian() const
+{
+	return _structure->encoding->is_bigendian;
+}
+
+int AnalogView::digits() const
+{
+	return _structure->encoding->digits;
+}
+
+const Quantity *AnalogView::mq() const
+{
+	return Quantity::get(_structure->meaning->mq);
+}
+
+const Unit *AnalogView::unit() const
+{
+	return Unit::get(_structure->meaning->unit);
+}
+
+vector<const QuantityFlag *> AnalogView::mq_flags() const
+{
+	return QuantityFlag::flags_from_mask(_structure->meaning->mqflags);
+}
+
 Rational::Rational(const struct sr_rational *structure) :
 	_structure(structure)
 {
@@ -1472,10 +1890,7 @@ shared_ptr<InputDevice> Input::device()
 
 void Input::send(void *data, size_t length)
 {
-	auto gstr = g_string_new_len(static_cast<char *>(data), length);
-	auto ret = sr_input_send(_structure, gstr);
-	g_string_free(gstr, true);
-	check(ret);
+	check(sr_input_send_data(_structure, data, length));
 }
 
 void Input::end()
@@ -1681,6 +2096,26 @@ string Output::receive(shared_ptr<Packet> packet)
 	}
 }
 
+void Output::receive(shared_ptr<Packet> packet, string &out)
+{
+	GString *gstr;
+	check(sr_output_send(_structure, packet->_structure, &gstr));
+	if (gstr) {
+		out.append(gstr->str, gstr->len);
+		g_string_free(gstr, true);
+	}
+}
+
+void Output::receive(shared_ptr<Packet> packet, std::ostream &out)
+{
+	GString *gstr;
+	check(sr_output_send(_structure, packet->_structure, &gstr));
+	if (gstr) {
+		out.write(gstr->str, gstr->len);
+		g_string_free(gstr, true);
+	}
+}
+
 #include <enums.cpp>
 
 }
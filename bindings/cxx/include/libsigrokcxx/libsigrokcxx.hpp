@@ -78,9 +78,15 @@ G_GNUC_BEGIN_IGNORE_DEPRECATIONS
 #include <glibmm.h>
 G_GNUC_END_IGNORE_DEPRECATIONS
 
+#include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <functional>
+#include <future>
+#include <ostream>
 #include <stdexcept>
 #include <memory>
+#include <mutex>
 #include <vector>
 #include <map>
 #include <set>
@@ -111,6 +117,10 @@ class SR_API ChannelType;
 class SR_API Packet;
 class SR_API PacketPayload;
 class SR_API PacketType;
+class SR_API PacketQueue;
+class SR_API PacketView;
+class SR_API LogicView;
+class SR_API AnalogView;
 class SR_API Quantity;
 class SR_API Unit;
 class SR_API QuantityFlag;
@@ -132,6 +142,30 @@ public:
 	const char *what() const noexcept;
 };
 
+/**
+ * Non-owning view of contiguous elements. Works like C++20 std::span,
+ * which can be constructed from data() and size().
+ */
+template <class T>
+class Span
+{
+public:
+	Span() : _data(nullptr), _size(0) {}
+	Span(T *data, size_t size) : _data(data), _size(size) {}
+	/** Pointer to the first element. */
+	T *data() const { return _data; }
+	/** Number of elements. */
+	size_t size() const { return _size; }
+	/** Whether there are no elements. */
+	bool empty() const { return _size == 0; }
+	T &operator[](size_t index) const { return _data[index]; }
+	T *begin() const { return _data; }
+	T *end() const { return _data + _size; }
+private:
+	T *_data;
+	size_t _size;
+};
+
 /* Base template for classes whose resources are owned by a parent object. */
 template <class Class, class Parent>
 class SR_API ParentOwned
@@ -413,6 +447,7 @@ private:
 	friend class ChannelGroup;
 	friend class Output;
 	friend class Analog;
+	friend class AnalogView;
 	friend struct std::default_delete<Device>;
 };
 
@@ -578,6 +613,10 @@ typedef std::function<void()> SessionStoppedCallback;
 typedef std::function<void(std::shared_ptr<Device>, std::shared_ptr<Packet>)>
 	DatafeedCallbackFunction;
 
+/** Type of datafeed callback which gets non-owning packet views */
+typedef std::function<void(Device &, const PacketView &)>
+	DatafeedViewCallbackFunction;
+
 /* Data required for C callback function to call a C++ datafeed callback */
 class SR_PRIV DatafeedCallbackData
 {
@@ -586,9 +625,15 @@ public:
 		const struct sr_datafeed_packet *pkt);
 private:
 	DatafeedCallbackFunction _callback;
+	DatafeedViewCallbackFunction _view_callback;
 	DatafeedCallbackData(Session *session,
 		DatafeedCallbackFunction callback);
+	DatafeedCallbackData(Session *session,
+		DatafeedViewCallbackFunction callback);
 	Session *_session;
+	/* Device of the last packet, most feeds come from one device. */
+	const struct sr_dev_inst *_last_sdi;
+	Device *_last_device;
 	friend class Session;
 };
 
@@ -620,12 +665,27 @@ public:
 	/** Add a datafeed callback to this session.
 	 * @param callback Callback of the form callback(Device, Packet). */
 	void add_datafeed_callback(DatafeedCallbackFunction callback);
+	/** Add a datafeed callback to this session, which gets packet views.
+	 * Views neither allocate nor count references, which suits
+	 * consumers of high packet rates. They are only valid during the
+	 * callback, consumers which keep packets use add_datafeed_callback().
+	 * @param callback Callback of the form callback(Device, PacketView). */
+	void add_datafeed_view_callback(DatafeedViewCallbackFunction callback);
+	/** Add a queue to this session which receives copies of the packets.
+	 * The session waits while the queue is full, so the consumer paces
+	 * the acquisition instead of losing packets.
+	 * @param capacity Number of packets the queue holds. */
+	std::shared_ptr<PacketQueue> add_datafeed_queue(size_t capacity = 64);
 	/** Remove all datafeed callbacks from this session. */
 	void remove_datafeed_callbacks();
 	/** Start the session. */
 	void start();
 	/** Run the session event loop. */
 	void run();
+	/** Run the session event loop on a thread of its own. The future
+	 * becomes ready when the session stops, and rethrows its errors.
+	 * Any queues of the session get closed then. */
+	std::future<void> run_async();
 	/** Stop the session. */
 	void stop();
 	/** Return whether the session is running. */
@@ -646,11 +706,14 @@ private:
 	Session(std::shared_ptr<Context> context, std::string filename);
 	~Session();
 	std::shared_ptr<Device> get_device(const struct sr_dev_inst *sdi);
+	Device &get_device_ref(const struct sr_dev_inst *sdi);
+	void forget_cached_devices();
 	struct sr_session *_structure;
 	const std::shared_ptr<Context> _context;
 	std::map<const struct sr_dev_inst *, std::unique_ptr<SessionDevice> > _owned_devices;
 	std::map<const struct sr_dev_inst *, std::shared_ptr<Device> > _other_devices;
 	std::vector<std::unique_ptr<DatafeedCallbackData> > _datafeed_callbacks;
+	std::vector<std::shared_ptr<PacketQueue> > _packet_queues;
 	SessionStoppedCallback _stopped_callback;
 	std::string _filename;
 	std::shared_ptr<Trigger> _trigger;
@@ -658,9 +721,41 @@ private:
 	friend class Context;
 	friend class DatafeedCallbackData;
 	friend class SessionDevice;
+	friend class AnalogView;
 	friend struct std::default_delete<Session>;
 };
 
+/** Bounded queue of packets from a session, see Session::add_datafeed_queue() */
+class SR_API PacketQueue
+{
+public:
+	/** Wait for the next packet.
+	 * @param device Set to the device which sent the packet.
+	 * @param packet Set to the packet.
+	 * @return False once the queue has been closed and drained. */
+	bool pop(std::shared_ptr<Device> &device, std::shared_ptr<Packet> &packet);
+	/** Wait for the next packet for at most timeout.
+	 * @return False if no packet arrived in time, or once the queue has
+	 *         been closed and drained, see closed(). */
+	bool try_pop(std::shared_ptr<Device> &device,
+		std::shared_ptr<Packet> &packet, std::chrono::milliseconds timeout);
+	/** Whether the acquisition ended, more packets may still be queued. */
+	bool closed();
+private:
+	explicit PacketQueue(size_t capacity);
+	void push(std::shared_ptr<Device> device, std::shared_ptr<Packet> packet);
+	void close();
+	bool take(std::shared_ptr<Device> &device, std::shared_ptr<Packet> &packet);
+	const size_t _capacity;
+	std::mutex _mutex;
+	std::condition_variable _not_empty;
+	std::condition_variable _not_full;
+	std::deque<std::pair<std::shared_ptr<Device>, std::shared_ptr<Packet> > > _packets;
+	bool _closed = false;
+
+	friend class Session;
+};
+
 /** A packet on the session datafeed */
 class SR_API Packet : public UserOwned<Packet>
 {
@@ -669,6 +764,9 @@ public:
 	const PacketType *type() const;
 	/** Payload of this packet. */
 	std::shared_ptr<PacketPayload> payload();
+	/** Copy of this packet which owns its data, and so stays valid
+	 * after the datafeed callback that received this packet returns. */
+	std::shared_ptr<Packet> copy();
 private:
 	Packet(std::shared_ptr<Device> device,
 		const struct sr_datafeed_packet *structure);
@@ -676,6 +774,9 @@ private:
 	const struct sr_datafeed_packet *_structure;
 	std::shared_ptr<Device> _device;
 	std::unique_ptr<PacketPayload> _payload;
+	bool _owned = false;
+	/* Allocated by Context::create_*_packet() on data of the caller. */
+	bool _created = false;
 
 	friend class Session;
 	friend class Output;
@@ -753,6 +854,24 @@ public:
 	size_t data_length() const;
 	/* Size of each sample in bytes. */
 	unsigned int unit_size() const;
+	/**
+	 * Point a packet from Context::create_logic_packet() at new data,
+	 * so producers can send one packet object over and over.
+	 * @param data_pointer Pointer to the new data.
+	 * @param data_length Length of the new data in bytes.
+	 */
+	void set_data(void *data_pointer, size_t data_length);
+	/**
+	 * Samples as words of unit_size() bytes, in host byte order.
+	 * T must be an integer type of unit_size() bytes, e.g. uint16_t.
+	 */
+	template <class T> Span<T> samples()
+	{
+		if (sizeof(T) != _structure->unitsize)
+			throw Error(SR_ERR_ARG);
+		return Span<T>(static_cast<T *>(_structure->data),
+			_structure->length / sizeof(T));
+	}
 private:
 	explicit Logic(const struct sr_datafeed_logic *structure);
 	~Logic();
@@ -773,11 +892,32 @@ class SR_API Analog :
 public:
 	/** Pointer to data. */
 	void *data_pointer();
+	/**
+	 * Data in the encoding of the packet, see unitsize(), is_signed(),
+	 * is_float(), is_bigendian(), scale() and offset().
+	 */
+	Span<const uint8_t> raw() const;
 	/**
 	 * Fills dest pointer with the analog data converted to float.
 	 * The pointer must have space for num_samples() floats.
 	 */
 	void get_data_as_float(float *dest);
+	/**
+	 * Converts the analog data to float, num_samples() per channel.
+	 * Resizes dest, and reuses its capacity across packets.
+	 */
+	void to_float(std::vector<float> &dest) const;
+	/**
+	 * Point a packet from Context::create_analog_packet() at new data,
+	 * so producers can send one packet object over and over.
+	 * @param data_pointer Pointer to num_samples floats per channel.
+	 * @param num_samples Number of samples per channel.
+	 */
+	void set_data(const float *data_pointer, unsigned int num_samples);
+	/** Bytes between consecutive samples of a channel in raw(). */
+	size_t sample_stride() const;
+	/** Bytes between the first samples of consecutive channels in raw(). */
+	size_t channel_stride() const;
 	/** Number of samples in this packet. */
 	unsigned int num_samples() const;
 	/** Channels for which this packet contains data. */
@@ -820,6 +960,22 @@ public:
 	 */
 	std::shared_ptr<Logic> get_logic_via_threshold(float threshold,
 		uint8_t *data_ptr=nullptr) const;
+	/**
+	 * Provides a Logic packet that contains a conversion of the analog
+	 * data of all channels of this packet, using a threshold per channel.
+	 * Bit n of each logic sample is the level of the nth channel.
+	 *
+	 * @param thresholds Threshold of each channel, in the order of
+	 *                   channels().
+	 * @param data_ptr Pointer to num_samples() samples of
+	 *                 (thresholds.size() + 7) / 8 bytes where the logic
+	 *                 samples are stored. When nullptr, memory for
+	 *                 logic->data_pointer() will be allocated and must
+	 *                 be freed by the caller.
+	 */
+	std::shared_ptr<Logic> get_logic_via_thresholds(
+		const std::vector<float> &thresholds,
+		uint8_t *data_ptr=nullptr) const;
 	/**
 	 * Provides a Logic packet that contains a conversion of the analog
 	 * data using a Schmitt-Trigger.
@@ -846,6 +1002,101 @@ private:
 	friend class Packet;
 };
 
+/**
+ * Non-owning view of a packet on the session datafeed. Views get passed
+ * to datafeed view callbacks, and are only valid during the callback.
+ */
+class SR_API PacketView
+{
+public:
+	/** Type of this packet. */
+	const PacketType *type() const;
+	/** Logic payload of this packet, which must be of the LOGIC type. */
+	LogicView logic() const;
+	/** Analog payload of this packet, which must be of the ANALOG type. */
+	AnalogView analog() const;
+private:
+	PacketView(Session &session, const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *structure);
+	Session &_session;
+	const struct sr_dev_inst *_sdi;
+	const struct sr_datafeed_packet *_structure;
+
+	friend class DatafeedCallbackData;
+};
+
+/** Non-owning view of a logic payload, see PacketView. */
+class SR_API LogicView
+{
+public:
+	/** Pointer to data. */
+	const void *data_pointer() const;
+	/** Data length in bytes. */
+	size_t data_length() const;
+	/** Size of each sample in bytes. */
+	unsigned int unit_size() const;
+	/** Samples as words of unit_size() bytes, see Logic::samples(). */
+	template <class T> Span<const T> samples() const
+	{
+		if (sizeof(T) != _structure->unitsize)
+			throw Error(SR_ERR_ARG);
+		return Span<const T>(static_cast<const T *>(_structure->data),
+			_structure->length / sizeof(T));
+	}
+private:
+	explicit LogicView(const struct sr_datafeed_logic *structure);
+	const struct sr_datafeed_logic *_structure;
+
+	friend class PacketView;
+};
+
+/** Non-owning view of an analog payload, see PacketView. */
+class SR_API AnalogView
+{
+public:
+	/** Pointer to data. */
+	const void *data_pointer() const;
+	/** Data in the encoding of the packet, see Analog::raw(). */
+	Span<const uint8_t> raw() const;
+	/**
+	 * Fills dest pointer with the analog data converted to float.
+	 * The pointer must have space for num_samples() floats.
+	 */
+	void get_data_as_float(float *dest) const;
+	/** Converts the analog data to float, see Analog::to_float(). */
+	void to_float(std::vector<float> &dest) const;
+	/** Number of samples in this packet. */
+	unsigned int num_samples() const;
+	/** Number of channels for which this packet contains data. */
+	unsigned int num_channels() const;
+	/** Channel of the given index, in the order of Analog::channels(). */
+	std::shared_ptr<Channel> channel(unsigned int index) const;
+	/** Size of a single sample in bytes. */
+	unsigned int unitsize() const;
+	/** Samples use a signed data type. */
+	bool is_signed() const;
+	/** Samples use float. */
+	bool is_float() const;
+	/** Samples are stored in big-endian order. */
+	bool is_bigendian() const;
+	/** Number of significant digits, see Analog::digits(). */
+	int digits() const;
+	/** Measured quantity of the samples in this packet. */
+	const Quantity *mq() const;
+	/** Unit of the samples in this packet. */
+	const Unit *unit() const;
+	/** Measurement flags associated with the samples in this packet. */
+	std::vector<const QuantityFlag *> mq_flags() const;
+private:
+	AnalogView(Session &session, const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_analog *structure);
+	Session &_session;
+	const struct sr_dev_inst *_sdi;
+	const struct sr_datafeed_analog *_structure;
+
+	friend class PacketView;
+};
+
 /** Number represented by a numerator/denominator integer pair */
 class SR_API Rational :
 	public ParentOwned<Rational, Analog>
@@ -1015,6 +1266,16 @@ public:
 	/** Update output with data from the given packet.
 	 * @param packet Packet to handle. */
 	std::string receive(std::shared_ptr<Packet> packet);
+	/** Update output with data from the given packet, appending the
+	 * output to a string whose capacity is reused across packets.
+	 * @param packet Packet to handle.
+	 * @param out String to append to. */
+	void receive(std::shared_ptr<Packet> packet, std::string &out);
+	/** Update output with data from the given packet, writing the
+	 * output to a stream without an intermediate string.
+	 * @param packet Packet to handle.
+	 * @param out Stream to write to. */
+	void receive(std::shared_ptr<Packet> packet, std::ostream &out);
 	/** Output format in use for this output */
 	std::shared_ptr<OutputFormat> format();
 private:
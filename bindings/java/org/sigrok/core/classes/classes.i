@@ -372,6 +372,66 @@ typedef jobject jdatafeedcallback;
   }
 }
 
+/* Bulk access to packet data, without a JNI call per sample. */
+
+%inline {
+typedef jobject jlogicbuffer;
+typedef jobject janalogbuffer;
+}
+
+%typemap(jni) jlogicbuffer, janalogbuffer "jobject"
+%typemap(jtype) jlogicbuffer, janalogbuffer "java.nio.ByteBuffer"
+%typemap(jstype) jlogicbuffer, janalogbuffer "java.nio.ByteBuffer"
+%typemap(out) jlogicbuffer, janalogbuffer "$result = $1;"
+%typemap(javaout) jlogicbuffer {
+    return $jnicall.order(java.nio.ByteOrder.nativeOrder());
+  }
+%typemap(javaout) janalogbuffer {
+    return $jnicall.order(is_bigendian() ?
+      java.nio.ByteOrder.BIG_ENDIAN : java.nio.ByteOrder.LITTLE_ENDIAN);
+  }
+
+%typemap(jni) jfloatArray "jfloatArray"
+%typemap(jtype) jfloatArray "float[]"
+%typemap(jstype) jfloatArray "float[]"
+%typemap(out) jfloatArray "$result = $1;"
+%typemap(javaout) jfloatArray {
+    return $jnicall;
+  }
+
+%extend sigrok::Logic
+{
+  /* Direct buffer on the samples, valid as long as the packet's data. */
+  jlogicbuffer data_buffer(JNIEnv *env)
+  {
+    return env->NewDirectByteBuffer($self->data_pointer(),
+      $self->data_length());
+  }
+}
+
+%extend sigrok::Analog
+{
+  /* Direct buffer on the samples in the packet's encoding, valid as
+   * long as the packet's data. */
+  janalogbuffer raw_buffer(JNIEnv *env)
+  {
+    auto raw = $self->raw();
+    return env->NewDirectByteBuffer(const_cast<uint8_t *>(raw.data()),
+      raw.size());
+  }
+
+  /* All samples converted to float, num_samples per channel. */
+  jfloatArray float_data(JNIEnv *env)
+  {
+    std::vector<float> data;
+    $self->to_float(data);
+    jfloatArray result = env->NewFloatArray(data.size());
+    if (result)
+      env->SetFloatArrayRegion(result, 0, data.size(), data.data());
+    return result;
+  }
+}
+
 %include "doc.i"
 
 %define %enumextras(Class)
@@ -91,6 +91,10 @@ typedef guint pyg_flags_type;
 #endif
     }
     import_array();
+#if PY_VERSION_HEX < 0x03070000
+    /* Session.run() releases the GIL, callbacks take it back. */
+    PyEval_InitThreads();
+#endif
 %}
 
 %include "../../../swig/templates.i"
@@ -252,6 +256,22 @@ typedef guint pyg_flags_type;
     Py_XINCREF($input);
 }
 
+/*
+ * Release the GIL while the session runs, so other Python threads keep
+ * going during the acquisition. The callbacks above reacquire it.
+ */
+%exception sigrok::Session::run {
+    PyThreadState *thread_state = PyEval_SaveThread();
+    try {
+        $action
+    } catch (sigrok::Error &e) {
+        PyEval_RestoreThread(thread_state);
+        SWIG_exception(swig_exception_code(e.result),
+            const_cast<char*>(e.what()));
+    }
+    PyEval_RestoreThread(thread_state);
+}
+
 /* Cast PacketPayload pointers to correct subclass type. */
 %ignore sigrok::Packet::payload;
 
@@ -539,42 +559,395 @@ std::map<std::string, Glib::VariantBase> dict_to_map_options(PyObject *dict,
     }
 }
 
-/* Return NumPy array from Analog::data(). */
+%{
+static void packet_capsule_free(PyObject *capsule)
+{
+    delete static_cast<std::shared_ptr<sigrok::Packet> *>(
+        PyCapsule_GetPointer(capsule, "sigrok.Packet"));
+}
+
+/* Wrap payload data in an array which keeps the packet alive. */
+static PyObject *array_from_packet(std::shared_ptr<sigrok::Packet> packet,
+    PyArray_Descr *descr, int nd, npy_intp *dims, npy_intp *strides,
+    void *data, int flags)
+{
+    PyObject *array, *capsule;
+
+    array = PyArray_NewFromDescr(&PyArray_Type, descr, nd, dims, strides,
+        data, flags, NULL);
+    if (!array)
+        return NULL;
+    capsule = PyCapsule_New(new std::shared_ptr<sigrok::Packet>(packet),
+        "sigrok.Packet", packet_capsule_free);
+    if (!capsule || PyArray_SetBaseObject((PyArrayObject *)array, capsule) < 0) {
+        Py_XDECREF(capsule);
+        Py_DECREF(array);
+        return NULL;
+    }
+
+    return array;
+}
+
+/* NumPy type of the samples in an analog packet, or -1. */
+static int analog_typenum(const sigrok::Analog *analog)
+{
+    if (analog->is_float()) {
+        switch (analog->unitsize()) {
+        case 4: return NPY_FLOAT32;
+        case 8: return NPY_FLOAT64;
+        }
+    } else if (analog->is_signed()) {
+        switch (analog->unitsize()) {
+        case 1: return NPY_INT8;
+        case 2: return NPY_INT16;
+        case 4: return NPY_INT32;
+        case 8: return NPY_INT64;
+        }
+    } else {
+        switch (analog->unitsize()) {
+        case 1: return NPY_UINT8;
+        case 2: return NPY_UINT16;
+        case 4: return NPY_UINT32;
+        case 8: return NPY_UINT64;
+        }
+    }
+
+    return -1;
+}
+%}
+
+/* Return NumPy arrays from Analog data. */
 %extend sigrok::Analog
 {
-    PyObject * _data()
+    /* Samples in the packet's encoding, as a read-only view. */
+    PyObject * _raw()
+    {
+        PyArray_Descr *descr, *swapped;
+        npy_intp dims[2], strides[2];
+        int typenum;
+
+        if ((typenum = analog_typenum($self)) < 0) {
+            PyErr_SetString(PyExc_TypeError, "Unsupported analog encoding");
+            return NULL;
+        }
+        descr = PyArray_DescrFromType(typenum);
+        if ($self->unitsize() > 1) {
+            swapped = PyArray_DescrNewByteorder(descr,
+                $self->is_bigendian() ? NPY_BIG : NPY_LITTLE);
+            Py_DECREF(descr);
+            if (!(descr = swapped))
+                return NULL;
+        }
+        dims[0] = $self->channels().size();
+        dims[1] = $self->num_samples();
+        strides[0] = $self->channel_stride();
+        strides[1] = $self->sample_stride();
+
+        return array_from_packet($self->parent(), descr, 2, dims, strides,
+            $self->data_pointer(), 0);
+    }
+
+    /* Data converted to floats, into out if given. */
+    PyObject * _to_float(PyObject *out)
     {
-        int nd = 2;
         npy_intp dims[2];
+        PyArrayObject *array;
+
         dims[0] = $self->channels().size();
         dims[1] = $self->num_samples();
-        int typenum = NPY_FLOAT;
-        void *data = $self->data_pointer();
-        return PyArray_SimpleNewFromData(nd, dims, typenum, data);
+        if (out == Py_None) {
+            out = PyArray_SimpleNew(2, dims, NPY_FLOAT32);
+            if (!out)
+                return NULL;
+        } else {
+            if (!PyArray_Check(out)) {
+                PyErr_SetString(PyExc_TypeError, "Expected a NumPy array");
+                return NULL;
+            }
+            array = (PyArrayObject *)out;
+            if (PyArray_TYPE(array) != NPY_FLOAT32 ||
+                    !PyArray_ISCARRAY(array) ||
+                    PyArray_SIZE(array) < dims[0] * dims[1]) {
+                PyErr_SetString(PyExc_ValueError, "Expected a writeable, "
+                    "contiguous float32 array of channels * num_samples");
+                return NULL;
+            }
+            Py_INCREF(out);
+        }
+        if (dims[0] * dims[1])
+            $self->get_data_as_float(
+                (float *)PyArray_DATA((PyArrayObject *)out));
+
+        return out;
+    }
+
+    /* Zero-copy view for float32 data, a converted copy otherwise. */
+    PyObject * _data()
+    {
+        bool native = $self->is_float() && $self->unitsize() == 4 &&
+            $self->is_bigendian() == (G_BYTE_ORDER == G_BIG_ENDIAN);
+        auto scale = $self->scale();
+        auto offset = $self->offset();
+
+        if (native && scale->numerator() == (int64_t)scale->denominator() &&
+                offset->numerator() == 0)
+            return sigrok_Analog__raw($self);
+
+        return sigrok_Analog__to_float($self, Py_None);
     }
 
 %pythoncode
 {
     data = property(_data)
+    raw = property(_raw)
+
+    def to_float(self, out=None):
+        return self._to_float(out)
 }
 }
 
+%{
+/* Channel indices from a Python sequence, checked against the unit size. */
+static bool logic_channels(PyObject *seq, unsigned int unit_size,
+    std::vector<unsigned int> &channels)
+{
+    PyObject *fast;
+    long index;
+
+    if (!(fast = PySequence_Fast(seq, "Expected a sequence of channel indices")))
+        return false;
+    for (Py_ssize_t i = 0; i < PySequence_Fast_GET_SIZE(fast); i++) {
+        index = PyLong_AsLong(PySequence_Fast_GET_ITEM(fast, i));
+        if (index == -1 && PyErr_Occurred())
+            break;
+        if (index < 0 || index >= (long)unit_size * 8) {
+            PyErr_SetString(PyExc_IndexError, "Channel index out of range");
+            break;
+        }
+        channels.push_back(index);
+    }
+    Py_DECREF(fast);
+
+    return !PyErr_Occurred();
+}
+%}
+
 /* Return NumPy array from Logic::data(). */
 %extend sigrok::Logic
 {
+    /* One row of 0/1 bytes per selected channel. */
+    PyObject * _channel_data(PyObject *seq)
+    {
+        const unsigned int unit_size = $self->unit_size();
+        const size_t num_samples = $self->data_length() / unit_size;
+        const uint8_t *data = (const uint8_t *)$self->data_pointer();
+        std::vector<unsigned int> channels;
+        npy_intp dims[2];
+        PyObject *array;
+        uint8_t *out;
+
+        if (!logic_channels(seq, unit_size, channels))
+            return NULL;
+        dims[0] = channels.size();
+        dims[1] = num_samples;
+        if (!(array = PyArray_SimpleNew(2, dims, NPY_UINT8)))
+            return NULL;
+        out = (uint8_t *)PyArray_DATA((PyArrayObject *)array);
+
+        for (size_t c = 0; c < channels.size(); c++) {
+            const uint8_t *src = data + channels[c] / 8;
+            const unsigned int shift = channels[c] % 8;
+            uint8_t *dst = out + c * num_samples;
+            /* Simple enough for the compiler to vectorize. */
+            for (size_t i = 0; i < num_samples; i++)
+                dst[i] = (src[i * unit_size] >> shift) & 1;
+        }
+
+        return array;
+    }
+
+    /* Per selected channel, the sample indices at which it changes. */
+    PyObject * _edges(PyObject *seq)
+    {
+        const unsigned int unit_size = $self->unit_size();
+        const size_t num_samples = $self->data_length() / unit_size;
+        const uint8_t *data = (const uint8_t *)$self->data_pointer();
+        std::vector<unsigned int> channels;
+        std::vector<npy_int64> edges;
+        npy_intp dims[1];
+        PyObject *list, *array;
+
+        if (!logic_channels(seq, unit_size, channels))
+            return NULL;
+        if (!(list = PyList_New(channels.size())))
+            return NULL;
+
+        for (size_t c = 0; c < channels.size(); c++) {
+            const uint8_t *src = data + channels[c] / 8;
+            const uint8_t mask = 1 << (channels[c] % 8);
+            uint8_t prev = num_samples ? src[0] & mask : 0;
+            edges.clear();
+            for (size_t i = 1; i < num_samples; i++) {
+                const uint8_t cur = src[i * unit_size] & mask;
+                if (cur != prev)
+                    edges.push_back(i);
+                prev = cur;
+            }
+            dims[0] = edges.size();
+            if (!(array = PyArray_SimpleNew(1, dims, NPY_INT64))) {
+                Py_DECREF(list);
+                return NULL;
+            }
+            if (!edges.empty())
+                memcpy(PyArray_DATA((PyArrayObject *)array), edges.data(),
+                    edges.size() * sizeof(npy_int64));
+            PyList_SET_ITEM(list, c, array);
+        }
+
+        return list;
+    }
+
     PyObject * _data()
     {
         npy_intp dims[2];
         dims[0] = $self->data_length() / $self->unit_size();
         dims[1] = $self->unit_size();
-        int typenum = NPY_UINT8;
-        void *data = $self->data_pointer();
-        return PyArray_SimpleNewFromData(2, dims, typenum, data);
+        return array_from_packet($self->parent(),
+            PyArray_DescrFromType(NPY_UINT8), 2, dims, NULL,
+            $self->data_pointer(), NPY_ARRAY_CARRAY);
     }
 
 %pythoncode
 {
     data = property(_data)
+
+    def channel_data(self, channels):
+        """Samples of the given channel indices without unpacking all
+        bits, as a (len(channels), samples) uint8 array of 0 and 1. Use
+        .view(bool) for a boolean array."""
+        return self._channel_data(channels)
+
+    def edges(self, channels):
+        """List of int64 arrays, one per given channel index, holding
+        the indices of the samples at which that channel changes."""
+        return self._edges(channels)
+}
+}
+
+%{
+/*
+ * Collects copies of the packets of a session without the GIL, and
+ * hands them to Python as one list every interval, and at the end of
+ * the acquisition.
+ */
+class DatafeedBatcher
+{
+public:
+    DatafeedBatcher(PyObject *callback, double interval) :
+        _callback(callback),
+        _interval(interval * G_USEC_PER_SEC),
+        _last_flush(g_get_monotonic_time())
+    {
+        Py_INCREF(_callback);
+    }
+
+    ~DatafeedBatcher()
+    {
+        auto gstate = PyGILState_Ensure();
+        Py_DECREF(_callback);
+        PyGILState_Release(gstate);
+    }
+
+    void add(std::shared_ptr<sigrok::Device> device,
+        std::shared_ptr<sigrok::Packet> packet)
+    {
+        bool end = packet->type() == sigrok::PacketType::END;
+
+        _packets.push_back(std::make_pair(device, packet->copy()));
+        if (end || g_get_monotonic_time() - _last_flush >= _interval)
+            flush();
+    }
+
+private:
+    void flush()
+    {
+        auto gstate = PyGILState_Ensure();
+
+        auto list = PyList_New(_packets.size());
+        for (size_t i = 0; i < _packets.size(); i++) {
+            auto device_obj = SWIG_NewPointerObj(
+                SWIG_as_voidptr(new std::shared_ptr<sigrok::Device>(
+                    _packets[i].first)),
+                SWIGTYPE_p_std__shared_ptrT_sigrok__Device_t, SWIG_POINTER_OWN);
+            auto packet_obj = SWIG_NewPointerObj(
+                SWIG_as_voidptr(new std::shared_ptr<sigrok::Packet>(
+                    _packets[i].second)),
+                SWIGTYPE_p_std__shared_ptrT_sigrok__Packet_t, SWIG_POINTER_OWN);
+            PyList_SET_ITEM(list, i, Py_BuildValue("(NN)",
+                device_obj, packet_obj));
+        }
+        _packets.clear();
+        _last_flush = g_get_monotonic_time();
+
+        auto arglist = Py_BuildValue("(N)", list);
+
+        auto result = PyEval_CallObject(_callback, arglist);
+
+        Py_XDECREF(arglist);
+
+        bool completed = !PyErr_Occurred();
+
+        if (!completed)
+            PyErr_Print();
+
+        bool valid_result = (completed && result == Py_None);
+
+        Py_XDECREF(result);
+
+        if (completed && !valid_result)
+        {
+            PyErr_SetString(PyExc_TypeError,
+                "Datafeed batch callback did not return None");
+            PyErr_Print();
+        }
+
+        PyGILState_Release(gstate);
+
+        if (!valid_result)
+            throw sigrok::Error(SR_ERR);
+    }
+
+    PyObject *_callback;
+    gint64 _interval;
+    gint64 _last_flush;
+    std::vector<std::pair<std::shared_ptr<sigrok::Device>,
+        std::shared_ptr<sigrok::Packet> > > _packets;
+};
+%}
+
+/* Deliver packets to Python in batches. */
+%extend sigrok::Session
+{
+    void _add_datafeed_batch_callback(PyObject *callback, double interval)
+    {
+        if (!PyCallable_Check(callback))
+            throw sigrok::Error(SR_ERR_ARG);
+
+        auto batcher = std::make_shared<DatafeedBatcher>(callback, interval);
+        $self->add_datafeed_callback(
+            [batcher] (std::shared_ptr<sigrok::Device> device,
+                    std::shared_ptr<sigrok::Packet> packet) {
+                batcher->add(device, packet);
+            });
+    }
+
+%pythoncode
+{
+    def add_datafeed_batch_callback(self, callback, interval=0.05):
+        """Call callback(packets) with a list of (device, packet) tuples
+        every interval seconds and at the end of the acquisition. The
+        packets are copies which stay valid after the callback."""
+        self._add_datafeed_batch_callback(callback, interval)
 }
 }
 
@@ -427,3 +427,32 @@ int convert_option_by_key(VALUE key, VALUE val, VALUE in) {
         return channels;
     }
 }
+
+/* Bulk access to packet data as binary strings, for String#unpack. */
+%extend sigrok::Logic
+{
+    VALUE bytes()
+    {
+        return rb_str_new((const char *) $self->data_pointer(),
+            $self->data_length());
+    }
+}
+
+%extend sigrok::Analog
+{
+    /* Samples in the packet's encoding. */
+    VALUE raw_bytes()
+    {
+        auto raw = $self->raw();
+        return rb_str_new((const char *) raw.data(), raw.size());
+    }
+
+    /* Samples converted to native floats, num_samples per channel. */
+    VALUE float_bytes()
+    {
+        std::vector<float> data;
+        $self->to_float(data);
+        return rb_str_new((const char *) data.data(),
+            data.size() * sizeof(float));
+    }
+}
@@ -80,6 +80,21 @@ template< class T > class enable_shared_from_this;
 #define SR_PRIV
 
 %ignore sigrok::DatafeedCallbackData;
+/* Views must not outlive their callback, which scripts can't ensure. */
+%ignore sigrok::Session::add_datafeed_view_callback;
+%ignore sigrok::Session::add_datafeed_queue;
+%ignore sigrok::Session::run_async;
+%ignore sigrok::PacketQueue;
+%ignore sigrok::PacketView;
+%ignore sigrok::LogicView;
+%ignore sigrok::AnalogView;
+%ignore sigrok::Span;
+%ignore sigrok::Analog::raw;
+%ignore sigrok::Analog::to_float;
+%ignore sigrok::Logic::set_data;
+%ignore sigrok::Analog::set_data;
+%ignore sigrok::Output::receive(std::shared_ptr<sigrok::Packet>, std::string &);
+%ignore sigrok::Output::receive(std::shared_ptr<sigrok::Packet>, std::ostream &);
 
 #ifndef SWIGJAVA
 
@@ -207,6 +222,10 @@ typedef std::map<const sigrok::ConfigKey *, Glib::VariantBase>
 %attributevector(Analog,
     std::vector<std::shared_ptr<sigrok::Channel> >, channels, channels);
 %attribute(sigrok::Analog, int, num_samples, num_samples);
+%attribute(sigrok::Analog, unsigned int, unitsize, unitsize);
+%attribute(sigrok::Analog, bool, is_signed, is_signed);
+%attribute(sigrok::Analog, bool, is_float, is_float);
+%attribute(sigrok::Analog, bool, is_bigendian, is_bigendian);
 %attribute(sigrok::Analog, const sigrok::Quantity *, mq, mq);
 %attribute(sigrok::Analog, const sigrok::Unit *, unit, unit);
 %attributevector(Analog, std::vector<const sigrok::QuantityFlag *>, mq_flags, mq_flags);
@@ -169,12 +169,19 @@ enum sr_packettype {
 	SR_DF_TRIGGER,
 	/** Payload is struct sr_datafeed_logic. */
 	SR_DF_LOGIC,
-	/** Beginning of frame. No payload. */
+	/**
+	 * Beginning of frame. Payload is NULL, or struct sr_datafeed_frame
+	 * for segments of a segmented capture.
+	 */
 	SR_DF_FRAME_BEGIN,
 	/** End of frame. No payload. */
 	SR_DF_FRAME_END,
 	/** Payload is struct sr_datafeed_analog. */
 	SR_DF_ANALOG,
+	/** Payload is struct sr_datafeed_logic_edges. */
+	SR_DF_LOGIC_EDGES,
+	/** Samples were lost here. Payload is struct sr_datafeed_gap. */
+	SR_DF_GAP,
 
 	/* Update datafeed_dump() (session.c) upon changes! */
 };
@@ -482,6 +489,22 @@ struct sr_context;
  */
 struct sr_session;
 
+/**
+ * @struct sr_capture_store
+ * Opaque structure keeping the samples of an acquisition in memory.
+ *
+ * @see sr_capture_store_new(), sr_capture_store_free().
+ */
+struct sr_capture_store;
+
+/**
+ * @struct sr_logic_edge_index
+ * Opaque structure collecting the transitions of logic channels.
+ *
+ * @see sr_logic_edge_index_new(), sr_logic_edges_find().
+ */
+struct sr_logic_edge_index;
+
 struct sr_rational {
 	/** Numerator of the rational number. */
 	int64_t p;
@@ -513,6 +536,66 @@ struct sr_datafeed_logic {
 	void *data;
 };
 
+/**
+ * Logic datafeed payload for type SR_DF_LOGIC_EDGES.
+ *
+ * Carries the same samples as an SR_DF_LOGIC packet, as a list of the
+ * positions where the value changes. The value at each offset holds
+ * until the next offset, or until the end of the packet. Samples before
+ * the first offset keep the last value of the previous packet. The first
+ * packet of a stream always has an entry at offset 0.
+ */
+struct sr_datafeed_logic_edges {
+	/** Number of samples covered by the packet. */
+	uint64_t num_samples;
+	uint16_t unitsize;
+	/** Number of entries in offsets and values. */
+	uint64_t num_edges;
+	/** Increasing sample offsets from the start of the packet. */
+	uint64_t *offsets;
+	/** New sample values, num_edges * unitsize bytes. */
+	void *values;
+};
+
+/** Cause of an SR_DF_GAP packet, sr_datafeed_gap.reason. */
+enum sr_gap_reason {
+	/** A transfer from the device failed, its data was lost. */
+	SR_GAP_TRANSFER = 10000,
+	/** The device's buffer overran before the host read it. */
+	SR_GAP_OVERRUN,
+	/** The device stopped sending data, the acquisition ends early. */
+	SR_GAP_ABORTED,
+};
+
+/**
+ * Datafeed payload for type SR_DF_GAP.
+ *
+ * Tells consumers that the capture is incomplete: samples which the
+ * device acquired were lost between the samples sent before, and those
+ * sent after this packet.
+ */
+struct sr_datafeed_gap {
+	/**
+	 * Number of samples the device sent before the gap, on its logic
+	 * stream, or on its analog stream if it sent no logic samples.
+	 */
+	uint64_t sample_index;
+	/** Number of samples lost, 0 if unknown. */
+	uint64_t num_samples;
+	/** Cause of the gap, enum sr_gap_reason. */
+	int reason;
+};
+
+/** Optional datafeed payload for type SR_DF_FRAME_BEGIN. */
+struct sr_datafeed_frame {
+	/** Index of the segment in the device's memory, starting at 0. */
+	uint64_t index;
+	/** TRUE if the device reported the segment's trigger time. */
+	gboolean has_time;
+	/** Trigger time of the segment in seconds, relative to index 0. */
+	double time;
+};
+
 /** Analog datafeed payload for type SR_DF_ANALOG. */
 struct sr_datafeed_analog {
 	void *data;
@@ -536,6 +619,19 @@ struct sr_analog_encoding {
 	gboolean is_digits_decimal;
 	struct sr_rational scale;
 	struct sr_rational offset;
+	/**
+	 * Layout of the samples of several channels: TRUE when all samples
+	 * of a channel come before those of the next one, FALSE when the
+	 * samples of the channels are interleaved.
+	 */
+	gboolean is_planar;
+	/**
+	 * Distance in bytes between consecutive samples of a channel, and
+	 * between the first samples of consecutive channels. Zero means
+	 * packed, as follows from the layout.
+	 */
+	uint32_t sample_stride;
+	uint32_t channel_stride;
 };
 
 struct sr_analog_meaning {
@@ -555,6 +651,212 @@ struct sr_analog_spec {
 	int8_t spec_digits;
 };
 
+/** Policy of asynchronous datafeed dispatch when its queue is full. */
+enum sr_dispatch_policy {
+	/** Block the sender until the consumer thread catches up. */
+	SR_DISPATCH_BLOCK = 10000,
+	/** Drop logic and analog packets, block for all other packets. */
+	SR_DISPATCH_DROP,
+};
+
+/** Counters of the memory pool used by sr_packet_copy(). */
+struct sr_packet_pool_stats {
+	/** Number of allocations served from the pool. */
+	uint64_t hits;
+	/** Number of allocations which needed new memory. */
+	uint64_t misses;
+	/** Number of allocations too large to be pooled. */
+	uint64_t oversized;
+	/** Number of bytes currently kept in the pool. */
+	uint64_t cached_bytes;
+};
+
+/** Ways of waiting for file descriptor events in a session. */
+enum sr_event_backend {
+	/** One GLib event source polls each descriptor. */
+	SR_EVENT_BACKEND_GLIB = 10000,
+	/** One epoll set watches all descriptors (Linux only). */
+	SR_EVENT_BACKEND_EPOLL,
+};
+
+/** Huge page use of sample buffers, see sr_buffer_hugepages_set(). */
+enum sr_hugepages {
+	/** Buffers are allocated from the heap. */
+	SR_HUGEPAGES_NONE = 10000,
+	/** Buffers use transparent huge pages where available. */
+	SR_HUGEPAGES_TRANSPARENT,
+	/** Buffers use reserved huge pages, else transparent ones. */
+	SR_HUGEPAGES_EXPLICIT,
+};
+
+/** Subsystems whose memory is accounted, see sr_mem_stats_get(). */
+enum sr_mem_kind {
+	/** Packet copies, e.g. for asynchronous datafeed dispatch. */
+	SR_MEM_PACKETS = 10000,
+	/** Pre-trigger buffers of the soft trigger. */
+	SR_MEM_TRIGGER,
+	/** Buffers of output modules. */
+	SR_MEM_OUTPUT,
+	/** USB transfer buffers. */
+	SR_MEM_TRANSFERS,
+};
+
+/** Memory use of a subsystem, see sr_mem_stats_get(). */
+struct sr_mem_stats {
+	/** Number of bytes currently in use. */
+	uint64_t bytes;
+	/** Highest number of bytes which were in use at the same time. */
+	uint64_t peak;
+	/** Number of allocations so far. */
+	uint64_t allocations;
+};
+
+/** Threads of a session, see sr_session_thread_sched_set(). */
+enum sr_thread_kind {
+	/** Per-device threads, see sr_session_dev_threads_set(). */
+	SR_THREAD_DEVICE = 10000,
+	/** libusb event threads of USB streaming drivers. */
+	SR_THREAD_USB_EVENTS,
+	/** Consumer thread, see sr_session_dispatch_async_set(). */
+	SR_THREAD_DISPATCH,
+};
+
+/** Scheduling of a kind of thread, see sr_session_thread_sched_set(). */
+struct sr_thread_sched {
+	/** Real-time (SCHED_FIFO) priority from 1 to 99, 0 for normal. */
+	int rt_priority;
+	/** The CPUs the threads may run on, bit 0 is CPU 0. 0 for all. */
+	uint64_t cpu_mask;
+};
+
+/** Ways of playing back a session file, see sr_session_playback_set(). */
+enum sr_playback_mode {
+	/** Send one block of samples per main loop iteration. */
+	SR_PLAYBACK_STEP = 10000,
+	/** Send large blocks for as long as possible, for batch processing. */
+	SR_PLAYBACK_MAX,
+	/** Send the samples when they are due at the samplerate. */
+	SR_PLAYBACK_REALTIME,
+};
+
+/** Counters of asynchronous datafeed dispatch. */
+struct sr_dispatch_stats {
+	/** Number of packets which were queued for the consumer thread. */
+	uint64_t queued;
+	/** Number of packets which were dropped since the queue was full. */
+	uint64_t dropped;
+	/** Number of times the sender had to wait for free queue space. */
+	uint64_t blocked;
+	/** Highest number of packets that were pending at the same time. */
+	uint64_t max_fill;
+	/** Number of times the memory budget held packets back. */
+	uint64_t over_budget;
+};
+
+/** Binary record of a packet sent on the session bus. */
+struct sr_trace_record {
+	/** Time the packet was sent in microseconds, monotonic clock. */
+	int64_t timestamp;
+	/** Packet type, SR_DF_HEADER etc. */
+	uint16_t type;
+	/** Size of one sample in bytes, 0 if the packet holds no samples. */
+	uint16_t unitsize;
+	/** Length of the sample data in bytes. */
+	uint64_t length;
+	/** Number of samples in the packet. */
+	uint64_t num_samples;
+};
+
+/** Data and driver counters of a device in a session run. */
+struct sr_dev_stats {
+	/** The device, NULL unless obtained via sr_session_stats_get(). */
+	const struct sr_dev_inst *sdi;
+	/** Number of packets sent by the device. */
+	uint64_t packets;
+	/** Number of sample data bytes sent by the device. */
+	uint64_t bytes;
+	/** Number of samples sent by the device. */
+	uint64_t samples;
+	/** Number of transfers (USB or otherwise) which carried data. */
+	uint64_t transfers;
+	/** Number of transfers which were empty or failed. */
+	uint64_t empty_transfers;
+	/** Number of transfers which were resubmitted. */
+	uint64_t resubmitted_transfers;
+	/** Number of transfers which could not be resubmitted. */
+	uint64_t dropped_transfers;
+	/** Number of transfers whose completion was handled late. */
+	uint64_t late_transfers;
+	/** Largest number of transfers which were in flight. */
+	uint64_t max_transfers;
+	/** Number of SR_DF_GAP packets sent by the device. */
+	uint64_t gaps;
+	/** Number of samples lost in gaps, as far as known. */
+	uint64_t lost_samples;
+};
+
+/** Time spent in a transform or datafeed callback in a session run. */
+struct sr_call_stats {
+	/** Transform module ID, or NULL for datafeed callbacks. */
+	const char *id;
+	/** Opaque data of the transform or datafeed callback. */
+	void *cb_data;
+	/** Number of packets passed. */
+	uint64_t calls;
+	/** Cumulative time spent in microseconds. */
+	uint64_t time_us;
+};
+
+/** Statistics of a session run, see sr_session_stats_get(). */
+struct sr_session_stats {
+	/** List of struct sr_dev_stats, one per device. */
+	GSList *devices;
+	/** List of struct sr_call_stats, in the order of the transforms. */
+	GSList *transforms;
+	/** List of struct sr_call_stats, in the order of the callbacks. */
+	GSList *callbacks;
+};
+
+/**
+ * Summary of a session file channel at one resolution.
+ *
+ * @see sr_session_overview_get()
+ */
+struct sr_overview {
+	/** Number of samples which one bucket summarizes. */
+	uint64_t bucket_size;
+	/** Number of buckets. */
+	uint64_t num_buckets;
+	/** Number of logic channels per bucket, 0 for analog overviews. */
+	unsigned int num_channels;
+	/** Logic: num_channels transition counts per bucket, else NULL. */
+	uint32_t *transitions;
+	/** Analog: minimum and maximum value of each bucket, else NULL. */
+	float *minmax;
+};
+
+/**
+ * Basic properties of a session file.
+ *
+ * @see sr_sessionfile_info()
+ */
+struct sr_sessionfile_info {
+	/** Samplerate in Hz, 0 if unknown. */
+	uint64_t samplerate;
+	/** Number of samples per channel. */
+	uint64_t num_samples;
+	/** Bytes per logic sample, 0 without logic data. */
+	unsigned int unitsize;
+	/** Number of logic channels, saved or not. */
+	unsigned int num_logic_channels;
+	/** Number of analog channels. */
+	unsigned int num_analog_channels;
+	/** Logic channel names, NULL for channels which were not saved. */
+	char **logic_names;
+	/** Analog channel names, NULL for channels without a name. */
+	char **analog_names;
+};
+
 /** Generic option struct used by various subsystems. */
 struct sr_option {
 	/* Short name suitable for commandline usage, [a-z0-9-]. */
@@ -597,6 +899,7 @@ enum sr_output_flag {
 struct sr_input;
 struct sr_input_module;
 struct sr_output;
+struct sr_output_group;
 struct sr_output_module;
 struct sr_transform;
 struct sr_transform_module;
@@ -784,6 +1087,12 @@ enum sr_configkey {
 	 */
 	SR_CONF_FORCE_DETECT,
 
+	/**
+	 * Upload firmware or FPGA images when opening the device, even if
+	 * the device still runs the image which was uploaded last.
+	 */
+	SR_CONF_FORCE_UPLOAD,
+
 	/* Update sr_key_info_config[] (hwdriver.c) upon changes! */
 
 	/*--- Device (or channel group) configuration -----------------------*/
@@ -1083,6 +1392,57 @@ enum sr_configkey {
 	 */
 	SR_CONF_RESISTANCE_TARGET,
 
+	/**
+	 * Generate data as fast as it gets consumed, ignoring the samplerate.
+	 * @arg type: boolean
+	 * @arg get: @b true if generation is unthrottled
+	 * @arg set: enable or disable unthrottled generation
+	 */
+	SR_CONF_UNTHROTTLED,
+
+	/**
+	 * Fraction of samples at which a logic channel changes its state.
+	 * @arg type: double, 0 to 1
+	 * @arg get: get the edge density
+	 * @arg set: change the edge density
+	 */
+	SR_CONF_EDGE_DENSITY,
+
+	/**
+	 * Interval in ms at which data gets delivered, in bursts.
+	 * @arg type: uint64
+	 * @arg get: get the burst interval
+	 * @arg set: change the burst interval
+	 */
+	SR_CONF_BURST_INTERVAL,
+
+	/**
+	 * Maximum random deviation in ms of the burst interval.
+	 * @arg type: uint64
+	 * @arg get: get the jitter
+	 * @arg set: change the jitter
+	 */
+	SR_CONF_BURST_JITTER,
+
+	/**
+	 * Encoding of analog samples, e.g. "float", "int16" or "int8".
+	 * @arg type: string
+	 * @arg get: get the encoding
+	 * @arg set: change the encoding
+	 * @arg list: list the supported encodings
+	 */
+	SR_CONF_ANALOG_ENCODING,
+
+	/**
+	 * Number of segments of a segmented (sequence) memory capture.
+	 * The device arms once for all segments, each one gets sent as
+	 * a frame. 0 or 1 disables segmented capture.
+	 * @arg type: uint64_t
+	 * @arg get: get the number of segments
+	 * @arg set: change the number of segments
+	 */
+	SR_CONF_NUM_SEGMENTS,
+
 	/* Update sr_key_info_config[] (hwdriver.c) upon changes! */
 
 	/*--- Special stuff -------------------------------------------------*/
@@ -1119,6 +1479,38 @@ enum sr_configkey {
 	/** Number of powerline cycles for ADC integration time. */
 	SR_CONF_ADC_POWERLINE_CYCLES,
 
+	/** Size of a USB transfer in bytes, 0 selects the driver default. */
+	SR_CONF_TRANSFER_SIZE,
+
+	/** Number of USB transfers in flight, 0 selects the driver default. */
+	SR_CONF_TRANSFER_COUNT,
+
+	/**
+	 * Adapt the number of USB transfers in flight. The driver queues
+	 * more transfers when it observes empty or late transfers.
+	 */
+	SR_CONF_TRANSFER_ADAPTIVE,
+
+	/**
+	 * Handle USB transfers on a thread of their own. Completed transfers
+	 * don't wait for the session's main loop to get resubmitted then.
+	 * Serial meters get serviced by a worker thread which is shared by
+	 * all serial ports, and only pass finished packets to the session.
+	 */
+	SR_CONF_TRANSFER_THREAD,
+
+	/**
+	 * Send analog samples in the device's binary encoding, with its
+	 * scale and offset in the payload's encoding, instead of floats.
+	 */
+	SR_CONF_ANALOG_RAW,
+
+	/**
+	 * Send logic data of compressed captures as SR_DF_LOGIC_EDGES
+	 * packets, instead of expanding the runs into SR_DF_LOGIC samples.
+	 */
+	SR_CONF_LOGIC_EDGES,
+
 	/* Update sr_key_info_config[] (hwdriver.c) upon changes! */
 
 	/*--- Acquisition modes, sample limiting ----------------------------*/
@@ -1248,6 +1640,13 @@ struct sr_dev_driver {
 	int (*config_list) (uint32_t key, GVariant **data,
 			const struct sr_dev_inst *sdi,
 			const struct sr_channel_group *cg);
+	/** Query values of several keys at once, optional. Drivers set the
+	 *  data of the keys they can answer to a (floating) GVariant.
+	 *  @see sr_config_get_many().
+	 */
+	int (*config_get_many) (struct sr_config *configs, unsigned int count,
+			const struct sr_dev_inst *sdi,
+			const struct sr_channel_group *cg);
 
 	/* Device-specific */
 	/** Open device */
@@ -30,10 +30,19 @@
 
 SR_API int sr_analog_to_float(const struct sr_datafeed_analog *analog,
 		float *buf);
+SR_API int sr_analog_to_float_prepared(const struct sr_datafeed_analog *analog,
+		float *buf);
+SR_API int sr_analog_to_double(const struct sr_datafeed_analog *analog,
+		double *buf);
+SR_API int sr_analog_get_raw(const struct sr_datafeed_analog *analog,
+		const void **data, size_t *count, struct sr_rational *scale,
+		struct sr_rational *offset);
 SR_API const char *sr_analog_si_prefix(float *value, int *digits);
 SR_API gboolean sr_analog_si_prefix_friendly(enum sr_unit unit);
 SR_API int sr_analog_unit_to_string(const struct sr_datafeed_analog *analog,
 		char **result);
+SR_API int sr_analog_format_values(const struct sr_datafeed_analog *analog,
+		const float *values, int digits, GString *out);
 SR_API void sr_rational_set(struct sr_rational *r, int64_t p, uint64_t q);
 SR_API int sr_rational_eq(const struct sr_rational *a, const struct sr_rational *b);
 SR_API int sr_rational_mult(struct sr_rational *res, const struct sr_rational *a,
@@ -46,10 +55,50 @@ SR_API int sr_rational_div(struct sr_rational *res, const struct sr_rational *nu
 SR_API int sr_init(struct sr_context **ctx);
 SR_API int sr_exit(struct sr_context *ctx);
 
+typedef void (*sr_hotplug_callback)(struct sr_context *ctx, gboolean arrived,
+		uint16_t vid, uint16_t pid, const char *connection_id,
+		void *cb_data);
+SR_API int sr_hotplug_callback_add(struct sr_context *ctx,
+		sr_hotplug_callback cb, void *cb_data);
+SR_API int sr_hotplug_callback_remove(struct sr_context *ctx,
+		sr_hotplug_callback cb, void *cb_data);
+
 SR_API GSList *sr_buildinfo_libs_get(void);
 SR_API char *sr_buildinfo_host_get(void);
 SR_API char *sr_buildinfo_scpi_backends_get(void);
 
+/*--- buffer.c --------------------------------------------------------------*/
+
+typedef void *(*sr_buffer_alloc_callback)(size_t size, void *cb_data);
+typedef void (*sr_buffer_free_callback)(void *buf, size_t size, void *cb_data);
+
+SR_API int sr_buffer_hugepages_set(int mode);
+SR_API int sr_buffer_allocator_set(sr_buffer_alloc_callback alloc_cb,
+		sr_buffer_free_callback free_cb, void *cb_data);
+SR_API int sr_mem_budget_set(uint64_t bytes);
+SR_API int sr_mem_stats_get(int kind, struct sr_mem_stats *stats);
+
+/*--- capture_store.c -------------------------------------------------------*/
+
+SR_API struct sr_capture_store *sr_capture_store_new(void);
+SR_API void sr_capture_store_free(struct sr_capture_store *store);
+SR_API int sr_capture_store_add(struct sr_capture_store *store,
+		const struct sr_datafeed_packet *packet);
+SR_API uint64_t sr_capture_store_logic_samples(const struct sr_capture_store *store,
+		uint16_t *unitsize);
+SR_API uint64_t sr_capture_store_analog_samples(struct sr_capture_store *store,
+		struct sr_channel *ch);
+SR_API uint64_t sr_capture_store_size(const struct sr_capture_store *store);
+SR_API int sr_capture_store_logic_read(struct sr_capture_store *store,
+		uint64_t start, uint64_t count, uint8_t *buf);
+SR_API int sr_capture_store_analog_read(struct sr_capture_store *store,
+		struct sr_channel *ch, uint64_t start, uint64_t count, float *buf);
+SR_API int sr_capture_store_analog_minmax(struct sr_capture_store *store,
+		struct sr_channel *ch, uint64_t start, uint64_t count,
+		float *min, float *max);
+SR_API int sr_capture_store_save(struct sr_capture_store *store,
+		const struct sr_dev_inst *sdi, const char *filename);
+
 /*--- conversion.c ----------------------------------------------------------*/
 
 SR_API int sr_a2l_threshold(const struct sr_datafeed_analog *analog,
@@ -57,6 +106,15 @@ SR_API int sr_a2l_threshold(const struct sr_datafeed_analog *analog,
 SR_API int sr_a2l_schmitt_trigger(const struct sr_datafeed_analog *analog,
 		float lo_thr, float hi_thr, uint8_t *state, uint8_t *output,
 		uint64_t count);
+SR_API int sr_a2l_threshold_multi(const struct sr_datafeed_analog *analog,
+		const float *thresholds, uint8_t *output, uint64_t count);
+SR_API struct sr_logic_edge_index *sr_logic_edge_index_new(uint64_t channel_mask);
+SR_API void sr_logic_edge_index_free(struct sr_logic_edge_index *index);
+SR_API void sr_logic_edge_index_clear(struct sr_logic_edge_index *index);
+SR_API int sr_logic_edges_find(struct sr_logic_edge_index *index,
+		const struct sr_datafeed_logic *logic);
+SR_API int sr_logic_edge_index_get(const struct sr_logic_edge_index *index,
+		unsigned int channel, const uint64_t **samples, uint64_t *count);
 
 /*--- log.c -----------------------------------------------------------------*/
 
@@ -68,6 +126,8 @@ SR_API int sr_log_loglevel_get(void);
 SR_API int sr_log_callback_set(sr_log_callback cb, void *cb_data);
 SR_API int sr_log_callback_set_default(void);
 SR_API int sr_log_callback_get(sr_log_callback *cb, void **cb_data);
+SR_API int sr_log_async_start(unsigned int ring_size);
+SR_API int sr_log_async_stop(void);
 
 /*--- device.c --------------------------------------------------------------*/
 
@@ -92,6 +152,8 @@ SR_API const char *sr_dev_inst_version_get(const struct sr_dev_inst *sdi);
 SR_API const char *sr_dev_inst_sernum_get(const struct sr_dev_inst *sdi);
 SR_API const char *sr_dev_inst_connid_get(const struct sr_dev_inst *sdi);
 SR_API GSList *sr_dev_inst_channels_get(const struct sr_dev_inst *sdi);
+SR_API struct sr_channel *sr_dev_inst_channel_by_name(
+		const struct sr_dev_inst *sdi, const char *name);
 SR_API GSList *sr_dev_inst_channel_groups_get(const struct sr_dev_inst *sdi);
 
 SR_API struct sr_dev_inst *sr_dev_inst_user_new(const char *vendor,
@@ -105,10 +167,19 @@ SR_API int sr_driver_init(struct sr_context *ctx,
 		struct sr_dev_driver *driver);
 SR_API GArray *sr_driver_scan_options_list(const struct sr_dev_driver *driver);
 SR_API GSList *sr_driver_scan(struct sr_dev_driver *driver, GSList *options);
+typedef void (*sr_driver_scan_callback)(struct sr_dev_driver *driver,
+		GSList *devices, void *cb_data);
+SR_API GSList *sr_driver_scan_all(struct sr_dev_driver **drivers,
+		GSList *options, unsigned int timeout_ms,
+		sr_driver_scan_callback cb, void *cb_data);
 SR_API int sr_config_get(const struct sr_dev_driver *driver,
 		const struct sr_dev_inst *sdi,
 		const struct sr_channel_group *cg,
 		uint32_t key, GVariant **data);
+SR_API int sr_config_get_many(const struct sr_dev_driver *driver,
+		const struct sr_dev_inst *sdi,
+		const struct sr_channel_group *cg,
+		struct sr_config *configs, unsigned int count);
 SR_API int sr_config_set(const struct sr_dev_inst *sdi,
 		const struct sr_channel_group *cg,
 		uint32_t key, GVariant *data);
@@ -125,12 +196,30 @@ SR_API const struct sr_key_info *sr_key_info_name_get(int keytype, const char *k
 typedef void (*sr_session_stopped_callback)(void *data);
 typedef void (*sr_datafeed_callback)(const struct sr_dev_inst *sdi,
 		const struct sr_datafeed_packet *packet, void *cb_data);
+typedef void (*sr_datafeed_batch_callback)(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packets, size_t num_packets,
+		void *cb_data);
 
 SR_API struct sr_trigger *sr_session_trigger_get(struct sr_session *session);
 
 /* Session setup */
 SR_API int sr_session_load(struct sr_context *ctx, const char *filename,
 	struct sr_session **session);
+SR_API int sr_session_range_set(struct sr_session *session, uint64_t start,
+	uint64_t count);
+SR_API int sr_session_decode_threads_set(struct sr_session *session,
+	unsigned int threads);
+SR_API int sr_session_playback_set(struct sr_session *session,
+	enum sr_playback_mode mode);
+SR_API int sr_session_search(struct sr_session *session,
+	struct sr_trigger *trigger, uint64_t max_matches,
+	uint64_t **matches, uint64_t *num_matches);
+SR_API int sr_session_overview_get(const char *filename, int analog,
+	uint64_t samples, struct sr_overview **overview);
+SR_API void sr_session_overview_free(struct sr_overview *overview);
+SR_API int sr_sessionfile_info(const char *filename,
+	struct sr_sessionfile_info **info);
+SR_API void sr_sessionfile_info_free(struct sr_sessionfile_info *info);
 SR_API int sr_session_new(struct sr_context *ctx, struct sr_session **session);
 SR_API int sr_session_destroy(struct sr_session *session);
 SR_API int sr_session_dev_remove_all(struct sr_session *session);
@@ -145,6 +234,19 @@ SR_API int sr_session_trigger_set(struct sr_session *session, struct sr_trigger
 SR_API int sr_session_datafeed_callback_remove_all(struct sr_session *session);
 SR_API int sr_session_datafeed_callback_add(struct sr_session *session,
 		sr_datafeed_callback cb, void *cb_data);
+SR_API int sr_session_datafeed_batch_callback_add(struct sr_session *session,
+		sr_datafeed_batch_callback cb, void *cb_data);
+SR_API int sr_session_datafeed_callback_add_thread_safe(
+		struct sr_session *session, sr_datafeed_callback cb,
+		void *cb_data);
+SR_API int sr_session_callback_threads_set(struct sr_session *session,
+		unsigned int num_threads);
+SR_API int sr_session_dev_threads_set(struct sr_session *session,
+		gboolean enable);
+SR_API int sr_session_event_backend_set(struct sr_session *session,
+		int backend);
+SR_API int sr_session_thread_sched_set(struct sr_session *session,
+		int kind, const struct sr_thread_sched *sched);
 
 /* Session control */
 SR_API int sr_session_start(struct sr_session *session);
@@ -153,10 +255,31 @@ SR_API int sr_session_stop(struct sr_session *session);
 SR_API int sr_session_is_running(struct sr_session *session);
 SR_API int sr_session_stopped_callback_set(struct sr_session *session,
 		sr_session_stopped_callback cb, void *cb_data);
+SR_API int sr_session_dispatch_async_set(struct sr_session *session,
+		size_t depth, int policy);
+SR_API int sr_session_dispatch_stats_get(struct sr_session *session,
+		struct sr_dispatch_stats *stats);
+SR_API int sr_session_stats_get(struct sr_session *session,
+		struct sr_session_stats **stats);
+SR_API void sr_session_stats_free(struct sr_session_stats *stats);
+SR_API int sr_session_trace_set(struct sr_session *session,
+		size_t num_records);
+SR_API int sr_session_trace_read(struct sr_session *session,
+		struct sr_trace_record *records, size_t max_records,
+		size_t *num_read, uint64_t *lost);
 
 SR_API int sr_packet_copy(const struct sr_datafeed_packet *packet,
 		struct sr_datafeed_packet **copy);
 SR_API void sr_packet_free(struct sr_datafeed_packet *packet);
+SR_API int sr_packet_pool_stats_get(struct sr_packet_pool_stats *stats);
+SR_API void sr_packet_pool_trim(void);
+SR_API int sr_packet_ref(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet,
+		struct sr_datafeed_packet **ref);
+SR_API void sr_packet_unref(struct sr_datafeed_packet *ref);
+SR_API int sr_packet_timestamp_get(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet,
+		int64_t *timestamp, uint64_t *sample_index);
 
 /*--- input/input.c ---------------------------------------------------------*/
 
@@ -176,6 +299,9 @@ SR_API int sr_input_scan_file(const char *filename, const struct sr_input **in);
 SR_API const struct sr_input_module *sr_input_module_get(const struct sr_input *in);
 SR_API struct sr_dev_inst *sr_input_dev_inst_get(const struct sr_input *in);
 SR_API int sr_input_send(const struct sr_input *in, GString *buf);
+SR_API int sr_input_send_data(const struct sr_input *in,
+		const void *data, size_t len);
+SR_API int sr_input_send_file(const struct sr_input *in, const char *filename);
 SR_API int sr_input_end(const struct sr_input *in);
 SR_API int sr_input_reset(const struct sr_input *in);
 SR_API void sr_input_free(const struct sr_input *in);
@@ -198,7 +324,18 @@ SR_API gboolean sr_output_test_flag(const struct sr_output_module *omod,
 		uint64_t flag);
 SR_API int sr_output_send(const struct sr_output *o,
 		const struct sr_datafeed_packet *packet, GString **out);
+typedef int (*sr_output_write_callback)(const struct sr_output *o,
+		const uint8_t *data, size_t length, void *cb_data);
+SR_API int sr_output_set_writer(const struct sr_output *o,
+		sr_output_write_callback cb, void *cb_data);
+SR_API int sr_output_set_fd(const struct sr_output *o, int fd);
 SR_API int sr_output_free(const struct sr_output *o);
+SR_API struct sr_output_group *sr_output_group_new(void);
+SR_API int sr_output_group_add(struct sr_output_group *group,
+		const struct sr_output *o);
+SR_API int sr_output_group_send(struct sr_output_group *group,
+		const struct sr_datafeed_packet *packet, GString **outs);
+SR_API void sr_output_group_free(struct sr_output_group *group);
 
 /*--- transform/transform.c -------------------------------------------------*/
 
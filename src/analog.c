@@ -157,6 +157,189 @@ SR_PRIV int sr_analog_init(struct sr_datafeed_analog *analog,
 	return SR_OK;
 }
 
+/* Approximate a value by a rational with a power of ten denominator. */
+static void rational_from_double(struct sr_rational *r, double value)
+{
+	double v;
+	uint64_t q;
+
+	q = 1;
+	v = value;
+	while (q < UINT64_C(1000000000000000000) && fabs(v) < 1e12 &&
+			fabs(v - rint(v)) > 1e-9 * fabs(v)) {
+		q *= 10;
+		v = value * q;
+	}
+	r->p = llrint(v);
+	r->q = q;
+}
+
+/**
+ * Describe integer samples in the device's encoding, which are converted
+ * as value = raw * scale + offset. Lets drivers send the data as the device
+ * sent it, instead of converting it to floats.
+ *
+ * @private
+ */
+SR_PRIV void sr_analog_set_raw_encoding(struct sr_analog_encoding *encoding,
+		uint8_t unitsize, gboolean is_signed, gboolean is_bigendian,
+		double scale, double offset)
+{
+	encoding->unitsize = unitsize;
+	encoding->is_signed = is_signed;
+	encoding->is_float = FALSE;
+	encoding->is_bigendian = is_bigendian;
+	rational_from_double(&encoding->scale, scale);
+	rational_from_double(&encoding->offset, offset);
+}
+
+/**
+ * Get the effective strides of the samples of a payload, in bytes.
+ *
+ * @private
+ */
+SR_PRIV void sr_analog_strides(const struct sr_datafeed_analog *analog,
+		size_t *sample_stride, size_t *channel_stride)
+{
+	const struct sr_analog_encoding *encoding;
+	size_t num_channels;
+
+	encoding = analog->encoding;
+	num_channels = g_slist_length(analog->meaning->channels);
+	if (encoding->is_planar) {
+		*sample_stride = encoding->unitsize;
+		*channel_stride = encoding->unitsize * analog->num_samples;
+	} else {
+		*sample_stride = encoding->unitsize * num_channels;
+		*channel_stride = encoding->unitsize;
+	}
+	if (encoding->sample_stride)
+		*sample_stride = encoding->sample_stride;
+	if (encoding->channel_stride)
+		*channel_stride = encoding->channel_stride;
+}
+
+/* Whether the samples are anything but packed and interleaved. */
+static gboolean analog_is_strided(const struct sr_datafeed_analog *analog)
+{
+	size_t sample_stride, channel_stride;
+
+	if (!analog->encoding->is_planar && !analog->encoding->sample_stride
+			&& !analog->encoding->channel_stride)
+		return FALSE;
+	sr_analog_strides(analog, &sample_stride, &channel_stride);
+
+	return channel_stride != analog->encoding->unitsize ||
+		sample_stride != analog->encoding->unitsize *
+		g_slist_length(analog->meaning->channels);
+}
+
+/**
+ * Get the number of bytes spanned by the samples of a payload.
+ *
+ * @private
+ */
+SR_PRIV size_t sr_analog_data_size(const struct sr_datafeed_analog *analog)
+{
+	size_t sample_stride, channel_stride, num_channels;
+
+	num_channels = MAX(g_slist_length(analog->meaning->channels), 1);
+	if (!analog->num_samples)
+		return 0;
+	sr_analog_strides(analog, &sample_stride, &channel_stride);
+
+	return (analog->num_samples - 1) * sample_stride +
+		(num_channels - 1) * channel_stride + analog->encoding->unitsize;
+}
+
+/*
+ * Call a conversion on a packed and interleaved copy of the samples of
+ * a strided or planar payload.
+ */
+static int analog_convert_packed(const struct sr_datafeed_analog *analog,
+		int (*convert)(const struct sr_datafeed_analog *, void *),
+		void *outbuf)
+{
+	struct sr_datafeed_analog packed;
+	struct sr_analog_encoding encoding;
+	size_t sample_stride, channel_stride, unitsize, num_channels, i, c;
+	const uint8_t *in;
+	uint8_t *buf, *out;
+	int ret;
+
+	sr_analog_strides(analog, &sample_stride, &channel_stride);
+	unitsize = analog->encoding->unitsize;
+	num_channels = g_slist_length(analog->meaning->channels);
+	if (!analog->num_samples || !num_channels)
+		return SR_OK;
+	if (!(buf = g_try_malloc(analog->num_samples * num_channels * unitsize)))
+		return SR_ERR_MALLOC;
+
+	out = buf;
+	for (i = 0; i < analog->num_samples; i++) {
+		in = (const uint8_t *)analog->data + i * sample_stride;
+		for (c = 0; c < num_channels; c++) {
+			memcpy(out, in + c * channel_stride, unitsize);
+			out += unitsize;
+		}
+	}
+
+	packed = *analog;
+	encoding = *analog->encoding;
+	encoding.is_planar = FALSE;
+	encoding.sample_stride = 0;
+	encoding.channel_stride = 0;
+	packed.encoding = &encoding;
+	packed.data = buf;
+	ret = convert(&packed, outbuf);
+	g_free(buf);
+
+	return ret;
+}
+
+static int analog_to_float_cb(const struct sr_datafeed_analog *analog,
+		void *outbuf)
+{
+	return sr_analog_to_float(analog, outbuf);
+}
+
+static int analog_to_double_cb(const struct sr_datafeed_analog *analog,
+		void *outbuf)
+{
+	return sr_analog_to_double(analog, outbuf);
+}
+
+/** @cond PRIVATE */
+/* Conversions of an encoding, besides the sr_simd_to_float() formats. */
+#define CONV_NATIVE	1
+#define CONV_GENERIC	2
+/** @endcond */
+
+/* Pick the conversion of an encoding. */
+static int analog_conversion(const struct sr_analog_encoding *encoding)
+{
+	gboolean host_bigendian;
+
+#ifdef WORDS_BIGENDIAN
+	host_bigendian = TRUE;
+#else
+	host_bigendian = FALSE;
+#endif
+	if (encoding->is_float && encoding->unitsize == sizeof(float)) {
+		if (encoding->is_bigendian == host_bigendian)
+			return CONV_NATIVE;
+		return encoding->is_bigendian ? SR_SIMD_F32BE : SR_SIMD_F32LE;
+	}
+	if (encoding->is_float)
+		return CONV_GENERIC;
+	if (encoding->unitsize == sizeof(uint8_t))
+		return encoding->is_signed ? SR_SIMD_I8 : SR_SIMD_U8;
+	if (encoding->unitsize == sizeof(uint16_t) && !encoding->is_bigendian)
+		return encoding->is_signed ? SR_SIMD_I16LE : SR_SIMD_U16LE;
+
+	return CONV_GENERIC;
+}
+
 /**
  * Convert an analog datafeed payload to an array of floats.
  *
@@ -184,6 +367,7 @@ SR_API int sr_analog_to_float(const struct sr_datafeed_analog *analog,
 	double scale, offset, value;
 	const uint8_t *data8;
 	gboolean input_is_native;
+	int conversion;
 	char type_text[10];
 
 	if (!analog || !analog->data || !analog->meaning || !analog->encoding)
@@ -191,6 +375,9 @@ SR_API int sr_analog_to_float(const struct sr_datafeed_analog *analog,
 	if (!outbuf)
 		return SR_ERR_ARG;
 
+	if (analog_is_strided(analog))
+		return analog_convert_packed(analog, analog_to_float_cb, outbuf);
+
 	count = analog->num_samples * g_slist_length(analog->meaning->channels);
 
 	/*
@@ -233,13 +420,16 @@ SR_API int sr_analog_to_float(const struct sr_datafeed_analog *analog,
 		input_bigendian == host_bigendian;
 	if (input_is_native) {
 		memcpy(outbuf, data8, count * sizeof(outbuf[0]));
-		if (scale != 1.0 || offset != 0.0) {
-			while (count--) {
-				*outbuf *= scale;
-				*outbuf += offset;
-				outbuf++;
-			}
-		}
+		if (scale != 1.0 || offset != 0.0)
+			sr_simd_scale_float(outbuf, count, scale, offset);
+		return SR_OK;
+	}
+
+	/* Vector kernels for the common formats. */
+	conversion = analog_conversion(analog->encoding);
+	if (conversion >= SR_SIMD_I8) {
+		sr_simd_to_float(conversion, data8, outbuf, count,
+			scale, offset);
 		return SR_OK;
 	}
 
@@ -252,24 +442,9 @@ SR_API int sr_analog_to_float(const struct sr_datafeed_analog *analog,
 	 * Do most internal calculations on double precision values.
 	 * Only trim the result data to single precision, since that's
 	 * the routine's result data type in its public API which needs
-	 * to be kept for compatibility. It remains an option for later
-	 * to add another public routine which returns double precision
-	 * result data, call sites could migrate at their own pace.
+	 * to be kept for compatibility. Call sites which need double
+	 * precision results can migrate to sr_analog_to_double().
 	 */
-	if (input_float && input_unitsize == sizeof(float)) {
-		float (*reader)(const uint8_t **p);
-		if (input_bigendian)
-			reader = read_fltbe_inc;
-		else
-			reader = read_fltle_inc;
-		while (count--) {
-			value = reader(&data8);
-			value *= scale;
-			value += offset;
-			*outbuf++ = value;
-		}
-		return SR_OK;
-	}
 	if (input_float && input_unitsize == sizeof(double)) {
 		double (*reader)(const uint8_t **p);
 		if (input_bigendian)
@@ -292,28 +467,6 @@ SR_API int sr_analog_to_float(const struct sr_datafeed_analog *analog,
 		return SR_ERR;
 	}
 
-	if (input_unitsize == sizeof(uint8_t) && input_signed) {
-		int8_t (*reader)(const uint8_t **p);
-		reader = read_i8_inc;
-		while (count--) {
-			value = reader(&data8);
-			value *= scale;
-			value += offset;
-			*outbuf++ = value;
-		}
-		return SR_OK;
-	}
-	if (input_unitsize == sizeof(uint8_t)) {
-		uint8_t (*reader)(const uint8_t **p);
-		reader = read_u8_inc;
-		while (count--) {
-			value = reader(&data8);
-			value *= scale;
-			value += offset;
-			*outbuf++ = value;
-		}
-		return SR_OK;
-	}
 	if (input_unitsize == sizeof(uint16_t) && input_signed) {
 		int16_t (*reader)(const uint8_t **p);
 		if (input_bigendian)
@@ -378,6 +531,202 @@ SR_API int sr_analog_to_float(const struct sr_datafeed_analog *analog,
 	return SR_ERR;
 }
 
+/**
+ * Convert an analog datafeed payload to an array of floats, using the
+ * vector conversion of its encoding where there is one.
+ *
+ * Works like sr_analog_to_float(), but converts the common 8 and 16 bit
+ * integer and the single precision float encodings with the vector
+ * kernels. The packet, including its encoding, is not modified.
+ *
+ * @param[in] analog The analog payload to convert. Must not be NULL.
+ *                   analog->data, analog->meaning, and analog->encoding
+ *                   must not be NULL.
+ * @param[out] outbuf Memory where to store the result. Must not be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR Unsupported encoding.
+ * @retval SR_ERR_ARG Invalid argument.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_analog_to_float_prepared(const struct sr_datafeed_analog *analog,
+		float *outbuf)
+{
+	const struct sr_analog_encoding *encoding;
+	int conversion;
+	double scale, offset;
+	size_t count;
+
+	if (!analog || !analog->data || !analog->meaning || !analog->encoding)
+		return SR_ERR_ARG;
+	if (!outbuf)
+		return SR_ERR_ARG;
+
+	if (analog_is_strided(analog))
+		return sr_analog_to_float(analog, outbuf);
+
+	encoding = analog->encoding;
+	conversion = analog_conversion(encoding);
+	if (conversion < SR_SIMD_I8)
+		return sr_analog_to_float(analog, outbuf);
+
+	count = analog->num_samples * g_slist_length(analog->meaning->channels);
+	offset = encoding->offset.p;
+	offset /= encoding->offset.q;
+	scale = encoding->scale.p;
+	scale /= encoding->scale.q;
+	sr_simd_to_float(conversion, analog->data, outbuf, count,
+		scale, offset);
+
+	return SR_OK;
+}
+
+/* Readers of one sample value of each format, as a double. */
+static double read_i8_dbl(const uint8_t **p) { return read_i8_inc(p); }
+static double read_u8_dbl(const uint8_t **p) { return read_u8_inc(p); }
+static double read_i16le_dbl(const uint8_t **p) { return read_i16le_inc(p); }
+static double read_i16be_dbl(const uint8_t **p) { return read_i16be_inc(p); }
+static double read_u16le_dbl(const uint8_t **p) { return read_u16le_inc(p); }
+static double read_u16be_dbl(const uint8_t **p) { return read_u16be_inc(p); }
+static double read_i32le_dbl(const uint8_t **p) { return read_i32le_inc(p); }
+static double read_i32be_dbl(const uint8_t **p) { return read_i32be_inc(p); }
+static double read_u32le_dbl(const uint8_t **p) { return read_u32le_inc(p); }
+static double read_u32be_dbl(const uint8_t **p) { return read_u32be_inc(p); }
+static double read_fltle_dbl(const uint8_t **p) { return read_fltle_inc(p); }
+static double read_fltbe_dbl(const uint8_t **p) { return read_fltbe_inc(p); }
+
+/**
+ * Convert an analog datafeed payload to an array of doubles.
+ *
+ * Like sr_analog_to_float(), but keeps the full precision of 32 bit
+ * integer and double precision samples.
+ *
+ * @param[in] analog The analog payload to convert. Must not be NULL.
+ *                   analog->data, analog->meaning, and analog->encoding
+ *                   must not be NULL.
+ * @param[out] outbuf Memory where to store the result. Must not be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR Unsupported encoding.
+ * @retval SR_ERR_ARG Invalid argument.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_analog_to_double(const struct sr_datafeed_analog *analog,
+		double *outbuf)
+{
+	const struct sr_analog_encoding *encoding;
+	double (*reader)(const uint8_t **p);
+	double scale, offset;
+	const uint8_t *data8;
+	gboolean be;
+	size_t count;
+
+	if (!analog || !analog->data || !analog->meaning || !analog->encoding)
+		return SR_ERR_ARG;
+	if (!outbuf)
+		return SR_ERR_ARG;
+
+	if (analog_is_strided(analog))
+		return analog_convert_packed(analog, analog_to_double_cb, outbuf);
+
+	encoding = analog->encoding;
+	be = encoding->is_bigendian;
+	reader = NULL;
+	if (encoding->is_float) {
+		if (encoding->unitsize == sizeof(float))
+			reader = be ? read_fltbe_dbl : read_fltle_dbl;
+		else if (encoding->unitsize == sizeof(double))
+			reader = be ? read_dblbe_inc : read_dblle_inc;
+	} else if (encoding->is_signed) {
+		if (encoding->unitsize == sizeof(int8_t))
+			reader = read_i8_dbl;
+		else if (encoding->unitsize == sizeof(int16_t))
+			reader = be ? read_i16be_dbl : read_i16le_dbl;
+		else if (encoding->unitsize == sizeof(int32_t))
+			reader = be ? read_i32be_dbl : read_i32le_dbl;
+	} else {
+		if (encoding->unitsize == sizeof(uint8_t))
+			reader = read_u8_dbl;
+		else if (encoding->unitsize == sizeof(uint16_t))
+			reader = be ? read_u16be_dbl : read_u16le_dbl;
+		else if (encoding->unitsize == sizeof(uint32_t))
+			reader = be ? read_u32be_dbl : read_u32le_dbl;
+	}
+	if (!reader) {
+		sr_err("Unsupported type for analog-to-double conversion: "
+			"%c%d%s.", encoding->is_float ? 'f' :
+			encoding->is_signed ? 'i' : 'u', encoding->unitsize * 8,
+			be ? "be" : "le");
+		return SR_ERR;
+	}
+
+	count = analog->num_samples * g_slist_length(analog->meaning->channels);
+	offset = encoding->offset.p;
+	offset /= encoding->offset.q;
+	scale = encoding->scale.p;
+	scale /= encoding->scale.q;
+	data8 = analog->data;
+	while (count--)
+		*outbuf++ = reader(&data8) * scale + offset;
+
+	return SR_OK;
+}
+
+/**
+ * Get the samples of an analog datafeed payload without converting them.
+ *
+ * This avoids the conversion and the larger buffer for consumers which
+ * can work on the samples in their native format, as described by
+ * analog->encoding. The value of a sample is raw * scale + offset.
+ *
+ * @param[in] analog The analog payload. Must not be NULL.
+ * @param[out] data The samples, valid as long as the payload is.
+ *                  Must not be NULL.
+ * @param[out] count The number of samples. Must not be NULL.
+ * @param[out] scale The scale of the samples. Can be NULL.
+ * @param[out] offset The offset of the samples. Can be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR The samples are not in the host's byte order, or not
+ *                packed and interleaved.
+ * @retval SR_ERR_ARG Invalid argument.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_analog_get_raw(const struct sr_datafeed_analog *analog,
+		const void **data, size_t *count, struct sr_rational *scale,
+		struct sr_rational *offset)
+{
+	gboolean host_bigendian;
+
+	if (!analog || !analog->data || !analog->meaning || !analog->encoding)
+		return SR_ERR_ARG;
+	if (!data || !count)
+		return SR_ERR_ARG;
+
+#ifdef WORDS_BIGENDIAN
+	host_bigendian = TRUE;
+#else
+	host_bigendian = FALSE;
+#endif
+	if (analog->encoding->unitsize > 1
+			&& analog->encoding->is_bigendian != host_bigendian)
+		return SR_ERR;
+	if (analog_is_strided(analog))
+		return SR_ERR;
+
+	*data = analog->data;
+	*count = analog->num_samples * g_slist_length(analog->meaning->channels);
+	if (scale)
+		*scale = analog->encoding->scale;
+	if (offset)
+		*offset = analog->encoding->offset;
+
+	return SR_OK;
+}
+
 /**
  * Scale a float value to the appropriate SI prefix.
  *
@@ -498,6 +847,87 @@ SR_API int sr_analog_unit_to_string(const struct sr_datafeed_analog *analog,
 	return SR_OK;
 }
 
+/**
+ * Format the values of an analog datafeed payload as text.
+ *
+ * Appends one line per value to out, in the same order as the values:
+ * "<channel name>: <value> <SI prefix><unit>". Each value is scaled to
+ * its own SI prefix (if the unit accepts one) as sr_analog_si_prefix()
+ * does, and shown with the given number of digits adjusted to it. The
+ * unit string and the prefix limits are worked out once for all the
+ * values, and nothing is allocated per value.
+ *
+ * @param[in] analog The analog payload the values belong to. Must not
+ *                   be NULL.
+ * @param[in] values The values of the payload, as converted by
+ *                   sr_analog_to_float(). Must not be NULL.
+ * @param[in] digits The number of significant decimal digits.
+ * @param[out] out The string to append to. Must not be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_analog_format_values(const struct sr_datafeed_analog *analog,
+		const float *values, int digits, GString *out)
+{
+	static const char *prefixes[] = { "f", "p", "n", "µ", "m", "", "k", "M", "G", "T" };
+	/* The factors scaling values to each of the prefixes. */
+	static const float factors[] = { 1e15, 1e12, 1e9, 1e6, 1e3, 1,
+		1e-3, 1e-6, 1e-9, 1e-12 };
+	const int neg_count = 5, pos_count = ARRAY_SIZE(prefixes) - 5 - 1;
+	const struct sr_channel *ch;
+	gboolean si_friendly;
+	char unit[64];
+	float value, logval;
+	int i, prefix, min_prefix;
+	uint32_t n;
+	GSList *l;
+
+	if (!analog || !analog->meaning || !values || !out)
+		return SR_ERR_ARG;
+
+	/* The unit and MQ flags are the same for all values. */
+	unit[0] = '\0';
+	for (i = 0; unit_strings[i].value; i++) {
+		if (analog->meaning->unit == unit_strings[i].value) {
+			g_strlcpy(unit, unit_strings[i].str, sizeof(unit));
+			break;
+		}
+	}
+	for (i = 0; mq_strings[i].value; i++)
+		if (analog->meaning->mqflags & mq_strings[i].value)
+			g_strlcat(unit, mq_strings[i].str, sizeof(unit));
+	si_friendly = sr_analog_si_prefix_friendly(analog->meaning->unit);
+
+	/* Smallest prefix which keeps the significant digits. */
+	min_prefix = (-digits + 2 * (digits < 0)) / 3;
+	min_prefix = CLAMP(min_prefix, -neg_count, pos_count);
+
+	for (n = 0; n < analog->num_samples; n++) {
+		for (l = analog->meaning->channels; l; l = l->next) {
+			ch = l->data;
+			value = *values++;
+			prefix = 0;
+			if (si_friendly && !isnan(value)) {
+				logval = log10f(fabsf(value));
+				prefix = (logval / 3) - (logval < 1);
+				prefix = MAX(prefix, -neg_count);
+				if (3 * prefix < -digits)
+					prefix = min_prefix;
+				prefix = MIN(prefix, pos_count);
+				value *= factors[prefix + neg_count];
+			}
+			g_string_append_printf(out, "%s: %.*f %s%s\n", ch->name,
+				MAX(digits + 3 * prefix, 0), value,
+				prefixes[prefix + neg_count], unit);
+		}
+	}
+
+	return SR_OK;
+}
+
 /**
  * Set sr_rational r to the given value.
  *
@@ -516,7 +946,30 @@ SR_API void sr_rational_set(struct sr_rational *r, int64_t p, uint64_t q)
 	r->q = q;
 }
 
-#ifndef HAVE___INT128_T
+/*
+ * Whether the products of the parts of two such values fit 64 bits,
+ * which is the case for the usual power of ten scales, so that the
+ * wider multiplication can be skipped.
+ */
+static inline gboolean rational_is_small(const struct sr_rational *r)
+{
+	return r->p >= -INT32_MAX && r->p <= INT32_MAX && r->q <= UINT32_MAX;
+}
+
+#ifdef HAVE___INT128_T
+static __uint128_t gcd_uint128(__uint128_t a, __uint128_t b)
+{
+	__uint128_t t;
+
+	while (b) {
+		t = a % b;
+		a = b;
+		b = t;
+	}
+
+	return a;
+}
+#else
 struct sr_int128_t {
 	int64_t high;
 	uint64_t low;
@@ -578,6 +1031,15 @@ SR_API int sr_rational_eq(const struct sr_rational *a, const struct sr_rational
 {
 #ifdef HAVE___INT128_T
 	__int128_t m1, m2;
+#else
+	struct sr_int128_t m1, m2;
+#endif
+
+	/* Same denominator, e.g. both from a unit or the same scale. */
+	if (a->q == b->q && a->q)
+		return a->p == b->p;
+
+#ifdef HAVE___INT128_T
 
 	/* p1/q1 = p2/q2  <=>  p1*q2 = p2*q1 */
 	m1 = ((__int128_t)(b->p)) * ((__uint128_t)a->q);
@@ -586,8 +1048,6 @@ SR_API int sr_rational_eq(const struct sr_rational *a, const struct sr_rational
 	return (m1 == m2);
 
 #else
-	struct sr_int128_t m1, m2;
-
 	mult_int64(&m1, a->q, b->p);
 	mult_int64(&m2, a->p, b->q);
 
@@ -618,22 +1078,32 @@ SR_API int sr_rational_mult(struct sr_rational *res, const struct sr_rational *a
 {
 #ifdef HAVE___INT128_T
 	__int128_t p;
-	__uint128_t q;
+	__uint128_t q, g;
+#else
+	struct sr_int128_t p;
+	struct sr_uint128_t q;
+#endif
 
+	if (rational_is_small(a) && rational_is_small(b)) {
+		res->p = a->p * b->p;
+		res->q = a->q * b->q;
+		return SR_OK;
+	}
+
+#ifdef HAVE___INT128_T
 	p = (__int128_t)(a->p) * (__int128_t)(b->p);
 	q = (__uint128_t)(a->q) * (__uint128_t)(b->q);
 
 	if ((p > INT64_MAX) || (p < INT64_MIN) || (q > UINT64_MAX)) {
-		while (!((p & 1) || (q & 1))) {
-			p /= 2;
-			q /= 2;
+		g = gcd_uint128((p < 0) ? -(__uint128_t)p : (__uint128_t)p, q);
+		if (g > 1) {
+			p /= (__int128_t)g;
+			q /= g;
 		}
 	}
 
-	if ((p > INT64_MAX) || (p < INT64_MIN) || (q > UINT64_MAX)) {
-		// TODO: determine gcd to do further reduction
+	if ((p > INT64_MAX) || (p < INT64_MIN) || (q > UINT64_MAX))
 		return SR_ERR_ARG;
-	}
 
 	res->p = (int64_t)p;
 	res->q = (uint64_t)q;
@@ -641,9 +1111,6 @@ SR_API int sr_rational_mult(struct sr_rational *res, const struct sr_rational *a
 	return SR_OK;
 
 #else
-	struct sr_int128_t p;
-	struct sr_uint128_t q;
-
 	mult_int64(&p, a->p, b->p);
 	mult_uint64(&q, a->q, b->q);
 
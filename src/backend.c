@@ -529,11 +529,57 @@ static int sanity_check_all_transform_modules(void)
 	return ret;
 }
 
+/*
+ * The module tables are fixed at build time, so checking them on every
+ * start only costs short-lived frontends. Check when debugging, or when
+ * asked to by the SIGROK_SANITY_CHECKS environment variable, which the
+ * test suite sets.
+ */
+static gboolean sanity_checks_wanted(void)
+{
+	const char *env;
+
+	if (sr_log_loglevel_get() >= SR_LOG_DBG)
+		return TRUE;
+	env = g_getenv("SIGROK_SANITY_CHECKS");
+
+	return env && g_strcmp0(env, "0") != 0;
+}
+
+static int sanity_check_all(const struct sr_context *ctx)
+{
+	if (sanity_check_all_drivers(ctx) < 0) {
+		sr_err("Internal driver error(s), aborting.");
+		return SR_ERR;
+	}
+
+	if (sanity_check_all_input_modules() < 0) {
+		sr_err("Internal input module error(s), aborting.");
+		return SR_ERR;
+	}
+
+	if (sanity_check_all_output_modules() < 0) {
+		sr_err("Internal output module error(s), aborting.");
+		return SR_ERR;
+	}
+
+	if (sanity_check_all_transform_modules() < 0) {
+		sr_err("Internal transform module error(s), aborting.");
+		return SR_ERR;
+	}
+
+	return SR_OK;
+}
+
 /**
  * Initialize libsigrok.
  *
  * This function must be called before any other libsigrok function.
  *
+ * The internal consistency checks of all drivers and modules only run
+ * at a log level of SR_LOG_DBG or above, or when the environment
+ * variable SIGROK_SANITY_CHECKS is set to a value other than "0".
+ *
  * @param ctx Pointer to a libsigrok context struct pointer. Must not be NULL.
  *            This will be a pointer to a newly allocated libsigrok context
  *            object upon success, and is undefined upon errors.
@@ -549,13 +595,17 @@ SR_API int sr_init(struct sr_context **ctx)
 {
 	int ret = SR_ERR;
 	struct sr_context *context;
+	gint64 start, checked;
 #ifdef _WIN32
 	WSADATA wsadata;
 #endif
 
-	print_versions();
+	start = g_get_monotonic_time();
 
-	print_resourcepaths();
+	if (sr_log_loglevel_get() >= SR_LOG_DBG) {
+		print_versions();
+		print_resourcepaths();
+	}
 
 	if (!ctx) {
 		sr_err("%s(): libsigrok context was NULL.", __func__);
@@ -566,24 +616,12 @@ SR_API int sr_init(struct sr_context **ctx)
 
 	sr_drivers_init(context);
 
-	if (sanity_check_all_drivers(context) < 0) {
-		sr_err("Internal driver error(s), aborting.");
-		goto done;
-	}
-
-	if (sanity_check_all_input_modules() < 0) {
-		sr_err("Internal input module error(s), aborting.");
-		goto done;
-	}
-
-	if (sanity_check_all_output_modules() < 0) {
-		sr_err("Internal output module error(s), aborting.");
-		goto done;
-	}
-
-	if (sanity_check_all_transform_modules() < 0) {
-		sr_err("Internal transform module error(s), aborting.");
-		goto done;
+	if (sanity_checks_wanted()) {
+		checked = g_get_monotonic_time();
+		if (sanity_check_all(context) != SR_OK)
+			goto done;
+		sr_spew("Sanity checks took %" G_GINT64_FORMAT " us.",
+			g_get_monotonic_time() - checked);
 	}
 
 #ifdef _WIN32
@@ -601,6 +639,7 @@ SR_API int sr_init(struct sr_context **ctx)
 		ret = SR_ERR;
 		goto done;
 	}
+	sr_usb_hotplug_init(context);
 #endif
 #ifdef HAVE_LIBHIDAPI
 	/*
@@ -617,6 +656,10 @@ SR_API int sr_init(struct sr_context **ctx)
 	}
 #endif
 	sr_resource_set_hooks(context, NULL, NULL, NULL, NULL);
+	sr_resource_cache_init(context);
+
+	sr_dbg("Initialization took %" G_GINT64_FORMAT " us.",
+		g_get_monotonic_time() - start);
 
 	*ctx = context;
 	context = NULL;
@@ -654,13 +697,74 @@ SR_API int sr_exit(struct sr_context *ctx)
 	hid_exit();
 #endif
 #ifdef HAVE_LIBUSB_1_0
+	sr_usb_hotplug_cleanup(ctx);
 	libusb_exit(ctx->libusb_ctx);
 #endif
 
+	sr_resource_cache_cleanup(ctx);
+	std_gvar_cache_clear();
 	g_free(sr_driver_list(ctx));
 	g_free(ctx);
 
 	return SR_OK;
 }
 
+/**
+ * Subscribe to USB device arrival and removal events.
+ *
+ * The callback runs from a libsigrok thread for every USB device that
+ * gets attached or detached while it is registered, so applications
+ * can rescan only when something changed instead of polling.
+ *
+ * @param ctx libsigrok context.
+ * @param cb Function to call on every event.
+ * @param cb_data Opaque pointer passed to the callback.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval SR_ERR_NA No USB hotplug support on this platform or build.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_hotplug_callback_add(struct sr_context *ctx,
+		sr_hotplug_callback cb, void *cb_data)
+{
+	if (!ctx || !cb)
+		return SR_ERR_ARG;
+
+#ifdef HAVE_LIBUSB_1_0
+	return sr_usb_hotplug_callback_add(ctx, cb, cb_data);
+#else
+	(void)cb_data;
+	return SR_ERR_NA;
+#endif
+}
+
+/**
+ * Unsubscribe from USB device arrival and removal events.
+ *
+ * @param ctx libsigrok context.
+ * @param cb Function passed to sr_hotplug_callback_add().
+ * @param cb_data Opaque pointer passed to sr_hotplug_callback_add().
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument, or no such subscription.
+ * @retval SR_ERR_NA No USB hotplug support on this platform or build.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_hotplug_callback_remove(struct sr_context *ctx,
+		sr_hotplug_callback cb, void *cb_data)
+{
+	if (!ctx || !cb)
+		return SR_ERR_ARG;
+
+#ifdef HAVE_LIBUSB_1_0
+	return sr_usb_hotplug_callback_remove(ctx, cb, cb_data);
+#else
+	(void)cb_data;
+	return SR_ERR_NA;
+#endif
+}
+
 /** @} */
@@ -96,6 +96,19 @@
 #define CONNECT_RFCOMM_TRIES	3
 #define CONNECT_RFCOMM_RETRY_MS	100
 
+/*
+ * Ask for an ATT MTU which fits a data length extended link layer packet,
+ * notifications then carry up to 244 instead of 20 payload bytes. Peers
+ * which don't support the exchange keep the default of 23.
+ */
+#define BLE_ATT_MTU_DEFAULT	23
+#define BLE_ATT_MTU_WANT	247
+#define BLE_MTU_EXCHANGE_MS	1000
+/* Supervision timeout for requested connection intervals, in 10ms units. */
+#define BLE_SUPERVISION_TIMEOUT	200
+/* Most messages to process per sr_bt_check_notify() call. */
+#define BLE_NOTIFY_BATCH	32
+
 /* Silence warning about (currently) unused routine. */
 #define WITH_WRITE_TYPE_HANDLE	0
 
@@ -239,9 +252,13 @@ struct sr_bt_desc {
 	uint16_t write_handle;
 	uint16_t cccd_handle;
 	uint16_t cccd_value;
+	uint16_t att_mtu_want;
+	uint16_t conn_interval_min;
+	uint16_t conn_interval_max;
 	/* Internal state. */
 	int devid;
 	int fd;
+	uint16_t att_mtu;
 	struct hci_filter orig_filter;
 };
 
@@ -268,6 +285,8 @@ SR_PRIV struct sr_bt_desc *sr_bt_desc_new(void)
 
 	desc->devid = -1;
 	desc->fd = -1;
+	desc->att_mtu_want = BLE_ATT_MTU_WANT;
+	desc->att_mtu = BLE_ATT_MTU_DEFAULT;
 
 	return desc;
 }
@@ -379,6 +398,51 @@ SR_PRIV int sr_bt_config_notify(struct sr_bt_desc *desc,
 	return 0;
 }
 
+/*
+ * The ATT MTU to negotiate when notifications get started, 0 skips the
+ * exchange. The peer's MTU may be smaller, sr_bt_get_mtu() tells.
+ */
+SR_PRIV int sr_bt_config_mtu(struct sr_bt_desc *desc, uint16_t mtu)
+{
+	if (!desc)
+		return -1;
+	if (mtu && mtu < BLE_ATT_MTU_DEFAULT)
+		return -1;
+
+	desc->att_mtu_want = mtu;
+
+	return 0;
+}
+
+SR_PRIV uint16_t sr_bt_get_mtu(struct sr_bt_desc *desc)
+{
+	if (!desc)
+		return 0;
+
+	return desc->att_mtu;
+}
+
+/*
+ * The BLE connection interval to request after connecting, in units of
+ * 1.25ms (6 to 3200), 0 keeps what the controller picks. Shorter intervals
+ * mean more connection events per second, and more notifications.
+ */
+SR_PRIV int sr_bt_config_conn_interval(struct sr_bt_desc *desc,
+	uint16_t interval_min, uint16_t interval_max)
+{
+	if (!desc)
+		return -1;
+	if (interval_min > interval_max)
+		return -1;
+	if (interval_max && (interval_min < 6 || interval_max > 3200))
+		return -1;
+
+	desc->conn_interval_min = interval_min;
+	desc->conn_interval_max = interval_max;
+
+	return 0;
+}
+
 static int sr_bt_desc_open(struct sr_bt_desc *desc, int *id_ref)
 {
 	int id, sock;
@@ -657,6 +721,49 @@ SR_PRIV int sr_bt_scan_bt(struct sr_bt_desc *desc, int duration)
 /* }}} scan */
 /* {{{ connect/disconnect */
 
+/*
+ * Request the configured connection interval. This needs access to the
+ * HCI device (CAP_NET_ADMIN), and the peer may reject the parameters.
+ * Neither is fatal, the connection just keeps its interval then.
+ */
+static void sr_bt_conn_update(struct sr_bt_desc *desc)
+{
+	struct l2cap_conninfo info;
+	socklen_t len;
+	bdaddr_t mac;
+	int id, dd, ret;
+
+	if (!desc->conn_interval_max)
+		return;
+
+	len = sizeof(info);
+	ret = getsockopt(desc->fd, SOL_L2CAP, L2CAP_CONNINFO, &info, &len);
+	if (ret < 0) {
+		sr_dbg("Cannot get the connection handle: %s.", g_strerror(errno));
+		return;
+	}
+	if (desc->local_addr[0]) {
+		id = hci_devid(desc->local_addr);
+	} else {
+		str2ba(desc->remote_addr, &mac);
+		id = hci_get_route(&mac);
+	}
+	dd = (id < 0) ? -1 : hci_open_dev(id);
+	if (dd < 0) {
+		sr_dbg("Cannot open the HCI device: %s.", g_strerror(errno));
+		return;
+	}
+	ret = hci_le_conn_update(dd, htobs(info.hci_handle),
+		desc->conn_interval_min, desc->conn_interval_max,
+		0, BLE_SUPERVISION_TIMEOUT, 1000);
+	if (ret < 0)
+		sr_dbg("Connection interval update failed: %s.", g_strerror(errno));
+	else
+		sr_dbg("Requested connection interval %u..%u (x1.25ms).",
+			desc->conn_interval_min, desc->conn_interval_max);
+	hci_close_dev(dd);
+}
+
 SR_PRIV int sr_bt_connect_ble(struct sr_bt_desc *desc)
 {
 	struct sockaddr_l2 sl2;
@@ -669,6 +776,7 @@ SR_PRIV int sr_bt_connect_ble(struct sr_bt_desc *desc)
 	if (!desc->remote_addr[0])
 		return -1;
 	sr_dbg("BLE connect, remote addr %s", desc->remote_addr);
+	desc->att_mtu = BLE_ATT_MTU_DEFAULT;
 
 	s = socket(AF_BLUETOOTH, SOCK_SEQPACKET, 0);
 	if (s < 0) {
@@ -774,16 +882,14 @@ SR_PRIV int sr_bt_connect_ble(struct sr_bt_desc *desc)
 			return soerror;
 		}
 
-		/*
-		 * TODO Get the receive MTU here?
-		 * getsockopt(SOL_BLUETOOTH, BT_RCVMTU, u16);
-		 */
 	}
 	if (ret < 0) {
 		perror("connect");
 		return ret;
 	}
 
+	sr_bt_conn_update(desc);
+
 	return 0;
 }
 
@@ -878,6 +984,50 @@ static int sr_bt_check_socket_usable(struct sr_bt_desc *desc)
 /* }}} connect/disconnect */
 /* {{{ indication/notification */
 
+/*
+ * Negotiate the ATT MTU. ATT allows one outstanding request, so wait for
+ * the response before the CCCD gets written. Peers which don't respond
+ * in time keep the default MTU, their late response gets ignored.
+ */
+static int sr_bt_exchange_mtu(struct sr_bt_desc *desc)
+{
+	uint8_t buf[1 + sizeof(uint16_t)], rxbuf[1024];
+	ssize_t wrlen, rdlen;
+	gint64 deadline;
+
+	buf[0] = BLE_ATT_EXCHANGE_MTU_REQ;
+	write_u16le(&buf[1], desc->att_mtu_want);
+	wrlen = write(desc->fd, buf, sizeof(buf));
+	if (wrlen != sizeof(buf))
+		return -2;
+
+	deadline = g_get_monotonic_time() + BLE_MTU_EXCHANGE_MS * 1000;
+	while (g_get_monotonic_time() < deadline) {
+		rdlen = sr_bt_read(desc, rxbuf, sizeof(rxbuf));
+		if (rdlen < 0)
+			return -2;
+		if (!rdlen) {
+			g_usleep(10 * 1000);
+			continue;
+		}
+		if (rxbuf[0] == BLE_ATT_EXCHANGE_MTU_RESP && rdlen >= 3) {
+			desc->att_mtu = MIN(desc->att_mtu_want,
+				bt_get_le16(&rxbuf[1]));
+			desc->att_mtu = MAX(desc->att_mtu, BLE_ATT_MTU_DEFAULT);
+			sr_dbg("BLE ATT MTU %u.", desc->att_mtu);
+			return 0;
+		}
+		if (rxbuf[0] == BLE_ATT_ERROR_RESP && rdlen >= 2 &&
+				rxbuf[1] == BLE_ATT_EXCHANGE_MTU_REQ) {
+			sr_dbg("BLE peer does not exchange the ATT MTU.");
+			return 0;
+		}
+	}
+	sr_dbg("BLE ATT MTU exchange timed out.");
+
+	return 0;
+}
+
 SR_PRIV int sr_bt_start_notify(struct sr_bt_desc *desc)
 {
 	uint8_t buf[sizeof(desc->cccd_value)];
@@ -890,6 +1040,11 @@ SR_PRIV int sr_bt_start_notify(struct sr_bt_desc *desc)
 	if (sr_bt_check_socket_usable(desc) < 0)
 		return -2;
 
+	if (desc->att_mtu_want > BLE_ATT_MTU_DEFAULT) {
+		if (sr_bt_exchange_mtu(desc) < 0)
+			return -2;
+	}
+
 	write_u16le(buf, desc->cccd_value);
 	wrlen = sr_bt_char_write_req(desc, desc->cccd_handle, buf, sizeof(buf));
 	if (wrlen != sizeof(buf))
@@ -898,27 +1053,20 @@ SR_PRIV int sr_bt_start_notify(struct sr_bt_desc *desc)
 	return 0;
 }
 
-SR_PRIV int sr_bt_check_notify(struct sr_bt_desc *desc)
+/*
+ * Process one message from the Bluetooth socket. Returns 1 when payload
+ * data was passed to the data callback, 0 for other messages, or negative
+ * upon errors.
+ */
+static int sr_bt_handle_message(struct sr_bt_desc *desc,
+	uint8_t *buf, ssize_t rdlen)
 {
-	uint8_t buf[1024];
-	ssize_t rdlen;
 	uint8_t packet_type;
 	uint16_t packet_handle;
 	uint8_t *packet_data;
 	size_t packet_dlen;
-
-	if (!desc)
-		return -1;
-
-	if (sr_bt_check_socket_usable(desc) < 0)
-		return -2;
-
-	/* Get another message from the Bluetooth socket. */
-	rdlen = sr_bt_read(desc, buf, sizeof(buf));
-	if (rdlen < 0)
-		return -2;
-	if (!rdlen)
-		return 0;
+	uint8_t resp[1 + sizeof(uint16_t)];
+	int ret;
 
 	/* Get header fields and references to the payload data. */
 	packet_type = 0x00;
@@ -943,25 +1091,34 @@ SR_PRIV int sr_bt_check_notify(struct sr_bt_desc *desc)
 		sr_spew("read() len %zd, type 0x%02x (%s)", rdlen, buf[0], "write response");
 		/* EMPTY */
 		break;
+	case BLE_ATT_EXCHANGE_MTU_REQ:
+		sr_spew("read() len %zd, type 0x%02x (%s)", rdlen, buf[0], "exchange MTU request");
+		resp[0] = BLE_ATT_EXCHANGE_MTU_RESP;
+		write_u16le(&resp[1], MAX(desc->att_mtu_want, BLE_ATT_MTU_DEFAULT));
+		if (write(desc->fd, resp, sizeof(resp)) != sizeof(resp))
+			return -2;
+		break;
+	case BLE_ATT_EXCHANGE_MTU_RESP:
+		sr_spew("read() len %zd, type 0x%02x (%s)", rdlen, buf[0], "late exchange MTU response");
+		/* EMPTY */
+		break;
 	case BLE_ATT_HANDLE_INDICATION:
 		sr_spew("read() len %zd, type 0x%02x (%s)", rdlen, buf[0], "handle indication");
 		sr_bt_write_type(desc, BLE_ATT_HANDLE_CONFIRMATION);
-		if (packet_handle != desc->read_handle)
-			return -4;
-		if (!packet_data)
-			return -4;
-		if (!desc->data_cb)
-			return 0;
-		return desc->data_cb(desc->data_cb_data, packet_data, packet_dlen);
+		/* FALLTHROUGH */
 	case BLE_ATT_HANDLE_NOTIFICATION:
-		sr_spew("read() len %zd, type 0x%02x (%s)", rdlen, buf[0], "handle notification");
+		if (packet_type == BLE_ATT_HANDLE_NOTIFICATION)
+			sr_spew("read() len %zd, type 0x%02x (%s)", rdlen, buf[0], "handle notification");
 		if (packet_handle != desc->read_handle)
 			return -4;
 		if (!packet_data)
 			return -4;
 		if (!desc->data_cb)
 			return 0;
-		return desc->data_cb(desc->data_cb_data, packet_data, packet_dlen);
+		ret = desc->data_cb(desc->data_cb_data, packet_data, packet_dlen);
+		if (ret < 0)
+			return ret;
+		return 1;
 	default:
 		sr_spew("unsupported type 0x%02x", packet_type);
 		return -3;
@@ -970,6 +1127,41 @@ SR_PRIV int sr_bt_check_notify(struct sr_bt_desc *desc)
 	return 0;
 }
 
+/*
+ * Process the messages which are pending on the Bluetooth socket, up to
+ * a batch size per call. Returns the number of notifications/indications
+ * which were passed to the data callback, or negative upon errors.
+ */
+SR_PRIV int sr_bt_check_notify(struct sr_bt_desc *desc)
+{
+	uint8_t buf[1024];
+	ssize_t rdlen;
+	size_t count;
+	int ret, delivered;
+
+	if (!desc)
+		return -1;
+
+	if (sr_bt_check_socket_usable(desc) < 0)
+		return -2;
+
+	delivered = 0;
+	for (count = 0; count < BLE_NOTIFY_BATCH; count++) {
+		/* Get another message from the Bluetooth socket. */
+		rdlen = sr_bt_read(desc, buf, sizeof(buf));
+		if (rdlen < 0)
+			return -2;
+		if (!rdlen)
+			break;
+		ret = sr_bt_handle_message(desc, buf, rdlen);
+		if (ret < 0)
+			return ret;
+		delivered += ret;
+	}
+
+	return delivered;
+}
+
 /* }}} indication/notification */
 /* {{{ read/write */
 
@@ -0,0 +1,476 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Needed for MAP_ANONYMOUS and madvise(). */
+#define _DEFAULT_SOURCE
+
+#include <config.h>
+#include <stdint.h>
+#include <string.h>
+#include <glib.h>
+#if defined(HAVE_SYS_MMAN_H) && !defined(_WIN32)
+#include <sys/mman.h>
+#define HAVE_MAPPED_BUFFERS 1
+#endif
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+/** @cond PRIVATE */
+#define LOG_PREFIX "buffer"
+/** @endcond */
+
+/**
+ * @file
+ *
+ * Allocation of large sample buffers, and memory accounting.
+ */
+
+/**
+ * @defgroup grp_buffer Sample buffers
+ *
+ * Allocation of large sample buffers, and memory accounting.
+ *
+ * @{
+ */
+
+/* Alignment of all buffers, for SIMD loads. */
+#define BUFFER_ALIGN 64
+/* Buffers from this size on can be backed by huge pages. */
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+/* A buffer from the application's allocator, or memory mapped. */
+struct mapping {
+	size_t size;
+	size_t used;
+	int kind;
+	sr_buffer_free_callback free_cb;
+	void *cb_data;
+};
+
+/* In front of heap buffers. */
+struct heap_header {
+	void *mem;
+	size_t size;
+	int kind;
+};
+
+#define MEM_KINDS (SR_MEM_TRANSFERS - SR_MEM_PACKETS + 1)
+
+static int hugepages = SR_HUGEPAGES_NONE;
+static sr_buffer_alloc_callback app_alloc_cb;
+static sr_buffer_free_callback app_free_cb;
+static void *app_cb_data;
+
+/* Buffers which aren't on the heap, keyed by their address. */
+static GMutex mappings_mutex;
+static GHashTable *mappings;
+
+/* Memory in use by subsystem, and the budget for all of it. */
+static GMutex mem_mutex;
+static struct sr_mem_stats mem_stats[MEM_KINDS];
+static uint64_t mem_total;
+static uint64_t mem_budget;
+
+/**
+ * Select whether large sample buffers are backed by huge pages.
+ *
+ * Huge pages reduce the TLB misses of code which runs through buffers
+ * of many megabytes, e.g. the pre-trigger buffer of the soft trigger,
+ * session file output, and USB transfer buffers. Buffers of 2 MiB and
+ * more are affected.
+ *
+ * With SR_HUGEPAGES_TRANSPARENT, buffers are aligned to huge pages and
+ * marked for transparent huge pages, which the kernel provides as far
+ * as it can. With SR_HUGEPAGES_EXPLICIT, buffers are taken from the
+ * reserved huge pages of the system (see vm.nr_hugepages), with a
+ * fallback to transparent huge pages. Huge pages are only supported
+ * on Linux, elsewhere, the buffers are allocated from the heap.
+ *
+ * The setting applies to buffers allocated afterwards.
+ *
+ * @param mode The enum sr_hugepages value to use.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid mode.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_buffer_hugepages_set(int mode)
+{
+	if (mode != SR_HUGEPAGES_NONE && mode != SR_HUGEPAGES_TRANSPARENT
+			&& mode != SR_HUGEPAGES_EXPLICIT) {
+		sr_err("%s: invalid mode %d", __func__, mode);
+		return SR_ERR_ARG;
+	}
+
+	g_atomic_int_set(&hugepages, mode);
+
+	return SR_OK;
+}
+
+/**
+ * Have the application allocate the library's sample buffers.
+ *
+ * This allows for allocators of the application's own, e.g. for memory
+ * of a specific NUMA node, or locked memory. The allocator must return
+ * memory aligned to at least 64 bytes, or NULL upon failure. Buffers
+ * allocated before keep going to the routine which allocated them.
+ * The callbacks can be called from any thread.
+ *
+ * @param alloc_cb The routine which allocates buffers, NULL for the
+ *                 library's own allocator.
+ * @param free_cb The routine which frees buffers, NULL for the
+ *                library's own allocator.
+ * @param cb_data Opaque pointer passed to the callbacks.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Only one of the callbacks is NULL.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_buffer_allocator_set(sr_buffer_alloc_callback alloc_cb,
+		sr_buffer_free_callback free_cb, void *cb_data)
+{
+	if (!alloc_cb != !free_cb) {
+		sr_err("%s: need both or none of the callbacks", __func__);
+		return SR_ERR_ARG;
+	}
+
+	g_mutex_lock(&mappings_mutex);
+	app_alloc_cb = alloc_cb;
+	app_free_cb = free_cb;
+	app_cb_data = cb_data;
+	g_mutex_unlock(&mappings_mutex);
+
+	return SR_OK;
+}
+
+/**
+ * Select the budget of memory the library may use.
+ *
+ * The memory of packet copies, pre-trigger buffers, output module
+ * buffers and USB transfer buffers is accounted, see sr_mem_stats_get().
+ * While more than the budget is in use, asynchronous datafeed dispatch
+ * (see sr_session_dispatch_async_set()) stops queueing packets: The
+ * sender waits until the consumer thread caught up, or with the
+ * SR_DISPATCH_DROP policy, sample packets are dropped. This keeps slow
+ * consumers such as file output from piling up packet copies.
+ *
+ * @param bytes The budget in bytes, 0 for no budget.
+ *
+ * @retval SR_OK Success.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_mem_budget_set(uint64_t bytes)
+{
+	g_mutex_lock(&mem_mutex);
+	mem_budget = bytes;
+	g_mutex_unlock(&mem_mutex);
+
+	return SR_OK;
+}
+
+/**
+ * Get the memory use of one of the library's subsystems.
+ *
+ * @param kind The enum sr_mem_kind value of the subsystem.
+ * @param stats Pointer to store the counters. Must not be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_mem_stats_get(int kind, struct sr_mem_stats *stats)
+{
+	if (kind < SR_MEM_PACKETS || kind > SR_MEM_TRANSFERS || !stats)
+		return SR_ERR_ARG;
+
+	g_mutex_lock(&mem_mutex);
+	*stats = mem_stats[kind - SR_MEM_PACKETS];
+	g_mutex_unlock(&mem_mutex);
+
+	return SR_OK;
+}
+
+/**
+ * Account memory which a subsystem allocated or released.
+ *
+ * @param kind The enum sr_mem_kind value of the subsystem.
+ * @param size The number of bytes.
+ * @param alloc TRUE for an allocation, FALSE for a release.
+ *
+ * @private
+ */
+SR_PRIV void sr_mem_account(int kind, size_t size, gboolean alloc)
+{
+	struct sr_mem_stats *st;
+
+	if (kind < SR_MEM_PACKETS || kind > SR_MEM_TRANSFERS)
+		return;
+
+	st = &mem_stats[kind - SR_MEM_PACKETS];
+	g_mutex_lock(&mem_mutex);
+	if (alloc) {
+		st->bytes += size;
+		st->allocations++;
+		if (st->bytes > st->peak)
+			st->peak = st->bytes;
+		mem_total += size;
+	} else {
+		st->bytes -= MIN(size, st->bytes);
+		mem_total -= MIN(size, mem_total);
+	}
+	g_mutex_unlock(&mem_mutex);
+}
+
+/**
+ * Check whether more memory than the budget is in use.
+ *
+ * @return TRUE if a budget is set and exceeded, FALSE otherwise.
+ *
+ * @private
+ */
+SR_PRIV gboolean sr_mem_over_budget(void)
+{
+	gboolean over;
+
+	g_mutex_lock(&mem_mutex);
+	over = mem_budget && mem_total > mem_budget;
+	g_mutex_unlock(&mem_mutex);
+
+	return over;
+}
+
+static void mapping_add(void *buf, size_t size, size_t used, int kind,
+		sr_buffer_free_callback free_cb, void *cb_data)
+{
+	struct mapping *m;
+
+	m = g_malloc(sizeof(*m));
+	m->size = size;
+	m->used = used;
+	m->kind = kind;
+	m->free_cb = free_cb;
+	m->cb_data = cb_data;
+	g_mutex_lock(&mappings_mutex);
+	if (!mappings)
+		mappings = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+			NULL, g_free);
+	g_hash_table_insert(mappings, buf, m);
+	g_mutex_unlock(&mappings_mutex);
+}
+
+static void *heap_alloc(size_t size, int kind)
+{
+	struct heap_header *hdr;
+	uint8_t *mem, *buf;
+
+	mem = g_try_malloc(size + sizeof(*hdr) + BUFFER_ALIGN - 1);
+	if (!mem)
+		return NULL;
+	buf = mem + sizeof(*hdr);
+	buf += (BUFFER_ALIGN - (uintptr_t)buf % BUFFER_ALIGN) % BUFFER_ALIGN;
+	hdr = (struct heap_header *)buf - 1;
+	hdr->mem = mem;
+	hdr->size = size;
+	hdr->kind = kind;
+
+	return buf;
+}
+
+#ifdef HAVE_MAPPED_BUFFERS
+static void *map_explicit(size_t size)
+{
+#ifdef MAP_HUGETLB
+	void *buf;
+
+	buf = mmap(NULL, size, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+	if (buf != MAP_FAILED)
+		return buf;
+	sr_dbg("No reserved huge pages for %zu bytes.", size);
+#else
+	(void)size;
+#endif
+
+	return NULL;
+}
+
+/* Map more than needed, to keep only the part at huge page alignment. */
+static void *map_transparent(size_t size)
+{
+	uint8_t *mem, *buf;
+	size_t head;
+
+	mem = mmap(NULL, size + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (mem == MAP_FAILED)
+		return NULL;
+	head = (HUGE_PAGE_SIZE - (uintptr_t)mem % HUGE_PAGE_SIZE) % HUGE_PAGE_SIZE;
+	buf = mem + head;
+	if (head)
+		munmap(mem, head);
+	munmap(buf + size, HUGE_PAGE_SIZE - head);
+#ifdef MADV_HUGEPAGE
+	madvise(buf, size, MADV_HUGEPAGE);
+#endif
+
+	return buf;
+}
+
+/* Memory mapped buffers are zeroed. */
+static void *map_alloc(size_t size, int mode, size_t *mapped_size)
+{
+	void *buf;
+
+	*mapped_size = (size + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+	buf = NULL;
+	if (mode == SR_HUGEPAGES_EXPLICIT)
+		buf = map_explicit(*mapped_size);
+	if (!buf)
+		buf = map_transparent(*mapped_size);
+
+	return buf;
+}
+#endif
+
+static void *buffer_alloc(int kind, size_t size, gboolean zero)
+{
+	sr_buffer_alloc_callback alloc_cb;
+	sr_buffer_free_callback free_cb;
+	void *buf, *cb_data;
+#ifdef HAVE_MAPPED_BUFFERS
+	size_t mapped_size;
+	int mode;
+#endif
+
+	if (!size)
+		return NULL;
+
+	g_mutex_lock(&mappings_mutex);
+	alloc_cb = app_alloc_cb;
+	free_cb = app_free_cb;
+	cb_data = app_cb_data;
+	g_mutex_unlock(&mappings_mutex);
+	if (alloc_cb) {
+		if (!(buf = alloc_cb(size, cb_data)))
+			return NULL;
+		mapping_add(buf, size, size, kind, free_cb, cb_data);
+		sr_mem_account(kind, size, TRUE);
+		if (zero)
+			memset(buf, 0, size);
+		return buf;
+	}
+
+#ifdef HAVE_MAPPED_BUFFERS
+	mode = g_atomic_int_get(&hugepages);
+	if (mode != SR_HUGEPAGES_NONE && size >= HUGE_PAGE_SIZE) {
+		buf = map_alloc(size, mode, &mapped_size);
+		if (buf) {
+			mapping_add(buf, mapped_size, size, kind, NULL, NULL);
+			sr_mem_account(kind, size, TRUE);
+			return buf;
+		}
+	}
+#endif
+
+	if (!(buf = heap_alloc(size, kind)))
+		return NULL;
+	sr_mem_account(kind, size, TRUE);
+	if (zero)
+		memset(buf, 0, size);
+
+	return buf;
+}
+
+/**
+ * Allocate a sample buffer.
+ *
+ * The buffer is aligned to 64 bytes, and can be backed by huge pages,
+ * see sr_buffer_hugepages_set(), or come from the application's own
+ * allocator, see sr_buffer_allocator_set().
+ *
+ * @param kind The enum sr_mem_kind value of the subsystem which uses
+ *             the buffer, for sr_mem_stats_get().
+ * @param size The size of the buffer in bytes.
+ *
+ * @return The buffer, NULL upon failure or for a size of 0. Free it
+ *         with sr_buffer_free().
+ *
+ * @private
+ */
+SR_PRIV void *sr_buffer_alloc(int kind, size_t size)
+{
+	return buffer_alloc(kind, size, FALSE);
+}
+
+/**
+ * Allocate a sample buffer like sr_buffer_alloc(), filled with zeros.
+ *
+ * @param kind The enum sr_mem_kind value of the subsystem.
+ * @param size The size of the buffer in bytes.
+ *
+ * @return The buffer, NULL upon failure or for a size of 0.
+ *
+ * @private
+ */
+SR_PRIV void *sr_buffer_alloc0(int kind, size_t size)
+{
+	return buffer_alloc(kind, size, TRUE);
+}
+
+/**
+ * Free a sample buffer.
+ *
+ * @param buf The buffer from sr_buffer_alloc() or sr_buffer_alloc0().
+ *            Can be NULL.
+ *
+ * @private
+ */
+SR_PRIV void sr_buffer_free(void *buf)
+{
+	struct heap_header *hdr;
+	struct mapping *m;
+
+	if (!buf)
+		return;
+
+	g_mutex_lock(&mappings_mutex);
+	m = mappings ? g_hash_table_lookup(mappings, buf) : NULL;
+	if (m)
+		g_hash_table_steal(mappings, buf);
+	g_mutex_unlock(&mappings_mutex);
+
+	if (!m) {
+		hdr = (struct heap_header *)buf - 1;
+		sr_mem_account(hdr->kind, hdr->size, FALSE);
+		g_free(hdr->mem);
+		return;
+	}
+	sr_mem_account(m->kind, m->used, FALSE);
+	if (m->free_cb)
+		m->free_cb(buf, m->size, m->cb_data);
+#ifdef HAVE_MAPPED_BUFFERS
+	else
+		munmap(buf, m->size);
+#endif
+	g_free(m);
+}
+
+/** @} */
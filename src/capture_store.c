@@ -0,0 +1,749 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <float.h>
+#include <string.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+/** @cond PRIVATE */
+#define LOG_PREFIX "capture-store"
+/** @endcond */
+
+/**
+ * @file
+ *
+ * Compressed in-memory store of captured samples.
+ */
+
+/**
+ * @defgroup grp_capture_store Capture store
+ *
+ * Keep the samples of an acquisition in memory, compressed, with random
+ * access to ranges of samples.
+ *
+ * Logic samples are kept in blocks of a fixed number of samples. Each
+ * complete block is run length encoded, unless that would not make it
+ * smaller. Analog samples are kept as floats per channel, again in
+ * blocks, with the minimum and maximum of each block, so that summaries
+ * of long ranges don't need to visit every sample.
+ *
+ * @{
+ */
+
+/** @cond PRIVATE */
+/* Samples per block, a power of two. */
+#define BLOCK_SAMPLES (64 * 1024)
+/** @endcond */
+
+struct logic_block {
+	/* Run length encoded, or raw if rle is FALSE. */
+	uint8_t *data;
+	size_t size;
+	gboolean rle;
+};
+
+struct analog_block {
+	float *values;
+	float min;
+	float max;
+};
+
+struct analog_channel {
+	struct sr_channel *ch;
+	enum sr_mq mq;
+	enum sr_unit unit;
+	enum sr_mqflag mqflags;
+	int digits;
+	/* Complete blocks, then the one being filled. */
+	GPtrArray *blocks;
+	uint64_t num_samples;
+};
+
+struct sr_capture_store {
+	uint64_t samplerate;
+
+	uint16_t unitsize;
+	uint64_t logic_samples;
+	/* Complete blocks of struct logic_block. */
+	GArray *logic_blocks;
+	/* The block being filled, raw. */
+	uint8_t *logic_tail;
+	/* Most recently decoded block, for sequential reads. */
+	uint8_t *decoded;
+	guint decoded_index;
+	gboolean decoded_valid;
+
+	/* struct analog_channel, in order of their first sample. */
+	GSList *analog;
+	float *convbuf;
+	size_t convbuf_size;
+
+	uint64_t bytes;
+};
+
+/**
+ * Create an empty capture store.
+ *
+ * @return A new capture store. Free it with sr_capture_store_free().
+ *
+ * @since 0.6.0
+ */
+SR_API struct sr_capture_store *sr_capture_store_new(void)
+{
+	struct sr_capture_store *store;
+
+	store = g_malloc0(sizeof(*store));
+	store->logic_blocks = g_array_new(FALSE, FALSE,
+		sizeof(struct logic_block));
+
+	return store;
+}
+
+static void analog_channel_free(void *data)
+{
+	struct analog_channel *ac;
+
+	ac = data;
+	g_ptr_array_free(ac->blocks, TRUE);
+	g_free(ac);
+}
+
+static void analog_block_free(void *data)
+{
+	struct analog_block *block;
+
+	block = data;
+	g_free(block->values);
+	g_free(block);
+}
+
+/**
+ * Free a capture store, and all samples in it.
+ *
+ * @param store The store to free. Can be NULL.
+ *
+ * @since 0.6.0
+ */
+SR_API void sr_capture_store_free(struct sr_capture_store *store)
+{
+	guint i;
+
+	if (!store)
+		return;
+
+	for (i = 0; i < store->logic_blocks->len; i++)
+		g_free(g_array_index(store->logic_blocks,
+			struct logic_block, i).data);
+	g_array_free(store->logic_blocks, TRUE);
+	g_free(store->logic_tail);
+	g_free(store->decoded);
+	g_slist_free_full(store->analog, analog_channel_free);
+	g_free(store->convbuf);
+	g_free(store);
+}
+
+
+/*
+ * Each run is its length as LEB128, followed by the sample value.
+ * Returns 0 if the encoding would not be smaller than the input.
+ */
+static size_t rle_encode(const uint8_t *in, uint16_t unitsize,
+		uint64_t num_samples, uint8_t *out)
+{
+	const size_t limit = num_samples * unitsize;
+	uint64_t i, run, n;
+	size_t len;
+
+	len = 0;
+	for (i = 0; i < num_samples; i += run) {
+		run = 1;
+		while (i + run < num_samples && !memcmp(in + i * unitsize,
+				in + (i + run) * unitsize, unitsize))
+			run++;
+		if (len + 10 + unitsize >= limit)
+			return 0;
+		for (n = run; n >= 0x80; n >>= 7)
+			out[len++] = (n & 0x7f) | 0x80;
+		out[len++] = n;
+		memcpy(out + len, in + i * unitsize, unitsize);
+		len += unitsize;
+	}
+
+	return len;
+}
+
+static void rle_decode(const uint8_t *in, size_t size, uint16_t unitsize,
+		uint8_t *out)
+{
+	const uint8_t *end;
+	uint64_t run;
+	unsigned int shift;
+
+	end = in + size;
+	while (in < end) {
+		run = 0;
+		shift = 0;
+		do {
+			run |= (uint64_t)(*in & 0x7f) << shift;
+			shift += 7;
+		} while (*in++ & 0x80);
+		while (run--) {
+			memcpy(out, in, unitsize);
+			out += unitsize;
+		}
+		in += unitsize;
+	}
+}
+
+static void logic_block_close(struct sr_capture_store *store)
+{
+	struct logic_block block;
+	uint8_t *buf;
+	size_t size;
+
+	size = BLOCK_SAMPLES * store->unitsize;
+	buf = g_malloc(size);
+	block.size = rle_encode(store->logic_tail, store->unitsize,
+		BLOCK_SAMPLES, buf);
+	block.rle = block.size != 0;
+	if (block.rle) {
+		block.data = g_realloc(buf, block.size);
+	} else {
+		g_free(buf);
+		block.data = g_memdup(store->logic_tail, size);
+		block.size = size;
+	}
+	g_array_append_val(store->logic_blocks, block);
+	store->bytes += block.size;
+}
+
+static int logic_add(struct sr_capture_store *store,
+		const struct sr_datafeed_logic *logic)
+{
+	const uint8_t *data;
+	uint64_t num_samples, offset, n;
+
+	if (!logic->unitsize)
+		return SR_ERR_ARG;
+	if (!store->unitsize) {
+		store->unitsize = logic->unitsize;
+		store->logic_tail = g_malloc(BLOCK_SAMPLES * store->unitsize);
+	} else if (logic->unitsize != store->unitsize) {
+		sr_err("Logic unitsize changed during the capture.");
+		return SR_ERR_DATA;
+	}
+
+	data = logic->data;
+	num_samples = logic->length / logic->unitsize;
+	while (num_samples) {
+		offset = store->logic_samples % BLOCK_SAMPLES;
+		n = MIN(num_samples, BLOCK_SAMPLES - offset);
+		memcpy(store->logic_tail + offset * store->unitsize, data,
+			n * store->unitsize);
+		data += n * store->unitsize;
+		num_samples -= n;
+		store->logic_samples += n;
+		if (offset + n == BLOCK_SAMPLES)
+			logic_block_close(store);
+	}
+
+	return SR_OK;
+}
+
+static struct analog_channel *analog_channel_get(struct sr_capture_store *store,
+		struct sr_channel *ch)
+{
+	GSList *l;
+	struct analog_channel *ac;
+
+	for (l = store->analog; l; l = l->next) {
+		ac = l->data;
+		if (ac->ch == ch)
+			return ac;
+	}
+
+	return NULL;
+}
+
+static void analog_channel_append(struct sr_capture_store *store,
+		struct analog_channel *ac, const float *values, size_t stride,
+		uint64_t count)
+{
+	struct analog_block *block;
+	uint64_t offset, i;
+	float v;
+
+	for (i = 0; i < count; i++) {
+		offset = ac->num_samples % BLOCK_SAMPLES;
+		if (!offset) {
+			block = g_malloc(sizeof(*block));
+			block->values = g_malloc_n(BLOCK_SAMPLES, sizeof(float));
+			block->min = FLT_MAX;
+			block->max = -FLT_MAX;
+			g_ptr_array_add(ac->blocks, block);
+			store->bytes += BLOCK_SAMPLES * sizeof(float);
+		} else {
+			block = g_ptr_array_index(ac->blocks, ac->blocks->len - 1);
+		}
+		v = values[i * stride];
+		block->values[offset] = v;
+		block->min = MIN(block->min, v);
+		block->max = MAX(block->max, v);
+		ac->num_samples++;
+	}
+}
+
+static int analog_add(struct sr_capture_store *store,
+		const struct sr_datafeed_analog *analog)
+{
+	struct analog_channel *ac;
+	struct sr_channel *ch;
+	GSList *l;
+	size_t num_channels, c;
+
+	num_channels = g_slist_length(analog->meaning->channels);
+	if (!num_channels || !analog->num_samples)
+		return SR_OK;
+
+	if (store->convbuf_size < analog->num_samples * num_channels) {
+		g_free(store->convbuf);
+		store->convbuf_size = analog->num_samples * num_channels;
+		store->convbuf = g_malloc_n(store->convbuf_size, sizeof(float));
+	}
+	if (sr_analog_to_float_prepared(analog, store->convbuf) != SR_OK)
+		return SR_ERR_DATA;
+
+	for (l = analog->meaning->channels, c = 0; l; l = l->next, c++) {
+		ch = l->data;
+		if (!(ac = analog_channel_get(store, ch))) {
+			ac = g_malloc0(sizeof(*ac));
+			ac->ch = ch;
+			ac->mq = analog->meaning->mq;
+			ac->unit = analog->meaning->unit;
+			ac->mqflags = analog->meaning->mqflags;
+			ac->digits = analog->encoding->digits;
+			ac->blocks = g_ptr_array_new_with_free_func(analog_block_free);
+			store->analog = g_slist_append(store->analog, ac);
+		}
+		analog_channel_append(store, ac, store->convbuf + c,
+			num_channels, analog->num_samples);
+	}
+
+	return SR_OK;
+}
+
+/**
+ * Add a datafeed packet to a capture store.
+ *
+ * Pass every packet of an acquisition, e.g. from a datafeed callback.
+ * Logic and analog samples are stored, the samplerate is taken from
+ * SR_DF_META packets. Other packets are ignored.
+ *
+ * @param store The store to add to. Must not be NULL.
+ * @param packet The packet to add. Must not be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval SR_ERR_DATA The unitsize of logic samples changed, or analog
+ *                     samples could not be converted.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_capture_store_add(struct sr_capture_store *store,
+		const struct sr_datafeed_packet *packet)
+{
+	const struct sr_datafeed_meta *meta;
+	const struct sr_config *src;
+	GSList *l;
+
+	if (!store || !packet)
+		return SR_ERR_ARG;
+
+	switch (packet->type) {
+	case SR_DF_LOGIC:
+		return logic_add(store, packet->payload);
+	case SR_DF_ANALOG:
+		return analog_add(store, packet->payload);
+	case SR_DF_META:
+		meta = packet->payload;
+		for (l = meta->config; l; l = l->next) {
+			src = l->data;
+			if (src->key == SR_CONF_SAMPLERATE)
+				store->samplerate = g_variant_get_uint64(src->data);
+		}
+		break;
+	default:
+		break;
+	}
+
+	return SR_OK;
+}
+
+/**
+ * Get the number of logic samples in a capture store.
+ *
+ * @param store The store. Must not be NULL.
+ * @param unitsize Pointer to store the size of a logic sample in bytes,
+ *                 0 while no logic samples were added. Can be NULL.
+ *
+ * @return The number of logic samples.
+ *
+ * @since 0.6.0
+ */
+SR_API uint64_t sr_capture_store_logic_samples(const struct sr_capture_store *store,
+		uint16_t *unitsize)
+{
+	if (!store)
+		return 0;
+	if (unitsize)
+		*unitsize = store->unitsize;
+
+	return store->logic_samples;
+}
+
+/**
+ * Get the number of analog samples of a channel in a capture store.
+ *
+ * @param store The store. Must not be NULL.
+ * @param ch The analog channel.
+ *
+ * @return The number of the channel's samples.
+ *
+ * @since 0.6.0
+ */
+SR_API uint64_t sr_capture_store_analog_samples(struct sr_capture_store *store,
+		struct sr_channel *ch)
+{
+	struct analog_channel *ac;
+
+	if (!store || !(ac = analog_channel_get(store, ch)))
+		return 0;
+
+	return ac->num_samples;
+}
+
+/**
+ * Get the memory used by the samples in a capture store.
+ *
+ * @param store The store. Must not be NULL.
+ *
+ * @return The number of bytes used by complete blocks and partial ones.
+ *
+ * @since 0.6.0
+ */
+SR_API uint64_t sr_capture_store_size(const struct sr_capture_store *store)
+{
+	if (!store)
+		return 0;
+
+	return store->bytes + (store->unitsize ?
+		BLOCK_SAMPLES * store->unitsize : 0);
+}
+
+/* Get the raw samples of a logic block, decoding it if necessary. */
+static const uint8_t *logic_block_data(struct sr_capture_store *store,
+		guint index)
+{
+	struct logic_block *block;
+
+	if (index == store->logic_blocks->len)
+		return store->logic_tail;
+
+	block = &g_array_index(store->logic_blocks, struct logic_block, index);
+	if (!block->rle)
+		return block->data;
+
+	if (!store->decoded_valid || store->decoded_index != index) {
+		if (!store->decoded)
+			store->decoded = g_malloc(BLOCK_SAMPLES * store->unitsize);
+		rle_decode(block->data, block->size, store->unitsize,
+			store->decoded);
+		store->decoded_index = index;
+		store->decoded_valid = TRUE;
+	}
+
+	return store->decoded;
+}
+
+/**
+ * Read a range of logic samples from a capture store.
+ *
+ * @param store The store to read from. Must not be NULL.
+ * @param start Index of the first sample to read.
+ * @param count Number of samples to read.
+ * @param buf Buffer for count samples of the store's unitsize.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument, or the range exceeds the samples
+ *                    in the store.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_capture_store_logic_read(struct sr_capture_store *store,
+		uint64_t start, uint64_t count, uint8_t *buf)
+{
+	const uint8_t *src;
+	uint64_t offset, n;
+
+	if (!store || !buf || start > store->logic_samples ||
+			count > store->logic_samples - start)
+		return SR_ERR_ARG;
+
+	while (count) {
+		offset = start % BLOCK_SAMPLES;
+		n = MIN(count, BLOCK_SAMPLES - offset);
+		src = logic_block_data(store, start / BLOCK_SAMPLES);
+		memcpy(buf, src + offset * store->unitsize, n * store->unitsize);
+		buf += n * store->unitsize;
+		start += n;
+		count -= n;
+	}
+
+	return SR_OK;
+}
+
+/**
+ * Read a range of analog samples of a channel from a capture store.
+ *
+ * @param store The store to read from. Must not be NULL.
+ * @param ch The analog channel.
+ * @param start Index of the first sample to read.
+ * @param count Number of samples to read.
+ * @param buf Buffer for count values.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument, or the range exceeds the samples
+ *                    of the channel in the store.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_capture_store_analog_read(struct sr_capture_store *store,
+		struct sr_channel *ch, uint64_t start, uint64_t count, float *buf)
+{
+	struct analog_channel *ac;
+	struct analog_block *block;
+	uint64_t offset, n;
+
+	if (!store || !buf || !(ac = analog_channel_get(store, ch)))
+		return SR_ERR_ARG;
+	if (start > ac->num_samples || count > ac->num_samples - start)
+		return SR_ERR_ARG;
+
+	while (count) {
+		offset = start % BLOCK_SAMPLES;
+		n = MIN(count, BLOCK_SAMPLES - offset);
+		block = g_ptr_array_index(ac->blocks, start / BLOCK_SAMPLES);
+		memcpy(buf, block->values + offset, n * sizeof(float));
+		buf += n;
+		start += n;
+		count -= n;
+	}
+
+	return SR_OK;
+}
+
+/**
+ * Get the minimum and maximum of a range of analog samples.
+ *
+ * Blocks which are completely within the range contribute their
+ * summary, so that only the samples at the range's ends are visited.
+ *
+ * @param store The store to read from. Must not be NULL.
+ * @param ch The analog channel.
+ * @param start Index of the first sample of the range.
+ * @param count Number of samples in the range, at least 1.
+ * @param min Pointer to store the smallest value. Must not be NULL.
+ * @param max Pointer to store the largest value. Must not be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument, or the range is empty or exceeds
+ *                    the samples of the channel in the store.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_capture_store_analog_minmax(struct sr_capture_store *store,
+		struct sr_channel *ch, uint64_t start, uint64_t count,
+		float *min, float *max)
+{
+	struct analog_channel *ac;
+	struct analog_block *block;
+	uint64_t offset, n, i;
+	float lo, hi;
+
+	if (!store || !min || !max || !(ac = analog_channel_get(store, ch)))
+		return SR_ERR_ARG;
+	if (!count || start > ac->num_samples || count > ac->num_samples - start)
+		return SR_ERR_ARG;
+
+	lo = FLT_MAX;
+	hi = -FLT_MAX;
+	while (count) {
+		offset = start % BLOCK_SAMPLES;
+		n = MIN(count, BLOCK_SAMPLES - offset);
+		block = g_ptr_array_index(ac->blocks, start / BLOCK_SAMPLES);
+		if (n == BLOCK_SAMPLES) {
+			lo = MIN(lo, block->min);
+			hi = MAX(hi, block->max);
+		} else {
+			for (i = offset; i < offset + n; i++) {
+				lo = MIN(lo, block->values[i]);
+				hi = MAX(hi, block->values[i]);
+			}
+		}
+		start += n;
+		count -= n;
+	}
+	*min = lo;
+	*max = hi;
+
+	return SR_OK;
+}
+
+static int save_packet(const struct sr_output *o,
+		const struct sr_datafeed_packet *packet)
+{
+	GString *out;
+	int ret;
+
+	out = NULL;
+	ret = sr_output_send(o, packet, &out);
+	if (out)
+		g_string_free(out, TRUE);
+
+	return ret;
+}
+
+static int save_analog_block(const struct sr_output *o,
+		const struct analog_channel *ac, guint index)
+{
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+	struct analog_block *block;
+	GSList channels;
+	int ret;
+
+	block = g_ptr_array_index(ac->blocks, index);
+	sr_analog_init(&analog, &encoding, &meaning, &spec, ac->digits);
+	channels.data = ac->ch;
+	channels.next = NULL;
+	meaning.mq = ac->mq;
+	meaning.unit = ac->unit;
+	meaning.mqflags = ac->mqflags;
+	meaning.channels = &channels;
+	analog.data = block->values;
+	analog.num_samples = MIN(BLOCK_SAMPLES,
+		ac->num_samples - (uint64_t)index * BLOCK_SAMPLES);
+	packet.type = SR_DF_ANALOG;
+	packet.payload = &analog;
+	ret = save_packet(o, &packet);
+
+	return ret;
+}
+
+/**
+ * Save the samples of a capture store to a session file.
+ *
+ * The samples are passed to the srzip output module block by block,
+ * without decompressing the whole capture first.
+ *
+ * @param store The store to save. Must not be NULL.
+ * @param sdi The device the samples were captured from, for its
+ *            channels. Must not be NULL.
+ * @param filename The name of the file to write. Must not be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval SR_ERR_NA The srzip output module is not available.
+ * @retval other Error writing the file.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_capture_store_save(struct sr_capture_store *store,
+		const struct sr_dev_inst *sdi, const char *filename)
+{
+	char id[] = "srzip";
+	const struct sr_output_module *omod;
+	const struct sr_output *o;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic logic;
+	struct sr_datafeed_meta meta;
+	struct sr_config samplerate;
+	struct analog_channel *ac;
+	GSList *l;
+	guint index, num_blocks;
+	int ret;
+
+	if (!store || !sdi || !filename)
+		return SR_ERR_ARG;
+	if (!(omod = sr_output_find(id)))
+		return SR_ERR_NA;
+	if (!(o = sr_output_new(omod, NULL, sdi, filename)))
+		return SR_ERR;
+
+	ret = SR_OK;
+	if (store->samplerate) {
+		samplerate.key = SR_CONF_SAMPLERATE;
+		samplerate.data = g_variant_new_uint64(store->samplerate);
+		meta.config = g_slist_append(NULL, &samplerate);
+		packet.type = SR_DF_META;
+		packet.payload = &meta;
+		ret = save_packet(o, &packet);
+		g_slist_free(meta.config);
+		g_variant_unref(samplerate.data);
+	}
+
+	num_blocks = (store->logic_samples + BLOCK_SAMPLES - 1) / BLOCK_SAMPLES;
+	for (index = 0; ret == SR_OK && index < num_blocks; index++) {
+		logic.unitsize = store->unitsize;
+		logic.length = MIN(BLOCK_SAMPLES, store->logic_samples -
+			(uint64_t)index * BLOCK_SAMPLES) * store->unitsize;
+		logic.data = (void *)logic_block_data(store, index);
+		packet.type = SR_DF_LOGIC;
+		packet.payload = &logic;
+		ret = save_packet(o, &packet);
+	}
+
+	/* Keep the channels' blocks in turns, like acquisitions send them. */
+	for (index = 0; ret == SR_OK; index++) {
+		num_blocks = 0;
+		for (l = store->analog; ret == SR_OK && l; l = l->next) {
+			ac = l->data;
+			if (index >= ac->blocks->len)
+				continue;
+			ret = save_analog_block(o, ac, index);
+			num_blocks++;
+		}
+		if (!num_blocks)
+			break;
+	}
+
+	if (ret == SR_OK) {
+		packet.type = SR_DF_END;
+		packet.payload = NULL;
+		ret = save_packet(o, &packet);
+	}
+	sr_output_free(o);
+
+	return ret;
+}
+
+/** @} */
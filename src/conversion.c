@@ -23,6 +23,7 @@
  * Conversion helper functions.
  */
 
+#include <string.h>
 #include <libsigrok/libsigrok.h>
 #include "libsigrok-internal.h"
 
@@ -55,8 +56,7 @@ SR_API int sr_a2l_threshold(const struct sr_datafeed_analog *analog,
 	} else
 		input = analog->data;
 
-	for (uint64_t i = 0; i < count; i++)
-		output[i] = (input[i] >= threshold) ? 1 : 0;
+	sr_simd_threshold(input, threshold, output, count);
 
 	if (!analog->encoding->is_float)
 		g_free(input);
@@ -93,17 +93,294 @@ SR_API int sr_a2l_schmitt_trigger(const struct sr_datafeed_analog *analog,
 	} else
 		input = analog->data;
 
-	for (uint64_t i = 0; i < count; i++) {
-		if (input[i] < lo_thr)
-			*state = 0;
-		else if (input[i] > hi_thr)
-			*state = 1;
-
-		output[i] = *state;
-	}
+	sr_simd_schmitt(input, lo_thr, hi_thr, state, output, count);
 
 	if (!analog->encoding->is_float)
 		g_free(input);
 
 	return SR_OK;
 }
+
+/**
+ * Convert the analog values of several channels to packed logic samples,
+ * using a fixed threshold per channel.
+ *
+ * @param[in] analog The analog input values, of one or more channels.
+ * @param[in] thresholds The threshold of each channel of the packet, in
+ *                       the order of analog->meaning->channels.
+ * @param[out] output The converted logic samples. Bit n of each sample
+ *                    is set when the value of the nth channel is at or
+ *                    above its threshold. Must provide space for count
+ *                    samples of (number of channels + 7) / 8 bytes.
+ * @param[in] count The number of samples to process.
+ *
+ * @return SR_OK on success or SR_ERR on failure.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_a2l_threshold_multi(const struct sr_datafeed_analog *analog,
+		const float *thresholds, uint8_t *output, uint64_t count)
+{
+	float *input;
+	size_t num_channels;
+
+	num_channels = g_slist_length(analog->meaning->channels);
+	input = g_try_malloc(sizeof(float) * count * num_channels);
+	if (!input)
+		return SR_ERR;
+	if (sr_analog_to_float_prepared(analog, input) != SR_OK) {
+		g_free(input);
+		return SR_ERR;
+	}
+
+	sr_simd_threshold_multi(input, thresholds, num_channels, output, count);
+	g_free(input);
+
+	return SR_OK;
+}
+
+struct sr_logic_edge_index {
+	uint64_t channel_mask;
+	/* Transition sample indices per channel, NULL if not in the mask. */
+	GArray *edges[64];
+	/* Value of the last sample, and the index of the next one. */
+	uint64_t last;
+	gboolean have_last;
+	uint64_t next_sample;
+};
+
+/**
+ * Create an index of the transitions of logic channels.
+ *
+ * Pass logic packets to sr_logic_edges_find() to fill the index. The
+ * index is incremental: it keeps the last sample of a packet, so that
+ * transitions at the start of the next packet are found, and counts
+ * sample indices from the first sample of the first packet.
+ *
+ * @param[in] channel_mask The channels to index. Bit n selects the
+ *                         channel at bit n of the logic samples.
+ *
+ * @return A new index, or NULL if channel_mask is 0. Free it with
+ *         sr_logic_edge_index_free().
+ *
+ * @since 0.6.0
+ */
+SR_API struct sr_logic_edge_index *sr_logic_edge_index_new(uint64_t channel_mask)
+{
+	struct sr_logic_edge_index *index;
+	unsigned int ch;
+
+	if (!channel_mask)
+		return NULL;
+
+	index = g_malloc0(sizeof(*index));
+	index->channel_mask = channel_mask;
+	for (ch = 0; ch < 64; ch++) {
+		if (channel_mask & (UINT64_C(1) << ch))
+			index->edges[ch] = g_array_new(FALSE, FALSE, sizeof(uint64_t));
+	}
+
+	return index;
+}
+
+/**
+ * Free an index created by sr_logic_edge_index_new().
+ *
+ * @param[in] index The index to free. Can be NULL.
+ *
+ * @since 0.6.0
+ */
+SR_API void sr_logic_edge_index_free(struct sr_logic_edge_index *index)
+{
+	unsigned int ch;
+
+	if (!index)
+		return;
+
+	for (ch = 0; ch < 64; ch++) {
+		if (index->edges[ch])
+			g_array_free(index->edges[ch], TRUE);
+	}
+	g_free(index);
+}
+
+/**
+ * Drop the transitions collected so far.
+ *
+ * The position in the stream is kept, so that the index can be drained
+ * after each packet without losing track of transitions or indices.
+ *
+ * @param[in] index The index to clear. Must not be NULL.
+ *
+ * @since 0.6.0
+ */
+SR_API void sr_logic_edge_index_clear(struct sr_logic_edge_index *index)
+{
+	unsigned int ch;
+
+	if (!index)
+		return;
+
+	for (ch = 0; ch < 64; ch++) {
+		if (index->edges[ch])
+			g_array_set_size(index->edges[ch], 0);
+	}
+}
+
+static uint64_t read_sample(const uint8_t *p, uint16_t unitsize)
+{
+	uint64_t value;
+	uint16_t i;
+
+	value = 0;
+	for (i = 0; i < unitsize; i++)
+		value |= (uint64_t)p[i] << (8 * i);
+
+	return value;
+}
+
+static void edge_append(struct sr_logic_edge_index *index, unsigned int ch,
+		uint64_t sample)
+{
+	g_array_append_val(index->edges[ch], sample);
+}
+
+/* Compare one sample after the other, for any unitsize. */
+static void edges_find_samples(struct sr_logic_edge_index *index,
+		const uint8_t *data, uint16_t unitsize, uint64_t num_samples)
+{
+	uint64_t i, value, diff;
+
+	for (i = 0; i < num_samples; i++) {
+		value = read_sample(data + i * unitsize, unitsize);
+		diff = (value ^ index->last) & index->channel_mask;
+		while (diff) {
+			edge_append(index, __builtin_ctzll(diff),
+				index->next_sample + i);
+			diff &= diff - 1;
+		}
+		index->last = value;
+	}
+	index->next_sample += num_samples;
+}
+
+/*
+ * Compare the 64bit words of the samples with the words one sample
+ * earlier. The bits of the result are the transitions of the word's
+ * samples, in order of their sample and channel.
+ */
+static void edges_find_words(struct sr_logic_edge_index *index,
+		const uint8_t *data, uint16_t unitsize, uint64_t num_samples)
+{
+	const unsigned int per_word = 8 / unitsize;
+	const unsigned int bits = 8 * unitsize;
+	uint64_t mask, i, cur, prev, diff;
+	unsigned int j, bit;
+
+	mask = 0;
+	for (j = 0; j < per_word; j++)
+		mask |= (index->channel_mask & (bits == 64 ?
+			~UINT64_C(0) : (UINT64_C(1) << bits) - 1)) << (j * bits);
+
+	for (i = 0; i + per_word <= num_samples; i += per_word) {
+		cur = RL64(data + i * unitsize);
+		if (i)
+			prev = RL64(data + (i - 1) * unitsize);
+		else if (bits == 64)
+			prev = index->last;
+		else
+			prev = (cur << bits) | index->last;
+		diff = (cur ^ prev) & mask;
+		while (diff) {
+			bit = __builtin_ctzll(diff);
+			edge_append(index, bit % bits,
+				index->next_sample + i + bit / bits);
+			diff &= diff - 1;
+		}
+	}
+	if (i)
+		index->last = read_sample(data + (i - 1) * unitsize, unitsize);
+	index->next_sample += i;
+
+	edges_find_samples(index, data + i * unitsize, unitsize,
+		num_samples - i);
+}
+
+/**
+ * Add the transitions of a logic packet's samples to an index.
+ *
+ * The sample index of each transition of a channel in the index's mask
+ * is appended to the channel's list, see sr_logic_edge_index_get().
+ * Sample indices count from the first sample passed to the index.
+ * Samples are compared a 64bit word at a time, so runs without
+ * transitions take little time.
+ *
+ * @param[in] index The index to add to. Must not be NULL.
+ * @param[in] logic The logic data. Its unitsize must be 1 to 8 bytes,
+ *                  and remain the same across packets.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_logic_edges_find(struct sr_logic_edge_index *index,
+		const struct sr_datafeed_logic *logic)
+{
+	const uint8_t *data;
+	uint16_t unitsize;
+	uint64_t num_samples;
+
+	if (!index || !logic || !logic->unitsize || logic->unitsize > 8)
+		return SR_ERR_ARG;
+
+	data = logic->data;
+	unitsize = logic->unitsize;
+	num_samples = logic->length / unitsize;
+	if (!num_samples)
+		return SR_OK;
+
+	/* The first sample of the stream is no transition. */
+	if (!index->have_last) {
+		index->last = read_sample(data, unitsize);
+		index->have_last = TRUE;
+	}
+
+	if (8 % unitsize == 0)
+		edges_find_words(index, data, unitsize, num_samples);
+	else
+		edges_find_samples(index, data, unitsize, num_samples);
+
+	return SR_OK;
+}
+
+/**
+ * Get the transitions of a channel collected in an index.
+ *
+ * @param[in] index The index to get the transitions from. Must not be NULL.
+ * @param[in] channel The channel, its bit position in the logic samples.
+ * @param[out] samples Pointer to store the increasing sample indices of
+ *                     the channel's transitions. The array is owned by
+ *                     the index, and valid until the index changes.
+ * @param[out] count Pointer to store the number of transitions.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument, or channel not in the index's mask.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_logic_edge_index_get(const struct sr_logic_edge_index *index,
+		unsigned int channel, const uint64_t **samples, uint64_t *count)
+{
+	GArray *edges;
+
+	if (!index || channel >= 64 || !samples || !count)
+		return SR_ERR_ARG;
+	if (!(edges = index->edges[channel]))
+		return SR_ERR_ARG;
+
+	*samples = (const uint64_t *)edges->data;
+	*count = edges->len;
+
+	return SR_OK;
+}
@@ -71,6 +71,7 @@ SR_PRIV struct sr_channel *sr_channel_new(struct sr_dev_inst *sdi,
 		ch->name = g_strdup(name);
 
 	sdi->channels = g_slist_append(sdi->channels, ch);
+	sr_dev_channels_changed(sdi);
 
 	return ch;
 }
@@ -101,6 +102,94 @@ SR_PRIV void sr_channel_free_cb(void *p)
 	sr_channel_free(p);
 }
 
+static void channel_cache_free(struct sr_dev_channel_cache *cache)
+{
+	if (!cache)
+		return;
+	g_free(cache->logic);
+	g_free(cache->analog);
+	g_hash_table_destroy(cache->by_name);
+	g_free(cache);
+}
+
+/**
+ * Drop the channel lookup tables of a device instance.
+ *
+ * Must be called when channels get added, renamed, or enabled or
+ * disabled other than by sr_channel_new(), sr_dev_channel_name_set()
+ * and sr_dev_channel_enable(). Replacing the sdi->channels list is
+ * detected. Acquisition starts rebuild the tables, too.
+ *
+ * @param[in] sdi The device instance. Must not be NULL.
+ *
+ * @private
+ */
+SR_PRIV void sr_dev_channels_changed(const struct sr_dev_inst *sdi)
+{
+	struct sr_dev_inst *dev;
+
+	/* The tables are a cache, not part of the device's state. */
+	dev = (struct sr_dev_inst *)sdi;
+	channel_cache_free(dev->channel_cache);
+	dev->channel_cache = NULL;
+}
+
+/**
+ * Get the channel lookup tables of a device instance.
+ *
+ * The tables get built on first use and stay valid until the channels
+ * change, see sr_dev_channels_changed(). They spare acquisition starts
+ * and per-packet code walks of the channel list.
+ *
+ * @param[in] sdi The device instance. Must not be NULL.
+ *
+ * @return The tables, owned by the device instance.
+ *
+ * @private
+ */
+SR_PRIV const struct sr_dev_channel_cache *sr_dev_channel_cache_get(
+		const struct sr_dev_inst *sdi)
+{
+	struct sr_dev_inst *dev;
+	struct sr_dev_channel_cache *cache;
+	struct sr_channel *ch;
+	size_t count;
+	GSList *l;
+
+	dev = (struct sr_dev_inst *)sdi;
+	cache = dev->channel_cache;
+	if (cache && cache->channels == sdi->channels)
+		return cache;
+	channel_cache_free(cache);
+
+	cache = g_malloc0(sizeof(*cache));
+	cache->channels = sdi->channels;
+	count = g_slist_length(sdi->channels);
+	cache->logic = g_malloc0(count * sizeof(cache->logic[0]));
+	cache->analog = g_malloc0(count * sizeof(cache->analog[0]));
+	cache->by_name = g_hash_table_new(g_str_hash, g_str_equal);
+	for (l = sdi->channels; l; l = l->next) {
+		ch = l->data;
+		if (ch->type == SR_CHANNEL_LOGIC) {
+			cache->logic[cache->num_logic++] = ch;
+			if (ch->enabled)
+				cache->num_logic_enabled++;
+			if (ch->enabled && ch->index >= 0 && ch->index < 64)
+				cache->logic_enabled_mask |= UINT64_C(1) << ch->index;
+		} else if (ch->type == SR_CHANNEL_ANALOG) {
+			cache->analog[cache->num_analog++] = ch;
+		}
+		if (ch->enabled)
+			cache->num_enabled++;
+		/* Like a search of the list, the first channel of a name wins. */
+		if (ch->name && !g_hash_table_contains(cache->by_name, ch->name))
+			g_hash_table_insert(cache->by_name, ch->name, ch);
+	}
+	dev->channel_cache = cache;
+
+	return cache;
+}
+
 /**
  * Set the name of the specified channel.
  *
@@ -123,6 +212,8 @@ SR_API int sr_dev_channel_name_set(struct sr_channel *channel,
 
 	g_free(channel->name);
 	channel->name = g_strdup(name);
+	if (channel->sdi)
+		sr_dev_channels_changed(channel->sdi);
 
 	return SR_OK;
 }
@@ -151,6 +242,8 @@ SR_API int sr_dev_channel_enable(struct sr_channel *channel, gboolean state)
 	sdi = channel->sdi;
 	was_enabled = channel->enabled;
 	channel->enabled = state;
+	if (!state != !was_enabled)
+		sr_dev_channels_changed(sdi);
 	if (!state != !was_enabled && sdi->driver
 			&& sdi->driver->config_channel_set) {
 		ret = sdi->driver->config_channel_set(
@@ -468,6 +561,7 @@ SR_PRIV void sr_dev_inst_free(struct sr_dev_inst *sdi)
 		g_free(cg);
 	}
 	g_slist_free(sdi->channel_groups);
+	sr_dev_channels_changed(sdi);
 
 	if (sdi->session)
 		sr_session_dev_remove(sdi->session, sdi);
@@ -843,7 +937,7 @@ SR_API const char *sr_dev_inst_connid_get(const struct sr_dev_inst *sdi)
 		drvc = sdi->driver->context;
 		usb = sdi->conn;
 
-		if ((cnt = libusb_get_device_list(drvc->sr_ctx->libusb_ctx, &devlist)) < 0) {
+		if ((cnt = sr_usb_device_list(drvc->sr_ctx, &devlist)) < 0) {
 			sr_err("Failed to retrieve device list: %s.",
 			       libusb_error_name(cnt));
 			return NULL;
@@ -894,6 +988,25 @@ SR_API GSList *sr_dev_inst_channels_get(const struct sr_dev_inst *sdi)
 	return sdi->channels;
 }
 
+/**
+ * Find a channel of a device instance by its name.
+ *
+ * @param sdi Device instance to use. Must not be NULL.
+ * @param name The name of the channel. Must not be NULL.
+ *
+ * @return The channel, or NULL if the device has no such channel.
+ *
+ * @since 0.6.0
+ */
+SR_API struct sr_channel *sr_dev_inst_channel_by_name(
+		const struct sr_dev_inst *sdi, const char *name)
+{
+	if (!sdi || !name)
+		return NULL;
+
+	return g_hash_table_lookup(sr_dev_channel_cache_get(sdi)->by_name, name);
+}
+
 /**
  * Queries a device instances' channel groups list.
  *
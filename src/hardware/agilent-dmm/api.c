@@ -297,8 +297,8 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 	std_session_send_df_header(sdi);
 
 	serial = sdi->conn;
-	serial_source_add(sdi->session, serial, G_IO_IN, 10,
-			agdmm_receive_data, (void *)sdi);
+	serial_line_source_add(sdi->session, serial, 10,
+			agdmm_receive_line, agdmm_receive_data, (void *)sdi);
 
 	return SR_OK;
 }
@@ -116,7 +116,7 @@ static void dispatch(const struct sr_dev_inst *sdi)
 		job_run(sdi);
 }
 
-static gboolean receive_line(const struct sr_dev_inst *sdi)
+static gboolean receive_line(const struct sr_dev_inst *sdi, const char *line)
 {
 	struct dev_context *devc;
 	const struct agdmm_recv *recvs, *recv;
@@ -127,21 +127,13 @@ static gboolean receive_line(const struct sr_dev_inst *sdi)
 
 	devc = sdi->priv;
 
-	/* Strip CRLF */
-	while (devc->buflen) {
-		if (*(devc->buf + devc->buflen - 1) == '\r'
-				|| *(devc->buf + devc->buflen - 1) == '\n')
-			*(devc->buf + --devc->buflen) = '\0';
-		else
-			break;
-	}
-	sr_spew("Received '%s'.", devc->buf);
+	sr_spew("Received '%s'.", line);
 
 	recv = NULL;
 	recvs = devc->profile->recvs;
 	for (i = 0; (&recvs[i])->recv_regex; i++) {
 		reg = g_regex_new((&recvs[i])->recv_regex, 0, 0, NULL);
-		if (g_regex_match(reg, (char *)devc->buf, 0, &match)) {
+		if (g_regex_match(reg, line, 0, &match)) {
 			recv = &recvs[i];
 			break;
 		}
@@ -159,22 +151,34 @@ static gboolean receive_line(const struct sr_dev_inst *sdi)
 		g_match_info_unref(match);
 		g_regex_unref(reg);
 	} else
-		sr_dbg("Unknown line '%s'.", devc->buf);
+		sr_dbg("Unknown line '%s'.", line);
 
-	/* Done with this. */
-	devc->buflen = 0;
 	return stop;
 }
 
+/* Called by the serial line framer for every received line. */
+SR_PRIV void agdmm_receive_line(struct sr_serial_dev_inst *serial,
+	void *cb_data, const char *line, size_t len)
+{
+	struct sr_dev_inst *sdi;
+
+	(void)serial;
+	(void)len;
+
+	if (!(sdi = cb_data) || !sdi->priv)
+		return;
+
+	if (receive_line(sdi, line))
+		sr_dev_acquisition_stop(sdi);
+}
+
 SR_PRIV int agdmm_receive_data(int fd, int revents, void *cb_data)
 {
 	struct sr_dev_inst *sdi;
 	struct dev_context *devc;
-	struct sr_serial_dev_inst *serial;
-	gboolean stop = FALSE;
-	int len;
 
 	(void)fd;
+	(void)revents;
 
 	if (!(sdi = cb_data))
 		return TRUE;
@@ -182,24 +186,7 @@ SR_PRIV int agdmm_receive_data(int fd, int revents, void *cb_data)
 	if (!(devc = sdi->priv))
 		return TRUE;
 
-	serial = sdi->conn;
-	if (revents == G_IO_IN) {
-		/* Serial data arrived. */
-		while (AGDMM_BUFSIZE - devc->buflen - 1 > 0) {
-			len = serial_read_nonblocking(serial, devc->buf + devc->buflen, 1);
-			if (len < 1)
-				break;
-			devc->buflen += len;
-			*(devc->buf + devc->buflen) = '\0';
-			if (*(devc->buf + devc->buflen - 1) == '\n') {
-				/* End of line */
-				stop = receive_line(sdi);
-				break;
-			}
-		}
-	}
-
-	if (sr_sw_limits_check(&devc->limits) || stop)
+	if (sr_sw_limits_check(&devc->limits))
 		sr_dev_acquisition_stop(sdi);
 	else
 		dispatch(sdi);
@@ -23,7 +23,6 @@
 #define LOG_PREFIX "agilent-dmm"
 
 #define MAX_CHANNELS 3
-#define AGDMM_BUFSIZE 256
 
 /* Always USB-serial, 1ms is plenty. */
 #define SERIAL_WRITE_TIMEOUT_MS 1
@@ -83,8 +82,6 @@ struct dev_context {
 	gboolean job_running;
 	gboolean job_again;
 	int64_t jobs_start[8];
-	unsigned char buf[AGDMM_BUFSIZE];
-	int buflen;
 	uint64_t cur_samplerate;
 	struct sr_channel *cur_channel;
 	struct sr_channel *cur_conf;
@@ -121,6 +118,8 @@ struct agdmm_recv {
 	int (*recv) (const struct sr_dev_inst *sdi, GMatchInfo *match);
 };
 
+SR_PRIV void agdmm_receive_line(struct sr_serial_dev_inst *serial,
+	void *cb_data, const char *line, size_t len);
 SR_PRIV int agdmm_receive_data(int fd, int revents, void *cb_data);
 
 #endif
@@ -44,6 +44,7 @@ static const uint32_t drvopts[] = {
 static const uint32_t devopts[] = {
 	SR_CONF_LIMIT_MSEC | SR_CONF_GET | SR_CONF_SET,
 	SR_CONF_LIMIT_SAMPLES | SR_CONF_GET | SR_CONF_SET,
+	SR_CONF_LIMIT_FRAMES | SR_CONF_GET | SR_CONF_SET,
 	SR_CONF_CONN | SR_CONF_GET,
 	SR_CONF_SAMPLERATE | SR_CONF_GET | SR_CONF_SET | SR_CONF_LIST,
 	SR_CONF_EXTERNAL_CLOCK | SR_CONF_GET | SR_CONF_SET,
@@ -148,7 +149,7 @@ static GSList *scan(struct sr_dev_driver *di, GSList *options)
 
 	/* Find all ASIX logic analyzers (which match the connection spec). */
 	devices = NULL;
-	libusb_get_device_list(usbctx, &devlist);
+	sr_usb_device_list(drvc->sr_ctx, &devlist);
 	for (devidx = 0; devlist[devidx]; devidx++) {
 		devitem = devlist[devidx];
 
@@ -313,6 +314,7 @@ static int config_get(uint32_t key, GVariant **data,
 		break;
 	case SR_CONF_LIMIT_MSEC:
 	case SR_CONF_LIMIT_SAMPLES:
+	case SR_CONF_LIMIT_FRAMES:
 		return sr_sw_limits_config_get(&devc->limit.config, key, data);
 	case SR_CONF_CAPTURE_RATIO:
 		*data = g_variant_new_uint64(devc->capture_ratio);
@@ -370,6 +372,7 @@ static int config_set(uint32_t key, GVariant *data,
 		break;
 	case SR_CONF_LIMIT_MSEC:
 	case SR_CONF_LIMIT_SAMPLES:
+	case SR_CONF_LIMIT_FRAMES:
 		return sr_sw_limits_config_set(&devc->limit.config, key, data);
 	case SR_CONF_CAPTURE_RATIO:
 		devc->capture_ratio = g_variant_get_uint64(data);
@@ -413,14 +416,7 @@ static int config_list(uint32_t key, GVariant **data,
 static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 {
 	struct dev_context *devc;
-	uint16_t pindis_mask;
-	uint8_t async, div;
 	int ret;
-	size_t triggerpin;
-	uint8_t trigsel2;
-	struct triggerinout triggerinout_conf;
-	struct triggerlut lut;
-	uint8_t regval, cmd_bytes[4], *wrptr;
 
 	devc = sdi->priv;
 
@@ -453,142 +449,11 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 	if (ret != SR_OK)
 		return ret;
 
-	/* Enter trigger programming mode. */
-	trigsel2 = TRGSEL2_RESET;
-	ret = sigma_set_register(devc, WRITE_TRIGGER_SELECT2, trigsel2);
-	if (ret != SR_OK)
-		return ret;
-
-	trigsel2 = 0;
-	if (devc->clock.samplerate >= SR_MHZ(100)) {
-		/* 100 and 200 MHz mode. */
-		/* TODO Decipher the 0x81 magic number's purpose. */
-		ret = sigma_set_register(devc, WRITE_TRIGGER_SELECT2, 0x81);
-		if (ret != SR_OK)
-			return ret;
-
-		/* Find which pin to trigger on from mask. */
-		for (triggerpin = 0; triggerpin < 8; triggerpin++) {
-			if (devc->trigger.risingmask & BIT(triggerpin))
-				break;
-			if (devc->trigger.fallingmask & BIT(triggerpin))
-				break;
-		}
-
-		/* Set trigger pin and light LED on trigger. */
-		trigsel2 = triggerpin & TRGSEL2_PINS_MASK;
-		trigsel2 |= TRGSEL2_LEDSEL1;
-
-		/* Default rising edge. */
-		/* TODO Documentation disagrees, bit set means _rising_ edge. */
-		if (devc->trigger.fallingmask)
-			trigsel2 |= TRGSEL2_PINPOL_RISE;
-
-	} else if (devc->clock.samplerate <= SR_MHZ(50)) {
-		/* 50MHz firmware modes. */
-
-		/* Translate application specs to hardware perspective. */
-		ret = sigma_build_basic_trigger(devc, &lut);
-		if (ret != SR_OK)
-			return ret;
-
-		/* Communicate resulting register values to the device. */
-		ret = sigma_write_trigger_lut(devc, &lut);
-		if (ret != SR_OK)
-			return ret;
-
-		trigsel2 = TRGSEL2_LEDSEL1 | TRGSEL2_LEDSEL0;
-	}
-
-	/* Setup trigger in and out pins to default values. */
-	memset(&triggerinout_conf, 0, sizeof(triggerinout_conf));
-	triggerinout_conf.trgout_bytrigger = TRUE;
-	triggerinout_conf.trgout_enable = TRUE;
-	/* TODO
-	 * Verify the correctness of this implementation. The previous
-	 * version used to assign to a C language struct with bit fields
-	 * which is highly non-portable and hard to guess the resulting
-	 * raw memory layout or wire transfer content. The C struct's
-	 * field names did not match the vendor documentation's names.
-	 * Which means that I could not verify "on paper" either. Let's
-	 * re-visit this code later during research for trigger support.
-	 */
-	wrptr = cmd_bytes;
-	regval = 0;
-	if (triggerinout_conf.trgout_bytrigger)
-		regval |= TRGOPT_TRGOOUTEN;
-	write_u8_inc(&wrptr, regval);
-	regval &= ~TRGOPT_CLEAR_MASK;
-	if (triggerinout_conf.trgout_enable)
-		regval |= TRGOPT_TRGOEN;
-	write_u8_inc(&wrptr, regval);
-	ret = sigma_write_register(devc, WRITE_TRIGGER_OPTION,
-		cmd_bytes, wrptr - cmd_bytes);
-	if (ret != SR_OK)
-		return ret;
-
-	/* Leave trigger programming mode. */
-	ret = sigma_set_register(devc, WRITE_TRIGGER_SELECT2, trigsel2);
-	if (ret != SR_OK)
-		return ret;
-
-	/*
-	 * Samplerate dependent clock and channels configuration. Some
-	 * channels by design are not available at higher clock rates.
-	 * Register layout differs between firmware variants (depth 1
-	 * with LSB channel mask above 50MHz, depth 4 with more details
-	 * up to 50MHz).
-	 *
-	 * Derive a mask where bits are set for unavailable channels.
-	 * Either send the single byte, or the full byte sequence.
-	 */
-	pindis_mask = ~BITS_MASK(devc->interp.num_channels);
-	if (devc->clock.samplerate > SR_MHZ(50)) {
-		ret = sigma_set_register(devc, WRITE_CLOCK_SELECT,
-			pindis_mask & 0xff);
-	} else {
-		wrptr = cmd_bytes;
-		/* Select 50MHz base clock, and divider. */
-		async = 0;
-		div = SR_MHZ(50) / devc->clock.samplerate - 1;
-		if (devc->clock.use_ext_clock) {
-			async = CLKSEL_CLKSEL8;
-			div = devc->clock.clock_pin + 1;
-			switch (devc->clock.clock_edge) {
-			case SIGMA_CLOCK_EDGE_RISING:
-				div |= CLKSEL_RISING;
-				break;
-			case SIGMA_CLOCK_EDGE_FALLING:
-				div |= CLKSEL_FALLING;
-				break;
-			case SIGMA_CLOCK_EDGE_EITHER:
-				div |= CLKSEL_RISING;
-				div |= CLKSEL_FALLING;
-				break;
-			}
-		}
-		write_u8_inc(&wrptr, async);
-		write_u8_inc(&wrptr, div);
-		write_u16be_inc(&wrptr, pindis_mask);
-		ret = sigma_write_register(devc, WRITE_CLOCK_SELECT,
-			cmd_bytes, wrptr - cmd_bytes);
-	}
-	if (ret != SR_OK)
-		return ret;
-
-	/* Setup maximum post trigger time. */
-	ret = sigma_set_register(devc, WRITE_POST_TRIGGER,
-		(devc->capture_ratio * 255) / 100);
-	if (ret != SR_OK)
-		return ret;
-
-	/* Start acqusition. */
-	regval = WMR_TRGRES | WMR_SDRAMWRITEEN;
-	if (devc->use_triggers)
-		regval |= WMR_TRGEN;
-	ret = sigma_set_register(devc, WRITE_MODE, regval);
+	ret = sigma_start_capture(sdi);
 	if (ret != SR_OK)
 		return ret;
+	devc->stop_requested = FALSE;
+	devc->num_frames = 0;
 
 	ret = std_session_send_df_header(sdi);
 	if (ret != SR_OK)
@@ -618,11 +483,13 @@ static int dev_acquisition_stop(struct sr_dev_inst *sdi)
 	 * already. The detour is required to have sample data retrieved
 	 * for forced acquisition stops.
 	 */
+	devc->stop_requested = TRUE;
 	if (devc->state == SIGMA_CAPTURE) {
 		devc->state = SIGMA_STOPPING;
 	} else {
 		devc->state = SIGMA_IDLE;
 		(void)sr_session_source_remove(sdi->session, -1);
+		sigma_abort_download(devc);
 	}
 
 	return SR_OK;
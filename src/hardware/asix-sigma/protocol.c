@@ -844,6 +844,7 @@ static int upload_firmware(struct sr_context *ctx, struct dev_context *devc,
 	}
 
 	devc->state = SIGMA_CONFIG;
+	devc->lut_cache.valid = FALSE;
 
 	/* Set the cable to bitbang mode. */
 	ret = ftdi_set_bitmode(&devc->ftdi.ctx, BB_PINMASK, BITMODE_BITBANG);
@@ -1047,6 +1048,7 @@ SR_PRIV int sigma_fetch_hw_config(const struct sr_dev_inst *sdi)
 
 	/* Seed configuration values from defaults. */
 	devc->firmware_idx = SIGMA_FW_NONE;
+	devc->lut_cache.valid = FALSE;
 	devc->clock.samplerate = samplerates[0];
 
 	/* TODO
@@ -1265,6 +1267,7 @@ static int addto_submit_buffer(struct dev_context *devc,
 {
 	struct submit_buffer *buffer;
 	struct sr_sw_limits *limits;
+	size_t n;
 	int ret;
 
 	buffer = devc->buffer;
@@ -1273,19 +1276,25 @@ static int addto_submit_buffer(struct dev_context *devc,
 		count = 0;
 
 	/*
-	 * Individually accumulate and check each sample, such that
-	 * accumulation between flushes won't exceed local storage, and
-	 * enforcement of user specified limits is exact.
+	 * Accumulate runs of the sample, such that accumulation between
+	 * flushes won't exceed local storage, and enforcement of user
+	 * specified limits is exact.
 	 */
-	while (count--) {
-		write_u16le_inc(&buffer->write_pointer, sample);
-		buffer->curr_samples++;
+	while (count) {
+		n = MIN(count, buffer->max_samples - buffer->curr_samples);
+		if (!devc->use_triggers && limits->limit_samples)
+			n = MIN(n, limits->limit_samples - limits->samples_read);
+		sr_simd_fill_u16((uint16_t *)buffer->write_pointer,
+			GUINT16_TO_LE(sample), n);
+		buffer->write_pointer += n * sizeof(uint16_t);
+		buffer->curr_samples += n;
+		count -= n;
 		if (buffer->curr_samples == buffer->max_samples) {
 			ret = flush_submit_buffer(devc);
 			if (ret != SR_OK)
 				return ret;
 		}
-		sr_sw_limits_update_samples_read(limits, 1);
+		sr_sw_limits_update_samples_read(limits, n);
 		if (!devc->use_triggers && sr_sw_limits_check(limits))
 			break;
 	}
@@ -1390,6 +1399,53 @@ static void rewind_trig_arm_pos(struct dev_context *devc, size_t count)
 	}
 }
 
+/*
+ * Read DRAM lines ahead of their interpretation. Each chunk goes to the
+ * half of the receive buffer which the session thread has released.
+ */
+static gpointer fetch_thread(gpointer data)
+{
+	struct dev_context *devc;
+	struct sigma_sample_interp *interp;
+	size_t line, slot, count;
+	int ret;
+
+	devc = data;
+	interp = &devc->interp;
+	line = interp->start.line;
+	slot = 0;
+
+	g_mutex_lock(&interp->fetch.mutex);
+	while (interp->fetch.lines_read < interp->fetch.lines_total) {
+		while (interp->fetch.slot_lines[slot] && !interp->fetch.stop)
+			g_cond_wait(&interp->fetch.cond, &interp->fetch.mutex);
+		if (interp->fetch.stop)
+			break;
+		count = interp->fetch.lines_total - interp->fetch.lines_read;
+		if (count > interp->fetch.lines_per_read)
+			count = interp->fetch.lines_per_read;
+		g_mutex_unlock(&interp->fetch.mutex);
+
+		ret = sigma_read_dram(devc, line, count, (uint8_t *)
+			&interp->fetch.rcvd_lines[slot * interp->fetch.lines_per_read]);
+
+		g_mutex_lock(&interp->fetch.mutex);
+		if (ret != SR_OK) {
+			interp->fetch.read_ret = ret;
+			g_cond_broadcast(&interp->fetch.cond);
+			break;
+		}
+		interp->fetch.slot_lines[slot] = count;
+		interp->fetch.lines_read += count;
+		line = (line + count) % ROW_COUNT;
+		slot ^= 1;
+		g_cond_broadcast(&interp->fetch.cond);
+	}
+	g_mutex_unlock(&interp->fetch.mutex);
+
+	return NULL;
+}
+
 static int alloc_sample_buffer(struct dev_context *devc,
 	size_t stop_pos, size_t trig_pos, uint8_t mode)
 {
@@ -1447,14 +1503,27 @@ static int alloc_sample_buffer(struct dev_context *devc,
 	interp->fetch.lines_total %= ROW_COUNT;
 	interp->fetch.lines_done = 0;
 
-	/* Arrange for chunked download, N lines per USB request. */
+	/*
+	 * Arrange for chunked download, N lines per USB request. A thread
+	 * reads the next chunk while the previous one gets interpreted,
+	 * alternating between two halves of the receive buffer.
+	 */
 	interp->fetch.lines_per_read = 32;
 	alloc_size = sizeof(devc->interp.fetch.rcvd_lines[0]);
-	alloc_size *= devc->interp.fetch.lines_per_read;
+	alloc_size *= 2 * devc->interp.fetch.lines_per_read;
 	devc->interp.fetch.rcvd_lines = g_try_malloc0(alloc_size);
 	if (!devc->interp.fetch.rcvd_lines)
 		return SR_ERR_MALLOC;
 
+	g_mutex_init(&interp->fetch.mutex);
+	g_cond_init(&interp->fetch.cond);
+	interp->fetch.thread = g_thread_try_new("sigma-fetch",
+		fetch_thread, devc, NULL);
+	if (!interp->fetch.thread) {
+		sr_err("Cannot start sample memory download thread.");
+		return SR_ERR;
+	}
+
 	return SR_OK;
 }
 
@@ -1464,7 +1533,7 @@ static uint16_t sigma_deinterlace_data_2x8(uint16_t indata, int idx);
 static int fetch_sample_buffer(struct dev_context *devc)
 {
 	struct sigma_sample_interp *interp;
-	size_t count;
+	size_t count, slot;
 	int ret;
 	const uint8_t *rdptr;
 	uint16_t ts, data;
@@ -1476,16 +1545,18 @@ static int fetch_sample_buffer(struct dev_context *devc)
 		interp->iter = interp->start;
 	}
 
-	/* Get another set of DRAM lines in one read call. */
-	count = interp->fetch.lines_total - interp->fetch.lines_done;
-	if (count > interp->fetch.lines_per_read)
-		count = interp->fetch.lines_per_read;
-	ret = sigma_read_dram(devc, interp->iter.line, count,
-		(uint8_t *)interp->fetch.rcvd_lines);
-	if (ret != SR_OK)
+	/* Wait for the read thread to provide another set of DRAM lines. */
+	slot = interp->fetch.decode_slot;
+	g_mutex_lock(&interp->fetch.mutex);
+	while (!interp->fetch.slot_lines[slot] && interp->fetch.read_ret == SR_OK)
+		g_cond_wait(&interp->fetch.cond, &interp->fetch.mutex);
+	count = interp->fetch.slot_lines[slot];
+	ret = interp->fetch.read_ret;
+	g_mutex_unlock(&interp->fetch.mutex);
+	if (!count)
 		return ret;
 	interp->fetch.lines_rcvd = count;
-	interp->fetch.curr_line = &interp->fetch.rcvd_lines[0];
+	interp->fetch.curr_line = &interp->fetch.rcvd_lines[slot * interp->fetch.lines_per_read];
 
 	/* First invocation? Get initial timestamp and sample data. */
 	if (!interp->fetch.lines_done) {
@@ -1504,8 +1575,34 @@ static int fetch_sample_buffer(struct dev_context *devc)
 	return SR_OK;
 }
 
+/* Hand the interpreted set of DRAM lines back to the read thread. */
+static void release_sample_buffer(struct dev_context *devc)
+{
+	struct sigma_sample_interp *interp;
+
+	interp = &devc->interp;
+	g_mutex_lock(&interp->fetch.mutex);
+	interp->fetch.slot_lines[interp->fetch.decode_slot] = 0;
+	interp->fetch.decode_slot ^= 1;
+	g_cond_broadcast(&interp->fetch.cond);
+	g_mutex_unlock(&interp->fetch.mutex);
+}
+
 static void free_sample_buffer(struct dev_context *devc)
 {
+	struct sigma_sample_interp *interp;
+
+	interp = &devc->interp;
+	if (interp->fetch.thread) {
+		g_mutex_lock(&interp->fetch.mutex);
+		interp->fetch.stop = TRUE;
+		g_cond_broadcast(&interp->fetch.cond);
+		g_mutex_unlock(&interp->fetch.mutex);
+		g_thread_join(interp->fetch.thread);
+		interp->fetch.thread = NULL;
+		g_mutex_clear(&interp->fetch.mutex);
+		g_cond_clear(&interp->fetch.cond);
+	}
 	g_free(devc->interp.fetch.rcvd_lines);
 	devc->interp.fetch.rcvd_lines = NULL;
 	devc->interp.fetch.lines_per_read = 0;
@@ -1808,6 +1905,37 @@ static uint16_t sigma_dram_cluster_data(struct sigma_dram_cluster *cl, int idx)
 	return read_u16le((const uint8_t *)&cl->samples[idx]);
 }
 
+/*
+ * Lookup tables for the deinterlacing of sample data. For each byte of
+ * an item they hold the bits of all samples in that byte: the even and
+ * odd bits in two nibbles for 100MHz, and the pairs of bits of each
+ * sample in four groups of two bits for 200MHz.
+ */
+static uint8_t deinterlace_2x8[256];
+static uint8_t deinterlace_4x4[256];
+
+static void sigma_init_deinterlace_tables(void)
+{
+	static gsize done = 0;
+	unsigned int value, bit;
+	uint8_t out2, out4;
+
+	if (!g_once_init_enter(&done))
+		return;
+	for (value = 0; value < 256; value++) {
+		out2 = out4 = 0;
+		for (bit = 0; bit < 8; bit++) {
+			if (!(value & (1 << bit)))
+				continue;
+			out2 |= 1 << ((bit % 2) * 4 + bit / 2);
+			out4 |= 1 << ((bit % 4) * 2 + bit / 4);
+		}
+		deinterlace_2x8[value] = out2;
+		deinterlace_4x4[value] = out4;
+	}
+	g_once_init_leave(&done, 1);
+}
+
 /*
  * Deinterlace sample data that was retrieved at 100MHz samplerate.
  * One 16bit item contains two samples of 8bits each. The bits of
@@ -1815,19 +1943,12 @@ static uint16_t sigma_dram_cluster_data(struct sigma_dram_cluster *cl, int idx)
  */
 static uint16_t sigma_deinterlace_data_2x8(uint16_t indata, int idx)
 {
-	uint16_t outdata;
+	uint8_t lo, hi;
 
-	indata >>= idx;
-	outdata = 0;
-	outdata |= (indata >> (0 * 2 - 0)) & (1 << 0);
-	outdata |= (indata >> (1 * 2 - 1)) & (1 << 1);
-	outdata |= (indata >> (2 * 2 - 2)) & (1 << 2);
-	outdata |= (indata >> (3 * 2 - 3)) & (1 << 3);
-	outdata |= (indata >> (4 * 2 - 4)) & (1 << 4);
-	outdata |= (indata >> (5 * 2 - 5)) & (1 << 5);
-	outdata |= (indata >> (6 * 2 - 6)) & (1 << 6);
-	outdata |= (indata >> (7 * 2 - 7)) & (1 << 7);
-	return outdata;
+	lo = deinterlace_2x8[indata & 0xff] >> (idx * 4);
+	hi = deinterlace_2x8[indata >> 8] >> (idx * 4);
+
+	return (lo & 0x0f) | ((hi & 0x0f) << 4);
 }
 
 /*
@@ -1837,15 +1958,12 @@ static uint16_t sigma_deinterlace_data_2x8(uint16_t indata, int idx)
  */
 static uint16_t sigma_deinterlace_data_4x4(uint16_t indata, int idx)
 {
-	uint16_t outdata;
+	uint8_t lo, hi;
+
+	lo = deinterlace_4x4[indata & 0xff] >> (idx * 2);
+	hi = deinterlace_4x4[indata >> 8] >> (idx * 2);
 
-	indata >>= idx;
-	outdata = 0;
-	outdata |= (indata >> (0 * 4 - 0)) & (1 << 0);
-	outdata |= (indata >> (1 * 4 - 1)) & (1 << 1);
-	outdata |= (indata >> (2 * 4 - 2)) & (1 << 2);
-	outdata |= (indata >> (3 * 4 - 3)) & (1 << 3);
-	return outdata;
+	return (lo & 0x03) | ((hi & 0x03) << 2);
 }
 
 static void sigma_decode_dram_cluster(struct dev_context *devc,
@@ -1956,6 +2074,183 @@ static int decode_chunk_ts(struct dev_context *devc,
 	return SR_OK;
 }
 
+/*
+ * Program the trigger, clock and post trigger registers, and start
+ * the acquisition. The firmware must be loaded, and the trigger spec
+ * converted already. Re-arming for another capture only repeats this.
+ */
+SR_PRIV int sigma_start_capture(const struct sr_dev_inst *sdi)
+{
+	struct dev_context *devc;
+	uint16_t pindis_mask;
+	uint8_t async, div;
+	int ret;
+	size_t triggerpin;
+	uint8_t trigsel2;
+	struct triggerinout triggerinout_conf;
+	struct triggerlut lut;
+	uint8_t regval, cmd_bytes[4], *wrptr;
+
+	devc = sdi->priv;
+
+	/* Enter trigger programming mode. */
+	trigsel2 = TRGSEL2_RESET;
+	ret = sigma_set_register(devc, WRITE_TRIGGER_SELECT2, trigsel2);
+	if (ret != SR_OK)
+		return ret;
+
+	trigsel2 = 0;
+	if (devc->clock.samplerate >= SR_MHZ(100)) {
+		/* 100 and 200 MHz mode. */
+		/* TODO Decipher the 0x81 magic number's purpose. */
+		ret = sigma_set_register(devc, WRITE_TRIGGER_SELECT2, 0x81);
+		if (ret != SR_OK)
+			return ret;
+
+		/* Find which pin to trigger on from mask. */
+		for (triggerpin = 0; triggerpin < 8; triggerpin++) {
+			if (devc->trigger.risingmask & BIT(triggerpin))
+				break;
+			if (devc->trigger.fallingmask & BIT(triggerpin))
+				break;
+		}
+
+		/* Set trigger pin and light LED on trigger. */
+		trigsel2 = triggerpin & TRGSEL2_PINS_MASK;
+		trigsel2 |= TRGSEL2_LEDSEL1;
+
+		/* Default rising edge. */
+		/* TODO Documentation disagrees, bit set means _rising_ edge. */
+		if (devc->trigger.fallingmask)
+			trigsel2 |= TRGSEL2_PINPOL_RISE;
+
+	} else if (devc->clock.samplerate <= SR_MHZ(50)) {
+		/* 50MHz firmware modes. */
+
+		/*
+		 * The firmware keeps the LUT until it gets uploaded again.
+		 * Skip building and sending it when re-arming with the
+		 * same trigger spec.
+		 */
+		if (devc->lut_cache.valid &&
+				devc->lut_cache.use_triggers == devc->use_triggers &&
+				!memcmp(&devc->lut_cache.trigger, &devc->trigger,
+					sizeof(devc->trigger))) {
+			sr_dbg("Trigger LUT unchanged.");
+		} else {
+			devc->lut_cache.valid = FALSE;
+
+			/* Translate application specs to hardware perspective. */
+			ret = sigma_build_basic_trigger(devc, &lut);
+			if (ret != SR_OK)
+				return ret;
+
+			/* Communicate resulting register values to the device. */
+			ret = sigma_write_trigger_lut(devc, &lut);
+			if (ret != SR_OK)
+				return ret;
+
+			devc->lut_cache.valid = TRUE;
+			devc->lut_cache.use_triggers = devc->use_triggers;
+			devc->lut_cache.trigger = devc->trigger;
+		}
+
+		trigsel2 = TRGSEL2_LEDSEL1 | TRGSEL2_LEDSEL0;
+	}
+
+	/* Setup trigger in and out pins to default values. */
+	memset(&triggerinout_conf, 0, sizeof(triggerinout_conf));
+	triggerinout_conf.trgout_bytrigger = TRUE;
+	triggerinout_conf.trgout_enable = TRUE;
+	/* TODO
+	 * Verify the correctness of this implementation. The previous
+	 * version used to assign to a C language struct with bit fields
+	 * which is highly non-portable and hard to guess the resulting
+	 * raw memory layout or wire transfer content. The C struct's
+	 * field names did not match the vendor documentation's names.
+	 * Which means that I could not verify "on paper" either. Let's
+	 * re-visit this code later during research for trigger support.
+	 */
+	wrptr = cmd_bytes;
+	regval = 0;
+	if (triggerinout_conf.trgout_bytrigger)
+		regval |= TRGOPT_TRGOOUTEN;
+	write_u8_inc(&wrptr, regval);
+	regval &= ~TRGOPT_CLEAR_MASK;
+	if (triggerinout_conf.trgout_enable)
+		regval |= TRGOPT_TRGOEN;
+	write_u8_inc(&wrptr, regval);
+	ret = sigma_write_register(devc, WRITE_TRIGGER_OPTION,
+		cmd_bytes, wrptr - cmd_bytes);
+	if (ret != SR_OK)
+		return ret;
+
+	/* Leave trigger programming mode. */
+	ret = sigma_set_register(devc, WRITE_TRIGGER_SELECT2, trigsel2);
+	if (ret != SR_OK)
+		return ret;
+
+	/*
+	 * Samplerate dependent clock and channels configuration. Some
+	 * channels by design are not available at higher clock rates.
+	 * Register layout differs between firmware variants (depth 1
+	 * with LSB channel mask above 50MHz, depth 4 with more details
+	 * up to 50MHz).
+	 *
+	 * Derive a mask where bits are set for unavailable channels.
+	 * Either send the single byte, or the full byte sequence.
+	 */
+	pindis_mask = ~BITS_MASK(devc->interp.num_channels);
+	if (devc->clock.samplerate > SR_MHZ(50)) {
+		ret = sigma_set_register(devc, WRITE_CLOCK_SELECT,
+			pindis_mask & 0xff);
+	} else {
+		wrptr = cmd_bytes;
+		/* Select 50MHz base clock, and divider. */
+		async = 0;
+		div = SR_MHZ(50) / devc->clock.samplerate - 1;
+		if (devc->clock.use_ext_clock) {
+			async = CLKSEL_CLKSEL8;
+			div = devc->clock.clock_pin + 1;
+			switch (devc->clock.clock_edge) {
+			case SIGMA_CLOCK_EDGE_RISING:
+				div |= CLKSEL_RISING;
+				break;
+			case SIGMA_CLOCK_EDGE_FALLING:
+				div |= CLKSEL_FALLING;
+				break;
+			case SIGMA_CLOCK_EDGE_EITHER:
+				div |= CLKSEL_RISING;
+				div |= CLKSEL_FALLING;
+				break;
+			}
+		}
+		write_u8_inc(&wrptr, async);
+		write_u8_inc(&wrptr, div);
+		write_u16be_inc(&wrptr, pindis_mask);
+		ret = sigma_write_register(devc, WRITE_CLOCK_SELECT,
+			cmd_bytes, wrptr - cmd_bytes);
+	}
+	if (ret != SR_OK)
+		return ret;
+
+	/* Setup maximum post trigger time. */
+	ret = sigma_set_register(devc, WRITE_POST_TRIGGER,
+		(devc->capture_ratio * 255) / 100);
+	if (ret != SR_OK)
+		return ret;
+
+	/* Start acqusition. */
+	regval = WMR_TRGRES | WMR_SDRAMWRITEEN;
+	if (devc->use_triggers)
+		regval |= WMR_TRGEN;
+	ret = sigma_set_register(devc, WRITE_MODE, regval);
+	if (ret != SR_OK)
+		return ret;
+
+	return SR_OK;
+}
+
 static int download_capture(struct sr_dev_inst *sdi)
 {
 	struct dev_context *devc;
@@ -2028,6 +2323,7 @@ static int download_capture(struct sr_dev_inst *sdi)
 		if (!(modestatus & RMR_TRIGGERED))
 			triggerpos = ~0;
 
+		sigma_init_deinterlace_tables();
 		ret = alloc_sample_buffer(devc, stoppos, triggerpos, modestatus);
 		if (ret != SR_OK)
 			return FALSE;
@@ -2038,6 +2334,9 @@ static int download_capture(struct sr_dev_inst *sdi)
 		ret = setup_submit_limit(devc);
 		if (ret != SR_OK)
 			return FALSE;
+
+		if (devc->limit.config.limit_frames)
+			std_session_send_df_frame_begin(sdi);
 	}
 
 	/*
@@ -2069,6 +2368,7 @@ static int download_capture(struct sr_dev_inst *sdi)
 			interp->fetch.curr_line++;
 			interp->fetch.lines_done++;
 		}
+		release_sample_buffer(devc);
 
 		/* Keep returning to application code for large data sets. */
 		if (!--chunks_per_receive_call) {
@@ -2091,6 +2391,26 @@ static int download_capture(struct sr_dev_inst *sdi)
 		free_submit_buffer(devc);
 		free_sample_buffer(devc);
 
+		/*
+		 * Multi-shot: the device stays configured, just re-arm
+		 * it for the next capture.
+		 */
+		if (devc->limit.config.limit_frames) {
+			std_session_send_df_frame_end(sdi);
+			devc->num_frames++;
+			if (!devc->stop_requested &&
+			    devc->num_frames < devc->limit.config.limit_frames) {
+				ret = sigma_set_acquire_timeout(devc);
+				if (ret != SR_OK)
+					return FALSE;
+				ret = sigma_start_capture(sdi);
+				if (ret != SR_OK)
+					return FALSE;
+				devc->state = SIGMA_CAPTURE;
+				return TRUE;
+			}
+		}
+
 		ret = std_session_send_df_end(sdi);
 		if (ret != SR_OK)
 			return FALSE;
@@ -2102,6 +2422,16 @@ static int download_capture(struct sr_dev_inst *sdi)
 	return TRUE;
 }
 
+/*
+ * Release the download's resources when the acquisition gets stopped
+ * before the sample memory was retrieved completely.
+ */
+SR_PRIV void sigma_abort_download(struct dev_context *devc)
+{
+	free_sample_buffer(devc);
+	free_submit_buffer(devc);
+}
+
 /*
  * Periodically check the Sigma status when in CAPTURE mode. This routine
  * checks whether the configured sample count or sample time have passed,
@@ -368,6 +368,15 @@ struct dev_context {
 			size_t lines_rcvd;
 			struct sigma_dram_line *rcvd_lines;
 			struct sigma_dram_line *curr_line;
+			/* Read ahead thread, fills two halves of rcvd_lines. */
+			GThread *thread;
+			GMutex mutex;
+			GCond cond;
+			size_t lines_read;
+			size_t slot_lines[2];
+			size_t decode_slot;
+			int read_ret;
+			gboolean stop;
 		} fetch;
 		struct {
 			gboolean armed;
@@ -378,7 +387,16 @@ struct dev_context {
 	uint64_t capture_ratio;
 	struct sigma_trigger trigger;
 	gboolean use_triggers;
+	struct {
+		/* Trigger spec of the LUT which the firmware holds. */
+		gboolean valid;
+		gboolean use_triggers;
+		struct sigma_trigger trigger;
+	} lut_cache;
 	gboolean late_trigger_timeout;
+	/* Captures done in multi-shot mode, and whether to stop. */
+	uint64_t num_frames;
+	gboolean stop_requested;
 	enum {
 		SIGMA_UNINITIALIZED = 0,
 		SIGMA_CONFIG,
@@ -416,10 +434,12 @@ SR_PRIV GVariant *sigma_get_samplerates_list(void);
 SR_PRIV int sigma_set_samplerate(const struct sr_dev_inst *sdi);
 SR_PRIV int sigma_set_acquire_timeout(struct dev_context *devc);
 SR_PRIV int sigma_convert_trigger(const struct sr_dev_inst *sdi);
+SR_PRIV int sigma_start_capture(const struct sr_dev_inst *sdi);
 SR_PRIV int sigma_build_basic_trigger(struct dev_context *devc,
 	struct triggerlut *lut);
 
 /* Callback to periodically drive acuisition progress. */
 SR_PRIV int sigma_receive_data(int fd, int revents, void *cb_data);
+SR_PRIV void sigma_abort_download(struct dev_context *devc);
 
 #endif
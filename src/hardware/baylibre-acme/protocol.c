@@ -52,6 +52,8 @@ struct channel_priv {
 	int ch_type;
 	int fd;
 	int digits;
+	/* Factor from the hwmon unit, 10^-digits. */
+	float scale;
 	float val;
 	struct channel_group_priv *probe;
 };
@@ -637,23 +639,20 @@ static float read_sample(struct sr_channel *ch)
 	struct channel_priv *chp;
 	char buf[16];
 	ssize_t len;
-	int fd;
 
 	chp = ch->priv;
-	fd = chp->fd;
-
-	lseek(fd, 0, SEEK_SET);
 
-	len = read(fd, buf, sizeof(buf));
+	/* Reading from the start has sysfs provide a fresh value. */
+	len = pread(chp->fd, buf, sizeof(buf) - 1, 0);
 	if (len < 0) {
 		sr_err("Error reading from channel %s (hwmon: %d): %s",
 			ch->name, chp->probe->hwmon_num, g_strerror(errno));
 		ch->enabled = FALSE;
 		return -1.0;
 	}
+	buf[len] = '\0';
 
-	chp->digits = type_digits(chp->ch_type);
-	return strtol(buf, NULL, 10) * powf(10, -chp->digits);
+	return strtol(buf, NULL, 10) * chp->scale;
 }
 
 SR_PRIV int bl_acme_open_channel(struct sr_channel *ch)
@@ -687,6 +686,8 @@ SR_PRIV int bl_acme_open_channel(struct sr_channel *ch)
 	}
 
 	chp->fd = fd;
+	chp->digits = type_digits(chp->ch_type);
+	chp->scale = powf(10, -chp->digits);
 
 	return 0;
 }
@@ -700,20 +701,70 @@ SR_PRIV void bl_acme_close_channel(struct sr_channel *ch)
 	chp->fd = -1;
 }
 
-SR_PRIV int bl_acme_receive_data(int fd, int revents, void *cb_data)
+/*
+ * Send the values of the channels, one packet for all channels which
+ * have the same quantity, unit and digits.
+ */
+static void send_values(const struct sr_dev_inst *sdi,
+		struct sr_channel *chs[], unsigned int num)
 {
-	uint64_t nrexpiration;
 	struct sr_datafeed_packet packet;
 	struct sr_datafeed_analog analog;
 	struct sr_analog_encoding encoding;
 	struct sr_analog_meaning meaning;
 	struct sr_analog_spec spec;
+	struct channel_priv *chp, *first;
+	GSList links[MAX_CHANNELS];
+	float values[MAX_CHANNELS];
+	gboolean sent[MAX_CHANNELS];
+	unsigned int i, j, n;
+	int mq, unit;
+
+	packet.type = SR_DF_ANALOG;
+	packet.payload = &analog;
+	memset(sent, 0, sizeof(sent));
+
+	for (i = 0; i < num; i++) {
+		if (sent[i])
+			continue;
+		first = chs[i]->priv;
+		mq = channel_to_mq(chs[i]);
+		unit = channel_to_unit(chs[i]);
+		n = 0;
+		for (j = i; j < num; j++) {
+			chp = chs[j]->priv;
+			if (sent[j] || channel_to_mq(chs[j]) != mq
+					|| channel_to_unit(chs[j]) != unit
+					|| chp->digits != first->digits)
+				continue;
+			links[n].data = chs[j];
+			links[n].next = NULL;
+			if (n)
+				links[n - 1].next = &links[n];
+			values[n] = chp->val;
+			sent[j] = TRUE;
+			n++;
+		}
+
+		sr_analog_init(&analog, &encoding, &meaning, &spec, first->digits);
+		analog.num_samples = 1;
+		analog.meaning->channels = links;
+		analog.meaning->mq = mq;
+		analog.meaning->unit = unit;
+		analog.data = values;
+		sr_session_send(sdi, &packet);
+	}
+}
+
+SR_PRIV int bl_acme_receive_data(int fd, int revents, void *cb_data)
+{
+	uint64_t nrexpiration;
 	struct sr_dev_inst *sdi;
-	struct sr_channel *ch;
+	struct sr_channel *ch, *chs[MAX_CHANNELS];
 	struct channel_priv *chp;
 	struct dev_context *devc;
-	GSList *chl, chonly;
-	unsigned i;
+	GSList *chl;
+	unsigned int i, num;
 
 	(void)fd;
 	(void)revents;
@@ -726,10 +777,6 @@ SR_PRIV int bl_acme_receive_data(int fd, int revents, void *cb_data)
 	if (!devc)
 		return TRUE;
 
-	packet.type = SR_DF_ANALOG;
-	packet.payload = &analog;
-	sr_analog_init(&analog, &encoding, &meaning, &spec, 0);
-
 	if (read(devc->timer_fd, &nrexpiration, sizeof(nrexpiration)) < 0) {
 		sr_warn("Failed to read timer information");
 		return TRUE;
@@ -758,41 +805,23 @@ SR_PRIV int bl_acme_receive_data(int fd, int revents, void *cb_data)
 	 * At high sampling rate this doesn't seem to visibly reduce the
 	 * accuracy.
 	 */
+	num = 0;
+	for (chl = sdi->channels; chl && num < MAX_CHANNELS; chl = chl->next) {
+		ch = chl->data;
+		chp = ch->priv;
+		if (!ch->enabled)
+			continue;
+		chp->val = read_sample(ch);
+		chs[num++] = ch;
+	}
+
 	for (i = 0; i < nrexpiration; i++) {
 		std_session_send_df_frame_begin(sdi);
-
-		/*
-		 * Due to different units used in each channel we're sending
-		 * samples one-by-one.
-		 */
-		for (chl = sdi->channels; chl; chl = chl->next) {
-			ch = chl->data;
-			chp = ch->priv;
-
-			if (!ch->enabled)
-				continue;
-			chonly.next = NULL;
-			chonly.data = ch;
-			analog.num_samples = 1;
-			analog.meaning->channels = &chonly;
-			analog.meaning->mq = channel_to_mq(chl->data);
-			analog.meaning->unit = channel_to_unit(ch);
-
-			if (i < 1)
-				chp->val = read_sample(ch);
-
-			analog.encoding->digits  = chp->digits;
-			analog.spec->spec_digits = chp->digits;
-			analog.data = &chp->val;
-			sr_session_send(sdi, &packet);
-		}
-
+		send_values(sdi, chs, num);
 		std_session_send_df_frame_end(sdi);
 	}
 
-	sr_sw_limits_update_samples_read(&devc->limits, 1);
-
-	if (sr_sw_limits_check(&devc->limits)) {
+	if (sr_sw_limits_update_and_check(&devc->limits, 1)) {
 		sr_dev_acquisition_stop(sdi);
 		return TRUE;
 	}
@@ -31,6 +31,9 @@
 /* We support up to 8 energy/temperature probes. */
 #define MAX_PROBES		8
 
+/* Energy probes have three channels, temperature probes two. */
+#define MAX_CHANNELS		(MAX_PROBES * 3)
+
 /*
  * Temperature probes can be connected to the last four ports on the
  * ACME cape. When scanning, first look for temperature probes starting
@@ -37,6 +37,7 @@ static const uint32_t devopts[] = {
 	SR_CONF_TRIGGER_MATCH | SR_CONF_LIST,
 	SR_CONF_CAPTURE_RATIO | SR_CONF_GET | SR_CONF_SET,
 	SR_CONF_NUM_LOGIC_CHANNELS | SR_CONF_GET,
+	SR_CONF_TRANSFER_SIZE | SR_CONF_GET | SR_CONF_SET,
 };
 
 static const int32_t trigger_matches[] = {
@@ -111,6 +112,7 @@ static GSList *scan(struct sr_dev_driver *di, GSList *options)
 	devc->fd = -1;
 	devc->limit_samples = 10000000;
 	devc->tcp_buffer = 0;
+	devc->tcp_buffer_size = TCP_BUFFER_SIZE;
 
 	if (!conn) {
 		devc->beaglelogic = &beaglelogic_native_ops;
@@ -187,7 +189,7 @@ static int dev_open(struct sr_dev_inst *sdi)
 			return SR_ERR;
 		}
 	} else {
-		devc->tcp_buffer = g_malloc(TCP_BUFFER_SIZE);
+		devc->tcp_buffer = g_malloc(devc->tcp_buffer_size);
 	}
 
 	return SR_OK;
@@ -197,9 +199,14 @@ static int dev_close(struct sr_dev_inst *sdi)
 {
 	struct dev_context *devc = sdi->priv;
 
-	/* Close the memory mapping and the file */
-	if (devc->beaglelogic == &beaglelogic_native_ops)
-		devc->beaglelogic->munmap(devc);
+	/* Close the memory mapping and the file. Consumers which still
+	 * hold sample data keep the mapping alive. */
+	if (devc->beaglelogic == &beaglelogic_native_ops) {
+		if (beaglelogic_blocks_release(devc))
+			devc->beaglelogic->munmap(devc);
+		else
+			sr_warn("Sample data still in use, keeping buffer mapped.");
+	}
 	devc->beaglelogic->close(devc);
 
 	return SR_OK;
@@ -237,6 +244,11 @@ static int config_get(uint32_t key, GVariant **data,
 	case SR_CONF_NUM_LOGIC_CHANNELS:
 		*data = g_variant_new_uint32(g_slist_length(sdi->channels));
 		break;
+	case SR_CONF_TRANSFER_SIZE:
+		if (devc->beaglelogic != &beaglelogic_tcp_ops)
+			return SR_ERR_NA;
+		*data = g_variant_new_uint64(devc->tcp_buffer_size);
+		break;
 	default:
 		return SR_ERR_NA;
 	}
@@ -276,6 +288,16 @@ static int config_set(uint32_t key, GVariant *data,
 	case SR_CONF_CAPTURE_RATIO:
 		devc->capture_ratio = g_variant_get_uint64(data);
 		break;
+	case SR_CONF_TRANSFER_SIZE:
+		/* The receive size, only the TCP transport has one. */
+		if (devc->beaglelogic != &beaglelogic_tcp_ops)
+			return SR_ERR_NA;
+		tmp_u64 = g_variant_get_uint64(data);
+		if (tmp_u64 < TCP_BUFFER_SIZE_MIN ||
+				tmp_u64 > TCP_BUFFER_SIZE_MAX || tmp_u64 % 2)
+			return SR_ERR_ARG;
+		devc->tcp_buffer_size = tmp_u64;
+		break;
 	default:
 		return SR_ERR_NA;
 	}
@@ -345,16 +367,22 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 		devc->trigger_fired = TRUE;
 	std_session_send_df_header(sdi);
 
-	/* Trigger and add poll on file */
+	/* Trigger and add poll on file. The kernel signals every filled
+	 * buffer unit, the native source needs no timeout. */
 	devc->beaglelogic->start(devc);
-	if (devc->beaglelogic == &beaglelogic_native_ops)
+	if (devc->beaglelogic == &beaglelogic_native_ops) {
+		beaglelogic_blocks_setup(devc);
 		sr_session_source_add_pollfd(sdi->session, &devc->pollfd,
-			BUFUNIT_TIMEOUT_MS(devc), beaglelogic_native_receive_data,
-			(void *)sdi);
-	else
+			-1, beaglelogic_native_receive_data, (void *)sdi);
+	} else {
+		/* The receive size may have changed since opening. */
+		devc->tcp_buffer = g_realloc(devc->tcp_buffer,
+			devc->tcp_buffer_size);
+		devc->tcp_fill = 0;
 		sr_session_source_add_pollfd(sdi->session, &devc->pollfd,
 			BUFUNIT_TIMEOUT_MS(devc), beaglelogic_tcp_receive_data,
 			(void *)sdi);
+	}
 
 	return SR_OK;
 }
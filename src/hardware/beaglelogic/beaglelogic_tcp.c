@@ -46,7 +46,7 @@ static int beaglelogic_tcp_open(struct dev_context *devc)
 {
 	struct addrinfo hints;
 	struct addrinfo *results, *res;
-	int err;
+	int err, rcvbuf;
 
 	memset(&hints, 0, sizeof(hints));
 	hints.ai_family = AF_UNSPEC;
@@ -65,6 +65,11 @@ static int beaglelogic_tcp_open(struct dev_context *devc)
 		if ((devc->socket = socket(res->ai_family, res->ai_socktype,
 						res->ai_protocol)) < 0)
 			continue;
+		/* Must happen before connecting for the window scaling. */
+		rcvbuf = TCP_SOCKET_RCVBUF;
+		if (setsockopt(devc->socket, SOL_SOCKET, SO_RCVBUF,
+				(const char *)&rcvbuf, sizeof(rcvbuf)) != 0)
+			sr_dbg("Cannot set the socket receive buffer size.");
 		if (connect(devc->socket, res->ai_addr, res->ai_addrlen) != 0) {
 			close(devc->socket);
 			devc->socket = -1;
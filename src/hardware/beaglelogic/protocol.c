@@ -33,13 +33,74 @@
 #include "beaglelogic.h"
 
 /* Define data packet size independent of packet (bufunitsize bytes) size
- * from the BeagleLogic kernel module */
+ * from the BeagleLogic kernel module. This is the minimum, faster sample
+ * rates use larger packets of up to a buffer unit. */
 #define PACKET_SIZE	(512 * 1024)
 
+/* Target period of data per packet, in ms */
+#define PACKET_PERIOD_MS	50
+
+/* Choose the packet size from the sample rate, and track the references
+ * to each packet sized block of the kernel buffer. */
+SR_PRIV void beaglelogic_blocks_setup(struct dev_context *devc)
+{
+	uint64_t rate;
+	uint32_t size;
+
+	beaglelogic_blocks_release(devc);
+
+	rate = devc->cur_samplerate * SAMPLEUNIT_TO_BYTES(devc->sampleunit);
+	size = PACKET_SIZE;
+	while (size * (uint64_t)2 <= devc->bufunitsize &&
+			devc->bufunitsize % (size * 2) == 0 &&
+			size < rate * PACKET_PERIOD_MS / 1000)
+		size *= 2;
+	devc->packetsize = size;
+	devc->num_blocks = (devc->buffersize + size - 1) / size;
+	devc->blocks = g_malloc0(devc->num_blocks * sizeof(devc->blocks[0]));
+	sr_dbg("Sending packets of %" PRIu32 " bytes.", size);
+}
+
+/* Drop the references to the blocks. Returns FALSE while consumers
+ * still hold on to some, the kernel buffer must stay mapped then. */
+SR_PRIV gboolean beaglelogic_blocks_release(struct dev_context *devc)
+{
+	gboolean all;
+	size_t i;
+
+	all = TRUE;
+	for (i = 0; i < devc->num_blocks; i++) {
+		if (devc->blocks[i] && !sr_packet_buffer_reclaim(devc->blocks[i]))
+			all = FALSE;
+	}
+	g_free(devc->blocks);
+	devc->blocks = NULL;
+	devc->num_blocks = 0;
+
+	return all;
+}
+
+/* Attach the block at the read offset to the packets which get sent, so
+ * consumers may retain them without copying. The kernel overwrites the
+ * block one lap of the ring later, in continuous mode. */
+static void attach_block(const struct sr_dev_inst *sdi,
+		struct dev_context *devc)
+{
+	struct sr_packet_buffer **block;
+
+	block = &devc->blocks[devc->offset / devc->packetsize];
+	if (*block && !sr_packet_buffer_reclaim(*block))
+		sr_warn("Retained sample data at offset %" PRIu32
+			" gets overwritten.", devc->offset);
+	*block = sr_packet_buffer_new(devc->sample_buf + devc->offset,
+		devc->packetsize, NULL);
+	sr_session_send_buffer_set(sdi->session, *block);
+}
+
 /* This implementation is zero copy from the libsigrok side.
  * It does not copy any data, just passes a pointer from the mmap'ed
- * kernel buffers appropriately. It is up to the application which is
- * using libsigrok to decide how to deal with the data.
+ * kernel buffers appropriately. Consumers which retain packets share
+ * the reference counted blocks of the buffer.
  */
 SR_PRIV int beaglelogic_native_receive_data(int fd, int revents, void *cb_data)
 {
@@ -56,11 +117,12 @@ SR_PRIV int beaglelogic_native_receive_data(int fd, int revents, void *cb_data)
 	if (!(sdi = cb_data) || !(devc = sdi->priv))
 		return TRUE;
 
-	packetsize = PACKET_SIZE;
+	packetsize = devc->packetsize;
 	logic.unitsize = SAMPLEUNIT_TO_BYTES(devc->sampleunit);
 
 	if (revents == G_IO_IN) {
-		sr_info("In callback G_IO_IN, offset=%d", devc->offset);
+		sr_spew("In callback G_IO_IN, offset=%d", devc->offset);
+		attach_block(sdi, devc);
 
 		bytes_remaining = (devc->limit_samples * logic.unitsize) -
 				devc->bytes_read;
@@ -90,6 +152,7 @@ SR_PRIV int beaglelogic_native_receive_data(int fd, int revents, void *cb_data)
 				devc->trigger_fired = TRUE;
 			}
 		}
+		sr_session_send_buffer_set(sdi->session, NULL);
 
 		/* Move the read pointer forward */
 		lseek(fd, packetsize, SEEK_CUR);
@@ -117,80 +180,149 @@ SR_PRIV int beaglelogic_native_receive_data(int fd, int revents, void *cb_data)
 	return TRUE;
 }
 
-SR_PRIV int beaglelogic_tcp_receive_data(int fd, int revents, void *cb_data)
+/*
+ * Receive without blocking where the platform supports it, so the socket
+ * can be drained within one wakeup. Otherwise only read once per wakeup.
+ */
+#ifdef MSG_DONTWAIT
+#define TCP_RECV_FLAGS	MSG_DONTWAIT
+#else
+#define TCP_RECV_FLAGS	0
+#endif
+
+/*
+ * Fill the receive buffer from the socket, until the socket has no more
+ * data or the buffer is full. In the latter case more data is likely
+ * pending, which is signalled by @more.
+ */
+static int beaglelogic_tcp_fill(struct dev_context *devc,
+		gboolean *eof, gboolean *more)
+{
+	int len;
+
+	*eof = *more = FALSE;
+	while (devc->tcp_fill < devc->tcp_buffer_size) {
+		len = recv(devc->socket, (char *)devc->tcp_buffer + devc->tcp_fill,
+			devc->tcp_buffer_size - devc->tcp_fill, TCP_RECV_FLAGS);
+		if (len == 0) {
+			*eof = TRUE;
+			return SR_OK;
+		}
+		if (len < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				return SR_OK;
+			sr_err("Receive error: %s", g_strerror(errno));
+			return SR_ERR;
+		}
+		devc->tcp_fill += len;
+		if (!TCP_RECV_FLAGS)
+			return SR_OK;
+	}
+	*more = TRUE;
+
+	return SR_OK;
+}
+
+/*
+ * Send @packetsize bytes of the receive buffer to the session bus.
+ * Returns FALSE when the capture is complete.
+ */
+static gboolean beaglelogic_tcp_send(const struct sr_dev_inst *sdi,
+		uint32_t packetsize)
 {
-	const struct sr_dev_inst *sdi;
 	struct dev_context *devc;
 	struct sr_datafeed_packet packet;
 	struct sr_datafeed_logic logic;
-
-	int len;
 	int pre_trigger_samples;
 	int trigger_offset;
-	uint32_t packetsize;
 	uint64_t bytes_remaining;
 
-	if (!(sdi = cb_data) || !(devc = sdi->priv))
-		return TRUE;
-
-	packetsize = TCP_BUFFER_SIZE;
+	devc = sdi->priv;
 	logic.unitsize = SAMPLEUNIT_TO_BYTES(devc->sampleunit);
+	bytes_remaining = (devc->limit_samples * logic.unitsize) -
+			devc->bytes_read;
+
+	/* Configure data packet */
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+	logic.data = devc->tcp_buffer;
+	logic.length = MIN(packetsize, bytes_remaining);
+
+	if (devc->trigger_fired) {
+		/* Send the incoming transfer to the session bus. */
+		sr_session_send(sdi, &packet);
+	} else {
+		/* Check for trigger */
+		trigger_offset = soft_trigger_logic_check(devc->stl,
+				logic.data, packetsize, &pre_trigger_samples);
+		if (trigger_offset > -1) {
+			devc->bytes_read += pre_trigger_samples * logic.unitsize;
+			trigger_offset *= logic.unitsize;
+			logic.length = MIN(packetsize - trigger_offset,
+					bytes_remaining);
+			logic.data += trigger_offset;
 
-	if (revents == G_IO_IN) {
-		sr_info("In callback G_IO_IN");
+			sr_session_send(sdi, &packet);
 
-		len = recv(fd, devc->tcp_buffer, TCP_BUFFER_SIZE, 0);
-		if (len < 0) {
-			sr_err("Receive error: %s", g_strerror(errno));
-			return SR_ERR;
+			devc->trigger_fired = TRUE;
 		}
+	}
 
-		packetsize = len;
+	/* Update byte count and offset (roll over if needed) */
+	devc->bytes_read += logic.length;
+	if ((devc->offset += packetsize) >= devc->buffersize) {
+		/* One shot capture, we abort and settle with less than
+		 * the required number of samples */
+		if (devc->triggerflags != BL_TRIGGERFLAGS_CONTINUOUS)
+			return FALSE;
+		devc->offset = 0;
+	}
 
-		bytes_remaining = (devc->limit_samples * logic.unitsize) -
-				devc->bytes_read;
+	return devc->bytes_read < devc->limit_samples * logic.unitsize;
+}
 
-		/* Configure data packet */
-		packet.type = SR_DF_LOGIC;
-		packet.payload = &logic;
-		logic.data = devc->tcp_buffer;
-		logic.length = MIN(packetsize, bytes_remaining);
+SR_PRIV int beaglelogic_tcp_receive_data(int fd, int revents, void *cb_data)
+{
+	const struct sr_dev_inst *sdi;
+	struct dev_context *devc;
+	uint32_t unitsize, packetsize;
+	gboolean running, eof, more;
 
-		if (devc->trigger_fired) {
-			/* Send the incoming transfer to the session bus. */
-			sr_session_send(sdi, &packet);
-		} else {
-			/* Check for trigger */
-			trigger_offset = soft_trigger_logic_check(devc->stl,
-					logic.data, packetsize, &pre_trigger_samples);
-			if (trigger_offset > -1) {
-				devc->bytes_read += pre_trigger_samples * logic.unitsize;
-				trigger_offset *= logic.unitsize;
-				logic.length = MIN(packetsize - trigger_offset,
-						bytes_remaining);
-				logic.data += trigger_offset;
+	(void)fd;
 
-				sr_session_send(sdi, &packet);
+	if (!(sdi = cb_data) || !(devc = sdi->priv))
+		return TRUE;
 
-				devc->trigger_fired = TRUE;
-			}
-		}
+	unitsize = SAMPLEUNIT_TO_BYTES(devc->sampleunit);
+	running = TRUE;
 
-		/* Update byte count and offset (roll over if needed) */
-		devc->bytes_read += logic.length;
-		if ((devc->offset += packetsize) >= devc->buffersize) {
-			/* One shot capture, we abort and settle with less than
-			 * the required number of samples */
-			if (devc->triggerflags == BL_TRIGGERFLAGS_CONTINUOUS)
-				devc->offset = 0;
-			else
-				packetsize = 0;
-		}
+	if (revents == G_IO_IN) {
+		sr_spew("In callback G_IO_IN");
+
+		/*
+		 * Drain the socket, and send what was received as few large
+		 * packets. A partial sample is kept for the next packet.
+		 */
+		do {
+			if (beaglelogic_tcp_fill(devc, &eof, &more) != SR_OK)
+				return SR_ERR;
+			packetsize = devc->tcp_fill - devc->tcp_fill % unitsize;
+			if (packetsize)
+				running = beaglelogic_tcp_send(sdi, packetsize);
+			devc->tcp_fill -= packetsize;
+			if (devc->tcp_fill)
+				memmove(devc->tcp_buffer,
+					devc->tcp_buffer + packetsize,
+					devc->tcp_fill);
+			if (eof)
+				running = FALSE;
+		} while (running && more);
 	}
 
 	/* EOF Received or we have reached the limit */
-	if (devc->bytes_read >= devc->limit_samples * logic.unitsize ||
-			packetsize == 0) {
+	if (!running) {
 		/* Send EOA Packet, stop polling */
 		std_session_send_df_end(sdi);
 		devc->beaglelogic->stop(devc);
@@ -32,7 +32,11 @@
 
 #define SAMPLEUNIT_TO_BYTES(x)	((x) == 1 ? 1 : 2)
 
-#define TCP_BUFFER_SIZE         (128 * 1024)
+/* Default and limits of the TCP receive size, and the socket buffer */
+#define TCP_BUFFER_SIZE         (1024 * 1024)
+#define TCP_BUFFER_SIZE_MIN     (4 * 1024)
+#define TCP_BUFFER_SIZE_MAX     (64 * 1024 * 1024)
+#define TCP_SOCKET_RCVBUF       (4 * 1024 * 1024)
 
 /** Private, per-device-instance driver context. */
 struct dev_context {
@@ -48,6 +52,8 @@ struct dev_context {
 	int socket;
 	unsigned int read_timeout;
 	unsigned char *tcp_buffer;
+	uint32_t tcp_buffer_size;
+	uint32_t tcp_fill;
 
 	/* Acquisition settings: see beaglelogic.h */
 	uint64_t cur_samplerate;
@@ -69,6 +75,11 @@ struct dev_context {
 	uint32_t offset;
 	uint8_t *sample_buf;	/* mmap'd kernel buffer here */
 
+	/* Packet size, and the references to the blocks of sample_buf */
+	uint32_t packetsize;
+	size_t num_blocks;
+	struct sr_packet_buffer **blocks;
+
 	/* Trigger logic */
 	struct soft_trigger_logic *stl;
 	gboolean trigger_fired;
@@ -76,5 +87,7 @@ struct dev_context {
 
 SR_PRIV int beaglelogic_native_receive_data(int fd, int revents, void *cb_data);
 SR_PRIV int beaglelogic_tcp_receive_data(int fd, int revents, void *cb_data);
+SR_PRIV void beaglelogic_blocks_setup(struct dev_context *devc);
+SR_PRIV gboolean beaglelogic_blocks_release(struct dev_context *devc);
 
 #endif
@@ -174,9 +174,7 @@ static void process_packet(const struct sr_dev_inst *sdi)
 	packet.payload = &analog;
 	sr_session_send(sdi, &packet);
 
-	sr_sw_limits_update_samples_read(&devc->limits, 1);
-
-	if (sr_sw_limits_check(&devc->limits))
+	if (sr_sw_limits_update_and_check(&devc->limits, 1))
 		sr_dev_acquisition_stop((struct sr_dev_inst *)sdi);
 }
 
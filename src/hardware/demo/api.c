@@ -45,6 +45,7 @@ static const char *logic_pattern_str[] = {
 	"all-high",
 	"squid",
 	"graycode",
+	"sparse",
 };
 
 static const uint32_t scanopts[] = {
@@ -69,6 +70,12 @@ static const uint32_t devopts[] = {
 	SR_CONF_AVG_SAMPLES | SR_CONF_GET | SR_CONF_SET,
 	SR_CONF_TRIGGER_MATCH | SR_CONF_LIST,
 	SR_CONF_CAPTURE_RATIO | SR_CONF_GET | SR_CONF_SET,
+	SR_CONF_UNTHROTTLED | SR_CONF_GET | SR_CONF_SET,
+	SR_CONF_BUFFERSIZE | SR_CONF_GET | SR_CONF_SET,
+	SR_CONF_BURST_INTERVAL | SR_CONF_GET | SR_CONF_SET,
+	SR_CONF_BURST_JITTER | SR_CONF_GET | SR_CONF_SET,
+	SR_CONF_EDGE_DENSITY | SR_CONF_GET | SR_CONF_SET,
+	SR_CONF_ANALOG_ENCODING | SR_CONF_GET | SR_CONF_SET | SR_CONF_LIST,
 };
 
 static const uint32_t devopts_cg_logic[] = {
@@ -93,6 +100,8 @@ static const int32_t trigger_matches[] = {
 	SR_TRIGGER_RISING,
 	SR_TRIGGER_FALLING,
 	SR_TRIGGER_EDGE,
+	SR_TRIGGER_OVER,
+	SR_TRIGGER_UNDER,
 };
 
 static const uint64_t samplerates[] = {
@@ -140,14 +149,19 @@ static GSList *scan(struct sr_dev_driver *di, GSList *options)
 	devc->cur_samplerate = SR_KHZ(200);
 	devc->num_logic_channels = num_logic_channels;
 	devc->logic_unitsize = (devc->num_logic_channels + 7) / 8;
-	devc->all_logic_channels_mask = 1UL << 0;
-	devc->all_logic_channels_mask <<= devc->num_logic_channels;
-	devc->all_logic_channels_mask--;
+	if (devc->num_logic_channels >= 64)
+		devc->all_logic_channels_mask = UINT64_MAX;
+	else
+		devc->all_logic_channels_mask = (UINT64_C(1) << devc->num_logic_channels) - 1;
+	devc->logic_bufsize = LOGIC_BUFSIZE;
+	devc->edge_density = DEFAULT_EDGE_DENSITY;
+	devc->burst_interval = DEFAULT_BURST_INTERVAL;
 	devc->logic_pattern = DEFAULT_LOGIC_PATTERN;
 	devc->num_analog_channels = num_analog_channels;
 	devc->limit_frames = limit_frames;
 	devc->capture_ratio = 20;
 	devc->stl = NULL;
+	devc->sta = NULL;
 
 	if (num_logic_channels > 0) {
 		/* Logic channels, all in one channel group. */
@@ -226,6 +240,8 @@ static void clear_helper(struct dev_context *devc)
 	void *value;
 
 	demo_free_analog_pattern(devc);
+	demo_free_logic_ring(devc);
+	g_free(devc->logic_data);
 
 	/* Analog generators. */
 	g_hash_table_iter_init(&iter, devc->ch_ag);
@@ -321,6 +337,24 @@ static int config_get(uint32_t key, GVariant **data,
 	case SR_CONF_CAPTURE_RATIO:
 		*data = g_variant_new_uint64(devc->capture_ratio);
 		break;
+	case SR_CONF_UNTHROTTLED:
+		*data = g_variant_new_boolean(devc->unthrottled);
+		break;
+	case SR_CONF_BUFFERSIZE:
+		*data = g_variant_new_uint64(devc->logic_bufsize);
+		break;
+	case SR_CONF_BURST_INTERVAL:
+		*data = g_variant_new_uint64(devc->burst_interval);
+		break;
+	case SR_CONF_BURST_JITTER:
+		*data = g_variant_new_uint64(devc->burst_jitter);
+		break;
+	case SR_CONF_EDGE_DENSITY:
+		*data = g_variant_new_double(devc->edge_density);
+		break;
+	case SR_CONF_ANALOG_ENCODING:
+		*data = g_variant_new_string(analog_encoding_str[devc->analog_encoding]);
+		break;
 	default:
 		return SR_ERR_NA;
 	}
@@ -336,7 +370,9 @@ static int config_set(uint32_t key, GVariant *data,
 	struct sr_channel *ch;
 	GVariant *mq_tuple_child;
 	GSList *l;
-	int logic_pattern, analog_pattern;
+	uint64_t num;
+	double density;
+	int logic_pattern, analog_pattern, idx;
 
 	devc = sdi->priv;
 
@@ -393,11 +429,6 @@ static int config_set(uint32_t key, GVariant *data,
 				sr_dbg("Setting logic pattern to %s",
 						logic_pattern_str[logic_pattern]);
 				devc->logic_pattern = logic_pattern;
-				/* Might as well do this now, these are static. */
-				if (logic_pattern == PATTERN_ALL_LOW)
-					memset(devc->logic_data, 0x00, LOGIC_BUFSIZE);
-				else if (logic_pattern == PATTERN_ALL_HIGH)
-					memset(devc->logic_data, 0xff, LOGIC_BUFSIZE);
 			} else if (ch->type == SR_CHANNEL_ANALOG) {
 				if (analog_pattern == -1)
 					return SR_ERR_ARG;
@@ -434,6 +465,35 @@ static int config_set(uint32_t key, GVariant *data,
 	case SR_CONF_CAPTURE_RATIO:
 		devc->capture_ratio = g_variant_get_uint64(data);
 		break;
+	case SR_CONF_UNTHROTTLED:
+		devc->unthrottled = g_variant_get_boolean(data);
+		break;
+	case SR_CONF_BUFFERSIZE:
+		num = g_variant_get_uint64(data);
+		if (num < 1 || num > LOGIC_BUFSIZE_MAX)
+			return SR_ERR_ARG;
+		devc->logic_bufsize = num;
+		break;
+	case SR_CONF_BURST_INTERVAL:
+		num = g_variant_get_uint64(data);
+		if (num < 1)
+			return SR_ERR_ARG;
+		devc->burst_interval = num;
+		break;
+	case SR_CONF_BURST_JITTER:
+		devc->burst_jitter = g_variant_get_uint64(data);
+		break;
+	case SR_CONF_EDGE_DENSITY:
+		density = g_variant_get_double(data);
+		if (density < 0.0 || density > 1.0)
+			return SR_ERR_ARG;
+		devc->edge_density = density;
+		break;
+	case SR_CONF_ANALOG_ENCODING:
+		if ((idx = std_str_idx(data, ARRAY_AND_SIZE(analog_encoding_str))) < 0)
+			return SR_ERR_ARG;
+		devc->analog_encoding = idx;
+		break;
 	default:
 		return SR_ERR_NA;
 	}
@@ -457,6 +517,9 @@ static int config_list(uint32_t key, GVariant **data,
 		case SR_CONF_TRIGGER_MATCH:
 			*data = std_gvar_array_i32(ARRAY_AND_SIZE(trigger_matches));
 			break;
+		case SR_CONF_ANALOG_ENCODING:
+			*data = g_variant_new_strv(ARRAY_AND_SIZE(analog_encoding_str));
+			break;
 		default:
 			return SR_ERR_NA;
 		}
@@ -495,12 +558,32 @@ static int config_list(uint32_t key, GVariant **data,
 	return SR_OK;
 }
 
+/* Whether the trigger has a match on an enabled analog channel. */
+static gboolean trigger_has_analog(const struct sr_trigger *trigger)
+{
+	struct sr_trigger_stage *stage;
+	struct sr_trigger_match *match;
+	GSList *l, *m;
+
+	for (l = trigger->stages; l; l = l->next) {
+		stage = l->data;
+		for (m = stage->matches; m; m = m->next) {
+			match = m->data;
+			if (match->channel->enabled
+					&& match->channel->type == SR_CHANNEL_ANALOG)
+				return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
 static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 {
 	struct dev_context *devc;
 	GSList *l;
 	struct sr_channel *ch;
-	int bitpos;
+	int bitpos, timeout;
 	uint8_t mask;
 	struct sr_trigger *trigger;
 
@@ -513,18 +596,34 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 		int pre_trigger_samples = 0;
 		if (devc->limit_samples > 0)
 			pre_trigger_samples = (devc->capture_ratio * devc->limit_samples) / 100;
-		devc->stl = soft_trigger_logic_new(sdi, trigger, pre_trigger_samples);
-		if (!devc->stl)
-			return SR_ERR_MALLOC;
-
-		/* Disable all analog channels since using them when there are logic
-		 * triggers set up would require having pre-trigger sample buffers
-		 * for analog sample data.
-		 */
-		for (l = sdi->channels; l; l = l->next) {
-			ch = l->data;
-			if (ch->type == SR_CHANNEL_ANALOG)
-				ch->enabled = FALSE;
+		if (trigger_has_analog(trigger)) {
+			devc->sta = soft_trigger_analog_new(sdi, trigger,
+				pre_trigger_samples, DEFAULT_ANALOG_AMPLITUDE / 100);
+			if (!devc->sta)
+				return SR_ERR_MALLOC;
+
+			/* Likewise, disable all logic channels when there are
+			 * analog triggers set up.
+			 */
+			for (l = sdi->channels; l; l = l->next) {
+				ch = l->data;
+				if (ch->type == SR_CHANNEL_LOGIC)
+					ch->enabled = FALSE;
+			}
+		} else {
+			devc->stl = soft_trigger_logic_new(sdi, trigger, pre_trigger_samples);
+			if (!devc->stl)
+				return SR_ERR_MALLOC;
+
+			/* Disable all analog channels since using them when there are logic
+			 * triggers set up would require having pre-trigger sample buffers
+			 * for analog sample data.
+			 */
+			for (l = sdi->channels; l; l = l->next) {
+				ch = l->data;
+				if (ch->type == SR_CHANNEL_ANALOG)
+					ch->enabled = FALSE;
+			}
 		}
 	}
 	devc->trigger_fired = FALSE;
@@ -567,7 +666,20 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 		devc->first_partial_logic_index,
 		devc->first_partial_logic_mask);
 
-	sr_session_source_add(sdi->session, -1, 0, 100,
+	/* The pattern depends on the enabled channels. */
+	demo_free_logic_ring(devc);
+	/* Packets hold at least one sample. */
+	devc->logic_data_size = MAX(devc->logic_bufsize, devc->logic_unitsize);
+	devc->logic_data = g_realloc(devc->logic_data, devc->logic_data_size);
+	devc->next_burst_us = 0;
+
+	if (devc->unthrottled)
+		timeout = 0;
+	else if (devc->burst_jitter)
+		timeout = 1;
+	else
+		timeout = devc->burst_interval;
+	sr_session_source_add(sdi->session, -1, 0, timeout,
 			demo_prepare_data, (struct sr_dev_inst *)sdi);
 
 	std_session_send_df_header(sdi);
@@ -599,6 +711,10 @@ static int dev_acquisition_stop(struct sr_dev_inst *sdi)
 		soft_trigger_logic_free(devc->stl);
 		devc->stl = NULL;
 	}
+	if (devc->sta) {
+		soft_trigger_analog_free(devc->sta);
+		devc->sta = NULL;
+	}
 
 	return SR_OK;
 }
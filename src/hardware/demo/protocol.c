@@ -246,7 +246,7 @@ SR_PRIV void demo_generate_analog_pattern(struct dev_context *devc)
 	devc->analog_patterns[PATTERN_SAWTOOTH] = pattern;
 
 	/* PATTERN_ANALOG_RANDOM */
-	/* Data not filled here, will be generated in send_analog_packet(). */
+	/* Data not filled here, will be generated in analog_generate(). */
 	pattern = g_malloc(sizeof(struct analog_pattern));
 	pattern->num_samples = last_end;
 	devc->analog_patterns[PATTERN_ANALOG_RANDOM] = pattern;
@@ -274,9 +274,56 @@ static void set_logic_data(uint64_t bits, uint8_t *data, size_t len)
 	}
 }
 
-static void logic_generator(struct sr_dev_inst *sdi, uint64_t size)
+/* xorshift64*, eight pseudo-random bytes per step. */
+static uint64_t random_next(uint64_t *state)
+{
+	uint64_t x;
+
+	x = *state ? *state : UINT64_C(0x9e3779b97f4a7c15);
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	*state = x;
+
+	return x * UINT64_C(0x2545f4914f6cdd1d);
+}
+
+static void random_fill(uint64_t *state, uint8_t *data, uint64_t size)
+{
+	uint64_t r;
+	size_t n;
+
+	while (size) {
+		r = random_next(state);
+		n = MIN(size, sizeof(r));
+		memcpy(data, &r, n);
+		data += n;
+		size -= n;
+	}
+}
+
+/*
+ * Number of channel states until the next edge, across all channels of
+ * all following samples. Geometrically distributed for the density.
+ */
+static uint64_t edge_gap(struct dev_context *devc)
+{
+	double u, gap;
+
+	if (devc->edge_density >= 1.0)
+		return 0;
+	if (devc->edge_density <= 0.0)
+		return UINT64_MAX / 2;
+	/* Uniform in (0, 1]. */
+	u = ((random_next(&devc->random_state) >> 11) + 1) * 0x1.0p-53;
+	gap = log(u) / log1p(-devc->edge_density);
+
+	return gap < UINT64_MAX / 2 ? gap : UINT64_MAX / 2;
+}
+
+static void logic_generator(struct dev_context *devc, uint8_t *data,
+		uint64_t size)
 {
-	struct dev_context *devc;
 	uint64_t i, j;
 	uint8_t pat;
 	uint8_t *sample;
@@ -284,35 +331,28 @@ static void logic_generator(struct sr_dev_inst *sdi, uint64_t size)
 	size_t col_count, col_height;
 	uint64_t gray;
 
-	devc = sdi->priv;
-
 	switch (devc->logic_pattern) {
 	case PATTERN_SIGROK:
-		memset(devc->logic_data, 0x00, size);
 		for (i = 0; i < size; i += devc->logic_unitsize) {
 			for (j = 0; j < devc->logic_unitsize; j++) {
 				pat = pattern_sigrok[(devc->step + j) % sizeof(pattern_sigrok)] >> 1;
-				devc->logic_data[i + j] = ~pat;
+				data[i + j] = ~pat;
 			}
 			devc->step++;
 		}
 		break;
 	case PATTERN_RANDOM:
-		for (i = 0; i < size; i++)
-			devc->logic_data[i] = (uint8_t)(rand() & 0xff);
+		random_fill(&devc->random_state, data, size);
 		break;
 	case PATTERN_INC:
-		for (i = 0; i < size; i++) {
-			for (j = 0; j < devc->logic_unitsize; j++)
-				devc->logic_data[i + j] = devc->step;
-			devc->step++;
-		}
+		for (i = 0; i < size; i++)
+			data[i] = devc->step++;
 		break;
 	case PATTERN_WALKING_ONE:
 		/* j contains the value of the highest bit */
 		j = 1 << (devc->num_logic_channels - 1);
 		for (i = 0; i < size; i++) {
-			devc->logic_data[i] = devc->step;
+			data[i] = devc->step;
 			if (devc->step == 0)
 				devc->step = 1;
 			else
@@ -327,7 +367,7 @@ static void logic_generator(struct sr_dev_inst *sdi, uint64_t size)
 		/* j contains the value of the highest bit */
 		j = 1 << (devc->num_logic_channels - 1);
 		for (i = 0; i < size; i++) {
-			devc->logic_data[i] = ~devc->step;
+			data[i] = ~devc->step;
 			if (devc->step == 0)
 				devc->step = 1;
 			else
@@ -338,15 +378,16 @@ static void logic_generator(struct sr_dev_inst *sdi, uint64_t size)
 		}
 		break;
 	case PATTERN_ALL_LOW:
+		memset(data, 0x00, size);
+		break;
 	case PATTERN_ALL_HIGH:
-		/* These were set when the pattern mode was selected. */
+		memset(data, 0xff, size);
 		break;
 	case PATTERN_SQUID:
-		memset(devc->logic_data, 0x00, size);
 		col_count = ARRAY_SIZE(pattern_squid);
 		col_height = ARRAY_SIZE(pattern_squid[0]);
 		for (i = 0; i < size; i += devc->logic_unitsize) {
-			sample = &devc->logic_data[i];
+			sample = &data[i];
 			image_col = pattern_squid[devc->step];
 			for (j = 0; j < devc->logic_unitsize; j++) {
 				pat = image_col[j % col_height];
@@ -362,7 +403,19 @@ static void logic_generator(struct sr_dev_inst *sdi, uint64_t size)
 			devc->step &= devc->all_logic_channels_mask;
 			gray = encode_number_to_gray(devc->step);
 			gray &= devc->all_logic_channels_mask;
-			set_logic_data(gray, &devc->logic_data[i], devc->logic_unitsize);
+			set_logic_data(gray, &data[i], devc->logic_unitsize);
+		}
+		break;
+	case PATTERN_SPARSE:
+		/* edge_skip counts channel states from this sample on. */
+		col_count = MIN(devc->num_logic_channels, 64);
+		for (i = 0; i < size; i += devc->logic_unitsize) {
+			while (devc->edge_skip < col_count) {
+				devc->edge_state ^= UINT64_C(1) << devc->edge_skip;
+				devc->edge_skip += 1 + edge_gap(devc);
+			}
+			devc->edge_skip -= col_count;
+			set_logic_data(devc->edge_state, &data[i], devc->logic_unitsize);
 		}
 		break;
 	default:
@@ -379,7 +432,7 @@ static void logic_generator(struct sr_dev_inst *sdi, uint64_t size)
  * of the enabled channels' data?
  */
 static void logic_fixup_feed(struct dev_context *devc,
-		struct sr_datafeed_logic *logic)
+		uint8_t *data, size_t length)
 {
 	size_t fp_off;
 	uint8_t fp_mask;
@@ -388,37 +441,197 @@ static void logic_fixup_feed(struct dev_context *devc,
 
 	fp_off = devc->first_partial_logic_index;
 	fp_mask = devc->first_partial_logic_mask;
-	if (fp_off == logic->unitsize)
+	if (fp_off == devc->logic_unitsize)
 		return;
 
-	for (off = 0; off < logic->length; off += logic->unitsize) {
-		sample = logic->data + off;
+	for (off = 0; off < length; off += devc->logic_unitsize) {
+		sample = data + off;
 		sample[fp_off] &= fp_mask;
-		for (idx = fp_off + 1; idx < logic->unitsize; idx++)
+		for (idx = fp_off + 1; idx < devc->logic_unitsize; idx++)
 			sample[idx] = 0x00;
 	}
 }
 
-static void send_analog_packet(struct analog_gen *ag,
-		struct sr_dev_inst *sdi, uint64_t *analog_sent,
+static size_t lcm(size_t a, size_t b)
+{
+	size_t x, y, t;
+
+	x = a;
+	y = b;
+	while (y) {
+		t = x % y;
+		x = y;
+		y = t;
+	}
+
+	return a / x * b;
+}
+
+/*
+ * Period of the logic pattern in bytes, a multiple of the unitsize.
+ * Returns 0 for patterns which don't repeat within LOGIC_RING_MAX.
+ */
+static size_t logic_pattern_period(const struct dev_context *devc)
+{
+	size_t period;
+
+	switch (devc->logic_pattern) {
+	case PATTERN_SIGROK:
+		period = sizeof(pattern_sigrok) * devc->logic_unitsize;
+		break;
+	case PATTERN_INC:
+		/* One byte after the other counts up. */
+		period = lcm(256, devc->logic_unitsize);
+		break;
+	case PATTERN_WALKING_ONE:
+	case PATTERN_WALKING_ZERO:
+		/* The all-zero state, then one state per channel, per byte. */
+		if (devc->num_logic_channels > 32)
+			return 0;
+		period = lcm(devc->num_logic_channels + 1, devc->logic_unitsize);
+		break;
+	case PATTERN_ALL_LOW:
+	case PATTERN_ALL_HIGH:
+		period = devc->logic_unitsize;
+		break;
+	case PATTERN_SQUID:
+		period = ARRAY_SIZE(pattern_squid) * devc->logic_unitsize;
+		break;
+	case PATTERN_GRAYCODE:
+		if (devc->num_logic_channels > 16)
+			return 0;
+		period = (devc->all_logic_channels_mask + 1) * devc->logic_unitsize;
+		break;
+	default:
+		return 0;
+	}
+
+	return period <= LOGIC_RING_MAX ? period : 0;
+}
+
+/*
+ * Generate one period of a repeating pattern, followed by as much data
+ * as the largest packet holds, so that packets can point into the ring
+ * at any position within the period.
+ */
+static void logic_ring_build(struct dev_context *devc)
+{
+	size_t period, size;
+	uint64_t step;
+
+	g_free(devc->logic_ring);
+	devc->logic_ring = NULL;
+	devc->logic_ring_pattern = devc->logic_pattern;
+	devc->logic_ring_pos = 0;
+	if (!(period = logic_pattern_period(devc)))
+		return;
+
+	size = period + devc->logic_data_size / devc->logic_unitsize * devc->logic_unitsize;
+	devc->logic_ring = g_malloc(size);
+	devc->logic_ring_period = period;
+	step = devc->step;
+	devc->step = 0;
+	logic_generator(devc, devc->logic_ring, size);
+	devc->step = step;
+	logic_fixup_feed(devc, devc->logic_ring, size);
+	sr_dbg("Pattern repeats every %zu bytes.", period);
+}
+
+/**
+ * Drop the precomputed logic pattern, the next packet rebuilds it.
+ * Needed when the channel setup changes.
+ */
+SR_PRIV void demo_free_logic_ring(struct dev_context *devc)
+{
+	g_free(devc->logic_ring);
+	devc->logic_ring = NULL;
+	devc->logic_ring_pattern = -1;
+}
+
+/* Get the next 'size' bytes of logic data for the session feed. */
+static uint8_t *logic_data_next(struct dev_context *devc, size_t size)
+{
+	uint8_t *data;
+
+	if (devc->logic_ring_pattern != (int)devc->logic_pattern)
+		logic_ring_build(devc);
+
+	if (devc->logic_ring) {
+		data = devc->logic_ring + devc->logic_ring_pos;
+		devc->logic_ring_pos = (devc->logic_ring_pos + size)
+			% devc->logic_ring_period;
+		return data;
+	}
+
+	logic_generator(devc, devc->logic_data, size);
+	logic_fixup_feed(devc, devc->logic_data, size);
+
+	return devc->logic_data;
+}
+
+/* Send analog samples, converted to the selected encoding. */
+static void analog_send(struct dev_context *devc, struct analog_gen *ag,
+		struct sr_dev_inst *sdi, struct sr_datafeed_packet *packet)
+{
+	struct sr_analog_encoding float_encoding;
+	const float *values;
+	int8_t *raw8;
+	float max;
+	long imax, value;
+	uint64_t q;
+	unsigned int i;
+	int digits;
+	void *data;
+
+	if (devc->analog_encoding == ENCODING_FLOAT) {
+		sr_session_send(sdi, packet);
+		return;
+	}
+
+	/* The finest decimal resolution which covers the signal's range. */
+	imax = devc->analog_encoding == ENCODING_INT16 ? INT16_MAX : INT8_MAX;
+	max = fabsf(ag->amplitude) + fabsf(ag->offset);
+	for (digits = 6, q = 1000000; digits > 0 && max * q > imax; digits--)
+		q /= 10;
+
+	values = ag->packet.data;
+	raw8 = (int8_t *)ag->raw;
+	for (i = 0; i < ag->packet.num_samples; i++) {
+		value = CLAMP(lrintf(values[i] * q), -imax, imax);
+		if (devc->analog_encoding == ENCODING_INT16)
+			ag->raw[i] = value;
+		else
+			raw8[i] = value;
+	}
+
+	float_encoding = *ag->packet.encoding;
+	ag->packet.encoding->unitsize = devc->analog_encoding == ENCODING_INT16 ? 2 : 1;
+	ag->packet.encoding->is_float = FALSE;
+	ag->packet.encoding->digits = digits;
+	sr_rational_set(&ag->packet.encoding->scale, 1, q);
+	data = ag->packet.data;
+	ag->packet.data = ag->raw;
+	sr_session_send(sdi, packet);
+	ag->packet.data = data;
+	*ag->packet.encoding = float_encoding;
+}
+
+/* Generate the next samples of an analog channel, without sending them. */
+static void analog_generate(struct analog_gen *ag, struct sr_dev_inst *sdi,
 		uint64_t analog_pos, uint64_t analog_todo)
 {
-	struct sr_datafeed_packet packet;
 	struct dev_context *devc;
 	struct analog_pattern *pattern;
-	uint64_t sending_now, to_avg;
+	uint64_t sending_now;
 	int ag_pattern_pos;
 	unsigned int i;
-	float amplitude, offset, value;
+	float amplitude, offset;
 	float *data;
 
 	if (!ag->ch || !ag->ch->enabled)
 		return;
 
 	devc = sdi->priv;
-	packet.type = SR_DF_ANALOG;
-	packet.payload = &ag->packet;
-
 	pattern = devc->analog_patterns[ag->pattern];
 
 	ag->packet.meaning->channels = g_slist_append(NULL, ag->ch);
@@ -524,7 +737,73 @@ static void send_analog_packet(struct analog_gen *ag,
 			ag->packet.data = pattern->data + ag_pattern_pos;
 		}
 		ag->packet.num_samples = sending_now;
-		sr_session_send(sdi, &packet);
+	}
+}
+
+/*
+ * Check the samples of all analog channels of a round for the trigger,
+ * and send the pre-trigger data when it fires. Returns the offset of
+ * the trigger in the round, or -1 when it did not fire.
+ */
+static int64_t analog_trigger_check(struct sr_dev_inst *sdi)
+{
+	struct dev_context *devc;
+	struct analog_gen *ag;
+	GHashTableIter iter;
+	void *value;
+	int64_t trigger_offset;
+
+	devc = sdi->priv;
+	g_hash_table_iter_init(&iter, devc->ch_ag);
+	while (g_hash_table_iter_next(&iter, NULL, &value)) {
+		ag = value;
+		if (!ag->ch || !ag->ch->enabled)
+			continue;
+		trigger_offset = soft_trigger_analog_check(devc->sta,
+				&ag->packet, NULL);
+		if (trigger_offset > -1) {
+			devc->trigger_fired = TRUE;
+			return trigger_offset;
+		}
+	}
+
+	return -1;
+}
+
+static void send_analog_packet(struct analog_gen *ag,
+		struct sr_dev_inst *sdi, uint64_t *analog_sent,
+		uint64_t analog_pos, uint64_t analog_todo, int64_t trigger_offset)
+{
+	struct sr_datafeed_packet packet;
+	struct dev_context *devc;
+	struct analog_pattern *pattern;
+	uint64_t sending_now, to_avg;
+	int ag_pattern_pos;
+	unsigned int i;
+	float amplitude, offset, value;
+	float *data;
+
+	if (!ag->ch || !ag->ch->enabled)
+		return;
+
+	devc = sdi->priv;
+	packet.type = SR_DF_ANALOG;
+	packet.payload = &ag->packet;
+
+	pattern = devc->analog_patterns[ag->pattern];
+
+	if (!devc->avg) {
+		/* All channels of the round start at the trigger point. */
+		sending_now = ag->packet.num_samples;
+		if ((!devc->sta || devc->trigger_fired)
+				&& trigger_offset < (int64_t)sending_now) {
+			data = ag->packet.data;
+			ag->packet.data = data + trigger_offset;
+			ag->packet.num_samples = sending_now - trigger_offset;
+			analog_send(devc, ag, sdi, &packet);
+			ag->packet.data = data;
+			ag->packet.num_samples = sending_now;
+		}
 
 		/* Whichever channel group gets there first. */
 		*analog_sent = MAX(*analog_sent, sending_now);
@@ -582,8 +861,9 @@ SR_PRIV int demo_prepare_data(int fd, int revents, void *cb_data)
 	struct analog_gen *ag;
 	GHashTableIter iter;
 	void *value;
+	uint8_t *logic_data;
 	uint64_t samples_todo, logic_done, analog_done, analog_sent, sending_now;
-	int64_t elapsed_us, limit_us, todo_us;
+	int64_t elapsed_us, limit_us, todo_us, now_us, jitter_us, interval_us;
 	int64_t trigger_offset;
 	int pre_trigger_samples;
 
@@ -601,8 +881,20 @@ SR_PRIV int demo_prepare_data(int fd, int revents, void *cb_data)
 		return G_SOURCE_CONTINUE;
 	}
 
+	/* With jitter, the timer fires often and bursts get picked here. */
+	now_us = g_get_monotonic_time();
+	if (devc->burst_jitter && !devc->unthrottled) {
+		if (now_us < devc->next_burst_us)
+			return G_SOURCE_CONTINUE;
+		jitter_us = 1000 * devc->burst_jitter;
+		interval_us = (int64_t)(1000 * devc->burst_interval) - jitter_us
+			+ (int64_t)(random_next(&devc->random_state)
+			% (2 * jitter_us + 1));
+		devc->next_burst_us = now_us + MAX(0, interval_us);
+	}
+
 	/* What time span should we send samples for? */
-	elapsed_us = g_get_monotonic_time() - devc->start_us;
+	elapsed_us = now_us - devc->start_us;
 	limit_us = 1000 * devc->limit_msec;
 	if (limit_us > 0 && limit_us < elapsed_us)
 		todo_us = MAX(0, limit_us - devc->spent_us);
@@ -610,8 +902,11 @@ SR_PRIV int demo_prepare_data(int fd, int revents, void *cb_data)
 		todo_us = MAX(0, elapsed_us - devc->spent_us);
 
 	/* How many samples are outstanding since the last round? */
-	samples_todo = (todo_us * devc->cur_samplerate + G_USEC_PER_SEC - 1)
-			/ G_USEC_PER_SEC;
+	if (devc->unthrottled)
+		samples_todo = UNTHROTTLED_SAMPLES;
+	else
+		samples_todo = (todo_us * devc->cur_samplerate + G_USEC_PER_SEC - 1)
+				/ G_USEC_PER_SEC;
 
 	if (devc->limit_samples > 0) {
 		if (devc->limit_samples < devc->sent_samples)
@@ -635,7 +930,8 @@ SR_PRIV int demo_prepare_data(int fd, int revents, void *cb_data)
 	 * count, rounded towards zero. This avoids getting stuck on a too-low
 	 * time delta with no samples being sent due to round-off.
 	 */
-	todo_us = samples_todo * G_USEC_PER_SEC / devc->cur_samplerate;
+	if (!devc->unthrottled)
+		todo_us = samples_todo * G_USEC_PER_SEC / devc->cur_samplerate;
 
 	logic_done = devc->num_logic_channels > 0 ? 0 : samples_todo;
 	if (!devc->enabled_logic_channels)
@@ -649,12 +945,12 @@ SR_PRIV int demo_prepare_data(int fd, int revents, void *cb_data)
 		/* Logic */
 		if (logic_done < samples_todo) {
 			sending_now = MIN(samples_todo - logic_done,
-					LOGIC_BUFSIZE / devc->logic_unitsize);
-			logic_generator(sdi, sending_now * devc->logic_unitsize);
+					devc->logic_data_size / devc->logic_unitsize);
+			logic_data = logic_data_next(devc, sending_now * devc->logic_unitsize);
 			/* Check for trigger and send pre-trigger data if needed */
 			if (devc->stl && (!devc->trigger_fired)) {
 				trigger_offset = soft_trigger_logic_check(devc->stl,
-						devc->logic_data, sending_now * devc->logic_unitsize,
+						logic_data, sending_now * devc->logic_unitsize,
 						&pre_trigger_samples);
 				if (trigger_offset > -1) {
 					devc->trigger_fired = TRUE;
@@ -672,8 +968,7 @@ SR_PRIV int demo_prepare_data(int fd, int revents, void *cb_data)
 				if (devc->trigger_fired && (trigger_offset < (int)sending_now)) {
 					/* Send after-trigger data */
 					logic.length = (sending_now - trigger_offset) * devc->logic_unitsize;
-					logic.data = devc->logic_data + trigger_offset * devc->logic_unitsize;
-					logic_fixup_feed(devc, &logic);
+					logic.data = logic_data + trigger_offset * devc->logic_unitsize;
 					sr_session_send(sdi, &packet);
 					logic_done += sending_now - trigger_offset;
 					/* End acquisition */
@@ -687,8 +982,7 @@ SR_PRIV int demo_prepare_data(int fd, int revents, void *cb_data)
 			} else if (!devc->stl) {
 				/* No trigger defined, send logic samples */
 				logic.length = sending_now * devc->logic_unitsize;
-				logic.data = devc->logic_data;
-				logic_fixup_feed(devc, &logic);
+				logic.data = logic_data;
 				sr_session_send(sdi, &packet);
 				logic_done += sending_now;
 			}
@@ -700,10 +994,23 @@ SR_PRIV int demo_prepare_data(int fd, int revents, void *cb_data)
 
 			g_hash_table_iter_init(&iter, devc->ch_ag);
 			while (g_hash_table_iter_next(&iter, NULL, &value)) {
-				send_analog_packet(value, sdi, &analog_sent,
+				analog_generate(value, sdi,
 						devc->sent_samples + analog_done,
 						samples_todo - analog_done);
 			}
+
+			/* Check for trigger and send pre-trigger data if needed. */
+			trigger_offset = 0;
+			if (devc->sta && !devc->trigger_fired && !devc->avg)
+				trigger_offset = analog_trigger_check(sdi);
+
+			g_hash_table_iter_init(&iter, devc->ch_ag);
+			while (g_hash_table_iter_next(&iter, NULL, &value)) {
+				send_analog_packet(value, sdi, &analog_sent,
+						devc->sent_samples + analog_done,
+						samples_todo - analog_done,
+						trigger_offset);
+			}
 			analog_done += analog_sent;
 		}
 	}
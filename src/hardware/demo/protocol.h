@@ -30,13 +30,21 @@
 
 #define LOG_PREFIX "demo"
 
-/* The size in bytes of chunks to send through the session bus. */
+/* The default size in bytes of chunks to send through the session bus. */
 #define LOGIC_BUFSIZE			4096
+#define LOGIC_BUFSIZE_MAX		(1024 * 1024)
+/* Longest period in bytes of logic patterns which get precomputed. */
+#define LOGIC_RING_MAX			(256 * 1024)
+/* Samples per round when generating as fast as they get consumed. */
+#define UNTHROTTLED_SAMPLES		(64 * 1024)
 /* Size of the analog pattern space per channel. */
 #define ANALOG_BUFSIZE			4096
 /* This is a development feature: it starts a new frame every n samples. */
 #define SAMPLES_PER_FRAME		1000UL
 #define DEFAULT_LIMIT_FRAMES		0
+/* Milliseconds between deliveries of data. */
+#define DEFAULT_BURST_INTERVAL		100
+#define DEFAULT_EDGE_DENSITY		0.01
 
 #define DEFAULT_ANALOG_ENCODING_DIGITS	4
 #define DEFAULT_ANALOG_SPEC_DIGITS		4
@@ -87,6 +95,12 @@ enum logic_pattern_type {
 
 	/** Gray encoded data, like rotary encoder signals. */
 	PATTERN_GRAYCODE,
+
+	/**
+	 * Channels change their state at random, at the rate of the
+	 * edge density. Covers the first 64 channels.
+	 */
+	PATTERN_SPARSE,
 };
 
 /* Analog patterns we can generate. */
@@ -106,6 +120,19 @@ static const char *analog_pattern_str[] = {
 	"random",
 };
 
+/* Encodings of analog samples we can send. */
+enum analog_encoding_type {
+	ENCODING_FLOAT,
+	ENCODING_INT16,
+	ENCODING_INT8,
+};
+
+static const char *analog_encoding_str[] = {
+	"float",
+	"int16",
+	"int8",
+};
+
 struct analog_pattern {
 	float data[ANALOG_BUFSIZE];
 	unsigned int num_samples;
@@ -127,9 +154,26 @@ struct dev_context {
 	uint64_t all_logic_channels_mask;
 	/* There is only ever one logic channel group, so its pattern goes here. */
 	enum logic_pattern_type logic_pattern;
-	uint8_t logic_data[LOGIC_BUFSIZE];
+	uint8_t *logic_data;
+	/* Configured packet size, and the one of the acquisition. */
+	size_t logic_bufsize;
+	size_t logic_data_size;
+	double edge_density;
+	uint64_t edge_state;
+	uint64_t edge_skip;
+	/* Precomputed periodic pattern, packets point into it. */
+	uint8_t *logic_ring;
+	size_t logic_ring_period;
+	size_t logic_ring_pos;
+	int logic_ring_pattern;
+	uint64_t random_state;
+	gboolean unthrottled;
+	uint64_t burst_interval;
+	uint64_t burst_jitter;
+	int64_t next_burst_us;
 	/* Analog */
 	struct analog_pattern *analog_patterns[ARRAY_SIZE(analog_pattern_str)];
+	enum analog_encoding_type analog_encoding;
 	int32_t num_analog_channels;
 	GHashTable *ch_ag;
 	gboolean avg; /* True if averaging is enabled */
@@ -142,6 +186,7 @@ struct dev_context {
 	uint64_t capture_ratio;
 	gboolean trigger_fired;
 	struct soft_trigger_logic *stl;
+	struct soft_trigger_analog *sta;
 };
 
 struct analog_gen {
@@ -158,10 +203,13 @@ struct analog_gen {
 	struct sr_analog_spec spec;
 	float avg_val; /* Average value */
 	unsigned int num_avgs; /* Number of samples averaged */
+	/* Samples in an integer encoding, see analog_encoding. */
+	int16_t raw[ANALOG_BUFSIZE / sizeof(float)];
 };
 
 SR_PRIV void demo_generate_analog_pattern(struct dev_context *devc);
 SR_PRIV void demo_free_analog_pattern(struct dev_context *devc);
+SR_PRIV void demo_free_logic_ring(struct dev_context *devc);
 SR_PRIV int demo_prepare_data(int fd, int revents, void *cb_data);
 
 #endif
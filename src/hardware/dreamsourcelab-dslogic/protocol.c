@@ -256,13 +256,24 @@ SR_PRIV int dslogic_fpga_firmware_upload(const struct sr_dev_inst *sdi)
 		return SR_ERR;
 	}
 
-	sr_dbg("Uploading FPGA firmware '%s'.", name);
-
 	result = sr_resource_open(drvc->sr_ctx, &bitstream,
 			SR_RESOURCE_FIRMWARE, name);
 	if (result != SR_OK)
 		return result;
 
+	/* The device still runs this image since it was last opened. */
+	if (!devc->force_upload &&
+			sr_usb_fpga_image_current(usb, name, bitstream.size)) {
+		sr_resource_close(drvc->sr_ctx, &bitstream);
+		sr_dbg("FPGA firmware '%s' already loaded.", name);
+		return SR_OK;
+	}
+
+	sr_dbg("Uploading FPGA firmware '%s'.", name);
+	sr_usb_fpga_image_record(usb, NULL, 0);
+	g_free(devc->fpga_cfg);
+	devc->fpga_cfg = NULL;
+
 	/* Tell the device firmware is coming. */
 	if ((ret = libusb_control_transfer(usb->devhdl, LIBUSB_REQUEST_TYPE_VENDOR |
 			LIBUSB_ENDPOINT_OUT, DS_CMD_CONFIG, 0x0000, 0x0000,
@@ -306,32 +317,22 @@ SR_PRIV int dslogic_fpga_firmware_upload(const struct sr_dev_inst *sdi)
 	g_free(buf);
 	sr_resource_close(drvc->sr_ctx, &bitstream);
 
-	if (result == SR_OK)
+	if (result == SR_OK) {
 		sr_dbg("FPGA firmware upload done.");
+		sr_usb_fpga_image_record(usb, name, bitstream.size);
+	}
 
 	return result;
 }
 
 static unsigned int enabled_channel_count(const struct sr_dev_inst *sdi)
 {
-	unsigned int count = 0;
-	for (const GSList *l = sdi->channels; l; l = l->next) {
-		const struct sr_channel *const probe = (struct sr_channel *)l->data;
-		if (probe->enabled)
-			count++;
-	}
-	return count;
+	return sr_dev_channel_cache_get(sdi)->num_enabled;
 }
 
 static uint16_t enabled_channel_mask(const struct sr_dev_inst *sdi)
 {
-	unsigned int mask = 0;
-	for (const GSList *l = sdi->channels; l; l = l->next) {
-		const struct sr_channel *const probe = (struct sr_channel *)l->data;
-		if (probe->enabled)
-			mask |= 1 << probe->index;
-	}
-	return mask;
+	return sr_dev_channel_cache_get(sdi)->logic_enabled_mask;
 }
 
 /*
@@ -427,7 +428,7 @@ static bool set_trigger(const struct sr_dev_inst *sdi, struct fpga_config *cfg)
 
 static int fpga_configure(const struct sr_dev_inst *sdi)
 {
-	const struct dev_context *const devc = sdi->priv;
+	struct dev_context *const devc = sdi->priv;
 	const struct sr_usb_dev_inst *const usb = sdi->conn;
 	uint8_t c[3];
 	struct fpga_config cfg;
@@ -435,8 +436,7 @@ static int fpga_configure(const struct sr_dev_inst *sdi)
 	uint32_t divider;
 	int transferred, len, ret;
 
-	sr_dbg("Configuring FPGA.");
-
+	memset(&cfg, 0, sizeof(cfg));
 	WL32(&cfg.sync, DS_CFG_START);
 	WL16(&cfg.mode_header, DS_CFG_MODE);
 	WL16(&cfg.divider_header, DS_CFG_DIVIDER);
@@ -447,21 +447,6 @@ static int fpga_configure(const struct sr_dev_inst *sdi)
 	WL16(&cfg.trig_header, DS_CFG_TRIG);
 	WL32(&cfg.end_sync, DS_CFG_END);
 
-	/* Pass in the length of a fixed-size struct. Really. */
-	len = sizeof(struct fpga_config) / 2;
-	c[0] = len & 0xff;
-	c[1] = (len >> 8) & 0xff;
-	c[2] = (len >> 16) & 0xff;
-
-	ret = libusb_control_transfer(usb->devhdl, LIBUSB_REQUEST_TYPE_VENDOR |
-			LIBUSB_ENDPOINT_OUT, DS_CMD_SETTING, 0x0000, 0x0000,
-			c, sizeof(c), USB_TIMEOUT);
-	if (ret < 0) {
-		sr_err("Failed to send FPGA configure command: %s.",
-			libusb_error_name(ret));
-		return SR_ERR;
-	}
-
 	if (set_trigger(sdi, &cfg))
 		mode |= DS_MODE_TRIG_EN;
 
@@ -500,6 +485,35 @@ static int fpga_configure(const struct sr_dev_inst *sdi)
 	/* Number of 16-sample units. */
 	WL32(&cfg.count, devc->limit_samples / 16);
 
+	/*
+	 * The FPGA keeps its configuration until the bitstream gets
+	 * uploaded again. Re-arming with the same settings, triggers
+	 * included, doesn't need another configuration transfer.
+	 */
+	if (devc->fpga_cfg && !memcmp(devc->fpga_cfg, &cfg, sizeof(cfg))) {
+		sr_dbg("FPGA configuration unchanged.");
+		return SR_OK;
+	}
+	g_free(devc->fpga_cfg);
+	devc->fpga_cfg = NULL;
+
+	sr_dbg("Configuring FPGA.");
+
+	/* Pass in the length of a fixed-size struct. Really. */
+	len = sizeof(struct fpga_config) / 2;
+	c[0] = len & 0xff;
+	c[1] = (len >> 8) & 0xff;
+	c[2] = (len >> 16) & 0xff;
+
+	ret = libusb_control_transfer(usb->devhdl, LIBUSB_REQUEST_TYPE_VENDOR |
+			LIBUSB_ENDPOINT_OUT, DS_CMD_SETTING, 0x0000, 0x0000,
+			c, sizeof(c), USB_TIMEOUT);
+	if (ret < 0) {
+		sr_err("Failed to send FPGA configure command: %s.",
+			libusb_error_name(ret));
+		return SR_ERR;
+	}
+
 	len = sizeof(struct fpga_config);
 	ret = libusb_bulk_transfer(usb->devhdl, 2 | LIBUSB_ENDPOINT_OUT,
 			(unsigned char *)&cfg, len, &transferred, USB_TIMEOUT);
@@ -508,6 +522,8 @@ static int fpga_configure(const struct sr_dev_inst *sdi)
 		return SR_ERR;
 	}
 
+	devc->fpga_cfg = g_memdup(&cfg, sizeof(cfg));
+
 	return SR_OK;
 }
 
@@ -551,7 +567,7 @@ SR_PRIV int dslogic_dev_open(struct sr_dev_inst *sdi, struct sr_dev_driver *di)
 	devc = sdi->priv;
 	usb = sdi->conn;
 
-	device_count = libusb_get_device_list(drvc->sr_ctx->libusb_ctx, &devlist);
+	device_count = sr_usb_device_list(drvc->sr_ctx, &devlist);
 	if (device_count < 0) {
 		sr_err("Failed to get device list: %s.",
 		       libusb_error_name(device_count));
@@ -662,90 +678,41 @@ SR_PRIV struct dev_context *dslogic_dev_new(void)
 
 static void abort_acquisition(struct dev_context *devc)
 {
-	int i;
-
 	devc->acq_aborted = TRUE;
 
-	for (i = devc->num_transfers - 1; i >= 0; i--) {
-		if (devc->transfers[i])
-			libusb_cancel_transfer(devc->transfers[i]);
-	}
+	if (devc->trigger_transfer)
+		libusb_cancel_transfer(devc->trigger_transfer);
+	sr_usb_stream_stop(devc->stream);
 }
 
-static void finish_acquisition(struct sr_dev_inst *sdi)
-{
-	struct dev_context *devc;
-
-	devc = sdi->priv;
-
-	std_session_send_df_end(sdi);
-
-	usb_source_remove(sdi->session, devc->ctx);
-
-	devc->num_transfers = 0;
-	g_free(devc->transfers);
-	g_free(devc->deinterleave_buffer);
-}
+static int arm_trigger(const struct sr_dev_inst *sdi);
 
-static void free_transfer(struct libusb_transfer *transfer)
+static void finish_acquisition(struct sr_dev_inst *sdi, void *cb_data)
 {
-	struct sr_dev_inst *sdi;
 	struct dev_context *devc;
-	unsigned int i;
 
-	sdi = transfer->user_data;
-	devc = sdi->priv;
+	(void)cb_data;
 
-	g_free(transfer->buffer);
-	transfer->buffer = NULL;
-	libusb_free_transfer(transfer);
+	devc = sdi->priv;
+	devc->stream = NULL;
 
-	for (i = 0; i < devc->num_transfers; i++) {
-		if (devc->transfers[i] == transfer) {
-			devc->transfers[i] = NULL;
-			break;
+	if (devc->limit_frames) {
+		std_session_send_df_frame_end(sdi);
+		devc->num_frames++;
+		/*
+		 * This runs from libusb's event handling, which must not
+		 * make synchronous requests. Arm the next shot from the
+		 * main loop, unless stopped.
+		 */
+		if (!devc->acq_aborted && devc->num_frames < devc->limit_frames) {
+			devc->rearm_pending = TRUE;
+			return;
 		}
 	}
 
-	devc->submitted_transfers--;
-	if (devc->submitted_transfers == 0)
-		finish_acquisition(sdi);
-}
-
-static void resubmit_transfer(struct libusb_transfer *transfer)
-{
-	int ret;
-
-	if ((ret = libusb_submit_transfer(transfer)) == LIBUSB_SUCCESS)
-		return;
-
-	sr_err("%s: %s", __func__, libusb_error_name(ret));
-	free_transfer(transfer);
-
-}
+	std_session_send_df_end(sdi);
 
-static void deinterleave_buffer(const uint8_t *src, size_t length,
-	uint16_t *dst_ptr, size_t channel_count, uint16_t channel_mask)
-{
-	uint16_t sample;
-
-	for (const uint64_t *src_ptr = (uint64_t*)src;
-		src_ptr < (uint64_t*)(src + length);
-		src_ptr += channel_count) {
-		for (int bit = 0; bit != 64; bit++) {
-			const uint64_t *word_ptr = src_ptr;
-			sample = 0;
-			for (unsigned int channel = 0; channel != 16;
-				channel++) {
-				const uint16_t m = channel_mask >> channel;
-				if (!m)
-					break;
-				if ((m & 1) && ((*word_ptr++ >> bit) & UINT64_C(1)))
-					sample |= 1 << channel;
-			}
-			*dst_ptr++ = sample;
-		}
-	}
+	usb_source_remove(sdi->session, devc->ctx);
 }
 
 static void send_data(struct sr_dev_inst *sdi,
@@ -765,63 +732,23 @@ static void send_data(struct sr_dev_inst *sdi,
 	sr_session_send(sdi, &packet);
 }
 
-static void LIBUSB_CALL receive_transfer(struct libusb_transfer *transfer)
+static gboolean receive_transfer(struct sr_dev_inst *sdi,
+	uint8_t *data, size_t length, void *cb_data)
 {
-	struct sr_dev_inst *const sdi = transfer->user_data;
 	struct dev_context *const devc = sdi->priv;
 	const size_t channel_count = enabled_channel_count(sdi);
 	const uint16_t channel_mask = enabled_channel_mask(sdi);
 	const unsigned int cur_sample_count = DSLOGIC_ATOMIC_SAMPLES *
-		transfer->actual_length /
-		(DSLOGIC_ATOMIC_BYTES * channel_count);
+		length / (DSLOGIC_ATOMIC_BYTES * channel_count);
 
-	gboolean packet_has_error = FALSE;
 	unsigned int num_samples;
 	int trigger_offset;
 
-	/*
-	 * If acquisition has already ended, just free any queued up
-	 * transfer that come in.
-	 */
-	if (devc->acq_aborted) {
-		free_transfer(transfer);
-		return;
-	}
-
-	sr_dbg("receive_transfer(): status %s received %d bytes.",
-		libusb_error_name(transfer->status), transfer->actual_length);
+	(void)cb_data;
 
-	/* Save incoming transfer before reusing the transfer struct. */
-
-	switch (transfer->status) {
-	case LIBUSB_TRANSFER_NO_DEVICE:
-		abort_acquisition(devc);
-		free_transfer(transfer);
-		return;
-	case LIBUSB_TRANSFER_COMPLETED:
-	case LIBUSB_TRANSFER_TIMED_OUT: /* We may have received some data though. */
-		break;
-	default:
-		packet_has_error = TRUE;
-		break;
-	}
-
-	if (transfer->actual_length == 0 || packet_has_error) {
-		devc->empty_transfer_count++;
-		if (devc->empty_transfer_count > MAX_EMPTY_TRANSFERS) {
-			/*
-			 * The FX2 gave up. End the acquisition, the frontend
-			 * will work out that the samplecount is short.
-			 */
-			abort_acquisition(devc);
-			free_transfer(transfer);
-		} else {
-			resubmit_transfer(transfer);
-		}
-		return;
-	} else {
-		devc->empty_transfer_count = 0;
-	}
+	/* Nothing to do once the acquisition has ended. */
+	if (devc->acq_aborted)
+		return FALSE;
 
 	if (!devc->limit_samples || devc->sent_samples < devc->limit_samples) {
 		if (devc->limit_samples && devc->sent_samples + cur_sample_count > devc->limit_samples)
@@ -840,9 +767,9 @@ static void LIBUSB_CALL receive_transfer(struct libusb_transfer *transfer)
 		 *
 		 * Hopefully in future it will be possible to pass the data on as-is.
 		 */
-		if (transfer->actual_length % (DSLOGIC_ATOMIC_BYTES * channel_count) != 0)
+		if (length % (DSLOGIC_ATOMIC_BYTES * channel_count) != 0)
 			sr_err("Invalid transfer length!");
-		deinterleave_buffer(transfer->buffer, transfer->actual_length,
+		sr_simd_deinterleave_words(SR_SIMD_WORD64LE_LSB, data, length,
 			devc->deinterleave_buffer, channel_count, channel_mask);
 
 		/* Send the incoming transfer to the session bus. */
@@ -867,26 +794,35 @@ static void LIBUSB_CALL receive_transfer(struct libusb_transfer *transfer)
 		}
 	}
 
-	if (devc->limit_samples && devc->sent_samples >= devc->limit_samples) {
-		abort_acquisition(devc);
-		free_transfer(transfer);
-	} else
-		resubmit_transfer(transfer);
+	return !devc->limit_samples || devc->sent_samples < devc->limit_samples;
 }
 
 static int receive_data(int fd, int revents, void *cb_data)
 {
 	struct timeval tv;
+	const struct sr_dev_inst *sdi;
+	struct dev_context *devc;
 	struct drv_context *drvc;
 
 	(void)fd;
 	(void)revents;
 
-	drvc = (struct drv_context *)cb_data;
+	sdi = cb_data;
+	devc = sdi->priv;
+	drvc = sdi->driver->context;
 
 	tv.tv_sec = tv.tv_usec = 0;
 	libusb_handle_events_timeout(drvc->sr_ctx->libusb_ctx, &tv);
 
+	if (devc->rearm_pending) {
+		/* The previous shot is done, arm the next one. */
+		devc->rearm_pending = FALSE;
+		if (devc->acq_aborted || arm_trigger(sdi) != SR_OK) {
+			std_session_send_df_end(sdi);
+			usb_source_remove(sdi->session, devc->ctx);
+		}
+	}
+
 	return TRUE;
 }
 
@@ -938,63 +874,57 @@ static int start_transfers(const struct sr_dev_inst *sdi)
 {
 	const size_t channel_count = enabled_channel_count(sdi);
 	const size_t size = get_buffer_size(sdi);
-	const unsigned int num_transfers = get_number_of_transfers(sdi);
-	const unsigned int timeout = get_timeout(sdi);
 
 	struct dev_context *devc;
 	struct sr_usb_dev_inst *usb;
-	struct libusb_transfer *transfer;
-	unsigned int i;
+	struct sr_usb_stream_params params;
+	uint16_t *dbuf;
+	size_t dsize;
 	int ret;
-	unsigned char *buf;
 
 	devc = sdi->priv;
 	usb = sdi->conn;
 
 	devc->sent_samples = 0;
 	devc->acq_aborted = FALSE;
-	devc->empty_transfer_count = 0;
-	devc->submitted_transfers = 0;
-
-	g_free(devc->transfers);
-	devc->transfers = g_try_malloc0(sizeof(*devc->transfers) * num_transfers);
-	if (!devc->transfers) {
-		sr_err("USB transfers malloc failed.");
-		return SR_ERR_MALLOC;
-	}
 
-	devc->deinterleave_buffer = g_try_malloc(DSLOGIC_ATOMIC_SAMPLES *
-		(size / (channel_count * DSLOGIC_ATOMIC_BYTES)) * sizeof(uint16_t));
-	if (!devc->deinterleave_buffer) {
-		sr_err("Deinterleave buffer malloc failed.");
-		g_free(devc->deinterleave_buffer);
-		return SR_ERR_MALLOC;
-	}
-
-	devc->num_transfers = num_transfers;
-	for (i = 0; i < num_transfers; i++) {
-		if (!(buf = g_try_malloc(size))) {
-			sr_err("USB transfer buffer malloc failed.");
+	dsize = DSLOGIC_ATOMIC_SAMPLES *
+		(size / (channel_count * DSLOGIC_ATOMIC_BYTES)) * sizeof(uint16_t);
+	if (dsize > devc->deinterleave_buffer_size) {
+		dbuf = g_try_realloc(devc->deinterleave_buffer, dsize);
+		if (!dbuf) {
+			sr_err("Deinterleave buffer malloc failed.");
 			return SR_ERR_MALLOC;
 		}
-		transfer = libusb_alloc_transfer(0);
-		libusb_fill_bulk_transfer(transfer, usb->devhdl,
-				6 | LIBUSB_ENDPOINT_IN, buf, size,
-				receive_transfer, (void *)sdi, timeout);
-		sr_info("submitting transfer: %d", i);
-		if ((ret = libusb_submit_transfer(transfer)) != 0) {
-			sr_err("Failed to submit transfer: %s.",
-			       libusb_error_name(ret));
-			libusb_free_transfer(transfer);
-			g_free(buf);
-			abort_acquisition(devc);
-			return SR_ERR;
-		}
-		devc->transfers[i] = transfer;
-		devc->submitted_transfers++;
+		devc->deinterleave_buffer = dbuf;
+		devc->deinterleave_buffer_size = dsize;
 	}
 
-	std_session_send_df_header(sdi);
+	/* Keep the device's buffers while their size remains. */
+	if (devc->xfer_pool && sr_usb_xfer_pool_buffer_size(devc->xfer_pool) != size) {
+		sr_usb_xfer_pool_free(devc->xfer_pool);
+		devc->xfer_pool = NULL;
+	}
+	if (!devc->xfer_pool)
+		devc->xfer_pool = sr_usb_xfer_pool_new(usb, size, TRUE);
+
+	memset(&params, 0, sizeof(params));
+	params.endpoint = 6 | LIBUSB_ENDPOINT_IN;
+	params.pool = devc->xfer_pool;
+	params.num_transfers = get_number_of_transfers(sdi);
+	params.timeout = get_timeout(sdi);
+	params.max_empty = MAX_EMPTY_TRANSFERS;
+	params.data_cb = receive_transfer;
+	params.done_cb = finish_acquisition;
+	ret = sr_usb_stream_start((struct sr_dev_inst *)sdi, &params,
+		&devc->stream);
+	if (ret != SR_OK)
+		return ret;
+
+	if (!devc->num_frames)
+		std_session_send_df_header(sdi);
+	if (devc->limit_frames)
+		std_session_send_df_frame_begin(sdi);
 
 	return SR_OK;
 }
@@ -1012,8 +942,7 @@ static void LIBUSB_CALL trigger_receive(struct libusb_transfer *transfer)
 		/* Terminate session. */
 		std_session_send_df_end(sdi);
 		usb_source_remove(sdi->session, devc->ctx);
-		devc->num_transfers = 0;
-		g_free(devc->transfers);
+		devc->trigger_transfer = NULL;
 	} else if (transfer->status == LIBUSB_TRANSFER_COMPLETED
 			&& transfer->actual_length == sizeof(struct dslogic_trigger_pos)) {
 		tpos = (struct dslogic_trigger_pos *)transfer->buffer;
@@ -1021,35 +950,26 @@ static void LIBUSB_CALL trigger_receive(struct libusb_transfer *transfer)
 			tpos->ram_saddr, tpos->remain_cnt_h, tpos->remain_cnt_l);
 		devc->trigger_pos = tpos->real_pos;
 		g_free(tpos);
+		devc->trigger_transfer = NULL;
 		start_transfers(sdi);
+	} else {
+		devc->trigger_transfer = NULL;
 	}
 	libusb_free_transfer(transfer);
 }
 
-SR_PRIV int dslogic_acquisition_start(const struct sr_dev_inst *sdi)
+/* Program the FPGA, start it and wait for the trigger of one shot. */
+static int arm_trigger(const struct sr_dev_inst *sdi)
 {
-	const unsigned int timeout = get_timeout(sdi);
-
-	struct sr_dev_driver *di;
-	struct drv_context *drvc;
 	struct dev_context *devc;
 	struct sr_usb_dev_inst *usb;
 	struct dslogic_trigger_pos *tpos;
 	struct libusb_transfer *transfer;
 	int ret;
 
-	di = sdi->driver;
-	drvc = di->context;
 	devc = sdi->priv;
 	usb = sdi->conn;
 
-	devc->ctx = drvc->sr_ctx;
-	devc->sent_samples = 0;
-	devc->empty_transfer_count = 0;
-	devc->acq_aborted = FALSE;
-
-	usb_source_add(sdi->session, devc->ctx, timeout, receive_data, drvc);
-
 	if ((ret = command_stop_acquisition(sdi)) != SR_OK)
 		return ret;
 
@@ -1072,16 +992,33 @@ SR_PRIV int dslogic_acquisition_start(const struct sr_dev_inst *sdi)
 		return SR_ERR;
 	}
 
-	devc->transfers = g_try_malloc0(sizeof(*devc->transfers));
-	if (!devc->transfers) {
-		sr_err("USB trigger_pos transfer malloc failed.");
-		return SR_ERR_MALLOC;
-	}
-	devc->num_transfers = 1;
-	devc->submitted_transfers++;
-	devc->transfers[0] = transfer;
+	devc->trigger_transfer = transfer;
 
-	return ret;
+	return SR_OK;
+}
+
+SR_PRIV int dslogic_acquisition_start(const struct sr_dev_inst *sdi)
+{
+	const unsigned int timeout = get_timeout(sdi);
+
+	struct sr_dev_driver *di;
+	struct drv_context *drvc;
+	struct dev_context *devc;
+
+	di = sdi->driver;
+	drvc = di->context;
+	devc = sdi->priv;
+
+	devc->ctx = drvc->sr_ctx;
+	devc->sent_samples = 0;
+	devc->num_frames = 0;
+	devc->acq_aborted = FALSE;
+	devc->rearm_pending = FALSE;
+
+	usb_source_add(sdi->session, devc->ctx, timeout, receive_data,
+		(void *)sdi);
+
+	return arm_trigger(sdi);
 }
 
 SR_PRIV int dslogic_acquisition_stop(struct sr_dev_inst *sdi)
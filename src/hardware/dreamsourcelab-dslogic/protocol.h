@@ -114,25 +114,36 @@ struct dev_context {
 	 * until a proper delay after the last device was upgraded.
 	 */
 	int64_t fw_updated;
+	gboolean force_upload;
 
 	const uint64_t *samplerates;
 	int num_samplerates;
 
 	uint64_t cur_samplerate;
 	uint64_t limit_samples;
+	uint64_t limit_frames;
 	uint64_t capture_ratio;
 
+	/* Shots completed so far when capturing multiple frames. */
+	uint64_t num_frames;
+
 	gboolean acq_aborted;
+	/* The next shot gets armed from the main loop. */
+	gboolean rearm_pending;
 
 	unsigned int sent_samples;
-	int submitted_transfers;
-	int empty_transfer_count;
 
-	unsigned int num_transfers;
-	struct libusb_transfer **transfers;
+	struct libusb_transfer *trigger_transfer;
+	struct sr_usb_stream *stream;
+	struct sr_usb_xfer_pool *xfer_pool;
 	struct sr_context *ctx;
 
+	/* Last configuration sent to the FPGA, NULL if unknown. */
+	void *fpga_cfg;
+
+	/* Kept across acquisitions, only ever grows. */
 	uint16_t *deinterleave_buffer;
+	size_t deinterleave_buffer_size;
 
 	uint16_t mode;
 	uint32_t trigger_pos;
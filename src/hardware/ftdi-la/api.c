@@ -37,6 +37,8 @@ static const uint32_t devopts[] = {
 	SR_CONF_LIMIT_SAMPLES | SR_CONF_SET,
 	SR_CONF_SAMPLERATE | SR_CONF_GET | SR_CONF_SET | SR_CONF_LIST,
 	SR_CONF_CONN | SR_CONF_GET,
+	SR_CONF_TRANSFER_SIZE | SR_CONF_GET | SR_CONF_SET,
+	SR_CONF_TRANSFER_COUNT | SR_CONF_GET | SR_CONF_SET,
 };
 
 static const uint64_t samplerates[] = {
@@ -140,9 +142,6 @@ static void scan_device(struct ftdi_context *ftdic,
 
 	devc = g_malloc0(sizeof(struct dev_context));
 
-	/* Allocate memory for the incoming data. */
-	devc->data_buf = g_malloc0(DATA_BUF_SIZE);
-
 	devc->desc = desc;
 
 	vendor = g_malloc(usb_str_maxlen);
@@ -212,7 +211,6 @@ err_free_strings:
 	g_free(vendor);
 	g_free(model);
 	g_free(serial_num);
-	g_free(devc->data_buf);
 	g_free(devc);
 }
 
@@ -275,7 +273,7 @@ static GSList *scan(struct sr_dev_driver *di, GSList *options)
 
 	if (conn) {
 		devices = NULL;
-		libusb_get_device_list(drvc->sr_ctx->libusb_ctx, &devlist);
+		sr_usb_device_list(drvc->sr_ctx, &devlist);
 		for (i = 0; devlist[i]; i++) {
 			conn_devices = sr_usb_find(drvc->sr_ctx->libusb_ctx, conn);
 			for (l = conn_devices; l; l = l->next) {
@@ -295,14 +293,9 @@ static GSList *scan(struct sr_dev_driver *di, GSList *options)
 	return std_scan_complete(di, devices);
 }
 
-static void clear_helper(struct dev_context *devc)
-{
-	g_free(devc->data_buf);
-}
-
 static int dev_clear(const struct sr_dev_driver *di)
 {
-	return std_dev_clear_with_callback(di, (std_dev_clear_callback)clear_helper);
+	return std_dev_clear(di);
 }
 
 static int dev_open(struct sr_dev_inst *sdi)
@@ -393,6 +386,12 @@ static int config_get(uint32_t key, GVariant **data,
 		usb = sdi->conn;
 		*data = g_variant_new_printf("%d.%d", usb->bus, usb->address);
 		break;
+	case SR_CONF_TRANSFER_SIZE:
+		*data = g_variant_new_uint64(devc->transfer_size);
+		break;
+	case SR_CONF_TRANSFER_COUNT:
+		*data = g_variant_new_uint64(devc->transfer_count);
+		break;
 	default:
 		return SR_ERR_NA;
 	}
@@ -425,6 +424,18 @@ static int config_set(uint32_t key, GVariant *data,
 			return SR_ERR_SAMPLERATE;
 		devc->cur_samplerate = value;
 		return ftdi_la_set_samplerate(devc);
+	case SR_CONF_TRANSFER_SIZE:
+		value = g_variant_get_uint64(data);
+		if (value > MAX_TRANSFER_SIZE)
+			return SR_ERR_ARG;
+		devc->transfer_size = value;
+		break;
+	case SR_CONF_TRANSFER_COUNT:
+		value = g_variant_get_uint64(data);
+		if (value > MAX_NUM_TRANSFERS)
+			return SR_ERR_ARG;
+		devc->transfer_count = value;
+		break;
 	default:
 		return SR_ERR_NA;
 	}
@@ -452,6 +463,7 @@ static int config_list(uint32_t key, GVariant **data,
 static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 {
 	struct dev_context *devc;
+	int ret;
 
 	devc = sdi->priv;
 
@@ -462,11 +474,14 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 
 	/* Properly reset internal variables before every new acquisition. */
 	devc->samples_sent = 0;
-	devc->bytes_received = 0;
+
+	ret = ftdi_la_start_transfers((struct sr_dev_inst *)sdi);
+	if (ret != SR_OK)
+		return ret;
 
 	std_session_send_df_header(sdi);
 
-	/* Hook up a dummy handler to receive data from the device. */
+	/* Hook up a dummy handler to handle the USB events. */
 	sr_session_source_add(sdi->session, -1, G_IO_IN, 0,
 			      ftdi_la_receive_data, (void *)sdi);
 
@@ -475,9 +490,8 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 
 static int dev_acquisition_stop(struct sr_dev_inst *sdi)
 {
-	sr_session_source_remove(sdi->session, -1);
-
-	std_session_send_df_end(sdi);
+	/* The end packet is sent when all transfers are cancelled. */
+	ftdi_la_abort_transfers(sdi->priv);
 
 	return SR_OK;
 }
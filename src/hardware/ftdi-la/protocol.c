@@ -18,10 +18,13 @@
  */
 
 #include <config.h>
+#include <string.h>
 #include <ftdi.h>
+#include <libusb.h>
 #include "protocol.h"
 
-static void send_samples(struct sr_dev_inst *sdi, uint64_t samples_to_send)
+static void send_samples(struct sr_dev_inst *sdi, uint8_t *data,
+		uint64_t samples_to_send)
 {
 	struct sr_datafeed_packet packet;
 	struct sr_datafeed_logic logic;
@@ -35,11 +38,10 @@ static void send_samples(struct sr_dev_inst *sdi, uint64_t samples_to_send)
 	packet.payload = &logic;
 	logic.length = samples_to_send;
 	logic.unitsize = 1;
-	logic.data = devc->data_buf;
+	logic.data = data;
 	sr_session_send(sdi, &packet);
 
 	devc->samples_sent += samples_to_send;
-	devc->bytes_received -= samples_to_send;
 }
 
 SR_PRIV int ftdi_la_set_samplerate(struct dev_context *devc)
@@ -56,12 +58,172 @@ SR_PRIV int ftdi_la_set_samplerate(struct dev_context *devc)
 	return SR_OK;
 }
 
-SR_PRIV int ftdi_la_receive_data(int fd, int revents, void *cb_data)
+/*
+ * The chip starts every USB packet with two modem status bytes, drop
+ * them and move the payloads together. Returns the payload length.
+ */
+static int strip_modem_status(uint8_t *buf, int length, int packet_size)
+{
+	int in, out, n;
+
+	out = 0;
+	for (in = 0; in < length; in += packet_size) {
+		n = MIN(packet_size, length - in) - 2;
+		if (n <= 0)
+			continue;
+		memmove(buf + out, buf + in + 2, n);
+		out += n;
+	}
+
+	return out;
+}
+
+static void LIBUSB_CALL receive_transfer(struct libusb_transfer *transfer)
 {
 	struct sr_dev_inst *sdi;
 	struct dev_context *devc;
-	int bytes_read;
 	uint64_t n;
+	int length, ret;
+
+	sdi = transfer->user_data;
+	devc = sdi->priv;
+
+	if (devc->acq_aborted) {
+		devc->submitted_transfers--;
+		return;
+	}
+
+	switch (transfer->status) {
+	case LIBUSB_TRANSFER_COMPLETED:
+	case LIBUSB_TRANSFER_TIMED_OUT:
+		break;
+	default:
+		sr_err("FTDI transfer failed: %s.",
+		       libusb_error_name(transfer->status));
+		devc->submitted_transfers--;
+		sr_dev_acquisition_stop(sdi);
+		return;
+	}
+
+	length = strip_modem_status(transfer->buffer, transfer->actual_length,
+			devc->ftdic->max_packet_size);
+	if (length > 0) {
+		n = length;
+		if (devc->limit_samples && devc->samples_sent + n >= devc->limit_samples) {
+			send_samples(sdi, transfer->buffer,
+				devc->limit_samples - devc->samples_sent);
+			sr_info("Requested number of samples reached.");
+			devc->submitted_transfers--;
+			sr_dev_acquisition_stop(sdi);
+			return;
+		}
+		send_samples(sdi, transfer->buffer, n);
+	}
+
+	ret = libusb_submit_transfer(transfer);
+	if (ret != 0) {
+		sr_err("Failed to resubmit FTDI transfer: %s.",
+		       libusb_error_name(ret));
+		devc->submitted_transfers--;
+		sr_dev_acquisition_stop(sdi);
+	}
+}
+
+static void free_transfers(struct dev_context *devc)
+{
+	unsigned int i;
+
+	for (i = 0; i < devc->num_transfers; i++) {
+		if (!devc->transfers[i])
+			continue;
+		g_free(devc->transfers[i]->buffer);
+		libusb_free_transfer(devc->transfers[i]);
+	}
+	g_free(devc->transfers);
+	devc->transfers = NULL;
+	devc->num_transfers = 0;
+}
+
+/*
+ * Stream the sample data through several bulk transfers in flight, on
+ * the libusb handle libftdi has opened. See ftdi_read_data() for the
+ * endpoint and timeout which libftdi uses itself.
+ */
+SR_PRIV int ftdi_la_start_transfers(struct sr_dev_inst *sdi)
+{
+	struct dev_context *devc;
+	struct libusb_transfer *transfer;
+	unsigned int i, size, packet_size;
+	uint8_t *buf;
+	int ret;
+
+	devc = sdi->priv;
+
+	devc->acq_aborted = FALSE;
+	devc->submitted_transfers = 0;
+	devc->num_transfers = devc->transfer_count ?
+		devc->transfer_count : DEFAULT_NUM_TRANSFERS;
+	size = devc->transfer_size ? devc->transfer_size : DEFAULT_TRANSFER_SIZE;
+	/* Whole packets only, the status bytes are per packet. */
+	packet_size = devc->ftdic->max_packet_size;
+	size = (size + packet_size - 1) / packet_size * packet_size;
+
+	devc->transfers = g_malloc0(devc->num_transfers * sizeof(*devc->transfers));
+	for (i = 0; i < devc->num_transfers; i++) {
+		if (!(buf = g_try_malloc(size))) {
+			sr_err("Failed to allocate transfer buffer.");
+			ret = SR_ERR_MALLOC;
+			goto err_abort;
+		}
+		if (!(transfer = libusb_alloc_transfer(0))) {
+			g_free(buf);
+			ret = SR_ERR_MALLOC;
+			goto err_abort;
+		}
+		libusb_fill_bulk_transfer(transfer, devc->ftdic->usb_dev,
+			devc->ftdic->out_ep, buf, size, receive_transfer,
+			(void *)sdi, TRANSFER_TIMEOUT_MS);
+		devc->transfers[i] = transfer;
+		if ((ret = libusb_submit_transfer(transfer)) != 0) {
+			sr_err("Failed to submit FTDI transfer: %s.",
+			       libusb_error_name(ret));
+			ret = SR_ERR;
+			goto err_abort;
+		}
+		devc->submitted_transfers++;
+	}
+
+	return SR_OK;
+
+err_abort:
+	ftdi_la_abort_transfers(devc);
+	/* Wait for the cancellations before the transfers go away. */
+	while (devc->submitted_transfers > 0) {
+		if (libusb_handle_events(devc->ftdic->usb_ctx) != 0)
+			break;
+	}
+	free_transfers(devc);
+
+	return ret;
+}
+
+SR_PRIV void ftdi_la_abort_transfers(struct dev_context *devc)
+{
+	unsigned int i;
+
+	devc->acq_aborted = TRUE;
+
+	for (i = 0; i < devc->num_transfers; i++) {
+		if (devc->transfers[i])
+			libusb_cancel_transfer(devc->transfers[i]);
+	}
+}
+
+SR_PRIV int ftdi_la_receive_data(int fd, int revents, void *cb_data)
+{
+	struct sr_dev_inst *sdi;
+	struct dev_context *devc;
+	struct timeval tv;
 
 	(void)fd;
 	(void)revents;
@@ -70,35 +232,19 @@ SR_PRIV int ftdi_la_receive_data(int fd, int revents, void *cb_data)
 		return TRUE;
 	if (!(devc = sdi->priv))
 		return TRUE;
-	if (!(revents == G_IO_IN || revents == 0))
-		return TRUE;
 	if (!devc->ftdic)
 		return TRUE;
 
-	/* Get a block of data. */
-	bytes_read = ftdi_read_data(devc->ftdic, devc->data_buf, DATA_BUF_SIZE);
-	if (bytes_read < 0) {
-		sr_err("Failed to read FTDI data (%d): %s.",
-		       bytes_read, ftdi_get_error_string(devc->ftdic));
-		sr_dev_acquisition_stop(sdi);
-		return FALSE;
-	}
-	if (bytes_read == 0) {
-		sr_spew("Received 0 bytes, nothing to do.");
-		return TRUE;
-	}
-	sr_spew("Got some data.");
-	devc->bytes_received += bytes_read;
-
-	n = devc->samples_sent + devc->bytes_received;
+	/* Wait a little for any of the transfers to complete. */
+	tv.tv_sec = 0;
+	tv.tv_usec = 10 * 1000;
+	libusb_handle_events_timeout_completed(devc->ftdic->usb_ctx, &tv, NULL);
 
-	if (devc->limit_samples && (n >= devc->limit_samples)) {
-		send_samples(sdi, devc->limit_samples - devc->samples_sent);
-		sr_info("Requested number of samples reached.");
-		sr_dev_acquisition_stop(sdi);
-		return TRUE;
-	} else {
-		send_samples(sdi, devc->bytes_received);
+	if (devc->acq_aborted && devc->submitted_transfers == 0) {
+		free_transfers(devc);
+		sr_session_source_remove(sdi->session, -1);
+		std_session_send_df_end(sdi);
+		return FALSE;
 	}
 
 	return TRUE;
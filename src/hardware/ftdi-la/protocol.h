@@ -27,7 +27,11 @@
 
 #define LOG_PREFIX "ftdi-la"
 
-#define DATA_BUF_SIZE (16 * 1024)
+#define DEFAULT_TRANSFER_SIZE	(64 * 1024)
+#define MAX_TRANSFER_SIZE	(4 * 1024 * 1024)
+#define DEFAULT_NUM_TRANSFERS	8
+#define MAX_NUM_TRANSFERS	64
+#define TRANSFER_TIMEOUT_MS	1000
 
 struct ftdi_chip_desc {
 	uint16_t vendor;
@@ -43,12 +47,19 @@ struct dev_context {
 	uint64_t limit_samples;
 	uint32_t cur_samplerate;
 
-	unsigned char *data_buf;
+	uint64_t transfer_size;
+	uint64_t transfer_count;
+
+	struct libusb_transfer **transfers;
+	unsigned int num_transfers;
+	unsigned int submitted_transfers;
+	gboolean acq_aborted;
 	uint64_t samples_sent;
-	uint64_t bytes_received;
 };
 
 SR_PRIV int ftdi_la_set_samplerate(struct dev_context *devc);
+SR_PRIV int ftdi_la_start_transfers(struct sr_dev_inst *sdi);
+SR_PRIV void ftdi_la_abort_transfers(struct dev_context *devc);
 SR_PRIV int ftdi_la_receive_data(int fd, int revents, void *cb_data);
 
 #endif
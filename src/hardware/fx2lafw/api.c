@@ -131,6 +131,10 @@ static const uint32_t devopts[] = {
 	SR_CONF_SAMPLERATE | SR_CONF_GET | SR_CONF_SET | SR_CONF_LIST,
 	SR_CONF_TRIGGER_MATCH | SR_CONF_LIST,
 	SR_CONF_CAPTURE_RATIO | SR_CONF_GET | SR_CONF_SET,
+	SR_CONF_TRANSFER_SIZE | SR_CONF_GET | SR_CONF_SET,
+	SR_CONF_TRANSFER_COUNT | SR_CONF_GET | SR_CONF_SET,
+	SR_CONF_TRANSFER_ADAPTIVE | SR_CONF_GET | SR_CONF_SET,
+	SR_CONF_TRANSFER_THREAD | SR_CONF_GET | SR_CONF_SET,
 };
 
 static const int32_t trigger_matches[] = {
@@ -214,7 +218,7 @@ static GSList *scan(struct sr_dev_driver *di, GSList *options)
 
 	/* Find all fx2lafw compatible devices and upload firmware to them. */
 	devices = NULL;
-	libusb_get_device_list(drvc->sr_ctx->libusb_ctx, &devlist);
+	sr_usb_device_list(drvc->sr_ctx, &devlist);
 	for (i = 0; devlist[i]; i++) {
 		if (conn) {
 			usb = NULL;
@@ -453,12 +457,17 @@ static int dev_open(struct sr_dev_inst *sdi)
 static int dev_close(struct sr_dev_inst *sdi)
 {
 	struct sr_usb_dev_inst *usb;
+	struct dev_context *devc;
 
 	usb = sdi->conn;
+	devc = sdi->priv;
 
 	if (!usb->devhdl)
 		return SR_ERR_BUG;
 
+	sr_usb_xfer_pool_free(devc->xfer_pool);
+	devc->xfer_pool = NULL;
+
 	sr_info("Closing device on %d.%d (logical) / %s (physical) interface %d.",
 		usb->bus, usb->address, sdi->connection_id, USB_INTERFACE);
 	libusb_release_interface(usb->devhdl, USB_INTERFACE);
@@ -504,6 +513,18 @@ static int config_get(uint32_t key, GVariant **data,
 	case SR_CONF_CAPTURE_RATIO:
 		*data = g_variant_new_uint64(devc->capture_ratio);
 		break;
+	case SR_CONF_TRANSFER_SIZE:
+		*data = g_variant_new_uint64(devc->transfer_size);
+		break;
+	case SR_CONF_TRANSFER_COUNT:
+		*data = g_variant_new_uint64(devc->transfer_count);
+		break;
+	case SR_CONF_TRANSFER_ADAPTIVE:
+		*data = g_variant_new_boolean(devc->transfer_adaptive);
+		break;
+	case SR_CONF_TRANSFER_THREAD:
+		*data = g_variant_new_boolean(devc->transfer_thread);
+		break;
 	default:
 		return SR_ERR_NA;
 	}
@@ -515,6 +536,7 @@ static int config_set(uint32_t key, GVariant *data,
 	const struct sr_dev_inst *sdi, const struct sr_channel_group *cg)
 {
 	struct dev_context *devc;
+	uint64_t u64;
 	int idx;
 
 	(void)cg;
@@ -539,6 +561,25 @@ static int config_set(uint32_t key, GVariant *data,
 	case SR_CONF_CAPTURE_RATIO:
 		devc->capture_ratio = g_variant_get_uint64(data);
 		break;
+	case SR_CONF_TRANSFER_SIZE:
+		/* Bulk transfers are a multiple of the packet size. */
+		u64 = g_variant_get_uint64(data);
+		if (u64 % 512 || u64 > MAX_TRANSFER_SIZE)
+			return SR_ERR_ARG;
+		devc->transfer_size = u64;
+		break;
+	case SR_CONF_TRANSFER_COUNT:
+		u64 = g_variant_get_uint64(data);
+		if (u64 > MAX_SIMUL_TRANSFERS)
+			return SR_ERR_ARG;
+		devc->transfer_count = u64;
+		break;
+	case SR_CONF_TRANSFER_ADAPTIVE:
+		devc->transfer_adaptive = g_variant_get_boolean(data);
+		break;
+	case SR_CONF_TRANSFER_THREAD:
+		devc->transfer_thread = g_variant_get_boolean(data);
+		break;
 	default:
 		return SR_ERR_NA;
 	}
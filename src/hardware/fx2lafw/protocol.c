@@ -155,7 +155,7 @@ SR_PRIV int fx2lafw_dev_open(struct sr_dev_inst *sdi, struct sr_dev_driver *di)
 	devc = sdi->priv;
 	usb = sdi->conn;
 
-	device_count = libusb_get_device_list(drvc->sr_ctx->libusb_ctx, &devlist);
+	device_count = sr_usb_device_list(drvc->sr_ctx, &devlist);
 	if (device_count < 0) {
 		sr_err("Failed to get device list: %s.",
 		       libusb_error_name(device_count));
@@ -260,6 +260,10 @@ SR_PRIV struct dev_context *fx2lafw_dev_new(void)
 	devc->limit_frames = 1;
 	devc->limit_samples = 0;
 	devc->capture_ratio = 0;
+	devc->transfer_size = 0;
+	devc->transfer_count = 0;
+	devc->transfer_adaptive = FALSE;
+	devc->transfer_thread = FALSE;
 	devc->sample_wide = FALSE;
 	devc->num_frames = 0;
 	devc->stl = NULL;
@@ -269,28 +273,23 @@ SR_PRIV struct dev_context *fx2lafw_dev_new(void)
 
 SR_PRIV void fx2lafw_abort_acquisition(struct dev_context *devc)
 {
-	int i;
-
 	devc->acq_aborted = TRUE;
-
-	for (i = devc->num_transfers - 1; i >= 0; i--) {
-		if (devc->transfers[i])
-			libusb_cancel_transfer(devc->transfers[i]);
-	}
+	sr_usb_stream_stop(devc->stream);
 }
 
-static void finish_acquisition(struct sr_dev_inst *sdi)
+static void finish_acquisition(struct sr_dev_inst *sdi, void *cb_data)
 {
 	struct dev_context *devc;
 
+	(void)cb_data;
+
 	devc = sdi->priv;
+	devc->stream = NULL;
 
 	std_session_send_df_end(sdi);
 
-	usb_source_remove(sdi->session, devc->ctx);
-
-	devc->num_transfers = 0;
-	g_free(devc->transfers);
+	if (devc->usb_source)
+		usb_source_remove(sdi->session, devc->ctx);
 
 	/* Free the deinterlace buffers if we had them. */
 	if (g_slist_length(devc->enabled_analog_channels) > 0) {
@@ -304,43 +303,6 @@ static void finish_acquisition(struct sr_dev_inst *sdi)
 	}
 }
 
-static void free_transfer(struct libusb_transfer *transfer)
-{
-	struct sr_dev_inst *sdi;
-	struct dev_context *devc;
-	unsigned int i;
-
-	sdi = transfer->user_data;
-	devc = sdi->priv;
-
-	g_free(transfer->buffer);
-	transfer->buffer = NULL;
-	libusb_free_transfer(transfer);
-
-	for (i = 0; i < devc->num_transfers; i++) {
-		if (devc->transfers[i] == transfer) {
-			devc->transfers[i] = NULL;
-			break;
-		}
-	}
-
-	devc->submitted_transfers--;
-	if (devc->submitted_transfers == 0)
-		finish_acquisition(sdi);
-}
-
-static void resubmit_transfer(struct libusb_transfer *transfer)
-{
-	int ret;
-
-	if ((ret = libusb_submit_transfer(transfer)) == LIBUSB_SUCCESS)
-		return;
-
-	sr_err("%s: %s", __func__, libusb_error_name(ret));
-	free_transfer(transfer);
-
-}
-
 static void mso_send_data_proc(struct sr_dev_inst *sdi,
 	uint8_t *data, size_t length, size_t sample_width)
 {
@@ -410,65 +372,26 @@ static void la_send_data_proc(struct sr_dev_inst *sdi,
 	sr_session_send(sdi, &packet);
 }
 
-static void LIBUSB_CALL receive_transfer(struct libusb_transfer *transfer)
+static gboolean receive_transfer(struct sr_dev_inst *sdi,
+	uint8_t *data, size_t length, void *cb_data)
 {
-	struct sr_dev_inst *sdi;
 	struct dev_context *devc;
-	gboolean packet_has_error = FALSE;
 	unsigned int num_samples;
 	int trigger_offset, cur_sample_count, unitsize, processed_samples;
 	int pre_trigger_samples;
 
-	sdi = transfer->user_data;
-	devc = sdi->priv;
+	(void)cb_data;
 
-	/*
-	 * If acquisition has already ended, just free any queued up
-	 * transfer that come in.
-	 */
-	if (devc->acq_aborted) {
-		free_transfer(transfer);
-		return;
-	}
+	devc = sdi->priv;
 
-	sr_dbg("receive_transfer(): status %s received %d bytes.",
-		libusb_error_name(transfer->status), transfer->actual_length);
+	/* Nothing to do once the acquisition has ended. */
+	if (devc->acq_aborted)
+		return FALSE;
 
-	/* Save incoming transfer before reusing the transfer struct. */
 	unitsize = devc->sample_wide ? 2 : 1;
-	cur_sample_count = transfer->actual_length / unitsize;
+	cur_sample_count = length / unitsize;
 	processed_samples = 0;
 
-	switch (transfer->status) {
-	case LIBUSB_TRANSFER_NO_DEVICE:
-		fx2lafw_abort_acquisition(devc);
-		free_transfer(transfer);
-		return;
-	case LIBUSB_TRANSFER_COMPLETED:
-	case LIBUSB_TRANSFER_TIMED_OUT: /* We may have received some data though. */
-		break;
-	default:
-		packet_has_error = TRUE;
-		break;
-	}
-
-	if (transfer->actual_length == 0 || packet_has_error) {
-		devc->empty_transfer_count++;
-		if (devc->empty_transfer_count > MAX_EMPTY_TRANSFERS) {
-			/*
-			 * The FX2 gave up. End the acquisition, the frontend
-			 * will work out that the samplecount is short.
-			 */
-			fx2lafw_abort_acquisition(devc);
-			free_transfer(transfer);
-		} else {
-			resubmit_transfer(transfer);
-		}
-		return;
-	} else {
-		devc->empty_transfer_count = 0;
-	}
-
 check_trigger:
 	if (devc->trigger_fired) {
 		if (!devc->limit_samples || devc->sent_samples < devc->limit_samples) {
@@ -477,15 +400,15 @@ check_trigger:
 			if (devc->limit_samples && devc->sent_samples + num_samples > devc->limit_samples)
 				num_samples = devc->limit_samples - devc->sent_samples;
 
-			devc->send_data_proc(sdi, (uint8_t *)transfer->buffer + processed_samples * unitsize,
+			devc->send_data_proc(sdi, (uint8_t *)data + processed_samples * unitsize,
 				num_samples * unitsize, unitsize);
 			devc->sent_samples += num_samples;
 			processed_samples += num_samples;
 		}
 	} else {
 		trigger_offset = soft_trigger_logic_check(devc->stl,
-			transfer->buffer + processed_samples * unitsize,
-			transfer->actual_length - processed_samples * unitsize,
+			data + processed_samples * unitsize,
+			length - processed_samples * unitsize,
 			&pre_trigger_samples);
 		if (trigger_offset > -1) {
 			std_session_send_df_frame_begin(sdi);
@@ -495,7 +418,7 @@ check_trigger:
 					devc->sent_samples + num_samples > devc->limit_samples)
 				num_samples = devc->limit_samples - devc->sent_samples;
 
-			devc->send_data_proc(sdi, (uint8_t *)transfer->buffer
+			devc->send_data_proc(sdi, (uint8_t *)data
 					+ processed_samples * unitsize
 					+ trigger_offset * unitsize,
 					num_samples * unitsize, unitsize);
@@ -528,11 +451,8 @@ check_trigger:
 				goto check_trigger;
 		}
 	}
-	if (frame_ended && final_frame) {
-		fx2lafw_abort_acquisition(devc);
-		free_transfer(transfer);
-	} else
-		resubmit_transfer(transfer);
+
+	return !(frame_ended && final_frame);
 }
 
 static int configure_channels(const struct sr_dev_inst *sdi)
@@ -578,6 +498,9 @@ static size_t get_buffer_size(struct dev_context *devc)
 {
 	size_t s;
 
+	if (devc->transfer_size)
+		return devc->transfer_size;
+
 	/*
 	 * The buffer should be large enough to hold 10ms of data and
 	 * a multiple of 512.
@@ -590,6 +513,9 @@ static unsigned int get_number_of_transfers(struct dev_context *devc)
 {
 	unsigned int n;
 
+	if (devc->transfer_count)
+		return devc->transfer_count;
+
 	/* Total buffer size should be able to hold about 500ms of data. */
 	n = (500 * to_bytes_per_ms(devc->cur_samplerate) /
 		get_buffer_size(devc));
@@ -597,16 +523,16 @@ static unsigned int get_number_of_transfers(struct dev_context *devc)
 	if (n > NUM_SIMUL_TRANSFERS)
 		return NUM_SIMUL_TRANSFERS;
 
-	return n;
+	return MAX(n, 1);
 }
 
-static unsigned int get_timeout(struct dev_context *devc)
+static unsigned int get_timeout(struct dev_context *devc,
+	unsigned int num_transfers)
 {
 	size_t total_size;
 	unsigned int timeout;
 
-	total_size = get_buffer_size(devc) *
-			get_number_of_transfers(devc);
+	total_size = get_buffer_size(devc) * num_transfers;
 	timeout = total_size / to_bytes_per_ms(devc->cur_samplerate);
 	return timeout + timeout / 4; /* Leave a headroom of 25% percent. */
 }
@@ -632,18 +558,15 @@ static int start_transfers(const struct sr_dev_inst *sdi)
 	struct dev_context *devc;
 	struct sr_usb_dev_inst *usb;
 	struct sr_trigger *trigger;
-	struct libusb_transfer *transfer;
-	unsigned int i, num_transfers;
-	int timeout, ret;
-	unsigned char *buf;
+	struct sr_usb_stream_params params;
 	size_t size;
+	int ret;
 
 	devc = sdi->priv;
 	usb = sdi->conn;
 
 	devc->sent_samples = 0;
 	devc->acq_aborted = FALSE;
-	devc->empty_transfer_count = 0;
 
 	if ((trigger = sr_session_trigger_get(sdi->session))) {
 		int pre_trigger_samples = 0;
@@ -658,40 +581,38 @@ static int start_transfers(const struct sr_dev_inst *sdi)
 		devc->trigger_fired = TRUE;
 	}
 
-	num_transfers = get_number_of_transfers(devc);
-
+	/* Keep the device's buffers while their size remains. */
 	size = get_buffer_size(devc);
-	devc->submitted_transfers = 0;
-
-	devc->transfers = g_try_malloc0(sizeof(*devc->transfers) * num_transfers);
-	if (!devc->transfers) {
-		sr_err("USB transfers malloc failed.");
-		return SR_ERR_MALLOC;
-	}
-
-	timeout = get_timeout(devc);
-	devc->num_transfers = num_transfers;
-	for (i = 0; i < num_transfers; i++) {
-		if (!(buf = g_try_malloc(size))) {
-			sr_err("USB transfer buffer malloc failed.");
-			return SR_ERR_MALLOC;
-		}
-		transfer = libusb_alloc_transfer(0);
-		libusb_fill_bulk_transfer(transfer, usb->devhdl,
-				2 | LIBUSB_ENDPOINT_IN, buf, size,
-				receive_transfer, (void *)sdi, timeout);
-		sr_info("submitting transfer: %d", i);
-		if ((ret = libusb_submit_transfer(transfer)) != 0) {
-			sr_err("Failed to submit transfer: %s.",
-			       libusb_error_name(ret));
-			libusb_free_transfer(transfer);
-			g_free(buf);
-			fx2lafw_abort_acquisition(devc);
-			return SR_ERR;
-		}
-		devc->transfers[i] = transfer;
-		devc->submitted_transfers++;
+	if (devc->xfer_pool && sr_usb_xfer_pool_buffer_size(devc->xfer_pool) != size) {
+		sr_usb_xfer_pool_free(devc->xfer_pool);
+		devc->xfer_pool = NULL;
 	}
+	if (!devc->xfer_pool)
+		devc->xfer_pool = sr_usb_xfer_pool_new(usb, size, TRUE);
+
+	memset(&params, 0, sizeof(params));
+	params.endpoint = 2 | LIBUSB_ENDPOINT_IN;
+	params.pool = devc->xfer_pool;
+	params.num_transfers = get_number_of_transfers(devc);
+	params.max_transfers = params.num_transfers;
+	if (devc->transfer_adaptive)
+		params.max_transfers = MAX(params.num_transfers, MAX_SIMUL_TRANSFERS);
+	params.timeout = get_timeout(devc, params.num_transfers);
+	params.max_empty = MAX_EMPTY_TRANSFERS(params.num_transfers);
+	params.bytes_per_ms = to_bytes_per_ms(devc->cur_samplerate);
+	params.unitsize = devc->sample_wide ? 2 : 1;
+	params.zero_copy = TRUE;
+	params.event_thread = devc->transfer_thread;
+	params.data_cb = receive_transfer;
+	params.done_cb = finish_acquisition;
+
+	sr_dbg("Using %u transfers of %zu bytes%s%s.", params.num_transfers,
+		size, devc->transfer_adaptive ? ", adaptive" : "",
+		devc->transfer_thread ? ", on an event thread" : "");
+	ret = sr_usb_stream_start((struct sr_dev_inst *)sdi, &params,
+		&devc->stream);
+	if (ret != SR_OK)
+		return ret;
 
 	/*
 	 * If this device has analog channels and at least one of them is
@@ -723,7 +644,6 @@ SR_PRIV int fx2lafw_start_acquisition(const struct sr_dev_inst *sdi)
 	devc->ctx = drvc->sr_ctx;
 	devc->num_frames = 0;
 	devc->sent_samples = 0;
-	devc->empty_transfer_count = 0;
 	devc->acq_aborted = FALSE;
 
 	if (configure_channels(sdi) != SR_OK) {
@@ -731,8 +651,17 @@ SR_PRIV int fx2lafw_start_acquisition(const struct sr_dev_inst *sdi)
 		return SR_ERR;
 	}
 
-	timeout = get_timeout(devc);
-	usb_source_add(sdi->session, devc->ctx, timeout, receive_data, drvc);
+	/*
+	 * The stream's event thread handles libusb events by itself. Don't
+	 * also handle them from the main loop, completions would then run
+	 * on the session's thread.
+	 */
+	devc->usb_source = !devc->transfer_thread;
+	if (devc->usb_source) {
+		timeout = get_timeout(devc, get_number_of_transfers(devc));
+		usb_source_add(sdi->session, devc->ctx, timeout,
+			receive_data, drvc);
+	}
 
 	size = get_buffer_size(devc);
 	/* Prepare for analog sampling. */
@@ -37,7 +37,9 @@
 
 #define MAX_RENUM_DELAY_MS	3000
 #define NUM_SIMUL_TRANSFERS	32
-#define MAX_EMPTY_TRANSFERS	(NUM_SIMUL_TRANSFERS * 2)
+#define MAX_SIMUL_TRANSFERS	128
+#define MAX_EMPTY_TRANSFERS(n)	((n) * 2)
+#define MAX_TRANSFER_SIZE	(4 * 1024 * 1024)
 
 #define NUM_CHANNELS		16
 
@@ -105,6 +107,13 @@ struct dev_context {
 	uint64_t limit_frames;
 	uint64_t limit_samples;
 	uint64_t capture_ratio;
+	/* Configured transfer size and count, 0 for the defaults. */
+	uint64_t transfer_size;
+	uint64_t transfer_count;
+	gboolean transfer_adaptive;
+	gboolean transfer_thread;
+	/* Whether the acquisition handles libusb events from the main loop. */
+	gboolean usb_source;
 
 	gboolean trigger_fired;
 	gboolean acq_aborted;
@@ -113,11 +122,9 @@ struct dev_context {
 
 	uint64_t num_frames;
 	uint64_t sent_samples;
-	int submitted_transfers;
-	int empty_transfer_count;
 
-	unsigned int num_transfers;
-	struct libusb_transfer **transfers;
+	struct sr_usb_stream *stream;
+	struct sr_usb_xfer_pool *xfer_pool;
 	struct sr_context *ctx;
 	void (*send_data_proc)(struct sr_dev_inst *sdi,
 		uint8_t *data, size_t length, size_t sample_width);
@@ -32,6 +32,7 @@ static const uint32_t drvopts[] = {
 static const uint32_t devopts[] = {
 	SR_CONF_LIMIT_FRAMES | SR_CONF_GET | SR_CONF_SET,
 	SR_CONF_SAMPLERATE | SR_CONF_GET,
+	SR_CONF_ANALOG_RAW | SR_CONF_GET | SR_CONF_SET,
 };
 
 static struct sr_dev_driver gwinstek_gds_800_driver_info;
@@ -135,6 +136,9 @@ static int config_get(uint32_t key, GVariant **data,
 	case SR_CONF_LIMIT_FRAMES:
 		*data = g_variant_new_uint64(devc->frame_limit);
 		break;
+	case SR_CONF_ANALOG_RAW:
+		*data = g_variant_new_boolean(devc->analog_raw);
+		break;
 	default:
 		return SR_ERR_NA;
 	}
@@ -158,6 +162,9 @@ static int config_set(uint32_t key, GVariant *data,
 	case SR_CONF_LIMIT_FRAMES:
 		devc->frame_limit = g_variant_get_uint64(data);
 		break;
+	case SR_CONF_ANALOG_RAW:
+		devc->analog_raw = g_variant_get_boolean(data);
+		break;
 	default:
 		return SR_ERR_NA;
 	}
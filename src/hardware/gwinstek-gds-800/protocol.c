@@ -21,7 +21,6 @@
 #include <math.h>
 #include <string.h>
 
-#define ANALOG_CHANNELS 2
 #define VERTICAL_DIVISIONS 10
 
 static int read_data(struct sr_dev_inst *sdi,
@@ -61,23 +60,121 @@ static int read_data(struct sr_dev_inst *sdi,
 	}
 }
 
-SR_PRIV int gwinstek_gds_800_receive_data(int fd, int revents, void *cb_data)
+/* Query the vertical scale of all enabled channels, once per acquisition. */
+static int query_channel_scales(struct sr_dev_inst *sdi,
+		struct sr_scpi_dev_inst *scpi, struct dev_context *devc)
+{
+	struct sr_channel *ch;
+	char command[32];
+	char *response, *end_ptr;
+	float volts_per_division;
+	int i;
+
+	for (i = 0; i < ANALOG_CHANNELS; i++) {
+		ch = g_slist_nth_data(sdi->channels, i);
+		if (!ch || !ch->enabled)
+			continue;
+		snprintf(command, sizeof(command), ":CHAN%d:SCAL?", i + 1);
+		if (sr_scpi_get_string(scpi, command, &response) != SR_OK) {
+			sr_err("Failed to get volts per division.");
+			return SR_ERR;
+		}
+		volts_per_division = g_ascii_strtod(response, &end_ptr);
+		if (!strcmp(end_ptr, "mV"))
+			volts_per_division *= 1.e-3;
+		g_free(response);
+		devc->volts_per_division[i] = volts_per_division;
+	}
+
+	return SR_OK;
+}
+
+/*
+ * Advance to the next enabled channel, or to the next frame after the
+ * last channel. Returns FALSE when all frames were acquired.
+ */
+static gboolean next_channel(struct sr_dev_inst *sdi, struct dev_context *devc)
+{
+	struct sr_channel *ch;
+
+	while (++devc->cur_acq_channel < ANALOG_CHANNELS) {
+		ch = g_slist_nth_data(sdi->channels, devc->cur_acq_channel);
+		if (ch && ch->enabled) {
+			devc->state = START_TRANSFER_OF_CHANNEL_DATA;
+			return TRUE;
+		}
+	}
+
+	sr_spew("All channels acquired.");
+	if (devc->cur_acq_frame == devc->frame_limit - 1) {
+		/* All frames acquired. */
+		sr_spew("All frames acquired.");
+		return FALSE;
+	}
+
+	/* Start acquiring next frame. */
+	if (devc->df_started) {
+		std_session_send_df_frame_end(sdi);
+		std_session_send_df_frame_begin(sdi);
+	}
+	devc->cur_acq_frame++;
+	devc->state = START_ACQUISITION;
+
+	return TRUE;
+}
+
+static void send_channel_data(struct sr_dev_inst *sdi, struct dev_context *devc)
 {
-	struct sr_dev_inst *sdi;
-	struct sr_scpi_dev_inst *scpi;
-	struct dev_context *devc;
 	struct sr_datafeed_packet packet;
 	struct sr_datafeed_analog analog;
 	struct sr_analog_encoding encoding;
 	struct sr_analog_meaning meaning;
 	struct sr_analog_spec spec;
-	char command[32];
-	char *response;
-	float volts_per_division;
-	int num_samples, i;
-	float samples[MAX_SAMPLES];
+	int num_samples, i, digits;
+	float vbit, vbitlog;
+	const uint8_t *rdptr;
+
+	num_samples = (devc->data_size - 8) / 2;
+	sr_spew("Received %d number of samples from channel "
+		"%d.", num_samples, devc->cur_acq_channel + 1);
+
+	vbit = devc->volts_per_division[devc->cur_acq_channel] *
+		VERTICAL_DIVISIONS / 256.0;
+	vbitlog = log10f(vbit);
+	digits = -(int)vbitlog + (vbitlog < 0.0);
+
+	/* Fill frame. */
+	sr_analog_init(&analog, &encoding, &meaning, &spec, digits);
+	if (devc->analog_raw) {
+		/* Big endian words, scaled by the receiver. */
+		sr_analog_set_raw_encoding(&encoding, 2, TRUE, TRUE, vbit, 0);
+		analog.data = devc->rcv_buffer;
+	} else {
+		/* Convert data. */
+		rdptr = (const uint8_t *)devc->rcv_buffer;
+		for (i = 0; i < num_samples; i++, rdptr += 2)
+			devc->samples[i] = (int16_t)RB16(rdptr) * vbit;
+		analog.data = devc->samples;
+	}
+	analog.meaning->channels = g_slist_append(NULL,
+		g_slist_nth_data(sdi->channels, devc->cur_acq_channel));
+	analog.num_samples = num_samples;
+	analog.meaning->mq = SR_MQ_VOLTAGE;
+	analog.meaning->unit = SR_UNIT_VOLT;
+	analog.meaning->mqflags = 0;
+	packet.type = SR_DF_ANALOG;
+	packet.payload = &analog;
+	sr_session_send(sdi, &packet);
+	g_slist_free(analog.meaning->channels);
+}
+
+SR_PRIV int gwinstek_gds_800_receive_data(int fd, int revents, void *cb_data)
+{
+	struct sr_dev_inst *sdi;
+	struct sr_scpi_dev_inst *scpi;
+	struct dev_context *devc;
+	struct sr_channel *ch;
 	uint32_t sample_rate;
-	char *end_ptr;
 
 	(void)fd;
 
@@ -110,49 +207,38 @@ SR_PRIV int gwinstek_gds_800_receive_data(int fd, int revents, void *cb_data)
 			return TRUE;
 		}
 
-		devc->cur_acq_channel = 0;
-		devc->state = START_TRANSFER_OF_CHANNEL_DATA;
+		/* The scale doesn't change while frames get acquired. */
+		if (devc->cur_acq_frame == 0 &&
+				query_channel_scales(sdi, scpi, devc) != SR_OK) {
+			sr_dev_acquisition_stop(sdi);
+			return TRUE;
+		}
+
+		devc->cur_acq_channel = -1;
+		if (!next_channel(sdi, devc)) {
+			sr_dev_acquisition_stop(sdi);
+			return TRUE;
+		}
 		break;
 	case START_TRANSFER_OF_CHANNEL_DATA:
-		if (((struct sr_channel *)g_slist_nth_data(sdi->channels, devc->cur_acq_channel))->enabled) {
-			if (sr_scpi_send(scpi, ":ACQ%d:MEM?", devc->cur_acq_channel+1) != SR_OK) {
-				sr_err("Failed to acquire memory.");
-				sr_dev_acquisition_stop(sdi);
-				return TRUE;
-			}
-			if (sr_scpi_read_begin(scpi) != SR_OK) {
-				sr_err("Could not begin reading SCPI response.");
+		ch = g_slist_nth_data(sdi->channels, devc->cur_acq_channel);
+		if (!ch || !ch->enabled) {
+			if (!next_channel(sdi, devc))
 				sr_dev_acquisition_stop(sdi);
-				return TRUE;
-			}
-			devc->state = WAIT_FOR_TRANSFER_OF_BEGIN_TRANSMISSION_COMPLETE;
-			devc->cur_rcv_buffer_position = 0;
-		} else {
-			/* All channels acquired. */
-			if (devc->cur_acq_channel == ANALOG_CHANNELS - 1) {
-				sr_spew("All channels acquired.");
-
-				if (devc->cur_acq_frame == devc->frame_limit - 1) {
-					/* All frames accquired. */
-					sr_spew("All frames acquired.");
-
-					sr_dev_acquisition_stop(sdi);
-					return TRUE;
-				} else {
-					/* Start acquiring next frame. */
-					if (devc->df_started) {
-						std_session_send_df_frame_end(sdi);
-						std_session_send_df_frame_begin(sdi);
-					}
-
-					devc->cur_acq_frame++;
-					devc->state = START_ACQUISITION;
-				}
-			} else {
-				/* Start acquiring next channel. */
-				devc->cur_acq_channel++;
-			}
+			return TRUE;
+		}
+		if (sr_scpi_send(scpi, ":ACQ%d:MEM?", devc->cur_acq_channel+1) != SR_OK) {
+			sr_err("Failed to acquire memory.");
+			sr_dev_acquisition_stop(sdi);
+			return TRUE;
+		}
+		if (sr_scpi_read_begin(scpi) != SR_OK) {
+			sr_err("Could not begin reading SCPI response.");
+			sr_dev_acquisition_stop(sdi);
+			return TRUE;
 		}
+		devc->state = WAIT_FOR_TRANSFER_OF_BEGIN_TRANSMISSION_COMPLETE;
+		devc->cur_rcv_buffer_position = 0;
 		break;
 	case WAIT_FOR_TRANSFER_OF_BEGIN_TRANSMISSION_COMPLETE:
 		if (read_data(sdi, scpi, devc, 1) < 0)
@@ -172,30 +258,36 @@ SR_PRIV int gwinstek_gds_800_receive_data(int fd, int revents, void *cb_data)
 			return TRUE;
 		} else {
 			devc->data_size_digits = devc->rcv_buffer[0] - '0';
-			devc->state = WAIT_FOR_TRANSFER_OF_DATA_SIZE_COMPLETE;
+			devc->state = WAIT_FOR_TRANSFER_OF_DATA_HEADER_COMPLETE;
 		}
 		break;
-	case WAIT_FOR_TRANSFER_OF_DATA_SIZE_COMPLETE:
-		if (read_data(sdi, scpi, devc, devc->data_size_digits) < 0)
+	case WAIT_FOR_TRANSFER_OF_DATA_HEADER_COMPLETE:
+		/*
+		 * Read the data size, the sample rate, the channel indicator
+		 * and the reserved bytes in one go. The data size accounts
+		 * for the latter three fields (8 bytes) and the samples.
+		 */
+		if (read_data(sdi, scpi, devc, devc->data_size_digits + 8) < 0)
 			break;
+		/*
+		 * Contrary to the documentation, the sample rate is
+		 * transfered with most significant byte first!
+		 */
+		sample_rate = RB32(&devc->rcv_buffer[devc->data_size_digits]);
+		memcpy(&devc->sample_rate, &sample_rate, sizeof(float));
 		devc->rcv_buffer[devc->data_size_digits] = 0;
 		if (sr_atoi(devc->rcv_buffer, &devc->data_size) != SR_OK) {
 			sr_err("Could not parse data size '%s'", devc->rcv_buffer);
 			sr_dev_acquisition_stop(sdi);
 			return TRUE;
-		} else
-			devc->state = WAIT_FOR_TRANSFER_OF_SAMPLE_RATE_COMPLETE;
-		break;
-	case WAIT_FOR_TRANSFER_OF_SAMPLE_RATE_COMPLETE:
-		if (read_data(sdi, scpi, devc, sizeof(float)) < 0)
-			break;
-		/*
-		 * Contrary to the documentation, this field is
-		 * transfered with most significant byte first!
-		 */
-		sample_rate = RB32(devc->rcv_buffer);
-		memcpy(&devc->sample_rate, &sample_rate, sizeof(float));
-		devc->state = WAIT_FOR_TRANSFER_OF_CHANNEL_INDICATOR_COMPLETE;
+		}
+		if (devc->data_size < 8 ||
+				devc->data_size - 8 > MAX_RCV_BUFFER_SIZE) {
+			sr_err("Unexpected data size %d.", devc->data_size);
+			sr_dev_acquisition_stop(sdi);
+			return TRUE;
+		}
+		devc->state = WAIT_FOR_TRANSFER_OF_CHANNEL_DATA_COMPLETE;
 
 		if (!devc->df_started) {
 			std_session_send_df_header(sdi);
@@ -203,80 +295,14 @@ SR_PRIV int gwinstek_gds_800_receive_data(int fd, int revents, void *cb_data)
 			devc->df_started = TRUE;
 		}
 		break;
-	case WAIT_FOR_TRANSFER_OF_CHANNEL_INDICATOR_COMPLETE:
-		if (read_data(sdi, scpi, devc, 1) == SR_OK)
-			devc->state = WAIT_FOR_TRANSFER_OF_RESERVED_DATA_COMPLETE;
-		break;
-	case WAIT_FOR_TRANSFER_OF_RESERVED_DATA_COMPLETE:
-		if (read_data(sdi, scpi, devc, 3) == SR_OK)
-			devc->state = WAIT_FOR_TRANSFER_OF_CHANNEL_DATA_COMPLETE;
-		break;
 	case WAIT_FOR_TRANSFER_OF_CHANNEL_DATA_COMPLETE:
 		if (read_data(sdi, scpi, devc, devc->data_size - 8) < 0)
 			break;
 
-		/* Fetch data needed for conversion from device. */
-		snprintf(command, sizeof(command), ":CHAN%d:SCAL?",
-				devc->cur_acq_channel + 1);
-		if (sr_scpi_get_string(scpi, command, &response) != SR_OK) {
-			sr_err("Failed to get volts per division.");
-			sr_dev_acquisition_stop(sdi);
-			return TRUE;
-		}
-		volts_per_division = g_ascii_strtod(response, &end_ptr);
-		if (!strcmp(end_ptr, "mV"))
-			volts_per_division *= 1.e-3;
-		g_free(response);
+		send_channel_data(sdi, devc);
 
-		num_samples = (devc->data_size - 8) / 2;
-		sr_spew("Received %d number of samples from channel "
-			"%d.", num_samples, devc->cur_acq_channel + 1);
-
-		float vbit = volts_per_division * VERTICAL_DIVISIONS / 256.0;
-		float vbitlog = log10f(vbit);
-		int digits = -(int)vbitlog + (vbitlog < 0.0);
-
-		/* Convert data. */
-		for (i = 0; i < num_samples; i++)
-			samples[i] = ((float) ((int16_t) (RB16(&devc->rcv_buffer[i*2])))) * vbit;
-
-		/* Fill frame. */
-		sr_analog_init(&analog, &encoding, &meaning, &spec, digits);
-		analog.meaning->channels = g_slist_append(NULL, g_slist_nth_data(sdi->channels, devc->cur_acq_channel));
-		analog.num_samples = num_samples;
-		analog.data = samples;
-		analog.meaning->mq = SR_MQ_VOLTAGE;
-		analog.meaning->unit = SR_UNIT_VOLT;
-		analog.meaning->mqflags = 0;
-		packet.type = SR_DF_ANALOG;
-		packet.payload = &analog;
-		sr_session_send(sdi, &packet);
-		g_slist_free(analog.meaning->channels);
-
-		/* All channels acquired. */
-		if (devc->cur_acq_channel == ANALOG_CHANNELS - 1) {
-			sr_spew("All channels acquired.");
-
-			if (devc->cur_acq_frame == devc->frame_limit - 1) {
-				/* All frames acquired. */
-				sr_spew("All frames acquired.");
-				sr_dev_acquisition_stop(sdi);
-				return TRUE;
-			} else {
-				/* Start acquiring next frame. */
-				if (devc->df_started) {
-					std_session_send_df_frame_end(sdi);
-					std_session_send_df_frame_begin(sdi);
-				}
-				devc->cur_acq_frame++;
-				devc->state = START_ACQUISITION;
-			}
-		} else {
-			/* Start acquiring next channel. */
-			devc->state = START_TRANSFER_OF_CHANNEL_DATA;
-			devc->cur_acq_channel++;
-			return TRUE;
-		}
+		if (!next_channel(sdi, devc))
+			sr_dev_acquisition_stop(sdi);
 		break;
 	}
 
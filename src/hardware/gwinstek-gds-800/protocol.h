@@ -28,6 +28,7 @@
 
 #define LOG_PREFIX "gwinstek-gds-800"
 
+#define ANALOG_CHANNELS 2
 #define MAX_SAMPLES 125000
 #define MAX_RCV_BUFFER_SIZE (MAX_SAMPLES * 2)
 
@@ -37,10 +38,7 @@ enum gds_state
 	START_TRANSFER_OF_CHANNEL_DATA,
 	WAIT_FOR_TRANSFER_OF_BEGIN_TRANSMISSION_COMPLETE,
 	WAIT_FOR_TRANSFER_OF_DATA_SIZE_DIGIT_COMPLETE,
-	WAIT_FOR_TRANSFER_OF_DATA_SIZE_COMPLETE,
-	WAIT_FOR_TRANSFER_OF_SAMPLE_RATE_COMPLETE,
-	WAIT_FOR_TRANSFER_OF_CHANNEL_INDICATOR_COMPLETE,
-	WAIT_FOR_TRANSFER_OF_RESERVED_DATA_COMPLETE,
+	WAIT_FOR_TRANSFER_OF_DATA_HEADER_COMPLETE,
 	WAIT_FOR_TRANSFER_OF_CHANNEL_DATA_COMPLETE,
 };
 
@@ -48,9 +46,13 @@ struct dev_context {
 	enum gds_state state;
 	uint64_t cur_acq_frame;
 	uint64_t frame_limit;
+	/* Send the scope's words with scale, not floats. */
+	gboolean analog_raw;
 	int cur_acq_channel;
 	int cur_rcv_buffer_position;
 	char rcv_buffer[MAX_RCV_BUFFER_SIZE];
+	float samples[MAX_SAMPLES];
+	float volts_per_division[ANALOG_CHANNELS];
 	int data_size_digits;
 	int data_size;
 	float sample_rate;
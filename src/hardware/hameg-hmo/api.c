@@ -124,6 +124,14 @@ static int dev_open(struct sr_dev_inst *sdi)
 
 static int dev_close(struct sr_dev_inst *sdi)
 {
+	struct dev_context *devc;
+
+	devc = sdi->priv;
+	if (devc->block) {
+		g_byte_array_free(devc->block, TRUE);
+		devc->block = NULL;
+	}
+
 	return sr_scpi_close(sdi->conn);
 }
 
@@ -620,21 +628,18 @@ static int config_list(uint32_t key, GVariant **data,
 	return SR_OK;
 }
 
-SR_PRIV int hmo_request_data(const struct sr_dev_inst *sdi)
+SR_PRIV int hmo_data_command(const struct sr_dev_inst *sdi,
+		struct sr_channel *ch, char *command, size_t size)
 {
-	char command[MAX_COMMAND_SIZE];
-	struct sr_channel *ch;
 	struct dev_context *devc;
 	const struct scope_config *model;
 
 	devc = sdi->priv;
 	model = devc->model_config;
 
-	ch = devc->current_channel->data;
-
 	switch (ch->type) {
 	case SR_CHANNEL_ANALOG:
-		g_snprintf(command, sizeof(command),
+		g_snprintf(command, size,
 			   (*model->scpi_dialect)[SCPI_CMD_GET_ANALOG_DATA],
 #ifdef WORDS_BIGENDIAN
 			   "MSBF",
@@ -644,15 +649,29 @@ SR_PRIV int hmo_request_data(const struct sr_dev_inst *sdi)
 			   ch->index + 1);
 		break;
 	case SR_CHANNEL_LOGIC:
-		g_snprintf(command, sizeof(command),
+		g_snprintf(command, size,
 			   (*model->scpi_dialect)[SCPI_CMD_GET_DIG_DATA],
 			   ch->index / DIGITAL_CHANNELS_PER_POD + 1);
 		break;
 	default:
 		sr_err("Invalid channel type.");
-		break;
+		return SR_ERR;
 	}
 
+	return SR_OK;
+}
+
+SR_PRIV int hmo_request_data(const struct sr_dev_inst *sdi)
+{
+	char command[MAX_COMMAND_SIZE];
+	struct dev_context *devc;
+
+	devc = sdi->priv;
+
+	if (hmo_data_command(sdi, devc->current_channel->data,
+			command, sizeof(command)) != SR_OK)
+		return SR_ERR;
+
 	return sr_scpi_send(sdi->conn, command);
 }
 
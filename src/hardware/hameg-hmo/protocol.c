@@ -1362,6 +1362,34 @@ SR_PRIV void hmo_cleanup_logic_data(struct dev_context *devc)
 	 */
 }
 
+/*
+ * Read the block of the current channel into the reused receive buffer.
+ * The next enabled channel's data gets requested right after the block
+ * was received, so the device prepares it while this block is processed.
+ */
+static int hmo_read_block(const struct sr_dev_inst *sdi,
+		GByteArray **data, gboolean *next_requested)
+{
+	char command[MAX_COMMAND_SIZE];
+	struct dev_context *devc;
+	GSList *next;
+	const char *next_command;
+
+	devc = sdi->priv;
+	if (!devc->block)
+		devc->block = g_byte_array_new();
+	*data = devc->block;
+
+	next_command = NULL;
+	next = devc->current_channel->next;
+	if (next && hmo_data_command(sdi, next->data, command,
+			sizeof(command)) == SR_OK)
+		next_command = command;
+
+	return sr_scpi_get_block_pipelined(sdi->conn, NULL, *data,
+		next_command, next_requested);
+}
+
 SR_PRIV int hmo_receive_data(int fd, int revents, void *cb_data)
 {
 	struct sr_channel *ch;
@@ -1376,6 +1404,7 @@ SR_PRIV int hmo_receive_data(int fd, int revents, void *cb_data)
 	struct sr_analog_spec spec;
 	struct sr_datafeed_logic logic;
 	size_t group;
+	gboolean next_requested;
 
 	(void)fd;
 	(void)revents;
@@ -1406,14 +1435,11 @@ SR_PRIV int hmo_receive_data(int fd, int revents, void *cb_data)
 	/*
 	 * Pass on the received data of the channel(s).
 	 */
+	next_requested = FALSE;
 	switch (ch->type) {
 	case SR_CHANNEL_ANALOG:
-		data = NULL;
-		if (sr_scpi_get_block(sdi->conn, NULL, &data) != SR_OK) {
-			if (data)
-				g_byte_array_free(data, TRUE);
+		if (hmo_read_block(sdi, &data, &next_requested) != SR_OK)
 			return TRUE;
-		}
 
 		packet.type = SR_DF_ANALOG;
 
@@ -1437,16 +1463,10 @@ SR_PRIV int hmo_receive_data(int fd, int revents, void *cb_data)
 		sr_session_send(sdi, &packet);
 		devc->num_samples = data->len / sizeof(float);
 		g_slist_free(meaning.channels);
-		g_byte_array_free(data, TRUE);
-		data = NULL;
 		break;
 	case SR_CHANNEL_LOGIC:
-		data = NULL;
-		if (sr_scpi_get_block(sdi->conn, NULL, &data) != SR_OK) {
-			if (data)
-				g_byte_array_free(data, TRUE);
+		if (hmo_read_block(sdi, &data, &next_requested) != SR_OK)
 			return TRUE;
-		}
 
 		/*
 		 * If only data from the first pod is involved in the
@@ -1477,8 +1497,6 @@ SR_PRIV int hmo_receive_data(int fd, int revents, void *cb_data)
 		}
 
 		devc->num_samples = data->len / devc->pod_count;
-		g_byte_array_free(data, TRUE);
-		data = NULL;
 		break;
 	default:
 		sr_err("Invalid channel type.");
@@ -1492,7 +1510,8 @@ SR_PRIV int hmo_receive_data(int fd, int revents, void *cb_data)
 	 */
 	if (devc->current_channel->next) {
 		devc->current_channel = devc->current_channel->next;
-		hmo_request_data(sdi);
+		if (!next_requested)
+			hmo_request_data(sdi);
 		return TRUE;
 	}
 	hmo_send_logic_packet(sdi, devc);
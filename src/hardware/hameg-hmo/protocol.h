@@ -131,9 +131,14 @@ struct dev_context {
 
 	size_t pod_count;
 	GByteArray *logic_data;
+
+	/* Reused receive buffer of waveform blocks */
+	GByteArray *block;
 };
 
 SR_PRIV int hmo_init_device(struct sr_dev_inst *sdi);
+SR_PRIV int hmo_data_command(const struct sr_dev_inst *sdi,
+		struct sr_channel *ch, char *command, size_t size);
 SR_PRIV int hmo_request_data(const struct sr_dev_inst *sdi);
 SR_PRIV int hmo_receive_data(int fd, int revents, void *cb_data);
 
@@ -200,7 +200,7 @@ static GSList *scan(struct sr_dev_driver *di, GSList *options)
 	else
 		conn_devices = NULL;
 
-	libusb_get_device_list(drvc->sr_ctx->libusb_ctx, &devlist);
+	sr_usb_device_list(drvc->sr_ctx, &devlist);
 	for (i = 0; devlist[i]; i++) {
 		if (conn) {
 			struct sr_usb_dev_inst *usb = NULL;
@@ -325,12 +325,17 @@ static int dev_open(struct sr_dev_inst *sdi)
 static int dev_close(struct sr_dev_inst *sdi)
 {
 	struct sr_usb_dev_inst *usb;
+	struct dev_context *devc;
 
 	usb = sdi->conn;
+	devc = sdi->priv;
 
 	if (!usb->devhdl)
 		return SR_ERR_BUG;
 
+	sr_usb_xfer_pool_free(devc->xfer_pool);
+	devc->xfer_pool = NULL;
+
 	sr_info("Closing device on %d.%d (logical) / %s (physical) interface %d.",
 		usb->bus, usb->address, sdi->connection_id, USB_INTERFACE);
 	libusb_release_interface(usb->devhdl, USB_INTERFACE);
@@ -499,12 +504,19 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 	struct dev_context *devc = sdi->priv;
 	struct sr_trigger *trigger = sr_session_trigger_get(sdi->session);
 	struct h4032l_cmd_pkt *cmd_pkt = &devc->cmd_pkt;
+	uint32_t enabled_mask;
 
 	/* Initialize variables. */
 	devc->acq_aborted = FALSE;
 	devc->submitted_transfers = 0;
 	devc->sent_samples = 0;
 
+	/* Only send the bytes of the sample words up to the last enabled channel. */
+	enabled_mask = sr_dev_channel_cache_get(sdi)->logic_enabled_mask;
+	devc->unitsize = sizeof(uint32_t);
+	while (devc->unitsize > 1 && !(enabled_mask >> (8 * (devc->unitsize - 1))))
+		devc->unitsize--;
+
 	/* Calculate packet ratio. */
 	cmd_pkt->pre_trigger_size = (cmd_pkt->sample_size * devc->capture_ratio) / 100;
 	devc->trigger_pos = cmd_pkt->pre_trigger_size;
@@ -49,6 +49,7 @@ static void abort_acquisition(struct dev_context *devc)
 		if (devc->transfers[i])
 			libusb_cancel_transfer(devc->transfers[i]);
 	}
+	sr_usb_stream_stop(devc->stream);
 
 	devc->status = H4032L_STATUS_IDLE;
 }
@@ -63,6 +64,17 @@ static void finish_acquisition(struct sr_dev_inst *sdi)
 
 	devc->num_transfers = 0;
 	g_free(devc->transfers);
+	devc->transfers = NULL;
+}
+
+static void finish_data_transfers(struct sr_dev_inst *sdi, void *cb_data)
+{
+	struct dev_context *devc = sdi->priv;
+
+	(void)cb_data;
+
+	devc->stream = NULL;
+	finish_acquisition(sdi);
 }
 
 static void free_transfer(struct libusb_transfer *transfer)
@@ -90,25 +102,34 @@ static void free_transfer(struct libusb_transfer *transfer)
 		finish_acquisition(sdi);
 }
 
-static void resubmit_transfer(struct libusb_transfer *transfer)
+/*
+ * Drop the bytes of the sample words above the highest enabled channel,
+ * in place.
+ */
+static void narrow_samples(uint8_t *data, size_t sample_count,
+	unsigned int unitsize)
 {
-	int ret;
+	size_t i;
+	unsigned int j;
 
-	if ((ret = libusb_submit_transfer(transfer)) == LIBUSB_SUCCESS)
+	if (unitsize == sizeof(uint32_t))
 		return;
 
-	sr_err("%s: %s", __func__, libusb_error_name(ret));
-	free_transfer(transfer);
+	for (i = 0; i < sample_count; i++) {
+		for (j = 0; j < unitsize; j++)
+			data[i * unitsize + j] = data[i * sizeof(uint32_t) + j];
+	}
 }
 
 static void send_data(struct sr_dev_inst *sdi,
 	uint32_t *data, size_t sample_count)
 {
 	struct dev_context *devc = sdi->priv;
+	uint8_t *samples = (uint8_t *)data;
 	struct sr_datafeed_logic logic = {
-		.length = sample_count * sizeof(uint32_t),
-		.unitsize = sizeof(uint32_t),
-		.data = data
+		.length = sample_count * devc->unitsize,
+		.unitsize = devc->unitsize,
+		.data = samples
 	};
 	const struct sr_datafeed_packet packet = {
 		.type = SR_DF_LOGIC,
@@ -116,11 +137,13 @@ static void send_data(struct sr_dev_inst *sdi,
 	};
 	size_t trigger_offset;
 
+	narrow_samples(samples, sample_count, devc->unitsize);
+
 	if (devc->trigger_pos >= devc->sent_samples &&
 		devc->trigger_pos < (devc->sent_samples + sample_count)) {
 		/* Get trigger position. */
 		trigger_offset = devc->trigger_pos - devc->sent_samples;
-		logic.length = trigger_offset * sizeof(uint32_t);
+		logic.length = trigger_offset * devc->unitsize;
 		if (logic.length)
 			sr_session_send(sdi, &packet);
 
@@ -128,8 +151,8 @@ static void send_data(struct sr_dev_inst *sdi,
 		std_session_send_df_trigger(sdi);
 
 		/* Send rest of data. */
-		logic.length = (sample_count - trigger_offset) * sizeof(uint32_t);
-		logic.data = data + trigger_offset;
+		logic.length = (sample_count - trigger_offset) * devc->unitsize;
+		logic.data = samples + trigger_offset * devc->unitsize;
 		if (logic.length)
 			sr_session_send(sdi, &packet);
 	} else {
@@ -155,54 +178,36 @@ SR_PRIV int h4032l_receive_data(int fd, int revents, void *cb_data)
 	return TRUE;
 }
 
-void LIBUSB_CALL h4032l_data_transfer_callback(struct libusb_transfer *transfer)
+static gboolean receive_data_transfer(struct sr_dev_inst *sdi,
+	uint8_t *data, size_t length, void *cb_data)
 {
-	struct sr_dev_inst *const sdi = transfer->user_data;
 	struct dev_context *const devc = sdi->priv;
-	uint32_t max_samples = transfer->actual_length / sizeof(uint32_t);
-	uint32_t *buf;
+	uint32_t max_samples = length / sizeof(uint32_t);
+	uint32_t *buf = (uint32_t *)data;
 	uint32_t num_samples;
 
-	/*
-	 * If acquisition has already ended, just free any queued up
-	 * transfer that come in.
-	 */
-	if (devc->acq_aborted) {
-		free_transfer(transfer);
-		return;
-	}
+	(void)cb_data;
 
-	if (transfer->status != LIBUSB_TRANSFER_COMPLETED)
-		sr_dbg("%s error: %d.", __func__, transfer->status);
-
-	/* Cancel pending transfers. */
-	if (transfer->actual_length == 0) {
-		resubmit_transfer(transfer);
-		return;
-	}
-
-	buf = (uint32_t *)transfer->buffer;
+	if (devc->acq_aborted)
+		return FALSE;
 
 	num_samples = MIN(devc->remaining_samples, max_samples);
 	devc->remaining_samples -= num_samples;
-	send_data(sdi, buf, num_samples);
 	sr_dbg("Remaining: %d %08X %08X.", devc->remaining_samples,
 		buf[0], buf[1]);
+	/* Check the end magic before the samples get narrowed. */
+	if (devc->remaining_samples == 0 && num_samples < max_samples &&
+	    buf[num_samples] != H4032L_END_PACKET_MAGIC)
+		sr_err("Mismatch magic number of end poll.");
+	send_data(sdi, buf, num_samples);
 
 	/* Close data receiving. */
 	if (devc->remaining_samples == 0) {
-		if (buf[num_samples] != H4032L_END_PACKET_MAGIC)
-			sr_err("Mismatch magic number of end poll.");
-
 		abort_acquisition(devc);
-		free_transfer(transfer);
-	} else {
-		if (((devc->submitted_transfers - 1) * H4032L_DATA_BUFFER_SIZE) <
-		    (int32_t)(devc->remaining_samples * sizeof(uint32_t)))
-			resubmit_transfer(transfer);
-		else
-			free_transfer(transfer);
+		return FALSE;
 	}
+
+	return TRUE;
 }
 
 void LIBUSB_CALL h4032l_usb_callback(struct libusb_transfer *transfer)
@@ -292,12 +297,20 @@ void LIBUSB_CALL h4032l_usb_callback(struct libusb_transfer *transfer)
 		break;
 	}
 
-	/* Start data receiving. */
+	/* Start data receiving, the stream takes over from the poll transfer. */
 	if (devc->status == H4032L_STATUS_TRANSFER) {
+		transfer->buffer = NULL;
+		libusb_free_transfer(transfer);
+		devc->transfers[0] = NULL;
+		devc->submitted_transfers--;
 		if ((ret = h4032l_start_data_transfers(sdi)) != SR_OK) {
 			sr_err("Can not start data transfers: %d", ret);
 			devc->status = H4032L_STATUS_IDLE;
+			/* Otherwise the stream ends the acquisition. */
+			if (!devc->stream)
+				finish_acquisition(sdi);
 		}
+		return;
 	} else if (devc->status != H4032L_STATUS_IDLE) {
 		if (cmd) {
 			/* Setup new USB cmd packet, reuse transfer object. */
@@ -354,55 +367,60 @@ uint16_t h4032l_voltage2pwm(double voltage)
 	return (uint16_t) ((voltage + 5.0) * (4096.0 / 15.0));
 }
 
+/*
+ * Transfers grow with the size of the download, so that a queue of them
+ * covers it, with whole packets of 512 bytes.
+ */
+static size_t data_transfer_size(uint32_t remaining_bytes)
+{
+	size_t size;
+
+	size = remaining_bytes / H4032L_DATA_TRANSFER_NUM;
+	size = CLAMP(size, H4032L_DATA_BUFFER_SIZE, H4032L_DATA_BUFFER_SIZE_MAX);
+
+	return (size + 511) / 512 * 512;
+}
+
 SR_PRIV int h4032l_start_data_transfers(const struct sr_dev_inst *sdi)
 {
 	struct dev_context *devc = sdi->priv;
 	struct sr_usb_dev_inst *usb = sdi->conn;
-	struct libusb_transfer *transfer;
-	uint8_t *buf;
+	struct sr_usb_stream_params params;
+	uint32_t remaining_bytes;
+	size_t size;
 	unsigned int num_transfers;
-	unsigned int i;
-	int ret;
-
-	devc->submitted_transfers = 0;
-
-	/*
-	 * Set number of data transfers regarding to size of buffer.
-	 * FPGA version 0 can't transfer multiple transfers at once.
-	 */
-	if ((num_transfers = MIN(devc->remaining_samples * sizeof(uint32_t) /
-	    H4032L_DATA_BUFFER_SIZE, devc->fpga_version ?
-	    H4032L_DATA_TRANSFER_MAX_NUM : 1)) == 0)
-		num_transfers = 1;
-
-	g_free(devc->transfers);
-	devc->transfers = g_malloc(sizeof(*devc->transfers) * num_transfers);
-	devc->num_transfers = num_transfers;
 
-	for (i = 0; i < num_transfers; i++) {
-		buf = g_malloc(H4032L_DATA_BUFFER_SIZE);
-		transfer = libusb_alloc_transfer(0);
+	remaining_bytes = devc->remaining_samples * sizeof(uint32_t);
+	size = data_transfer_size(remaining_bytes);
 
-		libusb_fill_bulk_transfer(transfer, usb->devhdl,
-			6 | LIBUSB_ENDPOINT_IN,
-			buf, H4032L_DATA_BUFFER_SIZE,
-			h4032l_data_transfer_callback,
-			(void *)sdi, H4032L_USB_TIMEOUT);
+	/* Set number of data transfers regarding to size of buffer. */
+	num_transfers = (remaining_bytes + size - 1) / size;
+	num_transfers = CLAMP(num_transfers, 1, H4032L_DATA_TRANSFER_NUM);
 
-		/* Send prepared usb packet. */
-		if ((ret = libusb_submit_transfer(transfer)) != 0) {
-			sr_err("Failed to submit transfer: %s.",
-			       libusb_error_name(ret));
-			libusb_free_transfer(transfer);
-			g_free(buf);
-			abort_acquisition(devc);
-			return SR_ERR;
-		}
-		devc->transfers[i] = transfer;
-		devc->submitted_transfers++;
+	/* Keep the device's buffers while their size remains. */
+	if (devc->xfer_pool && sr_usb_xfer_pool_buffer_size(devc->xfer_pool) != size) {
+		sr_usb_xfer_pool_free(devc->xfer_pool);
+		devc->xfer_pool = NULL;
 	}
-
-	return SR_OK;
+	if (!devc->xfer_pool)
+		devc->xfer_pool = sr_usb_xfer_pool_new(usb, size, TRUE);
+
+	memset(&params, 0, sizeof(params));
+	params.endpoint = 6 | LIBUSB_ENDPOINT_IN;
+	params.pool = devc->xfer_pool;
+	params.num_transfers = num_transfers;
+	params.max_transfers = H4032L_DATA_TRANSFER_MAX_NUM;
+	params.timeout = H4032L_USB_TIMEOUT;
+	params.bytes_per_ms = H4032L_DATA_BYTES_PER_MS;
+	params.data_cb = receive_data_transfer;
+	params.done_cb = finish_data_transfers;
+
+	/* FPGA version 0 can't transfer multiple transfers at once. */
+	if (!devc->fpga_version)
+		params.num_transfers = params.max_transfers = 1;
+
+	return sr_usb_stream_start((struct sr_dev_inst *)sdi, &params,
+		&devc->stream);
 }
 
 SR_PRIV int h4032l_start(const struct sr_dev_inst *sdi)
@@ -468,7 +486,7 @@ SR_PRIV int h4032l_dev_open(struct sr_dev_inst *sdi)
 	int ret = SR_ERR, i, device_count;
 	char connection_id[64];
 
-	device_count = libusb_get_device_list(drvc->sr_ctx->libusb_ctx, &devlist);
+	device_count = sr_usb_device_list(drvc->sr_ctx, &devlist);
 	if (device_count < 0) {
 		sr_err("Failed to get device list: %s.",
 		       libusb_error_name(device_count));
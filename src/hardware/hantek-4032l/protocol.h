@@ -34,7 +34,11 @@
 #define H4032L_USB_PRODUCT 0x4032
 
 #define H4032L_DATA_BUFFER_SIZE (2 * 1024)
+#define H4032L_DATA_BUFFER_SIZE_MAX (256 * 1024)
+#define H4032L_DATA_TRANSFER_NUM 8
 #define H4032L_DATA_TRANSFER_MAX_NUM 32
+/* Download rate of the capture memory, to detect late transfers. */
+#define H4032L_DATA_BYTES_PER_MS (40 * 1000)
 
 #define H4043L_NUM_SAMPLES_MIN (2 * 1024)
 #define H4032L_NUM_SAMPLES_MAX (64 * 1024 * 1024)
@@ -163,6 +167,9 @@ struct dev_context {
 	struct h4032l_cmd_pkt cmd_pkt;
 	unsigned int num_transfers;
 	struct libusb_transfer **transfers;
+	struct sr_usb_xfer_pool *xfer_pool;
+	struct sr_usb_stream *stream;
+	unsigned int unitsize;
 	uint8_t buf[512];
 	uint64_t capture_ratio;
 	uint32_t trigger_pos;
@@ -176,7 +183,6 @@ struct dev_context {
 SR_PRIV int h4032l_receive_data(int fd, int revents, void *cb_data);
 SR_PRIV uint16_t h4032l_voltage2pwm(double voltage);
 SR_PRIV void LIBUSB_CALL h4032l_usb_callback(struct libusb_transfer *transfer);
-SR_PRIV void LIBUSB_CALL h4032l_data_transfer_callback(struct libusb_transfer *transfer);
 SR_PRIV int h4032l_start_data_transfers(const struct sr_dev_inst *sdi);
 SR_PRIV int h4032l_start(const struct sr_dev_inst *sdi);
 SR_PRIV int h4032l_stop(struct sr_dev_inst *sdi);
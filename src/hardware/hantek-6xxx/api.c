@@ -40,6 +40,7 @@ static const uint32_t devopts[] = {
 	SR_CONF_LIMIT_MSEC | SR_CONF_GET | SR_CONF_SET,
 	SR_CONF_SAMPLERATE | SR_CONF_GET | SR_CONF_SET | SR_CONF_LIST,
 	SR_CONF_NUM_VDIV | SR_CONF_GET,
+	SR_CONF_ANALOG_ENCODING | SR_CONF_GET | SR_CONF_SET | SR_CONF_LIST,
 };
 
 static const uint32_t devopts_cg[] = {
@@ -59,6 +60,11 @@ static const char *acdc_coupling[] = {
 	"AC", "DC",
 };
 
+/* Indexed by dev_context.analog_float. */
+static const char *analog_encodings[] = {
+	"uint8", "float",
+};
+
 static const uint64_t vdivs[][2] = {
 	VDIV_VALUES
 };
@@ -234,7 +240,7 @@ static GSList *scan(struct sr_dev_driver *di, GSList *options)
 		conn_devices = NULL;
 
 	/* Find all Hantek 60xx devices and upload firmware to all of them. */
-	libusb_get_device_list(drvc->sr_ctx->libusb_ctx, &devlist);
+	sr_usb_device_list(drvc->sr_ctx, &devlist);
 	for (i = 0; devlist[i]; i++) {
 		if (conn) {
 			usb = NULL;
@@ -389,6 +395,9 @@ static int config_get(uint32_t key, GVariant **data,
 		case SR_CONF_LIMIT_SAMPLES:
 			*data = g_variant_new_uint64(devc->limit_samples);
 			break;
+		case SR_CONF_ANALOG_ENCODING:
+			*data = g_variant_new_string(analog_encodings[devc->analog_float]);
+			break;
 		case SR_CONF_CONN:
 			if (!sdi->conn)
 				return SR_ERR_ARG;
@@ -443,6 +452,11 @@ static int config_set(uint32_t key, GVariant *data,
 		case SR_CONF_LIMIT_SAMPLES:
 			devc->limit_samples = g_variant_get_uint64(data);
 			break;
+		case SR_CONF_ANALOG_ENCODING:
+			if ((idx = std_str_idx(data, ARRAY_AND_SIZE(analog_encodings))) < 0)
+				return SR_ERR_ARG;
+			devc->analog_float = idx;
+			break;
 		default:
 			return SR_ERR_NA;
 		}
@@ -490,6 +504,9 @@ static int config_list(uint32_t key, GVariant **data,
 		case SR_CONF_SAMPLERATE:
 			*data = std_gvar_samplerates(ARRAY_AND_SIZE(samplerates));
 			break;
+		case SR_CONF_ANALOG_ENCODING:
+			*data = g_variant_new_strv(ARRAY_AND_SIZE(analog_encodings));
+			break;
 		default:
 			return SR_ERR_NA;
 		}
@@ -552,6 +569,7 @@ static void send_chunk(struct sr_dev_inst *sdi, unsigned char *buf,
 	struct sr_analog_spec spec;
 	struct dev_context *devc = sdi->priv;
 	GSList *channels = devc->enabled_channels;
+	float *fdata;
 
 	const float ch_bit[] = { RANGE(0) / 255, RANGE(1) / 255 };
 	const float ch_center[] = { RANGE(0) / 2, RANGE(1) / 2 };
@@ -566,13 +584,27 @@ static void send_chunk(struct sr_dev_inst *sdi, unsigned char *buf,
 	analog.meaning->unit = SR_UNIT_VOLT;
 	analog.meaning->mqflags = 0;
 
-	analog.data = g_try_malloc(num_samples * sizeof(float));
-	if (!analog.data) {
-		sr_err("Analog data buffer malloc failed.");
-		devc->dev_state = STOPPING;
-		return;
+	fdata = NULL;
+	if (devc->analog_float) {
+		fdata = g_try_malloc(num_samples * sizeof(float));
+		if (!fdata) {
+			sr_err("Analog data buffer malloc failed.");
+			devc->dev_state = STOPPING;
+			return;
+		}
 	}
 
+	/*
+	 * The device always sends data for both channels. If a channel
+	 * is disabled, it contains a copy of the enabled channel's
+	 * data. However, we only send the requested channels to
+	 * the bus.
+	 *
+	 * Voltage values are encoded as a value 0-255, where the
+	 * value is a point in the range represented by the vdiv
+	 * setting. There are 10 vertical divs, so e.g. 500mV/div
+	 * represents 5V peak-to-peak where 0 = -2.5V and 255 = +2.5V.
+	 */
 	for (int ch = 0; ch < NUM_CHANNELS; ch++) {
 		if (!devc->ch_enabled[ch])
 			continue;
@@ -583,19 +615,16 @@ static void send_chunk(struct sr_dev_inst *sdi, unsigned char *buf,
 		analog.spec->spec_digits = digits;
 		analog.meaning->channels = g_slist_append(NULL, channels->data);
 
-		for (int i = 0; i < num_samples; i++) {
-			/*
-			 * The device always sends data for both channels. If a channel
-			 * is disabled, it contains a copy of the enabled channel's
-			 * data. However, we only send the requested channels to
-			 * the bus.
-			 *
-			 * Voltage values are encoded as a value 0-255, where the
-			 * value is a point in the range represented by the vdiv
-			 * setting. There are 10 vertical divs, so e.g. 500mV/div
-			 * represents 5V peak-to-peak where 0 = -2.5V and 255 = +2.5V.
-			 */
-			((float *)analog.data)[i] = ch_bit[ch] * *(buf + i * 2 + ch) - ch_center[ch];
+		if (fdata) {
+			for (int i = 0; i < num_samples; i++)
+				fdata[i] = ch_bit[ch] * *(buf + i * 2 + ch) - ch_center[ch];
+			analog.data = fdata;
+		} else {
+			/* Send the channel's bytes in place, with their scale. */
+			sr_analog_set_raw_encoding(analog.encoding, 1, FALSE, FALSE,
+				ch_bit[ch], -ch_center[ch]);
+			analog.encoding->sample_stride = NUM_CHANNELS;
+			analog.data = buf + ch;
 		}
 
 		sr_session_send(sdi, &packet);
@@ -603,7 +632,7 @@ static void send_chunk(struct sr_dev_inst *sdi, unsigned char *buf,
 
 		channels = channels->next;
 	}
-	g_free(analog.data);
+	g_free(fdata);
 }
 
 /*
@@ -145,6 +145,9 @@ struct dev_context {
 
 	uint64_t limit_msec;
 	uint64_t limit_samples;
+
+	/* Send samples as floats instead of the device's 8-bit values. */
+	gboolean analog_float;
 };
 
 SR_PRIV int hantek_6xxx_open(struct sr_dev_inst *sdi);
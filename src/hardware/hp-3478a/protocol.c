@@ -510,9 +510,7 @@ SR_PRIV int hp_3478a_receive_data(int fd, int revents, void *cb_data)
 		return FALSE;
 
 	acq_send_measurement(sdi);
-	sr_sw_limits_update_samples_read(&devc->limits, 1);
-
-	if (sr_sw_limits_check(&devc->limits))
+	if (sr_sw_limits_update_and_check(&devc->limits, 1))
 		sr_dev_acquisition_stop(sdi);
 
 	return TRUE;
@@ -32,6 +32,8 @@ static const uint32_t devopts[] = {
 	SR_CONF_TRIGGER_MATCH | SR_CONF_LIST,
 	SR_CONF_CAPTURE_RATIO | SR_CONF_GET | SR_CONF_SET,
 	SR_CONF_LIMIT_SAMPLES | SR_CONF_GET | SR_CONF_SET,
+	SR_CONF_LIMIT_FRAMES | SR_CONF_GET | SR_CONF_SET,
+	SR_CONF_CONTINUOUS | SR_CONF_GET | SR_CONF_SET,
 };
 
 static const int32_t trigger_matches[] = {
@@ -188,6 +190,12 @@ static int config_get(uint32_t key, GVariant **data,
 	case SR_CONF_LIMIT_SAMPLES:
 		*data = g_variant_new_uint64(devc->limit_samples);
 		break;
+	case SR_CONF_LIMIT_FRAMES:
+		*data = g_variant_new_uint64(devc->limit_frames);
+		break;
+	case SR_CONF_CONTINUOUS:
+		*data = g_variant_new_boolean(devc->continuous);
+		break;
 	default:
 		return SR_ERR_NA;
 	}
@@ -213,6 +221,12 @@ static int config_set(uint32_t key, GVariant *data,
 				devc->limit_samples = limit_samples;
 		}
 		break;
+	case SR_CONF_LIMIT_FRAMES:
+		devc->limit_frames = g_variant_get_uint64(data);
+		break;
+	case SR_CONF_CONTINUOUS:
+		devc->continuous = g_variant_get_boolean(data);
+		break;
 	default:
 		return SR_ERR_NA;
 	}
@@ -246,6 +260,11 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 	ipdbg_la_send_trigger(devc, tcp);
 	ipdbg_la_send_delay(devc, tcp);
 
+	devc->num_transfers = 0;
+	devc->num_frames = 0;
+
+	std_session_send_df_header(sdi);
+
 	/* If the device stops sending for longer than it takes to send a byte,
 	 * that means it's finished. But wait at least 100 ms to be safe.
 	 */
@@ -277,6 +296,9 @@ static int dev_acquisition_stop(struct sr_dev_inst *sdi)
 	ipdbg_la_send_reset(tcp);
 	ipdbg_la_abort_acquisition(sdi);
 
+	g_free(devc->raw_sample_buf);
+	devc->raw_sample_buf = NULL;
+
 	return SR_OK;
 }
 
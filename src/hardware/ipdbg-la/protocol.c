@@ -37,6 +37,12 @@
 
 #define BUFFER_SIZE 4
 
+/*
+ * Socket receive buffer size. Lets the kernel queue a whole readout
+ * of the sample memory while the main loop is busy elsewhere.
+ */
+#define RECV_BUFFER_SIZE (1024 * 1024)
+
 /* Top-level command opcodes */
 #define CMD_SET_TRIGGER            0x00
 #define CMD_CFG_TRIGGER            0xF0
@@ -100,7 +106,7 @@ SR_PRIV int ipdbg_la_tcp_open(struct ipdbg_la_tcp *tcp)
 {
 	struct addrinfo hints;
 	struct addrinfo *results, *res;
-	int err;
+	int err, bufsize;
 
 	memset(&hints, 0, sizeof(hints));
 	hints.ai_family = AF_UNSPEC;
@@ -135,6 +141,11 @@ SR_PRIV int ipdbg_la_tcp_open(struct ipdbg_la_tcp *tcp)
 		return SR_ERR;
 	}
 
+	bufsize = RECV_BUFFER_SIZE;
+	if (setsockopt(tcp->socket, SOL_SOCKET, SO_RCVBUF,
+			(const char *)&bufsize, sizeof(bufsize)) != 0)
+		sr_dbg("Cannot enlarge receive buffer: %s", g_strerror(errno));
+
 	return SR_OK;
 }
 
@@ -297,6 +308,11 @@ SR_PRIV int ipdbg_la_receive_data(int fd, int revents, void *cb_data)
 	struct ipdbg_la_tcp *tcp = sdi->conn;
 	struct sr_datafeed_packet packet;
 	struct sr_datafeed_logic logic;
+	uint8_t discard[4096];
+	uint8_t *buf;
+	uint64_t total, wanted;
+	size_t len;
+	int recd;
 
 	if (!devc->raw_sample_buf) {
 		devc->raw_sample_buf =
@@ -307,55 +323,70 @@ SR_PRIV int ipdbg_la_receive_data(int fd, int revents, void *cb_data)
 		}
 	}
 
-	if (devc->num_transfers <
-		(devc->limit_samples_max * devc->data_width_bytes)) {
-		const size_t bufsize = 1024;
-		uint8_t buffer[bufsize];
-
-		const int recd = ipdbg_la_tcp_receive(tcp, buffer, bufsize);
-		if ( recd > 0) {
-			int num_move = (((devc->num_transfers + recd) <=
-							 (devc->limit_samples * devc->data_width_bytes))
-			?
-				recd
-			:
-				(int)((devc->limit_samples * devc->data_width_bytes) -
-						devc->num_transfers));
-			if ( num_move > 0 )
-				memcpy(&(devc->raw_sample_buf[devc->num_transfers]),
-						buffer, num_move);
-			devc->num_transfers += recd;
-		}
-	} else {
-		if (devc->delay_value > 0) {
-			/* There are pre-trigger samples, send those first. */
-			packet.type = SR_DF_LOGIC;
-			packet.payload = &logic;
-			logic.length = devc->delay_value * devc->data_width_bytes;
-			logic.unitsize = devc->data_width_bytes;
-			logic.data = devc->raw_sample_buf;
-			sr_session_send(cb_data, &packet);
+	/*
+	 * The device sends its whole sample memory, keep what was asked
+	 * for. Drain everything the socket has queued in one go.
+	 */
+	total = devc->limit_samples_max * devc->data_width_bytes;
+	wanted = devc->limit_samples * devc->data_width_bytes;
+	while (devc->num_transfers < total) {
+		if (devc->num_transfers < wanted) {
+			buf = devc->raw_sample_buf + devc->num_transfers;
+			len = wanted - devc->num_transfers;
+		} else {
+			buf = discard;
+			len = MIN(sizeof(discard), total - devc->num_transfers);
 		}
+		recd = ipdbg_la_tcp_receive(tcp, buf, len);
+		if (recd <= 0)
+			break;
+		devc->num_transfers += recd;
+	}
+	if (devc->num_transfers < total)
+		return TRUE;
 
-		/* Send the trigger. */
-		std_session_send_df_trigger(cb_data);
+	if (devc->continuous)
+		std_session_send_df_frame_begin(sdi);
 
-		/* Send post-trigger samples. */
+	if (devc->delay_value > 0) {
+		/* There are pre-trigger samples, send those first. */
 		packet.type = SR_DF_LOGIC;
 		packet.payload = &logic;
-		logic.length = (devc->limit_samples - devc->delay_value) *
-			devc->data_width_bytes;
+		logic.length = devc->delay_value * devc->data_width_bytes;
 		logic.unitsize = devc->data_width_bytes;
-		logic.data = devc->raw_sample_buf +
-			(devc->delay_value * devc->data_width_bytes);
+		logic.data = devc->raw_sample_buf;
 		sr_session_send(cb_data, &packet);
+	}
 
-		g_free(devc->raw_sample_buf);
-		devc->raw_sample_buf = NULL;
-
-		ipdbg_la_abort_acquisition(sdi);
+	/* Send the trigger. */
+	std_session_send_df_trigger(cb_data);
+
+	/* Send post-trigger samples. */
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+	logic.length = (devc->limit_samples - devc->delay_value) *
+		devc->data_width_bytes;
+	logic.unitsize = devc->data_width_bytes;
+	logic.data = devc->raw_sample_buf +
+		(devc->delay_value * devc->data_width_bytes);
+	sr_session_send(cb_data, &packet);
+
+	if (devc->continuous) {
+		std_session_send_df_frame_end(sdi);
+		devc->num_frames++;
+		if (!devc->limit_frames || devc->num_frames < devc->limit_frames) {
+			/* The trigger setup is kept, arm for the next capture. */
+			devc->num_transfers = 0;
+			ipdbg_la_send_start(tcp);
+			return TRUE;
+		}
 	}
 
+	g_free(devc->raw_sample_buf);
+	devc->raw_sample_buf = NULL;
+
+	ipdbg_la_abort_acquisition(sdi);
+
 	return TRUE;
 }
 
@@ -52,6 +52,11 @@ struct dev_context {
 	int num_stages;
 	uint64_t num_transfers;
 	uint8_t *raw_sample_buf;
+
+	/* Continuous mode: re-arm after every capture. */
+	gboolean continuous;
+	uint64_t limit_frames;
+	uint64_t num_frames;
 };
 
 SR_PRIV struct ipdbg_la_tcp *ipdbg_la_tcp_new(void);
@@ -34,6 +34,7 @@
 
 static const uint32_t scanopts[] = {
 	SR_CONF_CONN,
+	SR_CONF_FORCE_UPLOAD,
 };
 
 static const uint32_t drvopts[] = {
@@ -41,15 +42,17 @@ static const uint32_t drvopts[] = {
 };
 
 static const uint32_t devopts[] = {
-	/* TODO: SR_CONF_CONTINUOUS, */
+	SR_CONF_CONTINUOUS | SR_CONF_GET | SR_CONF_SET,
 	SR_CONF_CONN | SR_CONF_GET,
 	SR_CONF_SAMPLERATE | SR_CONF_GET | SR_CONF_SET | SR_CONF_LIST,
 	SR_CONF_LIMIT_SAMPLES | SR_CONF_SET | SR_CONF_GET | SR_CONF_LIST,
+	SR_CONF_LIMIT_FRAMES | SR_CONF_SET | SR_CONF_GET,
 	SR_CONF_VOLTAGE_THRESHOLD | SR_CONF_GET | SR_CONF_SET | SR_CONF_LIST,
 	SR_CONF_LOGIC_THRESHOLD | SR_CONF_GET | SR_CONF_SET | SR_CONF_LIST,
 	SR_CONF_LOGIC_THRESHOLD_CUSTOM | SR_CONF_GET | SR_CONF_SET,
 	SR_CONF_TRIGGER_MATCH | SR_CONF_LIST,
 	SR_CONF_CAPTURE_RATIO | SR_CONF_GET | SR_CONF_SET,
+	SR_CONF_RLE | SR_CONF_GET | SR_CONF_SET,
 };
 
 static const int32_t trigger_matches[] = {
@@ -126,16 +129,21 @@ static GSList *scan(struct sr_dev_driver *di, GSList *options)
 	char connection_id[64];
 	int64_t fw_updated;
 	unsigned int dev_addr;
+	gboolean force_upload;
 
 	drvc = di->context;
 
 	conn = NULL;
+	force_upload = FALSE;
 	for (l = options; l; l = l->next) {
 		src = l->data;
 		switch (src->key) {
 		case SR_CONF_CONN:
 			conn = g_variant_get_string(src->data, NULL);
 			break;
+		case SR_CONF_FORCE_UPLOAD:
+			force_upload = g_variant_get_boolean(src->data);
+			break;
 		}
 	}
 	if (conn)
@@ -145,7 +153,7 @@ static GSList *scan(struct sr_dev_driver *di, GSList *options)
 
 	/* Find all LA2016 devices and upload firmware to them. */
 	devices = NULL;
-	libusb_get_device_list(drvc->sr_ctx->libusb_ctx, &devlist);
+	sr_usb_device_list(drvc->sr_ctx, &devlist);
 	for (i = 0; devlist[i]; i++) {
 		if (conn) {
 			usb = NULL;
@@ -202,6 +210,7 @@ static GSList *scan(struct sr_dev_driver *di, GSList *options)
 		devc = g_malloc0(sizeof(struct dev_context));
 		sdi->priv = devc;
 		devc->fw_updated = fw_updated;
+		devc->force_upload = force_upload;
 		devc->threshold_voltage_idx = 0;
 		devc->threshold_voltage = logic_threshold_value[devc->threshold_voltage_idx];
 
@@ -233,7 +242,7 @@ static int la2016_dev_open(struct sr_dev_inst *sdi)
 	usb = sdi->conn;
 	ret = SR_ERR;
 
-	device_count = libusb_get_device_list(drvc->sr_ctx->libusb_ctx, &devlist);
+	device_count = sr_usb_device_list(drvc->sr_ctx, &devlist);
 	if (device_count < 0) {
 		sr_err("Failed to get device list: %s.", libusb_error_name(device_count));
 		return SR_ERR;
@@ -366,14 +375,19 @@ static int dev_open(struct sr_dev_inst *sdi)
 static int dev_close(struct sr_dev_inst *sdi)
 {
 	struct sr_usb_dev_inst *usb;
+	struct dev_context *devc;
 
 	usb = sdi->conn;
+	devc = sdi->priv;
 
 	if (!usb->devhdl)
 		return SR_ERR_BUG;
 
 	la2016_deinit_device(sdi);
 
+	sr_usb_xfer_pool_free(devc->xfer_pool);
+	devc->xfer_pool = NULL;
+
 	sr_info("Closing device on %d.%d (logical) / %s (physical) interface %d.",
 		usb->bus, usb->address, sdi->connection_id, USB_INTERFACE);
 	libusb_release_interface(usb->devhdl, USB_INTERFACE);
@@ -414,6 +428,9 @@ static int config_get(uint32_t key, GVariant **data,
 	case SR_CONF_LIMIT_SAMPLES:
 		*data = g_variant_new_uint64(devc->limit_samples);
 		break;
+	case SR_CONF_LIMIT_FRAMES:
+		*data = g_variant_new_uint64(devc->limit_frames);
+		break;
 	case SR_CONF_CAPTURE_RATIO:
 		*data = g_variant_new_uint64(devc->capture_ratio);
 		break;
@@ -427,6 +444,12 @@ static int config_get(uint32_t key, GVariant **data,
 	case SR_CONF_LOGIC_THRESHOLD_CUSTOM:
 		*data = g_variant_new_double(devc->threshold_voltage);
 		break;
+	case SR_CONF_RLE:
+		*data = g_variant_new_boolean(devc->rle);
+		break;
+	case SR_CONF_CONTINUOUS:
+		*data = g_variant_new_boolean(devc->continuous);
+		break;
 
 	default:
 		return SR_ERR_NA;
@@ -453,6 +476,9 @@ static int config_set(uint32_t key, GVariant *data,
 	case SR_CONF_LIMIT_SAMPLES:
 		devc->limit_samples = g_variant_get_uint64(data);
 		break;
+	case SR_CONF_LIMIT_FRAMES:
+		devc->limit_frames = g_variant_get_uint64(data);
+		break;
 	case SR_CONF_CAPTURE_RATIO:
 		devc->capture_ratio = g_variant_get_uint64(data);
 		break;
@@ -475,6 +501,12 @@ static int config_set(uint32_t key, GVariant *data,
 	case SR_CONF_LOGIC_THRESHOLD_CUSTOM:
 		devc->threshold_voltage = g_variant_get_double(data);
 		break;
+	case SR_CONF_RLE:
+		devc->rle = g_variant_get_boolean(data);
+		break;
+	case SR_CONF_CONTINUOUS:
+		devc->continuous = g_variant_get_boolean(data);
+		break;
 	default:
 		return SR_ERR_NA;
 	}
@@ -513,31 +545,62 @@ static int config_list(uint32_t key, GVariant **data,
 	return SR_OK;
 }
 
-static void send_chunk(struct sr_dev_inst *sdi,
-	const uint8_t *packets, unsigned int num_tfers)
+/*
+ * Send the samples collected so far. In RLE mode the conversion buffer
+ * holds the offsets of the changes, followed by their values.
+ */
+static void send_samples(struct sr_dev_inst *sdi,
+	unsigned int n_samples, unsigned int n_edges)
 {
 	struct dev_context *devc;
 	struct sr_datafeed_logic logic;
+	struct sr_datafeed_logic_edges edges;
 	struct sr_datafeed_packet sr_packet;
-	unsigned int max_samples, n_samples, total_samples, free_n_samples;
-	unsigned int i, j, k;
-	int do_signal_trigger;
-	uint16_t *wp;
+
+	devc = sdi->priv;
+
+	if (!n_samples)
+		return;
+
+	if (devc->rle) {
+		edges.num_samples = n_samples;
+		edges.unitsize = 2;
+		edges.num_edges = n_edges;
+		edges.offsets = (uint64_t *)devc->convbuffer;
+		edges.values = devc->convbuffer + devc->max_edges * sizeof(uint64_t);
+		sr_packet.type = SR_DF_LOGIC_EDGES;
+		sr_packet.payload = &edges;
+	} else {
+		logic.length = n_samples * 2;
+		logic.unitsize = 2;
+		logic.data = devc->convbuffer;
+		sr_packet.type = SR_DF_LOGIC;
+		sr_packet.payload = &logic;
+	}
+	sr_session_send(sdi, &sr_packet);
+}
+
+static void send_chunk(struct sr_dev_inst *sdi,
+	const uint8_t *packets, unsigned int num_tfers)
+{
+	struct dev_context *devc;
+	unsigned int max_samples, n_samples, total_samples, n_edges;
+	unsigned int i, k;
+	int do_signal_trigger, full;
+	uint16_t *wp, *values;
+	uint64_t *offsets;
 	const uint8_t *rp;
 	uint16_t state;
 	uint8_t repetitions;
 
 	devc = sdi->priv;
 
-	logic.unitsize = 2;
-	logic.data = devc->convbuffer;
-
-	sr_packet.type = SR_DF_LOGIC;
-	sr_packet.payload = &logic;
-
 	max_samples = devc->convbuffer_size / 2;
 	n_samples = 0;
+	n_edges = 0;
 	wp = (uint16_t *)devc->convbuffer;
+	offsets = (uint64_t *)devc->convbuffer;
+	values = (uint16_t *)(devc->convbuffer + devc->max_edges * sizeof(uint64_t));
 	total_samples = 0;
 	do_signal_trigger = 0;
 
@@ -549,11 +612,14 @@ static void send_chunk(struct sr_dev_inst *sdi,
 	rp = packets;
 	for (i = 0; i < num_tfers; i++) {
 		for (k = 0; k < NUM_PACKETS_IN_CHUNK; k++) {
-			free_n_samples = max_samples - n_samples;
-			if (free_n_samples < 256 || do_signal_trigger) {
-				logic.length = n_samples * 2;
-				sr_session_send(sdi, &sr_packet);
+			if (devc->rle)
+				full = n_edges == devc->max_edges;
+			else
+				full = max_samples - n_samples < 256;
+			if (full || do_signal_trigger) {
+				send_samples(sdi, n_samples, n_edges);
 				n_samples = 0;
+				n_edges = 0;
 				wp = (uint16_t *)devc->convbuffer;
 				if (do_signal_trigger) {
 					std_session_send_df_trigger(sdi);
@@ -563,8 +629,19 @@ static void send_chunk(struct sr_dev_inst *sdi,
 
 			state = read_u16le_inc(&rp);
 			repetitions = read_u8_inc(&rp);
-			for (j = 0; j < repetitions; j++)
-				*wp++ = state;
+			if (devc->rle) {
+				/* Forward the changes instead of expanding runs. */
+				if (repetitions && (!devc->have_last_state ||
+						state != devc->last_state)) {
+					offsets[n_edges] = n_samples;
+					values[n_edges++] = state;
+					devc->last_state = state;
+					devc->have_last_state = TRUE;
+				}
+			} else {
+				sr_simd_fill_u16(wp, state, repetitions);
+				wp += repetitions;
+			}
 
 			n_samples += repetitions;
 			total_samples += repetitions;
@@ -583,8 +660,7 @@ static void send_chunk(struct sr_dev_inst *sdi,
 		(void)read_u8_inc(&rp); /* Skip sequence number. */
 	}
 	if (n_samples) {
-		logic.length = n_samples * 2;
-		sr_session_send(sdi, &sr_packet);
+		send_samples(sdi, n_samples, n_edges);
 		if (do_signal_trigger) {
 			std_session_send_df_trigger(sdi);
 		}
@@ -632,6 +708,109 @@ static void LIBUSB_CALL receive_transfer(struct libusb_transfer *transfer)
 	devc->transfer_finished = 1;
 }
 
+/*
+ * Streamed data is a sequence of blocks, with a 16bit word of 16 samples
+ * for each enabled channel. A block can span two transfers.
+ */
+static gboolean stream_data(struct sr_dev_inst *sdi, uint8_t *data,
+	size_t length, void *cb_data)
+{
+	struct dev_context *devc;
+	struct sr_datafeed_logic logic;
+	struct sr_datafeed_packet packet;
+	size_t block_size, count, num_blocks, n_samples;
+	uint16_t *wp;
+
+	(void)cb_data;
+
+	devc = sdi->priv;
+	block_size = devc->num_channels * sizeof(uint16_t);
+	wp = (uint16_t *)devc->convbuffer;
+	n_samples = 0;
+
+	/* Complete the block which the previous transfer started. */
+	if (devc->stream_carry_len) {
+		count = MIN(length, block_size - devc->stream_carry_len);
+		memcpy(devc->stream_carry + devc->stream_carry_len, data, count);
+		devc->stream_carry_len += count;
+		data += count;
+		length -= count;
+		if (devc->stream_carry_len < block_size)
+			return TRUE;
+		sr_simd_deinterleave_words(SR_SIMD_WORD16LE_LSB,
+			devc->stream_carry, block_size, wp,
+			devc->num_channels, devc->cur_channels);
+		devc->stream_carry_len = 0;
+		n_samples = 16;
+	}
+
+	num_blocks = length / block_size;
+	sr_simd_deinterleave_words(SR_SIMD_WORD16LE_LSB, data,
+		num_blocks * block_size, wp + n_samples,
+		devc->num_channels, devc->cur_channels);
+	n_samples += num_blocks * 16;
+	devc->stream_carry_len = length - num_blocks * block_size;
+	memcpy(devc->stream_carry, data + num_blocks * block_size,
+		devc->stream_carry_len);
+
+	if (devc->limit_samples && devc->sent_samples + n_samples > devc->limit_samples)
+		n_samples = devc->limit_samples - devc->sent_samples;
+	if (n_samples) {
+		logic.length = n_samples * sizeof(uint16_t);
+		logic.unitsize = sizeof(uint16_t);
+		logic.data = devc->convbuffer;
+		packet.type = SR_DF_LOGIC;
+		packet.payload = &logic;
+		sr_session_send(sdi, &packet);
+		devc->sent_samples += n_samples;
+	}
+
+	return !devc->limit_samples || devc->sent_samples < devc->limit_samples;
+}
+
+static void stream_done(struct sr_dev_inst *sdi, void *cb_data)
+{
+	struct dev_context *devc;
+
+	(void)cb_data;
+
+	devc = sdi->priv;
+	devc->stream = NULL;
+	devc->transfer_finished = 1;
+}
+
+static int start_stream(const struct sr_dev_inst *sdi)
+{
+	struct dev_context *devc;
+	struct sr_usb_stream_params params;
+	int ret;
+
+	devc = sdi->priv;
+
+	if (!devc->xfer_pool)
+		devc->xfer_pool = sr_usb_xfer_pool_new(sdi->conn,
+			LA2016_STREAM_TRANSFER_SIZE, TRUE);
+
+	if ((ret = la2016_start_streaming(sdi)) != SR_OK)
+		return ret;
+
+	devc->sent_samples = 0;
+	devc->stream_carry_len = 0;
+	devc->transfer_finished = 0;
+
+	memset(&params, 0, sizeof(params));
+	params.endpoint = 0x86;
+	params.pool = devc->xfer_pool;
+	params.num_transfers = LA2016_STREAM_TRANSFERS;
+	params.max_transfers = LA2016_STREAM_TRANSFERS;
+	params.bytes_per_ms = devc->cur_samplerate * devc->num_channels / 8 / 1000;
+	params.data_cb = stream_data;
+	params.done_cb = stream_done;
+
+	return sr_usb_stream_start((struct sr_dev_inst *)sdi, &params,
+		&devc->stream);
+}
+
 static int handle_event(int fd, int revents, void *cb_data)
 {
 	const struct sr_dev_inst *sdi;
@@ -647,6 +826,14 @@ static int handle_event(int fd, int revents, void *cb_data)
 	drvc = sdi->driver->context;
 
 	if (devc->have_trigger == 0) {
+		if (devc->stop_requested) {
+			/* Stopped while waiting for the next trigger. */
+			usb_source_remove(sdi->session, drvc->sr_ctx);
+			std_session_send_df_end(sdi);
+			g_free(devc->convbuffer);
+			devc->convbuffer = NULL;
+			return TRUE;
+		}
 		if (la2016_has_triggered(sdi) == 0) {
 			sr_dbg("not yet ready for download...");
 			return TRUE;
@@ -672,6 +859,19 @@ static int handle_event(int fd, int revents, void *cb_data)
 	if (devc->transfer_finished) {
 		sr_dbg("transfer is finished!");
 		std_session_send_df_frame_end(sdi);
+		devc->num_frames++;
+
+		/* Re-arm with the same setup for the next shot. */
+		if (!devc->continuous && !devc->stop_requested &&
+				devc->num_frames < devc->limit_frames) {
+			devc->transfer_finished = 0;
+			devc->have_trigger = 0;
+			devc->have_last_state = FALSE;
+			la2016_stop_acquisition(sdi);
+			if (la2016_start_acquisition(sdi) == SR_OK)
+				return TRUE;
+			sr_err("Failed to re-arm for the next frame.");
+		}
 
 		usb_source_remove(sdi->session, drvc->sr_ctx);
 		std_session_send_df_end(sdi);
@@ -691,6 +891,7 @@ static void abort_acquisition(struct dev_context *devc)
 {
 	if (devc->transfer)
 		libusb_cancel_transfer(devc->transfer);
+	sr_usb_stream_stop(devc->stream);
 }
 
 static int configure_channels(const struct sr_dev_inst *sdi)
@@ -728,7 +929,14 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 		return SR_ERR;
 	}
 
-	devc->convbuffer_size = 4 * 1024 * 1024;
+	if (devc->continuous && sr_session_trigger_get(sdi->session)) {
+		sr_err("Triggers are not supported in streaming mode.");
+		return SR_ERR_NA;
+	}
+
+	devc->convbuffer_size = LA2016_CONVBUFFER_SIZE;
+	devc->max_edges = devc->convbuffer_size / (sizeof(uint64_t) + 2);
+	devc->have_last_state = FALSE;
 	if (!(devc->convbuffer = g_try_malloc(devc->convbuffer_size))) {
 		sr_err("Conversion buffer malloc failed.");
 		return SR_ERR_MALLOC;
@@ -741,6 +949,27 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 	}
 
 	devc->ctx = drvc->sr_ctx;
+	devc->num_frames = 0;
+	devc->stop_requested = FALSE;
+
+	if (devc->continuous) {
+		/* The transfers need to be waiting before the device streams. */
+		std_session_send_df_header(sdi);
+		std_session_send_df_frame_begin(sdi);
+		if ((ret = start_stream(sdi)) != SR_OK) {
+			std_session_send_df_end(sdi);
+			g_free(devc->convbuffer);
+			devc->convbuffer = NULL;
+			return ret;
+		}
+		devc->have_trigger = 1;
+		usb_source_add(sdi->session, drvc->sr_ctx, 50, handle_event, (void *)sdi);
+		/* On errors the event handler finishes the cancelled stream. */
+		if ((ret = la2016_start_acquisition(sdi)) != SR_OK)
+			abort_acquisition(devc);
+
+		return ret;
+	}
 
 	if ((ret = la2016_start_acquisition(sdi)) != SR_OK) {
 		abort_acquisition(devc);
@@ -757,10 +986,14 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 
 static int dev_acquisition_stop(struct sr_dev_inst *sdi)
 {
+	struct dev_context *devc;
 	int ret;
 
+	devc = sdi->priv;
+	devc->stop_requested = TRUE;
+
 	ret = la2016_abort_acquisition(sdi);
-	abort_acquisition(sdi->priv);
+	abort_acquisition(devc);
 
 	return ret;
 }
@@ -44,6 +44,7 @@
 /* registers for control request 32: */
 #define CTRL_RUN         0x00
 #define CTRL_PWM_EN      0x02
+#define CTRL_CAPT_MODE   0x03
 #define CTRL_BULK        0x10 /* can be read to get 12 byte sampling_info (III) */
 #define CTRL_SAMPLING    0x20
 #define CTRL_TRIGGER     0x30
@@ -51,6 +52,10 @@
 #define CTRL_PWM1        0x70
 #define CTRL_PWM2        0x78
 
+/* values of CTRL_CAPT_MODE: */
+#define CAPT_MODE_TO_RAM 0x00
+#define CAPT_MODE_STREAM 0x01
+
 static int ctrl_in(const struct sr_dev_inst *sdi,
 		   uint8_t bRequest, uint16_t wValue, uint16_t wIndex,
 		   void *data, uint16_t wLength)
@@ -95,6 +100,8 @@ static int ctrl_out(const struct sr_dev_inst *sdi,
 	return SR_OK;
 }
 
+static uint16_t run_state(const struct sr_dev_inst *sdi);
+
 static int upload_fpga_bitstream(const struct sr_dev_inst *sdi)
 {
 	struct dev_context *devc;
@@ -114,8 +121,6 @@ static int upload_fpga_bitstream(const struct sr_dev_inst *sdi)
 	drvc = sdi->driver->context;
 	usb = sdi->conn;
 
-	sr_info("Uploading FPGA bitstream '%s'.", FPGA_FIRMWARE);
-
 	ret = sr_resource_open(drvc->sr_ctx, &bitstream, SR_RESOURCE_FIRMWARE, FPGA_FIRMWARE);
 	if (ret != SR_OK) {
 		sr_err("could not find la2016 firmware %s!", FPGA_FIRMWARE);
@@ -123,6 +128,17 @@ static int upload_fpga_bitstream(const struct sr_dev_inst *sdi)
 	}
 
 	devc->bitstream_size = (uint32_t)bitstream.size;
+
+	/* Still configured from a previous open, just enable the FPGA. */
+	if (!devc->force_upload && run_state(sdi) != 0xffff &&
+			sr_usb_fpga_image_current(usb, FPGA_FIRMWARE, bitstream.size)) {
+		sr_resource_close(drvc->sr_ctx, &bitstream);
+		sr_info("FPGA bitstream '%s' already loaded.", FPGA_FIRMWARE);
+		goto enable;
+	}
+
+	sr_info("Uploading FPGA bitstream '%s'.", FPGA_FIRMWARE);
+	sr_usb_fpga_image_record(usb, NULL, 0);
 	wrptr = buffer;
 	write_u32le_inc(&wrptr, devc->bitstream_size);
 	if ((ret = ctrl_out(sdi, 80, 0x00, 0, buffer, wrptr - buffer)) != SR_OK) {
@@ -176,9 +192,11 @@ static int upload_fpga_bitstream(const struct sr_dev_inst *sdi)
 		sr_err("after fpga bitstream upload command response is 0x%02x, expect 0!", cmd_resp);
 		return SR_ERR;
 	}
+	sr_usb_fpga_image_record(usb, FPGA_FIRMWARE, bitstream.size);
 
 	g_usleep(30000);
 
+enable:
 	if ((ret = ctrl_out(sdi, 16, 0x01, 0, NULL, 0)) != SR_OK) {
 		sr_err("failed enable fpga");
 		return ret;
@@ -433,11 +451,29 @@ static int set_sample_config(const struct sr_dev_inst *sdi)
 	divisor = (uint16_t)(clock_divisor + 0.5);
 	devc->cur_samplerate = MAX_SAMPLE_RATE / divisor;
 
-	if (devc->limit_samples > MAX_SAMPLE_DEPTH) {
+	if (!devc->continuous && devc->limit_samples > MAX_SAMPLE_DEPTH) {
 		sr_err("too high sample depth: %" PRIu64, devc->limit_samples);
 		return SR_ERR;
 	}
 
+	if (devc->continuous) {
+		/* The device streams until stopped, the limit is in software. */
+		if (devc->cur_samplerate * devc->num_channels > LA2016_STREAM_MAX_BITRATE) {
+			sr_err("%" PRIu64 "Hz with %d channels is too fast for streaming.",
+			       devc->cur_samplerate, devc->num_channels);
+			return SR_ERR_SAMPLERATE;
+		}
+		wrptr = buf;
+		write_u32le_inc(&wrptr, 0);
+		write_u48le_inc(&wrptr, 0);
+		write_u32le_inc(&wrptr, 0);
+		write_u16le_inc(&wrptr, clock_divisor);
+		ret = ctrl_out(sdi, 32, CTRL_SAMPLING, 0, buf, wrptr - buf);
+		if (ret != SR_OK)
+			sr_err("error setting sample config!");
+		return ret;
+	}
+
 	devc->pre_trigger_size = (devc->capture_ratio * devc->limit_samples) / 100;
 
 	sr_dbg("set sampling configuration %.0fkHz, %d samples, trigger-pos %d%%",
@@ -542,9 +578,9 @@ SR_PRIV int la2016_setup_acquisition(const struct sr_dev_inst *sdi)
 	if (ret != SR_OK)
 		return ret;
 
-	cmd = 0;
-	if ((ret = ctrl_out(sdi, 32, 0x03, 0, &cmd, sizeof(cmd))) != SR_OK) {
-		sr_err("failed to send stop sampling command");
+	cmd = devc->continuous ? CAPT_MODE_STREAM : CAPT_MODE_TO_RAM;
+	if ((ret = ctrl_out(sdi, 32, CTRL_CAPT_MODE, 0, &cmd, sizeof(cmd))) != SR_OK) {
+		sr_err("failed to set capture mode");
 		return ret;
 	}
 
@@ -651,6 +687,26 @@ SR_PRIV int la2016_start_retrieval(const struct sr_dev_inst *sdi, libusb_transfe
 	return SR_OK;
 }
 
+/*
+ * In streaming mode the device sends the samples on the bulk endpoint
+ * while it captures, there is no read position or length to set up.
+ */
+SR_PRIV int la2016_start_streaming(const struct sr_dev_inst *sdi)
+{
+	int ret;
+
+	if ((ret = ctrl_out(sdi, 56, 0x00, 0, NULL, 0)) != SR_OK) {
+		sr_err("failed to reset bulk state");
+		return ret;
+	}
+	if ((ret = ctrl_out(sdi, 48, 0x00, 0, NULL, 0)) != SR_OK) {
+		sr_err("failed to unblock bulk transfers");
+		return ret;
+	}
+
+	return SR_OK;
+}
+
 SR_PRIV int la2016_init_device(const struct sr_dev_inst *sdi)
 {
 	struct dev_context *devc;
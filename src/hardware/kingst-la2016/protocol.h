@@ -36,6 +36,15 @@
 #define USB_CONFIGURATION	1
 
 #define LA2016_BULK_MAX         8388608
+#define LA2016_CONVBUFFER_SIZE  (16 * 1024 * 1024)
+
+/*
+ * Streaming sends 16bit words with 16 samples of one channel each, for
+ * each enabled channel in turn. The bit rate has to fit the USB link.
+ */
+#define LA2016_STREAM_MAX_BITRATE  SR_MHZ(200)
+#define LA2016_STREAM_TRANSFERS    8
+#define LA2016_STREAM_TRANSFER_SIZE (64 * 1024)
 
 #define MAX_RENUM_DELAY_MS	3000
 #define DEFAULT_TIMEOUT_MS      200
@@ -77,12 +86,15 @@ struct dev_context {
 	struct sr_context *ctx;
 
 	int64_t fw_updated;
+	gboolean force_upload;
 	pwm_setting_t pwm_setting[2];
 	unsigned int threshold_voltage_idx;
 	float threshold_voltage;
 	uint64_t cur_samplerate;
 	uint64_t limit_samples;
+	uint64_t limit_frames;
 	uint64_t capture_ratio;
+	gboolean continuous;
 	uint16_t cur_channels;
 	int num_channels;
 
@@ -102,10 +114,25 @@ struct dev_context {
 	unsigned int reading_behind_trigger;
 	uint64_t total_samples;
 	uint32_t read_pos;
+	uint64_t num_frames;
+	gboolean stop_requested;
+
+	/* Send changes as SR_DF_LOGIC_EDGES instead of expanding runs. */
+	gboolean rle;
+	gboolean have_last_state;
+	uint16_t last_state;
+	unsigned int max_edges;
 
 	unsigned int convbuffer_size;
 	uint8_t *convbuffer;
 	struct libusb_transfer *transfer;
+
+	/* streaming */
+	struct sr_usb_stream *stream;
+	struct sr_usb_xfer_pool *xfer_pool;
+	uint8_t stream_carry[2 * 16];
+	unsigned int stream_carry_len;
+	uint64_t sent_samples;
 };
 
 SR_PRIV int la2016_upload_firmware(struct sr_context *sr_ctx, libusb_device *dev, uint16_t product_id);
@@ -115,6 +142,7 @@ SR_PRIV int la2016_stop_acquisition(const struct sr_dev_inst *sdi);
 SR_PRIV int la2016_abort_acquisition(const struct sr_dev_inst *sdi);
 SR_PRIV int la2016_has_triggered(const struct sr_dev_inst *sdi);
 SR_PRIV int la2016_start_retrieval(const struct sr_dev_inst *sdi, libusb_transfer_cb_fn cb);
+SR_PRIV int la2016_start_streaming(const struct sr_dev_inst *sdi);
 SR_PRIV int la2016_init_device(const struct sr_dev_inst *sdi);
 SR_PRIV int la2016_deinit_device(const struct sr_dev_inst *sdi);
 
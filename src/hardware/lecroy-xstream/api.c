@@ -38,6 +38,7 @@ static const uint32_t drvopts[] = {
 
 static const uint32_t devopts[] = {
 	SR_CONF_LIMIT_FRAMES | SR_CONF_GET | SR_CONF_SET,
+	SR_CONF_NUM_SEGMENTS | SR_CONF_GET | SR_CONF_SET,
 	SR_CONF_SAMPLERATE | SR_CONF_GET,
 	SR_CONF_TIMEBASE | SR_CONF_GET | SR_CONF_SET | SR_CONF_LIST,
 	SR_CONF_NUM_HDIV | SR_CONF_GET,
@@ -127,6 +128,21 @@ static int dev_open(struct sr_dev_inst *sdi)
 
 static int dev_close(struct sr_dev_inst *sdi)
 {
+	struct dev_context *devc;
+	unsigned int i;
+
+	devc = sdi->priv;
+	if (devc->block) {
+		g_byte_array_free(devc->block, TRUE);
+		devc->block = NULL;
+	}
+	for (i = 0; i < MAX_ANALOG_CHANNEL_COUNT; i++) {
+		if (!devc->segment_blocks[i])
+			continue;
+		g_byte_array_free(devc->segment_blocks[i], TRUE);
+		devc->segment_blocks[i] = NULL;
+	}
+
 	return sr_scpi_close(sdi->conn);
 }
 
@@ -185,6 +201,9 @@ static int config_get(uint32_t key, GVariant **data,
 	case SR_CONF_SAMPLERATE:
 		*data = g_variant_new_uint64(state->sample_rate);
 		break;
+	case SR_CONF_NUM_SEGMENTS:
+		*data = g_variant_new_uint64(devc->num_segments);
+		break;
 	case SR_CONF_ENABLED:
 		*data = g_variant_new_boolean(FALSE);
 		break;
@@ -218,6 +237,10 @@ static int config_set(uint32_t key, GVariant *data,
 		devc->frame_limit = g_variant_get_uint64(data);
 		ret = SR_OK;
 		break;
+	case SR_CONF_NUM_SEGMENTS:
+		devc->num_segments = g_variant_get_uint64(data);
+		ret = SR_OK;
+		break;
 	case SR_CONF_TRIGGER_SOURCE:
 		if ((idx = std_str_idx(data, *model->trigger_sources, model->num_trigger_sources)) < 0)
 			return SR_ERR_ARG;
@@ -449,6 +472,16 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 		goto free_enabled;
 	}
 
+	/* Sequence mode captures all segments on a single arm. */
+	if (devc->num_segments > 1)
+		ret = sr_scpi_send(scpi, "SEQUENCE ON,%" PRIu64, devc->num_segments);
+	else
+		ret = sr_scpi_send(scpi, "SEQUENCE OFF");
+	if (ret != SR_OK) {
+		sr_err("Failed to configure sequence mode.");
+		goto free_enabled;
+	}
+
 	/*
 	 * Start acquisition on the first enabled channel. The
 	 * receive routine will continue driving the acquisition.
@@ -460,6 +493,10 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 
 	devc->current_channel = devc->enabled_channels;
 
+	/* Don't return a sequence which was captured before. */
+	if (devc->num_segments > 1)
+		sr_scpi_send(scpi, "ARM;WAIT;*OPC");
+
 	return lecroy_xstream_request_data(sdi);
 
 free_enabled:
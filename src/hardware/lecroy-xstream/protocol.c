@@ -544,8 +544,82 @@ SR_PRIV int lecroy_xstream_init_device(struct sr_dev_inst *sdi)
 	return SR_OK;
 }
 
+/*
+ * Blocks of a waveform, in this order: descriptor, user text, reserved
+ * descriptor, trigger times, RIS times, reserved array, samples.
+ */
+static size_t lecroy_trigtime_offset(const struct lecroy_wavedesc *desc)
+{
+	return desc->version_2_x.wave_descriptor_length
+		+ desc->version_2_x.user_text_len
+		+ desc->version_2_x.res_desc1;
+}
+
+static size_t lecroy_wave_array_offset(const struct lecroy_wavedesc *desc)
+{
+	return lecroy_trigtime_offset(desc)
+		+ desc->version_2_x.trigtime_array_length
+		+ desc->version_2_x.ris_time1_array_length
+		+ desc->version_2_x.res_array1;
+}
+
+static struct lecroy_wavedesc *lecroy_waveform_desc(GByteArray *data)
+{
+	struct lecroy_wavedesc *desc;
+
+	if (data->len < sizeof(struct lecroy_wavedesc))
+		return NULL;
+
+	desc = (struct lecroy_wavedesc*)data->data;
+
+	if (strncmp(desc->template_name, "LECROY_2_2", 16) &&
+	    strncmp(desc->template_name, "LECROY_2_3", 16)) {
+		sr_err("Waveformat template '%.16s' not supported.",
+			desc->template_name);
+		return NULL;
+	}
+
+	if (lecroy_wave_array_offset(desc) +
+	    desc->version_2_x.wave_array_count * sizeof(int16_t) > data->len) {
+		sr_err("Waveform is shorter than its descriptor claims.");
+		return NULL;
+	}
+
+	return desc;
+}
+
+/* Number of segments in a waveform, 1 unless it's a sequence. */
+static unsigned int lecroy_waveform_segments(const struct lecroy_wavedesc *desc)
+{
+	return MAX(desc->version_2_x.subarray_count, 1);
+}
+
+/*
+ * Trigger time of a segment, relative to the first one. The trigger
+ * time array holds a pair of doubles per segment: the trigger time
+ * and the offset of the first sample from the trigger.
+ */
+static gboolean lecroy_waveform_segment_time(GByteArray *data,
+		const struct lecroy_wavedesc *desc, unsigned int segment,
+		double *trig_time)
+{
+	size_t offset;
+
+	if ((segment + 1) * 2 * sizeof(double) >
+	    desc->version_2_x.trigtime_array_length)
+		return FALSE;
+
+	offset = lecroy_trigtime_offset(desc) + segment * 2 * sizeof(double);
+	if (offset + sizeof(double) > data->len)
+		return FALSE;
+	memcpy(trig_time, data->data + offset, sizeof(double));
+
+	return TRUE;
+}
+
 static int lecroy_waveform_2_x_to_analog(GByteArray *data,
-		struct lecroy_wavedesc *desc, struct sr_datafeed_analog *analog)
+		struct lecroy_wavedesc *desc, unsigned int segment,
+		struct sr_datafeed_analog *analog)
 {
 	struct sr_analog_encoding *encoding = analog->encoding;
 	struct sr_analog_meaning *meaning = analog->meaning;
@@ -554,12 +628,12 @@ static int lecroy_waveform_2_x_to_analog(GByteArray *data,
 	int16_t *waveform_data;
 	unsigned int i, num_samples;
 
-	data_float = g_malloc(desc->version_2_x.wave_array_count * sizeof(float));
-	num_samples = desc->version_2_x.wave_array_count;
+	num_samples = desc->version_2_x.wave_array_count /
+		lecroy_waveform_segments(desc);
+	data_float = g_malloc(num_samples * sizeof(float));
 
-	waveform_data = (int16_t*)(data->data +
-		+ desc->version_2_x.wave_descriptor_length
-		+ desc->version_2_x.user_text_len);
+	waveform_data = (int16_t*)(data->data
+		+ lecroy_wave_array_offset(desc)) + segment * num_samples;
 
 	for (i = 0; i < num_samples; i++)
 		data_float[i] = (float)waveform_data[i]
@@ -596,23 +670,78 @@ static int lecroy_waveform_2_x_to_analog(GByteArray *data,
 	return SR_OK;
 }
 
-static int lecroy_waveform_to_analog(GByteArray *data,
+static int lecroy_waveform_to_analog(GByteArray *data, unsigned int segment,
 		struct sr_datafeed_analog *analog)
 {
 	struct lecroy_wavedesc *desc;
 
-	if (data->len < sizeof(struct lecroy_wavedesc))
+	if (!(desc = lecroy_waveform_desc(data)))
 		return SR_ERR;
 
-	desc = (struct lecroy_wavedesc*)data->data;
+	return lecroy_waveform_2_x_to_analog(data, desc, segment, analog);
+}
 
-	if (!strncmp(desc->template_name, "LECROY_2_2", 16) ||
-	    !strncmp(desc->template_name, "LECROY_2_3", 16)) {
-		return lecroy_waveform_2_x_to_analog(data, desc, analog);
+/*
+ * Send the segments of a sequence acquisition, which was downloaded
+ * for every enabled channel. Each segment becomes a frame.
+ */
+static int lecroy_send_segments(const struct sr_dev_inst *sdi)
+{
+	struct dev_context *devc;
+	struct sr_channel *ch;
+	struct lecroy_wavedesc *desc;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+	GByteArray *data;
+	GSList *l;
+	unsigned int num_segments, segment;
+	gboolean has_time;
+	double trig_time;
+
+	devc = sdi->priv;
+
+	num_segments = G_MAXUINT;
+	for (l = devc->enabled_channels; l; l = l->next) {
+		ch = l->data;
+		if (!(desc = lecroy_waveform_desc(devc->segment_blocks[ch->index])))
+			return SR_ERR;
+		num_segments = MIN(num_segments, lecroy_waveform_segments(desc));
 	}
 
-	sr_err("Waveformat template '%.16s' not supported.", desc->template_name);
-	return SR_ERR;
+	analog.encoding = &encoding;
+	analog.meaning = &meaning;
+	analog.spec = &spec;
+
+	for (segment = 0; segment < num_segments; segment++) {
+		/* The first enabled channel's trigger times are used. */
+		ch = devc->enabled_channels->data;
+		data = devc->segment_blocks[ch->index];
+		has_time = lecroy_waveform_segment_time(data,
+			(struct lecroy_wavedesc *)data->data, segment, &trig_time);
+		std_session_send_df_frame_segment(sdi, segment, has_time,
+			trig_time);
+
+		for (l = devc->enabled_channels; l; l = l->next) {
+			ch = l->data;
+			data = devc->segment_blocks[ch->index];
+			if (lecroy_waveform_to_analog(data, segment, &analog) != SR_OK)
+				return SR_ERR;
+			meaning.channels = g_slist_append(NULL, ch);
+			packet.payload = &analog;
+			packet.type = SR_DF_ANALOG;
+			sr_session_send(sdi, &packet);
+			g_slist_free(meaning.channels);
+			g_free(analog.data);
+		}
+
+		std_session_send_df_frame_end(sdi);
+	}
+	devc->num_frames += num_segments;
+
+	return SR_OK;
 }
 
 SR_PRIV int lecroy_xstream_receive_data(int fd, int revents, void *cb_data)
@@ -644,23 +773,31 @@ SR_PRIV int lecroy_xstream_receive_data(int fd, int revents, void *cb_data)
 	if (ch->type != SR_CHANNEL_ANALOG)
 		return SR_ERR;
 
-	data = NULL;
-	if (sr_scpi_get_block(sdi->conn, NULL, &data) != SR_OK) {
-		if (data)
-			g_byte_array_free(data, TRUE);
-		return TRUE;
+	/*
+	 * Waveforms keep their size, reuse the block buffer. Sequences
+	 * are kept per channel until all of them are downloaded.
+	 */
+	if (devc->num_segments > 1) {
+		if (!devc->segment_blocks[ch->index])
+			devc->segment_blocks[ch->index] = g_byte_array_new();
+		data = devc->segment_blocks[ch->index];
+	} else {
+		if (!devc->block)
+			devc->block = g_byte_array_new();
+		data = devc->block;
 	}
+	if (sr_scpi_get_block_into(sdi->conn, NULL, data) != SR_OK)
+		return TRUE;
 
 	analog.encoding = &encoding;
 	analog.meaning = &meaning;
 	analog.spec = &spec;
 
-	if (lecroy_waveform_to_analog(data, &analog) != SR_OK)
+	if (lecroy_waveform_to_analog(data, 0, &analog) != SR_OK)
 		return SR_ERR;
 
 	if (analog.num_samples == 0) {
 		g_free(analog.data);
-		g_byte_array_free(data, TRUE);
 
 		/* No data available, we have to acquire data first. */
 		g_snprintf(command, sizeof(command), "ARM;WAIT;*OPC;C%d:WAVEFORM?", ch->index + 1);
@@ -673,28 +810,29 @@ SR_PRIV int lecroy_xstream_receive_data(int fd, int revents, void *cb_data)
 		if (state->sample_rate == 0)
 			if (lecroy_xstream_update_sample_rate(sdi, analog.num_samples) != SR_OK) {
 				g_free(analog.data);
-				g_byte_array_free(data, TRUE);
 				return SR_ERR;
 			}
 	}
 
-	/*
-	 * Send "frame begin" packet upon reception of data for the
-	 * first enabled channel.
-	 */
-	if (devc->current_channel == devc->enabled_channels)
-		std_session_send_df_frame_begin(sdi);
-
-	meaning.channels = g_slist_append(NULL, ch);
-	packet.payload = &analog;
-	packet.type = SR_DF_ANALOG;
-	sr_session_send(sdi, &packet);
-
-	g_byte_array_free(data, TRUE);
-	data = NULL;
-
-	g_slist_free(meaning.channels);
-	g_free(analog.data);
+	if (devc->num_segments > 1) {
+		/* The segments get sent once all channels are in. */
+		g_free(analog.data);
+	} else {
+		/*
+		 * Send "frame begin" packet upon reception of data for the
+		 * first enabled channel.
+		 */
+		if (devc->current_channel == devc->enabled_channels)
+			std_session_send_df_frame_begin(sdi);
+
+		meaning.channels = g_slist_append(NULL, ch);
+		packet.payload = &analog;
+		packet.type = SR_DF_ANALOG;
+		sr_session_send(sdi, &packet);
+
+		g_slist_free(meaning.channels);
+		g_free(analog.data);
+	}
 
 	/*
 	 * Advance to the next enabled channel. When data for all enabled
@@ -707,15 +845,20 @@ SR_PRIV int lecroy_xstream_receive_data(int fd, int revents, void *cb_data)
 		return TRUE;
 	}
 
-	std_session_send_df_frame_end(sdi);
+	if (devc->num_segments > 1) {
+		if (lecroy_send_segments(sdi) != SR_OK)
+			return SR_ERR;
+	} else {
+		std_session_send_df_frame_end(sdi);
+		devc->num_frames++;
+	}
 
 	/*
 	 * End of frame was reached. Stop acquisition after the specified
 	 * number of frames, or continue reception by starting over at
 	 * the first enabled channel.
 	 */
-	devc->num_frames++;
-	if (devc->frame_limit && (devc->num_frames == devc->frame_limit)) {
+	if (devc->frame_limit && (devc->num_frames >= devc->frame_limit)) {
 		sr_dev_acquisition_stop(sdi);
 	} else {
 		devc->current_channel = devc->enabled_channels;
@@ -88,6 +88,14 @@ struct dev_context {
 	uint64_t num_frames;
 
 	uint64_t frame_limit;
+
+	/* Segments per sequence acquisition, 0 or 1 if disabled */
+	uint64_t num_segments;
+
+	/* Reused receive buffer of waveform blocks */
+	GByteArray *block;
+	/* Per channel waveforms of a sequence acquisition */
+	GByteArray *segment_blocks[MAX_ANALOG_CHANNEL_COUNT];
 };
 
 SR_PRIV int lecroy_xstream_init_device(struct sr_dev_inst *sdi);
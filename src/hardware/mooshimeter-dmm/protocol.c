@@ -640,8 +640,7 @@ static void chX_value_update(struct config_tree_node *node,
 	if (devc->channel_autorange[channel])
 		(*devc->channel_autorange[channel])(sdi, value);
 
-	sr_sw_limits_update_samples_read(&devc->limits, 1);
-	if (sr_sw_limits_check(&devc->limits))
+	if (sr_sw_limits_update_and_check(&devc->limits, 1))
 		sr_dev_acquisition_stop(sdi);
 }
 
@@ -746,8 +745,7 @@ static void chX_buffer_update(struct config_tree_node *node,
 	if (devc->channel_autorange[channel])
 		(*devc->channel_autorange[channel])(sdi, maximum_value);
 
-	sr_sw_limits_update_samples_read(&devc->limits, number_of_samples);
-	if (sr_sw_limits_check(&devc->limits))
+	if (sr_sw_limits_update_and_check(&devc->limits, number_of_samples))
 		sr_dev_acquisition_stop(sdi);
 }
 
@@ -1265,6 +1263,14 @@ SR_PRIV int mooshimeter_dmm_open(const struct sr_dev_inst *sdi)
 	if (ret < 0)
 		return SR_ERR;
 
+	/*
+	 * Sample streams are bound by the notifications per connection
+	 * event, so ask for a short connection interval (7.5..15ms).
+	 */
+	ret = sr_bt_config_conn_interval(desc, 6, 12);
+	if (ret < 0)
+		return SR_ERR;
+
 	ret = sr_bt_connect_ble(desc);
 	if (ret < 0)
 		return SR_ERR;
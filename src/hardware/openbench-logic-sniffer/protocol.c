@@ -370,7 +370,8 @@ SR_PRIV int ols_receive_data(int fd, int revents, void *cb_data)
 	uint32_t sample;
 	int num_changroups, offset, j;
 	unsigned int i;
-	unsigned char byte;
+	unsigned char buf[4096];
+	int len, k;
 
 	(void)fd;
 
@@ -401,17 +402,25 @@ SR_PRIV int ols_receive_data(int fd, int revents, void *cb_data)
 	}
 
 	if (revents == G_IO_IN && devc->num_samples < devc->limit_samples) {
-		if (serial_read_nonblocking(serial, &byte, 1) != 1)
+		/*
+		 * Drain whatever the serial port has, instead of taking a
+		 * trip through the main loop for every single byte.
+		 */
+		len = serial_read_nonblocking(serial, buf, sizeof(buf));
+		if (len < 0)
 			return FALSE;
-		devc->cnt_bytes++;
+		devc->cnt_bytes += len;
+
+		for (k = 0; k < len; k++) {
+			/* Ignore it if we've read enough. */
+			if (devc->num_samples >= devc->limit_samples)
+				break;
 
-		/* Ignore it if we've read enough. */
-		if (devc->num_samples >= devc->limit_samples)
-			return TRUE;
+			devc->sample[devc->num_bytes++] = buf[k];
+			sr_spew("Received byte 0x%.2x.", buf[k]);
+			if (devc->num_bytes != num_changroups)
+				continue;
 
-		devc->sample[devc->num_bytes++] = byte;
-		sr_spew("Received byte 0x%.2x.", byte);
-		if (devc->num_bytes == num_changroups) {
 			devc->cnt_samples++;
 			devc->cnt_samples_rle++;
 			/*
@@ -420,7 +429,7 @@ SR_PRIV int ols_receive_data(int fd, int revents, void *cb_data)
 			 */
 			sample = devc->sample[0] | (devc->sample[1] << 8) \
 					| (devc->sample[2] << 16) | (devc->sample[3] << 24);
-			sr_dbg("Received sample 0x%.*x.", devc->num_bytes * 2, sample);
+			sr_spew("Received sample 0x%.*x.", devc->num_bytes * 2, sample);
 			if (devc->capture_flags & CAPTURE_FLAG_RLE) {
 				/*
 				 * In RLE mode the high bit of the sample is the
@@ -432,9 +441,9 @@ SR_PRIV int ols_receive_data(int fd, int revents, void *cb_data)
 					sample &= ~(0x80 << (devc->num_bytes - 1) * 8);
 					devc->rle_count = sample;
 					devc->cnt_samples_rle += devc->rle_count;
-					sr_dbg("RLE count: %u.", devc->rle_count);
+					sr_spew("RLE count: %u.", devc->rle_count);
 					devc->num_bytes = 0;
-					return TRUE;
+					continue;
 				}
 			}
 			devc->num_samples += devc->rle_count + 1;
@@ -477,13 +486,13 @@ SR_PRIV int ols_receive_data(int fd, int revents, void *cb_data)
 			/*
 			 * the OLS sends its sample buffer backwards.
 			 * store it in reverse order here, so we can dump
-			 * this on the session bus later.
+			 * this on the session bus later. Runs get
+			 * expanded with block fills.
 			 */
 			offset = (devc->limit_samples - devc->num_samples) * 4;
-			for (i = 0; i <= devc->rle_count; i++) {
-				memcpy(devc->raw_sample_buf + offset + (i * 4),
-				       devc->sample, 4);
-			}
+			memcpy(&sample, devc->sample, 4);
+			sr_simd_fill_u32((uint32_t *)(devc->raw_sample_buf + offset),
+				sample, devc->rle_count + 1);
 			memset(devc->sample, 0, 4);
 			devc->num_bytes = 0;
 			devc->rle_count = 0;
@@ -579,9 +588,14 @@ SR_PRIV int ols_prepare_acquisition(const struct sr_dev_inst *sdi) {
 
 	/*
 	 * Limit readcount to prevent reading past the end of the hardware
-	 * buffer. Rather read too many samples than too few.
+	 * buffer. Rather read too many samples than too few. In RLE mode
+	 * the memory holds compressed entries, so read all of it: runs
+	 * expand to many more samples than fit there uncompressed, and
+	 * the receive path stops once the sample limit is reached.
 	 */
-	uint32_t samplecount = MIN(devc->max_samples / num_changroups, devc->limit_samples);
+	uint32_t samplecount = devc->max_samples / num_changroups;
+	if (!(devc->capture_flags & CAPTURE_FLAG_RLE))
+		samplecount = MIN(samplecount, devc->limit_samples);
 	uint32_t readcount = (samplecount + 3) / 4;
 	uint32_t delaycount;
 
@@ -656,7 +670,14 @@ SR_PRIV int ols_prepare_acquisition(const struct sr_dev_inst *sdi) {
 	devc->capture_flags &= ~0x3c;
 	devc->capture_flags |= ~(changroup_mask << 2) & 0x3c;
 
-	/* RLE mode is always zero, for now. */
+	/*
+	 * RLE mode 0: repeated values take a value and a count entry.
+	 * The count flag takes the top bit of the last enabled group,
+	 * so with all four groups enabled channel 31 is lost.
+	 */
+	devc->capture_flags &= ~(CAPTURE_FLAG_RLEMODE0 | CAPTURE_FLAG_RLEMODE1);
+	if ((devc->capture_flags & CAPTURE_FLAG_RLE) && num_changroups == 4)
+		sr_info("RLE uses the top bit of channel group 4 as count flag.");
 
 	if (ols_send_longdata(serial, CMD_SET_FLAGS, devc->capture_flags) != SR_OK)
 		return SR_ERR;
@@ -492,11 +492,14 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 
 	/*
 	 * Limit readcount to prevent reading past the end of the hardware
-	 * buffer.
+	 * buffer. In RLE mode the memory holds compressed entries, so
+	 * read all of it to get the full effective depth.
 	 */
 	sr_dbg("max_samples = %d", devc->max_samples);
 	sr_dbg("limit_samples = %" PRIu64, devc->limit_samples);
-	samplecount = MIN(devc->max_samples, devc->limit_samples);
+	samplecount = devc->max_samples;
+	if (!(devc->flag_reg & FLAG_RLE))
+		samplecount = MIN(samplecount, devc->limit_samples);
 	sr_dbg("Samplecount = %d", samplecount);
 
 	/* In demux mode the OLS is processing two samples per clock */
@@ -380,6 +380,7 @@ SR_PRIV int p_ols_receive_data(int fd, int revents, void *cb_data)
 	int bytes_read, index;
 	unsigned int i;
 	unsigned char byte;
+	size_t run, total, len;
 
 	(void)fd;
 	(void)revents;
@@ -454,7 +455,7 @@ SR_PRIV int p_ols_receive_data(int fd, int revents, void *cb_data)
 						sample &= ~(0x80 << (devc->num_bytes - 1) * 8);
 						devc->rle_count = sample;
 						devc->cnt_samples_rle += devc->rle_count * 2;
-						sr_dbg("RLE count: %u.", devc->rle_count * 2);
+						sr_spew("RLE count: %u.", devc->rle_count * 2);
 						devc->num_bytes = 0;
 						continue;
 					}
@@ -518,11 +519,18 @@ SR_PRIV int p_ols_receive_data(int fd, int revents, void *cb_data)
 					 * this on the session bus later.
 					 */
 					offset = (devc->limit_samples - devc->num_samples) * 4;
-					for (i = 0; i <= devc->rle_count; i++) {
-						memcpy(devc->raw_sample_buf + offset + (i * 8),
-									 devc->tmp_sample2, 4);
-						memcpy(devc->raw_sample_buf + offset + (4 + (i * 8)),
-									 devc->tmp_sample, 4);
+					memcpy(devc->raw_sample_buf + offset,
+					       devc->tmp_sample2, 4);
+					memcpy(devc->raw_sample_buf + offset + 4,
+					       devc->tmp_sample, 4);
+					/* Expand the run by doubling the filled block. */
+					run = 8;
+					total = (devc->rle_count + 1) * 8;
+					while (run < total) {
+						len = MIN(run, total - run);
+						memcpy(devc->raw_sample_buf + offset + run,
+						       devc->raw_sample_buf + offset, len);
+						run += len;
 					}
 					memset(devc->sample, 0, 4);
 					devc->num_bytes = 0;
@@ -551,7 +559,7 @@ SR_PRIV int p_ols_receive_data(int fd, int revents, void *cb_data)
 							sample &= ~(0x80 << (devc->num_bytes - 1) * 8);
 							devc->rle_count = sample;
 							devc->cnt_samples_rle += devc->rle_count;
-							sr_dbg("RLE count: %u.", devc->rle_count);
+							sr_spew("RLE count: %u.", devc->rle_count);
 							devc->num_bytes = 0;
 							continue;
 						}
@@ -596,10 +604,9 @@ SR_PRIV int p_ols_receive_data(int fd, int revents, void *cb_data)
 					 * this on the session bus later.
 					 */
 					offset = (devc->limit_samples - devc->num_samples) * 4;
-					for (i = 0; i <= devc->rle_count; i++) {
-						memcpy(devc->raw_sample_buf + offset + (i * 4),
-									 devc->sample, 4);
-					}
+					memcpy(&sample, devc->sample, 4);
+					sr_simd_fill_u32((uint32_t *)(devc->raw_sample_buf + offset),
+						sample, devc->rle_count + 1);
 					memset(devc->sample, 0, 4);
 					devc->num_bytes = 0;
 					devc->rle_count = 0;
@@ -33,7 +33,7 @@
 #define USB_DEVICE_ID		0x6010
 #define USB_IPRODUCT		"Pipistrello LX45"
 
-#define FTDI_BUF_SIZE          (16 * 1024)
+#define FTDI_BUF_SIZE          (64 * 1024)
 
 #define NUM_CHANNELS           32
 #define NUM_TRIGGER_STAGES     4
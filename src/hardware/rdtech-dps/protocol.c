@@ -118,6 +118,38 @@ static int rdtech_dps_read_holding_registers(struct sr_modbus_dev_inst *modbus,
 	return ret;
 }
 
+/*
+ * Most registers between the blocks which get polled, which get read and
+ * discarded to get both blocks in one request. A request's turnaround
+ * takes longer than the transfer of these registers.
+ */
+#define READ_PLAN_GAP	80
+
+/* Retries failed reads of a plan, like rdtech_dps_read_holding_registers(). */
+static int rdtech_dps_read_plan(const struct sr_dev_inst *sdi,
+	struct sr_modbus_read_plan *plan)
+{
+	struct dev_context *devc;
+	size_t retries;
+	int ret;
+
+	devc = sdi->priv;
+
+	retries = 3;
+	g_mutex_lock(&devc->rw_mutex);
+	while (retries--) {
+		ret = sr_modbus_read_plan_run(sdi->conn, plan);
+		if (ret == SR_OK)
+			break;
+	}
+	g_mutex_unlock(&devc->rw_mutex);
+	/* Don't try to merge across gaps again which the device rejects. */
+	if (plan->split)
+		devc->read_plan_split = TRUE;
+
+	return ret;
+}
+
 /* Set one 16bit register. LE format for DPS devices. */
 static int rdtech_dps_set_reg(const struct sr_dev_inst *sdi,
 	uint16_t address, uint16_t value)
@@ -257,9 +289,9 @@ SR_PRIV int rdtech_dps_get_state(const struct sr_dev_inst *sdi,
 	struct rdtech_dps_state *state, enum rdtech_dps_state_context reason)
 {
 	struct dev_context *devc;
-	struct sr_modbus_dev_inst *modbus;
 	gboolean get_config, get_init_state, get_curr_meas;
-	uint16_t registers[12];
+	struct sr_modbus_read_plan plan;
+	uint16_t registers[12], thresholds[2];
 	int ret;
 	const uint8_t *rdptr;
 	uint16_t uset_raw, iset_raw, uout_raw, iout_raw, power_raw;
@@ -273,7 +305,6 @@ SR_PRIV int rdtech_dps_get_state(const struct sr_dev_inst *sdi,
 	if (!sdi || !sdi->priv || !sdi->conn)
 		return SR_ERR_ARG;
 	devc = sdi->priv;
-	modbus = sdi->conn;
 	if (!state)
 		return SR_ERR_ARG;
 
@@ -308,6 +339,8 @@ SR_PRIV int rdtech_dps_get_state(const struct sr_dev_inst *sdi,
 	(void)get_init_state;
 	(void)get_curr_meas;
 
+	sr_modbus_read_plan_init(&plan,
+		devc->read_plan_split ? 0 : READ_PLAN_GAP);
 	switch (devc->model->model_type) {
 	case MODEL_DPS:
 		/*
@@ -318,10 +351,9 @@ SR_PRIV int rdtech_dps_get_state(const struct sr_dev_inst *sdi,
 		 * their bit fields. But then this is not too unusual for
 		 * a hardware specific device driver ...
 		 */
-		g_mutex_lock(&devc->rw_mutex);
-		ret = rdtech_dps_read_holding_registers(modbus,
-			REG_DPS_USET, 10, registers);
-		g_mutex_unlock(&devc->rw_mutex);
+		sr_modbus_read_plan_add(&plan, REG_DPS_USET, 10, registers);
+		sr_modbus_read_plan_add(&plan, PRE_DPS_OVPSET, 2, thresholds);
+		ret = rdtech_dps_read_plan(sdi, &plan);
 		if (ret != SR_OK)
 			return ret;
 
@@ -348,16 +380,8 @@ SR_PRIV int rdtech_dps_get_state(const struct sr_dev_inst *sdi,
 		out_state = read_u16le_inc(&rdptr); /* ENABLE */
 		is_out_enabled = out_state != 0;
 
-		/* Transfer another chunk of registers in a single call. */
-		g_mutex_lock(&devc->rw_mutex);
-		ret = rdtech_dps_read_holding_registers(modbus,
-			PRE_DPS_OVPSET, 2, registers);
-		g_mutex_unlock(&devc->rw_mutex);
-		if (ret != SR_OK)
-			return ret;
-
 		/* Interpret the second registers chunk's values. */
-		rdptr = (const void *)registers;
+		rdptr = (const void *)thresholds;
 		ovpset_raw = read_u16le_inc(&rdptr); /* PRE OVPSET */
 		ovp_threshold = ovpset_raw * devc->voltage_multiplier;
 		ocpset_raw = read_u16le_inc(&rdptr); /* PRE OCPSET */
@@ -366,11 +390,10 @@ SR_PRIV int rdtech_dps_get_state(const struct sr_dev_inst *sdi,
 		break;
 
 	case MODEL_RD:
-		/* Retrieve a set of adjacent registers. */
-		g_mutex_lock(&devc->rw_mutex);
-		ret = rdtech_dps_read_holding_registers(modbus,
-			REG_RD_VOLT_TGT, 11, registers);
-		g_mutex_unlock(&devc->rw_mutex);
+		/* Retrieve two sets of adjacent registers. */
+		sr_modbus_read_plan_add(&plan, REG_RD_VOLT_TGT, 11, registers);
+		sr_modbus_read_plan_add(&plan, REG_RD_OVP_THR, 2, thresholds);
+		ret = rdtech_dps_read_plan(sdi, &plan);
 		if (ret != SR_OK)
 			return ret;
 
@@ -397,16 +420,8 @@ SR_PRIV int rdtech_dps_get_state(const struct sr_dev_inst *sdi,
 		out_state = read_u16be_inc(&rdptr); /* ENABLE */
 		is_out_enabled = out_state != 0;
 
-		/* Retrieve a set of adjacent registers. */
-		g_mutex_lock(&devc->rw_mutex);
-		ret = rdtech_dps_read_holding_registers(modbus,
-			REG_RD_OVP_THR, 2, registers);
-		g_mutex_unlock(&devc->rw_mutex);
-		if (ret != SR_OK)
-			return ret;
-
 		/* Interpret the registers' raw content. */
-		rdptr = (const void *)registers;
+		rdptr = (const void *)thresholds;
 		ovpset_raw = read_u16be_inc(&rdptr); /* OVP THR */
 		ovp_threshold = ovpset_raw / devc->voltage_multiplier;
 		ocpset_raw = read_u16be_inc(&rdptr); /* OCP THR */
@@ -671,8 +686,7 @@ SR_PRIV int rdtech_dps_receive_data(int fd, int revents, void *cb_data)
 	}
 
 	/* Check optional acquisition limits. */
-	sr_sw_limits_update_samples_read(&devc->limits, 1);
-	if (sr_sw_limits_check(&devc->limits)) {
+	if (sr_sw_limits_update_and_check(&devc->limits, 1)) {
 		sr_dev_acquisition_stop(sdi);
 		return TRUE;
 	}
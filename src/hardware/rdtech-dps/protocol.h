@@ -55,6 +55,8 @@ struct dev_context {
 	double voltage_multiplier;
 	struct sr_sw_limits limits;
 	GMutex rw_mutex;
+	/* The device rejects merged reads of polled registers. */
+	gboolean read_plan_split;
 	gboolean curr_ovp_state;
 	gboolean curr_ocp_state;
 	gboolean curr_cc_state;
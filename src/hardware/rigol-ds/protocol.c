@@ -452,6 +452,22 @@ SR_PRIV int rigol_ds_capture_start(const struct sr_dev_inst *sdi)
 	return SR_OK;
 }
 
+/*
+ * Start a frame. Frames read back from the segment memory carry their
+ * index, so that segments can be told apart downstream.
+ */
+SR_PRIV int rigol_ds_frame_begin(const struct sr_dev_inst *sdi)
+{
+	struct dev_context *devc;
+
+	devc = sdi->priv;
+	if (devc->data_source == DATA_SOURCE_SEGMENTED)
+		return std_session_send_df_frame_segment(sdi, devc->num_frames,
+			FALSE, 0.0);
+
+	return std_session_send_df_frame_begin(sdi);
+}
+
 /* Start reading data from the current channel */
 SR_PRIV int rigol_ds_channel_start(const struct sr_dev_inst *sdi)
 {
@@ -742,18 +758,29 @@ SR_PRIV int rigol_ds_receive(int fd, int revents, void *cb_data)
 		vdiv = devc->vert_inc[ch->index];
 		origin = devc->vert_origin[ch->index];
 		offset = devc->vert_offset[ch->index];
-		if (devc->model->series->protocol >= PROTOCOL_V3)
-			for (i = 0; i < len; i++)
-				devc->data[i] = ((int)devc->buffer[i] - vref - origin) * vdiv;
-		else
-			for (i = 0; i < len; i++)
-				devc->data[i] = (128 - devc->buffer[i]) * vdiv - offset;
 		float vdivlog = log10f(vdiv);
 		int digits = -(int)vdivlog + (vdivlog < 0.0);
 		sr_analog_init(&analog, &encoding, &meaning, &spec, digits);
+		if (devc->analog_raw) {
+			/* Same conversions as below, applied by the receiver. */
+			if (devc->model->series->protocol >= PROTOCOL_V3)
+				sr_analog_set_raw_encoding(&encoding, 1, FALSE, FALSE,
+					vdiv, -(vref + origin) * vdiv);
+			else
+				sr_analog_set_raw_encoding(&encoding, 1, FALSE, FALSE,
+					-vdiv, 128 * vdiv - offset);
+			analog.data = devc->buffer;
+		} else {
+			if (devc->model->series->protocol >= PROTOCOL_V3)
+				for (i = 0; i < len; i++)
+					devc->data[i] = ((int)devc->buffer[i] - vref - origin) * vdiv;
+			else
+				for (i = 0; i < len; i++)
+					devc->data[i] = (128 - devc->buffer[i]) * vdiv - offset;
+			analog.data = devc->data;
+		}
 		analog.meaning->channels = g_slist_append(NULL, ch);
 		analog.num_samples = len;
-		analog.data = devc->data;
 		analog.meaning->mq = SR_MQ_VOLTAGE;
 		analog.meaning->unit = SR_UNIT_VOLT;
 		analog.meaning->mqflags = 0;
@@ -848,7 +875,7 @@ SR_PRIV int rigol_ds_receive(int fd, int revents, void *cb_data)
 			rigol_ds_capture_start(sdi);
 
 			/* Start of next frame. */
-			std_session_send_df_frame_begin(sdi);
+			rigol_ds_frame_begin(sdi);
 		}
 	}
 
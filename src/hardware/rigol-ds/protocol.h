@@ -121,6 +121,8 @@ struct dev_context {
 	GSList *enabled_channels;
 	uint64_t limit_frames;
 	enum data_source data_source;
+	/* Send the scope's bytes with scale and offset, not floats. */
+	gboolean analog_raw;
 	uint64_t analog_frame_size;
 	uint64_t digital_frame_size;
 
@@ -167,6 +169,7 @@ struct dev_context {
 
 SR_PRIV int rigol_ds_config_set(const struct sr_dev_inst *sdi, const char *format, ...);
 SR_PRIV int rigol_ds_capture_start(const struct sr_dev_inst *sdi);
+SR_PRIV int rigol_ds_frame_begin(const struct sr_dev_inst *sdi);
 SR_PRIV int rigol_ds_channel_start(const struct sr_dev_inst *sdi);
 SR_PRIV int rigol_ds_receive(int fd, int revents, void *cb_data);
 SR_PRIV int rigol_ds_get_dev_cfg(const struct sr_dev_inst *sdi);
@@ -849,40 +849,42 @@ static void saleae_logic_pro_convert_data(const struct sr_dev_inst *sdi,
 					 const uint32_t *src, size_t srccnt)
 {
 	struct dev_context *devc = sdi->priv;
-	uint8_t *dst = devc->conv_buffer;
-	uint32_t samples;
-	uint16_t channel_mask;
-	unsigned int sample_index, batch_index;
-	uint16_t *dst_batch;
-
-	/* Copy partial batch to the beginning. */
-	memcpy(dst, dst + devc->conv_size, CONV_BATCH_SIZE);
-	/* Reset converted size. */
+	uint16_t *dst = (uint16_t *)devc->conv_buffer;
+	size_t count, num_batches;
+
 	devc->conv_size = 0;
+	if (!devc->dig_channel_cnt)
+		return;
 
-	batch_index = devc->batch_index;
-	while (srccnt--) {
-		samples = *src++;
-		dst_batch = (uint16_t*)dst;
-
-		/* First index of the batch. */
-		if (batch_index == 0)
-			memset(dst, 0, CONV_BATCH_SIZE);
-
-		/* Convert one channel. */
-		channel_mask = devc->dig_channel_masks[batch_index];
-		for (sample_index = 0; sample_index <= 31; sample_index++)
-			if ((samples >> (31 - sample_index)) & 1)
-				dst_batch[sample_index] |= channel_mask;
-
-		/* Last index of the batch. */
-		if (++batch_index == devc->dig_channel_cnt) {
-			devc->conv_size += CONV_BATCH_SIZE;
-			batch_index = 0;
-			dst += CONV_BATCH_SIZE;
-		}
+	/* Complete the batch which the previous packet started. */
+	if (devc->batch_index) {
+		count = MIN(srccnt, devc->dig_channel_cnt - devc->batch_index);
+		memcpy(devc->batch + devc->batch_index, src, count * sizeof(*src));
+		devc->batch_index += count;
+		src += count;
+		srccnt -= count;
+		if (devc->batch_index < devc->dig_channel_cnt)
+			return;
+		sr_simd_deinterleave_words(SR_SIMD_WORD32LE_MSB,
+			(const uint8_t *)devc->batch,
+			devc->dig_channel_cnt * sizeof(*src), dst,
+			devc->dig_channel_cnt, devc->dig_channel_mask);
+		devc->batch_index = 0;
+		devc->conv_size += CONV_BATCH_SIZE;
+		dst += 32;
 	}
-	devc->batch_index = batch_index;
+
+	/* Convert the whole batches in place. */
+	num_batches = srccnt / devc->dig_channel_cnt;
+	count = num_batches * devc->dig_channel_cnt;
+	sr_simd_deinterleave_words(SR_SIMD_WORD32LE_MSB, (const uint8_t *)src,
+		count * sizeof(*src), dst, devc->dig_channel_cnt,
+		devc->dig_channel_mask);
+	devc->conv_size += num_batches * CONV_BATCH_SIZE;
+
+	/* Keep the words of the last, partial batch. */
+	devc->batch_index = srccnt - count;
+	memcpy(devc->batch, src + count, devc->batch_index * sizeof(*src));
 }
 
 SR_PRIV void LIBUSB_CALL saleae_logic_pro_receive_data(struct libusb_transfer *transfer)
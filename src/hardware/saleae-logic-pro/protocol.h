@@ -50,6 +50,8 @@ struct dev_context {
 
 	uint8_t *conv_buffer;
 	unsigned int conv_size;
+	/* Words of a batch which continues in the next packet. */
+	uint32_t batch[16];
 	unsigned int batch_index;
 };
 
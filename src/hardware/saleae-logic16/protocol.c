@@ -809,6 +809,7 @@ static size_t convert_sample_data(struct dev_context *devc,
 	uint16_t *channel_data;
 	int i, cur_channel;
 	size_t ret = 0;
+	size_t num_blocks, num_words;
 	uint16_t sample, channel_mask;
 
 	srccnt /= 2;
@@ -816,7 +817,32 @@ static size_t convert_sample_data(struct dev_context *devc,
 	channel_data = devc->channel_data;
 	cur_channel = devc->cur_channel;
 
-	while (srccnt--) {
+	while (srccnt) {
+		/* Transpose whole blocks of channel words at once. */
+		if (cur_channel == 0 && srccnt >= (size_t)devc->num_channels) {
+			num_blocks = MIN(srccnt / devc->num_channels, destcnt / (16 * 2));
+			if (!num_blocks) {
+				sr_err("Conversion buffer too small!");
+				break;
+			}
+			num_words = num_blocks * devc->num_channels;
+			sr_simd_deinterleave_words(SR_SIMD_WORD16LE_MSB, src,
+				num_words * 2, (uint16_t *)dest, devc->num_channels,
+				devc->cur_channels);
+#ifdef WORDS_BIGENDIAN
+			for (i = 0; i < (int)num_blocks * 16; i++)
+				((uint16_t *)dest)[i] = GUINT16_TO_LE(((uint16_t *)dest)[i]);
+#endif
+			src += num_words * 2;
+			srccnt -= num_words;
+			dest += num_blocks * 16 * 2;
+			destcnt -= num_blocks * 16 * 2;
+			ret += num_blocks * 16;
+			continue;
+		}
+
+		/* Blocks split across transfers take the bit by bit path. */
+		srccnt--;
 		sample = src[0] | (src[1] << 8);
 		src += 2;
 
@@ -43,6 +43,21 @@ static const struct pps_channel_instance pci[] = {
 	{ SR_MQ_FREQUENCY, SCPI_CMD_GET_MEAS_FREQUENCY, "F" },
 };
 
+/* Settings which only change upon commands, their queries can be cached. */
+static const int cached_cmds[] = {
+	SCPI_CMD_GET_VOLTAGE_TARGET,
+	SCPI_CMD_GET_FREQUENCY_TARGET,
+	SCPI_CMD_GET_CURRENT_LIMIT,
+	SCPI_CMD_GET_OVER_TEMPERATURE_PROTECTION,
+	SCPI_CMD_GET_OVER_VOLTAGE_PROTECTION_ENABLED,
+	SCPI_CMD_GET_OVER_VOLTAGE_PROTECTION_THRESHOLD,
+	SCPI_CMD_GET_OVER_CURRENT_PROTECTION_ENABLED,
+	SCPI_CMD_GET_OVER_CURRENT_PROTECTION_THRESHOLD,
+};
+
+/* Front panel changes show up in config_get() after this long. */
+#define CACHE_MAX_AGE_MS	1000
+
 static struct sr_dev_inst *probe_device(struct sr_scpi_dev_inst *scpi,
 		int (*get_hw_id)(struct sr_scpi_dev_inst *scpi,
 		struct sr_scpi_hw_info **scpi_response))
@@ -257,6 +272,36 @@ static GSList *scan_hpib_pps(struct sr_dev_driver *di, GSList *options)
 	return sr_scpi_scan(di->context, options, probe_hpib_pps_device);
 }
 
+/*
+ * Cache the responses to the setting queries of the device. A query which
+ * is a prefix of a measurement query would also match that, skip it.
+ */
+static void enable_cache(struct sr_dev_inst *sdi)
+{
+	struct dev_context *devc;
+	const char *queries[ARRAY_SIZE(cached_cmds) + 1];
+	const char *cmd, *meas;
+	unsigned int i, j, num_queries;
+
+	devc = sdi->priv;
+	num_queries = 0;
+	for (i = 0; i < ARRAY_SIZE(cached_cmds); i++) {
+		cmd = sr_scpi_cmd_get(devc->device->commands, cached_cmds[i]);
+		if (!cmd)
+			continue;
+		for (j = 0; j < ARRAY_SIZE(pci); j++) {
+			meas = sr_scpi_cmd_get(devc->device->commands, pci[j].command);
+			if (meas && g_str_has_prefix(meas, cmd))
+				break;
+		}
+		if (j == ARRAY_SIZE(pci))
+			queries[num_queries++] = cmd;
+	}
+	queries[num_queries] = NULL;
+
+	sr_scpi_cache_enable(sdi->conn, queries, CACHE_MAX_AGE_MS);
+}
+
 static int dev_open(struct sr_dev_inst *sdi)
 {
 	struct dev_context *devc;
@@ -285,6 +330,8 @@ static int dev_open(struct sr_dev_inst *sdi)
 		g_variant_unref(beeper);
 	}
 
+	enable_cache(sdi);
+
 	return SR_OK;
 }
 
@@ -666,26 +666,26 @@ static const struct scpi_command hp_6630b_cmd[] = {
 
 static int hp_6630b_init_acquisition(const struct sr_dev_inst *sdi)
 {
-	struct sr_scpi_dev_inst *scpi;
+	struct sr_scpi_batch *batch;
 	int ret;
 
-	scpi = sdi->conn;
+	/* Send the register setup as one message, and wait for completion. */
+	batch = sr_scpi_batch_new(sdi->conn, 0);
 
 	/*
 	 * Monitor CV (256), CC+ (1024) and CC- (2048) bits of the
 	 * Operational Status Register.
 	 * Use both positive and negative transitions of the status bits.
 	 */
-	ret = sr_scpi_send(scpi, "STAT:OPER:PTR 3328;NTR 3328;ENAB 3328");
-	if (ret != SR_OK)
-		return ret;
+	sr_scpi_batch_add(batch, "STAT:OPER:PTR 3328;NTR 3328;ENAB 3328");
 
 	/*
 	 * Monitor OVP (1), OCP (2), OTP (16) and Unreg (1024) bits of the
 	 * Questionable Status Register.
 	 * Use both positive and negative transitions of the status bits.
 	 */
-	ret = sr_scpi_send(scpi, "STAT:QUES:PTR 1043;NTR 1043;ENAB 1043");
+	sr_scpi_batch_add(batch, "STAT:QUES:PTR 1043;NTR 1043;ENAB 1043");
+	ret = sr_scpi_batch_finish(batch);
 	if (ret != SR_OK)
 		return ret;
 
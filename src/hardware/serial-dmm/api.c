@@ -42,6 +42,7 @@ static const uint32_t devopts[] = {
 	SR_CONF_CONTINUOUS,
 	SR_CONF_LIMIT_SAMPLES | SR_CONF_GET | SR_CONF_SET,
 	SR_CONF_LIMIT_MSEC | SR_CONF_GET | SR_CONF_SET,
+	SR_CONF_TRANSFER_THREAD | SR_CONF_GET | SR_CONF_SET,
 };
 
 static GSList *scan(struct sr_dev_driver *di, GSList *options)
@@ -201,6 +202,9 @@ static int config_get(uint32_t key, GVariant **data,
 	case SR_CONF_LIMIT_FRAMES:
 	case SR_CONF_LIMIT_MSEC:
 		return sr_sw_limits_config_get(&devc->limits, key, data);
+	case SR_CONF_TRANSFER_THREAD:
+		*data = g_variant_new_boolean(devc->transfer_thread);
+		return SR_OK;
 	default:
 		dmm = (struct dmm_info *)sdi->driver;
 		if (!dmm || !dmm->config_get)
@@ -226,6 +230,9 @@ static int config_set(uint32_t key, GVariant *data,
 	case SR_CONF_LIMIT_FRAMES:
 	case SR_CONF_LIMIT_MSEC:
 		return sr_sw_limits_config_set(&devc->limits, key, data);
+	case SR_CONF_TRANSFER_THREAD:
+		devc->transfer_thread = g_variant_get_boolean(data);
+		return SR_OK;
 	default:
 		dmm = (struct dmm_info *)sdi->driver;
 		if (!dmm || !dmm->config_set)
@@ -283,17 +290,49 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 	}
 
 	serial = sdi->conn;
+	if (devc->transfer_thread && cb_func == receive_data) {
+		ret = serial_worker_source_add((struct sr_dev_inst *)sdi,
+			serial, 50, receive_data_worker);
+		if (ret == SR_OK)
+			return SR_OK;
+		if (ret != SR_ERR_NA)
+			return ret;
+		sr_dbg("Cannot use the serial worker, using the main loop.");
+	}
 	serial_source_add(sdi->session, serial, G_IO_IN, 50,
 		cb_func, cb_data);
 
 	return SR_OK;
 }
 
+/*
+ * Synchronization hints of the fixed size packets of all chipsets which
+ * DMM() entries use. An all zero hint tests every offset.
+ */
+static const struct dmm_sync asycii_sync = { .has_last = TRUE, .last_value = '\r' };
+static const struct dmm_sync bm25x_sync = { .first_mask = 0xff, .first_value = 0x02 };
+static const struct dmm_sync brymen_bm52x_sync = { 0 };
+static const struct dmm_sync brymen_bm86x_sync = { 0 };
+static const struct dmm_sync dtm0660_sync = { .first_mask = 0xf0, .first_value = 0x10 };
+static const struct dmm_sync eev121gw_sync = { 0 };
+static const struct dmm_sync es519xx_sync = { .has_last = TRUE, .last_value = '\n' };
+static const struct dmm_sync fs9721_sync = { .first_mask = 0xf0, .first_value = 0x10 };
+static const struct dmm_sync fs9922_sync = { .has_last = TRUE, .last_value = '\n' };
+static const struct dmm_sync m2110_sync = { .has_last = TRUE, .last_value = '\n' };
+static const struct dmm_sync meterman_38xr_sync = { 0 };
+static const struct dmm_sync metex14_sync = { .has_last = TRUE, .last_value = '\r' };
+static const struct dmm_sync ms2115b_sync = { .first_mask = 0xff, .first_value = 0x55 };
+static const struct dmm_sync ms8250d_sync = { 0 };
+static const struct dmm_sync rs9lcd_sync = { 0 };
+static const struct dmm_sync ut71x_sync = { .has_last = TRUE, .last_value = '\n' };
+static const struct dmm_sync vc870_sync = { .has_last = TRUE, .last_value = '\n' };
+static const struct dmm_sync vc96_sync = { .has_last = TRUE, .last_value = '\n' };
+
 #define DMM_ENTRY(ID, CHIPSET, VENDOR, MODEL, \
 		CONN, SERIALCOMM, PACKETSIZE, TIMEOUT, DELAY, \
 		OPEN, REQUEST, VALID, PARSE, DETAILS, \
 		INIT_STATE, FREE_STATE, VALID_LEN, PARSE_LEN, \
-		CFG_GET, CFG_SET, CFG_LIST, ACQ_START) \
+		CFG_GET, CFG_SET, CFG_LIST, ACQ_START, SYNC) \
 	&((struct dmm_info) { \
 		{ \
 			.name = ID, \
@@ -318,7 +357,7 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 		sizeof(struct CHIPSET##_info), \
 		NULL, INIT_STATE, FREE_STATE, \
 		OPEN, VALID_LEN, PARSE_LEN, \
-		CFG_GET, CFG_SET, CFG_LIST, ACQ_START, \
+		CFG_GET, CFG_SET, CFG_LIST, ACQ_START, SYNC, \
 	}).di
 
 #define DMM_CONN(ID, CHIPSET, VENDOR, MODEL, \
@@ -327,7 +366,8 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 	DMM_ENTRY(ID, CHIPSET, VENDOR, MODEL, \
 		CONN, SERIALCOMM, PACKETSIZE, TIMEOUT, DELAY, \
 		NULL, REQUEST, VALID, PARSE, DETAILS, \
-		NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL)
+		NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, \
+		&CHIPSET##_sync)
 
 #define DMM(ID, CHIPSET, VENDOR, MODEL, SERIALCOMM, PACKETSIZE, TIMEOUT, \
 		DELAY, REQUEST, VALID, PARSE, DETAILS) \
@@ -341,7 +381,7 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 	DMM_ENTRY(ID, CHIPSET, VENDOR, MODEL, \
 		CONN, SERIALCOMM, PACKETSIZE, TIMEOUT, DELAY, \
 		OPEN, REQUEST, NULL, NULL, DETAILS, \
-		INIT, FREE, VALID, PARSE, NULL, NULL, NULL, NULL)
+		INIT, FREE, VALID, PARSE, NULL, NULL, NULL, NULL, NULL)
 
 SR_REGISTER_DEV_DRIVER_LIST(serial_dmm_drivers,
 	/*
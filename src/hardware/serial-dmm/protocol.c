@@ -138,6 +138,37 @@ SR_PRIV int req_packet(struct sr_dev_inst *sdi)
 	return SR_OK;
 }
 
+/*
+ * Skip to the next offset which can start a fixed size packet, according
+ * to the chipset's hints. Returns the offset of the last packet_size - 1
+ * bytes when no candidate was found, which might start a packet that is
+ * still being received.
+ */
+static size_t sync_candidate(const struct dmm_info *dmm,
+	const uint8_t *buf, size_t pos, size_t len)
+{
+	const struct dmm_sync *sync;
+	const uint8_t *last;
+	size_t tail;
+
+	sync = dmm->sync;
+	if (!sync || dmm->packet_valid_len || len - pos < dmm->packet_size)
+		return pos;
+
+	tail = len - dmm->packet_size + 1;
+	if (sync->has_last) {
+		last = memchr(&buf[pos + dmm->packet_size - 1],
+			sync->last_value, len - pos - dmm->packet_size + 1);
+		return last ? (size_t)(last - buf) - dmm->packet_size + 1 : tail;
+	}
+	if (sync->first_mask) {
+		while (pos < tail && (buf[pos] & sync->first_mask) != sync->first_value)
+			pos++;
+	}
+
+	return pos;
+}
+
 static void handle_new_data(struct sr_dev_inst *sdi, void *info)
 {
 	struct dmm_info *dmm;
@@ -170,6 +201,8 @@ static void handle_new_data(struct sr_dev_inst *sdi, void *info)
 	 */
 	check_pos = 0;
 	while (check_pos < devc->buflen) {
+		check_pos = sync_candidate(dmm, devc->buf, check_pos, devc->buflen);
+
 		/* Got the (minimum) amount of receive data for a packet? */
 		check_len = devc->buflen - check_pos;
 		if (check_len < dmm->packet_size)
@@ -234,21 +267,11 @@ static void handle_new_data(struct sr_dev_inst *sdi, void *info)
 	}
 }
 
-int receive_data(int fd, int revents, void *cb_data)
+static int handle_events(struct sr_dev_inst *sdi, int revents)
 {
-	struct sr_dev_inst *sdi;
-	struct dev_context *devc;
 	struct dmm_info *dmm;
 	void *info;
 
-	(void)fd;
-
-	if (!(sdi = cb_data))
-		return TRUE;
-
-	if (!(devc = sdi->priv))
-		return TRUE;
-
 	dmm = (struct dmm_info *)sdi->driver;
 
 	if (revents == G_IO_IN) {
@@ -259,11 +282,50 @@ int receive_data(int fd, int revents, void *cb_data)
 	} else {
 		/* Timeout; send another packet request if DMM needs it. */
 		if (dmm->packet_request && (req_packet(sdi) < 0))
-			return FALSE;
+			return SR_ERR;
 	}
 
+	return SR_OK;
+}
+
+int receive_data(int fd, int revents, void *cb_data)
+{
+	struct sr_dev_inst *sdi;
+	struct dev_context *devc;
+
+	(void)fd;
+
+	if (!(sdi = cb_data))
+		return TRUE;
+
+	if (!(devc = sdi->priv))
+		return TRUE;
+
+	if (handle_events(sdi, revents) != SR_OK)
+		return FALSE;
+
 	if (sr_sw_limits_check(&devc->limits))
 		sr_dev_acquisition_stop(sdi);
 
 	return TRUE;
 }
+
+/* Runs on the serial worker thread, which stops the acquisition on FALSE. */
+SR_PRIV int receive_data_worker(int fd, int revents, void *cb_data)
+{
+	struct sr_dev_inst *sdi;
+	struct dev_context *devc;
+
+	(void)fd;
+
+	if (!(sdi = cb_data))
+		return TRUE;
+
+	if (!(devc = sdi->priv))
+		return TRUE;
+
+	if (handle_events(sdi, revents) != SR_OK)
+		return FALSE;
+
+	return !sr_sw_limits_check(&devc->limits);
+}
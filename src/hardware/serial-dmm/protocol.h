@@ -22,6 +22,20 @@
 
 #define LOG_PREFIX "serial-dmm"
 
+/**
+ * Hints which locate candidate packet starts of fixed size packets, so
+ * that resynchronization doesn't run the packet check at every offset.
+ * Candidates still get checked by packet_valid().
+ */
+struct dmm_sync {
+	/** Bits and value of the first byte of a packet, mask 0 for any. */
+	uint8_t first_mask;
+	uint8_t first_value;
+	/** Whether packets end in a known byte, and that byte. */
+	gboolean has_last;
+	uint8_t last_value;
+};
+
 struct dmm_info {
 	/** libsigrok driver info struct. */
 	struct sr_dev_driver di;
@@ -78,6 +92,8 @@ struct dmm_info {
 	/** Hook at acquisition start. Can re-route the receive routine. */
 	int (*acquire_start)(void *state, const struct sr_dev_inst *sdi,
 		sr_receive_data_callback *cb, void **cb_data);
+	/** (Optional) Synchronization hints of fixed size packets. */
+	const struct dmm_sync *sync;
 };
 
 #define DMM_BUFSIZE 256
@@ -93,9 +109,13 @@ struct dev_context {
 	 * Used only if device needs polling.
 	 */
 	uint64_t req_next_at;
+
+	/** Whether to service the port on the serial worker thread. */
+	gboolean transfer_thread;
 };
 
 SR_PRIV int req_packet(struct sr_dev_inst *sdi);
 SR_PRIV int receive_data(int fd, int revents, void *cb_data);
+SR_PRIV int receive_data_worker(int fd, int revents, void *cb_data);
 
 #endif
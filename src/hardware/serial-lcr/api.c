@@ -42,6 +42,7 @@ static const uint32_t devopts[] = {
 	SR_CONF_LIMIT_MSEC | SR_CONF_SET,
 	SR_CONF_OUTPUT_FREQUENCY | SR_CONF_GET | SR_CONF_LIST,
 	SR_CONF_EQUIV_CIRCUIT_MODEL | SR_CONF_GET | SR_CONF_LIST,
+	SR_CONF_TRANSFER_THREAD | SR_CONF_GET | SR_CONF_SET,
 };
 
 static struct sr_dev_inst *scan_packet_check_devinst;
@@ -275,6 +276,9 @@ static int config_get(uint32_t key, GVariant **data,
 			return SR_ERR_NA;
 		*data = g_variant_new_string(devc->circuit_model);
 		return SR_OK;
+	case SR_CONF_TRANSFER_THREAD:
+		*data = g_variant_new_boolean(devc->transfer_thread);
+		return SR_OK;
 	default:
 		lcr = devc->lcr_info;
 		if (!lcr)
@@ -300,6 +304,9 @@ static int config_set(uint32_t key, GVariant *data,
 	case SR_CONF_LIMIT_FRAMES:
 	case SR_CONF_LIMIT_MSEC:
 		return sr_sw_limits_config_set(&devc->limits, key, data);
+	case SR_CONF_TRANSFER_THREAD:
+		devc->transfer_thread = g_variant_get_boolean(data);
+		return SR_OK;
 	default:
 		lcr = devc->lcr_info;
 		if (!lcr)
@@ -343,6 +350,7 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 {
 	struct dev_context *devc;
 	struct sr_serial_dev_inst *serial;
+	int ret;
 
 	devc = sdi->priv;
 
@@ -359,6 +367,15 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 	std_session_send_df_header(sdi);
 
 	serial = sdi->conn;
+	if (devc->transfer_thread) {
+		ret = serial_worker_source_add((struct sr_dev_inst *)sdi,
+			serial, 50, lcr_receive_data_worker);
+		if (ret == SR_OK)
+			return SR_OK;
+		if (ret != SR_ERR_NA)
+			return ret;
+		sr_dbg("Cannot use the serial worker, using the main loop.");
+	}
 	serial_source_add(sdi->session, serial, G_IO_IN, 50,
 		lcr_receive_data, (void *)sdi);
 
@@ -201,3 +201,27 @@ SR_PRIV int lcr_receive_data(int fd, int revents, void *cb_data)
 
 	return TRUE;
 }
+
+/* Runs on the serial worker thread, which stops the acquisition on FALSE. */
+SR_PRIV int lcr_receive_data_worker(int fd, int revents, void *cb_data)
+{
+	struct sr_dev_inst *sdi;
+	struct dev_context *devc;
+	int ret;
+
+	(void)fd;
+
+	if (!(sdi = cb_data))
+		return TRUE;
+	if (!(devc = sdi->priv))
+		return TRUE;
+
+	if (revents == G_IO_IN)
+		ret = handle_new_data(sdi);
+	else
+		ret = handle_timeout(sdi);
+	if (ret != SR_OK)
+		return FALSE;
+
+	return !sr_sw_limits_check(&devc->limits);
+}
@@ -63,8 +63,10 @@ struct dev_context {
 	uint64_t output_freq;
 	const char *circuit_model;
 	int64_t req_next_at;
+	gboolean transfer_thread;
 };
 
 SR_PRIV int lcr_receive_data(int fd, int revents, void *cb_data);
+SR_PRIV int lcr_receive_data_worker(int fd, int revents, void *cb_data);
 
 #endif
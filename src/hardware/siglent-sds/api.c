@@ -52,6 +52,7 @@ static const uint32_t devopts[] = {
 	SR_CONF_DATA_SOURCE | SR_CONF_GET | SR_CONF_SET | SR_CONF_LIST,
 	SR_CONF_AVERAGING | SR_CONF_GET | SR_CONF_SET,
 	SR_CONF_AVG_SAMPLES | SR_CONF_GET | SR_CONF_SET | SR_CONF_LIST,
+	SR_CONF_ANALOG_RAW | SR_CONF_GET | SR_CONF_SET,
 };
 
 static const uint32_t devopts_cg_analog[] = {
@@ -429,6 +430,9 @@ static int config_get(uint32_t key, GVariant **data,
 	case SR_CONF_LIMIT_FRAMES:
 		*data = g_variant_new_uint64(devc->limit_frames);
 		break;
+	case SR_CONF_ANALOG_RAW:
+		*data = g_variant_new_boolean(devc->analog_raw);
+		break;
 	case SR_CONF_DATA_SOURCE:
 		if (devc->data_source == DATA_SOURCE_SCREEN)
 			*data = g_variant_new_string("Screen");
@@ -557,6 +561,9 @@ static int config_set(uint32_t key, GVariant *data,
 	case SR_CONF_LIMIT_FRAMES:
 		devc->limit_frames = g_variant_get_uint64(data);
 		break;
+	case SR_CONF_ANALOG_RAW:
+		devc->analog_raw = g_variant_get_boolean(data);
+		break;
 	case SR_CONF_TRIGGER_SLOPE:
 		if ((idx = std_str_idx(data, ARRAY_AND_SIZE(trigger_slopes))) < 0)
 			return SR_ERR_ARG;
@@ -899,7 +906,7 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 		return SR_ERR;
 
 	/* Start of first frame. */
-	std_session_send_df_frame_begin(sdi);
+	siglent_sds_frame_begin(sdi);
 
 	return SR_OK;
 }
@@ -266,6 +266,22 @@ SR_PRIV int siglent_sds_capture_start(const struct sr_dev_inst *sdi)
 	return SR_OK;
 }
 
+/*
+ * Start a frame. Frames read back from the segment memory carry their
+ * index, so that segments can be told apart downstream.
+ */
+SR_PRIV int siglent_sds_frame_begin(const struct sr_dev_inst *sdi)
+{
+	struct dev_context *devc;
+
+	devc = sdi->priv;
+	if (devc->data_source == DATA_SOURCE_HISTORY)
+		return std_session_send_df_frame_segment(sdi, devc->num_frames,
+			FALSE, 0.0);
+
+	return std_session_send_df_frame_begin(sdi);
+}
+
 /* Start reading data from the current channel. */
 SR_PRIV int siglent_sds_channel_start(const struct sr_dev_inst *sdi)
 {
@@ -580,25 +596,27 @@ SR_PRIV int siglent_sds_receive(int fd, int revents, void *cb_data)
 				if (ch->type == SR_CHANNEL_ANALOG) {
 					float vdiv = devc->vdiv[ch->index];
 					float offset = devc->vert_offset[ch->index];
-					GArray *float_data;
-					static GArray *data;
-					float voltage, vdivlog;
+					float *float_data;
+					float vdivlog;
 					int digits;
 
-					data = g_array_sized_new(FALSE, FALSE, sizeof(uint8_t), len);
-					g_array_append_vals(data, devc->buffer, len);
-					float_data = g_array_new(FALSE, FALSE, sizeof(float));
-					for (i = 0; i < len; i++) {
-						voltage = (float)g_array_index(data, int8_t, i) / 25;
-						voltage = ((vdiv * voltage) - offset);
-						g_array_append_val(float_data, voltage);
-					}
 					vdivlog = log10f(vdiv);
 					digits = -(int) vdivlog + (vdivlog < 0.0);
 					sr_analog_init(&analog, &encoding, &meaning, &spec, digits);
+					float_data = NULL;
+					if (devc->analog_raw) {
+						/* 25 codes per division, applied by the receiver. */
+						sr_analog_set_raw_encoding(&encoding, 1, TRUE, FALSE,
+							vdiv / 25, -offset);
+						analog.data = devc->buffer;
+					} else {
+						float_data = g_malloc(len * sizeof(float));
+						for (i = 0; i < len; i++)
+							float_data[i] = vdiv * ((int8_t)devc->buffer[i] / 25.0f) - offset;
+						analog.data = float_data;
+					}
 					analog.meaning->channels = g_slist_append(NULL, ch);
-					analog.num_samples = float_data->len;
-					analog.data = (float *)float_data->data;
+					analog.num_samples = len;
 					analog.meaning->mq = SR_MQ_VOLTAGE;
 					analog.meaning->unit = SR_UNIT_VOLT;
 					analog.meaning->mqflags = 0;
@@ -606,7 +624,7 @@ SR_PRIV int siglent_sds_receive(int fd, int revents, void *cb_data)
 					packet.payload = &analog;
 					sr_session_send(sdi, &packet);
 					g_slist_free(analog.meaning->channels);
-					g_array_free(data, TRUE);
+					g_free(float_data);
 				}
 				len = 0;
 				if (devc->num_samples == (devc->num_block_bytes - SIGLENT_HEADER_SIZE)) {
@@ -643,7 +661,7 @@ SR_PRIV int siglent_sds_receive(int fd, int revents, void *cb_data)
 					siglent_sds_capture_start(sdi);
 
 					/* Start of next frame. */
-					std_session_send_df_frame_begin(sdi);
+					siglent_sds_frame_begin(sdi);
 				}
 			}
 		}
@@ -668,7 +686,7 @@ SR_PRIV int siglent_sds_receive(int fd, int revents, void *cb_data)
 			siglent_sds_capture_start(sdi);
 
 			/* Start of next frame. */
-			std_session_send_df_frame_begin(sdi);
+			siglent_sds_frame_begin(sdi);
 		}
 	}
 
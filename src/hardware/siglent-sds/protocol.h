@@ -108,6 +108,8 @@ struct dev_context {
 	uint64_t average_samples;
 	gboolean average_enabled;
 	enum data_source data_source;
+	/* Send the scope's bytes with scale and offset, not floats. */
+	gboolean analog_raw;
 	uint64_t analog_frame_size;
 	uint64_t digital_frame_size;
 	uint64_t num_samples;
@@ -158,6 +160,7 @@ struct dev_context {
 SR_PRIV int siglent_sds_config_set(const struct sr_dev_inst *sdi,
 	const char *format, ...);
 SR_PRIV int siglent_sds_capture_start(const struct sr_dev_inst *sdi);
+SR_PRIV int siglent_sds_frame_begin(const struct sr_dev_inst *sdi);
 SR_PRIV int siglent_sds_channel_start(const struct sr_dev_inst *sdi);
 SR_PRIV int siglent_sds_receive(int fd, int revents, void *cb_data);
 SR_PRIV int siglent_sds_get_dev_cfg(const struct sr_dev_inst *sdi);
@@ -160,7 +160,7 @@ static GSList *scan(struct sr_dev_driver *di, GSList *options)
 	}
 
 	/* List all libusb devices. */
-	num_devs = libusb_get_device_list(drvc->sr_ctx->libusb_ctx, &devlist);
+	num_devs = sr_usb_device_list(drvc->sr_ctx, &devlist);
 	if (num_devs < 0) {
 		sr_err("Failed to list USB devices: %s.",
 			libusb_error_name(num_devs));
@@ -356,6 +356,9 @@ static int config_get(uint32_t key, GVariant **data,
 	case SR_CONF_RLE:
 		*data = g_variant_new_boolean(devc->cfg_rle);
 		break;
+	case SR_CONF_LOGIC_EDGES:
+		*data = g_variant_new_boolean(devc->cfg_edges);
+		break;
 	case SR_CONF_EXTERNAL_CLOCK:
 		*data = g_variant_new_boolean(devc->cfg_clock_source
 						== CLOCK_EXT_CLK);
@@ -426,6 +429,9 @@ static int config_set(uint32_t key, GVariant *data,
 	case SR_CONF_RLE:
 		devc->cfg_rle = g_variant_get_boolean(data);
 		break;
+	case SR_CONF_LOGIC_EDGES:
+		devc->cfg_edges = g_variant_get_boolean(data);
+		break;
 	case SR_CONF_EXTERNAL_CLOCK:
 		devc->cfg_clock_source = (g_variant_get_boolean(data))
 			? CLOCK_EXT_CLK : CLOCK_INTERNAL;
@@ -69,6 +69,15 @@ struct sr_usb_dev_inst;
  */
 #define PACKET_SIZE		(5000 * 4 * 5)
 
+/* Maximum number of changes in an edges packet. The values are stored
+ * in the logic packet buffer, and take at most 8 bytes each.
+ */
+#define MAX_EDGES		(PACKET_SIZE / 8)
+
+/* Maximum number of samples covered by an edges packet.
+ */
+#define EDGE_PACKET_SAMPLES	(1 << 24)
+
 /** LWLA protocol command ID codes. */
 enum command_id {
 	CMD_READ_REG	= 1,
@@ -117,12 +126,19 @@ struct acquisition_state {
 	unsigned int mem_addr_done;	/* next address to be processed */
 	unsigned int mem_addr_next;	/* start address for next async read */
 	unsigned int mem_addr_stop;	/* end of memory range to be read */
-	unsigned int in_index;		/* position in read transfer buffer */
+	unsigned int mem_addr_end;	/* end of memory range in read_buf */
+	unsigned int in_index;		/* position in read_buf */
 	unsigned int out_index;		/* position in logic packet buffer */
 	enum rle_state rle;		/* RLE decoding state */
 
 	gboolean rle_enabled;	/* capturing in timing-state mode */
+	gboolean edges;		/* send changes instead of expanding runs */
+	gboolean have_edge_value;	/* edge_value is valid */
+	uint64_t edge_value;	/* sample value of the last change */
+	unsigned int num_edges;	/* number of changes in edges packet */
 	gboolean clock_boost;	/* switch to faster clock during capture */
+	gboolean read_cmd_busy;		/* memory read command in flight */
+	gboolean read_response_ready;	/* response arrived before command */
 	unsigned int status;	/* last received device status */
 
 	unsigned int reg_seq_pos;	/* index of next register/value pair */
@@ -130,10 +146,46 @@ struct acquisition_state {
 
 	struct regval reg_sequence[MAX_REG_SEQ_LEN];	/* register buffer */
 	uint32_t xfer_buf_in[MAX_ACQ_RECV_LEN32];	/* USB in buffer */
+	uint32_t read_buf[MAX_ACQ_RECV_LEN32];		/* memory being decoded */
 	uint16_t xfer_buf_out[MAX_ACQ_SEND_LEN16];	/* USB out buffer */
 	uint8_t out_packet[PACKET_SIZE];		/* logic payload */
+	uint64_t edge_offsets[MAX_EDGES];		/* edges payload */
 };
 
+/* Return the number of samples which still fit into the session packet.
+ */
+static inline unsigned int lwla_packet_space(const struct acquisition_state *acq,
+					     unsigned int unitsize)
+{
+	if (!acq->edges)
+		return PACKET_SIZE / unitsize - acq->out_index;
+	if (acq->num_edges >= MAX_EDGES)
+		return 0;
+
+	return EDGE_PACKET_SAMPLES - acq->out_index;
+}
+
+/* Record the current sample at the packet position as a change, unless
+ * it repeats the value of the previous change.
+ */
+static inline void lwla_queue_edge(struct acquisition_state *acq,
+				   unsigned int unitsize)
+{
+	uint8_t *value;
+	unsigned int i;
+
+	if (acq->have_edge_value && acq->sample == acq->edge_value)
+		return;
+
+	acq->edge_offsets[acq->num_edges] = acq->out_index;
+	value = &acq->out_packet[acq->num_edges * unitsize];
+	for (i = 0; i < unitsize; i++)
+		value[i] = (acq->sample >> (8 * i)) & 0xFF;
+	acq->num_edges++;
+	acq->edge_value = acq->sample;
+	acq->have_edge_value = TRUE;
+}
+
 static inline void lwla_queue_regval(struct acquisition_state *acq,
 				     unsigned int reg, uint32_t value)
 {
@@ -95,7 +95,7 @@ static void read_response(struct acquisition_state *acq)
 	unsigned int max_samples, run_samples;
 	unsigned int i;
 
-	words_left = MIN(acq->mem_addr_next, acq->mem_addr_stop)
+	words_left = MIN(acq->mem_addr_end, acq->mem_addr_stop)
 			- acq->mem_addr_done;
 	/* Calculate number of samples to write into packet. */
 	max_samples = MIN(acq->samples_max - acq->samples_done,
@@ -110,7 +110,7 @@ static void read_response(struct acquisition_state *acq)
 	 * alignment is guaranteed.
 	 */
 	out_p = (uint32_t *)&acq->out_packet[acq->out_index * UNIT_SIZE];
-	in_p = &acq->xfer_buf_in[acq->in_index];
+	in_p = &acq->read_buf[acq->in_index];
 	/*
 	 * Transfer two samples at a time, taking care to swap the 16-bit
 	 * halves of each input word but keeping the samples themselves in
@@ -130,26 +130,29 @@ static void read_response_rle(struct acquisition_state *acq)
 {
 	uint32_t *in_p;
 	uint16_t *out_p;
-	unsigned int words_left, max_samples, run_samples, wi, ri;
+	unsigned int words_left, max_samples, run_samples, wi;
 	uint32_t word;
-	uint16_t sample;
 
-	words_left = MIN(acq->mem_addr_next, acq->mem_addr_stop)
+	words_left = MIN(acq->mem_addr_end, acq->mem_addr_stop)
 			- acq->mem_addr_done;
-	in_p = &acq->xfer_buf_in[acq->in_index];
+	in_p = &acq->read_buf[acq->in_index];
 
 	for (wi = 0;; wi++) {
 		/* Calculate number of samples to write into packet. */
 		max_samples = MIN(acq->samples_max - acq->samples_done,
-				  PACKET_SIZE / UNIT_SIZE - acq->out_index);
+				  lwla_packet_space(acq, UNIT_SIZE));
 		run_samples = MIN(max_samples, acq->run_len);
 
-		/* Expand run-length samples into session packet. */
-		sample = GUINT16_TO_LE(acq->sample);
-		out_p = &((uint16_t *)acq->out_packet)[acq->out_index];
-
-		for (ri = 0; ri < run_samples; ri++)
-			out_p[ri] = sample;
+		if (acq->edges) {
+			/* Forward the change instead of expanding the run. */
+			if (run_samples > 0)
+				lwla_queue_edge(acq, UNIT_SIZE);
+		} else {
+			/* Expand run-length samples into session packet. */
+			out_p = &((uint16_t *)acq->out_packet)[acq->out_index];
+			sr_simd_fill_u16(out_p, GUINT16_TO_LE(acq->sample),
+					 run_samples);
+		}
 
 		acq->run_len -= run_samples;
 		acq->out_index += run_samples;
@@ -169,6 +172,15 @@ static void read_response_rle(struct acquisition_state *acq)
 	acq->mem_addr_done += wi;
 }
 
+/* Decode the next part of a capture memory read. */
+static void decode_response(struct acquisition_state *acq)
+{
+	if (acq->rle_enabled)
+		read_response_rle(acq);
+	else
+		read_response(acq);
+}
+
 /* Check whether we can receive responses of more than 64 bytes.
  * The FX2 firmware of the LWLA1016 has a bug in the reset logic which
  * sometimes causes the response endpoint to be limited to transfers of
@@ -416,10 +428,6 @@ static int handle_response(const struct sr_dev_inst *sdi)
 			devc->transfer_error = TRUE;
 			return SR_ERR;
 		}
-		if (acq->rle_enabled)
-			read_response_rle(acq);
-		else
-			read_response(acq);
 		break;
 	default:
 		sr_err("BUG: unhandled response state %d.", devc->state);
@@ -434,13 +442,14 @@ SR_PRIV const struct model_info lwla1016_info = {
 	.name = "LWLA1016",
 	.num_channels = NUM_CHANNELS,
 
-	.num_devopts = 5,
+	.num_devopts = 6,
 	.devopts = {
 		SR_CONF_LIMIT_SAMPLES | SR_CONF_GET | SR_CONF_SET,
 		SR_CONF_LIMIT_MSEC | SR_CONF_GET | SR_CONF_SET,
 		SR_CONF_SAMPLERATE | SR_CONF_GET | SR_CONF_SET | SR_CONF_LIST,
 		SR_CONF_TRIGGER_MATCH | SR_CONF_LIST,
 		SR_CONF_RLE | SR_CONF_GET | SR_CONF_SET,
+		SR_CONF_LOGIC_EDGES | SR_CONF_GET | SR_CONF_SET,
 	},
 	.num_samplerates = 19,
 	.samplerates = {
@@ -459,4 +468,5 @@ SR_PRIV const struct model_info lwla1016_info = {
 
 	.prepare_request = &prepare_request,
 	.handle_response = &handle_response,
+	.decode_response = &decode_response,
 };
@@ -18,6 +18,7 @@
  */
 
 #include <config.h>
+#include <string.h>
 #include "lwla.h"
 #include "protocol.h"
 
@@ -192,29 +193,38 @@ static void read_response(struct acquisition_state *acq)
 	uint64_t sample, high_nibbles, word;
 	uint32_t *slice;
 	uint8_t *out_p;
-	unsigned int words_left, max_samples, run_samples, wi, ri, si;
+	unsigned int words_left, max_samples, run_samples, wi, ri, si, n;
 
 	/* Number of 36-bit words remaining in the transfer buffer. */
-	words_left = MIN(acq->mem_addr_next, acq->mem_addr_stop)
+	words_left = MIN(acq->mem_addr_end, acq->mem_addr_stop)
 			- acq->mem_addr_done;
 
 	for (wi = 0;; wi++) {
 		/* Calculate number of samples to write into packet. */
 		max_samples = MIN(acq->samples_max - acq->samples_done,
-				  PACKET_SIZE / UNIT_SIZE - acq->out_index);
+				  lwla_packet_space(acq, UNIT_SIZE));
 		run_samples = MIN(max_samples, acq->run_len);
 
-		/* Expand run-length samples into session packet. */
-		sample = acq->sample;
-		out_p = &acq->out_packet[acq->out_index * UNIT_SIZE];
+		if (acq->edges) {
+			/* Forward the change instead of expanding the run. */
+			if (run_samples > 0)
+				lwla_queue_edge(acq, UNIT_SIZE);
+		} else if (run_samples > 0) {
+			/* Expand run-length samples into session packet. */
+			sample = acq->sample;
+			out_p = &acq->out_packet[acq->out_index * UNIT_SIZE];
 
-		for (ri = 0; ri < run_samples; ri++) {
 			out_p[0] =  sample        & 0xFF;
 			out_p[1] = (sample >>  8) & 0xFF;
 			out_p[2] = (sample >> 16) & 0xFF;
 			out_p[3] = (sample >> 24) & 0xFF;
 			out_p[4] = (sample >> 32) & 0xFF;
-			out_p += UNIT_SIZE;
+
+			/* Fill the rest of the run by doubling the copied block. */
+			for (ri = 1; ri < run_samples; ri += n) {
+				n = MIN(ri, run_samples - ri);
+				memcpy(&out_p[ri * UNIT_SIZE], out_p, n * UNIT_SIZE);
+			}
 		}
 		acq->run_len -= run_samples;
 		acq->out_index += run_samples;
@@ -226,7 +236,7 @@ static void read_response(struct acquisition_state *acq)
 			break; /* Done with current transfer. */
 
 		/* Get the current slice of 8 packed 36-bit words. */
-		slice = &acq->xfer_buf_in[(acq->in_index + wi) / 8 * 9];
+		slice = &acq->read_buf[(acq->in_index + wi) / 8 * 9];
 		si = (acq->in_index + wi) % 8; /* Word index within slice. */
 
 		/* Extract the next 36-bit word. */
@@ -536,7 +546,6 @@ static int handle_response(const struct sr_dev_inst *sdi)
 			devc->transfer_error = TRUE;
 			return SR_ERR;
 		}
-		read_response(acq);
 		break;
 	default:
 		sr_err("BUG: unhandled response state %d.", devc->state);
@@ -551,7 +560,7 @@ SR_PRIV const struct model_info lwla1034_info = {
 	.name = "LWLA1034",
 	.num_channels = NUM_CHANNELS,
 
-	.num_devopts = 8,
+	.num_devopts = 9,
 	.devopts = {
 		SR_CONF_LIMIT_SAMPLES | SR_CONF_GET | SR_CONF_SET,
 		SR_CONF_LIMIT_MSEC | SR_CONF_GET | SR_CONF_SET,
@@ -561,6 +570,7 @@ SR_PRIV const struct model_info lwla1034_info = {
 		SR_CONF_CLOCK_EDGE | SR_CONF_GET | SR_CONF_SET | SR_CONF_LIST,
 		SR_CONF_TRIGGER_SOURCE | SR_CONF_GET | SR_CONF_SET | SR_CONF_LIST,
 		SR_CONF_TRIGGER_SLOPE | SR_CONF_GET | SR_CONF_SET | SR_CONF_LIST,
+		SR_CONF_LOGIC_EDGES | SR_CONF_GET | SR_CONF_SET,
 	},
 	.num_samplerates = 20,
 	.samplerates = {
@@ -579,4 +589,5 @@ SR_PRIV const struct model_info lwla1034_info = {
 
 	.prepare_request = &prepare_request,
 	.handle_response = &handle_response,
+	.decode_response = &read_response,
 };
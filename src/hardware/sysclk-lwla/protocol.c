@@ -115,7 +115,18 @@ static int submit_request(const struct sr_dev_inst *sdi,
 			next_reg_write(acq);
 	}
 
-	return submit_transfer(devc, acq->xfer_out);
+	ret = submit_transfer(devc, acq->xfer_out);
+
+	/*
+	 * Queue the response transfer of a memory read right away, so that
+	 * it doesn't wait for the command completion to be handled.
+	 */
+	if (ret == SR_OK && state == STATE_READ_REQUEST) {
+		acq->read_cmd_busy = TRUE;
+		ret = submit_transfer(devc, acq->xfer_in);
+	}
+
+	return ret;
 }
 
 /* Evaluate and act on the response to a capture status request. */
@@ -173,6 +184,8 @@ static void handle_length_response(const struct sr_dev_inst *sdi)
 	acq->samples_done = 0;
 	acq->mem_addr_done = acq->mem_addr_next;
 	acq->out_index = 0;
+	acq->num_edges = 0;
+	acq->have_edge_value = FALSE;
 
 	if (acq->mem_addr_next >= acq->mem_addr_stop) {
 		submit_request(sdi, STATE_READ_FINISH);
@@ -184,61 +197,94 @@ static void handle_length_response(const struct sr_dev_inst *sdi)
 	submit_request(sdi, STATE_READ_PREPARE);
 }
 
-/* Evaluate and act on the response to a capture memory read request. */
-static void handle_read_response(const struct sr_dev_inst *sdi)
+/* Send off the samples collected in the packet buffer. */
+static void send_packet(const struct sr_dev_inst *sdi)
 {
 	struct dev_context *devc;
 	struct acquisition_state *acq;
 	struct sr_datafeed_packet packet;
 	struct sr_datafeed_logic logic;
-	unsigned int end_addr;
+	struct sr_datafeed_logic_edges edges;
+	unsigned int unitsize;
 
 	devc = sdi->priv;
 	acq = devc->acquisition;
+	unitsize = (devc->model->num_channels + 7) / 8;
+
+	if (acq->edges) {
+		packet.type = SR_DF_LOGIC_EDGES;
+		packet.payload = &edges;
+		edges.num_samples = acq->out_index;
+		edges.unitsize = unitsize;
+		edges.num_edges = acq->num_edges;
+		edges.offsets = acq->edge_offsets;
+		edges.values = acq->out_packet;
+	} else {
+		packet.type = SR_DF_LOGIC;
+		packet.payload = &logic;
+		logic.length = acq->out_index * unitsize;
+		logic.unitsize = unitsize;
+		logic.data = acq->out_packet;
+	}
+	sr_session_send(sdi, &packet);
 
-	/* Prepare session packet. */
-	packet.type = SR_DF_LOGIC;
-	packet.payload = &logic;
-	logic.unitsize = (devc->model->num_channels + 7) / 8;
-	logic.data = acq->out_packet;
+	acq->out_index = 0;
+	acq->num_edges = 0;
+}
+
+/* Evaluate and act on the response to a capture memory read request. */
+static void handle_read_response(const struct sr_dev_inst *sdi)
+{
+	struct dev_context *devc;
+	struct acquisition_state *acq;
+	unsigned int unitsize;
+	gboolean read_more;
 
-	end_addr = MIN(acq->mem_addr_next, acq->mem_addr_stop);
+	devc = sdi->priv;
+	acq = devc->acquisition;
+	unitsize = (devc->model->num_channels + 7) / 8;
 	acq->in_index = 0;
 
+	if (!devc->cancel_requested && acq->samples_done < acq->samples_max) {
+		if ((*devc->model->handle_response)(sdi) != SR_OK) {
+			devc->transfer_error = TRUE;
+			return;
+		}
+		/* Decode from a copy, the next block is read meanwhile. */
+		memcpy(acq->read_buf, acq->xfer_buf_in,
+		       acq->xfer_in->actual_length);
+	}
+	acq->mem_addr_end = MIN(acq->mem_addr_next, acq->mem_addr_stop);
+
+	read_more = !devc->cancel_requested
+			&& acq->samples_done < acq->samples_max
+			&& acq->mem_addr_next < acq->mem_addr_stop;
+	if (read_more && submit_request(sdi, STATE_READ_REQUEST) != SR_OK)
+		return;
+
 	/*
-	 * Repeatedly call the model-specific read response handler until
-	 * all data received in the transfer has been accounted for.
+	 * Repeatedly call the model-specific decoder until all data
+	 * received in the transfer has been accounted for.
 	 */
 	while (!devc->cancel_requested
-			&& (acq->run_len > 0 || acq->mem_addr_done < end_addr)
+			&& (acq->run_len > 0 || acq->mem_addr_done < acq->mem_addr_end)
 			&& acq->samples_done < acq->samples_max) {
 
-		if ((*devc->model->handle_response)(sdi) != SR_OK) {
-			devc->transfer_error = TRUE;
-			return;
-		}
-		if (acq->out_index * logic.unitsize >= PACKET_SIZE) {
+		(*devc->model->decode_response)(acq);
+
+		if (lwla_packet_space(acq, unitsize) == 0) {
 			/* Send off full logic packet. */
-			logic.length = acq->out_index * logic.unitsize;
-			sr_session_send(sdi, &packet);
-			acq->out_index = 0;
+			send_packet(sdi);
 		}
 	}
 
-	if (!devc->cancel_requested
-			&& acq->samples_done < acq->samples_max
-			&& acq->mem_addr_next < acq->mem_addr_stop) {
-		/* Request the next block. */
-		submit_request(sdi, STATE_READ_REQUEST);
+	/* Wait for the block in flight. */
+	if (read_more)
 		return;
-	}
 
 	/* Send partially filled packet as it is the last one. */
-	if (!devc->cancel_requested && acq->out_index > 0) {
- 		logic.length = acq->out_index * logic.unitsize;
-		sr_session_send(sdi, &packet);
-		acq->out_index = 0;
-	}
+	if (!devc->cancel_requested && acq->out_index > 0)
+		send_packet(sdi);
 	submit_request(sdi, STATE_READ_FINISH);
 }
 
@@ -329,6 +375,15 @@ static void LIBUSB_CALL transfer_out_completed(struct libusb_transfer *transfer)
 		return;
 	}
 
+	/* The response to a memory read is already queued. */
+	if (devc->state == STATE_READ_REQUEST) {
+		acq->read_cmd_busy = FALSE;
+		if (acq->read_response_ready) {
+			acq->read_response_ready = FALSE;
+			handle_read_response(sdi);
+		}
+		return;
+	}
 	/* If this was a read request, wait for the response. */
 	if ((devc->state & STATE_EXPECT_RESPONSE) != 0) {
 		submit_transfer(devc, acq->xfer_in);
@@ -427,7 +482,11 @@ static void LIBUSB_CALL transfer_in_completed(struct libusb_transfer *transfer)
 			handle_length_response(sdi);
 		break;
 	case STATE_READ_REQUEST:
-		handle_read_response(sdi);
+		/* The next command can't be sent before this one completed. */
+		if (acq->read_cmd_busy)
+			acq->read_response_ready = TRUE;
+		else
+			handle_read_response(sdi);
 		break;
 	default:
 		sr_err("Unexpected device state %d.", devc->state);
@@ -519,6 +578,8 @@ static int init_acquisition_state(const struct sr_dev_inst *sdi)
 	}
 
 	acq->rle_enabled = devc->cfg_rle;
+	/* Only compressed captures have runs to forward as edges. */
+	acq->edges = devc->cfg_edges && acq->rle_enabled;
 	devc->acquisition = acq;
 
 	return SR_OK;
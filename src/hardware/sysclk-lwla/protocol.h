@@ -125,6 +125,7 @@ struct dev_context {
 	gboolean transfer_error;	/* error during device communication */
 
 	gboolean cfg_rle;			/* RLE compression setting */
+	gboolean cfg_edges;			/* send runs as edges setting */
 	enum clock_source cfg_clock_source;	/* clock source setting */
 	enum signal_edge cfg_clock_edge;	/* ext clock edge setting */
 	enum trigger_source cfg_trigger_source;	/* trigger source setting */
@@ -137,7 +138,7 @@ struct model_info {
 	int num_channels;
 
 	unsigned int num_devopts;
-	uint32_t devopts[8];
+	uint32_t devopts[9];
 
 	unsigned int num_samplerates;
 	uint64_t samplerates[20];
@@ -148,6 +149,7 @@ struct model_info {
 
 	int (*prepare_request)(const struct sr_dev_inst *sdi);
 	int (*handle_response)(const struct sr_dev_inst *sdi);
+	void (*decode_response)(struct acquisition_state *acq);
 };
 
 extern SR_PRIV const struct model_info lwla1016_info;
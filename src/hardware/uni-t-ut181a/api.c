@@ -529,9 +529,10 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 		ret = ut181a_waitfor_response(sdi, 200);
 		if (ret < 0)
 			return ret;
+		memset(&devc->info.rec_data, 0, sizeof(devc->info.rec_data));
+		devc->info.rec_data.rec_idx = rec_idx;
 		devc->info.rec_data.samples_total = devc->wait_state.data_value;
-		devc->info.rec_data.samples_curr = 0;
-		ret = ut181a_send_cmd_get_rec_samples(serial, rec_idx, 0);
+		ret = ut181a_request_rec_samples(sdi);
 	}
 	if (ret < 0)
 		return ret;
@@ -1232,6 +1232,52 @@ SR_PRIV int ut181a_send_cmd_get_rec_samples(struct sr_serial_dev_inst *serial, s
 	return ut181a_send_frame(serial, cmd, sizeof(cmd));
 }
 
+/**
+ * Request the next chunks of a recording's samples.
+ *
+ * @param[in] sdi The device instance.
+ *
+ * @returns SR_OK upon success, SR_ERR_* upon error.
+ *
+ * Until the first chunk was received (the chunk size is not known),
+ * and after a chunk turned out shorter than expected, only a single
+ * request is outstanding. Otherwise up to REC_PIPELINE_DEPTH requests
+ * are, for consecutive chunks.
+ */
+SR_PRIV int ut181a_request_rec_samples(const struct sr_dev_inst *sdi)
+{
+	struct dev_context *devc;
+	struct sr_serial_dev_inst *serial;
+	size_t depth, stride;
+	int ret;
+
+	devc = sdi->priv;
+	serial = sdi->conn;
+
+	if (devc->info.rec_data.chunk_size && !devc->info.rec_data.sequential) {
+		depth = REC_PIPELINE_DEPTH;
+		stride = devc->info.rec_data.chunk_size;
+	} else {
+		depth = 1;
+		stride = 0;
+	}
+	while (devc->info.rec_data.requests_pending < depth &&
+			devc->info.rec_data.samples_requested <
+			devc->info.rec_data.samples_total) {
+		ret = ut181a_send_cmd_get_rec_samples(serial,
+			devc->info.rec_data.rec_idx,
+			devc->info.rec_data.samples_requested);
+		if (ret < 0)
+			return ret;
+		devc->info.rec_data.requests_pending++;
+		if (!stride)
+			break;
+		devc->info.rec_data.samples_requested += stride;
+	}
+
+	return SR_OK;
+}
+
 /* TODO
  * Construct and transmit "record on/off" command. Requires a caption,
  * an interval, and a duration to start a recording. Recordings can get
@@ -1518,6 +1564,42 @@ static int ut181a_feedbuff_send_feed(struct feed_buffer *buff,
 	return ret;
 }
 
+/**
+ * Send a run of values which share their precision, in one packet.
+ *
+ * The run gets cut short when it would exceed the sample count limit.
+ */
+static int ut181a_feedbuff_send_values(struct feed_buffer *buff,
+	struct sr_dev_inst *sdi, float *values, size_t count, int digits)
+{
+	struct dev_context *devc;
+	uint64_t remain;
+	int ret;
+
+	if (!buff || !sdi)
+		return SR_ERR_ARG;
+
+	devc = sdi->priv;
+	if (devc && devc->limits.limit_samples) {
+		remain = 0;
+		if (devc->limits.samples_read < devc->limits.limit_samples)
+			remain = devc->limits.limit_samples - devc->limits.samples_read;
+		count = MIN(count, remain);
+	}
+	if (!count)
+		return SR_OK;
+
+	buff->analog.data = values;
+	buff->analog.num_samples = count;
+	buff->analog.encoding->digits = digits;
+	buff->analog.spec->spec_digits = digits;
+	ret = ut181a_feedbuff_send_feed(buff, sdi, count);
+	buff->analog.data = &buff->main_value;
+	buff->analog.num_samples = 1;
+
+	return ret;
+}
+
 /**
  * Release previously allocated resources in the feed buffer.
  */
@@ -1741,6 +1823,9 @@ static int process_packet(struct sr_dev_inst *sdi, uint8_t *pkt, size_t len)
 	const char *unit_text, *rec_name;
 	struct feed_buffer feedbuff;
 	struct value_params value;
+	float rec_values[REC_CHUNK_MAX];
+	size_t rec_count, chunk_want, chunk_next;
+	int rec_digits;
 	const struct mqopt_item *mqitem;
 	int ret;
 	uint8_t v8; uint16_t v16; uint32_t v32; float vf;
@@ -2564,13 +2649,45 @@ static int process_packet(struct sr_dev_inst *sdi, uint8_t *pkt, size_t len)
 		ret = consume_u8(&info->rec_data.samples_chunk, &payload, &pl_dlen);
 		if (ret != SR_OK)
 			return SR_ERR_DATA;
-		info->rec_data.samples_curr += info->rec_data.samples_chunk;
+		if (info->rec_data.requests_pending)
+			info->rec_data.requests_pending--;
+
+		/*
+		 * Responses to requests which were outstanding when a
+		 * short chunk arrived are for the wrong offsets. Drop
+		 * them, the download continues after the short chunk.
+		 */
+		if (info->rec_data.responses_discard) {
+			info->rec_data.responses_discard--;
+			ret = ut181a_feedbuff_cleanup(&feedbuff);
+			break;
+		}
+		chunk_want = info->rec_data.samples_total - info->rec_data.samples_curr;
+		chunk_want = MIN(chunk_want, info->rec_data.chunk_size);
+		chunk_next = info->rec_data.samples_curr + info->rec_data.samples_chunk;
+		if (!info->rec_data.chunk_size) {
+			/* The first chunk determines the stride of requests. */
+			info->rec_data.chunk_size = info->rec_data.samples_chunk;
+			info->rec_data.samples_requested = chunk_next;
+		} else if (info->rec_data.samples_chunk < chunk_want) {
+			/* Continue one request at a time after a short chunk. */
+			info->rec_data.sequential = TRUE;
+			info->rec_data.responses_discard = info->rec_data.requests_pending;
+			info->rec_data.samples_requested = chunk_next;
+		} else if (info->rec_data.sequential) {
+			info->rec_data.samples_requested = chunk_next;
+		}
+		info->rec_data.samples_curr = chunk_next;
+
+		/*
+		 * Send runs of values which share their precision in one
+		 * packet. Implementation detail: Consume all received
+		 * data, yet skip processing when a limit was reached and
+		 * previously terminated acquisition.
+		 */
+		rec_count = 0;
+		rec_digits = 0;
 		while (info->rec_data.samples_chunk--) {
-			/*
-			 * Implementation detail: Consume all received
-			 * data, yet skip processing when a limit was
-			 * reached and previously terminated acquisition.
-			 */
 			ret = SR_OK;
 			ret |= consume_flt(&vf, &payload, &pl_dlen);
 			ret |= consume_u8(&v8, &payload, &pl_dlen);
@@ -2578,24 +2695,25 @@ static int process_packet(struct sr_dev_inst *sdi, uint8_t *pkt, size_t len)
 			if (ret != SR_OK)
 				return SR_ERR_DATA;
 
-			if (sdi->status != SR_ST_ACTIVE)
-				continue;
-
-			ret = ut181a_feedbuff_start_frame(sdi);
-			if (ret != SR_OK)
-				return SR_ERR_DATA;
-
 			ret = SR_OK;
 			ret |= ut181a_get_value_params(&value, vf, v8);
 			ret |= ut181a_feedbuff_setup_value(&feedbuff, &value);
-			ret |= ut181a_feedbuff_send_feed(&feedbuff, sdi, 1);
-			if (ret != SR_OK)
-				return SR_ERR_DATA;
-
-			ret = ut181a_feedbuff_count_frame(sdi);
 			if (ret != SR_OK)
 				return SR_ERR_DATA;
+			if (rec_count && value.digits != rec_digits) {
+				ret = ut181a_feedbuff_send_values(&feedbuff, sdi,
+					rec_values, rec_count, rec_digits);
+				if (ret != SR_OK)
+					return SR_ERR_DATA;
+				rec_count = 0;
+			}
+			rec_values[rec_count++] = feedbuff.main_value;
+			rec_digits = value.digits;
 		}
+		ret = ut181a_feedbuff_send_values(&feedbuff, sdi,
+			rec_values, rec_count, rec_digits);
+		if (ret != SR_OK)
+			return SR_ERR_DATA;
 		ret = ut181a_feedbuff_cleanup(&feedbuff);
 		break;
 
@@ -2672,14 +2790,16 @@ static int process_packet(struct sr_dev_inst *sdi, uint8_t *pkt, size_t len)
 			/*
 			 * The sample count was incremented above during
 			 * reception, because of variable length chunks
-			 * of sample data.
+			 * of sample data. Keep the pipeline of requests
+			 * filled, after dropped responses have drained.
 			 */
 			if (info->rec_data.samples_curr >= info->rec_data.samples_total) {
 				ut181a_cond_stop_acquisition(sdi);
 				break;
 			}
-			ret = ut181a_send_cmd_get_rec_samples(serial,
-				info->rec_data.rec_idx, info->rec_data.samples_curr);
+			if (info->rec_data.responses_discard)
+				break;
+			ret = ut181a_request_rec_samples(sdi);
 			if (ret < 0)
 				ut181a_cond_stop_acquisition(sdi);
 			break;
@@ -2839,39 +2959,43 @@ static int ut181a_receive_data(struct sr_dev_inst *sdi)
 	devc = sdi->priv;
 	serial = sdi->conn;
 
-	/*
-	 * Discard receive data when the buffer is exhausted. This shall
-	 * allow to (re-)synchronize to the data stream when we find it
-	 * in an arbitrary state. (Takes a while to exhaust the buffer.
-	 * Data is seriously unusable when we get here.)
-	 */
-	if (devc->recv_count == sizeof(devc->recv_buff)) {
-		if (FRAME_DUMP_RXDATA)
-			FRAME_DUMP_CALL("Discarding RX buffer (space exhausted)");
-		(void)process_packet(sdi, &devc->recv_buff[0], devc->recv_count);
-		devc->recv_count = 0;
-	}
+	do {
+		/*
+		 * Discard receive data when the buffer is exhausted. This
+		 * shall allow to (re-)synchronize to the data stream when
+		 * we find it in an arbitrary state. (Takes a while to
+		 * exhaust the buffer. Data is seriously unusable when we
+		 * get here.)
+		 */
+		if (devc->recv_count == sizeof(devc->recv_buff)) {
+			if (FRAME_DUMP_RXDATA)
+				FRAME_DUMP_CALL("Discarding RX buffer (space exhausted)");
+			(void)process_packet(sdi, &devc->recv_buff[0], devc->recv_count);
+			devc->recv_count = 0;
+		}
 
-	/*
-	 * Drain more data from the serial port, and check the receive
-	 * buffer for packets. Process what was found to be complete.
-	 */
-	len = sizeof(devc->recv_buff) - devc->recv_count;
-	data = &devc->recv_buff[devc->recv_count];
-	slen = serial_read_nonblocking(serial, data, len);
-	if (slen < 0) {
-		if (FRAME_DUMP_RXDATA)
-			FRAME_DUMP_CALL("UART RX failed, rc %zd", slen);
-		return 0;
-	}
-	len = slen;
-	if (FRAME_DUMP_RXDATA && sr_log_loglevel_get() >= FRAME_DUMP_LEVEL) {
-		spew = sr_hexdump_new(data, len);
-		FRAME_DUMP_CALL("UART RX, %zu bytes: %s", len, spew->str);
-		sr_hexdump_free(spew);
-	}
-	devc->recv_count += len;
-	process_buffer(sdi);
+		/*
+		 * Drain more data from the serial port, and check the
+		 * receive buffer for packets. Process what was found to
+		 * be complete. Keep reading while reads fill the buffer,
+		 * several frames are pending during record downloads.
+		 */
+		len = sizeof(devc->recv_buff) - devc->recv_count;
+		data = &devc->recv_buff[devc->recv_count];
+		slen = serial_read_nonblocking(serial, data, len);
+		if (slen < 0) {
+			if (FRAME_DUMP_RXDATA)
+				FRAME_DUMP_CALL("UART RX failed, rc %zd", slen);
+			return 0;
+		}
+		if (FRAME_DUMP_RXDATA && sr_log_loglevel_get() >= FRAME_DUMP_LEVEL) {
+			spew = sr_hexdump_new(data, slen);
+			FRAME_DUMP_CALL("UART RX, %zd bytes: %s", slen, spew->str);
+			sr_hexdump_free(spew);
+		}
+		devc->recv_count += slen;
+		process_buffer(sdi);
+	} while ((size_t)slen == len);
 
 	return 0;
 }
@@ -151,8 +151,7 @@ static void process_packet(struct sr_dev_inst *sdi, uint8_t *pkt, size_t len)
 	 * memory slots come through as "----" measurements.
 	 */
 	devc = sdi->priv;
-	sr_sw_limits_update_samples_read(&devc->limits, 1);
-	if (sr_sw_limits_check(&devc->limits))
+	if (sr_sw_limits_update_and_check(&devc->limits, 1))
 		sr_dev_acquisition_stop(sdi);
 }
 
@@ -44,6 +44,7 @@ static const uint32_t devopts[] = {
 	SR_CONF_HORIZ_TRIGGERPOS | SR_CONF_GET | SR_CONF_SET,
 	SR_CONF_TRIGGER_SOURCE | SR_CONF_GET | SR_CONF_SET | SR_CONF_LIST,
 	SR_CONF_TRIGGER_SLOPE | SR_CONF_GET | SR_CONF_SET | SR_CONF_LIST,
+	SR_CONF_ANALOG_RAW | SR_CONF_GET | SR_CONF_SET,
 };
 
 static const uint32_t devopts_cg_analog[] = {
@@ -123,6 +124,7 @@ static GSList *scan(struct sr_dev_driver *di, GSList *options)
 static void clear_helper(struct dev_context *devc)
 {
 	dlm_scope_state_destroy(devc->model_state);
+	dlm_buffers_free(devc);
 	g_free(devc->analog_groups);
 	g_free(devc->digital_groups);
 }
@@ -206,6 +208,10 @@ static int config_get(uint32_t key, GVariant **data,
 		*data = g_variant_new_int32(model->num_xdivs);
 		ret = SR_OK;
 		break;
+	case SR_CONF_ANALOG_RAW:
+		*data = g_variant_new_boolean(devc->analog_raw);
+		ret = SR_OK;
+		break;
 	case SR_CONF_TIMEBASE:
 		*data = g_variant_new("(tt)",
 				dlm_timebases[state->timebase][0],
@@ -291,6 +297,10 @@ static int config_set(uint32_t key, GVariant *data,
 		devc->frame_limit = g_variant_get_uint64(data);
 		ret = SR_OK;
 		break;
+	case SR_CONF_ANALOG_RAW:
+		devc->analog_raw = g_variant_get_boolean(data);
+		ret = SR_OK;
+		break;
 	case SR_CONF_TRIGGER_SOURCE:
 		if ((idx = std_str_idx(data, *model->trigger_sources, model->num_trigger_sources)) < 0)
 			return SR_ERR_ARG;
@@ -514,8 +524,12 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 		return SR_ERR_NA;
 	}
 
+	if (dlm_frames_prepare(sdi) != SR_OK)
+		return SR_ERR;
+
 	/* Request data for the first enabled channel. */
 	devc->current_channel = devc->enabled_channels;
+	devc->read_started = FALSE;
 	dlm_channel_data_request(sdi);
 
 	sr_scpi_source_add(sdi->session, scpi, G_IO_IN, 5,
@@ -832,6 +832,60 @@ SR_PRIV int dlm_device_init(struct sr_dev_inst *sdi, int model_index)
 	return SR_OK;
 }
 
+/**
+ * Determines the history records to transfer. With a frame limit of
+ * more than one frame, the most recent records from the acquisition
+ * history get transferred, oldest first.
+ *
+ * @param sdi The device instance.
+ *
+ * @return SR_OK upon success.
+ */
+SR_PRIV int dlm_frames_prepare(const struct sr_dev_inst *sdi)
+{
+	struct dev_context *devc;
+	int record_min;
+	int64_t first;
+
+	devc = sdi->priv;
+	devc->num_frames = 0;
+	devc->cur_record = 0;
+
+	if (devc->frame_limit <= 1)
+		return SR_OK;
+
+	if (dlm_record_min_get(sdi->conn, &record_min) != SR_OK) {
+		sr_warn("Failed to query the acquisition history, "
+			"only transferring the most recent record.");
+		return SR_OK;
+	}
+
+	first = 1 - (int64_t)MIN(devc->frame_limit, G_MAXINT);
+	if (first < record_min)
+		first = record_min;
+	if (first > 0)
+		first = 0;
+	devc->cur_record = first;
+	sr_dbg("Transferring history records %d to 0.", devc->cur_record);
+
+	return SR_OK;
+}
+
+/**
+ * Frees the buffers which received waveform data is kept in.
+ *
+ * @param devc The device context.
+ */
+SR_PRIV void dlm_buffers_free(struct dev_context *devc)
+{
+	if (devc->block)
+		g_array_free(devc->block, TRUE);
+	devc->block = NULL;
+	g_free(devc->float_buf);
+	devc->float_buf = NULL;
+	devc->float_buf_size = 0;
+}
+
 SR_PRIV int dlm_channel_data_request(const struct sr_dev_inst *sdi)
 {
 	struct dev_context *devc;
@@ -841,6 +895,15 @@ SR_PRIV int dlm_channel_data_request(const struct sr_dev_inst *sdi)
 	devc = sdi->priv;
 	ch = devc->current_channel->data;
 
+	/* Select the record and the data format once per frame. */
+	if (devc->current_channel == devc->enabled_channels) {
+		result = dlm_waveform_setup(sdi->conn, devc->cur_record);
+		if (result != SR_OK) {
+			devc->data_pending = FALSE;
+			return result;
+		}
+	}
+
 	switch (ch->type) {
 	case SR_CHANNEL_ANALOG:
 		result = dlm_analog_data_get(sdi->conn, ch->index + 1);
@@ -863,32 +926,36 @@ SR_PRIV int dlm_channel_data_request(const struct sr_dev_inst *sdi)
 }
 
 /**
- * Reads and removes the block data header from a given data input.
+ * Reads the block data header from a given data input.
  * Format is #ndddd... with n being the number of decimal digits d.
  * The string dddd... contains the decimal-encoded length of the data.
  * Example: #9000000013 would yield a length of 13 bytes.
  *
  * @param data The input data.
+ * @param offset The position of the data after the header.
  * @param len The determined input data length.
  */
-static int dlm_block_data_header_process(GArray *data, int *len)
+static int dlm_block_data_header_process(const GArray *data,
+		size_t *offset, int *len)
 {
 	int i, n;
 	gchar s[20];
 
-	if (g_array_index(data, gchar, 0) != '#')
+	if (data->len < 2 || data->data[0] != '#')
 		return SR_ERR;
 
-	n = (uint8_t)(g_array_index(data, gchar, 1) - '0');
+	n = (uint8_t)(data->data[1] - '0');
+	if (n < 1 || n > 9 || data->len < (guint)(2 + n))
+		return SR_ERR;
 
 	for (i = 0; i < n; i++)
-		s[i] = g_array_index(data, gchar, 2 + i);
+		s[i] = data->data[2 + i];
 	s[i] = 0;
 
 	if (sr_atoi(s, len) != SR_OK)
 		return SR_ERR;
 
-	g_array_remove_range(data, 0, 2 + n);
+	*offset = 2 + n;
 
 	return SR_OK;
 }
@@ -897,18 +964,18 @@ static int dlm_block_data_header_process(GArray *data, int *len)
  * Turns raw sample data into voltages and sends them off to the session bus.
  *
  * @param data The raw sample data.
+ * @param len The number of bytes in @p data.
  * @ch_state Pointer to the state of the channel whose data we're processing.
  * @sdi The device instance.
  *
  * @return SR_ERR when data is trucated, SR_OK otherwise.
  */
-static int dlm_analog_samples_send(GArray *data,
+static int dlm_analog_samples_send(const uint8_t *data, size_t len,
 		struct analog_channel_state *ch_state,
 		struct sr_dev_inst *sdi)
 {
 	uint32_t i, samples;
-	float voltage, range, offset;
-	GArray *float_data;
+	float range, offset, scale;
 	struct dev_context *devc;
 	struct scope_state *model_state;
 	struct sr_channel *ch;
@@ -923,7 +990,7 @@ static int dlm_analog_samples_send(GArray *data,
 	samples = model_state->samples_per_frame;
 	ch = devc->current_channel->data;
 
-	if (data->len < samples * sizeof(uint8_t)) {
+	if (len < samples * sizeof(uint8_t)) {
 		sr_err("Truncated waveform data packet received.");
 		return SR_ERR;
 	}
@@ -931,23 +998,30 @@ static int dlm_analog_samples_send(GArray *data,
 	range = ch_state->waveform_range;
 	offset = ch_state->waveform_offset;
 
+	/* TODO: Use proper 'digits' value for this device (and its modes). */
+	sr_analog_init(&analog, &encoding, &meaning, &spec, 2);
+
 	/*
 	 * Convert byte sample to voltage according to
 	 * page 269 of the Communication Interface User's Manual.
 	 */
-	float_data = g_array_new(FALSE, FALSE, sizeof(float));
-	for (i = 0; i < samples; i++) {
-		voltage = (float)g_array_index(data, int8_t, i);
-		voltage = (range * voltage /
-				DLM_DIVISION_FOR_BYTE_FORMAT) + offset;
-		g_array_append_val(float_data, voltage);
+	if (devc->analog_raw) {
+		sr_analog_set_raw_encoding(&encoding, 1, TRUE, FALSE,
+			range / DLM_DIVISION_FOR_BYTE_FORMAT, offset);
+		analog.data = (void *)data;
+	} else {
+		if (devc->float_buf_size < samples) {
+			g_free(devc->float_buf);
+			devc->float_buf = g_malloc(samples * sizeof(float));
+			devc->float_buf_size = samples;
+		}
+		scale = range / DLM_DIVISION_FOR_BYTE_FORMAT;
+		for (i = 0; i < samples; i++)
+			devc->float_buf[i] = scale * (int8_t)data[i] + offset;
+		analog.data = devc->float_buf;
 	}
-
-	/* TODO: Use proper 'digits' value for this device (and its modes). */
-	sr_analog_init(&analog, &encoding, &meaning, &spec, 2);
 	analog.meaning->channels = g_slist_append(NULL, ch);
-	analog.num_samples = float_data->len;
-	analog.data = (float*)float_data->data;
+	analog.num_samples = samples;
 	analog.meaning->mq = SR_MQ_VOLTAGE;
 	analog.meaning->unit = SR_UNIT_VOLT;
 	analog.meaning->mqflags = 0;
@@ -956,9 +1030,6 @@ static int dlm_analog_samples_send(GArray *data,
 	sr_session_send(sdi, &packet);
 	g_slist_free(analog.meaning->channels);
 
-	g_array_free(float_data, TRUE);
-	g_array_remove_range(data, 0, samples * sizeof(uint8_t));
-
 	return SR_OK;
 }
 
@@ -966,12 +1037,12 @@ static int dlm_analog_samples_send(GArray *data,
  * Sends logic sample data off to the session bus.
  *
  * @param data The raw sample data.
- * @ch_state Pointer to the state of the channel whose data we're processing.
+ * @param len The number of bytes in @p data.
  * @sdi The device instance.
  *
  * @return SR_ERR when data is trucated, SR_OK otherwise.
  */
-static int dlm_digital_samples_send(GArray *data,
+static int dlm_digital_samples_send(const uint8_t *data, size_t len,
 		struct sr_dev_inst *sdi)
 {
 	struct dev_context *devc;
@@ -984,20 +1055,18 @@ static int dlm_digital_samples_send(GArray *data,
 	model_state = devc->model_state;
 	samples = model_state->samples_per_frame;
 
-	if (data->len < samples * sizeof(uint8_t)) {
+	if (len < samples * sizeof(uint8_t)) {
 		sr_err("Truncated waveform data packet received.");
 		return SR_ERR;
 	}
 
 	logic.length = samples;
 	logic.unitsize = 1;
-	logic.data = data->data;
+	logic.data = (void *)data;
 	packet.type = SR_DF_LOGIC;
 	packet.payload = &logic;
 	sr_session_send(sdi, &packet);
 
-	g_array_remove_range(data, 0, samples * sizeof(uint8_t));
-
 	return SR_OK;
 }
 
@@ -1018,8 +1087,10 @@ SR_PRIV int dlm_data_receive(int fd, int revents, void *cb_data)
 	struct scope_state *model_state;
 	struct dev_context *devc;
 	struct sr_channel *ch;
+	GArray *data;
+	const uint8_t *payload;
+	size_t offset, payload_len, want, old_len;
 	int chunk_len, num_bytes;
-	static GArray *data = NULL;
 
 	(void)fd;
 	(void)revents;
@@ -1037,24 +1108,34 @@ SR_PRIV int dlm_data_receive(int fd, int revents, void *cb_data)
 	if (!devc->data_pending)
 		return TRUE;
 
-	/* Check if a new query response is coming our way. */
-	if (!data) {
-		if (sr_scpi_read_begin(sdi->conn) == SR_OK)
-			/* The 16 here accounts for the header and EOL. */
-			data = g_array_sized_new(FALSE, FALSE, sizeof(uint8_t),
-					16 + model_state->samples_per_frame);
-		else
+	/*
+	 * Check if a new query response is coming our way. The receive
+	 * buffer is kept across responses, the 16 here accounts for the
+	 * header and EOL.
+	 */
+	if (!devc->read_started) {
+		if (sr_scpi_read_begin(sdi->conn) != SR_OK)
 			return TRUE;
+		devc->read_started = TRUE;
+		if (!devc->block)
+			devc->block = g_array_sized_new(FALSE, FALSE,
+				sizeof(uint8_t), 16 + model_state->samples_per_frame);
+		g_array_set_size(devc->block, 0);
 	}
-
-	/* Store incoming data. */
-	chunk_len = sr_scpi_read_data(sdi->conn, devc->receive_buffer,
-			RECEIVE_BUFFER_SIZE);
+	data = devc->block;
+
+	/* Store incoming data, directly in the receive buffer. */
+	want = RECEIVE_BUFFER_SIZE;
+	if (16 + model_state->samples_per_frame > data->len + want)
+		want = 16 + model_state->samples_per_frame - data->len;
+	old_len = data->len;
+	g_array_set_size(data, old_len + want);
+	chunk_len = sr_scpi_read_data(sdi->conn, data->data + old_len, want);
 	if (chunk_len < 0) {
 		sr_err("Error while reading data: %d", chunk_len);
 		goto fail;
 	}
-	g_array_append_vals(data, devc->receive_buffer, chunk_len);
+	g_array_set_size(data, old_len + chunk_len);
 
 	/* Read the entire query response before processing. */
 	if (!sr_scpi_read_complete(sdi->conn))
@@ -1062,12 +1143,9 @@ SR_PRIV int dlm_data_receive(int fd, int revents, void *cb_data)
 
 	/* We finished reading and are no longer waiting for data. */
 	devc->data_pending = FALSE;
+	devc->read_started = FALSE;
 
-	/* Signal the beginning of a new frame if this is the first channel. */
-	if (devc->current_channel == devc->enabled_channels)
-		std_session_send_df_frame_begin(sdi);
-
-	if (dlm_block_data_header_process(data, &num_bytes) != SR_OK) {
+	if (dlm_block_data_header_process(data, &offset, &num_bytes) != SR_OK) {
 		sr_err("Encountered malformed block data header.");
 		goto fail;
 	}
@@ -1078,21 +1156,26 @@ SR_PRIV int dlm_data_receive(int fd, int revents, void *cb_data)
 				"acquisition and retrying.");
 		/* Don't care about return value here. */
 		dlm_acquisition_stop(sdi->conn);
-		g_array_free(data, TRUE);
 		dlm_channel_data_request(sdi);
 		return TRUE;
 	}
 
+	/* Signal the beginning of a new frame if this is the first channel. */
+	if (devc->current_channel == devc->enabled_channels)
+		std_session_send_df_frame_begin(sdi);
+
+	payload = (const uint8_t *)data->data + offset;
+	payload_len = data->len - offset;
 	ch = devc->current_channel->data;
 	switch (ch->type) {
 	case SR_CHANNEL_ANALOG:
-		if (dlm_analog_samples_send(data,
+		if (dlm_analog_samples_send(payload, payload_len,
 				&model_state->analog_states[ch->index],
 				sdi) != SR_OK)
 			goto fail;
 		break;
 	case SR_CHANNEL_LOGIC:
-		if (dlm_digital_samples_send(data, sdi) != SR_OK)
+		if (dlm_digital_samples_send(payload, payload_len, sdi) != SR_OK)
 			goto fail;
 		break;
 	default:
@@ -1100,23 +1183,22 @@ SR_PRIV int dlm_data_receive(int fd, int revents, void *cb_data)
 		break;
 	}
 
-	g_array_free(data, TRUE);
-	data = NULL;
-
 	/*
 	 * Signal the end of this frame if this was the last enabled channel
-	 * and set the next enabled channel. Then, request its data.
+	 * and set the next enabled channel. Then, request its data. Stop
+	 * after the most recent history record was transferred.
 	 */
 	if (!devc->current_channel->next) {
 		std_session_send_df_frame_end(sdi);
 		devc->current_channel = devc->enabled_channels;
+		devc->num_frames++;
 
-		/*
-		 * As of now we only support importing the current acquisition
-		 * data so we're going to stop at this point.
-		 */
-		sr_dev_acquisition_stop(sdi);
-		return TRUE;
+		if (devc->cur_record >= 0 || (devc->frame_limit &&
+				devc->num_frames >= devc->frame_limit)) {
+			sr_dev_acquisition_stop(sdi);
+			return TRUE;
+		}
+		devc->cur_record++;
 	} else
 		devc->current_channel = devc->current_channel->next;
 
@@ -1128,10 +1210,8 @@ SR_PRIV int dlm_data_receive(int fd, int revents, void *cb_data)
 	return TRUE;
 
 fail:
-	if (data) {
-		g_array_free(data, TRUE);
-		data = NULL;
-	}
+	devc->read_started = FALSE;
+	g_array_set_size(data, 0);
 
 	return FALSE;
 }
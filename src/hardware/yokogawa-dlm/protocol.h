@@ -108,9 +108,17 @@ struct dev_context {
 	uint64_t num_frames;
 
 	uint64_t frame_limit;
+	/* Send the scope's bytes with scale and offset, not floats. */
+	gboolean analog_raw;
 
-	char receive_buffer[RECEIVE_BUFFER_SIZE];
+	/* History records to transfer, the newest one is record 0. */
+	int cur_record;
 	gboolean data_pending;
+	gboolean read_started;
+	/* Receive and conversion buffers, kept across blocks. */
+	GArray *block;
+	float *float_buf;
+	size_t float_buf_size;
 };
 
 SR_PRIV int dlm_channel_state_set(const struct sr_dev_inst *sdi,
@@ -123,5 +131,7 @@ SR_PRIV void dlm_scope_state_destroy(struct scope_state *state);
 SR_PRIV int dlm_scope_state_query(struct sr_dev_inst *sdi);
 SR_PRIV int dlm_sample_rate_query(const struct sr_dev_inst *sdi);
 SR_PRIV int dlm_channel_data_request(const struct sr_dev_inst *sdi);
+SR_PRIV int dlm_frames_prepare(const struct sr_dev_inst *sdi);
+SR_PRIV void dlm_buffers_free(struct dev_context *devc);
 
 #endif
@@ -326,34 +326,30 @@ int dlm_data_get(struct sr_scpi_dev_inst *scpi, int acquisition_num)
 	return sr_scpi_send(scpi, cmd);
 }
 
-int dlm_analog_data_get(struct sr_scpi_dev_inst *scpi, int channel)
+/*
+ * Select the history record and the waveform range to transfer. Sent
+ * once per frame, as a single program message, rather than ahead of
+ * every channel's data query.
+ */
+int dlm_waveform_setup(struct sr_scpi_dev_inst *scpi, int record)
 {
-	gchar cmd[MAX_COMMAND_SIZE];
-	int result;
-
-	result = sr_scpi_send(scpi, ":WAVEFORM:FORMAT BYTE");
-	if (result == SR_OK) result = sr_scpi_send(scpi, ":WAVEFORM:RECORD 0");
-	if (result == SR_OK) result = sr_scpi_send(scpi, ":WAVEFORM:START 0");
-	if (result == SR_OK) result = sr_scpi_send(scpi, ":WAVEFORM:END 124999999");
-
-	g_snprintf(cmd, sizeof(cmd), ":WAVEFORM:TRACE %d", channel);
-	if (result == SR_OK) result = sr_scpi_send(scpi, cmd);
+	return sr_scpi_send(scpi, ":WAVEFORM:FORMAT BYTE;"
+		":WAVEFORM:RECORD %d;:WAVEFORM:START 0;"
+		":WAVEFORM:END 124999999", record);
+}
 
-	if (result == SR_OK) result = sr_scpi_send(scpi, ":WAVEFORM:SEND? 1");
+int dlm_record_min_get(struct sr_scpi_dev_inst *scpi, int *response)
+{
+	return sr_scpi_get_int(scpi, ":WAVEFORM:RECORD? MINIMUM", response);
+}
 
-	return result;
+int dlm_analog_data_get(struct sr_scpi_dev_inst *scpi, int channel)
+{
+	return sr_scpi_send(scpi, ":WAVEFORM:TRACE %d;:WAVEFORM:SEND? 1",
+		channel);
 }
 
 int dlm_digital_data_get(struct sr_scpi_dev_inst *scpi)
 {
-	int result;
-
-	result = sr_scpi_send(scpi, ":WAVEFORM:FORMAT BYTE");
-	if (result == SR_OK) result = sr_scpi_send(scpi, ":WAVEFORM:RECORD 0");
-	if (result == SR_OK) result = sr_scpi_send(scpi, ":WAVEFORM:START 0");
-	if (result == SR_OK) result = sr_scpi_send(scpi, ":WAVEFORM:END 124999999");
-	if (result == SR_OK) result = sr_scpi_send(scpi, ":WAVEFORM:TRACE LOGIC");
-	if (result == SR_OK) result = sr_scpi_send(scpi, ":WAVEFORM:SEND? 1");
-
-	return result;
+	return sr_scpi_send(scpi, ":WAVEFORM:TRACE LOGIC;:WAVEFORM:SEND? 1");
 }
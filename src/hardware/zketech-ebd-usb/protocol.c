@@ -260,8 +260,7 @@ SR_PRIV int ebd_receive_data(int fd, int revents, void *cb_data)
 	/* End frame. */
 	std_session_send_df_frame_end(sdi);
 
-	sr_sw_limits_update_samples_read(&devc->limits, 1);
-	if (sr_sw_limits_check(&devc->limits))
+	if (sr_sw_limits_update_and_check(&devc->limits, 1))
 		sr_dev_acquisition_stop(sdi);
 
 	return TRUE;
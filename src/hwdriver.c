@@ -74,6 +74,8 @@ static struct sr_key_info sr_key_info_config[] = {
 		"Modbus slave address", NULL},
 	{SR_CONF_FORCE_DETECT, SR_T_STRING, "force_detect",
 		"Forced detection", NULL},
+	{SR_CONF_FORCE_UPLOAD, SR_T_BOOL, "force_upload",
+		"Force firmware upload", NULL},
 
 	/* Device (or channel group) configuration */
 	{SR_CONF_SAMPLERATE, SR_T_UINT64, "samplerate",
@@ -212,6 +214,18 @@ static struct sr_key_info sr_key_info_config[] = {
 		"Power Target", NULL},
 	{SR_CONF_RESISTANCE_TARGET, SR_T_FLOAT, "resistance_target",
 		"Resistance Target", NULL},
+	{SR_CONF_UNTHROTTLED, SR_T_BOOL, "unthrottled",
+		"Unthrottled", NULL},
+	{SR_CONF_EDGE_DENSITY, SR_T_FLOAT, "edge_density",
+		"Edge density", NULL},
+	{SR_CONF_BURST_INTERVAL, SR_T_UINT64, "burst_interval",
+		"Burst interval", NULL},
+	{SR_CONF_BURST_JITTER, SR_T_UINT64, "burst_jitter",
+		"Burst jitter", NULL},
+	{SR_CONF_ANALOG_ENCODING, SR_T_STRING, "analog_encoding",
+		"Analog encoding", NULL},
+	{SR_CONF_NUM_SEGMENTS, SR_T_UINT64, "segments",
+		"Number of segments", NULL},
 
 	/* Special stuff */
 	{SR_CONF_SESSIONFILE, SR_T_STRING, "sessionfile",
@@ -228,6 +242,18 @@ static struct sr_key_info sr_key_info_config[] = {
 		"Probe factor", NULL},
 	{SR_CONF_ADC_POWERLINE_CYCLES, SR_T_FLOAT, "nplc",
 		"Number of ADC powerline cycles", NULL},
+	{SR_CONF_TRANSFER_SIZE, SR_T_UINT64, "transfer_size",
+		"Transfer size", NULL},
+	{SR_CONF_TRANSFER_COUNT, SR_T_UINT64, "transfer_count",
+		"Transfer count", NULL},
+	{SR_CONF_TRANSFER_ADAPTIVE, SR_T_BOOL, "transfer_adaptive",
+		"Adaptive transfer count", NULL},
+	{SR_CONF_TRANSFER_THREAD, SR_T_BOOL, "transfer_thread",
+		"Transfer thread", NULL},
+	{SR_CONF_ANALOG_RAW, SR_T_BOOL, "analog_raw",
+		"Raw analog samples", NULL},
+	{SR_CONF_LOGIC_EDGES, SR_T_BOOL, "logic_edges",
+		"Logic edges", NULL},
 
 	/* Acquisition modes, sample limiting */
 	{SR_CONF_LIMIT_MSEC, SR_T_UINT64, "limit_time",
@@ -570,6 +596,234 @@ SR_API GSList *sr_driver_scan(struct sr_dev_driver *driver, GSList *options)
 	return l;
 }
 
+/* Number of drivers sr_driver_scan_all() scans at the same time. */
+#define SCAN_ALL_THREADS 8
+
+struct scan_job {
+	struct sr_dev_driver *driver;
+	GSList *options;
+	GAsyncQueue *results;
+	/* Scans after this one, on the same thread. */
+	struct scan_job *next;
+	/* Set once the caller stops waiting for scans. */
+	gint *cancelled;
+};
+
+struct scan_result {
+	struct sr_dev_driver *driver;
+	GSList *devices;
+};
+
+static void scan_result_free(gpointer data)
+{
+	struct scan_result *result;
+
+	result = data;
+	g_slist_free(result->devices);
+	g_free(result);
+}
+
+static void scan_job_free(gpointer data)
+{
+	struct scan_job *job;
+
+	job = data;
+	g_slist_free_full(job->options, (GDestroyNotify)sr_config_free);
+	g_free(job);
+}
+
+/* The subset of options which the driver accepts for a scan. */
+static GSList *scan_options_for(struct sr_dev_driver *driver, GSList *options)
+{
+	struct sr_config *src;
+	GArray *opts;
+	GSList *l, *result;
+	guint i;
+
+	if (!(opts = sr_driver_scan_options_list(driver)))
+		return NULL;
+	result = NULL;
+	for (l = options; l; l = l->next) {
+		src = l->data;
+		for (i = 0; i < opts->len; i++) {
+			if (g_array_index(opts, uint32_t, i) != src->key)
+				continue;
+			result = g_slist_append(result,
+				sr_config_new(src->key, src->data));
+			break;
+		}
+	}
+	g_array_free(opts, TRUE);
+
+	return result;
+}
+
+static gboolean scan_options_have_conn(GSList *options)
+{
+	GSList *l;
+
+	for (l = options; l; l = l->next) {
+		if (((struct sr_config *)l->data)->key == SR_CONF_CONN)
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+static void scan_job_run(gpointer data, gpointer user_data)
+{
+	struct scan_job *job;
+	struct scan_result *result;
+
+	(void)user_data;
+
+	for (job = data; job; job = job->next) {
+		if (g_atomic_int_get(job->cancelled))
+			break;
+		result = g_malloc0(sizeof(*result));
+		result->driver = job->driver;
+		result->devices = sr_driver_scan(job->driver, job->options);
+		g_async_queue_push(job->results, result);
+	}
+}
+
+static void scan_report(struct scan_result *result, GSList **devices,
+		sr_driver_scan_callback cb, void *cb_data)
+{
+	if (cb)
+		cb(result->driver, result->devices, cb_data);
+	*devices = g_slist_concat(*devices, result->devices);
+	result->devices = NULL;
+	scan_result_free(result);
+}
+
+/**
+ * Tell several hardware drivers to scan for devices, concurrently.
+ *
+ * Each driver scans on a thread of its own, so the timeouts of drivers
+ * which probe serial ports or the network add up no longer. The drivers
+ * get the options they list in their SR_CONF_SCAN_OPTIONS, options
+ * which a driver does not support are left out for that driver. Drivers
+ * which get the SR_CONF_CONN option scan one after the other, so they
+ * don't probe the same port at the same time.
+ *
+ * Once the deadline passed, drivers which did not start their scan yet
+ * are skipped. The function still waits for the scans which are under
+ * way, no scan continues after it returned.
+ *
+ * @param drivers NULL terminated array of initialized drivers to scan,
+ *                e.g. from sr_driver_list(). Must not be NULL.
+ * @param options A list of 'struct sr_config' options to pass to the
+ *                drivers' scanners. Can be NULL/empty.
+ * @param timeout_ms Time after which no further drivers start their
+ *                   scan in milliseconds, or 0 to scan all of them.
+ * @param cb Function to call with each driver's devices when its scan
+ *           finished, from the calling thread. Can be NULL. The list
+ *           belongs to libsigrok, it is only valid during the call.
+ * @param cb_data Opaque pointer passed to cb.
+ *
+ * @return A GSList * of 'struct sr_dev_inst' of all drivers which
+ *         scanned, or NULL if no devices were found. This list must be
+ *         freed by the caller using g_slist_free(), but without freeing
+ *         the data pointed to in the list.
+ *
+ * @since 0.6.0
+ */
+SR_API GSList *sr_driver_scan_all(struct sr_dev_driver **drivers,
+		GSList *options, unsigned int timeout_ms,
+		sr_driver_scan_callback cb, void *cb_data)
+{
+	GThreadPool *pool;
+	GAsyncQueue *results;
+	GError *error;
+	struct scan_job *job, *conn_job, *conn_last;
+	struct scan_result *result;
+	GSList *jobs, *l, *devices;
+	gint64 deadline, remaining;
+	gint cancelled;
+	int i, pending;
+
+	if (!drivers) {
+		sr_err("Invalid driver list, can't scan for devices.");
+		return NULL;
+	}
+
+	error = NULL;
+	pool = g_thread_pool_new(scan_job_run, NULL, SCAN_ALL_THREADS,
+		FALSE, &error);
+	if (!pool) {
+		sr_err("Failed to create scan threads: %s.", error->message);
+		g_error_free(error);
+		return NULL;
+	}
+	results = g_async_queue_new_full(scan_result_free);
+
+	cancelled = FALSE;
+	jobs = NULL;
+	conn_job = conn_last = NULL;
+	pending = 0;
+	for (i = 0; drivers[i]; i++) {
+		if (!drivers[i]->context) {
+			sr_err("Driver %s not initialized, can't scan for devices.",
+				drivers[i]->name);
+			continue;
+		}
+		job = g_malloc0(sizeof(*job));
+		job->driver = drivers[i];
+		job->options = scan_options_for(drivers[i], options);
+		job->results = results;
+		job->cancelled = &cancelled;
+		jobs = g_slist_prepend(jobs, job);
+		pending++;
+		if (!scan_options_have_conn(job->options)) {
+			g_thread_pool_push(pool, job, NULL);
+			continue;
+		}
+		/* All of these got the same port, chain them up. */
+		if (conn_last)
+			conn_last->next = job;
+		else
+			conn_job = job;
+		conn_last = job;
+	}
+	if (conn_job)
+		g_thread_pool_push(pool, conn_job, NULL);
+
+	devices = NULL;
+	deadline = g_get_monotonic_time() + (gint64)timeout_ms * 1000;
+	for (; pending > 0; pending--) {
+		if (timeout_ms) {
+			remaining = deadline - g_get_monotonic_time();
+			if (remaining <= 0)
+				break;
+			result = g_async_queue_timeout_pop(results, remaining);
+			if (!result)
+				break;
+		} else {
+			result = g_async_queue_pop(results);
+		}
+		scan_report(result, &devices, cb, cb_data);
+	}
+
+	/* Skip the scans which didn't start yet, wait for the others. */
+	g_atomic_int_set(&cancelled, TRUE);
+	g_thread_pool_free(pool, TRUE, TRUE);
+	for (; pending > 0; pending--) {
+		if (!(result = g_async_queue_try_pop(results)))
+			break;
+		scan_report(result, &devices, cb, cb_data);
+	}
+	if (pending > 0)
+		sr_dbg("%d driver(s) skipped their scan, out of time.", pending);
+
+	for (l = jobs; l; l = l->next)
+		scan_job_free(l->data);
+	g_slist_free(jobs);
+	g_async_queue_unref(results);
+
+	return devices;
+}
+
 /**
  * Call driver cleanup function for all drivers.
  *
@@ -830,6 +1084,95 @@ SR_API int sr_config_get(const struct sr_dev_driver *driver,
 	return ret;
 }
 
+/**
+ * Query the values of several configuration keys at once.
+ *
+ * Drivers which implement config_get_many() can answer several keys
+ * with a single instrument query, the remaining keys are queried one
+ * by one like with sr_config_get().
+ *
+ * @param[in] driver The sr_dev_driver struct to query. Must not be NULL.
+ * @param[in] sdi (optional) The device instance, like for sr_config_get().
+ * @param[in] cg The channel group on the device, or NULL.
+ * @param[in,out] configs Array of the keys to query. On return, the data
+ *                field of each entry holds the value, which the caller
+ *                must unref, or NULL if the key could not be queried.
+ * @param[in] count Number of entries in configs.
+ *
+ * @retval SR_OK Success, values of keys which are not applicable are NULL.
+ * @retval SR_ERR Error.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_config_get_many(const struct sr_dev_driver *driver,
+		const struct sr_dev_inst *sdi,
+		const struct sr_channel_group *cg,
+		struct sr_config *configs, unsigned int count)
+{
+	struct sr_config *wanted;
+	unsigned int i, j, num_wanted;
+	int ret;
+
+	if (!driver || (count && !configs))
+		return SR_ERR;
+
+	if (sdi && !sdi->priv) {
+		sr_err("Can't get config (sdi != NULL, sdi->priv == NULL).");
+		return SR_ERR;
+	}
+
+	for (i = 0; i < count; i++)
+		configs[i].data = NULL;
+	if (!driver->config_get)
+		return SR_OK;
+
+	/* Drivers only get to see keys which they publish. */
+	wanted = g_malloc0(count * sizeof(*wanted));
+	num_wanted = 0;
+	for (i = 0; i < count; i++) {
+		if (check_key(driver, sdi, cg, configs[i].key, SR_CONF_GET, NULL) != SR_OK)
+			continue;
+		wanted[num_wanted++].key = configs[i].key;
+	}
+
+	if (num_wanted > 1 && driver->config_get_many) {
+		ret = driver->config_get_many(wanted, num_wanted, sdi, cg);
+		if (ret != SR_OK) {
+			/* Query the keys separately instead. */
+			for (i = 0; i < num_wanted; i++) {
+				if (wanted[i].data)
+					g_variant_unref(g_variant_ref_sink(wanted[i].data));
+				wanted[i].data = NULL;
+			}
+		}
+	}
+
+	for (i = 0; i < num_wanted; i++) {
+		if (!wanted[i].data) {
+			ret = driver->config_get(wanted[i].key, &wanted[i].data, sdi, cg);
+			if (ret != SR_OK) {
+				wanted[i].data = NULL;
+				if (ret == SR_ERR_CHANNEL_GROUP)
+					sr_err("%s: No channel group specified.",
+						driver->name);
+				continue;
+			}
+		}
+		log_key(sdi, cg, wanted[i].key, SR_CONF_GET, wanted[i].data);
+		g_variant_ref_sink(wanted[i].data);
+	}
+
+	/* Hand out the values in the order of the caller's keys. */
+	for (i = 0, j = 0; i < count && j < num_wanted; i++) {
+		if (configs[i].key != wanted[j].key)
+			continue;
+		configs[i].data = wanted[j++].data;
+	}
+	g_free(wanted);
+
+	return SR_OK;
+}
+
 /**
  * Set value of a configuration key in a device instance.
  *
@@ -848,6 +1191,9 @@ SR_API int sr_config_get(const struct sr_dev_driver *driver,
  *         interpreted as an error by the caller; merely as an indication
  *         that it's not applicable.
  *
+ * While the device's session is running, a successful change of a key
+ * of the device gets sent to the session bus as SR_DF_META packet.
+ *
  * @since 0.3.0
  */
 SR_API int sr_config_set(const struct sr_dev_inst *sdi,
@@ -871,6 +1217,9 @@ SR_API int sr_config_set(const struct sr_dev_inst *sdi,
 	else if ((ret = sr_variant_type_check(key, data)) == SR_OK) {
 		log_key(sdi, cg, key, SR_CONF_SET, data);
 		ret = sdi->driver->config_set(key, data, sdi, cg);
+		/* Let frontends of a running session see the change. */
+		if (ret == SR_OK && !cg && sdi->session && sdi->session->running)
+			sr_session_send_meta(sdi, key, data);
 	}
 
 	g_variant_unref(data);
@@ -984,7 +1333,9 @@ SR_API int sr_config_list(const struct sr_dev_driver *driver,
 
 	if ((ret = driver->config_list(key, data, sdi, cg)) == SR_OK) {
 		log_key(sdi, cg, key, SR_CONF_LIST, *data);
-		g_variant_ref_sink(*data);
+		/* Cached lists from the std_gvar_*() helpers aren't floating. */
+		if (g_variant_is_floating(*data))
+			g_variant_ref_sink(*data);
 	}
 
 	if (ret == SR_ERR_CHANNEL_GROUP)
@@ -994,26 +1345,57 @@ SR_API int sr_config_list(const struct sr_dev_driver *driver,
 	return ret;
 }
 
-static struct sr_key_info *get_keytable(int keytype)
-{
+/* Hash indexes of a key table, built on first use. */
+struct keytable_index {
 	struct sr_key_info *table;
+	GHashTable *by_key;
+	GHashTable *by_id;
+};
+
+static struct keytable_index keytable_indexes[] = {
+	[SR_KEY_CONFIG] = { .table = sr_key_info_config, },
+	[SR_KEY_MQ] = { .table = sr_key_info_mq, },
+	[SR_KEY_MQFLAGS] = { .table = sr_key_info_mqflag, },
+};
+
+static gpointer build_keytable_index(gpointer data)
+{
+	struct keytable_index *index;
+	struct sr_key_info *info;
+
+	index = data;
+	index->by_key = g_hash_table_new(g_direct_hash, g_direct_equal);
+	index->by_id = g_hash_table_new(g_str_hash, g_str_equal);
+	/* Like a search of the table, the first entry of a key wins. */
+	for (info = index->table; info->key; info++) {
+		if (!g_hash_table_contains(index->by_key, GUINT_TO_POINTER(info->key)))
+			g_hash_table_insert(index->by_key,
+				GUINT_TO_POINTER(info->key), info);
+		if (info->id && !g_hash_table_contains(index->by_id, info->id))
+			g_hash_table_insert(index->by_id, (char *)info->id, info);
+	}
+
+	return index;
+}
+
+static struct keytable_index *get_keytable(int keytype)
+{
+	static GOnce once[G_N_ELEMENTS(keytable_indexes)] = {
+		G_ONCE_INIT, G_ONCE_INIT, G_ONCE_INIT,
+	};
 
 	switch (keytype) {
 	case SR_KEY_CONFIG:
-		table = sr_key_info_config;
-		break;
 	case SR_KEY_MQ:
-		table = sr_key_info_mq;
-		break;
 	case SR_KEY_MQFLAGS:
-		table = sr_key_info_mqflag;
 		break;
 	default:
 		sr_err("Invalid keytype %d", keytype);
 		return NULL;
 	}
 
-	return table;
+	return g_once(&once[keytype], build_keytable_index,
+		&keytable_indexes[keytype]);
 }
 
 /**
@@ -1029,18 +1411,12 @@ static struct sr_key_info *get_keytable(int keytype)
  */
 SR_API const struct sr_key_info *sr_key_info_get(int keytype, uint32_t key)
 {
-	struct sr_key_info *table;
-	int i;
+	struct keytable_index *index;
 
-	if (!(table = get_keytable(keytype)))
+	if (!(index = get_keytable(keytype)))
 		return NULL;
 
-	for (i = 0; table[i].key; i++) {
-		if (table[i].key == key)
-			return &table[i];
-	}
-
-	return NULL;
+	return g_hash_table_lookup(index->by_key, GUINT_TO_POINTER(key));
 }
 
 /**
@@ -1056,20 +1432,12 @@ SR_API const struct sr_key_info *sr_key_info_get(int keytype, uint32_t key)
  */
 SR_API const struct sr_key_info *sr_key_info_name_get(int keytype, const char *keyid)
 {
-	struct sr_key_info *table;
-	int i;
+	struct keytable_index *index;
 
-	if (!(table = get_keytable(keytype)))
+	if (!(index = get_keytable(keytype)))
 		return NULL;
 
-	for (i = 0; table[i].key; i++) {
-		if (!table[i].id)
-			continue;
-		if (!strcmp(table[i].id, keyid))
-			return &table[i];
-	}
-
-	return NULL;
+	return g_hash_table_lookup(index->by_id, keyid);
 }
 
 /** @} */
@@ -66,7 +66,8 @@ static int init(struct sr_input *in, GHashTable *options)
 	return SR_OK;
 }
 
-static int process_buffer(struct sr_input *in)
+/* Send the samples of a buffer, returns the number of bytes consumed. */
+static gsize send_samples(struct sr_input *in, const uint8_t *data, gsize len)
 {
 	struct sr_datafeed_packet packet;
 	struct sr_datafeed_logic logic;
@@ -91,16 +92,26 @@ static int process_buffer(struct sr_input *in)
 	logic.unitsize = inc->unitsize;
 
 	/* Cut off at multiple of unitsize. */
-	chunk_size = in->buf->len / logic.unitsize * logic.unitsize;
+	chunk_size = len / logic.unitsize * logic.unitsize;
 
 	for (i = 0; i < chunk_size; i += chunk) {
-		logic.data = in->buf->str + i;
+		logic.data = (uint8_t *)data + i;
 		chunk = MIN(CHUNK_SIZE, chunk_size - i);
 		chunk /= logic.unitsize;
 		chunk *= logic.unitsize;
 		logic.length = chunk;
 		sr_session_send(in->sdi, &packet);
 	}
+
+	return chunk_size;
+}
+
+static int process_buffer(struct sr_input *in)
+{
+	gsize chunk_size;
+
+	chunk_size = send_samples(in, (const uint8_t *)in->buf->str,
+		in->buf->len);
 	g_string_erase(in->buf, 0, chunk_size);
 
 	return SR_OK;
@@ -123,6 +134,77 @@ static int receive(struct sr_input *in, GString *buf)
 	return ret;
 }
 
+static int receive_data(struct sr_input *in, const void *data, size_t len)
+{
+	const char *bytes;
+	size_t unitsize, fill, done;
+
+	if (!in->sdi_ready) {
+		g_string_append_len(in->buf, data, len);
+		/* sdi is ready, notify frontend. */
+		in->sdi_ready = TRUE;
+		return SR_OK;
+	}
+
+	/* Complete a partial sample from earlier data first. */
+	bytes = data;
+	unitsize = ((struct context *)in->priv)->unitsize;
+	if (in->buf->len) {
+		fill = MIN(len, (unitsize - in->buf->len % unitsize) % unitsize);
+		g_string_append_len(in->buf, bytes, fill);
+		process_buffer(in);
+		bytes += fill;
+		len -= fill;
+	}
+
+	/* Send everything else from the caller's memory. */
+	done = send_samples(in, (const uint8_t *)bytes, len);
+	g_string_append_len(in->buf, bytes + done, len - done);
+
+	return SR_OK;
+}
+
+static int receive_file(struct sr_input *in, const char *filename)
+{
+	GMappedFile *file;
+	GError *error;
+	const uint8_t *data;
+	gsize len, done;
+
+	if (!in->sdi_ready) {
+		/* The channels are known from the options already. */
+		in->sdi_ready = TRUE;
+		return SR_OK;
+	}
+
+	/* Samples queued by receive() come first. */
+	if (in->buf->len % ((struct context *)in->priv)->unitsize) {
+		sr_err("Cannot append a file to a partial sample.");
+		return SR_ERR_ARG;
+	}
+	process_buffer(in);
+
+	error = NULL;
+	file = g_mapped_file_new(filename, FALSE, &error);
+	if (!file) {
+		sr_err("Failed to map %s: %s", filename, error->message);
+		g_error_free(error);
+		return SR_ERR;
+	}
+	data = (const uint8_t *)g_mapped_file_get_contents(file);
+	len = g_mapped_file_get_length(file);
+
+	/*
+	 * Packets point straight into the mapping. Consumers which
+	 * retain them get a copy, the mapping ends with this call.
+	 */
+	done = data ? send_samples(in, data, len) : 0;
+	g_string_append_len(in->buf, (const char *)data + done, len - done);
+	g_mapped_file_unref(file);
+
+	return SR_OK;
+}
+
 static int end(struct sr_input *in)
 {
 	struct context *inc;
@@ -174,6 +256,8 @@ SR_PRIV struct sr_input_module input_binary = {
 	.options = get_options,
 	.init = init,
 	.receive = receive,
+	.receive_data = receive_data,
+	.receive_file = receive_file,
 	.end = end,
 	.reset = reset,
 };
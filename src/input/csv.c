@@ -34,6 +34,9 @@
 
 #define CHUNK_SIZE	(4 * 1024 * 1024)
 
+/* Minimum number of text lines per parser thread. */
+#define THREAD_MIN_LINES	4096
+
 /*
  * The CSV input module has the following options:
  *
@@ -91,6 +94,10 @@
  *     up to the end of the current text line. Can be empty to disable
  *     comment support. Defaults to semicolon.
  *
+ * threads: Specifies the number of threads which parse text lines. Zero
+ *     (the default) uses one thread per processor. Input with timestamp
+ *     columns gets parsed sequentially until the samplerate is known.
+ *
  * Typical examples of using these options:
  * - ... -I csv:column_formats=*l ...
  *   All columns are single-bit logic data. Identical to the previous
@@ -253,6 +260,15 @@ struct context {
 	/* Current line number. */
 	size_t line_number;
 
+	/* Columns of the current line, pointing into the input buffer. */
+	char **columns;
+	size_t columns_size;
+
+	/* Text lines of the current input buffer, and parser threads. */
+	char **lines;
+	size_t lines_size;
+	size_t threads;
+
 	/* List of previously created sigrok channels. */
 	GSList *prev_sr_channels;
 	GSList **prev_df_channels;
@@ -774,6 +790,49 @@ static char **split_line(char *buf, struct context *inc)
 	return fields;
 }
 
+/**
+ * Splits a text line into columns in place.
+ *
+ * @param[in] buf	The input text line to split, gets modified.
+ * @param[in] inc	The input module's context.
+ *
+ * @returns The number of columns, see inc->columns for their text.
+ *
+ * This is the allocation free variant of split_line() for the sample
+ * data's hot path. Separators get replaced by NUL characters, and the
+ * columns array gets re-used across lines.
+ */
+static size_t split_columns(char *buf, struct context *inc)
+{
+	const char *delim;
+	size_t delim_len, count, i;
+	char *next;
+
+	delim = inc->delimiter->str;
+	delim_len = inc->delimiter->len;
+	count = 0;
+	for (;;) {
+		if (count == inc->columns_size) {
+			inc->columns_size = MAX(16, 2 * inc->columns_size);
+			inc->columns = g_realloc(inc->columns,
+				inc->columns_size * sizeof(inc->columns[0]));
+		}
+		inc->columns[count++] = buf;
+		if (delim_len == 1)
+			next = strchr(buf, delim[0]);
+		else
+			next = strstr(buf, delim);
+		if (!next)
+			break;
+		*next = '\0';
+		buf = next + delim_len;
+	}
+	for (i = 0; i < count; i++)
+		g_strchomp(inc->columns[i]);
+
+	return count;
+}
+
 /**
  * Parse a multi-bit field into several logic channels.
  *
@@ -1216,6 +1275,7 @@ static int init(struct sr_input *in, GHashTable *options)
 	first_column = g_variant_get_uint32(g_hash_table_lookup(options, "first_column"));
 	inc->use_header = g_variant_get_boolean(g_hash_table_lookup(options, "header"));
 	inc->start_line = g_variant_get_uint32(g_hash_table_lookup(options, "start_line"));
+	inc->threads = g_variant_get_uint32(g_hash_table_lookup(options, "threads"));
 	if (inc->start_line < 1) {
 		sr_err("Invalid start line %zu.", inc->start_line);
 		return SR_ERR_ARG;
@@ -1529,16 +1589,298 @@ static int initial_receive(const struct sr_input *in)
 	return ret;
 }
 
-static int process_buffer(struct sr_input *in, gboolean is_eof)
+/**
+ * Parse a text line into the current sample set.
+ *
+ * @param[in] inc	The input module's context.
+ * @param[in] line	The text line, gets modified.
+ *
+ * @retval SR_OK	The current sample set holds the line's values.
+ * @retval SR_ERR_NA	The line contains no sample data, skip it.
+ * @retval SR_ERR	Invalid input data.
+ *
+ * This routine only touches the context's sample set and line parse
+ * state, and does not communicate to the session. Which allows to run
+ * it on a private copy of the context in parser threads.
+ */
+static int parse_line(struct context *inc, char *line)
 {
-	struct context *inc;
-	gsize num_columns;
-	size_t line_idx, col_idx, col_nr;
+	size_t num_columns, col_idx, col_nr;
 	const struct column_details *details;
 	col_parse_cb parse_func;
+	char *column;
+	int ret;
+
+	if (line[0] == '\0') {
+		sr_spew("Blank line %zu skipped.", inc->line_number);
+		return SR_ERR_NA;
+	}
+
+	/* Remove trailing comment. */
+	strip_comment(line, inc->comment);
+	if (line[0] == '\0') {
+		sr_spew("Comment-only line %zu skipped.", inc->line_number);
+		return SR_ERR_NA;
+	}
+
+	/* Skip the header line, its content was used as the channel names. */
+	if (inc->use_header && !inc->header_seen) {
+		sr_spew("Header line %zu skipped.", inc->line_number);
+		inc->header_seen = TRUE;
+		return SR_ERR_NA;
+	}
+
+	/* Split the line into columns, check for minimum length. */
+	num_columns = split_columns(line, inc);
+	if (num_columns < inc->column_want_count) {
+		sr_err("Insufficient column count %zu in line %zu.",
+			num_columns, inc->line_number);
+		return SR_ERR;
+	}
+
+	/* Have the columns of the current text line processed. */
+	clear_logic_samples(inc);
+	clear_analog_samples(inc);
+	for (col_idx = 0; col_idx < inc->column_want_count; col_idx++) {
+		column = inc->columns[col_idx];
+		col_nr = col_idx + 1;
+		details = lookup_column_details(inc, col_nr);
+		if (!details || !details->text_format)
+			continue;
+		parse_func = col_parse_funcs[details->text_format];
+		if (!parse_func)
+			continue;
+		ret = parse_func(column, inc, details);
+		if (ret != SR_OK)
+			return SR_ERR;
+	}
+
+	return SR_OK;
+}
+
+static int process_line(const struct sr_input *in, char *line)
+{
+	struct context *inc;
+	int ret;
+
+	inc = in->priv;
+	inc->line_number++;
+	if (inc->line_number < inc->start_line) {
+		sr_spew("Line %zu skipped (before start).", inc->line_number);
+		return SR_OK;
+	}
+	ret = parse_line(inc, line);
+	if (ret == SR_ERR_NA)
+		return SR_OK;
+	if (ret != SR_OK)
+		return ret;
+
+	/* Send sample data to the session bus (buffered). */
+	ret = queue_logic_samples(in);
+	ret += queue_analog_samples(in);
+	if (ret != SR_OK) {
+		sr_err("Sending samples failed.");
+		return SR_ERR;
+	}
+
+	return SR_OK;
+}
+
+/*
+ * A range of text lines which a parser thread converts to sample data.
+ * The thread works on a private copy of the context, its datafeed
+ * buffers hold the range's samples (analog data in "striped" layout,
+ * the range's line count is the stride).
+ */
+struct parse_chunk {
+	struct context ctx;
+	char **lines;
+	size_t line_count;
+	size_t sample_count;
+	int ret;
+	GThread *thread;
+};
+
+static gpointer parse_chunk_thread(gpointer data)
+{
+	struct parse_chunk *chunk;
+	struct context *inc;
+	size_t idx;
+	int ret;
+
+	chunk = data;
+	inc = &chunk->ctx;
+	for (idx = 0; idx < chunk->line_count; idx++) {
+		inc->line_number++;
+		ret = parse_line(inc, chunk->lines[idx]);
+		if (ret == SR_ERR_NA)
+			continue;
+		if (ret != SR_OK) {
+			chunk->ret = ret;
+			break;
+		}
+		inc->datafeed_buf_fill += inc->sample_unit_size;
+		inc->analog_datafeed_buf_fill++;
+		chunk->sample_count++;
+	}
+
+	return NULL;
+}
+
+static int queue_chunk_samples(const struct sr_input *in,
+	const struct parse_chunk *chunk)
+{
+	struct context *inc;
+	const uint8_t *logic;
+	const csv_analog_t *analog;
+	size_t done, count, ch_idx;
+	int ret;
+
+	/*
+	 * Copy runs of samples in bulk, up to the remaining space in the
+	 * datafeed buffers. Logic and analog buffers hold the same number
+	 * of samples, and fill up in lock step.
+	 */
+	inc = in->priv;
+	logic = chunk->ctx.datafeed_buffer;
+	analog = chunk->ctx.analog_datafeed_buffer;
+	done = 0;
+	while (done < chunk->sample_count) {
+		count = chunk->sample_count - done;
+		if (inc->logic_channels)
+			count = MIN(count, (inc->datafeed_buf_size -
+				inc->datafeed_buf_fill) / inc->sample_unit_size);
+		if (inc->analog_channels)
+			count = MIN(count, inc->analog_datafeed_buf_size -
+				inc->analog_datafeed_buf_fill);
+		if (inc->logic_channels) {
+			memcpy(&inc->datafeed_buffer[inc->datafeed_buf_fill],
+				&logic[done * inc->sample_unit_size],
+				count * inc->sample_unit_size);
+			inc->datafeed_buf_fill += count * inc->sample_unit_size;
+		}
+		if (inc->analog_channels) {
+			for (ch_idx = 0; ch_idx < inc->analog_channels; ch_idx++) {
+				memcpy(&inc->analog_datafeed_buffer[ch_idx *
+					inc->analog_datafeed_buf_size +
+					inc->analog_datafeed_buf_fill],
+					&analog[ch_idx * chunk->line_count + done],
+					count * sizeof(analog[0]));
+			}
+			inc->analog_datafeed_buf_fill += count;
+		}
+		done += count;
+
+		ret = SR_OK;
+		if (inc->datafeed_buf_fill == inc->datafeed_buf_size)
+			ret += flush_logic_samples(in);
+		if (inc->analog_datafeed_buf_fill == inc->analog_datafeed_buf_size)
+			ret += flush_analog_samples(in);
+		if (ret != SR_OK) {
+			sr_err("Sending samples failed.");
+			return SR_ERR;
+		}
+	}
+
+	return SR_OK;
+}
+
+/*
+ * Have several threads parse a range of text lines, then queue their
+ * samples in the input's order. Only applicable when no line depends
+ * on the processing of previous lines.
+ */
+static int process_lines_threaded(const struct sr_input *in,
+	char **lines, size_t line_count, size_t threads)
+{
+	struct context *inc;
+	struct parse_chunk *chunks, *chunk;
+	size_t idx, per_chunk;
+	GError *error;
 	int ret;
-	char *processed_up_to;
-	char **lines, *line, **columns, *column;
+
+	inc = in->priv;
+	chunks = g_malloc0(threads * sizeof(chunks[0]));
+	per_chunk = (line_count + threads - 1) / threads;
+	for (idx = 0; idx < threads; idx++) {
+		chunk = &chunks[idx];
+		chunk->lines = &lines[idx * per_chunk];
+		chunk->line_count = MIN(per_chunk, line_count - idx * per_chunk);
+		chunk->ctx = *inc;
+		chunk->ctx.columns = NULL;
+		chunk->ctx.columns_size = 0;
+		chunk->ctx.line_number = inc->line_number + idx * per_chunk;
+		chunk->ctx.datafeed_buf_size = chunk->line_count * inc->sample_unit_size;
+		chunk->ctx.datafeed_buf_fill = 0;
+		chunk->ctx.datafeed_buffer = g_malloc(chunk->ctx.datafeed_buf_size);
+		chunk->ctx.analog_datafeed_buf_size = chunk->line_count;
+		chunk->ctx.analog_datafeed_buf_fill = 0;
+		chunk->ctx.analog_datafeed_buffer = g_malloc(chunk->line_count *
+			inc->analog_channels * sizeof(csv_analog_t));
+		error = NULL;
+		if (idx)
+			chunk->thread = g_thread_try_new("sr-csv",
+				parse_chunk_thread, chunk, &error);
+		if (!chunk->thread) {
+			if (error) {
+				sr_dbg("Cannot create parser thread: %s.",
+					error->message);
+				g_error_free(error);
+			}
+			parse_chunk_thread(chunk);
+		}
+	}
+
+	ret = SR_OK;
+	for (idx = 0; idx < threads; idx++) {
+		chunk = &chunks[idx];
+		if (chunk->thread)
+			g_thread_join(chunk->thread);
+		if (ret == SR_OK)
+			ret = queue_chunk_samples(in, chunk);
+		if (ret == SR_OK)
+			ret = chunk->ret;
+		g_free(chunk->ctx.datafeed_buffer);
+		g_free(chunk->ctx.analog_datafeed_buffer);
+		g_free(chunk->ctx.columns);
+	}
+	g_free(chunks);
+	inc->line_number += line_count;
+
+	return ret;
+}
+
+/*
+ * Determine the number of parser threads for the lines which remain
+ * after the header. Timestamp columns get parsed sequentially until
+ * they have determined the samplerate, since they depend on previous
+ * lines.
+ */
+static size_t parse_thread_count(struct context *inc, size_t line_count)
+{
+	size_t threads, idx;
+
+	if (!inc->calc_samplerate) {
+		for (idx = 0; idx < inc->column_want_count; idx++) {
+			if (format_is_timestamp(inc->column_details[idx].text_format))
+				return 1;
+		}
+	}
+	threads = inc->threads;
+	if (!threads)
+		threads = g_get_num_processors();
+	threads = MIN(threads, line_count / THREAD_MIN_LINES);
+
+	return MAX(threads, 1);
+}
+
+static int process_buffer(struct sr_input *in, gboolean is_eof)
+{
+	struct context *inc;
+	int ret;
+	char *processed_up_to, *end, *next;
+	char *line;
+	size_t term_len, line_count, idx, threads;
 
 	inc = in->priv;
 	if (!inc->started) {
@@ -1561,94 +1903,73 @@ static int process_buffer(struct sr_input *in, gboolean is_eof)
 	 */
 	if (!in->buf->len)
 		return SR_OK;
+	term_len = strlen(inc->termination);
 	if (is_eof) {
-		processed_up_to = in->buf->str + in->buf->len;
+		end = processed_up_to = in->buf->str + in->buf->len;
 	} else {
-		processed_up_to = g_strrstr_len(in->buf->str, in->buf->len,
+		end = g_strrstr_len(in->buf->str, in->buf->len,
 			inc->termination);
-		if (!processed_up_to)
+		if (!end)
 			return SR_OK;
-		*processed_up_to = '\0';
-		processed_up_to += strlen(inc->termination);
+		*end = '\0';
+		processed_up_to = end + term_len;
 	}
 
-	/* Split input text lines and process their columns. */
-	ret = SR_OK;
-	lines = g_strsplit(in->buf->str, inc->termination, 0);
-	for (line_idx = 0; (line = lines[line_idx]); line_idx++) {
-		inc->line_number++;
-		if (inc->line_number < inc->start_line) {
-			sr_spew("Line %zu skipped (before start).", inc->line_number);
-			continue;
-		}
-		if (line[0] == '\0') {
-			sr_spew("Blank line %zu skipped.", inc->line_number);
-			continue;
-		}
-
-		/* Remove trailing comment. */
-		strip_comment(line, inc->comment);
-		if (line[0] == '\0') {
-			sr_spew("Comment-only line %zu skipped.", inc->line_number);
-			continue;
-		}
-
-		/* Skip the header line, its content was used as the channel names. */
-		if (inc->use_header && !inc->header_seen) {
-			sr_spew("Header line %zu skipped.", inc->line_number);
-			inc->header_seen = TRUE;
-			continue;
-		}
-
-		/* Split the line into columns, check for minimum length. */
-		columns = split_line(line, inc);
-		if (!columns) {
-			sr_err("Error while parsing line %zu.", inc->line_number);
-			g_strfreev(lines);
-			return SR_ERR;
-		}
-		num_columns = g_strv_length(columns);
-		if (num_columns < inc->column_want_count) {
-			sr_err("Insufficient column count %zu in line %zu.",
-				num_columns, inc->line_number);
-			g_strfreev(columns);
-			g_strfreev(lines);
-			return SR_ERR;
+	/*
+	 * Find the text lines in place. The lines' termination gets
+	 * replaced by NUL characters, memchr() scans for the termination's
+	 * first character in large blocks.
+	 */
+	line_count = 0;
+	for (line = in->buf->str; line < end;
+			line = (next < end) ? next + term_len : end) {
+		next = line;
+		while ((next = memchr(next, inc->termination[0], end - next))) {
+			if ((size_t)(end - next) >= term_len &&
+			    !memcmp(next, inc->termination, term_len))
+				break;
+			next++;
 		}
-
-		/* Have the columns of the current text line processed. */
-		clear_logic_samples(inc);
-		clear_analog_samples(inc);
-		for (col_idx = 0; col_idx < inc->column_want_count; col_idx++) {
-			column = columns[col_idx];
-			col_nr = col_idx + 1;
-			details = lookup_column_details(inc, col_nr);
-			if (!details || !details->text_format)
-				continue;
-			parse_func = col_parse_funcs[details->text_format];
-			if (!parse_func)
-				continue;
-			ret = parse_func(column, inc, details);
-			if (ret != SR_OK) {
-				g_strfreev(columns);
-				g_strfreev(lines);
-				return SR_ERR;
-			}
+		if (!next)
+			next = end;
+		*next = '\0';
+		if (line_count == inc->lines_size) {
+			inc->lines_size = MAX(1024, 2 * inc->lines_size);
+			inc->lines = g_realloc(inc->lines,
+				inc->lines_size * sizeof(inc->lines[0]));
 		}
+		inc->lines[line_count++] = line;
+	}
 
-		/* Send sample data to the session bus (buffered). */
-		ret = queue_logic_samples(in);
-		ret += queue_analog_samples(in);
-		if (ret != SR_OK) {
-			sr_err("Sending samples failed.");
-			g_strfreev(columns);
-			g_strfreev(lines);
-			return SR_ERR;
+	/*
+	 * Process leading lines sequentially, up to the start line and
+	 * the header line. Spread the remaining lines' parsing across
+	 * threads when this is possible and the amount of data is worth
+	 * the effort.
+	 */
+	ret = SR_OK;
+	idx = 0;
+	while (idx < line_count) {
+		if (inc->line_number + 1 >= inc->start_line &&
+		    (!inc->use_header || inc->header_seen))
+			break;
+		ret = process_line(in, inc->lines[idx++]);
+		if (ret != SR_OK)
+			return ret;
+	}
+	threads = parse_thread_count(inc, line_count - idx);
+	if (threads > 1) {
+		ret = process_lines_threaded(in, &inc->lines[idx],
+			line_count - idx, threads);
+		if (ret != SR_OK)
+			return ret;
+	} else {
+		while (idx < line_count) {
+			ret = process_line(in, inc->lines[idx++]);
+			if (ret != SR_OK)
+				return ret;
 		}
-
-		g_strfreev(columns);
 	}
-	g_strfreev(lines);
 	g_string_erase(in->buf, 0, processed_up_to - in->buf->str);
 
 	return ret;
@@ -1726,6 +2047,10 @@ static void cleanup(struct sr_input *in)
 	/* TODO Release channel names (before releasing details). */
 	g_free(inc->column_details);
 	inc->column_details = NULL;
+	g_free(inc->columns);
+	inc->columns = NULL;
+	g_free(inc->lines);
+	inc->lines = NULL;
 
 	/* Clear internal state, but keep what .init() has provided. */
 	save_ctx = *inc;
@@ -1736,6 +2061,7 @@ static void cleanup(struct sr_input *in)
 	inc->column_formats = save_ctx.column_formats;
 	inc->start_line = save_ctx.start_line;
 	inc->use_header = save_ctx.use_header;
+	inc->threads = save_ctx.threads;
 	inc->prev_sr_channels = save_ctx.prev_sr_channels;
 	inc->prev_df_channels = save_ctx.prev_df_channels;
 }
@@ -1763,6 +2089,7 @@ enum option_index {
 	OPT_SAMPLERATE,
 	OPT_COL_SEP,
 	OPT_COMMENT,
+	OPT_THREADS,
 	OPT_MAX,
 };
 
@@ -1817,6 +2144,11 @@ static struct sr_option options[] = {
 		"The text which starts comments at the end of text lines, semicolon by default.",
 		NULL, NULL,
 	},
+	[OPT_THREADS] = {
+		"threads", "Parser threads",
+		"The number of threads which parse text lines, 0 for one per processor (default: 0).",
+		NULL, NULL,
+	},
 	[OPT_MAX] = ALL_ZERO,
 };
 
@@ -1840,6 +2172,7 @@ static const struct sr_option *get_options(void)
 		options[OPT_SAMPLERATE].def = g_variant_ref_sink(g_variant_new_uint64(0));
 		options[OPT_COL_SEP].def = g_variant_ref_sink(g_variant_new_string(","));
 		options[OPT_COMMENT].def = g_variant_ref_sink(g_variant_new_string(";"));
+		options[OPT_THREADS].def = g_variant_ref_sink(g_variant_new_uint32(0));
 	}
 
 	return options;
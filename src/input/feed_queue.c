@@ -27,6 +27,7 @@ struct feed_queue_logic {
 	size_t alloc_count;
 	size_t fill_count;
 	uint8_t *data_bytes;
+	gboolean uniform;
 	struct sr_datafeed_packet packet;
 	struct sr_datafeed_logic logic;
 };
@@ -51,33 +52,156 @@ SR_API struct feed_queue_logic *feed_queue_logic_alloc(struct sr_dev_inst *sdi,
 	q->packet.type = SR_DF_LOGIC;
 	q->packet.payload = &q->logic;
 	q->logic.unitsize = q->unit_size;
-	q->logic.data = q->data_bytes;
 
 	return q;
 }
 
+/*
+ * Fill a buffer with copies of a sample. Single byte samples use memset(),
+ * wider samples double the filled region with every memcpy() call.
+ */
+static void fill_samples(uint8_t *wrptr, const uint8_t *data,
+	size_t unit_size, size_t count)
+{
+	size_t total, done, chunk;
+
+	if (!count)
+		return;
+	if (unit_size == 1) {
+		memset(wrptr, data[0], count);
+		return;
+	}
+
+	total = count * unit_size;
+	memcpy(wrptr, data, unit_size);
+	done = unit_size;
+	while (done < total) {
+		chunk = MIN(done, total - done);
+		memcpy(&wrptr[done], wrptr, chunk);
+		done += chunk;
+	}
+}
+
 SR_API int feed_queue_logic_submit(struct feed_queue_logic *q,
 	const uint8_t *data, size_t count)
 {
-	uint8_t *wrptr;
+	size_t run;
+	gboolean uniform;
+	int ret;
+
+	while (count) {
+		run = MIN(count, q->alloc_count - q->fill_count);
+		/*
+		 * Long runs of the same sample value send the very same
+		 * buffer content several times. Don't re-write the data
+		 * when the buffer already holds it.
+		 */
+		uniform = !q->fill_count && run == q->alloc_count;
+		if (!uniform || !q->uniform ||
+		    memcmp(q->data_bytes, data, q->unit_size) != 0)
+			fill_samples(&q->data_bytes[q->fill_count * q->unit_size],
+				data, q->unit_size, run);
+		q->uniform = uniform;
+		q->fill_count += run;
+		count -= run;
+		if (q->fill_count == q->alloc_count) {
+			ret = feed_queue_logic_flush(q);
+			if (ret != SR_OK)
+				return ret;
+		}
+	}
+
+	return SR_OK;
+}
+
+SR_API int feed_queue_logic_submit_many(struct feed_queue_logic *q,
+	const uint8_t *data, size_t count)
+{
+	size_t run;
 	int ret;
 
-	wrptr = &q->data_bytes[q->fill_count * q->unit_size];
-	while (count--) {
-		memcpy(wrptr, data, q->unit_size);
-		wrptr += q->unit_size;
-		q->fill_count++;
+	while (count) {
+		run = MIN(count, q->alloc_count - q->fill_count);
+		memcpy(&q->data_bytes[q->fill_count * q->unit_size],
+			data, run * q->unit_size);
+		q->uniform = FALSE;
+		q->fill_count += run;
+		data += run * q->unit_size;
+		count -= run;
 		if (q->fill_count == q->alloc_count) {
 			ret = feed_queue_logic_flush(q);
 			if (ret != SR_OK)
 				return ret;
-			wrptr = &q->data_bytes[0];
 		}
 	}
 
 	return SR_OK;
 }
 
+/*
+ * Get write access to the queue's buffer, for callers which decode
+ * samples in place. Returns the position of the next sample, and the
+ * number of samples which fit in *count. Samples become part of the
+ * queue's content by calling feed_queue_logic_commit().
+ */
+SR_API uint8_t *feed_queue_logic_get_space(struct feed_queue_logic *q,
+	size_t *count)
+{
+
+	if (!q || !count)
+		return NULL;
+	*count = 0;
+	if (!q->data_bytes)
+		return NULL;
+
+	*count = q->alloc_count - q->fill_count;
+	q->uniform = FALSE;
+
+	return &q->data_bytes[q->fill_count * q->unit_size];
+}
+
+/*
+ * Account for samples which the caller has written in place, after
+ * feed_queue_logic_get_space(). Sends the buffer when it is full.
+ */
+SR_API int feed_queue_logic_commit(struct feed_queue_logic *q, size_t count)
+{
+
+	if (!q)
+		return SR_ERR_ARG;
+	if (count > q->alloc_count - q->fill_count)
+		return SR_ERR_ARG;
+
+	q->fill_count += count;
+	if (q->fill_count == q->alloc_count)
+		return feed_queue_logic_flush(q);
+
+	return SR_OK;
+}
+
+/*
+ * Send logic data to the session. Consumers which retain the packet
+ * share the memory instead of copying it, in that case the memory is
+ * theirs and *data gets cleared. Otherwise the caller keeps it.
+ */
+static int send_logic_data(struct feed_queue_logic *q,
+	uint8_t **data, size_t count)
+{
+	struct sr_packet_buffer *pbuf;
+	int ret;
+
+	q->logic.data = *data;
+	q->logic.length = count * q->unit_size;
+	pbuf = sr_packet_buffer_new(*data, q->alloc_count * q->unit_size, g_free);
+	sr_session_send_buffer_set(q->sdi->session, pbuf);
+	ret = sr_session_send(q->sdi, &q->packet);
+	sr_session_send_buffer_set(q->sdi->session, NULL);
+	if (!sr_packet_buffer_reclaim(pbuf))
+		*data = NULL;
+
+	return ret;
+}
+
 SR_API int feed_queue_logic_flush(struct feed_queue_logic *q)
 {
 	int ret;
@@ -85,8 +209,13 @@ SR_API int feed_queue_logic_flush(struct feed_queue_logic *q)
 	if (!q->fill_count)
 		return SR_OK;
 
-	q->logic.length = q->fill_count * q->unit_size;
-	ret = sr_session_send(q->sdi, &q->packet);
+	ret = send_logic_data(q, &q->data_bytes, q->fill_count);
+	if (!q->data_bytes) {
+		q->data_bytes = g_try_malloc(q->alloc_count * q->unit_size);
+		q->uniform = FALSE;
+		if (!q->data_bytes)
+			return SR_ERR_MALLOC;
+	}
 	if (ret != SR_OK)
 		return ret;
 	q->fill_count = 0;
@@ -94,6 +223,39 @@ SR_API int feed_queue_logic_flush(struct feed_queue_logic *q)
 	return SR_OK;
 }
 
+/*
+ * Submit a caller's buffer of samples, which the queue takes ownership
+ * of (allocated by g_malloc()). A buffer of the queue's size gets sent
+ * without copying its content.
+ */
+SR_API int feed_queue_logic_submit_buffer(struct feed_queue_logic *q,
+	uint8_t *data, size_t count)
+{
+	int ret;
+
+	/* Only complete buffers get sent as is, copy everything else. */
+	if (count != q->alloc_count) {
+		ret = feed_queue_logic_submit_many(q, data, count);
+		g_free(data);
+		return ret;
+	}
+
+	ret = feed_queue_logic_flush(q);
+	if (ret != SR_OK) {
+		g_free(data);
+		return ret;
+	}
+	ret = send_logic_data(q, &data, count);
+	if (data) {
+		/* Keep the unused memory as the queue's next buffer. */
+		g_free(q->data_bytes);
+		q->data_bytes = data;
+		q->uniform = FALSE;
+	}
+
+	return ret;
+}
+
 SR_API void feed_queue_logic_free(struct feed_queue_logic *q)
 {
 
@@ -148,10 +310,39 @@ SR_API struct feed_queue_analog *feed_queue_analog_alloc(struct sr_dev_inst *sdi
 SR_API int feed_queue_analog_submit(struct feed_queue_analog *q,
 	float data, size_t count)
 {
+	size_t run;
+	float *wrptr;
+	int ret;
+
+	while (count) {
+		run = MIN(count, q->alloc_count - q->fill_count);
+		wrptr = &q->data_values[q->fill_count];
+		q->fill_count += run;
+		count -= run;
+		while (run--)
+			*wrptr++ = data;
+		if (q->fill_count == q->alloc_count) {
+			ret = feed_queue_analog_flush(q);
+			if (ret != SR_OK)
+				return ret;
+		}
+	}
+
+	return SR_OK;
+}
+
+SR_API int feed_queue_analog_submit_many(struct feed_queue_analog *q,
+	const float *data, size_t count)
+{
+	size_t run;
 	int ret;
 
-	while (count--) {
-		q->data_values[q->fill_count++] = data;
+	while (count) {
+		run = MIN(count, q->alloc_count - q->fill_count);
+		memcpy(&q->data_values[q->fill_count], data, run * sizeof(*data));
+		q->fill_count += run;
+		data += run;
+		count -= run;
 		if (q->fill_count == q->alloc_count) {
 			ret = feed_queue_analog_flush(q);
 			if (ret != SR_OK)
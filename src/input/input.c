@@ -72,6 +72,7 @@ extern SR_PRIV struct sr_input_module input_wav;
 extern SR_PRIV struct sr_input_module input_raw_analog;
 extern SR_PRIV struct sr_input_module input_logicport;
 extern SR_PRIV struct sr_input_module input_saleae;
+extern SR_PRIV struct sr_input_module input_srnet;
 extern SR_PRIV struct sr_input_module input_null;
 /** @endcond */
 
@@ -85,6 +86,7 @@ static const struct sr_input_module *input_module_list[] = {
 	&input_raw_analog,
 	&input_logicport,
 	&input_saleae,
+	&input_srnet,
 	&input_null,
 	NULL,
 };
@@ -340,6 +342,92 @@ static gboolean check_required_metadata(const uint8_t *metadata, uint8_t *avail)
 	return TRUE;
 }
 
+/** @cond PRIVATE */
+/* One input module's format match attempt during a scan. */
+struct scan_job {
+	const struct sr_input_module *imod;
+	GHashTable *meta;
+	gint index;
+	int ret;
+	unsigned int conf;
+};
+/** @endcond */
+
+static void scan_job_run(gpointer data, gpointer user_data)
+{
+	struct scan_job *job;
+	gint *stop_index, stop;
+
+	job = data;
+	stop_index = user_data;
+
+	/*
+	 * Skip the attempt when a module which precedes this one in the
+	 * list already matched with maximum confidence. It would win any
+	 * tie, this module cannot take precedence.
+	 */
+	job->ret = SR_ERR_NA;
+	if (job->index > g_atomic_int_get(stop_index))
+		return;
+
+	sr_spew("Trying module %s.", job->imod->id);
+	job->ret = job->imod->format_match(job->meta, &job->conf);
+	if (job->ret != SR_OK)
+		return;
+	sr_dbg("Module %s matched, confidence %u.", job->imod->id, job->conf);
+	if (job->conf > 1)
+		return;
+	do {
+		stop = g_atomic_int_get(stop_index);
+		if (job->index >= stop)
+			break;
+	} while (!g_atomic_int_compare_and_exchange(stop_index, stop, job->index));
+}
+
+/*
+ * Run the modules' format match routines, concurrently when several
+ * processors are available. Matchers only read the metadata, which
+ * makes them safe to run in parallel. Returns the module with the
+ * highest confidence, modules earlier in the list win ties.
+ */
+static const struct sr_input_module *scan_modules(struct scan_job *jobs,
+	size_t count)
+{
+	const struct sr_input_module *best_imod;
+	unsigned int best_conf;
+	GThreadPool *pool;
+	gint stop_index;
+	size_t i, threads;
+
+	stop_index = G_MAXINT;
+	threads = MIN(count, (size_t)g_get_num_processors());
+	pool = NULL;
+	if (threads > 1)
+		pool = g_thread_pool_new(scan_job_run, &stop_index,
+			threads, FALSE, NULL);
+	for (i = 0; i < count; i++) {
+		if (pool)
+			g_thread_pool_push(pool, &jobs[i], NULL);
+		else
+			scan_job_run(&jobs[i], &stop_index);
+	}
+	if (pool)
+		g_thread_pool_free(pool, FALSE, TRUE);
+
+	best_imod = NULL;
+	best_conf = ~0;
+	for (i = 0; i < count; i++) {
+		if (jobs[i].ret != SR_OK)
+			continue;
+		if (jobs[i].conf >= best_conf)
+			continue;
+		best_imod = jobs[i].imod;
+		best_conf = jobs[i].conf;
+	}
+
+	return best_imod;
+}
+
 /**
  * Try to find an input module that can parse the given buffer.
  *
@@ -364,10 +452,10 @@ static gboolean check_required_metadata(const uint8_t *metadata, uint8_t *avail)
 SR_API int sr_input_scan_buffer(GString *buf, const struct sr_input **in)
 {
 	const struct sr_input_module *imod, *best_imod;
+	struct scan_job jobs[G_N_ELEMENTS(input_module_list)];
 	GHashTable *meta;
 	unsigned int m, i;
-	unsigned int conf, best_conf;
-	int ret;
+	size_t count;
 	uint8_t mitem, avail_metadata[8];
 
 	/* No more metadata to be had from a buffer. */
@@ -375,8 +463,7 @@ SR_API int sr_input_scan_buffer(GString *buf, const struct sr_input **in)
 	avail_metadata[1] = 0;
 
 	*in = NULL;
-	best_imod = NULL;
-	best_conf = ~0;
+	count = 0;
 	for (i = 0; input_module_list[i]; i++) {
 		imod = input_module_list[i];
 		if (!imod->metadata[0]) {
@@ -399,28 +486,16 @@ SR_API int sr_input_scan_buffer(GString *buf, const struct sr_input **in)
 			g_hash_table_destroy(meta);
 			continue;
 		}
-		sr_spew("Trying module %s.", imod->id);
-		ret = imod->format_match(meta, &conf);
-		g_hash_table_destroy(meta);
-		if (ret == SR_ERR_DATA) {
-			/* Module recognized this buffer, but cannot handle it. */
-			continue;
-		} else if (ret == SR_ERR) {
-			/* Module didn't recognize this buffer. */
-			continue;
-		} else if (ret != SR_OK) {
-			/* Can be SR_ERR_NA. */
-			continue;
-		}
-
-		/* Found a matching module. */
-		sr_spew("Module %s matched, confidence %u.", imod->id, conf);
-		if (conf >= best_conf)
-			continue;
-		best_imod = imod;
-		best_conf = conf;
+		jobs[count].imod = imod;
+		jobs[count].meta = meta;
+		jobs[count].index = count;
+		count++;
 	}
 
+	best_imod = scan_modules(jobs, count);
+	for (i = 0; i < count; i++)
+		g_hash_table_destroy(jobs[i].meta);
+
 	if (best_imod) {
 		*in = sr_input_new(best_imod, NULL);
 		g_string_insert_len((*in)->buf, 0, buf->str, buf->len);
@@ -444,12 +519,11 @@ SR_API int sr_input_scan_file(const char *filename, const struct sr_input **in)
 	int64_t filesize;
 	FILE *stream;
 	const struct sr_input_module *imod, *best_imod;
+	struct scan_job jobs[G_N_ELEMENTS(input_module_list)];
 	GHashTable *meta;
 	GString *header;
 	size_t count;
 	unsigned int midx, i;
-	unsigned int conf, best_conf;
-	int ret;
 	uint8_t avail_metadata[8];
 
 	*in = NULL;
@@ -470,7 +544,8 @@ SR_API int sr_input_scan_file(const char *filename, const struct sr_input **in)
 		fclose(stream);
 		return SR_ERR;
 	}
-	header = g_string_sized_new(CHUNK_SIZE);
+	/* Read the header once, all modules share it (read-only). */
+	header = g_string_sized_new(MIN(filesize, CHUNK_SIZE) + 1);
 	count = fread(header->str, 1, header->allocated_len - 1, stream);
 	if (count < 1 || ferror(stream)) {
 		sr_err("Failed to read %s: %s", filename, g_strerror(errno));
@@ -495,8 +570,7 @@ SR_API int sr_input_scan_file(const char *filename, const struct sr_input **in)
 	avail_metadata[midx] = 0;
 	/* TODO: MIME type */
 
-	best_imod = NULL;
-	best_conf = ~0;
+	count = 0;
 	for (i = 0; input_module_list[i]; i++) {
 		imod = input_module_list[i];
 		if (!imod->metadata[0]) {
@@ -508,23 +582,12 @@ SR_API int sr_input_scan_file(const char *filename, const struct sr_input **in)
 			/* Cannot satisfy this module's requirements. */
 			continue;
 
-		sr_dbg("Trying module %s.", imod->id);
-
-		ret = imod->format_match(meta, &conf);
-		if (ret == SR_ERR) {
-			/* Module didn't recognize this buffer. */
-			continue;
-		} else if (ret != SR_OK) {
-			/* Module recognized this buffer, but cannot handle it. */
-			continue;
-		}
-		/* Found a matching module. */
-		sr_dbg("Module %s matched, confidence %u.", imod->id, conf);
-		if (conf >= best_conf)
-			continue;
-		best_imod = imod;
-		best_conf = conf;
+		jobs[count].imod = imod;
+		jobs[count].meta = meta;
+		jobs[count].index = count;
+		count++;
 	}
+	best_imod = scan_modules(jobs, count);
 	g_hash_table_destroy(meta);
 	g_string_free(header, TRUE);
 
@@ -593,6 +656,73 @@ SR_API int sr_input_send(const struct sr_input *in, GString *buf)
 	return in->module->receive((struct sr_input *)in, buf);
 }
 
+/**
+ * Send data from the caller's memory to the specified input instance.
+ *
+ * Like sr_input_send(), without the need to put the data into a GString.
+ * Input modules which support this parse the data in place, and only
+ * copy what they could not consume yet, e.g. a partial sample. The data
+ * is not used after this function returns.
+ *
+ * @param in The input instance.
+ * @param data The data to send. Can be NULL if len is 0.
+ * @param len The length of the data in bytes.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval other Negative error code.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_input_send_data(const struct sr_input *in,
+		const void *data, size_t len)
+{
+	GString buf;
+
+	if (!in || (!data && len))
+		return SR_ERR_ARG;
+
+	sr_spew("Sending %zu bytes to %s module.", len, in->module->id);
+	if (in->module->receive_data)
+		return in->module->receive_data((struct sr_input *)in, data, len);
+
+	/* Modules only read from the GString, so it can borrow the data. */
+	buf.str = (gchar *)(data ? data : "");
+	buf.len = len;
+	buf.allocated_len = len;
+
+	return in->module->receive((struct sr_input *)in, &buf);
+}
+
+/**
+ * Send a whole file to the specified input instance.
+ *
+ * Input modules which support this map the file into memory, and send
+ * the sample data straight from the mapping, instead of copying it out
+ * of buffers passed to sr_input_send().
+ *
+ * Like sr_input_send(), this returns the moment the device instance is
+ * ready, without sending sample data, if it was not ready before. Call
+ * it again after setting up the session to send the file's data.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval SR_ERR_NA The module cannot take files, use sr_input_send().
+ * @retval other Negative error code.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_input_send_file(const struct sr_input *in, const char *filename)
+{
+	if (!in || !filename || !filename[0])
+		return SR_ERR_ARG;
+	if (!in->module->receive_file)
+		return SR_ERR_NA;
+
+	sr_spew("Sending file %s to %s module.", filename, in->module->id);
+	return in->module->receive_file((struct sr_input *)in, filename);
+}
+
 /**
  * Signal the input module no more data will come.
  *
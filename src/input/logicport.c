@@ -131,9 +131,7 @@ struct context {
 	GSList *signal_groups;
 	GSList *channels;
 	size_t unitsize;
-	size_t samples_per_chunk;
-	size_t samples_in_buffer;
-	uint8_t *feed_buffer;
+	struct feed_queue_logic *feed_logic;
 };
 
 static struct signal_group_desc *alloc_signal_group(const char *name)
@@ -473,6 +471,74 @@ static int process_sample_line(struct context *inc, char **values)
 	return SR_OK;
 }
 
+/* Wire values in sample lines, indexed by the text character. */
+enum wire_char {
+	WIRE_CHAR_INVALID,
+	WIRE_CHAR_LOW,
+	WIRE_CHAR_HIGH,
+	WIRE_CHAR_UNDEF,
+};
+
+static const uint8_t wire_char_table[256] = {
+	['0'] = WIRE_CHAR_LOW,
+	['1'] = WIRE_CHAR_HIGH,
+	['U'] = WIRE_CHAR_UNDEF,
+};
+
+/*
+ * Parse a sample line in a single pass, without splitting it into
+ * separate strings. Handles the common layout of single character
+ * wire values and a decimal repeat count. Returns SR_ERR_NA for any
+ * other input, callers then take the generic (slower) path.
+ */
+static int parse_sample_line(struct context *inc, const char *line)
+{
+	struct sample_data_entry *entry;
+	uint64_t bits, undef, mask, repeat;
+	size_t idx;
+	const uint8_t *p;
+
+	p = (const uint8_t *)line;
+	bits = 0;
+	undef = 0;
+	mask = UINT64_C(1);
+	for (idx = 0; idx < inc->channel_count; idx++, mask <<= 1) {
+		switch (wire_char_table[p[0]]) {
+		case WIRE_CHAR_LOW:
+			break;
+		case WIRE_CHAR_HIGH:
+			bits |= mask;
+			break;
+		case WIRE_CHAR_UNDEF:
+			undef |= mask;
+			break;
+		default:
+			return SR_ERR_NA;
+		}
+		if (p[1] != ',')
+			return SR_ERR_NA;
+		p += 2;
+	}
+	if (!g_ascii_isdigit(*p))
+		return SR_ERR_NA;
+	repeat = 0;
+	while (g_ascii_isdigit(*p)) {
+		if (repeat > (G_MAXSIZE - 9) / 10)
+			return SR_ERR_NA;
+		repeat = repeat * 10 + (*p++ - '0');
+	}
+	if (*p)
+		return SR_ERR_NA;
+
+	entry = &inc->sample_data_queue[inc->sample_lines_read];
+	entry->bits = bits;
+	entry->repeat = repeat;
+	inc->wires_undefined |= undef;
+	inc->samples_got_uncomp += repeat;
+
+	return SR_OK;
+}
+
 static int process_keyvalue_line(struct context *inc, char *line)
 {
 	char *sep, *key, *arg;
@@ -513,9 +579,12 @@ static int process_keyvalue_line(struct context *inc, char *line)
 	case SAMPLEDATA_DATA_LINES:
 		while (isspace(*line))
 			line++;
-		args = g_strsplit(line, ",", 0);
-		rc = process_sample_line(inc, args);
-		g_strfreev(args);
+		rc = parse_sample_line(inc, line);
+		if (rc == SR_ERR_NA) {
+			args = g_strsplit(line, ",", 0);
+			rc = process_sample_line(inc, args);
+			g_strfreev(args);
+		}
 		if (rc)
 			return rc;
 		inc->sample_lines_read++;
@@ -828,27 +897,21 @@ static int create_feed_buffer(struct sr_input *in)
 	inc = in->priv;
 
 	inc->unitsize = (inc->channel_count + 7) / 8;
-	inc->samples_per_chunk = CHUNK_SIZE / inc->unitsize;
-	inc->samples_in_buffer = 0;
-	inc->feed_buffer = g_malloc0(inc->samples_per_chunk * inc->unitsize);
-	if (!inc->feed_buffer)
+	inc->feed_logic = feed_queue_logic_alloc(in->sdi,
+		CHUNK_SIZE / inc->unitsize, inc->unitsize);
+	if (!inc->feed_logic)
 		return SR_ERR_MALLOC;
 
 	return SR_OK;
 }
 
-/* Send all accumulated sample data values to the session. */
-static int send_buffer(struct sr_input *in)
+/* Send the DF header and the samplerate (once) before sample data. */
+static int start_feed(struct sr_input *in)
 {
 	struct context *inc;
-	struct sr_datafeed_packet packet;
-	struct sr_datafeed_logic logic;
 	int rc;
 
 	inc = in->priv;
-	if (!inc->samples_in_buffer)
-		return SR_OK;
-
 	if (!inc->header_sent) {
 		rc = std_session_send_df_header(in->sdi);
 		if (rc)
@@ -864,60 +927,46 @@ static int send_buffer(struct sr_input *in)
 		inc->rate_sent = TRUE;
 	}
 
-	packet.type = SR_DF_LOGIC;
-	packet.payload = &logic;
-	logic.unitsize = inc->unitsize;
-	logic.data = inc->feed_buffer;
-	logic.length = inc->unitsize * inc->samples_in_buffer;
-	rc = sr_session_send(in->sdi, &packet);
+	return SR_OK;
+}
 
-	inc->samples_in_buffer = 0;
+/* Send all accumulated sample data values to the session. */
+static int send_buffer(struct sr_input *in)
+{
+	struct context *inc;
 
-	if (rc)
-		return rc;
+	inc = in->priv;
+	if (!inc->feed_logic)
+		return SR_OK;
 
-	return SR_OK;
+	return feed_queue_logic_flush(inc->feed_logic);
 }
 
 /*
- * Add N copies of the current sample to the buffer. Send the buffer to
- * the session feed when a maximum amount of data was collected.
+ * Add N copies of the current sample to the buffer. The feed queue
+ * fills runs of the same value in bulk, and sends the buffer to the
+ * session feed when a maximum amount of data was collected.
  */
 static int add_samples(struct sr_input *in, uint64_t samples, size_t count)
 {
 	struct context *inc;
 	uint8_t sample_buffer[sizeof(uint64_t)];
 	size_t idx;
-	size_t copy_count;
-	uint8_t *p;
 	int rc;
 
 	inc = in->priv;
+	if (!count)
+		return SR_OK;
+	rc = start_feed(in);
+	if (rc)
+		return rc;
+
 	for (idx = 0; idx < inc->unitsize; idx++) {
 		sample_buffer[idx] = samples & 0xff;
 		samples >>= 8;
 	}
-	while (count) {
-		copy_count = inc->samples_per_chunk - inc->samples_in_buffer;
-		if (copy_count > count)
-			copy_count = count;
-		count -= copy_count;
-
-		p = inc->feed_buffer + inc->samples_in_buffer * inc->unitsize;
-		while (copy_count-- > 0) {
-			memcpy(p, sample_buffer, inc->unitsize);
-			p += inc->unitsize;
-			inc->samples_in_buffer++;
-		}
-
-		if (inc->samples_in_buffer == inc->samples_per_chunk) {
-			rc = send_buffer(in);
-			if (rc)
-				return rc;
-		}
-	}
 
-	return SR_OK;
+	return feed_queue_logic_submit(inc->feed_logic, sample_buffer, count);
 }
 
 /* Pass on previously received samples to the session. */
@@ -926,15 +975,53 @@ static int process_queued_samples(struct sr_input *in)
 	struct context *inc;
 	struct sample_data_entry *entry;
 	uint64_t sample_bits;
+	uint8_t *wrptr;
+	size_t space, count, idx;
 	int rc;
 
 	inc = in->priv;
+	if (inc->sample_lines_fed >= inc->sample_lines_total)
+		return SR_OK;
+	rc = start_feed(in);
+	if (rc)
+		return rc;
+
 	while (inc->sample_lines_fed < inc->sample_lines_total) {
-		entry = &inc->sample_data_queue[inc->sample_lines_fed++];
-		sample_bits = entry->bits;
-		sample_bits ^= inc->wires_inverted;
-		sample_bits &= inc->wires_enabled;
-		rc = add_samples(in, sample_bits, entry->repeat);
+		entry = &inc->sample_data_queue[inc->sample_lines_fed];
+		if (entry->repeat != 1) {
+			sample_bits = entry->bits;
+			sample_bits ^= inc->wires_inverted;
+			sample_bits &= inc->wires_enabled;
+			rc = add_samples(in, sample_bits, entry->repeat);
+			if (rc)
+				return rc;
+			inc->sample_lines_fed++;
+			continue;
+		}
+
+		/*
+		 * Lines without compression are most common in captures
+		 * of busy signals. Write runs of them directly into the
+		 * feed queue's buffer.
+		 */
+		wrptr = feed_queue_logic_get_space(inc->feed_logic, &space);
+		if (!wrptr)
+			return SR_ERR_MALLOC;
+		count = 0;
+		while (count < space && entry->repeat == 1) {
+			sample_bits = entry->bits;
+			sample_bits ^= inc->wires_inverted;
+			sample_bits &= inc->wires_enabled;
+			for (idx = 0; idx < inc->unitsize; idx++) {
+				*wrptr++ = sample_bits & 0xff;
+				sample_bits >>= 8;
+			}
+			count++;
+			if (++inc->sample_lines_fed == inc->sample_lines_total)
+				break;
+			entry++;
+		}
+		rc = feed_queue_logic_commit(inc->feed_logic, count);
 		if (rc)
 			return rc;
 	}
@@ -1150,7 +1237,7 @@ static void cleanup(struct sr_input *in)
 		g_free(inc->signal_names[idx]);
 	g_slist_free_full(inc->signal_groups, sg_free);
 	g_slist_free_full(inc->channels, g_free);
-	g_free(inc->feed_buffer);
+	feed_queue_logic_free(inc->feed_logic);
 	memset(inc, 0, sizeof(*inc));
 }
 
@@ -152,10 +152,15 @@ static int init(struct sr_input *in, GHashTable *options)
 	return SR_OK;
 }
 
-static int process_buffer(struct sr_input *in)
+/*
+ * Send whole samples from a memory region, return the number of bytes
+ * that were consumed. Packets point into the caller's memory and carry
+ * the sample format's native encoding, no conversion takes place.
+ */
+static size_t send_samples(struct sr_input *in, const uint8_t *data, size_t len)
 {
 	struct context *inc;
-	unsigned int offset, chunk_size;
+	size_t offset, chunk_size;
 
 	inc = in->priv;
 	if (!inc->started) {
@@ -174,21 +179,30 @@ static int process_buffer(struct sr_input *in)
 	chunk_size = inc->analog.num_samples * inc->samplesize;
 	offset = 0;
 
-	while ((offset + chunk_size) < in->buf->len) {
-		inc->analog.data = in->buf->str + offset;
+	while ((offset + chunk_size) < len) {
+		inc->analog.data = (void *)(data + offset);
 		sr_session_send(in->sdi, &inc->packet);
 		offset += chunk_size;
 	}
 
-	inc->analog.num_samples = (in->buf->len - offset) / inc->samplesize;
+	inc->analog.num_samples = (len - offset) / inc->samplesize;
 	chunk_size = inc->analog.num_samples * inc->samplesize;
 	if (chunk_size > 0) {
-		inc->analog.data = in->buf->str + offset;
+		inc->analog.data = (void *)(data + offset);
 		sr_session_send(in->sdi, &inc->packet);
 		offset += chunk_size;
 	}
 
-	if ((unsigned int)offset < in->buf->len) {
+	return offset;
+}
+
+static int process_buffer(struct sr_input *in)
+{
+	size_t offset;
+
+	offset = send_samples(in, (const uint8_t *)in->buf->str, in->buf->len);
+
+	if (offset < in->buf->len) {
 		/*
 		 * The incoming buffer wasn't processed completely. Stash
 		 * the leftover data for next time.
@@ -218,6 +232,77 @@ static int receive(struct sr_input *in, GString *buf)
 	return ret;
 }
 
+static int receive_data(struct sr_input *in, const void *data, size_t len)
+{
+	const char *bytes;
+	size_t samplesize, fill, done;
+
+	if (!in->sdi_ready) {
+		g_string_append_len(in->buf, data, len);
+		/* sdi is ready, notify frontend. */
+		in->sdi_ready = TRUE;
+		return SR_OK;
+	}
+
+	/* Complete a partial sample from earlier data first. */
+	bytes = data;
+	samplesize = ((struct context *)in->priv)->samplesize;
+	if (in->buf->len) {
+		fill = MIN(len, (samplesize - in->buf->len % samplesize) % samplesize);
+		g_string_append_len(in->buf, bytes, fill);
+		process_buffer(in);
+		bytes += fill;
+		len -= fill;
+	}
+
+	/* Send everything else from the caller's memory. */
+	done = send_samples(in, (const uint8_t *)bytes, len);
+	g_string_append_len(in->buf, bytes + done, len - done);
+
+	return SR_OK;
+}
+
+static int receive_file(struct sr_input *in, const char *filename)
+{
+	GMappedFile *file;
+	GError *error;
+	const uint8_t *data;
+	size_t len, done;
+
+	if (!in->sdi_ready) {
+		/* The channels are known from the options already. */
+		in->sdi_ready = TRUE;
+		return SR_OK;
+	}
+
+	/* Samples queued by receive() come first. */
+	if (in->buf->len % ((struct context *)in->priv)->samplesize) {
+		sr_err("Cannot append a file to a partial sample.");
+		return SR_ERR_ARG;
+	}
+	process_buffer(in);
+
+	error = NULL;
+	file = g_mapped_file_new(filename, FALSE, &error);
+	if (!file) {
+		sr_err("Failed to map %s: %s", filename, error->message);
+		g_error_free(error);
+		return SR_ERR;
+	}
+	data = (const uint8_t *)g_mapped_file_get_contents(file);
+	len = g_mapped_file_get_length(file);
+
+	/*
+	 * Packets point straight into the mapping. Consumers which
+	 * retain them get a copy, the mapping ends with this call.
+	 */
+	done = data ? send_samples(in, data, len) : 0;
+	g_string_append_len(in->buf, (const char *)data + done, len - done);
+	g_mapped_file_unref(file);
+
+	return SR_OK;
+}
+
 static int end(struct sr_input *in)
 {
 	struct context *inc;
@@ -287,6 +372,8 @@ SR_PRIV struct sr_input_module input_raw_analog = {
 	.options = get_options,
 	.init = init,
 	.receive = receive,
+	.receive_data = receive_data,
+	.receive_file = receive_file,
 	.end = end,
 	.cleanup = cleanup,
 	.reset = reset,
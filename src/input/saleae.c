@@ -310,23 +310,14 @@ static int setup_feed_buffer_channel(struct sr_input *in, size_t ch_idx)
 	return SR_OK;
 }
 
-static int flush_feed_buffer(struct sr_input *in)
+/* Automatically send a datafeed header before meta and samples. */
+static int start_feed(struct sr_input *in)
 {
 	struct context *inc;
-	struct sr_datafeed_packet packet;
-	struct sr_datafeed_logic logic;
-	struct sr_datafeed_analog analog;
-	struct sr_analog_encoding encoding;
-	struct sr_analog_meaning meaning;
-	struct sr_analog_spec spec;
 	int rc;
 
 	inc = in->priv;
 
-	if (!inc->feed.samples_in_buffer)
-		return SR_OK;
-
-	/* Automatically send a datafeed header before meta and samples. */
 	if (!inc->module_state.header_sent) {
 		rc = std_session_send_df_header(in->sdi);
 		if (rc)
@@ -341,33 +332,78 @@ static int flush_feed_buffer(struct sr_input *in)
 		inc->module_state.rate_sent = TRUE;
 	}
 
+	return SR_OK;
+}
+
+/* Send host format float values of the current channel. */
+static int send_analog(struct sr_input *in, const float *data, size_t count)
+{
+	struct context *inc;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+	int rc;
+
+	inc = in->priv;
+
+	rc = start_feed(in);
+	if (rc)
+		return rc;
+
+	/* TODO: Use proper 'digits' value for this input module. */
+	memset(&packet, 0, sizeof(packet));
+	sr_analog_init(&analog, &encoding, &meaning, &spec, 3);
+	analog.data = (float *)data;
+	analog.num_samples = count;
+	analog.meaning->channels = inc->feed.channels;
+	analog.meaning->mq = SR_MQ_VOLTAGE;
+	analog.meaning->mqflags |= SR_MQFLAG_DC;
+	analog.meaning->unit = SR_UNIT_VOLT;
+	packet.type = SR_DF_ANALOG;
+	packet.payload = &analog;
+
+	return sr_session_send(in->sdi, &packet);
+}
+
+static int flush_feed_buffer(struct sr_input *in)
+{
+	struct context *inc;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic logic;
+	size_t count;
+	int rc;
+
+	inc = in->priv;
+
+	if (!inc->feed.samples_in_buffer)
+		return SR_OK;
+
 	/*
 	 * Create a packet with either logic or analog payload. Rewind
 	 * the caller's write position.
 	 */
-	memset(&packet, 0, sizeof(packet));
 	if (inc->feed.is_analog) {
-		/* TODO: Use proper 'digits' value for this input module. */
-		sr_analog_init(&analog, &encoding, &meaning, &spec, 3);
-		analog.data = inc->feed.buffer_analog;
-		analog.num_samples = inc->feed.samples_in_buffer;
-		analog.meaning->channels = inc->feed.channels;
-		analog.meaning->mq = SR_MQ_VOLTAGE;
-		analog.meaning->mqflags |= SR_MQFLAG_DC;
-		analog.meaning->unit = SR_UNIT_VOLT;
-		packet.type = SR_DF_ANALOG;
-		packet.payload = &analog;
+		count = inc->feed.samples_in_buffer;
 		inc->feed.write_pos = (void *)inc->feed.buffer_analog;
-	} else {
-		memset(&logic, 0, sizeof(logic));
-		logic.length = inc->feed.samples_in_buffer;
-		logic.length *= inc->feed.unit_size;
-		logic.unitsize = inc->feed.unit_size;
-		logic.data = inc->feed.buffer_digital;
-		packet.type = SR_DF_LOGIC;
-		packet.payload = &logic;
-		inc->feed.write_pos = inc->feed.buffer_digital;
+		inc->feed.samples_in_buffer = 0;
+		return send_analog(in, inc->feed.buffer_analog, count);
 	}
+
+	rc = start_feed(in);
+	if (rc)
+		return rc;
+
+	memset(&packet, 0, sizeof(packet));
+	memset(&logic, 0, sizeof(logic));
+	logic.length = inc->feed.samples_in_buffer;
+	logic.length *= inc->feed.unit_size;
+	logic.unitsize = inc->feed.unit_size;
+	logic.data = inc->feed.buffer_digital;
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+	inc->feed.write_pos = inc->feed.buffer_digital;
 	inc->feed.samples_in_buffer = 0;
 
 	/* Send the packet to the session feed. */
@@ -378,13 +414,20 @@ static int addto_feed_buffer_logic(struct sr_input *in,
 	uint64_t data, size_t count)
 {
 	struct context *inc;
+	uint8_t *start;
+	size_t run, total, done, chunk;
 
 	inc = in->priv;
 
 	if (inc->feed.is_analog)
 		return SR_ERR_ARG;
 
-	while (count--) {
+	while (count) {
+		run = inc->feed.samples_per_chunk - inc->feed.samples_in_buffer;
+		if (run > count)
+			run = count;
+		count -= run;
+		start = inc->feed.write_pos;
 		if (inc->feed.unit_size == sizeof(uint64_t))
 			write_u64le_inc(&inc->feed.write_pos, data);
 		else if (inc->feed.unit_size == sizeof(uint32_t))
@@ -395,7 +438,16 @@ static int addto_feed_buffer_logic(struct sr_input *in,
 			write_u8_inc(&inc->feed.write_pos, data);
 		else
 			return SR_ERR_BUG;
-		inc->feed.samples_in_buffer++;
+		/* Replicate the sample for the rest of the run, in bulk. */
+		total = run * inc->feed.unit_size;
+		done = inc->feed.unit_size;
+		while (done < total) {
+			chunk = MIN(done, total - done);
+			memcpy(&start[done], start, chunk);
+			done += chunk;
+		}
+		inc->feed.write_pos = &start[total];
+		inc->feed.samples_in_buffer += run;
 		if (inc->feed.samples_in_buffer == inc->feed.samples_per_chunk)
 			flush_feed_buffer(in);
 	}
@@ -829,6 +881,7 @@ static int parse_next_item(struct sr_input *in,
 			rc = setup_feed_buffer_channel(in, 0);
 			if (rc)
 				return rc;
+			inc->logic_state.stage = STAGE_L2A_EVERY_VALUE;
 			count = 1;
 		} else {
 			count = inc->logic_state.l2a.down_sample;
@@ -845,8 +898,91 @@ static int parse_next_item(struct sr_input *in,
 	/* UNREACH */
 }
 
+/*
+ * Bulk decoder for Logic2 digital data. Expands the list of transition
+ * timestamps into runs of samples, without the per-item dispatch. The
+ * feed buffer fills runs of the same value in bulk.
+ */
+static int parse_l2d_bulk(struct sr_input *in,
+	const uint8_t **buff, size_t *blen)
+{
+	struct context *inc;
+	const uint8_t *pos, *end;
+	double next_time, diff_time, period;
+	uint64_t count;
+	int rc;
+
+	inc = in->priv;
+	pos = *buff;
+	end = pos + *blen - *blen % sizeof(double);
+	period = inc->logic_state.l2d.sample_period;
+	rc = SR_OK;
+	while (pos < end) {
+		next_time = read_dblle_inc(&pos);
+		diff_time = next_time - inc->feed.last.time;
+		if (inc->logic_state.l2d.min_time_step > diff_time)
+			inc->logic_state.l2d.min_time_step = diff_time;
+		diff_time /= period;
+		diff_time += 0.5;
+		count = (uint64_t)diff_time;
+		if (count) {
+			rc = addto_feed_buffer_logic(in,
+				inc->feed.last.digital, count);
+			if (rc)
+				break;
+			inc->feed.last.time = next_time;
+		}
+		inc->feed.last.digital = 1 - inc->feed.last.digital;
+	}
+	*blen -= pos - *buff;
+	*buff = pos;
+
+	return rc;
+}
+
+/*
+ * Bulk decoder for Logic2 analog data. The file's float array already
+ * is in the host's format on little endian hosts, and gets sent from
+ * the receive buffer without copying it to the feed buffer.
+ */
+static int parse_l2a_bulk(struct sr_input *in,
+	const uint8_t **buff, size_t *blen)
+{
+#ifdef WORDS_BIGENDIAN
+	(void)in;
+	(void)buff;
+	(void)blen;
+
+	return SR_OK;
+#else
+	struct context *inc;
+	size_t count;
+	int rc;
+
+	inc = in->priv;
+	if (!inc->feed.is_analog)
+		return SR_OK;
+	count = *blen / sizeof(float);
+	if (!count)
+		return SR_OK;
+
+	/* Previously queued values come first. */
+	rc = flush_feed_buffer(in);
+	if (rc)
+		return rc;
+	rc = send_analog(in, (const float *)*buff, count);
+	if (rc)
+		return rc;
+	*buff += count * sizeof(float);
+	*blen -= count * sizeof(float);
+
+	return SR_OK;
+#endif
+}
+
 static int parse_samples(struct sr_input *in)
 {
+	struct context *inc;
 	const uint8_t *buff, *start;
 	size_t blen;
 
@@ -854,10 +990,22 @@ static int parse_samples(struct sr_input *in)
 	size_t len;
 	int rc;
 
+	inc = in->priv;
 	start = (const uint8_t *)in->buf->str;
 	buff = start;
 	blen = in->buf->len;
-	while (have_next_item(in, buff, blen, &curr, &next)) {
+	while (TRUE) {
+		/* Consume runs of items in bulk when the format allows. */
+		if (inc->logic_state.stage == STAGE_L2D_CHANGE_VALUE)
+			rc = parse_l2d_bulk(in, &buff, &blen);
+		else if (inc->logic_state.stage == STAGE_L2A_EVERY_VALUE)
+			rc = parse_l2a_bulk(in, &buff, &blen);
+		else
+			rc = SR_OK;
+		if (rc)
+			return rc;
+		if (!have_next_item(in, buff, blen, &curr, &next))
+			break;
 		len = next - curr;
 		rc = parse_next_item(in, curr, len);
 		if (rc)
@@ -0,0 +1,587 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Reads the packet stream of the srnet output module, see srnet.h for
+ * the format. The stream can come from a file, or from a connection
+ * as it arrives: each complete frame gets sent on as the packet it
+ * holds, the data without copying.
+ */
+
+#include <config.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+#include "srnet.h"
+
+#define LOG_PREFIX "input/srnet"
+
+struct context {
+	gboolean have_magic;
+	gboolean channels_done;
+	gboolean started;
+	/* Aligned copy of analog samples which arrived unaligned. */
+	uint8_t *abuf;
+	size_t abuf_size;
+};
+
+/* Bounds checked reads from a frame's payload. */
+struct reader {
+	const uint8_t *p;
+	const uint8_t *end;
+	gboolean truncated;
+};
+
+static const uint8_t *get_bytes(struct reader *r, size_t len)
+{
+	const uint8_t *p;
+
+	if (r->truncated || (size_t)(r->end - r->p) < len) {
+		r->truncated = TRUE;
+		return NULL;
+	}
+	p = r->p;
+	r->p += len;
+
+	return p;
+}
+
+static uint8_t get_u8(struct reader *r)
+{
+	const uint8_t *p;
+
+	return (p = get_bytes(r, 1)) ? R8(p) : 0;
+}
+
+static uint16_t get_u16(struct reader *r)
+{
+	const uint8_t *p;
+
+	return (p = get_bytes(r, 2)) ? RL16(p) : 0;
+}
+
+static uint32_t get_u32(struct reader *r)
+{
+	const uint8_t *p;
+
+	return (p = get_bytes(r, 4)) ? RL32(p) : 0;
+}
+
+static uint64_t get_u64(struct reader *r)
+{
+	const uint8_t *p;
+
+	return (p = get_bytes(r, 8)) ? RL64(p) : 0;
+}
+
+static double get_dbl(struct reader *r)
+{
+	const uint8_t *p;
+
+	return (p = get_bytes(r, 8)) ? RLDB(p) : 0;
+}
+
+static void get_rational(struct reader *r, struct sr_rational *rat)
+{
+	rat->p = (int64_t)get_u64(r);
+	rat->q = get_u64(r);
+}
+
+static struct sr_channel *find_channel(const struct sr_dev_inst *sdi,
+		int index)
+{
+	struct sr_channel *ch;
+	GSList *l;
+
+	for (l = sdi->channels; l; l = l->next) {
+		ch = l->data;
+		if (ch->index == index && ch->type == SR_CHANNEL_ANALOG)
+			return ch;
+	}
+
+	return NULL;
+}
+
+static int send_packet(struct sr_input *in, int type, const void *payload)
+{
+	struct sr_datafeed_packet packet;
+
+	packet.type = type;
+	packet.payload = payload;
+
+	return sr_session_send(in->sdi, &packet);
+}
+
+static int do_header(struct sr_input *in, struct reader *r, gboolean send)
+{
+	struct context *inc;
+	struct sr_datafeed_header header;
+	const uint8_t *name;
+	char *ch_name;
+	uint32_t i, num_channels, index, type;
+	uint16_t len;
+	gboolean enabled;
+
+	inc = in->priv;
+	header.feed_version = get_u32(r);
+	header.starttime.tv_sec = (time_t)get_u64(r);
+	header.starttime.tv_usec = get_u32(r);
+	num_channels = get_u32(r);
+	for (i = 0; i < num_channels && !r->truncated; i++) {
+		index = get_u32(r);
+		type = get_u32(r);
+		enabled = get_u8(r);
+		len = get_u16(r);
+		if (!(name = get_bytes(r, len)) || inc->channels_done)
+			continue;
+		ch_name = g_strndup((const char *)name, len);
+		sr_channel_new(in->sdi, index, type, enabled, ch_name);
+		g_free(ch_name);
+	}
+	if (r->truncated)
+		return SR_ERR_DATA;
+	inc->channels_done = TRUE;
+
+	if (!send)
+		return SR_OK;
+	inc->started = TRUE;
+
+	return send_packet(in, SR_DF_HEADER, &header);
+}
+
+static int do_meta(struct sr_input *in, struct reader *r)
+{
+	struct sr_datafeed_meta meta;
+	const uint8_t *type, *data;
+	char *type_str;
+	GVariant *value, *swapped;
+	uint32_t i, count, key, size;
+	uint16_t len;
+	int ret;
+
+	meta.config = NULL;
+	count = get_u32(r);
+	for (i = 0; i < count && !r->truncated; i++) {
+		key = get_u32(r);
+		len = get_u16(r);
+		type = get_bytes(r, len);
+		size = get_u32(r);
+		if (!type || !(data = get_bytes(r, size)))
+			break;
+		type_str = g_strndup((const char *)type, len);
+		if (!g_variant_type_string_is_valid(type_str)) {
+			sr_warn("Skipping meta item %u of invalid type '%s'.",
+				key, type_str);
+			g_free(type_str);
+			continue;
+		}
+		value = g_variant_new_from_data(G_VARIANT_TYPE(type_str),
+			g_memdup(data, size), size, FALSE, g_free, NULL);
+		g_free(type_str);
+		g_variant_ref_sink(value);
+		if (G_BYTE_ORDER == G_BIG_ENDIAN) {
+			swapped = g_variant_byteswap(value);
+			g_variant_unref(value);
+			value = swapped;
+		}
+		meta.config = g_slist_append(meta.config,
+			sr_config_new(key, value));
+		g_variant_unref(value);
+	}
+
+	ret = r->truncated ? SR_ERR_DATA : send_packet(in, SR_DF_META, &meta);
+	g_slist_free_full(meta.config, (GDestroyNotify)sr_config_free);
+
+	return ret;
+}
+
+static int do_analog(struct sr_input *in, struct reader *r)
+{
+	struct context *inc;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+	struct sr_channel *ch;
+	const uint8_t *data;
+	uint32_t num_samples, index;
+	uint16_t i, num_channels;
+	uint8_t unitsize, flags;
+	int8_t digits;
+	size_t size;
+	int ret;
+
+	inc = in->priv;
+	num_samples = get_u32(r);
+	unitsize = get_u8(r);
+	flags = get_u8(r);
+	digits = (int8_t)get_u8(r);
+	sr_analog_init(&analog, &encoding, &meaning, &spec, digits);
+	spec.spec_digits = (int8_t)get_u8(r);
+	encoding.unitsize = unitsize;
+	encoding.is_signed = (flags & SRNET_ANALOG_SIGNED) != 0;
+	encoding.is_float = (flags & SRNET_ANALOG_FLOAT) != 0;
+	encoding.is_bigendian = (flags & SRNET_ANALOG_BIGENDIAN) != 0;
+	encoding.is_digits_decimal = (flags & SRNET_ANALOG_DIGITS_DECIMAL) != 0;
+	get_rational(r, &encoding.scale);
+	get_rational(r, &encoding.offset);
+	meaning.mq = get_u32(r);
+	meaning.unit = get_u32(r);
+	meaning.mqflags = get_u64(r);
+	num_channels = get_u16(r);
+	for (i = 0; i < num_channels && !r->truncated; i++) {
+		index = get_u32(r);
+		if (!(ch = find_channel(in->sdi, index))) {
+			sr_err("Analog data of unknown channel %u.", index);
+			g_slist_free(meaning.channels);
+			return SR_ERR_DATA;
+		}
+		meaning.channels = g_slist_append(meaning.channels, ch);
+	}
+	size = (size_t)num_samples * num_channels * unitsize;
+	if (!unitsize || !encoding.scale.q || !encoding.offset.q
+			|| !(data = get_bytes(r, size))) {
+		g_slist_free(meaning.channels);
+		return SR_ERR_DATA;
+	}
+
+	if ((uintptr_t)data % unitsize) {
+		if (size > inc->abuf_size) {
+			g_free(inc->abuf);
+			inc->abuf = g_malloc(size);
+			inc->abuf_size = size;
+		}
+		memcpy(inc->abuf, data, size);
+		data = inc->abuf;
+	}
+	analog.data = (void *)data;
+	analog.num_samples = num_samples;
+	ret = send_packet(in, SR_DF_ANALOG, &analog);
+	g_slist_free(meaning.channels);
+
+	return ret;
+}
+
+static int do_logic_edges(struct sr_input *in, struct reader *r)
+{
+	struct sr_datafeed_logic_edges edges;
+	const uint8_t *offsets;
+	uint64_t i;
+	int ret;
+
+	edges.num_samples = get_u64(r);
+	edges.unitsize = get_u16(r);
+	edges.num_edges = get_u64(r);
+	if (edges.num_edges > (uint64_t)(r->end - r->p) / sizeof(uint64_t))
+		return SR_ERR_DATA;
+	offsets = get_bytes(r, edges.num_edges * sizeof(uint64_t));
+	edges.values = (void *)get_bytes(r, edges.num_edges * edges.unitsize);
+	if (r->truncated)
+		return SR_ERR_DATA;
+
+	edges.offsets = g_malloc(edges.num_edges * sizeof(uint64_t));
+	for (i = 0; i < edges.num_edges; i++)
+		edges.offsets[i] = RL64(offsets + i * sizeof(uint64_t));
+	ret = send_packet(in, SR_DF_LOGIC_EDGES, &edges);
+	g_free(edges.offsets);
+
+	return ret;
+}
+
+static int do_frames(struct sr_input *in, const uint8_t *buf, size_t len,
+		size_t *used, gboolean nested);
+
+static int do_zlib(struct sr_input *in, struct reader *r)
+{
+#ifdef HAVE_ZLIB
+	uint8_t *batch;
+	uLongf size;
+	size_t used;
+	int ret;
+
+	size = get_u32(r);
+	if (r->truncated || size > SRNET_FRAME_MAX_LEN)
+		return SR_ERR_DATA;
+	batch = g_malloc(size);
+	if (uncompress(batch, &size, r->p, r->end - r->p) != Z_OK) {
+		sr_err("Cannot decompress a batch.");
+		g_free(batch);
+		return SR_ERR_DATA;
+	}
+	ret = do_frames(in, batch, size, &used, TRUE);
+	if (ret == SR_OK && used != size)
+		ret = SR_ERR_DATA;
+	g_free(batch);
+
+	return ret;
+#else
+	(void)in;
+	(void)r;
+	sr_err("The stream is compressed, this needs zlib support.");
+
+	return SR_ERR_NA;
+#endif
+}
+
+static int do_frame(struct sr_input *in, uint8_t type,
+		const uint8_t *payload, size_t len, gboolean nested)
+{
+	struct context *inc;
+	struct sr_datafeed_logic logic;
+	struct sr_datafeed_frame frame;
+	struct sr_datafeed_gap gap;
+	struct reader r;
+
+	inc = in->priv;
+	r.p = payload;
+	r.end = payload + len;
+	r.truncated = FALSE;
+
+	switch (type) {
+	case SRNET_HEADER:
+		return do_header(in, &r, TRUE);
+	case SRNET_END:
+		inc->started = FALSE;
+		return send_packet(in, SR_DF_END, NULL);
+	case SRNET_META:
+		return do_meta(in, &r);
+	case SRNET_TRIGGER:
+		return send_packet(in, SR_DF_TRIGGER, NULL);
+	case SRNET_LOGIC:
+		logic.unitsize = get_u16(&r);
+		if (r.truncated || !logic.unitsize)
+			return SR_ERR_DATA;
+		logic.data = (void *)r.p;
+		logic.length = (r.end - r.p) - (r.end - r.p) % logic.unitsize;
+		return send_packet(in, SR_DF_LOGIC, &logic);
+	case SRNET_FRAME_BEGIN:
+		if (!len)
+			return send_packet(in, SR_DF_FRAME_BEGIN, NULL);
+		frame.index = get_u64(&r);
+		frame.has_time = get_u8(&r);
+		frame.time = get_dbl(&r);
+		if (r.truncated)
+			return SR_ERR_DATA;
+		return send_packet(in, SR_DF_FRAME_BEGIN, &frame);
+	case SRNET_FRAME_END:
+		return send_packet(in, SR_DF_FRAME_END, NULL);
+	case SRNET_ANALOG:
+		return do_analog(in, &r);
+	case SRNET_LOGIC_EDGES:
+		return do_logic_edges(in, &r);
+	case SRNET_GAP:
+		gap.sample_index = get_u64(&r);
+		gap.num_samples = get_u64(&r);
+		gap.reason = get_u32(&r);
+		if (r.truncated)
+			return SR_ERR_DATA;
+		return send_packet(in, SR_DF_GAP, &gap);
+	case SRNET_ZLIB:
+		if (nested)
+			return SR_ERR_DATA;
+		return do_zlib(in, &r);
+	default:
+		sr_dbg("Skipping frame of unknown type %d.", type);
+		return SR_OK;
+	}
+}
+
+/* Handle the complete frames in a buffer, tell how much they took. */
+static int do_frames(struct sr_input *in, const uint8_t *buf, size_t len,
+		size_t *used, gboolean nested)
+{
+	size_t offset, payload_len;
+	int ret;
+
+	offset = 0;
+	ret = SR_OK;
+	while (len - offset >= SRNET_FRAME_HEADER_LEN) {
+		payload_len = RL32(buf + offset + 4);
+		if (payload_len > SRNET_FRAME_MAX_LEN) {
+			sr_err("Frame of %zu bytes is too large.", payload_len);
+			ret = SR_ERR_DATA;
+			break;
+		}
+		if (len - offset - SRNET_FRAME_HEADER_LEN < payload_len)
+			break;
+		ret = do_frame(in, buf[offset], buf + offset +
+			SRNET_FRAME_HEADER_LEN, payload_len, nested);
+		if (ret != SR_OK) {
+			sr_err("Cannot handle a frame of type %d: %s.",
+				buf[offset], sr_strerror(ret));
+			break;
+		}
+		offset += SRNET_FRAME_HEADER_LEN + payload_len;
+	}
+	*used = offset;
+
+	return ret;
+}
+
+static int format_match(GHashTable *metadata, unsigned int *confidence)
+{
+	GString *buf;
+
+	buf = g_hash_table_lookup(metadata, GINT_TO_POINTER(SR_INPUT_META_HEADER));
+	if (!buf || buf->len < SRNET_MAGIC_LEN)
+		return SR_ERR;
+	if (memcmp(buf->str, SRNET_MAGIC, SRNET_MAGIC_LEN))
+		return SR_ERR;
+
+	*confidence = 1;
+
+	return SR_OK;
+}
+
+static int init(struct sr_input *in, GHashTable *options)
+{
+	(void)options;
+
+	in->sdi = g_malloc0(sizeof(struct sr_dev_inst));
+	in->priv = g_malloc0(sizeof(struct context));
+
+	return SR_OK;
+}
+
+/* Get the channels from the first header, for the device instance. */
+static int prepare_sdi(struct sr_input *in)
+{
+	const uint8_t *buf;
+	struct reader r;
+	size_t payload_len;
+
+	if (in->buf->len < SRNET_FRAME_HEADER_LEN)
+		return SR_OK;
+	buf = (const uint8_t *)in->buf->str;
+	if (buf[0] != SRNET_HEADER) {
+		sr_err("The stream does not start with a header.");
+		return SR_ERR_DATA;
+	}
+	payload_len = RL32(buf + 4);
+	if (payload_len > SRNET_FRAME_MAX_LEN)
+		return SR_ERR_DATA;
+	if (in->buf->len - SRNET_FRAME_HEADER_LEN < payload_len)
+		return SR_OK;
+
+	r.p = buf + SRNET_FRAME_HEADER_LEN;
+	r.end = r.p + payload_len;
+	r.truncated = FALSE;
+	if (do_header(in, &r, FALSE) != SR_OK)
+		return SR_ERR_DATA;
+	in->sdi_ready = TRUE;
+
+	return SR_OK;
+}
+
+static int process_buffer(struct sr_input *in)
+{
+	size_t used;
+	int ret;
+
+	ret = do_frames(in, (const uint8_t *)in->buf->str, in->buf->len,
+		&used, FALSE);
+	g_string_erase(in->buf, 0, used);
+
+	return ret;
+}
+
+static int receive(struct sr_input *in, GString *buf)
+{
+	struct context *inc;
+
+	inc = in->priv;
+	g_string_append_len(in->buf, buf->str, buf->len);
+
+	if (!inc->have_magic) {
+		if (in->buf->len < SRNET_MAGIC_LEN)
+			return SR_OK;
+		if (memcmp(in->buf->str, SRNET_MAGIC, SRNET_MAGIC_LEN)) {
+			sr_err("Not an srnet stream.");
+			return SR_ERR_DATA;
+		}
+		g_string_erase(in->buf, 0, SRNET_MAGIC_LEN);
+		inc->have_magic = TRUE;
+	}
+
+	if (!in->sdi_ready) {
+		/* sdi is ready once it has the channels, notify frontend. */
+		return prepare_sdi(in);
+	}
+
+	return process_buffer(in);
+}
+
+static int end(struct sr_input *in)
+{
+	struct context *inc;
+	int ret;
+
+	inc = in->priv;
+	ret = SR_OK;
+	if (in->sdi_ready)
+		ret = process_buffer(in);
+	if (in->buf->len)
+		sr_warn("The stream ends within a frame.");
+	if (inc->started)
+		std_session_send_df_end(in->sdi);
+	inc->started = FALSE;
+
+	return ret;
+}
+
+static void cleanup(struct sr_input *in)
+{
+	struct context *inc;
+
+	inc = in->priv;
+	g_free(inc->abuf);
+	inc->abuf = NULL;
+	inc->abuf_size = 0;
+}
+
+static int reset(struct sr_input *in)
+{
+	struct context *inc;
+
+	inc = in->priv;
+	cleanup(in);
+	/* Keep the channels, the next stream gets the same. */
+	inc->have_magic = FALSE;
+	inc->started = FALSE;
+	g_string_truncate(in->buf, 0);
+
+	return SR_OK;
+}
+
+SR_PRIV struct sr_input_module input_srnet = {
+	.id = "srnet",
+	.name = "srnet",
+	.desc = "Packet stream of the srnet output",
+	.exts = (const char*[]){"srnet", NULL},
+	.metadata = { SR_INPUT_META_HEADER | SR_INPUT_META_REQUIRED },
+	.format_match = format_match,
+	.init = init,
+	.receive = receive,
+	.end = end,
+	.reset = reset,
+	.cleanup = cleanup,
+};
@@ -100,7 +100,14 @@ struct context {
 	int32_t last_record;
 	uint64_t samplerate;
 	double timestamp_scale;
-	GString *out_buf;
+	size_t unitsize;
+	size_t pod_count;
+	struct pod_layout {
+		uint32_t data_offset;
+		uint32_t clk_offset;
+		uint8_t clk_bit;
+	} pods[MAX_POD_COUNT];
+	struct feed_queue_logic *feed_logic;
 };
 
 static int process_header(GString *buf, struct context *inc);
@@ -182,7 +189,11 @@ static int init(struct sr_input *in, GHashTable *options)
 		return SR_ERR;
 	}
 
-	inc->out_buf = g_string_sized_new(CHUNK_SIZE);
+	inc->unitsize = (g_slist_length(in->sdi->channels) + 7) / 8;
+	inc->feed_logic = feed_queue_logic_alloc(in->sdi,
+		CHUNK_SIZE / inc->unitsize, inc->unitsize);
+	if (!inc->feed_logic)
+		return SR_ERR_MALLOC;
 
 	return SR_OK;
 }
@@ -415,40 +426,19 @@ static void send_metadata(struct sr_input *in)
 	inc->meta_sent = TRUE;
 }
 
-static void flush_output_buffer(struct sr_input *in)
+/*
+ * Determine where the data of the enabled pods is located in a record,
+ * so that records can get decoded without checking the device and the
+ * record mode for each of them.
+ */
+static int prepare_pod_layout(struct context *inc)
 {
-	struct context *inc;
-	struct sr_datafeed_packet packet;
-	struct sr_datafeed_logic logic;
-
-	inc = in->priv;
-
-	if (inc->out_buf->len) {
-		packet.type = SR_DF_LOGIC;
-		packet.payload = &logic;
-		logic.unitsize = (g_slist_length(in->sdi->channels) + 7) / 8;
-		logic.data = inc->out_buf->str;
-		logic.length = inc->out_buf->len;
-		sr_session_send(in->sdi, &packet);
-
-		g_string_truncate(inc->out_buf, 0);
-	}
-}
-
-static void process_record_pi(struct sr_input *in, gsize start)
-{
-	struct context *inc;
-	uint64_t timestamp, next_timestamp;
-	uint32_t pod_data;
-	char single_payload[12 * 3];
-	GString *buf;
-	int i, pod_count, clk_offset, packet_count, pod;
-	int payload_bit, payload_len, value;
-
-	inc = in->priv;
-	buf = in->buf;
+	struct pod_layout *layout;
+	int pod, max_pods;
+	uint32_t clk_offset, data_offset, clk_byte;
 
 	/*
+	 * PowerIntegrator records:
 	 * 0x00 u8  timestamp
 	 * 0x08 u16 A15..0
 	 * 0x0A u16 B15..0
@@ -469,178 +459,187 @@ static void process_record_pi(struct sr_input *in, gsize start)
 	 * 0x2A/19 u8 ??
 	 * 0x2B/1A u8 ??
 	 * 0x2C/1B u8 ??
+	 *
+	 * IProbe records:
+	 * 0x00 u64 timestamp
+	 * 0x08 u16 IP15..0
+	 * 0x0A u8  CLK
 	 */
 
-	timestamp = RL64(buf->str + start);
-
-	if (inc->record_mode == AD_MODE_500MHZ) {
-		pod_count = 6;
-		clk_offset = 0x18;
-	} else {
-		pod_count = 12;
-		clk_offset = 0x28;
+	switch (inc->device) {
+	case AD_DEVICE_PI:
+		if (inc->record_mode == AD_MODE_500MHZ) {
+			max_pods = 6;
+			clk_offset = 0x18;
+		} else {
+			max_pods = 12;
+			clk_offset = 0x28;
+		}
+		break;
+	case AD_DEVICE_IPROBE:
+		max_pods = 1;
+		clk_offset = 0x0A;
+		break;
+	default:
+		sr_err("Trying to process records for unknown device!");
+		return SR_ERR;
 	}
 
-	payload_bit = 0;
-	payload_len = 0;
-	single_payload[0] = 0;
-
-	for (pod = 0; pod < pod_count; pod++) {
+	inc->pod_count = 0;
+	for (pod = 0; pod < MAX_POD_COUNT; pod++) {
 		if (!inc->pod_status[pod])
 			continue;
-
-		switch (pod) {
-		case 0: /* A */
-			pod_data = RL16(buf->str + start + 0x08);
-			pod_data |= (RL16(buf->str + start + clk_offset) & 1) << 16;
-			break;
-		case 1: /* B */
-			pod_data = RL16(buf->str + start + 0x0A);
-			pod_data |= (RL16(buf->str + start + clk_offset) & 2) << 15;
-			break;
-		case 2: /* C */
-			pod_data = RL16(buf->str + start + 0x0C);
-			pod_data |= (RL16(buf->str + start + clk_offset) & 4) << 14;
-			break;
-		case 3: /* D */
-			pod_data = RL16(buf->str + start + 0x0E);
-			pod_data |= (RL16(buf->str + start + clk_offset) & 8) << 13;
-			break;
-		case 4: /* E */
-			pod_data = RL16(buf->str + start + 0x10);
-			pod_data |= (RL16(buf->str + start + clk_offset) & 16) << 12;
-			break;
-		case 5: /* F */
-			pod_data = RL16(buf->str + start + 0x12);
-			pod_data |= (RL16(buf->str + start + clk_offset) & 32) << 11;
-			break;
-		case 6: /* J */
-			pod_data = RL16(buf->str + start + 0x18);
-			pod_data |= (RL16(buf->str + start + 0x29) & 1) << 16;
-			break;
-		case 7: /* K */
-			pod_data = RL16(buf->str + start + 0x1A);
-			pod_data |= (RL16(buf->str + start + 0x29) & 2) << 15;
-			break;
-		case 8: /* L */
-			pod_data = RL16(buf->str + start + 0x1C);
-			pod_data |= (RL16(buf->str + start + 0x29) & 4) << 14;
-			break;
-		case 9: /* M */
-			pod_data = RL16(buf->str + start + 0x1E);
-			pod_data |= (RL16(buf->str + start + 0x29) & 8) << 13;
-			break;
-		case 10: /* N */
-			pod_data = RL16(buf->str + start + 0x20);
-			pod_data |= (RL16(buf->str + start + 0x29) & 16) << 12;
-			break;
-		case 11: /* O */
-			pod_data = RL16(buf->str + start + 0x22);
-			pod_data |= (RL16(buf->str + start + 0x29) & 32) << 11;
-			break;
-		default:
-			pod_data = 0;
-			sr_err("Don't know how to obtain data for pod %d.", pod);
+		if (pod >= max_pods) {
+			sr_err("Pod %c has no data in this file.",
+				get_pod_name_from_id(pod));
+			return SR_ERR_DATA;
 		}
-
-		for (i = 0; i < 17; i++) {
-			value = (pod_data >> i) & 1;
-			single_payload[payload_len] |= value << payload_bit;
-
-			payload_bit++;
-			if (payload_bit > 7) {
-				payload_bit = 0;
-				payload_len++;
-				single_payload[payload_len] = 0;
-			}
+		if (pod < 6) {
+			data_offset = 0x08 + 2 * pod;
+			clk_byte = clk_offset;
+		} else {
+			data_offset = 0x18 + 2 * (pod - 6);
+			clk_byte = 0x29;
 		}
+		if (data_offset + 2 > inc->record_size ||
+		    clk_byte + 1 > inc->record_size) {
+			sr_err("Record size %u is too small for pod %c.",
+				inc->record_size, get_pod_name_from_id(pod));
+			return SR_ERR_DATA;
+		}
+		layout = &inc->pods[inc->pod_count++];
+		layout->data_offset = data_offset;
+		layout->clk_offset = clk_byte;
+		layout->clk_bit = pod % 6;
 	}
 
-	/* Make sure that payload_len accounts for any incomplete bytes used. */
-	if (payload_bit)
-		payload_len++;
-
-	i = (g_slist_length(in->sdi->channels) + 7) / 8;
-	if (payload_len != i) {
-		sr_err("Payload unit size is %d but should be %d!", payload_len, i);
-		return;
-	}
-
-	if (timestamp == inc->trigger_timestamp && !inc->trigger_sent) {
-		sr_dbg("Trigger @%lf s, record #%d.",
-			timestamp * TIMESTAMP_RESOLUTION, inc->cur_record);
-		std_session_send_df_trigger(in->sdi);
-		inc->trigger_sent = TRUE;
+	if ((inc->pod_count * 17 + 7) / 8 != inc->unitsize) {
+		sr_err("Payload unit size is %zu but should be %zu!",
+			(inc->pod_count * 17 + 7) / 8, inc->unitsize);
+		return SR_ERR_BUG;
 	}
 
-	/* Is this the last record in the file? */
-	if (inc->cur_record == inc->record_count - 1) {
-		/* It is, so send the last sample data only once. */
-		g_string_append_len(inc->out_buf, single_payload, payload_len);
-	} else {
-		/* It's not, so fill the time gap by sending lots of data. */
-		next_timestamp = RL64(buf->str + start + inc->record_size);
-		packet_count = (int)(next_timestamp - timestamp) / inc->timestamp_scale;
-
-		/* Make sure we send at least one data set. */
-		if (packet_count == 0)
-			packet_count = 1;
+	return SR_OK;
+}
 
-		for (i = 0; i < packet_count; i++)
-			g_string_append_len(inc->out_buf, single_payload, payload_len);
+/*
+ * Decode one record into a sample of the session feed. The 16 data
+ * bits and the clock bit of every enabled pod get packed without gaps.
+ */
+static void decode_record(const struct context *inc,
+	const uint8_t *rec, uint8_t *sample)
+{
+	const struct pod_layout *layout;
+	uint64_t acc;
+	uint32_t pod_data;
+	size_t idx;
+	int bits;
+
+	acc = 0;
+	bits = 0;
+	for (idx = 0; idx < inc->pod_count; idx++) {
+		layout = &inc->pods[idx];
+		pod_data = RL16(&rec[layout->data_offset]);
+		pod_data |= ((R8(&rec[layout->clk_offset]) >> layout->clk_bit) & 1) << 16;
+		acc |= (uint64_t)pod_data << bits;
+		bits += 17;
+		while (bits >= 8) {
+			*sample++ = acc & 0xff;
+			acc >>= 8;
+			bits -= 8;
+		}
 	}
-
-	if (inc->out_buf->len >= CHUNK_SIZE)
-		flush_output_buffer(in);
+	if (bits)
+		*sample = acc & 0xff;
 }
 
-static void process_record_iprobe(struct sr_input *in, gsize start)
+/*
+ * Decode a block of records. Records which span a single sample are
+ * written into the feed queue's buffer as they get decoded. Longer
+ * time gaps between records are filled with copies of the sample.
+ * Returns the number of bytes consumed in *used.
+ */
+static int process_records(struct sr_input *in, size_t len, size_t *used)
 {
 	struct context *inc;
-	uint64_t timestamp, next_timestamp;
-	char single_payload[3];
-	int i, payload_len, packet_count;
+	const uint8_t *rec;
+	uint8_t sample[(MAX_POD_COUNT * 17 + 7) / 8];
+	uint8_t *wrptr;
+	uint64_t timestamp, next_timestamp, count;
+	size_t pos, space, filled;
+	int ret;
 
 	inc = in->priv;
+	rec = (const uint8_t *)in->buf->str;
+	wrptr = NULL;
+	space = 0;
+	filled = 0;
+
+	for (pos = 0; pos < len && !inc->records_read; pos += inc->record_size) {
+		timestamp = RL64(&rec[pos]);
+
+		/* Is this the last record in the file? */
+		if (inc->cur_record == inc->record_count - 1) {
+			/* It is, so send the last sample data only once. */
+			count = 1;
+		} else {
+			/* It's not, so fill the time gap by sending lots of data. */
+			next_timestamp = RL64(&rec[pos + inc->record_size]);
+			count = 0;
+			if (next_timestamp > timestamp)
+				count = (next_timestamp - timestamp) / inc->timestamp_scale;
+
+			/* Make sure we send at least one data set. */
+			if (count == 0)
+				count = 1;
+		}
 
-	/*
-	 * 0x00 u64 timestamp
-	 * 0x08 u16 IP15..0
-	 * 0x0A u8  CLK
-	 */
-
-	timestamp = RL64(in->buf->str + start);
-	single_payload[0] = R8(in->buf->str + start + 0x08);
-	single_payload[1] = R8(in->buf->str + start + 0x09);
-	single_payload[2] = R8(in->buf->str + start + 0x0A) & 1;
-	payload_len = 3;
-
-	if (timestamp == inc->trigger_timestamp && !inc->trigger_sent) {
-		sr_dbg("Trigger @%lf s, record #%d.",
-			timestamp * TIMESTAMP_RESOLUTION, inc->cur_record);
-		std_session_send_df_trigger(in->sdi);
-		inc->trigger_sent = TRUE;
-	}
-
-	/* Is this the last record in the file? */
-	if (inc->cur_record == inc->record_count - 1) {
-		/* It is, so send the last sample data only once. */
-		g_string_append_len(inc->out_buf, single_payload, payload_len);
-	} else {
-		/* It's not, so fill the time gap by sending lots of data. */
-		next_timestamp = RL64(in->buf->str + start + inc->record_size);
-		packet_count = (int)(next_timestamp - timestamp) / inc->timestamp_scale;
+		if (timestamp == inc->trigger_timestamp && !inc->trigger_sent) {
+			ret = feed_queue_logic_commit(inc->feed_logic, filled);
+			if (ret == SR_OK)
+				ret = feed_queue_logic_flush(inc->feed_logic);
+			if (ret != SR_OK)
+				return ret;
+			wrptr = NULL;
+			space = filled = 0;
+			sr_dbg("Trigger @%lf s, record #%d.",
+				timestamp * TIMESTAMP_RESOLUTION, inc->cur_record);
+			std_session_send_df_trigger(in->sdi);
+			inc->trigger_sent = TRUE;
+		}
 
-		/* Make sure we send at least one data set. */
-		if (packet_count == 0)
-			packet_count = 1;
+		if (count == 1) {
+			if (filled == space) {
+				ret = feed_queue_logic_commit(inc->feed_logic, filled);
+				if (ret != SR_OK)
+					return ret;
+				wrptr = feed_queue_logic_get_space(inc->feed_logic, &space);
+				if (!wrptr)
+					return SR_ERR_MALLOC;
+				filled = 0;
+			}
+			decode_record(inc, &rec[pos], &wrptr[filled * inc->unitsize]);
+			filled++;
+		} else {
+			ret = feed_queue_logic_commit(inc->feed_logic, filled);
+			if (ret != SR_OK)
+				return ret;
+			wrptr = NULL;
+			space = filled = 0;
+			decode_record(inc, &rec[pos], sample);
+			ret = feed_queue_logic_submit(inc->feed_logic, sample, count);
+			if (ret != SR_OK)
+				return ret;
+		}
 
-		for (i = 0; i < packet_count; i++)
-			g_string_append_len(inc->out_buf, single_payload, payload_len);
+		inc->cur_record++;
+		if (inc->cur_record == inc->record_count)
+			inc->records_read = TRUE;
 	}
 
-	if (inc->out_buf->len >= CHUNK_SIZE)
-		flush_output_buffer(in);
+	*used = pos;
+
+	return feed_queue_logic_commit(inc->feed_logic, filled);
 }
 
 static void process_practice_token(struct sr_input *in, char *cmd_token)
@@ -755,7 +754,8 @@ static void process_practice(struct sr_input *in)
 static int process_buffer(struct sr_input *in)
 {
 	struct context *inc;
-	int i, chunk_size, res;
+	int chunk_size, res;
+	size_t used;
 
 	inc = in->priv;
 
@@ -764,6 +764,9 @@ static int process_buffer(struct sr_input *in)
 		g_string_erase(in->buf, 0, inc->header_size);
 		if (res != SR_OK)
 			return res;
+		res = prepare_pod_layout(inc);
+		if (res != SR_OK)
+			return res;
 	}
 
 	if (!inc->meta_sent) {
@@ -778,25 +781,14 @@ static int process_buffer(struct sr_input *in)
 		/* There needs to be at least one more record process_record() can peek into. */
 		chunk_size -= inc->record_size;
 
-		for (i = 0; (i < chunk_size) && (!inc->records_read); i += inc->record_size) {
-			switch (inc->device) {
-			case AD_DEVICE_PI:
-				process_record_pi(in, i);
-				break;
-			case AD_DEVICE_IPROBE:
-				process_record_iprobe(in, i);
-				break;
-			default:
-				sr_err("Trying to process records for unknown device!");
-				return SR_ERR;
-			}
-
-			inc->cur_record++;
-			if (inc->cur_record == inc->record_count)
-				inc->records_read = TRUE;
+		used = 0;
+		if (chunk_size > 0) {
+			res = process_records(in, chunk_size, &used);
+			if (res != SR_OK)
+				return res;
 		}
 
-		g_string_erase(in->buf, 0, i);
+		g_string_erase(in->buf, 0, used);
 	}
 
 	if (inc->records_read) {
@@ -832,7 +824,8 @@ static int end(struct sr_input *in)
 	else
 		ret = SR_OK;
 
-	flush_output_buffer(in);
+	if (ret == SR_OK)
+		ret = feed_queue_logic_flush(inc->feed_logic);
 
 	if (inc->meta_sent)
 		std_session_send_df_end(in->sdi);
@@ -850,11 +843,30 @@ static int reset(struct sr_input *in)
 	inc->trigger_sent = FALSE;
 	inc->cur_record = 0;
 
+	/* Discard samples which were queued but not sent yet. */
+	feed_queue_logic_free(inc->feed_logic);
+	inc->feed_logic = feed_queue_logic_alloc(in->sdi,
+		CHUNK_SIZE / inc->unitsize, inc->unitsize);
+	if (!inc->feed_logic)
+		return SR_ERR_MALLOC;
+
 	g_string_truncate(in->buf, 0);
 
 	return SR_OK;
 }
 
+static void cleanup(struct sr_input *in)
+{
+	struct context *inc;
+
+	inc = in->priv;
+	if (!inc)
+		return;
+
+	feed_queue_logic_free(inc->feed_logic);
+	inc->feed_logic = NULL;
+}
+
 static struct sr_option options[] = {
 	{ "podA", "Import pod A / iprobe",
 		"Create channels and data for pod A / iprobe", NULL, NULL },
@@ -908,5 +920,6 @@ SR_PRIV struct sr_input_module input_trace32_ad = {
 	.init = init,
 	.receive = receive,
 	.end = end,
+	.cleanup = cleanup,
 	.reset = reset,
 };
@@ -134,11 +134,15 @@ struct context {
 	uint64_t prev_timestamp;
 	uint64_t samplerate;
 	size_t vcdsignals; /* VCD signals (input) */
-	GSList *ignored_signals;
+	GHashTable *ignored_signals;
 	gboolean data_after_timestamp;
 	gboolean ignore_end_keyword;
 	gboolean skip_until_end;
 	GSList *channels;
+	struct signal_ids {
+		GSList *by_char[128];
+		GHashTable *by_name;
+	} signal_ids;
 	size_t unit_size;
 	size_t logic_count;
 	size_t analog_count;
@@ -152,11 +156,6 @@ struct context {
 	} conv_bits;
 	GString *scope_prefix;
 	struct feed_queue_logic *feed_logic;
-	struct split_state {
-		size_t alloced;
-		char **words;
-		gboolean in_use;
-	} split;
 	struct ts_stats {
 		size_t total_ts_seen;
 		uint64_t last_ts_value;
@@ -538,10 +537,8 @@ static gboolean parse_section(GString *buf, char **name, char **contents)
  * The repeated memory allocation is acceptable for small workloads like
  * parsing the header sections. But the heavy lifting for sample data is
  * done by DIY code to speedup execution. The use of glib routines would
- * severely hurt throughput. Allocated memory gets re-used while a strict
- * ping-pong pattern is assumed (each text line of input data enters and
- * leaves in a strict symmetrical manner, due to the organization of the
- * receive() routine and parse calls).
+ * severely hurt throughput. Words of the data section get taken from
+ * the input buffer one after another, and get terminated in place.
  */
 
 /* Remove empty parts from an array returned by g_strsplit(). */
@@ -563,107 +560,30 @@ static void remove_empty_parts(gchar **parts)
 	*dest = NULL;
 }
 
-static char **split_text_line(struct context *inc, char *text, size_t *count)
+/*
+ * Get the next whitespace separated word from the input text. The word
+ * gets terminated in place, the read position advances past the word.
+ * Returns NULL when the input text is exhausted.
+ */
+static char *next_text_word(char **text)
 {
-	struct split_state *state;
-	size_t counted, alloced, wanted;
-	char **words, *p, **new_words;
-
-	state = &inc->split;
+	char *p, *word;
 
-	if (count)
-		*count = 0;
-
-	if (state->in_use) {
-		sr_dbg("coding error, split() called while \"in use\".");
+	p = *text;
+	while (g_ascii_isspace(*p))
+		p++;
+	if (!*p) {
+		*text = p;
 		return NULL;
 	}
-
-	/*
-	 * Seed allocation when invoked for the first time. Assume
-	 * simple logic data, start with a few words per line. Will
-	 * automatically adjust with subsequent use.
-	 */
-	if (!state->alloced) {
-		alloced = 20;
-		words = g_malloc(sizeof(words[0]) * alloced);
-		if (!words)
-			return NULL;
-		state->alloced = alloced;
-		state->words = words;
-	}
-
-	/* Start with most recently allocated word list space. */
-	alloced = state->alloced;
-	words = state->words;
-	counted = 0;
-
-	/* As long as more input text remains ... */
-	p = text;
-	while (*p) {
-		/* Resize word list if needed. Just double the size. */
-		if (counted + 1 >= alloced) {
-			wanted = 2 * alloced;
-			new_words = g_realloc(words, sizeof(words[0]) * wanted);
-			if (!new_words) {
-				return NULL;
-			}
-			words = new_words;
-			alloced = wanted;
-			state->words = words;
-			state->alloced = alloced;
-		}
-
-		/* Skip leading spaces. */
-		while (g_ascii_isspace(*p))
-			p++;
-		if (!*p)
-			break;
-
-		/* Add found word to word list. */
-		words[counted++] = p;
-
-		/* Find end of the word. Terminate loop upon EOS. */
-		while (*p && !g_ascii_isspace(*p))
-			p++;
-		if (!*p)
-			break;
-
-		/* More text follows. Terminate the word. */
+	word = p;
+	while (*p && !g_ascii_isspace(*p))
+		p++;
+	if (*p)
 		*p++ = '\0';
-	}
+	*text = p;
 
-	/*
-	 * NULL terminate the word list. Provide its length so that
-	 * calling code need not re-iterate the list to get the count.
-	 */
-	words[counted] = NULL;
-	if (count)
-		*count = counted;
-	state->in_use = TRUE;
-
-	return words;
-}
-
-static void free_text_split(struct context *inc, char **words)
-{
-	struct split_state *state;
-
-	state = &inc->split;
-
-	if (words && words != state->words) {
-		sr_dbg("coding error, free() arg differs from split() result.");
-	}
-
-	/* "Double free" finally releases the memory. */
-	if (!state->in_use) {
-		g_free(state->words);
-		state->words = NULL;
-		state->alloced = 0;
-	}
-
-	/* Mark as no longer in use. */
-	state->in_use = FALSE;
+	return word;
 }
 
 static gboolean have_header(GString *buf)
@@ -809,6 +729,66 @@ static int parse_scope(struct context *inc, char *contents, gboolean is_up)
 	return SR_OK;
 }
 
+/*
+ * Map VCD signal identifiers to their channels. Generators assign short
+ * identifiers first, single character IDs directly index an array, and
+ * longer IDs are kept in a hash table. Several $var declarations can
+ * share an identifier, each entry is a list of channels (in the order
+ * of their declaration).
+ */
+static void add_signal_id(struct context *inc, struct vcd_channel *vcd_ch)
+{
+	struct signal_ids *ids;
+	const char *id;
+	GSList *l;
+
+	ids = &inc->signal_ids;
+	id = vcd_ch->identifier;
+	if (id[0] && !id[1] && (unsigned char)id[0] < G_N_ELEMENTS(ids->by_char)) {
+		l = ids->by_char[(unsigned char)id[0]];
+		ids->by_char[(unsigned char)id[0]] = g_slist_append(l, vcd_ch);
+		return;
+	}
+
+	if (!ids->by_name)
+		ids->by_name = g_hash_table_new_full(g_str_hash, g_str_equal,
+			NULL, (GDestroyNotify)g_slist_free);
+	l = g_hash_table_lookup(ids->by_name, id);
+	if (l)
+		(void)g_slist_append(l, vcd_ch);
+	else
+		g_hash_table_insert(ids->by_name, vcd_ch->identifier,
+			g_slist_append(NULL, vcd_ch));
+}
+
+static GSList *find_signal_id(struct context *inc, const char *id)
+{
+	struct signal_ids *ids;
+
+	ids = &inc->signal_ids;
+	if (id[0] && !id[1] && (unsigned char)id[0] < G_N_ELEMENTS(ids->by_char))
+		return ids->by_char[(unsigned char)id[0]];
+	if (!ids->by_name)
+		return NULL;
+
+	return g_hash_table_lookup(ids->by_name, id);
+}
+
+static void free_signal_ids(struct context *inc)
+{
+	struct signal_ids *ids;
+	size_t idx;
+
+	ids = &inc->signal_ids;
+	for (idx = 0; idx < G_N_ELEMENTS(ids->by_char); idx++) {
+		g_slist_free(ids->by_char[idx]);
+		ids->by_char[idx] = NULL;
+	}
+	if (ids->by_name)
+		g_hash_table_destroy(ids->by_name);
+	ids->by_name = NULL;
+}
+
 /**
  * Parse a $var section which describes a VCD signal ("variable").
  *
@@ -891,8 +871,10 @@ static int parse_header_var(struct context *inc, char *contents)
 	if (inc->options.maxchannels && next_size > inc->options.maxchannels) {
 		sr_warn("Skipping '%s%s', exceeds requested channel count %zu.",
 			ref, idx ? idx : "", inc->options.maxchannels);
-		inc->ignored_signals = g_slist_append(inc->ignored_signals,
-			g_strdup(id));
+		if (!inc->ignored_signals)
+			inc->ignored_signals = g_hash_table_new_full(g_str_hash,
+				g_str_equal, g_free, NULL);
+		g_hash_table_add(inc->ignored_signals, g_strdup(id));
 		g_strfreev(parts);
 		return SR_OK;
 	}
@@ -922,6 +904,7 @@ static int parse_header_var(struct context *inc, char *contents)
 		vcd_ch->type == SR_CHANNEL_ANALOG ? "A" : "L",
 		vcd_ch->array_index);
 	inc->channels = g_slist_append(inc->channels, vcd_ch);
+	add_signal_id(inc, vcd_ch);
 	g_strfreev(parts);
 
 	return SR_OK;
@@ -1314,17 +1297,12 @@ static void add_samples(const struct sr_input *in, size_t count, gboolean flush)
 	}
 }
 
-static gint vcd_compare_id(gconstpointer a, gconstpointer b)
-{
-	return strcmp((const char *)a, (const char *)b);
-}
-
 static gboolean is_ignored(struct context *inc, const char *id)
 {
-	GSList *ignored;
+	if (!inc->ignored_signals)
+		return FALSE;
 
-	ignored = g_slist_find_custom(inc->ignored_signals, id, vcd_compare_id);
-	return ignored != NULL;
+	return g_hash_table_contains(inc->ignored_signals, id);
 }
 
 /*
@@ -1374,10 +1352,8 @@ static void process_bits(struct context *inc, char *identifier,
 	size = 0;
 	have_int = FALSE;
 	int_val = 0;
-	for (l = inc->channels; l; l = l->next) {
+	for (l = find_signal_id(inc, identifier); l; l = l->next) {
 		vcd_ch = l->data;
-		if (g_strcmp0(identifier, vcd_ch->identifier) != 0)
-			continue;
 		if (vcd_ch->type == SR_CHANNEL_ANALOG) {
 			/* Special case for 'integer' VCD signal types. */
 			size = vcd_ch->size; /* Flag for "VCD signal found". */
@@ -1448,12 +1424,10 @@ static void process_real(struct context *inc, char *identifier, float real_val)
 	struct vcd_channel *vcd_ch;
 
 	found = FALSE;
-	for (l = inc->channels; l; l = l->next) {
+	for (l = find_signal_id(inc, identifier); l; l = l->next) {
 		vcd_ch = l->data;
 		if (vcd_ch->type != SR_CHANNEL_ANALOG)
 			continue;
-		if (g_strcmp0(identifier, vcd_ch->identifier) != 0)
-			continue;
 
 		/* Found our (analog) channel. */
 		found = TRUE;
@@ -1510,14 +1484,12 @@ static uint8_t vcd_char_to_value(char bit_char, int *warn)
 	return ~0;
 }
 
-/* Parse one text line of the data section. */
+/* Parse complete text lines of the data section. */
 static int parse_textline(const struct sr_input *in, char *lines)
 {
 	struct context *inc;
 	int ret;
-	char **words;
-	size_t word_count, word_idx;
-	char *curr_word, *next_word, curr_first;
+	char *curr_word, curr_first;
 	gboolean is_timestamp, is_section, is_real, is_multibit, is_singlebit;
 	uint64_t timestamp;
 	char *identifier, *endptr;
@@ -1526,30 +1498,18 @@ static int parse_textline(const struct sr_input *in, char *lines)
 	inc = in->priv;
 
 	/*
-	 * Split the caller's text lines into a list of space separated
-	 * words. Note that some of the branches consume the very next
-	 * words as well, and assume that both adjacent words will be
-	 * available when the first word is seen. This constraint applies
-	 * to bit vector data, multi-bit integers and real (float) data,
-	 * as well as single-bit data with whitespace before its
-	 * identifier (if that's valid in VCD, we'd accept it here).
-	 * The fact that callers always pass complete text lines should
-	 * make this assumption acceptable.
+	 * Take space separated words from the caller's text lines, in
+	 * place. Note that some of the branches consume the very next
+	 * word as well, and assume that it is available when the first
+	 * word is seen. This constraint applies to bit vector data,
+	 * multi-bit integers and real (float) data, as well as single-bit
+	 * data with whitespace before its identifier (if that's valid in
+	 * VCD, we'd accept it here). The fact that callers always pass
+	 * complete text lines should make this assumption acceptable.
 	 */
 	ret = SR_OK;
-	words = split_text_line(inc, lines, &word_count);
-	for (word_idx = 0; word_idx < word_count; word_idx++) {
-		/*
-		 * Make the next two words available, to simpilify code
-		 * paths below. The second word is optional here.
-		 */
-		curr_word = words[word_idx];
-		if (!curr_word && !curr_word[0])
-			continue;
+	while ((curr_word = next_text_word(&lines))) {
 		curr_first = g_ascii_tolower(curr_word[0]);
-		next_word = words[word_idx + 1];
-		if (next_word && !next_word[0])
-			next_word = NULL;
 
 		/*
 		 * Optionally skip some sections that can be interleaved
@@ -1730,8 +1690,7 @@ static int parse_textline(const struct sr_input *in, char *lines)
 			float real_val;
 
 			real_text = &curr_word[1];
-			identifier = next_word;
-			word_idx++;
+			identifier = next_text_word(&lines);
 			if (!*real_text || !identifier || !*identifier) {
 				sr_err("Unexpected real format.");
 				ret = SR_ERR_DATA;
@@ -1765,8 +1724,7 @@ static int parse_textline(const struct sr_input *in, char *lines)
 			 * we may never unify code paths at all here.
 			 */
 			bits_text = &curr_word[1];
-			identifier = next_word;
-			word_idx++;
+			identifier = next_text_word(&lines);
 
 			if (!*bits_text || !identifier || !*identifier) {
 				sr_err("Unexpected integer/vector format.");
@@ -1851,10 +1809,8 @@ static int parse_textline(const struct sr_input *in, char *lines)
 				break;
 			}
 			identifier = ++bits_text;
-			if (!*identifier) {
-				identifier = next_word;
-				word_idx++;
-			}
+			if (!*identifier)
+				identifier = next_text_word(&lines);
 			if (!identifier || !*identifier) {
 				sr_err("Identifier missing.");
 				ret = SR_ERR_DATA;
@@ -1878,7 +1834,6 @@ static int parse_textline(const struct sr_input *in, char *lines)
 		ret = SR_ERR_DATA;
 		break;
 	}
-	free_text_split(inc, words);
 
 	return ret;
 }
@@ -1889,7 +1844,7 @@ static int process_buffer(struct sr_input *in, gboolean is_eof)
 	uint64_t samplerate;
 	GVariant *gvar;
 	int ret;
-	char *rdptr, *endptr, *trimptr;
+	char *endptr;
 	size_t rdlen;
 
 	inc = in->priv;
@@ -1915,30 +1870,18 @@ static int process_buffer(struct sr_input *in, gboolean is_eof)
 	if (is_eof)
 		g_string_append_c(in->buf, '\n');
 
-	/* Find and process complete text lines in the input data. */
-	ret = SR_OK;
-	rdptr = in->buf->str;
-	while (TRUE) {
-		rdlen = &in->buf->str[in->buf->len] - rdptr;
-		endptr = g_strstr_len(rdptr, rdlen, "\n");
-		if (!endptr)
-			break;
-		trimptr = endptr;
-		*endptr++ = '\0';
-		while (g_ascii_isspace(*rdptr))
-			rdptr++;
-		while (trimptr > rdptr && g_ascii_isspace(trimptr[-1]))
-			*(--trimptr) = '\0';
-		if (!*rdptr) {
-			rdptr = endptr;
-			continue;
-		}
-		ret = parse_textline(in, rdptr);
-		rdptr = endptr;
-		if (ret != SR_OK)
-			break;
-	}
-	rdlen = rdptr - in->buf->str;
+	/*
+	 * Process all complete text lines in the input data in a single
+	 * pass. Line termination is just another word separator, and
+	 * words get taken from the buffer in place. An incomplete last
+	 * line is kept for the next invocation.
+	 */
+	endptr = g_strrstr_len(in->buf->str, in->buf->len, "\n");
+	if (!endptr)
+		return SR_OK;
+	*endptr++ = '\0';
+	ret = parse_textline(in, in->buf->str);
+	rdlen = endptr - in->buf->str;
 	g_string_erase(in->buf, 0, rdlen);
 
 	return ret;
@@ -2075,6 +2018,7 @@ static void cleanup(struct sr_input *in)
 
 	keep_header_for_reread(in);
 
+	free_signal_ids(inc);
 	g_slist_free_full(inc->channels, free_channel);
 	inc->channels = NULL;
 	feed_queue_logic_free(inc->feed_logic);
@@ -2087,9 +2031,9 @@ static void cleanup(struct sr_input *in)
 	inc->current_floats = NULL;
 	g_string_free(inc->scope_prefix, TRUE);
 	inc->scope_prefix = NULL;
-	g_slist_free_full(inc->ignored_signals, g_free);
+	if (inc->ignored_signals)
+		g_hash_table_destroy(inc->ignored_signals);
 	inc->ignored_signals = NULL;
-	free_text_split(inc, NULL);
 }
 
 static int reset(struct sr_input *in)
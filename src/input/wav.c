@@ -52,6 +52,7 @@ struct context {
 	int unitsize;
 	gboolean found_data;
 	gboolean create_channels;
+	gboolean native;
 };
 
 static int parse_wav_header(GString *buf, struct context *inc)
@@ -153,13 +154,12 @@ static int init(struct sr_input *in, GHashTable *options)
 {
 	struct context *inc;
 
-	(void)options;
-
 	in->sdi = g_malloc0(sizeof(struct sr_dev_inst));
 	in->priv = g_malloc0(sizeof(struct context));
 	inc = in->priv;
 
 	inc->create_channels = TRUE;
+	inc->native = g_variant_get_boolean(g_hash_table_lookup(options, "native"));
 
 	return SR_OK;
 }
@@ -189,6 +189,60 @@ static int find_data_chunk(GString *buf, int initial_offset)
 	return offset;
 }
 
+/*
+ * Send the PCM data as is, pointing into the input buffer. The encoding
+ * describes the file's sample format, consumers convert the values with
+ * sr_analog_to_float() when they need to.
+ */
+static void send_chunk_native(const struct sr_input *in, int offset,
+	int num_samples)
+{
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+	struct context *inc;
+
+	inc = in->priv;
+
+	/* TODO: Use proper 'digits' value for this device (and its modes). */
+	sr_analog_init(&analog, &encoding, &meaning, &spec, 2);
+	packet.type = SR_DF_ANALOG;
+	packet.payload = &analog;
+	analog.num_samples = num_samples;
+	analog.data = in->buf->str + offset;
+	analog.meaning->channels = in->sdi->channels;
+	analog.meaning->mq = 0;
+	analog.meaning->mqflags = 0;
+	analog.meaning->unit = 0;
+	encoding.unitsize = inc->unitsize;
+	encoding.is_bigendian = FALSE;
+	if (inc->fmt_code == WAVE_FORMAT_PCM_) {
+		encoding.is_float = FALSE;
+		switch (inc->unitsize) {
+		case 1:
+			/* 8-bit PCM samples are unsigned. */
+			encoding.is_signed = FALSE;
+			sr_rational_set(&encoding.scale, 1, UINT8_MAX);
+			break;
+		case 2:
+			encoding.is_signed = TRUE;
+			sr_rational_set(&encoding.scale, 1, INT16_MAX);
+			break;
+		case 4:
+			encoding.is_signed = TRUE;
+			sr_rational_set(&encoding.scale, 1, INT32_MAX);
+			break;
+		}
+	} else {
+		/* BINARY32 float */
+		encoding.is_float = TRUE;
+		encoding.is_signed = TRUE;
+	}
+	sr_session_send(in->sdi, &packet);
+}
+
 static void send_chunk(const struct sr_input *in, int offset, int num_samples)
 {
 	struct sr_datafeed_packet packet;
@@ -288,7 +342,10 @@ static int process_buffer(struct sr_input *in)
 			num_samples = max_chunk_samples;
 		else
 			num_samples = chunk_samples;
-		send_chunk(in, offset, num_samples);
+		if (inc->native)
+			send_chunk_native(in, offset, num_samples);
+		else
+			send_chunk(in, offset, num_samples);
 		offset += num_samples * inc->samplesize;
 		chunk_samples -= num_samples;
 		processed += num_samples;
@@ -368,7 +425,13 @@ static int end(struct sr_input *in)
 
 static int reset(struct sr_input *in)
 {
-	memset(in->priv, 0, sizeof(struct context));
+	struct context *inc;
+	gboolean native;
+
+	inc = in->priv;
+	native = inc->native;
+	memset(inc, 0, sizeof(*inc));
+	inc->native = native;
 
 	/*
 	 * We only want to create the sigrok channels once, so
@@ -380,12 +443,35 @@ static int reset(struct sr_input *in)
 	return SR_OK;
 }
 
+enum option_index {
+	OPT_NATIVE,
+	OPT_MAX,
+};
+
+static struct sr_option options[] = {
+	[OPT_NATIVE] = {
+		"native", "Native sample format",
+		"Send samples in the file's PCM format instead of converting them to float (default: off).",
+		NULL, NULL,
+	},
+	[OPT_MAX] = ALL_ZERO,
+};
+
+static const struct sr_option *get_options(void)
+{
+	if (!options[0].def)
+		options[OPT_NATIVE].def = g_variant_ref_sink(g_variant_new_boolean(FALSE));
+
+	return options;
+}
+
 SR_PRIV struct sr_input_module input_wav = {
 	.id = "wav",
 	.name = "WAV",
 	.desc = "Microsoft WAV file format data",
 	.exts = (const char*[]){"wav", NULL},
 	.metadata = { SR_INPUT_META_HEADER | SR_INPUT_META_REQUIRED },
+	.options = get_options,
 	.format_match = format_match,
 	.init = init,
 	.receive = receive,
@@ -63,6 +63,27 @@ struct zip_stat;
 #define SR_RECEIVE_DATA_CALLBACK(f) \
 	((sr_receive_data_callback) (void (*)(void)) (f))
 
+/*
+ * Static tracing probes of the "libsigrok" provider, for perf, bpftrace
+ * and SystemTap, e.g.:
+ *   bpftrace -e 'usdt:libsigrok.so:libsigrok:session_send_entry { ... }'
+ * Without --enable-usdt they are compiled out, and their arguments are
+ * not evaluated. Each probe takes up to three integer or pointer
+ * arguments, use "readelf -n libsigrok.so" for the list of probes.
+ */
+#ifdef HAVE_USDT
+#include <sys/sdt.h>
+#define SR_PROBE(name) DTRACE_PROBE(libsigrok, name)
+#define SR_PROBE1(name, a) DTRACE_PROBE1(libsigrok, name, a)
+#define SR_PROBE2(name, a, b) DTRACE_PROBE2(libsigrok, name, a, b)
+#define SR_PROBE3(name, a, b, c) DTRACE_PROBE3(libsigrok, name, a, b, c)
+#else
+#define SR_PROBE(name) do { } while (0)
+#define SR_PROBE1(name, a) do { } while (0)
+#define SR_PROBE2(name, a, b) do { } while (0)
+#define SR_PROBE3(name, a, b, c) do { } while (0)
+#endif
+
 /**
  * Read a 8 bits unsigned integer out of memory.
  * @param x a pointer to the input memory
@@ -1071,11 +1092,22 @@ struct sr_context {
 	struct sr_dev_driver **driver_list;
 #ifdef HAVE_LIBUSB_1_0
 	libusb_context *libusb_ctx;
+	/* Devices currently attached, kept by hotplug events, see usb.c. */
+	gboolean usb_hotplug;
+	libusb_hotplug_callback_handle usb_hotplug_handle;
+	GMutex usb_devices_mutex;
+	GSList *usb_devices;
+	GSList *hotplug_callbacks;
+	GThread *hotplug_thread;
+	gint hotplug_stop;
 #endif
 	sr_resource_open_callback resource_open_cb;
 	sr_resource_close_callback resource_close_cb;
 	sr_resource_read_callback resource_read_cb;
 	void *resource_cb_data;
+	/* Loaded resources of the default hooks, see sr_resource_load(). */
+	GHashTable *resource_cache;
+	GMutex resource_cache_mutex;
 };
 
 /** Input module metadata keys. */
@@ -1202,6 +1234,34 @@ struct sr_input_module {
 	 */
 	int (*receive) (struct sr_input *in, GString *buf);
 
+	/**
+	 * Send data from the caller's memory to the specified input instance.
+	 *
+	 * Like receive(), but the module parses the data in place where it
+	 * can, and only keeps what it didn't consume. The data is only valid
+	 * during the call.
+	 *
+	 * This function is optional, see sr_input_send_data().
+	 *
+	 * @retval SR_OK Success
+	 * @retval other Negative error code.
+	 */
+	int (*receive_data) (struct sr_input *in, const void *data, size_t len);
+
+	/**
+	 * Send a whole file to the specified input instance.
+	 *
+	 * Like receive(), this returns without processing data the moment
+	 * the device instance becomes ready, and gets called again for the
+	 * file's data.
+	 *
+	 * This function is optional, see sr_input_send_file().
+	 *
+	 * @retval SR_OK Success
+	 * @retval other Negative error code.
+	 */
+	int (*receive_file) (struct sr_input *in, const char *filename);
+
 	/**
 	 * Signal the input module no more data will come.
 	 *
@@ -1259,6 +1319,13 @@ struct sr_output {
 	 * there, and only flush it when it reaches a certain size.
 	 */
 	void *priv;
+
+	/**
+	 * Where the output goes when set, instead of the GString of
+	 * sr_output_send(). See sr_output_set_writer().
+	 */
+	sr_output_write_callback writer;
+	void *writer_data;
 };
 
 /** Output module driver. */
@@ -1352,6 +1419,13 @@ struct sr_output_module {
 	int (*cleanup) (struct sr_output *o);
 };
 
+/** Output which sr_output_flush() collects before it gets written. */
+#define SR_OUTPUT_FLUSH_SIZE (64 * 1024)
+
+SR_PRIV int sr_output_write(const struct sr_output *o,
+		const uint8_t *data, size_t length);
+SR_PRIV int sr_output_flush(const struct sr_output *o, GString *out);
+
 /** Transform module instance. */
 struct sr_transform {
 	/** A pointer to this transform's module. */
@@ -1368,6 +1442,11 @@ struct sr_transform {
 	 * state between calls into its callback functions.
 	 */
 	void *priv;
+
+	/** Number of packets passed in the current or last session run. */
+	uint64_t calls;
+	/** Time spent in the module in microseconds, see calls. */
+	uint64_t time_us;
 };
 
 struct sr_transform_module {
@@ -1413,7 +1492,8 @@ struct sr_transform_module {
 	 * This function is passed a pointer to every packet in the data feed.
 	 *
 	 * It can either return (in packet_out) a pointer to another packet
-	 * (possibly the exact same packet it got as input), or NULL.
+	 * (possibly the exact same packet it got as input), or NULL. Modules
+	 * which output several packets send them with sr_transform_send().
 	 *
 	 * @param t Pointer to the respective 'struct sr_transform'.
 	 * @param packet_in Pointer to a datafeed packet.
@@ -1428,6 +1508,32 @@ struct sr_transform_module {
 			struct sr_datafeed_packet *packet_in,
 			struct sr_datafeed_packet **packet_out);
 
+	/**
+	 * Whether the module processes logic and analog packets in place,
+	 * i.e. receive() modifies packet_in (including its sample data)
+	 * and returns it in packet_out. The session then makes sure that
+	 * packet_in is writable, without copying it for every such module
+	 * in the chain.
+	 */
+	gboolean in_place;
+
+	/**
+	 * Optional. Transform a block of the sample data of a logic
+	 * packet in place, like receive() would for the whole packet.
+	 * The session runs consecutive modules which provide this over one
+	 * cache sized block after the other, instead of each of them over
+	 * the whole packet. Only modules with in_place set can provide it.
+	 *
+	 * @param t Pointer to the respective 'struct sr_transform'.
+	 * @param logic The payload of the packet the block belongs to.
+	 * @param data The first sample of the block.
+	 * @param length The length of the block in bytes, a multiple of
+	 *               the unitsize.
+	 */
+	void (*logic_block) (const struct sr_transform *t,
+			const struct sr_datafeed_logic *logic,
+			uint8_t *data, uint64_t length);
+
 	/**
 	 * This function is called after the caller is finished using
 	 * the transform module, and can be used to free any internal
@@ -1458,6 +1564,21 @@ struct ser_hid_chip_functions;
 struct sr_bt_desc;
 typedef void (*serial_rx_chunk_callback)(struct sr_serial_dev_inst *serial,
 	void *cb_data, const void *buf, size_t count);
+typedef void (*serial_line_callback)(struct sr_serial_dev_inst *serial,
+	void *cb_data, const char *line, size_t len);
+struct ser_line_framer;
+struct ser_worker_port;
+/** Ring buffer of received data, see sr_ser_alloc_rx_queue(). */
+struct ser_rx_queue {
+	uint8_t *buf;
+	/** Capacity, a power of two. */
+	size_t size;
+	/** Read position, and number of queued bytes. */
+	size_t head, len;
+	/** Largest number of queued bytes, for diagnostics. */
+	size_t high_water;
+};
+
 struct sr_serial_dev_inst {
 	/** Port name, e.g. '/dev/tty42'. */
 	char *port;
@@ -1470,9 +1591,13 @@ struct sr_serial_dev_inst {
 		int parity_bits;
 		int stop_bits;
 	} comm_params;
-	GString *rcv_buffer;
+	struct ser_rx_queue *rcv_buffer;
 	serial_rx_chunk_callback rx_chunk_cb_func;
 	void *rx_chunk_cb_data;
+	/** Line framer of serial_line_source_add(), NULL when unused. */
+	struct ser_line_framer *line_framer;
+	/** Port of serial_worker_source_add(), NULL when unused. */
+	struct ser_worker_port *worker_port;
 #ifdef HAVE_LIBSERIALPORT
 	/** libserialport port handle */
 	struct sp_port *sp_data;
@@ -1540,12 +1665,28 @@ SR_PRIV int sr_log(int loglevel, const char *format, ...)
 SR_PRIV int sr_log(int loglevel, const char *format, ...) G_GNUC_PRINTF(2, 3);
 #endif
 
+extern SR_PRIV int sr_log_cur_level;
+
+/*
+ * Messages above SR_LOG_MAX_LEVEL are compiled out, builds can define
+ * it to e.g. SR_LOG_INFO in CPPFLAGS. Disabled messages don't evaluate
+ * their arguments.
+ */
+#ifndef SR_LOG_MAX_LEVEL
+#define SR_LOG_MAX_LEVEL SR_LOG_SPEW
+#endif
+#define sr_log_enabled(l) \
+	((l) <= SR_LOG_MAX_LEVEL && (l) <= sr_log_cur_level)
+
+#define sr_log_prefixed(l, ...) \
+	(sr_log_enabled(l) ? sr_log(l, LOG_PREFIX ": " __VA_ARGS__) : SR_OK)
+
 /* Message logging helpers with subsystem-specific prefix string. */
-#define sr_spew(...)	sr_log(SR_LOG_SPEW, LOG_PREFIX ": " __VA_ARGS__)
-#define sr_dbg(...)	sr_log(SR_LOG_DBG,  LOG_PREFIX ": " __VA_ARGS__)
-#define sr_info(...)	sr_log(SR_LOG_INFO, LOG_PREFIX ": " __VA_ARGS__)
-#define sr_warn(...)	sr_log(SR_LOG_WARN, LOG_PREFIX ": " __VA_ARGS__)
-#define sr_err(...)	sr_log(SR_LOG_ERR,  LOG_PREFIX ": " __VA_ARGS__)
+#define sr_spew(...)	sr_log_prefixed(SR_LOG_SPEW, __VA_ARGS__)
+#define sr_dbg(...)	sr_log_prefixed(SR_LOG_DBG,  __VA_ARGS__)
+#define sr_info(...)	sr_log_prefixed(SR_LOG_INFO, __VA_ARGS__)
+#define sr_warn(...)	sr_log_prefixed(SR_LOG_WARN, __VA_ARGS__)
+#define sr_err(...)	sr_log_prefixed(SR_LOG_ERR,  __VA_ARGS__)
 
 /*--- device.c --------------------------------------------------------------*/
 
@@ -1601,10 +1742,39 @@ struct sr_dev_inst {
 	void *priv;
 	/** Session to which this device is currently assigned. */
 	struct sr_session *session;
+	/** Counters of the current or last session run. */
+	struct sr_dev_stats stats;
+	/** Number of logic samples sent in the current session run. */
+	uint64_t logic_sample_index;
+	/** Number of analog samples sent in the current session run. */
+	uint64_t analog_sample_index;
+	/** Channel lookup tables, see sr_dev_channel_cache_get(). */
+	struct sr_dev_channel_cache *channel_cache;
+};
+
+/** Lookup tables of the channels of a device instance. */
+struct sr_dev_channel_cache {
+	/** The sdi->channels list the tables were built from. */
+	GSList *channels;
+	/** Logic channels, in list order. */
+	struct sr_channel **logic;
+	size_t num_logic;
+	/** Analog channels, in list order. */
+	struct sr_channel **analog;
+	size_t num_analog;
+	/** Bits of the indices of the enabled logic channels below 64. */
+	uint64_t logic_enabled_mask;
+	size_t num_logic_enabled;
+	size_t num_enabled;
+	/** Channels by name. */
+	GHashTable *by_name;
 };
 
 /* Generic device instances */
 SR_PRIV void sr_dev_inst_free(struct sr_dev_inst *sdi);
+SR_PRIV void sr_dev_channels_changed(const struct sr_dev_inst *sdi);
+SR_PRIV const struct sr_dev_channel_cache *sr_dev_channel_cache_get(
+		const struct sr_dev_inst *sdi);
 
 #ifdef HAVE_LIBUSB_1_0
 /* USB-specific instances */
@@ -1660,6 +1830,9 @@ SR_PRIV int sr_dev_acquisition_stop(struct sr_dev_inst *sdi);
 
 /*--- session.c -------------------------------------------------------------*/
 
+/* Number of enum sr_thread_kind values. */
+#define SR_THREAD_KINDS (SR_THREAD_DISPATCH - SR_THREAD_DEVICE + 1)
+
 struct sr_session {
 	/** Context this session exists in. */
 	struct sr_context *ctx;
@@ -1690,6 +1863,99 @@ struct sr_session {
 	unsigned int stop_check_id;
 	/** Whether the session has been started. */
 	gboolean running;
+
+	/** Buffer donated by the driver for packets currently being sent. */
+	struct sr_packet_buffer *send_buffer;
+	/** Packet currently being passed to the datafeed callbacks. */
+	const struct sr_datafeed_packet *send_packet;
+	/** Shared copy of send_packet's data, created by sr_packet_ref(). */
+	struct sr_packet_buffer *send_copy;
+	/** Host or hardware time of send_packet, in microseconds. */
+	int64_t send_timestamp;
+	/** Index of the first sample of send_packet in its device's stream. */
+	uint64_t send_sample_index;
+	/** Packets currently being passed to batch datafeed callbacks. */
+	const struct sr_datafeed_packet *send_batch;
+	size_t send_batch_len;
+	/** Times and first sample indices of the packets of send_batch. */
+	const int64_t *send_batch_timestamps;
+	const uint64_t *send_batch_indices;
+	/** Hardware time of the next packet to send, if valid. */
+	int64_t hw_timestamp;
+	gboolean hw_timestamp_valid;
+	/** Mutex protecting send_copy. */
+	GMutex send_mutex;
+
+	/** Queue depth of asynchronous datafeed dispatch, 0 if disabled. */
+	size_t dispatch_depth;
+	/** Policy of asynchronous datafeed dispatch, SR_DISPATCH_BLOCK etc. */
+	int dispatch_policy;
+	/** Asynchronous dispatch state while the session is running. */
+	struct dispatch_queue *dispatch_queue;
+	/** Counters of asynchronous datafeed dispatch. */
+	struct sr_dispatch_stats dispatch_stats;
+
+	/** Worker threads for thread-safe datafeed callbacks, or NULL. */
+	GThreadPool *callback_pool;
+	/** Mutex protecting pool_pending. */
+	GMutex pool_mutex;
+	/** Signalled when all pooled callbacks of a packet have returned. */
+	GCond pool_cond;
+	/** Number of pooled callbacks which did not return yet. */
+	unsigned int pool_pending;
+
+	/** Mutex protecting the packet trace ring. */
+	GMutex trace_mutex;
+	/** Packet trace ring, NULL if tracing is disabled. */
+	struct sr_trace_record *trace;
+	/** Capacity of the packet trace ring in records. */
+	size_t trace_size;
+	/** Index of the oldest record in the packet trace ring. */
+	size_t trace_first;
+	/** Number of records in the packet trace ring. */
+	size_t trace_count;
+	/** Number of records overwritten before they were read. */
+	uint64_t trace_lost;
+
+	/** Whether to run each device's acquisition on its own thread. */
+	gboolean dev_threads_enabled;
+	/** Scheduling of the session's threads, by enum sr_thread_kind. */
+	struct sr_thread_sched thread_sched[SR_THREAD_KINDS];
+	/** Per-device threads while the session is running. */
+	GSList *dev_threads;
+	/** Mutex protecting event_sources. */
+	GMutex sources_mutex;
+	/** Serializes packets sent from device threads. */
+	GRecMutex bus_mutex;
+
+	/** How to wait for descriptor events, SR_EVENT_BACKEND_GLIB etc. */
+	int event_backend;
+	/** Source watching the epoll set of the session, or NULL. */
+	struct epoll_source *epoll_source;
+
+	/** Writable copy of packets, for in-place transform modules. */
+	struct writable_packet *writable;
+	/** Whether the writable copy is in use by the packet being sent. */
+	gboolean writable_busy;
+};
+
+/**
+ * Reference counted sample data memory.
+ *
+ * Drivers can wrap their acquisition buffers in this, and attach them
+ * to the session while sending packets. Consumers which retain packets
+ * by means of sr_packet_ref() then share the driver's memory instead of
+ * copying it.
+ */
+struct sr_packet_buffer {
+	/** Number of references held. Only modify with atomic operations. */
+	gint refcount;
+	/** Start of the memory region. */
+	void *data;
+	/** Size of the memory region in bytes. */
+	size_t size;
+	/** Releases the memory region after the last reference is gone. */
+	GDestroyNotify free_func;
 };
 
 SR_PRIV int sr_session_source_add_internal(struct sr_session *session,
@@ -1718,11 +1984,51 @@ SR_PRIV int sr_session_source_remove_channel(struct sr_session *session,
 
 SR_PRIV int sr_session_send_meta(const struct sr_dev_inst *sdi,
 		uint32_t key, GVariant *var);
+SR_PRIV void sr_session_send_buffer_set(struct sr_session *session,
+		struct sr_packet_buffer *buf);
 SR_PRIV int sr_session_send(const struct sr_dev_inst *sdi,
 		const struct sr_datafeed_packet *packet);
+SR_PRIV int sr_session_send_timestamped(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, int64_t timestamp);
+SR_PRIV int sr_session_send_batch(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packets, size_t num_packets);
+SR_PRIV int sr_transform_send(const struct sr_transform *t,
+		const struct sr_datafeed_packet *packet,
+		int64_t timestamp, uint64_t sample_index);
+
+/** Routine which gets the packets of a thread, see sr_session_send_redirect_set(). */
+struct sr_send_redirect {
+	/* The timestamp is 0 for packets which were sent without one. */
+	int (*send)(const struct sr_dev_inst *sdi,
+			const struct sr_datafeed_packet *packet,
+			int64_t timestamp, void *cb_data);
+	void *cb_data;
+};
+SR_PRIV void sr_session_send_redirect_set(const struct sr_send_redirect *redirect);
+SR_PRIV const struct sr_thread_sched *sr_session_thread_sched_get(
+		const struct sr_session *session, int kind);
 SR_PRIV int sr_sessionfile_check(const char *filename);
 SR_PRIV struct sr_dev_inst *sr_session_prepare_sdi(const char *filename,
 		struct sr_session **session);
+SR_PRIV int sr_session_driver_range_set(struct sr_dev_inst *sdi,
+		uint64_t start, uint64_t count);
+SR_PRIV int sr_session_driver_threads_set(struct sr_dev_inst *sdi,
+		unsigned int threads);
+SR_PRIV int sr_session_driver_playback_set(struct sr_dev_inst *sdi,
+		enum sr_playback_mode mode);
+SR_PRIV int sr_session_driver_planes_set(struct sr_dev_inst *sdi,
+		gboolean planes);
+SR_PRIV int sr_session_driver_encoding_set(struct sr_dev_inst *sdi,
+		struct sr_channel *ch, const struct sr_analog_encoding *encoding);
+SR_PRIV int sr_session_driver_search(const struct sr_dev_inst *sdi,
+		struct sr_trigger *trigger, uint64_t max_matches, GArray *matches);
+
+SR_PRIV struct sr_packet_buffer *sr_packet_buffer_new(void *data,
+		size_t size, GDestroyNotify free_func);
+SR_PRIV struct sr_packet_buffer *sr_packet_buffer_ref(
+		struct sr_packet_buffer *buf);
+SR_PRIV void sr_packet_buffer_unref(struct sr_packet_buffer *buf);
+SR_PRIV gboolean sr_packet_buffer_reclaim(struct sr_packet_buffer *buf);
 
 /*--- session_file.c --------------------------------------------------------*/
 
@@ -1734,6 +2040,14 @@ SR_PRIV void sr_zip_discard(struct zip *archive);
 
 SR_PRIV GKeyFile *sr_sessionfile_read_metadata(struct zip *archive,
 			const struct zip_stat *entry);
+SR_PRIV void sr_sessionfile_planes_encode(uint8_t *out, const uint8_t *in,
+		size_t size, size_t unitsize);
+SR_PRIV void sr_sessionfile_planes_decode(uint8_t *out, const uint8_t *in,
+		size_t size, size_t unitsize);
+SR_PRIV void sr_sessionfile_delta_encode(uint8_t *out, const float *in,
+		size_t count);
+SR_PRIV void sr_sessionfile_delta_decode(float *out, const uint8_t *in,
+		size_t count);
 
 /*--- analog.c --------------------------------------------------------------*/
 
@@ -1742,6 +2056,25 @@ SR_PRIV int sr_analog_init(struct sr_datafeed_analog *analog,
                            struct sr_analog_meaning *meaning,
                            struct sr_analog_spec *spec,
                            int digits);
+SR_PRIV void sr_analog_strides(const struct sr_datafeed_analog *analog,
+		size_t *sample_stride, size_t *channel_stride);
+SR_PRIV size_t sr_analog_data_size(const struct sr_datafeed_analog *analog);
+SR_PRIV void sr_analog_set_raw_encoding(struct sr_analog_encoding *encoding,
+		uint8_t unitsize, gboolean is_signed, gboolean is_bigendian,
+		double scale, double offset);
+
+/*--- buffer.c --------------------------------------------------------------*/
+
+SR_PRIV void sr_mem_account(int kind, size_t size, gboolean alloc);
+SR_PRIV gboolean sr_mem_over_budget(void);
+SR_PRIV void *sr_buffer_alloc(int kind, size_t size);
+SR_PRIV void *sr_buffer_alloc0(int kind, size_t size);
+SR_PRIV void sr_buffer_free(void *buf);
+
+/*--- thread.c --------------------------------------------------------------*/
+
+SR_PRIV void sr_thread_sched_apply(const struct sr_thread_sched *sched,
+		const char *name);
 
 /*--- std.c -----------------------------------------------------------------*/
 
@@ -1762,7 +2095,11 @@ SR_PRIV int std_session_send_df_header(const struct sr_dev_inst *sdi);
 SR_PRIV int std_session_send_df_end(const struct sr_dev_inst *sdi);
 SR_PRIV int std_session_send_df_trigger(const struct sr_dev_inst *sdi);
 SR_PRIV int std_session_send_df_frame_begin(const struct sr_dev_inst *sdi);
+SR_PRIV int std_session_send_df_frame_segment(const struct sr_dev_inst *sdi,
+		uint64_t index, gboolean has_time, double time);
 SR_PRIV int std_session_send_df_frame_end(const struct sr_dev_inst *sdi);
+SR_PRIV int std_session_send_df_gap(const struct sr_dev_inst *sdi,
+		uint64_t num_samples, enum sr_gap_reason reason);
 SR_PRIV int std_dev_clear_with_callback(const struct sr_dev_driver *driver,
 		std_dev_clear_callback clear_private);
 SR_PRIV int std_dev_clear(const struct sr_dev_driver *driver);
@@ -1781,6 +2118,7 @@ extern SR_PRIV const uint32_t NO_OPTS[1];
 	std_opts_config_list(key, data, sdi, cg, ARRAY_AND_SIZE(scanopts), \
 		ARRAY_AND_SIZE(drvopts), ARRAY_AND_SIZE(devopts))
 
+SR_PRIV void std_gvar_cache_clear(void);
 SR_PRIV GVariant *std_gvar_tuple_array(const uint64_t a[][2], unsigned int n);
 SR_PRIV GVariant *std_gvar_tuple_rational(const struct sr_rational *r, unsigned int n);
 SR_PRIV GVariant *std_gvar_samplerates(const uint64_t samplerates[], unsigned int n);
@@ -1822,6 +2160,8 @@ SR_PRIV int std_dummy_set_handshake(struct sr_serial_dev_inst *serial,
 
 SR_PRIV int64_t sr_file_get_size(FILE *file);
 
+SR_PRIV void sr_resource_cache_init(struct sr_context *ctx);
+SR_PRIV void sr_resource_cache_cleanup(struct sr_context *ctx);
 SR_PRIV int sr_resource_open(struct sr_context *ctx,
 		struct sr_resource *res, int type, const char *name)
 		G_GNUC_WARN_UNUSED_RESULT;
@@ -1851,26 +2191,102 @@ SR_PRIV void sr_hexdump_free(GString *s);
 
 /*--- soft-trigger.c --------------------------------------------------------*/
 
+/* Circular buffer of the newest pre-trigger samples. */
+struct soft_trigger_ring {
+	uint8_t *buffer;
+	uint8_t *head;
+	int size;
+	int fill;
+};
+
+/* A trigger stage, compiled to masks of the logic sample bits. */
+struct soft_trigger_stage {
+	/* One word per 8 bytes of a sample in each mask. */
+	uint64_t *masks;
+	/* Required bit values, where care is set. */
+	uint64_t *value;
+	uint64_t *care;
+	/* Bits which must rise, fall or change since the last sample. */
+	uint64_t *rising;
+	uint64_t *falling;
+	uint64_t *edge;
+	gboolean has_edges;
+	/* Contradicting level matches. */
+	gboolean never;
+	/* No matches supplied. */
+	gboolean empty;
+};
+
 struct soft_trigger_logic {
 	const struct sr_dev_inst *sdi;
 	const struct sr_trigger *trigger;
-	int count;
 	int unitsize;
 	int cur_stage;
-	uint8_t *prev_sample;
-	uint8_t *pre_trigger_buffer;
-	uint8_t *pre_trigger_head;
-	int pre_trigger_size;
-	int pre_trigger_fill;
+	struct soft_trigger_stage *stages;
+	int num_stages;
+	int num_words;
+	/* The previous and the current sample, as words. */
+	uint64_t *prev_words;
+	uint64_t *cur_words;
+	gboolean have_prev;
+	struct soft_trigger_ring pre_trigger;
 };
 
-SR_PRIV int logic_channel_unitsize(GSList *channels);
 SR_PRIV struct soft_trigger_logic *soft_trigger_logic_new(
 		const struct sr_dev_inst *sdi, struct sr_trigger *trigger,
 		int pre_trigger_samples);
 SR_PRIV void soft_trigger_logic_free(struct soft_trigger_logic *st);
 SR_PRIV int soft_trigger_logic_check(struct soft_trigger_logic *st, uint8_t *buf,
 		int len, int *pre_trigger_samples);
+SR_PRIV int soft_trigger_logic_find(struct soft_trigger_logic *st,
+		const uint8_t *buf, int len);
+
+/* A match of an analog trigger stage on a level. */
+struct soft_trigger_analog_match {
+	int match;
+	float level;
+	/* Seen a value beyond the hysteresis band below or above level. */
+	gboolean armed_low;
+	gboolean armed_high;
+};
+
+/* An analog trigger stage, all of its matches are on one channel. */
+struct soft_trigger_analog_stage {
+	const struct sr_channel *ch;
+	struct soft_trigger_analog_match *matches;
+	int num_matches;
+};
+
+/* Pre-trigger samples of an analog channel, and what they mean. */
+struct soft_trigger_analog_channel {
+	struct sr_channel *ch;
+	struct soft_trigger_ring pre_trigger;
+	enum sr_mq mq;
+	enum sr_mqflag mqflags;
+	enum sr_unit unit;
+	int digits;
+};
+
+struct soft_trigger_analog {
+	const struct sr_dev_inst *sdi;
+	const struct sr_trigger *trigger;
+	float hysteresis;
+	int cur_stage;
+	struct soft_trigger_analog_stage *stages;
+	int num_stages;
+	struct soft_trigger_analog_channel *channels;
+	int num_channels;
+	/* Conversion buffer for the packet being checked. */
+	float *values;
+	uint32_t values_size;
+};
+
+SR_PRIV struct soft_trigger_analog *soft_trigger_analog_new(
+		const struct sr_dev_inst *sdi, struct sr_trigger *trigger,
+		int pre_trigger_samples, float hysteresis);
+SR_PRIV void soft_trigger_analog_free(struct soft_trigger_analog *sta);
+SR_PRIV int soft_trigger_analog_check(struct soft_trigger_analog *sta,
+		const struct sr_datafeed_analog *analog, int *pre_trigger_samples);
 
 /*--- serial.c --------------------------------------------------------------*/
 
@@ -1907,6 +2323,8 @@ SR_PRIV int serial_set_params(struct sr_serial_dev_inst *serial, int baudrate,
 		int bits, int parity, int stopbits, int flowcontrol, int rts, int dtr);
 SR_PRIV int serial_set_handshake(struct sr_serial_dev_inst *serial,
 		int rts, int dtr);
+SR_PRIV int serial_set_latency(struct sr_serial_dev_inst *serial,
+		int latency_ms, int low_latency);
 SR_PRIV int serial_set_paramstr(struct sr_serial_dev_inst *serial,
 		const char *paramstr);
 SR_PRIV int serial_readline(struct sr_serial_dev_inst *serial, char **buf,
@@ -1923,13 +2341,27 @@ SR_PRIV int serial_source_add(struct sr_session *session,
 		sr_receive_data_callback cb, void *cb_data);
 SR_PRIV int serial_source_remove(struct sr_session *session,
 		struct sr_serial_dev_inst *serial);
+SR_PRIV int serial_line_source_add(struct sr_session *session,
+		struct sr_serial_dev_inst *serial, int timeout,
+		serial_line_callback line_cb, sr_receive_data_callback cb,
+		void *cb_data);
+SR_PRIV int serial_worker_source_add(struct sr_dev_inst *sdi,
+		struct sr_serial_dev_inst *serial, int timeout,
+		sr_receive_data_callback cb);
+SR_PRIV int serial_worker_source_remove(struct sr_serial_dev_inst *serial);
 SR_PRIV GSList *sr_serial_find_usb(uint16_t vendor_id, uint16_t product_id);
 SR_PRIV int serial_timeout(struct sr_serial_dev_inst *port, int num_bytes);
 
+SR_PRIV void sr_ser_alloc_rx_queue(struct sr_serial_dev_inst *serial,
+	size_t size);
 SR_PRIV void sr_ser_discard_queued_data(struct sr_serial_dev_inst *serial);
 SR_PRIV size_t sr_ser_has_queued_data(struct sr_serial_dev_inst *serial);
 SR_PRIV void sr_ser_queue_rx_data(struct sr_serial_dev_inst *serial,
 		const uint8_t *data, size_t len);
+SR_PRIV uint8_t *sr_ser_rx_queue_reserve(struct sr_serial_dev_inst *serial,
+		size_t len);
+SR_PRIV void sr_ser_rx_queue_commit(struct sr_serial_dev_inst *serial,
+		size_t len);
 SR_PRIV size_t sr_ser_unqueue_rx_data(struct sr_serial_dev_inst *serial,
 		uint8_t *data, size_t len);
 
@@ -1949,12 +2381,16 @@ struct ser_lib_functions {
 			int flowcontrol, int rts, int dtr);
 	int (*set_handshake)(struct sr_serial_dev_inst *serial,
 			int rts, int dtr);
+	int (*set_latency)(struct sr_serial_dev_inst *serial,
+			int latency_ms, int low_latency);
 	int (*setup_source_add)(struct sr_session *session,
 			struct sr_serial_dev_inst *serial,
 			int events, int timeout,
 			sr_receive_data_callback cb, void *cb_data);
 	int (*setup_source_remove)(struct sr_session *session,
 			struct sr_serial_dev_inst *serial);
+	int (*get_poll_fd)(struct sr_serial_dev_inst *serial, int events,
+			gintptr *fd, unsigned int *poll_events);
 	GSList *(*list)(GSList *list, sr_ser_list_append_t append);
 	GSList *(*find_usb)(GSList *list, sr_ser_find_append_t append,
 			uint16_t vendor_id, uint16_t product_id);
@@ -2015,6 +2451,10 @@ SR_PRIV int sr_bt_config_cb_data(struct sr_bt_desc *desc,
 SR_PRIV int sr_bt_config_addr_local(struct sr_bt_desc *desc, const char *addr);
 SR_PRIV int sr_bt_config_addr_remote(struct sr_bt_desc *desc, const char *addr);
 SR_PRIV int sr_bt_config_rfcomm(struct sr_bt_desc *desc, size_t channel);
+SR_PRIV int sr_bt_config_mtu(struct sr_bt_desc *desc, uint16_t mtu);
+SR_PRIV int sr_bt_config_conn_interval(struct sr_bt_desc *desc,
+	uint16_t interval_min, uint16_t interval_max);
+SR_PRIV uint16_t sr_bt_get_mtu(struct sr_bt_desc *desc);
 SR_PRIV int sr_bt_config_notify(struct sr_bt_desc *desc,
 	uint16_t read_handle, uint16_t write_handle,
 	uint16_t cccd_handle, uint16_t cccd_value);
@@ -2055,8 +2495,65 @@ SR_PRIV int usb_source_add(struct sr_session *session, struct sr_context *ctx,
 		int timeout, sr_receive_data_callback cb, void *cb_data);
 SR_PRIV int usb_source_remove(struct sr_session *session, struct sr_context *ctx);
 SR_PRIV int usb_get_port_path(libusb_device *dev, char *path, int path_len);
+SR_PRIV void sr_usb_hotplug_init(struct sr_context *ctx);
+SR_PRIV void sr_usb_hotplug_cleanup(struct sr_context *ctx);
+SR_PRIV ssize_t sr_usb_device_list(struct sr_context *ctx,
+		libusb_device ***list);
+SR_PRIV int sr_usb_hotplug_callback_add(struct sr_context *ctx,
+		sr_hotplug_callback cb, void *cb_data);
+SR_PRIV int sr_usb_hotplug_callback_remove(struct sr_context *ctx,
+		sr_hotplug_callback cb, void *cb_data);
+SR_PRIV gboolean sr_usb_fpga_image_current(const struct sr_usb_dev_inst *usb,
+		const char *name, uint64_t size);
+SR_PRIV void sr_usb_fpga_image_record(const struct sr_usb_dev_inst *usb,
+		const char *name, uint64_t size);
 SR_PRIV gboolean usb_match_manuf_prod(libusb_device *dev,
 		const char *manufacturer, const char *product);
+struct sr_usb_xfer_pool;
+SR_PRIV struct sr_usb_xfer_pool *sr_usb_xfer_pool_new(
+		struct sr_usb_dev_inst *usb, size_t buffer_size, gboolean dev_mem);
+SR_PRIV void sr_usb_xfer_pool_free(struct sr_usb_xfer_pool *pool);
+SR_PRIV size_t sr_usb_xfer_pool_buffer_size(const struct sr_usb_xfer_pool *pool);
+SR_PRIV void *sr_usb_xfer_pool_get(struct sr_usb_xfer_pool *pool);
+SR_PRIV void sr_usb_xfer_buf_release(void *buf);
+
+struct sr_usb_stream;
+/** Gets the data of a transfer. Returns FALSE to stop the stream. */
+typedef gboolean (*sr_usb_stream_data_callback)(struct sr_dev_inst *sdi,
+		uint8_t *data, size_t length, void *cb_data);
+/** Runs once all transfers of a stream have come back. */
+typedef void (*sr_usb_stream_done_callback)(struct sr_dev_inst *sdi,
+		void *cb_data);
+/** Parameters of a USB bulk stream, see sr_usb_stream_start(). */
+struct sr_usb_stream_params {
+	/** Bulk IN endpoint address. */
+	unsigned char endpoint;
+	/** Transfer buffers, their size is the size of the transfers. */
+	struct sr_usb_xfer_pool *pool;
+	/** Number of transfers to start with. */
+	unsigned int num_transfers;
+	/** Number of transfers the queue may grow to, for adaptive mode. */
+	unsigned int max_transfers;
+	/** Timeout of the initial transfers in ms, 0 for none. */
+	unsigned int timeout;
+	/** Stop after this many empty transfers in a row, 0 for never. */
+	unsigned int max_empty;
+	/** Data rate of the device, to detect late transfers. Can be 0. */
+	uint64_t bytes_per_ms;
+	/** Bytes per sample, to count the samples lost in gaps. Can be 0. */
+	unsigned int unitsize;
+	/** Attach transfer buffers to the session, see sr_packet_buffer. */
+	gboolean zero_copy;
+	/** Handle libusb events on a thread of the stream's own. */
+	gboolean event_thread;
+	sr_usb_stream_data_callback data_cb;
+	sr_usb_stream_done_callback done_cb;
+	void *cb_data;
+};
+SR_PRIV int sr_usb_stream_start(struct sr_dev_inst *sdi,
+		const struct sr_usb_stream_params *params,
+		struct sr_usb_stream **stream);
+SR_PRIV void sr_usb_stream_stop(struct sr_usb_stream *stream);
 #endif
 
 /*--- binary_helpers.c ------------------------------------------------------*/
@@ -2143,6 +2640,92 @@ SR_PRIV int bv_send_analog_channel(const struct sr_dev_inst *sdi, struct sr_chan
  */
 SR_PRIV uint16_t sr_crc16(uint16_t crc, const uint8_t *buffer, int len);
 
+/*--- simd.c ----------------------------------------------------------------*/
+
+SR_PRIV void sr_simd_invert(uint8_t *data, size_t length);
+SR_PRIV void sr_simd_scale_float(float *data, size_t count, double scale,
+		double offset);
+
+/** Lookup tables and sizes for packing selected logic channels. */
+struct sr_bit_extract {
+	uint64_t mask;
+	uint16_t in_unitsize;
+	uint16_t out_unitsize;
+	/* Output bit position of the first selected bit of each byte. */
+	uint8_t shift[8];
+	/* Selected bits of every input byte value, packed. */
+	uint8_t table[8][256];
+};
+
+SR_PRIV void sr_simd_bit_extract_init(struct sr_bit_extract *be,
+		uint64_t mask, uint16_t in_unitsize);
+SR_PRIV void sr_simd_bit_extract(const struct sr_bit_extract *be,
+		const uint8_t *in, uint8_t *out, size_t num_samples);
+SR_PRIV void sr_simd_threshold(const float *in, float threshold,
+		uint8_t *out, size_t count);
+SR_PRIV void sr_simd_schmitt(const float *in, float lo_thr, float hi_thr,
+		uint8_t *state, uint8_t *out, size_t count);
+SR_PRIV void sr_simd_threshold_multi(const float *in, const float *thresholds,
+		size_t num_channels, uint8_t *out, size_t count);
+SR_PRIV size_t sr_simd_find_outside(const float *in, size_t count,
+		float lo, float hi);
+SR_PRIV size_t sr_simd_find_mismatch(const uint8_t *a, const uint8_t *b,
+		size_t length);
+/** Masks of a trigger stage, see sr_simd_find_candidate(). */
+struct sr_simd_pattern {
+	unsigned int unitsize;
+	/* The low unitsize bytes, as the samples are stored. */
+	uint32_t value;
+	uint32_t care;
+	uint32_t rising;
+	uint32_t falling;
+	uint32_t edge;
+};
+
+SR_PRIV size_t sr_simd_find_candidate(const struct sr_simd_pattern *pat,
+		const uint8_t *in, size_t length);
+/** Running statistics of floats, see sr_simd_stats_float(). */
+struct sr_simd_stats {
+	float min;
+	float max;
+	double sum;
+	double sum_sq;
+};
+
+SR_PRIV void sr_simd_stats_init(struct sr_simd_stats *stats);
+SR_PRIV void sr_simd_stats_float(struct sr_simd_stats *stats,
+		const float *in, size_t count);
+SR_PRIV void sr_simd_fill_u16(uint16_t *out, uint16_t value, size_t count);
+SR_PRIV void sr_simd_fill_u32(uint32_t *out, uint32_t value, size_t count);
+
+/** Sample formats with a sr_simd_to_float() kernel. */
+enum sr_simd_format {
+	SR_SIMD_I8 = 10000,
+	SR_SIMD_U8,
+	SR_SIMD_I16LE,
+	SR_SIMD_U16LE,
+	SR_SIMD_F32LE,
+	SR_SIMD_F32BE,
+};
+
+SR_PRIV void sr_simd_to_float(enum sr_simd_format format, const uint8_t *in,
+		float *out, size_t count, double scale, double offset);
+
+enum sr_simd_word_format {
+	/* 64 samples per word, the earliest in the least significant bit. */
+	SR_SIMD_WORD64LE_LSB = 10000,
+	/* 32 samples per word, the earliest in the most significant bit. */
+	SR_SIMD_WORD32LE_MSB,
+	/* 16 samples per word, the earliest in the least significant bit. */
+	SR_SIMD_WORD16LE_LSB,
+	/* 16 samples per word, the earliest in the most significant bit. */
+	SR_SIMD_WORD16LE_MSB,
+};
+
+SR_PRIV void sr_simd_deinterleave_words(enum sr_simd_word_format format,
+		const uint8_t *in, size_t length, uint16_t *out,
+		size_t num_words, uint16_t channel_mask);
+
 /*--- modbus/modbus.c -------------------------------------------------------*/
 
 struct sr_modbus_dev_inst {
@@ -2162,10 +2745,26 @@ struct sr_modbus_dev_inst {
 	int (*read_end)(void *priv);
 	int (*close)(void *priv);
 	void (*free)(void *priv);
+	/* Requests which may await their replies at once, 1 if NULL. */
+	unsigned int (*get_max_pending)(void *priv);
 	unsigned int read_timeout_ms;
 	void *priv;
 };
 
+/** Holding register ranges to read in few requests, see sr_modbus_read_plan_init(). */
+struct sr_modbus_read_plan {
+	unsigned int max_gap;
+	/* Requests across gaps failed, only merge adjacent ranges. */
+	gboolean split;
+	size_t num_ranges;
+	/* Sorted by address. */
+	struct {
+		int address;
+		int nb_registers;
+		uint16_t *registers;
+	} ranges[16];
+};
+
 SR_PRIV GSList *sr_modbus_scan(struct drv_context *drvc, GSList *options,
 		struct sr_dev_inst *(*probe_device)(struct sr_modbus_dev_inst *modbus));
 SR_PRIV struct sr_modbus_dev_inst *modbus_dev_inst_new(const char *resource,
@@ -2188,6 +2787,13 @@ SR_PRIV int sr_modbus_read_coils(struct sr_modbus_dev_inst *modbus,
 SR_PRIV int sr_modbus_read_holding_registers(struct sr_modbus_dev_inst *modbus,
                                              int address, int nb_registers,
                                              uint16_t *registers);
+SR_PRIV void sr_modbus_read_plan_init(struct sr_modbus_read_plan *plan,
+                                      unsigned int max_gap);
+SR_PRIV int sr_modbus_read_plan_add(struct sr_modbus_read_plan *plan,
+                                    int address, int nb_registers,
+                                    uint16_t *registers);
+SR_PRIV int sr_modbus_read_plan_run(struct sr_modbus_dev_inst *modbus,
+                                    struct sr_modbus_read_plan *plan);
 SR_PRIV int sr_modbus_write_coil(struct sr_modbus_dev_inst *modbus,
                                  int address, int value);
 SR_PRIV int sr_modbus_write_multiple_registers(struct sr_modbus_dev_inst*modbus,
@@ -2663,6 +3269,8 @@ struct sr_sw_limits {
 	uint64_t samples_read;
 	uint64_t frames_read;
 	uint64_t start_time;
+	uint64_t deadline;
+	gboolean time_expired;
 };
 
 SR_PRIV int sr_sw_limits_config_get(const struct sr_sw_limits *limits, uint32_t key,
@@ -2671,6 +3279,8 @@ SR_PRIV int sr_sw_limits_config_set(struct sr_sw_limits *limits, uint32_t key,
 	GVariant *data);
 SR_PRIV void sr_sw_limits_acquisition_start(struct sr_sw_limits *limits);
 SR_PRIV gboolean sr_sw_limits_check(struct sr_sw_limits *limits);
+SR_PRIV gboolean sr_sw_limits_update_and_check(struct sr_sw_limits *limits,
+	uint64_t samples_read);
 SR_PRIV void sr_sw_limits_update_samples_read(struct sr_sw_limits *limits,
 	uint64_t samples_read);
 SR_PRIV void sr_sw_limits_update_frames_read(struct sr_sw_limits *limits,
@@ -2687,6 +3297,13 @@ SR_API struct feed_queue_logic *feed_queue_logic_alloc(
 	size_t sample_count, size_t unit_size);
 SR_API int feed_queue_logic_submit(struct feed_queue_logic *q,
 	const uint8_t *data, size_t count);
+SR_API int feed_queue_logic_submit_many(struct feed_queue_logic *q,
+	const uint8_t *data, size_t count);
+SR_API int feed_queue_logic_submit_buffer(struct feed_queue_logic *q,
+	uint8_t *data, size_t count);
+SR_API uint8_t *feed_queue_logic_get_space(struct feed_queue_logic *q,
+	size_t *count);
+SR_API int feed_queue_logic_commit(struct feed_queue_logic *q, size_t count);
 SR_API int feed_queue_logic_flush(struct feed_queue_logic *q);
 SR_API void feed_queue_logic_free(struct feed_queue_logic *q);
 
@@ -2695,6 +3312,8 @@ SR_API struct feed_queue_analog *feed_queue_analog_alloc(
 	size_t sample_count, int digits, struct sr_channel *ch);
 SR_API int feed_queue_analog_submit(struct feed_queue_analog *q,
 	float data, size_t count);
+SR_API int feed_queue_analog_submit_many(struct feed_queue_analog *q,
+	const float *data, size_t count);
 SR_API int feed_queue_analog_flush(struct feed_queue_analog *q);
 SR_API void feed_queue_analog_free(struct feed_queue_analog *q);
 
@@ -42,8 +42,11 @@
  * @{
  */
 
-/* Currently selected libsigrok loglevel. Default: SR_LOG_WARN. */
-static int cur_loglevel = SR_LOG_WARN; /* Show errors+warnings per default. */
+/*
+ * Currently selected libsigrok loglevel. Default: SR_LOG_WARN.
+ * Visible to the sr_log_enabled() check of the logging macros.
+ */
+SR_PRIV int sr_log_cur_level = SR_LOG_WARN; /* Show errors+warnings per default. */
 
 /* Function prototype. */
 static int sr_logv(void *cb_data, int loglevel, const char *format,
@@ -63,6 +66,44 @@ static void *sr_log_cb_data = NULL;
 /** @endcond */
 static int64_t sr_log_start_time = 0;
 
+/** @cond PRIVATE */
+#define LOG_RECORD_TEXT 240
+#define LOG_DRAIN_INTERVAL_US (20 * 1000)
+/** @endcond */
+
+/* A message, formatted by the thread which logged it. */
+struct log_record {
+	int loglevel;
+	char text[LOG_RECORD_TEXT];
+};
+
+/*
+ * Single producer, single consumer ring of one logging thread, drained
+ * by the log thread. Only the producer writes 'head', only the consumer
+ * writes 'tail', so neither side takes a lock.
+ */
+struct log_ring {
+	struct log_record *records;
+	guint size;
+	guint head;
+	guint tail;
+	guint dropped;
+	gboolean dead;
+};
+
+static void log_ring_release(gpointer data);
+static void log_rings_drain(void);
+
+/* State of the asynchronous log sink, see sr_log_async_start(). */
+static gint log_async_active;
+static guint log_ring_size;
+static GPrivate log_thread_ring = G_PRIVATE_INIT(log_ring_release);
+static GMutex log_rings_mutex;
+static GSList *log_rings;
+/* Set while the log thread drains the rings, read by logging threads. */
+static GThread *log_thread;
+static gint log_thread_stop;
+
 /**
  * Set the libsigrok loglevel.
  *
@@ -90,7 +131,7 @@ SR_API int sr_log_loglevel_set(int loglevel)
 	if (loglevel >= LOGLEVEL_TIMESTAMP && sr_log_start_time == 0)
 		sr_log_start_time = g_get_monotonic_time();
 
-	cur_loglevel = loglevel;
+	sr_log_cur_level = loglevel;
 
 	sr_dbg("libsigrok loglevel set to %d.", loglevel);
 
@@ -106,7 +147,7 @@ SR_API int sr_log_loglevel_set(int loglevel)
  */
 SR_API int sr_log_loglevel_get(void)
 {
-	return cur_loglevel;
+	return sr_log_cur_level;
 }
 
 /**
@@ -194,7 +235,7 @@ static int sr_logv(void *cb_data, int loglevel, const char *format, va_list args
 
 	(void)loglevel;
 
-	if (cur_loglevel >= LOGLEVEL_TIMESTAMP) {
+	if (sr_log_cur_level >= LOGLEVEL_TIMESTAMP) {
 		elapsed_us = g_get_monotonic_time() - sr_log_start_time;
 
 		minutes = elapsed_us / G_TIME_SPAN_MINUTE;
@@ -231,18 +272,211 @@ static int sr_logv(void *cb_data, int loglevel, const char *format, va_list args
 	return SR_OK;
 }
 
+static int log_emit(int loglevel, const char *format, ...)
+{
+	int ret;
+	va_list args;
+
+	va_start(args, format);
+	ret = sr_log_cb(sr_log_cb_data, loglevel, format, args);
+	va_end(args);
+
+	return ret;
+}
+
+static void log_ring_free(struct log_ring *ring)
+{
+	g_free(ring->records);
+	g_free(ring);
+}
+
+/* Called on exit of a logging thread, the log thread frees the ring. */
+static void log_ring_release(gpointer data)
+{
+	struct log_ring *ring;
+
+	ring = data;
+	g_mutex_lock(&log_rings_mutex);
+	if (g_atomic_pointer_get(&log_thread)) {
+		g_atomic_int_set(&ring->dead, TRUE);
+	} else {
+		log_rings = g_slist_remove(log_rings, ring);
+		log_ring_free(ring);
+	}
+	g_mutex_unlock(&log_rings_mutex);
+}
+
+static struct log_ring *log_ring_get(void)
+{
+	struct log_ring *ring;
+
+	if ((ring = g_private_get(&log_thread_ring)))
+		return ring;
+
+	ring = g_malloc0(sizeof(*ring));
+	ring->size = log_ring_size;
+	ring->records = g_malloc(ring->size * sizeof(ring->records[0]));
+	g_private_set(&log_thread_ring, ring);
+	g_mutex_lock(&log_rings_mutex);
+	log_rings = g_slist_prepend(log_rings, ring);
+	g_mutex_unlock(&log_rings_mutex);
+
+	return ring;
+}
+
+/* Format a message into the calling thread's ring, drop it when full. */
+static int log_ring_push(int loglevel, const char *format, va_list args)
+{
+	struct log_ring *ring;
+	struct log_record *rec;
+	guint head;
+
+	ring = log_ring_get();
+	head = ring->head;
+	if (head - g_atomic_int_get(&ring->tail) >= ring->size) {
+		g_atomic_int_inc(&ring->dropped);
+		return SR_OK;
+	}
+	rec = &ring->records[head % ring->size];
+	rec->loglevel = loglevel;
+	g_vsnprintf(rec->text, sizeof(rec->text), format, args);
+	g_atomic_int_set(&ring->head, head + 1);
+
+	/*
+	 * When the sink stopped meanwhile, its last drain may have missed
+	 * the message. Pass it on here rather than leaving it behind.
+	 */
+	if (!g_atomic_pointer_get(&log_thread)) {
+		g_mutex_lock(&log_rings_mutex);
+		log_rings_drain();
+		g_mutex_unlock(&log_rings_mutex);
+	}
+
+	return SR_OK;
+}
+
+/* Pass queued messages on to the log callback. Caller holds the list lock. */
+static void log_rings_drain(void)
+{
+	struct log_ring *ring;
+	struct log_record *rec;
+	GSList *l, *next;
+	guint head, tail, dropped;
+
+	for (l = log_rings; l; l = next) {
+		next = l->next;
+		ring = l->data;
+		head = g_atomic_int_get(&ring->head);
+		for (tail = ring->tail; tail != head; tail++) {
+			rec = &ring->records[tail % ring->size];
+			log_emit(rec->loglevel, "%s", rec->text);
+			g_atomic_int_set(&ring->tail, tail + 1);
+		}
+		if ((dropped = g_atomic_int_and(&ring->dropped, 0)))
+			log_emit(SR_LOG_WARN, "log: %u messages dropped.", dropped);
+		if (g_atomic_int_get(&ring->dead)) {
+			log_rings = g_slist_delete_link(log_rings, l);
+			log_ring_free(ring);
+		}
+	}
+}
+
+static gpointer log_thread_run(gpointer data)
+{
+	(void)data;
+
+	while (!g_atomic_int_get(&log_thread_stop)) {
+		g_usleep(LOG_DRAIN_INTERVAL_US);
+		g_mutex_lock(&log_rings_mutex);
+		log_rings_drain();
+		g_mutex_unlock(&log_rings_mutex);
+	}
+
+	return NULL;
+}
+
+/**
+ * Log asynchronously through per-thread ring buffers.
+ *
+ * Messages get formatted into a ring buffer of the logging thread,
+ * without any locking, and a log thread passes them on to the log
+ * callback. Callbacks then no longer slow down acquisitions, but run
+ * in the log thread and see messages with a small delay. When a ring
+ * is full, its messages get dropped and the number of dropped messages
+ * logged. Messages are truncated to 239 characters.
+ *
+ * @param ring_size Number of messages each thread can queue, 0 for
+ *                  the default of 1024.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_BUG The asynchronous sink is already active.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_log_async_start(unsigned int ring_size)
+{
+	if (g_atomic_int_get(&log_async_active))
+		return SR_ERR_BUG;
+
+	/* Rings kept from an earlier start keep their size. */
+	log_ring_size = ring_size ? ring_size : 1024;
+	g_atomic_int_set(&log_thread_stop, 0);
+	g_mutex_lock(&log_rings_mutex);
+	g_atomic_pointer_set(&log_thread,
+		g_thread_new("sr-log", log_thread_run, NULL));
+	g_mutex_unlock(&log_rings_mutex);
+	g_atomic_int_set(&log_async_active, TRUE);
+
+	return SR_OK;
+}
+
+/**
+ * Stop logging asynchronously and pass queued messages on.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_BUG The asynchronous sink is not active.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_log_async_stop(void)
+{
+	GThread *thread;
+
+	if (!g_atomic_int_get(&log_async_active))
+		return SR_ERR_BUG;
+
+	g_atomic_int_set(&log_async_active, FALSE);
+	g_atomic_int_set(&log_thread_stop, 1);
+	thread = g_atomic_pointer_get(&log_thread);
+	g_thread_join(thread);
+
+	/* Messages queued after the thread's last drain go out here. */
+	g_mutex_lock(&log_rings_mutex);
+	g_atomic_pointer_set(&log_thread, NULL);
+	log_rings_drain();
+	g_mutex_unlock(&log_rings_mutex);
+
+	return SR_OK;
+}
+
 /** @private */
 SR_PRIV int sr_log(int loglevel, const char *format, ...)
 {
+	GThread *thread;
 	int ret;
 	va_list args;
 
 	/* Only output messages of at least the selected loglevel(s). */
-	if (loglevel > cur_loglevel)
+	if (loglevel > sr_log_cur_level)
 		return SR_OK;
 
 	va_start(args, format);
-	ret = sr_log_cb(sr_log_cb_data, loglevel, format, args);
+	/* Callbacks logging from the log thread must not queue. */
+	thread = g_atomic_pointer_get(&log_thread);
+	if (thread && thread != g_thread_self())
+		ret = log_ring_push(loglevel, format, args);
+	else
+		ret = sr_log_cb(sr_log_cb_data, loglevel, format, args);
 	va_end(args);
 
 	return ret;
@@ -25,9 +25,11 @@
 
 #define LOG_PREFIX "modbus"
 
+SR_PRIV extern const struct sr_modbus_dev_inst modbus_tcp_dev;
 SR_PRIV extern const struct sr_modbus_dev_inst modbus_serial_rtu_dev;
 
 static const struct sr_modbus_dev_inst *modbus_devs[] = {
+	&modbus_tcp_dev,
 #ifdef HAVE_SERIAL_COMM
 	&modbus_serial_rtu_dev, /* Must be last as it matches any resource. */
 #endif
@@ -478,6 +480,195 @@ SR_PRIV int sr_modbus_read_holding_registers(struct sr_modbus_dev_inst *modbus,
 	return SR_OK;
 }
 
+/**
+ * Start a plan of holding register reads.
+ *
+ * The ranges which get added to the plan are read in as few requests as
+ * possible. Ranges which overlap, touch, or are at most max_gap registers
+ * apart share a request, as long as it does not exceed the protocol's
+ * limit of 125 registers. This saves the request/response turnaround per
+ * range, which dominates the time of short reads.
+ *
+ * @param plan The plan to initialize.
+ * @param max_gap The most registers between ranges, which get read and
+ *                discarded to merge them.
+ */
+SR_PRIV void sr_modbus_read_plan_init(struct sr_modbus_read_plan *plan,
+		unsigned int max_gap)
+{
+	memset(plan, 0, sizeof(*plan));
+	plan->max_gap = max_gap;
+}
+
+/**
+ * Add a range of holding registers to a read plan.
+ *
+ * @param plan Previously initialized plan.
+ * @param address The Modbus address of the range's first register.
+ * @param nb_registers The number of registers in the range.
+ * @param registers Buffer to store the range's register values when the
+ *                  plan gets run, in the format which
+ *                  sr_modbus_read_holding_registers() uses.
+ *
+ * @return SR_OK upon success, SR_ERR_ARG upon invalid arguments.
+ */
+SR_PRIV int sr_modbus_read_plan_add(struct sr_modbus_read_plan *plan,
+		int address, int nb_registers, uint16_t *registers)
+{
+	size_t i;
+
+	if (address < 0 || nb_registers < 1 || nb_registers > 125
+	    || address + nb_registers > 0x10000 || !registers)
+		return SR_ERR_ARG;
+	if (plan->num_ranges == ARRAY_SIZE(plan->ranges))
+		return SR_ERR_ARG;
+
+	/* Keep the ranges sorted by address. */
+	for (i = plan->num_ranges; i > 0; i--) {
+		if (plan->ranges[i - 1].address <= address)
+			break;
+		plan->ranges[i] = plan->ranges[i - 1];
+	}
+	plan->ranges[i].address = address;
+	plan->ranges[i].nb_registers = nb_registers;
+	plan->ranges[i].registers = registers;
+	plan->num_ranges++;
+
+	return SR_OK;
+}
+
+struct read_plan_block {
+	size_t first, last;
+	int start, end;
+	gboolean has_gap;
+};
+
+/* Group the ranges of a plan into the blocks which get read at once. */
+static size_t read_plan_blocks(const struct sr_modbus_read_plan *plan,
+		struct read_plan_block *blocks)
+{
+	struct read_plan_block *b;
+	size_t num_blocks, last;
+	int range_end, max_gap;
+
+	max_gap = plan->split ? 0 : plan->max_gap;
+	num_blocks = 0;
+	for (last = 0; last < plan->num_ranges; ) {
+		b = &blocks[num_blocks++];
+		b->first = last;
+		b->start = plan->ranges[b->first].address;
+		b->end = b->start + plan->ranges[b->first].nb_registers;
+		b->has_gap = FALSE;
+		for (last = b->first + 1; last < plan->num_ranges; last++) {
+			range_end = plan->ranges[last].address
+				+ plan->ranges[last].nb_registers;
+			if (plan->ranges[last].address > b->end + max_gap)
+				break;
+			if (MAX(b->end, range_end) - b->start > 125)
+				break;
+			if (plan->ranges[last].address > b->end)
+				b->has_gap = TRUE;
+			b->end = MAX(b->end, range_end);
+		}
+		b->last = last;
+	}
+
+	return num_blocks;
+}
+
+/* Read the reply to a block's request, and distribute the values. */
+static int read_plan_block_reply(struct sr_modbus_dev_inst *modbus,
+		struct sr_modbus_read_plan *plan, const struct read_plan_block *b)
+{
+	uint16_t block[125];
+	size_t i;
+	int ret;
+
+	ret = sr_modbus_read_holding_registers(modbus, -1,
+		b->end - b->start, block);
+	if (ret != SR_OK)
+		return ret;
+
+	for (i = b->first; i < b->last; i++)
+		memcpy(plan->ranges[i].registers,
+			&block[plan->ranges[i].address - b->start],
+			plan->ranges[i].nb_registers * sizeof(block[0]));
+
+	return SR_OK;
+}
+
+/**
+ * Read the ranges of a plan.
+ *
+ * Some devices reject reads of unmapped registers in gaps. When a request
+ * which spans a gap fails, the plan only merges adjacent ranges from then
+ * on, and sets its 'split' flag. Callers which repeat a plan can keep it,
+ * or start their next plan with a max_gap of 0.
+ *
+ * Transports which match replies to their requests (Modbus TCP) get
+ * several requests sent before the first reply is read, so the requests
+ * of a plan share one round trip.
+ *
+ * @param modbus Previously initialized Modbus device structure.
+ * @param plan The plan to read.
+ *
+ * @return SR_OK upon success, SR_ERR_ARG upon invalid arguments,
+ *         SR_ERR_DATA upon invalid data, or SR_ERR on failure.
+ */
+SR_PRIV int sr_modbus_read_plan_run(struct sr_modbus_dev_inst *modbus,
+		struct sr_modbus_read_plan *plan)
+{
+	struct read_plan_block blocks[ARRAY_SIZE(plan->ranges)];
+	uint16_t discard[125];
+	size_t num_blocks, depth, sent, done, failed;
+	int ret;
+
+	if (!modbus || !plan)
+		return SR_ERR_ARG;
+
+	num_blocks = read_plan_blocks(plan, blocks);
+	depth = modbus->get_max_pending ?
+		modbus->get_max_pending(modbus->priv) : 1;
+	depth = MAX(depth, 1);
+
+	for (sent = done = 0; done < num_blocks; done++) {
+		for (; sent < num_blocks && sent - done < depth; sent++) {
+			sr_spew("Reading %d registers at %d for %zu ranges.",
+				blocks[sent].end - blocks[sent].start,
+				blocks[sent].start,
+				blocks[sent].last - blocks[sent].first);
+			ret = sr_modbus_read_holding_registers(modbus,
+				blocks[sent].start,
+				blocks[sent].end - blocks[sent].start, NULL);
+			if (ret != SR_OK) {
+				failed = sent;
+				goto drain;
+			}
+		}
+		ret = read_plan_block_reply(modbus, plan, &blocks[done]);
+		if (ret != SR_OK) {
+			failed = done++;
+			goto drain;
+		}
+	}
+
+	return SR_OK;
+
+drain:
+	/* Collect the replies still in flight before giving up or retrying. */
+	for (; done < sent; done++)
+		sr_modbus_read_holding_registers(modbus, -1,
+			blocks[done].end - blocks[done].start, discard);
+
+	if (ret == SR_ERR_DATA && blocks[failed].has_gap) {
+		sr_dbg("Merged register read failed, reading ranges apart.");
+		plan->split = TRUE;
+		return sr_modbus_read_plan_run(modbus, plan);
+	}
+
+	return ret;
+}
+
 /**
  * Send a Modbus write coil command.
  *
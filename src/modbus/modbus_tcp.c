@@ -0,0 +1,417 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#ifdef _WIN32
+#define _WIN32_WINNT 0x0501
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#endif
+#include <glib.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#ifndef _WIN32
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+#endif
+#include <errno.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+#define LOG_PREFIX "modbus_tcp"
+
+/*
+ * Modbus TCP frames a PDU with the MBAP header: transaction ID, protocol
+ * ID (0), the length of the remaining bytes, and the unit ID. Replies
+ * carry the request's transaction ID, so several requests can be in
+ * flight, and replies are matched to them regardless of their order.
+ */
+#define MBAP_HEADER_SIZE	7
+#define PDU_MAX_SIZE		253
+
+#define DEFAULT_PORT		"502"
+#define DEFAULT_PENDING		4
+#define MAX_PENDING		64
+#define READ_TIMEOUT_MS		1000
+
+struct modbus_tcp_reply {
+	uint16_t transaction_id;
+	size_t len;
+	uint8_t pdu[PDU_MAX_SIZE];
+};
+
+struct modbus_tcp {
+	char *address;
+	char *port;
+	int socket;
+	uint8_t unit_id;
+	unsigned int max_pending;
+	uint16_t next_transaction_id;
+	/* Transaction IDs of requests without a reply yet, oldest first. */
+	GQueue pending;
+	/* Replies which arrived ahead of the reply to an older request. */
+	GSList *early;
+	/* The reply which is being read. */
+	struct modbus_tcp_reply reply;
+	size_t reply_pos;
+};
+
+static int modbus_tcp_dev_inst_new(void *priv, const char *resource,
+		char **params, const char *serialcomm, int modbusaddr)
+{
+	struct modbus_tcp *tcp = priv;
+	char **param, *port, *value, *end;
+	long num;
+
+	(void)resource;
+	(void)serialcomm;
+
+	if (!params || !params[1]) {
+		sr_err("Invalid parameters.");
+		return SR_ERR;
+	}
+
+	tcp->max_pending = DEFAULT_PENDING;
+
+	/* The port is optional, and so is "pending=<count>" after it. */
+	port = params[2];
+	if (port && strchr(port, '='))
+		port = NULL;
+	for (param = port ? &params[3] : &params[2]; *param; param++) {
+		if (!(value = strchr(*param, '='))) {
+			sr_err("Invalid parameter '%s'.", *param);
+			return SR_ERR;
+		}
+		num = strtol(value + 1, &end, 10);
+		if (end == value + 1 || *end || num < 1 || num > MAX_PENDING) {
+			sr_err("Invalid value of parameter '%s'.", *param);
+			return SR_ERR;
+		}
+		if (g_str_has_prefix(*param, "pending=")) {
+			tcp->max_pending = num;
+		} else {
+			sr_err("Unknown parameter '%s'.", *param);
+			return SR_ERR;
+		}
+	}
+
+	tcp->address = g_strdup(params[1]);
+	tcp->port = g_strdup(port ? port : DEFAULT_PORT);
+	tcp->unit_id = modbusaddr;
+	tcp->socket = -1;
+	g_queue_init(&tcp->pending);
+
+	return SR_OK;
+}
+
+static int modbus_tcp_open(void *priv)
+{
+	struct modbus_tcp *tcp = priv;
+	struct addrinfo hints;
+	struct addrinfo *results, *res;
+	int err, one;
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_protocol = IPPROTO_TCP;
+
+	err = getaddrinfo(tcp->address, tcp->port, &hints, &results);
+	if (err) {
+		sr_err("Address lookup failed: %s:%s: %s", tcp->address,
+			tcp->port, gai_strerror(err));
+		return SR_ERR;
+	}
+
+	for (res = results; res; res = res->ai_next) {
+		if ((tcp->socket = socket(res->ai_family, res->ai_socktype,
+						res->ai_protocol)) < 0)
+			continue;
+		/* Requests are short, don't let Nagle's algorithm hold them. */
+		one = 1;
+		if (setsockopt(tcp->socket, IPPROTO_TCP, TCP_NODELAY,
+				(const char *)&one, sizeof(one)) < 0)
+			sr_dbg("Failed to set TCP_NODELAY: %s", g_strerror(errno));
+		if (connect(tcp->socket, res->ai_addr, res->ai_addrlen) != 0) {
+			close(tcp->socket);
+			tcp->socket = -1;
+			continue;
+		}
+		break;
+	}
+
+	freeaddrinfo(results);
+
+	if (tcp->socket < 0) {
+		sr_err("Failed to connect to %s:%s: %s", tcp->address,
+			tcp->port, g_strerror(errno));
+		return SR_ERR;
+	}
+
+	return SR_OK;
+}
+
+static int modbus_tcp_source_add(struct sr_session *session, void *priv,
+		int events, int timeout, sr_receive_data_callback cb, void *cb_data)
+{
+	struct modbus_tcp *tcp = priv;
+
+	return sr_session_source_add(session, tcp->socket, events, timeout,
+			cb, cb_data);
+}
+
+static int modbus_tcp_source_remove(struct sr_session *session, void *priv)
+{
+	struct modbus_tcp *tcp = priv;
+
+	return sr_session_source_remove(session, tcp->socket);
+}
+
+static int modbus_tcp_send(void *priv, const uint8_t *buffer, int buffer_size)
+{
+	struct modbus_tcp *tcp = priv;
+	uint8_t adu[MBAP_HEADER_SIZE + PDU_MAX_SIZE];
+	uint16_t transaction_id;
+	int len, pos, out;
+
+	if (buffer_size > PDU_MAX_SIZE)
+		return SR_ERR_ARG;
+
+	if (g_queue_get_length(&tcp->pending) >= tcp->max_pending) {
+		sr_err("Too many Modbus requests in flight.");
+		return SR_ERR;
+	}
+
+	transaction_id = tcp->next_transaction_id++;
+	WB16(adu + 0, transaction_id);
+	WB16(adu + 2, 0);
+	WB16(adu + 4, buffer_size + 1);
+	W8(adu + 6, tcp->unit_id);
+	memcpy(adu + MBAP_HEADER_SIZE, buffer, buffer_size);
+	len = MBAP_HEADER_SIZE + buffer_size;
+
+	for (pos = 0; pos < len; pos += out) {
+		out = send(tcp->socket, (const char *)adu + pos, len - pos, 0);
+		if (out < 0) {
+			sr_err("Send error: %s", g_strerror(errno));
+			return SR_ERR;
+		}
+	}
+
+	g_queue_push_tail(&tcp->pending, GUINT_TO_POINTER(transaction_id));
+
+	return SR_OK;
+}
+
+/* Receive exactly len bytes, unless the timeout passes without data. */
+static int modbus_tcp_recv(struct modbus_tcp *tcp, uint8_t *buf, size_t len)
+{
+	fd_set rset;
+	struct timeval tv;
+	size_t pos;
+	int ret;
+
+	for (pos = 0; pos < len; pos += ret) {
+		FD_ZERO(&rset);
+		FD_SET(tcp->socket, &rset);
+		tv.tv_sec = READ_TIMEOUT_MS / 1000;
+		tv.tv_usec = (READ_TIMEOUT_MS % 1000) * 1000;
+		ret = select(tcp->socket + 1, &rset, NULL, NULL, &tv);
+		if (ret < 0 && errno == EINTR) {
+			ret = 0;
+			continue;
+		}
+		if (ret < 0) {
+			sr_err("Receive error: %s", g_strerror(errno));
+			return SR_ERR;
+		}
+		if (ret == 0) {
+			sr_err("Timed out waiting for Modbus response.");
+			return SR_ERR;
+		}
+		ret = recv(tcp->socket, (char *)buf + pos, len - pos, 0);
+		if (ret <= 0) {
+			sr_err("Receive error: %s", ret ? g_strerror(errno)
+				: "Connection closed");
+			return SR_ERR;
+		}
+	}
+
+	return SR_OK;
+}
+
+static int modbus_tcp_recv_reply(struct modbus_tcp *tcp,
+		struct modbus_tcp_reply *reply)
+{
+	uint8_t header[MBAP_HEADER_SIZE];
+	size_t len;
+	int ret;
+
+	ret = modbus_tcp_recv(tcp, header, sizeof(header));
+	if (ret != SR_OK)
+		return ret;
+
+	reply->transaction_id = RB16(header + 0);
+	len = RB16(header + 4);
+	if (RB16(header + 2) != 0 || len < 2 || len > PDU_MAX_SIZE + 1) {
+		sr_err("Invalid Modbus TCP header.");
+		return SR_ERR_DATA;
+	}
+	reply->len = len - 1;
+
+	return modbus_tcp_recv(tcp, reply->pdu, reply->len);
+}
+
+static gboolean modbus_tcp_is_pending(struct modbus_tcp *tcp,
+		uint16_t transaction_id)
+{
+	return g_queue_find(&tcp->pending,
+		GUINT_TO_POINTER(transaction_id)) != NULL;
+}
+
+static int modbus_tcp_read_begin(void *priv, uint8_t *function_code)
+{
+	struct modbus_tcp *tcp = priv;
+	struct modbus_tcp_reply *early;
+	uint16_t transaction_id;
+	GSList *l;
+	int ret;
+
+	if (g_queue_is_empty(&tcp->pending)) {
+		sr_err("No Modbus request to read the reply of.");
+		return SR_ERR;
+	}
+
+	/*
+	 * Read the reply to the oldest request. It's given up on upon
+	 * errors, a late reply to it gets dropped then.
+	 */
+	transaction_id = GPOINTER_TO_UINT(g_queue_pop_head(&tcp->pending));
+
+	for (l = tcp->early; l; l = l->next) {
+		early = l->data;
+		if (early->transaction_id != transaction_id)
+			continue;
+		tcp->reply = *early;
+		tcp->early = g_slist_delete_link(tcp->early, l);
+		g_free(early);
+		goto found;
+	}
+
+	while (TRUE) {
+		ret = modbus_tcp_recv_reply(tcp, &tcp->reply);
+		if (ret != SR_OK)
+			return ret;
+		if (tcp->reply.transaction_id == transaction_id)
+			break;
+		if (modbus_tcp_is_pending(tcp, tcp->reply.transaction_id)) {
+			/* The reply to a newer request came first, keep it. */
+			early = g_malloc(sizeof(*early));
+			*early = tcp->reply;
+			tcp->early = g_slist_prepend(tcp->early, early);
+		} else {
+			sr_dbg("Dropping Modbus reply of transaction %u.",
+				tcp->reply.transaction_id);
+		}
+	}
+
+found:
+	*function_code = tcp->reply.pdu[0];
+	tcp->reply_pos = 1;
+
+	return SR_OK;
+}
+
+static int modbus_tcp_read_data(void *priv, uint8_t *buf, int maxlen)
+{
+	struct modbus_tcp *tcp = priv;
+	size_t len;
+
+	len = MIN((size_t)maxlen, tcp->reply.len - tcp->reply_pos);
+	if (!len && maxlen)
+		return SR_ERR;
+	memcpy(buf, tcp->reply.pdu + tcp->reply_pos, len);
+	tcp->reply_pos += len;
+
+	return len;
+}
+
+static int modbus_tcp_read_end(void *priv)
+{
+	struct modbus_tcp *tcp = priv;
+
+	if (tcp->reply_pos != tcp->reply.len) {
+		sr_err("Unexpected length of Modbus reply.");
+		return SR_ERR_DATA;
+	}
+
+	return SR_OK;
+}
+
+static int modbus_tcp_close(void *priv)
+{
+	struct modbus_tcp *tcp = priv;
+
+	g_queue_clear(&tcp->pending);
+	g_slist_free_full(tcp->early, g_free);
+	tcp->early = NULL;
+
+	if (tcp->socket < 0)
+		return SR_OK;
+	if (close(tcp->socket) < 0)
+		return SR_ERR;
+	tcp->socket = -1;
+
+	return SR_OK;
+}
+
+static void modbus_tcp_free(void *priv)
+{
+	struct modbus_tcp *tcp = priv;
+
+	g_free(tcp->address);
+	g_free(tcp->port);
+}
+
+static unsigned int modbus_tcp_get_max_pending(void *priv)
+{
+	struct modbus_tcp *tcp = priv;
+
+	return tcp->max_pending;
+}
+
+SR_PRIV const struct sr_modbus_dev_inst modbus_tcp_dev = {
+	.name            = "tcp",
+	.prefix          = "tcp",
+	.priv_size       = sizeof(struct modbus_tcp),
+	.scan            = NULL,
+	.dev_inst_new    = modbus_tcp_dev_inst_new,
+	.open            = modbus_tcp_open,
+	.source_add      = modbus_tcp_source_add,
+	.source_remove   = modbus_tcp_source_remove,
+	.send            = modbus_tcp_send,
+	.read_begin      = modbus_tcp_read_begin,
+	.read_data       = modbus_tcp_read_data,
+	.read_end        = modbus_tcp_read_end,
+	.close           = modbus_tcp_close,
+	.free            = modbus_tcp_free,
+	.get_max_pending = modbus_tcp_get_max_pending,
+};
@@ -80,12 +80,9 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 	const struct sr_datafeed_meta *meta;
 	const struct sr_config *src;
 	const struct sr_key_info *srci;
-	struct sr_channel *ch;
 	GSList *l;
 	float *fdata;
-	unsigned int i;
-	int num_channels, c, ret, digits, actual_digits;
-	char *number, *suffix;
+	int num_channels, ret, digits;
 
 	*out = NULL;
 	if (!o || !o->sdi)
@@ -132,36 +129,16 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 						analog->num_samples * num_channels * sizeof(float))))
 			return SR_ERR_MALLOC;
 		ctx->fdata = fdata;
-		if ((ret = sr_analog_to_float(analog, fdata)) != SR_OK)
+		if ((ret = sr_analog_to_float_prepared(analog, fdata)) != SR_OK)
 			return ret;
-		*out = g_string_sized_new(512);
+		*out = g_string_sized_new(64 * analog->num_samples * num_channels);
 		if (ctx->digits == DIGITS_ALL)
 			digits = analog->encoding->digits;
 		else
 			digits = analog->spec->spec_digits;
 		if (!analog->encoding->is_digits_decimal)
 			digits = copysign(ceil(abs(digits) * BIN_TO_DEC_DIGITS), digits);
-		gboolean si_friendly = sr_analog_si_prefix_friendly(analog->meaning->unit);
-		sr_analog_unit_to_string(analog, &suffix);
-		for (i = 0; i < analog->num_samples; i++) {
-			for (l = analog->meaning->channels, c = 0; l; l = l->next, c++) {
-				float value = fdata[i * num_channels + c];
-				const char *prefix = "";
-				actual_digits = digits;
-				if (si_friendly)
-					prefix = sr_analog_si_prefix(&value, &actual_digits);
-				ch = l->data;
-				g_string_append_printf(*out, "%s: ", ch->name);
-				number = g_strdup_printf("%.*f", MAX(actual_digits, 0), value);
-				g_string_append(*out, number);
-				g_free(number);
-				g_string_append(*out, " ");
-				g_string_append(*out, prefix);
-				g_string_append(*out, suffix);
-				g_string_append(*out, "\n");
-			}
-		}
-		g_free(suffix);
+		sr_analog_format_values(analog, fdata, digits, *out);
 		break;
 	}
 
@@ -0,0 +1,508 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Apache Arrow IPC file output, via the arrow-glib library.
+ *
+ * The table has these typed columns:
+ * - "sample" (uint64), the index of the sample within the acquisition.
+ * - "time" (double), the sample's time in seconds. Only present when
+ *   the samplerate is known when the first sample data arrives.
+ * - One bit packed boolean column per enabled logic channel.
+ * - One float column per enabled analog channel.
+ *
+ * Logic and analog data arrive in separate packets. Rows get written
+ * as soon as all columns have data for them, which results in one
+ * record batch per packet for most acquisitions.
+ */
+
+#include <config.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include <arrow-glib/arrow-glib.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+#define LOG_PREFIX "output/arrow"
+
+struct analog_column {
+	struct sr_channel *ch;
+	float *data;
+	size_t count;
+	size_t size;
+};
+
+struct context {
+	uint64_t samplerate;
+	uint64_t sample_offset;
+	GArrowOutputStream *stream;
+	GArrowRecordBatchWriter *writer;
+	GArrowSchema *schema;
+	gboolean with_time;
+	/* Logic channels, and buffered raw logic samples. */
+	size_t num_logic;
+	struct sr_channel **logic_channels;
+	size_t unitsize;
+	uint8_t *logic_data;
+	size_t logic_count;
+	size_t logic_size;
+	/* Analog channels, and their buffered values. */
+	size_t num_analog;
+	struct analog_column *analog;
+	float *fdata;
+	size_t fdata_size;
+};
+
+static void report_error(const char *what, GError *error)
+{
+	sr_err("%s: %s.", what, error ? error->message : "unknown error");
+	if (error)
+		g_error_free(error);
+}
+
+static int init(struct sr_output *o, GHashTable *options)
+{
+	struct context *ctx;
+	struct sr_channel *ch;
+	GSList *l;
+	GError *error;
+
+	(void)options;
+
+	if (!o || !o->sdi)
+		return SR_ERR_ARG;
+	if (!o->filename || o->filename[0] == '\0') {
+		sr_info("arrow output module requires a file name, cannot save.");
+		return SR_ERR_ARG;
+	}
+
+	ctx = g_malloc0(sizeof(*ctx));
+	o->priv = ctx;
+
+	for (l = o->sdi->channels; l; l = l->next) {
+		ch = l->data;
+		if (!ch->enabled)
+			continue;
+		if (ch->type == SR_CHANNEL_LOGIC)
+			ctx->num_logic++;
+		else if (ch->type == SR_CHANNEL_ANALOG)
+			ctx->num_analog++;
+	}
+	ctx->logic_channels = g_malloc0(ctx->num_logic * sizeof(ctx->logic_channels[0]));
+	ctx->analog = g_malloc0(ctx->num_analog * sizeof(ctx->analog[0]));
+	ctx->num_logic = ctx->num_analog = 0;
+	for (l = o->sdi->channels; l; l = l->next) {
+		ch = l->data;
+		if (!ch->enabled)
+			continue;
+		if (ch->type == SR_CHANNEL_LOGIC)
+			ctx->logic_channels[ctx->num_logic++] = ch;
+		else if (ch->type == SR_CHANNEL_ANALOG)
+			ctx->analog[ctx->num_analog++].ch = ch;
+	}
+
+	error = NULL;
+	ctx->stream = GARROW_OUTPUT_STREAM(garrow_file_output_stream_new(
+		o->filename, FALSE, &error));
+	if (!ctx->stream) {
+		report_error("Cannot create output file", error);
+		g_free(ctx->logic_channels);
+		g_free(ctx->analog);
+		g_free(ctx);
+		o->priv = NULL;
+		return SR_ERR_IO;
+	}
+
+	return SR_OK;
+}
+
+static void add_field(GList **fields, const char *name, GArrowDataType *type)
+{
+	*fields = g_list_append(*fields, garrow_field_new(name, type));
+	g_object_unref(type);
+}
+
+/* The schema gets determined when the first sample data arrives. */
+static int start_writer(const struct sr_output *o)
+{
+	struct context *ctx;
+	GList *fields;
+	GVariant *gvar;
+	GError *error;
+	size_t i;
+
+	ctx = o->priv;
+	if (ctx->writer)
+		return SR_OK;
+
+	if (!ctx->samplerate && sr_config_get(o->sdi->driver, o->sdi, NULL,
+			SR_CONF_SAMPLERATE, &gvar) == SR_OK) {
+		ctx->samplerate = g_variant_get_uint64(gvar);
+		g_variant_unref(gvar);
+	}
+	ctx->with_time = ctx->samplerate != 0;
+
+	fields = NULL;
+	add_field(&fields, "sample", GARROW_DATA_TYPE(garrow_uint64_data_type_new()));
+	if (ctx->with_time)
+		add_field(&fields, "time", GARROW_DATA_TYPE(garrow_double_data_type_new()));
+	for (i = 0; i < ctx->num_logic; i++) {
+		add_field(&fields, ctx->logic_channels[i]->name,
+			GARROW_DATA_TYPE(garrow_boolean_data_type_new()));
+	}
+	for (i = 0; i < ctx->num_analog; i++) {
+		add_field(&fields, ctx->analog[i].ch->name,
+			GARROW_DATA_TYPE(garrow_float_data_type_new()));
+	}
+	ctx->schema = garrow_schema_new(fields);
+	g_list_free_full(fields, g_object_unref);
+
+	error = NULL;
+	ctx->writer = GARROW_RECORD_BATCH_WRITER(garrow_record_batch_file_writer_new(
+		ctx->stream, ctx->schema, &error));
+	if (!ctx->writer) {
+		report_error("Cannot create Arrow writer", error);
+		return SR_ERR_IO;
+	}
+
+	return SR_OK;
+}
+
+/* Create an array which takes ownership of the buffer's memory. */
+static GArrowBuffer *take_buffer(void *data, size_t size)
+{
+	GBytes *bytes;
+	GArrowBuffer *buffer;
+
+	bytes = g_bytes_new_take(data, size);
+	buffer = garrow_buffer_new_bytes(bytes);
+	g_bytes_unref(bytes);
+
+	return buffer;
+}
+
+static GArrowArray *sample_column(struct context *ctx, size_t count)
+{
+	GArrowBuffer *buffer;
+	GArrowArray *array;
+	uint64_t *data;
+	size_t i;
+
+	data = g_malloc(count * sizeof(data[0]));
+	for (i = 0; i < count; i++)
+		data[i] = ctx->sample_offset + i;
+	buffer = take_buffer(data, count * sizeof(data[0]));
+	array = GARROW_ARRAY(garrow_uint64_array_new(count, buffer, NULL, 0));
+	g_object_unref(buffer);
+
+	return array;
+}
+
+static GArrowArray *time_column(struct context *ctx, size_t count)
+{
+	GArrowBuffer *buffer;
+	GArrowArray *array;
+	double *data;
+	size_t i;
+
+	data = g_malloc(count * sizeof(data[0]));
+	for (i = 0; i < count; i++)
+		data[i] = (double)(ctx->sample_offset + i) / ctx->samplerate;
+	buffer = take_buffer(data, count * sizeof(data[0]));
+	array = GARROW_ARRAY(garrow_double_array_new(count, buffer, NULL, 0));
+	g_object_unref(buffer);
+
+	return array;
+}
+
+/* Arrow's boolean arrays keep the earliest value in the LSB. */
+static GArrowArray *logic_column(struct context *ctx, size_t idx, size_t count)
+{
+	GArrowBuffer *buffer;
+	GArrowArray *array;
+	const uint8_t *rd;
+	uint8_t *data, mask;
+	size_t i, size;
+
+	size = (count + 7) / 8;
+	data = g_malloc0(size);
+	rd = ctx->logic_data + idx / 8;
+	mask = 1 << (idx % 8);
+	for (i = 0; i < count; i++) {
+		if (*rd & mask)
+			data[i / 8] |= 1 << (i % 8);
+		rd += ctx->unitsize;
+	}
+	buffer = take_buffer(data, size);
+	array = GARROW_ARRAY(garrow_boolean_array_new(count, buffer, NULL, 0));
+	g_object_unref(buffer);
+
+	return array;
+}
+
+static GArrowArray *analog_column(struct analog_column *col, size_t count)
+{
+	GArrowBuffer *buffer;
+	GArrowArray *array;
+
+	buffer = take_buffer(g_memdup(col->data, count * sizeof(float)),
+		count * sizeof(float));
+	array = GARROW_ARRAY(garrow_float_array_new(count, buffer, NULL, 0));
+	g_object_unref(buffer);
+
+	return array;
+}
+
+/* Write the rows for which all columns have data. */
+static int write_rows(struct context *ctx)
+{
+	GArrowRecordBatch *batch;
+	GList *columns;
+	GError *error;
+	size_t count, i;
+	gboolean ok;
+
+	if (!ctx->num_logic && !ctx->num_analog)
+		return SR_OK;
+	count = G_MAXSIZE;
+	if (ctx->num_logic)
+		count = ctx->logic_count;
+	for (i = 0; i < ctx->num_analog; i++)
+		count = MIN(count, ctx->analog[i].count);
+	if (!count)
+		return SR_OK;
+
+	columns = NULL;
+	columns = g_list_append(columns, sample_column(ctx, count));
+	if (ctx->with_time)
+		columns = g_list_append(columns, time_column(ctx, count));
+	for (i = 0; i < ctx->num_logic; i++) {
+		columns = g_list_append(columns, logic_column(ctx,
+			ctx->logic_channels[i]->index, count));
+	}
+	for (i = 0; i < ctx->num_analog; i++)
+		columns = g_list_append(columns, analog_column(&ctx->analog[i], count));
+
+	error = NULL;
+	batch = garrow_record_batch_new(ctx->schema, count, columns, &error);
+	g_list_free_full(columns, g_object_unref);
+	if (!batch) {
+		report_error("Cannot create record batch", error);
+		return SR_ERR;
+	}
+	ok = garrow_record_batch_writer_write_record_batch(ctx->writer,
+		batch, &error);
+	g_object_unref(batch);
+	if (!ok) {
+		report_error("Cannot write record batch", error);
+		return SR_ERR_IO;
+	}
+
+	/* Keep the data of rows which are not complete yet. */
+	if (ctx->num_logic) {
+		ctx->logic_count -= count;
+		memmove(ctx->logic_data, ctx->logic_data + count * ctx->unitsize,
+			ctx->logic_count * ctx->unitsize);
+	}
+	for (i = 0; i < ctx->num_analog; i++) {
+		ctx->analog[i].count -= count;
+		memmove(ctx->analog[i].data, ctx->analog[i].data + count,
+			ctx->analog[i].count * sizeof(float));
+	}
+	ctx->sample_offset += count;
+
+	return SR_OK;
+}
+
+static int receive_logic(struct context *ctx,
+	const struct sr_datafeed_logic *logic)
+{
+	uint8_t *data;
+	size_t count, size;
+
+	if (!ctx->num_logic)
+		return SR_OK;
+	if (ctx->unitsize && ctx->unitsize != logic->unitsize) {
+		sr_err("Logic unit size changed during acquisition.");
+		return SR_ERR_DATA;
+	}
+	ctx->unitsize = logic->unitsize;
+
+	count = logic->length / logic->unitsize;
+	size = (ctx->logic_count + count) * ctx->unitsize;
+	if (size > ctx->logic_size) {
+		data = g_try_realloc(ctx->logic_data, size);
+		if (!data)
+			return SR_ERR_MALLOC;
+		ctx->logic_data = data;
+		ctx->logic_size = size;
+	}
+	memcpy(ctx->logic_data + ctx->logic_count * ctx->unitsize,
+		logic->data, count * ctx->unitsize);
+	ctx->logic_count += count;
+
+	return SR_OK;
+}
+
+static int receive_analog(struct context *ctx,
+	const struct sr_datafeed_analog *analog)
+{
+	struct analog_column *col;
+	GSList *l;
+	float *data;
+	size_t num_samples, num_channels, i, j, c;
+	int ret;
+
+	num_samples = analog->num_samples;
+	num_channels = g_slist_length(analog->meaning->channels);
+	if (!num_samples || !num_channels)
+		return SR_OK;
+
+	if (num_samples * num_channels > ctx->fdata_size) {
+		data = g_try_realloc(ctx->fdata,
+			num_samples * num_channels * sizeof(float));
+		if (!data)
+			return SR_ERR_MALLOC;
+		ctx->fdata = data;
+		ctx->fdata_size = num_samples * num_channels;
+	}
+	ret = sr_analog_to_float_prepared(analog, ctx->fdata);
+	if (ret != SR_OK)
+		return ret;
+
+	/* Samples of several channels are interleaved, split them. */
+	for (l = analog->meaning->channels, j = 0; l; l = l->next, j++) {
+		col = NULL;
+		for (c = 0; c < ctx->num_analog; c++) {
+			if (ctx->analog[c].ch == l->data)
+				col = &ctx->analog[c];
+		}
+		if (!col)
+			continue;
+		if (col->count + num_samples > col->size) {
+			data = g_try_realloc(col->data,
+				(col->count + num_samples) * sizeof(float));
+			if (!data)
+				return SR_ERR_MALLOC;
+			col->data = data;
+			col->size = col->count + num_samples;
+		}
+		for (i = 0; i < num_samples; i++)
+			col->data[col->count++] = ctx->fdata[i * num_channels + j];
+	}
+
+	return SR_OK;
+}
+
+static int receive(const struct sr_output *o, const struct sr_datafeed_packet *packet,
+		GString **out)
+{
+	const struct sr_datafeed_meta *meta;
+	const struct sr_config *src;
+	struct context *ctx;
+	GSList *l;
+	GError *error;
+	int ret;
+
+	*out = NULL;
+	if (!o || !o->sdi)
+		return SR_ERR_ARG;
+	if (!(ctx = o->priv))
+		return SR_ERR_ARG;
+
+	switch (packet->type) {
+	case SR_DF_META:
+		meta = packet->payload;
+		for (l = meta->config; l; l = l->next) {
+			src = l->data;
+			if (src->key != SR_CONF_SAMPLERATE)
+				continue;
+			ctx->samplerate = g_variant_get_uint64(src->data);
+		}
+		break;
+	case SR_DF_LOGIC:
+	case SR_DF_ANALOG:
+		if ((ret = start_writer(o)) != SR_OK)
+			return ret;
+		if (packet->type == SR_DF_LOGIC)
+			ret = receive_logic(ctx, packet->payload);
+		else
+			ret = receive_analog(ctx, packet->payload);
+		if (ret != SR_OK)
+			return ret;
+		return write_rows(ctx);
+	case SR_DF_END:
+		if (!ctx->writer)
+			break;
+		error = NULL;
+		if (!garrow_record_batch_writer_close(ctx->writer, &error)) {
+			report_error("Cannot finish Arrow file", error);
+			return SR_ERR_IO;
+		}
+		g_object_unref(ctx->writer);
+		ctx->writer = NULL;
+		break;
+	}
+
+	return SR_OK;
+}
+
+static int cleanup(struct sr_output *o)
+{
+	struct context *ctx;
+	size_t i;
+
+	if (!o)
+		return SR_ERR_ARG;
+
+	if (!(ctx = o->priv))
+		return SR_OK;
+
+	if (ctx->writer) {
+		garrow_record_batch_writer_close(ctx->writer, NULL);
+		g_object_unref(ctx->writer);
+	}
+	if (ctx->schema)
+		g_object_unref(ctx->schema);
+	if (ctx->stream) {
+		garrow_output_stream_flush(ctx->stream, NULL);
+		g_object_unref(ctx->stream);
+	}
+	for (i = 0; i < ctx->num_analog; i++)
+		g_free(ctx->analog[i].data);
+	g_free(ctx->analog);
+	g_free(ctx->logic_channels);
+	g_free(ctx->logic_data);
+	g_free(ctx->fdata);
+	g_free(ctx);
+	o->priv = NULL;
+
+	return SR_OK;
+}
+
+SR_PRIV struct sr_output_module output_arrow = {
+	.id = "arrow",
+	.name = "Apache Arrow",
+	.desc = "Apache Arrow IPC file with typed columns",
+	.exts = (const char*[]){"arrow", NULL},
+	.flags = SR_OUTPUT_INTERNAL_IO_HANDLING,
+	.options = NULL,
+	.init = init,
+	.receive = receive,
+	.cleanup = cleanup,
+};
@@ -51,8 +51,86 @@ struct context {
 	GString **lines;
 	const char *charset;
 	gboolean edges;
+	char level_chars[256][8];
 };
 
+/*
+ * Lookup table for the low/high text of eight consecutive samples of a
+ * channel, the earliest sample is kept in the most significant bit.
+ */
+static void fill_level_chars(struct context *ctx)
+{
+	size_t byte, bit;
+
+	for (byte = 0; byte < ARRAY_SIZE(ctx->level_chars); byte++) {
+		for (bit = 0; bit < 8; bit++) {
+			ctx->level_chars[byte][bit] =
+				ctx->charset[(byte & (0x80 >> bit)) ? 1 : 0];
+		}
+	}
+}
+
+/* Collect a channel's bits of up to eight samples, earliest first. */
+static uint8_t gather_bits(const uint8_t *data, size_t unitsize,
+	size_t bytepos, uint8_t bitmask, size_t count)
+{
+	uint8_t bits;
+
+	data += bytepos;
+	bits = 0;
+	while (count--) {
+		bits <<= 1;
+		if (*data & bitmask)
+			bits |= 1;
+		data += unitsize;
+	}
+
+	return bits;
+}
+
+/*
+ * Append a run of samples to a channel's line. The run must not exceed
+ * the end of the line. Levels get formatted in groups of eight via table
+ * lookup, edge characters are patched in where the level changed.
+ */
+static void append_samples(struct context *ctx, size_t j,
+	const uint8_t *data, size_t unitsize, size_t count)
+{
+	GString *line;
+	size_t idx, bytepos, pos, group, bit;
+	uint8_t bitmask, bits, prev, edges;
+	char text[8];
+
+	line = ctx->lines[j];
+	idx = ctx->channel_index[j];
+	bytepos = idx / 8;
+	bitmask = 1U << (idx % 8);
+	prev = (ctx->prev_sample[bytepos] & bitmask) ? 1 : 0;
+	pos = ctx->spl_cnt;
+	while (count) {
+		group = MIN(count, 8);
+		bits = gather_bits(data, unitsize, bytepos, bitmask, group);
+		bits <<= 8 - group;
+		memcpy(text, ctx->level_chars[bits], group);
+		if (ctx->edges) {
+			/* Compare each sample against its predecessor. */
+			edges = bits ^ ((bits >> 1) | (prev << 7));
+			if (pos == 0)
+				edges &= 0x7f;
+			edges &= 0xff << (8 - group);
+			for (bit = 0; edges; bit++, edges <<= 1) {
+				if (edges & 0x80)
+					text[bit] = ctx->charset[2 + ((bits >> (7 - bit)) & 1)];
+			}
+		}
+		g_string_append_len(line, text, group);
+		prev = (bits >> (8 - group)) & 1;
+		data += group * unitsize;
+		count -= group;
+		pos += group;
+	}
+}
+
 static int init(struct sr_output *o, GHashTable *options)
 {
 	struct context *ctx;
@@ -74,6 +152,7 @@ static int init(struct sr_output *o, GHashTable *options)
 		ctx->charset = g_strdup(DEFAULT_ASCII_CHARS);
 	}
 	ctx->edges = (strlen(ctx->charset) >= 4) ? TRUE : FALSE;
+	fill_level_chars(ctx);
 
 	for (l = o->sdi->channels; l; l = l->next) {
 		ch = l->data;
@@ -180,13 +259,10 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 	const struct sr_config *src;
 	GSList *l;
 	struct context *ctx;
-	size_t idx, i, j;
-	size_t num_samples;
+	size_t i, j;
+	size_t num_samples, count;
 	const uint8_t *curr_sample;
-	size_t bytepos;
-	uint8_t bitmask, curbit, prevbit;
-	char c;
-	size_t charidx;
+	int ret;
 
 	*out = NULL;
 	if (!o || !o->sdi)
@@ -218,37 +294,31 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 		logic = packet->payload;
 		num_samples = logic->length / logic->unitsize;
 		curr_sample = logic->data;
-		while (num_samples--) {
-			ctx->spl_cnt++;
-			for (j = 0; j < ctx->num_enabled_channels; j++) {
-				idx = ctx->channel_index[j];
-				bytepos = idx / 8;
-				bitmask = 1U << (idx % 8);
-				curbit = curr_sample[bytepos] & bitmask;
-				prevbit = ctx->prev_sample[bytepos] & bitmask;
-
-				charidx = curbit ? 1 : 0;
-				if (ctx->edges && ctx->spl_cnt > 1) {
-					if (curbit != prevbit)
-						charidx += 2;
-				}
-				c = ctx->charset[charidx];
-				g_string_append_c(ctx->lines[j], c);
-
-				if (ctx->spl_cnt == ctx->spl) {
-					/* Flush line buffers. */
+		while (num_samples) {
+			/* Render the samples up to the end of the current line. */
+			count = num_samples;
+			if (ctx->spl && count > ctx->spl - ctx->spl_cnt)
+				count = ctx->spl - ctx->spl_cnt;
+			for (j = 0; j < ctx->num_enabled_channels; j++)
+				append_samples(ctx, j, curr_sample, logic->unitsize, count);
+			ctx->spl_cnt += count;
+			curr_sample += count * logic->unitsize;
+			num_samples -= count;
+			memcpy(ctx->prev_sample, curr_sample - logic->unitsize,
+				logic->unitsize);
+
+			if (ctx->spl_cnt == ctx->spl) {
+				/* Flush line buffers. */
+				for (j = 0; j < ctx->num_enabled_channels; j++) {
 					g_string_append_len(*out, ctx->lines[j]->str, ctx->lines[j]->len);
 					g_string_append_c(*out, '\n');
-					if (j + 1 == ctx->num_enabled_channels)
-						maybe_add_trigger(ctx, *out);
 					g_string_printf(ctx->lines[j], "%s:", ctx->aligned_names[j]);
 				}
-			}
-			if (ctx->spl_cnt == ctx->spl)
-				/* Line buffers were already flushed. */
+				maybe_add_trigger(ctx, *out);
 				ctx->spl_cnt = 0;
-			memcpy(ctx->prev_sample, curr_sample, logic->unitsize);
-			curr_sample += logic->unitsize;
+			}
+			if ((ret = sr_output_flush(o, *out)) != SR_OK)
+				return ret;
 		}
 		break;
 	case SR_DF_END:
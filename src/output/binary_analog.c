@@ -0,0 +1,332 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Raw binary analog output, in the encoding the device sent.
+ *
+ * Each enabled analog channel gets written to "<filename>.<channel>.raw"
+ * as the packed samples of the acquisition, without any conversion. A
+ * sidecar "<filename>.meta" key file describes the encoding of each
+ * channel (unitsize, signedness, float, endianness, scale and offset),
+ * so readers can convert the samples: value = raw * scale + offset.
+ *
+ * The encoding must not change during the acquisition. For 8bit scope
+ * data this is a lossless archive at a quarter of the size of floats.
+ */
+
+#include <config.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+#define LOG_PREFIX "output/binary_analog"
+
+struct raw_channel {
+	struct sr_channel *ch;
+	char *filename;
+	FILE *file;
+	gboolean have_encoding;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	uint64_t num_samples;
+};
+
+struct context {
+	uint64_t samplerate;
+	size_t num_channels;
+	struct raw_channel *channels;
+	uint8_t *buf;
+	size_t buf_size;
+	gboolean meta_done;
+};
+
+static int cleanup(struct sr_output *o);
+
+static int init(struct sr_output *o, GHashTable *options)
+{
+	struct context *ctx;
+	struct raw_channel *rc;
+	struct sr_channel *ch;
+	GSList *l;
+
+	(void)options;
+
+	if (!o || !o->sdi)
+		return SR_ERR_ARG;
+	if (!o->filename || o->filename[0] == '\0') {
+		sr_info("binary-analog output module requires a file name, cannot save.");
+		return SR_ERR_ARG;
+	}
+
+	ctx = g_malloc0(sizeof(*ctx));
+	o->priv = ctx;
+
+	for (l = o->sdi->channels; l; l = l->next) {
+		ch = l->data;
+		if (ch->enabled && ch->type == SR_CHANNEL_ANALOG)
+			ctx->num_channels++;
+	}
+	ctx->channels = g_malloc0(ctx->num_channels * sizeof(ctx->channels[0]));
+	rc = ctx->channels;
+	for (l = o->sdi->channels; l; l = l->next) {
+		ch = l->data;
+		if (!ch->enabled || ch->type != SR_CHANNEL_ANALOG)
+			continue;
+		rc->ch = ch;
+		rc->filename = g_strdup_printf("%s.%s.raw", o->filename, ch->name);
+		rc->file = g_fopen(rc->filename, "wb");
+		if (!rc->file) {
+			sr_err("Cannot create '%s': %s.", rc->filename,
+				g_strerror(errno));
+			cleanup(o);
+			return SR_ERR_IO;
+		}
+		rc++;
+	}
+
+	return SR_OK;
+}
+
+static gboolean same_encoding(const struct sr_analog_encoding *a,
+	const struct sr_analog_encoding *b)
+{
+	return a->unitsize == b->unitsize && a->is_signed == b->is_signed &&
+		a->is_float == b->is_float && a->is_bigendian == b->is_bigendian &&
+		a->scale.p == b->scale.p && a->scale.q == b->scale.q &&
+		a->offset.p == b->offset.p && a->offset.q == b->offset.q;
+}
+
+static int write_channel(struct context *ctx, struct raw_channel *rc,
+	const struct sr_datafeed_analog *analog, size_t index)
+{
+	const uint8_t *src;
+	uint8_t *buf;
+	size_t sample_stride, channel_stride, unitsize, size, i;
+
+	if (!rc->have_encoding) {
+		rc->encoding = *analog->encoding;
+		rc->meaning = *analog->meaning;
+		rc->meaning.channels = NULL;
+		rc->have_encoding = TRUE;
+	} else if (!same_encoding(&rc->encoding, analog->encoding)) {
+		sr_err("Encoding of channel %s changed during acquisition.",
+			rc->ch->name);
+		return SR_ERR_DATA;
+	}
+
+	unitsize = analog->encoding->unitsize;
+	size = analog->num_samples * unitsize;
+	sr_analog_strides(analog, &sample_stride, &channel_stride);
+	src = (const uint8_t *)analog->data + index * channel_stride;
+	if (sample_stride != unitsize) {
+		/* Gather the channel's samples, they are not adjacent. */
+		if (size > ctx->buf_size) {
+			buf = g_try_realloc(ctx->buf, size);
+			if (!buf)
+				return SR_ERR_MALLOC;
+			ctx->buf = buf;
+			ctx->buf_size = size;
+		}
+		for (i = 0; i < analog->num_samples; i++)
+			memcpy(ctx->buf + i * unitsize, src + i * sample_stride, unitsize);
+		src = ctx->buf;
+	}
+	if (fwrite(src, 1, size, rc->file) != size) {
+		sr_err("Cannot write '%s'.", rc->filename);
+		return SR_ERR_IO;
+	}
+	rc->num_samples += analog->num_samples;
+
+	return SR_OK;
+}
+
+static int receive_analog(struct context *ctx,
+	const struct sr_datafeed_analog *analog)
+{
+	GSList *l;
+	size_t i, j;
+	int ret;
+
+	if (!analog->num_samples)
+		return SR_OK;
+	for (l = analog->meaning->channels, j = 0; l; l = l->next, j++) {
+		for (i = 0; i < ctx->num_channels; i++) {
+			if (ctx->channels[i].ch != l->data)
+				continue;
+			ret = write_channel(ctx, &ctx->channels[i], analog, j);
+			if (ret != SR_OK)
+				return ret;
+		}
+	}
+
+	return SR_OK;
+}
+
+static void set_rational(GKeyFile *meta, const char *group, const char *key,
+	const struct sr_rational *r)
+{
+	char *s;
+
+	s = g_strdup_printf("%" PRId64 "/%" PRIu64, r->p, r->q);
+	g_key_file_set_string(meta, group, key, s);
+	g_free(s);
+}
+
+/* Describe the encoding of each channel's samples in the sidecar file. */
+static int write_meta(const struct sr_output *o)
+{
+	struct context *ctx;
+	struct raw_channel *rc;
+	GKeyFile *meta;
+	GError *error;
+	char *group, *filename, *basename, *data;
+	size_t i, len;
+	gboolean ok;
+
+	ctx = o->priv;
+	if (ctx->meta_done)
+		return SR_OK;
+	ctx->meta_done = TRUE;
+
+	meta = g_key_file_new();
+	g_key_file_set_string(meta, "global", "sigrok version",
+		sr_package_version_string_get());
+	g_key_file_set_uint64(meta, "global", "samplerate", ctx->samplerate);
+	for (i = 0; i < ctx->num_channels; i++) {
+		rc = &ctx->channels[i];
+		fflush(rc->file);
+		group = g_strdup_printf("channel %s", rc->ch->name);
+		basename = g_path_get_basename(rc->filename);
+		g_key_file_set_string(meta, group, "file", basename);
+		g_free(basename);
+		g_key_file_set_uint64(meta, group, "samples", rc->num_samples);
+		if (rc->have_encoding) {
+			g_key_file_set_integer(meta, group, "unitsize", rc->encoding.unitsize);
+			g_key_file_set_boolean(meta, group, "signed", rc->encoding.is_signed);
+			g_key_file_set_boolean(meta, group, "float", rc->encoding.is_float);
+			g_key_file_set_boolean(meta, group, "bigendian", rc->encoding.is_bigendian);
+			g_key_file_set_integer(meta, group, "digits", rc->encoding.digits);
+			set_rational(meta, group, "scale", &rc->encoding.scale);
+			set_rational(meta, group, "offset", &rc->encoding.offset);
+			g_key_file_set_integer(meta, group, "mq", rc->meaning.mq);
+			g_key_file_set_integer(meta, group, "unit", rc->meaning.unit);
+			g_key_file_set_uint64(meta, group, "mqflags", rc->meaning.mqflags);
+		}
+		g_free(group);
+	}
+
+	filename = g_strdup_printf("%s.meta", o->filename);
+	error = NULL;
+	data = g_key_file_to_data(meta, &len, NULL);
+	ok = g_file_set_contents(filename, data, len, &error);
+	g_free(data);
+	if (!ok) {
+		sr_err("Cannot write '%s': %s.", filename, error->message);
+		g_error_free(error);
+	}
+	g_free(filename);
+	g_key_file_free(meta);
+
+	return ok ? SR_OK : SR_ERR_IO;
+}
+
+static int receive(const struct sr_output *o, const struct sr_datafeed_packet *packet,
+		GString **out)
+{
+	const struct sr_datafeed_meta *meta;
+	const struct sr_config *src;
+	struct context *ctx;
+	GVariant *gvar;
+	GSList *l;
+
+	*out = NULL;
+	if (!o || !o->sdi)
+		return SR_ERR_ARG;
+	if (!(ctx = o->priv))
+		return SR_ERR_ARG;
+
+	switch (packet->type) {
+	case SR_DF_META:
+		meta = packet->payload;
+		for (l = meta->config; l; l = l->next) {
+			src = l->data;
+			if (src->key != SR_CONF_SAMPLERATE)
+				continue;
+			ctx->samplerate = g_variant_get_uint64(src->data);
+		}
+		break;
+	case SR_DF_ANALOG:
+		if (!ctx->samplerate && sr_config_get(o->sdi->driver, o->sdi,
+				NULL, SR_CONF_SAMPLERATE, &gvar) == SR_OK) {
+			ctx->samplerate = g_variant_get_uint64(gvar);
+			g_variant_unref(gvar);
+		}
+		return receive_analog(ctx, packet->payload);
+	case SR_DF_END:
+		return write_meta(o);
+	}
+
+	return SR_OK;
+}
+
+static int cleanup(struct sr_output *o)
+{
+	struct context *ctx;
+	size_t i;
+
+	if (!o)
+		return SR_ERR_ARG;
+
+	if (!(ctx = o->priv))
+		return SR_OK;
+
+	for (i = 0; i < ctx->num_channels; i++) {
+		if (!ctx->channels[i].file)
+			break;
+	}
+	/* Describe what an aborted acquisition left. */
+	if (i == ctx->num_channels)
+		write_meta(o);
+	for (i = 0; i < ctx->num_channels; i++) {
+		if (ctx->channels[i].file)
+			fclose(ctx->channels[i].file);
+		g_free(ctx->channels[i].filename);
+	}
+	g_free(ctx->channels);
+	g_free(ctx->buf);
+	g_free(ctx);
+	o->priv = NULL;
+
+	return SR_OK;
+}
+
+SR_PRIV struct sr_output_module output_binary_analog = {
+	.id = "binary-analog",
+	.name = "Binary analog",
+	.desc = "Raw analog samples in the device's encoding",
+	.exts = NULL,
+	.flags = SR_OUTPUT_INTERNAL_IO_HANDLING,
+	.options = NULL,
+	.init = init,
+	.receive = receive,
+	.cleanup = cleanup,
+};
@@ -0,0 +1,337 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Planar binary output. Each enabled channel gets written to a file of
+ * its own, next to the output file name:
+ *
+ * - "<filename>.<channel>.bits" holds a logic channel as a packed bit
+ *   plane. Eight samples get stored per byte, the earliest sample in
+ *   the least significant bit. The last byte gets padded with zeros.
+ * - "<filename>.<channel>.f32" holds an analog channel as a contiguous
+ *   array of little endian 32bit IEEE 754 floats.
+ *
+ * This layout allows column oriented scans of one channel, without
+ * touching the data of other channels.
+ */
+
+#include <config.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+#define LOG_PREFIX "output/binary_planar"
+
+struct plane {
+	struct sr_channel *ch;
+	FILE *file;
+	uint8_t bits;
+	size_t bit_count;
+};
+
+struct context {
+	size_t num_logic;
+	struct plane *logic;
+	size_t num_analog;
+	struct plane *analog;
+	GSList *analog_channels;
+	uint8_t *buf;
+	size_t buf_size;
+	float *fdata;
+	size_t fdata_size;
+};
+
+static int open_plane(const struct sr_output *o, struct plane *plane,
+	struct sr_channel *ch, const char *ext)
+{
+	char *filename;
+
+	plane->ch = ch;
+	filename = g_strdup_printf("%s.%s.%s", o->filename, ch->name, ext);
+	plane->file = g_fopen(filename, "wb");
+	if (!plane->file) {
+		sr_err("Cannot create '%s': %s.", filename, g_strerror(errno));
+		g_free(filename);
+		return SR_ERR_IO;
+	}
+	g_free(filename);
+
+	return SR_OK;
+}
+
+static int write_plane(struct plane *plane, const uint8_t *data, size_t len)
+{
+	if (!len)
+		return SR_OK;
+	if (fwrite(data, 1, len, plane->file) != len) {
+		sr_err("Cannot write plane of channel %s.", plane->ch->name);
+		return SR_ERR_IO;
+	}
+
+	return SR_OK;
+}
+
+static int cleanup(struct sr_output *o);
+
+static int init(struct sr_output *o, GHashTable *options)
+{
+	struct context *ctx;
+	struct sr_channel *ch;
+	GSList *l;
+	size_t num_logic, num_analog;
+	int ret;
+
+	(void)options;
+
+	if (!o || !o->sdi)
+		return SR_ERR_ARG;
+	if (!o->filename || o->filename[0] == '\0') {
+		sr_info("binary-planar output module requires a file name, cannot save.");
+		return SR_ERR_ARG;
+	}
+
+	ctx = g_malloc0(sizeof(*ctx));
+	o->priv = ctx;
+
+	num_logic = num_analog = 0;
+	for (l = o->sdi->channels; l; l = l->next) {
+		ch = l->data;
+		if (!ch->enabled)
+			continue;
+		if (ch->type == SR_CHANNEL_LOGIC)
+			num_logic++;
+		else if (ch->type == SR_CHANNEL_ANALOG)
+			num_analog++;
+	}
+	ctx->logic = g_malloc0(num_logic * sizeof(ctx->logic[0]));
+	ctx->analog = g_malloc0(num_analog * sizeof(ctx->analog[0]));
+
+	for (l = o->sdi->channels; l; l = l->next) {
+		ch = l->data;
+		if (!ch->enabled)
+			continue;
+		if (ch->type == SR_CHANNEL_LOGIC) {
+			ret = open_plane(o, &ctx->logic[ctx->num_logic++],
+				ch, "bits");
+		} else if (ch->type == SR_CHANNEL_ANALOG) {
+			ctx->analog_channels = g_slist_append(ctx->analog_channels, ch);
+			ret = open_plane(o, &ctx->analog[ctx->num_analog++],
+				ch, "f32");
+		} else {
+			ret = SR_OK;
+		}
+		if (ret != SR_OK) {
+			cleanup(o);
+			return ret;
+		}
+	}
+
+	return SR_OK;
+}
+
+static uint8_t *get_buffer(struct context *ctx, size_t size)
+{
+	uint8_t *buf;
+
+	if (size <= ctx->buf_size)
+		return ctx->buf;
+	buf = g_try_realloc(ctx->buf, size);
+	if (!buf)
+		return NULL;
+	ctx->buf = buf;
+	ctx->buf_size = size;
+
+	return buf;
+}
+
+/*
+ * Append a logic packet's samples of one channel to its bit plane.
+ * Bits which don't fill a byte yet are kept for the next packet.
+ */
+static int receive_logic(struct context *ctx, struct plane *plane,
+	const struct sr_datafeed_logic *logic)
+{
+	const uint8_t *data;
+	uint8_t *buf, *wr, mask, bits;
+	size_t num_samples, bit_count;
+
+	num_samples = logic->length / logic->unitsize;
+	buf = get_buffer(ctx, num_samples / 8 + 1);
+	if (!buf)
+		return SR_ERR_MALLOC;
+
+	data = logic->data + plane->ch->index / 8;
+	mask = 1 << (plane->ch->index % 8);
+	bits = plane->bits;
+	bit_count = plane->bit_count;
+	wr = buf;
+	while (num_samples--) {
+		if (*data & mask)
+			bits |= 1 << bit_count;
+		data += logic->unitsize;
+		if (++bit_count == 8) {
+			*wr++ = bits;
+			bits = 0;
+			bit_count = 0;
+		}
+	}
+	plane->bits = bits;
+	plane->bit_count = bit_count;
+
+	return write_plane(plane, buf, wr - buf);
+}
+
+static int receive_analog(struct context *ctx,
+	const struct sr_datafeed_analog *analog)
+{
+	struct sr_channel *ch;
+	struct plane *plane;
+	GSList *l;
+	float *fdata;
+	uint8_t *buf, *wr;
+	size_t num_samples, num_channels, i, j;
+	int idx, ret;
+
+	num_samples = analog->num_samples;
+	num_channels = g_slist_length(analog->meaning->channels);
+	if (!num_samples || !num_channels)
+		return SR_OK;
+
+	if (num_samples * num_channels > ctx->fdata_size) {
+		fdata = g_try_realloc(ctx->fdata,
+			num_samples * num_channels * sizeof(float));
+		if (!fdata)
+			return SR_ERR_MALLOC;
+		ctx->fdata = fdata;
+		ctx->fdata_size = num_samples * num_channels;
+	}
+	ret = sr_analog_to_float_prepared(analog, ctx->fdata);
+	if (ret != SR_OK)
+		return ret;
+
+	buf = get_buffer(ctx, num_samples * sizeof(float));
+	if (!buf)
+		return SR_ERR_MALLOC;
+
+	/* Samples of several channels are interleaved, split them. */
+	for (l = analog->meaning->channels, j = 0; l; l = l->next, j++) {
+		ch = l->data;
+		idx = g_slist_index(ctx->analog_channels, ch);
+		if (idx < 0)
+			continue;
+		plane = &ctx->analog[idx];
+		wr = buf;
+		for (i = 0; i < num_samples; i++)
+			write_fltle_inc(&wr, ctx->fdata[i * num_channels + j]);
+		ret = write_plane(plane, buf, wr - buf);
+		if (ret != SR_OK)
+			return ret;
+	}
+
+	return SR_OK;
+}
+
+static int receive(const struct sr_output *o, const struct sr_datafeed_packet *packet,
+		GString **out)
+{
+	struct context *ctx;
+	size_t i;
+	int ret;
+
+	*out = NULL;
+	if (!o || !o->sdi)
+		return SR_ERR_ARG;
+	if (!(ctx = o->priv))
+		return SR_ERR_ARG;
+
+	switch (packet->type) {
+	case SR_DF_LOGIC:
+		for (i = 0; i < ctx->num_logic; i++) {
+			ret = receive_logic(ctx, &ctx->logic[i], packet->payload);
+			if (ret != SR_OK)
+				return ret;
+		}
+		break;
+	case SR_DF_ANALOG:
+		return receive_analog(ctx, packet->payload);
+	case SR_DF_END:
+		/* Write out partial bytes of the bit planes. */
+		for (i = 0; i < ctx->num_logic; i++) {
+			if (!ctx->logic[i].bit_count)
+				continue;
+			ret = write_plane(&ctx->logic[i], &ctx->logic[i].bits, 1);
+			if (ret != SR_OK)
+				return ret;
+			ctx->logic[i].bits = 0;
+			ctx->logic[i].bit_count = 0;
+		}
+		for (i = 0; i < ctx->num_logic; i++)
+			fflush(ctx->logic[i].file);
+		for (i = 0; i < ctx->num_analog; i++)
+			fflush(ctx->analog[i].file);
+		break;
+	}
+
+	return SR_OK;
+}
+
+static int cleanup(struct sr_output *o)
+{
+	struct context *ctx;
+	size_t i;
+
+	if (!o)
+		return SR_ERR_ARG;
+
+	if (!(ctx = o->priv))
+		return SR_OK;
+
+	for (i = 0; i < ctx->num_logic; i++) {
+		if (ctx->logic[i].file)
+			fclose(ctx->logic[i].file);
+	}
+	for (i = 0; i < ctx->num_analog; i++) {
+		if (ctx->analog[i].file)
+			fclose(ctx->analog[i].file);
+	}
+	g_free(ctx->logic);
+	g_free(ctx->analog);
+	g_slist_free(ctx->analog_channels);
+	g_free(ctx->buf);
+	g_free(ctx->fdata);
+	g_free(ctx);
+	o->priv = NULL;
+
+	return SR_OK;
+}
+
+SR_PRIV struct sr_output_module output_binary_planar = {
+	.id = "binary-planar",
+	.name = "Binary planar",
+	.desc = "Raw binary data, one file per channel",
+	.exts = NULL,
+	.flags = SR_OUTPUT_INTERNAL_IO_HANDLING,
+	.options = NULL,
+	.init = init,
+	.receive = receive,
+	.cleanup = cleanup,
+};
@@ -38,8 +38,70 @@ struct context {
 	char **channel_names;
 	gboolean header_done;
 	GString **lines;
+	char bit_chars[256][8];
 };
 
+/*
+ * Lookup table for the text of eight consecutive samples of a channel,
+ * the earliest sample is kept in the most significant bit.
+ */
+static void fill_bit_chars(struct context *ctx)
+{
+	size_t byte, bit;
+
+	for (byte = 0; byte < ARRAY_SIZE(ctx->bit_chars); byte++) {
+		for (bit = 0; bit < 8; bit++)
+			ctx->bit_chars[byte][bit] = (byte & (0x80 >> bit)) ? '1' : '0';
+	}
+}
+
+/* Collect a channel's bits of up to eight samples, earliest first. */
+static uint8_t gather_bits(const uint8_t *data, size_t unitsize,
+	int idx, size_t count)
+{
+	uint8_t bits, mask;
+
+	data += idx / 8;
+	mask = 1 << (idx % 8);
+	bits = 0;
+	while (count--) {
+		bits <<= 1;
+		if (*data & mask)
+			bits |= 1;
+		data += unitsize;
+	}
+
+	return bits;
+}
+
+/*
+ * Append the text of a run of samples to a channel's line. The run must
+ * not exceed the end of the line. Bits get formatted in groups of eight
+ * via table lookup, with a separator after each complete group.
+ */
+static void append_bits(struct context *ctx, size_t j,
+	const uint8_t *data, size_t unitsize, size_t count)
+{
+	GString *line;
+	size_t pos, group;
+	uint8_t bits;
+
+	line = ctx->lines[j];
+	pos = ctx->spl_cnt;
+	while (count) {
+		group = MIN(count, 8 - pos % 8);
+		bits = gather_bits(data, unitsize, ctx->channel_index[j], group);
+		bits <<= 8 - group;
+		g_string_append_len(line, ctx->bit_chars[bits], group);
+		data += group * unitsize;
+		count -= group;
+		pos += group;
+		/* Add a space every 8th bit, except at the end of a line. */
+		if (pos % 8 == 0 && (int)pos != ctx->spl)
+			g_string_append_c(line, ' ');
+	}
+}
+
 static int init(struct sr_output *o, GHashTable *options)
 {
 	struct context *ctx;
@@ -54,6 +116,7 @@ static int init(struct sr_output *o, GHashTable *options)
 	o->priv = ctx;
 	ctx->trigger = -1;
 	ctx->spl = g_variant_get_uint32(g_hash_table_lookup(options, "width"));
+	fill_bit_chars(ctx);
 
 	for (l = o->sdi->channels; l; l = l->next) {
 		ch = l->data;
@@ -124,9 +187,10 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 	const struct sr_config *src;
 	struct context *ctx;
 	GSList *l;
-	int idx, offset;
+	const uint8_t *data;
+	int offset, ret;
 	uint64_t i, j;
-	gchar *p, c;
+	size_t num_samples, count;
 
 	*out = NULL;
 	if (!o || !o->sdi)
@@ -155,37 +219,40 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 			*out = g_string_sized_new(512);
 
 		logic = packet->payload;
-		for (i = 0; i <= logic->length - logic->unitsize; i += logic->unitsize) {
-			ctx->spl_cnt++;
-			for (j = 0; j < ctx->num_enabled_channels; j++) {
-				idx = ctx->channel_index[j];
-				p = logic->data + i + idx / 8;
-				c = (*p & (1 << (idx % 8))) ? '1' : '0';
-				g_string_append_c(ctx->lines[j], c);
-
-				if (ctx->spl_cnt == ctx->spl) {
-					/* Flush line buffers. */
+		num_samples = logic->length / logic->unitsize;
+		data = logic->data;
+		while (num_samples) {
+			/* Render the samples up to the end of the current line. */
+			count = num_samples;
+			if (ctx->spl && count > (size_t)(ctx->spl - ctx->spl_cnt))
+				count = ctx->spl - ctx->spl_cnt;
+			for (j = 0; j < ctx->num_enabled_channels; j++)
+				append_bits(ctx, j, data, logic->unitsize, count);
+			ctx->spl_cnt += count;
+			data += count * logic->unitsize;
+			num_samples -= count;
+
+			if (ctx->spl_cnt == ctx->spl) {
+				/* Flush line buffers. */
+				for (j = 0; j < ctx->num_enabled_channels; j++) {
 					g_string_append_len(*out, ctx->lines[j]->str, ctx->lines[j]->len);
 					g_string_append_c(*out, '\n');
-					if (j == ctx->num_enabled_channels - 1 && ctx->trigger > -1) {
-						/*
-						 * Sample data lines have one character per bit,
-						 * plus one separator per byte. Align trigger marker
-						 * to this layout.
-						 */
-						offset = ctx->trigger + ctx->trigger / 8;
-						g_string_append_printf(*out, "T:%*s^ %d\n", offset, "", ctx->trigger);
-						ctx->trigger = -1;
-					}
 					g_string_printf(ctx->lines[j], "%s:", ctx->channel_names[j]);
-				} else if ((ctx->spl_cnt & 7) == 0) {
-					/* Add a space every 8th bit. */
-					g_string_append_c(ctx->lines[j], ' ');
 				}
-			}
-			if (ctx->spl_cnt == ctx->spl)
-				/* Line buffers were already flushed. */
+				if (ctx->trigger > -1) {
+					/*
+					 * Sample data lines have one character per bit,
+					 * plus one separator per byte. Align trigger marker
+					 * to this layout.
+					 */
+					offset = ctx->trigger + ctx->trigger / 8;
+					g_string_append_printf(*out, "T:%*s^ %d\n", offset, "", ctx->trigger);
+					ctx->trigger = -1;
+				}
 				ctx->spl_cnt = 0;
+			}
+			if ((ret = sr_output_flush(o, *out)) != SR_OK)
+				return ret;
 		}
 		break;
 	case SR_DF_END:
@@ -63,6 +63,9 @@
 
 #define LOG_PREFIX "output/csv"
 
+/* Size of the buffer which rows are formatted into. */
+#define CSV_BUFSIZE (64 * 1024)
+
 struct ctx_channel {
 	struct sr_channel *ch;
 	char *label;
@@ -99,6 +102,8 @@ struct context {
 	uint8_t *previous_sample;
 	float *analog_samples;
 	uint8_t *logic_samples;
+	/* Channel values at the end of the last change-only packet. */
+	uint8_t *edge_values;
 	const char *xlabel;	/* Don't free: will point to a static string. */
 	const char *title;	/* Don't free: will point into the driver struct. */
 
@@ -106,6 +111,11 @@ struct context {
 	gboolean have_checked;
 	gboolean have_frames;
 	uint64_t pkt_snums;
+
+	/* Formatted output, passed on whenever it fills up. */
+	char *buf;
+	size_t buf_used;
+	int write_ret;
 };
 
 /*
@@ -127,6 +137,12 @@ static int init(struct sr_output *o, GHashTable *options)
 
 	ctx = g_malloc0(sizeof(struct context));
 	o->priv = ctx;
+	ctx->buf = sr_buffer_alloc(SR_MEM_OUTPUT, CSV_BUFSIZE);
+	if (!ctx->buf) {
+		g_free(ctx);
+		o->priv = NULL;
+		return SR_ERR_MALLOC;
+	}
 
 	/* Options */
 	ctx->gnuplot = g_strdup(g_variant_get_string(
@@ -340,7 +356,7 @@ static void process_analog(struct context *ctx,
 	ctx->channels_seen += num_rcvd_ch;
 	sr_dbg("Processing packet of %zu analog channels", num_rcvd_ch);
 	fdata = g_malloc(analog->num_samples * num_rcvd_ch * sizeof(float));
-	if ((ret = sr_analog_to_float(analog, fdata)) != SR_OK)
+	if ((ret = sr_analog_to_float_prepared(analog, fdata)) != SR_OK)
 		sr_warn("Problems converting data to floating point values.");
 
 	num_have_ch = ctx->num_analog_channels + ctx->num_logic_channels;
@@ -405,13 +421,232 @@ static void process_logic(struct context *ctx,
 	}
 }
 
-static void dump_saved_values(struct context *ctx, GString **out)
+/*
+ * Like process_logic(), but for change-only packets. The channel bits
+ * are only extracted where the value changes, and copied to the other
+ * rows.
+ */
+static void process_logic_edges(struct context *ctx,
+			  const struct sr_datafeed_logic_edges *edges)
 {
+	unsigned int j, ch, num_samples;
+	uint64_t e, i, end;
+	int idx;
+	uint8_t *sample;
+
+	num_samples = edges->num_samples;
+	ctx->channels_seen += ctx->logic_channel_count;
+	if (!ctx->logic_samples) {
+		ctx->logic_samples = g_malloc(num_samples * ctx->num_logic_channels);
+		if (!ctx->num_samples)
+			ctx->num_samples = num_samples;
+	}
+	if (ctx->num_samples != num_samples)
+		sr_warn("Expecting %u samples, got %u",
+			ctx->num_samples, num_samples);
+	if (!ctx->edge_values)
+		ctx->edge_values = g_malloc0(ctx->num_logic_channels);
+
+	i = 0;
+	for (e = 0; e <= edges->num_edges; e++) {
+		end = (e < edges->num_edges) ? edges->offsets[e] : num_samples;
+		end = MIN(end, ctx->num_samples);
+		for (; i < end; i++)
+			memcpy(&ctx->logic_samples[i * ctx->num_logic_channels],
+				ctx->edge_values, ctx->num_logic_channels);
+		if (e == edges->num_edges)
+			break;
+
+		sample = (uint8_t *)edges->values + e * edges->unitsize;
+		for (j = ch = 0; ch < ctx->num_logic_channels; j++) {
+			if (ctx->channels[j].ch->type != SR_CHANNEL_LOGIC)
+				continue;
+			idx = ctx->channels[j].ch->index;
+			if (ctx->label_do && !ctx->label_names)
+				ctx->channels[j].label = "logic";
+			ctx->edge_values[ch++] = sample[idx / 8] & (1 << (idx % 8));
+		}
+	}
+}
+
+/*
+ * Pass on the formatted output: to the writer of the output instance if
+ * it has one, otherwise to the GString returned for the packet.
+ */
+static void buf_flush(const struct sr_output *o, GString **out)
+{
+	struct context *ctx;
+	int ret;
+
+	ctx = o->priv;
+	if (!ctx->buf_used)
+		return;
+	if (o->writer) {
+		ret = sr_output_write(o, (const uint8_t *)ctx->buf,
+			ctx->buf_used);
+		if (ret != SR_OK && ctx->write_ret == SR_OK)
+			ctx->write_ret = ret;
+	} else {
+		if (!*out)
+			*out = g_string_sized_new(ctx->buf_used);
+		g_string_append_len(*out, ctx->buf, ctx->buf_used);
+	}
+	ctx->buf_used = 0;
+}
+
+static void buf_append(const struct sr_output *o, GString **out,
+		const char *str, size_t len)
+{
+	struct context *ctx;
+	size_t n;
+
+	ctx = o->priv;
+	while (len) {
+		if (ctx->buf_used == CSV_BUFSIZE)
+			buf_flush(o, out);
+		n = MIN(len, CSV_BUFSIZE - ctx->buf_used);
+		memcpy(ctx->buf + ctx->buf_used, str, n);
+		ctx->buf_used += n;
+		str += n;
+		len -= n;
+	}
+}
+
+/* Get room for len bytes at the end of the buffer. */
+static char *buf_reserve(const struct sr_output *o, GString **out,
+		size_t len)
+{
+	struct context *ctx;
+
+	ctx = o->priv;
+	if (ctx->buf_used + len > CSV_BUFSIZE)
+		buf_flush(o, out);
+
+	return ctx->buf + ctx->buf_used;
+}
+
+static size_t format_u64(char *s, uint64_t value)
+{
+	char digits[20];
+	size_t n, i;
+
+	n = 0;
+	do {
+		digits[n++] = '0' + value % 10;
+		value /= 10;
+	} while (value);
+	for (i = 0; i < n; i++)
+		s[i] = digits[n - 1 - i];
+
+	return n;
+}
+
+/*
+ * Format a value like printf("%g") in the C locale does, without the
+ * overhead of printf. Needs room for 16 bytes.
+ */
+static size_t format_float(char *s, float value)
+{
+	static const double pow10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6,
+		1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16,
+		1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+	char digits[8];
+	double v, m;
+	int e, n, i, len;
+
+	len = 0;
+	if (signbit(value))
+		s[len++] = '-';
+	if (isnan(value) || isinf(value)) {
+		memcpy(s + len, isnan(value) ? "nan" : "inf", 3);
+		return len + 3;
+	}
+	v = fabs(value);
+	if (v == 0) {
+		s[len++] = '0';
+		return len;
+	}
+
+	/* Round to 6 significant digits, m is in [100000, 999999]. */
+	e = floor(log10(v));
+	for (;;) {
+		if (e <= 5 && 5 - e <= 22)
+			m = v * pow10[5 - e];
+		else if (e > 5 && e - 5 <= 22)
+			m = v / pow10[e - 5];
+		else
+			m = v * pow(10, 5 - e);
+		m = nearbyint(m);
+		if (m >= 1e6)
+			e++;
+		else if (m < 1e5)
+			e--;
+		else
+			break;
+	}
+
+	/* Drop trailing zeros, as %g does. */
+	n = format_u64(digits, (uint64_t)m);
+	while (n > 1 && digits[n - 1] == '0')
+		n--;
+
+	if (e < -4 || e >= 6) {
+		s[len++] = digits[0];
+		if (n > 1) {
+			s[len++] = '.';
+			memcpy(s + len, digits + 1, n - 1);
+			len += n - 1;
+		}
+		s[len++] = 'e';
+		s[len++] = e < 0 ? '-' : '+';
+		if (abs(e) < 10)
+			s[len++] = '0';
+		len += format_u64(s + len, abs(e));
+	} else if (e < 0) {
+		s[len++] = '0';
+		s[len++] = '.';
+		for (i = -1; i > e; i--)
+			s[len++] = '0';
+		memcpy(s + len, digits, n);
+		len += n;
+	} else {
+		for (i = 0; i <= e; i++)
+			s[len++] = i < n ? digits[i] : '0';
+		if (n > e + 1) {
+			s[len++] = '.';
+			memcpy(s + len, digits + e + 1, n - e - 1);
+			len += n - e - 1;
+		}
+	}
+
+	return len;
+}
+
+/*
+ * Format the saved values as rows of text. The rows are formatted into
+ * a reused buffer, and passed on in pieces of its size.
+ */
+static void dump_saved_values(const struct sr_output *o, GString **out)
+{
+	struct context *ctx;
 	unsigned int i, j, analog_size, num_channels;
 	double sample_time_dbl;
 	uint64_t sample_time_u64;
 	float *analog_sample, value;
 	uint8_t *logic_sample;
+	size_t value_len, record_len;
+	gboolean first;
+	const char *label;
+	char *p;
+
+	ctx = o->priv;
+
+	/* Keep the order with output which is already in the GString. */
+	if (o->writer && *out) {
+		buf_append(o, out, (*out)->str, (*out)->len);
+		g_string_free(*out, TRUE);
+		*out = NULL;
+	}
 
 	/* If we haven't seen samples we're expecting, skip them. */
 	if ((ctx->num_analog_channels && !ctx->analog_samples) ||
@@ -420,29 +655,34 @@ static void dump_saved_values(struct context *ctx, GString **out)
 	} else {
 		sr_info("Dumping %u samples", ctx->num_samples);
 
-		if (!*out)
-			*out = g_string_sized_new(512);
 		num_channels =
 		    ctx->num_logic_channels + ctx->num_analog_channels;
+		value_len = strlen(ctx->value);
+		record_len = strlen(ctx->record);
 
 		if (ctx->label_do) {
-			if (ctx->time)
-				g_string_append_printf(*out, "%s%s",
-					ctx->label_names ? "Time" : ctx->xlabel,
-					ctx->value);
+			first = TRUE;
+			if (ctx->time) {
+				label = ctx->label_names ? "Time" : ctx->xlabel;
+				buf_append(o, out, label, strlen(label));
+				first = FALSE;
+			}
 			for (i = 0; i < num_channels; i++) {
-				g_string_append_printf(*out, "%s%s",
-					ctx->channels[i].label, ctx->value);
+				if (!first)
+					buf_append(o, out, ctx->value, value_len);
+				first = FALSE;
+				label = ctx->channels[i].label;
+				buf_append(o, out, label, strlen(label));
 				if (ctx->channels[i].ch->type == SR_CHANNEL_ANALOG
 						&& ctx->label_names)
 					g_free(ctx->channels[i].label);
 			}
-			if (ctx->do_trigger)
-				g_string_append_printf(*out, "Trigger%s",
-						       ctx->value);
-			/* Drop last separator. */
-			g_string_truncate(*out, (*out)->len - 1);
-			g_string_append(*out, ctx->record);
+			if (ctx->do_trigger) {
+				if (!first)
+					buf_append(o, out, ctx->value, value_len);
+				buf_append(o, out, "Trigger", 7);
+			}
+			buf_append(o, out, ctx->record, record_len);
 
 			ctx->label_do = FALSE;
 		}
@@ -473,29 +713,34 @@ static void dump_saved_values(struct context *ctx, GString **out)
 				       analog_sample, analog_size);
 			}
 
+			first = TRUE;
 			if (ctx->time && !ctx->sample_rate) {
-				g_string_append_printf(*out, "0%s", ctx->value);
+				buf_append(o, out, "0", 1);
+				first = FALSE;
 			} else if (ctx->time) {
 				sample_time_dbl = ctx->out_sample_count++;
 				sample_time_dbl /= ctx->sample_rate;
 				sample_time_dbl *= ctx->sample_scale;
 				sample_time_u64 = sample_time_dbl;
-				g_string_append_printf(*out, "%" PRIu64 "%s",
-					sample_time_u64, ctx->value);
+				p = buf_reserve(o, out, 20);
+				ctx->buf_used += format_u64(p, sample_time_u64);
+				first = FALSE;
 			}
 
 			for (j = 0; j < num_channels; j++) {
+				if (!first)
+					buf_append(o, out, ctx->value, value_len);
+				first = FALSE;
 				if (ctx->channels[j].ch->type == SR_CHANNEL_ANALOG) {
 					value = ctx->analog_samples[i * ctx->num_analog_channels + j];
 					ctx->channels[j].max =
 					    fmax(value, ctx->channels[j].max);
 					ctx->channels[j].min =
 					    fmin(value, ctx->channels[j].min);
-					g_string_append_printf(*out, "%g%s",
-						value, ctx->value);
+					p = buf_reserve(o, out, 16);
+					ctx->buf_used += format_float(p, value);
 				} else if (ctx->channels[j].ch->type == SR_CHANNEL_LOGIC) {
-					g_string_append_printf(*out, "%c%s",
-							       ctx->logic_samples[i * ctx->num_logic_channels + j] ? '1' : '0', ctx->value);
+					buf_append(o, out, ctx->logic_samples[i * ctx->num_logic_channels + j] ? "1" : "0", 1);
 				} else {
 					sr_warn("Unexpected channel type: %d",
 						ctx->channels[i].ch->type);
@@ -503,14 +748,15 @@ static void dump_saved_values(struct context *ctx, GString **out)
 			}
 
 			if (ctx->do_trigger) {
-				g_string_append_printf(*out, "%d%s",
-					ctx->trigger, ctx->value);
+				if (!first)
+					buf_append(o, out, ctx->value, value_len);
+				buf_append(o, out, ctx->trigger ? "1" : "0", 1);
 				ctx->trigger = FALSE;
 			}
-			g_string_truncate(*out, (*out)->len - 1);
-			g_string_append(*out, ctx->record);
+			buf_append(o, out, ctx->record, record_len);
 		}
 	}
+	buf_flush(o, out);
 
 	/* Discard all of the working space. */
 	g_free(ctx->previous_sample);
@@ -659,7 +905,9 @@ static int receive(const struct sr_output *o,
 {
 	struct context *ctx;
 	const struct sr_datafeed_logic *logic;
+	const struct sr_datafeed_logic_edges *edges;
 	const struct sr_datafeed_analog *analog;
+	int ret;
 
 	*out = NULL;
 	if (!o || !o->sdi)
@@ -673,21 +921,27 @@ static int receive(const struct sr_output *o,
 		ctx->have_checked = FALSE;
 		ctx->have_frames = FALSE;
 		ctx->pkt_snums = FALSE;
+		g_free(ctx->edge_values);
+		ctx->edge_values = NULL;
 		*out = gen_header(o, packet->payload);
 		break;
 	case SR_DF_TRIGGER:
 		ctx->trigger = TRUE;
 		break;
 	case SR_DF_LOGIC:
-		*out = g_string_sized_new(512);
 		logic = packet->payload;
 		ctx->pkt_snums = logic->length;
 		ctx->pkt_snums /= logic->length;
 		check_input_constraints(ctx);
 		process_logic(ctx, logic);
 		break;
+	case SR_DF_LOGIC_EDGES:
+		edges = packet->payload;
+		ctx->pkt_snums = edges->num_samples;
+		check_input_constraints(ctx);
+		process_logic_edges(ctx, edges);
+		break;
 	case SR_DF_ANALOG:
-		*out = g_string_sized_new(512);
 		analog = packet->payload;
 		ctx->pkt_snums = analog->num_samples;
 		ctx->pkt_snums /= g_slist_length(analog->meaning->channels);
@@ -709,9 +963,12 @@ static int receive(const struct sr_output *o,
 
 	/* If we've got them all, dump the values. */
 	if (ctx->channels_seen >= ctx->channel_count)
-		dump_saved_values(ctx, out);
+		dump_saved_values(o, out);
 
-	return SR_OK;
+	ret = ctx->write_ret;
+	ctx->write_ret = SR_OK;
+
+	return ret;
 }
 
 static int cleanup(struct sr_output *o)
@@ -729,7 +986,9 @@ static int cleanup(struct sr_output *o)
 		g_free((gpointer)ctx->gnuplot);
 		g_free((gpointer)ctx->value);
 		g_free(ctx->previous_sample);
+		g_free(ctx->edge_values);
 		g_free(ctx->channels);
+		sr_buffer_free(ctx->buf);
 		g_free(o->priv);
 		o->priv = NULL;
 	}
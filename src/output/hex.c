@@ -43,6 +43,64 @@ struct context {
 	GString **lines;
 };
 
+static const char hex_digits[] = "0123456789abcdef";
+
+/* Collect a channel's bits of up to eight samples, earliest first. */
+static uint8_t gather_bits(const uint8_t *data, size_t unitsize,
+	int idx, size_t count)
+{
+	uint8_t bits, mask;
+
+	data += idx / 8;
+	mask = 1 << (idx % 8);
+	bits = 0;
+	while (count--) {
+		bits <<= 1;
+		if (*data & mask)
+			bits |= 1;
+		data += unitsize;
+	}
+
+	return bits;
+}
+
+static void append_hex(GString *line, uint8_t byte)
+{
+	char text[3];
+
+	text[0] = hex_digits[byte >> 4];
+	text[1] = hex_digits[byte & 0x0f];
+	text[2] = ' ';
+	g_string_append_len(line, text, sizeof(text));
+}
+
+/*
+ * Append a run of samples to a channel's line. The run must not exceed
+ * the end of the line. Bits get collected in groups of eight, and each
+ * complete group is output as a hex byte.
+ */
+static void append_samples(struct context *ctx, size_t j,
+	const uint8_t *data, size_t unitsize, size_t count)
+{
+	size_t pos, group;
+	uint8_t bits;
+
+	pos = ctx->spl_cnt;
+	while (count) {
+		group = MIN(count, 8 - pos % 8);
+		bits = gather_bits(data, unitsize, ctx->channel_index[j], group);
+		ctx->sample_buf[j] = (ctx->sample_buf[j] << group) | bits;
+		data += group * unitsize;
+		count -= group;
+		pos += group;
+		if (pos % 8 == 0) {
+			/* Buffered a byte's worth, output hex. */
+			append_hex(ctx->lines[j], ctx->sample_buf[j]);
+			ctx->sample_buf[j] = 0;
+		}
+	}
+}
+
 static int init(struct sr_output *o, GHashTable *options)
 {
 	struct context *ctx;
@@ -129,9 +187,10 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 	const struct sr_config *src;
 	GSList *l;
 	struct context *ctx;
-	int idx, pos, offset;
+	const uint8_t *data;
+	int offset, ret;
 	uint64_t i, j;
-	gchar *p;
+	size_t num_samples, count;
 
 	*out = NULL;
 	if (!o || !o->sdi)
@@ -160,42 +219,40 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 			*out = g_string_sized_new(512);
 
 		logic = packet->payload;
-		for (i = 0; i <= logic->length - logic->unitsize; i += logic->unitsize) {
-			ctx->spl_cnt++;
-			pos = ctx->spl_cnt & 7;
-			for (j = 0; j < ctx->num_enabled_channels; j++) {
-				idx = ctx->channel_index[j];
-				p = logic->data + i + idx / 8;
-				ctx->sample_buf[j] <<= 1;
-				if (*p & (1 << (idx % 8)))
-					ctx->sample_buf[j] |= 1;
-				if (ctx->spl_cnt && pos == 0) {
-					/* Buffered a byte's worth, output hex. */
-					g_string_append_printf(ctx->lines[j], "%.2x ",
-							ctx->sample_buf[j]);
-					ctx->sample_buf[j] = 0;
-				}
+		num_samples = logic->length / logic->unitsize;
+		data = logic->data;
+		while (num_samples) {
+			/* Render the samples up to the end of the current line. */
+			count = num_samples;
+			if (ctx->spl && count > (size_t)(ctx->spl - ctx->spl_cnt))
+				count = ctx->spl - ctx->spl_cnt;
+			for (j = 0; j < ctx->num_enabled_channels; j++)
+				append_samples(ctx, j, data, logic->unitsize, count);
+			ctx->spl_cnt += count;
+			data += count * logic->unitsize;
+			num_samples -= count;
 
-				if (ctx->spl_cnt == ctx->spl) {
-					/* Flush line buffers. */
+			if (ctx->spl_cnt == ctx->spl) {
+				/* Flush line buffers. */
+				for (j = 0; j < ctx->num_enabled_channels; j++) {
 					g_string_append_len(*out, ctx->lines[j]->str, ctx->lines[j]->len);
 					g_string_append_c(*out, '\n');
-					if (j == ctx->num_enabled_channels - 1 && ctx->trigger > -1) {
-						/*
-						 * Sample data lines have one character per nibble,
-						 * plus one separator per byte. Align trigger marker
-						 * to this layout.
-						 */
-						offset = ctx->trigger / 4 + ctx->trigger / 8;
-						g_string_append_printf(*out, "T:%*s^ %d\n", offset, "", ctx->trigger);
-						ctx->trigger = -1;
-					}
 					g_string_printf(ctx->lines[j], "%s:", ctx->channel_names[j]);
 				}
-			}
-			if (ctx->spl_cnt == ctx->spl)
-				/* Line buffers were already flushed. */
+				if (ctx->trigger > -1) {
+					/*
+					 * Sample data lines have one character per nibble,
+					 * plus one separator per byte. Align trigger marker
+					 * to this layout.
+					 */
+					offset = ctx->trigger / 4 + ctx->trigger / 8;
+					g_string_append_printf(*out, "T:%*s^ %d\n", offset, "", ctx->trigger);
+					ctx->trigger = -1;
+				}
 				ctx->spl_cnt = 0;
+			}
+			if ((ret = sr_output_flush(o, *out)) != SR_OK)
+				return ret;
 		}
 		break;
 	case SR_DF_END:
@@ -204,8 +261,8 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 			*out = g_string_sized_new(512);
 			for (i = 0; i < ctx->num_enabled_channels; i++) {
 				if (ctx->spl_cnt & 7)
-					g_string_append_printf(ctx->lines[i], "%.2x ",
-							ctx->sample_buf[i] << (8 - (ctx->spl_cnt & 7)));
+					append_hex(ctx->lines[i],
+						ctx->sample_buf[i] << (8 - (ctx->spl_cnt & 7)));
 				g_string_append_len(*out, ctx->lines[i]->str, ctx->lines[i]->len);
 				g_string_append_c(*out, '\n');
 			}
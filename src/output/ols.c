@@ -36,6 +36,10 @@
 struct context {
 	uint64_t samplerate;
 	uint64_t num_samples;
+	/* The most recent sample, and the index it was last written at. */
+	uint8_t *last_sample;
+	uint16_t unitsize;
+	uint64_t last_written;
 };
 
 static int init(struct sr_output *o, GHashTable *options)
@@ -86,16 +90,94 @@ static GString *gen_header(const struct sr_dev_inst *sdi, struct context *ctx)
 	return s;
 }
 
+/*
+ * Samples of the compressed format only get written where the value
+ * changes, each with its sample index.
+ */
+static void write_sample(struct context *ctx, GString *out,
+	const uint8_t *sample, uint64_t snum)
+{
+	static const char hex_digits[] = "0123456789abcdef";
+	char *p;
+	size_t i;
+	uint8_t c;
+
+	g_string_set_size(out, out->len + 2 * ctx->unitsize);
+	p = out->str + out->len - 2 * ctx->unitsize;
+	for (i = 0; i < ctx->unitsize; i++) {
+		/* The OLS format wants the samples presented MSB first. */
+		c = sample[ctx->unitsize - 1 - i];
+		*p++ = hex_digits[c >> 4];
+		*p++ = hex_digits[c & 0x0f];
+	}
+	g_string_append_printf(out, "@%"PRIu64"\n", snum);
+	ctx->last_written = snum;
+}
+
+static int check_unitsize(struct context *ctx, uint16_t unitsize)
+{
+	if (ctx->last_sample) {
+		if (unitsize == ctx->unitsize)
+			return SR_OK;
+		sr_err("Logic unit size changed during acquisition.");
+		return SR_ERR_DATA;
+	}
+	ctx->unitsize = unitsize;
+	ctx->last_sample = g_malloc0(unitsize);
+
+	return SR_OK;
+}
+
+static void receive_logic(struct context *ctx, GString *out,
+	const struct sr_datafeed_logic *logic)
+{
+	const uint8_t *sample, *end;
+	size_t run;
+
+	sample = logic->data;
+	end = sample + logic->length / ctx->unitsize * ctx->unitsize;
+	while (sample < end) {
+		if (ctx->num_samples == 0 ||
+				memcmp(ctx->last_sample, sample, ctx->unitsize)) {
+			memcpy(ctx->last_sample, sample, ctx->unitsize);
+			write_sample(ctx, out, sample, ctx->num_samples);
+		}
+
+		/* Skip the run of samples which equal this one. */
+		run = sr_simd_find_mismatch(sample + ctx->unitsize, sample,
+			end - sample - ctx->unitsize);
+		run = run / ctx->unitsize + 1;
+		ctx->num_samples += run;
+		sample += run * ctx->unitsize;
+	}
+}
+
+static void receive_edges(struct context *ctx, GString *out,
+	const struct sr_datafeed_logic_edges *edges)
+{
+	const uint8_t *sample;
+	uint64_t i, snum;
+
+	for (i = 0; i < edges->num_edges; i++) {
+		sample = (const uint8_t *)edges->values + i * ctx->unitsize;
+		snum = ctx->num_samples + edges->offsets[i];
+		if (snum == 0 || memcmp(ctx->last_sample, sample, ctx->unitsize)) {
+			memcpy(ctx->last_sample, sample, ctx->unitsize);
+			write_sample(ctx, out, sample, snum);
+		}
+	}
+	ctx->num_samples += edges->num_samples;
+}
+
 static int receive(const struct sr_output *o, const struct sr_datafeed_packet *packet,
 		GString **out)
 {
 	struct context *ctx;
 	const struct sr_datafeed_meta *meta;
-	const struct sr_datafeed_logic *logic;
 	const struct sr_config *src;
 	GSList *l;
-	unsigned int i, j;
-	uint8_t c;
+	uint16_t unitsize;
+	int ret;
 
 	*out = NULL;
 	if (!o || !o->sdi)
@@ -112,19 +194,27 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 		}
 		break;
 	case SR_DF_LOGIC:
-		logic = packet->payload;
+	case SR_DF_LOGIC_EDGES:
+		unitsize = packet->type == SR_DF_LOGIC ?
+			((const struct sr_datafeed_logic *)packet->payload)->unitsize :
+			((const struct sr_datafeed_logic_edges *)packet->payload)->unitsize;
+		if ((ret = check_unitsize(ctx, unitsize)) != SR_OK)
+			return ret;
 		if (ctx->num_samples == 0) {
 			/* First logic packet in the feed. */
 			*out = gen_header(o->sdi, ctx);
 		} else
 			*out = g_string_sized_new(512);
-		for (i = 0; i <= logic->length - logic->unitsize; i += logic->unitsize) {
-			for (j = 0; j < logic->unitsize; j++) {
-				/* The OLS format wants the samples presented MSB first. */
-				c = *((uint8_t *)logic->data + i + logic->unitsize - 1 - j);
-				g_string_append_printf(*out, "%02x", c);
-			}
-			g_string_append_printf(*out, "@%"PRIu64"\n", ctx->num_samples++);
+		if (packet->type == SR_DF_LOGIC)
+			receive_logic(ctx, *out, packet->payload);
+		else
+			receive_edges(ctx, *out, packet->payload);
+		break;
+	case SR_DF_END:
+		/* The last sample determines the length of the capture. */
+		if (ctx->num_samples && ctx->last_written != ctx->num_samples - 1) {
+			*out = g_string_sized_new(64);
+			write_sample(ctx, *out, ctx->last_sample, ctx->num_samples - 1);
 		}
 		break;
 	}
@@ -140,6 +230,7 @@ static int cleanup(struct sr_output *o)
 		return SR_ERR_ARG;
 
 	ctx = o->priv;
+	g_free(ctx->last_sample);
 	g_free(ctx);
 	o->priv = NULL;
 
@@ -18,7 +18,9 @@
  */
 
 #include <config.h>
+#include <errno.h>
 #include <string.h>
+#include <unistd.h>
 #include <libsigrok/libsigrok.h>
 #include "libsigrok-internal.h"
 
@@ -57,6 +59,8 @@ extern SR_PRIV struct sr_output_module output_bits;
 extern SR_PRIV struct sr_output_module output_hex;
 extern SR_PRIV struct sr_output_module output_ascii;
 extern SR_PRIV struct sr_output_module output_binary;
+extern SR_PRIV struct sr_output_module output_binary_analog;
+extern SR_PRIV struct sr_output_module output_binary_planar;
 extern SR_PRIV struct sr_output_module output_vcd;
 extern SR_PRIV struct sr_output_module output_ols;
 extern SR_PRIV struct sr_output_module output_chronovu_la8;
@@ -65,12 +69,19 @@ extern SR_PRIV struct sr_output_module output_analog;
 extern SR_PRIV struct sr_output_module output_srzip;
 extern SR_PRIV struct sr_output_module output_wav;
 extern SR_PRIV struct sr_output_module output_wavedrom;
+extern SR_PRIV struct sr_output_module output_zarr;
+extern SR_PRIV struct sr_output_module output_srnet;
 extern SR_PRIV struct sr_output_module output_null;
+#ifdef HAVE_ARROW
+extern SR_PRIV struct sr_output_module output_arrow;
+#endif
 /** @endcond */
 
 static const struct sr_output_module *output_module_list[] = {
 	&output_ascii,
 	&output_binary,
+	&output_binary_analog,
+	&output_binary_planar,
 	&output_bits,
 	&output_csv,
 	&output_hex,
@@ -81,7 +92,12 @@ static const struct sr_output_module *output_module_list[] = {
 	&output_srzip,
 	&output_wav,
 	&output_wavedrom,
+	&output_zarr,
+	&output_srnet,
 	&output_null,
+#ifdef HAVE_ARROW
+	&output_arrow,
+#endif
 	NULL,
 };
 
@@ -271,7 +287,7 @@ SR_API const struct sr_output *sr_output_new(const struct sr_output_module *omod
 	gpointer key, value;
 	int i;
 
-	op = g_malloc(sizeof(struct sr_output));
+	op = g_malloc0(sizeof(struct sr_output));
 	op->module = omod;
 	op->sdi = sdi;
 	op->filename = g_strdup(filename);
@@ -336,7 +352,134 @@ SR_API const struct sr_output *sr_output_new(const struct sr_output_module *omod
 SR_API int sr_output_send(const struct sr_output *o,
 		const struct sr_datafeed_packet *packet, GString **out)
 {
-	return o->module->receive(o, packet, out);
+	int ret;
+
+	ret = o->module->receive(o, packet, out);
+	if (!o->writer || !*out)
+		return ret;
+
+	/* Pass on the rest of the GString which the module built. */
+	if (ret == SR_OK && (*out)->len)
+		ret = sr_output_write(o, (const uint8_t *)(*out)->str,
+			(*out)->len);
+	g_string_free(*out, TRUE);
+	*out = NULL;
+
+	return ret;
+}
+
+/**
+ * Have the output of an output instance written by a callback.
+ *
+ * Once set, sr_output_send() passes all output to the callback, and
+ * always stores NULL in its out parameter. Output modules which support
+ * it write their output in pieces of a reused buffer, so no GString is
+ * built per packet. The callback returns SR_OK, or an error code which
+ * sr_output_send() passes on.
+ *
+ * @param o The output instance. Must not be NULL.
+ * @param cb The callback, or NULL to return output in a GString again.
+ * @param cb_data Opaque pointer passed to the callback.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_output_set_writer(const struct sr_output *o,
+		sr_output_write_callback cb, void *cb_data)
+{
+	struct sr_output *op;
+
+	if (!o)
+		return SR_ERR_ARG;
+
+	op = (struct sr_output *)o;
+	op->writer = cb;
+	op->writer_data = cb_data;
+
+	return SR_OK;
+}
+
+static int write_fd(const struct sr_output *o, const uint8_t *data,
+		size_t length, void *cb_data)
+{
+	int fd;
+	ssize_t ret;
+
+	(void)o;
+
+	fd = GPOINTER_TO_INT(cb_data);
+	while (length) {
+		ret = write(fd, data, length);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret < 0) {
+			sr_err("Cannot write output: %s.", g_strerror(errno));
+			return SR_ERR_IO;
+		}
+		data += ret;
+		length -= ret;
+	}
+
+	return SR_OK;
+}
+
+/**
+ * Have the output of an output instance written to a file descriptor.
+ *
+ * This is sr_output_set_writer() with a writer which passes all output
+ * to write(). The caller keeps ownership of the file descriptor.
+ *
+ * @param o The output instance. Must not be NULL.
+ * @param fd The file descriptor to write to.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_output_set_fd(const struct sr_output *o, int fd)
+{
+	if (fd < 0)
+		return SR_ERR_ARG;
+
+	return sr_output_set_writer(o, write_fd, GINT_TO_POINTER(fd));
+}
+
+/**
+ * Pass a piece of output to the writer callback of an output instance.
+ *
+ * @private
+ */
+SR_PRIV int sr_output_write(const struct sr_output *o,
+		const uint8_t *data, size_t length)
+{
+	if (!o->writer || !length)
+		return SR_OK;
+
+	return o->writer(o, data, length, o->writer_data);
+}
+
+/**
+ * Pass on the output which a module collected in a GString so far, if
+ * the instance has a writer and enough output was collected. Modules
+ * call this while they format a large packet, which bounds the size of
+ * the GString. It gets emptied and reused.
+ *
+ * @private
+ */
+SR_PRIV int sr_output_flush(const struct sr_output *o, GString *out)
+{
+	int ret;
+
+	if (!o->writer || !out || out->len < SR_OUTPUT_FLUSH_SIZE)
+		return SR_OK;
+
+	ret = sr_output_write(o, (const uint8_t *)out->str, out->len);
+	g_string_truncate(out, 0);
+
+	return ret;
 }
 
 /**
@@ -360,4 +503,188 @@ SR_API int sr_output_free(const struct sr_output *o)
 	return ret;
 }
 
+/** @cond PRIVATE */
+struct output_job {
+	struct sr_output_group *group;
+	const struct sr_output *o;
+	GString *out;
+	int ret;
+};
+
+struct sr_output_group {
+	GArray *jobs;
+	GThreadPool *pool;
+	const struct sr_datafeed_packet *packet;
+	GMutex mutex;
+	GCond done;
+	guint pending;
+};
+/** @endcond */
+
+static void output_job_run(gpointer data, gpointer user_data)
+{
+	struct output_job *job;
+	struct sr_output_group *group;
+
+	(void)user_data;
+
+	job = data;
+	group = job->group;
+	job->out = NULL;
+	job->ret = sr_output_send(job->o, group->packet, &job->out);
+
+	g_mutex_lock(&group->mutex);
+	if (!--group->pending)
+		g_cond_signal(&group->done);
+	g_mutex_unlock(&group->mutex);
+}
+
+/**
+ * Create a group of output instances which receive packets together.
+ *
+ * sr_output_group_send() passes a packet to all members of the group
+ * concurrently, so recording and exporting at the same time costs the
+ * time of the slowest output, not the sum of all of them.
+ *
+ * @return A new, empty output group. Free it with sr_output_group_free().
+ *
+ * @since 0.6.0
+ */
+SR_API struct sr_output_group *sr_output_group_new(void)
+{
+	struct sr_output_group *group;
+
+	group = g_malloc0(sizeof(*group));
+	group->jobs = g_array_new(FALSE, TRUE, sizeof(struct output_job));
+	g_mutex_init(&group->mutex);
+	g_cond_init(&group->done);
+
+	return group;
+}
+
+/**
+ * Add an output instance to an output group.
+ *
+ * The group does not take ownership of the instance, which must stay
+ * valid until the group is freed. An instance must not be a member of
+ * more than one group, nor get packets sent by other means meanwhile.
+ *
+ * @param group The output group. Must not be NULL.
+ * @param o The output instance. Must not be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_output_group_add(struct sr_output_group *group,
+		const struct sr_output *o)
+{
+	struct output_job job;
+
+	if (!group || !o)
+		return SR_ERR_ARG;
+
+	memset(&job, 0, sizeof(job));
+	job.group = group;
+	job.o = o;
+	g_array_append_val(group->jobs, job);
+
+	/* Have the pool created again with the new number of members. */
+	if (group->pool) {
+		g_thread_pool_free(group->pool, FALSE, TRUE);
+		group->pool = NULL;
+	}
+
+	return SR_OK;
+}
+
+/**
+ * Send a packet to all output instances of an output group.
+ *
+ * The members process the packet concurrently on a thread pool, the
+ * call returns when all of them are done. Thus each member receives
+ * its packets in order. Writer callbacks of the members get called
+ * from the pool's threads.
+ *
+ * @param group The output group. Must not be NULL.
+ * @param packet The packet to send.
+ * @param outs Array with an element per member in the order they were
+ *             added, which receives each member's output as returned
+ *             by sr_output_send(). The caller must free these with
+ *             g_string_free(). May be NULL when all members have a
+ *             writer, any output gets discarded then.
+ *
+ * @return SR_OK, or the error code of the first member which failed.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_output_group_send(struct sr_output_group *group,
+		const struct sr_datafeed_packet *packet, GString **outs)
+{
+	struct output_job *jobs;
+	guint i, num_jobs, threads;
+	int ret;
+
+	if (!group || !packet)
+		return SR_ERR_ARG;
+
+	jobs = (struct output_job *)group->jobs->data;
+	num_jobs = group->jobs->len;
+	if (!num_jobs)
+		return SR_OK;
+
+	/* The calling thread runs the first member itself. */
+	if (!group->pool && num_jobs > 1) {
+		threads = MIN(num_jobs - 1, g_get_num_processors());
+		group->pool = g_thread_pool_new(output_job_run, NULL,
+			threads, FALSE, NULL);
+	}
+
+	group->packet = packet;
+	group->pending = num_jobs;
+	for (i = 1; i < num_jobs; i++)
+		g_thread_pool_push(group->pool, &jobs[i], NULL);
+	output_job_run(&jobs[0], NULL);
+
+	g_mutex_lock(&group->mutex);
+	while (group->pending)
+		g_cond_wait(&group->done, &group->mutex);
+	g_mutex_unlock(&group->mutex);
+	group->packet = NULL;
+
+	ret = SR_OK;
+	for (i = 0; i < num_jobs; i++) {
+		if (ret == SR_OK && jobs[i].ret != SR_OK)
+			ret = jobs[i].ret;
+		if (outs)
+			outs[i] = jobs[i].out;
+		else if (jobs[i].out)
+			g_string_free(jobs[i].out, TRUE);
+		jobs[i].out = NULL;
+	}
+
+	return ret;
+}
+
+/**
+ * Free an output group. The member output instances are not freed.
+ *
+ * @param group The output group. May be NULL.
+ *
+ * @since 0.6.0
+ */
+SR_API void sr_output_group_free(struct sr_output_group *group)
+{
+	if (!group)
+		return;
+
+	if (group->pool)
+		g_thread_pool_free(group->pool, FALSE, TRUE);
+	g_array_free(group->jobs, TRUE);
+	g_mutex_clear(&group->mutex);
+	g_cond_clear(&group->done);
+	g_free(group);
+}
+
 /** @} */
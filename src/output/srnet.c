@@ -0,0 +1,613 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Packet stream output, for processing an acquisition on another host,
+ * see srnet.h for the format. The srnet input module reads it back.
+ *
+ * Data packets are batched up to the "batch" size, consecutive logic
+ * packets get merged into one frame. Other packets flush the batch, so
+ * that triggers and frame boundaries arrive without delay. Batches are
+ * optionally compressed with zlib.
+ *
+ * The stream goes to the output file, or with the "host" option to a
+ * TCP connection. The connection's flow control holds the sender back
+ * when the receiver cannot keep up; with asynchronous dispatch and the
+ * drop policy, the session then drops packets instead of stalling the
+ * device.
+ */
+
+#include <config.h>
+#ifdef _WIN32
+#define _WIN32_WINNT 0x0501
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#endif
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <glib.h>
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+#endif
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+#include "srnet.h"
+
+#define LOG_PREFIX "output/srnet"
+
+#define DEFAULT_BATCH_SIZE (64 * 1024)
+/* Smaller batches don't gain from compression. */
+#define COMPRESS_MIN_LEN 512
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+struct context {
+	GString *batch;
+	size_t batch_size;
+	/* Offset of the last frame in the batch, if it is a logic frame. */
+	gboolean last_logic;
+	size_t last_offset;
+	uint16_t last_unitsize;
+	gboolean compress;
+	int level;
+	int socket;
+	float *fbuf;
+	size_t fbuf_size;
+};
+
+static void put_u8(GString *s, uint8_t v)
+{
+	g_string_append_c(s, v);
+}
+
+static void put_u16(GString *s, uint16_t v)
+{
+	uint8_t b[sizeof(v)];
+
+	WL16(b, v);
+	g_string_append_len(s, (const char *)b, sizeof(b));
+}
+
+static void put_u32(GString *s, uint32_t v)
+{
+	uint8_t b[sizeof(v)];
+
+	WL32(b, v);
+	g_string_append_len(s, (const char *)b, sizeof(b));
+}
+
+static void put_u64(GString *s, uint64_t v)
+{
+	uint8_t b[sizeof(v)];
+
+	WL64(b, v);
+	g_string_append_len(s, (const char *)b, sizeof(b));
+}
+
+static void put_dbl(GString *s, double v)
+{
+	uint8_t b[sizeof(v)];
+
+	write_dblle(b, v);
+	g_string_append_len(s, (const char *)b, sizeof(b));
+}
+
+static void put_rational(GString *s, const struct sr_rational *r)
+{
+	put_u64(s, (uint64_t)r->p);
+	put_u64(s, r->q);
+}
+
+/* Start a frame, its length gets set by frame_end(). */
+static size_t frame_begin(struct context *ctx, uint8_t type)
+{
+	size_t offset;
+
+	offset = ctx->batch->len;
+	put_u8(ctx->batch, type);
+	put_u8(ctx->batch, 0);
+	put_u16(ctx->batch, 0);
+	put_u32(ctx->batch, 0);
+	ctx->last_logic = FALSE;
+
+	return offset;
+}
+
+static void frame_end(struct context *ctx, size_t offset)
+{
+	WL32(ctx->batch->str + offset + 4,
+		ctx->batch->len - offset - SRNET_FRAME_HEADER_LEN);
+}
+
+static int connect_host(struct context *ctx, const char *host, uint32_t port)
+{
+	struct addrinfo hints, *results, *res;
+	char service[16];
+	int err;
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_protocol = IPPROTO_TCP;
+	snprintf(service, sizeof(service), "%u", port);
+	if ((err = getaddrinfo(host, service, &hints, &results))) {
+		sr_err("Address lookup failed: %s:%s: %s", host, service,
+			gai_strerror(err));
+		return SR_ERR;
+	}
+
+	ctx->socket = -1;
+	for (res = results; res; res = res->ai_next) {
+		if ((ctx->socket = socket(res->ai_family, res->ai_socktype,
+				res->ai_protocol)) < 0)
+			continue;
+		if (connect(ctx->socket, res->ai_addr, res->ai_addrlen) != 0) {
+			close(ctx->socket);
+			ctx->socket = -1;
+			continue;
+		}
+		break;
+	}
+	freeaddrinfo(results);
+
+	if (ctx->socket < 0) {
+		sr_err("Failed to connect to %s:%s: %s", host, service,
+			g_strerror(errno));
+		return SR_ERR;
+	}
+	sr_info("Streaming to %s:%s.", host, service);
+
+	return SR_OK;
+}
+
+static int send_all(struct context *ctx, const char *data, size_t len)
+{
+	ssize_t ret;
+
+	while (len) {
+		ret = send(ctx->socket, data, len, MSG_NOSIGNAL);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret <= 0) {
+			sr_err("Cannot send to the receiver: %s.",
+				g_strerror(errno));
+			return SR_ERR_IO;
+		}
+		data += ret;
+		len -= ret;
+	}
+
+	return SR_OK;
+}
+
+#ifdef HAVE_ZLIB
+/* Replace the batch by a ZLIB frame holding it, if that is smaller. */
+static void compress_batch(struct context *ctx)
+{
+	GString *z;
+	uLongf zlen;
+
+	zlen = compressBound(ctx->batch->len);
+	z = g_string_sized_new(SRNET_FRAME_HEADER_LEN + 4 + zlen);
+	put_u8(z, SRNET_ZLIB);
+	put_u8(z, 0);
+	put_u16(z, 0);
+	put_u32(z, 0);
+	put_u32(z, ctx->batch->len);
+	if (compress2((Bytef *)z->str + z->len, &zlen,
+			(const Bytef *)ctx->batch->str, ctx->batch->len,
+			ctx->level) != Z_OK || zlen + 4 >= ctx->batch->len) {
+		g_string_free(z, TRUE);
+		return;
+	}
+	g_string_set_size(z, z->len + zlen);
+	WL32(z->str + 4, z->len - SRNET_FRAME_HEADER_LEN);
+	g_string_free(ctx->batch, TRUE);
+	ctx->batch = z;
+}
+#endif
+
+/* Pass the batch on, to the connection or as the output. */
+static int flush(struct context *ctx, gboolean compress, GString **out)
+{
+	int ret;
+
+	ctx->last_logic = FALSE;
+	if (!ctx->batch->len)
+		return SR_OK;
+
+#ifdef HAVE_ZLIB
+	if (compress && ctx->compress && ctx->batch->len >= COMPRESS_MIN_LEN)
+		compress_batch(ctx);
+#else
+	(void)compress;
+#endif
+
+	if (ctx->socket >= 0) {
+		ret = send_all(ctx, ctx->batch->str, ctx->batch->len);
+		g_string_truncate(ctx->batch, 0);
+		return ret;
+	}
+
+	*out = ctx->batch;
+	ctx->batch = g_string_sized_new(ctx->batch_size + SRNET_FRAME_HEADER_LEN);
+
+	return SR_OK;
+}
+
+static void put_header(struct context *ctx, const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_header *header)
+{
+	struct sr_channel *ch;
+	size_t offset, len;
+	GSList *l;
+
+	offset = frame_begin(ctx, SRNET_HEADER);
+	put_u32(ctx->batch, header->feed_version);
+	put_u64(ctx->batch, (uint64_t)header->starttime.tv_sec);
+	put_u32(ctx->batch, header->starttime.tv_usec);
+	put_u32(ctx->batch, g_slist_length(sdi->channels));
+	for (l = sdi->channels; l; l = l->next) {
+		ch = l->data;
+		len = strlen(ch->name);
+		put_u32(ctx->batch, ch->index);
+		put_u32(ctx->batch, ch->type);
+		put_u8(ctx->batch, ch->enabled);
+		put_u16(ctx->batch, len);
+		g_string_append_len(ctx->batch, ch->name, len);
+	}
+	frame_end(ctx, offset);
+}
+
+static void put_meta(struct context *ctx, const struct sr_datafeed_meta *meta)
+{
+	struct sr_config *src;
+	GVariant *data;
+	const char *type;
+	size_t offset;
+	GSList *l;
+
+	offset = frame_begin(ctx, SRNET_META);
+	put_u32(ctx->batch, g_slist_length(meta->config));
+	for (l = meta->config; l; l = l->next) {
+		src = l->data;
+		if (G_BYTE_ORDER == G_BIG_ENDIAN)
+			data = g_variant_byteswap(src->data);
+		else
+			data = g_variant_ref(src->data);
+		type = g_variant_get_type_string(data);
+		put_u32(ctx->batch, src->key);
+		put_u16(ctx->batch, strlen(type));
+		g_string_append(ctx->batch, type);
+		put_u32(ctx->batch, g_variant_get_size(data));
+		g_string_append_len(ctx->batch, g_variant_get_data(data),
+			g_variant_get_size(data));
+		g_variant_unref(data);
+	}
+	frame_end(ctx, offset);
+}
+
+static void put_logic(struct context *ctx, const struct sr_datafeed_logic *logic)
+{
+	const char *data;
+	size_t offset, len, room;
+	uint64_t left;
+
+	if (!logic->unitsize)
+		return;
+
+	data = logic->data;
+	left = logic->length;
+	while (left) {
+		/* Extend the previous logic frame when possible. */
+		if (ctx->last_logic && ctx->last_unitsize == logic->unitsize) {
+			offset = ctx->last_offset;
+			room = SRNET_FRAME_MAX_LEN - (ctx->batch->len - offset -
+				SRNET_FRAME_HEADER_LEN);
+		} else {
+			offset = frame_begin(ctx, SRNET_LOGIC);
+			put_u16(ctx->batch, logic->unitsize);
+			room = SRNET_FRAME_MAX_LEN - sizeof(uint16_t);
+		}
+		room -= room % logic->unitsize;
+		len = MIN(left, room);
+		g_string_append_len(ctx->batch, data, len);
+		frame_end(ctx, offset);
+		data += len;
+		left -= len;
+		ctx->last_logic = len < room;
+		ctx->last_offset = offset;
+		ctx->last_unitsize = logic->unitsize;
+	}
+}
+
+static int put_analog(struct context *ctx,
+		const struct sr_datafeed_analog *analog)
+{
+	struct sr_analog_encoding *enc;
+	struct sr_rational scale, offs, unity, zero;
+	struct sr_channel *ch;
+	const void *data;
+	size_t offset, count, size;
+	uint8_t unitsize, flags;
+	GSList *l;
+	int ret;
+
+	enc = analog->encoding;
+	flags = 0;
+	if (sr_analog_get_raw(analog, &data, &count, &scale, &offs) == SR_OK) {
+		unitsize = enc->unitsize;
+		if (enc->is_signed)
+			flags |= SRNET_ANALOG_SIGNED;
+		if (enc->is_float)
+			flags |= SRNET_ANALOG_FLOAT;
+	} else {
+		/* Strided or foreign byte order, send floats. */
+		count = analog->num_samples *
+			g_slist_length(analog->meaning->channels);
+		if (count > ctx->fbuf_size) {
+			g_free(ctx->fbuf);
+			ctx->fbuf = g_malloc(count * sizeof(float));
+			ctx->fbuf_size = count;
+		}
+		if ((ret = sr_analog_to_float(analog, ctx->fbuf)) != SR_OK)
+			return ret;
+		data = ctx->fbuf;
+		unitsize = sizeof(float);
+		flags |= SRNET_ANALOG_SIGNED | SRNET_ANALOG_FLOAT;
+		sr_rational_set(&unity, 1, 1);
+		sr_rational_set(&zero, 0, 1);
+		scale = unity;
+		offs = zero;
+	}
+	if (G_BYTE_ORDER == G_BIG_ENDIAN)
+		flags |= SRNET_ANALOG_BIGENDIAN;
+	if (enc->is_digits_decimal)
+		flags |= SRNET_ANALOG_DIGITS_DECIMAL;
+	size = count * unitsize;
+	if (size > SRNET_FRAME_MAX_LEN - 1024) {
+		sr_err("Analog packet of %zu bytes is too large.", size);
+		return SR_ERR_DATA;
+	}
+
+	offset = frame_begin(ctx, SRNET_ANALOG);
+	put_u32(ctx->batch, analog->num_samples);
+	put_u8(ctx->batch, unitsize);
+	put_u8(ctx->batch, flags);
+	put_u8(ctx->batch, (uint8_t)enc->digits);
+	put_u8(ctx->batch, analog->spec ? (uint8_t)analog->spec->spec_digits : 0);
+	put_rational(ctx->batch, &scale);
+	put_rational(ctx->batch, &offs);
+	put_u32(ctx->batch, analog->meaning->mq);
+	put_u32(ctx->batch, analog->meaning->unit);
+	put_u64(ctx->batch, analog->meaning->mqflags);
+	put_u16(ctx->batch, g_slist_length(analog->meaning->channels));
+	for (l = analog->meaning->channels; l; l = l->next) {
+		ch = l->data;
+		put_u32(ctx->batch, ch->index);
+	}
+	g_string_append_len(ctx->batch, data, size);
+	frame_end(ctx, offset);
+
+	return SR_OK;
+}
+
+static void put_logic_edges(struct context *ctx,
+		const struct sr_datafeed_logic_edges *edges)
+{
+	size_t offset;
+	uint64_t i;
+
+	offset = frame_begin(ctx, SRNET_LOGIC_EDGES);
+	put_u64(ctx->batch, edges->num_samples);
+	put_u16(ctx->batch, edges->unitsize);
+	put_u64(ctx->batch, edges->num_edges);
+	for (i = 0; i < edges->num_edges; i++)
+		put_u64(ctx->batch, edges->offsets[i]);
+	g_string_append_len(ctx->batch, edges->values,
+		edges->num_edges * edges->unitsize);
+	frame_end(ctx, offset);
+}
+
+static int receive(const struct sr_output *o,
+		const struct sr_datafeed_packet *packet, GString **out)
+{
+	struct context *ctx;
+	const struct sr_datafeed_frame *frame;
+	const struct sr_datafeed_gap *gap;
+	size_t offset;
+	int ret;
+
+	*out = NULL;
+	if (!o || !o->sdi || !(ctx = o->priv))
+		return SR_ERR_ARG;
+
+	switch (packet->type) {
+	case SR_DF_HEADER:
+		/* Let receivers find the channels without decompressing. */
+		put_header(ctx, o->sdi, packet->payload);
+		return flush(ctx, FALSE, out);
+	case SR_DF_LOGIC:
+		put_logic(ctx, packet->payload);
+		break;
+	case SR_DF_ANALOG:
+		if ((ret = put_analog(ctx, packet->payload)) != SR_OK)
+			return ret;
+		break;
+	case SR_DF_LOGIC_EDGES:
+		put_logic_edges(ctx, packet->payload);
+		break;
+	case SR_DF_META:
+		put_meta(ctx, packet->payload);
+		return flush(ctx, TRUE, out);
+	case SR_DF_FRAME_BEGIN:
+		offset = frame_begin(ctx, SRNET_FRAME_BEGIN);
+		if ((frame = packet->payload)) {
+			put_u64(ctx->batch, frame->index);
+			put_u8(ctx->batch, frame->has_time);
+			put_dbl(ctx->batch, frame->time);
+		}
+		frame_end(ctx, offset);
+		return flush(ctx, TRUE, out);
+	case SR_DF_GAP:
+		gap = packet->payload;
+		offset = frame_begin(ctx, SRNET_GAP);
+		put_u64(ctx->batch, gap->sample_index);
+		put_u64(ctx->batch, gap->num_samples);
+		put_u32(ctx->batch, gap->reason);
+		frame_end(ctx, offset);
+		return flush(ctx, TRUE, out);
+	case SR_DF_TRIGGER:
+		frame_end(ctx, frame_begin(ctx, SRNET_TRIGGER));
+		return flush(ctx, TRUE, out);
+	case SR_DF_FRAME_END:
+		frame_end(ctx, frame_begin(ctx, SRNET_FRAME_END));
+		return flush(ctx, TRUE, out);
+	case SR_DF_END:
+		frame_end(ctx, frame_begin(ctx, SRNET_END));
+		return flush(ctx, TRUE, out);
+	default:
+		return SR_OK;
+	}
+
+	if (ctx->batch->len < ctx->batch_size)
+		return SR_OK;
+
+	return flush(ctx, TRUE, out);
+}
+
+static int init(struct sr_output *o, GHashTable *options)
+{
+	struct context *ctx;
+	const char *compression, *host;
+	uint32_t port;
+	int ret;
+
+	if (!o || !o->sdi)
+		return SR_ERR_ARG;
+
+	compression = g_variant_get_string(g_hash_table_lookup(options,
+		"compression"), NULL);
+	if (strcmp(compression, "none") && strcmp(compression, "zlib")) {
+		sr_err("Unsupported compression '%s'.", compression);
+		return SR_ERR_ARG;
+	}
+#ifndef HAVE_ZLIB
+	if (!strcmp(compression, "zlib")) {
+		sr_err("Compression '%s' needs zlib support.", compression);
+		return SR_ERR_ARG;
+	}
+#endif
+
+	ctx = g_malloc0(sizeof(*ctx));
+	ctx->socket = -1;
+	ctx->compress = !strcmp(compression, "zlib");
+	ctx->level = g_variant_get_uint32(g_hash_table_lookup(options, "level"));
+	ctx->level = MIN(ctx->level, 9);
+	ctx->batch_size = g_variant_get_uint32(g_hash_table_lookup(options,
+		"batch"));
+	ctx->batch_size = MIN(ctx->batch_size, SRNET_FRAME_MAX_LEN);
+
+	host = g_variant_get_string(g_hash_table_lookup(options, "host"), NULL);
+	port = g_variant_get_uint32(g_hash_table_lookup(options, "port"));
+	if (host[0] && (ret = connect_host(ctx, host, port)) != SR_OK) {
+		g_free(ctx);
+		return ret;
+	}
+
+	ctx->batch = g_string_sized_new(ctx->batch_size + SRNET_FRAME_HEADER_LEN);
+	g_string_append_len(ctx->batch, SRNET_MAGIC, SRNET_MAGIC_LEN);
+	o->priv = ctx;
+
+	return SR_OK;
+}
+
+static struct sr_option options[] = {
+	{"host", "Host", "Stream to this TCP server instead of the output file", NULL, NULL},
+	{"port", "Port", "TCP port of the server", NULL, NULL},
+	{"batch", "Batch size", "Number of bytes of data packets to send at once", NULL, NULL},
+	{"compression", "Compression", "Compression of batches (none, zlib)", NULL, NULL},
+	{"level", "Level", "Compression level (0-9)", NULL, NULL},
+	ALL_ZERO
+};
+
+static const struct sr_option *get_options(void)
+{
+	GSList *l;
+
+	if (!options[0].def) {
+		options[0].def = g_variant_ref_sink(g_variant_new_string(""));
+		options[1].def = g_variant_ref_sink(g_variant_new_uint32(SRNET_DEFAULT_PORT));
+		options[2].def = g_variant_ref_sink(g_variant_new_uint32(DEFAULT_BATCH_SIZE));
+		options[3].def = g_variant_ref_sink(g_variant_new_string("none"));
+		l = NULL;
+		l = g_slist_append(l, g_variant_ref_sink(g_variant_new_string("none")));
+#ifdef HAVE_ZLIB
+		l = g_slist_append(l, g_variant_ref_sink(g_variant_new_string("zlib")));
+#endif
+		options[3].values = l;
+		options[4].def = g_variant_ref_sink(g_variant_new_uint32(1));
+	}
+
+	return options;
+}
+
+static int cleanup(struct sr_output *o)
+{
+	struct context *ctx;
+
+	if (!o)
+		return SR_ERR_ARG;
+
+	if (!(ctx = o->priv))
+		return SR_OK;
+
+	if (ctx->socket >= 0) {
+		/* Whatever an aborted acquisition left in the batch. */
+		if (ctx->batch->len)
+			send_all(ctx, ctx->batch->str, ctx->batch->len);
+		close(ctx->socket);
+	}
+	g_string_free(ctx->batch, TRUE);
+	g_free(ctx->fbuf);
+	g_free(ctx);
+	o->priv = NULL;
+
+	return SR_OK;
+}
+
+SR_PRIV struct sr_output_module output_srnet = {
+	.id = "srnet",
+	.name = "srnet",
+	.desc = "Packet stream for processing on another host",
+	.exts = (const char*[]){"srnet", NULL},
+	.flags = 0,
+	.options = get_options,
+	.init = init,
+	.receive = receive,
+	.cleanup = cleanup,
+};
@@ -24,14 +24,66 @@
 #include <glib.h>
 #include <glib/gstdio.h>
 #include <zip.h>
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
 #include <libsigrok/libsigrok.h>
 #include "libsigrok-internal.h"
 
 #define LOG_PREFIX "output/srzip"
+/* Default chunk size, see the "chunksize" option. */
 #define CHUNK_SIZE (4 * 1024 * 1024)
+#define CHUNK_SIZE_MIN 1024
+/* Name of the entry which lists the chunks and their sample ranges. */
+#define INDEX_NAME "chunkindex"
+/* Bucket count ratio between neighbouring overview levels. */
+#define OVERVIEW_FACTOR 16
+/* Least amount of chunk data to add before the archive gets written. */
+#define COMMIT_SIZE (64 * 1024 * 1024)
+
+/* Chunk compression methods, by the values of the "compression" option. */
+static const struct chunk_codec {
+	const char *name;
+	zip_int32_t method;
+	zip_uint32_t level;
+} chunk_codecs[] = {
+	{ "deflate", ZIP_CM_DEFLATE, 0 },
+#ifdef HAVE_ZIP_SET_FILE_COMPRESSION
+	{ "store", ZIP_CM_STORE, 0 },
+#ifdef ZIP_CM_ZSTD
+	{ "zstd", ZIP_CM_ZSTD, 1 },
+#endif
+#endif
+};
+
+/* A chunk which gets compressed by a worker thread. */
+struct zip_chunk {
+	char *name;
+	/* Retained packet which data points into, or NULL if data is owned. */
+	struct sr_datafeed_packet *ref;
+	uint8_t *data;
+	size_t size;
+	uint8_t *comp;
+	size_t comp_size;
+	size_t read_pos;
+	uint32_t crc;
+	gboolean done;
+	/* Where the (compressed) data went in the spool file. */
+	FILE *spool;
+	uint64_t spool_offset;
+	gboolean compressed;
+};
 
 struct out_context {
 	gboolean zip_created;
+	const struct chunk_codec *codec;
+	size_t chunk_size;
+	/* Chunks hold bit planes and delta encoded analog samples. */
+	gboolean planes;
+	/* Integer analog samples are kept as they are. */
+	gboolean native;
+	/* Samples per bucket of the finest overview level, 0 for none. */
+	uint64_t overview_bucket;
 	uint64_t samplerate;
 	char *filename;
 	size_t first_analog_index;
@@ -42,29 +94,429 @@ struct out_context {
 		size_t alloc_size;
 		uint8_t *samples;
 		size_t fill_size;
+		/* Last value of change-only packets. */
+		uint8_t *edge_value;
+		unsigned int next_chunk;
+		uint64_t next_sample;
+		/* Overview: transitions per channel of each bucket. */
+		GArray *ov_counts;
+		uint32_t *ov_cur;
+		uint8_t *ov_last;
+		uint64_t ov_fill;
 	} logic_buff;
 	struct analog_buff {
 		size_t alloc_size;
-		float *samples;
+		/* Floats, or integers of the channel's own encoding. */
+		uint8_t *samples;
+		size_t sample_size;
+		gboolean native;
+		gboolean encoding_known;
+		struct sr_analog_encoding encoding;
 		size_t fill_size;
+		unsigned int next_chunk;
+		uint64_t next_sample;
+		/* Overview: minimum and maximum of each bucket. */
+		GArray *ov_minmax;
+		float ov_min, ov_max;
+		uint64_t ov_fill;
 	} *analog_buff;
+	/*
+	 * The archive stays open across chunks. libzip only reads the
+	 * data of added entries when the archive gets closed. Chunk data
+	 * waits in a spool file next to the archive until then, so the
+	 * memory in use doesn't grow with the capture, and the packets
+	 * and buffers of chunks are released right away. Closing the
+	 * archive copies all entries written before, so it gets written
+	 * whenever as much chunk data was added as was written so far,
+	 * COMMIT_SIZE at least. That copies every byte about twice in
+	 * total instead of once per commit, at the cost of a spool file
+	 * of up to half the archive's size.
+	 */
+	struct zip *archive;
+	GKeyFile *meta;
+	zip_int64_t meta_index;
+	gboolean have_unitsize;
+	GString *index;
+	gboolean index_written;
+	GSList *pending;
+	size_t pending_size;
+	uint64_t committed_size;
+	char *spool_path;
+	FILE *spool;
+	uint64_t spool_size;
+#ifdef HAVE_ZLIB
+	/*
+	 * With several threads, chunks get deflated by a worker pool and
+	 * are added as compressed entries when the archive gets written.
+	 */
+	GThreadPool *pool;
+	GQueue chunks;
+	/*
+	 * The first chunk which is not in the spool file yet, and the
+	 * number of such chunks. The output waits for the workers when
+	 * there are more than max_unspooled.
+	 */
+	GList *spool_next;
+	unsigned int num_unspooled;
+	unsigned int max_unspooled;
+	GMutex mutex;
+	GCond cond;
+#endif
 };
 
-static int init(struct sr_output *o, GHashTable *options)
+/**
+ * Create the spool file for the chunks of the next archive write.
+ *
+ * @param[in] o Output module instance.
+ *
+ * @returns SR_OK et al error codes.
+ */
+static int spool_open(const struct sr_output *o)
+{
+	struct out_context *outc;
+	int fd;
+
+	outc = o->priv;
+	if (outc->spool)
+		return SR_OK;
+
+	/* Next to the archive, temporary directories may live in RAM. */
+	outc->spool_path = g_strconcat(outc->filename, ".XXXXXX", NULL);
+	fd = g_mkstemp(outc->spool_path);
+	if (fd >= 0 && !(outc->spool = fdopen(fd, "w+b")))
+		g_close(fd, NULL);
+	if (!outc->spool) {
+		sr_err("Cannot create spool file '%s': %s.",
+			outc->spool_path, g_strerror(errno));
+		if (fd >= 0)
+			g_unlink(outc->spool_path);
+		g_free(outc->spool_path);
+		outc->spool_path = NULL;
+		return SR_ERR;
+	}
+	outc->spool_size = 0;
+
+	return SR_OK;
+}
+
+/**
+ * Append chunk data to the spool file.
+ *
+ * @param[in] outc Output module context.
+ * @param[in] data Chunk data.
+ * @param[in] size Chunk data length in bytes.
+ * @param[out] offset Position of the data in the spool file.
+ *
+ * @returns SR_OK et al error codes.
+ */
+static int spool_write(struct out_context *outc, const void *data,
+	size_t size, uint64_t *offset)
+{
+	*offset = outc->spool_size;
+	if (fwrite(data, 1, size, outc->spool) != size) {
+		sr_err("Cannot write spool file '%s': %s.",
+			outc->spool_path, g_strerror(errno));
+		return SR_ERR;
+	}
+	outc->spool_size += size;
+
+	return SR_OK;
+}
+
+/* Remove the spool file, after the archive was written. */
+static void spool_close(struct out_context *outc)
 {
+	if (!outc->spool)
+		return;
+	fclose(outc->spool);
+	outc->spool = NULL;
+	g_unlink(outc->spool_path);
+	g_free(outc->spool_path);
+	outc->spool_path = NULL;
+}
+
+#ifdef HAVE_ZLIB
+static void compress_chunk(gpointer data, gpointer user_data)
+{
+	struct zip_chunk *chunk;
 	struct out_context *outc;
+	z_stream zs;
+	uLong bound;
+
+	chunk = data;
+	outc = user_data;
+
+	chunk->crc = crc32(crc32(0, Z_NULL, 0), chunk->data, chunk->size);
+
+	/* Raw deflate data, as it's stored in ZIP archives. */
+	memset(&zs, 0, sizeof(zs));
+	if (deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+			-MAX_WBITS, 8, Z_DEFAULT_STRATEGY) == Z_OK) {
+		bound = deflateBound(&zs, chunk->size);
+		chunk->comp = g_try_malloc(bound);
+		if (chunk->comp) {
+			zs.next_in = chunk->data;
+			zs.avail_in = chunk->size;
+			zs.next_out = chunk->comp;
+			zs.avail_out = bound;
+			if (deflate(&zs, Z_FINISH) == Z_STREAM_END) {
+				chunk->comp_size = zs.total_out;
+			} else {
+				g_free(chunk->comp);
+				chunk->comp = NULL;
+			}
+		}
+		deflateEnd(&zs);
+	}
+
+	/* Keep the data to store it uncompressed if deflate failed. */
+	if (chunk->comp && !chunk->ref) {
+		g_free(chunk->data);
+		chunk->data = NULL;
+	}
+
+	g_mutex_lock(&outc->mutex);
+	chunk->done = TRUE;
+	g_cond_broadcast(&outc->cond);
+	g_mutex_unlock(&outc->mutex);
+}
+
+static void wait_chunk(struct out_context *outc, struct zip_chunk *chunk)
+{
+	g_mutex_lock(&outc->mutex);
+	while (!chunk->done)
+		g_cond_wait(&outc->cond, &outc->mutex);
+	g_mutex_unlock(&outc->mutex);
+}
+
+static gboolean chunk_done(struct out_context *outc, struct zip_chunk *chunk)
+{
+	gboolean done;
+
+	g_mutex_lock(&outc->mutex);
+	done = chunk->done;
+	g_mutex_unlock(&outc->mutex);
 
-	(void)options;
+	return done;
+}
+
+/* Move a compressed chunk to the spool file, and release its buffers. */
+static int spool_chunk(struct out_context *outc, struct zip_chunk *chunk)
+{
+	int ret;
+
+	chunk->compressed = chunk->comp != NULL;
+	if (chunk->compressed)
+		ret = spool_write(outc, chunk->comp, chunk->comp_size,
+			&chunk->spool_offset);
+	else
+		ret = spool_write(outc, chunk->data, chunk->size,
+			&chunk->spool_offset);
+	if (ret != SR_OK)
+		return ret;
+	chunk->spool = outc->spool;
+
+	if (chunk->ref)
+		sr_packet_unref(chunk->ref);
+	else
+		g_free(chunk->data);
+	chunk->ref = NULL;
+	chunk->data = NULL;
+	g_free(chunk->comp);
+	chunk->comp = NULL;
+
+	return SR_OK;
+}
+
+/**
+ * Move the chunks which the worker threads compressed to the spool file,
+ * in the order they were queued. Waits for the workers if there are too
+ * many chunks in flight, or if all of them were asked for.
+ *
+ * @param[in] o Output module instance.
+ * @param[in] all Whether to spool all queued chunks.
+ *
+ * @returns SR_OK et al error codes.
+ */
+static int spool_chunks(const struct sr_output *o, gboolean all)
+{
+	struct out_context *outc;
+	struct zip_chunk *chunk;
+	int ret;
+
+	outc = o->priv;
+	while (outc->spool_next) {
+		chunk = outc->spool_next->data;
+		if (!all && outc->num_unspooled <= outc->max_unspooled &&
+				!chunk_done(outc, chunk))
+			break;
+		wait_chunk(outc, chunk);
+		ret = spool_open(o);
+		if (ret != SR_OK)
+			return ret;
+		ret = spool_chunk(outc, chunk);
+		if (ret != SR_OK)
+			return ret;
+		outc->spool_next = outc->spool_next->next;
+		outc->num_unspooled--;
+	}
+
+	return SR_OK;
+}
+
+static void free_chunks(struct out_context *outc)
+{
+	struct zip_chunk *chunk;
+
+	while ((chunk = g_queue_pop_head(&outc->chunks))) {
+		wait_chunk(outc, chunk);
+		g_free(chunk->name);
+		if (chunk->ref)
+			sr_packet_unref(chunk->ref);
+		else
+			g_free(chunk->data);
+		g_free(chunk->comp);
+		g_free(chunk);
+	}
+	outc->spool_next = NULL;
+	outc->num_unspooled = 0;
+}
+
+/*
+ * A source which provides deflated data from the spool file, with the
+ * sizes and checksum of the chunk. libzip copies such data into the
+ * archive as it is.
+ */
+static zip_int64_t chunk_source_cb(void *userdata, void *data,
+	zip_uint64_t len, enum zip_source_cmd cmd)
+{
+	struct zip_chunk *chunk;
+	struct zip_stat *st;
+	size_t n;
+
+	chunk = userdata;
+	switch (cmd) {
+	case ZIP_SOURCE_OPEN:
+		chunk->read_pos = 0;
+		return 0;
+	case ZIP_SOURCE_READ:
+		n = MIN(len, chunk->comp_size - chunk->read_pos);
+		if (fseeko(chunk->spool, chunk->spool_offset + chunk->read_pos,
+				SEEK_SET) < 0 || fread(data, 1, n, chunk->spool) != n)
+			return -1;
+		chunk->read_pos += n;
+		return n;
+	case ZIP_SOURCE_CLOSE:
+		return 0;
+	case ZIP_SOURCE_STAT:
+		if (len < sizeof(*st))
+			return -1;
+		st = data;
+		zip_stat_init(st);
+		st->valid = ZIP_STAT_SIZE | ZIP_STAT_COMP_SIZE |
+			ZIP_STAT_COMP_METHOD | ZIP_STAT_CRC;
+		st->size = chunk->size;
+		st->comp_size = chunk->comp_size;
+		st->comp_method = ZIP_CM_DEFLATE;
+		st->crc = chunk->crc;
+		return sizeof(*st);
+	case ZIP_SOURCE_ERROR:
+		if (len < 2 * sizeof(int))
+			return -1;
+		memset(data, 0, 2 * sizeof(int));
+		return 2 * sizeof(int);
+	case ZIP_SOURCE_FREE:
+		/* The chunk gets released after the archive was written. */
+		return 0;
+	default:
+		return -1;
+	}
+}
+#endif
+
+static int init(struct sr_output *o, GHashTable *options)
+{
+	struct out_context *outc;
+	const struct chunk_codec *codec;
+	const char *name;
+	size_t i;
+#ifdef HAVE_ZLIB
+	unsigned int threads;
+	GError *error;
+#endif
 
 	if (!o->filename || o->filename[0] == '\0') {
 		sr_info("srzip output module requires a file name, cannot save.");
 		return SR_ERR_ARG;
 	}
 
+	name = g_variant_get_string(g_hash_table_lookup(options,
+		"compression"), NULL);
+	codec = NULL;
+	for (i = 0; i < ARRAY_SIZE(chunk_codecs); i++) {
+		if (!strcmp(name, chunk_codecs[i].name))
+			codec = &chunk_codecs[i];
+	}
+	if (!codec) {
+		if (!strcmp(name, "lz4"))
+			sr_err("LZ4 is no ZIP compression method, use zstd.");
+		else
+			sr_err("Unsupported compression '%s'.", name);
+		return SR_ERR_ARG;
+	}
+
 	outc = g_malloc0(sizeof(*outc));
 	outc->filename = g_strdup(o->filename);
+	outc->codec = codec;
 	o->priv = outc;
 
+	outc->overview_bucket = g_variant_get_uint32(g_hash_table_lookup(options,
+		"overview"));
+	outc->native = g_variant_get_boolean(g_hash_table_lookup(options,
+		"native"));
+	name = g_variant_get_string(g_hash_table_lookup(options,
+		"encoding"), NULL);
+	if (!strcmp(name, "bitplane")) {
+		outc->planes = TRUE;
+	} else if (strcmp(name, "raw")) {
+		sr_err("Unsupported encoding '%s'.", name);
+		g_free(outc->filename);
+		g_free(outc);
+		o->priv = NULL;
+		return SR_ERR_ARG;
+	}
+	outc->chunk_size = g_variant_get_uint32(g_hash_table_lookup(options,
+		"chunksize"));
+	if (outc->chunk_size < CHUNK_SIZE_MIN) {
+		sr_err("Chunk size must be at least %d bytes.", CHUNK_SIZE_MIN);
+		g_free(outc->filename);
+		g_free(outc);
+		o->priv = NULL;
+		return SR_ERR_ARG;
+	}
+
+#ifdef HAVE_ZLIB
+	/* The worker threads only do deflate. */
+	g_queue_init(&outc->chunks);
+	g_mutex_init(&outc->mutex);
+	g_cond_init(&outc->cond);
+	threads = g_variant_get_uint32(g_hash_table_lookup(options, "threads"));
+	if (!threads)
+		threads = g_get_num_processors();
+	if (threads > 1 && codec->method == ZIP_CM_DEFLATE) {
+		/* Enough chunks in flight to keep all workers busy. */
+		outc->max_unspooled = 2 * threads;
+		error = NULL;
+		outc->pool = g_thread_pool_new(compress_chunk, outc,
+			threads, TRUE, &error);
+		if (!outc->pool) {
+			sr_warn("Cannot create compression threads: %s.",
+				error->message);
+			g_error_free(error);
+		}
+	}
+#endif
+
 	return SR_OK;
 }
 
@@ -101,7 +553,9 @@ static int zip_create(const struct sr_output *o)
 		return SR_ERR;
 
 	/* "version" */
-	versrc = zip_source_buffer(zipfile, "2", 1, FALSE);
+	/* Older readers cannot decode bit planes or integer analog chunks. */
+	versrc = zip_source_buffer(zipfile,
+		outc->planes || outc->native ? "3" : "2", 1, FALSE);
 	if (zip_add(zipfile, "version", versrc) < 0) {
 		sr_err("Error saving version into zipfile: %s",
 			zip_strerror(zipfile));
@@ -156,6 +610,15 @@ static int zip_create(const struct sr_output *o)
 	g_free(s);
 
 	g_key_file_set_integer(meta, devgroup, "total analog", enabled_analog_channels);
+	g_key_file_set_string(meta, devgroup, "compression", outc->codec->name);
+	if (outc->planes)
+		g_key_file_set_string(meta, devgroup, "encoding", "bitplane");
+	if (outc->overview_bucket) {
+		g_key_file_set_uint64(meta, devgroup, "overview bucket",
+			outc->overview_bucket);
+		g_key_file_set_integer(meta, devgroup, "overview factor",
+			OVERVIEW_FACTOR);
+	}
 
 	outc->analog_ch_count = enabled_analog_channels;
 	alloc_size = sizeof(gint) * outc->analog_ch_count + 1;
@@ -189,7 +652,7 @@ static int zip_create(const struct sr_output *o)
 	/*
 	 * Allocate one samples buffer for all logic channels, and
 	 * several samples buffers for the analog channels. Allocate
-	 * buffers of CHUNK_SIZE size (in bytes), and determine the
+	 * buffers of the chunk size (in bytes), and determine the
 	 * sample counts from the respective channel counts and data
 	 * type widths.
 	 *
@@ -203,11 +666,11 @@ static int zip_create(const struct sr_output *o)
 	 * holding a local buffer won't harm when no data is seen later
 	 * during execution. This simplifies other locations.
 	 */
-	alloc_size = CHUNK_SIZE;
+	alloc_size = outc->chunk_size;
 	outc->logic_buff.unit_size = logic_channels;
 	outc->logic_buff.unit_size += 8 - 1;
 	outc->logic_buff.unit_size /= 8;
-	outc->logic_buff.samples = g_try_malloc0(alloc_size);
+	outc->logic_buff.samples = sr_buffer_alloc0(SR_MEM_OUTPUT, alloc_size);
 	if (!outc->logic_buff.samples)
 		return SR_ERR_MALLOC;
 	if (outc->logic_buff.unit_size)
@@ -218,194 +681,711 @@ static int zip_create(const struct sr_output *o)
 	alloc_size = sizeof(outc->analog_buff[0]) * outc->analog_ch_count + 1;
 	outc->analog_buff = g_malloc0(alloc_size);
 	for (index = 0; index < outc->analog_ch_count; index++) {
-		alloc_size = CHUNK_SIZE;
+		alloc_size = outc->chunk_size;
 		outc->analog_buff[index].samples = g_try_malloc0(alloc_size);
 		if (!outc->analog_buff[index].samples)
 			return SR_ERR_MALLOC;
-		alloc_size /= sizeof(outc->analog_buff[0].samples[0]);
+		outc->analog_buff[index].sample_size = sizeof(float);
+		alloc_size /= sizeof(float);
 		outc->analog_buff[index].alloc_size = alloc_size;
 		outc->analog_buff[index].fill_size = 0;
 	}
 
+	outc->index = g_string_new("# entry first_sample last_sample bytes\n");
+	outc->logic_buff.next_chunk = 1;
+	for (index = 0; index < outc->analog_ch_count; index++)
+		outc->analog_buff[index].next_chunk = 1;
+
 	metabuf = g_key_file_to_data(meta, &metalen, NULL);
-	g_key_file_free(meta);
 
 	metasrc = zip_source_buffer(zipfile, metabuf, metalen, FALSE);
-	if (zip_add(zipfile, "metadata", metasrc) < 0) {
+	outc->meta_index = zip_add(zipfile, "metadata", metasrc);
+	if (outc->meta_index < 0) {
 		sr_err("Error saving metadata into zipfile: %s",
 			zip_strerror(zipfile));
 		zip_source_free(metasrc);
 		zip_discard(zipfile);
+		g_key_file_free(meta);
 		g_free(metabuf);
 		return SR_ERR;
 	}
 
-	if (zip_close(zipfile) < 0) {
-		sr_err("Error saving zipfile: %s", zip_strerror(zipfile));
-		zip_discard(zipfile);
-		g_free(metabuf);
+	/* Keep the archive and the metadata for the chunks to come. */
+	outc->archive = zipfile;
+	outc->meta = meta;
+	outc->pending = g_slist_prepend(outc->pending, metabuf);
+
+	return SR_OK;
+}
+
+/**
+ * Open the archive again after it was written.
+ *
+ * @param[in] o Output module instance.
+ *
+ * @returns SR_OK et al error codes.
+ */
+static int zip_reopen(const struct sr_output *o)
+{
+	struct out_context *outc;
+
+	outc = o->priv;
+	if (outc->archive)
+		return SR_OK;
+	outc->archive = zip_open(outc->filename, 0, NULL);
+	if (!outc->archive) {
+		sr_err("Cannot open session file '%s'.", outc->filename);
 		return SR_ERR;
 	}
-	g_free(metabuf);
 
 	return SR_OK;
 }
 
+#ifdef HAVE_ZLIB
 /**
- * Append a block of logic data to an srzip archive.
+ * Add the chunks which the worker threads compressed to the archive.
  *
  * @param[in] o Output module instance.
- * @param[in] buf Logic data samples as byte sequence.
- * @param[in] unitsize Logic data unit size (bytes per sample).
- * @param[in] length Byte sequence length (in bytes, not samples).
  *
  * @returns SR_OK et al error codes.
  */
-static int zip_append(const struct sr_output *o,
-	uint8_t *buf, size_t unitsize, size_t length)
+static int zip_add_compressed(const struct sr_output *o)
 {
 	struct out_context *outc;
-	struct zip *archive;
-	struct zip_source *logicsrc;
-	int64_t i, num_files;
-	struct zip_stat zs;
-	struct zip_source *metasrc;
-	GKeyFile *kf;
-	GError *error;
-	uint64_t chunk_num;
-	const char *entry_name;
-	char *metabuf;
-	gsize metalen;
-	char *chunkname;
-	unsigned int next_chunk_num;
+	struct zip_chunk *chunk;
+	struct zip_source *src;
+	GList *l;
+	int ret;
 
-	if (!length)
+	outc = o->priv;
+	if (g_queue_is_empty(&outc->chunks))
 		return SR_OK;
+	ret = spool_chunks(o, TRUE);
+	if (ret != SR_OK)
+		return ret;
+	ret = zip_reopen(o);
+	if (ret != SR_OK)
+		return ret;
+
+	/* Keep the order in which the chunks were queued. */
+	for (l = outc->chunks.head; l; l = l->next) {
+		chunk = l->data;
+		if (chunk->compressed)
+			src = zip_source_function(outc->archive,
+				chunk_source_cb, chunk);
+		else
+			src = zip_source_file(outc->archive, outc->spool_path,
+				chunk->spool_offset, chunk->size);
+		if (!src || zip_add(outc->archive, chunk->name, src) < 0) {
+			sr_err("Failed to add chunk '%s': %s", chunk->name,
+				zip_strerror(outc->archive));
+			if (src)
+				zip_source_free(src);
+			return SR_ERR;
+		}
+	}
+
+	return SR_OK;
+}
+#endif
+
+/* Whether enough chunk data was added to write the archive. */
+static gboolean commit_due(const struct out_context *outc)
+{
+	return outc->pending_size >= COMMIT_SIZE &&
+		outc->pending_size >= outc->committed_size;
+}
+
+/**
+ * Write the entries which were added to the archive so far.
+ *
+ * @param[in] o Output module instance.
+ *
+ * @returns SR_OK et al error codes.
+ */
+static int zip_commit(const struct sr_output *o)
+{
+	struct out_context *outc;
+	int ret;
 
 	outc = o->priv;
-	if (!(archive = zip_open(outc->filename, 0, NULL)))
+	SR_PROBE1(srzip_commit_entry, outc->pending_size);
+	ret = SR_OK;
+#ifdef HAVE_ZLIB
+	ret = zip_add_compressed(o);
+#endif
+	if (ret == SR_OK && outc->spool && fflush(outc->spool) != 0) {
+		sr_err("Cannot write spool file '%s': %s.",
+			outc->spool_path, g_strerror(errno));
+		ret = SR_ERR;
+	}
+	if (outc->archive) {
+		if (ret != SR_OK) {
+			zip_discard(outc->archive);
+		} else if (zip_close(outc->archive) < 0) {
+			sr_err("Error saving session file: %s",
+				zip_strerror(outc->archive));
+			zip_discard(outc->archive);
+			ret = SR_ERR;
+		}
+	}
+	outc->archive = NULL;
+	spool_close(outc);
+	g_slist_free_full(outc->pending, g_free);
+	outc->pending = NULL;
+	outc->committed_size += outc->pending_size;
+	outc->pending_size = 0;
+#ifdef HAVE_ZLIB
+	free_chunks(outc);
+#endif
+	SR_PROBE1(srzip_commit_return, ret);
+
+	return ret;
+}
+
+/**
+ * Add an entry to the archive, its data goes to the spool file until the
+ * archive gets written.
+ *
+ * @param[in] o Output module instance.
+ * @param[in] name Entry name.
+ * @param[in] buf Entry data, owned by the archive from then on.
+ * @param[in] size Entry data length in bytes.
+ * @param[in] ref Retained packet which buf points into, owned by the
+ *                archive from then on. NULL if buf was allocated.
+ *
+ * @returns SR_OK et al error codes.
+ */
+static int zip_add_chunk(const struct sr_output *o,
+	const char *name, void *buf, size_t size,
+	struct sr_datafeed_packet *ref)
+{
+	struct out_context *outc;
+	struct zip_source *src;
+	zip_int64_t index;
+	uint64_t offset;
+	int ret;
+#ifdef HAVE_ZLIB
+	struct zip_chunk *chunk;
+#endif
+
+	outc = o->priv;
+	SR_PROBE2(srzip_chunk_add, name, size);
+#ifdef HAVE_ZLIB
+	if (outc->pool) {
+		chunk = g_malloc0(sizeof(*chunk));
+		chunk->name = g_strdup(name);
+		chunk->ref = ref;
+		chunk->data = buf;
+		chunk->size = size;
+		g_queue_push_tail(&outc->chunks, chunk);
+		if (!outc->spool_next)
+			outc->spool_next = outc->chunks.tail;
+		outc->num_unspooled++;
+		g_thread_pool_push(outc->pool, chunk, NULL);
+		outc->pending_size += size;
+		ret = spool_chunks(o, FALSE);
+		if (ret != SR_OK)
+			return ret;
+		if (commit_due(outc))
+			return zip_commit(o);
+		return SR_OK;
+	}
+#endif
+	ret = spool_open(o);
+	if (ret == SR_OK)
+		ret = spool_write(outc, buf, size, &offset);
+	if (ref)
+		sr_packet_unref(ref);
+	else
+		g_free(buf);
+	if (ret != SR_OK)
+		return ret;
+	outc->pending_size += size;
+	ret = zip_reopen(o);
+	if (ret != SR_OK)
+		return ret;
+
+	src = zip_source_file(outc->archive, outc->spool_path, offset, size);
+	index = src ? zip_add(outc->archive, name, src) : -1;
+	if (index < 0) {
+		sr_err("Failed to add chunk '%s': %s", name,
+			zip_strerror(outc->archive));
+		if (src)
+			zip_source_free(src);
+		return SR_ERR;
+	}
+#ifdef HAVE_ZIP_SET_FILE_COMPRESSION
+	if (outc->codec->method != ZIP_CM_DEFLATE &&
+	    zip_set_file_compression(outc->archive, index,
+			outc->codec->method, outc->codec->level) < 0) {
+		sr_err("Failed to set compression of chunk '%s': %s", name,
+			zip_strerror(outc->archive));
 		return SR_ERR;
+	}
+#endif
+
+	if (commit_due(outc)) {
+		ret = zip_commit(o);
+		if (ret != SR_OK)
+			return ret;
+	}
+
+	return SR_OK;
+}
+
+/**
+ * Record a chunk in the index, see zip_write_index().
+ *
+ * @param[in] o Output module instance.
+ * @param[in] name Entry name of the chunk.
+ * @param[in] first Sample number of the chunk's first sample.
+ * @param[in] count Number of samples in the chunk.
+ * @param[in] size Chunk length in bytes.
+ */
+static void index_add(const struct sr_output *o, const char *name,
+	uint64_t first, uint64_t count, size_t size)
+{
+	struct out_context *outc;
+
+	outc = o->priv;
+	if (!count)
+		return;
+	g_string_append_printf(outc->index, "%s %" PRIu64 " %" PRIu64
+		" %zu\n", name, first, first + count - 1, size);
+}
 
-	if (zip_stat(archive, "metadata", 0, &zs) < 0) {
-		sr_err("Failed to open metadata: %s", zip_strerror(archive));
-		zip_discard(archive);
+/**
+ * Add the index of all chunks to the archive.
+ *
+ * The index lets readers find the chunk which holds a sample without
+ * reading the chunks before it. Each line names a chunk entry, and
+ * lists its first and last sample number, and its size in bytes.
+ *
+ * @param[in] o Output module instance.
+ *
+ * @returns SR_OK et al error codes.
+ */
+static int zip_write_index(const struct sr_output *o)
+{
+	struct out_context *outc;
+	struct zip_source *src;
+	char *buf;
+	int ret;
+
+	outc = o->priv;
+	if (!outc->zip_created || outc->index_written)
+		return SR_OK;
+	ret = zip_reopen(o);
+	if (ret != SR_OK)
+		return ret;
+
+	buf = g_memdup(outc->index->str, outc->index->len);
+	outc->pending = g_slist_prepend(outc->pending, buf);
+	src = zip_source_buffer(outc->archive, buf, outc->index->len, FALSE);
+	if (zip_add(outc->archive, INDEX_NAME, src) < 0) {
+		sr_err("Failed to add chunk index: %s",
+			zip_strerror(outc->archive));
+		zip_source_free(src);
 		return SR_ERR;
 	}
-	kf = sr_sessionfile_read_metadata(archive, &zs);
-	if (!kf) {
-		zip_discard(archive);
-		return SR_ERR_DATA;
+	outc->index_written = TRUE;
+
+	return SR_OK;
+}
+
+/**
+ * Count the logic channels' transitions for the overview.
+ *
+ * @param[in] o Output module instance.
+ * @param[in] data Logic data samples.
+ * @param[in] count Number of samples.
+ */
+static void overview_logic(const struct sr_output *o,
+	const uint8_t *data, size_t count)
+{
+	struct out_context *outc;
+	struct logic_buff *buff;
+	size_t unitsize, i, byte, bit;
+	uint8_t diff;
+
+	outc = o->priv;
+	buff = &outc->logic_buff;
+	unitsize = buff->unit_size;
+	if (!outc->overview_bucket || !count)
+		return;
+	if (!buff->ov_counts) {
+		buff->ov_counts = g_array_new(FALSE, FALSE, sizeof(uint32_t));
+		buff->ov_cur = g_malloc0(unitsize * 8 * sizeof(uint32_t));
+		buff->ov_last = g_memdup(data, unitsize);
 	}
-	/*
-	 * If the file was only initialized but doesn't yet have any
-	 * data it in, it won't have a unitsize field in metadata yet.
-	 */
-	error = NULL;
-	metabuf = NULL;
-	if (!g_key_file_has_key(kf, "device 1", "unitsize", &error)) {
-		if (error && error->code != G_KEY_FILE_ERROR_KEY_NOT_FOUND) {
-			sr_err("Failed to check unitsize key: %s", error->message);
-			g_error_free(error);
-			g_key_file_free(kf);
-			zip_discard(archive);
-			return SR_ERR;
+
+	for (i = 0; i < count; i++, data += unitsize) {
+		for (byte = 0; byte < unitsize; byte++) {
+			diff = data[byte] ^ buff->ov_last[byte];
+			for (bit = 0; diff; bit++, diff >>= 1) {
+				if (diff & 1)
+					buff->ov_cur[byte * 8 + bit]++;
+			}
 		}
-		g_clear_error(&error);
-
-		/* Add unitsize field. */
-		g_key_file_set_integer(kf, "device 1", "unitsize", unitsize);
-		metabuf = g_key_file_to_data(kf, &metalen, NULL);
-		metasrc = zip_source_buffer(archive, metabuf, metalen, FALSE);
-
-		if (zip_replace(archive, zs.index, metasrc) < 0) {
-			sr_err("Failed to replace metadata: %s",
-				zip_strerror(archive));
-			g_key_file_free(kf);
-			zip_source_free(metasrc);
-			zip_discard(archive);
-			g_free(metabuf);
-			return SR_ERR;
+		memcpy(buff->ov_last, data, unitsize);
+		if (++buff->ov_fill == outc->overview_bucket) {
+			g_array_append_vals(buff->ov_counts, buff->ov_cur,
+				unitsize * 8);
+			memset(buff->ov_cur, 0, unitsize * 8 * sizeof(uint32_t));
+			buff->ov_fill = 0;
+		}
+	}
+}
+
+/**
+ * Track an analog channel's minimum and maximum for the overview.
+ *
+ * @param[in] o Output module instance.
+ * @param[in] idx Index of the channel's queue.
+ * @param[in] data Analog samples.
+ * @param[in] count Number of samples.
+ */
+static void overview_analog(const struct sr_output *o, size_t idx,
+	const float *data, size_t count)
+{
+	struct out_context *outc;
+	struct analog_buff *buff;
+	size_t i;
+
+	outc = o->priv;
+	buff = &outc->analog_buff[idx];
+	if (!outc->overview_bucket)
+		return;
+	if (!buff->ov_minmax)
+		buff->ov_minmax = g_array_new(FALSE, FALSE, sizeof(float));
+
+	for (i = 0; i < count; i++) {
+		if (!buff->ov_fill || data[i] < buff->ov_min)
+			buff->ov_min = data[i];
+		if (!buff->ov_fill || data[i] > buff->ov_max)
+			buff->ov_max = data[i];
+		if (++buff->ov_fill == outc->overview_bucket) {
+			g_array_append_val(buff->ov_minmax, buff->ov_min);
+			g_array_append_val(buff->ov_minmax, buff->ov_max);
+			buff->ov_fill = 0;
 		}
 	}
-	g_key_file_free(kf);
+}
 
-	next_chunk_num = 1;
-	num_files = zip_get_num_entries(archive, 0);
-	for (i = 0; i < num_files; i++) {
-		entry_name = zip_get_name(archive, i, 0);
-		if (!entry_name || strncmp(entry_name, "logic-1", 7) != 0)
-			continue;
-		if (entry_name[7] == '\0') {
-			/*
-			 * This file has no extra chunks, just a single
-			 * "logic-1". Rename it to "logic-1-1" and continue
-			 * with chunk 2.
-			 */
-			if (zip_rename(archive, i, "logic-1-1") < 0) {
-				sr_err("Failed to rename 'logic-1' to 'logic-1-1': %s",
-					zip_strerror(archive));
-				zip_discard(archive);
-				g_free(metabuf);
-				return SR_ERR;
+/**
+ * Add all levels of a channel's overview to the archive.
+ *
+ * Each level merges OVERVIEW_FACTOR buckets of the previous one,
+ * until a single bucket is left. Transition counts get summed up,
+ * minimum and maximum values get combined.
+ *
+ * @param[in] o Output module instance.
+ * @param[in] prefix Entry name, the level number gets appended.
+ * @param[in] data The finest level, owned by the archive from then on.
+ * @param[in] buckets Number of buckets of the finest level.
+ * @param[in] width Number of uint32_t transition counts per bucket,
+ *                  0 for pairs of float minimum and maximum values.
+ *
+ * @returns SR_OK et al error codes.
+ */
+static int overview_add_levels(const struct sr_output *o,
+	const char *prefix, void *data, size_t buckets, size_t width)
+{
+	void *next;
+	const uint32_t *counts;
+	uint32_t *next_counts;
+	const float *values;
+	float *next_values;
+	size_t elem_size, next_buckets, b, v;
+	gboolean first;
+	unsigned int level;
+	char *name;
+	int ret;
+
+	elem_size = width ? width * sizeof(uint32_t) : 2 * sizeof(float);
+	for (level = 0; ; level++) {
+		next = NULL;
+		next_buckets = 0;
+		if (buckets > 1) {
+			next_buckets = (buckets + OVERVIEW_FACTOR - 1) / OVERVIEW_FACTOR;
+			next = g_malloc0(next_buckets * elem_size);
+		}
+		for (b = 0; next && b < buckets; b++) {
+			first = !(b % OVERVIEW_FACTOR);
+			if (width) {
+				counts = (const uint32_t *)data + b * width;
+				next_counts = (uint32_t *)next
+					+ b / OVERVIEW_FACTOR * width;
+				for (v = 0; v < width; v++)
+					next_counts[v] += counts[v];
+			} else {
+				values = (const float *)data + b * 2;
+				next_values = (float *)next + b / OVERVIEW_FACTOR * 2;
+				if (first || values[0] < next_values[0])
+					next_values[0] = values[0];
+				if (first || values[1] > next_values[1])
+					next_values[1] = values[1];
 			}
-			next_chunk_num = 2;
-			break;
-		} else if (entry_name[7] == '-') {
-			chunk_num = g_ascii_strtoull(entry_name + 8, NULL, 10);
-			if (chunk_num < G_MAXINT && chunk_num >= next_chunk_num)
-				next_chunk_num = chunk_num + 1;
 		}
+
+		name = g_strdup_printf("%s-%u", prefix, level);
+		ret = zip_add_chunk(o, name, data, buckets * elem_size, NULL);
+		g_free(name);
+		if (ret != SR_OK || !next) {
+			g_free(next);
+			return ret;
+		}
+		data = next;
+		buckets = next_buckets;
 	}
+}
+
+/**
+ * Add the overview of all channels to the archive.
+ *
+ * The overview summarizes the samples in buckets, on several levels of
+ * resolution, so viewers can draw a capture zoomed out without reading
+ * its chunks. Logic entries hold a uint32_t transition count per logic
+ * channel (unitsize * 8) for each bucket, analog entries hold a pair of
+ * float minimum and maximum values, in host byte order like the chunks.
+ *
+ * @param[in] o Output module instance.
+ *
+ * @returns SR_OK et al error codes.
+ */
+static int zip_write_overview(const struct sr_output *o)
+{
+	struct out_context *outc;
+	struct logic_buff *lbuff;
+	struct analog_buff *abuff;
+	size_t width, buckets, idx;
+	char *prefix;
+	int ret;
 
-	if (length % unitsize != 0) {
-		sr_warn("Chunk size %zu not a multiple of the"
-			" unit size %zu.", length, unitsize);
+	outc = o->priv;
+	lbuff = &outc->logic_buff;
+	if (lbuff->ov_counts) {
+		width = lbuff->unit_size * 8;
+		if (lbuff->ov_fill)
+			g_array_append_vals(lbuff->ov_counts, lbuff->ov_cur, width);
+		buckets = lbuff->ov_counts->len / width;
+		ret = overview_add_levels(o, "overview-logic-1",
+			g_array_free(lbuff->ov_counts, FALSE), buckets, width);
+		lbuff->ov_counts = NULL;
+		if (ret != SR_OK)
+			return ret;
 	}
-	logicsrc = zip_source_buffer(archive, buf, length, FALSE);
-	chunkname = g_strdup_printf("logic-1-%u", next_chunk_num);
-	i = zip_add(archive, chunkname, logicsrc);
-	g_free(chunkname);
-	if (i < 0) {
-		sr_err("Failed to add chunk 'logic-1-%u': %s",
-			next_chunk_num, zip_strerror(archive));
-		zip_source_free(logicsrc);
-		zip_discard(archive);
-		g_free(metabuf);
-		return SR_ERR;
+
+	for (idx = 0; idx < outc->analog_ch_count; idx++) {
+		abuff = &outc->analog_buff[idx];
+		if (!abuff->ov_minmax)
+			continue;
+		if (abuff->ov_fill) {
+			g_array_append_val(abuff->ov_minmax, abuff->ov_min);
+			g_array_append_val(abuff->ov_minmax, abuff->ov_max);
+		}
+		buckets = abuff->ov_minmax->len / 2;
+		prefix = g_strdup_printf("overview-analog-1-%zu",
+			outc->first_analog_index + idx);
+		ret = overview_add_levels(o, prefix,
+			g_array_free(abuff->ov_minmax, FALSE), buckets, 0);
+		abuff->ov_minmax = NULL;
+		g_free(prefix);
+		if (ret != SR_OK)
+			return ret;
 	}
-	if (zip_close(archive) < 0) {
-		sr_err("Error saving session file: %s", zip_strerror(archive));
-		zip_discard(archive);
-		g_free(metabuf);
+
+	return SR_OK;
+}
+
+/**
+ * Replace the archive's metadata by the current key/value store.
+ *
+ * @param[in] o Output module instance.
+ *
+ * @returns SR_OK et al error codes.
+ */
+static int meta_replace(const struct sr_output *o)
+{
+	struct out_context *outc;
+	struct zip_source *metasrc;
+	char *metabuf;
+	gsize metalen;
+	int ret;
+
+	outc = o->priv;
+	ret = zip_reopen(o);
+	if (ret != SR_OK)
+		return ret;
+	metabuf = g_key_file_to_data(outc->meta, &metalen, NULL);
+	outc->pending = g_slist_prepend(outc->pending, metabuf);
+	metasrc = zip_source_buffer(outc->archive, metabuf, metalen, FALSE);
+	if (zip_replace(outc->archive, outc->meta_index, metasrc) < 0) {
+		sr_err("Failed to replace metadata: %s",
+			zip_strerror(outc->archive));
+		zip_source_free(metasrc);
 		return SR_ERR;
 	}
-	g_free(metabuf);
 
 	return SR_OK;
 }
 
+/**
+ * Append a chunk of logic data to an srzip archive.
+ *
+ * @param[in] o Output module instance.
+ * @param[in] buf Logic data samples, owned by the archive from then on.
+ * @param[in] length Byte sequence length (in bytes, not samples).
+ * @param[in] ref Retained packet which buf points into, or NULL.
+ *
+ * @returns SR_OK et al error codes.
+ */
+static int zip_append_chunk(const struct sr_output *o,
+	void *buf, size_t length, struct sr_datafeed_packet *ref)
+{
+	struct out_context *outc;
+	struct logic_buff *buff;
+	char *chunkname;
+	uint8_t *planes;
+	int ret;
+
+	outc = o->priv;
+	buff = &outc->logic_buff;
+
+	/* Add the unitsize field with the first logic data. */
+	if (!outc->have_unitsize) {
+		g_key_file_set_integer(outc->meta, "device 1", "unitsize",
+			buff->unit_size);
+		ret = meta_replace(o);
+		if (ret != SR_OK)
+			return ret;
+		outc->have_unitsize = TRUE;
+	}
+
+	chunkname = g_strdup_printf("logic-1-%u", buff->next_chunk++);
+	index_add(o, chunkname, buff->next_sample,
+		length / buff->unit_size, length);
+	buff->next_sample += length / buff->unit_size;
+	overview_logic(o, buf, length / buff->unit_size);
+	if (outc->planes) {
+		/* The planes replace the samples, retained or not. */
+		planes = g_try_malloc(MAX(length, 1));
+		if (planes)
+			sr_sessionfile_planes_encode(planes, buf, length,
+				buff->unit_size);
+		if (ref)
+			sr_packet_unref(ref);
+		else
+			g_free(buf);
+		if (!planes) {
+			g_free(chunkname);
+			return SR_ERR_MALLOC;
+		}
+		buf = planes;
+		ref = NULL;
+	}
+	ret = zip_add_chunk(o, chunkname, buf, length, ref);
+	g_free(chunkname);
+
+	return ret;
+}
+
+/**
+ * Append the queued logic data to an srzip archive.
+ *
+ * The queue's buffer becomes the archive entry's data, and the queue
+ * gets a new buffer.
+ *
+ * @param[in] o Output module instance.
+ *
+ * @returns SR_OK et al error codes.
+ */
+static int zip_append(const struct sr_output *o)
+{
+	struct out_context *outc;
+	struct logic_buff *buff;
+	uint8_t *samples;
+	int ret;
+
+	outc = o->priv;
+	buff = &outc->logic_buff;
+	if (!buff->fill_size)
+		return SR_OK;
+
+	samples = g_try_malloc(outc->chunk_size);
+	if (!samples)
+		return SR_ERR_MALLOC;
+
+	ret = zip_append_chunk(o, buff->samples,
+		buff->fill_size * buff->unit_size, NULL);
+	buff->samples = samples;
+	buff->fill_size = 0;
+
+	return ret;
+}
+
+/**
+ * Append a chunk of logic data straight from a packet.
+ *
+ * The packet gets retained until the archive was written, which avoids
+ * copying drivers' buffers that are attached to the session.
+ *
+ * @param[in] o Output module instance.
+ * @param[in] packet The logic packet.
+ * @param[in] buf Start of the chunk within the packet's data.
+ * @param[in] length Chunk length in bytes.
+ *
+ * @returns SR_OK et al error codes.
+ */
+static int zip_append_direct(const struct sr_output *o,
+	const struct sr_datafeed_packet *packet, const uint8_t *buf,
+	size_t length)
+{
+	const struct sr_datafeed_logic *logic, *ref_logic;
+	struct sr_datafeed_packet *ref;
+	size_t offset;
+	int ret;
+
+	ret = sr_packet_ref(o->sdi, packet, &ref);
+	if (ret != SR_OK)
+		return ret;
+	logic = packet->payload;
+	ref_logic = ref->payload;
+	offset = buf - (const uint8_t *)logic->data;
+
+	return zip_append_chunk(o, (uint8_t *)ref_logic->data + offset,
+		length, ref);
+}
+
 /**
  * Queue a block of logic data for srzip archive writes.
  *
+ * Whole chunks of packets get added without copying them, when no
+ * samples are queued.
+ *
  * @param[in] o Output module instance.
- * @param[in] buf Logic data samples as byte sequence.
- * @param[in] unitsize Logic data unit size (bytes per sample).
- * @param[in] length Number of bytes of sample data.
+ * @param[in] packet The logic packet, or NULL to only flush.
  * @param[in] flush Force ZIP archive update (queue by default).
  *
  * @returns SR_OK et al error codes.
  */
 static int zip_append_queue(const struct sr_output *o,
-	uint8_t *buf, size_t unitsize, size_t length, gboolean flush)
+	const struct sr_datafeed_packet *packet, gboolean flush)
 {
 	struct out_context *outc;
 	struct logic_buff *buff;
-	size_t send_size, remain, copy_size;
+	const struct sr_datafeed_logic *logic;
+	size_t send_size, remain, copy_size, unitsize, length;
 	uint8_t *wrptr, *rdptr;
 	int ret;
 
 	outc = o->priv;
 	buff = &outc->logic_buff;
+	logic = packet ? packet->payload : NULL;
+	rdptr = logic ? logic->data : NULL;
+	unitsize = logic ? logic->unitsize : 0;
+	length = logic ? logic->length : 0;
 	if (length && unitsize != buff->unit_size) {
 		sr_warn("Unexpected unit size, discarding logic data.");
 		return SR_ERR_ARG;
@@ -415,9 +1395,17 @@ static int zip_append_queue(const struct sr_output *o,
 	 * Queue most recently received samples to the local buffer.
 	 * Flush to the ZIP archive when the buffer space is exhausted.
 	 */
-	rdptr = buf;
 	send_size = buff->unit_size ? length / buff->unit_size : 0;
 	while (send_size) {
+		if (!buff->fill_size && send_size >= buff->alloc_size) {
+			copy_size = buff->alloc_size * buff->unit_size;
+			ret = zip_append_direct(o, packet, rdptr, copy_size);
+			if (ret != SR_OK)
+				return ret;
+			rdptr += copy_size;
+			send_size -= buff->alloc_size;
+			continue;
+		}
 		remain = buff->alloc_size - buff->fill_size;
 		if (remain) {
 			wrptr = &buff->samples[buff->fill_size * buff->unit_size];
@@ -429,100 +1417,201 @@ static int zip_append_queue(const struct sr_output *o,
 			remain -= copy_size;
 		}
 		if (send_size && !remain) {
-			ret = zip_append(o, buff->samples, buff->unit_size,
-				buff->fill_size * buff->unit_size);
+			ret = zip_append(o);
 			if (ret != SR_OK)
 				return ret;
-			buff->fill_size = 0;
 			remain = buff->alloc_size - buff->fill_size;
 		}
 	}
 
 	/* Flush to the ZIP archive if the caller wants us to. */
-	if (flush && buff->fill_size) {
-		ret = zip_append(o, buff->samples, buff->unit_size,
-			buff->fill_size * buff->unit_size);
+	if (flush) {
+		ret = zip_append(o);
 		if (ret != SR_OK)
 			return ret;
-		buff->fill_size = 0;
 	}
 
 	return SR_OK;
 }
 
 /**
- * Append analog data of a channel to an srzip archive.
+ * Queue the samples of a change-only logic packet.
+ *
+ * The srzip format stores every sample, so the runs between the
+ * changes get expanded straight into the local buffer.
  *
  * @param[in] o Output module instance.
- * @param[in] values Sample data as array of floating point values.
- * @param[in] count Number of samples (float items, not bytes).
- * @param[in] ch_nr 1-based channel number.
+ * @param[in] edges The change-only packet payload.
  *
  * @returns SR_OK et al error codes.
  */
-static int zip_append_analog(const struct sr_output *o,
-	const float *values, size_t count, size_t ch_nr)
+static int zip_append_edges_queue(const struct sr_output *o,
+	const struct sr_datafeed_logic_edges *edges)
 {
 	struct out_context *outc;
-	struct zip *archive;
-	struct zip_source *analogsrc;
-	int64_t i, num_files;
-	size_t size;
-	struct zip_stat zs;
-	uint64_t chunk_num;
-	const char *entry_name;
-	char *basename;
-	gsize baselen;
-	char *chunkname;
-	unsigned int next_chunk_num;
+	struct logic_buff *buff;
+	uint64_t e, pos, end;
+	size_t remain, copy_size, i;
+	uint8_t *wrptr;
+	int ret;
 
 	outc = o->priv;
-
-	if (!(archive = zip_open(outc->filename, 0, NULL)))
-		return SR_ERR;
-
-	if (zip_stat(archive, "metadata", 0, &zs) < 0) {
-		sr_err("Failed to open metadata: %s", zip_strerror(archive));
-		zip_discard(archive);
-		return SR_ERR;
+	buff = &outc->logic_buff;
+	if (edges->unitsize != buff->unit_size) {
+		sr_warn("Unexpected unit size, discarding logic data.");
+		return SR_ERR_ARG;
 	}
-
-	basename = g_strdup_printf("analog-1-%zu", ch_nr);
-	baselen = strlen(basename);
-	next_chunk_num = 1;
-	num_files = zip_get_num_entries(archive, 0);
-	for (i = 0; i < num_files; i++) {
-		entry_name = zip_get_name(archive, i, 0);
-		if (!entry_name || strncmp(entry_name, basename, baselen) != 0) {
-			continue;
-		} else if (entry_name[baselen] == '-') {
-			chunk_num = g_ascii_strtoull(entry_name + baselen + 1, NULL, 10);
-			if (chunk_num < G_MAXINT && chunk_num >= next_chunk_num)
-				next_chunk_num = chunk_num + 1;
+	if (!buff->edge_value)
+		buff->edge_value = g_malloc0(buff->unit_size);
+
+	pos = 0;
+	for (e = 0; e <= edges->num_edges; e++) {
+		end = (e < edges->num_edges) ? edges->offsets[e]
+			: edges->num_samples;
+		while (pos < end) {
+			remain = buff->alloc_size - buff->fill_size;
+			if (!remain) {
+				ret = zip_append(o);
+				if (ret != SR_OK)
+					return ret;
+				continue;
+			}
+			wrptr = &buff->samples[buff->fill_size * buff->unit_size];
+			copy_size = MIN(end - pos, remain);
+			for (i = 0; i < copy_size; i++) {
+				memcpy(wrptr, buff->edge_value, buff->unit_size);
+				wrptr += buff->unit_size;
+			}
+			buff->fill_size += copy_size;
+			pos += copy_size;
 		}
+		if (e < edges->num_edges)
+			memcpy(buff->edge_value, (uint8_t *)edges->values
+				+ e * buff->unit_size, buff->unit_size);
 	}
 
-	size = sizeof(values[0]) * count;
-	analogsrc = zip_source_buffer(archive, values, size, FALSE);
-	chunkname = g_strdup_printf("%s-%u", basename, next_chunk_num);
-	i = zip_add(archive, chunkname, analogsrc);
-	if (i < 0) {
-		sr_err("Failed to add chunk '%s': %s", chunkname, zip_strerror(archive));
-		g_free(chunkname);
-		g_free(basename);
-		zip_source_free(analogsrc);
-		zip_discard(archive);
-		return SR_ERR;
+	return SR_OK;
+}
+
+/**
+ * Append the queued analog data of a channel to an srzip archive.
+ *
+ * @param[in] o Output module instance.
+ * @param[in] idx Index of the channel's queue.
+ *
+ * @returns SR_OK et al error codes.
+ */
+static int zip_append_analog(const struct sr_output *o, size_t idx)
+{
+	struct out_context *outc;
+	struct analog_buff *buff;
+	char *chunkname;
+	uint8_t *samples;
+	int ret;
+
+	outc = o->priv;
+	buff = &outc->analog_buff[idx];
+	if (!buff->fill_size)
+		return SR_OK;
+
+	samples = g_try_malloc(outc->chunk_size);
+	if (!samples)
+		return SR_ERR_MALLOC;
+
+	chunkname = g_strdup_printf("analog-1-%zu-%u",
+		outc->first_analog_index + idx, buff->next_chunk++);
+	index_add(o, chunkname, buff->next_sample, buff->fill_size,
+		buff->fill_size * buff->sample_size);
+	buff->next_sample += buff->fill_size;
+	if (outc->planes && !buff->native) {
+		/* Encode into the new buffer, and keep the queue's one. */
+		sr_sessionfile_delta_encode(samples, (float *)buff->samples,
+			buff->fill_size);
+		ret = zip_add_chunk(o, chunkname, samples,
+			buff->fill_size * buff->sample_size, NULL);
+	} else {
+		ret = zip_add_chunk(o, chunkname, buff->samples,
+			buff->fill_size * buff->sample_size, NULL);
+		buff->samples = samples;
 	}
 	g_free(chunkname);
-	if (zip_close(archive) < 0) {
-		sr_err("Error saving session file: %s", zip_strerror(archive));
-		g_free(basename);
-		zip_discard(archive);
-		return SR_ERR;
-	}
+	buff->fill_size = 0;
 
-	g_free(basename);
+	return ret;
+}
+
+/* Whether analog samples can be kept in their own encoding. */
+static gboolean analog_native_ok(const struct sr_datafeed_analog *analog)
+{
+	const struct sr_analog_encoding *enc;
+	size_t sample_stride, channel_stride;
+
+	enc = analog->encoding;
+	if (enc->is_float || !enc->scale.q || !enc->offset.q)
+		return FALSE;
+	if (enc->unitsize != 1 && enc->unitsize != 2 && enc->unitsize != 4)
+		return FALSE;
+	sr_analog_strides(analog, &sample_stride, &channel_stride);
+
+	return sample_stride == enc->unitsize;
+}
+
+static gboolean same_encoding(const struct sr_analog_encoding *a,
+	const struct sr_analog_encoding *b)
+{
+	return a->unitsize == b->unitsize && a->is_signed == b->is_signed &&
+		a->is_bigendian == b->is_bigendian &&
+		a->scale.p == b->scale.p && a->scale.q == b->scale.q &&
+		a->offset.p == b->offset.p && a->offset.q == b->offset.q;
+}
+
+/**
+ * Keep the samples of an analog channel in their own encoding.
+ *
+ * The encoding goes into the metadata as "encoding<n>", a list of the
+ * integer type (like "s16le"), the scale and the offset.
+ *
+ * @param[in] o Output module instance.
+ * @param[in] idx Index of the channel's queue.
+ * @param[in] enc Encoding of the channel's samples.
+ *
+ * @returns SR_OK et al error codes.
+ */
+static int analog_native_start(const struct sr_output *o, size_t idx,
+	const struct sr_analog_encoding *enc)
+{
+	struct out_context *outc;
+	struct analog_buff *buff;
+	char *key, *type, *scale, *offset;
+	const gchar *list[3];
+	int ret;
+
+	outc = o->priv;
+	buff = &outc->analog_buff[idx];
+
+	type = g_strdup_printf("%c%d%s", enc->is_signed ? 's' : 'u',
+		enc->unitsize * 8, enc->is_bigendian ? "be" : "le");
+	scale = g_strdup_printf("%" PRId64 "/%" PRIu64,
+		enc->scale.p, enc->scale.q);
+	offset = g_strdup_printf("%" PRId64 "/%" PRIu64,
+		enc->offset.p, enc->offset.q);
+	key = g_strdup_printf("encoding%zu", outc->first_analog_index + idx);
+	list[0] = type;
+	list[1] = scale;
+	list[2] = offset;
+	g_key_file_set_string_list(outc->meta, "device 1", key, list, 3);
+	g_free(key);
+	g_free(type);
+	g_free(scale);
+	g_free(offset);
+	ret = meta_replace(o);
+	if (ret != SR_OK)
+		return ret;
+
+	buff->native = TRUE;
+	buff->encoding = *enc;
+	buff->sample_size = enc->unitsize;
+	buff->alloc_size = outc->chunk_size / buff->sample_size;
 
 	return SR_OK;
 }
@@ -541,9 +1630,11 @@ static int zip_append_analog_queue(const struct sr_output *o,
 {
 	struct out_context *outc;
 	const struct sr_channel *ch;
-	size_t idx, nr;
+	size_t idx;
 	struct analog_buff *buff;
-	float *values, *wrptr, *rdptr;
+	float *values;
+	const uint8_t *rdptr;
+	uint8_t *wrptr;
 	size_t send_size, remain, copy_size;
 	int ret;
 
@@ -552,15 +1643,9 @@ static int zip_append_analog_queue(const struct sr_output *o,
 	/* Is this the DF_END flush call without samples submission? */
 	if (!analog && flush) {
 		for (idx = 0; idx < outc->analog_ch_count; idx++) {
-			nr = outc->first_analog_index + idx;
-			buff = &outc->analog_buff[idx];
-			if (!buff->fill_size)
-				continue;
-			ret = zip_append_analog(o,
-				buff->samples, buff->fill_size, nr);
+			ret = zip_append_analog(o, idx);
 			if (ret != SR_OK)
 				return ret;
-			buff->fill_size = 0;
 		}
 		return SR_OK;
 	}
@@ -578,55 +1663,71 @@ static int zip_append_analog_queue(const struct sr_output *o,
 	}
 	if (idx == outc->analog_ch_count)
 		return SR_ERR_ARG;
-	nr = outc->first_analog_index + idx;
 	buff = &outc->analog_buff[idx];
 
+	/* The channel's first samples decide how all of them are kept. */
+	if (!buff->encoding_known) {
+		buff->encoding_known = TRUE;
+		if (outc->native && analog_native_ok(analog)) {
+			ret = analog_native_start(o, idx, analog->encoding);
+			if (ret != SR_OK)
+				return ret;
+		}
+	}
+	if (buff->native && (!analog_native_ok(analog) ||
+			!same_encoding(&buff->encoding, analog->encoding))) {
+		sr_err("Encoding of channel %s changed, cannot keep it.",
+			ch->name);
+		return SR_ERR_DATA;
+	}
+
 	/* Convert the analog data to an array of float values. */
-	values = g_try_malloc0(analog->num_samples * sizeof(values[0]));
-	if (!values)
-		return SR_ERR_MALLOC;
-	ret = sr_analog_to_float(analog, values);
-	if (ret != SR_OK) {
-		g_free(values);
-		return ret;
+	values = NULL;
+	if (!buff->native || outc->overview_bucket) {
+		values = g_try_malloc0(analog->num_samples * sizeof(values[0]));
+		if (!values)
+			return SR_ERR_MALLOC;
+		ret = sr_analog_to_float_prepared(analog, values);
+		if (ret != SR_OK) {
+			g_free(values);
+			return ret;
+		}
+		overview_analog(o, idx, values, analog->num_samples);
 	}
 
 	/*
 	 * Queue most recently received samples to the local buffer.
 	 * Flush to the ZIP archive when the buffer space is exhausted.
 	 */
-	rdptr = values;
+	rdptr = buff->native ? analog->data : (const uint8_t *)values;
 	send_size = analog->num_samples;
 	while (send_size) {
 		remain = buff->alloc_size - buff->fill_size;
 		if (remain) {
-			wrptr = &buff->samples[buff->fill_size];
+			wrptr = &buff->samples[buff->fill_size * buff->sample_size];
 			copy_size = MIN(send_size, remain);
 			send_size -= copy_size;
 			buff->fill_size += copy_size;
-			memcpy(wrptr, rdptr, copy_size * sizeof(values[0]));
-			rdptr += copy_size;
+			memcpy(wrptr, rdptr, copy_size * buff->sample_size);
+			rdptr += copy_size * buff->sample_size;
 			remain -= copy_size;
 		}
 		if (send_size && !remain) {
-			ret = zip_append_analog(o,
-				buff->samples, buff->fill_size, nr);
+			ret = zip_append_analog(o, idx);
 			if (ret != SR_OK) {
 				g_free(values);
 				return ret;
 			}
-			buff->fill_size = 0;
 			remain = buff->alloc_size - buff->fill_size;
 		}
 	}
 	g_free(values);
 
 	/* Flush to the ZIP archive if the caller wants us to. */
-	if (flush && buff->fill_size) {
-		ret = zip_append_analog(o, buff->samples, buff->fill_size, nr);
+	if (flush) {
+		ret = zip_append_analog(o, idx);
 		if (ret != SR_OK)
 			return ret;
-		buff->fill_size = 0;
 	}
 
 	return SR_OK;
@@ -637,7 +1738,6 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 {
 	struct out_context *outc;
 	const struct sr_datafeed_meta *meta;
-	const struct sr_datafeed_logic *logic;
 	const struct sr_datafeed_analog *analog;
 	const struct sr_config *src;
 	GSList *l;
@@ -663,9 +1763,17 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 				return ret;
 			outc->zip_created = TRUE;
 		}
-		logic = packet->payload;
-		ret = zip_append_queue(o, logic->data,
-			logic->unitsize, logic->length, FALSE);
+		ret = zip_append_queue(o, packet, FALSE);
+		if (ret != SR_OK)
+			return ret;
+		break;
+	case SR_DF_LOGIC_EDGES:
+		if (!outc->zip_created) {
+			if ((ret = zip_create(o)) != SR_OK)
+				return ret;
+			outc->zip_created = TRUE;
+		}
+		ret = zip_append_edges_queue(o, packet->payload);
 		if (ret != SR_OK)
 			return ret;
 		break;
@@ -682,12 +1790,21 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 		break;
 	case SR_DF_END:
 		if (outc->zip_created) {
-			ret = zip_append_queue(o, NULL, 0, 0, TRUE);
+			ret = zip_append_queue(o, NULL, TRUE);
 			if (ret != SR_OK)
 				return ret;
 			ret = zip_append_analog_queue(o, NULL, TRUE);
 			if (ret != SR_OK)
 				return ret;
+			ret = zip_write_overview(o);
+			if (ret != SR_OK)
+				return ret;
+			ret = zip_write_index(o);
+			if (ret != SR_OK)
+				return ret;
+			ret = zip_commit(o);
+			if (ret != SR_OK)
+				return ret;
 		}
 		break;
 	}
@@ -696,11 +1813,40 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 }
 
 static struct sr_option options[] = {
+	{"threads", "Threads", "Number of compression threads, 0 for one per processor (needs zlib)", NULL, NULL},
+	{"compression", "Compression", "Compression method of sample data chunks", NULL, NULL},
+	{"chunksize", "Chunk size", "Size of sample data chunks in bytes", NULL, NULL},
+	{"overview", "Overview", "Samples per bucket of the overview's finest level, 0 for no overview", NULL, NULL},
+	{"encoding", "Encoding", "Layout of sample data chunks, bitplane compresses better but needs newer readers", NULL, NULL},
+	{"native", "Native analog", "Keep integer analog samples with their scale and offset instead of floats", NULL, NULL},
 	ALL_ZERO
 };
 
 static const struct sr_option *get_options(void)
 {
+	GSList *l;
+	size_t i;
+
+	if (!options[0].def) {
+		options[0].def = g_variant_new_uint32(0);
+		g_variant_ref_sink(options[0].def);
+		options[1].def = g_variant_ref_sink(g_variant_new_string("deflate"));
+		l = NULL;
+		for (i = 0; i < ARRAY_SIZE(chunk_codecs); i++)
+			l = g_slist_append(l, g_variant_ref_sink(
+				g_variant_new_string(chunk_codecs[i].name)));
+		options[1].values = l;
+		options[2].def = g_variant_ref_sink(g_variant_new_uint32(CHUNK_SIZE));
+		options[3].def = g_variant_ref_sink(g_variant_new_uint32(0));
+		options[4].def = g_variant_ref_sink(g_variant_new_string("raw"));
+		l = g_slist_append(NULL,
+			g_variant_ref_sink(g_variant_new_string("raw")));
+		l = g_slist_append(l,
+			g_variant_ref_sink(g_variant_new_string("bitplane")));
+		options[4].values = l;
+		options[5].def = g_variant_ref_sink(g_variant_new_boolean(FALSE));
+	}
+
 	return options;
 }
 
@@ -711,11 +1857,33 @@ static int cleanup(struct sr_output *o)
 
 	outc = o->priv;
 
+	/* Write what an aborted acquisition left in the archive. */
+	zip_write_index(o);
+	zip_commit(o);
+	if (outc->meta)
+		g_key_file_free(outc->meta);
+	if (outc->index)
+		g_string_free(outc->index, TRUE);
+#ifdef HAVE_ZLIB
+	if (outc->pool)
+		g_thread_pool_free(outc->pool, FALSE, TRUE);
+	g_mutex_clear(&outc->mutex);
+	g_cond_clear(&outc->cond);
+#endif
+
 	g_free(outc->analog_index_map);
 	g_free(outc->filename);
-	g_free(outc->logic_buff.samples);
-	for (idx = 0; idx < outc->analog_ch_count; idx++)
+	sr_buffer_free(outc->logic_buff.samples);
+	g_free(outc->logic_buff.edge_value);
+	if (outc->logic_buff.ov_counts)
+		g_array_free(outc->logic_buff.ov_counts, TRUE);
+	g_free(outc->logic_buff.ov_cur);
+	g_free(outc->logic_buff.ov_last);
+	for (idx = 0; idx < outc->analog_ch_count; idx++) {
 		g_free(outc->analog_buff[idx].samples);
+		if (outc->analog_buff[idx].ov_minmax)
+			g_array_free(outc->analog_buff[idx].ov_minmax, TRUE);
+	}
 	g_free(outc->analog_buff);
 
 	g_free(outc);
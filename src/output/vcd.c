@@ -69,8 +69,9 @@ struct context {
 	uint64_t samplerate;
 	GSList *free_list, *used_list;
 	size_t alloced, freed, reused, pooled;
-	GList *vcd_queue_list;
-	GList *vcd_queue_last;
+	GPtrArray *vcd_queue;
+	GHashTable *vcd_queue_index;
+	struct vcd_queue_item *vcd_queue_cur;
 	gboolean immediate_write;
 	uint8_t *last_logic;
 };
@@ -238,6 +239,8 @@ static int init(struct sr_output *o, GHashTable *options)
 	/* Allocate space for channel descriptions. */
 	ctx = g_malloc0(sizeof(*ctx));
 	o->priv = ctx;
+	ctx->vcd_queue = g_ptr_array_new();
+	ctx->vcd_queue_index = g_hash_table_new(g_int64_hash, g_int64_equal);
 	ctx->enabled_count = num_enabled;
 	ctx->logic_count = num_logic;
 	ctx->analog_count = num_analog;
@@ -555,203 +558,91 @@ static void queue_drain_pool(struct context *ctx)
 	g_slist_free(list);
 }
 
-static int cmp_snum(gconstpointer l, gconstpointer d)
+/*
+ * The queue is a binary min-heap of items, ordered by sample number, so
+ * that inserts and removals of the oldest item take O(log n) steps. A
+ * hash table finds the item for a sample number which already is queued.
+ */
+static void queue_heap_push(struct context *ctx, struct vcd_queue_item *item)
 {
-	const struct vcd_queue_item *list_item;
-	const uint64_t *snum_ptr;
-
-	list_item = l;
-	snum_ptr = d;
-	if (list_item->samplenum > *snum_ptr)
-		return +1;
-	if (list_item->samplenum < *snum_ptr)
-		return -1;
-	return 0;
+	struct vcd_queue_item **items;
+	size_t pos, parent;
+
+	g_ptr_array_add(ctx->vcd_queue, item);
+	items = (struct vcd_queue_item **)ctx->vcd_queue->pdata;
+	pos = ctx->vcd_queue->len - 1;
+	while (pos) {
+		parent = (pos - 1) / 2;
+		if (items[parent]->samplenum <= item->samplenum)
+			break;
+		items[pos] = items[parent];
+		pos = parent;
+	}
+	items[pos] = item;
 }
 
-static int cmp_items(gconstpointer a, gconstpointer b)
+static struct vcd_queue_item *queue_heap_pop(struct context *ctx)
 {
-	const struct vcd_queue_item *item_a, *item_b;
-
-	item_a = a;
-	item_b = b;
-	if (item_a->samplenum > item_b->samplenum)
-		return +1;
-	if (item_a->samplenum < item_b->samplenum)
-		return -1;
-	return 0;
+	struct vcd_queue_item **items, *top, *last;
+	size_t len, pos, child;
+
+	len = ctx->vcd_queue->len;
+	if (!len)
+		return NULL;
+	items = (struct vcd_queue_item **)ctx->vcd_queue->pdata;
+	top = items[0];
+	last = items[--len];
+	g_ptr_array_set_size(ctx->vcd_queue, len);
+	if (!len)
+		return top;
+
+	/* Move the last item down from the top to where it belongs. */
+	items = (struct vcd_queue_item **)ctx->vcd_queue->pdata;
+	pos = 0;
+	for (;;) {
+		child = 2 * pos + 1;
+		if (child >= len)
+			break;
+		if (child + 1 < len &&
+		    items[child + 1]->samplenum < items[child]->samplenum)
+			child++;
+		if (items[child]->samplenum >= last->samplenum)
+			break;
+		items[pos] = items[child];
+		pos = child;
+	}
+	items[pos] = last;
+
+	return top;
 }
 
 /*
  * Position the current pointer of the VCD value queue to a specific
- * sample number. Create a new queue item when needed. The logic assumes
- * a specific use pattern: Reception of striped sample data for channels
- * and processing in strict order of sample numbers within a channel.
- * Lower sample numbers near the start of the queue when channels change
- * between session feed packets, before another linear sequence follows.
- *
- * Naive use of convenience glib routines would severely lose performance.
- * That's why custom code is used, which is as complex as it needs to be,
- * yet shall execute faster than a simpler implementation. For trivial
+ * sample number. Create a new queue item when needed. For trivial
  * cases (logic only, one analog channel only) this queue is bypassed.
  */
 static int queue_samplenum(struct context *ctx, uint64_t snum)
 {
-	struct vcd_queue_item *item, *add_item;
-	GList *walk_list, *after_snum, *before_snum, *add_list;
-	GList *last;
-	gboolean add_after_last, do_search;
+	struct vcd_queue_item *item;
 
 	/* Already at that position? */
-	item = ctx->vcd_queue_last ? ctx->vcd_queue_last->data : NULL;
+	item = ctx->vcd_queue_cur;
 	if (item && item->samplenum == snum)
 		return SR_OK;
 
-	/*
-	 * Search after the current position in the remaining queue. The
-	 * custom code uses the queue's being sorted by sample number.
-	 * Narrow down a later insert position as much as possible. This
-	 * avoids linear search in huge spaces later on.
-	 */
-	last = NULL;
-	add_after_last = FALSE;
-	after_snum = NULL;
-	before_snum = NULL;
-	walk_list = ctx->vcd_queue_last;
-	while (walk_list) {
-		item = walk_list->data;
-		if (!item)
-			break;
-		if (item->samplenum == snum) {
-			ctx->vcd_queue_last = walk_list;
-			return SR_OK;
-		}
-		last = walk_list;
-		if (item->samplenum < snum)
-			before_snum = walk_list;
-		if (item->samplenum > snum) {
-			after_snum = walk_list;
-			break;
-		}
-		if (!walk_list->next)
-			add_after_last = TRUE;
-		walk_list = walk_list->next;
-	}
-
-	/*
-	 * No exact match at or beyond the current position. Run another
-	 * search from the start of the queue, again restrict the space
-	 * which is searched, and narrow down the insert position when
-	 * no match is found.
-	 *
-	 * If the searched sample number is larger than any we have seen
-	 * before, or was in the above covered range but was not found,
-	 * then we know that another queue item needs to get added, and
-	 * where to put it. In that case we need not iterate the earlier
-	 * list items.
-	 */
-	walk_list = ctx->vcd_queue_list;
-	do_search = TRUE;
-	if (add_after_last)
-		do_search = FALSE;
-	if (before_snum)
-		do_search = FALSE;
-	while (do_search && walk_list && walk_list != ctx->vcd_queue_last) {
-		item = walk_list->data;
-		if (!item)
-			break;
-		if (item->samplenum == snum) {
-			ctx->vcd_queue_last = walk_list;
-			return SR_OK;
-		}
-		if (item->samplenum < snum)
-			before_snum = walk_list;
-		if (item->samplenum > snum) {
-			after_snum = walk_list;
-			break;
-		}
-		walk_list = walk_list->next;
-	}
-
-	/*
-	 * The complete existing queue was exhausted, no exact match was
-	 * found. A new queue item must get inserted. Identify a good
-	 * position where to start searching for the exact position to
-	 * link the new item to the list. Assume that the combination of
-	 * the glib routine's list traversal and the sample number check
-	 * in the callback is expensive, reduce the amount of work done.
-	 *
-	 * If we have seen an item with a larger sample number than the
-	 * wanted, check its immediate predecessor. If this has a smaller
-	 * sample number, then we found a perfect location to insert the
-	 * new item. If we know that the new item must be inserted after
-	 * the last traversed queue item, start there.
-	 */
-	if (!before_snum) do {
-		if (add_after_last)
-			break;
-		if (!after_snum)
-			break;
-		walk_list = after_snum->prev;
-		if (!walk_list)
-			break;
-		item = walk_list->data;
+	item = g_hash_table_lookup(ctx->vcd_queue_index, &snum);
+	if (!item) {
+		if (with_queue_stats)
+			sr_dbg("%s(), queue nr %" PRIu64, __func__, snum);
+		item = queue_alloc_item(ctx, snum);
 		if (!item)
-			break;
-		if (item->samplenum == snum) {
-			ctx->vcd_queue_last = walk_list;
-			return SR_OK;
-		}
-		if (item->samplenum < snum)
-			before_snum = walk_list;
-	} while (0);
-	add_list = add_after_last ? last : before_snum;
-	if (!add_list) {
-		walk_list = ctx->vcd_queue_list;
-		while (walk_list) {
-			item = walk_list->data;
-			if (!item)
-				break;
-			if (item->samplenum == snum) {
-				ctx->vcd_queue_last = walk_list;
-				return SR_OK;
-			}
-			if (item->samplenum > snum) {
-				after_snum = walk_list;
-				break;
-			}
-			add_list = walk_list;
-			walk_list = walk_list->next;
-		}
-	}
-	if (add_list && (item = add_list->data) && item->samplenum == snum) {
-		ctx->vcd_queue_last = add_list;
-		return SR_OK;
+			return SR_ERR_MALLOC;
+		queue_heap_push(ctx, item);
+		g_hash_table_insert(ctx->vcd_queue_index,
+			&item->samplenum, item);
 	}
+	ctx->vcd_queue_cur = item;
 
-	/*
-	 * Create a new queue item for the so far untracked sample
-	 * number. Immediately search for the inserted position (is
-	 * unfortunately not returned from the insert call), and
-	 * cache that position for subsequent lookups.
-	 */
-	if (with_queue_stats)
-		sr_dbg("%s(), queue nr %" PRIu64, __func__, snum);
-	add_item = queue_alloc_item(ctx, snum);
-	if (!add_item)
-		return SR_ERR_MALLOC;
-	if (!add_list)
-		add_list = ctx->vcd_queue_list;
-	if (add_list && add_list->prev)
-		add_list = add_list->prev;
-	walk_list = g_list_insert_sorted(add_list, add_item, cmp_items);
-	if (!walk_list->prev)
-		ctx->vcd_queue_list = walk_list;
-	walk_list = g_list_find_custom(walk_list, &snum, cmp_snum);
-	item = walk_list ? walk_list->data : NULL;
-	if (item && item->samplenum == snum) {
-		ctx->vcd_queue_last = walk_list;
-	}
 	return SR_OK;
 }
 
@@ -766,7 +657,7 @@ static GString *queue_value_text_prep(struct context *ctx)
 	GString *buff;
 
 	/* Cope with not-yet-positioned write pointers. */
-	item = ctx->vcd_queue_last ? ctx->vcd_queue_last->data : NULL;
+	item = ctx->vcd_queue_cur;
 	if (!item)
 		return NULL;
 
@@ -934,7 +825,6 @@ static uint64_t get_max_snum_flush(struct context *ctx)
 static int write_completed_changes(struct context *ctx, GString *out)
 {
 	uint64_t upto_snum;
-	GList **listref, *node;
 	struct vcd_queue_item *item;
 	int rc;
 	size_t dumped;
@@ -945,31 +835,28 @@ static int write_completed_changes(struct context *ctx, GString *out)
 		sr_spew("%s(), check up to %" PRIu64, __func__, upto_snum);
 
 	/*
-	 * Forward and consume those items from the head of the list
+	 * Forward and consume those items from the top of the heap
 	 * which we completely have accumulated and are certain about.
 	 */
 	dumped = 0;
-	listref = &ctx->vcd_queue_list;
-	while (*listref) {
+	while (ctx->vcd_queue->len) {
 		/* Find items before the targetted sample number. */
-		node = *listref;
-		item = node->data;
-		if (!item)
-			break;
+		item = g_ptr_array_index(ctx->vcd_queue, 0);
 		if (item->samplenum >= upto_snum)
 			break;
 
 		/*
-		 * Unlink the item from the list. Void cached positions.
+		 * Unlink the item from the queue. Void cached positions.
 		 * Append its timestamp and values to the caller's text.
 		 */
 		dumped++;
 		if (with_queue_stats)
 			sr_dbg("%s(), dump nr %" PRIu64,
 				__func__, item->samplenum);
-		if (ctx->vcd_queue_last == node)
-			ctx->vcd_queue_last = NULL;
-		*listref = g_list_remove_link(*listref, node);
+		if (ctx->vcd_queue_cur == item)
+			ctx->vcd_queue_cur = NULL;
+		queue_heap_pop(ctx);
+		g_hash_table_remove(ctx->vcd_queue_index, &item->samplenum);
 		rc = unqueue_item(ctx, item, out);
 		queue_free_item(ctx, item);
 		if (rc != SR_OK)
@@ -979,6 +866,66 @@ static int write_completed_changes(struct context *ctx, GString *out)
 	return SR_OK;
 }
 
+/* Emit the text for the logic values which changed at a sample number. */
+static void emit_logic_change(struct context *ctx, GString *out,
+	const uint8_t *sample, uint64_t snum_curr)
+{
+	struct vcd_channel_desc *desc;
+	size_t index, p;
+	GString *s_val;
+	uint8_t prevbit, curbit;
+	double ts;
+
+	/*
+	 * Start or continue tracking that sample number.
+	 * Avoid string copies for logic-only setups.
+	 */
+	if (ctx->immediate_write) {
+		ts = snum_to_ts(ctx, snum_curr);
+		append_vcd_timestamp(out, ts, FALSE);
+	} else {
+		queue_samplenum(ctx, snum_curr);
+	}
+
+	/* Iterate over individual logic channels. */
+	for (p = 0; p < ctx->enabled_count; p++) {
+		/*
+		 * TODO Check whether the mapping from
+		 * data image positions to channel numbers
+		 * is required. Experiments suggest that
+		 * the data image "is dense", and packs
+		 * bits of enabled channels, and leaves no
+		 * room for positions of disabled channels.
+		 */
+		desc = &ctx->channels[p];
+		if (desc->type != SR_CHANNEL_LOGIC)
+			continue;
+		index = desc->index;
+		prevbit = desc->last.logic;
+
+		/* Skip over unchanged values. */
+		curbit = sample[index / 8];
+		curbit = (curbit & (1 << (index % 8))) ? 1 : 0;
+		if (snum_curr != 0 && prevbit == curbit)
+			continue;
+		desc->last.logic = curbit;
+
+		/*
+		 * Queue, or immediately emit the text for
+		 * the observed value change.
+		 */
+		if (ctx->immediate_write) {
+			g_string_append_c(out, ' ');
+			s_val = out;
+		} else {
+			s_val = queue_value_text_prep(ctx);
+			if (!s_val)
+				return;
+		}
+		format_vcd_value_bit(s_val, curbit, desc->name);
+	}
+}
+
 /* Get packets from the session feed, generate output text. */
 static int receive(const struct sr_output *o,
 	const struct sr_datafeed_packet *packet, GString **out)
@@ -986,15 +933,16 @@ static int receive(const struct sr_output *o,
 	struct context *ctx;
 	const struct sr_datafeed_meta *meta;
 	const struct sr_datafeed_logic *logic;
+	const struct sr_datafeed_logic_edges *edges;
 	const struct sr_datafeed_analog *analog;
 	const struct sr_config *src;
 	GSList *l;
 	struct vcd_channel_desc *desc;
-	uint64_t snum_curr;
-	size_t count, index, p, unit_size;
+	uint64_t snum_curr, snum_base, i;
+	size_t count, index, unit_size, run;
 	gboolean changed;
 	GString *s_val;
-	uint8_t *sample, *last_logic, prevbit, curbit;
+	uint8_t *sample, *last_logic, *end;
 	GSList *channels;
 	struct sr_channel *channel;
 	int rc;
@@ -1027,67 +975,48 @@ static int receive(const struct sr_output *o,
 		upd_last_snum_logic(ctx, count);
 
 		last_logic = ctx->last_logic;
-		while (count--) {
+		end = sample + count * unit_size;
+		while (sample < end) {
 			/* Check whether any logic value has changed. */
 			changed = memcmp(last_logic, sample, unit_size) != 0;
 			changed |= snum_curr == 0;
-			if (changed)
+			if (changed) {
 				memcpy(last_logic, sample, unit_size);
+				emit_logic_change(ctx, *out, sample, snum_curr);
+			}
 
 			/*
-			 * Start or continue tracking that sample number.
-			 * Avoid string copies for logic-only setups.
+			 * Skip the run of samples which equal this one.
+			 * Comparing the data against itself shifted by one
+			 * sample finds the next change, a word at a time.
 			 */
-			if (changed) {
-				if (ctx->immediate_write) {
-					ts = snum_to_ts(ctx, snum_curr);
-					append_vcd_timestamp(*out, ts, FALSE);
-				} else {
-					queue_samplenum(ctx, snum_curr);
-				}
-			}
+			run = sr_simd_find_mismatch(sample + unit_size, sample,
+				end - sample - unit_size);
+			run = run / unit_size + 1;
+			snum_curr += run;
+			sample += run * unit_size;
+		}
+		write_completed_changes(ctx, *out);
+		break;
+	case SR_DF_LOGIC_EDGES:
+		*out = chk_header(o);
 
-			/* Iterate over individual logic channels. */
-			for (p = 0; changed && p < ctx->enabled_count; p++) {
-				/*
-				 * TODO Check whether the mapping from
-				 * data image positions to channel numbers
-				 * is required. Experiments suggest that
-				 * the data image "is dense", and packs
-				 * bits of enabled channels, and leaves no
-				 * room for positions of disabled channels.
-				 */
-				desc = &ctx->channels[p];
-				if (desc->type != SR_CHANNEL_LOGIC)
-					continue;
-				index = desc->index;
-				prevbit = desc->last.logic;
-
-				/* Skip over unchanged values. */
-				curbit = sample[index / 8];
-				curbit = (curbit & (1 << (index % 8))) ? 1 : 0;
-				if (snum_curr != 0 && prevbit == curbit)
-					continue;
-				desc->last.logic = curbit;
-
-				/*
-				 * Queue, or immediately emit the text for
-				 * the observed value change.
-				 */
-				if (ctx->immediate_write) {
-					g_string_append_c(*out, ' ');
-					s_val = *out;
-				} else {
-					s_val = queue_value_text_prep(ctx);
-					if (!s_val)
-						break;
-				}
-				format_vcd_value_bit(s_val, curbit, desc->name);
-			}
+		/* Only visit the samples where some value has changed. */
+		edges = packet->payload;
+		unit_size = edges->unitsize;
+		snum_base = get_last_snum_logic(ctx);
+		upd_last_snum_logic(ctx, edges->num_samples);
 
-			/* Advance to next set of logic samples. */
-			snum_curr++;
-			sample += unit_size;
+		last_logic = ctx->last_logic;
+		for (i = 0; i < edges->num_edges; i++) {
+			sample = (uint8_t *)edges->values + i * unit_size;
+			snum_curr = snum_base + edges->offsets[i];
+			changed = memcmp(last_logic, sample, unit_size) != 0;
+			changed |= snum_curr == 0;
+			if (changed) {
+				memcpy(last_logic, sample, unit_size);
+				emit_logic_change(ctx, *out, sample, snum_curr);
+			}
 		}
 		write_completed_changes(ctx, *out);
 		break;
@@ -1127,7 +1056,7 @@ static int receive(const struct sr_output *o,
 		floats = g_try_malloc(sizeof(*floats) * analog->num_samples);
 		if (!floats)
 			return SR_ERR_MALLOC;
-		rc = sr_analog_to_float(analog, floats);
+		rc = sr_analog_to_float_prepared(analog, floats);
 		if (rc != SR_OK) {
 			g_free(floats);
 			return rc;
@@ -1188,6 +1117,10 @@ static int cleanup(struct sr_output *o)
 	if (with_pool_stats)
 		sr_info("STATS: alloc/reuse %zu/%zu, pool/free %zu/%zu",
 			ctx->alloced, ctx->reused, ctx->pooled, ctx->freed);
+	while (ctx->vcd_queue->len)
+		queue_free_item(ctx, queue_heap_pop(ctx));
+	g_ptr_array_free(ctx->vcd_queue, TRUE);
+	g_hash_table_destroy(ctx->vcd_queue_index);
 	queue_drain_pool(ctx);
 	if (with_pool_stats)
 		sr_info("STATS: alloc/reuse %zu/%zu, pool/free %zu/%zu",
@@ -18,7 +18,9 @@
  */
 
 #include <config.h>
+#include <stdio.h>
 #include <string.h>
+#include <glib/gstdio.h>
 #include <libsigrok/libsigrok.h>
 #include "libsigrok-internal.h"
 
@@ -27,63 +29,126 @@
 /* Minimum/maximum number of samples per channel to put in a data chunk */
 #define MIN_DATA_CHUNK_SAMPLES 10
 
+/* Number of frames (one sample of every channel) per interleaved block. */
+#define FRAMES_PER_BLOCK 4096
+
+/* Size of the header which gen_header() creates. */
+#define HEADER_SIZE 46
+
 struct out_context {
 	double scale;
 	gboolean header_done;
 	uint64_t samplerate;
 	int num_channels;
 	GSList *channels;
-	int chanbuf_size;
-	int *chanbuf_used;
-	uint8_t **chanbuf;
+	size_t chanbuf_size;
+	size_t *chanbuf_used;
+	float **chanbuf;
+	float *interleaved;
 	float *fdata;
+	size_t fdata_size;
+	uint64_t data_bytes;
 };
 
-static int realloc_chanbufs(const struct sr_output *o, int size)
+/*
+ * Make room for more samples in a channel's buffer. Buffers only grow
+ * up to the high water mark of the acquisition, and get reused after.
+ */
+static int grow_chanbufs(const struct sr_output *o, size_t size)
 {
 	struct out_context *outc;
+	float *buf;
 	int i;
 
 	outc = o->priv;
+	if (size <= outc->chanbuf_size)
+		return SR_OK;
+	size = MAX(size, 2 * outc->chanbuf_size);
 	for (i = 0; i < outc->num_channels; i++) {
-		if (!(outc->chanbuf[i] = g_try_realloc(outc->chanbuf[i], sizeof(float) * size))) {
+		if (!(buf = g_try_realloc(outc->chanbuf[i], sizeof(float) * size))) {
 			sr_err("Unable to allocate enough output buffer memory.");
-			return SR_ERR;
+			return SR_ERR_MALLOC;
 		}
-		outc->chanbuf_used[i] = 0;
+		outc->chanbuf[i] = buf;
 	}
 	outc->chanbuf_size = size;
 
 	return SR_OK;
 }
 
-static int flush_chanbufs(const struct sr_output *o, GString *out)
+/* Returns the number of frames which all channel buffers have data for. */
+static size_t complete_frames(const struct sr_output *o)
 {
 	struct out_context *outc;
-	int num_samples, i, j;
-	char *buf, *bufp;
+	size_t frames;
+	int i;
 
 	outc = o->priv;
+	frames = outc->chanbuf_size;
+	for (i = 0; i < outc->num_channels; i++)
+		frames = MIN(frames, outc->chanbuf_used[i]);
 
-	/* Any one of them will do. */
-	num_samples = outc->chanbuf_used[0];
-	if (!(buf = g_try_malloc(4 * num_samples * outc->num_channels))) {
-		sr_err("Unable to allocate enough interleaved output buffer memory.");
-		return SR_ERR;
-	}
+	return frames;
+}
+
+static int write_data(const struct sr_output *o, GString *out,
+		const void *data, size_t len)
+{
+	struct out_context *outc;
+
+	outc = o->priv;
+	outc->data_bytes += len;
+	if (o->writer)
+		return sr_output_write(o, data, len);
+	g_string_append_len(out, data, len);
+
+	return SR_OK;
+}
 
-	bufp = buf;
-	for (i = 0; i < num_samples; i++) {
+/*
+ * Interleave the frames which all channels have data for, in blocks of
+ * a reused buffer. Each channel's samples get copied with a fixed stride,
+ * which the compiler can turn into vector code. The output is made of
+ * little endian floats.
+ */
+static int flush_chanbufs(const struct sr_output *o, GString *out)
+{
+	struct out_context *outc;
+	size_t frames, done, count, i, stride;
+	const float *src;
+	float *dst;
+	int j, ret;
+#ifdef WORDS_BIGENDIAN
+	size_t k;
+#endif
+
+	outc = o->priv;
+	frames = complete_frames(o);
+	stride = outc->num_channels;
+	for (done = 0; done < frames; done += count) {
+		count = MIN(frames - done, FRAMES_PER_BLOCK);
 		for (j = 0; j < outc->num_channels; j++) {
-			memcpy(bufp, outc->chanbuf[j] + i * 4, 4);
-			bufp += 4;
+			src = outc->chanbuf[j] + done;
+			dst = outc->interleaved + j;
+			for (i = 0; i < count; i++)
+				dst[i * stride] = src[i];
 		}
+#ifdef WORDS_BIGENDIAN
+		for (k = 0; k < count * stride; k++)
+			write_fltle((uint8_t *)&outc->interleaved[k], outc->interleaved[k]);
+#endif
+		ret = write_data(o, out, outc->interleaved,
+			sizeof(float) * count * stride);
+		if (ret != SR_OK)
+			return ret;
 	}
-	g_string_append_len(out, buf, 4 * num_samples * outc->num_channels);
-	g_free(buf);
 
-	for (i = 0; i < outc->num_channels; i++)
-		outc->chanbuf_used[i] = 0;
+	/* Keep the samples of channels which are ahead of the others. */
+	for (j = 0; j < outc->num_channels; j++) {
+		outc->chanbuf_used[j] -= frames;
+		memmove(outc->chanbuf[j], outc->chanbuf[j] + frames,
+			sizeof(float) * outc->chanbuf_used[j]);
+	}
 
 	return SR_OK;
 }
@@ -109,12 +174,12 @@ static int init(struct sr_output *o, GHashTable *options)
 	}
 
 	outc->chanbuf = g_malloc0(sizeof(float *) * outc->num_channels);
-	outc->chanbuf_used = g_malloc0(sizeof(int) * outc->num_channels);
+	outc->chanbuf_used = g_malloc0(sizeof(size_t) * outc->num_channels);
+	outc->interleaved = g_malloc(sizeof(float) * FRAMES_PER_BLOCK *
+		MAX(outc->num_channels, 1));
 
-	/* Start off the interleaved buffer with 100 samples/channel. */
-	realloc_chanbufs(o, 100);
-
-	return SR_OK;
+	/* Start off the channel buffers with one block's worth of samples. */
+	return grow_chanbufs(o, FRAMES_PER_BLOCK);
 }
 
 static void add_data_chunk(const struct sr_output *o, GString *gs)
@@ -182,55 +247,35 @@ static GString *gen_header(const struct sr_output *o)
 }
 
 /*
- * Stores the float in little-endian BINARY32 IEEE-754 2008 format.
+ * The header's size fields are maxed out while the data gets streamed.
+ * Put in the actual sizes when the output went to a file which holds
+ * all of the data already.
  */
-static void float_to_le(uint8_t *buf, float value)
-{
-	uint8_t *old;
-
-	old = (uint8_t *)&value;
-#ifdef WORDS_BIGENDIAN
-	buf[0] = old[3];
-	buf[1] = old[2];
-	buf[2] = old[1];
-	buf[3] = old[0];
-#else
-	buf[0] = old[0];
-	buf[1] = old[1];
-	buf[2] = old[2];
-	buf[3] = old[3];
-#endif
-}
-
-/*
- * Returns the number of samples used in the current channel buffers,
- * or -1 if they're not all the same.
- */
-static int check_chanbuf_size(const struct sr_output *o)
+static void fixup_header(const struct sr_output *o)
 {
 	struct out_context *outc;
-	int size, i;
+	GStatBuf st;
+	FILE *f;
+	uint8_t tmp[4];
 
 	outc = o->priv;
-	size = 0;
-	for (i = 0; i < outc->num_channels; i++) {
-		if (size == 0) {
-			if (outc->chanbuf_used[i] == 0) {
-				/* Nothing in all the buffers yet. */
-				size = -1;
-				break;
-			} else {
-				/* New high water mark. */
-				size = outc->chanbuf_used[i];
-			}
-		} else if (outc->chanbuf_used[i] != size) {
-			/* All channel buffers are not equally full yet. */
-			size = -1;
-			break;
-		}
-	}
-
-	return size;
+	if (!o->filename || !outc->header_done)
+		return;
+	if (outc->data_bytes > UINT32_MAX - (HEADER_SIZE - 8))
+		return;
+	if (g_stat(o->filename, &st) != 0)
+		return;
+	if ((uint64_t)st.st_size != HEADER_SIZE + outc->data_bytes)
+		return;
+	if (!(f = g_fopen(o->filename, "r+b")))
+		return;
+	WL32(tmp, HEADER_SIZE - 8 + outc->data_bytes);
+	if (fseek(f, 4, SEEK_SET) == 0)
+		fwrite(tmp, 1, sizeof(tmp), f);
+	WL32(tmp, outc->data_bytes);
+	if (fseek(f, HEADER_SIZE - 4, SEEK_SET) == 0)
+		fwrite(tmp, 1, sizeof(tmp), f);
+	fclose(f);
 }
 
 static int receive(const struct sr_output *o, const struct sr_datafeed_packet *packet,
@@ -240,13 +285,11 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 	const struct sr_datafeed_meta *meta;
 	const struct sr_datafeed_analog *analog;
 	const struct sr_config *src;
-	struct sr_channel *ch;
 	GSList *l;
 	const GSList *channels;
-	float f;
-	int num_channels, num_samples, size, *chan_idx, idx, i, j, ret;
-	float *data;
-	uint8_t *buf;
+	size_t num_samples, frames, *used, i, j;
+	int num_channels, idx, ret;
+	float *data, *buf;
 
 	*out = NULL;
 	if (!o || !o->sdi || !(outc = o->priv))
@@ -274,10 +317,14 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 		num_samples = analog->num_samples;
 		channels = analog->meaning->channels;
 		num_channels = g_slist_length(analog->meaning->channels);
-		if (!(data = g_try_realloc(outc->fdata, sizeof(float) * num_samples * num_channels)))
-			return SR_ERR_MALLOC;
-		outc->fdata = data;
-		ret = sr_analog_to_float(analog, data);
+		if (num_samples * num_channels > outc->fdata_size) {
+			if (!(data = g_try_realloc(outc->fdata, sizeof(float) * num_samples * num_channels)))
+				return SR_ERR_MALLOC;
+			outc->fdata = data;
+			outc->fdata_size = num_samples * num_channels;
+		}
+		data = outc->fdata;
+		ret = sr_analog_to_float_prepared(analog, data);
 		if (ret != SR_OK)
 			return ret;
 
@@ -290,41 +337,35 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 			return SR_ERR;
 		}
 
-		if (num_samples > outc->chanbuf_size) {
-			if (realloc_chanbufs(o, analog->num_samples) != SR_OK)
-				return SR_ERR_MALLOC;
-		}
-
-		/* Index the channels in this packet, so we can interleave quicker. */
-		chan_idx = g_malloc(sizeof(int) * outc->num_channels);
-		for (i = 0; i < num_channels; i++) {
-			ch = g_slist_nth_data((GSList *) channels, i);
-			chan_idx[i] = g_slist_index(outc->channels, ch);
-		}
-
-		for (i = 0; i < num_samples; i++) {
-			for (j = 0; j < num_channels; j++) {
-				idx = chan_idx[j];
-				buf = outc->chanbuf[idx] + outc->chanbuf_used[idx]++ * 4;
-				f = data[i * num_channels + j];
-				if (outc->scale != 1.0)
-					f /= outc->scale;
-				float_to_le(buf, f);
+		/* Split the packet's samples into the channel buffers. */
+		for (j = 0; j < (size_t)num_channels; j++) {
+			idx = g_slist_index(outc->channels,
+				g_slist_nth_data((GSList *)channels, j));
+			if (idx < 0)
+				continue;
+			used = &outc->chanbuf_used[idx];
+			if ((ret = grow_chanbufs(o, *used + num_samples)) != SR_OK)
+				return ret;
+			buf = outc->chanbuf[idx] + *used;
+			for (i = 0; i < num_samples; i++)
+				buf[i] = data[i * num_channels + j];
+			if (outc->scale != 1.0) {
+				for (i = 0; i < num_samples; i++)
+					buf[i] /= outc->scale;
 			}
+			*used += num_samples;
 		}
-		g_free(chan_idx);
 
-		size = check_chanbuf_size(o);
-		if (size > MIN_DATA_CHUNK_SAMPLES)
-			if (flush_chanbufs(o, *out) != SR_OK)
-				return SR_ERR;
+		frames = complete_frames(o);
+		if (frames > MIN_DATA_CHUNK_SAMPLES)
+			if ((ret = flush_chanbufs(o, *out)) != SR_OK)
+				return ret;
 		break;
 	case SR_DF_END:
-		size = check_chanbuf_size(o);
-		if (size > 0) {
-			*out = g_string_sized_new(4 * size * outc->num_channels);
-			if (flush_chanbufs(o, *out) != SR_OK)
-				return SR_ERR;
+		if (complete_frames(o) > 0) {
+			*out = g_string_sized_new(512);
+			if ((ret = flush_chanbufs(o, *out)) != SR_OK)
+				return ret;
 		}
 		break;
 	}
@@ -351,12 +392,14 @@ static int cleanup(struct sr_output *o)
 	int i;
 
 	outc = o->priv;
+	fixup_header(o);
 	g_slist_free(outc->channels);
 	g_variant_unref(options[0].def);
 	for (i = 0; i < outc->num_channels; i++)
 		g_free(outc->chanbuf[i]);
 	g_free(outc->chanbuf_used);
 	g_free(outc->chanbuf);
+	g_free(outc->interleaved);
 	g_free(outc->fdata);
 	g_free(outc);
 	o->priv = NULL;
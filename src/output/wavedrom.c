@@ -18,110 +18,152 @@
  */
 
 #include <config.h>
+#include <errno.h>
+#include <stdio.h>
 #include <string.h>
 #include <libsigrok/libsigrok.h>
 #include "libsigrok-internal.h"
 
 #define LOG_PREFIX "output/wavedrom"
 
+/* Size of wave text which gets kept in memory per spooled channel. */
+#define SPOOL_BLOCK_SIZE (64 * 1024)
+
+struct channel_wave {
+	GString *text; /* wave text, repeated values collapsed to '.' */
+	FILE *spool; /* temporary file for text beyond the block size */
+	char last_char;
+};
+
 struct context {
 	uint32_t channel_count;
 	struct sr_channel **channels;
-	GString **channel_outputs; /* output strings */
+	struct channel_wave *waves;
+	gboolean spool;
 };
 
+static int spool_text(struct channel_wave *wave)
+{
+	if (fwrite(wave->text->str, 1, wave->text->len, wave->spool) != wave->text->len) {
+		sr_err("Cannot write to spool file: %s.", g_strerror(errno));
+		return SR_ERR_IO;
+	}
+	g_string_truncate(wave->text, 0);
+
+	return SR_OK;
+}
+
+/* Emits a channel's wave text, in blocks when it was spooled. */
+static int render_wave(const struct sr_output *o, struct channel_wave *wave,
+	GString *output)
+{
+	size_t len;
+	int ret;
+
+	if (!wave->spool) {
+		g_string_append_len(output, wave->text->str, wave->text->len);
+		return SR_OK;
+	}
+
+	if ((ret = spool_text(wave)) != SR_OK)
+		return ret;
+	rewind(wave->spool);
+	g_string_set_size(wave->text, SPOOL_BLOCK_SIZE);
+	while ((len = fread(wave->text->str, 1, SPOOL_BLOCK_SIZE, wave->spool))) {
+		g_string_append_len(output, wave->text->str, len);
+		if ((ret = sr_output_flush(o, output)) != SR_OK)
+			return ret;
+	}
+	g_string_truncate(wave->text, 0);
+	if (ferror(wave->spool)) {
+		sr_err("Cannot read from spool file.");
+		return SR_ERR_IO;
+	}
+
+	return SR_OK;
+}
+
 /* Converts accumulated output data to a JSON string. */
-static GString *wavedrom_render(const struct context *ctx)
+static int wavedrom_render(const struct sr_output *o, GString *output)
 {
-	GString *output;
-	size_t ch, i;
-	char last_char, curr_char;
+	struct context *ctx;
+	size_t ch;
+	gboolean first;
+	int ret;
 
-	output = g_string_new("{ \"signal\": [");
+	ctx = o->priv;
+	g_string_append(output, "{ \"signal\": [");
+	first = TRUE;
 	for (ch = 0; ch < ctx->channel_count; ch++) {
-		if (!ctx->channel_outputs[ch])
+		if (!ctx->waves[ch].text)
 			continue;
 
 		/* Channel strip. */
 		g_string_append_printf(output,
-			"{ \"name\": \"%s\", \"wave\": \"", ctx->channels[ch]->name);
-
-		last_char = 0;
-		for (i = 0; i < ctx->channel_outputs[ch]->len; i++) {
-			curr_char = ctx->channel_outputs[ch]->str[i];
-			/* Data point. */
-			if (curr_char == last_char) {
-				g_string_append_c(output, '.');
-			} else {
-				g_string_append_c(output, curr_char);
-				last_char = curr_char;
-			}
-		}
-		if (ch < ctx->channel_count - 1) {
-			g_string_append(output, "\" },");
-		} else {
-			/* Last channel, no comma. */
-			g_string_append(output, "\" }");
-		}
+			"%s{ \"name\": \"%s\", \"wave\": \"",
+			first ? "" : ",", ctx->channels[ch]->name);
+		first = FALSE;
+		if ((ret = render_wave(o, &ctx->waves[ch], output)) != SR_OK)
+			return ret;
+		g_string_append(output, "\" }");
 	}
 	g_string_append(output, "], \"config\": { \"skin\": \"narrow\" }}");
 
-	return output;
+	return SR_OK;
 }
 
-static void process_logic(const struct context *ctx,
+static int process_logic(const struct context *ctx,
 	const struct sr_datafeed_logic *logic)
 {
+	struct channel_wave *wave;
 	size_t sample_count, ch, i;
-	uint8_t *sample, bit;
-	GString *accu;
+	const uint8_t *sample;
+	uint8_t mask;
+	char c;
+	int ret;
 
 	if (!ctx->channel_count)
-		return;
+		return SR_OK;
 
 	/*
-	 * Extract the logic bits for each channel and store them
-	 * as wavedrom letters (1/0) in each channel's text string.
-	 * This transforms the input which consists of sample sets
-	 * that span multiple channels into output stripes per logic
-	 * channel which consist of bits for that individual channel.
-	 *
-	 * TODO Reduce memory consumption during accumulation of
-	 * output data.
-	 *
-	 * Ideally we'd accumulate binary chunks, and defer conversion
-	 * to the text format. Analog data already won't get here, only
-	 * logic data does. When the per-channel transformation also
-	 * gets deferred until later, then the only overhead would be
-	 * for disabled logic channels. Which may be acceptable or even
-	 * negligable.
-	 *
-	 * An optional addition to the above mentioned accumulation of
-	 * binary data is RLE compression. Mark both the position in the
-	 * accumulated data as well as a repetition counter, instead of
-	 * repeatedly storing the same sample set. The efficiency of
-	 * this approach of course depends on the change rate of input
-	 * data. But the approach perfectly matches the WaveDrom syntax
-	 * for repeated bit patterns, and thus is easily handled in the
-	 * text rendering stage of the output module.
+	 * Extract the logic bits for each channel and store them as
+	 * wavedrom letters in each channel's text string. Repeated
+	 * values get collapsed to '.' right away, so only the final
+	 * text is kept. In spool mode the text goes to a temporary
+	 * file per channel whenever a block is complete, which bounds
+	 * memory consumption regardless of the capture's length.
 	 */
 	sample_count = logic->length / logic->unitsize;
-	for (i = 0; i < sample_count; i++) {
-		sample = logic->data + i * logic->unitsize;
-		for (ch = 0; ch < ctx->channel_count; ch++) {
-			accu = ctx->channel_outputs[ch];
-			if (!accu)
-				continue;
-			bit = sample[ch / 8] & (1 << (ch % 8));
-			g_string_append_c(accu, bit ? '1' : '0');
+	for (ch = 0; ch < ctx->channel_count; ch++) {
+		wave = &ctx->waves[ch];
+		if (!wave->text)
+			continue;
+		sample = (const uint8_t *)logic->data + ch / 8;
+		mask = 1 << (ch % 8);
+		for (i = 0; i < sample_count; i++) {
+			c = (*sample & mask) ? '1' : '0';
+			sample += logic->unitsize;
+			if (c == wave->last_char) {
+				g_string_append_c(wave->text, '.');
+			} else {
+				g_string_append_c(wave->text, c);
+				wave->last_char = c;
+			}
+		}
+		if (wave->spool && wave->text->len >= SPOOL_BLOCK_SIZE) {
+			if ((ret = spool_text(wave)) != SR_OK)
+				return ret;
 		}
 	}
+
+	return SR_OK;
 }
 
 static int receive(const struct sr_output *o,
 	const struct sr_datafeed_packet *packet, GString **out)
 {
 	struct context *ctx;
+	int ret;
 
 	*out = NULL;
 
@@ -132,16 +174,19 @@ static int receive(const struct sr_output *o,
 
 	switch (packet->type) {
 	case SR_DF_LOGIC:
-		process_logic(ctx, packet->payload);
-		break;
+		return process_logic(ctx, packet->payload);
 	case SR_DF_END:
-		*out = wavedrom_render(ctx);
+		*out = g_string_sized_new(SPOOL_BLOCK_SIZE);
+		if ((ret = wavedrom_render(o, *out)) != SR_OK)
+			return ret;
 		break;
 	}
 
 	return SR_OK;
 }
 
+static int cleanup(struct sr_output *o);
+
 static int init(struct sr_output *o, GHashTable *options)
 {
 	struct context *ctx;
@@ -149,24 +194,32 @@ static int init(struct sr_output *o, GHashTable *options)
 	GSList *l;
 	size_t i;
 
-	(void)options;
-
 	if (!o || !o->sdi)
 		return SR_ERR_ARG;
 
 	o->priv = ctx = g_malloc0(sizeof(*ctx));
+	ctx->spool = g_variant_get_boolean(g_hash_table_lookup(options, "spool"));
 
 	ctx->channel_count = g_slist_length(o->sdi->channels);
 	ctx->channels = g_malloc0(
 		sizeof(ctx->channels[0]) * ctx->channel_count);
-	ctx->channel_outputs = g_malloc0(
-		sizeof(ctx->channel_outputs[0]) * ctx->channel_count);
+	ctx->waves = g_malloc0(
+		sizeof(ctx->waves[0]) * ctx->channel_count);
 
 	for (i = 0, l = o->sdi->channels; l; l = l->next, i++) {
 		channel = l->data;
 		if (channel->enabled && channel->type == SR_CHANNEL_LOGIC) {
 			ctx->channels[i] = channel;
-			ctx->channel_outputs[i] = g_string_new(NULL);
+			ctx->waves[i].text = g_string_new(NULL);
+			if (!ctx->spool)
+				continue;
+			ctx->waves[i].spool = tmpfile();
+			if (!ctx->waves[i].spool) {
+				sr_err("Cannot create spool file: %s.",
+					g_strerror(errno));
+				cleanup(o);
+				return SR_ERR_IO;
+			}
 		}
 	}
 
@@ -176,7 +229,7 @@ static int init(struct sr_output *o, GHashTable *options)
 static int cleanup(struct sr_output *o)
 {
 	struct context *ctx;
-	GString *s;
+	size_t i;
 
 	if (!o)
 		return SR_ERR_ARG;
@@ -185,12 +238,13 @@ static int cleanup(struct sr_output *o)
 	o->priv = NULL;
 
 	if (ctx) {
-		while (--ctx->channel_count) {
-			s = ctx->channel_outputs[ctx->channel_count];
-			if (s)
-				g_string_free(s, TRUE);
+		for (i = 0; i < ctx->channel_count; i++) {
+			if (ctx->waves[i].text)
+				g_string_free(ctx->waves[i].text, TRUE);
+			if (ctx->waves[i].spool)
+				fclose(ctx->waves[i].spool);
 		}
-		g_free(ctx->channel_outputs);
+		g_free(ctx->waves);
 		g_free(ctx->channels);
 		g_free(ctx);
 	}
@@ -198,13 +252,26 @@ static int cleanup(struct sr_output *o)
 	return SR_OK;
 }
 
+static struct sr_option options[] = {
+	{ "spool", "Spool", "Keep wave text in temporary files instead of memory", NULL, NULL },
+	ALL_ZERO
+};
+
+static const struct sr_option *get_options(void)
+{
+	if (!options[0].def)
+		options[0].def = g_variant_ref_sink(g_variant_new_boolean(FALSE));
+
+	return options;
+}
+
 SR_PRIV struct sr_output_module output_wavedrom = {
 	.id = "wavedrom",
 	.name = "WaveDrom",
 	.desc = "WaveDrom.com file format",
 	.exts = (const char *[]){"wavedrom", "json", NULL},
 	.flags = 0,
-	.options = NULL,
+	.options = get_options,
 	.init = init,
 	.receive = receive,
 	.cleanup = cleanup,
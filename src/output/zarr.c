@@ -0,0 +1,461 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Chunked array output of analog data, as a Zarr (version 2) directory.
+ *
+ * The output file name becomes a Zarr group. Each enabled analog channel
+ * becomes a one dimensional array of little endian floats within that
+ * group, stored in chunks of a configurable number of samples. Chunks
+ * optionally get compressed with zlib. Readers can load a time window
+ * by only reading (and decompressing) the chunks which cover it.
+ *
+ *   <filename>/.zgroup
+ *   <filename>/.zattrs            samplerate, channel names
+ *   <filename>/<channel>/.zarray  shape, chunk shape, compressor
+ *   <filename>/<channel>/<n>      the n-th chunk of samples
+ */
+
+#include <config.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+#define LOG_PREFIX "output/zarr"
+
+#define DEFAULT_CHUNK_SAMPLES (64 * 1024)
+
+struct zarr_array {
+	struct sr_channel *ch;
+	char *dirname;
+	uint8_t *chunk;
+	size_t chunk_fill;
+	uint64_t chunk_index;
+	uint64_t num_samples;
+};
+
+struct context {
+	char *dirname;
+	uint64_t samplerate;
+	size_t chunk_samples;
+	gboolean compress;
+	int level;
+	size_t num_arrays;
+	struct zarr_array *arrays;
+	float *fdata;
+	size_t fdata_size;
+	gboolean meta_done;
+};
+
+/* Channel names become directory names, keep them within the group. */
+static char *array_dirname(const char *dirname, const char *name)
+{
+	char *fixed, *p, *path;
+
+	fixed = g_strdup(name);
+	for (p = fixed; *p; p++) {
+		if (*p == '/' || *p == '\\')
+			*p = '_';
+	}
+	if (fixed[0] == '.' || fixed[0] == '\0') {
+		p = g_strconcat("_", fixed, NULL);
+		g_free(fixed);
+		fixed = p;
+	}
+	path = g_build_filename(dirname, fixed, NULL);
+	g_free(fixed);
+
+	return path;
+}
+
+static int write_file(const char *dirname, const char *name,
+	const void *data, size_t len)
+{
+	GError *error;
+	char *path;
+	gboolean ok;
+
+	path = g_build_filename(dirname, name, NULL);
+	error = NULL;
+	ok = g_file_set_contents(path, data, len, &error);
+	if (!ok) {
+		sr_err("Cannot write '%s': %s.", path, error->message);
+		g_error_free(error);
+	}
+	g_free(path);
+
+	return ok ? SR_OK : SR_ERR_IO;
+}
+
+static int init(struct sr_output *o, GHashTable *options)
+{
+	struct context *ctx;
+	struct sr_channel *ch;
+	struct zarr_array *arr;
+	const char *compression;
+	GSList *l;
+
+	if (!o || !o->sdi)
+		return SR_ERR_ARG;
+	if (!o->filename || o->filename[0] == '\0') {
+		sr_info("zarr output module requires a file name, cannot save.");
+		return SR_ERR_ARG;
+	}
+
+	compression = g_variant_get_string(g_hash_table_lookup(options,
+		"compression"), NULL);
+	if (strcmp(compression, "none") && strcmp(compression, "zlib")) {
+		sr_err("Unsupported compression '%s'.", compression);
+		return SR_ERR_ARG;
+	}
+#ifndef HAVE_ZLIB
+	if (!strcmp(compression, "zlib")) {
+		sr_err("Compression '%s' needs zlib support.", compression);
+		return SR_ERR_ARG;
+	}
+#endif
+
+	ctx = g_malloc0(sizeof(*ctx));
+	o->priv = ctx;
+	ctx->dirname = g_strdup(o->filename);
+	ctx->compress = !strcmp(compression, "zlib");
+	ctx->level = g_variant_get_uint32(g_hash_table_lookup(options, "level"));
+	ctx->level = MIN(ctx->level, 9);
+	ctx->chunk_samples = g_variant_get_uint32(g_hash_table_lookup(options,
+		"chunksize"));
+	if (!ctx->chunk_samples)
+		ctx->chunk_samples = DEFAULT_CHUNK_SAMPLES;
+
+	for (l = o->sdi->channels; l; l = l->next) {
+		ch = l->data;
+		if (ch->enabled && ch->type == SR_CHANNEL_ANALOG)
+			ctx->num_arrays++;
+	}
+	ctx->arrays = g_malloc0(ctx->num_arrays * sizeof(ctx->arrays[0]));
+	arr = ctx->arrays;
+	for (l = o->sdi->channels; l; l = l->next) {
+		ch = l->data;
+		if (!ch->enabled || ch->type != SR_CHANNEL_ANALOG)
+			continue;
+		arr->ch = ch;
+		arr->dirname = array_dirname(ctx->dirname, ch->name);
+		arr->chunk = g_malloc0(ctx->chunk_samples * sizeof(float));
+		if (g_mkdir_with_parents(arr->dirname, 0755) != 0) {
+			sr_err("Cannot create '%s': %s.", arr->dirname,
+				g_strerror(errno));
+			return SR_ERR_IO;
+		}
+		arr++;
+	}
+
+	return SR_OK;
+}
+
+/* Write a chunk, the last chunk of an array gets padded with zeros. */
+static int write_chunk(struct context *ctx, struct zarr_array *arr)
+{
+	char name[24];
+	size_t size;
+	int ret;
+#ifdef HAVE_ZLIB
+	uLongf zlen;
+	uint8_t *zbuf;
+#endif
+
+	if (!arr->chunk_fill)
+		return SR_OK;
+
+	size = ctx->chunk_samples * sizeof(float);
+	memset(arr->chunk + arr->chunk_fill * sizeof(float), 0,
+		size - arr->chunk_fill * sizeof(float));
+	snprintf(name, sizeof(name), "%" PRIu64, arr->chunk_index);
+
+#ifdef HAVE_ZLIB
+	if (ctx->compress) {
+		zlen = compressBound(size);
+		zbuf = g_try_malloc(zlen);
+		if (!zbuf)
+			return SR_ERR_MALLOC;
+		if (compress2(zbuf, &zlen, arr->chunk, size, ctx->level) != Z_OK) {
+			sr_err("Cannot compress chunk %s of channel %s.",
+				name, arr->ch->name);
+			g_free(zbuf);
+			return SR_ERR;
+		}
+		ret = write_file(arr->dirname, name, zbuf, zlen);
+		g_free(zbuf);
+	} else
+#endif
+		ret = write_file(arr->dirname, name, arr->chunk, size);
+	if (ret != SR_OK)
+		return ret;
+
+	arr->chunk_index++;
+	arr->chunk_fill = 0;
+
+	return SR_OK;
+}
+
+static int write_array_meta(struct context *ctx, struct zarr_array *arr)
+{
+	GString *s;
+	int ret;
+
+	s = g_string_sized_new(256);
+	g_string_append_printf(s, "{\n"
+		"    \"chunks\": [%zu],\n", ctx->chunk_samples);
+	if (ctx->compress) {
+		g_string_append_printf(s,
+			"    \"compressor\": {\"id\": \"zlib\", \"level\": %d},\n",
+			ctx->level);
+	} else {
+		g_string_append(s, "    \"compressor\": null,\n");
+	}
+	g_string_append_printf(s,
+		"    \"dtype\": \"<f4\",\n"
+		"    \"fill_value\": 0.0,\n"
+		"    \"filters\": null,\n"
+		"    \"order\": \"C\",\n"
+		"    \"shape\": [%" PRIu64 "],\n"
+		"    \"zarr_format\": 2\n"
+		"}\n", arr->num_samples);
+	ret = write_file(arr->dirname, ".zarray", s->str, s->len);
+	g_string_free(s, TRUE);
+
+	return ret;
+}
+
+static void append_json_string(GString *s, const char *text)
+{
+	g_string_append_c(s, '"');
+	for (; *text; text++) {
+		if (*text == '"' || *text == '\\')
+			g_string_append_c(s, '\\');
+		if ((unsigned char)*text < 0x20)
+			g_string_append_printf(s, "\\u%04x", *text);
+		else
+			g_string_append_c(s, *text);
+	}
+	g_string_append_c(s, '"');
+}
+
+/* Flush the remaining samples, and write the group's metadata. */
+static int finish(struct context *ctx)
+{
+	static const char zgroup[] = "{\n    \"zarr_format\": 2\n}\n";
+	GString *s;
+	size_t i;
+	int ret;
+
+	if (ctx->meta_done)
+		return SR_OK;
+	ctx->meta_done = TRUE;
+
+	for (i = 0; i < ctx->num_arrays; i++) {
+		if ((ret = write_chunk(ctx, &ctx->arrays[i])) != SR_OK)
+			return ret;
+		if ((ret = write_array_meta(ctx, &ctx->arrays[i])) != SR_OK)
+			return ret;
+	}
+
+	ret = write_file(ctx->dirname, ".zgroup", zgroup, strlen(zgroup));
+	if (ret != SR_OK)
+		return ret;
+
+	s = g_string_sized_new(256);
+	g_string_append_printf(s, "{\n    \"samplerate\": %" PRIu64 ",\n"
+		"    \"channels\": [", ctx->samplerate);
+	for (i = 0; i < ctx->num_arrays; i++) {
+		if (i)
+			g_string_append(s, ", ");
+		append_json_string(s, ctx->arrays[i].ch->name);
+	}
+	g_string_append(s, "]\n}\n");
+	ret = write_file(ctx->dirname, ".zattrs", s->str, s->len);
+	g_string_free(s, TRUE);
+
+	return ret;
+}
+
+static int receive_analog(struct context *ctx,
+	const struct sr_datafeed_analog *analog)
+{
+	struct zarr_array *arr;
+	GSList *l;
+	float *fdata;
+	uint8_t *wr;
+	size_t num_samples, num_channels, i, j, k, count;
+	int ret;
+
+	num_samples = analog->num_samples;
+	num_channels = g_slist_length(analog->meaning->channels);
+	if (!num_samples || !num_channels)
+		return SR_OK;
+
+	if (num_samples * num_channels > ctx->fdata_size) {
+		fdata = g_try_realloc(ctx->fdata,
+			num_samples * num_channels * sizeof(float));
+		if (!fdata)
+			return SR_ERR_MALLOC;
+		ctx->fdata = fdata;
+		ctx->fdata_size = num_samples * num_channels;
+	}
+	ret = sr_analog_to_float_prepared(analog, ctx->fdata);
+	if (ret != SR_OK)
+		return ret;
+
+	/* Samples of several channels are interleaved, split them. */
+	for (l = analog->meaning->channels, j = 0; l; l = l->next, j++) {
+		arr = NULL;
+		for (k = 0; k < ctx->num_arrays; k++) {
+			if (ctx->arrays[k].ch == l->data)
+				arr = &ctx->arrays[k];
+		}
+		if (!arr)
+			continue;
+		i = 0;
+		while (i < num_samples) {
+			count = MIN(num_samples - i,
+				ctx->chunk_samples - arr->chunk_fill);
+			wr = arr->chunk + arr->chunk_fill * sizeof(float);
+			arr->chunk_fill += count;
+			arr->num_samples += count;
+			while (count--)
+				write_fltle_inc(&wr, ctx->fdata[i++ * num_channels + j]);
+			if (arr->chunk_fill == ctx->chunk_samples) {
+				if ((ret = write_chunk(ctx, arr)) != SR_OK)
+					return ret;
+			}
+		}
+	}
+
+	return SR_OK;
+}
+
+static int receive(const struct sr_output *o, const struct sr_datafeed_packet *packet,
+		GString **out)
+{
+	const struct sr_datafeed_meta *meta;
+	const struct sr_config *src;
+	struct context *ctx;
+	GVariant *gvar;
+	GSList *l;
+
+	*out = NULL;
+	if (!o || !o->sdi)
+		return SR_ERR_ARG;
+	if (!(ctx = o->priv))
+		return SR_ERR_ARG;
+
+	switch (packet->type) {
+	case SR_DF_META:
+		meta = packet->payload;
+		for (l = meta->config; l; l = l->next) {
+			src = l->data;
+			if (src->key != SR_CONF_SAMPLERATE)
+				continue;
+			ctx->samplerate = g_variant_get_uint64(src->data);
+		}
+		break;
+	case SR_DF_ANALOG:
+		if (!ctx->samplerate && sr_config_get(o->sdi->driver, o->sdi,
+				NULL, SR_CONF_SAMPLERATE, &gvar) == SR_OK) {
+			ctx->samplerate = g_variant_get_uint64(gvar);
+			g_variant_unref(gvar);
+		}
+		return receive_analog(ctx, packet->payload);
+	case SR_DF_END:
+		return finish(ctx);
+	}
+
+	return SR_OK;
+}
+
+static struct sr_option options[] = {
+	{"compression", "Compression", "Compression method of chunks (none, zlib)", NULL, NULL},
+	{"level", "Level", "Compression level (0-9)", NULL, NULL},
+	{"chunksize", "Chunk size", "Number of samples per chunk", NULL, NULL},
+	ALL_ZERO
+};
+
+static const struct sr_option *get_options(void)
+{
+	GSList *l;
+
+	if (!options[0].def) {
+#ifdef HAVE_ZLIB
+		options[0].def = g_variant_ref_sink(g_variant_new_string("zlib"));
+#else
+		options[0].def = g_variant_ref_sink(g_variant_new_string("none"));
+#endif
+		l = NULL;
+		l = g_slist_append(l, g_variant_ref_sink(g_variant_new_string("none")));
+#ifdef HAVE_ZLIB
+		l = g_slist_append(l, g_variant_ref_sink(g_variant_new_string("zlib")));
+#endif
+		options[0].values = l;
+		options[1].def = g_variant_ref_sink(g_variant_new_uint32(1));
+		options[2].def = g_variant_ref_sink(g_variant_new_uint32(DEFAULT_CHUNK_SAMPLES));
+	}
+
+	return options;
+}
+
+static int cleanup(struct sr_output *o)
+{
+	struct context *ctx;
+	size_t i;
+
+	if (!o)
+		return SR_ERR_ARG;
+
+	if (!(ctx = o->priv))
+		return SR_OK;
+
+	/* Write what an aborted acquisition left in the directory. */
+	finish(ctx);
+	for (i = 0; i < ctx->num_arrays; i++) {
+		g_free(ctx->arrays[i].dirname);
+		g_free(ctx->arrays[i].chunk);
+	}
+	g_free(ctx->arrays);
+	g_free(ctx->fdata);
+	g_free(ctx->dirname);
+	g_free(ctx);
+	o->priv = NULL;
+
+	return SR_OK;
+}
+
+SR_PRIV struct sr_output_module output_zarr = {
+	.id = "zarr",
+	.name = "Zarr",
+	.desc = "Chunked analog arrays in a Zarr directory",
+	.exts = (const char*[]){"zarr", NULL},
+	.flags = SR_OUTPUT_INTERNAL_IO_HANDLING,
+	.options = get_options,
+	.init = init,
+	.receive = receive,
+	.cleanup = cleanup,
+};
@@ -20,6 +20,7 @@
 #include <config.h>
 #include <errno.h>
 #include <stdio.h>
+#include <string.h>
 #include <glib.h>
 #include <glib/gstdio.h>
 #include <libsigrok/libsigrok.h>
@@ -120,57 +121,55 @@ SR_PRIV int64_t sr_file_get_size(FILE *file)
 	return filesize;
 }
 
-static FILE *try_open_file(const char *datadir, const char *subdir,
-		const char *name)
+/* Full path of the first file of that name in the search paths. */
+static char *resource_locate(int type, const char *name)
 {
+	GSList *paths, *p;
 	char *filename;
-	FILE *file;
-
-	if (subdir)
-		filename = g_build_filename(datadir, subdir, name, NULL);
-	else
-		filename = g_build_filename(datadir, name, NULL);
-
-	file = g_fopen(filename, "rb");
 
-	if (file)
-		sr_info("Opened '%s'.", filename);
-	else
-		sr_spew("Attempt to open '%s' failed: %s",
-			filename, g_strerror(errno));
-	g_free(filename);
+	paths = sr_resourcepaths_get(type);
+	filename = NULL;
+	for (p = paths; p; p = p->next) {
+		filename = g_build_filename((const char *)p->data, name, NULL);
+		if (g_file_test(filename, G_FILE_TEST_IS_REGULAR))
+			break;
+		sr_spew("Attempt to open '%s' failed: not found.", filename);
+		g_free(filename);
+		filename = NULL;
+	}
+	g_slist_free_full(paths, g_free);
 
-	return file;
+	return filename;
 }
 
 static int resource_open_default(struct sr_resource *res,
 		const char *name, void *cb_data)
 {
-	GSList *paths, *p = NULL;
+	char *filename;
 	int64_t filesize;
-	FILE *file = NULL;
+	FILE *file;
 
 	(void)cb_data;
 
-	paths = sr_resourcepaths_get(res->type);
-
 	/* Currently, the enum only defines SR_RESOURCE_FIRMWARE. */
 	if (res->type != SR_RESOURCE_FIRMWARE) {
 		sr_err("%s: unknown type %d.", __func__, res->type);
 		return SR_ERR_ARG;
 	}
 
-	p = paths;
-	while (p && !file) {
-		file = try_open_file((const char *)(p->data), NULL, name);
-		p = p->next;
+	if (!(filename = resource_locate(res->type, name))) {
+		sr_dbg("Failed to locate '%s'.", name);
+		return SR_ERR;
 	}
-	g_slist_free_full(paths, g_free);
-
+	file = g_fopen(filename, "rb");
 	if (!file) {
-		sr_dbg("Failed to locate '%s'.", name);
+		sr_spew("Attempt to open '%s' failed: %s",
+			filename, g_strerror(errno));
+		g_free(filename);
 		return SR_ERR;
 	}
+	sr_info("Opened '%s'.", filename);
+	g_free(filename);
 
 	filesize = sr_file_get_size(file);
 	if (filesize < 0) {
@@ -356,6 +355,124 @@ SR_PRIV gssize sr_resource_read(struct sr_context *ctx,
 	return n_read;
 }
 
+struct resource_cache_entry {
+	char *filename;
+	gint64 mtime;
+	gint64 size;
+	GBytes *data;
+};
+
+static void resource_cache_entry_free(gpointer data)
+{
+	struct resource_cache_entry *entry;
+
+	entry = data;
+	g_free(entry->filename);
+	g_bytes_unref(entry->data);
+	g_free(entry);
+}
+
+/** @private */
+SR_PRIV void sr_resource_cache_init(struct sr_context *ctx)
+{
+	g_mutex_init(&ctx->resource_cache_mutex);
+	ctx->resource_cache = g_hash_table_new_full(g_str_hash, g_str_equal,
+		g_free, resource_cache_entry_free);
+}
+
+/** @private */
+SR_PRIV void sr_resource_cache_cleanup(struct sr_context *ctx)
+{
+	g_hash_table_destroy(ctx->resource_cache);
+	ctx->resource_cache = NULL;
+	g_mutex_clear(&ctx->resource_cache_mutex);
+}
+
+/*
+ * Load a file from the default search paths through the context's cache.
+ * Entries stay valid while the file found first keeps its size and
+ * modification time, so updated or newly installed firmware is seen.
+ * Files are read rather than mapped, a mapping would fault when they
+ * get rewritten in place.
+ */
+static GBytes *resource_load_cached(struct sr_context *ctx,
+		int type, const char *name, size_t max_size)
+{
+	struct resource_cache_entry *entry;
+	GStatBuf st;
+	GError *error;
+	GBytes *data;
+	char *key, *filename, *contents;
+	gsize len;
+
+	if (type != SR_RESOURCE_FIRMWARE) {
+		sr_err("%s: unknown type %d.", __func__, type);
+		return NULL;
+	}
+	if (!(filename = resource_locate(type, name))) {
+		sr_err("Failed to open resource '%s' (use loglevel 5/spew for"
+		       " details).", name);
+		return NULL;
+	}
+	if (g_stat(filename, &st) < 0) {
+		sr_err("Failed to obtain size of '%s': %s",
+			name, g_strerror(errno));
+		g_free(filename);
+		return NULL;
+	}
+	if ((guint64)st.st_size > max_size) {
+		sr_err("Size %" PRIu64 " of '%s' exceeds limit %zu.",
+			(uint64_t)st.st_size, name, max_size);
+		g_free(filename);
+		return NULL;
+	}
+
+	key = g_strdup_printf("%d/%s", type, name);
+	data = NULL;
+	g_mutex_lock(&ctx->resource_cache_mutex);
+	entry = g_hash_table_lookup(ctx->resource_cache, key);
+	if (entry && !strcmp(entry->filename, filename) &&
+			entry->mtime == st.st_mtime && entry->size == st.st_size)
+		data = g_bytes_ref(entry->data);
+	g_mutex_unlock(&ctx->resource_cache_mutex);
+	if (data) {
+		sr_dbg("Using cached '%s'.", filename);
+		g_free(filename);
+		g_free(key);
+		return data;
+	}
+
+	error = NULL;
+	if (!g_file_get_contents(filename, &contents, &len, &error)) {
+		sr_err("Failed to read '%s': %s", name, error->message);
+		g_error_free(error);
+		g_free(filename);
+		g_free(key);
+		return NULL;
+	}
+	sr_info("Loaded '%s'.", filename);
+	if (len > max_size) {
+		sr_err("Size %" G_GSIZE_FORMAT " of '%s' exceeds limit %zu.",
+			len, name, max_size);
+		g_free(contents);
+		g_free(filename);
+		g_free(key);
+		return NULL;
+	}
+	data = g_bytes_new_take(contents, len);
+
+	entry = g_malloc0(sizeof(*entry));
+	entry->filename = filename;
+	entry->mtime = st.st_mtime;
+	entry->size = st.st_size;
+	entry->data = g_bytes_ref(data);
+	g_mutex_lock(&ctx->resource_cache_mutex);
+	g_hash_table_replace(ctx->resource_cache, key, entry);
+	g_mutex_unlock(&ctx->resource_cache_mutex);
+
+	return data;
+}
+
 /**
  * Load a resource into memory.
  *
@@ -365,6 +482,9 @@ SR_PRIV gssize sr_resource_read(struct sr_context *ctx,
  * @param[out] size Size in bytes of the returned buffer. Must not be NULL.
  * @param max_size Size limit. Error out if the resource is larger than this.
  *
+ * With the default resource hooks, files are kept in a cache of the
+ * context, so reopening a device does not read its firmware again.
+ *
  * @return A buffer containing the resource data, or NULL on failure. Must
  *         be freed by the caller using g_free().
  *
@@ -374,10 +494,27 @@ SR_PRIV void *sr_resource_load(struct sr_context *ctx,
 		int type, const char *name, size_t *size, size_t max_size)
 {
 	struct sr_resource res;
+	GBytes *data;
 	void *buf;
 	size_t res_size;
 	gssize n_read;
 
+	if (ctx->resource_open_cb == &resource_open_default) {
+		if (!(data = resource_load_cached(ctx, type, name, max_size)))
+			return NULL;
+		res_size = g_bytes_get_size(data);
+		buf = g_try_malloc(res_size ? res_size : 1);
+		if (!buf) {
+			sr_err("Failed to allocate buffer for '%s'.", name);
+			g_bytes_unref(data);
+			return NULL;
+		}
+		memcpy(buf, g_bytes_get_data(data, NULL), res_size);
+		g_bytes_unref(data);
+		*size = res_size;
+		return buf;
+	}
+
 	if (sr_resource_open(ctx, &res, type, name) != SR_OK)
 		return NULL;
 
@@ -28,6 +28,9 @@
 #define SCPI_CMD_IDN "*IDN?"
 #define SCPI_CMD_OPC "*OPC?"
 
+/* Conservative input buffer size of instruments, for batched commands. */
+#define SCPI_BATCH_DEFAULT_LEN 256
+
 enum {
 	SCPI_CMD_GET_TIMEBASE = 1,
 	SCPI_CMD_SET_TIMEBASE,
@@ -105,6 +108,11 @@ struct sr_scpi_dev_inst {
 	int (*read_data)(void *priv, char *buf, int maxlen);
 	int (*write_data)(void *priv, char *buf, int len);
 	int (*read_complete)(void *priv);
+	/* Optional, for non-blocking reads. See scpi_async.c. */
+	int (*read_begin_async)(void *priv);
+	int (*read_ready)(void *priv);
+	/* Optional, aborts a read which is in progress in another thread. */
+	int (*abort)(void *priv);
 	int (*close)(struct sr_scpi_dev_inst *scpi);
 	void (*free)(void *priv);
 	unsigned int read_timeout_us;
@@ -114,6 +122,34 @@ struct sr_scpi_dev_inst {
 	GMutex scpi_mutex;
 	char *actual_channel_name;
 	gboolean no_opc_command;
+	/* Queue of asynchronous requests, NULL when not started. */
+	struct scpi_async *async;
+	/* Cached responses of queries, NULL when not enabled. */
+	GHashTable *cache;
+	char **cache_queries;
+	gint64 cache_max_age_us;
+};
+
+/**
+ * Completion callback of an asynchronous SCPI request.
+ *
+ * @param scpi The SCPI device the request was submitted to.
+ * @param status SR_OK upon success, SR_ERR* upon failure.
+ * @param response The response with trailing CR/LF removed, or NULL when
+ *        none was requested or upon failure. Owned by the SCPI layer, only
+ *        valid during the callback.
+ * @param cb_data The data passed on submission.
+ */
+typedef void (*sr_scpi_async_cb)(struct sr_scpi_dev_inst *scpi, int status,
+		GString *response, void *cb_data);
+
+/** Commands to be sent as few compound messages, see sr_scpi_batch_new(). */
+struct sr_scpi_batch {
+	struct sr_scpi_dev_inst *scpi;
+	GString *msg;
+	size_t max_len;
+	/* First failure, later commands are dropped. */
+	int ret;
 };
 
 SR_PRIV GSList *sr_scpi_scan(struct drv_context *drvc, GSList *options,
@@ -128,6 +164,15 @@ SR_PRIV int sr_scpi_source_add(struct sr_session *session,
 		sr_receive_data_callback cb, void *cb_data);
 SR_PRIV int sr_scpi_source_remove(struct sr_session *session,
 		struct sr_scpi_dev_inst *scpi);
+SR_PRIV void sr_scpi_cache_enable(struct sr_scpi_dev_inst *scpi,
+		const char *const *queries, unsigned int max_age_ms);
+SR_PRIV void sr_scpi_cache_invalidate(struct sr_scpi_dev_inst *scpi);
+SR_PRIV int sr_scpi_async_start(struct sr_session *session,
+		struct sr_scpi_dev_inst *scpi, int poll_ms);
+SR_PRIV void sr_scpi_async_stop(struct sr_scpi_dev_inst *scpi);
+SR_PRIV int sr_scpi_async_submit(struct sr_scpi_dev_inst *scpi,
+		const char *command, gboolean want_response,
+		sr_scpi_async_cb cb, void *cb_data);
 SR_PRIV int sr_scpi_send(struct sr_scpi_dev_inst *scpi,
 		const char *format, ...);
 SR_PRIV int sr_scpi_send_variadic(struct sr_scpi_dev_inst *scpi,
@@ -136,6 +181,7 @@ SR_PRIV int sr_scpi_read_begin(struct sr_scpi_dev_inst *scpi);
 SR_PRIV int sr_scpi_read_data(struct sr_scpi_dev_inst *scpi, char *buf, int maxlen);
 SR_PRIV int sr_scpi_write_data(struct sr_scpi_dev_inst *scpi, char *buf, int len);
 SR_PRIV int sr_scpi_read_complete(struct sr_scpi_dev_inst *scpi);
+SR_PRIV int sr_scpi_abort(struct sr_scpi_dev_inst *scpi);
 SR_PRIV int sr_scpi_close(struct sr_scpi_dev_inst *scpi);
 SR_PRIV void sr_scpi_free(struct sr_scpi_dev_inst *scpi);
 
@@ -160,6 +206,11 @@ SR_PRIV int sr_scpi_get_data(struct sr_scpi_dev_inst *scpi,
 			const char *command, GString **scpi_response);
 SR_PRIV int sr_scpi_get_block(struct sr_scpi_dev_inst *scpi,
 			const char *command, GByteArray **scpi_response);
+SR_PRIV int sr_scpi_get_block_into(struct sr_scpi_dev_inst *scpi,
+			const char *command, GByteArray *block);
+SR_PRIV int sr_scpi_get_block_pipelined(struct sr_scpi_dev_inst *scpi,
+			const char *command, GByteArray *block,
+			const char *next_command, gboolean *next_sent);
 SR_PRIV int sr_scpi_get_hw_id(struct sr_scpi_dev_inst *scpi,
 			struct sr_scpi_hw_info **scpi_response);
 SR_PRIV void sr_scpi_hw_info_free(struct sr_scpi_hw_info *hw_info);
@@ -178,6 +229,18 @@ SR_PRIV int sr_scpi_cmd_resp(const struct sr_dev_inst *sdi,
 		int channel_command, const char *channel_name,
 		GVariant **gvar, const GVariantType *gvtype, int command, ...);
 
+SR_PRIV struct sr_scpi_batch *sr_scpi_batch_new(struct sr_scpi_dev_inst *scpi,
+		size_t max_len);
+SR_PRIV int sr_scpi_batch_add(struct sr_scpi_batch *batch,
+		const char *format, ...);
+SR_PRIV int sr_scpi_batch_cmd(struct sr_scpi_batch *batch,
+		const struct scpi_command *cmdtable,
+		int channel_command, const char *channel_name,
+		int command, ...);
+SR_PRIV int sr_scpi_batch_flush(struct sr_scpi_batch *batch);
+SR_PRIV int sr_scpi_batch_finish(struct sr_scpi_batch *batch);
+SR_PRIV void sr_scpi_batch_free(struct sr_scpi_batch *batch);
+
 /*--- GPIB only functions ---------------------------------------------------*/
 
 #ifdef HAVE_LIBGPIB
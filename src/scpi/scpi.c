@@ -146,25 +146,34 @@ static int scpi_send_variadic(struct sr_scpi_dev_inst *scpi,
 			 const char *format, va_list args)
 {
 	va_list args_copy;
-	char *buf;
+	char sbuf[256], *buf;
 	int len, ret;
 
-	/* Get length of buffer required. */
+	/* Most commands fit the stack buffer, format them in one pass. */
 	va_copy(args_copy, args);
-	len = sr_vsnprintf_ascii(NULL, 0, format, args_copy);
+	len = sr_vsnprintf_ascii(sbuf, sizeof(sbuf) - 1, format, args_copy);
 	va_end(args_copy);
+	if (len < 0)
+		return SR_ERR;
 
-	/* Allocate buffer and write out command. */
-	buf = g_malloc0(len + 2);
-	sr_vsprintf_ascii(buf, format, args);
-	if (buf[len - 1] != '\n')
-		buf[len] = '\n';
+	if ((size_t)len < sizeof(sbuf) - 1) {
+		buf = sbuf;
+	} else {
+		buf = g_malloc(len + 2);
+		sr_vsprintf_ascii(buf, format, args);
+	}
+	if (!len || buf[len - 1] != '\n')
+		buf[len++] = '\n';
+	buf[len] = '\0';
 
 	/* Send command. */
+	SR_PROBE2(scpi_send_entry, buf, len);
 	ret = scpi->send(scpi->priv, buf);
+	SR_PROBE1(scpi_send_return, ret);
 
 	/* Free command buffer. */
-	g_free(buf);
+	if (buf != sbuf)
+		g_free(buf);
 
 	return ret;
 }
@@ -189,6 +198,107 @@ static int scpi_send(struct sr_scpi_dev_inst *scpi, const char *format, ...)
 	return ret;
 }
 
+/* Format a command like scpi_send_variadic() does, to a new string. */
+static char *scpi_vformat(const char *format, va_list args)
+{
+	va_list args_copy;
+	char sbuf[256], *buf;
+	int len;
+
+	va_copy(args_copy, args);
+	len = sr_vsnprintf_ascii(sbuf, sizeof(sbuf), format, args_copy);
+	va_end(args_copy);
+	if (len < 0)
+		return g_strdup("");
+	if ((size_t)len < sizeof(sbuf))
+		return g_strndup(sbuf, len);
+
+	buf = g_malloc0(len + 1);
+	sr_vsprintf_ascii(buf, format, args);
+
+	return buf;
+}
+
+/* A single query does not change the device's settings. */
+static gboolean scpi_is_query(const char *command)
+{
+	return command && strchr(command, '?') && !strchr(command, ';');
+}
+
+struct scpi_cache_entry {
+	char *response;
+	gint64 time;
+};
+
+static void scpi_cache_entry_free(void *data)
+{
+	struct scpi_cache_entry *entry;
+
+	entry = data;
+	g_free(entry->response);
+	g_free(entry);
+}
+
+/* Get an entry's response, unless the entry has expired. */
+static const char *scpi_cache_lookup(struct sr_scpi_dev_inst *scpi,
+		const char *key)
+{
+	struct scpi_cache_entry *entry;
+
+	if (!key || !(entry = g_hash_table_lookup(scpi->cache, key)))
+		return NULL;
+	if (scpi->cache_max_age_us &&
+			g_get_monotonic_time() - entry->time > scpi->cache_max_age_us) {
+		g_hash_table_remove(scpi->cache, key);
+		return NULL;
+	}
+
+	return entry->response;
+}
+
+/* Store a response, takes ownership of the key. */
+static void scpi_cache_store(struct sr_scpi_dev_inst *scpi,
+		char *key, const char *response)
+{
+	struct scpi_cache_entry *entry;
+
+	if (!scpi->cache) {
+		g_free(key);
+		return;
+	}
+	entry = g_malloc(sizeof(*entry));
+	entry->response = g_strdup(response);
+	entry->time = g_get_monotonic_time();
+	g_hash_table_replace(scpi->cache, key, entry);
+}
+
+static void scpi_cache_invalidate(struct sr_scpi_dev_inst *scpi)
+{
+	if (scpi->cache)
+		g_hash_table_remove_all(scpi->cache);
+}
+
+/*
+ * Get the cache key of a query, or NULL when its response must not be
+ * cached. Queries apply to the selected channel, which is part of the key.
+ */
+static char *scpi_cache_key(struct sr_scpi_dev_inst *scpi,
+		const char *channel, const char *command)
+{
+	char **query;
+
+	if (!scpi->cache || !scpi_is_query(command))
+		return NULL;
+	for (query = scpi->cache_queries; *query; query++) {
+		if (g_str_has_prefix(command, *query))
+			break;
+	}
+	if (!*query)
+		return NULL;
+
+	return g_strconcat(channel ? channel : "", "\n", command, NULL);
+}
+
 /**
  * Send data to SCPI device without mutex.
  *
@@ -288,6 +398,7 @@ static int scpi_get_data(struct sr_scpi_dev_inst *scpi,
 	timeout = g_get_monotonic_time() + scpi->read_timeout_us;
 
 	response = *scpi_response;
+	SR_PROBE(scpi_read_entry);
 
 	while (!sr_scpi_read_complete(scpi)) {
 		/* Resize the buffer when free space drops below a threshold. */
@@ -301,11 +412,14 @@ static int scpi_get_data(struct sr_scpi_dev_inst *scpi,
 		/* Read another chunk of the response. */
 		ret = scpi_read_response(scpi, response, timeout);
 
-		if (ret < 0)
+		if (ret < 0) {
+			SR_PROBE2(scpi_read_return, ret, response->len);
 			return ret;
+		}
 		if (ret > 0)
 			timeout = g_get_monotonic_time() + scpi->read_timeout_us;
 	}
+	SR_PROBE2(scpi_read_return, SR_OK, response->len);
 
 	return SR_OK;
 }
@@ -403,6 +517,7 @@ SR_PRIV struct sr_scpi_dev_inst *scpi_dev_inst_new(struct drv_context *drvc,
 SR_PRIV int sr_scpi_open(struct sr_scpi_dev_inst *scpi)
 {
 	g_mutex_init(&scpi->scpi_mutex);
+	scpi_cache_invalidate(scpi);
 
 	return scpi->open(scpi);
 }
@@ -460,6 +575,53 @@ SR_PRIV int sr_scpi_source_remove(struct sr_session *session,
 	return scpi->source_remove(session, scpi->priv);
 }
 
+/**
+ * Enable caching of query responses.
+ *
+ * Responses to the queries given are cached per command and selected
+ * channel, and subsequent queries are answered from the cache. Settings
+ * which only change upon commands from the host can be cached, but not
+ * measurements or status. All cached responses are dropped upon any
+ * command which is not a single query, and upon opening or closing the
+ * device.
+ *
+ * @param scpi Previously initialised SCPI device structure.
+ * @param queries NULL terminated list of query prefixes whose responses
+ *        may be cached. NULL disables the cache.
+ * @param max_age_ms Maximum age of cached responses, which bounds how
+ *        long changes from the front panel go unnoticed. 0 keeps them
+ *        until they are dropped.
+ */
+SR_PRIV void sr_scpi_cache_enable(struct sr_scpi_dev_inst *scpi,
+		const char *const *queries, unsigned int max_age_ms)
+{
+	if (scpi->cache) {
+		g_hash_table_destroy(scpi->cache);
+		scpi->cache = NULL;
+	}
+	g_strfreev(scpi->cache_queries);
+	scpi->cache_queries = NULL;
+
+	if (!queries || !queries[0])
+		return;
+	scpi->cache_queries = g_strdupv((char **)queries);
+	scpi->cache_max_age_us = (gint64)max_age_ms * 1000;
+	scpi->cache = g_hash_table_new_full(g_str_hash, g_str_equal,
+		g_free, scpi_cache_entry_free);
+}
+
+/**
+ * Drop all cached query responses, e.g. after changes from the front panel.
+ *
+ * @param scpi Previously initialised SCPI device structure.
+ */
+SR_PRIV void sr_scpi_cache_invalidate(struct sr_scpi_dev_inst *scpi)
+{
+	g_mutex_lock(&scpi->scpi_mutex);
+	scpi_cache_invalidate(scpi);
+	g_mutex_unlock(&scpi->scpi_mutex);
+}
+
 /**
  * Send a SCPI command.
  *
@@ -476,6 +638,8 @@ SR_PRIV int sr_scpi_send(struct sr_scpi_dev_inst *scpi,
 
 	va_start(args, format);
 	g_mutex_lock(&scpi->scpi_mutex);
+	if (!scpi_is_query(format))
+		scpi_cache_invalidate(scpi);
 	ret = scpi_send_variadic(scpi, format, args);
 	g_mutex_unlock(&scpi->scpi_mutex);
 	va_end(args);
@@ -498,6 +662,8 @@ SR_PRIV int sr_scpi_send_variadic(struct sr_scpi_dev_inst *scpi,
 	int ret;
 
 	g_mutex_lock(&scpi->scpi_mutex);
+	if (!scpi_is_query(format))
+		scpi_cache_invalidate(scpi);
 	ret = scpi_send_variadic(scpi, format, args);
 	g_mutex_unlock(&scpi->scpi_mutex);
 
@@ -555,6 +721,7 @@ SR_PRIV int sr_scpi_write_data(struct sr_scpi_dev_inst *scpi,
 	int ret;
 
 	g_mutex_lock(&scpi->scpi_mutex);
+	scpi_cache_invalidate(scpi);
 	ret = scpi_write_data(scpi, buf, maxlen);
 	g_mutex_unlock(&scpi->scpi_mutex);
 
@@ -573,6 +740,25 @@ SR_PRIV int sr_scpi_read_complete(struct sr_scpi_dev_inst *scpi)
 	return scpi->read_complete(scpi->priv);
 }
 
+/**
+ * Abort a read which is blocked in another thread.
+ *
+ * The connection remains usable, the aborted read returns an error.
+ * Doesn't take the SCPI lock, which is held by the blocked reader.
+ *
+ * @param scpi Previously initialised SCPI device structure.
+ *
+ * @return SR_OK on success, SR_ERR_NA if the transport can't abort reads,
+ *         SR_ERR on failure.
+ */
+SR_PRIV int sr_scpi_abort(struct sr_scpi_dev_inst *scpi)
+{
+	if (!scpi->abort)
+		return SR_ERR_NA;
+
+	return scpi->abort(scpi->priv);
+}
+
 /**
  * Close SCPI device.
  *
@@ -584,7 +770,10 @@ SR_PRIV int sr_scpi_close(struct sr_scpi_dev_inst *scpi)
 {
 	int ret;
 
+	sr_scpi_async_stop(scpi);
+
 	g_mutex_lock(&scpi->scpi_mutex);
+	scpi_cache_invalidate(scpi);
 	ret = scpi->close(scpi);
 	g_mutex_unlock(&scpi->scpi_mutex);
 	g_mutex_clear(&scpi->scpi_mutex);
@@ -606,6 +795,9 @@ SR_PRIV void sr_scpi_free(struct sr_scpi_dev_inst *scpi)
 	scpi->free(scpi->priv);
 	g_free(scpi->priv);
 	g_free(scpi->actual_channel_name);
+	if (scpi->cache)
+		g_hash_table_destroy(scpi->cache);
+	g_strfreev(scpi->cache_queries);
 	g_free(scpi);
 }
 
@@ -625,13 +817,28 @@ SR_PRIV int sr_scpi_get_string(struct sr_scpi_dev_inst *scpi,
 			       const char *command, char **scpi_response)
 {
 	GString *response;
+	char *key;
+	const char *cached;
 
 	*scpi_response = NULL;
 
+	g_mutex_lock(&scpi->scpi_mutex);
+	key = scpi_cache_key(scpi, scpi->actual_channel_name, command);
+	cached = scpi_cache_lookup(scpi, key);
+	if (cached)
+		*scpi_response = g_strdup(cached);
+	g_mutex_unlock(&scpi->scpi_mutex);
+	if (cached) {
+		sr_spew("Cached response: '%.70s'.", *scpi_response);
+		g_free(key);
+		return SR_OK;
+	}
+
 	response = g_string_sized_new(1024);
 	if (sr_scpi_get_data(scpi, command, &response) != SR_OK) {
 		if (response)
 			g_string_free(response, TRUE);
+		g_free(key);
 		return SR_ERR;
 	}
 
@@ -648,6 +855,12 @@ SR_PRIV int sr_scpi_get_string(struct sr_scpi_dev_inst *scpi,
 
 	*scpi_response = g_string_free(response, FALSE);
 
+	if (key) {
+		g_mutex_lock(&scpi->scpi_mutex);
+		scpi_cache_store(scpi, key, *scpi_response);
+		g_mutex_unlock(&scpi->scpi_mutex);
+	}
+
 	return SR_OK;
 }
 
@@ -861,8 +1074,7 @@ SR_PRIV int sr_scpi_get_floatv(struct sr_scpi_dev_inst *scpi,
 {
 	int ret;
 	float tmp;
-	char *response;
-	gchar **ptr, **tokens;
+	char *response, *token, *next;
 	size_t token_count;
 	GArray *response_array;
 
@@ -873,23 +1085,27 @@ SR_PRIV int sr_scpi_get_floatv(struct sr_scpi_dev_inst *scpi,
 	if (ret != SR_OK && !response)
 		return ret;
 
-	tokens = g_strsplit(response, ",", 0);
-	token_count = g_strv_length(tokens);
+	token_count = 1;
+	for (token = response; (token = strchr(token, ',')); token++)
+		token_count++;
 
 	response_array = g_array_sized_new(TRUE, FALSE,
 		sizeof(float), token_count + 1);
 
-	ptr = tokens;
-	while (*ptr) {
-		ret = sr_atof_ascii(*ptr, &tmp);
-		if (ret != SR_OK) {
+	/* Split the response in place, waveforms have many values. */
+	ret = SR_OK;
+	for (token = response; token; token = next) {
+		next = strchr(token, ',');
+		if (next)
+			*next++ = '\0';
+		else if (!*token && token == response)
+			break;
+		if (sr_atof_ascii(token, &tmp) != SR_OK) {
 			ret = SR_ERR_DATA;
 			break;
 		}
 		response_array = g_array_append_val(response_array, tmp);
-		ptr++;
 	}
-	g_strfreev(tokens);
 	g_free(response);
 
 	if (ret != SR_OK && response_array->len == 0) {
@@ -962,63 +1178,57 @@ SR_PRIV int sr_scpi_get_uint8v(struct sr_scpi_dev_inst *scpi,
 }
 
 /**
- * Send a SCPI command, read the reply, parse it as binary data with a
- * "definite length block" header and store the as an result in scpi_response.
+ * Read exactly the requested number of bytes, without mutex.
  *
- * Callers must free the allocated memory (unless it's NULL) regardless of
- * the routine's return code. See @ref g_byte_array_free().
- *
- * @param[in] scpi Previously initialised SCPI device structure.
- * @param[in] command The SCPI command to send to the device (can be NULL).
- * @param[out] scpi_response Pointer where to store the parsed result.
+ * @param scpi Previously initialised SCPI device structure.
+ * @param buf Buffer to store result.
+ * @param len Number of bytes to read.
+ * @param abs_timeout_us Absolute timeout in microseconds.
  *
- * @return SR_OK upon successfully parsing all values, SR_ERR* upon a parsing
- *         error or upon no response.
+ * @return SR_OK on success, SR_ERR* on failure.
  */
-SR_PRIV int sr_scpi_get_block(struct sr_scpi_dev_inst *scpi,
-			       const char *command, GByteArray **scpi_response)
+static int scpi_read_exact(struct sr_scpi_dev_inst *scpi,
+			char *buf, int len, gint64 abs_timeout_us)
 {
 	int ret;
-	GString* response;
-	gsize oldlen;
+
+	while (len > 0) {
+		ret = scpi_read_data(scpi, buf, len);
+		if (ret < 0) {
+			sr_err("Incompletely read SCPI response.");
+			return SR_ERR;
+		}
+		if (ret == 0 && g_get_monotonic_time() > abs_timeout_us) {
+			sr_err("Timed out waiting for SCPI response.");
+			return SR_ERR_TIMEOUT;
+		}
+		buf += ret;
+		len -= ret;
+	}
+
+	return SR_OK;
+}
+
+static int scpi_read_block(struct sr_scpi_dev_inst *scpi,
+			const char *command, GByteArray *block)
+{
+	int ret, len;
 	char buf[10];
 	long llen;
 	long datalen;
+	long pos;
 	gint64 timeout;
 
-	*scpi_response = NULL;
-
-	g_mutex_lock(&scpi->scpi_mutex);
-
-	if (command)
-		if (scpi_send(scpi, command) != SR_OK) {
-			g_mutex_unlock(&scpi->scpi_mutex);
-			return SR_ERR;
-		}
+	g_byte_array_set_size(block, 0);
 
-	if (sr_scpi_read_begin(scpi) != SR_OK) {
-		g_mutex_unlock(&scpi->scpi_mutex);
+	if (command && scpi_send(scpi, command) != SR_OK)
 		return SR_ERR;
-	}
 
-	/*
-	 * Assume an initial maximum length, optionally gets adjusted below.
-	 * Prepare a NULL return value for when error paths will be taken.
-	 */
-	response = g_string_sized_new(1024);
+	if (sr_scpi_read_begin(scpi) != SR_OK)
+		return SR_ERR;
 
 	timeout = g_get_monotonic_time() + scpi->read_timeout_us;
 
-	/* Get (the first chunk of) the response. */
-	do {
-		ret = scpi_read_response(scpi, response, timeout);
-		if (ret < 0) {
-			g_mutex_unlock(&scpi->scpi_mutex);
-			g_string_free(response, TRUE);
-			return ret;
-		}
-	} while (response->len < 2);
-
 	/*
 	 * SCPI protocol data blocks are preceeded with a length spec.
 	 * The length spec consists of a '#' marker, one digit which
@@ -1027,79 +1237,178 @@ SR_PRIV int sr_scpi_get_block(struct sr_scpi_dev_inst *scpi,
 	 * length. Raw data bytes follow (thus one must no longer assume
 	 * that the received input stream would be an ASCIIZ string).
 	 *
-	 * Get the data block length, and strip off the length spec from
-	 * the input buffer, leaving just the data bytes.
+	 * Read exactly the length spec, so the data bytes can be read
+	 * straight to their final location.
 	 */
-	if (response->str[0] != '#') {
-		g_mutex_unlock(&scpi->scpi_mutex);
-		g_string_free(response, TRUE);
+	ret = scpi_read_exact(scpi, buf, 2, timeout);
+	if (ret != SR_OK)
+		return ret;
+	if (buf[0] != '#')
 		return SR_ERR_DATA;
-	}
-	buf[0] = response->str[1];
+	buf[0] = buf[1];
 	buf[1] = '\0';
 	ret = sr_atol(buf, &llen);
-	if ((ret != SR_OK) || (llen == 0)) {
-		g_mutex_unlock(&scpi->scpi_mutex);
-		g_string_free(response, TRUE);
+	if (ret != SR_OK)
 		return ret;
+	if (llen == 0) {
+		sr_err("Indefinite length SCPI blocks are not supported.");
+		return SR_ERR_DATA;
 	}
 
-	while (response->len < (unsigned long)(2 + llen)) {
-		ret = scpi_read_response(scpi, response, timeout);
-		if (ret < 0) {
-			g_mutex_unlock(&scpi->scpi_mutex);
-			g_string_free(response, TRUE);
-			return ret;
-		}
-	}
-
-	memcpy(buf, &response->str[2], llen);
+	ret = scpi_read_exact(scpi, buf, llen, timeout);
+	if (ret != SR_OK)
+		return ret;
 	buf[llen] = '\0';
 	ret = sr_atol(buf, &datalen);
-	if ((ret != SR_OK) || (datalen == 0)) {
-		g_mutex_unlock(&scpi->scpi_mutex);
-		g_string_free(response, TRUE);
-		return ret;
-	}
-	g_string_erase(response, 0, 2 + llen);
+	if (ret != SR_OK || datalen < 0)
+		return SR_ERR_DATA;
 
-	/*
-	 * Re-allocate the buffer size to the now known length
-	 * and keep reading more chunks of response data.
-	 */
-	oldlen = response->len;
-	g_string_set_size(response, datalen);
-	g_string_set_size(response, oldlen);
-
-	if (oldlen < (unsigned long)(datalen)) {
-		do {
-			oldlen = response->len;
-			ret = scpi_read_response(scpi, response, timeout);
-
-			/* On timeout truncate the buffer and send the partial response
-			 * instead of getting stuck on timeouts...
-			 */
-			if (ret == SR_ERR_TIMEOUT) {
-				datalen = oldlen;
-				break;
-			}
-			if (ret < 0) {
-				g_mutex_unlock(&scpi->scpi_mutex);
-				g_string_free(response, TRUE);
-				return ret;
-			}
-			if (ret > 0)
-				timeout = g_get_monotonic_time() + scpi->read_timeout_us;
-		} while (response->len < (unsigned long)(datalen));
+	/* Allocate the data block once, and read in chunks as large as possible. */
+	g_byte_array_set_size(block, datalen);
+	pos = 0;
+	while (pos < datalen) {
+		len = scpi_read_data(scpi, (char *)block->data + pos,
+			MIN(datalen - pos, G_MAXINT));
+		if (len < 0) {
+			sr_err("Incompletely read SCPI response.");
+			return SR_ERR;
+		}
+		if (len > 0) {
+			pos += len;
+			timeout = g_get_monotonic_time() + scpi->read_timeout_us;
+			continue;
+		}
+		/* On timeout truncate the buffer and return the partial
+		 * response instead of getting stuck on timeouts...
+		 */
+		if (g_get_monotonic_time() > timeout) {
+			sr_err("Timed out waiting for SCPI response.");
+			break;
+		}
 	}
+	g_byte_array_set_size(block, pos);
+
+	return SR_OK;
+}
+
+/**
+ * Read a "definite length block" into a caller provided array, without
+ * mutex. See @ref sr_scpi_get_block_into().
+ */
+static int scpi_get_block(struct sr_scpi_dev_inst *scpi,
+			const char *command, GByteArray *block)
+{
+	int ret;
+
+	SR_PROBE1(scpi_block_entry, command);
+	ret = scpi_read_block(scpi, command, block);
+	SR_PROBE2(scpi_block_return, ret, block->len);
 
+	return ret;
+}
+
+/**
+ * Send a SCPI command, read the reply, parse it as binary data with a
+ * "definite length block" header and store the data bytes in a caller
+ * provided byte array.
+ *
+ * The array's previous content gets replaced. Its allocation is kept,
+ * so an array which is reused for subsequent blocks of similar size
+ * avoids allocations. The data bytes are read directly into the array,
+ * without intermediate copies.
+ *
+ * @param[in] scpi Previously initialised SCPI device structure.
+ * @param[in] command The SCPI command to send to the device (can be NULL).
+ * @param[in,out] block The array which receives the data bytes.
+ *
+ * @return SR_OK upon successfully reading the block, SR_ERR* upon a parsing
+ *         error or upon no response. Upon timeout while reading the data
+ *         bytes SR_OK is returned, and the array holds the partial block.
+ */
+SR_PRIV int sr_scpi_get_block_into(struct sr_scpi_dev_inst *scpi,
+			const char *command, GByteArray *block)
+{
+	int ret;
+
+	if (!block)
+		return SR_ERR_ARG;
+
+	g_mutex_lock(&scpi->scpi_mutex);
+	ret = scpi_get_block(scpi, command, block);
 	g_mutex_unlock(&scpi->scpi_mutex);
 
-	/* Convert received data to byte array. */
-	*scpi_response = g_byte_array_new_take(
-		(guint8*)g_string_free(response, FALSE), datalen);
+	return ret;
+}
 
-	return SR_OK;
+/**
+ * Read a "definite length block" like @ref sr_scpi_get_block_into(), and
+ * send the next command right after the block was received.
+ *
+ * This allows pipelining: the device prepares the response to the next
+ * command (e.g. the next channel's waveform), while the caller processes
+ * the block. No other command can get in between the two.
+ *
+ * @param[in] scpi Previously initialised SCPI device structure.
+ * @param[in] command The SCPI command to send to the device (can be NULL).
+ * @param[in,out] block The array which receives the data bytes.
+ * @param[in] next_command The SCPI command to send after the block was
+ *            received (can be NULL). It is not sent when reading failed.
+ * @param[out] next_sent Whether the next command was sent (can be NULL).
+ *
+ * @return SR_OK upon successfully reading the block, SR_ERR* upon a parsing
+ *         error or upon no response. A failure to send the next command
+ *         is only reported via next_sent.
+ */
+SR_PRIV int sr_scpi_get_block_pipelined(struct sr_scpi_dev_inst *scpi,
+			const char *command, GByteArray *block,
+			const char *next_command, gboolean *next_sent)
+{
+	int ret;
+	gboolean sent;
+
+	if (!block)
+		return SR_ERR_ARG;
+
+	sent = FALSE;
+	g_mutex_lock(&scpi->scpi_mutex);
+	ret = scpi_get_block(scpi, command, block);
+	if (ret == SR_OK && next_command)
+		sent = scpi_send(scpi, "%s", next_command) == SR_OK;
+	g_mutex_unlock(&scpi->scpi_mutex);
+
+	if (next_sent)
+		*next_sent = sent;
+
+	return ret;
+}
+
+/**
+ * Send a SCPI command, read the reply, parse it as binary data with a
+ * "definite length block" header and store the as an result in scpi_response.
+ *
+ * Callers must free the allocated memory (unless it's NULL) regardless of
+ * the routine's return code. See @ref g_byte_array_free().
+ *
+ * @param[in] scpi Previously initialised SCPI device structure.
+ * @param[in] command The SCPI command to send to the device (can be NULL).
+ * @param[out] scpi_response Pointer where to store the parsed result.
+ *
+ * @return SR_OK upon successfully parsing all values, SR_ERR* upon a parsing
+ *         error or upon no response.
+ */
+SR_PRIV int sr_scpi_get_block(struct sr_scpi_dev_inst *scpi,
+			       const char *command, GByteArray **scpi_response)
+{
+	int ret;
+
+	*scpi_response = g_byte_array_new();
+	ret = sr_scpi_get_block_into(scpi, command, *scpi_response);
+	if (ret != SR_OK) {
+		g_byte_array_free(*scpi_response, TRUE);
+		*scpi_response = NULL;
+	}
+
+	return ret;
 }
 
 /**
@@ -1290,6 +1599,7 @@ SR_PRIV int sr_scpi_cmd(const struct sr_dev_inst *sdi,
 	}
 
 	g_mutex_lock(&scpi->scpi_mutex);
+	scpi_cache_invalidate(scpi);
 
 	/* Select channel. */
 	channel_cmd = sr_scpi_cmd_get(cmdtable, channel_command);
@@ -1312,32 +1622,18 @@ SR_PRIV int sr_scpi_cmd(const struct sr_dev_inst *sdi,
 	return ret;
 }
 
-SR_PRIV int sr_scpi_cmd_resp(const struct sr_dev_inst *sdi,
-		const struct scpi_command *cmdtable,
-		int channel_command, const char *channel_name,
-		GVariant **gvar, const GVariantType *gvtype, int command, ...)
+/*
+ * Select the channel if needed, send the query and read the response,
+ * without mutex.
+ */
+static int scpi_cmd_query(struct sr_scpi_dev_inst *scpi,
+		const char *channel_cmd, const char *channel_name,
+		const char *query, char **scpi_response)
 {
-	struct sr_scpi_dev_inst *scpi;
-	va_list args;
-	const char *channel_cmd;
-	const char *cmd;
 	GString *response;
-	char *s;
-	gboolean b;
-	double d;
 	int ret;
 
-	scpi = sdi->conn;
-
-	if (!(cmd = sr_scpi_cmd_get(cmdtable, command))) {
-		/* Device does not implement this command. */
-		return SR_ERR_NA;
-	}
-
-	g_mutex_lock(&scpi->scpi_mutex);
-
 	/* Select channel. */
-	channel_cmd = sr_scpi_cmd_get(cmdtable, channel_command);
 	if (channel_cmd && channel_name &&
 			g_strcmp0(channel_name, scpi->actual_channel_name)) {
 		sr_spew("sr_scpi_cmd_get(): new channel = %s", channel_name);
@@ -1348,25 +1644,18 @@ SR_PRIV int sr_scpi_cmd_resp(const struct sr_dev_inst *sdi,
 			return ret;
 	}
 
-	va_start(args, command);
-	ret = scpi_send_variadic(scpi, cmd, args);
-	va_end(args);
-	if (ret != SR_OK) {
-		g_mutex_unlock(&scpi->scpi_mutex);
+	ret = scpi_send(scpi, "%s", query);
+	if (ret != SR_OK)
 		return ret;
-	}
 
 	response = g_string_sized_new(1024);
 	ret = scpi_get_data(scpi, NULL, &response);
 	if (ret != SR_OK) {
-		g_mutex_unlock(&scpi->scpi_mutex);
 		if (response)
 			g_string_free(response, TRUE);
 		return ret;
 	}
 
-	g_mutex_unlock(&scpi->scpi_mutex);
-
 	/* Get rid of trailing linefeed if present */
 	if (response->len >= 1 && response->str[response->len - 1] == '\n')
 		g_string_truncate(response, response->len - 1);
@@ -1375,7 +1664,61 @@ SR_PRIV int sr_scpi_cmd_resp(const struct sr_dev_inst *sdi,
 	if (response->len >= 1 && response->str[response->len - 1] == '\r')
 		g_string_truncate(response, response->len - 1);
 
-	s = g_string_free(response, FALSE);
+	*scpi_response = g_string_free(response, FALSE);
+
+	return SR_OK;
+}
+
+SR_PRIV int sr_scpi_cmd_resp(const struct sr_dev_inst *sdi,
+		const struct scpi_command *cmdtable,
+		int channel_command, const char *channel_name,
+		GVariant **gvar, const GVariantType *gvtype, int command, ...)
+{
+	struct sr_scpi_dev_inst *scpi;
+	va_list args;
+	const char *channel_cmd;
+	const char *cmd;
+	const char *cached;
+	char *s, *query, *key;
+	gboolean b;
+	double d;
+	int ret;
+
+	scpi = sdi->conn;
+
+	if (!(cmd = sr_scpi_cmd_get(cmdtable, command))) {
+		/* Device does not implement this command. */
+		return SR_ERR_NA;
+	}
+
+	va_start(args, command);
+	query = scpi_vformat(cmd, args);
+	va_end(args);
+
+	g_mutex_lock(&scpi->scpi_mutex);
+
+	/* Use a cached response to the query for the channel, if any. */
+	channel_cmd = sr_scpi_cmd_get(cmdtable, channel_command);
+	key = scpi_cache_key(scpi, (channel_cmd && channel_name) ?
+		channel_name : scpi->actual_channel_name, query);
+	cached = scpi_cache_lookup(scpi, key);
+	if (cached) {
+		s = g_strdup(cached);
+		g_free(key);
+	} else {
+		ret = scpi_cmd_query(scpi, channel_cmd, channel_name, query, &s);
+		if (ret != SR_OK) {
+			g_mutex_unlock(&scpi->scpi_mutex);
+			g_free(query);
+			g_free(key);
+			return ret;
+		}
+		if (key)
+			scpi_cache_store(scpi, key, s);
+	}
+
+	g_mutex_unlock(&scpi->scpi_mutex);
+	g_free(query);
 
 	ret = SR_OK;
 	if (g_variant_type_equal(gvtype, G_VARIANT_TYPE_BOOLEAN)) {
@@ -1395,3 +1738,211 @@ SR_PRIV int sr_scpi_cmd_resp(const struct sr_dev_inst *sdi,
 
 	return ret;
 }
+
+/**
+ * Start a batch of SCPI commands.
+ *
+ * Commands which are added to the batch are joined into few compound
+ * messages, which saves a round trip per command. Queries can't be part
+ * of a batch. See @ref sr_scpi_batch_finish().
+ *
+ * @param scpi Previously initialised SCPI device structure.
+ * @param max_len Maximum length of a message the device accepts,
+ *        0 for a conservative default.
+ *
+ * @return The new batch.
+ */
+SR_PRIV struct sr_scpi_batch *sr_scpi_batch_new(struct sr_scpi_dev_inst *scpi,
+		size_t max_len)
+{
+	struct sr_scpi_batch *batch;
+
+	batch = g_malloc0(sizeof(*batch));
+	batch->scpi = scpi;
+	batch->max_len = max_len ? max_len : SCPI_BATCH_DEFAULT_LEN;
+	batch->msg = g_string_sized_new(batch->max_len);
+	batch->ret = SR_OK;
+
+	return batch;
+}
+
+static int scpi_batch_send(struct sr_scpi_batch *batch)
+{
+	if (batch->ret != SR_OK || !batch->msg->len)
+		return batch->ret;
+
+	batch->ret = sr_scpi_send(batch->scpi, "%s", batch->msg->str);
+	g_string_truncate(batch->msg, 0);
+
+	return batch->ret;
+}
+
+static int scpi_batch_append(struct sr_scpi_batch *batch, char *cmd)
+{
+	g_strchomp(cmd);
+	if (strchr(cmd, '?')) {
+		sr_err("Cannot batch query '%s'.", cmd);
+		batch->ret = SR_ERR_ARG;
+	}
+	if (batch->ret != SR_OK)
+		return batch->ret;
+
+	/* Make room for the separator and the absolute header marker. */
+	if (batch->msg->len && batch->msg->len + strlen(cmd) + 2 > batch->max_len)
+		scpi_batch_send(batch);
+
+	if (batch->msg->len)
+		g_string_append_c(batch->msg, ';');
+	/*
+	 * Headers in compound messages are relative to the path of the
+	 * previous command. Make them absolute, so that commands don't
+	 * depend on their neighbours in the batch.
+	 */
+	if (cmd[0] != ':' && cmd[0] != '*')
+		g_string_append_c(batch->msg, ':');
+	g_string_append(batch->msg, cmd);
+
+	return batch->ret;
+}
+
+/**
+ * Add a command to a batch.
+ *
+ * @param batch The batch.
+ * @param format Format string, to be followed by any necessary arguments.
+ *
+ * @return SR_OK on success, SR_ERR* if this or a previous command of the
+ *         batch failed.
+ */
+SR_PRIV int sr_scpi_batch_add(struct sr_scpi_batch *batch,
+		const char *format, ...)
+{
+	va_list args;
+	char *cmd;
+	int ret;
+
+	va_start(args, format);
+	cmd = scpi_vformat(format, args);
+	va_end(args);
+
+	ret = scpi_batch_append(batch, cmd);
+	g_free(cmd);
+
+	return ret;
+}
+
+/**
+ * Add a command of a command table to a batch, like @ref sr_scpi_cmd()
+ * sends it. A channel select command gets added when needed.
+ *
+ * @return SR_OK on success, or when the device does not implement the
+ *         command. SR_ERR* if this or a previous command of the batch
+ *         failed.
+ */
+SR_PRIV int sr_scpi_batch_cmd(struct sr_scpi_batch *batch,
+		const struct scpi_command *cmdtable,
+		int channel_command, const char *channel_name,
+		int command, ...)
+{
+	struct sr_scpi_dev_inst *scpi;
+	va_list args;
+	const char *channel_cmd;
+	const char *cmd;
+	char *s;
+	int ret;
+
+	scpi = batch->scpi;
+
+	if (!(cmd = sr_scpi_cmd_get(cmdtable, command))) {
+		/* Device does not implement this command, that's OK. */
+		return batch->ret;
+	}
+
+	/* Select channel. */
+	channel_cmd = sr_scpi_cmd_get(cmdtable, channel_command);
+	if (channel_cmd && channel_name &&
+			g_strcmp0(channel_name, scpi->actual_channel_name)) {
+		g_free(scpi->actual_channel_name);
+		scpi->actual_channel_name = g_strdup(channel_name);
+		ret = sr_scpi_batch_add(batch, channel_cmd, channel_name);
+		if (ret != SR_OK)
+			return ret;
+	}
+
+	va_start(args, command);
+	s = scpi_vformat(cmd, args);
+	va_end(args);
+
+	ret = scpi_batch_append(batch, s);
+	g_free(s);
+
+	return ret;
+}
+
+/**
+ * Send the pending commands of a batch.
+ *
+ * @param batch The batch.
+ *
+ * @return SR_OK on success, SR_ERR* if a command of the batch failed.
+ */
+SR_PRIV int sr_scpi_batch_flush(struct sr_scpi_batch *batch)
+{
+	return scpi_batch_send(batch);
+}
+
+/**
+ * Send the pending commands of a batch, wait for their completion, and
+ * free the batch.
+ *
+ * An "*OPC?" query is appended to the last message, unless the device
+ * doesn't support it. Its response signals when all commands of the
+ * batch have been executed.
+ *
+ * @param batch The batch.
+ *
+ * @return SR_OK on success, SR_ERR* if a command of the batch failed.
+ */
+SR_PRIV int sr_scpi_batch_finish(struct sr_scpi_batch *batch)
+{
+	struct sr_scpi_dev_inst *scpi;
+	gboolean opc;
+	int ret;
+
+	scpi = batch->scpi;
+
+	if (batch->ret == SR_OK && !scpi->no_opc_command) {
+		if (batch->msg->len + strlen(SCPI_CMD_OPC) + 1 > batch->max_len)
+			scpi_batch_send(batch);
+		if (batch->msg->len)
+			g_string_append_c(batch->msg, ';');
+		g_string_append(batch->msg, SCPI_CMD_OPC);
+		if (scpi_batch_send(batch) == SR_OK) {
+			opc = FALSE;
+			batch->ret = sr_scpi_get_bool(scpi, NULL, &opc);
+			if (batch->ret == SR_OK && !opc)
+				batch->ret = SR_ERR;
+		}
+	} else {
+		scpi_batch_send(batch);
+	}
+
+	ret = batch->ret;
+	sr_scpi_batch_free(batch);
+
+	return ret;
+}
+
+/**
+ * Free a batch, without sending its pending commands.
+ *
+ * @param batch The batch, can be NULL.
+ */
+SR_PRIV void sr_scpi_batch_free(struct sr_scpi_batch *batch)
+{
+	if (!batch)
+		return;
+
+	g_string_free(batch->msg, TRUE);
+	g_free(batch);
+}
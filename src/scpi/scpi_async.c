@@ -0,0 +1,334 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Asynchronous SCPI requests.
+ *
+ * Requests are queued, and are processed one after another from an event
+ * source of the SCPI device. Their completion is signalled by a callback,
+ * so a slow instrument does not block the session's main loop.
+ *
+ * Reads don't block when the transport implements read_ready(), which
+ * tells whether read_data() would return without waiting. Transports
+ * which don't implement it read one chunk per input event.
+ *
+ * The synchronous API must not be used on a device while asynchronous
+ * requests are in flight.
+ */
+
+#include <config.h>
+#include <glib.h>
+#include <string.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+#include "scpi.h"
+
+#define LOG_PREFIX "scpi"
+
+struct scpi_async_request {
+	char *command;
+	gboolean want_response;
+	sr_scpi_async_cb cb;
+	void *cb_data;
+};
+
+struct scpi_async {
+	struct sr_session *session;
+	GQueue requests;
+	struct scpi_async_request *current;
+	GString *response;
+	gint64 timeout;
+	/* Nesting depth of callbacks, and stop requested from within one. */
+	int busy;
+	gboolean stopped;
+};
+
+static void request_free(struct scpi_async_request *req)
+{
+	g_free(req->command);
+	g_free(req);
+}
+
+static void async_free(struct sr_scpi_dev_inst *scpi)
+{
+	struct scpi_async *async;
+	struct scpi_async_request *req;
+
+	async = scpi->async;
+	scpi->async = NULL;
+
+	if (async->current)
+		request_free(async->current);
+	while ((req = g_queue_pop_head(&async->requests)))
+		request_free(req);
+	g_string_free(async->response, TRUE);
+	g_free(async);
+}
+
+static void async_complete(struct sr_scpi_dev_inst *scpi, int status)
+{
+	struct scpi_async *async;
+	struct scpi_async_request *req;
+	GString *response;
+
+	async = scpi->async;
+	req = async->current;
+	async->current = NULL;
+
+	response = NULL;
+	if (status == SR_OK && req->want_response) {
+		response = async->response;
+		/* Get rid of trailing linefeed and carriage return if present */
+		if (response->len >= 1 && response->str[response->len - 1] == '\n')
+			g_string_truncate(response, response->len - 1);
+		if (response->len >= 1 && response->str[response->len - 1] == '\r')
+			g_string_truncate(response, response->len - 1);
+		sr_spew("Got response: '%.70s', length %" G_GSIZE_FORMAT ".",
+			response->str, response->len);
+	}
+
+	if (req->cb)
+		req->cb(scpi, status, response, req->cb_data);
+	request_free(req);
+}
+
+/* Send queued commands until one awaits a response. */
+static void async_issue(struct sr_scpi_dev_inst *scpi)
+{
+	struct scpi_async *async;
+	struct scpi_async_request *req;
+	int ret;
+
+	async = scpi->async;
+	while (!async->stopped && !async->current &&
+			(req = g_queue_pop_head(&async->requests))) {
+		async->current = req;
+
+		if (!req->want_response)
+			sr_scpi_cache_invalidate(scpi);
+		g_mutex_lock(&scpi->scpi_mutex);
+		ret = scpi->send(scpi->priv, req->command);
+		if (ret == SR_OK && req->want_response) {
+			g_string_truncate(async->response, 0);
+			if (scpi->read_begin_async)
+				ret = scpi->read_begin_async(scpi->priv);
+			else
+				ret = scpi->read_begin(scpi->priv);
+		}
+		g_mutex_unlock(&scpi->scpi_mutex);
+
+		async->timeout = g_get_monotonic_time() + scpi->read_timeout_us;
+		if (ret != SR_OK || !req->want_response)
+			async_complete(scpi, ret);
+	}
+}
+
+/*
+ * Read what is available of the current response, without blocking.
+ * Returns TRUE when the response is complete, FALSE when more data is
+ * pending, or SR_ERR* upon failure.
+ */
+static int async_read(struct sr_scpi_dev_inst *scpi, int revents)
+{
+	struct scpi_async *async;
+	GString *response;
+	gboolean did_read;
+	int ret, len, space, oldlen;
+
+	async = scpi->async;
+	response = async->response;
+	did_read = FALSE;
+
+	g_mutex_lock(&scpi->scpi_mutex);
+	for (;;) {
+		if (scpi->read_complete(scpi->priv)) {
+			ret = TRUE;
+			break;
+		}
+		if (scpi->read_ready)
+			ret = scpi->read_ready(scpi->priv);
+		else
+			ret = (revents & G_IO_IN) && !did_read;
+		if (ret <= 0)
+			break;
+
+		/* Resize the buffer when free space drops below a threshold. */
+		space = response->allocated_len - response->len;
+		if (space < 128) {
+			oldlen = response->len;
+			g_string_set_size(response, oldlen + 1024);
+			g_string_set_size(response, oldlen);
+			space = response->allocated_len - response->len;
+		}
+
+		len = scpi->read_data(scpi->priv, &response->str[response->len],
+			space);
+		if (len < 0) {
+			sr_err("Incompletely read SCPI response.");
+			ret = SR_ERR;
+			break;
+		}
+		if (len == 0) {
+			ret = FALSE;
+			break;
+		}
+		g_string_set_size(response, response->len + len);
+		async->timeout = g_get_monotonic_time() + scpi->read_timeout_us;
+		did_read = TRUE;
+	}
+	g_mutex_unlock(&scpi->scpi_mutex);
+
+	return ret;
+}
+
+static int async_receive(int fd, int revents, void *cb_data)
+{
+	struct sr_scpi_dev_inst *scpi;
+	struct scpi_async *async;
+	int ret;
+
+	(void)fd;
+
+	scpi = cb_data;
+	if (!(async = scpi->async))
+		return FALSE;
+
+	async->busy++;
+	if (async->current) {
+		ret = async_read(scpi, revents);
+		if (ret == FALSE && g_get_monotonic_time() > async->timeout) {
+			sr_err("Timed out waiting for SCPI response.");
+			ret = SR_ERR_TIMEOUT;
+		}
+		if (ret == TRUE)
+			async_complete(scpi, SR_OK);
+		else if (ret < 0)
+			async_complete(scpi, ret);
+	}
+	async_issue(scpi);
+	async->busy--;
+
+	if (async->stopped && !async->busy) {
+		async_free(scpi);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/**
+ * Start processing asynchronous requests of an SCPI device.
+ *
+ * @param session The session whose main loop processes the requests.
+ * @param scpi Previously initialised SCPI device structure.
+ * @param poll_ms Interval in ms to check for responses and timeouts,
+ *        in the absence of input events.
+ *
+ * @return SR_OK upon success, SR_ERR* upon failure.
+ */
+SR_PRIV int sr_scpi_async_start(struct sr_session *session,
+		struct sr_scpi_dev_inst *scpi, int poll_ms)
+{
+	struct scpi_async *async;
+	int ret;
+
+	if (!session || !scpi)
+		return SR_ERR_ARG;
+	if (scpi->async)
+		return SR_ERR_BUG;
+
+	async = g_malloc0(sizeof(*async));
+	async->session = session;
+	g_queue_init(&async->requests);
+	async->response = g_string_sized_new(1024);
+	scpi->async = async;
+
+	ret = sr_scpi_source_add(session, scpi, G_IO_IN, poll_ms,
+		async_receive, scpi);
+	if (ret != SR_OK)
+		async_free(scpi);
+
+	return ret;
+}
+
+/**
+ * Stop processing asynchronous requests of an SCPI device.
+ *
+ * Pending requests are dropped without invoking their callbacks. This
+ * can be called from within a request's callback.
+ *
+ * @param scpi Previously initialised SCPI device structure.
+ */
+SR_PRIV void sr_scpi_async_stop(struct sr_scpi_dev_inst *scpi)
+{
+	struct scpi_async *async;
+
+	if (!scpi || !(async = scpi->async) || async->stopped)
+		return;
+
+	async->stopped = TRUE;
+	sr_scpi_source_remove(async->session, scpi);
+	if (!async->busy)
+		async_free(scpi);
+}
+
+/**
+ * Queue a SCPI command, and optionally read its response.
+ *
+ * The command is sent as soon as the previous requests have completed.
+ * The callback is invoked upon completion, possibly from within this
+ * call. Requests may be submitted from within callbacks.
+ *
+ * @param scpi Previously initialised SCPI device structure, see
+ *        @ref sr_scpi_async_start().
+ * @param command The SCPI command to send to the device.
+ * @param want_response Whether a response is to be read.
+ * @param cb The completion callback (can be NULL).
+ * @param cb_data Data passed to the callback.
+ *
+ * @return SR_OK upon success, SR_ERR* upon failure.
+ */
+SR_PRIV int sr_scpi_async_submit(struct sr_scpi_dev_inst *scpi,
+		const char *command, gboolean want_response,
+		sr_scpi_async_cb cb, void *cb_data)
+{
+	struct scpi_async *async;
+	struct scpi_async_request *req;
+
+	if (!scpi || !command)
+		return SR_ERR_ARG;
+	if (!(async = scpi->async) || async->stopped)
+		return SR_ERR_BUG;
+
+	req = g_malloc0(sizeof(*req));
+	req->command = g_strdup(command);
+	req->want_response = want_response;
+	req->cb = cb;
+	req->cb_data = cb_data;
+	g_queue_push_tail(&async->requests, req);
+
+	/* Only start sending when not within a callback of this device. */
+	if (!async->busy) {
+		async->busy++;
+		async_issue(scpi);
+		async->busy--;
+		if (async->stopped && !async->busy)
+			async_free(scpi);
+	}
+
+	return SR_OK;
+}
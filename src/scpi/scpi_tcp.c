@@ -27,8 +27,10 @@
 #include <string.h>
 #include <unistd.h>
 #ifndef _WIN32
+#include <sys/select.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <arpa/inet.h>
 #include <netdb.h>
 #endif
@@ -41,9 +43,21 @@
 
 #define LENGTH_BYTES 4
 
+/*
+ * Socket defaults for request/response instruments: don't let Nagle's
+ * algorithm hold back short commands, and allow bulk transfers to fill
+ * the link. Can be overridden by "key=value" parameters after the port.
+ */
+#define DEFAULT_NODELAY   TRUE
+#define DEFAULT_KEEPALIVE TRUE
+#define DEFAULT_RCVBUF    (1024 * 1024)
+
 struct scpi_tcp {
 	char *address;
 	char *port;
+	gboolean nodelay;
+	gboolean keepalive;
+	int rcvbuf;
 	int socket;
 	char length_buf[LENGTH_BYTES];
 	int length_bytes_read;
@@ -55,6 +69,8 @@ static int scpi_tcp_dev_inst_new(void *priv, struct drv_context *drvc,
 		const char *resource, char **params, const char *serialcomm)
 {
 	struct scpi_tcp *tcp = priv;
+	char **param, *value, *end;
+	long num;
 
 	(void)drvc;
 	(void)resource;
@@ -65,6 +81,34 @@ static int scpi_tcp_dev_inst_new(void *priv, struct drv_context *drvc,
 		return SR_ERR;
 	}
 
+	tcp->nodelay = DEFAULT_NODELAY;
+	tcp->keepalive = DEFAULT_KEEPALIVE;
+	tcp->rcvbuf = DEFAULT_RCVBUF;
+
+	/* Optional "nodelay=<0|1>", "keepalive=<0|1>", "rcvbuf=<bytes>". */
+	for (param = &params[3]; *param; param++) {
+		if (!(value = strchr(*param, '='))) {
+			sr_err("Invalid parameter '%s'.", *param);
+			return SR_ERR;
+		}
+		num = strtol(value + 1, &end, 10);
+		if (end == value + 1 || *end || num < 0 || num > G_MAXINT) {
+			sr_err("Invalid value of parameter '%s'.", *param);
+			return SR_ERR;
+		}
+		if (g_str_has_prefix(*param, "nodelay=")) {
+			tcp->nodelay = num != 0;
+		} else if (g_str_has_prefix(*param, "keepalive=")) {
+			tcp->keepalive = num != 0;
+		} else if (g_str_has_prefix(*param, "rcvbuf=")) {
+			/* 0 keeps the system default. */
+			tcp->rcvbuf = num;
+		} else {
+			sr_err("Unknown parameter '%s'.", *param);
+			return SR_ERR;
+		}
+	}
+
 	tcp->address = g_strdup(params[1]);
 	tcp->port = g_strdup(params[2]);
 	tcp->socket = -1;
@@ -72,6 +116,26 @@ static int scpi_tcp_dev_inst_new(void *priv, struct drv_context *drvc,
 	return SR_OK;
 }
 
+static void scpi_tcp_set_option(struct scpi_tcp *tcp, int level, int name,
+		const char *desc, int value)
+{
+	if (setsockopt(tcp->socket, level, name,
+			(const char *)&value, sizeof(value)) < 0)
+		sr_dbg("Failed to set %s: %s", desc, g_strerror(errno));
+}
+
+static void scpi_tcp_set_options(struct scpi_tcp *tcp)
+{
+	/* The receive buffer must be set before connecting, for window scaling. */
+	if (tcp->rcvbuf)
+		scpi_tcp_set_option(tcp, SOL_SOCKET, SO_RCVBUF,
+			"SO_RCVBUF", tcp->rcvbuf);
+	scpi_tcp_set_option(tcp, IPPROTO_TCP, TCP_NODELAY,
+		"TCP_NODELAY", tcp->nodelay);
+	scpi_tcp_set_option(tcp, SOL_SOCKET, SO_KEEPALIVE,
+		"SO_KEEPALIVE", tcp->keepalive);
+}
+
 static int scpi_tcp_open(struct sr_scpi_dev_inst *scpi)
 {
 	struct scpi_tcp *tcp = scpi->priv;
@@ -96,6 +160,7 @@ static int scpi_tcp_open(struct sr_scpi_dev_inst *scpi)
 		if ((tcp->socket = socket(res->ai_family, res->ai_socktype,
 						res->ai_protocol)) < 0)
 			continue;
+		scpi_tcp_set_options(tcp);
 		if (connect(tcp->socket, res->ai_addr, res->ai_addrlen) != 0) {
 			close(tcp->socket);
 			tcp->socket = -1;
@@ -253,6 +318,28 @@ static int scpi_tcp_read_complete(void *priv)
 			tcp->response_bytes_read >= tcp->response_length);
 }
 
+/* Check without blocking whether a subsequent recv() would return. */
+static int scpi_tcp_read_ready(void *priv)
+{
+	struct scpi_tcp *tcp = priv;
+	fd_set rset;
+	struct timeval tv;
+	int ret;
+
+	FD_ZERO(&rset);
+	FD_SET(tcp->socket, &rset);
+	tv.tv_sec = 0;
+	tv.tv_usec = 0;
+
+	ret = select(tcp->socket + 1, &rset, NULL, NULL, &tv);
+	if (ret < 0) {
+		sr_err("Select error: %s", g_strerror(errno));
+		return SR_ERR;
+	}
+
+	return ret > 0;
+}
+
 static int scpi_tcp_close(struct sr_scpi_dev_inst *scpi)
 {
 	struct scpi_tcp *tcp = scpi->priv;
@@ -286,6 +373,7 @@ SR_PRIV const struct sr_scpi_dev_inst scpi_tcp_raw_dev = {
 	.read_data     = scpi_tcp_raw_read_data,
 	.write_data    = scpi_tcp_raw_write_data,
 	.read_complete = scpi_tcp_read_complete,
+	.read_ready    = scpi_tcp_read_ready,
 	.close         = scpi_tcp_close,
 	.free          = scpi_tcp_free,
 };
@@ -304,6 +392,7 @@ SR_PRIV const struct sr_scpi_dev_inst scpi_tcp_rigol_dev = {
 	.read_begin    = scpi_tcp_read_begin,
 	.read_data     = scpi_tcp_rigol_read_data,
 	.read_complete = scpi_tcp_read_complete,
+	.read_ready    = scpi_tcp_read_ready,
 	.close         = scpi_tcp_close,
 	.free          = scpi_tcp_free,
 };
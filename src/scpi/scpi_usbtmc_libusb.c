@@ -26,8 +26,19 @@
 
 #define LOG_PREFIX "scpi_usbtmc"
 
-#define MAX_TRANSFER_LENGTH 2048
+/*
+ * Bulk in transfers are a multiple of the largest (high speed) packet
+ * size, so that a device never overflows them. Large transfers amortize
+ * the per transfer overhead of waveform downloads. The size can be set
+ * with a "transfer=<bytes>" parameter after the device address.
+ */
+#define PACKET_SIZE 512
+#define DEFAULT_TRANSFER_LENGTH (64 * 1024)
+#define MIN_TRANSFER_LENGTH 2048
+#define MAX_TRANSFER_LENGTH (1024 * 1024)
 #define TRANSFER_TIMEOUT 1000
+/* Bulk in transfers in flight, when reading straight into the caller's buffer. */
+#define NUM_DIRECT_TRANSFERS 4
 
 struct scpi_usbtmc_libusb {
 	struct sr_context *ctx;
@@ -42,10 +53,20 @@ struct scpi_usbtmc_libusb {
 	uint8_t usb488_dev_cap;
 	uint8_t bTag;
 	uint8_t bulkin_attributes;
-	uint8_t buffer[MAX_TRANSFER_LENGTH];
+	uint8_t *buffer;
+	int buffer_size;
 	int response_length;
 	int response_bytes_read;
 	int remaining_length;
+	/* Bulk in transfer of non-blocking reads */
+	struct libusb_transfer *transfer;
+	gboolean transfer_busy;
+	gboolean transfer_header;
+	int header_tries;
+	/* Bulk in transfers of reads into the caller's buffer */
+	struct libusb_transfer *direct[NUM_DIRECT_TRANSFERS];
+	int direct_busy;
+	gboolean direct_short;
 };
 
 /* Some USBTMC-specific enums, as defined in the USBTMC standard. */
@@ -130,7 +151,7 @@ static GSList *scpi_usbtmc_libusb_scan(struct drv_context *drvc)
 	int confidx, intfidx, ret, i;
 	char *res;
 
-	ret = libusb_get_device_list(drvc->sr_ctx->libusb_ctx, &devlist);
+	ret = sr_usb_device_list(drvc->sr_ctx, &devlist);
 	if (ret < 0) {
 		sr_err("Failed to get device list: %s.",
 		       libusb_error_name(ret));
@@ -176,6 +197,8 @@ static int scpi_usbtmc_libusb_dev_inst_new(void *priv, struct drv_context *drvc,
 {
 	struct scpi_usbtmc_libusb *uscpi = priv;
 	GSList *devices;
+	char *end;
+	long size;
 
 	(void)resource;
 	(void)serialcomm;
@@ -185,6 +208,21 @@ static int scpi_usbtmc_libusb_dev_inst_new(void *priv, struct drv_context *drvc,
 		return SR_ERR;
 	}
 
+	size = DEFAULT_TRANSFER_LENGTH;
+	if (params[2]) {
+		if (!g_str_has_prefix(params[2], "transfer=")) {
+			sr_err("Unknown parameter '%s'.", params[2]);
+			return SR_ERR;
+		}
+		size = strtol(params[2] + strlen("transfer="), &end, 10);
+		if (*end || size < MIN_TRANSFER_LENGTH || size > MAX_TRANSFER_LENGTH) {
+			sr_err("Invalid transfer size '%s', must be %d to %d bytes.",
+			       params[2], MIN_TRANSFER_LENGTH, MAX_TRANSFER_LENGTH);
+			return SR_ERR;
+		}
+	}
+	uscpi->buffer_size = size & ~(PACKET_SIZE - 1);
+
 	uscpi->ctx = drvc->sr_ctx;
 	devices = sr_usb_find(uscpi->ctx->libusb_ctx, params[1]);
 	if (g_slist_length(devices) != 1) {
@@ -194,6 +232,7 @@ static int scpi_usbtmc_libusb_dev_inst_new(void *priv, struct drv_context *drvc,
 	}
 	uscpi->usb = devices->data;
 	g_slist_free(devices);
+	uscpi->buffer = g_malloc(uscpi->buffer_size);
 
 	return SR_OK;
 }
@@ -483,7 +522,7 @@ static int scpi_usbtmc_bulkout(struct scpi_usbtmc_libusb *uscpi,
 	struct sr_usb_dev_inst *usb = uscpi->usb;
 	int padded_size, ret, transferred;
 
-	if (data && (size + USBTMC_BULK_HEADER_SIZE + 3) > (int)sizeof(uscpi->buffer)) {
+	if (data && (size + USBTMC_BULK_HEADER_SIZE + 3) > uscpi->buffer_size) {
 		sr_err("USBTMC bulk out transfer is too big.");
 		return SR_ERR;
 	}
@@ -519,12 +558,47 @@ static int scpi_usbtmc_bulkout(struct scpi_usbtmc_libusb *uscpi,
 	return transferred - USBTMC_BULK_HEADER_SIZE;
 }
 
+/* Parse the header of the first transfer of a bulk in message. */
+static int scpi_usbtmc_bulkin_header(struct scpi_usbtmc_libusb *uscpi,
+                                     uint8_t msg_id, void *data, int transferred,
+                                     int32_t size, uint8_t *transfer_attributes)
+{
+	int message_size;
+
+	if (transferred < USBTMC_BULK_HEADER_SIZE) {
+		sr_err("USBTMC bulk in returned too little data: %d/%d bytes\n", transferred, size);
+		return SR_ERR;
+	}
+
+	if (usbtmc_bulk_in_header_read(data, msg_id, uscpi->bTag, &message_size,
+	                               transfer_attributes) != SR_OK) {
+		sr_err("USBTMC invalid bulk in header.");
+		return SR_ERR;
+	}
+
+	message_size += USBTMC_BULK_HEADER_SIZE;
+	uscpi->response_length = MIN(transferred, message_size);
+	uscpi->response_bytes_read = USBTMC_BULK_HEADER_SIZE;
+	uscpi->remaining_length = message_size - uscpi->response_length;
+
+	return transferred - USBTMC_BULK_HEADER_SIZE;
+}
+
+/* Account for a subsequent transfer of a bulk in message. */
+static void scpi_usbtmc_bulkin_data(struct scpi_usbtmc_libusb *uscpi,
+                                    int transferred)
+{
+	uscpi->response_length = MIN(transferred, uscpi->remaining_length);
+	uscpi->response_bytes_read = 0;
+	uscpi->remaining_length -= uscpi->response_length;
+}
+
 static int scpi_usbtmc_bulkin_start(struct scpi_usbtmc_libusb *uscpi,
                                     uint8_t msg_id, void *data, int32_t size,
                                     uint8_t *transfer_attributes)
 {
 	struct sr_usb_dev_inst *usb = uscpi->usb;
-	int ret, transferred, message_size, tries;
+	int ret, transferred, tries;
 
 	for (tries = 0; ; tries++) {
 		ret = libusb_bulk_transfer(usb->devhdl, uscpi->bulk_in_ep, data,
@@ -548,26 +622,11 @@ static int scpi_usbtmc_bulkin_start(struct scpi_usbtmc_libusb *uscpi,
 			continue;
 		}
 
-		if (transferred < USBTMC_BULK_HEADER_SIZE) {
-			sr_err("USBTMC bulk in returned too little data: %d/%d bytes\n", transferred, size);
-			return SR_ERR;
-		}
-
 		break;
 	}
 
-	if (usbtmc_bulk_in_header_read(data, msg_id, uscpi->bTag, &message_size,
-	                               transfer_attributes) != SR_OK) {
-		sr_err("USBTMC invalid bulk in header.");
-		return SR_ERR;
-	}
-
-	message_size += USBTMC_BULK_HEADER_SIZE;
-	uscpi->response_length = MIN(transferred, message_size);
-	uscpi->response_bytes_read = USBTMC_BULK_HEADER_SIZE;
-	uscpi->remaining_length = message_size - uscpi->response_length;
-
-	return transferred - USBTMC_BULK_HEADER_SIZE;
+	return scpi_usbtmc_bulkin_header(uscpi, msg_id, data, transferred,
+	                                 size, transfer_attributes);
 }
 
 static int scpi_usbtmc_bulkin_continue(struct scpi_usbtmc_libusb *uscpi,
@@ -584,9 +643,138 @@ static int scpi_usbtmc_bulkin_continue(struct scpi_usbtmc_libusb *uscpi,
 		return SR_ERR;
 	}
 
-	uscpi->response_length = MIN(transferred, uscpi->remaining_length);
+	scpi_usbtmc_bulkin_data(uscpi, transferred);
+
+	return transferred;
+}
+
+static void LIBUSB_CALL scpi_usbtmc_bulkin_cb(struct libusb_transfer *transfer)
+{
+	struct scpi_usbtmc_libusb *uscpi = transfer->user_data;
+
+	uscpi->transfer_busy = FALSE;
+}
+
+/* Submit a bulk in transfer which completes in the background. */
+static int scpi_usbtmc_bulkin_submit(struct scpi_usbtmc_libusb *uscpi,
+                                     gboolean header)
+{
+	int ret;
+
+	if (!uscpi->transfer && !(uscpi->transfer = libusb_alloc_transfer(0)))
+		return SR_ERR_MALLOC;
+
+	libusb_fill_bulk_transfer(uscpi->transfer, uscpi->usb->devhdl,
+	                          uscpi->bulk_in_ep, uscpi->buffer,
+	                          uscpi->buffer_size, scpi_usbtmc_bulkin_cb,
+	                          uscpi, TRANSFER_TIMEOUT);
+	if ((ret = libusb_submit_transfer(uscpi->transfer)) < 0) {
+		sr_err("USBTMC bulk in transfer error: %s.",
+		       libusb_error_name(ret));
+		return SR_ERR;
+	}
+	uscpi->transfer_busy = TRUE;
+	uscpi->transfer_header = header;
+
+	return SR_OK;
+}
+
+/* Cancel a pending background transfer, and wait for its completion. */
+static void scpi_usbtmc_bulkin_cancel(struct scpi_usbtmc_libusb *uscpi)
+{
+	struct timeval tv;
+
+	if (!uscpi->transfer_busy)
+		return;
+
+	libusb_cancel_transfer(uscpi->transfer);
+	while (uscpi->transfer_busy) {
+		tv.tv_sec = 0;
+		tv.tv_usec = 100 * 1000;
+		if (libusb_handle_events_timeout_completed(uscpi->ctx->libusb_ctx,
+				&tv, NULL) < 0)
+			break;
+	}
+}
+
+static void LIBUSB_CALL scpi_usbtmc_direct_cb(struct libusb_transfer *transfer)
+{
+	struct scpi_usbtmc_libusb *uscpi = transfer->user_data;
+
+	uscpi->direct_busy--;
+	if (transfer->status != LIBUSB_TRANSFER_COMPLETED ||
+	    transfer->actual_length < transfer->length)
+		uscpi->direct_short = TRUE;
+}
+
+/*
+ * Read the next part of a bulk in message straight into the caller's
+ * buffer, with several transfers in flight. The length must be a multiple
+ * of the packet size, and less than the remaining length of the message,
+ * so that the message's alignment padding doesn't end up in the buffer.
+ */
+static int scpi_usbtmc_bulkin_direct(struct scpi_usbtmc_libusb *uscpi,
+                                     uint8_t *data, int size)
+{
+	struct libusb_transfer *transfer;
+	struct timeval tv;
+	int num, len, offset, transferred, i, ret;
+
+	uscpi->direct_busy = 0;
+	uscpi->direct_short = FALSE;
+	for (num = 0, offset = 0; num < NUM_DIRECT_TRANSFERS && offset < size; num++) {
+		if (!uscpi->direct[num] &&
+		    !(uscpi->direct[num] = libusb_alloc_transfer(0)))
+			break;
+		transfer = uscpi->direct[num];
+		len = MIN(size - offset, uscpi->buffer_size);
+		libusb_fill_bulk_transfer(transfer, uscpi->usb->devhdl,
+		                          uscpi->bulk_in_ep, data + offset, len,
+		                          scpi_usbtmc_direct_cb, uscpi,
+		                          TRANSFER_TIMEOUT);
+		if ((ret = libusb_submit_transfer(transfer)) < 0) {
+			sr_err("USBTMC bulk in transfer error: %s.",
+			       libusb_error_name(ret));
+			break;
+		}
+		uscpi->direct_busy++;
+		offset += len;
+	}
+
+	/* Once a transfer falls short, the following ones get no data. */
+	while (uscpi->direct_busy) {
+		tv.tv_sec = 0;
+		tv.tv_usec = 100 * 1000;
+		if (libusb_handle_events_timeout_completed(uscpi->ctx->libusb_ctx,
+				&tv, NULL) < 0)
+			break;
+		if (uscpi->direct_short) {
+			for (i = 0; i < num; i++)
+				libusb_cancel_transfer(uscpi->direct[i]);
+		}
+	}
+	if (uscpi->direct_busy) {
+		sr_err("USBTMC bulk in transfers did not complete.");
+		return SR_ERR;
+	}
+
+	transferred = 0;
+	for (i = 0; i < num; i++) {
+		transfer = uscpi->direct[i];
+		transferred += transfer->actual_length;
+		if (transfer->status != LIBUSB_TRANSFER_COMPLETED ||
+		    transfer->actual_length < transfer->length)
+			break;
+	}
+	if (i < num && !transferred) {
+		sr_err("USBTMC bulk in transfer failed (status %d).",
+		       uscpi->direct[i]->status);
+		return SR_ERR;
+	}
+
+	uscpi->response_length = 0;
 	uscpi->response_bytes_read = 0;
-	uscpi->remaining_length -= uscpi->response_length;
+	uscpi->remaining_length -= MIN(transferred, uscpi->remaining_length);
 
 	return transferred;
 }
@@ -608,13 +796,14 @@ static int scpi_usbtmc_libusb_read_begin(void *priv)
 {
 	struct scpi_usbtmc_libusb *uscpi = priv;
 
+	scpi_usbtmc_bulkin_cancel(uscpi);
 	uscpi->remaining_length = 0;
 
 	if (scpi_usbtmc_bulkout(uscpi, REQUEST_DEV_DEP_MSG_IN,
 	    NULL, INT32_MAX, 0) < 0)
 		return SR_ERR;
 	if (scpi_usbtmc_bulkin_start(uscpi, DEV_DEP_MSG_IN,
-	                             uscpi->buffer, sizeof(uscpi->buffer),
+	                             uscpi->buffer, uscpi->buffer_size,
 	                             &uscpi->bulkin_attributes) < 0)
 		return SR_ERR;
 
@@ -627,9 +816,15 @@ static int scpi_usbtmc_libusb_read_data(void *priv, char *buf, int maxlen)
 	int read_length;
 
 	if (uscpi->response_bytes_read >= uscpi->response_length) {
+		/* Skip the bounce buffer when the caller asks for a lot. */
+		read_length = MIN(maxlen, uscpi->remaining_length - 1) &
+		              ~(PACKET_SIZE - 1);
+		if (read_length >= uscpi->buffer_size)
+			return scpi_usbtmc_bulkin_direct(uscpi,
+			                                 (uint8_t *)buf, read_length);
 		if (uscpi->remaining_length > 0) {
 			if (scpi_usbtmc_bulkin_continue(uscpi, uscpi->buffer,
-			                                sizeof(uscpi->buffer)) <= 0)
+			                                uscpi->buffer_size) <= 0)
 				return SR_ERR;
 		} else {
 			if (uscpi->bulkin_attributes & EOM)
@@ -648,6 +843,89 @@ static int scpi_usbtmc_libusb_read_data(void *priv, char *buf, int maxlen)
 	return read_length;
 }
 
+static int scpi_usbtmc_libusb_read_begin_async(void *priv)
+{
+	struct scpi_usbtmc_libusb *uscpi = priv;
+
+	scpi_usbtmc_bulkin_cancel(uscpi);
+	uscpi->remaining_length = 0;
+	uscpi->response_length = 0;
+	uscpi->response_bytes_read = 0;
+	uscpi->header_tries = 0;
+
+	if (scpi_usbtmc_bulkout(uscpi, REQUEST_DEV_DEP_MSG_IN,
+	    NULL, INT32_MAX, 0) < 0)
+		return SR_ERR;
+
+	return scpi_usbtmc_bulkin_submit(uscpi, TRUE);
+}
+
+/*
+ * Returns TRUE when read_data() can be called without blocking, i.e. data
+ * of the current transfer is pending. Submits the next transfer of the
+ * response when needed, and returns FALSE until it completes.
+ */
+static int scpi_usbtmc_libusb_read_ready(void *priv)
+{
+	struct scpi_usbtmc_libusb *uscpi = priv;
+	struct libusb_transfer *transfer;
+	struct timeval tv;
+
+	if (uscpi->transfer_busy) {
+		tv.tv_sec = 0;
+		tv.tv_usec = 0;
+		libusb_handle_events_timeout_completed(uscpi->ctx->libusb_ctx,
+			&tv, NULL);
+		if (uscpi->transfer_busy)
+			return FALSE;
+
+		transfer = uscpi->transfer;
+		if (transfer->status != LIBUSB_TRANSFER_COMPLETED) {
+			sr_err("USBTMC bulk in transfer failed (status %d).",
+			       transfer->status);
+			return SR_ERR;
+		}
+		if (!uscpi->transfer_header) {
+			scpi_usbtmc_bulkin_data(uscpi, transfer->actual_length);
+			return TRUE;
+		}
+		if (transfer->actual_length == 0 && uscpi->header_tries++ < 1) {
+			/* See scpi_usbtmc_bulkin_start() for this quirk. */
+			sr_warn("USBTMC bulk in start was empty; retrying\n");
+			return scpi_usbtmc_bulkin_submit(uscpi, TRUE) < 0 ?
+				SR_ERR : FALSE;
+		}
+		if (scpi_usbtmc_bulkin_header(uscpi, DEV_DEP_MSG_IN,
+		                              uscpi->buffer, transfer->actual_length,
+		                              uscpi->buffer_size,
+		                              &uscpi->bulkin_attributes) < 0)
+			return SR_ERR;
+		return TRUE;
+	}
+
+	if (uscpi->response_bytes_read < uscpi->response_length)
+		return TRUE;
+
+	if (uscpi->remaining_length > 0) {
+		if (scpi_usbtmc_bulkin_submit(uscpi, FALSE) < 0)
+			return SR_ERR;
+		return FALSE;
+	}
+
+	/* The device split the response into several messages. */
+	if (!(uscpi->bulkin_attributes & EOM)) {
+		uscpi->header_tries = 0;
+		if (scpi_usbtmc_bulkout(uscpi, REQUEST_DEV_DEP_MSG_IN,
+		    NULL, INT32_MAX, 0) < 0)
+			return SR_ERR;
+		if (scpi_usbtmc_bulkin_submit(uscpi, TRUE) < 0)
+			return SR_ERR;
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
 static int scpi_usbtmc_libusb_read_complete(void *priv)
 {
 	struct scpi_usbtmc_libusb *uscpi = priv;
@@ -660,11 +938,19 @@ static int scpi_usbtmc_libusb_close(struct sr_scpi_dev_inst *scpi)
 {
 	struct scpi_usbtmc_libusb *uscpi = scpi->priv;
 	struct sr_usb_dev_inst *usb = uscpi->usb;
-	int ret;
+	int ret, i;
 
 	if (!usb->devhdl)
 		return SR_ERR;
 
+	scpi_usbtmc_bulkin_cancel(uscpi);
+	libusb_free_transfer(uscpi->transfer);
+	uscpi->transfer = NULL;
+	for (i = 0; i < NUM_DIRECT_TRANSFERS; i++) {
+		libusb_free_transfer(uscpi->direct[i]);
+		uscpi->direct[i] = NULL;
+	}
+
 	scpi_usbtmc_local(uscpi);
 
 	if ((ret = libusb_release_interface(usb->devhdl, uscpi->interface)) < 0)
@@ -688,6 +974,7 @@ static void scpi_usbtmc_libusb_free(void *priv)
 {
 	struct scpi_usbtmc_libusb *uscpi = priv;
 	sr_usb_dev_inst_free(uscpi->usb);
+	g_free(uscpi->buffer);
 }
 
 SR_PRIV const struct sr_scpi_dev_inst scpi_usbtmc_libusb_dev = {
@@ -705,6 +992,8 @@ SR_PRIV const struct sr_scpi_dev_inst scpi_usbtmc_libusb_dev = {
 	.read_begin    = scpi_usbtmc_libusb_read_begin,
 	.read_data     = scpi_usbtmc_libusb_read_data,
 	.read_complete = scpi_usbtmc_libusb_read_complete,
+	.read_begin_async = scpi_usbtmc_libusb_read_begin_async,
+	.read_ready    = scpi_usbtmc_libusb_read_ready,
 	.close         = scpi_usbtmc_libusb_close,
 	.free          = scpi_usbtmc_libusb_free,
 };
@@ -30,16 +30,26 @@
 
 #define LOG_PREFIX "scpi_vxi"
 #define VXI_DEFAULT_TIMEOUT_MS 2000
+/* Margin of the RPC timeout over the instrument's I/O timeout. */
+#define VXI_RPC_TIMEOUT_MARGIN_MS 1000
 
 struct scpi_vxi {
 	char *address;
 	char *instrument;
 	CLIENT *client;
+	/* Abort channel, NULL when the instrument doesn't provide it. */
+	CLIENT *abort_client;
 	Device_Link link;
 	unsigned int max_send_size;
 	unsigned int read_complete;
 };
 
+/* Response of device_read, decoded into the caller's buffer. */
+struct scpi_vxi_read_resp {
+	Device_ReadResp resp;
+	u_int maxlen;
+};
+
 static int scpi_vxi_dev_inst_new(void *priv, struct drv_context *drvc,
 		const char *resource, char **params, const char *serialcomm)
 {
@@ -60,6 +70,28 @@ static int scpi_vxi_dev_inst_new(void *priv, struct drv_context *drvc,
 	return SR_OK;
 }
 
+/*
+ * Connect to the abort channel, which is served on a separate port of the
+ * same host. Without it, reads can't be aborted, which is not fatal.
+ */
+static void scpi_vxi_abort_open(struct scpi_vxi *vxi, u_short port)
+{
+	struct sockaddr_in addr;
+	int sock;
+
+	if (!port || !clnt_control(vxi->client, CLGET_SERVER_ADDR, (char *)&addr)) {
+		sr_dbg("No abort channel for %s.", vxi->address);
+		return;
+	}
+
+	addr.sin_port = htons(port);
+	sock = RPC_ANYSOCK;
+	vxi->abort_client = clnttcp_create(&addr, DEVICE_ASYNC,
+		DEVICE_ASYNC_VERSION, &sock, 0, 0);
+	if (!vxi->abort_client)
+		sr_dbg("Abort channel creation failed for %s.", vxi->address);
+}
+
 static int scpi_vxi_open(struct sr_scpi_dev_inst *scpi)
 {
 	struct scpi_vxi *vxi = scpi->priv;
@@ -89,6 +121,8 @@ static int scpi_vxi_open(struct sr_scpi_dev_inst *scpi)
 	if (vxi->max_send_size <= 0)
 		vxi->max_send_size = 4096;
 
+	scpi_vxi_abort_open(vxi, link_resp->abortPort);
+
 	return SR_OK;
 }
 
@@ -128,27 +162,34 @@ static int scpi_vxi_send(void *priv, const char *command)
 	struct scpi_vxi *vxi = priv;
 	Device_WriteResp *write_resp;
 	Device_WriteParms write_parms;
-	unsigned long len;
+	unsigned long len, sent;
 
 	len = strlen(command);
 
 	write_parms.lid           = vxi->link;
 	write_parms.io_timeout    = VXI_DEFAULT_TIMEOUT_MS;
 	write_parms.lock_timeout  = VXI_DEFAULT_TIMEOUT_MS;
-	write_parms.flags         = DF_END;
-	write_parms.data.data_len = MIN(len, vxi->max_send_size);
-	write_parms.data.data_val = (char *)command;
-
-	if (!(write_resp = device_write_1(&write_parms, vxi->client))
-	    || write_resp->error) {
-		sr_err("Device write failed for %s with error %ld",
-		       vxi->address, write_resp ? write_resp->error : 0);
-		return SR_ERR;
+
+	/* Split commands which exceed the instrument's maxRecvSize. */
+	for (sent = 0; sent < len; sent += write_resp->size) {
+		write_parms.data.data_len = MIN(len - sent, vxi->max_send_size);
+		write_parms.data.data_val = (char *)command + sent;
+		write_parms.flags = sent + write_parms.data.data_len == len ?
+			DF_END : 0;
+
+		if (!(write_resp = device_write_1(&write_parms, vxi->client))
+		    || write_resp->error) {
+			sr_err("Device write failed for %s with error %ld",
+			       vxi->address, write_resp ? write_resp->error : 0);
+			return SR_ERR;
+		}
+		if (!write_resp->size)
+			break;
 	}
 
-	if (write_resp->size < len)
+	if (sent < len)
 		sr_dbg("Only sent %lu/%lu bytes of SCPI command: '%s'.",
-		       write_resp->size, len, command);
+		       sent, len, command);
 	else
 		sr_spew("Successfully sent SCPI command: '%s'.", command);
 
@@ -169,11 +210,29 @@ static int scpi_vxi_read_begin(void *priv)
 #define RRR_TERM  0x02  /* a termination char has been read */
 #define RRR_END   0x04  /* an END indicator has been read */
 
+/*
+ * Like xdr_Device_ReadResp(), but decodes the data into the preset buffer,
+ * and rejects more data than fits.
+ */
+static bool_t scpi_vxi_xdr_read_resp(XDR *xdrs, struct scpi_vxi_read_resp *r)
+{
+	if (!xdr_Device_ErrorCode(xdrs, &r->resp.error))
+		return FALSE;
+	if (!xdr_long(xdrs, &r->resp.reason))
+		return FALSE;
+	return xdr_bytes(xdrs, &r->resp.data.data_val,
+		&r->resp.data.data_len, r->maxlen);
+}
+
+static int scpi_vxi_abort(void *priv);
+
 static int scpi_vxi_read_data(void *priv, char *buf, int maxlen)
 {
 	struct scpi_vxi *vxi = priv;
 	Device_ReadParms read_parms;
-	Device_ReadResp *read_resp;
+	struct scpi_vxi_read_resp read_resp;
+	struct timeval timeout;
+	enum clnt_stat stat;
 
 	read_parms.lid          = vxi->link;
 	read_parms.io_timeout   = VXI_DEFAULT_TIMEOUT_MS;
@@ -182,16 +241,28 @@ static int scpi_vxi_read_data(void *priv, char *buf, int maxlen)
 	read_parms.termChar     = 0;
 	read_parms.requestSize  = maxlen;
 
-	if (!(read_resp = device_read_1(&read_parms, vxi->client))
-	    || read_resp->error) {
+	/* Let the RPC layer write straight into the caller's buffer. */
+	memset(&read_resp, 0, sizeof(read_resp));
+	read_resp.resp.data.data_val = buf;
+	read_resp.maxlen = maxlen;
+	timeout.tv_sec = (VXI_DEFAULT_TIMEOUT_MS + VXI_RPC_TIMEOUT_MARGIN_MS) / 1000;
+	timeout.tv_usec = 0;
+
+	stat = clnt_call(vxi->client, device_read,
+		(xdrproc_t)xdr_Device_ReadParms, (caddr_t)&read_parms,
+		(xdrproc_t)scpi_vxi_xdr_read_resp, (caddr_t)&read_resp,
+		timeout);
+	if (stat != RPC_SUCCESS || read_resp.resp.error) {
 		sr_err("Device read failed for %s with error %ld",
-		       vxi->address, read_resp ? read_resp->error : 0);
+		       vxi->address, read_resp.resp.error);
+		/* Stop the instrument's side of the read, keep the link. */
+		if (stat == RPC_TIMEDOUT)
+			scpi_vxi_abort(vxi);
 		return SR_ERR;
 	}
 
-	memcpy(buf, read_resp->data.data_val, read_resp->data.data_len);
-	vxi->read_complete = read_resp->reason & (RRR_TERM | RRR_END);
-	return read_resp->data.data_len;  /* actual number of bytes received */
+	vxi->read_complete = read_resp.resp.reason & (RRR_TERM | RRR_END);
+	return read_resp.resp.data.data_len;  /* actual number of bytes received */
 }
 
 static int scpi_vxi_read_complete(void *priv)
@@ -201,6 +272,25 @@ static int scpi_vxi_read_complete(void *priv)
 	return vxi->read_complete;
 }
 
+/* Abort an in-progress read of the link, through the abort channel. */
+static int scpi_vxi_abort(void *priv)
+{
+	struct scpi_vxi *vxi = priv;
+	Device_Error *dev_error;
+
+	if (!vxi->abort_client)
+		return SR_ERR_NA;
+
+	if (!(dev_error = device_abort_1(&vxi->link, vxi->abort_client))
+	    || dev_error->error) {
+		sr_err("Device abort failed for %s with error %ld",
+		       vxi->address, dev_error ? dev_error->error : 0);
+		return SR_ERR;
+	}
+
+	return SR_OK;
+}
+
 static int scpi_vxi_close(struct sr_scpi_dev_inst *scpi)
 {
 	struct scpi_vxi *vxi = scpi->priv;
@@ -209,6 +299,11 @@ static int scpi_vxi_close(struct sr_scpi_dev_inst *scpi)
 	if (!vxi->client)
 		return SR_ERR;
 
+	if (vxi->abort_client) {
+		clnt_destroy(vxi->abort_client);
+		vxi->abort_client = NULL;
+	}
+
 	if (!(dev_error = destroy_link_1(&vxi->link, vxi->client))) {
 		sr_err("Link destruction failed for %s", vxi->address);
 		return SR_ERR;
@@ -242,6 +337,7 @@ SR_PRIV const struct sr_scpi_dev_inst scpi_vxi_dev = {
 	.read_begin    = scpi_vxi_read_begin,
 	.read_data     = scpi_vxi_read_data,
 	.read_complete = scpi_vxi_read_complete,
+	.abort         = scpi_vxi_abort,
 	.close         = scpi_vxi_close,
 	.free          = scpi_vxi_free,
 };
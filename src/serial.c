@@ -64,6 +64,8 @@ static int dev_is_supported(struct sr_serial_dev_inst *serial)
 	return 1;
 }
 
+static void ser_line_framer_release(struct sr_serial_dev_inst *serial);
+
 /**
  * Open the specified serial port.
  *
@@ -166,9 +168,15 @@ SR_PRIV int serial_close(struct sr_serial_dev_inst *serial)
 	if (!serial->lib_funcs || !serial->lib_funcs->close)
 		return SR_ERR_NA;
 
+	ser_line_framer_release(serial);
+	serial_worker_source_remove(serial);
 	rc = serial->lib_funcs->close(serial);
 	if (rc == SR_OK && serial->rcv_buffer) {
-		g_string_free(serial->rcv_buffer, TRUE);
+		sr_dbg("RX queue high water mark %zu of %zu bytes.",
+			serial->rcv_buffer->high_water,
+			serial->rcv_buffer->size);
+		g_free(serial->rcv_buffer->buf);
+		g_free(serial->rcv_buffer);
 		serial->rcv_buffer = NULL;
 	}
 
@@ -274,6 +282,62 @@ SR_PRIV int serial_set_read_chunk_cb(struct sr_serial_dev_inst *serial,
 	return SR_OK;
 }
 
+/* Initial capacity of the RX queue, which grows when it fills up. */
+#define SER_RX_QUEUE_MIN_SIZE 4096
+
+/**
+ * Allocate the RX queue, unless allocated already. Internal to the serial
+ * subsystem, coordination between common and transport specific support
+ * code.
+ *
+ * @param[in] serial Serial port instance being opened.
+ * @param[in] size Number of bytes the transport delivers at once.
+ *
+ * @private
+ */
+SR_PRIV void sr_ser_alloc_rx_queue(struct sr_serial_dev_inst *serial,
+	size_t size)
+{
+	struct ser_rx_queue *q;
+
+	if (!serial || serial->rcv_buffer)
+		return;
+
+	q = g_malloc0(sizeof(*q));
+	q->size = SER_RX_QUEUE_MIN_SIZE;
+	while (q->size < 4 * size)
+		q->size *= 2;
+	q->buf = g_malloc(q->size);
+	serial->rcv_buffer = q;
+}
+
+/* Move the queue's data to the start of a buffer of the given size. */
+static void ser_rx_queue_relocate(struct ser_rx_queue *q, size_t size)
+{
+	uint8_t *buf;
+	size_t first;
+
+	buf = g_malloc(size);
+	first = MIN(q->len, q->size - q->head);
+	memcpy(buf, q->buf + q->head, first);
+	memcpy(buf + first, q->buf, q->len - first);
+	g_free(q->buf);
+	q->buf = buf;
+	q->size = size;
+	q->head = 0;
+}
+
+/* Double the queue's capacity until len more bytes fit, keep the data. */
+static void ser_rx_queue_grow(struct ser_rx_queue *q, size_t len)
+{
+	size_t size;
+
+	size = q->size;
+	while (size - q->len < len)
+		size *= 2;
+	ser_rx_queue_relocate(q, size);
+}
+
 /**
  * Discard previously queued RX data. Internal to the serial subsystem,
  * coordination between common and transport specific support code.
@@ -287,7 +351,8 @@ SR_PRIV void sr_ser_discard_queued_data(struct sr_serial_dev_inst *serial)
 	if (!serial || !serial->rcv_buffer)
 		return;
 
-	g_string_truncate(serial->rcv_buffer, 0);
+	serial->rcv_buffer->head = 0;
+	serial->rcv_buffer->len = 0;
 }
 
 /**
@@ -319,13 +384,94 @@ SR_PRIV size_t sr_ser_has_queued_data(struct sr_serial_dev_inst *serial)
 SR_PRIV void sr_ser_queue_rx_data(struct sr_serial_dev_inst *serial,
 	const uint8_t *data, size_t len)
 {
+	struct ser_rx_queue *q;
+	size_t tail, first;
+
 	if (!serial || !data || !len)
 		return;
 
-	if (serial->rx_chunk_cb_func)
+	if (serial->rx_chunk_cb_func) {
 		serial->rx_chunk_cb_func(serial, serial->rx_chunk_cb_data, data, len);
-	else if (serial->rcv_buffer)
-		g_string_append_len(serial->rcv_buffer, (const gchar *)data, len);
+		return;
+	}
+	if (!(q = serial->rcv_buffer))
+		return;
+
+	if (q->size - q->len < len)
+		ser_rx_queue_grow(q, len);
+	tail = (q->head + q->len) & (q->size - 1);
+	first = MIN(len, q->size - tail);
+	memcpy(q->buf + tail, data, first);
+	memcpy(q->buf, data + first, len - first);
+	q->len += len;
+	if (q->len > q->high_water)
+		q->high_water = q->len;
+}
+
+/**
+ * Get space to receive data into the RX queue. Internal to the serial
+ * subsystem, coordination between common and transport specific support
+ * code.
+ *
+ * Transports which unpack received data can write it to the queue this
+ * way, instead of through a buffer of their own. The data only gets
+ * queued by sr_ser_rx_queue_commit().
+ *
+ * @param[in] serial Previously opened serial port instance.
+ * @param[in] len Number of contiguous bytes which are needed.
+ *
+ * @returns Pointer to the space, or NULL when there is no queue, or the
+ *   data has to go to a chunk callback. Callers queue the data with
+ *   sr_ser_queue_rx_data() then.
+ *
+ * @private
+ */
+SR_PRIV uint8_t *sr_ser_rx_queue_reserve(struct sr_serial_dev_inst *serial,
+	size_t len)
+{
+	struct ser_rx_queue *q;
+	size_t tail;
+
+	if (!serial || !len || serial->rx_chunk_cb_func)
+		return NULL;
+	if (!(q = serial->rcv_buffer))
+		return NULL;
+
+	if (!q->len)
+		q->head = 0;
+	if (q->size - q->len < len)
+		ser_rx_queue_grow(q, len);
+	tail = (q->head + q->len) & (q->size - 1);
+	/* Only the free space up to the buffer's end may be too short. */
+	if (tail >= q->head && q->size - tail < len) {
+		ser_rx_queue_relocate(q, q->size);
+		tail = q->len;
+	}
+
+	return q->buf + tail;
+}
+
+/**
+ * Queue data which was received into sr_ser_rx_queue_reserve() space.
+ * Internal to the serial subsystem, coordination between common and
+ * transport specific support code.
+ *
+ * @param[in] serial Previously opened serial port instance.
+ * @param[in] len Number of data bytes which were received.
+ *
+ * @private
+ */
+SR_PRIV void sr_ser_rx_queue_commit(struct sr_serial_dev_inst *serial,
+	size_t len)
+{
+	struct ser_rx_queue *q;
+
+	if (!serial || !(q = serial->rcv_buffer))
+		return;
+
+	q->len += len;
+	if (q->len > q->high_water)
+		q->high_water = q->len;
 }
 
 /**
@@ -341,23 +487,25 @@ SR_PRIV void sr_ser_queue_rx_data(struct sr_serial_dev_inst *serial,
 SR_PRIV size_t sr_ser_unqueue_rx_data(struct sr_serial_dev_inst *serial,
 	uint8_t *data, size_t len)
 {
-	size_t qlen;
-	GString *buf;
+	struct ser_rx_queue *q;
+	size_t first;
 
 	if (!serial || !data || !len)
 		return 0;
 
-	qlen = sr_ser_has_queued_data(serial);
-	if (!qlen)
+	if (!sr_ser_has_queued_data(serial))
 		return 0;
 
-	buf = serial->rcv_buffer;
-	if (len > buf->len)
-		len = buf->len;
-	if (len) {
-		memcpy(data, buf->str, len);
-		g_string_erase(buf, 0, len);
-	}
+	q = serial->rcv_buffer;
+	if (len > q->len)
+		len = q->len;
+	first = MIN(len, q->size - q->head);
+	memcpy(data, q->buf + q->head, first);
+	memcpy(data + first, q->buf, len - first);
+	q->head = (q->head + len) & (q->size - 1);
+	q->len -= len;
+	if (!q->len)
+		q->head = 0;
 
 	return len;
 }
@@ -592,6 +740,44 @@ SR_PRIV int serial_set_handshake(struct sr_serial_dev_inst *serial,
 	return ret;
 }
 
+/**
+ * Configure the latency of the specified serial port.
+ *
+ * USB serial adapters batch received bytes, e.g. FTDI chips hold them for
+ * up to 16ms by default. Shorter latencies speed up poll/response style
+ * protocols. Failures are not fatal to the caller, not all adapters and
+ * platforms support these settings.
+ *
+ * @param serial Previously opened serial port structure.
+ * @param[in] latency_ms Latency timer in ms (FTDI adapters), or -1 to keep.
+ * @param[in] low_latency Low latency mode of the tty driver (0 or 1), or -1
+ *                        to keep.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_NA Not supported by the port or the platform.
+ * @retval SR_ERR Failure.
+ *
+ * @private
+ */
+SR_PRIV int serial_set_latency(struct sr_serial_dev_inst *serial,
+	int latency_ms, int low_latency)
+{
+	if (!serial) {
+		sr_dbg("Invalid serial port.");
+		return SR_ERR;
+	}
+
+	if (latency_ms < 0 && low_latency < 0)
+		return SR_OK;
+
+	sr_spew("Setting latency of serial port %s.", serial->port);
+
+	if (!serial->lib_funcs || !serial->lib_funcs->set_latency)
+		return SR_ERR_NA;
+
+	return serial->lib_funcs->set_latency(serial, latency_ms, low_latency);
+}
+
 /**
  * Set serial parameters for the specified serial port from parameter string.
  *
@@ -606,6 +792,8 @@ SR_PRIV int serial_set_handshake(struct sr_serial_dev_inst *serial,
  * Options:\n
  * dtr=0|1 Set DTR off resp. on.\n
  * flow=0|1|2 Flow control. 0 for none, 1 for RTS/CTS, 2 for XON/XOFF.\n
+ * latency=1..255 Latency timer of FTDI adapters in ms.\n
+ * lowlatency=0|1 Low latency mode of the tty driver off resp. on (Linux).\n
  * rts=0|1 Set RTS off resp. on.\n
  * Please note that values and combinations of these parameters must be
  * supported by the concrete serial interface hardware and the drivers for it.
@@ -625,13 +813,15 @@ SR_PRIV int serial_set_paramstr(struct sr_serial_dev_inst *serial,
 	GRegex *reg;
 	GMatchInfo *match;
 	int speed, databits, parity, stopbits, flow, rts, dtr, i;
-	char *mstr, **opts, **kv;
+	int latency, lowlatency, ret;
+	char *mstr, **opts, **kv, *end;
 
 	speed = flow = 0;
 	databits = 8;
 	parity = SP_PARITY_NONE;
 	stopbits = 1;
 	rts = dtr = -1;
+	latency = lowlatency = -1;
 	sr_spew("Parsing parameters from \"%s\".", paramstr);
 	reg = g_regex_new(SERIAL_COMM_SPEC, 0, 0, NULL);
 	if (g_regex_match(reg, paramstr, 0, &match)) {
@@ -696,6 +886,21 @@ SR_PRIV int serial_set_paramstr(struct sr_serial_dev_inst *serial,
 							sr_dbg("invalid value for flow: %c", kv[1][0]);
 							speed = 0;
 						}
+					} else if (!strncmp(kv[0], "latency", 7) && kv[1]) {
+						latency = strtol(kv[1], &end, 10);
+						if (end == kv[1] || *end || latency < 1 || latency > 255) {
+							sr_dbg("invalid value for latency: %s", kv[1]);
+							speed = 0;
+						}
+					} else if (!strncmp(kv[0], "lowlatency", 10) && kv[1]) {
+						if (kv[1][0] == '1')
+							lowlatency = 1;
+						else if (kv[1][0] == '0')
+							lowlatency = 0;
+						else {
+							sr_dbg("invalid value for lowlatency: %c", kv[1][0]);
+							speed = 0;
+						}
 					}
 					g_strfreev(kv);
 				}
@@ -714,9 +919,16 @@ SR_PRIV int serial_set_paramstr(struct sr_serial_dev_inst *serial,
 		return SR_ERR_ARG;
 	}
 
-	return serial_set_params(serial, speed,
+	ret = serial_set_params(serial, speed,
 			databits, parity, stopbits,
 			flow, rts, dtr);
+	if (ret != SR_OK)
+		return ret;
+
+	/* Not all adapters have these, carry on without them. */
+	serial_set_latency(serial, latency, lowlatency);
+
+	return SR_OK;
 }
 
 /**
@@ -968,6 +1180,161 @@ SR_PRIV int sr_serial_extract_options(GSList *options,
 	return SR_OK;
 }
 
+/* Longest line of serial_line_source_add(), excluding the delimiter. */
+#define SERIAL_LINE_MAX 1024
+
+struct ser_line_framer {
+	struct sr_serial_dev_inst *serial;
+	serial_line_callback line_cb;
+	sr_receive_data_callback cb;
+	void *cb_data;
+	/* Callbacks are running, release() defers the free. */
+	gboolean busy, released;
+	size_t len;
+	char buf[SERIAL_LINE_MAX];
+};
+
+static void ser_line_framer_release(struct sr_serial_dev_inst *serial)
+{
+	struct ser_line_framer *framer;
+
+	if (!(framer = serial->line_framer))
+		return;
+
+	serial->line_framer = NULL;
+	if (framer->busy)
+		framer->released = TRUE;
+	else
+		g_free(framer);
+}
+
+/* Find the first CR or LF. */
+static char *ser_line_find_eol(char *p, size_t len)
+{
+	char *lf, *cr;
+
+	lf = memchr(p, '\n', len);
+	cr = memchr(p, '\r', lf ? (size_t)(lf - p) : len);
+
+	return cr ? cr : lf;
+}
+
+/* Pass complete lines to the callback, keep a partial line. */
+static void ser_line_framer_split(struct ser_line_framer *framer,
+	size_t scanned)
+{
+	char *line, *eol, *end;
+
+	line = framer->buf;
+	end = framer->buf + framer->len;
+	while (!framer->released &&
+			(eol = ser_line_find_eol(line + scanned, end - line - scanned))) {
+		*eol = '\0';
+		if (eol > line)
+			framer->line_cb(framer->serial, framer->cb_data,
+				line, eol - line);
+		line = eol + 1;
+		scanned = 0;
+	}
+	if (framer->released)
+		return;
+
+	framer->len = end - line;
+	if (framer->len == sizeof(framer->buf)) {
+		sr_warn("Discarding %zu bytes without line delimiter.",
+			framer->len);
+		framer->len = 0;
+	} else if (line != framer->buf) {
+		memmove(framer->buf, line, framer->len);
+	}
+}
+
+static int ser_line_source_cb(int fd, int revents, void *cb_data)
+{
+	struct ser_line_framer *framer;
+	size_t scanned;
+	int rc, keep;
+
+	framer = cb_data;
+	framer->busy = TRUE;
+
+	while ((revents & G_IO_IN) && !framer->released) {
+		rc = serial_read_nonblocking(framer->serial,
+			framer->buf + framer->len,
+			sizeof(framer->buf) - framer->len);
+		if (rc <= 0)
+			break;
+		scanned = framer->len;
+		framer->len += rc;
+		ser_line_framer_split(framer, scanned);
+	}
+
+	keep = TRUE;
+	if (!framer->released && framer->cb)
+		keep = framer->cb(fd, revents, framer->cb_data);
+
+	framer->busy = FALSE;
+	if (framer->released) {
+		g_free(framer);
+		return FALSE;
+	}
+
+	return keep;
+}
+
+/**
+ * Add a source which splits received data into lines.
+ *
+ * Lines are delimited by CR or LF, and passed to the line callback without
+ * the delimiter. Empty lines are skipped, so CR/LF sequences yield a single
+ * line. The data gets read as it arrives, instead of polling for single
+ * bytes. The optional 'cb' then runs like the callback of
+ * serial_source_add(), e.g. to check limits upon timeouts.
+ *
+ * Both callbacks may remove the source. serial_source_remove() removes it.
+ *
+ * @param[in] session The session the source is added to.
+ * @param[in] serial Previously opened serial port instance.
+ * @param[in] timeout Timeout of the source in ms, as for serial_source_add().
+ * @param[in] line_cb Routine to call for every received line.
+ * @param[in] cb Routine to call after received data was processed, or NULL.
+ * @param[in] cb_data User data to pass to both callbacks.
+ *
+ * @private
+ */
+SR_PRIV int serial_line_source_add(struct sr_session *session,
+	struct sr_serial_dev_inst *serial, int timeout,
+	serial_line_callback line_cb, sr_receive_data_callback cb,
+	void *cb_data)
+{
+	struct ser_line_framer *framer;
+	int ret;
+
+	if (!serial || !line_cb)
+		return SR_ERR_ARG;
+
+	if (serial->line_framer) {
+		sr_err("Serial port %s already has a line source.", serial->port);
+		return SR_ERR_BUG;
+	}
+
+	framer = g_malloc0(sizeof(*framer));
+	framer->serial = serial;
+	framer->line_cb = line_cb;
+	framer->cb = cb;
+	framer->cb_data = cb_data;
+
+	ret = serial_source_add(session, serial, G_IO_IN, timeout,
+		ser_line_source_cb, framer);
+	if (ret != SR_OK) {
+		g_free(framer);
+		return ret;
+	}
+	serial->line_framer = framer;
+
+	return SR_OK;
+}
+
 /** @private */
 SR_PRIV int serial_source_add(struct sr_session *session,
 	struct sr_serial_dev_inst *serial, int events, int timeout,
@@ -999,6 +1366,11 @@ SR_PRIV int serial_source_remove(struct sr_session *session,
 		return SR_ERR_ARG;
 	}
 
+	ser_line_framer_release(serial);
+
+	if (serial->worker_port)
+		return serial_worker_source_remove(serial);
+
 	if (!serial->lib_funcs || !serial->lib_funcs->setup_source_remove)
 		return SR_ERR_NA;
 
@@ -21,6 +21,7 @@
 #include <glib.h>
 #include <libsigrok/libsigrok.h>
 #include "libsigrok-internal.h"
+#include <stdlib.h>
 #include <string.h>
 #include <memory.h>
 
@@ -104,6 +105,9 @@ static const char *conn_name_text(enum ser_bt_conn_t type)
  * @param[out] write_hdl The BLE notify write handle (if applicable).
  * @param[out] cccd_hdl The BLE notify CCCD handle (if applicable).
  * @param[out] cccd_val The BLE notify CCCD value (if applicable).
+ * @param[out] att_mtu The BLE ATT MTU to negotiate, -1 for the default.
+ * @param[out] conn_ival The BLE connection interval in 1.25ms units,
+ *   0 to keep the controller's choice.
  *
  * @return 0 upon success, non-zero upon failure.
  *
@@ -119,16 +123,19 @@ static const char *conn_name_text(enum ser_bt_conn_t type)
  * - The next field is the remote device's address, either separated
  *   by colons or dashes or spaces, or not separated at all.
  * - Other parameters (RFCOMM channel, notify handles and write values)
- *   get derived from the connection type. A future implementation may
- *   accept more fields, but the syntax is yet to get developed.
+ *   get derived from the connection type.
+ * - Optional "key=value" fields can follow for BLE connections: the ATT
+ *   MTU to negotiate (mtu=23..517, mtu=0 skips the exchange), and the
+ *   connection interval to request in milliseconds (interval=7.5..4000).
  *
  * Supported formats resulting from these rules:
- *   bt/<conn>/<addr>
+ *   bt/<conn>/<addr>[/mtu=<bytes>][/interval=<ms>]
  *
  * Examples:
  *   bt/rfcomm/11-22-33-44-55-66
  *   bt/ble122/88:6b:12:34:56:78
  *   bt/cc254x/0123456789ab
+ *   bt/nrf51/0123456789ab/mtu=247/interval=7.5
  *
  * It's assumed that users easily can create those conn= specs from
  * available information, or that scan routines will create such specs
@@ -140,11 +147,15 @@ static int ser_bt_parse_conn_spec(
 	enum ser_bt_conn_t *conn_type, const char **remote_addr,
 	size_t *rfcomm_channel,
 	uint16_t *read_hdl, uint16_t *write_hdl,
-	uint16_t *cccd_hdl, uint16_t *cccd_val)
+	uint16_t *cccd_hdl, uint16_t *cccd_val,
+	int *att_mtu, uint16_t *conn_ival)
 {
 	enum ser_bt_conn_t type;
 	const char *addr;
-	char **fields, *field;
+	char **fields, *field, *end;
+	size_t idx;
+	long mtu;
+	double ival_ms;
 
 	if (conn_type)
 		*conn_type = SER_BT_CONN_UNKNOWN;
@@ -160,6 +171,10 @@ static int ser_bt_parse_conn_spec(
 		*cccd_hdl = 0;
 	if (cccd_val)
 		*cccd_val = 0;
+	if (att_mtu)
+		*att_mtu = -1;
+	if (conn_ival)
+		*conn_ival = 0;
 
 	type = SER_BT_CONN_UNKNOWN;
 	addr = NULL;
@@ -244,7 +259,37 @@ static int ser_bt_parse_conn_spec(
 		return SR_ERR_ARG;
 	}
 
-	/* TODO Evaluate optionally trailing fields, override defaults? */
+	/* Evaluate optionally trailing fields, for BLE connections. */
+	for (idx = 3; fields[idx]; idx++) {
+		field = fields[idx];
+		if (type == SER_BT_CONN_RFCOMM) {
+			g_strfreev(fields);
+			return SR_ERR_ARG;
+		}
+		if (g_str_has_prefix(field, "mtu=")) {
+			mtu = strtol(field + strlen("mtu="), &end, 10);
+			if (end == field + strlen("mtu=") || *end ||
+					(mtu && (mtu < 23 || mtu > 517))) {
+				g_strfreev(fields);
+				return SR_ERR_ARG;
+			}
+			if (att_mtu)
+				*att_mtu = mtu;
+		} else if (g_str_has_prefix(field, "interval=")) {
+			ival_ms = g_ascii_strtod(field + strlen("interval="), &end);
+			if (end == field + strlen("interval=") || *end ||
+					ival_ms < 7.5 || ival_ms > 4000) {
+				g_strfreev(fields);
+				return SR_ERR_ARG;
+			}
+			if (conn_ival)
+				*conn_ival = (uint16_t)(ival_ms / 1.25 + 0.5);
+		} else {
+			sr_err("Unknown Bluetooth conn= field '%s'.", field);
+			g_strfreev(fields);
+			return SR_ERR_ARG;
+		}
+	}
 
 	g_strfreev(fields);
 	return SR_OK;
@@ -312,6 +357,8 @@ static int ser_bt_open(struct sr_serial_dev_inst *serial, int flags)
 	const char *remote_addr;
 	size_t rfcomm_channel;
 	uint16_t read_hdl, write_hdl, cccd_hdl, cccd_val;
+	int att_mtu;
+	uint16_t conn_ival;
 	int rc;
 	struct sr_bt_desc *desc;
 
@@ -322,7 +369,8 @@ static int ser_bt_open(struct sr_serial_dev_inst *serial, int flags)
 			&conn_type, &remote_addr,
 			&rfcomm_channel,
 			&read_hdl, &write_hdl,
-			&cccd_hdl, &cccd_val);
+			&cccd_hdl, &cccd_val,
+			&att_mtu, &conn_ival);
 	if (rc != SR_OK)
 		return SR_ERR_ARG;
 
@@ -354,6 +402,10 @@ static int ser_bt_open(struct sr_serial_dev_inst *serial, int flags)
 			read_hdl, write_hdl, cccd_hdl, cccd_val);
 		if (rc < 0)
 			return SR_ERR;
+		if (att_mtu >= 0 && sr_bt_config_mtu(desc, att_mtu) < 0)
+			return SR_ERR_ARG;
+		if (sr_bt_config_conn_interval(desc, conn_ival, conn_ival) < 0)
+			return SR_ERR_ARG;
 		serial->bt_notify_handle_read = read_hdl;
 		serial->bt_notify_handle_write = write_hdl;
 		serial->bt_notify_handle_cccd = cccd_hdl;
@@ -367,7 +419,7 @@ static int ser_bt_open(struct sr_serial_dev_inst *serial, int flags)
 
 	/* Make sure the receive buffer can accept input data. */
 	if (!serial->rcv_buffer)
-		serial->rcv_buffer = g_string_sized_new(SER_BT_CHUNK_SIZE);
+		sr_ser_alloc_rx_queue(serial, SER_BT_CHUNK_SIZE);
 	rc = sr_bt_config_cb_data(desc, ser_bt_data_cb, serial);
 	if (rc < 0)
 		return SR_ERR;
@@ -410,6 +410,42 @@ struct hidapi_source_args_t {
 	struct sr_serial_dev_inst *serial;
 };
 
+/*
+ * Read all reports which the chip has pending, waiting for the first
+ * one up to the timeout. The chip's read_bytes() unpacks each report's
+ * UART bytes right into the RX queue. Meters send few bytes per report,
+ * so draining them per wakeup saves many wakeups and main loop passes.
+ * Returns the number of received bytes, or a negative error code.
+ */
+static int ser_hid_read_reports(struct sr_serial_dev_inst *serial,
+	unsigned int timeout_ms)
+{
+	uint8_t bounce[SER_HID_CHUNK_SIZE], *buf;
+	size_t reports;
+	int rc, total;
+
+	total = 0;
+	for (reports = 0; reports < SER_HID_BATCH_REPORTS; reports++) {
+		buf = sr_ser_rx_queue_reserve(serial, sizeof(bounce));
+		if (!buf)
+			buf = bounce;
+		rc = serial->hid_chip_funcs->read_bytes(serial,
+				buf, sizeof(bounce), reports ? 0 : timeout_ms);
+		if (rc < 0)
+			return rc;
+		if (!rc)
+			break;
+		ser_hid_mask_databits(serial, buf, rc);
+		if (buf == bounce)
+			sr_ser_queue_rx_data(serial, bounce, rc);
+		else
+			sr_ser_rx_queue_commit(serial, rc);
+		total += rc;
+	}
+
+	return total;
+}
+
 /*
  * Gets periodically invoked by the glib main loop. "Drives" (checks)
  * progress of USB communication, and invokes the application's callback
@@ -419,25 +455,16 @@ struct hidapi_source_args_t {
 static int hidapi_source_cb(int fd, int revents, void *cb_data)
 {
 	struct hidapi_source_args_t *args;
-	uint8_t rx_buf[SER_HID_CHUNK_SIZE];
-	int rc;
 
 	args = cb_data;
 
 	/*
 	 * Drain receive data which the chip might have pending. This is
-	 * "a copy" of the "background part" of ser_hid_read(), without
-	 * the timeout support code, and not knowing how much data the
-	 * application is expecting.
+	 * the "background part" of ser_hid_read(), without the timeout
+	 * support code, and not knowing how much data the application
+	 * is expecting.
 	 */
-	do {
-		rc = args->serial->hid_chip_funcs->read_bytes(args->serial,
-				rx_buf, sizeof(rx_buf), 0);
-		if (rc > 0) {
-			ser_hid_mask_databits(args->serial, rx_buf, rc);
-			sr_ser_queue_rx_data(args->serial, rx_buf, rc);
-		}
-	} while (rc > 0);
+	ser_hid_read_reports(args->serial, 0);
 
 	/*
 	 * When RX data became available (now or earlier), pass this
@@ -447,9 +474,8 @@ static int hidapi_source_cb(int fd, int revents, void *cb_data)
 	 */
 	if (sr_ser_has_queued_data(args->serial))
 		revents |= G_IO_IN;
-	rc = args->cb(fd, revents, args->cb_data);
 
-	return rc;
+	return args->cb(fd, revents, args->cb_data);
 }
 
 #define WITH_MAXIMUM_TIMEOUT_VALUE	10
@@ -1114,7 +1140,7 @@ static int ser_hid_open(struct sr_serial_dev_inst *serial, int flags)
 	}
 
 	if (!serial->rcv_buffer)
-		serial->rcv_buffer = g_string_sized_new(SER_HID_CHUNK_SIZE);
+		sr_ser_alloc_rx_queue(serial, SER_HID_CHUNK_SIZE);
 
 	return SR_OK;
 }
@@ -1230,7 +1256,6 @@ static int ser_hid_read(struct sr_serial_dev_inst *serial,
 	int nonblocking, unsigned int timeout_ms)
 {
 	gint64 deadline_us, now_us;
-	uint8_t buffer[SER_HID_CHUNK_SIZE];
 	int rc;
 	unsigned int got;
 
@@ -1287,27 +1312,18 @@ static int ser_hid_read(struct sr_serial_dev_inst *serial,
 
 		/*
 		 * Check the HID transport for the availability of more
-		 * receive data.
+		 * receive data, and grab all reports which are pending.
 		 */
-		rc = serial->hid_chip_funcs->read_bytes(serial,
-				buffer, sizeof(buffer), timeout_ms);
+		rc = ser_hid_read_reports(serial, timeout_ms);
 		if (rc < 0) {
 			sr_dbg("DBG: %s() read error %d.", __func__, rc);
 			return SR_ERR;
 		}
-		if (rc) {
-			ser_hid_mask_databits(serial, buffer, rc);
-			sr_ser_queue_rx_data(serial, buffer, rc);
-		}
 		got = sr_ser_has_queued_data(serial);
 
 		/*
 		 * Stop reading when the requested amount is available,
 		 * or when the timeout has expired.
-		 *
-		 * TODO Consider whether grabbing all RX data is more
-		 * desirable. Implementing this approach requires a cheap
-		 * check for the availability of more data on the USB level.
 		 */
 		if (got >= count)
 			break;
@@ -37,6 +37,8 @@
  * WCH CH9325:    up to 7 bytes
  */
 #define SER_HID_CHUNK_SIZE	64
+/* Most reports to read per wakeup, ahead of passing their data on. */
+#define SER_HID_BATCH_REPORTS	64
 
 /*
  * Routines to get/set reports/data, provided by serial_hid.c and used
@@ -21,6 +21,9 @@
  */
 
 #include <config.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <glib.h>
 #include <libsigrok/libsigrok.h>
 #include "libsigrok-internal.h"
@@ -30,6 +33,10 @@
 #ifdef G_OS_WIN32
 #include <windows.h> /* for HANDLE */
 #endif
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <linux/serial.h> /* for ASYNC_LOW_LATENCY */
+#endif
 
 #define LOG_PREFIX "serial-libsp"
 
@@ -311,6 +318,104 @@ static int sr_ser_libsp_set_handshake(struct sr_serial_dev_inst *serial,
 	return SR_OK;
 }
 
+#ifdef __linux__
+/*
+ * USB serial adapters which support it (ftdi_sio) expose their latency
+ * timer in sysfs, below the tty's name. Resolve symlinks like those in
+ * /dev/serial/by-id/ to get that name.
+ */
+static int sr_ser_libsp_set_latency_timer(struct sr_serial_dev_inst *serial,
+	int latency_ms)
+{
+	char *path, *name, *sysfs;
+	FILE *f;
+	int ret;
+
+	path = realpath(serial->port, NULL);
+	name = g_path_get_basename(path ? path : serial->port);
+	free(path);
+	sysfs = g_strdup_printf("/sys/bus/usb-serial/devices/%s/latency_timer",
+		name);
+	g_free(name);
+
+	ret = SR_OK;
+	f = fopen(sysfs, "w");
+	if (!f || fprintf(f, "%d\n", latency_ms) < 0) {
+		sr_warn("Cannot set latency timer of %s: %s.",
+			serial->port, g_strerror(errno));
+		ret = SR_ERR_NA;
+	}
+	if (f && fclose(f) != 0 && ret == SR_OK) {
+		sr_warn("Cannot set latency timer of %s: %s.",
+			serial->port, g_strerror(errno));
+		ret = SR_ERR_NA;
+	}
+	g_free(sysfs);
+	if (ret == SR_OK)
+		sr_dbg("Latency timer of %s is %d ms.", serial->port, latency_ms);
+
+	return ret;
+}
+
+static int sr_ser_libsp_set_low_latency(struct sr_serial_dev_inst *serial,
+	int low_latency)
+{
+	struct serial_struct ss;
+	int fd;
+
+	if (sp_get_port_handle(serial->sp_data, &fd) != SP_OK)
+		return SR_ERR;
+
+	if (ioctl(fd, TIOCGSERIAL, &ss) < 0) {
+		sr_warn("Cannot get serial flags of %s: %s.",
+			serial->port, g_strerror(errno));
+		return SR_ERR_NA;
+	}
+	if (low_latency)
+		ss.flags |= ASYNC_LOW_LATENCY;
+	else
+		ss.flags &= ~ASYNC_LOW_LATENCY;
+	if (ioctl(fd, TIOCSSERIAL, &ss) < 0) {
+		sr_warn("Cannot set low latency mode of %s: %s.",
+			serial->port, g_strerror(errno));
+		return SR_ERR_NA;
+	}
+	sr_dbg("Low latency mode of %s is %s.", serial->port,
+		low_latency ? "on" : "off");
+
+	return SR_OK;
+}
+#endif
+
+static int sr_ser_libsp_set_latency(struct sr_serial_dev_inst *serial,
+	int latency_ms, int low_latency)
+{
+	int ret;
+
+	if (!serial->sp_data) {
+		sr_dbg("Cannot configure unopened serial port %s.", serial->port);
+		return SR_ERR;
+	}
+
+#ifdef __linux__
+	ret = SR_OK;
+	if (low_latency >= 0)
+		ret = sr_ser_libsp_set_low_latency(serial, low_latency);
+	/* The low latency flag might have changed the timer, so set it last. */
+	if (latency_ms >= 0 && ret == SR_OK)
+		ret = sr_ser_libsp_set_latency_timer(serial, latency_ms);
+
+	return ret;
+#else
+	(void)latency_ms;
+	(void)low_latency;
+	ret = SR_ERR_NA;
+	sr_warn("Cannot set latency of %s on this platform.", serial->port);
+
+	return ret;
+#endif
+}
+
 #ifdef G_OS_WIN32
 typedef HANDLE event_handle;
 #else
@@ -402,6 +507,15 @@ static int sr_ser_libsp_source_add(struct sr_session *session,
 		timeout, cb, cb_data);
 }
 
+static int sr_ser_libsp_get_poll_fd(struct sr_serial_dev_inst *serial,
+	int events, gintptr *fd, unsigned int *poll_events)
+{
+	void *key;
+
+	return sr_ser_libsp_source_add_int(serial, events,
+		&key, fd, poll_events);
+}
+
 static int sr_ser_libsp_source_remove(struct sr_session *session,
 	struct sr_serial_dev_inst *serial)
 {
@@ -526,8 +640,10 @@ static struct ser_lib_functions serlib_sp = {
 	.read = sr_ser_libsp_read,
 	.set_params = sr_ser_libsp_set_params,
 	.set_handshake = sr_ser_libsp_set_handshake,
+	.set_latency = sr_ser_libsp_set_latency,
 	.setup_source_add = sr_ser_libsp_source_add,
 	.setup_source_remove = sr_ser_libsp_source_remove,
+	.get_poll_fd = sr_ser_libsp_get_poll_fd,
 	.list = sr_ser_libsp_list,
 	.find_usb = sr_ser_libsp_find_usb,
 	.get_frame_format = sr_ser_libsp_get_frame_format,
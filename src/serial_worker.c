@@ -0,0 +1,605 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <glib.h>
+#if defined(HAVE_SYS_EPOLL_H) && defined(HAVE_SYS_EVENTFD_H)
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#define HAVE_SERIAL_WORKER 1
+#endif
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+#define LOG_PREFIX "serial-worker"
+
+#ifdef HAVE_SERIAL_COMM
+
+/**
+ * @file
+ *
+ * Serial port handling, shared I/O worker thread.
+ */
+
+/**
+ * @defgroup grp_serial_worker Serial port handling, worker thread
+ *
+ * Service many serial ports from a single thread.
+ *
+ * All ports which use serial_worker_source_add() are watched by one epoll
+ * set, on a worker thread which is shared by all sessions. The driver's
+ * callback runs on that thread, so reading and parsing of received data
+ * no longer wakes up the session's main loop. The packets which the
+ * callback sends are queued instead, and delivered on the session's
+ * thread when the callback returns. A session with many slow meters then
+ * gets a single wakeup per batch of finished packets.
+ *
+ * @{
+ */
+
+#ifdef HAVE_SERIAL_WORKER
+
+#define WORKER_EVENTS_MAX 64
+
+/** @cond PRIVATE */
+struct ser_worker {
+	GThread *thread;
+	int epfd;
+	/* Wakes up the thread, for stop requests and changed timeouts. */
+	int wakefd;
+	gint stop;
+	/* Held while callbacks run, protects the port list. */
+	GMutex mutex;
+	GSList *ports;
+};
+
+struct ser_worker_port {
+	struct sr_dev_inst *sdi;
+	struct sr_serial_dev_inst *serial;
+	sr_receive_data_callback cb;
+	gintptr fd;
+	unsigned int events;
+	int64_t timeout_us;
+	int64_t due_us;
+	unsigned int revents;
+	/* The port is no longer watched, after errors or a stop request. */
+	gboolean stopped;
+
+	struct sr_send_redirect redirect;
+	/* Packets sent by the callback, until the session delivers them. */
+	GMutex queue_mutex;
+	GQueue queue;
+	/* Queued packets or a stop request, only use atomic operations. */
+	gint pending;
+	gint stop_request;
+
+	GSource *source;
+	GMainContext *context;
+};
+
+struct posted_packet {
+	struct sr_datafeed_packet *packet;
+	int64_t timestamp;
+};
+
+struct worker_source {
+	GSource base;
+	struct ser_worker_port *port;
+	struct sr_session *session;
+};
+/** @endcond */
+
+/* The worker, created with the first port, and freed with the last. */
+static struct ser_worker *worker;
+static GMutex worker_lock;
+
+/* The port whose callback runs on the worker thread. */
+static GPrivate worker_current = G_PRIVATE_INIT(NULL);
+
+static void worker_wakeup(struct ser_worker *w)
+{
+	uint64_t value;
+
+	value = 1;
+	if (write(w->wakefd, &value, sizeof(value)) < 0 && errno != EAGAIN)
+		sr_dbg("Cannot wake up the serial worker: %s.", g_strerror(errno));
+}
+
+/* Runs on the worker thread, queues a packet for the session. */
+static int port_post(const struct sr_dev_inst *sdi,
+	const struct sr_datafeed_packet *packet, int64_t timestamp,
+	void *cb_data)
+{
+	struct ser_worker_port *port;
+	struct posted_packet *post;
+	struct sr_datafeed_packet *copy;
+	int ret;
+
+	(void)sdi;
+
+	port = cb_data;
+
+	ret = sr_packet_copy(packet, &copy);
+	if (ret != SR_OK)
+		return ret;
+
+	post = g_malloc(sizeof(*post));
+	post->packet = copy;
+	post->timestamp = timestamp;
+	g_mutex_lock(&port->queue_mutex);
+	g_queue_push_tail(&port->queue, post);
+	g_mutex_unlock(&port->queue_mutex);
+
+	return SR_OK;
+}
+
+/* Send the packets which the callback queued, on the session's thread. */
+static void port_deliver(struct ser_worker_port *port)
+{
+	struct posted_packet *post;
+	GQueue queue;
+
+	g_atomic_int_set(&port->pending, 0);
+	g_mutex_lock(&port->queue_mutex);
+	queue = port->queue;
+	g_queue_init(&port->queue);
+	g_mutex_unlock(&port->queue_mutex);
+
+	while ((post = g_queue_pop_head(&queue))) {
+		if (post->timestamp)
+			sr_session_send_timestamped(port->sdi, post->packet,
+				post->timestamp);
+		else
+			sr_session_send(port->sdi, post->packet);
+		sr_packet_free(post->packet);
+		g_free(post);
+	}
+}
+
+/* Stop watching a port, its source stops the acquisition. */
+static void port_stop(struct ser_worker *w, struct ser_worker_port *port)
+{
+	if (port->stopped)
+		return;
+
+	port->stopped = TRUE;
+	epoll_ctl(w->epfd, EPOLL_CTL_DEL, port->fd, NULL);
+	g_atomic_int_set(&port->stop_request, 1);
+}
+
+static void port_dispatch(struct ser_worker *w, struct ser_worker_port *port,
+	int64_t now)
+{
+	unsigned int revents;
+	gboolean keep;
+
+	revents = port->revents;
+	port->revents = 0;
+
+	if (revents & (G_IO_ERR | G_IO_HUP)) {
+		sr_err("Serial port %s failed, stopping.", port->serial->port);
+		port_stop(w, port);
+	} else {
+		g_private_set(&worker_current, port);
+		sr_session_send_redirect_set(&port->redirect);
+		keep = port->cb(port->fd, revents, port->sdi);
+		sr_session_send_redirect_set(NULL);
+		g_private_set(&worker_current, NULL);
+		if (!keep)
+			port_stop(w, port);
+	}
+	port->due_us = (port->timeout_us >= 0) ? now + port->timeout_us : -1;
+
+	if (port->stopped || !g_queue_is_empty(&port->queue)) {
+		g_atomic_int_set(&port->pending, 1);
+		g_main_context_wakeup(port->context);
+	}
+}
+
+/* Milliseconds until the earliest timeout of the ports, or -1. */
+static int worker_timeout(struct ser_worker *w, int64_t now)
+{
+	struct ser_worker_port *port;
+	int64_t due;
+	GSList *l;
+
+	due = -1;
+	for (l = w->ports; l; l = l->next) {
+		port = l->data;
+		if (port->stopped || port->due_us < 0)
+			continue;
+		if (due < 0 || port->due_us < due)
+			due = port->due_us;
+	}
+	if (due < 0)
+		return -1;
+	if (due <= now)
+		return 0;
+
+	return (due - now + 999) / 1000;
+}
+
+static gpointer worker_thread(gpointer data)
+{
+	struct ser_worker *w;
+	struct ser_worker_port *port;
+	struct epoll_event events[WORKER_EVENTS_MAX];
+	uint64_t value;
+	int64_t now;
+	GSList *l;
+	int i, num_events, timeout;
+
+	w = data;
+
+	while (!g_atomic_int_get(&w->stop)) {
+		g_mutex_lock(&w->mutex);
+		timeout = worker_timeout(w, g_get_monotonic_time());
+		g_mutex_unlock(&w->mutex);
+
+		num_events = epoll_wait(w->epfd, events,
+			WORKER_EVENTS_MAX, timeout);
+		if (num_events < 0) {
+			if (errno == EINTR)
+				continue;
+			sr_err("Cannot wait for serial port events: %s.",
+				g_strerror(errno));
+			break;
+		}
+
+		g_mutex_lock(&w->mutex);
+		for (i = 0; i < num_events; i++) {
+			port = events[i].data.ptr;
+			if (!port) {
+				while (read(w->wakefd, &value, sizeof(value)) > 0)
+					;
+				continue;
+			}
+			/* The port might have gone while we waited. */
+			if (!g_slist_find(w->ports, port))
+				continue;
+			port->revents = events[i].events
+				& (G_IO_IN | G_IO_PRI | G_IO_OUT | G_IO_ERR | G_IO_HUP);
+		}
+		now = g_get_monotonic_time();
+		for (l = w->ports; l; l = l->next) {
+			port = l->data;
+			if (port->stopped)
+				continue;
+			if (port->revents || (port->due_us >= 0 && now >= port->due_us))
+				port_dispatch(w, port, now);
+		}
+		g_mutex_unlock(&w->mutex);
+	}
+
+	return NULL;
+}
+
+static struct ser_worker *worker_ref(void)
+{
+	struct ser_worker *w;
+	struct epoll_event event;
+	GError *error;
+
+	if (worker)
+		return worker;
+
+	w = g_malloc0(sizeof(*w));
+	g_mutex_init(&w->mutex);
+	w->epfd = epoll_create1(EPOLL_CLOEXEC);
+	w->wakefd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (w->epfd < 0 || w->wakefd < 0) {
+		sr_err("Cannot create serial worker descriptors: %s.",
+			g_strerror(errno));
+		goto err;
+	}
+	memset(&event, 0, sizeof(event));
+	event.events = EPOLLIN;
+	event.data.ptr = NULL;
+	if (epoll_ctl(w->epfd, EPOLL_CTL_ADD, w->wakefd, &event) < 0) {
+		sr_err("Cannot watch the serial worker's wakeup: %s.",
+			g_strerror(errno));
+		goto err;
+	}
+
+	error = NULL;
+	w->thread = g_thread_try_new("serial-worker", worker_thread, w, &error);
+	if (!w->thread) {
+		sr_err("Cannot start the serial worker thread: %s.",
+			error->message);
+		g_error_free(error);
+		goto err;
+	}
+	worker = w;
+
+	return w;
+
+err:
+	if (w->wakefd >= 0)
+		close(w->wakefd);
+	if (w->epfd >= 0)
+		close(w->epfd);
+	g_mutex_clear(&w->mutex);
+	g_free(w);
+
+	return NULL;
+}
+
+/* Stop the worker thread when the last port is gone. */
+static void worker_unref(void)
+{
+	struct ser_worker *w;
+
+	w = worker;
+	if (!w || w->ports)
+		return;
+
+	worker = NULL;
+	g_atomic_int_set(&w->stop, 1);
+	worker_wakeup(w);
+	g_thread_join(w->thread);
+	close(w->wakefd);
+	close(w->epfd);
+	g_mutex_clear(&w->mutex);
+	g_free(w);
+}
+
+static gboolean worker_source_prepare(GSource *source, int *timeout)
+{
+	struct ser_worker_port *port;
+
+	port = ((struct worker_source *)source)->port;
+	*timeout = -1;
+
+	return g_atomic_int_get(&port->pending);
+}
+
+static gboolean worker_source_check(GSource *source)
+{
+	struct ser_worker_port *port;
+
+	port = ((struct worker_source *)source)->port;
+
+	return g_atomic_int_get(&port->pending);
+}
+
+static gboolean worker_source_dispatch(GSource *source,
+	GSourceFunc callback, void *user_data)
+{
+	struct ser_worker_port *port;
+
+	(void)callback;
+	(void)user_data;
+
+	port = ((struct worker_source *)source)->port;
+
+	port_deliver(port);
+	if (g_atomic_int_get(&port->stop_request)) {
+		g_atomic_int_set(&port->stop_request, 0);
+		/* This usually removes the port, don't touch it afterwards. */
+		sr_dev_acquisition_stop(port->sdi);
+	}
+
+	return G_SOURCE_CONTINUE;
+}
+
+static void worker_source_finalize(GSource *source)
+{
+	struct worker_source *wsource;
+
+	wsource = (struct worker_source *)source;
+	sr_session_source_destroyed(wsource->session, wsource->port, source);
+}
+
+/**
+ * Service a serial port on the shared worker thread.
+ *
+ * The callback runs on the worker thread when data was received, or when
+ * 'timeout' ms have passed without data (with revents set to 0), like
+ * the callback of serial_source_add(). Packets which the callback sends
+ * get queued, and are delivered on the session's thread when it returns.
+ * The callback must not call other session routines, or stop the
+ * acquisition itself. It returns FALSE to request that the acquisition
+ * gets stopped, which then happens on the session's thread.
+ *
+ * serial_source_remove() removes the port again, after delivering queued
+ * packets.
+ *
+ * @param[in] sdi The device instance which the callback gets as cb_data.
+ * @param[in] serial Previously opened serial port instance.
+ * @param[in] timeout Timeout of the callback in ms, or -1 for none.
+ * @param[in] cb Routine to call on the worker thread.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_NA The port cannot be watched by the worker, use
+ *                   serial_source_add() instead.
+ *
+ * @private
+ */
+SR_PRIV int serial_worker_source_add(struct sr_dev_inst *sdi,
+	struct sr_serial_dev_inst *serial, int timeout,
+	sr_receive_data_callback cb)
+{
+	static GSourceFuncs worker_source_funcs = {
+		.prepare  = &worker_source_prepare,
+		.check    = &worker_source_check,
+		.dispatch = &worker_source_dispatch,
+		.finalize = &worker_source_finalize
+	};
+	struct ser_worker *w;
+	struct ser_worker_port *port;
+	struct worker_source *wsource;
+	struct epoll_event event;
+	gintptr fd;
+	unsigned int events;
+	int ret;
+
+	if (!sdi || !sdi->session || !serial || !cb)
+		return SR_ERR_ARG;
+
+	if (serial->worker_port) {
+		sr_err("Serial port %s already has a worker source.", serial->port);
+		return SR_ERR_BUG;
+	}
+
+	if (!serial->lib_funcs || !serial->lib_funcs->get_poll_fd)
+		return SR_ERR_NA;
+	ret = serial->lib_funcs->get_poll_fd(serial, G_IO_IN | G_IO_ERR,
+		&fd, &events);
+	if (ret != SR_OK)
+		return SR_ERR_NA;
+
+	port = g_malloc0(sizeof(*port));
+	port->sdi = sdi;
+	port->serial = serial;
+	port->cb = cb;
+	port->fd = fd;
+	port->events = events;
+	port->timeout_us = (timeout >= 0) ? (int64_t)timeout * 1000 : -1;
+	port->redirect.send = port_post;
+	port->redirect.cb_data = port;
+	g_mutex_init(&port->queue_mutex);
+	g_queue_init(&port->queue);
+
+	port->source = g_source_new(&worker_source_funcs, sizeof(*wsource));
+	wsource = (struct worker_source *)port->source;
+	wsource->port = port;
+	wsource->session = sdi->session;
+	g_source_set_name(port->source, "serial-worker");
+	ret = sr_session_source_add_internal(sdi->session, port, port->source);
+	if (ret != SR_OK) {
+		g_source_unref(port->source);
+		g_mutex_clear(&port->queue_mutex);
+		g_free(port);
+		return ret;
+	}
+	port->context = g_main_context_ref(g_source_get_context(port->source));
+
+	g_mutex_lock(&worker_lock);
+	w = worker_ref();
+	if (w) {
+		memset(&event, 0, sizeof(event));
+		event.events = events
+			& (G_IO_IN | G_IO_PRI | G_IO_OUT | G_IO_ERR | G_IO_HUP);
+		event.data.ptr = port;
+		g_mutex_lock(&w->mutex);
+		if (epoll_ctl(w->epfd, EPOLL_CTL_ADD, fd, &event) == 0) {
+			port->due_us = (port->timeout_us >= 0)
+				? g_get_monotonic_time() + port->timeout_us : -1;
+			w->ports = g_slist_append(w->ports, port);
+		} else {
+			sr_dbg("Cannot watch %s via epoll: %s.",
+				serial->port, g_strerror(errno));
+		}
+		g_mutex_unlock(&w->mutex);
+	}
+	if (!w || !g_slist_find(w->ports, port)) {
+		if (w)
+			worker_unref();
+		g_mutex_unlock(&worker_lock);
+		sr_session_source_remove_internal(sdi->session, port);
+		g_source_unref(port->source);
+		g_main_context_unref(port->context);
+		g_mutex_clear(&port->queue_mutex);
+		g_free(port);
+		return SR_ERR_NA;
+	}
+	/* Have the thread pick up the port's timeout. */
+	worker_wakeup(w);
+	g_mutex_unlock(&worker_lock);
+
+	serial->worker_port = port;
+	sr_dbg("Serial port %s is serviced by the worker thread.", serial->port);
+
+	return SR_OK;
+}
+
+/**
+ * Remove the worker source of a serial port, if it has one.
+ *
+ * Waits for a running callback of the port, and delivers the packets it
+ * queued. Must not be called from the worker thread.
+ *
+ * @private
+ */
+SR_PRIV int serial_worker_source_remove(struct sr_serial_dev_inst *serial)
+{
+	struct ser_worker *w;
+	struct ser_worker_port *port;
+	struct sr_session *session;
+
+	if (!serial || !(port = serial->worker_port))
+		return SR_OK;
+
+	if (g_private_get(&worker_current)) {
+		sr_err("Cannot remove a serial worker source from its callback.");
+		return SR_ERR_BUG;
+	}
+
+	g_mutex_lock(&worker_lock);
+	w = worker;
+	g_mutex_lock(&w->mutex);
+	if (!port->stopped)
+		epoll_ctl(w->epfd, EPOLL_CTL_DEL, port->fd, NULL);
+	w->ports = g_slist_remove(w->ports, port);
+	g_mutex_unlock(&w->mutex);
+	worker_unref();
+	g_mutex_unlock(&worker_lock);
+	serial->worker_port = NULL;
+
+	/* Packets of the last callback precede the end of the acquisition. */
+	port_deliver(port);
+
+	session = port->sdi->session;
+	sr_session_source_remove_internal(session, port);
+	g_source_unref(port->source);
+	g_main_context_unref(port->context);
+	g_mutex_clear(&port->queue_mutex);
+	g_free(port);
+
+	return SR_OK;
+}
+
+#else
+
+SR_PRIV int serial_worker_source_add(struct sr_dev_inst *sdi,
+	struct sr_serial_dev_inst *serial, int timeout,
+	sr_receive_data_callback cb)
+{
+	(void)sdi;
+	(void)serial;
+	(void)timeout;
+	(void)cb;
+
+	return SR_ERR_NA;
+}
+
+SR_PRIV int serial_worker_source_remove(struct sr_serial_dev_inst *serial)
+{
+	(void)serial;
+
+	return SR_OK;
+}
+
+#endif
+
+/** @} */
+
+#endif
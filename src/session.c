@@ -25,6 +25,9 @@
 #include <unistd.h>
 #include <string.h>
 #include <glib.h>
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif
 #include <libsigrok/libsigrok.h>
 #include "libsigrok-internal.h"
 
@@ -48,8 +51,56 @@
 
 struct datafeed_callback {
 	sr_datafeed_callback cb;
+	/* Used instead of cb for callbacks which accept batches. */
+	sr_datafeed_batch_callback batch_cb;
 	void *cb_data;
+	/* Whether the callback may run concurrently with other callbacks. */
+	gboolean thread_safe;
+	/* Number of packets and time spent in the current or last run. */
+	uint64_t calls;
+	uint64_t time_us;
+	/* Arguments of the pending invocation on the callback pool. */
+	const struct sr_dev_inst *sdi;
+	const struct sr_datafeed_packet *packet;
+	gpointer dispatched;
+};
+
+static int dispatch_start(struct sr_session *session);
+static void dispatch_stop(struct sr_session *session);
+static void stats_reset(struct sr_session *session);
+static unsigned int main_source_attach(struct sr_session *session,
+		GSource *source);
+static gboolean buffer_contains(const struct sr_packet_buffer *buf,
+		const void *data, size_t size);
+static void writable_packet_free(struct writable_packet *wp);
+
+/* The packet which the dispatch thread currently passes to callbacks. */
+static GPrivate dispatch_current = G_PRIVATE_INIT(NULL);
+
+/* The packets retained by sr_packet_ref() which are not released yet. */
+static GMutex packet_refs_mutex;
+static GHashTable *packet_refs;
+
+/* The main context of the device thread which is running, if any. */
+static GPrivate dev_thread_context = G_PRIVATE_INIT(NULL);
+
+/* Where packets sent by the current thread go instead of the bus. */
+static GPrivate send_redirect = G_PRIVATE_INIT(NULL);
+
+/** @cond PRIVATE */
+struct dev_thread {
+	struct sr_session *session;
+	struct sr_dev_inst *sdi;
+	GMainContext *context;
+	GMainLoop *loop;
+	GThread *thread;
+	/* Result of starting the acquisition, valid once started is set. */
+	int start_ret;
+	gboolean started;
+	GMutex mutex;
+	GCond cond;
 };
+/** @endcond */
 
 /** Custom GLib event source for generic descriptor I/O.
  * @see https://developer.gnome.org/glib/stable/glib-The-Main-Event-Loop.html
@@ -65,7 +116,224 @@ struct fd_source {
 	void *key;
 
 	GPollFD pollfd;
+	/* Whether the descriptor is watched by the session's epoll set. */
+	gboolean epoll;
+};
+
+#ifdef HAVE_SYS_EPOLL_H
+/** @cond PRIVATE */
+/*
+ * Source which polls the epoll descriptor of a session, and wakes up the
+ * fd sources whose descriptors are ready. Those sources then have no
+ * prepare() and check() methods, and rely on their ready time instead.
+ */
+struct epoll_source {
+	GSource base;
+	GPollFD pollfd;
+	/* Protects the epoll set against finalizing fd sources. */
+	GMutex mutex;
 };
+/** @endcond */
+
+#define EPOLL_EVENTS_MAX 64
+
+/* Bytes of logic data per pass of fused transforms, fits the L1 cache. */
+#define FUSED_BLOCK_SIZE (16 * 1024)
+
+/* Batches up to this many packets keep their send context on the stack. */
+#define BATCH_STACK_PACKETS 32
+
+static gboolean epoll_source_check(GSource *source)
+{
+	struct epoll_source *esource;
+
+	esource = (struct epoll_source *)source;
+
+	return esource->pollfd.revents != 0;
+}
+
+static gboolean epoll_source_dispatch(GSource *source,
+		GSourceFunc callback, void *user_data)
+{
+	struct epoll_source *esource;
+	struct epoll_event events[EPOLL_EVENTS_MAX];
+	struct fd_source *fsource;
+	int i, num_events;
+
+	(void)callback;
+	(void)user_data;
+
+	esource = (struct epoll_source *)source;
+
+	g_mutex_lock(&esource->mutex);
+	num_events = epoll_wait(esource->pollfd.fd, events,
+		EPOLL_EVENTS_MAX, 0);
+	for (i = 0; i < num_events; i++) {
+		fsource = events[i].data.ptr;
+		if (!fsource)
+			continue;
+		/* The EPOLL* flags match the poll() flags used by GLib. */
+		fsource->pollfd.revents = events[i].events
+			& (G_IO_IN | G_IO_PRI | G_IO_OUT | G_IO_ERR | G_IO_HUP);
+		g_source_set_ready_time(&fsource->base, 0);
+	}
+	g_mutex_unlock(&esource->mutex);
+
+	return G_SOURCE_CONTINUE;
+}
+
+static void epoll_source_finalize(GSource *source)
+{
+	struct epoll_source *esource;
+
+	esource = (struct epoll_source *)source;
+
+	close(esource->pollfd.fd);
+	g_mutex_clear(&esource->mutex);
+}
+
+/* Create the epoll source of a session, and attach it to its main context. */
+static struct epoll_source *epoll_source_get(struct sr_session *session)
+{
+	static GSourceFuncs epoll_source_funcs = {
+		.check    = &epoll_source_check,
+		.dispatch = &epoll_source_dispatch,
+		.finalize = &epoll_source_finalize
+	};
+	GSource *source;
+	struct epoll_source *esource;
+	int epfd;
+
+	if (session->epoll_source)
+		return session->epoll_source;
+
+	epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (epfd < 0) {
+		sr_err("Cannot create epoll descriptor: %s.", g_strerror(errno));
+		return NULL;
+	}
+
+	source = g_source_new(&epoll_source_funcs, sizeof(struct epoll_source));
+	esource = (struct epoll_source *)source;
+	g_source_set_name(source, "epoll");
+	g_mutex_init(&esource->mutex);
+	esource->pollfd.fd = epfd;
+	esource->pollfd.events = G_IO_IN;
+	esource->pollfd.revents = 0;
+	g_source_add_poll(source, &esource->pollfd);
+
+	/* Not an event source of the acquisition, don't register it. */
+	if (main_source_attach(session, source) == 0) {
+		g_source_unref(source);
+		return NULL;
+	}
+	session->epoll_source = esource;
+
+	return esource;
+}
+
+static void epoll_source_free(struct sr_session *session)
+{
+	if (!session->epoll_source)
+		return;
+
+	g_source_destroy(&session->epoll_source->base);
+	g_source_unref(&session->epoll_source->base);
+	session->epoll_source = NULL;
+}
+
+static int epoll_source_ctl(struct epoll_source *esource, int op,
+		gintptr fd, int events, struct fd_source *fsource)
+{
+	struct epoll_event event;
+	int ret;
+
+	memset(&event, 0, sizeof(event));
+	event.events = events
+		& (G_IO_IN | G_IO_PRI | G_IO_OUT | G_IO_ERR | G_IO_HUP);
+	event.data.ptr = fsource;
+
+	g_mutex_lock(&esource->mutex);
+	ret = epoll_ctl(esource->pollfd.fd, op, fd, &event);
+	g_mutex_unlock(&esource->mutex);
+
+	return ret;
+}
+
+/*
+ * Add a descriptor to the session's epoll set. It is not associated to
+ * an fd source yet, see epoll_source_set_fd_source().
+ */
+static gboolean epoll_source_add_fd(struct sr_session *session,
+		gintptr fd, int events)
+{
+	struct epoll_source *esource;
+
+	esource = epoll_source_get(session);
+	if (!esource)
+		return FALSE;
+
+	if (epoll_source_ctl(esource, EPOLL_CTL_ADD, fd, events, NULL) < 0) {
+		/* E.g. regular files cannot be watched via epoll. */
+		sr_dbg("Cannot watch fd %d via epoll: %s.",
+			(int)fd, g_strerror(errno));
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static void epoll_source_set_fd_source(struct sr_session *session,
+		struct fd_source *fsource)
+{
+	epoll_source_ctl(session->epoll_source, EPOLL_CTL_MOD,
+		fsource->pollfd.fd, fsource->pollfd.events, fsource);
+}
+
+static void epoll_source_remove_fd(struct sr_session *session,
+		struct fd_source *fsource)
+{
+	struct epoll_source *esource;
+
+	esource = session->epoll_source;
+	if (!esource)
+		return;
+
+	g_mutex_lock(&esource->mutex);
+	epoll_ctl(esource->pollfd.fd, EPOLL_CTL_DEL, fsource->pollfd.fd, NULL);
+	g_mutex_unlock(&esource->mutex);
+}
+#endif
+
+/** FD event source dispatch() method for sources without prepare() and
+ * check(), i.e. those which are woken up by their ready time.
+ */
+static gboolean fd_source_dispatch_ready(GSource *source,
+		GSourceFunc callback, void *user_data)
+{
+	struct fd_source *fsource;
+	unsigned int revents;
+	gboolean keep;
+
+	fsource = (struct fd_source *)source;
+	revents = fsource->pollfd.revents;
+	fsource->pollfd.revents = 0;
+
+	if (!callback) {
+		sr_err("Callback not set, cannot dispatch event.");
+		return G_SOURCE_REMOVE;
+	}
+	SR_PROBE2(receive_entry, fsource->pollfd.fd, revents);
+	keep = (*SR_RECEIVE_DATA_CALLBACK(callback))
+			(fsource->pollfd.fd, revents, user_data);
+	SR_PROBE2(receive_return, fsource->pollfd.fd, keep);
+
+	if (G_LIKELY(keep) && G_LIKELY(!g_source_is_destroyed(source)))
+		g_source_set_ready_time(source, (fsource->timeout_us >= 0)
+			? g_source_get_time(source) + fsource->timeout_us : -1);
+
+	return keep;
+}
 
 /** FD event source prepare() method.
  * This is called immediately before poll().
@@ -126,8 +394,10 @@ static gboolean fd_source_dispatch(GSource *source,
 		sr_err("Callback not set, cannot dispatch event.");
 		return G_SOURCE_REMOVE;
 	}
+	SR_PROBE2(receive_entry, fsource->pollfd.fd, revents);
 	keep = (*SR_RECEIVE_DATA_CALLBACK(callback))
 			(fsource->pollfd.fd, revents, user_data);
+	SR_PROBE2(receive_return, fsource->pollfd.fd, keep);
 
 	if (fsource->timeout_us >= 0 && G_LIKELY(keep)
 			&& G_LIKELY(!g_source_is_destroyed(source)))
@@ -146,6 +416,11 @@ static void fd_source_finalize(GSource *source)
 
 	sr_dbg("%s: key %p", __func__, fsource->key);
 
+#ifdef HAVE_SYS_EPOLL_H
+	if (fsource->epoll)
+		epoll_source_remove_fd(fsource->session, fsource);
+#endif
+
 	sr_session_source_destroyed(fsource->session, fsource->key, source);
 }
 
@@ -171,10 +446,31 @@ static GSource *fd_source_new(struct sr_session *session, void *key,
 		.dispatch = &fd_source_dispatch,
 		.finalize = &fd_source_finalize
 	};
+	static GSourceFuncs fd_source_ready_funcs = {
+		.dispatch = &fd_source_dispatch_ready,
+		.finalize = &fd_source_finalize
+	};
 	GSource *source;
 	struct fd_source *fsource;
+	gboolean ready, epoll;
+
+	/*
+	 * With the epoll backend, descriptors are watched by the session's
+	 * epoll set, and timers only use the ready time. Descriptors which
+	 * epoll does not support get polled the default way.
+	 */
+	ready = FALSE;
+	epoll = FALSE;
+	if (session->event_backend == SR_EVENT_BACKEND_EPOLL) {
+#ifdef HAVE_SYS_EPOLL_H
+		if (fd >= 0)
+			epoll = epoll_source_add_fd(session, fd, events);
+#endif
+		ready = (fd < 0) || epoll;
+	}
 
-	source = g_source_new(&fd_source_funcs, sizeof(struct fd_source));
+	source = g_source_new(ready ? &fd_source_ready_funcs : &fd_source_funcs,
+		sizeof(struct fd_source));
 	fsource = (struct fd_source *)source;
 
 	g_source_set_name(source, (fd < 0) ? "timer" : "fd");
@@ -193,8 +489,18 @@ static GSource *fd_source_new(struct sr_session *session, void *key,
 	fsource->pollfd.events = events;
 	fsource->pollfd.revents = 0;
 
-	if (fd >= 0)
+	if (ready) {
+		fsource->epoll = epoll;
+#ifdef HAVE_SYS_EPOLL_H
+		if (epoll)
+			epoll_source_set_fd_source(session, fsource);
+#endif
+		if (fsource->timeout_us >= 0)
+			g_source_set_ready_time(source,
+				g_get_monotonic_time() + fsource->timeout_us);
+	} else if (fd >= 0) {
 		g_source_add_poll(source, &fsource->pollfd);
+	}
 
 	return source;
 }
@@ -223,8 +529,16 @@ SR_API int sr_session_new(struct sr_context *ctx,
 	session = g_malloc0(sizeof(struct sr_session));
 
 	session->ctx = ctx;
+	session->dispatch_policy = SR_DISPATCH_BLOCK;
+	session->event_backend = SR_EVENT_BACKEND_GLIB;
 
 	g_mutex_init(&session->main_mutex);
+	g_mutex_init(&session->send_mutex);
+	g_mutex_init(&session->pool_mutex);
+	g_cond_init(&session->pool_cond);
+	g_mutex_init(&session->trace_mutex);
+	g_mutex_init(&session->sources_mutex);
+	g_rec_mutex_init(&session->bus_mutex);
 
 	/* To maintain API compatibility, we need a lookup table
 	 * which maps poll_object IDs to GSource* pointers.
@@ -254,13 +568,29 @@ SR_API int sr_session_destroy(struct sr_session *session)
 		return SR_ERR_ARG;
 	}
 
+	dispatch_stop(session);
+
 	sr_session_dev_remove_all(session);
 	g_slist_free_full(session->owned_devs, (GDestroyNotify)sr_dev_inst_free);
 
 	sr_session_datafeed_callback_remove_all(session);
+	sr_session_callback_threads_set(session, 0);
+
+	sr_session_send_buffer_set(session, NULL);
+	g_free(session->trace);
+	writable_packet_free(session->writable);
+#ifdef HAVE_SYS_EPOLL_H
+	epoll_source_free(session);
+#endif
 
 	g_hash_table_unref(session->event_sources);
 
+	g_rec_mutex_clear(&session->bus_mutex);
+	g_mutex_clear(&session->sources_mutex);
+	g_mutex_clear(&session->trace_mutex);
+	g_cond_clear(&session->pool_cond);
+	g_mutex_clear(&session->pool_mutex);
+	g_mutex_clear(&session->send_mutex);
 	g_mutex_clear(&session->main_mutex);
 
 	g_free(session);
@@ -467,6 +797,34 @@ SR_API int sr_session_datafeed_callback_remove_all(struct sr_session *session)
 	return SR_OK;
 }
 
+static int datafeed_callback_add(struct sr_session *session,
+		sr_datafeed_callback cb, sr_datafeed_batch_callback batch_cb,
+		void *cb_data, gboolean thread_safe)
+{
+	struct datafeed_callback *cb_struct;
+
+	if (!session) {
+		sr_err("%s: session was NULL", __func__);
+		return SR_ERR_BUG;
+	}
+
+	if (!cb && !batch_cb) {
+		sr_err("%s: cb was NULL", __func__);
+		return SR_ERR_ARG;
+	}
+
+	cb_struct = g_malloc0(sizeof(struct datafeed_callback));
+	cb_struct->cb = cb;
+	cb_struct->batch_cb = batch_cb;
+	cb_struct->cb_data = cb_data;
+	cb_struct->thread_safe = thread_safe;
+
+	session->datafeed_callbacks =
+	    g_slist_append(session->datafeed_callbacks, cb_struct);
+
+	return SR_OK;
+}
+
 /**
  * Add a datafeed callback to a session.
  *
@@ -482,25 +840,147 @@ SR_API int sr_session_datafeed_callback_remove_all(struct sr_session *session)
  */
 SR_API int sr_session_datafeed_callback_add(struct sr_session *session,
 		sr_datafeed_callback cb, void *cb_data)
+{
+	return datafeed_callback_add(session, cb, NULL, cb_data, FALSE);
+}
+
+/**
+ * Add a datafeed callback to a session, which accepts batches of packets.
+ *
+ * Drivers may send several packets at once, which are then passed to
+ * the callback in one call, in order. Single packets are passed as a
+ * batch of one.
+ *
+ * @param session The session to use. Must not be NULL.
+ * @param cb Function to call when chunks of data are received.
+ *           Must not be NULL.
+ * @param cb_data Opaque pointer passed in by the caller.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_BUG No session exists.
+ * @retval SR_ERR_ARG Invalid argument.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_datafeed_batch_callback_add(struct sr_session *session,
+		sr_datafeed_batch_callback cb, void *cb_data)
+{
+	if (!cb) {
+		sr_err("%s: cb was NULL", __func__);
+		return SR_ERR_ARG;
+	}
+
+	return datafeed_callback_add(session, NULL, cb, cb_data, FALSE);
+}
+
+/**
+ * Add a thread-safe datafeed callback to a session.
+ *
+ * Same as sr_session_datafeed_callback_add(), but the callback may run
+ * on a worker thread, concurrently with the other thread-safe callbacks
+ * of the session, see sr_session_callback_threads_set(). All callbacks
+ * have returned before the next packet gets sent.
+ *
+ * @param session The session to use. Must not be NULL.
+ * @param cb Function to call when a chunk of data is received.
+ *           Must not be NULL.
+ * @param cb_data Opaque pointer passed in by the caller.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_BUG No session exists.
+ * @retval SR_ERR_ARG Invalid argument.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_datafeed_callback_add_thread_safe(
+		struct sr_session *session, sr_datafeed_callback cb,
+		void *cb_data)
+{
+	return datafeed_callback_add(session, cb, NULL, cb_data, TRUE);
+}
+
+static void call_datafeed_callback(struct datafeed_callback *cb_struct,
+		const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet)
+{
+	gint64 start;
+
+	SR_PROBE2(callback_entry, cb_struct->cb_data, packet->type);
+	start = g_get_monotonic_time();
+	if (cb_struct->batch_cb)
+		cb_struct->batch_cb(sdi, packet, 1, cb_struct->cb_data);
+	else
+		cb_struct->cb(sdi, packet, cb_struct->cb_data);
+	cb_struct->time_us += g_get_monotonic_time() - start;
+	SR_PROBE1(callback_return, cb_struct->cb_data);
+	cb_struct->calls++;
+}
+
+static void callback_pool_run(gpointer data, gpointer user_data)
 {
 	struct datafeed_callback *cb_struct;
+	struct sr_session *session;
+
+	cb_struct = data;
+	session = user_data;
+
+	g_private_set(&dispatch_current, cb_struct->dispatched);
+	call_datafeed_callback(cb_struct, cb_struct->sdi, cb_struct->packet);
+	g_private_set(&dispatch_current, NULL);
+
+	g_mutex_lock(&session->pool_mutex);
+	if (--session->pool_pending == 0)
+		g_cond_signal(&session->pool_cond);
+	g_mutex_unlock(&session->pool_mutex);
+}
+
+/**
+ * Set the number of worker threads for thread-safe datafeed callbacks.
+ *
+ * With worker threads, each packet is passed to all callbacks which
+ * were added by sr_session_datafeed_callback_add_thread_safe() in
+ * parallel, while the other callbacks run in the sending thread as
+ * usual. Without worker threads, all callbacks run one after another.
+ *
+ * @param session The session to use. Must not be NULL.
+ * @param num_threads The number of worker threads, 0 to disable.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid session passed.
+ * @retval SR_ERR The session is running, or the threads could not be
+ *                created.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_callback_threads_set(struct sr_session *session,
+		unsigned int num_threads)
+{
+	GError *error;
 
 	if (!session) {
 		sr_err("%s: session was NULL", __func__);
-		return SR_ERR_BUG;
-	}
-
-	if (!cb) {
-		sr_err("%s: cb was NULL", __func__);
 		return SR_ERR_ARG;
 	}
+	if (session->running) {
+		sr_err("Cannot change callback threads while the session is running.");
+		return SR_ERR;
+	}
 
-	cb_struct = g_malloc0(sizeof(struct datafeed_callback));
-	cb_struct->cb = cb;
-	cb_struct->cb_data = cb_data;
+	if (session->callback_pool) {
+		g_thread_pool_free(session->callback_pool, FALSE, TRUE);
+		session->callback_pool = NULL;
+	}
+	if (!num_threads)
+		return SR_OK;
 
-	session->datafeed_callbacks =
-	    g_slist_append(session->datafeed_callbacks, cb_struct);
+	error = NULL;
+	session->callback_pool = g_thread_pool_new(callback_pool_run,
+			session, num_threads, TRUE, &error);
+	if (!session->callback_pool) {
+		sr_err("Cannot create callback threads: %s.", error->message);
+		g_error_free(error);
+		return SR_ERR;
+	}
 
 	return SR_OK;
 }
@@ -654,7 +1134,7 @@ static int unset_main_context(struct sr_session *session)
 	return ret;
 }
 
-static unsigned int session_source_attach(struct sr_session *session,
+static unsigned int main_source_attach(struct sr_session *session,
 		GSource *source)
 {
 	unsigned int id = 0;
@@ -671,46 +1151,351 @@ static unsigned int session_source_attach(struct sr_session *session,
 	return id;
 }
 
-/* Idle handler; invoked when the number of registered event sources
- * for a running session drops to zero.
+/* Attach a source to the context of the device thread, if called from
+ * one, or to the main context of the session otherwise.
  */
-static gboolean delayed_stop_check(void *data)
+static unsigned int session_source_attach(struct sr_session *session,
+		GSource *source)
 {
-	struct sr_session *session;
+	GMainContext *context;
 
-	session = data;
-	session->stop_check_id = 0;
+	context = g_private_get(&dev_thread_context);
+	if (context)
+		return g_source_attach(source, context);
 
-	/* Session already ended? */
-	if (!session->running)
-		return G_SOURCE_REMOVE;
+	return main_source_attach(session, source);
+}
 
-	/* New event sources may have been installed in the meantime. */
-	if (g_hash_table_size(session->event_sources) != 0)
-		return G_SOURCE_REMOVE;
+static gpointer dev_thread_run(gpointer data)
+{
+	struct dev_thread *dt;
+	int ret;
 
-	session->running = FALSE;
-	unset_main_context(session);
+	dt = data;
+	sr_thread_sched_apply(sr_session_thread_sched_get(dt->session,
+		SR_THREAD_DEVICE), "device");
+	g_main_context_push_thread_default(dt->context);
+	g_private_set(&dev_thread_context, dt->context);
 
-	sr_info("Stopped.");
+	ret = sr_dev_acquisition_start(dt->sdi);
 
-	/* This indicates a bug in user code, since it is not valid to
-	 * restart or destroy a session while it may still be running.
-	 */
-	if (!session->main_loop && !session->stopped_callback) {
-		sr_err("BUG: Session stop left unhandled.");
-		return G_SOURCE_REMOVE;
-	}
-	if (session->main_loop)
-		g_main_loop_quit(session->main_loop);
+	g_mutex_lock(&dt->mutex);
+	dt->start_ret = ret;
+	dt->started = TRUE;
+	g_cond_signal(&dt->cond);
+	g_mutex_unlock(&dt->mutex);
 
-	if (session->stopped_callback)
-		(*session->stopped_callback)(session->stopped_cb_data);
+	if (ret == SR_OK)
+		g_main_loop_run(dt->loop);
 
-	return G_SOURCE_REMOVE;
+	g_private_set(&dev_thread_context, NULL);
+	g_main_context_pop_thread_default(dt->context);
+
+	return NULL;
 }
 
-static int stop_check_later(struct sr_session *session)
+/* Start the acquisition of a device on a thread of its own. */
+static int dev_thread_start(struct sr_session *session,
+		struct sr_dev_inst *sdi)
+{
+	struct dev_thread *dt;
+	GError *error;
+	int ret;
+
+	dt = g_malloc0(sizeof(*dt));
+	dt->session = session;
+	dt->sdi = sdi;
+	dt->context = g_main_context_new();
+	dt->loop = g_main_loop_new(dt->context, FALSE);
+	g_mutex_init(&dt->mutex);
+	g_cond_init(&dt->cond);
+	session->dev_threads = g_slist_append(session->dev_threads, dt);
+
+	error = NULL;
+	dt->thread = g_thread_try_new("sr-device", dev_thread_run, dt, &error);
+	if (!dt->thread) {
+		sr_err("Cannot create device thread: %s.", error->message);
+		g_error_free(error);
+		return SR_ERR;
+	}
+
+	g_mutex_lock(&dt->mutex);
+	while (!dt->started)
+		g_cond_wait(&dt->cond, &dt->mutex);
+	ret = dt->start_ret;
+	g_mutex_unlock(&dt->mutex);
+
+	return ret;
+}
+
+static gboolean dev_thread_stop_acquisition(void *user_data)
+{
+	sr_dev_acquisition_stop(user_data);
+
+	return G_SOURCE_REMOVE;
+}
+
+/* Terminate all device threads of a session. */
+static void dev_threads_stop(struct sr_session *session)
+{
+	struct dev_thread *dt;
+	GSList *l;
+
+	for (l = session->dev_threads; l; l = l->next) {
+		dt = l->data;
+		if (dt->thread) {
+			g_main_loop_quit(dt->loop);
+			g_thread_join(dt->thread);
+		}
+		g_main_loop_unref(dt->loop);
+		g_main_context_unref(dt->context);
+		g_cond_clear(&dt->cond);
+		g_mutex_clear(&dt->mutex);
+		g_free(dt);
+	}
+	g_slist_free(session->dev_threads);
+	session->dev_threads = NULL;
+}
+
+/* Have a device stop acquisition, in its own thread if it has one. */
+static void session_dev_acquisition_stop(struct sr_session *session,
+		struct sr_dev_inst *sdi)
+{
+	struct dev_thread *dt;
+	GSList *l;
+
+	for (l = session->dev_threads; l; l = l->next) {
+		dt = l->data;
+		if (dt->sdi == sdi) {
+			g_main_context_invoke(dt->context,
+				dev_thread_stop_acquisition, sdi);
+			return;
+		}
+	}
+
+	sr_dev_acquisition_stop(sdi);
+}
+
+/**
+ * Run the event sources of each device on a thread of its own.
+ *
+ * By default, the event sources of all devices in a session are
+ * dispatched by the session's main context, i.e. by a single thread.
+ * With device threads, each device's acquisition is started on a
+ * thread which owns a main context for that device's event sources.
+ * Packets from all devices are serialized before they reach the
+ * transforms and datafeed callbacks.
+ *
+ * The setting takes effect when the session gets started.
+ *
+ * @param session The session to use. Must not be NULL.
+ * @param enable TRUE to use a thread per device, FALSE otherwise.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid session passed.
+ * @retval SR_ERR The session is running.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_dev_threads_set(struct sr_session *session,
+		gboolean enable)
+{
+	if (!session) {
+		sr_err("%s: session was NULL", __func__);
+		return SR_ERR_ARG;
+	}
+	if (session->running) {
+		sr_err("Cannot change device threads while the session is running.");
+		return SR_ERR;
+	}
+
+	session->dev_threads_enabled = enable;
+
+	return SR_OK;
+}
+
+/**
+ * Select how a session waits for events on file descriptors.
+ *
+ * With SR_EVENT_BACKEND_GLIB (the default), each descriptor is polled
+ * by its own GLib event source, which computes its timeout on every
+ * main loop iteration. With SR_EVENT_BACKEND_EPOLL, all descriptors
+ * are registered once with an epoll set, and only the event sources of
+ * ready descriptors or expired timeouts get dispatched. This scales to
+ * sessions with many devices, e.g. lots of serial multimeters.
+ *
+ * The setting applies to event sources added afterwards, so it should
+ * be made right after creating the session.
+ *
+ * @param session The session to use. Must not be NULL.
+ * @param backend The backend, SR_EVENT_BACKEND_GLIB etc.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval SR_ERR_NA The backend is not available on this platform.
+ * @retval SR_ERR The session is running.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_event_backend_set(struct sr_session *session,
+		int backend)
+{
+	if (!session) {
+		sr_err("%s: session was NULL", __func__);
+		return SR_ERR_ARG;
+	}
+	if (backend != SR_EVENT_BACKEND_GLIB
+			&& backend != SR_EVENT_BACKEND_EPOLL) {
+		sr_err("%s: invalid backend %d", __func__, backend);
+		return SR_ERR_ARG;
+	}
+#ifndef HAVE_SYS_EPOLL_H
+	if (backend == SR_EVENT_BACKEND_EPOLL)
+		return SR_ERR_NA;
+#endif
+	if (session->running) {
+		sr_err("Cannot change event backend while the session is running.");
+		return SR_ERR;
+	}
+
+	session->event_backend = backend;
+
+	return SR_OK;
+}
+
+/**
+ * Set the scheduling of a kind of thread of a session.
+ *
+ * Threads which handle the data stream of fast devices can be given a
+ * real-time priority and be bound to a set of CPUs, so other work on
+ * the host doesn't preempt them long enough for the device's buffers to
+ * overrun. Buffers which bound threads allocate get placed in the
+ * memory local to their CPUs, by the first-touch policy of the system.
+ *
+ * Real-time priorities usually need a privilege (e.g. CAP_SYS_NICE or
+ * an RLIMIT_RTPRIO limit). Threads which can't have their settings run
+ * as before, with a warning. On Windows, any priority selects the time
+ * critical priority.
+ *
+ * The settings apply to threads started afterwards, so they should be
+ * made before the session gets started.
+ *
+ * @param session The session to use. Must not be NULL.
+ * @param kind The kind of thread, enum sr_thread_kind.
+ * @param sched The scheduling to use, NULL for the default.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval SR_ERR The session is running.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_thread_sched_set(struct sr_session *session,
+		int kind, const struct sr_thread_sched *sched)
+{
+	if (!session) {
+		sr_err("%s: session was NULL", __func__);
+		return SR_ERR_ARG;
+	}
+	if (kind < SR_THREAD_DEVICE || kind > SR_THREAD_DISPATCH) {
+		sr_err("%s: invalid thread kind %d", __func__, kind);
+		return SR_ERR_ARG;
+	}
+	if (sched && (sched->rt_priority < 0 || sched->rt_priority > 99)) {
+		sr_err("%s: invalid priority %d", __func__, sched->rt_priority);
+		return SR_ERR_ARG;
+	}
+	if (session->running) {
+		sr_err("Cannot change thread scheduling while the session is running.");
+		return SR_ERR;
+	}
+
+	if (sched)
+		session->thread_sched[kind - SR_THREAD_DEVICE] = *sched;
+	else
+		memset(&session->thread_sched[kind - SR_THREAD_DEVICE], 0,
+			sizeof(session->thread_sched[0]));
+
+	return SR_OK;
+}
+
+/**
+ * Get the scheduling of a kind of thread of a session.
+ *
+ * @param session The session to use. Must not be NULL.
+ * @param kind The kind of thread, enum sr_thread_kind.
+ *
+ * @return The settings for sr_thread_sched_apply(), or NULL for the
+ *         default scheduling.
+ *
+ * @private
+ */
+SR_PRIV const struct sr_thread_sched *sr_session_thread_sched_get(
+		const struct sr_session *session, int kind)
+{
+	const struct sr_thread_sched *sched;
+
+	if (!session || kind < SR_THREAD_DEVICE || kind > SR_THREAD_DISPATCH)
+		return NULL;
+
+	sched = &session->thread_sched[kind - SR_THREAD_DEVICE];
+	if (!sched->rt_priority && !sched->cpu_mask)
+		return NULL;
+
+	return sched;
+}
+
+/* Idle handler; invoked when the number of registered event sources
+ * for a running session drops to zero.
+ */
+static gboolean delayed_stop_check(void *data)
+{
+	struct sr_session *session;
+	guint num_sources;
+
+	session = data;
+	session->stop_check_id = 0;
+
+	/* Session already ended? */
+	if (!session->running)
+		return G_SOURCE_REMOVE;
+
+	/* New event sources may have been installed in the meantime. */
+	g_mutex_lock(&session->sources_mutex);
+	num_sources = g_hash_table_size(session->event_sources);
+	g_mutex_unlock(&session->sources_mutex);
+	if (num_sources != 0)
+		return G_SOURCE_REMOVE;
+
+	session->running = FALSE;
+	dev_threads_stop(session);
+#ifdef HAVE_SYS_EPOLL_H
+	epoll_source_free(session);
+#endif
+	unset_main_context(session);
+
+	/* Have the consumer thread deliver all pending packets. */
+	dispatch_stop(session);
+
+	sr_info("Stopped.");
+
+	/* This indicates a bug in user code, since it is not valid to
+	 * restart or destroy a session while it may still be running.
+	 */
+	if (!session->main_loop && !session->stopped_callback) {
+		sr_err("BUG: Session stop left unhandled.");
+		return G_SOURCE_REMOVE;
+	}
+	if (session->main_loop)
+		g_main_loop_quit(session->main_loop);
+
+	if (session->stopped_callback)
+		(*session->stopped_callback)(session->stopped_cb_data);
+
+	return G_SOURCE_REMOVE;
+}
+
+static int stop_check_later(struct sr_session *session)
 {
 	GSource *source;
 	unsigned int source_id;
@@ -721,7 +1506,7 @@ static int stop_check_later(struct sr_session *session)
 	source = g_idle_source_new();
 	g_source_set_callback(source, &delayed_stop_check, session, NULL);
 
-	source_id = session_source_attach(session, source);
+	source_id = main_source_attach(session, source);
 	session->stop_check_id = source_id;
 
 	g_source_unref(source);
@@ -753,8 +1538,7 @@ static int stop_check_later(struct sr_session *session)
 SR_API int sr_session_start(struct sr_session *session)
 {
 	struct sr_dev_inst *sdi;
-	struct sr_channel *ch;
-	GSList *l, *c, *lend;
+	GSList *l, *lend;
 	int ret;
 
 	if (!session) {
@@ -782,12 +1566,9 @@ SR_API int sr_session_start(struct sr_session *session)
 	/* Check enabled channels and commit settings of all devices. */
 	for (l = session->devs; l; l = l->next) {
 		sdi = l->data;
-		for (c = sdi->channels; c; c = c->next) {
-			ch = c->data;
-			if (ch->enabled)
-				break;
-		}
-		if (!c) {
+		/* Pick up channel changes the lookup tables didn't see. */
+		sr_dev_channels_changed(sdi);
+		if (!sr_dev_channel_cache_get(sdi)->num_enabled) {
 			sr_err("%s device %s has no enabled channels.",
 				sdi->driver->name, sdi->connection_id);
 			return SR_ERR;
@@ -806,6 +1587,14 @@ SR_API int sr_session_start(struct sr_session *session)
 	if (ret != SR_OK)
 		return ret;
 
+	stats_reset(session);
+
+	ret = dispatch_start(session);
+	if (ret != SR_OK) {
+		unset_main_context(session);
+		return ret;
+	}
+
 	sr_info("Starting.");
 
 	session->running = TRUE;
@@ -817,7 +1606,10 @@ SR_API int sr_session_start(struct sr_session *session)
 			ret = SR_ERR;
 			break;
 		}
-		ret = sr_dev_acquisition_start(sdi);
+		if (session->dev_threads_enabled)
+			ret = dev_thread_start(session, sdi);
+		else
+			ret = sr_dev_acquisition_start(sdi);
 		if (ret != SR_OK) {
 			sr_err("Could not start %s device %s acquisition.",
 				sdi->driver->name, sdi->connection_id);
@@ -831,13 +1623,18 @@ SR_API int sr_session_start(struct sr_session *session)
 		lend = l->next;
 		for (l = session->devs; l != lend; l = l->next) {
 			sdi = l->data;
-			sr_dev_acquisition_stop(sdi);
+			session_dev_acquisition_stop(session, sdi);
 		}
 		/* TODO: Handle delayed stops. Need to iterate the event
 		 * sources... */
 		session->running = FALSE;
 
+		dev_threads_stop(session);
+#ifdef HAVE_SYS_EPOLL_H
+		epoll_source_free(session);
+#endif
 		unset_main_context(session);
+		dispatch_stop(session);
 		return ret;
 	}
 
@@ -914,7 +1711,7 @@ static gboolean session_stop_sync(void *user_data)
 
 	for (node = session->devs; node; node = node->next) {
 		sdi = node->data;
-		sr_dev_acquisition_stop(sdi);
+		session_dev_acquisition_stop(session, sdi);
 	}
 
 	return G_SOURCE_REMOVE;
@@ -1033,8 +1830,11 @@ SR_API int sr_session_stopped_callback_set(struct sr_session *session,
  */
 static void datafeed_dump(const struct sr_datafeed_packet *packet)
 {
+	const struct sr_datafeed_frame *frame;
 	const struct sr_datafeed_logic *logic;
 	const struct sr_datafeed_analog *analog;
+	const struct sr_datafeed_logic_edges *edges;
+	const struct sr_datafeed_gap *gap;
 
 	/* Please use the same order as in libsigrok.h. */
 	switch (packet->type) {
@@ -1056,7 +1856,12 @@ static void datafeed_dump(const struct sr_datafeed_packet *packet)
 		       "unitsize = %d).", logic->length, logic->unitsize);
 		break;
 	case SR_DF_FRAME_BEGIN:
-		sr_dbg("bus: Received SR_DF_FRAME_BEGIN packet.");
+		frame = packet->payload;
+		if (frame)
+			sr_dbg("bus: Received SR_DF_FRAME_BEGIN packet "
+			       "(segment %" PRIu64 ").", frame->index);
+		else
+			sr_dbg("bus: Received SR_DF_FRAME_BEGIN packet.");
 		break;
 	case SR_DF_FRAME_END:
 		sr_dbg("bus: Received SR_DF_FRAME_END packet.");
@@ -1066,128 +1871,1310 @@ static void datafeed_dump(const struct sr_datafeed_packet *packet)
 		sr_dbg("bus: Received SR_DF_ANALOG packet (%d samples).",
 		       analog->num_samples);
 		break;
+	case SR_DF_LOGIC_EDGES:
+		edges = packet->payload;
+		sr_dbg("bus: Received SR_DF_LOGIC_EDGES packet (%" PRIu64
+		       " samples, %" PRIu64 " changes, unitsize = %d).",
+		       edges->num_samples, edges->num_edges, edges->unitsize);
+		break;
+	case SR_DF_GAP:
+		gap = packet->payload;
+		sr_dbg("bus: Received SR_DF_GAP packet (%" PRIu64 " samples "
+		       "lost after sample %" PRIu64 ").",
+		       gap->num_samples, gap->sample_index);
+		break;
 	default:
 		sr_dbg("bus: Received unknown packet type: %d.", packet->type);
 		break;
 	}
 }
 
-/**
- * Helper to send a meta datafeed package (SR_DF_META) to the session bus.
- *
- * @param sdi The device instance to send the package from. Must not be NULL.
- * @param key The config key to send to the session bus.
- * @param var The value to send to the session bus.
- *
- * @retval SR_OK Success.
- * @retval SR_ERR_ARG Invalid argument.
- *
- * @private
- */
-SR_PRIV int sr_session_send_meta(const struct sr_dev_inst *sdi,
-		uint32_t key, GVariant *var)
+static void run_datafeed_callbacks(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet)
 {
-	struct sr_config *cfg;
-	struct sr_datafeed_packet packet;
-	struct sr_datafeed_meta meta;
-	int ret;
+	GSList *l;
+	struct sr_session *session;
+	struct datafeed_callback *cb_struct;
+	gboolean pooled;
 
-	cfg = sr_config_new(key, var);
+	session = sdi->session;
+	if (session->datafeed_callbacks && sr_log_loglevel_get() >= SR_LOG_DBG)
+		datafeed_dump(packet);
 
-	memset(&meta, 0, sizeof(meta));
+	pooled = FALSE;
+	for (l = session->datafeed_callbacks; l; l = l->next) {
+		cb_struct = l->data;
+		if (!cb_struct->thread_safe || !session->callback_pool) {
+			call_datafeed_callback(cb_struct, sdi, packet);
+			continue;
+		}
+		cb_struct->sdi = sdi;
+		cb_struct->packet = packet;
+		cb_struct->dispatched = g_private_get(&dispatch_current);
+		g_mutex_lock(&session->pool_mutex);
+		session->pool_pending++;
+		g_mutex_unlock(&session->pool_mutex);
+		g_thread_pool_push(session->callback_pool, cb_struct, NULL);
+		pooled = TRUE;
+	}
 
-	packet.type = SR_DF_META;
-	packet.payload = &meta;
+	/* The packet must stay valid until all callbacks have returned. */
+	if (pooled) {
+		g_mutex_lock(&session->pool_mutex);
+		while (session->pool_pending)
+			g_cond_wait(&session->pool_cond, &session->pool_mutex);
+		g_mutex_unlock(&session->pool_mutex);
+	}
+}
 
-	meta.config = g_slist_append(NULL, cfg);
+/** @cond PRIVATE */
+struct dispatch_item {
+	const struct sr_dev_inst *sdi;
+	struct sr_datafeed_packet *packet;
+};
 
-	ret = sr_session_send(sdi, &packet);
-	g_slist_free(meta.config);
-	sr_config_free(cfg);
+/*
+ * Single producer, single consumer ring of retained packets. The
+ * producer is the thread which runs the session, the consumer is the
+ * dispatch thread. Head and tail are free running counters, and only
+ * get modified by the consumer and producer respectively. The mutex
+ * and conditions are only used when either side needs to sleep.
+ */
+struct dispatch_queue {
+	struct sr_session *session;
+	GThread *thread;
+	struct dispatch_item *items;
+	guint size;
+	gint head;
+	gint tail;
+	gint stop;
+	gint consumer_waiting;
+	gint producer_waiting;
+	GMutex mutex;
+	GCond not_empty;
+	GCond not_full;
+};
+/** @endcond */
 
-	return ret;
+static guint dispatch_fill(struct dispatch_queue *q)
+{
+	return (guint)g_atomic_int_get(&q->tail)
+		- (guint)g_atomic_int_get(&q->head);
 }
 
-/**
- * Send a packet to whatever is listening on the datafeed bus.
- *
- * Hardware drivers use this to send a data packet to the frontend.
- *
- * @param sdi TODO.
- * @param packet The datafeed packet to send to the session bus.
- *
- * @retval SR_OK Success.
- * @retval SR_ERR_ARG Invalid argument.
- *
- * @private
- */
-SR_PRIV int sr_session_send(const struct sr_dev_inst *sdi,
+static gpointer dispatch_thread(gpointer data)
+{
+	struct dispatch_queue *q;
+	struct dispatch_item *item;
+	gint head;
+
+	q = data;
+	sr_thread_sched_apply(sr_session_thread_sched_get(q->session,
+		SR_THREAD_DISPATCH), "dispatch");
+	for (;;) {
+		head = g_atomic_int_get(&q->head);
+		if (head == g_atomic_int_get(&q->tail)) {
+			g_mutex_lock(&q->mutex);
+			g_atomic_int_set(&q->consumer_waiting, 1);
+			while (head == g_atomic_int_get(&q->tail)
+					&& !g_atomic_int_get(&q->stop))
+				g_cond_wait(&q->not_empty, &q->mutex);
+			g_atomic_int_set(&q->consumer_waiting, 0);
+			g_mutex_unlock(&q->mutex);
+			/* Only ever terminate after the queue was drained. */
+			if (head == g_atomic_int_get(&q->tail))
+				break;
+		}
+
+		item = &q->items[(guint)head & (q->size - 1)];
+		g_private_set(&dispatch_current, item->packet);
+		run_datafeed_callbacks(item->sdi, item->packet);
+		g_private_set(&dispatch_current, NULL);
+		sr_packet_unref(item->packet);
+		item->packet = NULL;
+
+		g_atomic_int_set(&q->head, head + 1);
+		if (g_atomic_int_get(&q->producer_waiting)) {
+			g_mutex_lock(&q->mutex);
+			g_cond_signal(&q->not_full);
+			g_mutex_unlock(&q->mutex);
+		}
+	}
+
+	return NULL;
+}
+
+static int dispatch_push(struct dispatch_queue *q,
+		const struct sr_dev_inst *sdi,
 		const struct sr_datafeed_packet *packet)
 {
-	GSList *l;
-	struct datafeed_callback *cb_struct;
-	struct sr_datafeed_packet *packet_in, *packet_out;
-	struct sr_transform *t;
+	struct sr_dispatch_stats *stats;
+	struct sr_datafeed_packet *ref;
+	struct dispatch_item *item;
+	gboolean droppable, over_budget;
+	gint tail;
+	guint fill;
 	int ret;
 
-	if (!sdi) {
-		sr_err("%s: sdi was NULL", __func__);
+	stats = &q->session->dispatch_stats;
+
+	/*
+	 * Past the memory budget, hold packets back until the queue has
+	 * drained. This can't wait for memory which isn't queued though.
+	 */
+	over_budget = dispatch_fill(q) > 0 && sr_mem_over_budget();
+	if (over_budget)
+		stats->over_budget++;
+
+	if (dispatch_fill(q) >= q->size || over_budget) {
+		droppable = packet->type == SR_DF_LOGIC
+			|| packet->type == SR_DF_LOGIC_EDGES
+			|| packet->type == SR_DF_ANALOG;
+		if (droppable && q->session->dispatch_policy == SR_DISPATCH_DROP) {
+			stats->dropped++;
+			return SR_OK;
+		}
+		stats->blocked++;
+		g_mutex_lock(&q->mutex);
+		g_atomic_int_set(&q->producer_waiting, 1);
+		while (dispatch_fill(q) >= q->size
+				|| (dispatch_fill(q) > 0 && sr_mem_over_budget()))
+			g_cond_wait(&q->not_full, &q->mutex);
+		g_atomic_int_set(&q->producer_waiting, 0);
+		g_mutex_unlock(&q->mutex);
+	}
+
+	ret = sr_packet_ref(sdi, packet, &ref);
+	if (ret != SR_OK)
+		return ret;
+
+	tail = g_atomic_int_get(&q->tail);
+	item = &q->items[(guint)tail & (q->size - 1)];
+	item->sdi = sdi;
+	item->packet = ref;
+	g_atomic_int_set(&q->tail, tail + 1);
+
+	stats->queued++;
+	fill = dispatch_fill(q);
+	if (fill > stats->max_fill)
+		stats->max_fill = fill;
+
+	if (g_atomic_int_get(&q->consumer_waiting)) {
+		g_mutex_lock(&q->mutex);
+		g_cond_signal(&q->not_empty);
+		g_mutex_unlock(&q->mutex);
+	}
+
+	return SR_OK;
+}
+
+static int dispatch_start(struct sr_session *session)
+{
+	struct dispatch_queue *q;
+	GError *error;
+
+	memset(&session->dispatch_stats, 0, sizeof(session->dispatch_stats));
+	if (!session->dispatch_depth)
+		return SR_OK;
+
+	q = g_malloc0(sizeof(*q));
+	q->session = session;
+	q->size = 1;
+	while (q->size < session->dispatch_depth && q->size < (1U << 20))
+		q->size <<= 1;
+	q->items = g_malloc0_n(q->size, sizeof(q->items[0]));
+	g_mutex_init(&q->mutex);
+	g_cond_init(&q->not_empty);
+	g_cond_init(&q->not_full);
+
+	error = NULL;
+	q->thread = g_thread_try_new("sr-dispatch", dispatch_thread, q, &error);
+	if (!q->thread) {
+		sr_err("Cannot create dispatch thread: %s.", error->message);
+		g_error_free(error);
+		g_cond_clear(&q->not_full);
+		g_cond_clear(&q->not_empty);
+		g_mutex_clear(&q->mutex);
+		g_free(q->items);
+		g_free(q);
+		return SR_ERR;
+	}
+	sr_dbg("Dispatching packets asynchronously, queue depth %u.", q->size);
+	session->dispatch_queue = q;
+
+	return SR_OK;
+}
+
+static void dispatch_stop(struct sr_session *session)
+{
+	struct dispatch_queue *q;
+
+	q = session->dispatch_queue;
+	if (!q)
+		return;
+
+	g_mutex_lock(&q->mutex);
+	g_atomic_int_set(&q->stop, 1);
+	g_cond_signal(&q->not_empty);
+	g_mutex_unlock(&q->mutex);
+	g_thread_join(q->thread);
+	session->dispatch_queue = NULL;
+
+	g_cond_clear(&q->not_full);
+	g_cond_clear(&q->not_empty);
+	g_mutex_clear(&q->mutex);
+	g_free(q->items);
+	g_free(q);
+}
+
+/**
+ * Have a consumer thread run the datafeed callbacks of a session.
+ *
+ * By default, datafeed callbacks run synchronously inside the event
+ * source that sent the packet, so slow consumers delay acquisition.
+ * With asynchronous dispatch, sent packets are retained as with
+ * sr_packet_ref(), and queued for a dedicated thread to pass them to
+ * the datafeed callbacks. The order of packets is kept.
+ *
+ * Datafeed callbacks then run in a different thread than the session.
+ * The set of callbacks must not be changed while the session runs.
+ *
+ * The setting takes effect when the session gets started.
+ *
+ * @param session The session to use. Must not be NULL.
+ * @param depth The maximum number of pending packets, rounded up to a
+ *              power of two. Zero disables asynchronous dispatch.
+ * @param policy What to do when the queue is full, SR_DISPATCH_BLOCK
+ *               or SR_DISPATCH_DROP.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval SR_ERR The session is running.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_dispatch_async_set(struct sr_session *session,
+		size_t depth, int policy)
+{
+	if (!session) {
+		sr_err("%s: session was NULL", __func__);
+		return SR_ERR_ARG;
+	}
+	if (policy != SR_DISPATCH_BLOCK && policy != SR_DISPATCH_DROP) {
+		sr_err("%s: invalid policy %d", __func__, policy);
+		return SR_ERR_ARG;
+	}
+	if (session->running) {
+		sr_err("Cannot change dispatch mode while the session is running.");
+		return SR_ERR;
+	}
+
+	session->dispatch_depth = depth;
+	session->dispatch_policy = policy;
+
+	return SR_OK;
+}
+
+/**
+ * Get the counters of asynchronous datafeed dispatch.
+ *
+ * The counters get reset when the session is started.
+ *
+ * @param session The session to use. Must not be NULL.
+ * @param stats Pointer to store the counters. Must not be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_dispatch_stats_get(struct sr_session *session,
+		struct sr_dispatch_stats *stats)
+{
+	if (!session || !stats)
+		return SR_ERR_ARG;
+
+	*stats = session->dispatch_stats;
+
+	return SR_OK;
+}
+
+/* Get the size of a packet's sample data, all zero for other packets. */
+static void packet_samples(const struct sr_datafeed_packet *packet,
+		uint16_t *unitsize, uint64_t *length, uint64_t *num_samples)
+{
+	const struct sr_datafeed_logic *logic;
+	const struct sr_datafeed_analog *analog;
+	const struct sr_datafeed_logic_edges *edges;
+
+	*unitsize = 0;
+	*length = 0;
+	*num_samples = 0;
+	switch (packet->type) {
+	case SR_DF_LOGIC:
+		logic = packet->payload;
+		*unitsize = logic->unitsize;
+		*length = logic->length;
+		if (logic->unitsize)
+			*num_samples = logic->length / logic->unitsize;
+		break;
+	case SR_DF_ANALOG:
+		analog = packet->payload;
+		*unitsize = analog->encoding->unitsize;
+		*length = sr_analog_data_size(analog);
+		*num_samples = analog->num_samples;
+		break;
+	case SR_DF_LOGIC_EDGES:
+		edges = packet->payload;
+		*unitsize = edges->unitsize;
+		*length = edges->num_edges
+			* (sizeof(uint64_t) + edges->unitsize);
+		*num_samples = edges->num_samples;
+		break;
+	default:
+		break;
+	}
+}
+
+static void trace_packet(struct sr_session *session,
+		const struct sr_datafeed_packet *packet)
+{
+	struct sr_trace_record *rec;
+
+	/* Keep the untraced case free of locking. */
+	if (!g_atomic_pointer_get(&session->trace))
+		return;
+
+	g_mutex_lock(&session->trace_mutex);
+	if (!session->trace) {
+		g_mutex_unlock(&session->trace_mutex);
+		return;
+	}
+
+	if (session->trace_count < session->trace_size) {
+		rec = &session->trace[(session->trace_first + session->trace_count)
+			% session->trace_size];
+		session->trace_count++;
+	} else {
+		/* Overwrite the oldest record. */
+		rec = &session->trace[session->trace_first];
+		session->trace_first = (session->trace_first + 1)
+			% session->trace_size;
+		session->trace_lost++;
+	}
+
+	rec->timestamp = g_get_monotonic_time();
+	rec->type = packet->type;
+	packet_samples(packet, &rec->unitsize, &rec->length, &rec->num_samples);
+
+	g_mutex_unlock(&session->trace_mutex);
+}
+
+static void stats_reset(struct sr_session *session)
+{
+	GSList *l;
+	struct sr_dev_inst *sdi;
+	struct sr_transform *t;
+	struct datafeed_callback *cb_struct;
+
+	for (l = session->devs; l; l = l->next) {
+		sdi = l->data;
+		memset(&sdi->stats, 0, sizeof(sdi->stats));
+		sdi->logic_sample_index = 0;
+		sdi->analog_sample_index = 0;
+	}
+	for (l = session->transforms; l; l = l->next) {
+		t = l->data;
+		t->calls = 0;
+		t->time_us = 0;
+	}
+	for (l = session->datafeed_callbacks; l; l = l->next) {
+		cb_struct = l->data;
+		cb_struct->calls = 0;
+		cb_struct->time_us = 0;
+	}
+}
+
+/**
+ * Get the statistics of the current or last run of a session.
+ *
+ * This reports the packets, bytes and samples sent per device, driver
+ * counters such as USB transfer outcomes (where the driver supports
+ * it), and the cumulative time spent per transform and per datafeed
+ * callback. The counters are reset when the session is started. While
+ * the session runs, the numbers may be slightly out of sync.
+ *
+ * @param session The session to use. Must not be NULL.
+ * @param stats Pointer to store the statistics. Must not be NULL.
+ *              Must be freed using sr_session_stats_free().
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_stats_get(struct sr_session *session,
+		struct sr_session_stats **stats)
+{
+	GSList *l;
+	struct sr_session_stats *st;
+	struct sr_dev_inst *sdi;
+	struct sr_dev_stats *dev_stats;
+	struct sr_transform *t;
+	struct datafeed_callback *cb_struct;
+	struct sr_call_stats *call_stats;
+
+	if (!session || !stats)
+		return SR_ERR_ARG;
+
+	st = g_malloc0(sizeof(*st));
+	for (l = session->devs; l; l = l->next) {
+		sdi = l->data;
+		dev_stats = g_memdup(&sdi->stats, sizeof(*dev_stats));
+		dev_stats->sdi = sdi;
+		st->devices = g_slist_append(st->devices, dev_stats);
+	}
+	for (l = session->transforms; l; l = l->next) {
+		t = l->data;
+		call_stats = g_malloc0(sizeof(*call_stats));
+		call_stats->id = t->module->id;
+		call_stats->cb_data = t->priv;
+		call_stats->calls = t->calls;
+		call_stats->time_us = t->time_us;
+		st->transforms = g_slist_append(st->transforms, call_stats);
+	}
+	for (l = session->datafeed_callbacks; l; l = l->next) {
+		cb_struct = l->data;
+		call_stats = g_malloc0(sizeof(*call_stats));
+		call_stats->cb_data = cb_struct->cb_data;
+		call_stats->calls = cb_struct->calls;
+		call_stats->time_us = cb_struct->time_us;
+		st->callbacks = g_slist_append(st->callbacks, call_stats);
+	}
+	*stats = st;
+
+	return SR_OK;
+}
+
+/**
+ * Free session statistics obtained via sr_session_stats_get().
+ *
+ * @param stats The statistics to free. Can be NULL.
+ *
+ * @since 0.6.0
+ */
+SR_API void sr_session_stats_free(struct sr_session_stats *stats)
+{
+	if (!stats)
+		return;
+
+	g_slist_free_full(stats->devices, g_free);
+	g_slist_free_full(stats->transforms, g_free);
+	g_slist_free_full(stats->callbacks, g_free);
+	g_free(stats);
+}
+
+/**
+ * Enable binary tracing of the packets sent on the session bus.
+ *
+ * Every packet sent by a device is recorded in a ring of fixed size,
+ * without text formatting or memory allocation. This works regardless
+ * of the log level. When the ring is full, the oldest records get
+ * overwritten. Previously recorded packets are discarded.
+ *
+ * @param session The session to use. Must not be NULL.
+ * @param num_records Capacity of the ring in records, 0 to disable.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid session passed.
+ * @retval SR_ERR_MALLOC Not enough memory for the ring.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_trace_set(struct sr_session *session,
+		size_t num_records)
+{
+	struct sr_trace_record *trace;
+
+	if (!session) {
+		sr_err("%s: session was NULL", __func__);
+		return SR_ERR_ARG;
+	}
+
+	trace = NULL;
+	if (num_records) {
+		trace = g_try_malloc_n(num_records, sizeof(*trace));
+		if (!trace) {
+			sr_err("Failed to allocate packet trace.");
+			return SR_ERR_MALLOC;
+		}
+	}
+
+	g_mutex_lock(&session->trace_mutex);
+	g_free(session->trace);
+	g_atomic_pointer_set(&session->trace, trace);
+	session->trace_size = num_records;
+	session->trace_first = 0;
+	session->trace_count = 0;
+	session->trace_lost = 0;
+	g_mutex_unlock(&session->trace_mutex);
+
+	return SR_OK;
+}
+
+/**
+ * Drain records of the packet trace, oldest first.
+ *
+ * This may be called from any thread, also while the session runs.
+ *
+ * @param session The session to use. Must not be NULL.
+ * @param records Array to store the records. Must not be NULL.
+ * @param max_records Maximum number of records to store.
+ * @param num_read Pointer to store the number of records read.
+ *                 Must not be NULL.
+ * @param lost Pointer to store the number of records which were
+ *             overwritten since the last call. Can be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_trace_read(struct sr_session *session,
+		struct sr_trace_record *records, size_t max_records,
+		size_t *num_read, uint64_t *lost)
+{
+	size_t i, n;
+
+	if (!session || !records || !num_read)
+		return SR_ERR_ARG;
+
+	g_mutex_lock(&session->trace_mutex);
+	n = MIN(max_records, session->trace_count);
+	for (i = 0; i < n; i++) {
+		records[i] = session->trace[session->trace_first];
+		session->trace_first = (session->trace_first + 1)
+			% session->trace_size;
+	}
+	session->trace_count -= n;
+	if (lost)
+		*lost = session->trace_lost;
+	session->trace_lost = 0;
+	g_mutex_unlock(&session->trace_mutex);
+
+	*num_read = n;
+
+	return SR_OK;
+}
+
+/*
+ * Account for a packet which the device sends: trace it, update the
+ * device's statistics (including gaps and lost samples) and its
+ * position in the sample streams. Returns the packet's time and the
+ * index of its first sample. Every packet takes this path, whether it
+ * is sent alone or as part of a batch, so this is where the
+ * session_send_entry probe fires.
+ */
+static void send_account(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet,
+		int64_t *timestamp, uint64_t *sample_index)
+{
+	struct sr_session *session;
+	struct sr_dev_stats *dev_stats;
+	struct sr_dev_inst *dev;
+	uint16_t unitsize;
+	uint64_t length, num_samples;
+
+	session = sdi->session;
+	SR_PROBE2(session_send_entry, sdi, packet->type);
+	trace_packet(session, packet);
+
+	/* Drivers may have provided the hardware time of the packet. */
+	if (session->hw_timestamp_valid)
+		*timestamp = session->hw_timestamp;
+	else
+		*timestamp = g_get_monotonic_time();
+	session->hw_timestamp_valid = FALSE;
+
+	dev_stats = (struct sr_dev_stats *)&sdi->stats;
+	packet_samples(packet, &unitsize, &length, &num_samples);
+	dev_stats->packets++;
+	dev_stats->bytes += length;
+	dev_stats->samples += num_samples;
+	if (packet->type == SR_DF_GAP) {
+		dev_stats->gaps++;
+		dev_stats->lost_samples +=
+			((const struct sr_datafeed_gap *)packet->payload)->num_samples;
+	}
+	dev = (struct sr_dev_inst *)sdi;
+	if (packet->type == SR_DF_LOGIC
+			|| packet->type == SR_DF_LOGIC_EDGES) {
+		*sample_index = dev->logic_sample_index;
+		dev->logic_sample_index += num_samples;
+	} else if (packet->type == SR_DF_ANALOG) {
+		*sample_index = dev->analog_sample_index;
+		dev->analog_sample_index += num_samples;
+	} else {
+		*sample_index = 0;
+	}
+}
+
+/*
+ * Find a packet among the ones currently being sent, alone or in a
+ * batch. Gets its time and first sample index, when found.
+ */
+static gboolean send_context_get(const struct sr_session *session,
+		const struct sr_datafeed_packet *packet,
+		int64_t *timestamp, uint64_t *sample_index)
+{
+	size_t i;
+
+	if (!session)
+		return FALSE;
+
+	if (packet == session->send_packet) {
+		*timestamp = session->send_timestamp;
+		*sample_index = session->send_sample_index;
+		return TRUE;
+	}
+
+	if (session->send_batch && packet >= session->send_batch
+			&& packet < session->send_batch + session->send_batch_len) {
+		i = packet - session->send_batch;
+		*timestamp = session->send_batch_timestamps[i];
+		*sample_index = session->send_batch_indices[i];
+		return TRUE;
+	}
+
+	return FALSE;
+}
+
+/*
+ * With device threads, packets can be sent from several threads at
+ * once. Serialize them, so that transforms and callbacks see a single
+ * stream of packets.
+ */
+static void bus_lock(struct sr_session *session)
+{
+	if (session->dev_threads)
+		g_rec_mutex_lock(&session->bus_mutex);
+}
+
+static void bus_unlock(struct sr_session *session)
+{
+	if (session->dev_threads)
+		g_rec_mutex_unlock(&session->bus_mutex);
+}
+
+/**
+ * Send multiple packets to the session bus at once.
+ *
+ * This is equivalent to calling sr_session_send() for each packet in
+ * order, but passes the whole batch to callbacks which accept batches.
+ * Without transforms, asynchronous dispatch or callback threads, the
+ * per-packet processing is done once for the batch.
+ *
+ * @param sdi Device instance. Must not be NULL.
+ * @param packets Array of packets to send. Must not be NULL.
+ * @param num_packets Number of packets in the array.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ *
+ * @private
+ */
+SR_PRIV int sr_session_send_batch(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packets, size_t num_packets)
+{
+	GSList *l;
+	struct sr_session *session;
+	struct datafeed_callback *cb_struct;
+	const struct sr_send_redirect *redirect;
+	const struct sr_datafeed_packet *prev_packet, *prev_batch;
+	const int64_t *prev_batch_timestamps;
+	const uint64_t *prev_batch_indices;
+	struct sr_packet_buffer *prev_copy;
+	int64_t stack_timestamps[BATCH_STACK_PACKETS], *timestamps;
+	uint64_t stack_indices[BATCH_STACK_PACKETS], *indices;
+	int64_t prev_timestamp;
+	uint64_t prev_sample_index;
+	size_t prev_batch_len;
+	gint64 start;
+	size_t i;
+	int ret;
+
+	if (!sdi || !packets) {
+		sr_err("%s: Invalid argument.", __func__);
+		return SR_ERR_ARG;
+	}
+
+	if (!sdi->session) {
+		sr_err("%s: session was NULL", __func__);
+		return SR_ERR_BUG;
+	}
+
+	/* Worker threads hand their packets over to the session's thread. */
+	redirect = g_private_get(&send_redirect);
+	if (redirect) {
+		for (i = 0; i < num_packets; i++) {
+			ret = redirect->send(sdi, &packets[i], 0, redirect->cb_data);
+			if (ret != SR_OK)
+				return ret;
+		}
+		return SR_OK;
+	}
+
+	session = sdi->session;
+	if (session->transforms || session->dispatch_queue
+			|| session->callback_pool) {
+		/* Transforms and worker threads handle one packet at a time. */
+		for (i = 0; i < num_packets; i++) {
+			ret = sr_session_send(sdi, &packets[i]);
+			if (ret != SR_OK)
+				return ret;
+		}
+		return SR_OK;
+	}
+
+	if (num_packets <= BATCH_STACK_PACKETS) {
+		timestamps = stack_timestamps;
+		indices = stack_indices;
+	} else {
+		timestamps = g_malloc_n(num_packets, sizeof(*timestamps));
+		indices = g_malloc_n(num_packets, sizeof(*indices));
+	}
+
+	bus_lock(session);
+	for (i = 0; i < num_packets; i++) {
+		send_account(sdi, &packets[i], &timestamps[i], &indices[i]);
+		if (session->datafeed_callbacks
+				&& sr_log_loglevel_get() >= SR_LOG_DBG)
+			datafeed_dump(&packets[i]);
+	}
+
+	/*
+	 * Keep track of the packets while callbacks run, so that
+	 * sr_packet_ref() and sr_packet_timestamp_get() find them.
+	 */
+	prev_packet = session->send_packet;
+	prev_copy = session->send_copy;
+	prev_timestamp = session->send_timestamp;
+	prev_sample_index = session->send_sample_index;
+	prev_batch = session->send_batch;
+	prev_batch_len = session->send_batch_len;
+	prev_batch_timestamps = session->send_batch_timestamps;
+	prev_batch_indices = session->send_batch_indices;
+	session->send_packet = NULL;
+	session->send_copy = NULL;
+	session->send_batch = packets;
+	session->send_batch_len = num_packets;
+	session->send_batch_timestamps = timestamps;
+	session->send_batch_indices = indices;
+
+	for (l = session->datafeed_callbacks; l; l = l->next) {
+		cb_struct = l->data;
+		if (!cb_struct->batch_cb) {
+			for (i = 0; i < num_packets; i++)
+				call_datafeed_callback(cb_struct, sdi, &packets[i]);
+			continue;
+		}
+		if (num_packets)
+			SR_PROBE2(callback_entry, cb_struct->cb_data,
+				packets[0].type);
+		start = g_get_monotonic_time();
+		cb_struct->batch_cb(sdi, packets, num_packets,
+			cb_struct->cb_data);
+		cb_struct->time_us += g_get_monotonic_time() - start;
+		if (num_packets)
+			SR_PROBE1(callback_return, cb_struct->cb_data);
+		cb_struct->calls += num_packets;
+	}
+	for (i = 0; i < num_packets; i++)
+		SR_PROBE2(session_send_return, sdi, SR_OK);
+
+	session->send_packet = prev_packet;
+	session->send_copy = prev_copy;
+	session->send_timestamp = prev_timestamp;
+	session->send_sample_index = prev_sample_index;
+	session->send_batch = prev_batch;
+	session->send_batch_len = prev_batch_len;
+	session->send_batch_timestamps = prev_batch_timestamps;
+	session->send_batch_indices = prev_batch_indices;
+	bus_unlock(session);
+
+	if (timestamps != stack_timestamps) {
+		g_free(timestamps);
+		g_free(indices);
+	}
+
+	return SR_OK;
+}
+
+/**
+ * Helper to send a meta datafeed package (SR_DF_META) to the session bus.
+ *
+ * @param sdi The device instance to send the package from. Must not be NULL.
+ * @param key The config key to send to the session bus.
+ * @param var The value to send to the session bus.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ *
+ * @private
+ */
+SR_PRIV int sr_session_send_meta(const struct sr_dev_inst *sdi,
+		uint32_t key, GVariant *var)
+{
+	struct sr_config *cfg;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_meta meta;
+	int ret;
+
+	cfg = sr_config_new(key, var);
+
+	memset(&meta, 0, sizeof(meta));
+
+	packet.type = SR_DF_META;
+	packet.payload = &meta;
+
+	meta.config = g_slist_append(NULL, cfg);
+
+	ret = sr_session_send(sdi, &packet);
+	g_slist_free(meta.config);
+	sr_config_free(cfg);
+
+	return ret;
+}
+
+/** @cond PRIVATE */
+struct writable_packet {
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic logic;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+	void *data;
+	size_t data_size;
+};
+/** @endcond */
+
+static void writable_packet_free(struct writable_packet *wp)
+{
+	if (!wp)
+		return;
+
+	g_free(wp->data);
+	g_free(wp);
+}
+
+/*
+ * Make a packet writable for in-place transform modules. The payload
+ * structs are copied to the (reused) writable packet. The sample data is
+ * copied too, unless it lies in the buffer that the driver handed over to
+ * the session, which nobody else can see yet.
+ */
+static struct sr_datafeed_packet *packet_make_writable(
+		struct sr_session *session, struct writable_packet *wp,
+		struct sr_datafeed_packet *packet)
+{
+	const struct sr_datafeed_logic *logic;
+	const struct sr_datafeed_analog *analog;
+	void *data;
+	size_t size;
+
+	switch (packet->type) {
+	case SR_DF_LOGIC:
+		logic = packet->payload;
+		data = logic->data;
+		size = logic->length;
+		break;
+	case SR_DF_ANALOG:
+		analog = packet->payload;
+		data = analog->data;
+		size = sr_analog_data_size(analog);
+		break;
+	default:
+		/* In-place modules only modify sample data packets. */
+		return packet;
+	}
+
+	if (!buffer_contains(session->send_buffer, data, size)) {
+		if (wp->data_size < size) {
+			g_free(wp->data);
+			wp->data = g_malloc(size);
+			wp->data_size = size;
+		}
+		memcpy(wp->data, data, size);
+		data = wp->data;
+	}
+
+	wp->packet.type = packet->type;
+	if (packet->type == SR_DF_LOGIC) {
+		wp->logic = *logic;
+		wp->logic.data = data;
+		wp->packet.payload = &wp->logic;
+	} else {
+		wp->analog = *analog;
+		wp->encoding = *analog->encoding;
+		wp->meaning = *analog->meaning;
+		wp->spec = *analog->spec;
+		wp->analog.encoding = &wp->encoding;
+		wp->analog.meaning = &wp->meaning;
+		wp->analog.spec = &wp->spec;
+		wp->analog.data = data;
+		wp->packet.payload = &wp->analog;
+	}
+
+	return &wp->packet;
+}
+
+/*
+ * Run a row of transforms which provide a logic block kernel over the
+ * (writable) packet, one block at a time. Each block stays in the cache
+ * while all of them process it. Returns the list item of the last
+ * transform which ran.
+ */
+static GSList *transforms_run_fused(GSList *first,
+		struct sr_datafeed_packet *packet)
+{
+	const struct sr_datafeed_logic *logic;
+	struct sr_transform *t;
+	GSList *last, *l;
+	uint8_t *data;
+	uint64_t offset, size, block;
+	int64_t start;
+
+	last = first;
+	while (last->next && ((struct sr_transform *)
+			last->next->data)->module->logic_block)
+		last = last->next;
+
+	logic = packet->payload;
+	block = FUSED_BLOCK_SIZE;
+	if (logic->unitsize)
+		block = MAX(block - block % logic->unitsize, logic->unitsize);
+	data = logic->data;
+	for (offset = 0; offset < logic->length; offset += size) {
+		size = MIN(block, logic->length - offset);
+		for (l = first; l != last->next; l = l->next) {
+			t = l->data;
+			start = g_get_monotonic_time();
+			t->module->logic_block(t, logic, data + offset, size);
+			t->time_us += g_get_monotonic_time() - start;
+		}
+	}
+	for (l = first; l != last->next; l = l->next) {
+		t = l->data;
+		sr_spew("Ran transform module '%s' fused.", t->module->id);
+		t->calls++;
+	}
+
+	return last;
+}
+
+/*
+ * Pass a packet through the transform modules from the given one on,
+ * then to the datafeed callbacks.
+ */
+static int session_send_from(const struct sr_dev_inst *sdi, GSList *first,
+		const struct sr_datafeed_packet *packet,
+		int64_t timestamp, uint64_t sample_index)
+{
+	GSList *l;
+	struct sr_datafeed_packet *packet_in, *packet_out;
+	const struct sr_datafeed_packet *prev_packet;
+	struct sr_packet_buffer *prev_copy;
+	struct sr_session *session;
+	struct sr_transform *t;
+	struct writable_packet *wp;
+	gboolean writable;
+	uint64_t prev_sample_index;
+	int64_t prev_timestamp;
+	gint64 start;
+	int ret;
+
+	session = sdi->session;
+
+	/*
+	 * Pass the packet to the first transform module. If that returns
+	 * another packet (instead of NULL), pass that packet to the next
+	 * transform module in the list, and so on.
+	 */
+	packet_in = (struct sr_datafeed_packet *)packet;
+	wp = NULL;
+	writable = FALSE;
+	for (l = first; l; l = l->next) {
+		t = l->data;
+		if (t->module->in_place && !writable) {
+			/* Nested sends must not reuse the outer copy. */
+			if (!wp && session->writable_busy) {
+				wp = g_malloc0(sizeof(*wp));
+			} else if (!wp) {
+				if (!session->writable)
+					session->writable = g_malloc0(sizeof(*wp));
+				wp = session->writable;
+				session->writable_busy = TRUE;
+			}
+			packet_in = packet_make_writable(session, wp, packet_in);
+			writable = TRUE;
+		}
+		if (t->module->logic_block && packet_in->type == SR_DF_LOGIC) {
+			l = transforms_run_fused(l, packet_in);
+			continue;
+		}
+		sr_spew("Running transform module '%s'.", t->module->id);
+		SR_PROBE2(transform_entry, t->module->id, packet_in->type);
+		start = g_get_monotonic_time();
+		ret = t->module->receive(t, packet_in, &packet_out);
+		t->time_us += g_get_monotonic_time() - start;
+		SR_PROBE2(transform_return, t->module->id, ret);
+		t->calls++;
+		if (ret < 0) {
+			sr_err("Error while running transform module: %d.", ret);
+			ret = SR_ERR;
+			goto done;
+		}
+		if (!packet_out) {
+			/*
+			 * If any of the transforms don't return an output
+			 * packet, abort.
+			 */
+			sr_spew("Transform module didn't return a packet, aborting.");
+			ret = SR_OK;
+			goto done;
+		} else {
+			/*
+			 * Use this transform module's output packet as input
+			 * for the next transform module.
+			 */
+			if (packet_out != packet_in)
+				writable = FALSE;
+			packet_in = packet_out;
+		}
+	}
+	packet = packet_in;
+
+	/*
+	 * If the last transform did output a packet, pass it to all datafeed
+	 * callbacks, or queue it for the consumer thread to do so. Keep
+	 * track of the packet meanwhile, so that sr_packet_ref() can share
+	 * data between multiple consumers, and sr_packet_timestamp_get()
+	 * can find the packet's time.
+	 */
+	prev_packet = session->send_packet;
+	prev_copy = session->send_copy;
+	prev_timestamp = session->send_timestamp;
+	prev_sample_index = session->send_sample_index;
+	session->send_packet = packet;
+	session->send_copy = NULL;
+	session->send_timestamp = timestamp;
+	session->send_sample_index = sample_index;
+	ret = SR_OK;
+	if (session->dispatch_queue)
+		ret = dispatch_push(session->dispatch_queue, sdi, packet);
+	else
+		run_datafeed_callbacks(sdi, packet);
+	if (session->send_copy)
+		sr_packet_buffer_unref(session->send_copy);
+	session->send_packet = prev_packet;
+	session->send_copy = prev_copy;
+	session->send_timestamp = prev_timestamp;
+	session->send_sample_index = prev_sample_index;
+
+done:
+	if (wp == session->writable)
+		session->writable_busy = FALSE;
+	else
+		writable_packet_free(wp);
+
+	return ret;
+}
+
+static int session_send(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet)
+{
+	uint64_t sample_index;
+	int64_t timestamp;
+
+	send_account(sdi, packet, &timestamp, &sample_index);
+
+	return session_send_from(sdi, sdi->session->transforms, packet,
+		timestamp, sample_index);
+}
+
+/**
+ * Send a packet to whatever is listening on the datafeed bus.
+ *
+ * Hardware drivers use this to send a data packet to the frontend.
+ *
+ * @param sdi TODO.
+ * @param packet The datafeed packet to send to the session bus.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ *
+ * @private
+ */
+SR_PRIV int sr_session_send(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet)
+{
+	const struct sr_send_redirect *redirect;
+	int ret;
+
+	if (!sdi) {
+		sr_err("%s: sdi was NULL", __func__);
+		return SR_ERR_ARG;
+	}
+
+	if (!packet) {
+		sr_err("%s: packet was NULL", __func__);
+		return SR_ERR_ARG;
+	}
+
+	if (!sdi->session) {
+		sr_err("%s: session was NULL", __func__);
+		return SR_ERR_BUG;
+	}
+
+	redirect = g_private_get(&send_redirect);
+	if (redirect)
+		return redirect->send(sdi, packet, 0, redirect->cb_data);
+
+	bus_lock(sdi->session);
+	ret = session_send(sdi, packet);
+	bus_unlock(sdi->session);
+	SR_PROBE2(session_send_return, sdi, ret);
+
+	return ret;
+}
+
+/**
+ * Redirect the packets which the calling thread sends.
+ *
+ * While a redirect is set, sr_session_send() and related routines pass
+ * the packets of the calling thread to the redirect's routine, instead
+ * of the session bus. Worker threads use this to hand packets over to
+ * the thread of the session. Other threads are not affected.
+ *
+ * @param redirect The redirect to use, or NULL to send to the bus again.
+ *                 Must stay valid while it is set.
+ *
+ * @private
+ */
+SR_PRIV void sr_session_send_redirect_set(const struct sr_send_redirect *redirect)
+{
+	g_private_set(&send_redirect, (gpointer)redirect);
+}
+
+/**
+ * Send a packet to the datafeed bus, with the hardware time of the packet.
+ *
+ * Drivers which know the time of the first sample in a packet on the
+ * host's monotonic clock can use this instead of sr_session_send(), see
+ * sr_packet_timestamp_get().
+ *
+ * @param sdi Device instance. Must not be NULL.
+ * @param packet The datafeed packet to send to the session bus.
+ * @param timestamp Time of the packet in microseconds, on the scale of
+ *                  g_get_monotonic_time().
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ *
+ * @private
+ */
+SR_PRIV int sr_session_send_timestamped(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, int64_t timestamp)
+{
+	const struct sr_send_redirect *redirect;
+	int ret;
+
+	if (!sdi || !packet) {
+		sr_err("%s: Invalid argument.", __func__);
+		return SR_ERR_ARG;
+	}
+
+	if (!sdi->session) {
+		sr_err("%s: session was NULL", __func__);
+		return SR_ERR_BUG;
+	}
+
+	redirect = g_private_get(&send_redirect);
+	if (redirect)
+		return redirect->send(sdi, packet, timestamp, redirect->cb_data);
+
+	bus_lock(sdi->session);
+	sdi->session->hw_timestamp = timestamp;
+	sdi->session->hw_timestamp_valid = TRUE;
+	ret = session_send(sdi, packet);
+	bus_unlock(sdi->session);
+	SR_PROBE2(session_send_return, sdi, ret);
+
+	return ret;
+}
+
+/**
+ * Send a packet from a transform module on to the modules after it.
+ *
+ * Transform modules which need to output more than one packet for a
+ * packet they received (or output packets which don't correspond to
+ * a received one) call this from their receive() callback. The packet
+ * runs through the remaining transform modules, then gets passed to
+ * the datafeed callbacks.
+ *
+ * @param t The transform module which outputs the packet. Must not be NULL.
+ * @param packet The datafeed packet to send. Must not be NULL.
+ * @param timestamp Time of the packet in microseconds, on the scale of
+ *                  g_get_monotonic_time().
+ * @param sample_index Index of the packet's first sample in its stream.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ *
+ * @private
+ */
+SR_PRIV int sr_transform_send(const struct sr_transform *t,
+		const struct sr_datafeed_packet *packet,
+		int64_t timestamp, uint64_t sample_index)
+{
+	GSList *l;
+
+	if (!t || !t->sdi || !t->sdi->session || !packet)
 		return SR_ERR_ARG;
-	}
 
-	if (!packet) {
-		sr_err("%s: packet was NULL", __func__);
+	l = g_slist_find(t->sdi->session->transforms, t);
+	if (!l)
 		return SR_ERR_ARG;
-	}
-
-	if (!sdi->session) {
-		sr_err("%s: session was NULL", __func__);
-		return SR_ERR_BUG;
-	}
 
-	/*
-	 * Pass the packet to the first transform module. If that returns
-	 * another packet (instead of NULL), pass that packet to the next
-	 * transform module in the list, and so on.
-	 */
-	packet_in = (struct sr_datafeed_packet *)packet;
-	for (l = sdi->session->transforms; l; l = l->next) {
-		t = l->data;
-		sr_spew("Running transform module '%s'.", t->module->id);
-		ret = t->module->receive(t, packet_in, &packet_out);
-		if (ret < 0) {
-			sr_err("Error while running transform module: %d.", ret);
-			return SR_ERR;
-		}
-		if (!packet_out) {
-			/*
-			 * If any of the transforms don't return an output
-			 * packet, abort.
-			 */
-			sr_spew("Transform module didn't return a packet, aborting.");
-			return SR_OK;
-		} else {
-			/*
-			 * Use this transform module's output packet as input
-			 * for the next transform module.
-			 */
-			packet_in = packet_out;
-		}
-	}
-	packet = packet_in;
+	return session_send_from(t->sdi, l->next, packet,
+		timestamp, sample_index);
+}
 
-	/*
-	 * If the last transform did output a packet, pass it to all datafeed
-	 * callbacks.
-	 */
-	for (l = sdi->session->datafeed_callbacks; l; l = l->next) {
-		if (sr_log_loglevel_get() >= SR_LOG_DBG)
-			datafeed_dump(packet);
-		cb_struct = l->data;
-		cb_struct->cb(sdi, packet, cb_struct->cb_data);
-	}
+/**
+ * Attach a driver owned buffer to subsequently sent packets.
+ *
+ * While a buffer is attached, packets whose payload data is located
+ * within the buffer's memory can be retained by datafeed consumers
+ * (see sr_packet_ref()) without copying the data. The session holds
+ * a reference to the buffer until it gets replaced or unset.
+ *
+ * @param session The session to use. Must not be NULL.
+ * @param buf The buffer to attach, or NULL to detach the current buffer.
+ *
+ * @private
+ */
+SR_PRIV void sr_session_send_buffer_set(struct sr_session *session,
+		struct sr_packet_buffer *buf)
+{
+	if (!session)
+		return;
 
-	return SR_OK;
+	if (buf)
+		sr_packet_buffer_ref(buf);
+	if (session->send_buffer)
+		sr_packet_buffer_unref(session->send_buffer);
+	session->send_buffer = buf;
 }
 
 /**
@@ -1213,11 +3200,14 @@ SR_PRIV int sr_session_source_add_internal(struct sr_session *session,
 	 * already installed source. (Well it would, if we did not have
 	 * another sanity check there.)
 	 */
+	g_mutex_lock(&session->sources_mutex);
 	if (g_hash_table_contains(session->event_sources, key)) {
+		g_mutex_unlock(&session->sources_mutex);
 		sr_err("Event source with key %p already exists.", key);
 		return SR_ERR_BUG;
 	}
 	g_hash_table_insert(session->event_sources, key, source);
+	g_mutex_unlock(&session->sources_mutex);
 
 	if (session_source_attach(session, source) == 0)
 		return SR_ERR;
@@ -1357,7 +3347,9 @@ SR_PRIV int sr_session_source_remove_internal(struct sr_session *session,
 {
 	GSource *source;
 
+	g_mutex_lock(&session->sources_mutex);
 	source = g_hash_table_lookup(session->event_sources, key);
+	g_mutex_unlock(&session->sources_mutex);
 	/*
 	 * Trying to remove an already removed event source is problematic
 	 * since the poll_object handle may have been reused in the meantime.
@@ -1453,24 +3445,30 @@ SR_PRIV int sr_session_source_destroyed(struct sr_session *session,
 		void *key, GSource *source)
 {
 	GSource *registered_source;
+	guint num_sources;
 
+	g_mutex_lock(&session->sources_mutex);
 	registered_source = g_hash_table_lookup(session->event_sources, key);
 	/*
 	 * Trying to remove an already removed event source is problematic
 	 * since the poll_object handle may have been reused in the meantime.
 	 */
 	if (!registered_source) {
+		g_mutex_unlock(&session->sources_mutex);
 		sr_err("No event source for key %p found.", key);
 		return SR_ERR_BUG;
 	}
 	if (registered_source != source) {
+		g_mutex_unlock(&session->sources_mutex);
 		sr_err("Event source for key %p does not match"
 			" destroyed source.", key);
 		return SR_ERR_BUG;
 	}
 	g_hash_table_remove(session->event_sources, key);
+	num_sources = g_hash_table_size(session->event_sources);
+	g_mutex_unlock(&session->sources_mutex);
 
-	if (g_hash_table_size(session->event_sources) > 0)
+	if (num_sources > 0)
 		return SR_OK;
 
 	/* If no event sources are left, consider the acquisition finished.
@@ -1480,6 +3478,167 @@ SR_PRIV int sr_session_source_destroyed(struct sr_session *session,
 	return stop_check_later(session);
 }
 
+/** @cond PRIVATE */
+#define PACKET_POOL_MIN_SHIFT	6
+#define PACKET_POOL_MAX_SHIFT	22
+#define PACKET_POOL_CLASSES	(PACKET_POOL_MAX_SHIFT - PACKET_POOL_MIN_SHIFT + 1)
+/* Maximum number of free blocks kept per size class. */
+#define PACKET_POOL_DEPTH	32
+
+/* Header in front of each block, keeps the payload suitably aligned. */
+union pool_header {
+	struct {
+		union pool_header *next;
+		/* Payload size, for memory accounting. */
+		size_t size;
+		int size_class;
+	} h;
+	long double align;
+};
+/** @endcond */
+
+/*
+ * Free lists of the memory used by packet copies, by power of two size
+ * class. This is shared by all sessions, since sr_packet_copy() and
+ * sr_packet_free() have no reference to a session.
+ */
+static struct {
+	GMutex mutex;
+	union pool_header *free[PACKET_POOL_CLASSES];
+	unsigned int num_free[PACKET_POOL_CLASSES];
+	struct sr_packet_pool_stats stats;
+} packet_pool;
+
+static void *pool_alloc(size_t size)
+{
+	union pool_header *block;
+	int size_class;
+
+	size_class = 0;
+	while (size_class < PACKET_POOL_CLASSES
+			&& ((size_t)1 << (size_class + PACKET_POOL_MIN_SHIFT)) < size)
+		size_class++;
+
+	if (size_class == PACKET_POOL_CLASSES) {
+		/* Too large to be kept around. */
+		block = g_malloc(sizeof(*block) + size);
+		block->h.size = size;
+		block->h.size_class = -1;
+		g_mutex_lock(&packet_pool.mutex);
+		packet_pool.stats.oversized++;
+		g_mutex_unlock(&packet_pool.mutex);
+		sr_mem_account(SR_MEM_PACKETS, size, TRUE);
+		return block + 1;
+	}
+
+	g_mutex_lock(&packet_pool.mutex);
+	block = packet_pool.free[size_class];
+	if (block) {
+		packet_pool.free[size_class] = block->h.next;
+		packet_pool.num_free[size_class]--;
+		packet_pool.stats.cached_bytes -=
+			(size_t)1 << (size_class + PACKET_POOL_MIN_SHIFT);
+		packet_pool.stats.hits++;
+	} else {
+		packet_pool.stats.misses++;
+	}
+	g_mutex_unlock(&packet_pool.mutex);
+
+	if (!block) {
+		block = g_malloc(sizeof(*block)
+			+ ((size_t)1 << (size_class + PACKET_POOL_MIN_SHIFT)));
+		block->h.size = (size_t)1 << (size_class + PACKET_POOL_MIN_SHIFT);
+		block->h.size_class = size_class;
+	}
+	sr_mem_account(SR_MEM_PACKETS, block->h.size, TRUE);
+
+	return block + 1;
+}
+
+static void *pool_alloc0(size_t size)
+{
+	void *ptr;
+
+	ptr = pool_alloc(size);
+	memset(ptr, 0, size);
+
+	return ptr;
+}
+
+static void pool_free(void *ptr)
+{
+	union pool_header *block;
+	int size_class;
+
+	if (!ptr)
+		return;
+
+	block = (union pool_header *)ptr - 1;
+	sr_mem_account(SR_MEM_PACKETS, block->h.size, FALSE);
+	size_class = block->h.size_class;
+	if (size_class < 0) {
+		g_free(block);
+		return;
+	}
+
+	g_mutex_lock(&packet_pool.mutex);
+	if (packet_pool.num_free[size_class] < PACKET_POOL_DEPTH) {
+		block->h.next = packet_pool.free[size_class];
+		packet_pool.free[size_class] = block;
+		packet_pool.num_free[size_class]++;
+		packet_pool.stats.cached_bytes +=
+			(size_t)1 << (size_class + PACKET_POOL_MIN_SHIFT);
+		block = NULL;
+	}
+	g_mutex_unlock(&packet_pool.mutex);
+
+	g_free(block);
+}
+
+/**
+ * Get the counters of the memory pool used by sr_packet_copy().
+ *
+ * @param stats Pointer to store the counters. Must not be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_packet_pool_stats_get(struct sr_packet_pool_stats *stats)
+{
+	if (!stats)
+		return SR_ERR_ARG;
+
+	g_mutex_lock(&packet_pool.mutex);
+	*stats = packet_pool.stats;
+	g_mutex_unlock(&packet_pool.mutex);
+
+	return SR_OK;
+}
+
+/**
+ * Release the memory cached by the pool used by sr_packet_copy().
+ *
+ * @since 0.6.0
+ */
+SR_API void sr_packet_pool_trim(void)
+{
+	union pool_header *block;
+	int i;
+
+	g_mutex_lock(&packet_pool.mutex);
+	for (i = 0; i < PACKET_POOL_CLASSES; i++) {
+		while ((block = packet_pool.free[i])) {
+			packet_pool.free[i] = block->h.next;
+			g_free(block);
+		}
+		packet_pool.num_free[i] = 0;
+	}
+	packet_pool.stats.cached_bytes = 0;
+	g_mutex_unlock(&packet_pool.mutex);
+}
+
 static void copy_src(struct sr_config *src, struct sr_datafeed_meta *meta_copy)
 {
 	g_variant_ref(src->data);
@@ -1496,16 +3655,28 @@ SR_API int sr_packet_copy(const struct sr_datafeed_packet *packet,
 	struct sr_datafeed_logic *logic_copy;
 	const struct sr_datafeed_analog *analog;
 	struct sr_datafeed_analog *analog_copy;
+	const struct sr_datafeed_logic_edges *edges;
+	struct sr_datafeed_logic_edges *edges_copy;
 	uint8_t *payload;
 
-	*copy = g_malloc0(sizeof(struct sr_datafeed_packet));
+	*copy = pool_alloc0(sizeof(struct sr_datafeed_packet));
 	(*copy)->type = packet->type;
 
 	switch (packet->type) {
 	case SR_DF_TRIGGER:
 	case SR_DF_END:
+	case SR_DF_FRAME_END:
 		/* No payload. */
 		break;
+	case SR_DF_FRAME_BEGIN:
+		if (packet->payload)
+			(*copy)->payload = g_memdup(packet->payload,
+					sizeof(struct sr_datafeed_frame));
+		break;
+	case SR_DF_GAP:
+		(*copy)->payload = g_memdup(packet->payload,
+				sizeof(struct sr_datafeed_gap));
+		break;
 	case SR_DF_HEADER:
 		payload = g_malloc(sizeof(struct sr_datafeed_header));
 		memcpy(payload, packet->payload, sizeof(struct sr_datafeed_header));
@@ -1514,31 +3685,25 @@ SR_API int sr_packet_copy(const struct sr_datafeed_packet *packet,
 	case SR_DF_META:
 		meta = packet->payload;
 		meta_copy = g_malloc0(sizeof(struct sr_datafeed_meta));
-		g_slist_foreach(meta->config, (GFunc)copy_src, meta_copy->config);
+		g_slist_foreach(meta->config, (GFunc)copy_src, meta_copy);
 		(*copy)->payload = meta_copy;
 		break;
 	case SR_DF_LOGIC:
 		logic = packet->payload;
-		logic_copy = g_malloc(sizeof(*logic_copy));
-		if (!logic_copy)
-			return SR_ERR;
+		logic_copy = pool_alloc(sizeof(*logic_copy));
 		logic_copy->length = logic->length;
 		logic_copy->unitsize = logic->unitsize;
-		logic_copy->data = g_malloc(logic->length * logic->unitsize);
-		if (!logic_copy->data) {
-			g_free(logic_copy);
-			return SR_ERR;
-		}
-		memcpy(logic_copy->data, logic->data, logic->length * logic->unitsize);
+		/* The length is in bytes, not samples. */
+		logic_copy->data = pool_alloc(logic->length);
+		memcpy(logic_copy->data, logic->data, logic->length);
 		(*copy)->payload = logic_copy;
 		break;
 	case SR_DF_ANALOG:
 		analog = packet->payload;
-		analog_copy = g_malloc(sizeof(*analog_copy));
-		analog_copy->data = g_malloc(
-				analog->encoding->unitsize * analog->num_samples);
+		analog_copy = pool_alloc(sizeof(*analog_copy));
+		analog_copy->data = pool_alloc(sr_analog_data_size(analog));
 		memcpy(analog_copy->data, analog->data,
-				analog->encoding->unitsize * analog->num_samples);
+				sr_analog_data_size(analog));
 		analog_copy->num_samples = analog->num_samples;
 		analog_copy->encoding = g_memdup(analog->encoding,
 				sizeof(struct sr_analog_encoding));
@@ -1550,6 +3715,20 @@ SR_API int sr_packet_copy(const struct sr_datafeed_packet *packet,
 				sizeof(struct sr_analog_spec));
 		(*copy)->payload = analog_copy;
 		break;
+	case SR_DF_LOGIC_EDGES:
+		edges = packet->payload;
+		edges_copy = pool_alloc(sizeof(*edges_copy));
+		*edges_copy = *edges;
+		edges_copy->offsets = pool_alloc(
+				edges->num_edges * sizeof(uint64_t));
+		memcpy(edges_copy->offsets, edges->offsets,
+				edges->num_edges * sizeof(uint64_t));
+		edges_copy->values = pool_alloc(
+				edges->num_edges * edges->unitsize);
+		memcpy(edges_copy->values, edges->values,
+				edges->num_edges * edges->unitsize);
+		(*copy)->payload = edges_copy;
+		break;
 	default:
 		sr_err("Unknown packet type %d", packet->type);
 		return SR_ERR;
@@ -1563,14 +3742,24 @@ SR_API void sr_packet_free(struct sr_datafeed_packet *packet)
 	const struct sr_datafeed_meta *meta;
 	const struct sr_datafeed_logic *logic;
 	const struct sr_datafeed_analog *analog;
+	const struct sr_datafeed_logic_edges *edges;
 	struct sr_config *src;
 	GSList *l;
 
 	switch (packet->type) {
 	case SR_DF_TRIGGER:
 	case SR_DF_END:
+	case SR_DF_FRAME_END:
 		/* No payload. */
 		break;
+	case SR_DF_FRAME_BEGIN:
+		/* Optional payload is a simple struct. */
+		g_free((void *)packet->payload);
+		break;
+	case SR_DF_GAP:
+		/* Payload is a simple struct. */
+		g_free((void *)packet->payload);
+		break;
 	case SR_DF_HEADER:
 		/* Payload is a simple struct. */
 		g_free((void *)packet->payload);
@@ -1587,22 +3776,374 @@ SR_API void sr_packet_free(struct sr_datafeed_packet *packet)
 		break;
 	case SR_DF_LOGIC:
 		logic = packet->payload;
-		g_free(logic->data);
-		g_free((void *)packet->payload);
+		pool_free(logic->data);
+		pool_free((void *)packet->payload);
 		break;
 	case SR_DF_ANALOG:
 		analog = packet->payload;
-		g_free(analog->data);
+		pool_free(analog->data);
 		g_free(analog->encoding);
 		g_slist_free(analog->meaning->channels);
 		g_free(analog->meaning);
 		g_free(analog->spec);
-		g_free((void *)packet->payload);
+		pool_free((void *)packet->payload);
+		break;
+	case SR_DF_LOGIC_EDGES:
+		edges = packet->payload;
+		pool_free(edges->offsets);
+		pool_free(edges->values);
+		pool_free((void *)packet->payload);
 		break;
 	default:
 		sr_err("Unknown packet type %d", packet->type);
 	}
-	g_free(packet);
+	pool_free(packet);
+}
+
+/**
+ * Create a reference counted buffer around a memory region.
+ *
+ * The caller holds the initial reference.
+ *
+ * @param data The memory region. Must not be NULL.
+ * @param size The size of the memory region in bytes.
+ * @param free_func Function to release @a data when the last reference
+ *                  is dropped. Can be NULL.
+ *
+ * @return The new buffer.
+ *
+ * @private
+ */
+SR_PRIV struct sr_packet_buffer *sr_packet_buffer_new(void *data,
+		size_t size, GDestroyNotify free_func)
+{
+	struct sr_packet_buffer *buf;
+
+	buf = g_malloc0(sizeof(*buf));
+	buf->refcount = 1;
+	buf->data = data;
+	buf->size = size;
+	buf->free_func = free_func;
+
+	return buf;
+}
+
+/** @private */
+SR_PRIV struct sr_packet_buffer *sr_packet_buffer_ref(
+		struct sr_packet_buffer *buf)
+{
+	g_atomic_int_inc(&buf->refcount);
+
+	return buf;
+}
+
+/** @private */
+SR_PRIV void sr_packet_buffer_unref(struct sr_packet_buffer *buf)
+{
+	if (!buf)
+		return;
+	if (!g_atomic_int_dec_and_test(&buf->refcount))
+		return;
+
+	if (buf->free_func)
+		buf->free_func(buf->data);
+	g_free(buf);
+}
+
+/**
+ * Drop a reference to a buffer, and reclaim its memory if possible.
+ *
+ * When the caller held the last reference, the buffer is released but
+ * its memory region is not, and the caller regains ownership of it.
+ * Otherwise the remaining holders of references take over the memory
+ * region, and free it when done.
+ *
+ * This allows drivers to keep re-using their acquisition buffers for
+ * as long as no consumer retains packets.
+ *
+ * @param buf The buffer. Must not be NULL.
+ *
+ * @retval TRUE The caller owns the memory region again.
+ * @retval FALSE The memory region is still in use elsewhere.
+ *
+ * @private
+ */
+SR_PRIV gboolean sr_packet_buffer_reclaim(struct sr_packet_buffer *buf)
+{
+	if (!g_atomic_int_dec_and_test(&buf->refcount))
+		return FALSE;
+
+	g_free(buf);
+
+	return TRUE;
+}
+
+/** @cond PRIVATE */
+struct packet_ref {
+	struct sr_datafeed_packet packet;
+	int64_t timestamp;
+	uint64_t sample_index;
+	struct sr_packet_buffer *buffer;
+	struct sr_datafeed_packet *copy;
+	struct sr_datafeed_logic logic;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+};
+/** @endcond */
+
+static void packet_ref_register(struct packet_ref *pref)
+{
+	g_mutex_lock(&packet_refs_mutex);
+	if (!packet_refs)
+		packet_refs = g_hash_table_new(NULL, NULL);
+	g_hash_table_add(packet_refs, pref);
+	g_mutex_unlock(&packet_refs_mutex);
+}
+
+static void packet_ref_unregister(struct packet_ref *pref)
+{
+	g_mutex_lock(&packet_refs_mutex);
+	g_hash_table_remove(packet_refs, pref);
+	if (!g_hash_table_size(packet_refs)) {
+		g_hash_table_destroy(packet_refs);
+		packet_refs = NULL;
+	}
+	g_mutex_unlock(&packet_refs_mutex);
+}
+
+/* Whether a packet came from sr_packet_ref() and is not released yet. */
+static gboolean packet_ref_known(const struct sr_datafeed_packet *packet)
+{
+	gboolean known;
+
+	g_mutex_lock(&packet_refs_mutex);
+	known = packet_refs && g_hash_table_contains(packet_refs, packet);
+	g_mutex_unlock(&packet_refs_mutex);
+
+	return known;
+}
+
+static gboolean buffer_contains(const struct sr_packet_buffer *buf,
+		const void *data, size_t size)
+{
+	const uint8_t *start, *end, *p;
+
+	if (!buf || !data)
+		return FALSE;
+
+	start = buf->data;
+	end = start + buf->size;
+	p = data;
+
+	return p >= start && p <= end && size <= (size_t)(end - p);
+}
+
+/**
+ * Retain a datafeed packet beyond the lifetime of a datafeed callback.
+ *
+ * Logic and analog packets which a driver sends from a buffer attached
+ * to the session get shared with the driver without copying the sample
+ * data. For other packets, their data gets copied once, and the copy is
+ * shared between all datafeed callbacks which retain the same packet.
+ * Packets which are not currently being sent are copied.
+ *
+ * The resulting packet is read-only, and must be released by means of
+ * sr_packet_unref().
+ *
+ * @param sdi The device instance which sent the packet, as passed to the
+ *            datafeed callback. Can be NULL, in which case the packet
+ *            is always copied.
+ * @param packet The packet to retain. Must not be NULL.
+ * @param ref Pointer to store the retained packet. Must not be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval SR_ERR Other error.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_packet_ref(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet,
+		struct sr_datafeed_packet **ref)
+{
+	struct sr_session *session;
+	struct packet_ref *pref;
+	struct sr_packet_buffer **cached, *buf;
+	const struct sr_datafeed_logic *logic;
+	const struct sr_datafeed_analog *analog;
+	const void *data;
+	size_t size;
+	int ret;
+
+	if (!packet || !ref)
+		return SR_ERR_ARG;
+	*ref = NULL;
+
+	pref = g_malloc0(sizeof(*pref));
+	pref->packet.type = packet->type;
+	session = sdi ? sdi->session : NULL;
+	if (packet == g_private_get(&dispatch_current))
+		sr_packet_timestamp_get(sdi, packet, &pref->timestamp,
+			&pref->sample_index);
+	else
+		send_context_get(session, packet, &pref->timestamp,
+			&pref->sample_index);
+
+	switch (packet->type) {
+	case SR_DF_LOGIC:
+		logic = packet->payload;
+		data = logic->data;
+		size = logic->length;
+		pref->logic = *logic;
+		pref->packet.payload = &pref->logic;
+		break;
+	case SR_DF_ANALOG:
+		analog = packet->payload;
+		data = analog->data;
+		size = sr_analog_data_size(analog);
+		pref->analog = *analog;
+		pref->encoding = *analog->encoding;
+		pref->meaning = *analog->meaning;
+		pref->meaning.channels = g_slist_copy(analog->meaning->channels);
+		pref->spec = *analog->spec;
+		pref->analog.encoding = &pref->encoding;
+		pref->analog.meaning = &pref->meaning;
+		pref->analog.spec = &pref->spec;
+		pref->packet.payload = &pref->analog;
+		break;
+	default:
+		/* No bulk data involved, a plain copy will do. */
+		ret = sr_packet_copy(packet, &pref->copy);
+		if (ret != SR_OK) {
+			g_free(pref);
+			return ret;
+		}
+		pref->packet.payload = pref->copy->payload;
+		packet_ref_register(pref);
+		*ref = &pref->packet;
+		return SR_OK;
+	}
+
+	session = sdi ? sdi->session : NULL;
+	if (packet == g_private_get(&dispatch_current)) {
+		/* Retained by async dispatch already, share its buffer. */
+		buf = sr_packet_buffer_ref(((struct packet_ref *)packet)->buffer);
+	} else if (session && buffer_contains(session->send_buffer, data, size)) {
+		/* Zero copy, share the driver's memory. */
+		buf = sr_packet_buffer_ref(session->send_buffer);
+	} else {
+		cached = (session && packet == session->send_packet)
+			? &session->send_copy : NULL;
+		/* Callbacks may run on worker threads. */
+		if (cached)
+			g_mutex_lock(&session->send_mutex);
+		if (cached && *cached) {
+			buf = sr_packet_buffer_ref(*cached);
+		} else {
+			buf = sr_packet_buffer_new(g_malloc(size ? size : 1),
+				size, g_free);
+			memcpy(buf->data, data, size);
+			if (cached)
+				*cached = sr_packet_buffer_ref(buf);
+		}
+		if (cached)
+			g_mutex_unlock(&session->send_mutex);
+		data = buf->data;
+	}
+	pref->buffer = buf;
+
+	if (packet->type == SR_DF_LOGIC)
+		pref->logic.data = (void *)data;
+	else
+		pref->analog.data = (void *)data;
+
+	packet_ref_register(pref);
+	*ref = &pref->packet;
+
+	return SR_OK;
+}
+
+/**
+ * Release a packet which was retained by sr_packet_ref().
+ *
+ * @param ref The packet to release. Can be NULL.
+ *
+ * @since 0.6.0
+ */
+SR_API void sr_packet_unref(struct sr_datafeed_packet *ref)
+{
+	struct packet_ref *pref;
+
+	if (!ref)
+		return;
+
+	pref = (struct packet_ref *)ref;
+	packet_ref_unregister(pref);
+	if (pref->copy)
+		sr_packet_free(pref->copy);
+	if (pref->packet.type == SR_DF_ANALOG)
+		g_slist_free(pref->meaning.channels);
+	sr_packet_buffer_unref(pref->buffer);
+	g_free(pref);
+}
+
+/**
+ * Get the time and position of a logic or analog packet in its stream.
+ *
+ * The timestamp is taken from the monotonic host clock when the device
+ * sent the packet, unless the driver provided the hardware time. The
+ * sample index is the number of samples the device sent in previous
+ * packets of the same type during this session run. It counts the
+ * samples of all analog packets, regardless of their channels.
+ *
+ * Together, they allow consumers to merge the streams of multiple
+ * devices in a session.
+ *
+ * @param sdi The device which sent the packet.
+ * @param packet The packet which is being passed to a datafeed callback,
+ *               or a packet retained by sr_packet_ref(). Must not be NULL.
+ * @param timestamp Pointer to store the time in microseconds, on the
+ *                  scale of g_get_monotonic_time(). Can be NULL.
+ * @param sample_index Pointer to store the index of the packet's first
+ *                     sample. Can be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval SR_ERR_NA The packet is neither being sent nor retained.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_packet_timestamp_get(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet,
+		int64_t *timestamp, uint64_t *sample_index)
+{
+	struct sr_session *session;
+	const struct packet_ref *pref;
+	int64_t ts;
+	uint64_t index;
+
+	if (!packet)
+		return SR_ERR_ARG;
+
+	session = sdi ? sdi->session : NULL;
+	if (!send_context_get(session, packet, &ts, &index)) {
+		/* Only the packets of sr_packet_ref() carry their time. */
+		if (packet != g_private_get(&dispatch_current)
+				&& !packet_ref_known(packet))
+			return SR_ERR_NA;
+		pref = (const struct packet_ref *)packet;
+		ts = pref->timestamp;
+		index = pref->sample_index;
+	}
+
+	if (timestamp)
+		*timestamp = ts;
+	if (sample_index)
+		*sample_index = index;
+
+	return SR_OK;
 }
 
 /** @} */
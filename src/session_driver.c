@@ -33,6 +33,19 @@
 /** @cond PRIVATE */
 #define CHUNKSIZE (4 * 1024 * 1024)
 /** @endcond */
+/* Default read size of files without analog data. */
+#define CHUNKSIZE_LOGIC (16 * 1024 * 1024)
+/* Number of blocks the prefetch thread reads ahead. */
+#define PREFETCH_DEPTH 2
+/* Default read size of SR_PLAYBACK_MAX. */
+#define CHUNKSIZE_MAX (64 * 1024 * 1024)
+/* Longest time SR_PLAYBACK_MAX sends blocks without returning. */
+#define MAX_SLICE_US (50 * 1000)
+/* Interval at which SR_PLAYBACK_REALTIME sends the samples due. */
+#define REALTIME_INTERVAL_MS 10
+
+/* Entry written by the srzip output, listing the chunks' sample ranges. */
+#define INDEX_NAME "chunkindex"
 
 SR_PRIV struct sr_dev_driver session_driver_info;
 
@@ -50,6 +63,60 @@ struct session_vdev {
 	GArray *analog_channels;
 	int cur_chunk;
 	gboolean finished;
+	/* Sample range to play back, see sr_session_driver_range_set(). */
+	uint64_t range_start;
+	uint64_t range_count;
+	uint64_t cur_sample;
+	gboolean range_done;
+	/* Chunk name -> struct chunk_range, from the archive's index. */
+	GHashTable *index;
+	gboolean eof;
+	/* Read size in bytes set by SR_CONF_BUFFERSIZE, 0 picks one. */
+	uint64_t buffer_size;
+	size_t read_size;
+	/* Read buffers which consumers did not retain. */
+	GSList *spare_bufs;
+	/* Prefetch thread, and the blocks it has read. */
+	GThread *thread;
+	GMutex mutex;
+	GCond cond;
+	GQueue blocks;
+	gboolean prefetch_done;
+	gboolean stop;
+	/* Decoder threads, and their archive handles. */
+	unsigned int decode_threads;
+	GThreadPool *decoders;
+	GAsyncQueue *archives;
+	/* Chunks hold bit planes and delta encoded analog samples. */
+	gboolean planes;
+	/* Channel -> struct sr_analog_encoding of integer analog samples. */
+	GHashTable *encodings;
+	/* See sr_session_playback_set(). */
+	enum sr_playback_mode playback;
+	/* Block which was only partially sent. */
+	struct read_block *cur_blk;
+	/* Realtime playback: start and samples sent of the current channel. */
+	int64_t rt_start;
+	uint64_t rt_sent;
+	int rt_channel;
+};
+
+/* A block of sample data read from a capture file. */
+struct read_block {
+	uint8_t *buf;
+	size_t size;
+	size_t offset;
+	size_t length;
+	/* 0 for logic data, else like session_vdev.cur_analog_channel. */
+	int analog_channel;
+	/* Chunks which the decoder threads read as a whole. */
+	char *name;
+	gboolean pending;
+};
+
+struct chunk_range {
+	uint64_t first;
+	uint64_t last;
 };
 
 static const uint32_t devopts[] = {
@@ -59,151 +126,676 @@ static const uint32_t devopts[] = {
 	SR_CONF_NUM_ANALOG_CHANNELS | SR_CONF_SET,
 	SR_CONF_SAMPLERATE | SR_CONF_GET | SR_CONF_SET,
 	SR_CONF_SESSIONFILE | SR_CONF_SET,
+	SR_CONF_BUFFERSIZE | SR_CONF_GET | SR_CONF_SET,
 };
 
-static gboolean stream_session_data(struct sr_dev_inst *sdi)
+/* Read the archive's chunk index, if there is one. */
+static void index_load(struct session_vdev *vdev)
 {
-	struct session_vdev *vdev;
-	struct sr_datafeed_packet packet;
-	struct sr_datafeed_logic logic;
-	struct sr_datafeed_analog analog;
-	struct sr_analog_encoding encoding;
-	struct sr_analog_meaning meaning;
-	struct sr_analog_spec spec;
 	struct zip_stat zs;
-	int ret, got_data;
-	char capturefile[128];
-	void *buf;
+	struct zip_file *zf;
+	struct chunk_range *range;
+	char *buf, **lines, name[128];
+	uint64_t first, last;
+	int i;
 
-	got_data = FALSE;
-	vdev = sdi->priv;
+	if (zip_stat(vdev->archive, INDEX_NAME, 0, &zs) < 0)
+		return;
+	if (!(zf = zip_fopen(vdev->archive, INDEX_NAME, 0)))
+		return;
+	buf = g_malloc(zs.size + 1);
+	if (zip_fread(zf, buf, zs.size) != (zip_int64_t)zs.size) {
+		sr_warn("Failed to read the chunk index.");
+		zip_fclose(zf);
+		g_free(buf);
+		return;
+	}
+	zip_fclose(zf);
+	buf[zs.size] = '\0';
 
-	if (!vdev->capfile) {
-		/* No capture file opened yet, or finished with the last
-		 * chunked one. */
-		if (vdev->capturefile && (vdev->cur_chunk == 0)) {
-			/* capturefile is always the unchunked base name. */
-			if (zip_stat(vdev->archive, vdev->capturefile, 0, &zs) != -1) {
-				/* No chunks, just a single capture file. */
-				vdev->cur_chunk = 0;
-				if (!(vdev->capfile = zip_fopen(vdev->archive,
-						vdev->capturefile, 0)))
-					return FALSE;
-				sr_dbg("Opened %s.", vdev->capturefile);
-			} else {
-				/* Try as first chunk filename. */
-				snprintf(capturefile, sizeof(capturefile) - 1, "%s-1", vdev->capturefile);
-				if (zip_stat(vdev->archive, capturefile, 0, &zs) != -1) {
-					vdev->cur_chunk = 1;
-					if (!(vdev->capfile = zip_fopen(vdev->archive,
-							capturefile, 0)))
-						return FALSE;
-					sr_dbg("Opened %s.", capturefile);
-				} else {
-					sr_err("No capture file '%s' in " "session file '%s'.",
-							vdev->capturefile, vdev->sessionfile);
-					return FALSE;
-				}
-			}
+	vdev->index = g_hash_table_new_full(g_str_hash, g_str_equal,
+			g_free, g_free);
+	lines = g_strsplit(buf, "\n", 0);
+	for (i = 0; lines[i]; i++) {
+		if (lines[i][0] == '#')
+			continue;
+		if (sscanf(lines[i], "%127s %" SCNu64 " %" SCNu64,
+				name, &first, &last) != 3)
+			continue;
+		range = g_malloc(sizeof(*range));
+		range->first = first;
+		range->last = last;
+		g_hash_table_insert(vdev->index, g_strdup(name), range);
+	}
+	g_strfreev(lines);
+	g_free(buf);
+	sr_dbg("Loaded index of %u chunks.", g_hash_table_size(vdev->index));
+}
+
+/*
+ * Return the number of the first chunk from @chunk on which holds
+ * samples of the requested range. Chunks which the index lists as
+ * ending before the range are skipped without being read. Without
+ * an index, the chunks get read, and the samples discarded.
+ */
+static int index_seek(struct session_vdev *vdev, int chunk)
+{
+	const struct chunk_range *range;
+	char name[128];
+
+	if (!vdev->index)
+		return chunk;
+	while (vdev->cur_sample < vdev->range_start) {
+		snprintf(name, sizeof(name), "%s-%d", vdev->capturefile, chunk);
+		range = g_hash_table_lookup(vdev->index, name);
+		if (!range || range->first != vdev->cur_sample ||
+				range->last >= vdev->range_start)
+			break;
+		vdev->cur_sample = range->last + 1;
+		chunk++;
+	}
+
+	return chunk;
+}
+
+/*
+ * Find the capture file or chunk to read next, and put its name into
+ * @name. Returns FALSE when all data was read, or on errors. When
+ * switching to the next analog channel, @name is left empty and the
+ * caller has to try again.
+ */
+static gboolean next_entry(struct session_vdev *vdev, char *name,
+	size_t size, struct zip_stat *zs)
+{
+	name[0] = '\0';
+	if (vdev->capturefile && (vdev->cur_chunk == 0)) {
+		/* capturefile is always the unchunked base name. */
+		if (zip_stat(vdev->archive, vdev->capturefile, 0, zs) != -1) {
+			/* No chunks, just a single capture file. */
+			vdev->cur_chunk = 0;
+			snprintf(name, size, "%s", vdev->capturefile);
 		} else {
-			/* Capture data is chunked, advance to the next chunk. */
-			vdev->cur_chunk++;
-			snprintf(capturefile, sizeof(capturefile) - 1, "%s-%d", vdev->capturefile,
-					vdev->cur_chunk);
-			if (zip_stat(vdev->archive, capturefile, 0, &zs) != -1) {
-				if (!(vdev->capfile = zip_fopen(vdev->archive,
-						capturefile, 0)))
-					return FALSE;
-				sr_dbg("Opened %s.", capturefile);
-			} else if (vdev->cur_analog_channel < vdev->num_analog_channels) {
-				vdev->capturefile = g_strdup_printf("analog-1-%d",
-						vdev->num_logic_channels + vdev->cur_analog_channel + 1);
-				vdev->cur_analog_channel++;
-				vdev->cur_chunk = 0;
-				return TRUE;
-			} else {
-				/* We got all the chunks, finish up. */
-				g_free(vdev->capturefile);
-
-				/* If the file has logic channels, the initial value for
-				 * capturefile is set by stream_session_data() - however only
-				 * once. In order to not mess this mechanism up, we simulate
-				 * this here if needed. For purely analog files, capturefile
-				 * is not set.
-				 */
-				if (vdev->num_logic_channels)
-					vdev->capturefile = g_strdup("logic-1");
-				else
-					vdev->capturefile = NULL;
+			/* Try as first chunk filename. */
+			vdev->cur_chunk = index_seek(vdev, 1);
+			snprintf(name, size, "%s-%d",
+					vdev->capturefile, vdev->cur_chunk);
+			if (zip_stat(vdev->archive, name, 0, zs) == -1) {
+				sr_err("No capture file '%s' in " "session file '%s'.",
+						vdev->capturefile, vdev->sessionfile);
 				return FALSE;
 			}
 		}
+	} else {
+		/* Capture data is chunked, advance to the next chunk. */
+		vdev->cur_chunk = index_seek(vdev, vdev->cur_chunk + 1);
+		snprintf(name, size, "%s-%d", vdev->capturefile,
+				vdev->cur_chunk);
+		if (!vdev->range_done &&
+				zip_stat(vdev->archive, name, 0, zs) != -1) {
+			/* Next chunk found. */
+		} else if (vdev->cur_analog_channel < vdev->num_analog_channels) {
+			name[0] = '\0';
+			g_free(vdev->capturefile);
+			vdev->capturefile = g_strdup_printf("analog-1-%d",
+					vdev->num_logic_channels + vdev->cur_analog_channel + 1);
+			vdev->cur_analog_channel++;
+			vdev->cur_chunk = 0;
+			vdev->cur_sample = 0;
+			vdev->range_done = FALSE;
+		} else {
+			/* We got all the chunks, finish up. */
+			g_free(vdev->capturefile);
+
+			/* If the file has logic channels, the initial value for
+			 * capturefile is set by stream_session_data() - however only
+			 * once. In order to not mess this mechanism up, we simulate
+			 * this here if needed. For purely analog files, capturefile
+			 * is not set.
+			 */
+			if (vdev->num_logic_channels)
+				vdev->capturefile = g_strdup("logic-1");
+			else
+				vdev->capturefile = NULL;
+			return FALSE;
+		}
 	}
 
-	buf = g_malloc(CHUNKSIZE);
+	return TRUE;
+}
 
-	/* unitsize is not defined for purely analog session files. */
-	if (vdev->unitsize)
+/*
+ * Account for @count samples read from the current channel, and cut
+ * them down to the requested sample range. Returns the number of
+ * samples to skip and to send.
+ */
+static void range_trim(struct session_vdev *vdev, uint64_t count,
+	uint64_t *skip, uint64_t *send)
+{
+	uint64_t first, end, range_end;
+
+	first = vdev->cur_sample;
+	end = first + count;
+	vdev->cur_sample = end;
+	*skip = 0;
+	if (first < vdev->range_start) {
+		*skip = MIN(vdev->range_start - first, count);
+		first += *skip;
+	}
+	if (vdev->range_count) {
+		range_end = vdev->range_start + vdev->range_count;
+		if (end >= range_end) {
+			end = MAX(first, range_end);
+			vdev->range_done = TRUE;
+		}
+	}
+	*send = end - first;
+}
+
+/* Get a read buffer, preferably one which the consumers gave back. */
+static uint8_t *read_buf_get(struct session_vdev *vdev)
+{
+	uint8_t *buf;
+
+	g_mutex_lock(&vdev->mutex);
+	buf = vdev->spare_bufs ? vdev->spare_bufs->data : NULL;
+	vdev->spare_bufs = g_slist_delete_link(vdev->spare_bufs,
+			vdev->spare_bufs);
+	g_mutex_unlock(&vdev->mutex);
+
+	return buf ? buf : g_try_malloc(vdev->read_size);
+}
+
+static void read_buf_put(struct session_vdev *vdev, uint8_t *buf)
+{
+	g_mutex_lock(&vdev->mutex);
+	vdev->spare_bufs = g_slist_prepend(vdev->spare_bufs, buf);
+	g_mutex_unlock(&vdev->mutex);
+}
+
+/* Encoding of an analog channel's integer samples, NULL for floats. */
+static const struct sr_analog_encoding *analog_encoding(
+	struct session_vdev *vdev, int analog_channel)
+{
+	struct sr_channel *ch;
+
+	if (!vdev->encodings || analog_channel == 0)
+		return NULL;
+	ch = g_array_index(vdev->analog_channels, struct sr_channel *,
+		analog_channel - 1);
+
+	return g_hash_table_lookup(vdev->encodings, ch);
+}
+
+/*
+ * Read a whole chunk, and undo its encoding. Returns NULL on errors.
+ * Encoded chunks can only be decoded as a whole.
+ */
+static uint8_t *read_chunk(struct session_vdev *vdev, struct zip *archive,
+	const char *name, size_t size, int analog_channel)
+{
+	struct zip_file *zf;
+	uint8_t *buf, *raw;
+
+	if (!(zf = zip_fopen(archive, name, 0)))
+		return NULL;
+	buf = g_try_malloc(MAX(size, 1));
+	if (buf && zip_fread(zf, buf, size) != (zip_int64_t)size) {
+		g_free(buf);
+		buf = NULL;
+	}
+	zip_fclose(zf);
+
+	if (buf && vdev->planes && !analog_encoding(vdev, analog_channel)) {
+		if (!(raw = g_try_malloc(MAX(size, 1)))) {
+			g_free(buf);
+			return NULL;
+		}
+		if (analog_channel != 0)
+			sr_sessionfile_delta_decode((float *)raw, buf,
+				size / sizeof(float));
+		else
+			sr_sessionfile_planes_decode(raw, buf, size,
+				vdev->unitsize);
+		g_free(buf);
+		buf = raw;
+	}
+
+	return buf;
+}
+
+/*
+ * Decoder thread: decompresses a whole chunk. Each decoder opens an
+ * archive handle of its own, libzip archives must not be shared by
+ * threads.
+ */
+static void decode_chunk(gpointer data, gpointer user_data)
+{
+	struct session_vdev *vdev;
+	struct read_block *blk;
+	struct zip *archive;
+	uint8_t *buf;
+	int ret;
+
+	blk = data;
+	vdev = user_data;
+
+	buf = NULL;
+	if (!(archive = g_async_queue_try_pop(vdev->archives)))
+		archive = zip_open(vdev->sessionfile, 0, &ret);
+	if (archive) {
+		buf = read_chunk(vdev, archive, blk->name, blk->size,
+			blk->analog_channel);
+		g_async_queue_push(vdev->archives, archive);
+	}
+	if (!buf)
+		sr_err("Failed to decode chunk '%s'.", blk->name);
+
+	g_mutex_lock(&vdev->mutex);
+	blk->buf = buf;
+	blk->pending = FALSE;
+	g_cond_broadcast(&vdev->cond);
+	g_mutex_unlock(&vdev->mutex);
+}
+
+/* Hand a whole chunk over to the decoder threads. */
+static struct read_block *decode_submit(struct session_vdev *vdev,
+	const char *name, const struct zip_stat *zs, int sample_size)
+{
+	struct read_block *blk;
+	uint64_t skip, send;
+
+	range_trim(vdev, zs->size / sample_size, &skip, &send);
+	if (!send)
+		return NULL;
+
+	blk = g_malloc0(sizeof(*blk));
+	blk->name = g_strdup(name);
+	blk->size = zs->size;
+	blk->offset = skip * sample_size;
+	blk->length = send * sample_size;
+	blk->analog_channel = vdev->cur_analog_channel;
+	blk->pending = TRUE;
+	g_thread_pool_push(vdev->decoders, blk, NULL);
+
+	return blk;
+}
+
+/* Read a whole encoded chunk, without decoder threads. */
+static struct read_block *read_whole(struct session_vdev *vdev,
+	const char *name, const struct zip_stat *zs, int sample_size)
+{
+	struct read_block *blk;
+	uint64_t skip, send;
+	uint8_t *buf;
+
+	range_trim(vdev, zs->size / sample_size, &skip, &send);
+	if (!send)
+		return NULL;
+
+	if (!(buf = read_chunk(vdev, vdev->archive, name, zs->size,
+			vdev->cur_analog_channel))) {
+		sr_err("Failed to decode chunk '%s'.", name);
+		vdev->eof = TRUE;
+		return NULL;
+	}
+	sr_dbg("Decoded %s.", name);
+
+	blk = g_malloc0(sizeof(*blk));
+	blk->buf = buf;
+	blk->size = zs->size;
+	blk->offset = skip * sample_size;
+	blk->length = send * sample_size;
+	blk->analog_channel = vdev->cur_analog_channel;
+
+	return blk;
+}
+
+static void read_block_free(struct read_block *blk)
+{
+	g_free(blk->name);
+	g_free(blk->buf);
+	g_free(blk);
+}
+
+/*
+ * Read the next block of sample data, opening capture files and chunks
+ * as needed, and cut it down to the requested sample range. Returns
+ * NULL when all data was read, or on errors.
+ */
+static struct read_block *read_block(struct session_vdev *vdev)
+{
+	const struct sr_analog_encoding *enc;
+	struct read_block *blk;
+	struct zip_stat zs;
+	uint64_t skip, send;
+	int ret, sample_size;
+	char name[128];
+	uint8_t *buf;
+
+	while (!vdev->eof) {
+		/* unitsize is not defined for purely analog session files. */
+		if ((enc = analog_encoding(vdev, vdev->cur_analog_channel)))
+			sample_size = enc->unitsize;
+		else if (vdev->cur_analog_channel != 0)
+			sample_size = sizeof(float);
+		else
+			sample_size = vdev->unitsize;
+
+		if (!vdev->capfile) {
+			if (!next_entry(vdev, name, sizeof(name), &zs))
+				break;
+			if (!name[0])
+				continue;
+			if (!sample_size) {
+				/*
+				 * Neither analog data, nor logic which has
+				 * unitsize, must be an unexpected API use.
+				 */
+				sr_warn("Neither analog nor logic data. Ignoring.");
+				break;
+			}
+			/* Chunks get decoded as a whole, in parallel. */
+			if (vdev->decoders && vdev->cur_chunk != 0) {
+				if ((blk = decode_submit(vdev, name, &zs, sample_size)))
+					return blk;
+				continue;
+			}
+			if (vdev->planes) {
+				blk = read_whole(vdev, name, &zs, sample_size);
+				/* Unchunked capture files are done in one go. */
+				if (vdev->cur_chunk == 0)
+					vdev->eof = TRUE;
+				if (blk)
+					return blk;
+				if (vdev->eof)
+					break;
+				continue;
+			}
+			if (!(vdev->capfile = zip_fopen(vdev->archive, name, 0)))
+				break;
+			sr_dbg("Opened %s.", name);
+		}
+
+		if (!(buf = read_buf_get(vdev))) {
+			sr_err("Failed to allocate read buffer.");
+			break;
+		}
 		ret = zip_fread(vdev->capfile, buf,
-				CHUNKSIZE / vdev->unitsize * vdev->unitsize);
-	else
-		ret = zip_fread(vdev->capfile, buf, CHUNKSIZE);
-
-	if (ret > 0) {
-		if (vdev->cur_analog_channel != 0) {
-			got_data = TRUE;
-			packet.type = SR_DF_ANALOG;
-			packet.payload = &analog;
-			/* TODO: Use proper 'digits' value for this device (and its modes). */
-			sr_analog_init(&analog, &encoding, &meaning, &spec, 2);
-			analog.meaning->channels = g_slist_prepend(NULL,
-					g_array_index(vdev->analog_channels,
-						struct sr_channel *, vdev->cur_analog_channel - 1));
-			analog.num_samples = ret / sizeof(float);
-			analog.meaning->mq = SR_MQ_VOLTAGE;
-			analog.meaning->unit = SR_UNIT_VOLT;
-			analog.meaning->mqflags = SR_MQFLAG_DC;
-			analog.data = (float *) buf;
-		} else if (vdev->unitsize) {
-			got_data = TRUE;
-			if (ret % vdev->unitsize != 0)
-				sr_warn("Read size %d not a multiple of the"
-					" unit size %d.", ret, vdev->unitsize);
-			packet.type = SR_DF_LOGIC;
-			packet.payload = &logic;
-			logic.length = ret;
-			logic.unitsize = vdev->unitsize;
-			logic.data = buf;
-		} else {
-			/*
-			 * Neither analog data, nor logic which has
-			 * unitsize, must be an unexpected API use.
-			 */
-			sr_warn("Neither analog nor logic data. Ignoring.");
+				vdev->read_size / sample_size * sample_size);
+		if (ret <= 0) {
+			/* done with this capture file */
+			read_buf_put(vdev, buf);
+			zip_fclose(vdev->capfile);
+			vdev->capfile = NULL;
+			/* There might be more chunks. */
+			if (vdev->cur_chunk == 0)
+				break;
+			continue;
+		}
+		if (ret % sample_size != 0)
+			sr_warn("Read size %d not a multiple of the"
+				" sample size %d.", ret, sample_size);
+
+		range_trim(vdev, ret / sample_size, &skip, &send);
+		if (vdev->range_done) {
+			/* Past the range, don't read the rest of the channel. */
+			zip_fclose(vdev->capfile);
+			vdev->capfile = NULL;
+			vdev->eof = vdev->cur_chunk == 0;
 		}
-		if (got_data) {
-			vdev->bytes_read += ret;
-			sr_session_send(sdi, &packet);
+		if (!send) {
+			/* Still before the range, keep going. */
+			read_buf_put(vdev, buf);
+			continue;
+		}
+
+		blk = g_malloc0(sizeof(*blk));
+		blk->buf = buf;
+		blk->size = vdev->read_size;
+		blk->offset = skip * sample_size;
+		blk->length = send * sample_size;
+		blk->analog_channel = vdev->cur_analog_channel;
+		return blk;
+	}
+	vdev->eof = TRUE;
+
+	return NULL;
+}
+
+/*
+ * Prefetch thread: reads and decompresses blocks ahead of the session
+ * thread, which only has to dispatch them.
+ */
+static gpointer prefetch_thread(gpointer data)
+{
+	struct session_vdev *vdev;
+	struct read_block *blk;
+	gboolean stop;
+	guint depth;
+
+	vdev = data;
+	depth = PREFETCH_DEPTH;
+	if (vdev->decoders)
+		depth *= g_thread_pool_get_max_threads(vdev->decoders);
+	for (;;) {
+		g_mutex_lock(&vdev->mutex);
+		while (!vdev->stop && g_queue_get_length(&vdev->blocks) >= depth)
+			g_cond_wait(&vdev->cond, &vdev->mutex);
+		stop = vdev->stop;
+		g_mutex_unlock(&vdev->mutex);
+		if (stop)
+			break;
+
+		blk = read_block(vdev);
+
+		g_mutex_lock(&vdev->mutex);
+		vdev->prefetch_done = !blk;
+		if (blk)
+			g_queue_push_tail(&vdev->blocks, blk);
+		g_cond_broadcast(&vdev->cond);
+		g_mutex_unlock(&vdev->mutex);
+		if (!blk)
+			break;
+	}
+
+	return NULL;
+}
+
+/*
+ * Get the next block, from the prefetch thread if there is one. The
+ * queue keeps the blocks in file order, so chunks which the decoders
+ * finish early wait there until the ones before them are done.
+ */
+static struct read_block *next_block(struct session_vdev *vdev)
+{
+	struct read_block *blk;
+
+	if (!vdev->thread)
+		return read_block(vdev);
+
+	g_mutex_lock(&vdev->mutex);
+	while (!(blk = g_queue_peek_head(&vdev->blocks)) && !vdev->prefetch_done)
+		g_cond_wait(&vdev->cond, &vdev->mutex);
+	while (blk && blk->pending)
+		g_cond_wait(&vdev->cond, &vdev->mutex);
+	g_queue_pop_head(&vdev->blocks);
+	g_cond_broadcast(&vdev->cond);
+	g_mutex_unlock(&vdev->mutex);
+
+	if (blk && !blk->buf) {
+		/* The chunk failed to decode. */
+		read_block_free(blk);
+		return NULL;
+	}
+
+	return blk;
+}
+
+static void prefetch_stop(struct session_vdev *vdev)
+{
+	struct read_block *blk;
+	struct zip *archive;
+
+	if (vdev->thread) {
+		g_mutex_lock(&vdev->mutex);
+		vdev->stop = TRUE;
+		g_cond_broadcast(&vdev->cond);
+		g_mutex_unlock(&vdev->mutex);
+		g_thread_join(vdev->thread);
+		vdev->thread = NULL;
+	}
+	if (vdev->decoders) {
+		/* Let the decoders finish the chunks they were given. */
+		g_thread_pool_free(vdev->decoders, FALSE, TRUE);
+		vdev->decoders = NULL;
+	}
+	if (vdev->archives) {
+		while ((archive = g_async_queue_try_pop(vdev->archives)))
+			zip_discard(archive);
+		g_async_queue_unref(vdev->archives);
+		vdev->archives = NULL;
+	}
+	while ((blk = g_queue_pop_head(&vdev->blocks)))
+		read_block_free(blk);
+	g_slist_free_full(vdev->spare_bufs, g_free);
+	vdev->spare_bufs = NULL;
+}
+
+/*
+ * Send up to max_samples samples of the current block, all of them if
+ * max_samples is 0. Returns FALSE when all data was sent.
+ */
+static gboolean stream_session_data(struct sr_dev_inst *sdi,
+	uint64_t max_samples, uint64_t *sent)
+{
+	struct session_vdev *vdev;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic logic;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+	struct sr_packet_buffer *pbuf;
+	struct read_block *blk;
+	const struct sr_analog_encoding *enc;
+	uint8_t *data;
+	size_t sample_size, length;
+
+	vdev = sdi->priv;
+
+	if (!vdev->cur_blk && !(vdev->cur_blk = next_block(vdev)))
+		return FALSE;
+	blk = vdev->cur_blk;
+	data = blk->buf + blk->offset;
+
+	enc = analog_encoding(vdev, blk->analog_channel);
+	if (enc)
+		sample_size = enc->unitsize;
+	else if (blk->analog_channel != 0)
+		sample_size = sizeof(float);
+	else
+		sample_size = vdev->unitsize;
+	length = blk->length;
+	if (max_samples && max_samples < length / sample_size)
+		length = max_samples * sample_size;
+
+	if (blk->analog_channel != 0) {
+		packet.type = SR_DF_ANALOG;
+		packet.payload = &analog;
+		/* TODO: Use proper 'digits' value for this device (and its modes). */
+		sr_analog_init(&analog, &encoding, &meaning, &spec, 2);
+		analog.meaning->channels = g_slist_prepend(NULL,
+				g_array_index(vdev->analog_channels,
+					struct sr_channel *, blk->analog_channel - 1));
+		analog.num_samples = length / sample_size;
+		/* Integer samples are sent as they were captured. */
+		if (enc) {
+			encoding.unitsize = enc->unitsize;
+			encoding.is_signed = enc->is_signed;
+			encoding.is_float = FALSE;
+			encoding.is_bigendian = enc->is_bigendian;
+			encoding.scale = enc->scale;
+			encoding.offset = enc->offset;
 		}
+		analog.meaning->mq = SR_MQ_VOLTAGE;
+		analog.meaning->unit = SR_UNIT_VOLT;
+		analog.meaning->mqflags = SR_MQFLAG_DC;
+		analog.data = (float *) data;
 	} else {
-		/* done with this capture file */
-		zip_fclose(vdev->capfile);
-		vdev->capfile = NULL;
-		if (vdev->cur_chunk != 0) {
-			/* There might be more chunks, so don't fall through
-			 * to the SR_DF_END here. */
-			got_data = TRUE;
+		packet.type = SR_DF_LOGIC;
+		packet.payload = &logic;
+		logic.length = length;
+		logic.unitsize = vdev->unitsize;
+		logic.data = data;
+	}
+	vdev->bytes_read += length;
+	if (sent)
+		*sent = length / sample_size;
+
+	if (length < blk->length) {
+		/* The rest of the block follows, consumers copy this part. */
+		sr_session_send(sdi, &packet);
+		blk->offset += length;
+		blk->length -= length;
+	} else {
+		/*
+		 * Let consumers retain the read buffer's data without
+		 * copying it, and keep using it for reads unless they do.
+		 */
+		pbuf = sr_packet_buffer_new(blk->buf, blk->size, g_free);
+		sr_session_send_buffer_set(sdi->session, pbuf);
+		sr_session_send(sdi, &packet);
+		sr_session_send_buffer_set(sdi->session, NULL);
+		if (!sr_packet_buffer_reclaim(pbuf))
+			blk->buf = NULL;
+		else if (blk->size == vdev->read_size) {
+			read_buf_put(vdev, blk->buf);
+			blk->buf = NULL;
 		}
+		read_block_free(blk);
+		vdev->cur_blk = NULL;
 	}
-	g_free(buf);
+	if (packet.type == SR_DF_ANALOG)
+		g_slist_free(analog.meaning->channels);
 
-	return got_data;
+	return TRUE;
+}
+
+/*
+ * Send the samples which are due at the samplerate. Each channel's
+ * samples get paced on their own, as the file has them one channel
+ * after another.
+ */
+static gboolean stream_realtime(struct sr_dev_inst *sdi)
+{
+	struct session_vdev *vdev;
+	int64_t now;
+	uint64_t due, sent;
+
+	vdev = sdi->priv;
+	now = g_get_monotonic_time();
+	for (;;) {
+		if (!vdev->cur_blk && !(vdev->cur_blk = next_block(vdev)))
+			return FALSE;
+		if (vdev->cur_blk->analog_channel != vdev->rt_channel) {
+			vdev->rt_channel = vdev->cur_blk->analog_channel;
+			vdev->rt_start = now;
+			vdev->rt_sent = 0;
+		}
+		due = (double)(now - vdev->rt_start) * vdev->samplerate / 1000000;
+		if (due <= vdev->rt_sent)
+			return TRUE;
+		if (!stream_session_data(sdi, due - vdev->rt_sent, &sent))
+			return FALSE;
+		vdev->rt_sent += sent;
+	}
 }
 
 static int receive_data(int fd, int revents, void *cb_data)
 {
 	struct sr_dev_inst *sdi;
 	struct session_vdev *vdev;
+	int64_t start;
 
 	(void)fd;
 	(void)revents;
@@ -211,11 +803,34 @@ static int receive_data(int fd, int revents, void *cb_data)
 	sdi = cb_data;
 	vdev = sdi->priv;
 
-	if (!vdev->finished && !stream_session_data(sdi))
-		vdev->finished = TRUE;
+	switch (vdev->playback) {
+	case SR_PLAYBACK_MAX:
+		/* Return to the loop now and then, to notice stop requests. */
+		start = g_get_monotonic_time();
+		while (!vdev->finished) {
+			if (!stream_session_data(sdi, 0, NULL))
+				vdev->finished = TRUE;
+			if (g_get_monotonic_time() - start >= MAX_SLICE_US)
+				break;
+		}
+		break;
+	case SR_PLAYBACK_REALTIME:
+		if (!vdev->finished && !stream_realtime(sdi))
+			vdev->finished = TRUE;
+		break;
+	default:
+		if (!vdev->finished && !stream_session_data(sdi, 0, NULL))
+			vdev->finished = TRUE;
+		break;
+	}
 	if (!vdev->finished)
 		return G_SOURCE_CONTINUE;
 
+	if (vdev->cur_blk) {
+		read_block_free(vdev->cur_blk);
+		vdev->cur_blk = NULL;
+	}
+	prefetch_stop(vdev);
 	if (vdev->capfile) {
 		zip_fclose(vdev->capfile);
 		vdev->capfile = NULL;
@@ -224,6 +839,10 @@ static int receive_data(int fd, int revents, void *cb_data)
 		zip_discard(vdev->archive);
 		vdev->archive = NULL;
 	}
+	if (vdev->index) {
+		g_hash_table_destroy(vdev->index);
+		vdev->index = NULL;
+	}
 
 	std_session_send_df_end(sdi);
 
@@ -241,6 +860,11 @@ static int dev_open(struct sr_dev_inst *sdi)
 	di = sdi->driver;
 	drvc = di->context;
 	vdev = g_malloc0(sizeof(struct session_vdev));
+	g_mutex_init(&vdev->mutex);
+	g_cond_init(&vdev->cond);
+	g_queue_init(&vdev->blocks);
+	vdev->decode_threads = 1;
+	vdev->playback = SR_PLAYBACK_STEP;
 	sdi->priv = vdev;
 	drvc->instances = g_slist_append(drvc->instances, sdi);
 
@@ -249,9 +873,13 @@ static int dev_open(struct sr_dev_inst *sdi)
 
 static int dev_close(struct sr_dev_inst *sdi)
 {
-	const struct session_vdev *const vdev = sdi->priv;
+	struct session_vdev *vdev = sdi->priv;
 	g_free(vdev->sessionfile);
 	g_free(vdev->capturefile);
+	if (vdev->encodings)
+		g_hash_table_destroy(vdev->encodings);
+	g_mutex_clear(&vdev->mutex);
+	g_cond_clear(&vdev->cond);
 
 	g_free(sdi->priv);
 	sdi->priv = NULL;
@@ -278,6 +906,9 @@ static int config_get(uint32_t key, GVariant **data,
 	case SR_CONF_CAPTURE_UNITSIZE:
 		*data = g_variant_new_uint64(vdev->unitsize);
 		break;
+	case SR_CONF_BUFFERSIZE:
+		*data = g_variant_new_uint64(vdev->buffer_size);
+		break;
 	default:
 		return SR_ERR_NA;
 	}
@@ -318,6 +949,11 @@ static int config_set(uint32_t key, GVariant *data,
 	case SR_CONF_NUM_ANALOG_CHANNELS:
 		vdev->num_analog_channels = g_variant_get_int32(data);
 		break;
+	case SR_CONF_BUFFERSIZE:
+		vdev->buffer_size = g_variant_get_uint64(data);
+		if (vdev->buffer_size > G_MAXINT)
+			return SR_ERR_ARG;
+		break;
 	default:
 		return SR_ERR_NA;
 	}
@@ -334,6 +970,7 @@ static int config_list(uint32_t key, GVariant **data,
 static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 {
 	struct session_vdev *vdev;
+	unsigned int threads;
 	int ret;
 	GSList *l;
 	struct sr_channel *ch;
@@ -349,8 +986,30 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 			g_array_append_val(vdev->analog_channels, ch);
 	}
 	vdev->cur_chunk = 0;
+	vdev->cur_sample = 0;
+	vdev->range_done = FALSE;
+	vdev->eof = FALSE;
 	vdev->finished = FALSE;
 
+	if (vdev->playback == SR_PLAYBACK_REALTIME && !vdev->samplerate) {
+		sr_warn("No samplerate, cannot play back in realtime.");
+		vdev->playback = SR_PLAYBACK_STEP;
+	}
+	vdev->rt_channel = -1;
+
+	/* Files without analog data get read in bigger blocks. */
+	if (vdev->buffer_size)
+		vdev->read_size = vdev->buffer_size;
+	else if (vdev->playback == SR_PLAYBACK_MAX)
+		vdev->read_size = CHUNKSIZE_MAX;
+	else if (vdev->num_analog_channels)
+		vdev->read_size = CHUNKSIZE;
+	else
+		vdev->read_size = CHUNKSIZE_LOGIC;
+	vdev->read_size = MAX(vdev->read_size, sizeof(float));
+	if (vdev->unitsize)
+		vdev->read_size = MAX(vdev->read_size, (size_t)vdev->unitsize);
+
 	sr_info("Opening archive %s file %s", vdev->sessionfile,
 		vdev->capturefile);
 
@@ -359,11 +1018,36 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 		       "zip error %d.", vdev->sessionfile, ret);
 		return SR_ERR;
 	}
+	if (vdev->range_start)
+		index_load(vdev);
+
+	vdev->stop = FALSE;
+	vdev->prefetch_done = FALSE;
+	threads = vdev->decode_threads;
+	if (!threads)
+		threads = g_get_num_processors();
+	if (threads > 1) {
+		vdev->archives = g_async_queue_new();
+		vdev->decoders = g_thread_pool_new(decode_chunk, vdev,
+				threads, TRUE, NULL);
+		if (!vdev->decoders)
+			sr_warn("Cannot create decoder threads.");
+	}
+	vdev->thread = g_thread_try_new("session-prefetch", prefetch_thread,
+			vdev, NULL);
+	if (!vdev->thread)
+		sr_warn("Cannot create prefetch thread, reading inline.");
+	if (!vdev->thread && vdev->decoders) {
+		g_thread_pool_free(vdev->decoders, FALSE, TRUE);
+		vdev->decoders = NULL;
+	}
 
 	std_session_send_df_header(sdi);
 
-	/* freewheeling source */
-	sr_session_source_add(sdi->session, -1, 0, 0, receive_data, (void *)sdi);
+	/* freewheeling source, paced by a timeout for realtime playback */
+	sr_session_source_add(sdi->session, -1, 0,
+		vdev->playback == SR_PLAYBACK_REALTIME ? REALTIME_INTERVAL_MS : 0,
+		receive_data, (void *)sdi);
 
 	return SR_OK;
 }
@@ -379,6 +1063,513 @@ static int dev_acquisition_stop(struct sr_dev_inst *sdi)
 	return SR_OK;
 }
 
+/**
+ * Limit playback of a session file device to a range of samples.
+ *
+ * @param sdi Device instance of the session driver.
+ * @param start Number of the first sample to send.
+ * @param count Number of samples to send, 0 sends up to the end.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ *
+ * @private
+ */
+SR_PRIV int sr_session_driver_range_set(struct sr_dev_inst *sdi,
+	uint64_t start, uint64_t count)
+{
+	struct session_vdev *vdev;
+
+	if (!sdi || !(vdev = sdi->priv))
+		return SR_ERR_ARG;
+	vdev->range_start = start;
+	vdev->range_count = count;
+
+	return SR_OK;
+}
+
+/**
+ * Set the number of threads which decompress a session file's chunks.
+ *
+ * @param sdi Device instance of the session driver.
+ * @param threads Number of threads, 0 for one per processor, 1 to read
+ *                the chunks one after another.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ *
+ * @private
+ */
+SR_PRIV int sr_session_driver_threads_set(struct sr_dev_inst *sdi,
+	unsigned int threads)
+{
+	struct session_vdev *vdev;
+
+	if (!sdi || !(vdev = sdi->priv))
+		return SR_ERR_ARG;
+	vdev->decode_threads = threads;
+
+	return SR_OK;
+}
+
+/**
+ * Set how a session file gets played back.
+ *
+ * @param sdi Device instance of the session driver.
+ * @param mode The playback mode.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ *
+ * @private
+ */
+SR_PRIV int sr_session_driver_playback_set(struct sr_dev_inst *sdi,
+	enum sr_playback_mode mode)
+{
+	struct session_vdev *vdev;
+
+	if (!sdi || !(vdev = sdi->priv))
+		return SR_ERR_ARG;
+	vdev->playback = mode;
+
+	return SR_OK;
+}
+
+/**
+ * Set whether a session file's chunks are encoded.
+ *
+ * @param sdi Device instance of the session driver.
+ * @param planes TRUE if logic chunks hold bit planes, and analog chunks
+ *               delta encoded samples, see the srzip "encoding" option.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ *
+ * @private
+ */
+SR_PRIV int sr_session_driver_planes_set(struct sr_dev_inst *sdi,
+	gboolean planes)
+{
+	struct session_vdev *vdev;
+
+	if (!sdi || !(vdev = sdi->priv))
+		return SR_ERR_ARG;
+	vdev->planes = planes;
+
+	return SR_OK;
+}
+
+/**
+ * Set the encoding of an analog channel's integer samples.
+ *
+ * @param sdi Device instance of the session driver.
+ * @param ch The analog channel.
+ * @param encoding The encoding, see the srzip "native" option.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ *
+ * @private
+ */
+SR_PRIV int sr_session_driver_encoding_set(struct sr_dev_inst *sdi,
+	struct sr_channel *ch, const struct sr_analog_encoding *encoding)
+{
+	struct session_vdev *vdev;
+
+	if (!sdi || !(vdev = sdi->priv) || !ch || !encoding)
+		return SR_ERR_ARG;
+	if (!vdev->encodings)
+		vdev->encodings = g_hash_table_new_full(g_direct_hash,
+			g_direct_equal, NULL, g_free);
+	g_hash_table_replace(vdev->encodings, ch,
+		g_memdup(encoding, sizeof(*encoding)));
+
+	return SR_OK;
+}
+
+/* A chunk of logic data to search. */
+struct search_chunk {
+	char name[128];
+	size_t size;
+	uint64_t first;
+	/* The chunk's summary rules out matches, it doesn't get read. */
+	gboolean skip;
+	/* Only read for its last sample, which the next chunk needs. */
+	gboolean tail_only;
+	gboolean failed;
+	/* First and last sample, and the positions of the matches. */
+	uint8_t *head;
+	uint8_t *tail;
+	GArray *matches;
+};
+
+struct search {
+	struct session_vdev *vdev;
+	const struct sr_dev_inst *sdi;
+	struct sr_trigger *trigger;
+	GAsyncQueue *archives;
+};
+
+/* Record the positions of all matches within a buffer of samples. */
+static void search_scan(struct soft_trigger_logic *stl, const uint8_t *buf,
+	size_t length, uint64_t first, GArray *matches)
+{
+	size_t offset, n;
+	uint64_t pos;
+	int m;
+
+	offset = 0;
+	while (offset < length) {
+		n = MIN(length - offset, (size_t)G_MAXINT);
+		n -= n % stl->unitsize;
+		m = soft_trigger_logic_find(stl, buf + offset, n);
+		if (m < 0) {
+			offset += n;
+			continue;
+		}
+		pos = first + offset / stl->unitsize + m;
+		g_array_append_val(matches, pos);
+		offset += (m + 1) * stl->unitsize;
+	}
+}
+
+/*
+ * Search thread: reads a whole chunk and scans it on its own. The
+ * chunk's first sample can't match edges there, see search_chunks().
+ */
+static void search_chunk(gpointer data, gpointer user_data)
+{
+	struct search_chunk *chunk;
+	struct search *search;
+	struct soft_trigger_logic *stl;
+	struct zip *archive;
+	size_t unitsize, num_samples;
+	uint8_t *buf;
+	int ret;
+
+	chunk = data;
+	search = user_data;
+	unitsize = search->vdev->unitsize;
+
+	buf = NULL;
+	if (!(archive = g_async_queue_try_pop(search->archives)))
+		archive = zip_open(search->vdev->sessionfile, 0, &ret);
+	if (archive) {
+		buf = read_chunk(search->vdev, archive, chunk->name,
+			chunk->size, 0);
+		g_async_queue_push(search->archives, archive);
+	}
+	if (!buf) {
+		sr_err("Failed to decode chunk '%s'.", chunk->name);
+		chunk->failed = TRUE;
+		return;
+	}
+
+	num_samples = chunk->size / unitsize;
+	if (num_samples) {
+		chunk->head = g_memdup(buf, unitsize);
+		chunk->tail = g_memdup(buf + (num_samples - 1) * unitsize,
+			unitsize);
+	}
+	if (!chunk->tail_only) {
+		stl = soft_trigger_logic_new(search->sdi, search->trigger, 0);
+		search_scan(stl, buf, num_samples * unitsize, chunk->first,
+			chunk->matches);
+		soft_trigger_logic_free(stl);
+	}
+	g_free(buf);
+}
+
+/* Whether a channel has no transitions within a chunk's samples. */
+static gboolean chunk_quiet(const struct sr_overview *ov, int channel,
+	uint64_t first, uint64_t count)
+{
+	uint64_t b, last;
+
+	if (!count)
+		return TRUE;
+	last = (first + count - 1) / ov->bucket_size;
+	if (last >= ov->num_buckets || channel >= (int)ov->num_channels)
+		return FALSE;
+	for (b = first / ov->bucket_size; b <= last; b++) {
+		if (ov->transitions[b * ov->num_channels + channel])
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+/*
+ * Skip the chunks in which a channel that must change for the match
+ * never does. The overview counts the transition into the first sample
+ * of a bucket, so this holds for the chunks' first samples, too.
+ */
+static void search_skip(struct search *search,
+	const struct soft_trigger_stage *st, GArray *chunks)
+{
+	struct session_vdev *vdev;
+	struct search_chunk *chunk;
+	struct sr_overview *ov;
+	const uint8_t *edges;
+	uint8_t mask;
+	guint c;
+	int ch, num_skipped;
+
+	vdev = search->vdev;
+	if (sr_session_overview_get(vdev->sessionfile, -1, 0, &ov) != SR_OK)
+		return;
+
+	num_skipped = 0;
+	for (c = 0; c < chunks->len; c++) {
+		chunk = &g_array_index(chunks, struct search_chunk, c);
+		for (ch = 0; ch < vdev->unitsize * 8 && !chunk->skip; ch++) {
+			edges = (const uint8_t *)st->rising;
+			mask = edges[ch / 8];
+			edges = (const uint8_t *)st->falling;
+			mask |= edges[ch / 8];
+			edges = (const uint8_t *)st->edge;
+			mask |= edges[ch / 8];
+			if (!(mask & (1 << (ch % 8))))
+				continue;
+			chunk->skip = chunk_quiet(ov, ch, chunk->first,
+				chunk->size / vdev->unitsize);
+		}
+	}
+	sr_session_overview_free(ov);
+
+	/* Chunks before one which gets scanned provide their last sample. */
+	for (c = 0; c < chunks->len; c++) {
+		chunk = &g_array_index(chunks, struct search_chunk, c);
+		if (chunk->skip && c + 1 < chunks->len && !g_array_index(chunks,
+				struct search_chunk, c + 1).skip) {
+			chunk->skip = FALSE;
+			chunk->tail_only = TRUE;
+		}
+		if (chunk->skip)
+			num_skipped++;
+	}
+	sr_dbg("Skipping %d of %u chunks.", num_skipped, chunks->len);
+}
+
+/*
+ * Scan the chunks of a single stage trigger, in parallel. Each chunk
+ * gets scanned on its own, then the chunks' first samples get checked
+ * against the last samples of the chunks before them.
+ */
+static int search_chunks(struct search *search, GArray *chunks,
+	const struct soft_trigger_stage *st)
+{
+	struct session_vdev *vdev;
+	struct search_chunk *chunk, *prev;
+	struct soft_trigger_logic *stl;
+	struct zip *archive;
+	GThreadPool *pool;
+	uint8_t *pair;
+	unsigned int threads;
+	uint64_t pos;
+	guint c;
+	int ret;
+
+	vdev = search->vdev;
+	threads = vdev->decode_threads;
+	if (!threads)
+		threads = g_get_num_processors();
+
+	search->archives = g_async_queue_new();
+	pool = NULL;
+	if (threads > 1)
+		pool = g_thread_pool_new(search_chunk, search, threads, TRUE, NULL);
+	for (c = 0; c < chunks->len; c++) {
+		chunk = &g_array_index(chunks, struct search_chunk, c);
+		if (chunk->skip)
+			continue;
+		if (pool)
+			g_thread_pool_push(pool, chunk, NULL);
+		else
+			search_chunk(chunk, search);
+	}
+	if (pool)
+		g_thread_pool_free(pool, FALSE, TRUE);
+	while ((archive = g_async_queue_try_pop(search->archives)))
+		zip_discard(archive);
+	g_async_queue_unref(search->archives);
+
+	ret = SR_OK;
+	pair = g_malloc(2 * vdev->unitsize);
+	for (c = 0; c < chunks->len && ret == SR_OK; c++) {
+		chunk = &g_array_index(chunks, struct search_chunk, c);
+		if (chunk->failed)
+			ret = SR_ERR_DATA;
+		if (ret != SR_OK || chunk->skip || chunk->tail_only ||
+				!chunk->head || !c || !st->has_edges)
+			continue;
+		prev = &g_array_index(chunks, struct search_chunk, c - 1);
+		if (!prev->tail)
+			continue;
+		memcpy(pair, prev->tail, vdev->unitsize);
+		memcpy(pair + vdev->unitsize, chunk->head, vdev->unitsize);
+		stl = soft_trigger_logic_new(search->sdi, search->trigger, 0);
+		if (soft_trigger_logic_find(stl, pair, 2 * vdev->unitsize) == 1) {
+			pos = chunk->first;
+			g_array_prepend_val(chunk->matches, pos);
+		}
+		soft_trigger_logic_free(stl);
+	}
+	g_free(pair);
+
+	return ret;
+}
+
+/* Scan the chunks one after another, for triggers with several stages. */
+static int search_sequential(struct search *search, GArray *chunks,
+	uint64_t max_matches, GArray *matches)
+{
+	struct session_vdev *vdev;
+	struct search_chunk *chunk;
+	struct soft_trigger_logic *stl;
+	struct zip *archive;
+	uint8_t *buf;
+	guint c;
+	int ret;
+
+	vdev = search->vdev;
+	if (!(archive = zip_open(vdev->sessionfile, 0, &ret)))
+		return SR_ERR;
+
+	ret = SR_OK;
+	stl = soft_trigger_logic_new(search->sdi, search->trigger, 0);
+	for (c = 0; c < chunks->len; c++) {
+		if (max_matches && matches->len >= max_matches)
+			break;
+		chunk = &g_array_index(chunks, struct search_chunk, c);
+		buf = read_chunk(vdev, archive, chunk->name, chunk->size, 0);
+		if (!buf) {
+			sr_err("Failed to decode chunk '%s'.", chunk->name);
+			ret = SR_ERR_DATA;
+			break;
+		}
+		search_scan(stl, buf, chunk->size - chunk->size % vdev->unitsize,
+			chunk->first, matches);
+		g_free(buf);
+	}
+	soft_trigger_logic_free(stl);
+	zip_discard(archive);
+
+	return ret;
+}
+
+/**
+ * Find the samples of a session file which match a trigger.
+ *
+ * @param sdi Device instance of the session driver.
+ * @param trigger The trigger, on the device's logic channels.
+ * @param max_matches Stop after this many matches, 0 for no limit.
+ * @param matches Will be filled in with the sample numbers.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument, or a stage without matches.
+ * @retval SR_ERR_NA The file has no logic data.
+ * @retval SR_ERR_DATA A chunk could not be read.
+ * @retval SR_ERR The file could not be opened.
+ *
+ * @private
+ */
+SR_PRIV int sr_session_driver_search(const struct sr_dev_inst *sdi,
+	struct sr_trigger *trigger, uint64_t max_matches, GArray *matches)
+{
+	struct session_vdev *vdev;
+	struct search search;
+	struct search_chunk chunk, *cp;
+	struct soft_trigger_logic *stl;
+	struct zip *archive;
+	struct zip_stat zs;
+	GArray *chunks;
+	uint64_t first;
+	guint c;
+	int i, ret;
+
+	if (!sdi || !(vdev = sdi->priv) || !trigger || !matches)
+		return SR_ERR_ARG;
+	if (!vdev->unitsize || !vdev->capturefile)
+		return SR_ERR_NA;
+
+	stl = soft_trigger_logic_new(sdi, trigger, 0);
+	if (!stl)
+		return SR_ERR_MALLOC;
+	if (stl->unitsize != vdev->unitsize) {
+		sr_err("Unitsize %d doesn't match the logic channels.",
+			vdev->unitsize);
+		soft_trigger_logic_free(stl);
+		return SR_ERR_DATA;
+	}
+	for (i = 0; i < stl->num_stages; i++) {
+		if (stl->stages[i].empty) {
+			soft_trigger_logic_free(stl);
+			return SR_ERR_ARG;
+		}
+	}
+
+	/* The chunks' sample numbers follow from their sizes. */
+	if (!(archive = zip_open(vdev->sessionfile, 0, &ret))) {
+		soft_trigger_logic_free(stl);
+		return SR_ERR;
+	}
+	chunks = g_array_new(FALSE, TRUE, sizeof(struct search_chunk));
+	first = 0;
+	for (i = 0; ; i++) {
+		memset(&chunk, 0, sizeof(chunk));
+		if (i == 0)
+			snprintf(chunk.name, sizeof(chunk.name), "%s",
+				vdev->capturefile);
+		else
+			snprintf(chunk.name, sizeof(chunk.name), "%s-%d",
+				vdev->capturefile, i);
+		if (zip_stat(archive, chunk.name, 0, &zs) < 0) {
+			if (i == 0)
+				continue;
+			break;
+		}
+		chunk.size = zs.size;
+		chunk.first = first;
+		chunk.matches = g_array_new(FALSE, FALSE, sizeof(uint64_t));
+		first += zs.size / vdev->unitsize;
+		g_array_append_val(chunks, chunk);
+		/* A single capture file has no chunks after it. */
+		if (i == 0)
+			break;
+	}
+	zip_discard(archive);
+
+	search.vdev = vdev;
+	search.sdi = sdi;
+	search.trigger = trigger;
+	if (stl->num_stages == 1) {
+		if (stl->stages[0].has_edges && !stl->stages[0].never)
+			search_skip(&search, &stl->stages[0], chunks);
+		ret = search_chunks(&search, chunks, &stl->stages[0]);
+		for (c = 0; c < chunks->len && ret == SR_OK; c++) {
+			cp = &g_array_index(chunks, struct search_chunk, c);
+			g_array_append_vals(matches, cp->matches->data,
+				cp->matches->len);
+		}
+	} else {
+		ret = search_sequential(&search, chunks, max_matches, matches);
+	}
+	if (max_matches && matches->len > max_matches)
+		g_array_set_size(matches, max_matches);
+
+	for (c = 0; c < chunks->len; c++) {
+		cp = &g_array_index(chunks, struct search_chunk, c);
+		g_free(cp->head);
+		g_free(cp->tail);
+		g_array_free(cp->matches, TRUE);
+	}
+	g_array_free(chunks, TRUE);
+	soft_trigger_logic_free(stl);
+
+	return ret;
+}
+
 /** @private */
 SR_PRIV struct sr_dev_driver session_driver = {
 	.name = "virtual-session",
@@ -111,51 +111,188 @@ SR_PRIV GKeyFile *sr_sessionfile_read_metadata(struct zip *archive,
 	return keyfile;
 }
 
-/** @private */
-SR_PRIV int sr_sessionfile_check(const char *filename)
+/* Transpose the 8x8 bit matrix of the bytes of @x. */
+static uint64_t transpose8(uint64_t x)
+{
+	uint64_t t;
+
+	t = (x ^ (x >> 7)) & 0x00aa00aa00aa00aaULL;
+	x ^= t ^ (t << 7);
+	t = (x ^ (x >> 14)) & 0x0000cccc0000ccccULL;
+	x ^= t ^ (t << 14);
+	t = (x ^ (x >> 28)) & 0x00000000f0f0f0f0ULL;
+	x ^= t ^ (t << 28);
+
+	return x;
+}
+
+/**
+ * Transpose logic samples into bit planes, one per channel.
+ *
+ * Plane n holds bit n of every sample, eight samples per byte. The
+ * planes cover the samples by groups of eight, the samples which don't
+ * fill a group follow the planes as they are. Output and input have
+ * the same size, so sample counts can be taken from the chunk size.
+ *
+ * @param[out] out Bit planes, @size bytes.
+ * @param[in] in Logic samples.
+ * @param[in] size Size of the samples in bytes.
+ * @param[in] unitsize Size of a sample in bytes.
+ *
+ * @private
+ */
+SR_PRIV void sr_sessionfile_planes_encode(uint8_t *out, const uint8_t *in,
+		size_t size, size_t unitsize)
+{
+	size_t groups, k, j, b;
+	uint64_t x;
+
+	groups = size / (8 * unitsize);
+	for (k = 0; k < groups; k++, in += 8 * unitsize) {
+		for (j = 0; j < unitsize; j++) {
+			x = 0;
+			for (b = 0; b < 8; b++)
+				x |= (uint64_t)in[b * unitsize + j] << (8 * b);
+			x = transpose8(x);
+			for (b = 0; b < 8; b++)
+				out[(8 * j + b) * groups + k] = x >> (8 * b);
+		}
+	}
+	memcpy(out + groups * 8 * unitsize, in, size - groups * 8 * unitsize);
+}
+
+/**
+ * Restore logic samples from bit planes.
+ *
+ * @param[out] out Logic samples, @size bytes.
+ * @param[in] in Bit planes, see sr_sessionfile_planes_encode().
+ * @param[in] size Size of the planes in bytes.
+ * @param[in] unitsize Size of a sample in bytes.
+ *
+ * @private
+ */
+SR_PRIV void sr_sessionfile_planes_decode(uint8_t *out, const uint8_t *in,
+		size_t size, size_t unitsize)
+{
+	size_t groups, k, j, b;
+	uint64_t x;
+
+	groups = size / (8 * unitsize);
+	for (k = 0; k < groups; k++, out += 8 * unitsize) {
+		for (j = 0; j < unitsize; j++) {
+			x = 0;
+			for (b = 0; b < 8; b++)
+				x |= (uint64_t)in[(8 * j + b) * groups + k] << (8 * b);
+			x = transpose8(x);
+			for (b = 0; b < 8; b++)
+				out[b * unitsize + j] = x >> (8 * b);
+		}
+	}
+	memcpy(out, in + groups * 8 * unitsize, size - groups * 8 * unitsize);
+}
+
+/**
+ * Delta encode analog samples.
+ *
+ * The bit patterns of consecutive floats are subtracted, and the bytes
+ * of the differences are grouped by their position, so that the mostly
+ * constant sign and exponent bytes form long runs.
+ *
+ * @param[out] out Encoded samples, @count floats in size.
+ * @param[in] in Analog samples.
+ * @param[in] count Number of samples.
+ *
+ * @private
+ */
+SR_PRIV void sr_sessionfile_delta_encode(uint8_t *out, const float *in,
+		size_t count)
+{
+	uint32_t prev, cur, delta;
+	size_t i, b;
+
+	prev = 0;
+	for (i = 0; i < count; i++) {
+		memcpy(&cur, &in[i], sizeof(cur));
+		delta = cur - prev;
+		prev = cur;
+		for (b = 0; b < sizeof(delta); b++)
+			out[b * count + i] = delta >> (8 * b);
+	}
+}
+
+/**
+ * Restore analog samples from their delta encoding.
+ *
+ * @param[out] out Analog samples.
+ * @param[in] in Encoded samples, see sr_sessionfile_delta_encode().
+ * @param[in] count Number of samples.
+ *
+ * @private
+ */
+SR_PRIV void sr_sessionfile_delta_decode(float *out, const uint8_t *in,
+		size_t count)
+{
+	uint32_t cur, delta;
+	size_t i, b;
+
+	cur = 0;
+	for (i = 0; i < count; i++) {
+		delta = 0;
+		for (b = 0; b < sizeof(delta); b++)
+			delta |= (uint32_t)in[b * count + i] << (8 * b);
+		cur += delta;
+		memcpy(&out[i], &cur, sizeof(cur));
+	}
+}
+
+/* Open a session archive, and check its version and metadata. */
+static struct zip *sessionfile_open(const char *filename, int *ret)
 {
 	struct zip *archive;
 	struct zip_file *zf;
 	struct zip_stat zs;
 	uint64_t version;
-	int ret;
+	int len;
 	char s[11];
 
-	if (!filename)
-		return SR_ERR_ARG;
+	*ret = SR_ERR;
+	if (!filename) {
+		*ret = SR_ERR_ARG;
+		return NULL;
+	}
 
 	if (!g_file_test(filename, G_FILE_TEST_IS_REGULAR)) {
 		sr_err("Not a regular file: %s.", filename);
-		return SR_ERR;
+		return NULL;
 	}
 
 	if (!(archive = zip_open(filename, 0, NULL)))
 		/* No logging: this can be used just to check if it's
 		 * a sigrok session file or not. */
-		return SR_ERR;
+		return NULL;
 
 	/* check "version" */
 	if (!(zf = zip_fopen(archive, "version", 0))) {
 		sr_dbg("Not a sigrok session file: no version found.");
 		zip_discard(archive);
-		return SR_ERR;
+		return NULL;
 	}
-	ret = zip_fread(zf, s, sizeof(s) - 1);
-	if (ret < 0) {
+	len = zip_fread(zf, s, sizeof(s) - 1);
+	if (len < 0) {
 		sr_err("Failed to read version file: %s",
 			zip_file_strerror(zf));
 		zip_fclose(zf);
 		zip_discard(archive);
-		return SR_ERR;
+		return NULL;
 	}
 	zip_fclose(zf);
-	s[ret] = '\0';
+	s[len] = '\0';
 	version = g_ascii_strtoull(s, NULL, 10);
-	if (version == 0 || version > 2) {
+	if (version == 0 || version > 3) {
 		sr_dbg("Cannot handle sigrok session file version %" PRIu64 ".",
 			version);
 		zip_discard(archive);
-		return SR_ERR;
+		return NULL;
 	}
 	sr_spew("Detected sigrok session file version %" PRIu64 ".", version);
 
@@ -163,11 +300,23 @@ SR_PRIV int sr_sessionfile_check(const char *filename)
 	if (zip_stat(archive, "metadata", 0, &zs) < 0) {
 		sr_dbg("Not a valid sigrok session file.");
 		zip_discard(archive);
-		return SR_ERR;
+		return NULL;
 	}
-	zip_discard(archive);
 
-	return SR_OK;
+	*ret = SR_OK;
+	return archive;
+}
+
+/** @private */
+SR_PRIV int sr_sessionfile_check(const char *filename)
+{
+	struct zip *archive;
+	int ret;
+
+	if ((archive = sessionfile_open(filename, &ret)))
+		zip_discard(archive);
+
+	return ret;
 }
 
 /** @private */
@@ -192,6 +341,67 @@ SR_PRIV struct sr_dev_inst *sr_session_prepare_sdi(const char *filename, struct
 	return sdi;
 }
 
+/* Parse a rational number written as "p/q". */
+static gboolean rational_parse(const char *str, struct sr_rational *r)
+{
+	char *end;
+
+	r->p = g_ascii_strtoll(str, &end, 10);
+	if (end == str || *end != '/')
+		return FALSE;
+	str = end + 1;
+	r->q = g_ascii_strtoull(str, &end, 10);
+
+	return end != str && !*end && r->q;
+}
+
+/*
+ * Parse the encoding of integer analog samples, a list of their type
+ * (like "s16le"), scale and offset. Returns FALSE if it's invalid.
+ */
+static gboolean analog_encoding_parse(char **list,
+		struct sr_analog_encoding *encoding)
+{
+	char *end;
+	unsigned long bits;
+
+	if (!list || g_strv_length(list) != 3)
+		return FALSE;
+	if (list[0][0] != 's' && list[0][0] != 'u')
+		return FALSE;
+	bits = strtoul(list[0] + 1, &end, 10);
+	if (bits != 8 && bits != 16 && bits != 32)
+		return FALSE;
+	if (strcmp(end, "le") && strcmp(end, "be"))
+		return FALSE;
+
+	memset(encoding, 0, sizeof(*encoding));
+	encoding->unitsize = bits / 8;
+	encoding->is_signed = list[0][0] == 's';
+	encoding->is_bigendian = !strcmp(end, "be");
+
+	return rational_parse(list[1], &encoding->scale) &&
+		rational_parse(list[2], &encoding->offset);
+}
+
+/* Check whether libzip can decompress chunks of a compression method. */
+static gboolean compression_supported(const char *name)
+{
+	if (!strcmp(name, "deflate") || !strcmp(name, "store"))
+		return TRUE;
+#ifdef ZIP_CM_ZSTD
+	if (!strcmp(name, "zstd")) {
+#ifdef HAVE_ZIP_COMPRESSION_METHOD_SUPPORTED
+		return zip_compression_method_supported(ZIP_CM_ZSTD, 0);
+#else
+		return TRUE;
+#endif
+	}
+#endif
+
+	return FALSE;
+}
+
 /**
  * Load the session from the specified filename.
  *
@@ -218,9 +428,10 @@ SR_API int sr_session_load(struct sr_context *ctx, const char *filename,
 	int total_channels, total_analog, k;
 	GSList *l;
 	int unitsize;
-	char **sections, **keys, *val;
+	char **sections, **keys, *val, **list;
 	char channelname[SR_MAX_CHANNELNAME_LEN + 1];
 	gboolean file_has_logic;
+	struct sr_analog_encoding encoding;
 
 	if ((ret = sr_sessionfile_check(filename)) != SR_OK)
 		return ret;
@@ -299,6 +510,51 @@ SR_API int sr_session_load(struct sr_context *ctx, const char *filename,
 					}
 					sr_config_set(sdi, NULL, SR_CONF_CAPTURE_UNITSIZE,
 							g_variant_new_uint64(unitsize));
+				} else if (!strcmp(keys[j], "compression")) {
+					val = g_key_file_get_string(kf, sections[i],
+							keys[j], &error);
+					if (!val || !compression_supported(val)) {
+						sr_err("Cannot decompress '%s' chunks.",
+							val ? val : "");
+						g_free(val);
+						ret = SR_ERR_DATA;
+						break;
+					}
+					g_free(val);
+				} else if (!strcmp(keys[j], "encoding")) {
+					val = g_key_file_get_string(kf, sections[i],
+							keys[j], &error);
+					if (!sdi || !val || (strcmp(val, "raw") &&
+							strcmp(val, "bitplane"))) {
+						sr_err("Unknown chunk encoding '%s'.",
+							val ? val : "");
+						g_free(val);
+						ret = SR_ERR_DATA;
+						break;
+					}
+					sr_session_driver_planes_set(sdi,
+						!strcmp(val, "bitplane"));
+					g_free(val);
+				} else if (!strncmp(keys[j], "encoding", 8)) {
+					/* Integer analog samples, see the srzip output. */
+					tmp_u64 = g_ascii_strtoull(keys[j] + 8, NULL, 10);
+					ch = NULL;
+					for (l = sdi ? sdi->channels : NULL; l; l = l->next) {
+						ch = l->data;
+						if ((guint64)ch->index == tmp_u64 - 1)
+							break;
+						ch = NULL;
+					}
+					list = g_key_file_get_string_list(kf, sections[i],
+							keys[j], NULL, NULL);
+					if (!ch || !analog_encoding_parse(list, &encoding)) {
+						sr_err("Invalid analog encoding '%s'.", keys[j]);
+						g_strfreev(list);
+						ret = SR_ERR_DATA;
+						break;
+					}
+					g_strfreev(list);
+					sr_session_driver_encoding_set(sdi, ch, &encoding);
 				} else if (!strcmp(keys[j], "total probes")) {
 					total_channels = g_key_file_get_integer(kf,
 							sections[i], keys[j], &error);
@@ -393,4 +649,516 @@ SR_API int sr_session_load(struct sr_context *ctx, const char *filename,
 	return ret;
 }
 
+/**
+ * Play back only a range of samples of a loaded session file.
+ *
+ * Sample data before the range is skipped, and reading stops after the
+ * range. When the file carries a chunk index (written by the srzip
+ * output), chunks before the range are not read at all, so playback
+ * can start in the middle of a large capture right away. Must be
+ * called before sr_session_start().
+ *
+ * @param session A session loaded by sr_session_load().
+ * @param start Number of the first sample to play back.
+ * @param count Number of samples to play back, 0 plays up to the end.
+ *
+ * @retval SR_OK Success
+ * @retval SR_ERR_ARG Invalid argument, or not a loaded session file
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_range_set(struct sr_session *session, uint64_t start,
+		uint64_t count)
+{
+	struct sr_dev_inst *sdi;
+	GSList *l;
+	int ret, found;
+
+	if (!session)
+		return SR_ERR_ARG;
+
+	found = FALSE;
+	for (l = session->owned_devs; l; l = l->next) {
+		sdi = l->data;
+		if (sdi->driver != &session_driver)
+			continue;
+		ret = sr_session_driver_range_set(sdi, start, count);
+		if (ret != SR_OK)
+			return ret;
+		found = TRUE;
+	}
+
+	return found ? SR_OK : SR_ERR_ARG;
+}
+
+/**
+ * Set the number of threads which decompress a loaded session file.
+ *
+ * The chunks of a session file are compressed independently, so
+ * several of them can be decompressed at the same time. They still
+ * get sent to the session in the file's order. Must be called before
+ * sr_session_start().
+ *
+ * @param session A session loaded by sr_session_load().
+ * @param threads Number of threads, 0 for one per processor. The
+ *                default of 1 decompresses one chunk after another.
+ *
+ * @retval SR_OK Success
+ * @retval SR_ERR_ARG Invalid argument, or not a loaded session file
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_decode_threads_set(struct sr_session *session,
+		unsigned int threads)
+{
+	struct sr_dev_inst *sdi;
+	GSList *l;
+	int ret, found;
+
+	if (!session)
+		return SR_ERR_ARG;
+
+	found = FALSE;
+	for (l = session->owned_devs; l; l = l->next) {
+		sdi = l->data;
+		if (sdi->driver != &session_driver)
+			continue;
+		ret = sr_session_driver_threads_set(sdi, threads);
+		if (ret != SR_OK)
+			return ret;
+		found = TRUE;
+	}
+
+	return found ? SR_OK : SR_ERR_ARG;
+}
+
+/**
+ * Set how a loaded session file gets played back.
+ *
+ * By default, one block of samples gets sent per main loop iteration,
+ * as fast as the loop runs. SR_PLAYBACK_MAX reads larger blocks and
+ * keeps sending them for a while before it returns to the loop, for
+ * batch processing. Combine it with sr_session_dev_threads_set() to not
+ * delay other event sources. SR_PLAYBACK_REALTIME sends the samples
+ * when they are due at the file's samplerate, for testing consumers
+ * with realistic timing. Files without a samplerate get the default.
+ * Must be called before sr_session_start().
+ *
+ * @param session A session loaded by sr_session_load().
+ * @param mode The playback mode.
+ *
+ * @retval SR_OK Success
+ * @retval SR_ERR_ARG Invalid argument, or not a loaded session file
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_playback_set(struct sr_session *session,
+		enum sr_playback_mode mode)
+{
+	struct sr_dev_inst *sdi;
+	GSList *l;
+	int ret, found;
+
+	if (!session)
+		return SR_ERR_ARG;
+	if (mode != SR_PLAYBACK_STEP && mode != SR_PLAYBACK_MAX &&
+			mode != SR_PLAYBACK_REALTIME)
+		return SR_ERR_ARG;
+
+	found = FALSE;
+	for (l = session->owned_devs; l; l = l->next) {
+		sdi = l->data;
+		if (sdi->driver != &session_driver)
+			continue;
+		ret = sr_session_driver_playback_set(sdi, mode);
+		if (ret != SR_OK)
+			return ret;
+		found = TRUE;
+	}
+
+	return found ? SR_OK : SR_ERR_ARG;
+}
+
+/**
+ * Find the samples of a loaded session file which match a trigger.
+ *
+ * This scans the logic data of the file without playing it back. The
+ * chunks get scanned by the threads set with
+ * sr_session_decode_threads_set(), when the trigger has a single stage.
+ * If the file has an overview, chunks in which a channel that the
+ * trigger wants to change never does are not read at all. Triggers with
+ * several stages scan the chunks one after another.
+ *
+ * @param session A session loaded by sr_session_load().
+ * @param trigger The trigger, on the logic channels of the session's
+ *                device. See sr_trigger_new().
+ * @param max_matches Stop after this many matches, 0 for no limit.
+ * @param matches Will be filled in with a newly allocated array of the
+ *                matching samples' numbers, in ascending order. Free it
+ *                with g_free().
+ * @param num_matches Will be filled in with the number of matches.
+ *
+ * @retval SR_OK Success, also if nothing matched.
+ * @retval SR_ERR_ARG Invalid argument, or not a loaded session file
+ * @retval SR_ERR_NA The file has no logic data
+ * @retval SR_ERR_DATA Malformed session file
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_search(struct sr_session *session,
+		struct sr_trigger *trigger, uint64_t max_matches,
+		uint64_t **matches, uint64_t *num_matches)
+{
+	struct sr_dev_inst *sdi;
+	GArray *found;
+	GSList *l;
+	int ret;
+
+	if (!session || !trigger || !matches || !num_matches)
+		return SR_ERR_ARG;
+	*matches = NULL;
+	*num_matches = 0;
+
+	ret = SR_ERR_ARG;
+	for (l = session->owned_devs; l; l = l->next) {
+		sdi = l->data;
+		if (sdi->driver != &session_driver)
+			continue;
+		found = g_array_new(FALSE, FALSE, sizeof(uint64_t));
+		ret = sr_session_driver_search(sdi, trigger, max_matches, found);
+		*num_matches = ret == SR_OK ? found->len : 0;
+		*matches = (uint64_t *)g_array_free(found, ret != SR_OK);
+		break;
+	}
+
+	return ret;
+}
+
+/**
+ * Read the overview of a channel from a session file.
+ *
+ * The srzip output stores overviews when its "overview" option is set.
+ * They summarize the samples in buckets on several levels of resolution,
+ * so a zoomed out view of a capture costs as much as the screen is wide,
+ * no matter how many samples the capture has. This picks the coarsest
+ * level whose buckets hold no more than the requested number of samples.
+ *
+ * @param filename The name of the session file.
+ * @param analog Index of the analog channel among the file's analog
+ *               channels, or -1 for the logic channels.
+ * @param samples Maximum number of samples per bucket, e.g. the number
+ *                of samples per pixel. 0 gets the finest level.
+ * @param overview Will be filled in with a newly allocated overview,
+ *                 free it with sr_session_overview_free().
+ *
+ * @retval SR_OK Success
+ * @retval SR_ERR_ARG Invalid argument
+ * @retval SR_ERR_NA The file has no overview of the channel
+ * @retval SR_ERR_DATA Malformed session file
+ * @retval SR_ERR This is not a session file
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_overview_get(const char *filename, int analog,
+		uint64_t samples, struct sr_overview **overview)
+{
+	struct sr_overview *ov;
+	struct zip *archive;
+	struct zip_file *zf;
+	struct zip_stat zs;
+	GKeyFile *kf;
+	GError *error;
+	const char *devgroup;
+	char *prefix, *name;
+	uint64_t bucket, factor;
+	size_t elem_size;
+	int level, width, first_analog, ret;
+	void *data;
+
+	if (!filename || !overview)
+		return SR_ERR_ARG;
+	*overview = NULL;
+
+	if ((ret = sr_sessionfile_check(filename)) != SR_OK)
+		return ret;
+	if (!(archive = zip_open(filename, 0, NULL)))
+		return SR_ERR;
+	if (zip_stat(archive, "metadata", 0, &zs) < 0) {
+		zip_discard(archive);
+		return SR_ERR;
+	}
+	if (!(kf = sr_sessionfile_read_metadata(archive, &zs))) {
+		zip_discard(archive);
+		return SR_ERR_DATA;
+	}
+
+	devgroup = "device 1";
+	error = NULL;
+	factor = 0;
+	bucket = g_key_file_get_uint64(kf, devgroup, "overview bucket", &error);
+	if (!error)
+		factor = g_key_file_get_integer(kf, devgroup,
+			"overview factor", &error);
+	width = 0;
+	first_analog = 1;
+	if (!error && analog < 0)
+		width = g_key_file_get_integer(kf, devgroup, "unitsize",
+			&error) * 8;
+	else if (!error && g_key_file_has_key(kf, devgroup, "capturefile", NULL))
+		first_analog += g_key_file_get_integer(kf, devgroup,
+			"total probes", &error);
+	g_key_file_free(kf);
+	if (error || !bucket || factor < 2 || (analog < 0 && width <= 0)) {
+		g_clear_error(&error);
+		zip_discard(archive);
+		return SR_ERR_NA;
+	}
+
+	if (analog < 0)
+		prefix = g_strdup("overview-logic-1");
+	else
+		prefix = g_strdup_printf("overview-analog-1-%d",
+			first_analog + analog);
+
+	/* Pick the coarsest level, and fall back as far as it exists. */
+	level = 0;
+	while (bucket <= samples / factor) {
+		bucket *= factor;
+		level++;
+	}
+	name = NULL;
+	for (; level >= 0; level--, bucket /= factor) {
+		g_free(name);
+		name = g_strdup_printf("%s-%d", prefix, level);
+		if (zip_stat(archive, name, 0, &zs) == 0)
+			break;
+	}
+	g_free(prefix);
+	if (level < 0) {
+		g_free(name);
+		zip_discard(archive);
+		return SR_ERR_NA;
+	}
+
+	elem_size = width ? width * sizeof(uint32_t) : 2 * sizeof(float);
+	if (zs.size % elem_size || !(data = g_try_malloc(zs.size))) {
+		sr_err("Malformed or oversized overview '%s'.", name);
+		g_free(name);
+		zip_discard(archive);
+		return SR_ERR_DATA;
+	}
+	zf = zip_fopen(archive, name, 0);
+	if (!zf || zip_fread(zf, data, zs.size) != (zip_int64_t)zs.size) {
+		sr_err("Failed to read overview '%s'.", name);
+		if (zf)
+			zip_fclose(zf);
+		g_free(data);
+		g_free(name);
+		zip_discard(archive);
+		return SR_ERR_DATA;
+	}
+	zip_fclose(zf);
+	g_free(name);
+	zip_discard(archive);
+
+	ov = g_malloc0(sizeof(*ov));
+	ov->bucket_size = bucket;
+	ov->num_buckets = zs.size / elem_size;
+	ov->num_channels = width;
+	if (width)
+		ov->transitions = data;
+	else
+		ov->minmax = data;
+	*overview = ov;
+
+	return SR_OK;
+}
+
+/**
+ * Free an overview read by sr_session_overview_get().
+ *
+ * @param overview The overview to free, can be NULL.
+ *
+ * @since 0.6.0
+ */
+SR_API void sr_session_overview_free(struct sr_overview *overview)
+{
+	if (!overview)
+		return;
+	g_free(overview->transitions);
+	g_free(overview->minmax);
+	g_free(overview);
+}
+
+/* Check whether an entry is @base itself, or one of its chunks. */
+static gboolean is_capture_entry(const char *name, const char *base)
+{
+	size_t len;
+
+	len = strlen(base);
+	if (strncmp(name, base, len))
+		return FALSE;
+	if (!name[len])
+		return TRUE;
+	if (name[len] != '-' || !name[len + 1])
+		return FALSE;
+
+	return strspn(name + len + 1, "0123456789") == strlen(name + len + 1);
+}
+
+/**
+ * Read the basic properties of a session file.
+ *
+ * This only parses the metadata, and takes the number of samples from
+ * the sizes of the capture data in the archive's central directory.
+ * Neither sample data gets decompressed, nor a session created, which
+ * makes this cheap enough to scan large numbers of files.
+ *
+ * @param filename The name of the session file.
+ * @param info Will be filled in with newly allocated properties, free
+ *             them with sr_sessionfile_info_free().
+ *
+ * @retval SR_OK Success
+ * @retval SR_ERR_ARG Invalid argument
+ * @retval SR_ERR_DATA Malformed session file
+ * @retval SR_ERR This is not a session file
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_sessionfile_info(const char *filename,
+		struct sr_sessionfile_info **info)
+{
+	struct sr_sessionfile_info *fi;
+	struct zip *archive;
+	struct zip_stat zs;
+	GKeyFile *kf;
+	GError *error;
+	const char *devgroup;
+	char *val, *key, *base, **list;
+	struct sr_analog_encoding encoding;
+	zip_int64_t num_entries, i;
+	uint64_t logic_bytes, analog_bytes;
+	size_t analog_size;
+	unsigned int first_analog, ch;
+	int num_logic, num_analog, unitsize, ret;
+
+	if (!info)
+		return SR_ERR_ARG;
+	*info = NULL;
+
+	if (!(archive = sessionfile_open(filename, &ret)))
+		return ret;
+	zip_stat(archive, "metadata", 0, &zs);
+	if (!(kf = sr_sessionfile_read_metadata(archive, &zs))) {
+		zip_discard(archive);
+		return SR_ERR_DATA;
+	}
+
+	fi = g_malloc0(sizeof(*fi));
+	devgroup = "device 1";
+	error = NULL;
+	if ((val = g_key_file_get_string(kf, devgroup, "samplerate", NULL))) {
+		if (sr_parse_sizestring(val, &fi->samplerate) != SR_OK)
+			ret = SR_ERR_DATA;
+		g_free(val);
+	}
+	num_logic = num_analog = unitsize = 0;
+	if (g_key_file_has_key(kf, devgroup, "capturefile", NULL)) {
+		num_logic = g_key_file_get_integer(kf, devgroup,
+				"total probes", &error);
+		if (!error && g_key_file_has_key(kf, devgroup, "unitsize", NULL))
+			unitsize = g_key_file_get_integer(kf, devgroup,
+					"unitsize", &error);
+	}
+	if (!error && g_key_file_has_key(kf, devgroup, "total analog", NULL))
+		num_analog = g_key_file_get_integer(kf, devgroup,
+				"total analog", &error);
+	if (error) {
+		g_error_free(error);
+		ret = SR_ERR_DATA;
+	}
+	if (num_logic < 0 || num_analog < 0 || unitsize < 0)
+		ret = SR_ERR_DATA;
+	if (ret != SR_OK) {
+		g_key_file_free(kf);
+		zip_discard(archive);
+		sr_sessionfile_info_free(fi);
+		return ret;
+	}
+
+	fi->num_logic_channels = num_logic;
+	fi->num_analog_channels = num_analog;
+	fi->unitsize = unitsize;
+
+	/* See zip_create() of the srzip output for the channel numbering. */
+	first_analog = fi->num_logic_channels + 1;
+	fi->logic_names = g_malloc0((fi->num_logic_channels + 1) * sizeof(char *));
+	fi->analog_names = g_malloc0((fi->num_analog_channels + 1) * sizeof(char *));
+	for (ch = 0; ch < fi->num_logic_channels; ch++) {
+		key = g_strdup_printf("probe%u", ch + 1);
+		fi->logic_names[ch] = g_key_file_get_string(kf, devgroup, key, NULL);
+		g_free(key);
+	}
+	for (ch = 0; ch < fi->num_analog_channels; ch++) {
+		key = g_strdup_printf("analog%u", first_analog + ch);
+		fi->analog_names[ch] = g_key_file_get_string(kf, devgroup, key, NULL);
+		g_free(key);
+	}
+	/* The first analog channel might keep integer samples. */
+	analog_size = sizeof(float);
+	key = g_strdup_printf("encoding%u", first_analog);
+	list = g_key_file_get_string_list(kf, devgroup, key, NULL, NULL);
+	if (analog_encoding_parse(list, &encoding))
+		analog_size = encoding.unitsize;
+	g_strfreev(list);
+	g_free(key);
+	g_key_file_free(kf);
+
+	/* Sum up the uncompressed sizes of the first channel's data. */
+	logic_bytes = analog_bytes = 0;
+	base = g_strdup_printf("analog-1-%u", first_analog);
+	num_entries = zip_get_num_entries(archive, 0);
+	for (i = 0; i < num_entries; i++) {
+		if (zip_stat_index(archive, i, 0, &zs) < 0)
+			continue;
+		if (fi->unitsize && is_capture_entry(zs.name, "logic-1"))
+			logic_bytes += zs.size;
+		else if (is_capture_entry(zs.name, base))
+			analog_bytes += zs.size;
+	}
+	g_free(base);
+	zip_discard(archive);
+
+	if (fi->unitsize)
+		fi->num_samples = logic_bytes / fi->unitsize;
+	else
+		fi->num_samples = analog_bytes / analog_size;
+	*info = fi;
+
+	return SR_OK;
+}
+
+/**
+ * Free the properties read by sr_sessionfile_info().
+ *
+ * @param info The properties to free, can be NULL.
+ *
+ * @since 0.6.0
+ */
+SR_API void sr_sessionfile_info_free(struct sr_sessionfile_info *info)
+{
+	unsigned int ch;
+
+	if (!info)
+		return;
+	/* Unsaved channels leave holes, so no g_strfreev(). */
+	for (ch = 0; info->logic_names && ch < info->num_logic_channels; ch++)
+		g_free(info->logic_names[ch]);
+	for (ch = 0; info->analog_names && ch < info->num_analog_channels; ch++)
+		g_free(info->analog_names[ch]);
+	g_free(info->logic_names);
+	g_free(info->analog_names);
+	g_free(info);
+}
+
 /** @} */
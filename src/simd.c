@@ -0,0 +1,1825 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2026 libsigrok contributors
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <float.h>
+#include <stdint.h>
+#include <string.h>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SIMD_X86 1
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#define SIMD_NEON 1
+#include <arm_neon.h>
+#endif
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+/** @cond PRIVATE */
+#define LOG_PREFIX "simd"
+/** @endcond */
+
+/*
+ * Vector kernels for the sample processing hot paths. On x86 the widest
+ * supported instruction set is picked at runtime, on ARM NEON is used
+ * when the compiler targets it. The scalar code handles the remainder
+ * and all other platforms.
+ */
+
+static void invert_scalar(uint8_t *data, size_t length)
+{
+	uint64_t w;
+
+	while (length >= sizeof(w)) {
+		memcpy(&w, data, sizeof(w));
+		w = ~w;
+		memcpy(data, &w, sizeof(w));
+		data += sizeof(w);
+		length -= sizeof(w);
+	}
+	while (length--) {
+		*data = ~*data;
+		data++;
+	}
+}
+
+/*
+ * Keep the rounding of the original code: the product is rounded to
+ * single precision before the offset is added.
+ */
+static void scale_scalar(float *data, size_t count, double scale,
+		double offset)
+{
+	while (count--) {
+		*data *= scale;
+		*data += offset;
+		data++;
+	}
+}
+
+#ifdef SIMD_X86
+__attribute__((target("avx2")))
+static size_t invert_avx2(uint8_t *data, size_t length)
+{
+	__m256i ones, v;
+	size_t i;
+
+	ones = _mm256_set1_epi8(-1);
+	for (i = 0; i + 32 <= length; i += 32) {
+		v = _mm256_loadu_si256((const __m256i *)(data + i));
+		_mm256_storeu_si256((__m256i *)(data + i),
+			_mm256_xor_si256(v, ones));
+	}
+
+	return i;
+}
+
+__attribute__((target("sse2")))
+static size_t invert_sse2(uint8_t *data, size_t length)
+{
+	__m128i ones, v;
+	size_t i;
+
+	ones = _mm_set1_epi8(-1);
+	for (i = 0; i + 16 <= length; i += 16) {
+		v = _mm_loadu_si128((const __m128i *)(data + i));
+		_mm_storeu_si128((__m128i *)(data + i), _mm_xor_si128(v, ones));
+	}
+
+	return i;
+}
+
+__attribute__((target("avx")))
+static size_t scale_avx(float *data, size_t count, double scale,
+		double offset)
+{
+	__m256d s, o, v;
+	size_t i;
+
+	s = _mm256_set1_pd(scale);
+	o = _mm256_set1_pd(offset);
+	for (i = 0; i + 4 <= count; i += 4) {
+		v = _mm256_cvtps_pd(_mm_loadu_ps(data + i));
+		v = _mm256_cvtps_pd(_mm256_cvtpd_ps(_mm256_mul_pd(v, s)));
+		_mm_storeu_ps(data + i, _mm256_cvtpd_ps(_mm256_add_pd(v, o)));
+	}
+
+	return i;
+}
+
+__attribute__((target("sse2")))
+static size_t scale_sse2(float *data, size_t count, double scale,
+		double offset)
+{
+	__m128d s, o, v;
+	size_t i;
+
+	s = _mm_set1_pd(scale);
+	o = _mm_set1_pd(offset);
+	for (i = 0; i + 2 <= count; i += 2) {
+		v = _mm_cvtps_pd(_mm_castpd_ps(_mm_load_sd((const double *)(data + i))));
+		v = _mm_cvtps_pd(_mm_cvtpd_ps(_mm_mul_pd(v, s)));
+		_mm_store_sd((double *)(data + i),
+			_mm_castps_pd(_mm_cvtpd_ps(_mm_add_pd(v, o))));
+	}
+
+	return i;
+}
+#endif
+
+#ifdef SIMD_NEON
+static size_t invert_neon(uint8_t *data, size_t length)
+{
+	size_t i;
+
+	for (i = 0; i + 16 <= length; i += 16)
+		vst1q_u8(data + i, vmvnq_u8(vld1q_u8(data + i)));
+
+	return i;
+}
+#endif
+
+/**
+ * Invert all bits of a buffer in place.
+ *
+ * @param data The buffer to modify.
+ * @param length The length of the buffer in bytes.
+ *
+ * @private
+ */
+SR_PRIV void sr_simd_invert(uint8_t *data, size_t length)
+{
+	size_t done;
+
+	done = 0;
+#ifdef SIMD_X86
+	if (__builtin_cpu_supports("avx2"))
+		done = invert_avx2(data, length);
+	else if (__builtin_cpu_supports("sse2"))
+		done = invert_sse2(data, length);
+#endif
+#ifdef SIMD_NEON
+	done = invert_neon(data, length);
+#endif
+	invert_scalar(data + done, length - done);
+}
+
+/**
+ * Scale and offset an array of floats in place.
+ *
+ * Computes data[i] * scale + offset, rounded like the scalar code in
+ * sr_analog_to_float() always did: single precision after each step.
+ *
+ * @param data The values to modify.
+ * @param count The number of values.
+ * @param scale The factor to apply.
+ * @param offset The offset to add after scaling.
+ *
+ * @private
+ */
+SR_PRIV void sr_simd_scale_float(float *data, size_t count, double scale,
+		double offset)
+{
+	size_t done;
+
+	done = 0;
+#ifdef SIMD_X86
+	if (__builtin_cpu_supports("avx"))
+		done = scale_avx(data, count, scale, offset);
+	else if (__builtin_cpu_supports("sse2"))
+		done = scale_sse2(data, count, scale, offset);
+#endif
+	scale_scalar(data + done, count - done, scale, offset);
+}
+
+static uint8_t pext8(uint8_t value, uint8_t mask)
+{
+	uint8_t result;
+	int bit, pos;
+
+	result = 0;
+	for (bit = pos = 0; bit < 8; bit++) {
+		if (!(mask & (1 << bit)))
+			continue;
+		if (value & (1 << bit))
+			result |= 1 << pos;
+		pos++;
+	}
+
+	return result;
+}
+
+/*
+ * The output bits of every input byte are looked up in a table and
+ * shifted into place.
+ */
+static void bit_extract_table(const struct sr_bit_extract *be,
+		const uint8_t *in, uint8_t *out, size_t num_samples)
+{
+	uint64_t w;
+	size_t i, b, num_bytes;
+
+	num_bytes = MIN(be->in_unitsize, sizeof(w));
+	for (i = 0; i < num_samples; i++) {
+		w = 0;
+		for (b = 0; b < num_bytes; b++)
+			w |= (uint64_t)be->table[b][in[b]] << be->shift[b];
+		for (b = 0; b < be->out_unitsize; b++)
+			out[b] = w >> (8 * b);
+		in += be->in_unitsize;
+		out += be->out_unitsize;
+	}
+}
+
+#if defined(SIMD_X86) && defined(__x86_64__)
+__attribute__((target("bmi2")))
+static void bit_extract_bmi2(const struct sr_bit_extract *be,
+		const uint8_t *in, uint8_t *out, size_t num_samples)
+{
+	uint64_t w;
+	size_t i, num_bytes;
+
+	/* x86 is little endian, bit n of a sample is bit n of the word. */
+	num_bytes = MIN(be->in_unitsize, sizeof(w));
+	for (i = 0; i < num_samples; i++) {
+		w = 0;
+		memcpy(&w, in, num_bytes);
+		w = _pext_u64(w, be->mask);
+		memcpy(out, &w, be->out_unitsize);
+		in += be->in_unitsize;
+		out += be->out_unitsize;
+	}
+}
+#endif
+
+/**
+ * Prepare the extraction of selected bits from logic samples.
+ *
+ * @param be The state to initialize.
+ * @param mask The bits to keep, bit n is the logic channel with index n.
+ * @param in_unitsize The unitsize of the input samples.
+ *
+ * @private
+ */
+SR_PRIV void sr_simd_bit_extract_init(struct sr_bit_extract *be,
+		uint64_t mask, uint16_t in_unitsize)
+{
+	unsigned int b, v, shift;
+	uint8_t m;
+
+	be->mask = mask;
+	be->in_unitsize = in_unitsize;
+	shift = 0;
+	for (b = 0; b < 8; b++) {
+		m = mask >> (8 * b);
+		be->shift[b] = shift;
+		for (v = 0; v < 256; v++)
+			be->table[b][v] = pext8(v, m);
+		for (; m; m &= m - 1)
+			shift++;
+	}
+	be->out_unitsize = MAX((shift + 7) / 8, 1);
+}
+
+/**
+ * Pack the selected bits of logic samples into the smallest unitsize.
+ *
+ * Output bit n is the nth set bit of the mask, in increasing order.
+ *
+ * @param be The state set up by sr_simd_bit_extract_init().
+ * @param in The input samples, be->in_unitsize bytes each.
+ * @param out The output samples, be->out_unitsize bytes each.
+ * @param num_samples The number of samples.
+ *
+ * @private
+ */
+SR_PRIV void sr_simd_bit_extract(const struct sr_bit_extract *be,
+		const uint8_t *in, uint8_t *out, size_t num_samples)
+{
+#if defined(SIMD_X86) && defined(__x86_64__)
+	if (__builtin_cpu_supports("bmi2")) {
+		bit_extract_bmi2(be, in, out, num_samples);
+		return;
+	}
+#endif
+	bit_extract_table(be, in, out, num_samples);
+}
+
+/* Spread the low 4 bits of a compare mask to 4 bytes of 0 or 1. */
+static void mask_to_bytes4(unsigned int mask, uint8_t *out)
+{
+	uint32_t w;
+
+	w = ((mask & 0xf) * 0x00204081U) & 0x01010101U;
+	out[0] = w;
+	out[1] = w >> 8;
+	out[2] = w >> 16;
+	out[3] = w >> 24;
+}
+
+static void threshold_scalar(const float *in, float threshold,
+		uint8_t *out, size_t count)
+{
+	size_t i;
+
+	for (i = 0; i < count; i++)
+		out[i] = (in[i] >= threshold) ? 1 : 0;
+}
+
+static void schmitt_scalar(const float *in, float lo_thr, float hi_thr,
+		uint8_t *state, uint8_t *out, size_t count)
+{
+	size_t i;
+
+	for (i = 0; i < count; i++) {
+		if (in[i] < lo_thr)
+			*state = 0;
+		else if (in[i] > hi_thr)
+			*state = 1;
+		out[i] = *state;
+	}
+}
+
+#ifdef SIMD_X86
+__attribute__((target("avx")))
+static size_t threshold_avx(const float *in, float threshold,
+		uint8_t *out, size_t count)
+{
+	__m256 thr;
+	unsigned int mask;
+	size_t i;
+
+	thr = _mm256_set1_ps(threshold);
+	for (i = 0; i + 8 <= count; i += 8) {
+		mask = _mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(in + i),
+			thr, _CMP_GE_OQ));
+		mask_to_bytes4(mask, out + i);
+		mask_to_bytes4(mask >> 4, out + i + 4);
+	}
+
+	return i;
+}
+
+__attribute__((target("sse2")))
+static size_t threshold_sse2(const float *in, float threshold,
+		uint8_t *out, size_t count)
+{
+	__m128 thr;
+	size_t i;
+
+	thr = _mm_set1_ps(threshold);
+	for (i = 0; i + 4 <= count; i += 4)
+		mask_to_bytes4(_mm_movemask_ps(_mm_cmpge_ps(
+			_mm_loadu_ps(in + i), thr)), out + i);
+
+	return i;
+}
+
+/*
+ * The Schmitt trigger state depends on the previous sample, but most
+ * blocks contain no sample which would change it. Those are found with
+ * two compares and filled with the current state; only the others are
+ * walked sample by sample.
+ */
+__attribute__((target("avx")))
+static size_t schmitt_avx(const float *in, float lo_thr, float hi_thr,
+		uint8_t *state, uint8_t *out, size_t count)
+{
+	__m256 lo, hi, v;
+	unsigned int below, above;
+	size_t i;
+
+	lo = _mm256_set1_ps(lo_thr);
+	hi = _mm256_set1_ps(hi_thr);
+	for (i = 0; i + 8 <= count; i += 8) {
+		v = _mm256_loadu_ps(in + i);
+		below = _mm256_movemask_ps(_mm256_cmp_ps(v, lo, _CMP_LT_OQ));
+		above = _mm256_movemask_ps(_mm256_cmp_ps(v, hi, _CMP_GT_OQ));
+		if (!(*state ? below : above))
+			memset(out + i, *state, 8);
+		else
+			schmitt_scalar(in + i, lo_thr, hi_thr, state, out + i, 8);
+	}
+
+	return i;
+}
+
+__attribute__((target("sse2")))
+static size_t schmitt_sse2(const float *in, float lo_thr, float hi_thr,
+		uint8_t *state, uint8_t *out, size_t count)
+{
+	__m128 lo, hi, v;
+	unsigned int below, above;
+	size_t i;
+
+	lo = _mm_set1_ps(lo_thr);
+	hi = _mm_set1_ps(hi_thr);
+	for (i = 0; i + 4 <= count; i += 4) {
+		v = _mm_loadu_ps(in + i);
+		below = _mm_movemask_ps(_mm_cmplt_ps(v, lo));
+		above = _mm_movemask_ps(_mm_cmpgt_ps(v, hi));
+		if (!(*state ? below : above))
+			memset(out + i, *state, 4);
+		else
+			schmitt_scalar(in + i, lo_thr, hi_thr, state, out + i, 4);
+	}
+
+	return i;
+}
+#endif
+
+/**
+ * Convert floats to logic levels using a fixed threshold.
+ *
+ * @param in The analog values.
+ * @param threshold Values at or above it become 1, all others 0.
+ * @param out The logic levels, one byte per value.
+ * @param count The number of values.
+ *
+ * @private
+ */
+SR_PRIV void sr_simd_threshold(const float *in, float threshold,
+		uint8_t *out, size_t count)
+{
+	size_t done;
+
+	done = 0;
+#ifdef SIMD_X86
+	if (__builtin_cpu_supports("avx"))
+		done = threshold_avx(in, threshold, out, count);
+	else if (__builtin_cpu_supports("sse2"))
+		done = threshold_sse2(in, threshold, out, count);
+#endif
+	threshold_scalar(in + done, threshold, out + done, count - done);
+}
+
+/**
+ * Convert floats to logic levels using a Schmitt trigger.
+ *
+ * @param in The analog values.
+ * @param lo_thr Values below it switch the state to 0.
+ * @param hi_thr Values above it switch the state to 1.
+ * @param state The state after the previous value, updated on return.
+ * @param out The logic levels, one byte per value.
+ * @param count The number of values.
+ *
+ * @private
+ */
+SR_PRIV void sr_simd_schmitt(const float *in, float lo_thr, float hi_thr,
+		uint8_t *state, uint8_t *out, size_t count)
+{
+	size_t done;
+
+	done = 0;
+#ifdef SIMD_X86
+	if (__builtin_cpu_supports("avx"))
+		done = schmitt_avx(in, lo_thr, hi_thr, state, out, count);
+	else if (__builtin_cpu_supports("sse2"))
+		done = schmitt_sse2(in, lo_thr, hi_thr, state, out, count);
+#endif
+	schmitt_scalar(in + done, lo_thr, hi_thr, state, out + done,
+		count - done);
+}
+
+/*
+ * The multi-channel threshold first compares the interleaved values as
+ * one flat stream, one result bit per value. The thresholds repeat for
+ * every channel; a copy of them repeated 8 times lines up with every
+ * block of 8 values.
+ */
+static void threshold_bits_scalar(const float *in, const float *thr_rep,
+		size_t period, size_t pos, uint8_t *out, size_t count)
+{
+	size_t i;
+
+	for (i = 0; i < count; i++) {
+		if (!(i % 8))
+			out[i / 8] = 0;
+		if (in[i] >= thr_rep[(pos + i) % period])
+			out[i / 8] |= 1 << (i % 8);
+	}
+}
+
+#ifdef SIMD_X86
+__attribute__((target("avx")))
+static size_t threshold_bits_avx(const float *in, const float *thr_rep,
+		size_t period, uint8_t *out, size_t count)
+{
+	size_t i, p;
+
+	for (i = 0, p = 0; i + 8 <= count; i += 8) {
+		out[i / 8] = _mm256_movemask_ps(_mm256_cmp_ps(
+			_mm256_loadu_ps(in + i), _mm256_loadu_ps(thr_rep + p),
+			_CMP_GE_OQ));
+		if ((p += 8) == period)
+			p = 0;
+	}
+
+	return i;
+}
+
+__attribute__((target("sse2")))
+static size_t threshold_bits_sse2(const float *in, const float *thr_rep,
+		size_t period, uint8_t *out, size_t count)
+{
+	size_t i, p;
+
+	for (i = 0, p = 0; i + 8 <= count; i += 8) {
+		out[i / 8] = _mm_movemask_ps(_mm_cmpge_ps(_mm_loadu_ps(in + i),
+			_mm_loadu_ps(thr_rep + p))) |
+			_mm_movemask_ps(_mm_cmpge_ps(_mm_loadu_ps(in + i + 4),
+			_mm_loadu_ps(thr_rep + p + 4))) << 4;
+		if ((p += 8) == period)
+			p = 0;
+	}
+
+	return i;
+}
+#endif
+
+static void threshold_bits(const float *in, const float *thr_rep,
+		size_t period, uint8_t *out, size_t count)
+{
+	size_t done;
+
+	done = 0;
+#ifdef SIMD_X86
+	if (__builtin_cpu_supports("avx"))
+		done = threshold_bits_avx(in, thr_rep, period, out, count);
+	else if (__builtin_cpu_supports("sse2"))
+		done = threshold_bits_sse2(in, thr_rep, period, out, count);
+#endif
+	threshold_bits_scalar(in + done, thr_rep, period, done,
+		out + done / 8, count - done);
+}
+
+/**
+ * Convert interleaved floats of several channels to packed logic samples.
+ *
+ * Bit n of each logic sample is set when the value of channel n is at
+ * or above the threshold of that channel.
+ *
+ * @param in The analog values, count values of each channel interleaved.
+ * @param thresholds The threshold of each channel.
+ * @param num_channels The number of channels.
+ * @param out The logic samples, (num_channels + 7) / 8 bytes each.
+ * @param count The number of samples.
+ *
+ * @private
+ */
+SR_PRIV void sr_simd_threshold_multi(const float *in, const float *thresholds,
+		size_t num_channels, uint8_t *out, size_t count)
+{
+	uint8_t bits[512 + 2];
+	float *thr_rep;
+	size_t unitsize, period, chunk, n, s, j, bit, width;
+
+	if (!num_channels || !count)
+		return;
+
+	period = 8 * num_channels;
+	thr_rep = g_malloc_n(period, sizeof(float));
+	for (j = 0; j < period; j++)
+		thr_rep[j] = thresholds[j % num_channels];
+	unitsize = (num_channels + 7) / 8;
+
+	/* Whole bytes per sample: the bit stream is the output already. */
+	if (!(num_channels % 8)) {
+		threshold_bits(in, thr_rep, period, out, count * num_channels);
+		g_free(thr_rep);
+		return;
+	}
+
+	/* Otherwise regroup the bits of chunks of 8n samples. */
+	chunk = (8 * (sizeof(bits) - 2) / num_channels) & ~(size_t)7;
+	while (count > 0) {
+		n = MIN(chunk, count);
+		threshold_bits(in, thr_rep, period, bits, n * num_channels);
+		bits[(n * num_channels + 7) / 8] = 0;
+		for (s = 0; s < n; s++) {
+			for (j = 0; j < unitsize; j++) {
+				bit = s * num_channels + 8 * j;
+				width = MIN(8, num_channels - 8 * j);
+				out[j] = ((bits[bit / 8] | bits[bit / 8 + 1] << 8)
+					>> (bit % 8)) & ((1 << width) - 1);
+			}
+			out += unitsize;
+		}
+		in += n * num_channels;
+		count -= n;
+	}
+	g_free(thr_rep);
+}
+
+static size_t find_outside_scalar(const float *in, size_t count,
+		float lo, float hi)
+{
+	size_t i;
+
+	for (i = 0; i < count; i++) {
+		if (in[i] < lo || in[i] > hi)
+			break;
+	}
+
+	return i;
+}
+
+#ifdef SIMD_X86
+__attribute__((target("avx")))
+static size_t find_outside_avx(const float *in, size_t count,
+		float lo, float hi)
+{
+	__m256 vlo, vhi, v, out;
+	size_t i;
+
+	vlo = _mm256_set1_ps(lo);
+	vhi = _mm256_set1_ps(hi);
+	for (i = 0; i + 8 <= count; i += 8) {
+		v = _mm256_loadu_ps(in + i);
+		out = _mm256_or_ps(_mm256_cmp_ps(v, vlo, _CMP_LT_OQ),
+			_mm256_cmp_ps(v, vhi, _CMP_GT_OQ));
+		if (_mm256_movemask_ps(out))
+			break;
+	}
+
+	return i;
+}
+
+__attribute__((target("sse2")))
+static size_t find_outside_sse2(const float *in, size_t count,
+		float lo, float hi)
+{
+	__m128 vlo, vhi, v, out;
+	size_t i;
+
+	vlo = _mm_set1_ps(lo);
+	vhi = _mm_set1_ps(hi);
+	for (i = 0; i + 4 <= count; i += 4) {
+		v = _mm_loadu_ps(in + i);
+		out = _mm_or_ps(_mm_cmplt_ps(v, vlo), _mm_cmpgt_ps(v, vhi));
+		if (_mm_movemask_ps(out))
+			break;
+	}
+
+	return i;
+}
+#endif
+
+/**
+ * Find the first float outside of a range.
+ *
+ * @param in The values to search.
+ * @param count The number of values.
+ * @param lo Values below it are outside.
+ * @param hi Values above it are outside.
+ *
+ * @return The index of the first value below lo or above hi, or count.
+ *
+ * @private
+ */
+SR_PRIV size_t sr_simd_find_outside(const float *in, size_t count,
+		float lo, float hi)
+{
+	size_t done;
+
+	/* The vector loops stop at the block which has the value. */
+	done = 0;
+#ifdef SIMD_X86
+	if (__builtin_cpu_supports("avx"))
+		done = find_outside_avx(in, count, lo, hi);
+	else if (__builtin_cpu_supports("sse2"))
+		done = find_outside_sse2(in, count, lo, hi);
+#endif
+	return done + find_outside_scalar(in + done, count - done, lo, hi);
+}
+
+static void stats_scalar(struct sr_simd_stats *stats, const float *in,
+		size_t count)
+{
+	size_t i;
+	float v;
+
+	for (i = 0; i < count; i++) {
+		v = in[i];
+		if (v < stats->min)
+			stats->min = v;
+		if (v > stats->max)
+			stats->max = v;
+		stats->sum += v;
+		stats->sum_sq += (double)v * v;
+	}
+}
+
+#ifdef SIMD_X86
+__attribute__((target("avx")))
+static size_t stats_avx(struct sr_simd_stats *stats, const float *in,
+		size_t count)
+{
+	__m256 vmin, vmax, v;
+	__m256d vsum, vsq, lo, hi;
+	float mins[8], maxs[8];
+	double sums[4], sqs[4];
+	size_t i, j;
+
+	if (count < 8)
+		return 0;
+
+	/* Sums are kept in double precision, like the scalar code does. */
+	vmin = _mm256_set1_ps(stats->min);
+	vmax = _mm256_set1_ps(stats->max);
+	vsum = _mm256_setzero_pd();
+	vsq = _mm256_setzero_pd();
+	for (i = 0; i + 8 <= count; i += 8) {
+		v = _mm256_loadu_ps(in + i);
+		vmin = _mm256_min_ps(vmin, v);
+		vmax = _mm256_max_ps(vmax, v);
+		lo = _mm256_cvtps_pd(_mm256_castps256_ps128(v));
+		hi = _mm256_cvtps_pd(_mm256_extractf128_ps(v, 1));
+		vsum = _mm256_add_pd(vsum, _mm256_add_pd(lo, hi));
+		vsq = _mm256_add_pd(vsq, _mm256_add_pd(_mm256_mul_pd(lo, lo),
+			_mm256_mul_pd(hi, hi)));
+	}
+
+	_mm256_storeu_ps(mins, vmin);
+	_mm256_storeu_ps(maxs, vmax);
+	_mm256_storeu_pd(sums, vsum);
+	_mm256_storeu_pd(sqs, vsq);
+	for (j = 0; j < 8; j++) {
+		stats->min = MIN(stats->min, mins[j]);
+		stats->max = MAX(stats->max, maxs[j]);
+	}
+	for (j = 0; j < 4; j++) {
+		stats->sum += sums[j];
+		stats->sum_sq += sqs[j];
+	}
+
+	return i;
+}
+
+__attribute__((target("sse2")))
+static size_t stats_sse2(struct sr_simd_stats *stats, const float *in,
+		size_t count)
+{
+	__m128 vmin, vmax, v;
+	__m128d vsum, vsq, lo, hi;
+	float mins[4], maxs[4];
+	double sums[2], sqs[2];
+	size_t i, j;
+
+	if (count < 4)
+		return 0;
+
+	vmin = _mm_set1_ps(stats->min);
+	vmax = _mm_set1_ps(stats->max);
+	vsum = _mm_setzero_pd();
+	vsq = _mm_setzero_pd();
+	for (i = 0; i + 4 <= count; i += 4) {
+		v = _mm_loadu_ps(in + i);
+		vmin = _mm_min_ps(vmin, v);
+		vmax = _mm_max_ps(vmax, v);
+		lo = _mm_cvtps_pd(v);
+		hi = _mm_cvtps_pd(_mm_movehl_ps(v, v));
+		vsum = _mm_add_pd(vsum, _mm_add_pd(lo, hi));
+		vsq = _mm_add_pd(vsq, _mm_add_pd(_mm_mul_pd(lo, lo),
+			_mm_mul_pd(hi, hi)));
+	}
+
+	_mm_storeu_ps(mins, vmin);
+	_mm_storeu_ps(maxs, vmax);
+	_mm_storeu_pd(sums, vsum);
+	_mm_storeu_pd(sqs, vsq);
+	for (j = 0; j < 4; j++) {
+		stats->min = MIN(stats->min, mins[j]);
+		stats->max = MAX(stats->max, maxs[j]);
+	}
+	for (j = 0; j < 2; j++) {
+		stats->sum += sums[j];
+		stats->sum_sq += sqs[j];
+	}
+
+	return i;
+}
+#endif
+
+/**
+ * Start running statistics, see sr_simd_stats_float().
+ *
+ * @param stats The statistics to reset.
+ *
+ * @private
+ */
+SR_PRIV void sr_simd_stats_init(struct sr_simd_stats *stats)
+{
+	stats->min = FLT_MAX;
+	stats->max = -FLT_MAX;
+	stats->sum = 0;
+	stats->sum_sq = 0;
+}
+
+/**
+ * Add floats to running statistics.
+ *
+ * Updates the minimum and maximum, and the sums of the values and of
+ * their squares, from which the mean and the RMS follow.
+ *
+ * @param stats The statistics to update.
+ * @param in The values to add.
+ * @param count The number of values.
+ *
+ * @private
+ */
+SR_PRIV void sr_simd_stats_float(struct sr_simd_stats *stats,
+		const float *in, size_t count)
+{
+	size_t done;
+
+	done = 0;
+#ifdef SIMD_X86
+	if (__builtin_cpu_supports("avx"))
+		done = stats_avx(stats, in, count);
+	else if (__builtin_cpu_supports("sse2"))
+		done = stats_sse2(stats, in, count);
+#endif
+	stats_scalar(stats, in + done, count - done);
+}
+
+static size_t find_mismatch_scalar(const uint8_t *a, const uint8_t *b,
+		size_t length)
+{
+	uint64_t wa, wb;
+	size_t i;
+
+	/* Compare words, the XOR of differing words is non-zero. */
+	for (i = 0; i + sizeof(wa) <= length; i += sizeof(wa)) {
+		memcpy(&wa, a + i, sizeof(wa));
+		memcpy(&wb, b + i, sizeof(wb));
+		if (wa ^ wb)
+			break;
+	}
+	while (i < length && a[i] == b[i])
+		i++;
+
+	return i;
+}
+
+#ifdef SIMD_X86
+__attribute__((target("avx2")))
+static size_t find_mismatch_avx2(const uint8_t *a, const uint8_t *b,
+		size_t length)
+{
+	__m256i va, vb;
+	size_t i;
+
+	for (i = 0; i + 32 <= length; i += 32) {
+		va = _mm256_loadu_si256((const __m256i *)(a + i));
+		vb = _mm256_loadu_si256((const __m256i *)(b + i));
+		if ((uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(va, vb))
+				!= 0xffffffff)
+			break;
+	}
+
+	return i;
+}
+
+__attribute__((target("sse2")))
+static size_t find_mismatch_sse2(const uint8_t *a, const uint8_t *b,
+		size_t length)
+{
+	__m128i va, vb;
+	size_t i;
+
+	for (i = 0; i + 16 <= length; i += 16) {
+		va = _mm_loadu_si128((const __m128i *)(a + i));
+		vb = _mm_loadu_si128((const __m128i *)(b + i));
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(va, vb)) != 0xffff)
+			break;
+	}
+
+	return i;
+}
+#endif
+
+/**
+ * Find the first byte which differs between two buffers.
+ *
+ * Comparing the samples of a buffer with the same buffer shifted by
+ * one unitsize skips runs of unchanged logic samples.
+ *
+ * @param a The first buffer.
+ * @param b The second buffer.
+ * @param length The number of bytes to compare.
+ *
+ * @return The offset of the first differing byte, or length.
+ *
+ * @private
+ */
+SR_PRIV size_t sr_simd_find_mismatch(const uint8_t *a, const uint8_t *b,
+		size_t length)
+{
+	size_t done;
+
+	/* The vector loops stop at the block which has the difference. */
+	done = 0;
+#ifdef SIMD_X86
+	if (__builtin_cpu_supports("avx2"))
+		done = find_mismatch_avx2(a, b, length);
+	else if (__builtin_cpu_supports("sse2"))
+		done = find_mismatch_sse2(a, b, length);
+#endif
+	return done + find_mismatch_scalar(a + done, b + done, length - done);
+}
+
+/* Repeat the low unitsize bytes of a mask over 32 bits. */
+static uint32_t pattern_word(uint32_t mask, unsigned int unitsize)
+{
+	switch (unitsize) {
+	case 1:
+		return (mask & 0xff) * UINT32_C(0x01010101);
+	case 2:
+		return (mask & 0xffff) * UINT32_C(0x00010001);
+	default:
+		return mask;
+	}
+}
+
+#ifdef SIMD_X86
+__attribute__((target("avx2")))
+static size_t find_candidate_avx2(const struct sr_simd_pattern *pat,
+		const uint8_t *in, size_t length)
+{
+	__m256i value, care, rising, falling, edge, zero, cur, prev, mismatch, eq;
+	unsigned int unitsize;
+	size_t i;
+
+	unitsize = pat->unitsize;
+	value = _mm256_set1_epi32((int)pattern_word(pat->value, unitsize));
+	care = _mm256_set1_epi32((int)pattern_word(pat->care, unitsize));
+	rising = _mm256_set1_epi32((int)pattern_word(pat->rising, unitsize));
+	falling = _mm256_set1_epi32((int)pattern_word(pat->falling, unitsize));
+	edge = _mm256_set1_epi32((int)pattern_word(pat->edge, unitsize));
+	zero = _mm256_setzero_si256();
+
+	for (i = 0; i + 32 <= length; i += 32) {
+		cur = _mm256_loadu_si256((const __m256i *)(in + i));
+		prev = _mm256_loadu_si256((const __m256i *)(in + i - unitsize));
+		mismatch = _mm256_and_si256(_mm256_xor_si256(cur, value), care);
+		mismatch = _mm256_or_si256(mismatch, _mm256_andnot_si256(
+			_mm256_andnot_si256(prev, cur), rising));
+		mismatch = _mm256_or_si256(mismatch, _mm256_andnot_si256(
+			_mm256_andnot_si256(cur, prev), falling));
+		mismatch = _mm256_or_si256(mismatch, _mm256_andnot_si256(
+			_mm256_xor_si256(prev, cur), edge));
+		if (unitsize == 1)
+			eq = _mm256_cmpeq_epi8(mismatch, zero);
+		else if (unitsize == 2)
+			eq = _mm256_cmpeq_epi16(mismatch, zero);
+		else
+			eq = _mm256_cmpeq_epi32(mismatch, zero);
+		if (_mm256_movemask_epi8(eq))
+			break;
+	}
+
+	return i;
+}
+
+__attribute__((target("sse2")))
+static size_t find_candidate_sse2(const struct sr_simd_pattern *pat,
+		const uint8_t *in, size_t length)
+{
+	__m128i value, care, rising, falling, edge, zero, cur, prev, mismatch, eq;
+	unsigned int unitsize;
+	size_t i;
+
+	unitsize = pat->unitsize;
+	value = _mm_set1_epi32((int)pattern_word(pat->value, unitsize));
+	care = _mm_set1_epi32((int)pattern_word(pat->care, unitsize));
+	rising = _mm_set1_epi32((int)pattern_word(pat->rising, unitsize));
+	falling = _mm_set1_epi32((int)pattern_word(pat->falling, unitsize));
+	edge = _mm_set1_epi32((int)pattern_word(pat->edge, unitsize));
+	zero = _mm_setzero_si128();
+
+	for (i = 0; i + 16 <= length; i += 16) {
+		cur = _mm_loadu_si128((const __m128i *)(in + i));
+		prev = _mm_loadu_si128((const __m128i *)(in + i - unitsize));
+		mismatch = _mm_and_si128(_mm_xor_si128(cur, value), care);
+		mismatch = _mm_or_si128(mismatch, _mm_andnot_si128(
+			_mm_andnot_si128(prev, cur), rising));
+		mismatch = _mm_or_si128(mismatch, _mm_andnot_si128(
+			_mm_andnot_si128(cur, prev), falling));
+		mismatch = _mm_or_si128(mismatch, _mm_andnot_si128(
+			_mm_xor_si128(prev, cur), edge));
+		if (unitsize == 1)
+			eq = _mm_cmpeq_epi8(mismatch, zero);
+		else if (unitsize == 2)
+			eq = _mm_cmpeq_epi16(mismatch, zero);
+		else
+			eq = _mm_cmpeq_epi32(mismatch, zero);
+		if (_mm_movemask_epi8(eq))
+			break;
+	}
+
+	return i;
+}
+#endif
+
+#ifdef SIMD_NEON
+static size_t find_candidate_neon(const struct sr_simd_pattern *pat,
+		const uint8_t *in, size_t length)
+{
+	uint32x4_t value, care, rising, falling, edge, cur, prev, mismatch;
+	uint64x2_t any;
+	unsigned int unitsize;
+	size_t i;
+
+	unitsize = pat->unitsize;
+	value = vdupq_n_u32(pattern_word(pat->value, unitsize));
+	care = vdupq_n_u32(pattern_word(pat->care, unitsize));
+	rising = vdupq_n_u32(pattern_word(pat->rising, unitsize));
+	falling = vdupq_n_u32(pattern_word(pat->falling, unitsize));
+	edge = vdupq_n_u32(pattern_word(pat->edge, unitsize));
+
+	for (i = 0; i + 16 <= length; i += 16) {
+		cur = vreinterpretq_u32_u8(vld1q_u8(in + i));
+		prev = vreinterpretq_u32_u8(vld1q_u8(in + i - unitsize));
+		mismatch = vandq_u32(veorq_u32(cur, value), care);
+		mismatch = vorrq_u32(mismatch,
+			vbicq_u32(rising, vbicq_u32(cur, prev)));
+		mismatch = vorrq_u32(mismatch,
+			vbicq_u32(falling, vbicq_u32(prev, cur)));
+		mismatch = vorrq_u32(mismatch,
+			vbicq_u32(edge, veorq_u32(prev, cur)));
+		/* Lanes without a mismatching bit compare all ones. */
+		if (unitsize == 1)
+			any = vreinterpretq_u64_u8(vceqq_u8(
+				vreinterpretq_u8_u32(mismatch), vdupq_n_u8(0)));
+		else if (unitsize == 2)
+			any = vreinterpretq_u64_u16(vceqq_u16(
+				vreinterpretq_u16_u32(mismatch), vdupq_n_u16(0)));
+		else
+			any = vreinterpretq_u64_u32(vceqq_u32(mismatch,
+				vdupq_n_u32(0)));
+		if (vgetq_lane_u64(any, 0) | vgetq_lane_u64(any, 1))
+			break;
+	}
+
+	return i;
+}
+#endif
+
+/**
+ * Skip over logic samples which can't match a trigger stage.
+ *
+ * A sample is a candidate when it has the pattern's value in the bits
+ * the pattern cares about, and the pattern's edges against the sample
+ * before it. This checks a vector of samples at a time, and stops at
+ * the first vector which holds a candidate, or which doesn't fit.
+ * Without vector instructions, it returns 0 right away and the caller's
+ * own loop does all the checking.
+ *
+ * @param pat The pattern, its unitsize is 1, 2 or 4.
+ * @param in The first sample to check. The sample before it must be
+ *           readable, it's the previous sample of the first one.
+ * @param length The number of bytes to check.
+ *
+ * @return The number of bytes, a multiple of the unitsize, whose
+ *         samples are no candidates.
+ *
+ * @private
+ */
+SR_PRIV size_t sr_simd_find_candidate(const struct sr_simd_pattern *pat,
+		const uint8_t *in, size_t length)
+{
+#if G_BYTE_ORDER == G_LITTLE_ENDIAN
+#ifdef SIMD_X86
+	if (__builtin_cpu_supports("avx2"))
+		return find_candidate_avx2(pat, in, length);
+	if (__builtin_cpu_supports("sse2"))
+		return find_candidate_sse2(pat, in, length);
+#endif
+#ifdef SIMD_NEON
+	return find_candidate_neon(pat, in, length);
+#endif
+#endif
+	(void)pat;
+	(void)in;
+	(void)length;
+
+	return 0;
+}
+
+static void fill_u16_scalar(uint16_t *out, uint16_t value, size_t count)
+{
+	while (count--)
+		*out++ = value;
+}
+
+#ifdef SIMD_X86
+__attribute__((target("avx2")))
+static size_t fill_u16_avx2(uint16_t *out, uint16_t value, size_t count)
+{
+	__m256i v;
+	size_t i;
+
+	v = _mm256_set1_epi16(value);
+	for (i = 0; i + 16 <= count; i += 16)
+		_mm256_storeu_si256((__m256i *)(out + i), v);
+
+	return i;
+}
+
+__attribute__((target("sse2")))
+static size_t fill_u16_sse2(uint16_t *out, uint16_t value, size_t count)
+{
+	__m128i v;
+	size_t i;
+
+	v = _mm_set1_epi16(value);
+	for (i = 0; i + 8 <= count; i += 8)
+		_mm_storeu_si128((__m128i *)(out + i), v);
+
+	return i;
+}
+#endif
+
+#ifdef SIMD_NEON
+static size_t fill_u16_neon(uint16_t *out, uint16_t value, size_t count)
+{
+	uint16x8_t v;
+	size_t i;
+
+	v = vdupq_n_u16(value);
+	for (i = 0; i + 8 <= count; i += 8)
+		vst1q_u16(out + i, v);
+
+	return i;
+}
+#endif
+
+/**
+ * Fill a buffer with copies of a 16bit value.
+ *
+ * Expands runs of run length encoded logic samples.
+ *
+ * @param out The buffer.
+ * @param value The value, in host byte order.
+ * @param count The number of values to write.
+ *
+ * @private
+ */
+SR_PRIV void sr_simd_fill_u16(uint16_t *out, uint16_t value, size_t count)
+{
+	size_t done;
+
+	done = 0;
+#ifdef SIMD_X86
+	if (__builtin_cpu_supports("avx2"))
+		done = fill_u16_avx2(out, value, count);
+	else if (__builtin_cpu_supports("sse2"))
+		done = fill_u16_sse2(out, value, count);
+#endif
+#ifdef SIMD_NEON
+	done = fill_u16_neon(out, value, count);
+#endif
+	fill_u16_scalar(out + done, value, count - done);
+}
+
+static void fill_u32_scalar(uint32_t *out, uint32_t value, size_t count)
+{
+	while (count--)
+		*out++ = value;
+}
+
+#ifdef SIMD_X86
+__attribute__((target("avx2")))
+static size_t fill_u32_avx2(uint32_t *out, uint32_t value, size_t count)
+{
+	__m256i v;
+	size_t i;
+
+	v = _mm256_set1_epi32(value);
+	for (i = 0; i + 8 <= count; i += 8)
+		_mm256_storeu_si256((__m256i *)(out + i), v);
+
+	return i;
+}
+
+__attribute__((target("sse2")))
+static size_t fill_u32_sse2(uint32_t *out, uint32_t value, size_t count)
+{
+	__m128i v;
+	size_t i;
+
+	v = _mm_set1_epi32(value);
+	for (i = 0; i + 4 <= count; i += 4)
+		_mm_storeu_si128((__m128i *)(out + i), v);
+
+	return i;
+}
+#endif
+
+#ifdef SIMD_NEON
+static size_t fill_u32_neon(uint32_t *out, uint32_t value, size_t count)
+{
+	uint32x4_t v;
+	size_t i;
+
+	v = vdupq_n_u32(value);
+	for (i = 0; i + 4 <= count; i += 4)
+		vst1q_u32(out + i, v);
+
+	return i;
+}
+#endif
+
+/**
+ * Fill a buffer with copies of a 32bit value.
+ *
+ * @param out The buffer.
+ * @param value The value, in host byte order.
+ * @param count The number of values to write.
+ *
+ * @private
+ */
+SR_PRIV void sr_simd_fill_u32(uint32_t *out, uint32_t value, size_t count)
+{
+	size_t done;
+
+	done = 0;
+#ifdef SIMD_X86
+	if (__builtin_cpu_supports("avx2"))
+		done = fill_u32_avx2(out, value, count);
+	else if (__builtin_cpu_supports("sse2"))
+		done = fill_u32_sse2(out, value, count);
+#endif
+#ifdef SIMD_NEON
+	done = fill_u32_neon(out, value, count);
+#endif
+	fill_u32_scalar(out + done, value, count - done);
+}
+
+/*
+ * The conversion kernels compute in double precision and round to
+ * single precision once, like the generic sr_analog_to_float() code.
+ */
+static void to_float_scalar(enum sr_simd_format format, const uint8_t *in,
+		float *out, size_t count, double scale, double offset)
+{
+	double value;
+	size_t i;
+
+	for (i = 0; i < count; i++) {
+		switch (format) {
+		case SR_SIMD_I8:
+			value = read_i8(in + i);
+			break;
+		case SR_SIMD_U8:
+			value = read_u8(in + i);
+			break;
+		case SR_SIMD_I16LE:
+			value = read_i16le(in + 2 * i);
+			break;
+		case SR_SIMD_U16LE:
+			value = read_u16le(in + 2 * i);
+			break;
+		case SR_SIMD_F32LE:
+			value = read_fltle(in + 4 * i);
+			break;
+		case SR_SIMD_F32BE:
+			value = read_fltbe(in + 4 * i);
+			break;
+		default:
+			value = 0;
+			break;
+		}
+		out[i] = value * scale + offset;
+	}
+}
+
+#ifdef SIMD_X86
+__attribute__((target("avx")))
+static inline void to_float_store_avx(float *out, __m256d v,
+		__m256d s, __m256d o)
+{
+	_mm_storeu_ps(out, _mm256_cvtpd_ps(_mm256_add_pd(_mm256_mul_pd(v, s), o)));
+}
+
+__attribute__((target("avx")))
+static size_t to_float_avx(enum sr_simd_format format, const uint8_t *in,
+		float *out, size_t count, double scale, double offset)
+{
+	const __m128i bswap = _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11,
+		4, 5, 6, 7, 0, 1, 2, 3);
+	__m256d s, o, v;
+	__m128i x;
+	int32_t w;
+	size_t i;
+
+	s = _mm256_set1_pd(scale);
+	o = _mm256_set1_pd(offset);
+	for (i = 0; i + 4 <= count; i += 4) {
+		switch (format) {
+		case SR_SIMD_I8:
+			memcpy(&w, in + i, sizeof(w));
+			x = _mm_cvtepi8_epi32(_mm_cvtsi32_si128(w));
+			v = _mm256_cvtepi32_pd(x);
+			break;
+		case SR_SIMD_U8:
+			memcpy(&w, in + i, sizeof(w));
+			x = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(w));
+			v = _mm256_cvtepi32_pd(x);
+			break;
+		case SR_SIMD_I16LE:
+			x = _mm_loadl_epi64((const __m128i *)(in + 2 * i));
+			v = _mm256_cvtepi32_pd(_mm_cvtepi16_epi32(x));
+			break;
+		case SR_SIMD_U16LE:
+			x = _mm_loadl_epi64((const __m128i *)(in + 2 * i));
+			v = _mm256_cvtepi32_pd(_mm_cvtepu16_epi32(x));
+			break;
+		case SR_SIMD_F32LE:
+			v = _mm256_cvtps_pd(_mm_loadu_ps((const float *)(in + 4 * i)));
+			break;
+		case SR_SIMD_F32BE:
+			x = _mm_loadu_si128((const __m128i *)(in + 4 * i));
+			x = _mm_shuffle_epi8(x, bswap);
+			v = _mm256_cvtps_pd(_mm_castsi128_ps(x));
+			break;
+		default:
+			return i;
+		}
+		to_float_store_avx(out + i, v, s, o);
+	}
+
+	return i;
+}
+
+__attribute__((target("sse2")))
+static inline void to_float_store_sse2(float *out, __m128d lo, __m128d hi,
+		__m128d s, __m128d o)
+{
+	__m128 l, h;
+
+	l = _mm_cvtpd_ps(_mm_add_pd(_mm_mul_pd(lo, s), o));
+	h = _mm_cvtpd_ps(_mm_add_pd(_mm_mul_pd(hi, s), o));
+	_mm_storeu_ps(out, _mm_movelh_ps(l, h));
+}
+
+__attribute__((target("sse2")))
+static size_t to_float_sse2(enum sr_simd_format format, const uint8_t *in,
+		float *out, size_t count, double scale, double offset)
+{
+	__m128d s, o;
+	__m128i x, zero;
+	__m128 f;
+	int32_t w;
+	size_t i;
+
+	s = _mm_set1_pd(scale);
+	o = _mm_set1_pd(offset);
+	zero = _mm_setzero_si128();
+	for (i = 0; i + 4 <= count; i += 4) {
+		/* Get four 32 bit integers, or four floats. */
+		switch (format) {
+		case SR_SIMD_I8:
+			memcpy(&w, in + i, sizeof(w));
+			x = _mm_cvtsi32_si128(w);
+			x = _mm_unpacklo_epi8(x, x);
+			x = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 24);
+			break;
+		case SR_SIMD_U8:
+			memcpy(&w, in + i, sizeof(w));
+			x = _mm_unpacklo_epi8(_mm_cvtsi32_si128(w), zero);
+			x = _mm_unpacklo_epi16(x, zero);
+			break;
+		case SR_SIMD_I16LE:
+			x = _mm_loadl_epi64((const __m128i *)(in + 2 * i));
+			x = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+			break;
+		case SR_SIMD_U16LE:
+			x = _mm_loadl_epi64((const __m128i *)(in + 2 * i));
+			x = _mm_unpacklo_epi16(x, zero);
+			break;
+		case SR_SIMD_F32LE:
+		case SR_SIMD_F32BE:
+			x = _mm_loadu_si128((const __m128i *)(in + 4 * i));
+			if (format == SR_SIMD_F32BE) {
+				x = _mm_or_si128(_mm_slli_epi16(x, 8),
+					_mm_srli_epi16(x, 8));
+				x = _mm_shufflelo_epi16(x, 0xb1);
+				x = _mm_shufflehi_epi16(x, 0xb1);
+			}
+			f = _mm_castsi128_ps(x);
+			to_float_store_sse2(out + i, _mm_cvtps_pd(f),
+				_mm_cvtps_pd(_mm_movehl_ps(f, f)), s, o);
+			continue;
+		default:
+			return i;
+		}
+		to_float_store_sse2(out + i, _mm_cvtepi32_pd(x),
+			_mm_cvtepi32_pd(_mm_srli_si128(x, 8)), s, o);
+	}
+
+	return i;
+}
+#endif
+
+/**
+ * Convert samples of a common format to floats.
+ *
+ * Computes in[i] * scale + offset in double precision, and rounds the
+ * result to single precision.
+ *
+ * @param format The format of the input samples.
+ * @param in The input samples.
+ * @param out The output values.
+ * @param count The number of samples.
+ * @param scale The factor to apply.
+ * @param offset The offset to add after scaling.
+ *
+ * @private
+ */
+SR_PRIV void sr_simd_to_float(enum sr_simd_format format, const uint8_t *in,
+		float *out, size_t count, double scale, double offset)
+{
+	size_t done, unitsize;
+
+	unitsize = (format == SR_SIMD_I8 || format == SR_SIMD_U8) ? 1 :
+		(format == SR_SIMD_I16LE || format == SR_SIMD_U16LE) ? 2 : 4;
+	done = 0;
+#ifdef SIMD_X86
+	if (__builtin_cpu_supports("avx"))
+		done = to_float_avx(format, in, out, count, scale, offset);
+	else if (__builtin_cpu_supports("sse2"))
+		done = to_float_sse2(format, in, out, count, scale, offset);
+#endif
+	to_float_scalar(format, in + done * unitsize, out + done,
+		count - done, scale, offset);
+}
+
+/*
+ * Deinterleaving of channel words. Blocks of 16bit, 32bit or 64bit little
+ * endian words carry 16, 32 or 64 samples of one channel each, the k-th word of a
+ * block belongs to the k-th channel in the mask. This is a bit matrix
+ * transpose: the vector kernels first transpose the bytes of a block with
+ * unpack operations, so a register holds the same byte of every word.
+ * Movemask then collects one bit of every word, which is a sample. The
+ * bits of unused words get masked, or scattered to their channels by
+ * lookup tables when the channels aren't the mask's low bits.
+ */
+
+struct deinterleave_map {
+	size_t num_words;
+	size_t word_size;
+	gboolean msb_first;
+	uint8_t channel[16];
+	/* Used lanes, when the channels are the low bits of the mask. */
+	gboolean direct;
+	uint16_t lanes;
+	/* Channel bits of the lanes in the low and high byte. */
+	uint16_t lo[256];
+	uint16_t hi[256];
+};
+
+static void deinterleave_map_init(struct deinterleave_map *map,
+		enum sr_simd_word_format format, size_t num_words,
+		uint16_t channel_mask)
+{
+	unsigned int c, v, b;
+	size_t k;
+
+	switch (format) {
+	case SR_SIMD_WORD16LE_LSB:
+	case SR_SIMD_WORD16LE_MSB:
+		map->word_size = 2;
+		break;
+	case SR_SIMD_WORD32LE_MSB:
+		map->word_size = 4;
+		break;
+	default:
+		map->word_size = 8;
+		break;
+	}
+	map->msb_first = format == SR_SIMD_WORD32LE_MSB ||
+		format == SR_SIMD_WORD16LE_MSB;
+	k = 0;
+	map->direct = TRUE;
+	for (c = 0; c < 16 && k < num_words; c++) {
+		if (!(channel_mask & (1 << c)))
+			continue;
+		if (c != k)
+			map->direct = FALSE;
+		map->channel[k++] = c;
+	}
+	map->num_words = k;
+	map->lanes = (1 << k) - 1;
+	if (map->direct)
+		return;
+
+	for (v = 0; v < 256; v++) {
+		map->lo[v] = map->hi[v] = 0;
+		for (b = 0; b < 8; b++) {
+			if (!(v & (1 << b)))
+				continue;
+			if (b < k)
+				map->lo[v] |= 1 << map->channel[b];
+			if (b + 8 < k)
+				map->hi[v] |= 1 << map->channel[b + 8];
+		}
+	}
+}
+
+static inline uint16_t deinterleave_sample(const struct deinterleave_map *map,
+		unsigned int lanes)
+{
+	if (map->direct)
+		return lanes & map->lanes;
+
+	return map->lo[lanes & 0xff] | map->hi[(lanes >> 8) & 0xff];
+}
+
+/* Index of the sample in bit 'bit' of byte 'byte' of the words. */
+static inline size_t deinterleave_index(const struct deinterleave_map *map,
+		int byte, int bit)
+{
+	if (map->msb_first)
+		return (map->word_size - 1 - byte) * 8 + 7 - bit;
+
+	return byte * 8 + bit;
+}
+
+static void deinterleave_scalar(const struct deinterleave_map *map,
+		const uint8_t *in, size_t num_blocks, size_t block_size,
+		uint16_t *out)
+{
+	uint64_t words[16];
+	uint16_t sample;
+	size_t k;
+	unsigned int bit, shift, num_bits;
+
+	num_bits = map->word_size * 8;
+	while (num_blocks--) {
+		for (k = 0; k < map->num_words; k++) {
+			if (map->word_size == 2)
+				words[k] = RL16(in + k * 2);
+			else if (map->word_size == 4)
+				words[k] = RL32(in + k * 4);
+			else
+				words[k] = RL64(in + k * 8);
+		}
+		for (bit = 0; bit < num_bits; bit++) {
+			shift = map->msb_first ? num_bits - 1 - bit : bit;
+			sample = 0;
+			for (k = 0; k < map->num_words; k++) {
+				if ((words[k] >> shift) & 1)
+					sample |= 1 << map->channel[k];
+			}
+			*out++ = sample;
+		}
+		in += block_size;
+	}
+}
+
+#ifdef SIMD_X86
+/*
+ * Each level pairs registers i and i + n / 2. After four levels register
+ * j holds byte j of all 16 words, in word order, for one register per
+ * byte of the words.
+ */
+__attribute__((target("avx2")))
+static inline void transpose_level_avx2(__m256i *r, int n)
+{
+	__m256i t[8];
+	int i;
+
+	for (i = 0; i < n / 2; i++) {
+		t[2 * i] = _mm256_unpacklo_epi8(r[i], r[i + n / 2]);
+		t[2 * i + 1] = _mm256_unpackhi_epi8(r[i], r[i + n / 2]);
+	}
+	for (i = 0; i < n; i++)
+		r[i] = t[i];
+}
+
+/* Two blocks at a time, one in each 128bit lane. */
+__attribute__((target("avx2")))
+static size_t deinterleave_avx2(const struct deinterleave_map *map,
+		const uint8_t *in, size_t num_blocks, size_t block_size,
+		uint16_t *out)
+{
+	__m256i r[8];
+	const uint8_t *a, *b;
+	uint16_t *oa, *ob;
+	uint32_t lanes;
+	size_t n, length, load_size, num_samples;
+	int j, bit, num_regs;
+
+	num_regs = map->word_size;
+	load_size = num_regs * 16;
+	num_samples = map->word_size * 8;
+	length = num_blocks * block_size;
+	/* The loads cover 16 words from the start of each block. */
+	for (n = 0; n + 2 <= num_blocks &&
+			(n + 1) * block_size + load_size <= length; n += 2) {
+		a = in + n * block_size;
+		b = a + block_size;
+		for (j = 0; j < num_regs; j++) {
+			r[j] = _mm256_inserti128_si256(_mm256_castsi128_si256(
+				_mm_loadu_si128((const __m128i *)(a + 16 * j))),
+				_mm_loadu_si128((const __m128i *)(b + 16 * j)), 1);
+		}
+		transpose_level_avx2(r, num_regs);
+		transpose_level_avx2(r, num_regs);
+		transpose_level_avx2(r, num_regs);
+		transpose_level_avx2(r, num_regs);
+		oa = out + n * num_samples;
+		ob = oa + num_samples;
+		for (j = 0; j < num_regs; j++) {
+			for (bit = 7; bit >= 0; bit--) {
+				lanes = _mm256_movemask_epi8(r[j]);
+				oa[deinterleave_index(map, j, bit)] =
+					deinterleave_sample(map, lanes);
+				ob[deinterleave_index(map, j, bit)] =
+					deinterleave_sample(map, lanes >> 16);
+				r[j] = _mm256_add_epi8(r[j], r[j]);
+			}
+		}
+	}
+
+	return n;
+}
+
+__attribute__((target("sse2")))
+static inline void transpose_level_sse2(__m128i *r, int n)
+{
+	__m128i t[8];
+	int i;
+
+	for (i = 0; i < n / 2; i++) {
+		t[2 * i] = _mm_unpacklo_epi8(r[i], r[i + n / 2]);
+		t[2 * i + 1] = _mm_unpackhi_epi8(r[i], r[i + n / 2]);
+	}
+	for (i = 0; i < n; i++)
+		r[i] = t[i];
+}
+
+__attribute__((target("sse2")))
+static size_t deinterleave_sse2(const struct deinterleave_map *map,
+		const uint8_t *in, size_t num_blocks, size_t block_size,
+		uint16_t *out)
+{
+	__m128i r[8];
+	const uint8_t *a;
+	uint16_t *o;
+	size_t n, length, load_size, num_samples;
+	int j, bit, num_regs;
+
+	num_regs = map->word_size;
+	load_size = num_regs * 16;
+	num_samples = map->word_size * 8;
+	length = num_blocks * block_size;
+	for (n = 0; n < num_blocks && n * block_size + load_size <= length; n++) {
+		a = in + n * block_size;
+		for (j = 0; j < num_regs; j++)
+			r[j] = _mm_loadu_si128((const __m128i *)(a + 16 * j));
+		transpose_level_sse2(r, num_regs);
+		transpose_level_sse2(r, num_regs);
+		transpose_level_sse2(r, num_regs);
+		transpose_level_sse2(r, num_regs);
+		o = out + n * num_samples;
+		for (j = 0; j < num_regs; j++) {
+			for (bit = 7; bit >= 0; bit--) {
+				o[deinterleave_index(map, j, bit)] =
+					deinterleave_sample(map,
+						_mm_movemask_epi8(r[j]));
+				r[j] = _mm_add_epi8(r[j], r[j]);
+			}
+		}
+	}
+
+	return n;
+}
+#endif
+
+#ifdef SIMD_NEON
+static inline unsigned int movemask_neon(uint8x16_t v)
+{
+	static const int8_t shifts[16] = {
+		0, 1, 2, 3, 4, 5, 6, 7, 0, 1, 2, 3, 4, 5, 6, 7,
+	};
+	uint8x16_t bits;
+	uint64x2_t sums;
+
+	bits = vshlq_u8(vshrq_n_u8(v, 7), vld1q_s8(shifts));
+	sums = vpaddlq_u32(vpaddlq_u16(vpaddlq_u8(bits)));
+
+	return vgetq_lane_u64(sums, 0) | (vgetq_lane_u64(sums, 1) << 8);
+}
+
+static size_t deinterleave_neon(const struct deinterleave_map *map,
+		const uint8_t *in, size_t num_blocks, size_t block_size,
+		uint16_t *out)
+{
+	uint8x16_t r[8], t[8];
+	uint8x16x2_t z;
+	const uint8_t *a;
+	uint16_t *o;
+	size_t n, length, load_size, num_samples;
+	int i, j, level, bit, num_regs;
+
+	num_regs = map->word_size;
+	load_size = num_regs * 16;
+	num_samples = map->word_size * 8;
+	length = num_blocks * block_size;
+	for (n = 0; n < num_blocks && n * block_size + load_size <= length; n++) {
+		a = in + n * block_size;
+		for (j = 0; j < num_regs; j++)
+			r[j] = vld1q_u8(a + 16 * j);
+		/* Zipping is unpacking, see transpose_level_sse2(). */
+		for (level = 0; level < 4; level++) {
+			for (i = 0; i < num_regs / 2; i++) {
+				z = vzipq_u8(r[i], r[i + num_regs / 2]);
+				t[2 * i] = z.val[0];
+				t[2 * i + 1] = z.val[1];
+			}
+			for (i = 0; i < num_regs; i++)
+				r[i] = t[i];
+		}
+		o = out + n * num_samples;
+		for (j = 0; j < num_regs; j++) {
+			for (bit = 7; bit >= 0; bit--) {
+				o[deinterleave_index(map, j, bit)] =
+					deinterleave_sample(map,
+						movemask_neon(r[j]));
+				r[j] = vaddq_u8(r[j], r[j]);
+			}
+		}
+	}
+
+	return n;
+}
+#endif
+
+/**
+ * Deinterleave blocks of channel words into 16bit logic samples.
+ *
+ * The input is a sequence of blocks of num_words little endian words.
+ * The k-th word of a block holds consecutive samples of the k-th channel
+ * which is set in channel_mask. With SR_SIMD_WORD16LE_LSB and
+ * SR_SIMD_WORD64LE_LSB the earliest of 16 or 64 samples is in the least
+ * significant bit, with SR_SIMD_WORD16LE_MSB and SR_SIMD_WORD32LE_MSB the
+ * earliest of 16 or 32 samples is in the most significant bit.
+ *
+ * @param format The layout of the words.
+ * @param in The channel words.
+ * @param length The length of the input in bytes, a multiple of the
+ *               block size.
+ * @param out The output samples, 16, 32 or 64 for every block.
+ * @param num_words The number of words per block, 1 to 16.
+ * @param channel_mask The channels, which are bits of the samples.
+ *
+ * @private
+ */
+SR_PRIV void sr_simd_deinterleave_words(enum sr_simd_word_format format,
+		const uint8_t *in, size_t length, uint16_t *out,
+		size_t num_words, uint16_t channel_mask)
+{
+	struct deinterleave_map map;
+	size_t block_size, num_blocks, num_samples, done;
+
+	if (!num_words || num_words > 16)
+		return;
+	deinterleave_map_init(&map, format, num_words, channel_mask);
+	block_size = num_words * map.word_size;
+	num_blocks = length / block_size;
+	num_samples = map.word_size * 8;
+
+	/* The vector loops leave the blocks near the end to the scalar code. */
+	done = 0;
+#ifdef SIMD_X86
+	if (__builtin_cpu_supports("avx2"))
+		done = deinterleave_avx2(&map, in, num_blocks, block_size, out);
+	if (__builtin_cpu_supports("sse2"))
+		done += deinterleave_sse2(&map, in + done * block_size,
+			num_blocks - done, block_size, out + done * num_samples);
+#endif
+#ifdef SIMD_NEON
+	done = deinterleave_neon(&map, in, num_blocks, block_size, out);
+#endif
+	deinterleave_scalar(&map, in + done * block_size, num_blocks - done,
+		block_size, out + done * num_samples);
+}
@@ -18,6 +18,7 @@
  */
 
 #include <config.h>
+#include <math.h>
 #include <string.h>
 #include <libsigrok/libsigrok.h>
 #include "libsigrok-internal.h"
@@ -26,19 +27,170 @@
 #define LOG_PREFIX "soft-trigger"
 /** @endcond */
 
-SR_PRIV int logic_channel_unitsize(GSList *channels)
+static void stage_set_bit(uint64_t *mask, int index)
 {
-	int number = 0;
-	struct sr_channel *channel;
-	GSList *l;
+	uint8_t *bytes;
+
+	bytes = (uint8_t *)mask;
+	bytes[index / 8] |= 1 << (index % 8);
+}
+
+static gboolean stage_test_bit(const uint64_t *mask, int index)
+{
+	const uint8_t *bytes;
+
+	bytes = (const uint8_t *)mask;
+
+	return (bytes[index / 8] & (1 << (index % 8))) != 0;
+}
+
+/*
+ * Compile the matches of each trigger stage into bit masks, so that a
+ * logic sample can be checked against a whole stage with a few word
+ * wide operations. The masks use the layout of a sample copied into
+ * words byte by byte, which keeps them independent of the endianness.
+ */
+static void stages_compile(struct soft_trigger_logic *stl)
+{
+	struct soft_trigger_stage *st;
+	struct sr_trigger_stage *stage;
+	struct sr_trigger_match *match;
+	const struct sr_channel *ch;
+	GSList *l, *m;
+	int index;
+
+	stl->num_words = (stl->unitsize + 7) / 8;
+	stl->num_stages = g_slist_length(stl->trigger->stages);
+	stl->stages = g_malloc0_n(stl->num_stages, sizeof(*stl->stages));
+	stl->prev_words = g_malloc0_n(stl->num_words, sizeof(uint64_t));
+	stl->cur_words = g_malloc0_n(stl->num_words, sizeof(uint64_t));
+
+	st = stl->stages;
+	for (l = stl->trigger->stages; l; l = l->next, st++) {
+		stage = l->data;
+		st->masks = g_malloc0_n(5 * stl->num_words, sizeof(uint64_t));
+		st->value = st->masks;
+		st->care = st->value + stl->num_words;
+		st->rising = st->care + stl->num_words;
+		st->falling = st->rising + stl->num_words;
+		st->edge = st->falling + stl->num_words;
+		st->empty = !stage->matches;
+		for (m = stage->matches; m; m = m->next) {
+			match = m->data;
+			ch = match->channel;
+			/* Ignore disabled channels with a trigger. */
+			if (!ch->enabled || ch->type != SR_CHANNEL_LOGIC)
+				continue;
+			if (ch->index >= stl->unitsize * 8)
+				continue;
+			index = ch->index;
+			switch (match->match) {
+			case SR_TRIGGER_ONE:
+				/* A bit can't be both 0 and 1. */
+				if (stage_test_bit(st->care, index)
+						&& !stage_test_bit(st->value, index))
+					st->never = TRUE;
+				stage_set_bit(st->value, index);
+				stage_set_bit(st->care, index);
+				break;
+			case SR_TRIGGER_ZERO:
+				if (stage_test_bit(st->value, index))
+					st->never = TRUE;
+				stage_set_bit(st->care, index);
+				break;
+			case SR_TRIGGER_RISING:
+				stage_set_bit(st->rising, index);
+				st->has_edges = TRUE;
+				break;
+			case SR_TRIGGER_FALLING:
+				stage_set_bit(st->falling, index);
+				st->has_edges = TRUE;
+				break;
+			case SR_TRIGGER_EDGE:
+				stage_set_bit(st->edge, index);
+				st->has_edges = TRUE;
+				break;
+			}
+		}
+	}
+}
+
+/* Allocate a pre-trigger ring of size bytes. */
+static gboolean ring_init(struct soft_trigger_ring *ring, int size)
+{
+	ring->size = MAX(size, 0);
+	ring->fill = 0;
+	ring->buffer = sr_buffer_alloc(SR_MEM_TRIGGER, ring->size);
+	ring->head = ring->buffer;
+
+	/* Size 0 returns NULL, which is fine for no pre-trigger. */
+	return ring->size == 0 || ring->buffer;
+}
+
+static void ring_free(struct soft_trigger_ring *ring)
+{
+	sr_buffer_free(ring->buffer);
+	ring->buffer = ring->head = NULL;
+}
 
-	for (l = channels; l; l = l->next) {
-		channel = l->data;
-		if (channel->type == SR_CHANNEL_LOGIC)
-			number++;
+static void ring_append(struct soft_trigger_ring *ring,
+		const uint8_t *buf, int len)
+{
+	int size;
+
+	/* Avoid uselessly copying more than the pre-trigger size. */
+	if (len > ring->size) {
+		buf += len - ring->size;
+		len = ring->size;
+	}
+
+	/* Update the filling level of the pre-trigger circular buffer. */
+	ring->fill = MIN(ring->fill + len, ring->size);
+
+	/* Actually copy data to the pre-trigger circular buffer. */
+	while (len > 0) {
+		size = MIN(ring->buffer + ring->size - ring->head, len);
+		memcpy(ring->head, buf, size);
+		ring->head += size;
+		if (ring->head >= ring->buffer + ring->size)
+			ring->head = ring->buffer;
+		buf += size;
+		len -= size;
+	}
+}
+
+/*
+ * Get (at most) the newest keep bytes of a ring, as up to two segments
+ * from old to new, and empty the ring. The segments stay valid until
+ * the next append. Returns the number of segments.
+ */
+static int ring_take(struct soft_trigger_ring *ring, int keep,
+		uint8_t **data, int *length)
+{
+	uint8_t *start, *end;
+	int num;
+
+	keep = MIN(ring->fill, MAX(keep, 0));
+
+	/* The oldest valid byte is at head once the buffer is full. */
+	end = ring->buffer + ring->size;
+	start = (ring->fill < ring->size) ? ring->buffer : ring->head;
+	start += ring->fill - keep;
+	if (start >= end)
+		start -= ring->size;
+
+	num = 0;
+	while (keep > 0) {
+		length[num] = MIN(end - start, keep);
+		data[num] = start;
+		keep -= length[num];
+		num++;
+		start = ring->buffer;
 	}
+	ring->head = ring->buffer;
+	ring->fill = 0;
 
-	return (number + 7) / 8;
+	return num;
 }
 
 SR_PRIV struct soft_trigger_logic *soft_trigger_logic_new(
@@ -50,22 +202,9 @@ SR_PRIV struct soft_trigger_logic *soft_trigger_logic_new(
 	stl = g_malloc0(sizeof(struct soft_trigger_logic));
 	stl->sdi = sdi;
 	stl->trigger = trigger;
-	stl->unitsize = logic_channel_unitsize(sdi->channels);
-	stl->prev_sample = g_malloc0(stl->unitsize);
-	stl->pre_trigger_size = stl->unitsize * pre_trigger_samples;
-	stl->pre_trigger_buffer = g_try_malloc(stl->pre_trigger_size);
-	if (pre_trigger_samples > 0 && !stl->pre_trigger_buffer) {
-		/*
-		 * Error out if g_try_malloc() failed (or was invoked as
-		 * g_try_malloc(0)) *and* more than 0 pretrigger samples
-		 * were requested.
-		 */
-		soft_trigger_logic_free(stl);
-		return NULL;
-	}
-	stl->pre_trigger_head = stl->pre_trigger_buffer;
-
-	if (stl->pre_trigger_size > 0 && !stl->pre_trigger_buffer) {
+	stl->unitsize = (sr_dev_channel_cache_get(sdi)->num_logic + 7) / 8;
+	stages_compile(stl);
+	if (!ring_init(&stl->pre_trigger, stl->unitsize * pre_trigger_samples)) {
 		soft_trigger_logic_free(stl);
 		return NULL;
 	}
@@ -75,148 +214,302 @@ SR_PRIV struct soft_trigger_logic *soft_trigger_logic_new(
 
 SR_PRIV void soft_trigger_logic_free(struct soft_trigger_logic *stl)
 {
-	g_free(stl->pre_trigger_buffer);
-	g_free(stl->prev_sample);
+	int i;
+
+	for (i = 0; i < stl->num_stages; i++)
+		g_free(stl->stages[i].masks);
+	g_free(stl->stages);
+	g_free(stl->prev_words);
+	g_free(stl->cur_words);
+	ring_free(&stl->pre_trigger);
 	g_free(stl);
 }
 
-static void pre_trigger_append(struct soft_trigger_logic *stl,
-		uint8_t *buf, int len)
+/*
+ * Send the pre-trigger samples: the newest part of the circular buffer,
+ * which takes at most two packets, followed by the samples of the
+ * current buffer up to the trigger point. Those are sent from where
+ * they are, instead of being appended to the circular buffer first.
+ */
+static void pre_trigger_send(struct soft_trigger_logic *stl,
+		uint8_t *buf, int len, int *pre_trigger_samples)
 {
-	/* Avoid uselessly copying more than the pre-trigger size. */
-	if (len > stl->pre_trigger_size) {
-		buf += len - stl->pre_trigger_size;
-		len = stl->pre_trigger_size;
-	}
+	struct sr_datafeed_packet packets[3];
+	struct sr_datafeed_logic logic[3];
+	uint8_t *data[2];
+	int length[2];
+	size_t num_packets;
+	int i;
 
-	/* Update the filling level of the pre-trigger circular buffer. */
-	stl->pre_trigger_fill = MIN(stl->pre_trigger_fill + len,
-	                            stl->pre_trigger_size);
+	if (pre_trigger_samples)
+		*pre_trigger_samples = 0;
 
-	/* Actually copy data to the pre-trigger circular buffer. */
-	while (len > 0) {
-		size_t size = MIN(stl->pre_trigger_buffer + stl->pre_trigger_size
-		                  - stl->pre_trigger_head, len);
-		memcpy(stl->pre_trigger_head, buf, size);
-		stl->pre_trigger_head += size;
-		if (stl->pre_trigger_head >= stl->pre_trigger_buffer
-		                             + stl->pre_trigger_size)
-			stl->pre_trigger_head = stl->pre_trigger_buffer;
-		buf += size;
-		len -= size;
+	/* Only the newest pre-trigger size bytes are needed in total. */
+	if (len > stl->pre_trigger.size) {
+		buf += len - stl->pre_trigger.size;
+		len = stl->pre_trigger.size;
+	}
+	num_packets = ring_take(&stl->pre_trigger,
+		stl->pre_trigger.size - len, data, length);
+	for (i = 0; i < (int)num_packets; i++) {
+		logic[i].length = length[i];
+		logic[i].data = data[i];
 	}
+	if (len > 0) {
+		logic[num_packets].length = len;
+		logic[num_packets].data = buf;
+		num_packets++;
+	}
+
+	for (i = 0; i < (int)num_packets; i++) {
+		packets[i].type = SR_DF_LOGIC;
+		packets[i].payload = &logic[i];
+		logic[i].unitsize = stl->unitsize;
+		if (pre_trigger_samples)
+			*pre_trigger_samples += logic[i].length / stl->unitsize;
+	}
+	if (num_packets)
+		sr_session_send_batch(stl->sdi, packets, num_packets);
 }
 
-static void pre_trigger_send(struct soft_trigger_logic *stl,
-		int *pre_trigger_samples)
+/* Check one word of a sample, given the same word of the previous one. */
+static inline gboolean word_matches(const struct soft_trigger_stage *st,
+		int w, uint64_t cur, uint64_t prev)
 {
-	struct sr_datafeed_packet packet;
-	struct sr_datafeed_logic logic;
+	if ((cur ^ st->value[w]) & st->care[w])
+		return FALSE;
+	if (st->rising[w] & (prev | ~cur))
+		return FALSE;
+	if (st->falling[w] & (~prev | cur))
+		return FALSE;
+	if (st->edge[w] & ~(prev ^ cur))
+		return FALSE;
 
-	packet.type = SR_DF_LOGIC;
-	packet.payload = &logic;
-	logic.unitsize = stl->unitsize;
+	return TRUE;
+}
 
-	if (pre_trigger_samples)
-		*pre_trigger_samples = 0;
+static inline uint64_t sample_word(const uint8_t *sample, int size)
+{
+	uint64_t w;
 
-	/* If pre-trigger buffer not full, rewind head to the first valid sample. */
-	if (stl->pre_trigger_fill < stl->pre_trigger_size)
-		stl->pre_trigger_head = stl->pre_trigger_buffer;
-
-	/* Send logic packets for the pre-trigger circular buffer content. */
-	while (stl->pre_trigger_fill > 0) {
-		size_t size = MIN(stl->pre_trigger_buffer + stl->pre_trigger_size
-		                  - stl->pre_trigger_head, stl->pre_trigger_fill);
-		logic.length = size;
-		logic.data = stl->pre_trigger_head;
-		sr_session_send(stl->sdi, &packet);
-		stl->pre_trigger_head = stl->pre_trigger_buffer;
-		stl->pre_trigger_fill -= size;
-		if (pre_trigger_samples)
-			*pre_trigger_samples += size / stl->unitsize;
+	w = 0;
+	switch (size) {
+	case 1:
+		memcpy(&w, sample, 1);
+		break;
+	case 2:
+		memcpy(&w, sample, 2);
+		break;
+	case 4:
+		memcpy(&w, sample, 4);
+		break;
+	case 8:
+		memcpy(&w, sample, 8);
+		break;
+	default:
+		memcpy(&w, sample, size);
+		break;
 	}
+
+	return w;
 }
 
-static gboolean logic_check_match(struct soft_trigger_logic *stl,
-		uint8_t *sample, struct sr_trigger_match *match)
+static void sample_load(struct soft_trigger_logic *stl,
+		const uint8_t *sample, uint64_t *words)
 {
-	int bit, prev_bit;
-	gboolean result;
+	int w;
 
-	stl->count++;
-	result = FALSE;
-	bit = *(sample + match->channel->index / 8)
-			& (1 << (match->channel->index % 8));
-	if (match->match == SR_TRIGGER_ZERO)
-		result = bit == 0;
-	else if (match->match == SR_TRIGGER_ONE)
-		result = bit != 0;
-	else {
-		/* Edge matches. */
-		if (stl->count == 1)
-			/* First sample, don't have enough for an edge match yet. */
+	for (w = 0; w < stl->num_words; w++)
+		words[w] = sample_word(sample + w * 8,
+			MIN(8, stl->unitsize - w * 8));
+}
+
+static gboolean stage_matches(const struct soft_trigger_logic *stl,
+		const struct soft_trigger_stage *st, const uint64_t *cur)
+{
+	int w;
+
+	if (st->never)
+		return FALSE;
+	/* First sample, don't have enough for an edge match yet. */
+	if (st->has_edges && !stl->have_prev)
+		return FALSE;
+
+	for (w = 0; w < stl->num_words; w++) {
+		if (!word_matches(st, w, cur[w], stl->prev_words[w]))
 			return FALSE;
-		prev_bit = *(stl->prev_sample + match->channel->index / 8)
-				& (1 << (match->channel->index % 8));
-		if (match->match == SR_TRIGGER_RISING)
-			result = prev_bit == 0 && bit != 0;
-		else if (match->match == SR_TRIGGER_FALLING)
-			result = prev_bit != 0 && bit == 0;
-		else if (match->match == SR_TRIGGER_EDGE)
-			result = prev_bit != bit;
 	}
 
-	return result;
+	return TRUE;
 }
 
-/* Returns the offset (in samples) within buf of where the trigger
- * occurred, or -1 if not triggered. */
-SR_PRIV int soft_trigger_logic_check(struct soft_trigger_logic *stl,
-		uint8_t *buf, int len, int *pre_trigger_samples)
+/*
+ * Helpers to check several samples packed into one word at once. Each
+ * sample takes a lane of bits. A sample's lane value is its word as
+ * from sample_word(), moved to the low bits when needed. The previous
+ * sample of every lane is the neighbouring lane in memory order.
+ */
+#if G_BYTE_ORDER == G_LITTLE_ENDIAN
+#define LANE_VALUE(word, bits)	((word) & (~UINT64_C(0) >> (64 - (bits))))
+#define LANES_PREV(words, last, bits) \
+	(((words) << (bits)) | (last))
+#else
+#define LANE_VALUE(word, bits)	((word) >> (64 - (bits)))
+#define LANES_PREV(words, last, bits) \
+	(((words) >> (bits)) | ((last) << (64 - (bits))))
+#endif
+
+/* Copies of a stage's masks in every lane. */
+struct stage_lanes {
+	int bits;
+	uint64_t ones, high;
+	uint64_t value, care, rising, falling, edge;
+};
+
+static void stage_lanes_init(struct stage_lanes *sl,
+		const struct soft_trigger_stage *st, int unitsize)
 {
-	struct sr_trigger_stage *stage;
-	struct sr_trigger_match *match;
-	GSList *l, *l_stage;
-	int offset;
+	sl->bits = unitsize * 8;
+	sl->ones = ~UINT64_C(0) / (~UINT64_C(0) >> (64 - sl->bits));
+	sl->high = sl->ones << (sl->bits - 1);
+	sl->value = LANE_VALUE(st->value[0], sl->bits) * sl->ones;
+	sl->care = LANE_VALUE(st->care[0], sl->bits) * sl->ones;
+	sl->rising = LANE_VALUE(st->rising[0], sl->bits) * sl->ones;
+	sl->falling = LANE_VALUE(st->falling[0], sl->bits) * sl->ones;
+	sl->edge = LANE_VALUE(st->edge[0], sl->bits) * sl->ones;
+}
+
+/* Tell whether any of the samples in cur is a candidate for a match. */
+static inline gboolean lanes_candidate(const struct stage_lanes *sl,
+		uint64_t cur, uint64_t prev)
+{
+	uint64_t mismatch;
+
+	mismatch = (cur ^ sl->value) & sl->care;
+	mismatch |= sl->rising & (prev | ~cur);
+	mismatch |= sl->falling & (~prev | cur);
+	mismatch |= sl->edge & ~(prev ^ cur);
+
+	/* Is any lane all zero, i.e. has a sample no mismatching bit? */
+	return ((mismatch - sl->ones) & ~mismatch & sl->high) != 0;
+}
+
+/*
+ * Skip over the samples which don't match a stage of single word
+ * samples. This is where the time goes while waiting for the trigger.
+ * Samples of 1, 2 or 4 bytes first get checked a vector at a time by
+ * sr_simd_find_candidate(), where it has vector instructions, then a
+ * word of samples at a time. Only candidate words are checked sample
+ * by sample. Returns the offset of the first matching sample (or len),
+ * and leaves the sample before it in prev_words.
+ */
+static int stage_scan(struct soft_trigger_logic *stl,
+		const struct soft_trigger_stage *st, const uint8_t *buf,
+		int i, int len)
+{
+	struct stage_lanes sl;
+	struct sr_simd_pattern pat;
+	uint64_t cur, prev, words;
+	gboolean have_prev, use_lanes, vector_done;
+	int unitsize, single_end;
+	size_t skip;
+
+	unitsize = stl->unitsize;
+	prev = stl->prev_words[0];
+	have_prev = stl->have_prev;
+	use_lanes = unitsize == 1 || unitsize == 2 || unitsize == 4;
+	stage_lanes_init(&sl, st, unitsize);
+	pat.unitsize = unitsize;
+	pat.value = st->value[0];
+	pat.care = st->care[0];
+	pat.rising = st->rising[0];
+	pat.falling = st->falling[0];
+	pat.edge = st->edge[0];
+	single_end = i;
+	for (; i < len; i += unitsize) {
+		if (use_lanes && i >= single_end && (have_prev || !st->has_edges)) {
+			vector_done = FALSE;
+			while (i + 8 <= len) {
+				/*
+				 * The vectors take the previous sample from
+				 * buf, which it isn't after a restart.
+				 */
+				if (!vector_done && i >= unitsize &&
+						(!st->has_edges || prev == sample_word(
+						buf + i - unitsize, unitsize))) {
+					vector_done = TRUE;
+					skip = sr_simd_find_candidate(&pat,
+						buf + i, len - i);
+					if (skip) {
+						i += skip;
+						prev = sample_word(buf + i - unitsize,
+							unitsize);
+						have_prev = TRUE;
+						continue;
+					}
+				}
+				memcpy(&words, buf + i, sizeof(words));
+				if (lanes_candidate(&sl, words, LANES_PREV(words,
+						LANE_VALUE(prev, sl.bits), sl.bits)))
+					break;
+				prev = sample_word(buf + i + 8 - unitsize, unitsize);
+				have_prev = TRUE;
+				i += 8;
+			}
+			/* Check the candidate word's samples one by one. */
+			single_end = i + 8;
+			if (i >= len)
+				break;
+		}
+		cur = sample_word(buf + i, unitsize);
+		if ((have_prev || !st->has_edges)
+				&& word_matches(st, 0, cur, prev))
+			break;
+		prev = cur;
+		have_prev = TRUE;
+	}
+	stl->prev_words[0] = prev;
+	stl->have_prev = have_prev;
+
+	return i;
+}
+
+/*
+ * Run the stages over the samples of buf. Returns the offset in bytes
+ * of the sample which matched the last stage, -1 if none did, or
+ * SR_ERR_ARG. The state is kept for the next call.
+ */
+static int stages_run(struct soft_trigger_logic *stl,
+		const uint8_t *buf, int len)
+{
+	struct soft_trigger_stage *stage;
 	int i;
 	gboolean match_found;
 
-	offset = -1;
 	for (i = 0; i < len; i += stl->unitsize) {
-		l_stage = g_slist_nth(stl->trigger->stages, stl->cur_stage);
-		stage = l_stage->data;
-		if (!stage->matches)
+		stage = &stl->stages[stl->cur_stage];
+		if (stage->empty)
 			/* No matches supplied, client error. */
 			return SR_ERR_ARG;
 
-		match_found = TRUE;
-		for (l = stage->matches; l; l = l->next) {
-			match = l->data;
-			if (!match->channel->enabled)
-				/* Ignore disabled channels with a trigger. */
-				continue;
-			if (!logic_check_match(stl, buf + i, match)) {
-				match_found = FALSE;
+		if (stl->cur_stage == 0 && stl->num_words == 1 && !stage->never) {
+			i = stage_scan(stl, stage, buf, i, len);
+			if (i >= len)
 				break;
-			}
 		}
-		memcpy(stl->prev_sample, buf + i, stl->unitsize);
+
+		sample_load(stl, buf + i, stl->cur_words);
+		match_found = stage_matches(stl, stage, stl->cur_words);
+		memcpy(stl->prev_words, stl->cur_words,
+			stl->num_words * sizeof(uint64_t));
+		stl->have_prev = TRUE;
 		if (match_found) {
 			/* Matched on the current stage. */
-			if (l_stage->next) {
+			if (stl->cur_stage + 1 < stl->num_stages) {
 				/* Advance to next stage. */
 				stl->cur_stage++;
 			} else {
-				/* Matched on last stage, send pre-trigger data. */
-				pre_trigger_append(stl, buf, i);
-				pre_trigger_send(stl, pre_trigger_samples);
-
-				/* Fire trigger. */
-				offset = i / stl->unitsize;
-
-				std_session_send_df_trigger(stl->sdi);
-				break;
+				return i;
 			}
 		} else if (stl->cur_stage > 0) {
 			/*
@@ -229,15 +522,438 @@ SR_PRIV int soft_trigger_logic_check(struct soft_trigger_logic *stl,
 			 * takes care of.
 			 */
 			i -= stl->cur_stage * stl->unitsize;
-			if (i < -1)
-				i = -1; /* Oops, went back past this buffer. */
+			if (i < -stl->unitsize)
+				i = -stl->unitsize; /* Oops, went back past this buffer. */
 			/* Reset trigger stage. */
 			stl->cur_stage = 0;
 		}
 	}
 
+	return -1;
+}
+
+/* Returns the offset (in samples) within buf of where the trigger
+ * occurred, or -1 if not triggered. */
+SR_PRIV int soft_trigger_logic_check(struct soft_trigger_logic *stl,
+		uint8_t *buf, int len, int *pre_trigger_samples)
+{
+	int i;
+
+	i = stages_run(stl, buf, len);
+	if (i == SR_ERR_ARG)
+		return i;
+	if (i < 0) {
+		ring_append(&stl->pre_trigger, buf, len);
+		return -1;
+	}
+
+	/* Matched on last stage, send pre-trigger data. */
+	pre_trigger_send(stl, buf, i, pre_trigger_samples);
+
+	/* Fire trigger. */
+	std_session_send_df_trigger(stl->sdi);
+
+	return i / stl->unitsize;
+}
+
+/*
+ * Like soft_trigger_logic_check(), but only looks for a match, without
+ * sending anything. A match starts over at the first stage, call again
+ * with the samples after it to find the next one.
+ */
+SR_PRIV int soft_trigger_logic_find(struct soft_trigger_logic *stl,
+		const uint8_t *buf, int len)
+{
+	int i;
+
+	i = stages_run(stl, buf, len);
+	if (i < 0)
+		return i;
+	stl->cur_stage = 0;
+
+	return i / stl->unitsize;
+}
+
+/*
+ * Compile the analog trigger stages. A stage compares the values of
+ * one channel, matches on other channels are not supported.
+ */
+static void analog_stages_compile(struct soft_trigger_analog *sta)
+{
+	struct soft_trigger_analog_stage *st;
+	struct soft_trigger_analog_match *am;
+	struct sr_trigger_stage *stage;
+	struct sr_trigger_match *match;
+	const struct sr_channel *ch;
+	GSList *l, *m;
+
+	sta->num_stages = g_slist_length(sta->trigger->stages);
+	sta->stages = g_malloc0_n(sta->num_stages, sizeof(*sta->stages));
+
+	st = sta->stages;
+	for (l = sta->trigger->stages; l; l = l->next, st++) {
+		stage = l->data;
+		st->matches = g_malloc0_n(g_slist_length(stage->matches),
+			sizeof(*st->matches));
+		for (m = stage->matches; m; m = m->next) {
+			match = m->data;
+			ch = match->channel;
+			if (!ch->enabled || ch->type != SR_CHANNEL_ANALOG)
+				continue;
+			if (st->ch && ch != st->ch) {
+				sr_err("Stage %d: ignoring match on %s, a stage "
+					"can only match on one analog channel.",
+					stage->stage, ch->name);
+				continue;
+			}
+			st->ch = ch;
+			am = &st->matches[st->num_matches++];
+			am->match = match->match;
+			am->level = match->value;
+		}
+	}
+}
+
+SR_PRIV struct soft_trigger_analog *soft_trigger_analog_new(
+		const struct sr_dev_inst *sdi, struct sr_trigger *trigger,
+		int pre_trigger_samples, float hysteresis)
+{
+	struct soft_trigger_analog *sta;
+	struct soft_trigger_analog_channel *chan;
+	struct sr_channel *ch;
+	GSList *l;
+
+	sta = g_malloc0(sizeof(struct soft_trigger_analog));
+	sta->sdi = sdi;
+	sta->trigger = trigger;
+	sta->hysteresis = fabsf(hysteresis);
+	analog_stages_compile(sta);
+
+	for (l = sdi->channels; l; l = l->next) {
+		ch = l->data;
+		if (ch->enabled && ch->type == SR_CHANNEL_ANALOG)
+			sta->num_channels++;
+	}
+	sta->channels = g_malloc0_n(sta->num_channels, sizeof(*sta->channels));
+	chan = sta->channels;
+	for (l = sdi->channels; l; l = l->next) {
+		ch = l->data;
+		if (!ch->enabled || ch->type != SR_CHANNEL_ANALOG)
+			continue;
+		chan->ch = ch;
+		if (!ring_init(&chan->pre_trigger,
+				pre_trigger_samples * sizeof(float))) {
+			soft_trigger_analog_free(sta);
+			return NULL;
+		}
+		chan++;
+	}
+
+	return sta;
+}
+
+SR_PRIV void soft_trigger_analog_free(struct soft_trigger_analog *sta)
+{
+	int i;
+
+	for (i = 0; i < sta->num_stages; i++)
+		g_free(sta->stages[i].matches);
+	g_free(sta->stages);
+	for (i = 0; i < sta->num_channels; i++)
+		ring_free(&sta->channels[i].pre_trigger);
+	g_free(sta->channels);
+	g_free(sta->values);
+	g_free(sta);
+}
+
+static struct soft_trigger_analog_channel *analog_channel_find(
+		struct soft_trigger_analog *sta, const struct sr_channel *ch)
+{
+	int i;
+
+	for (i = 0; i < sta->num_channels; i++) {
+		if (sta->channels[i].ch == ch)
+			return &sta->channels[i];
+	}
+
+	return NULL;
+}
+
+/*
+ * Check one value against a match. Slope matches are armed once the
+ * value has been beyond the hysteresis band on the far side of the
+ * level, which keeps noise around the level from firing them.
+ */
+static gboolean analog_match_step(const struct soft_trigger_analog *sta,
+		struct soft_trigger_analog_match *am, float v)
+{
+	gboolean result;
+
+	switch (am->match) {
+	case SR_TRIGGER_OVER:
+		return v > am->level;
+	case SR_TRIGGER_UNDER:
+		return v < am->level;
+	}
+
+	result = FALSE;
+	if (am->match != SR_TRIGGER_FALLING && am->armed_low && v > am->level)
+		result = TRUE;
+	if (am->match != SR_TRIGGER_RISING && am->armed_high && v < am->level)
+		result = TRUE;
+
+	/* Crossing the level uses up the arming on the other side. */
+	if (v > am->level)
+		am->armed_low = FALSE;
+	if (v < am->level)
+		am->armed_high = FALSE;
+	if (v < am->level - sta->hysteresis)
+		am->armed_low = TRUE;
+	if (v > am->level + sta->hysteresis)
+		am->armed_high = TRUE;
+
+	return result;
+}
+
+/*
+ * Find the first value matching a single match stage. Level and slope
+ * matches come down to searching for a value outside of a range,
+ * which is done on whole vectors of values at a time.
+ */
+static int analog_match_find(const struct soft_trigger_analog *sta,
+		struct soft_trigger_analog_match *am, const float *values,
+		int i, int count)
+{
+	float level, hyst;
+
+	level = am->level;
+	hyst = sta->hysteresis;
+	switch (am->match) {
+	case SR_TRIGGER_OVER:
+		return i + sr_simd_find_outside(values + i, count - i,
+			-INFINITY, level);
+	case SR_TRIGGER_UNDER:
+		return i + sr_simd_find_outside(values + i, count - i,
+			level, INFINITY);
+	case SR_TRIGGER_RISING:
+		while (i < count) {
+			if (!am->armed_low) {
+				/* Wait for a value below the band. */
+				i += sr_simd_find_outside(values + i,
+					count - i, level - hyst, INFINITY);
+				if (i < count)
+					am->armed_low = TRUE;
+				i++;
+				continue;
+			}
+			i += sr_simd_find_outside(values + i, count - i,
+				-INFINITY, level);
+			if (i < count) {
+				am->armed_low = FALSE;
+				return i;
+			}
+		}
+		return count;
+	case SR_TRIGGER_FALLING:
+		while (i < count) {
+			if (!am->armed_high) {
+				/* Wait for a value above the band. */
+				i += sr_simd_find_outside(values + i,
+					count - i, -INFINITY, level + hyst);
+				if (i < count)
+					am->armed_high = TRUE;
+				i++;
+				continue;
+			}
+			i += sr_simd_find_outside(values + i, count - i,
+				level, INFINITY);
+			if (i < count) {
+				am->armed_high = FALSE;
+				return i;
+			}
+		}
+		return count;
+	}
+
+	for (; i < count; i++) {
+		if (analog_match_step(sta, am, values[i]))
+			break;
+	}
+
+	return i;
+}
+
+/* Returns the index of the first value matching all of a stage. */
+static int analog_stage_find(const struct soft_trigger_analog *sta,
+		struct soft_trigger_analog_stage *st, const float *values,
+		int i, int count)
+{
+	gboolean match_found;
+	int m;
+
+	if (st->num_matches == 1)
+		return analog_match_find(sta, &st->matches[0], values, i, count);
+
+	for (; i < count; i++) {
+		/* Step all matches, to keep the slope states up to date. */
+		match_found = TRUE;
+		for (m = 0; m < st->num_matches; m++) {
+			if (!analog_match_step(sta, &st->matches[m], values[i]))
+				match_found = FALSE;
+		}
+		if (match_found)
+			break;
+	}
+
+	return i;
+}
+
+/*
+ * Send the pre-trigger values of all channels: the circular buffer of
+ * each channel, and for the triggering channel also the values of the
+ * current packet up to the trigger point.
+ */
+static void analog_pre_trigger_send(struct soft_trigger_analog *sta,
+		struct soft_trigger_analog_channel *trig, float *values,
+		int count, int *pre_trigger_samples)
+{
+	struct soft_trigger_analog_channel *chan;
+	struct sr_datafeed_packet *packets;
+	struct sr_datafeed_analog *analogs;
+	struct sr_analog_encoding *encodings;
+	struct sr_analog_meaning *meanings;
+	struct sr_analog_spec *specs;
+	uint8_t *data[3];
+	int length[3];
+	int max_packets, num_packets, num, keep, i, j, k;
+
+	if (pre_trigger_samples)
+		*pre_trigger_samples = 0;
+
+	max_packets = 3 * sta->num_channels;
+	packets = g_malloc_n(max_packets, sizeof(*packets));
+	analogs = g_malloc_n(max_packets, sizeof(*analogs));
+	encodings = g_malloc_n(max_packets, sizeof(*encodings));
+	meanings = g_malloc_n(max_packets, sizeof(*meanings));
+	specs = g_malloc_n(max_packets, sizeof(*specs));
+
+	num_packets = 0;
+	for (i = 0; i < sta->num_channels; i++) {
+		chan = &sta->channels[i];
+		keep = chan->pre_trigger.size;
+		if (chan == trig) {
+			/* Only the newest pre-trigger size values are needed. */
+			if (count * (int)sizeof(float) > keep) {
+				values += count - keep / sizeof(float);
+				count = keep / sizeof(float);
+			}
+			keep -= count * sizeof(float);
+		}
+		num = ring_take(&chan->pre_trigger, keep, data, length);
+		if (chan == trig && count > 0) {
+			data[num] = (uint8_t *)values;
+			length[num] = count * sizeof(float);
+			num++;
+		}
+		for (j = 0; j < num; j++) {
+			k = num_packets++;
+			sr_analog_init(&analogs[k], &encodings[k], &meanings[k],
+				&specs[k], chan->digits);
+			meanings[k].mq = chan->mq;
+			meanings[k].mqflags = chan->mqflags;
+			meanings[k].unit = chan->unit;
+			meanings[k].channels = g_slist_append(NULL, chan->ch);
+			analogs[k].num_samples = length[j] / sizeof(float);
+			analogs[k].data = data[j];
+			packets[k].type = SR_DF_ANALOG;
+			packets[k].payload = &analogs[k];
+			if (chan == trig && pre_trigger_samples)
+				*pre_trigger_samples += analogs[k].num_samples;
+		}
+	}
+	if (num_packets)
+		sr_session_send_batch(sta->sdi, packets, num_packets);
+
+	for (k = 0; k < num_packets; k++)
+		g_slist_free(meanings[k].channels);
+	g_free(packets);
+	g_free(analogs);
+	g_free(encodings);
+	g_free(meanings);
+	g_free(specs);
+}
+
+/*
+ * Check a packet of one analog channel. Returns the offset (in samples)
+ * within the packet of where the trigger occurred, or -1 if not
+ * triggered.
+ */
+SR_PRIV int soft_trigger_analog_check(struct soft_trigger_analog *sta,
+		const struct sr_datafeed_analog *analog, int *pre_trigger_samples)
+{
+	struct soft_trigger_analog_stage *stage;
+	struct soft_trigger_analog_channel *chan;
+	const struct sr_channel *ch;
+	int offset, count, i;
+
+	if (!analog->meaning->channels || analog->meaning->channels->next) {
+		sr_err("Analog trigger needs single channel packets.");
+		return SR_ERR_ARG;
+	}
+	ch = analog->meaning->channels->data;
+	if (!(chan = analog_channel_find(sta, ch)))
+		return -1;
+
+	count = analog->num_samples;
+	if (sta->values_size < analog->num_samples) {
+		g_free(sta->values);
+		sta->values = g_malloc_n(analog->num_samples, sizeof(float));
+		sta->values_size = analog->num_samples;
+	}
+	if (sr_analog_to_float_prepared(analog, sta->values) != SR_OK)
+		return SR_ERR_DATA;
+
+	/* Remember what the values mean, for sending them later. */
+	chan->mq = analog->meaning->mq;
+	chan->mqflags = analog->meaning->mqflags;
+	chan->unit = analog->meaning->unit;
+	chan->digits = analog->encoding->digits;
+
+	offset = -1;
+	i = 0;
+	while (i < count) {
+		stage = &sta->stages[sta->cur_stage];
+		if (!stage->num_matches)
+			/* No matches supplied, client error. */
+			return SR_ERR_ARG;
+		/* Values of other channels go to the pre-trigger buffer. */
+		if (stage->ch != ch)
+			break;
+
+		i = analog_stage_find(sta, stage, sta->values, i, count);
+		if (i >= count)
+			break;
+
+		if (sta->cur_stage + 1 < sta->num_stages) {
+			/* Advance to next stage, with the next value. */
+			sta->cur_stage++;
+			i++;
+			continue;
+		}
+
+		/* Matched on last stage, send pre-trigger data. */
+		analog_pre_trigger_send(sta, chan, sta->values, i,
+			pre_trigger_samples);
+
+		/* Fire trigger. */
+		offset = i;
+		std_session_send_df_trigger(sta->sdi);
+		break;
+	}
+
 	if (offset == -1)
-		pre_trigger_append(stl, buf, len);
+		ring_append(&chan->pre_trigger, (uint8_t *)sta->values,
+			count * sizeof(float));
 
 	return offset;
 }
@@ -0,0 +1,78 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBSIGROK_SRNET_H
+#define LIBSIGROK_SRNET_H
+
+/*
+ * The srnet packet stream, as written by the srnet output module and
+ * read by the srnet input module. All integers are little endian.
+ *
+ * The stream starts with SRNET_MAGIC, followed by frames. A frame is
+ * an 8 byte header (u8 type, three zero bytes, u32 payload length) and
+ * its payload, one datafeed packet per frame:
+ *
+ *   HEADER       u32 feed version, i64 seconds, u32 microseconds,
+ *                u32 number of channels, and per channel u32 index,
+ *                u32 type, u8 enabled, u16 name length, name
+ *   META         u32 number of items, and per item u32 key, u16 type
+ *                string length, GVariant type string, u32 data length,
+ *                little endian GVariant data
+ *   LOGIC        u16 unitsize, samples
+ *   FRAME_BEGIN  nothing, or u64 index, u8 has time, f64 time
+ *   ANALOG       u32 samples, u8 unitsize, u8 SRNET_ANALOG_* flags,
+ *                i8 digits, i8 spec digits, r64 scale, r64 offset,
+ *                u32 mq, u32 unit, u64 mqflags, u16 number of
+ *                channels, u32 index per channel, interleaved samples
+ *   LOGIC_EDGES  u64 samples, u16 unitsize, u64 number of edges,
+ *                u64 offset per edge, values
+ *   GAP          u64 sample index, u64 samples, u32 reason
+ *   END, TRIGGER, FRAME_END have no payload.
+ *
+ * An r64 is an i64 numerator and a u64 denominator. A ZLIB frame holds
+ * a batch of further frames, compressed: its payload is the u32 size
+ * of the batch, then the zlib stream. Receivers skip unknown frames.
+ */
+
+#define SRNET_MAGIC "SRNET\0\0\1"
+#define SRNET_MAGIC_LEN 8
+#define SRNET_FRAME_HEADER_LEN 8
+/* Largest payload of a frame, and of the batch in a ZLIB frame. */
+#define SRNET_FRAME_MAX_LEN (64 * 1024 * 1024)
+#define SRNET_DEFAULT_PORT 5560
+
+enum srnet_frame_type {
+	SRNET_HEADER = 1,
+	SRNET_END,
+	SRNET_META,
+	SRNET_TRIGGER,
+	SRNET_LOGIC,
+	SRNET_FRAME_BEGIN,
+	SRNET_FRAME_END,
+	SRNET_ANALOG,
+	SRNET_LOGIC_EDGES,
+	SRNET_GAP,
+	SRNET_ZLIB = 0x80,
+};
+
+/* Flags of ANALOG frames. */
+#define SRNET_ANALOG_SIGNED         (1 << 0)
+#define SRNET_ANALOG_FLOAT          (1 << 1)
+#define SRNET_ANALOG_BIGENDIAN      (1 << 2)
+#define SRNET_ANALOG_DIGITS_DECIMAL (1 << 3)
+
+#endif
@@ -27,6 +27,7 @@
 #define _XOPEN_SOURCE 700
 
 #include <config.h>
+#include <inttypes.h>
 #include <string.h>
 #include <math.h>
 #include <sys/time.h>
@@ -268,6 +269,51 @@ SR_PRIV int std_session_send_df_frame_begin(const struct sr_dev_inst *sdi)
 	return send_df_without_payload(sdi, SR_DF_FRAME_BEGIN);
 }
 
+/**
+ * Standard API helper for sending an SR_DF_FRAME_BEGIN packet for a
+ * segment of a segmented capture.
+ *
+ * @param[in] sdi The device instance to use. Must not be NULL.
+ * @param[in] index The index of the segment, starting at 0.
+ * @param[in] has_time TRUE if the segment's trigger time is known.
+ * @param[in] time The segment's trigger time in seconds, relative to
+ *                 segment 0.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval other Other error.
+ */
+SR_PRIV int std_session_send_df_frame_segment(const struct sr_dev_inst *sdi,
+		uint64_t index, gboolean has_time, double time)
+{
+	const char *prefix;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_frame frame;
+	int ret;
+
+	if (!sdi) {
+		sr_err("%s: Invalid argument.", __func__);
+		return SR_ERR_ARG;
+	}
+
+	prefix = (sdi->driver) ? sdi->driver->name : "unknown";
+
+	frame.index = index;
+	frame.has_time = has_time;
+	frame.time = has_time ? time : 0.0;
+
+	packet.type = SR_DF_FRAME_BEGIN;
+	packet.payload = &frame;
+
+	if ((ret = sr_session_send(sdi, &packet)) < 0) {
+		sr_err("%s: Failed to send SR_DF_FRAME_BEGIN packet: %d.",
+			prefix, ret);
+		return ret;
+	}
+
+	return SR_OK;
+}
+
 /**
  * Standard API helper for sending an SR_DF_FRAME_END packet.
  *
@@ -284,6 +330,60 @@ SR_PRIV int std_session_send_df_frame_end(const struct sr_dev_inst *sdi)
 	return send_df_without_payload(sdi, SR_DF_FRAME_END);
 }
 
+/**
+ * Standard API helper for sending an SR_DF_GAP packet.
+ *
+ * Drivers call this when samples were lost, e.g. upon failed transfers
+ * or overruns of the device's buffer. The gap is placed after the
+ * samples sent so far, and is counted in the device's statistics.
+ *
+ * @param[in] sdi The device instance to use. Must not be NULL.
+ * @param[in] num_samples Number of samples lost, 0 if unknown.
+ * @param[in] reason Cause of the gap.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval other Other error.
+ */
+SR_PRIV int std_session_send_df_gap(const struct sr_dev_inst *sdi,
+		uint64_t num_samples, enum sr_gap_reason reason)
+{
+	const char *prefix;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_gap gap;
+	int ret;
+
+	if (!sdi) {
+		sr_err("%s: Invalid argument.", __func__);
+		return SR_ERR_ARG;
+	}
+
+	prefix = (sdi->driver) ? sdi->driver->name : "unknown";
+
+	if (sdi->logic_sample_index)
+		gap.sample_index = sdi->logic_sample_index;
+	else
+		gap.sample_index = sdi->analog_sample_index;
+	gap.num_samples = num_samples;
+	gap.reason = reason;
+	if (num_samples)
+		sr_warn("%s: Lost %" PRIu64 " samples after sample %" PRIu64 ".",
+			prefix, num_samples, gap.sample_index);
+	else
+		sr_warn("%s: Lost samples after sample %" PRIu64 ".",
+			prefix, gap.sample_index);
+
+	packet.type = SR_DF_GAP;
+	packet.payload = &gap;
+
+	if ((ret = sr_session_send(sdi, &packet)) < 0) {
+		sr_err("%s: Failed to send SR_DF_GAP packet: %d.", prefix, ret);
+		return ret;
+	}
+
+	return SR_OK;
+}
+
 #ifdef HAVE_SERIAL_COMM
 
 /**
@@ -559,22 +659,19 @@ SR_PRIV int std_opts_config_list(uint32_t key, GVariant **data,
 		/* Always return scanopts, regardless of sdi or cg. */
 		if (!scanopts || scanopts == NO_OPTS)
 			return SR_ERR_ARG;
-		*data = g_variant_new_fixed_array(G_VARIANT_TYPE_UINT32,
-			scanopts, scansize, sizeof(uint32_t));
+		*data = std_gvar_array_u32(scanopts, scansize);
 		break;
 	case SR_CONF_DEVICE_OPTIONS:
 		if (!sdi) {
 			/* sdi == NULL: return drvopts. */
 			if (!drvopts || drvopts == NO_OPTS)
 				return SR_ERR_ARG;
-			*data = g_variant_new_fixed_array(G_VARIANT_TYPE_UINT32,
-				drvopts, drvsize, sizeof(uint32_t));
+			*data = std_gvar_array_u32(drvopts, drvsize);
 		} else if (sdi && !cg) {
 			/* sdi != NULL, cg == NULL: return devopts. */
 			if (!devopts || devopts == NO_OPTS)
 				return SR_ERR_ARG;
-			*data = g_variant_new_fixed_array(G_VARIANT_TYPE_UINT32,
-				devopts, devsize, sizeof(uint32_t));
+			*data = std_gvar_array_u32(devopts, devsize);
 		} else {
 			/*
 			 * Note: sdi != NULL, cg != NULL is not handled by
@@ -592,12 +689,193 @@ SR_PRIV int std_opts_config_list(uint32_t key, GVariant **data,
 	return SR_OK;
 }
 
+/*
+ * Cache of the list variants built from drivers' arrays, which frontends
+ * query over and over. Entries are keyed by the array's address and
+ * helper, and keep a copy of the array's contents, so that arrays which
+ * change yield fresh variants. The cached variants are immutable, the
+ * helpers return a new (non-floating) reference to them.
+ */
+
+/** @cond PRIVATE */
+/* Maximum number of cached variants. */
+#define GVAR_CACHE_SIZE 256
+/** @endcond */
+
+enum gvar_cache_kind {
+	GVAR_TUPLE_ARRAY,
+	GVAR_TUPLE_RATIONAL,
+	GVAR_SAMPLERATES,
+	GVAR_SAMPLERATES_STEPS,
+	GVAR_MIN_MAX_STEP_ARRAY,
+	GVAR_ARRAY_I32,
+	GVAR_ARRAY_U32,
+	GVAR_ARRAY_U64,
+	GVAR_ARRAY_STR,
+	GVAR_THRESHOLDS,
+};
+
+struct gvar_cache_entry {
+	struct gvar_cache_entry *next;
+	int kind;
+	/* Copy of the array, its strings for GVAR_ARRAY_STR. */
+	size_t size;
+	void *copy;
+	GVariant *gvar;
+};
+
+static struct {
+	GMutex mutex;
+	/* Array address to a list of entries. */
+	GHashTable *entries;
+	unsigned int count;
+} gvar_cache;
+
+static gboolean gvar_cache_match(const struct gvar_cache_entry *e,
+		const void *array, size_t size)
+{
+	const char * const *strv;
+	char **copy;
+	size_t i;
+
+	if (e->size != size)
+		return FALSE;
+	if (e->kind != GVAR_ARRAY_STR)
+		return !memcmp(e->copy, array, size);
+
+	strv = array;
+	copy = e->copy;
+	for (i = 0; i < size / sizeof(char *); i++) {
+		if (strcmp(strv[i], copy[i]) != 0)
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+static GVariant *gvar_cache_get(int kind, const void *array, size_t size)
+{
+	struct gvar_cache_entry *e;
+	GVariant *gvar;
+
+	gvar = NULL;
+	g_mutex_lock(&gvar_cache.mutex);
+	e = gvar_cache.entries ? g_hash_table_lookup(gvar_cache.entries, array) : NULL;
+	for (; e; e = e->next) {
+		if (e->kind != kind)
+			continue;
+		if (gvar_cache_match(e, array, size))
+			gvar = g_variant_ref(e->gvar);
+		break;
+	}
+	g_mutex_unlock(&gvar_cache.mutex);
+
+	return gvar;
+}
+
+static void gvar_cache_entry_clear(struct gvar_cache_entry *e)
+{
+	if (e->kind == GVAR_ARRAY_STR)
+		g_strfreev(e->copy);
+	else
+		g_free(e->copy);
+	g_variant_unref(e->gvar);
+}
+
+/* Takes the floating reference of gvar, returns a full reference. */
+static GVariant *gvar_cache_put(int kind, const void *array, size_t size,
+		GVariant *gvar)
+{
+	struct gvar_cache_entry *head, *e;
+	const char * const *strv;
+	char **copy;
+	size_t i, n;
+
+	g_variant_ref_sink(gvar);
+
+	g_mutex_lock(&gvar_cache.mutex);
+	if (!gvar_cache.entries)
+		gvar_cache.entries = g_hash_table_new(g_direct_hash, g_direct_equal);
+	head = g_hash_table_lookup(gvar_cache.entries, array);
+	for (e = head; e; e = e->next) {
+		if (e->kind == kind)
+			break;
+	}
+	if (e) {
+		/* The array changed, keep its latest contents only. */
+		gvar_cache_entry_clear(e);
+	} else if (gvar_cache.count < GVAR_CACHE_SIZE) {
+		e = g_malloc0(sizeof(*e));
+		e->kind = kind;
+		e->next = head;
+		g_hash_table_insert(gvar_cache.entries, (gpointer)array, e);
+		gvar_cache.count++;
+	}
+	if (e) {
+		e->size = size;
+		if (kind == GVAR_ARRAY_STR) {
+			strv = array;
+			n = size / sizeof(char *);
+			copy = g_malloc0_n(n + 1, sizeof(char *));
+			for (i = 0; i < n; i++)
+				copy[i] = g_strdup(strv[i]);
+			e->copy = copy;
+		} else {
+			e->copy = g_memdup(array, size);
+		}
+		e->gvar = g_variant_ref(gvar);
+	}
+	g_mutex_unlock(&gvar_cache.mutex);
+
+	return gvar;
+}
+
+static gboolean gvar_cache_free_list(gpointer key, gpointer value,
+		gpointer user_data)
+{
+	struct gvar_cache_entry *e, *next;
+
+	(void)key;
+	(void)user_data;
+
+	for (e = value; e; e = next) {
+		next = e->next;
+		gvar_cache_entry_clear(e);
+		g_free(e);
+	}
+
+	return TRUE;
+}
+
+/**
+ * Release the cached list variants of the std_gvar_*() helpers.
+ *
+ * References held elsewhere stay valid.
+ *
+ * @private
+ */
+SR_PRIV void std_gvar_cache_clear(void)
+{
+	g_mutex_lock(&gvar_cache.mutex);
+	if (gvar_cache.entries) {
+		g_hash_table_foreach_remove(gvar_cache.entries,
+			gvar_cache_free_list, NULL);
+		g_hash_table_destroy(gvar_cache.entries);
+		gvar_cache.entries = NULL;
+	}
+	gvar_cache.count = 0;
+	g_mutex_unlock(&gvar_cache.mutex);
+}
+
 SR_PRIV GVariant *std_gvar_tuple_array(const uint64_t a[][2], unsigned int n)
 {
 	unsigned int i;
-	GVariant *rational[2];
+	GVariant *gvar, *rational[2];
 	GVariantBuilder gvb;
 
+	if ((gvar = gvar_cache_get(GVAR_TUPLE_ARRAY, a, n * sizeof(a[0]))))
+		return gvar;
+
 	g_variant_builder_init(&gvb, G_VARIANT_TYPE_TUPLE);
 
 	for (i = 0; i < n; i++) {
@@ -608,15 +886,19 @@ SR_PRIV GVariant *std_gvar_tuple_array(const uint64_t a[][2], unsigned int n)
 		g_variant_builder_add_value(&gvb, g_variant_new_tuple(rational, 2));
 	}
 
-	return g_variant_builder_end(&gvb);
+	return gvar_cache_put(GVAR_TUPLE_ARRAY, a, n * sizeof(a[0]),
+		g_variant_builder_end(&gvb));
 }
 
 SR_PRIV GVariant *std_gvar_tuple_rational(const struct sr_rational *r, unsigned int n)
 {
 	unsigned int i;
-	GVariant *rational[2];
+	GVariant *gvar, *rational[2];
 	GVariantBuilder gvb;
 
+	if ((gvar = gvar_cache_get(GVAR_TUPLE_RATIONAL, r, n * sizeof(r[0]))))
+		return gvar;
+
 	g_variant_builder_init(&gvb, G_VARIANT_TYPE_TUPLE);
 
 	for (i = 0; i < n; i++) {
@@ -627,30 +909,38 @@ SR_PRIV GVariant *std_gvar_tuple_rational(const struct sr_rational *r, unsigned
 		g_variant_builder_add_value(&gvb, g_variant_new_tuple(rational, 2));
 	}
 
-	return g_variant_builder_end(&gvb);
+	return gvar_cache_put(GVAR_TUPLE_RATIONAL, r, n * sizeof(r[0]),
+		g_variant_builder_end(&gvb));
 }
 
-static GVariant *samplerate_helper(const uint64_t samplerates[], unsigned int n, const char *str)
+static GVariant *samplerate_helper(const uint64_t samplerates[], unsigned int n,
+		const char *str, int kind)
 {
 	GVariant *gvar;
 	GVariantBuilder gvb;
 
+	if ((gvar = gvar_cache_get(kind, samplerates, n * sizeof(uint64_t))))
+		return gvar;
+
 	g_variant_builder_init(&gvb, G_VARIANT_TYPE("a{sv}"));
 	gvar = g_variant_new_fixed_array(G_VARIANT_TYPE("t"), samplerates,
 			n, sizeof(uint64_t));
 	g_variant_builder_add(&gvb, "{sv}", str, gvar);
 
-	return g_variant_builder_end(&gvb);
+	return gvar_cache_put(kind, samplerates, n * sizeof(uint64_t),
+		g_variant_builder_end(&gvb));
 }
 
 SR_PRIV GVariant *std_gvar_samplerates(const uint64_t samplerates[], unsigned int n)
 {
-	return samplerate_helper(samplerates, n, "samplerates");
+	return samplerate_helper(samplerates, n, "samplerates",
+		GVAR_SAMPLERATES);
 }
 
 SR_PRIV GVariant *std_gvar_samplerates_steps(const uint64_t samplerates[], unsigned int n)
 {
-	return samplerate_helper(samplerates, n, "samplerate-steps");
+	return samplerate_helper(samplerates, n, "samplerate-steps",
+		GVAR_SAMPLERATES_STEPS);
 }
 
 SR_PRIV GVariant *std_gvar_min_max_step(double min, double max, double step)
@@ -669,14 +959,19 @@ SR_PRIV GVariant *std_gvar_min_max_step(double min, double max, double step)
 SR_PRIV GVariant *std_gvar_min_max_step_array(const double a[3])
 {
 	unsigned int i;
+	GVariant *gvar;
 	GVariantBuilder gvb;
 
+	if ((gvar = gvar_cache_get(GVAR_MIN_MAX_STEP_ARRAY, a, 3 * sizeof(a[0]))))
+		return gvar;
+
 	g_variant_builder_init(&gvb, G_VARIANT_TYPE_ARRAY);
 
 	for (i = 0; i < 3; i++)
 		g_variant_builder_add_value(&gvb, g_variant_new_double(a[i]));
 
-	return g_variant_builder_end(&gvb);
+	return gvar_cache_put(GVAR_MIN_MAX_STEP_ARRAY, a, 3 * sizeof(a[0]),
+		g_variant_builder_end(&gvb));
 }
 
 SR_PRIV GVariant *std_gvar_min_max_step_thresholds(const double min, const double max, const double step)
@@ -724,22 +1019,34 @@ SR_PRIV GVariant *std_gvar_tuple_double(double low, double high)
 	return g_variant_new_tuple(range, 2);
 }
 
+static GVariant *fixed_array_helper(const GVariantType *type,
+		const void *a, unsigned int n, size_t element_size, int kind)
+{
+	GVariant *gvar;
+
+	if ((gvar = gvar_cache_get(kind, a, n * element_size)))
+		return gvar;
+
+	return gvar_cache_put(kind, a, n * element_size,
+		g_variant_new_fixed_array(type, a, n, element_size));
+}
+
 SR_PRIV GVariant *std_gvar_array_i32(const int32_t a[], unsigned int n)
 {
-	return g_variant_new_fixed_array(G_VARIANT_TYPE_INT32,
-				a, n, sizeof(int32_t));
+	return fixed_array_helper(G_VARIANT_TYPE_INT32,
+				a, n, sizeof(int32_t), GVAR_ARRAY_I32);
 }
 
 SR_PRIV GVariant *std_gvar_array_u32(const uint32_t a[], unsigned int n)
 {
-	return g_variant_new_fixed_array(G_VARIANT_TYPE_UINT32,
-				a, n, sizeof(uint32_t));
+	return fixed_array_helper(G_VARIANT_TYPE_UINT32,
+				a, n, sizeof(uint32_t), GVAR_ARRAY_U32);
 }
 
 SR_PRIV GVariant *std_gvar_array_u64(const uint64_t a[], unsigned int n)
 {
-	return g_variant_new_fixed_array(G_VARIANT_TYPE_UINT64,
-				a, n, sizeof(uint64_t));
+	return fixed_array_helper(G_VARIANT_TYPE_UINT64,
+				a, n, sizeof(uint64_t), GVAR_ARRAY_U64);
 }
 
 SR_PRIV GVariant *std_gvar_array_str(const char *a[], unsigned int n)
@@ -748,6 +1055,9 @@ SR_PRIV GVariant *std_gvar_array_str(const char *a[], unsigned int n)
 	GVariantBuilder *builder;
 	unsigned int i;
 
+	if ((gvar = gvar_cache_get(GVAR_ARRAY_STR, a, n * sizeof(a[0]))))
+		return gvar;
+
 	builder = g_variant_builder_new(G_VARIANT_TYPE ("as"));
 
 	for (i = 0; i < n; i++)
@@ -756,7 +1066,7 @@ SR_PRIV GVariant *std_gvar_array_str(const char *a[], unsigned int n)
 	gvar = g_variant_new("as", builder);
 	g_variant_builder_unref(builder);
 
-	return gvar;
+	return gvar_cache_put(GVAR_ARRAY_STR, a, n * sizeof(a[0]), gvar);
 }
 
 SR_PRIV GVariant *std_gvar_thresholds(const double a[][2], unsigned int n)
@@ -765,6 +1075,9 @@ SR_PRIV GVariant *std_gvar_thresholds(const double a[][2], unsigned int n)
 	GVariant *gvar, *range[2];
 	GVariantBuilder gvb;
 
+	if ((gvar = gvar_cache_get(GVAR_THRESHOLDS, a, n * sizeof(a[0]))))
+		return gvar;
+
 	g_variant_builder_init(&gvb, G_VARIANT_TYPE_ARRAY);
 
 	for (i = 0; i < n; i++) {
@@ -774,7 +1087,8 @@ SR_PRIV GVariant *std_gvar_thresholds(const double a[][2], unsigned int n)
 		g_variant_builder_add_value(&gvb, gvar);
 	}
 
-	return g_variant_builder_end(&gvb);
+	return gvar_cache_put(GVAR_THRESHOLDS, a, n * sizeof(a[0]),
+		g_variant_builder_end(&gvb));
 }
 
 /* Return the index of 'data' in the array 'arr' (or -1). */
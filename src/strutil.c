@@ -294,6 +294,89 @@ SR_PRIV int sr_atof(const char *str, float *ret)
 	return SR_OK;
 }
 
+/*
+ * Convert plain decimal text without going through strtod(). This only
+ * handles numbers whose mantissa and power of ten are exact doubles, so
+ * a single multiplication or division rounds correctly, and the result
+ * matches strtod() to the bit. Returns FALSE for anything else, which
+ * leaves the conversion to the common code.
+ */
+static gboolean atod_fast(const char *str, double *ret)
+{
+	static const double pow10[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+		1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20,
+		1e21, 1e22,
+	};
+	const char *p;
+	uint64_t mant;
+	int exp, exp_val, digits;
+	gboolean neg, exp_neg;
+	double value;
+
+	p = str;
+	while (g_ascii_isspace(*p))
+		p++;
+	neg = *p == '-';
+	if (*p == '-' || *p == '+')
+		p++;
+
+	mant = 0;
+	exp = 0;
+	digits = 0;
+	while (g_ascii_isdigit(*p)) {
+		if (mant > (UINT64_C(1) << 53) / 10)
+			return FALSE;
+		mant = mant * 10 + (*p++ - '0');
+		digits++;
+	}
+	if (*p == '.') {
+		p++;
+		while (g_ascii_isdigit(*p)) {
+			if (mant > (UINT64_C(1) << 53) / 10)
+				return FALSE;
+			mant = mant * 10 + (*p++ - '0');
+			exp--;
+			digits++;
+		}
+	}
+	if (!digits)
+		return FALSE;
+	if (*p == 'e' || *p == 'E') {
+		p++;
+		exp_neg = *p == '-';
+		if (*p == '-' || *p == '+')
+			p++;
+		if (!g_ascii_isdigit(*p))
+			return FALSE;
+		exp_val = 0;
+		while (g_ascii_isdigit(*p)) {
+			if (exp_val > 1000)
+				return FALSE;
+			exp_val = exp_val * 10 + (*p++ - '0');
+		}
+		exp += exp_neg ? -exp_val : exp_val;
+	}
+	if (*p || mant > (UINT64_C(1) << 53))
+		return FALSE;
+	/* Move excess powers into the mantissa while it stays exact. */
+	while (exp > 22 && mant <= (UINT64_C(1) << 53) / 10) {
+		mant *= 10;
+		exp--;
+	}
+	if (exp < -22 || exp > 22)
+		return FALSE;
+
+	value = mant;
+	if (exp < 0)
+		value /= pow10[-exp];
+	else
+		value *= pow10[exp];
+	*ret = neg ? -value : value;
+
+	return TRUE;
+}
+
 /**
  * Convert a string representation of a numeric value to a double. The
  * conversion is strict and will fail if the complete string does not represent
@@ -314,6 +397,8 @@ SR_PRIV int sr_atod_ascii(const char *str, double *ret)
 	char *endptr = NULL;
 
 	errno = 0;
+	if (atod_fast(str, ret))
+		return SR_OK;
 	tmp = g_ascii_strtod(str, &endptr);
 
 	if (!endptr || *endptr || errno) {
@@ -417,6 +502,10 @@ SR_PRIV int sr_atof_ascii(const char *str, float *ret)
 	char *endptr = NULL;
 
 	errno = 0;
+	if (atod_fast(str, &tmp)) {
+		*ret = (float) tmp;
+		return SR_OK;
+	}
 	tmp = g_ascii_strtod(str, &endptr);
 
 	if (!endptr || *endptr || errno) {
@@ -439,6 +528,27 @@ SR_PRIV int sr_atof_ascii(const char *str, float *ret)
 	return SR_OK;
 }
 
+#if defined(__APPLE__) || (defined(__FreeBSD__) && __FreeBSD_version >= 901000) || \
+	(defined(__linux__) && !defined(__ANDROID__))
+/*
+ * The "C" locale for numeric conversions, created on first use and kept
+ * for the lifetime of the process. Creating one per call is expensive,
+ * and SCPI drivers format every command through the functions below.
+ */
+static locale_t c_numeric_locale(void)
+{
+	static gsize initialized = 0;
+	static locale_t locale;
+
+	if (g_once_init_enter(&initialized)) {
+		locale = newlocale(LC_NUMERIC_MASK, "C", NULL);
+		g_once_init_leave(&initialized, 1);
+	}
+
+	return locale;
+}
+#endif
+
 /**
  * Compose a string with a format string in the buffer pointed to by buf.
  *
@@ -533,28 +643,14 @@ SR_API int sr_vsprintf_ascii(char *buf, const char *format, va_list args)
 	 * https://developer.apple.com/legacy/library/documentation/Darwin/Reference/ManPages/man3/printf_l.3.html
 	 * https://developer.apple.com/legacy/library/documentation/Darwin/Reference/ManPages/man3/xlocale.3.html
 	 */
-	int ret;
-	locale_t locale;
-
-	locale = newlocale(LC_NUMERIC_MASK, "C", NULL);
-	ret = vsprintf_l(buf, locale, format, args);
-	freelocale(locale);
-
-	return ret;
+	return vsprintf_l(buf, c_numeric_locale(), format, args);
 #elif defined(__FreeBSD__) && __FreeBSD_version >= 901000
 	/*
 	 * See:
 	 * https://www.freebsd.org/cgi/man.cgi?query=printf_l&apropos=0&sektion=3&manpath=FreeBSD+9.1-RELEASE
 	 * https://www.freebsd.org/cgi/man.cgi?query=xlocale&apropos=0&sektion=3&manpath=FreeBSD+9.1-RELEASE
 	 */
-	int ret;
-	locale_t locale;
-
-	locale = newlocale(LC_NUMERIC_MASK, "C", NULL);
-	ret = vsprintf_l(buf, locale, format, args);
-	freelocale(locale);
-
-	return ret;
+	return vsprintf_l(buf, c_numeric_locale(), format, args);
 #elif defined(__ANDROID__)
 	/*
 	 * The Bionic libc only has two locales ("C" aka "POSIX" and "C.UTF-8"
@@ -568,17 +664,15 @@ SR_API int sr_vsprintf_ascii(char *buf, const char *format, va_list args)
 	return ret;
 #elif defined(__linux__)
 	int ret;
-	locale_t old_locale, temp_locale;
+	locale_t old_locale;
 
 	/* Switch to C locale for proper float/double conversion. */
-	temp_locale = newlocale(LC_NUMERIC, "C", NULL);
-	old_locale = uselocale(temp_locale);
+	old_locale = uselocale(c_numeric_locale());
 
 	ret = vsprintf(buf, format, args);
 
 	/* Switch back to original locale. */
 	uselocale(old_locale);
-	freelocale(temp_locale);
 
 	return ret;
 #elif defined(__unix__) || defined(__unix)
@@ -706,28 +800,14 @@ SR_API int sr_vsnprintf_ascii(char *buf, size_t buf_size,
 	 * https://developer.apple.com/legacy/library/documentation/Darwin/Reference/ManPages/man3/printf_l.3.html
 	 * https://developer.apple.com/legacy/library/documentation/Darwin/Reference/ManPages/man3/xlocale.3.html
 	 */
-	int ret;
-	locale_t locale;
-
-	locale = newlocale(LC_NUMERIC_MASK, "C", NULL);
-	ret = vsnprintf_l(buf, buf_size, locale, format, args);
-	freelocale(locale);
-
-	return ret;
+	return vsnprintf_l(buf, buf_size, c_numeric_locale(), format, args);
 #elif defined(__FreeBSD__) && __FreeBSD_version >= 901000
 	/*
 	 * See:
 	 * https://www.freebsd.org/cgi/man.cgi?query=printf_l&apropos=0&sektion=3&manpath=FreeBSD+9.1-RELEASE
 	 * https://www.freebsd.org/cgi/man.cgi?query=xlocale&apropos=0&sektion=3&manpath=FreeBSD+9.1-RELEASE
 	 */
-	int ret;
-	locale_t locale;
-
-	locale = newlocale(LC_NUMERIC_MASK, "C", NULL);
-	ret = vsnprintf_l(buf, buf_size, locale, format, args);
-	freelocale(locale);
-
-	return ret;
+	return vsnprintf_l(buf, buf_size, c_numeric_locale(), format, args);
 #elif defined(__ANDROID__)
 	/*
 	 * The Bionic libc only has two locales ("C" aka "POSIX" and "C.UTF-8"
@@ -741,17 +821,15 @@ SR_API int sr_vsnprintf_ascii(char *buf, size_t buf_size,
 	return ret;
 #elif defined(__linux__)
 	int ret;
-	locale_t old_locale, temp_locale;
+	locale_t old_locale;
 
 	/* Switch to C locale for proper float/double conversion. */
-	temp_locale = newlocale(LC_NUMERIC, "C", NULL);
-	old_locale = uselocale(temp_locale);
+	old_locale = uselocale(c_numeric_locale());
 
 	ret = vsnprintf(buf, buf_size, format, args);
 
 	/* Switch back to original locale. */
 	uselocale(old_locale);
-	freelocale(temp_locale);
 
 	return ret;
 #elif defined(__unix__) || defined(__unix)
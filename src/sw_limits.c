@@ -100,6 +100,7 @@ SR_PRIV int sr_sw_limits_config_set(struct sr_sw_limits *limits, uint32_t key,
 		break;
 	case SR_CONF_LIMIT_MSEC:
 		limits->limit_msec = g_variant_get_uint64(data) * 1000;
+		limits->deadline = limits->start_time + limits->limit_msec;
 		break;
 	default:
 		return SR_ERR_NA;
@@ -121,6 +122,26 @@ SR_PRIV void sr_sw_limits_acquisition_start(struct sr_sw_limits *limits)
 	limits->samples_read = 0;
 	limits->frames_read = 0;
 	limits->start_time = g_get_monotonic_time();
+	limits->deadline = limits->start_time + limits->limit_msec;
+	limits->time_expired = FALSE;
+}
+
+/*
+ * Get the current time for the check of the time limit. Drivers mostly
+ * check limits from within their session source callbacks. The main
+ * context caches the time for each iteration, so meters which receive
+ * data in the same iteration share a single clock read. Fall back to
+ * reading the clock when not running from a source, e.g. in a thread.
+ */
+static int64_t sw_limits_get_time(void)
+{
+	GSource *source;
+
+	source = g_main_current_source();
+	if (source && !g_source_is_destroyed(source))
+		return g_source_get_time(source);
+
+	return g_get_monotonic_time();
 }
 
 /**
@@ -152,12 +173,12 @@ SR_PRIV gboolean sr_sw_limits_check(struct sr_sw_limits *limits)
 	}
 
 	if (limits->limit_msec && limits->start_time) {
-		guint64 now;
-		now = g_get_monotonic_time();
-		if (now > limits->start_time &&
-			now - limits->start_time > limits->limit_msec) {
+		if (limits->time_expired)
+			return TRUE;
+		if (sw_limits_get_time() > (int64_t)limits->deadline) {
 			sr_dbg("Requested sampling time (%" PRIu64
 			       "ms) reached.", limits->limit_msec / 1000);
+			limits->time_expired = TRUE;
 			return TRUE;
 		}
 	}
@@ -165,6 +186,25 @@ SR_PRIV gboolean sr_sw_limits_check(struct sr_sw_limits *limits)
 	return FALSE;
 }
 
+/**
+ * Update the amount of samples that have been read, and check limits
+ *
+ * Combines sr_sw_limits_update_samples_read() and sr_sw_limits_check(),
+ * for drivers which check the limits after each received sample.
+ *
+ * @param limits software limits instance
+ * @param samples_read the amount of samples that have been read
+ * @returns TRUE if any of the software limits has been reached and the driver
+ *               should stop data acquisition, otherwise FALSE.
+ */
+SR_PRIV gboolean sr_sw_limits_update_and_check(struct sr_sw_limits *limits,
+	uint64_t samples_read)
+{
+	limits->samples_read += samples_read;
+
+	return sr_sw_limits_check(limits);
+}
+
 /**
  * Update the amount of samples that have been read
  *
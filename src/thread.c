@@ -0,0 +1,113 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file
+ *
+ * Scheduling of the library's own threads.
+ */
+
+/* Needed for CPU_SET() and pthread_setaffinity_np(). */
+#define _GNU_SOURCE
+
+#include <config.h>
+#include <inttypes.h>
+#include <string.h>
+#include <glib.h>
+#ifdef _WIN32
+#include <windows.h>
+#elif defined(HAVE_PTHREAD_SETSCHEDPARAM)
+#include <pthread.h>
+#include <sched.h>
+#endif
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+#define LOG_PREFIX "thread"
+
+static void set_priority(int rt_priority, const char *name)
+{
+#ifdef _WIN32
+	(void)rt_priority;
+	if (!SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL))
+		sr_warn("Cannot raise the priority of the %s thread.", name);
+#elif defined(HAVE_PTHREAD_SETSCHEDPARAM)
+	struct sched_param param;
+	int ret;
+
+	memset(&param, 0, sizeof(param));
+	param.sched_priority = rt_priority;
+	ret = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+	if (ret != 0)
+		sr_warn("Cannot set real-time priority %d of the %s thread: %s.",
+			rt_priority, name, g_strerror(ret));
+#else
+	(void)rt_priority;
+	sr_warn("Cannot set the priority of the %s thread on this system.", name);
+#endif
+}
+
+static void set_affinity(uint64_t cpu_mask, const char *name)
+{
+#ifdef _WIN32
+	if (!SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)cpu_mask))
+		sr_warn("Cannot set the CPU affinity of the %s thread.", name);
+#elif defined(HAVE_PTHREAD_SETAFFINITY_NP)
+	cpu_set_t cpus;
+	unsigned int cpu;
+	int ret;
+
+	CPU_ZERO(&cpus);
+	for (cpu = 0; cpu < 64; cpu++) {
+		if (cpu_mask & (UINT64_C(1) << cpu))
+			CPU_SET(cpu, &cpus);
+	}
+	ret = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+	if (ret != 0)
+		sr_warn("Cannot set the CPU affinity of the %s thread: %s.",
+			name, g_strerror(ret));
+#else
+	(void)cpu_mask;
+	sr_warn("Cannot set the CPU affinity of the %s thread on this system.",
+		name);
+#endif
+}
+
+/**
+ * Apply scheduling settings to the calling thread.
+ *
+ * Failures, e.g. for lack of the privilege to use real-time priorities,
+ * are logged, and the thread keeps running with its previous settings.
+ *
+ * @param sched The settings to apply. NULL keeps the current settings.
+ * @param name Name of the thread for messages, e.g. "device".
+ *
+ * @private
+ */
+SR_PRIV void sr_thread_sched_apply(const struct sr_thread_sched *sched,
+		const char *name)
+{
+	if (!sched)
+		return;
+
+	if (sched->rt_priority)
+		set_priority(sched->rt_priority, name);
+	if (sched->cpu_mask)
+		set_affinity(sched->cpu_mask, name);
+	sr_dbg("Scheduling the %s thread with priority %d, CPU mask 0x%"
+		PRIx64 ".", name, sched->rt_priority, sched->cpu_mask);
+}
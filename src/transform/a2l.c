@@ -0,0 +1,347 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2026 libsigrok contributors
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Convert analog channels to logic levels.
+ *
+ * Every enabled analog channel gets a bit of the logic samples, by its
+ * rank among them. Devices may send the channels in one packet or in
+ * packets of their own, the levels of each channel are collected until
+ * all channels reached a sample, and each sample is sent once with the
+ * bits of all channels. The analog packets are passed on as well.
+ */
+
+#include <config.h>
+#include <string.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+#define LOG_PREFIX "transform/a2l"
+
+/* Most samples to hold back for channels which fall behind. */
+#define MAX_PENDING (1024 * 1024)
+
+struct context {
+	float lo_thr;
+	float hi_thr;
+	gboolean schmitt;
+	/* Schmitt trigger state per analog channel. */
+	GHashTable *states;
+	/* Output bit per analog channel, plus one, and how many there are. */
+	GHashTable *bits;
+	size_t num_bits;
+	size_t unitsize;
+	/* Stream index of the next sample of each bit's channel. */
+	uint64_t *positions;
+
+	/*
+	 * Logic samples from stream index 'base' on, which not all
+	 * channels reached yet.
+	 */
+	uint8_t *window;
+	size_t window_len;
+	size_t window_alloc;
+	uint64_t base;
+
+	/* Output packet, reused for every sent packet. */
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic logic;
+	float *values;
+	size_t values_size;
+	float *chan_values;
+	uint8_t *levels;
+	size_t chan_size;
+};
+
+/*
+ * Every enabled analog channel gets the bit of its rank among them, so
+ * a channel keeps its bit whichever channels a packet carries. All
+ * channels start at the first sample, with an empty window.
+ */
+static void bits_assign(struct context *ctx, const struct sr_dev_inst *sdi)
+{
+	struct sr_channel *ch;
+	GSList *l;
+
+	g_hash_table_remove_all(ctx->bits);
+	ctx->num_bits = 0;
+	for (l = sdi->channels; l; l = l->next) {
+		ch = l->data;
+		if (ch->type != SR_CHANNEL_ANALOG || !ch->enabled)
+			continue;
+		g_hash_table_insert(ctx->bits, ch,
+			GSIZE_TO_POINTER(++ctx->num_bits));
+	}
+	ctx->unitsize = (ctx->num_bits + 7) / 8;
+	g_free(ctx->positions);
+	ctx->positions = g_malloc0_n(MAX(ctx->num_bits, 1),
+		sizeof(*ctx->positions));
+	ctx->window_len = 0;
+	ctx->base = 0;
+}
+
+static int init(struct sr_transform *t, GHashTable *options)
+{
+	struct context *ctx;
+	double threshold, hysteresis;
+
+	if (!t || !t->sdi || !options)
+		return SR_ERR_ARG;
+
+	threshold = g_variant_get_double(g_hash_table_lookup(options, "threshold"));
+	hysteresis = g_variant_get_double(g_hash_table_lookup(options, "hysteresis"));
+	if (hysteresis < 0) {
+		sr_err("Hysteresis must not be negative.");
+		return SR_ERR_ARG;
+	}
+
+	t->priv = ctx = g_malloc0(sizeof(struct context));
+	ctx->lo_thr = threshold - hysteresis / 2;
+	ctx->hi_thr = threshold + hysteresis / 2;
+	ctx->schmitt = hysteresis > 0;
+	ctx->states = g_hash_table_new(g_direct_hash, g_direct_equal);
+	ctx->bits = g_hash_table_new(g_direct_hash, g_direct_equal);
+	bits_assign(ctx, t->sdi);
+
+	return SR_OK;
+}
+
+static void convert(struct context *ctx, void *channel, const float *in,
+		uint8_t *out, size_t count)
+{
+	uint8_t state;
+
+	if (!ctx->schmitt) {
+		sr_simd_threshold(in, ctx->hi_thr, out, count);
+		return;
+	}
+
+	state = GPOINTER_TO_UINT(g_hash_table_lookup(ctx->states, channel));
+	sr_simd_schmitt(in, ctx->lo_thr, ctx->hi_thr, &state, out, count);
+	g_hash_table_insert(ctx->states, channel, GUINT_TO_POINTER(state));
+}
+
+/* Make room in the window for its samples up to stream index 'end'. */
+static void window_extend(struct context *ctx, uint64_t end)
+{
+	size_t len;
+
+	len = end - ctx->base;
+	if (len <= ctx->window_len)
+		return;
+	if (len > ctx->window_alloc) {
+		ctx->window_alloc = MAX(len, 2 * ctx->window_alloc);
+		ctx->window = g_realloc(ctx->window,
+			ctx->window_alloc * ctx->unitsize);
+	}
+	memset(ctx->window + ctx->window_len * ctx->unitsize, 0,
+		(len - ctx->window_len) * ctx->unitsize);
+	ctx->window_len = len;
+}
+
+/*
+ * Send the window's samples before stream index 'end'. Channels which
+ * did not reach it yet continue from there, their levels of the samples
+ * sent are low.
+ */
+static int window_send(const struct sr_transform *t, uint64_t end)
+{
+	struct context *ctx;
+	size_t count, b;
+	int ret;
+
+	ctx = t->priv;
+	count = end - ctx->base;
+	if (!count)
+		return SR_OK;
+
+	ctx->logic.length = count * ctx->unitsize;
+	ctx->logic.unitsize = ctx->unitsize;
+	ctx->logic.data = ctx->window;
+	ctx->packet.type = SR_DF_LOGIC;
+	ctx->packet.payload = &ctx->logic;
+	ret = sr_transform_send(t, &ctx->packet, g_get_monotonic_time(),
+		ctx->base);
+
+	memmove(ctx->window, ctx->window + count * ctx->unitsize,
+		(ctx->window_len - count) * ctx->unitsize);
+	ctx->window_len -= count;
+	ctx->base = end;
+	for (b = 0; b < ctx->num_bits; b++)
+		ctx->positions[b] = MAX(ctx->positions[b], end);
+
+	return ret;
+}
+
+/* Send all samples of the window, whether all channels reached them. */
+static int window_flush(const struct sr_transform *t)
+{
+	struct context *ctx;
+
+	ctx = t->priv;
+
+	return window_send(t, ctx->base + ctx->window_len);
+}
+
+static int analog_to_logic(const struct sr_transform *t,
+		const struct sr_datafeed_analog *analog)
+{
+	struct context *ctx;
+	GSList *l;
+	uint8_t *out;
+	uint64_t complete;
+	size_t num_channels, bit, b, c, i, count;
+
+	ctx = t->priv;
+	count = analog->num_samples;
+	num_channels = g_slist_length(analog->meaning->channels);
+	if (!count || !num_channels || !ctx->num_bits)
+		return SR_OK;
+
+	if (ctx->values_size < count * num_channels) {
+		g_free(ctx->values);
+		ctx->values_size = count * num_channels;
+		ctx->values = g_malloc_n(ctx->values_size, sizeof(float));
+	}
+	if (sr_analog_to_float_prepared(analog, ctx->values) != SR_OK)
+		return SR_ERR_DATA;
+
+	if (ctx->chan_size < count) {
+		g_free(ctx->chan_values);
+		g_free(ctx->levels);
+		ctx->chan_size = count;
+		ctx->chan_values = g_malloc_n(count, sizeof(float));
+		ctx->levels = g_malloc(count);
+	}
+
+	for (c = 0, l = analog->meaning->channels; l; c++, l = l->next) {
+		/* Channels which were not enabled at start have no bit. */
+		bit = GPOINTER_TO_SIZE(g_hash_table_lookup(ctx->bits, l->data));
+		if (!bit--)
+			continue;
+		window_extend(ctx, ctx->positions[bit] + count);
+		out = ctx->window +
+			(ctx->positions[bit] - ctx->base) * ctx->unitsize;
+		ctx->positions[bit] += count;
+		if (ctx->num_bits == 1 && num_channels == 1) {
+			/* Levels of 0 and 1 already are the logic samples. */
+			convert(ctx, l->data, ctx->values, out, count);
+			continue;
+		}
+		for (i = 0; i < count; i++)
+			ctx->chan_values[i] = ctx->values[i * num_channels + c];
+		convert(ctx, l->data, ctx->chan_values, ctx->levels, count);
+		for (i = 0; i < count; i++)
+			out[i * ctx->unitsize + bit / 8] |=
+				ctx->levels[i] << (bit % 8);
+	}
+
+	/* Send the samples which all channels reached. */
+	complete = ctx->positions[0];
+	for (b = 1; b < ctx->num_bits; b++)
+		complete = MIN(complete, ctx->positions[b]);
+	if (ctx->window_len - (complete - ctx->base) > MAX_PENDING) {
+		sr_warn("Analog channels fall behind, sending their samples low.");
+		return window_flush(t);
+	}
+
+	return window_send(t, complete);
+}
+
+static int receive(const struct sr_transform *t,
+		struct sr_datafeed_packet *packet_in,
+		struct sr_datafeed_packet **packet_out)
+{
+	struct context *ctx;
+	int ret;
+
+	if (!t || !t->sdi || !packet_in || !packet_out)
+		return SR_ERR_ARG;
+	ctx = t->priv;
+
+	*packet_out = packet_in;
+	switch (packet_in->type) {
+	case SR_DF_ANALOG:
+		/* The logic samples go ahead of the analog ones. */
+		return analog_to_logic(t, packet_in->payload);
+	case SR_DF_HEADER:
+		/* All channels start out low. */
+		g_hash_table_remove_all(ctx->states);
+		bits_assign(ctx, t->sdi);
+		break;
+	case SR_DF_FRAME_END:
+	case SR_DF_END:
+		/* Channels which ended early are low for the rest. */
+		if ((ret = window_flush(t)) != SR_OK)
+			return ret;
+		break;
+	default:
+		sr_spew("Unsupported packet type %d, ignoring.", packet_in->type);
+		break;
+	}
+
+	return SR_OK;
+}
+
+static int cleanup(struct sr_transform *t)
+{
+	struct context *ctx;
+
+	if (!t || !t->sdi)
+		return SR_ERR_ARG;
+	ctx = t->priv;
+
+	g_hash_table_destroy(ctx->states);
+	g_hash_table_destroy(ctx->bits);
+	g_free(ctx->positions);
+	g_free(ctx->window);
+	g_free(ctx->values);
+	g_free(ctx->chan_values);
+	g_free(ctx->levels);
+	g_free(ctx);
+	t->priv = NULL;
+
+	return SR_OK;
+}
+
+static struct sr_option options[] = {
+	{ "threshold", "Threshold", "Level between logic low and high", NULL, NULL },
+	{ "hysteresis", "Hysteresis", "Width of the Schmitt trigger band around the threshold", NULL, NULL },
+	ALL_ZERO
+};
+
+static const struct sr_option *get_options(void)
+{
+	if (!options[0].def) {
+		options[0].def = g_variant_ref_sink(g_variant_new_double(0.5));
+		options[1].def = g_variant_ref_sink(g_variant_new_double(0.0));
+	}
+
+	return options;
+}
+
+SR_PRIV struct sr_transform_module transform_a2l = {
+	.id = "a2l",
+	.name = "Analog to logic",
+	.desc = "Convert analog channels to logic levels",
+	.options = get_options,
+	.init = init,
+	.receive = receive,
+	.cleanup = cleanup,
+};
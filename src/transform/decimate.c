@@ -0,0 +1,425 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2026 libsigrok contributors
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <float.h>
+#include <string.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+#define LOG_PREFIX "transform/decimate"
+
+enum decimate_mode {
+	/* Keep every Nth sample. */
+	MODE_PICK,
+	/* Keep the minimum and the maximum of every N samples. */
+	MODE_MINMAX,
+	/* Keep the average of every N samples. */
+	MODE_AVERAGE,
+};
+
+/* Decimation state of the analog samples of one channel (group). */
+struct analog_stream {
+	/* Number of samples in the current window. */
+	uint64_t count;
+	/* Number of interleaved channels; per-channel state follows. */
+	size_t num_channels;
+	float *min;
+	float *max;
+	double *sum;
+};
+
+struct context {
+	uint64_t factor;
+	enum decimate_mode mode;
+
+	/* Logic input samples until the next one to be kept. */
+	uint64_t logic_skip;
+	/* Analog streams, keyed by their first channel. */
+	GHashTable *streams;
+
+	/* Output packet, reused for every input packet. */
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic logic;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+	struct sr_datafeed_meta meta;
+	struct sr_config samplerate;
+	void *outbuf;
+	size_t outbuf_size;
+	float *inbuf;
+	size_t inbuf_size;
+};
+
+static void analog_stream_free(void *data)
+{
+	struct analog_stream *stream;
+
+	stream = data;
+	g_free(stream->min);
+	g_free(stream->max);
+	g_free(stream->sum);
+	g_free(stream);
+}
+
+static int init(struct sr_transform *t, GHashTable *options)
+{
+	struct context *ctx;
+	const char *mode;
+
+	if (!t || !t->sdi || !options)
+		return SR_ERR_ARG;
+
+	t->priv = ctx = g_malloc0(sizeof(struct context));
+
+	ctx->factor = g_variant_get_uint64(g_hash_table_lookup(options, "factor"));
+	if (!ctx->factor) {
+		sr_err("Decimation factor must be at least 1.");
+		g_free(ctx);
+		t->priv = NULL;
+		return SR_ERR_ARG;
+	}
+
+	mode = g_variant_get_string(g_hash_table_lookup(options, "mode"), NULL);
+	if (!strcmp(mode, "pick")) {
+		ctx->mode = MODE_PICK;
+	} else if (!strcmp(mode, "minmax")) {
+		ctx->mode = MODE_MINMAX;
+	} else if (!strcmp(mode, "average")) {
+		ctx->mode = MODE_AVERAGE;
+	} else {
+		sr_err("Unknown decimation mode '%s'.", mode);
+		g_free(ctx);
+		t->priv = NULL;
+		return SR_ERR_ARG;
+	}
+
+	ctx->streams = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+		NULL, analog_stream_free);
+
+	return SR_OK;
+}
+
+static void *outbuf_get(struct context *ctx, size_t size)
+{
+	if (ctx->outbuf_size < size) {
+		g_free(ctx->outbuf);
+		ctx->outbuf = g_malloc(size);
+		ctx->outbuf_size = size;
+	}
+
+	return ctx->outbuf;
+}
+
+static struct sr_datafeed_packet *decimate_logic(struct context *ctx,
+		const struct sr_datafeed_logic *logic)
+{
+	const uint8_t *in;
+	uint8_t *out;
+	uint64_t i, num_samples, num_out;
+
+	if (!logic->unitsize)
+		return NULL;
+
+	in = logic->data;
+	num_samples = logic->length / logic->unitsize;
+	out = outbuf_get(ctx, (num_samples / ctx->factor + 1) * logic->unitsize);
+
+	/* Logic data can't be averaged, always keep every Nth sample. */
+	num_out = 0;
+	for (i = ctx->logic_skip; i < num_samples; i += ctx->factor) {
+		memcpy(out + num_out * logic->unitsize,
+			in + i * logic->unitsize, logic->unitsize);
+		num_out++;
+	}
+	ctx->logic_skip = (i - num_samples);
+
+	if (!num_out)
+		return NULL;
+
+	ctx->logic.length = num_out * logic->unitsize;
+	ctx->logic.unitsize = logic->unitsize;
+	ctx->logic.data = out;
+	ctx->packet.type = SR_DF_LOGIC;
+	ctx->packet.payload = &ctx->logic;
+
+	return &ctx->packet;
+}
+
+static struct analog_stream *analog_stream_get(struct context *ctx,
+		const struct sr_datafeed_analog *analog, size_t num_channels)
+{
+	struct analog_stream *stream;
+	void *key;
+	size_t c;
+
+	key = analog->meaning->channels ? analog->meaning->channels->data : NULL;
+	stream = g_hash_table_lookup(ctx->streams, key);
+	if (stream && stream->num_channels == num_channels)
+		return stream;
+
+	stream = g_malloc0(sizeof(*stream));
+	stream->num_channels = num_channels;
+	stream->min = g_malloc_n(num_channels, sizeof(float));
+	stream->max = g_malloc_n(num_channels, sizeof(float));
+	stream->sum = g_malloc0_n(num_channels, sizeof(double));
+	for (c = 0; c < num_channels; c++) {
+		stream->min[c] = FLT_MAX;
+		stream->max[c] = -FLT_MAX;
+	}
+	g_hash_table_replace(ctx->streams, key, stream);
+
+	return stream;
+}
+
+static struct sr_datafeed_packet *decimate_analog(struct context *ctx,
+		const struct sr_datafeed_analog *analog)
+{
+	struct analog_stream *stream;
+	const float *in;
+	float *out, v;
+	size_t num_channels, c, per_window;
+	uint64_t i, num_out;
+
+	num_channels = g_slist_length(analog->meaning->channels);
+	if (!num_channels)
+		num_channels = 1;
+
+	/* Process all encodings as floats, like consumers do. */
+	if (ctx->inbuf_size < analog->num_samples * num_channels) {
+		g_free(ctx->inbuf);
+		ctx->inbuf_size = analog->num_samples * num_channels;
+		ctx->inbuf = g_malloc_n(ctx->inbuf_size, sizeof(float));
+	}
+	if (sr_analog_to_float_prepared(analog, ctx->inbuf) != SR_OK)
+		return NULL;
+	in = ctx->inbuf;
+
+	stream = analog_stream_get(ctx, analog, num_channels);
+	per_window = (ctx->mode == MODE_MINMAX) ? 2 : 1;
+	out = outbuf_get(ctx, (analog->num_samples / ctx->factor + 1)
+		* per_window * num_channels * sizeof(float));
+
+	num_out = 0;
+	for (i = 0; i < analog->num_samples; i++) {
+		for (c = 0; c < num_channels; c++) {
+			v = in[i * num_channels + c];
+			switch (ctx->mode) {
+			case MODE_PICK:
+				if (stream->count == 0)
+					stream->sum[c] = v;
+				break;
+			case MODE_MINMAX:
+				stream->min[c] = MIN(stream->min[c], v);
+				stream->max[c] = MAX(stream->max[c], v);
+				break;
+			case MODE_AVERAGE:
+				stream->sum[c] += v;
+				break;
+			}
+		}
+		if (++stream->count < ctx->factor)
+			continue;
+
+		/* End of a window, emit its result and start another. */
+		for (c = 0; c < num_channels; c++) {
+			switch (ctx->mode) {
+			case MODE_PICK:
+				out[num_out * num_channels + c] = stream->sum[c];
+				break;
+			case MODE_MINMAX:
+				out[num_out * num_channels + c] = stream->min[c];
+				out[(num_out + 1) * num_channels + c] = stream->max[c];
+				stream->min[c] = FLT_MAX;
+				stream->max[c] = -FLT_MAX;
+				break;
+			case MODE_AVERAGE:
+				out[num_out * num_channels + c] =
+					stream->sum[c] / ctx->factor;
+				break;
+			}
+			stream->sum[c] = 0;
+		}
+		num_out += per_window;
+		stream->count = 0;
+	}
+
+	if (!num_out)
+		return NULL;
+
+	ctx->encoding = *analog->encoding;
+	ctx->encoding.unitsize = sizeof(float);
+	ctx->encoding.is_signed = TRUE;
+	ctx->encoding.is_float = TRUE;
+#ifdef WORDS_BIGENDIAN
+	ctx->encoding.is_bigendian = TRUE;
+#else
+	ctx->encoding.is_bigendian = FALSE;
+#endif
+	ctx->encoding.scale.p = 1;
+	ctx->encoding.scale.q = 1;
+	ctx->encoding.offset.p = 0;
+	ctx->encoding.offset.q = 1;
+	/* The output is interleaved floats, whatever the input layout. */
+	ctx->encoding.is_planar = FALSE;
+	ctx->encoding.sample_stride = 0;
+	ctx->encoding.channel_stride = 0;
+	ctx->meaning = *analog->meaning;
+	ctx->spec = *analog->spec;
+	ctx->analog.data = out;
+	ctx->analog.num_samples = num_out;
+	ctx->analog.encoding = &ctx->encoding;
+	ctx->analog.meaning = &ctx->meaning;
+	ctx->analog.spec = &ctx->spec;
+	ctx->packet.type = SR_DF_ANALOG;
+	ctx->packet.payload = &ctx->analog;
+
+	return &ctx->packet;
+}
+
+/* Pass on the samplerate of the decimated stream. */
+static struct sr_datafeed_packet *decimate_meta(struct context *ctx,
+		struct sr_datafeed_packet *packet)
+{
+	const struct sr_datafeed_meta *meta;
+	struct sr_config *src;
+	GSList *l;
+	uint64_t samplerate;
+
+	meta = packet->payload;
+	for (l = meta->config; l; l = l->next) {
+		src = l->data;
+		if (src->key == SR_CONF_SAMPLERATE)
+			break;
+	}
+	if (!l)
+		return packet;
+
+	samplerate = g_variant_get_uint64(src->data) / ctx->factor;
+	if (ctx->mode == MODE_MINMAX)
+		samplerate *= 2;
+
+	if (ctx->samplerate.data)
+		g_variant_unref(ctx->samplerate.data);
+	ctx->samplerate.key = SR_CONF_SAMPLERATE;
+	ctx->samplerate.data = g_variant_ref_sink(g_variant_new_uint64(samplerate));
+
+	/* Same config list, with the samplerate swapped for our own. */
+	g_slist_free(ctx->meta.config);
+	ctx->meta.config = NULL;
+	for (l = meta->config; l; l = l->next) {
+		src = l->data;
+		ctx->meta.config = g_slist_append(ctx->meta.config,
+			src->key == SR_CONF_SAMPLERATE ? &ctx->samplerate : src);
+	}
+	ctx->packet.type = SR_DF_META;
+	ctx->packet.payload = &ctx->meta;
+
+	return &ctx->packet;
+}
+
+static int receive(const struct sr_transform *t,
+		struct sr_datafeed_packet *packet_in,
+		struct sr_datafeed_packet **packet_out)
+{
+	struct context *ctx;
+
+	if (!t || !t->sdi || !packet_in || !packet_out)
+		return SR_ERR_ARG;
+	ctx = t->priv;
+
+	switch (packet_in->type) {
+	case SR_DF_LOGIC:
+		*packet_out = decimate_logic(ctx, packet_in->payload);
+		break;
+	case SR_DF_ANALOG:
+		*packet_out = decimate_analog(ctx, packet_in->payload);
+		break;
+	case SR_DF_META:
+		*packet_out = decimate_meta(ctx, packet_in);
+		break;
+	case SR_DF_HEADER:
+		/* Start over for a new acquisition. */
+		ctx->logic_skip = 0;
+		g_hash_table_remove_all(ctx->streams);
+		*packet_out = packet_in;
+		break;
+	default:
+		sr_spew("Unsupported packet type %d, ignoring.", packet_in->type);
+		*packet_out = packet_in;
+		break;
+	}
+
+	return SR_OK;
+}
+
+static int cleanup(struct sr_transform *t)
+{
+	struct context *ctx;
+
+	if (!t || !t->sdi)
+		return SR_ERR_ARG;
+	ctx = t->priv;
+
+	g_hash_table_destroy(ctx->streams);
+	if (ctx->samplerate.data)
+		g_variant_unref(ctx->samplerate.data);
+	g_slist_free(ctx->meta.config);
+	g_free(ctx->outbuf);
+	g_free(ctx->inbuf);
+	g_free(ctx);
+	t->priv = NULL;
+
+	return SR_OK;
+}
+
+static struct sr_option options[] = {
+	{ "factor", "Factor", "Number of input samples per output sample", NULL, NULL },
+	{ "mode", "Mode", "How to reduce analog samples: pick, minmax or average", NULL, NULL },
+	ALL_ZERO
+};
+
+static const struct sr_option *get_options(void)
+{
+	GSList *l;
+
+	if (!options[0].def) {
+		options[0].def = g_variant_ref_sink(g_variant_new_uint64(10));
+		options[1].def = g_variant_ref_sink(g_variant_new_string("average"));
+		l = NULL;
+		l = g_slist_append(l, g_variant_ref_sink(g_variant_new_string("pick")));
+		l = g_slist_append(l, g_variant_ref_sink(g_variant_new_string("minmax")));
+		l = g_slist_append(l, g_variant_ref_sink(g_variant_new_string("average")));
+		options[1].values = l;
+	}
+
+	return options;
+}
+
+SR_PRIV struct sr_transform_module transform_decimate = {
+	.id = "decimate",
+	.name = "Decimate",
+	.desc = "Reduce the samplerate by a specified factor",
+	.options = get_options,
+	.init = init,
+	.receive = receive,
+	.cleanup = cleanup,
+};
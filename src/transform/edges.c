@@ -0,0 +1,204 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2026 libsigrok contributors
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <string.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+#define LOG_PREFIX "transform/edges"
+
+struct context {
+	/* Value of the last sample received, unitsize bytes. */
+	uint8_t *last;
+	uint16_t unitsize;
+
+	/* Output packet, reused for every input packet. */
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic_edges edges;
+	uint64_t *offsets;
+	uint8_t *values;
+	uint64_t alloc_edges;
+};
+
+static int init(struct sr_transform *t, GHashTable *options)
+{
+	(void)options;
+
+	if (!t || !t->sdi)
+		return SR_ERR_ARG;
+
+	t->priv = g_malloc0(sizeof(struct context));
+
+	return SR_OK;
+}
+
+static void edges_append(struct context *ctx, uint64_t offset,
+		const uint8_t *value)
+{
+	uint64_t n;
+
+	n = ctx->edges.num_edges;
+	if (n == ctx->alloc_edges) {
+		ctx->alloc_edges = ctx->alloc_edges ? 2 * ctx->alloc_edges : 256;
+		ctx->offsets = g_realloc_n(ctx->offsets,
+			ctx->alloc_edges, sizeof(uint64_t));
+		ctx->values = g_realloc_n(ctx->values,
+			ctx->alloc_edges, ctx->unitsize);
+	}
+	ctx->offsets[n] = offset;
+	memcpy(ctx->values + n * ctx->unitsize, value, ctx->unitsize);
+	ctx->edges.num_edges++;
+}
+
+/* Find the next sample which differs from the last one. */
+static uint64_t next_change(const struct context *ctx,
+		const uint8_t *data, uint64_t i, uint64_t num_samples)
+{
+	const uint8_t *last;
+	uint16_t unitsize;
+
+	last = ctx->last;
+	unitsize = ctx->unitsize;
+
+	/* Compare whole units for the common sizes. */
+	switch (unitsize) {
+	case 1:
+		while (i < num_samples && data[i] == last[0])
+			i++;
+		break;
+	case 2:
+		while (i < num_samples && RL16(data + 2 * i) == RL16(last))
+			i++;
+		break;
+	case 4:
+		while (i < num_samples && RL32(data + 4 * i) == RL32(last))
+			i++;
+		break;
+	default:
+		while (i < num_samples
+				&& !memcmp(data + i * unitsize, last, unitsize))
+			i++;
+		break;
+	}
+
+	return i;
+}
+
+static struct sr_datafeed_packet *logic_to_edges(struct context *ctx,
+		const struct sr_datafeed_logic *logic)
+{
+	const uint8_t *data;
+	uint64_t i, num_samples;
+
+	if (!logic->unitsize)
+		return NULL;
+
+	if (logic->unitsize != ctx->unitsize) {
+		/* First packet, or the layout changed: start over. */
+		g_free(ctx->last);
+		ctx->last = NULL;
+		g_free(ctx->values);
+		ctx->values = NULL;
+		ctx->alloc_edges = 0;
+		ctx->unitsize = logic->unitsize;
+	}
+
+	data = logic->data;
+	num_samples = logic->length / logic->unitsize;
+	ctx->edges.num_edges = 0;
+
+	i = 0;
+	if (!ctx->last && num_samples) {
+		ctx->last = g_malloc(ctx->unitsize);
+		memcpy(ctx->last, data, ctx->unitsize);
+		edges_append(ctx, 0, data);
+		i = 1;
+	}
+	while ((i = next_change(ctx, data, i, num_samples)) < num_samples) {
+		memcpy(ctx->last, data + i * ctx->unitsize, ctx->unitsize);
+		edges_append(ctx, i, ctx->last);
+		i++;
+	}
+
+	ctx->edges.num_samples = num_samples;
+	ctx->edges.unitsize = ctx->unitsize;
+	ctx->edges.offsets = ctx->offsets;
+	ctx->edges.values = ctx->values;
+	ctx->packet.type = SR_DF_LOGIC_EDGES;
+	ctx->packet.payload = &ctx->edges;
+
+	return &ctx->packet;
+}
+
+static int receive(const struct sr_transform *t,
+		struct sr_datafeed_packet *packet_in,
+		struct sr_datafeed_packet **packet_out)
+{
+	struct context *ctx;
+
+	if (!t || !t->sdi || !packet_in || !packet_out)
+		return SR_ERR_ARG;
+	ctx = t->priv;
+
+	switch (packet_in->type) {
+	case SR_DF_LOGIC:
+		*packet_out = logic_to_edges(ctx, packet_in->payload);
+		break;
+	case SR_DF_HEADER:
+		/* A new stream starts with its first value. */
+		g_free(ctx->last);
+		ctx->last = NULL;
+		*packet_out = packet_in;
+		break;
+	default:
+		sr_spew("Unsupported packet type %d, ignoring.", packet_in->type);
+		*packet_out = packet_in;
+		break;
+	}
+
+	return SR_OK;
+}
+
+static int cleanup(struct sr_transform *t)
+{
+	struct context *ctx;
+
+	if (!t || !t->sdi)
+		return SR_ERR_ARG;
+	ctx = t->priv;
+
+	g_free(ctx->last);
+	g_free(ctx->offsets);
+	g_free(ctx->values);
+	g_free(ctx);
+	t->priv = NULL;
+
+	return SR_OK;
+}
+
+SR_PRIV struct sr_transform_module transform_edges = {
+	.id = "edges",
+	.name = "Edges",
+	.desc = "Pass on logic data as a list of value changes",
+	.options = NULL,
+	.init = init,
+	.receive = receive,
+	.cleanup = cleanup,
+};
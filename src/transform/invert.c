@@ -24,15 +24,25 @@
 
 #define LOG_PREFIX "transform/invert"
 
+static void logic_block(const struct sr_transform *t,
+		const struct sr_datafeed_logic *logic,
+		uint8_t *data, uint64_t length)
+{
+	(void)t;
+	(void)logic;
+
+	/* For now invert every bit in every byte. */
+	sr_simd_invert(data, length);
+}
+
 static int receive(const struct sr_transform *t,
 		struct sr_datafeed_packet *packet_in,
 		struct sr_datafeed_packet **packet_out)
 {
 	const struct sr_datafeed_logic *logic;
 	const struct sr_datafeed_analog *analog;
-	uint8_t *b;
 	int64_t p;
-	uint64_t i, j, q;
+	uint64_t q;
 
 	if (!t || !t->sdi || !packet_in || !packet_out)
 		return SR_ERR_ARG;
@@ -40,13 +50,7 @@ static int receive(const struct sr_transform *t,
 	switch (packet_in->type) {
 	case SR_DF_LOGIC:
 		logic = packet_in->payload;
-		for (i = 0; i <= logic->length - logic->unitsize; i += logic->unitsize) {
-			for (j = 0; j < logic->unitsize; j++) {
-				/* For now invert every bit in every byte. */
-				b = (uint8_t *)logic->data + i + logic->unitsize - 1 - j;
-				*b = ~(*b);
-			}
-		}
+		logic_block(t, logic, logic->data, logic->length);
 		break;
 	case SR_DF_ANALOG:
 		analog = packet_in->payload;
@@ -75,5 +79,7 @@ SR_PRIV struct sr_transform_module transform_invert = {
 	.options = NULL,
 	.init = NULL,
 	.receive = receive,
+	.in_place = TRUE,
+	.logic_block = logic_block,
 	.cleanup = NULL,
 };
@@ -0,0 +1,406 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Pass on logic and analog samples in blocks of a uniform size.
+ *
+ * Consecutive packets of the same kind are collected until a block is
+ * complete, or until the oldest collected sample is older than the
+ * latency bound. Packets larger than a block are split. Any other
+ * packet first flushes what was collected, so the order of samples
+ * and the packets around them is kept.
+ *
+ * The latency bound is checked when packets arrive, a stream which
+ * stops sending keeps its last samples until its next packet.
+ */
+
+#include <config.h>
+#include <string.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+#define LOG_PREFIX "transform/repacketize"
+
+struct pending {
+	uint8_t *buf;
+	size_t buf_size;
+	/* Collected bytes, and the size of one sample in bytes. */
+	size_t length;
+	size_t sample_size;
+	/* Time of arrival and stream index of the first collected sample. */
+	int64_t time;
+	uint64_t index;
+	/* Stream index of the next sample to arrive. */
+	uint64_t next;
+};
+
+struct context {
+	uint64_t block_samples;
+	int64_t latency_us;
+
+	struct pending logic;
+	uint16_t logic_unitsize;
+
+	struct pending analog;
+	struct sr_datafeed_analog analog_out;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+};
+
+static int init(struct sr_transform *t, GHashTable *options)
+{
+	struct context *ctx;
+	uint64_t samples, latency;
+
+	if (!t || !t->sdi || !options)
+		return SR_ERR_ARG;
+
+	samples = g_variant_get_uint64(g_hash_table_lookup(options, "samples"));
+	latency = g_variant_get_uint64(g_hash_table_lookup(options, "latency"));
+	if (!samples) {
+		sr_err("Block size must be at least one sample.");
+		return SR_ERR_ARG;
+	}
+
+	t->priv = ctx = g_malloc0(sizeof(struct context));
+	ctx->block_samples = samples;
+	ctx->latency_us = latency * 1000;
+
+	return SR_OK;
+}
+
+static void pending_append(struct pending *p, const uint8_t *data,
+		size_t length)
+{
+	if (!p->length) {
+		p->time = g_get_monotonic_time();
+		p->index = p->next;
+	}
+	if (p->length + length > p->buf_size) {
+		p->buf_size = p->length + length;
+		p->buf = g_realloc(p->buf, p->buf_size);
+	}
+	memcpy(p->buf + p->length, data, length);
+	p->length += length;
+	p->next += length / p->sample_size;
+}
+
+static int send_logic(const struct sr_transform *t, const uint8_t *data,
+		size_t length, int64_t time, uint64_t index)
+{
+	struct context *ctx;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic logic;
+
+	ctx = t->priv;
+	logic.length = length;
+	logic.unitsize = ctx->logic_unitsize;
+	logic.data = (void *)data;
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+
+	return sr_transform_send(t, &packet, time, index);
+}
+
+static int send_analog(const struct sr_transform *t, const uint8_t *data,
+		size_t length, int64_t time, uint64_t index)
+{
+	struct context *ctx;
+	struct sr_datafeed_packet packet;
+
+	ctx = t->priv;
+	ctx->analog_out.data = (void *)data;
+	ctx->analog_out.num_samples = length / ctx->analog.sample_size;
+	packet.type = SR_DF_ANALOG;
+	packet.payload = &ctx->analog_out;
+
+	return sr_transform_send(t, &packet, time, index);
+}
+
+static int flush_logic(const struct sr_transform *t)
+{
+	struct context *ctx;
+	struct pending *p;
+	int ret;
+
+	ctx = t->priv;
+	p = &ctx->logic;
+	if (!p->length)
+		return SR_OK;
+	ret = send_logic(t, p->buf, p->length, p->time, p->index);
+	p->length = 0;
+
+	return ret;
+}
+
+static int flush_analog(const struct sr_transform *t)
+{
+	struct context *ctx;
+	struct pending *p;
+	int ret;
+
+	ctx = t->priv;
+	p = &ctx->analog;
+	if (!p->length)
+		return SR_OK;
+	ret = send_analog(t, p->buf, p->length, p->time, p->index);
+	p->length = 0;
+
+	return ret;
+}
+
+/*
+ * Collect the samples of a packet into blocks, and send the complete
+ * ones. Whole blocks of the packet are sent without copying them.
+ */
+static int collect(const struct sr_transform *t, struct pending *p,
+		const uint8_t *data, size_t length,
+		int (*send)(const struct sr_transform *, const uint8_t *,
+			size_t, int64_t, uint64_t))
+{
+	struct context *ctx;
+	size_t block_size, n;
+	int ret;
+
+	ctx = t->priv;
+	block_size = ctx->block_samples * p->sample_size;
+
+	if (p->length) {
+		n = MIN(length, block_size - p->length);
+		pending_append(p, data, n);
+		data += n;
+		length -= n;
+		if (p->length == block_size) {
+			ret = send(t, p->buf, p->length, p->time, p->index);
+			p->length = 0;
+			if (ret != SR_OK)
+				return ret;
+		}
+	}
+
+	while (length >= block_size) {
+		ret = send(t, data, block_size, g_get_monotonic_time(), p->next);
+		if (ret != SR_OK)
+			return ret;
+		p->next += ctx->block_samples;
+		data += block_size;
+		length -= block_size;
+	}
+
+	if (length)
+		pending_append(p, data, length);
+
+	if (p->length && g_get_monotonic_time() - p->time >= ctx->latency_us) {
+		ret = send(t, p->buf, p->length, p->time, p->index);
+		p->length = 0;
+		return ret;
+	}
+
+	return SR_OK;
+}
+
+static int receive_logic(const struct sr_transform *t,
+		const struct sr_datafeed_logic *logic)
+{
+	struct context *ctx;
+	int ret;
+
+	ctx = t->priv;
+	if (!logic->unitsize || !logic->length)
+		return SR_OK;
+
+	if (logic->unitsize != ctx->logic_unitsize) {
+		if ((ret = flush_logic(t)) != SR_OK)
+			return ret;
+		ctx->logic_unitsize = logic->unitsize;
+		ctx->logic.sample_size = logic->unitsize;
+	}
+
+	return collect(t, &ctx->logic, logic->data,
+		logic->length - logic->length % logic->unitsize, send_logic);
+}
+
+static gboolean same_channels(GSList *a, GSList *b)
+{
+	while (a && b && a->data == b->data) {
+		a = a->next;
+		b = b->next;
+	}
+
+	return !a && !b;
+}
+
+/* Whether the samples can go into the same block as those collected. */
+static gboolean analog_compatible(const struct context *ctx,
+		const struct sr_datafeed_analog *analog)
+{
+	const struct sr_analog_encoding *a, *b;
+
+	a = &ctx->encoding;
+	b = analog->encoding;
+
+	return a->unitsize == b->unitsize && a->is_signed == b->is_signed &&
+		a->is_float == b->is_float && a->is_bigendian == b->is_bigendian &&
+		a->digits == b->digits &&
+		a->is_digits_decimal == b->is_digits_decimal &&
+		a->scale.p == b->scale.p && a->scale.q == b->scale.q &&
+		a->offset.p == b->offset.p && a->offset.q == b->offset.q &&
+		ctx->meaning.mq == analog->meaning->mq &&
+		ctx->meaning.unit == analog->meaning->unit &&
+		ctx->meaning.mqflags == analog->meaning->mqflags &&
+		ctx->spec.spec_digits == analog->spec->spec_digits &&
+		same_channels(ctx->meaning.channels, analog->meaning->channels);
+}
+
+static int receive_analog(const struct sr_transform *t,
+		struct sr_datafeed_packet *packet_in,
+		struct sr_datafeed_packet **packet_out)
+{
+	const struct sr_datafeed_analog *analog;
+	struct context *ctx;
+	size_t num_channels, sample_stride, channel_stride, sample_size;
+	int ret;
+
+	ctx = t->priv;
+	analog = packet_in->payload;
+	*packet_out = NULL;
+	if (!analog->num_samples)
+		return SR_OK;
+
+	if (!analog_compatible(ctx, analog)) {
+		if ((ret = flush_analog(t)) != SR_OK)
+			return ret;
+		ctx->encoding = *analog->encoding;
+		ctx->encoding.is_planar = FALSE;
+		ctx->encoding.sample_stride = 0;
+		ctx->encoding.channel_stride = 0;
+		g_slist_free(ctx->meaning.channels);
+		ctx->meaning = *analog->meaning;
+		ctx->meaning.channels = g_slist_copy(analog->meaning->channels);
+		ctx->spec = *analog->spec;
+		ctx->analog_out.encoding = &ctx->encoding;
+		ctx->analog_out.meaning = &ctx->meaning;
+		ctx->analog_out.spec = &ctx->spec;
+	}
+
+	/* Only packed and interleaved samples can be cut into blocks. */
+	num_channels = MAX(g_slist_length(analog->meaning->channels), 1);
+	sample_size = analog->encoding->unitsize * num_channels;
+	sr_analog_strides(analog, &sample_stride, &channel_stride);
+	if (sample_stride != sample_size || (num_channels > 1 &&
+			channel_stride != analog->encoding->unitsize)) {
+		if ((ret = flush_analog(t)) != SR_OK)
+			return ret;
+		ctx->analog.next += analog->num_samples;
+		*packet_out = packet_in;
+		return SR_OK;
+	}
+	ctx->analog.sample_size = sample_size;
+
+	return collect(t, &ctx->analog, analog->data,
+		analog->num_samples * sample_size, send_analog);
+}
+
+static int receive(const struct sr_transform *t,
+		struct sr_datafeed_packet *packet_in,
+		struct sr_datafeed_packet **packet_out)
+{
+	const struct sr_datafeed_logic_edges *edges;
+	struct context *ctx;
+	int ret;
+
+	if (!t || !t->sdi || !packet_in || !packet_out)
+		return SR_ERR_ARG;
+	ctx = t->priv;
+
+	switch (packet_in->type) {
+	case SR_DF_LOGIC:
+		*packet_out = NULL;
+		return receive_logic(t, packet_in->payload);
+	case SR_DF_ANALOG:
+		return receive_analog(t, packet_in, packet_out);
+	case SR_DF_HEADER:
+		ctx->logic.length = 0;
+		ctx->logic.next = 0;
+		ctx->analog.length = 0;
+		ctx->analog.next = 0;
+		*packet_out = packet_in;
+		break;
+	case SR_DF_LOGIC_EDGES:
+		/* Runs of samples follow the samples before them. */
+		if ((ret = flush_logic(t)) != SR_OK)
+			return ret;
+		edges = packet_in->payload;
+		ctx->logic.next += edges->num_samples;
+		*packet_out = packet_in;
+		break;
+	default:
+		/* Keep the collected samples ahead of triggers, frames etc. */
+		if ((ret = flush_logic(t)) != SR_OK)
+			return ret;
+		if ((ret = flush_analog(t)) != SR_OK)
+			return ret;
+		*packet_out = packet_in;
+		break;
+	}
+
+	return SR_OK;
+}
+
+static int cleanup(struct sr_transform *t)
+{
+	struct context *ctx;
+
+	if (!t || !t->sdi)
+		return SR_ERR_ARG;
+	ctx = t->priv;
+
+	g_free(ctx->logic.buf);
+	g_free(ctx->analog.buf);
+	g_slist_free(ctx->meaning.channels);
+	g_free(ctx);
+	t->priv = NULL;
+
+	return SR_OK;
+}
+
+static struct sr_option options[] = {
+	{ "samples", "Samples", "Number of samples per block", NULL, NULL },
+	{ "latency", "Latency", "Longest time in milliseconds to hold back samples", NULL, NULL },
+	ALL_ZERO
+};
+
+static const struct sr_option *get_options(void)
+{
+	if (!options[0].def) {
+		options[0].def = g_variant_ref_sink(g_variant_new_uint64(4096));
+		options[1].def = g_variant_ref_sink(g_variant_new_uint64(100));
+	}
+
+	return options;
+}
+
+SR_PRIV struct sr_transform_module transform_repacketize = {
+	.id = "repacketize",
+	.name = "Repacketize",
+	.desc = "Pass on samples in blocks of a uniform size",
+	.options = get_options,
+	.init = init,
+	.receive = receive,
+	.cleanup = cleanup,
+};
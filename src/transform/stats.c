@@ -0,0 +1,383 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Replace analog samples by their statistics over windows of N samples.
+ *
+ * For every complete window and channel, the minimum, maximum, mean
+ * and RMS of its samples are passed on. Each statistic goes into an
+ * analog packet of its own, with the input's quantity and unit, and
+ * SR_MQFLAG_MIN, SR_MQFLAG_MAX, SR_MQFLAG_AVG or SR_MQFLAG_RMS added
+ * to its flags. Logic and all other packets are passed on unmodified.
+ */
+
+#include <config.h>
+#include <math.h>
+#include <string.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+#define LOG_PREFIX "transform/stats"
+
+enum stat {
+	STAT_MIN,
+	STAT_MAX,
+	STAT_MEAN,
+	STAT_RMS,
+	NUM_STATS,
+};
+
+static const struct {
+	const char *name;
+	enum sr_mqflag flag;
+} stat_info[NUM_STATS] = {
+	[STAT_MIN] = { "min", SR_MQFLAG_MIN },
+	[STAT_MAX] = { "max", SR_MQFLAG_MAX },
+	[STAT_MEAN] = { "mean", SR_MQFLAG_AVG },
+	[STAT_RMS] = { "rms", SR_MQFLAG_RMS },
+};
+
+/* Statistics of the current window of one channel (group). */
+struct analog_stream {
+	/* Number of samples in the current window. */
+	uint64_t count;
+	/* Number of windows passed on so far. */
+	uint64_t num_windows;
+	/* Number of interleaved channels; per-channel state follows. */
+	size_t num_channels;
+	struct sr_simd_stats *stats;
+};
+
+struct context {
+	uint64_t window;
+	gboolean enabled[NUM_STATS];
+
+	/* Analog streams, keyed by their first channel. */
+	GHashTable *streams;
+
+	/* Output packet, reused for every statistic. */
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+	float *outbuf[NUM_STATS];
+	size_t outbuf_size;
+	float *inbuf;
+	size_t inbuf_size;
+	float *chan_values;
+	size_t chan_size;
+};
+
+static void analog_stream_free(void *data)
+{
+	struct analog_stream *stream;
+
+	stream = data;
+	g_free(stream->stats);
+	g_free(stream);
+}
+
+static int init(struct sr_transform *t, GHashTable *options)
+{
+	struct context *ctx;
+	const char *names;
+	char **tokens;
+	size_t i, s;
+	gboolean found;
+
+	if (!t || !t->sdi || !options)
+		return SR_ERR_ARG;
+
+	t->priv = ctx = g_malloc0(sizeof(struct context));
+
+	ctx->window = g_variant_get_uint64(g_hash_table_lookup(options, "window"));
+	if (!ctx->window) {
+		sr_err("Window must be at least one sample.");
+		g_free(ctx);
+		t->priv = NULL;
+		return SR_ERR_ARG;
+	}
+
+	names = g_variant_get_string(g_hash_table_lookup(options, "stats"), NULL);
+	tokens = g_strsplit(names, ",", 0);
+	found = FALSE;
+	for (i = 0; tokens[i]; i++) {
+		for (s = 0; s < NUM_STATS; s++) {
+			if (!strcmp(g_strstrip(tokens[i]), stat_info[s].name))
+				break;
+		}
+		if (s == NUM_STATS) {
+			sr_err("Unknown statistic '%s'.", tokens[i]);
+			g_strfreev(tokens);
+			g_free(ctx);
+			t->priv = NULL;
+			return SR_ERR_ARG;
+		}
+		ctx->enabled[s] = TRUE;
+		found = TRUE;
+	}
+	g_strfreev(tokens);
+	if (!found) {
+		sr_err("No statistics selected.");
+		g_free(ctx);
+		t->priv = NULL;
+		return SR_ERR_ARG;
+	}
+
+	ctx->streams = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+		NULL, analog_stream_free);
+
+	return SR_OK;
+}
+
+static struct analog_stream *analog_stream_get(struct context *ctx,
+		const struct sr_datafeed_analog *analog, size_t num_channels)
+{
+	struct analog_stream *stream;
+	void *key;
+	size_t c;
+
+	key = analog->meaning->channels ? analog->meaning->channels->data : NULL;
+	stream = g_hash_table_lookup(ctx->streams, key);
+	if (stream && stream->num_channels == num_channels)
+		return stream;
+
+	stream = g_malloc0(sizeof(*stream));
+	stream->num_channels = num_channels;
+	stream->stats = g_malloc_n(num_channels, sizeof(*stream->stats));
+	for (c = 0; c < num_channels; c++)
+		sr_simd_stats_init(&stream->stats[c]);
+	g_hash_table_replace(ctx->streams, key, stream);
+
+	return stream;
+}
+
+/* Store the statistics of a complete window, and start another one. */
+static void window_end(struct context *ctx, struct analog_stream *stream,
+		uint64_t row)
+{
+	struct sr_simd_stats *st;
+	float *out;
+	size_t c;
+
+	for (c = 0; c < stream->num_channels; c++) {
+		st = &stream->stats[c];
+		out = ctx->outbuf[STAT_MIN];
+		out[row * stream->num_channels + c] = st->min;
+		out = ctx->outbuf[STAT_MAX];
+		out[row * stream->num_channels + c] = st->max;
+		out = ctx->outbuf[STAT_MEAN];
+		out[row * stream->num_channels + c] = st->sum / ctx->window;
+		out = ctx->outbuf[STAT_RMS];
+		out[row * stream->num_channels + c] = sqrt(st->sum_sq / ctx->window);
+		sr_simd_stats_init(st);
+	}
+	stream->count = 0;
+}
+
+static int send_stats(const struct sr_transform *t,
+		const struct sr_datafeed_analog *analog,
+		struct analog_stream *stream, uint64_t num_rows)
+{
+	struct context *ctx;
+	size_t s;
+	int ret;
+
+	ctx = t->priv;
+
+	ctx->encoding = *analog->encoding;
+	ctx->encoding.unitsize = sizeof(float);
+	ctx->encoding.is_signed = TRUE;
+	ctx->encoding.is_float = TRUE;
+#ifdef WORDS_BIGENDIAN
+	ctx->encoding.is_bigendian = TRUE;
+#else
+	ctx->encoding.is_bigendian = FALSE;
+#endif
+	ctx->encoding.scale.p = 1;
+	ctx->encoding.scale.q = 1;
+	ctx->encoding.offset.p = 0;
+	ctx->encoding.offset.q = 1;
+	ctx->encoding.is_planar = FALSE;
+	ctx->encoding.sample_stride = 0;
+	ctx->encoding.channel_stride = 0;
+	ctx->spec = *analog->spec;
+	ctx->analog.num_samples = num_rows;
+	ctx->analog.encoding = &ctx->encoding;
+	ctx->analog.meaning = &ctx->meaning;
+	ctx->analog.spec = &ctx->spec;
+	ctx->packet.type = SR_DF_ANALOG;
+	ctx->packet.payload = &ctx->analog;
+
+	for (s = 0; s < NUM_STATS; s++) {
+		if (!ctx->enabled[s])
+			continue;
+		ctx->meaning = *analog->meaning;
+		ctx->meaning.mqflags |= stat_info[s].flag;
+		ctx->analog.data = ctx->outbuf[s];
+		ret = sr_transform_send(t, &ctx->packet, g_get_monotonic_time(),
+			stream->num_windows);
+		if (ret != SR_OK)
+			return ret;
+	}
+	stream->num_windows += num_rows;
+
+	return SR_OK;
+}
+
+static int stats_analog(const struct sr_transform *t,
+		const struct sr_datafeed_analog *analog)
+{
+	struct context *ctx;
+	struct analog_stream *stream;
+	const float *in;
+	size_t num_channels, c, s, size;
+	uint64_t pos, n, i, num_rows;
+
+	ctx = t->priv;
+	if (!analog->num_samples)
+		return SR_OK;
+
+	num_channels = g_slist_length(analog->meaning->channels);
+	if (!num_channels)
+		num_channels = 1;
+
+	/* Process all encodings as floats, like consumers do. */
+	if (ctx->inbuf_size < analog->num_samples * num_channels) {
+		g_free(ctx->inbuf);
+		ctx->inbuf_size = analog->num_samples * num_channels;
+		ctx->inbuf = g_malloc_n(ctx->inbuf_size, sizeof(float));
+	}
+	if (sr_analog_to_float_prepared(analog, ctx->inbuf) != SR_OK)
+		return SR_ERR_DATA;
+	in = ctx->inbuf;
+
+	stream = analog_stream_get(ctx, analog, num_channels);
+	size = (analog->num_samples / ctx->window + 1) * num_channels;
+	if (ctx->outbuf_size < size) {
+		for (s = 0; s < NUM_STATS; s++) {
+			g_free(ctx->outbuf[s]);
+			ctx->outbuf[s] = g_malloc_n(size, sizeof(float));
+		}
+		ctx->outbuf_size = size;
+	}
+
+	num_rows = 0;
+	for (pos = 0; pos < analog->num_samples; pos += n) {
+		n = MIN(ctx->window - stream->count, analog->num_samples - pos);
+		if (num_channels == 1) {
+			sr_simd_stats_float(&stream->stats[0], in + pos, n);
+		} else {
+			/* Reduce each channel's samples in a row. */
+			if (ctx->chan_size < n) {
+				g_free(ctx->chan_values);
+				ctx->chan_size = n;
+				ctx->chan_values = g_malloc_n(n, sizeof(float));
+			}
+			for (c = 0; c < num_channels; c++) {
+				for (i = 0; i < n; i++)
+					ctx->chan_values[i] =
+						in[(pos + i) * num_channels + c];
+				sr_simd_stats_float(&stream->stats[c],
+					ctx->chan_values, n);
+			}
+		}
+		stream->count += n;
+		if (stream->count == ctx->window)
+			window_end(ctx, stream, num_rows++);
+	}
+
+	if (!num_rows)
+		return SR_OK;
+
+	return send_stats(t, analog, stream, num_rows);
+}
+
+static int receive(const struct sr_transform *t,
+		struct sr_datafeed_packet *packet_in,
+		struct sr_datafeed_packet **packet_out)
+{
+	struct context *ctx;
+
+	if (!t || !t->sdi || !packet_in || !packet_out)
+		return SR_ERR_ARG;
+	ctx = t->priv;
+
+	switch (packet_in->type) {
+	case SR_DF_ANALOG:
+		/* The statistics are sent, the samples are dropped. */
+		*packet_out = NULL;
+		return stats_analog(t, packet_in->payload);
+	case SR_DF_HEADER:
+		/* Start over for a new acquisition. */
+		g_hash_table_remove_all(ctx->streams);
+		*packet_out = packet_in;
+		break;
+	default:
+		*packet_out = packet_in;
+		break;
+	}
+
+	return SR_OK;
+}
+
+static int cleanup(struct sr_transform *t)
+{
+	struct context *ctx;
+	size_t s;
+
+	if (!t || !t->sdi)
+		return SR_ERR_ARG;
+	ctx = t->priv;
+
+	g_hash_table_destroy(ctx->streams);
+	for (s = 0; s < NUM_STATS; s++)
+		g_free(ctx->outbuf[s]);
+	g_free(ctx->inbuf);
+	g_free(ctx->chan_values);
+	g_free(ctx);
+	t->priv = NULL;
+
+	return SR_OK;
+}
+
+static struct sr_option options[] = {
+	{ "window", "Window", "Number of input samples per statistics window", NULL, NULL },
+	{ "stats", "Statistics", "Comma separated list of min, max, mean and rms", NULL, NULL },
+	ALL_ZERO
+};
+
+static const struct sr_option *get_options(void)
+{
+	if (!options[0].def) {
+		options[0].def = g_variant_ref_sink(g_variant_new_uint64(1000));
+		options[1].def = g_variant_ref_sink(g_variant_new_string("min,max,mean,rms"));
+	}
+
+	return options;
+}
+
+SR_PRIV struct sr_transform_module transform_stats = {
+	.id = "stats",
+	.name = "Statistics",
+	.desc = "Minimum, maximum, mean and RMS of analog samples per window",
+	.options = get_options,
+	.init = init,
+	.receive = receive,
+	.cleanup = cleanup,
+};
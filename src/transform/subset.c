@@ -0,0 +1,315 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2026 libsigrok contributors
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <string.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+#define LOG_PREFIX "transform/subset"
+
+/* Where a selected channel's bit ends up in the packed samples. */
+struct channel_map {
+	struct sr_channel *ch;
+	unsigned int bit;
+};
+
+/* Logic channel state to restore when the stream ends. */
+struct saved_channel {
+	struct sr_channel *ch;
+	int index;
+	gboolean enabled;
+};
+
+struct context {
+	uint64_t mask;
+	struct sr_bit_extract be;
+	gboolean be_valid;
+
+	/* Selected channels, in packed bit order. */
+	struct channel_map *map;
+	size_t num_mapped;
+
+	/* The device's logic channels, while the packed layout is published. */
+	struct saved_channel *saved;
+	size_t num_saved;
+
+	/* Output packet, reused for every input packet. */
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic logic;
+	uint8_t *outbuf;
+	size_t outbuf_size;
+};
+
+/*
+ * The packed bit order follows the original bit order. Only the
+ * channels the map refers to are published to the consumers, see
+ * channels_publish().
+ */
+static void channels_map(struct context *ctx, const struct sr_dev_inst *sdi)
+{
+	struct sr_channel *ch;
+	GSList *l;
+	uint64_t bit, below;
+	size_t i;
+
+	for (l = sdi->channels; l; l = l->next) {
+		ch = l->data;
+		if (ch->type == SR_CHANNEL_LOGIC && ch->index < 64 &&
+				(ctx->mask & (UINT64_C(1) << ch->index)))
+			ctx->num_mapped++;
+	}
+	ctx->map = g_malloc0_n(ctx->num_mapped, sizeof(*ctx->map));
+	for (l = sdi->channels; l; l = l->next) {
+		ch = l->data;
+		if (ch->type != SR_CHANNEL_LOGIC || ch->index >= 64)
+			continue;
+		bit = UINT64_C(1) << ch->index;
+		if (!(ctx->mask & bit))
+			continue;
+		i = 0;
+		for (below = ctx->mask & (bit - 1); below; below &= below - 1)
+			i++;
+		ctx->map[i].ch = ch;
+		ctx->map[i].bit = i;
+	}
+}
+
+static void channels_log(const struct context *ctx)
+{
+	size_t i;
+
+	for (i = 0; i < ctx->num_mapped; i++)
+		sr_dbg("Channel %s (index %d) goes to bit %u.",
+			ctx->map[i].ch->name, ctx->map[i].ch->index,
+			ctx->map[i].bit);
+}
+
+/*
+ * Publish the packed layout to the consumers for the duration of the
+ * stream: each selected channel gets its packed bit as index, all other
+ * logic channels are disabled. Consumers which set up from the channels
+ * at the header, like outputs do, then read the right bits. Drivers have
+ * set up their acquisition from the channels by the time they send the
+ * header, and the channels are restored at the end of the stream.
+ */
+static void channels_publish(struct context *ctx,
+		const struct sr_dev_inst *sdi)
+{
+	struct sr_channel *ch;
+	struct saved_channel *sc;
+	GSList *l;
+	size_t i;
+
+	ctx->num_saved = 0;
+	for (l = sdi->channels; l; l = l->next) {
+		ch = l->data;
+		if (ch->type == SR_CHANNEL_LOGIC)
+			ctx->num_saved++;
+	}
+	ctx->saved = g_malloc_n(ctx->num_saved, sizeof(*ctx->saved));
+	sc = ctx->saved;
+	for (l = sdi->channels; l; l = l->next) {
+		ch = l->data;
+		if (ch->type != SR_CHANNEL_LOGIC)
+			continue;
+		sc->ch = ch;
+		sc->index = ch->index;
+		sc->enabled = ch->enabled;
+		sc++;
+		ch->enabled = FALSE;
+	}
+	for (i = 0; i < ctx->num_mapped; i++) {
+		ch = ctx->map[i].ch;
+		ch->index = ctx->map[i].bit;
+		ch->enabled = TRUE;
+	}
+}
+
+static void channels_restore(struct context *ctx)
+{
+	size_t i;
+
+	if (!ctx->saved)
+		return;
+	for (i = 0; i < ctx->num_saved; i++) {
+		ctx->saved[i].ch->index = ctx->saved[i].index;
+		ctx->saved[i].ch->enabled = ctx->saved[i].enabled;
+	}
+	g_free(ctx->saved);
+	ctx->saved = NULL;
+}
+
+static int init(struct sr_transform *t, GHashTable *options)
+{
+	struct context *ctx;
+	struct sr_channel *ch;
+	const char *names;
+	char **tokens;
+	GSList *l;
+	size_t i;
+	gboolean found;
+
+	if (!t || !t->sdi || !options)
+		return SR_ERR_ARG;
+
+	names = g_variant_get_string(g_hash_table_lookup(options, "channels"), NULL);
+	tokens = g_strsplit(names, ",", 0);
+	if (!tokens[0]) {
+		sr_err("No channels selected.");
+		g_strfreev(tokens);
+		return SR_ERR_ARG;
+	}
+
+	t->priv = ctx = g_malloc0(sizeof(struct context));
+	for (i = 0; tokens[i]; i++) {
+		found = FALSE;
+		for (l = t->sdi->channels; l; l = l->next) {
+			ch = l->data;
+			if (ch->type != SR_CHANNEL_LOGIC)
+				continue;
+			if (strcmp(ch->name, g_strstrip(tokens[i])))
+				continue;
+			if (ch->index >= 64) {
+				sr_err("Channel %s can't be selected.", ch->name);
+				break;
+			}
+			ctx->mask |= UINT64_C(1) << ch->index;
+			found = TRUE;
+			break;
+		}
+		if (!found) {
+			sr_err("Unknown logic channel '%s'.", tokens[i]);
+			g_strfreev(tokens);
+			g_free(ctx);
+			t->priv = NULL;
+			return SR_ERR_ARG;
+		}
+	}
+	g_strfreev(tokens);
+
+	channels_map(ctx, t->sdi);
+
+	return SR_OK;
+}
+
+static struct sr_datafeed_packet *pack_logic(struct context *ctx,
+		const struct sr_datafeed_logic *logic)
+{
+	uint64_t num_samples;
+	size_t size;
+
+	if (!logic->unitsize)
+		return NULL;
+
+	if (!ctx->be_valid || ctx->be.in_unitsize != logic->unitsize) {
+		sr_simd_bit_extract_init(&ctx->be, ctx->mask, logic->unitsize);
+		ctx->be_valid = TRUE;
+	}
+
+	num_samples = logic->length / logic->unitsize;
+	size = num_samples * ctx->be.out_unitsize;
+	if (ctx->outbuf_size < size) {
+		g_free(ctx->outbuf);
+		ctx->outbuf = g_malloc(size);
+		ctx->outbuf_size = size;
+	}
+	sr_simd_bit_extract(&ctx->be, logic->data, ctx->outbuf, num_samples);
+
+	ctx->logic.length = size;
+	ctx->logic.unitsize = ctx->be.out_unitsize;
+	ctx->logic.data = ctx->outbuf;
+	ctx->packet.type = SR_DF_LOGIC;
+	ctx->packet.payload = &ctx->logic;
+
+	return &ctx->packet;
+}
+
+static int receive(const struct sr_transform *t,
+		struct sr_datafeed_packet *packet_in,
+		struct sr_datafeed_packet **packet_out)
+{
+	struct context *ctx;
+
+	if (!t || !t->sdi || !packet_in || !packet_out)
+		return SR_ERR_ARG;
+	ctx = t->priv;
+
+	switch (packet_in->type) {
+	case SR_DF_LOGIC:
+		*packet_out = pack_logic(ctx, packet_in->payload);
+		break;
+	case SR_DF_HEADER:
+		channels_restore(ctx);
+		channels_log(ctx);
+		channels_publish(ctx, t->sdi);
+		*packet_out = packet_in;
+		break;
+	case SR_DF_END:
+		channels_restore(ctx);
+		*packet_out = packet_in;
+		break;
+	default:
+		sr_spew("Unsupported packet type %d, ignoring.", packet_in->type);
+		*packet_out = packet_in;
+		break;
+	}
+
+	return SR_OK;
+}
+
+static int cleanup(struct sr_transform *t)
+{
+	struct context *ctx;
+
+	if (!t || !t->sdi)
+		return SR_ERR_ARG;
+	ctx = t->priv;
+
+	channels_restore(ctx);
+	g_free(ctx->map);
+	g_free(ctx->outbuf);
+	g_free(ctx);
+	t->priv = NULL;
+
+	return SR_OK;
+}
+
+static struct sr_option options[] = {
+	{ "channels", "Channels", "Comma separated names of the logic channels to keep", NULL, NULL },
+	ALL_ZERO
+};
+
+static const struct sr_option *get_options(void)
+{
+	if (!options[0].def)
+		options[0].def = g_variant_ref_sink(g_variant_new_string(""));
+
+	return options;
+}
+
+SR_PRIV struct sr_transform_module transform_subset = {
+	.id = "subset",
+	.name = "Channel subset",
+	.desc = "Keep selected logic channels, packed into the smallest unitsize",
+	.options = get_options,
+	.init = init,
+	.receive = receive,
+	.cleanup = cleanup,
+};
@@ -45,12 +45,24 @@
 extern SR_PRIV struct sr_transform_module transform_nop;
 extern SR_PRIV struct sr_transform_module transform_scale;
 extern SR_PRIV struct sr_transform_module transform_invert;
+extern SR_PRIV struct sr_transform_module transform_decimate;
+extern SR_PRIV struct sr_transform_module transform_edges;
+extern SR_PRIV struct sr_transform_module transform_subset;
+extern SR_PRIV struct sr_transform_module transform_a2l;
+extern SR_PRIV struct sr_transform_module transform_repacketize;
+extern SR_PRIV struct sr_transform_module transform_stats;
 /** @endcond */
 
 static const struct sr_transform_module *transform_module_list[] = {
 	&transform_nop,
 	&transform_scale,
 	&transform_invert,
+	&transform_decimate,
+	&transform_edges,
+	&transform_subset,
+	&transform_a2l,
+	&transform_repacketize,
+	&transform_stats,
 	NULL,
 };
 
@@ -208,7 +220,7 @@ SR_API const struct sr_transform *sr_transform_new(const struct sr_transform_mod
 	gpointer key, value;
 	int i;
 
-	t = g_malloc(sizeof(struct sr_transform));
+	t = g_malloc0(sizeof(struct sr_transform));
 	t->module = tmod;
 	t->sdi = sdi;
 
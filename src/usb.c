@@ -24,6 +24,12 @@
 #include <memory.h>
 #include <glib.h>
 #include <libusb.h>
+#ifdef _WIN32
+#include <windows.h> /* for SetThreadPriority() */
+#elif defined(HAVE_PTHREAD_SETSCHEDPARAM)
+#include <pthread.h>
+#include <sched.h>
+#endif
 #include <libsigrok/libsigrok.h>
 #include "libsigrok-internal.h"
 
@@ -507,6 +513,289 @@ SR_PRIV int usb_get_port_path(libusb_device *dev, char *path, int path_len)
 	return SR_OK;
 }
 
+struct hotplug_callback {
+	sr_hotplug_callback cb;
+	void *cb_data;
+};
+
+static int LIBUSB_CALL hotplug_event(libusb_context *usb_ctx,
+		libusb_device *dev, libusb_hotplug_event event, void *user_data)
+{
+	struct sr_context *ctx;
+	struct hotplug_callback *hcb;
+	struct libusb_device_descriptor des;
+	GSList *l, *callbacks;
+	gboolean arrived;
+	char connection_id[64];
+
+	(void)usb_ctx;
+
+	ctx = user_data;
+	arrived = event == LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED;
+	g_mutex_lock(&ctx->usb_devices_mutex);
+	if (arrived) {
+		/* Keep the bus order, as enumerating gives it. */
+		ctx->usb_devices = g_slist_append(ctx->usb_devices,
+			libusb_ref_device(dev));
+	} else if ((l = g_slist_find(ctx->usb_devices, dev))) {
+		ctx->usb_devices = g_slist_delete_link(ctx->usb_devices, l);
+		libusb_unref_device(dev);
+	}
+	/* Subscribers may unsubscribe from within their callback. */
+	callbacks = NULL;
+	for (l = ctx->hotplug_callbacks; l; l = l->next)
+		callbacks = g_slist_prepend(callbacks,
+			g_memdup(l->data, sizeof(*hcb)));
+	callbacks = g_slist_reverse(callbacks);
+	g_mutex_unlock(&ctx->usb_devices_mutex);
+
+	if (callbacks) {
+		libusb_get_device_descriptor(dev, &des);
+		if (usb_get_port_path(dev, connection_id, sizeof(connection_id)) < 0)
+			snprintf(connection_id, sizeof(connection_id), "%d.%d",
+				libusb_get_bus_number(dev),
+				libusb_get_device_address(dev));
+		for (l = callbacks; l; l = l->next) {
+			hcb = l->data;
+			hcb->cb(ctx, arrived, des.idVendor, des.idProduct,
+				connection_id, hcb->cb_data);
+		}
+		g_slist_free_full(callbacks, g_free);
+	}
+
+	return 0;
+}
+
+/* Handle libusb events while anyone wants to hear about hotplug events. */
+static gpointer hotplug_thread(gpointer data)
+{
+	struct sr_context *ctx;
+	struct timeval tv;
+
+	ctx = data;
+	while (!g_atomic_int_get(&ctx->hotplug_stop)) {
+		tv.tv_sec = 0;
+		tv.tv_usec = 200 * 1000;
+		libusb_handle_events_timeout_completed(ctx->libusb_ctx, &tv, NULL);
+	}
+
+	return NULL;
+}
+
+/**
+ * Keep a list of the attached USB devices through libusb hotplug events,
+ * where the platform supports them, for sr_usb_device_list().
+ *
+ * @private
+ */
+SR_PRIV void sr_usb_hotplug_init(struct sr_context *ctx)
+{
+	int ret;
+
+	g_mutex_init(&ctx->usb_devices_mutex);
+	if (!libusb_has_capability(LIBUSB_CAP_HAS_HOTPLUG)) {
+		sr_dbg("No USB hotplug support, scans enumerate the bus.");
+		return;
+	}
+	/* Enumerating the present devices fills the list. */
+	ret = libusb_hotplug_register_callback(ctx->libusb_ctx,
+		LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED | LIBUSB_HOTPLUG_EVENT_DEVICE_LEFT,
+		LIBUSB_HOTPLUG_ENUMERATE, LIBUSB_HOTPLUG_MATCH_ANY,
+		LIBUSB_HOTPLUG_MATCH_ANY, LIBUSB_HOTPLUG_MATCH_ANY,
+		hotplug_event, ctx, &ctx->usb_hotplug_handle);
+	if (ret != LIBUSB_SUCCESS) {
+		sr_warn("Failed to register USB hotplug callback: %s.",
+			libusb_error_name(ret));
+		return;
+	}
+	ctx->usb_hotplug = TRUE;
+}
+
+/** @private */
+SR_PRIV void sr_usb_hotplug_cleanup(struct sr_context *ctx)
+{
+	if (ctx->hotplug_thread) {
+		g_atomic_int_set(&ctx->hotplug_stop, 1);
+		g_thread_join(ctx->hotplug_thread);
+		ctx->hotplug_thread = NULL;
+	}
+	if (ctx->usb_hotplug) {
+		libusb_hotplug_deregister_callback(ctx->libusb_ctx,
+			ctx->usb_hotplug_handle);
+		ctx->usb_hotplug = FALSE;
+	}
+	g_slist_free_full(ctx->usb_devices, (GDestroyNotify)libusb_unref_device);
+	ctx->usb_devices = NULL;
+	g_slist_free_full(ctx->hotplug_callbacks, g_free);
+	ctx->hotplug_callbacks = NULL;
+	g_mutex_clear(&ctx->usb_devices_mutex);
+}
+
+/**
+ * Get the list of attached USB devices, like libusb_get_device_list().
+ *
+ * While the hotplug thread handles libusb events, this returns the list
+ * kept by hotplug events instead of enumerating the bus again. Without
+ * it nothing keeps the list current, and this enumerates the bus. It
+ * doesn't handle libusb events itself, which could run the completions
+ * of a running acquisition on the caller's thread.
+ *
+ * @param ctx libsigrok context.
+ * @param[out] list NULL terminated array of referenced devices, to be
+ *                  freed with libusb_free_device_list().
+ *
+ * @return The number of devices, or a negative libusb error code.
+ *
+ * @private
+ */
+SR_PRIV ssize_t sr_usb_device_list(struct sr_context *ctx,
+		libusb_device ***list)
+{
+	libusb_device **devs;
+	GSList *l;
+	ssize_t i, count;
+
+	g_mutex_lock(&ctx->usb_devices_mutex);
+	if (!ctx->usb_hotplug || !ctx->hotplug_thread) {
+		g_mutex_unlock(&ctx->usb_devices_mutex);
+		return libusb_get_device_list(ctx->libusb_ctx, list);
+	}
+	count = g_slist_length(ctx->usb_devices);
+	/* Allocated like libusb does, libusb_free_device_list() frees it. */
+	devs = calloc(count + 1, sizeof(*devs));
+	if (!devs) {
+		g_mutex_unlock(&ctx->usb_devices_mutex);
+		return LIBUSB_ERROR_NO_MEM;
+	}
+	for (l = ctx->usb_devices, i = 0; l; l = l->next, i++)
+		devs[i] = libusb_ref_device(l->data);
+	g_mutex_unlock(&ctx->usb_devices_mutex);
+	*list = devs;
+
+	return count;
+}
+
+/** @private */
+SR_PRIV int sr_usb_hotplug_callback_add(struct sr_context *ctx,
+		sr_hotplug_callback cb, void *cb_data)
+{
+	struct hotplug_callback *hcb;
+
+	if (!ctx->usb_hotplug)
+		return SR_ERR_NA;
+
+	hcb = g_malloc0(sizeof(*hcb));
+	hcb->cb = cb;
+	hcb->cb_data = cb_data;
+	g_mutex_lock(&ctx->usb_devices_mutex);
+	ctx->hotplug_callbacks = g_slist_append(ctx->hotplug_callbacks, hcb);
+	if (!ctx->hotplug_thread)
+		ctx->hotplug_thread = g_thread_new("sr-usb-hotplug",
+			hotplug_thread, ctx);
+	g_mutex_unlock(&ctx->usb_devices_mutex);
+
+	return SR_OK;
+}
+
+/** @private */
+SR_PRIV int sr_usb_hotplug_callback_remove(struct sr_context *ctx,
+		sr_hotplug_callback cb, void *cb_data)
+{
+	struct hotplug_callback *hcb;
+	GSList *l;
+	int ret;
+
+	ret = SR_ERR_ARG;
+	g_mutex_lock(&ctx->usb_devices_mutex);
+	for (l = ctx->hotplug_callbacks; l; l = l->next) {
+		hcb = l->data;
+		if (hcb->cb != cb || hcb->cb_data != cb_data)
+			continue;
+		ctx->hotplug_callbacks = g_slist_delete_link(
+			ctx->hotplug_callbacks, l);
+		g_free(hcb);
+		ret = SR_OK;
+		break;
+	}
+	g_mutex_unlock(&ctx->usb_devices_mutex);
+
+	return ret;
+}
+
+/*
+ * Images last uploaded to the FPGAs of USB devices, so that reopening a
+ * device can skip uploading the image it still runs. Devices are known
+ * by bus and address, which change whenever a device re-enumerates,
+ * e.g. after a replug or an FX2 firmware upload.
+ */
+static GHashTable *fpga_images;
+static GMutex fpga_images_mutex;
+
+static char *fpga_image_key(const struct sr_usb_dev_inst *usb)
+{
+	return g_strdup_printf("%d.%d", usb->bus, usb->address);
+}
+
+/**
+ * Check whether a device still runs a given FPGA image.
+ *
+ * @param usb The device.
+ * @param name Name of the image resource.
+ * @param size Size of the image in bytes.
+ *
+ * @return TRUE if the image was the last one recorded for this device
+ *         by sr_usb_fpga_image_record().
+ *
+ * @private
+ */
+SR_PRIV gboolean sr_usb_fpga_image_current(const struct sr_usb_dev_inst *usb,
+		const char *name, uint64_t size)
+{
+	char *key, *image;
+	gboolean current;
+
+	key = fpga_image_key(usb);
+	image = g_strdup_printf("%s/%" PRIu64, name, size);
+	g_mutex_lock(&fpga_images_mutex);
+	current = fpga_images &&
+		!g_strcmp0(g_hash_table_lookup(fpga_images, key), image);
+	g_mutex_unlock(&fpga_images_mutex);
+	g_free(image);
+	g_free(key);
+
+	return current;
+}
+
+/**
+ * Record the FPGA image which a device runs.
+ *
+ * @param usb The device.
+ * @param name Name of the image resource, or NULL if the device's FPGA
+ *             state is unknown, e.g. while uploading.
+ * @param size Size of the image in bytes.
+ *
+ * @private
+ */
+SR_PRIV void sr_usb_fpga_image_record(const struct sr_usb_dev_inst *usb,
+		const char *name, uint64_t size)
+{
+	char *key;
+
+	key = fpga_image_key(usb);
+	g_mutex_lock(&fpga_images_mutex);
+	if (!fpga_images)
+		fpga_images = g_hash_table_new_full(g_str_hash, g_str_equal,
+			g_free, g_free);
+	if (name) {
+		g_hash_table_replace(fpga_images, key,
+			g_strdup_printf("%s/%" PRIu64, name, size));
+	} else {
+		g_hash_table_remove(fpga_images, key);
+		g_free(key);
+	}
+	g_mutex_unlock(&fpga_images_mutex);
+}
+
 /**
  * Check the USB configuration to determine if this device has a given
  * manufacturer and product string.
@@ -550,3 +839,1015 @@ SR_PRIV gboolean usb_match_manuf_prod(libusb_device *dev,
 
 	return ret;
 }
+
+/*
+ * Pools of USB bulk transfer buffers.
+ *
+ * Drivers keep one pool per device, and draw their transfer buffers
+ * from it across acquisitions instead of allocating them each time.
+ * Buffers are page aligned. When the pool is created for kernel memory,
+ * buffers are obtained with libusb_dev_mem_alloc() where supported, so
+ * transfers don't get bounced through an extra copy in the kernel.
+ *
+ * Every buffer is preceded by a header which refers back to its pool.
+ * This allows sr_usb_xfer_buf_release() to serve as a GDestroyNotify,
+ * e.g. for packet buffers which consumers hold on to, from any thread.
+ */
+
+#define USB_XFER_ALIGN	4096
+
+/** @cond PRIVATE */
+struct sr_usb_xfer_pool {
+	struct libusb_device_handle *devhdl;
+	size_t buffer_size;
+	gboolean dev_mem;
+	GMutex mutex;
+	/* Buffers which are ready for use. */
+	GSList *idle;
+	/* Number of buffers which are in use. */
+	unsigned int busy;
+	/* The owner freed the pool, free it once all buffers are back. */
+	gboolean freed;
+};
+
+struct usb_xfer_buf {
+	struct sr_usb_xfer_pool *pool;
+	/* Start of the allocation the buffer lives in. */
+	void *mem;
+	gboolean dev_mem;
+};
+/** @endcond */
+
+static struct usb_xfer_buf *xfer_buf_header(void *buf)
+{
+	return (struct usb_xfer_buf *)((uint8_t *)buf - sizeof(struct usb_xfer_buf));
+}
+
+static void *xfer_buf_alloc(struct sr_usb_xfer_pool *pool)
+{
+	struct usb_xfer_buf *hdr;
+	uint8_t *mem, *buf;
+	size_t size;
+	gboolean dev_mem;
+
+	/* The header goes into the page (heap: pages) before the buffer. */
+	size = pool->buffer_size + USB_XFER_ALIGN;
+	mem = NULL;
+	dev_mem = FALSE;
+#if (LIBUSB_API_VERSION >= 0x01000105)
+	if (pool->dev_mem) {
+		mem = libusb_dev_mem_alloc(pool->devhdl, size);
+		if (mem) {
+			dev_mem = TRUE;
+		} else {
+			sr_dbg("No kernel memory for USB transfers, using the heap.");
+			pool->dev_mem = FALSE;
+		}
+	}
+#endif
+	if (!mem) {
+		mem = sr_buffer_alloc(SR_MEM_TRANSFERS, size + USB_XFER_ALIGN);
+		if (!mem)
+			return NULL;
+	}
+
+	buf = mem + sizeof(*hdr);
+	buf += (USB_XFER_ALIGN - (uintptr_t)buf % USB_XFER_ALIGN) % USB_XFER_ALIGN;
+	hdr = xfer_buf_header(buf);
+	hdr->pool = pool;
+	hdr->mem = mem;
+	hdr->dev_mem = dev_mem;
+
+	return buf;
+}
+
+static void xfer_buf_free(struct sr_usb_xfer_pool *pool, void *buf)
+{
+	struct usb_xfer_buf *hdr;
+
+	hdr = xfer_buf_header(buf);
+#if (LIBUSB_API_VERSION >= 0x01000105)
+	if (hdr->dev_mem) {
+		/*
+		 * Kernel memory can't be released without the device
+		 * handle. Buffers held past the device's close leak.
+		 */
+		if (pool->devhdl)
+			libusb_dev_mem_free(pool->devhdl, hdr->mem,
+				pool->buffer_size + USB_XFER_ALIGN);
+		return;
+	}
+#else
+	(void)pool;
+#endif
+	sr_buffer_free(hdr->mem);
+}
+
+static void xfer_pool_destroy(struct sr_usb_xfer_pool *pool)
+{
+	g_mutex_clear(&pool->mutex);
+	g_free(pool);
+}
+
+/**
+ * Create a pool of USB transfer buffers for a device.
+ *
+ * @param usb The USB device instance, which must be open. The pool must
+ *            be freed before the device gets closed.
+ * @param buffer_size The size of the buffers in bytes.
+ * @param dev_mem TRUE to try and allocate kernel memory for zero-copy
+ *                transfers, FALSE to use heap memory.
+ *
+ * @return The new pool.
+ *
+ * @private
+ */
+SR_PRIV struct sr_usb_xfer_pool *sr_usb_xfer_pool_new(
+		struct sr_usb_dev_inst *usb, size_t buffer_size, gboolean dev_mem)
+{
+	struct sr_usb_xfer_pool *pool;
+
+	pool = g_malloc0(sizeof(*pool));
+	pool->devhdl = usb->devhdl;
+	pool->buffer_size = buffer_size;
+	pool->dev_mem = dev_mem;
+	g_mutex_init(&pool->mutex);
+
+	return pool;
+}
+
+/**
+ * Free a pool of USB transfer buffers.
+ *
+ * Buffers which are still in use get released when they are returned.
+ * Call this before the device gets closed, kernel memory buffers which
+ * are returned afterwards can't be released any more.
+ *
+ * @param pool The pool. Can be NULL.
+ *
+ * @private
+ */
+SR_PRIV void sr_usb_xfer_pool_free(struct sr_usb_xfer_pool *pool)
+{
+	GSList *l;
+	gboolean destroy;
+
+	if (!pool)
+		return;
+
+	g_mutex_lock(&pool->mutex);
+	pool->freed = TRUE;
+	for (l = pool->idle; l; l = l->next)
+		xfer_buf_free(pool, l->data);
+	g_slist_free(pool->idle);
+	pool->idle = NULL;
+	/* The device is about to be closed. */
+	pool->devhdl = NULL;
+	destroy = !pool->busy;
+	if (pool->busy)
+		sr_dbg("Freeing USB transfer pool, %u buffers still in use.",
+			pool->busy);
+	g_mutex_unlock(&pool->mutex);
+
+	if (destroy)
+		xfer_pool_destroy(pool);
+}
+
+/** @private */
+SR_PRIV size_t sr_usb_xfer_pool_buffer_size(const struct sr_usb_xfer_pool *pool)
+{
+	return pool->buffer_size;
+}
+
+/**
+ * Get a transfer buffer from a pool, allocate one if none is idle.
+ *
+ * @param pool The pool. Must not be NULL.
+ *
+ * @return A buffer of the pool's buffer size, or NULL upon allocation
+ *         failure. Release it with sr_usb_xfer_buf_release().
+ *
+ * @private
+ */
+SR_PRIV void *sr_usb_xfer_pool_get(struct sr_usb_xfer_pool *pool)
+{
+	void *buf;
+
+	g_mutex_lock(&pool->mutex);
+	if (pool->idle) {
+		buf = pool->idle->data;
+		pool->idle = g_slist_delete_link(pool->idle, pool->idle);
+	} else {
+		buf = xfer_buf_alloc(pool);
+	}
+	if (buf)
+		pool->busy++;
+	g_mutex_unlock(&pool->mutex);
+
+	return buf;
+}
+
+/**
+ * Return a transfer buffer to its pool.
+ *
+ * This is a GDestroyNotify, the buffer can be returned from any thread.
+ *
+ * @param buf The buffer, obtained from sr_usb_xfer_pool_get(). Can be NULL.
+ *
+ * @private
+ */
+SR_PRIV void sr_usb_xfer_buf_release(void *buf)
+{
+	struct sr_usb_xfer_pool *pool;
+	gboolean destroy;
+
+	if (!buf)
+		return;
+
+	pool = xfer_buf_header(buf)->pool;
+	g_mutex_lock(&pool->mutex);
+	pool->busy--;
+	destroy = pool->freed && !pool->busy;
+	if (pool->freed)
+		xfer_buf_free(pool, buf);
+	else
+		pool->idle = g_slist_prepend(pool->idle, buf);
+	g_mutex_unlock(&pool->mutex);
+
+	if (destroy)
+		xfer_pool_destroy(pool);
+}
+
+/*
+ * Asynchronous bulk streaming.
+ *
+ * A stream keeps a queue of bulk IN transfers in flight, and hands the
+ * data of every transfer to the driver's data callback. It deals with
+ * empty and failed transfers, resubmission, and the statistics of the
+ * device. Transfer buffers come from the device's pool. With zero-copy
+ * donation, the buffer is attached to the session while the data
+ * callback sends packets, so consumers can retain packets without
+ * copying. A fresh buffer from the pool replaces one they hold on to.
+ *
+ * In adaptive mode, the stream queues more transfers when it sees empty
+ * or late transfers. A transfer is late when more than half the queued
+ * transfers' worth of time has passed since the previous one completed.
+ *
+ * With an event thread, libusb events get handled on a thread of their
+ * own, at a raised priority where the system permits. Completed transfers
+ * are resubmitted right away with a fresh buffer from the pool, and the
+ * filled buffer goes to the session's thread through a single producer,
+ * single consumer ring. So slow datafeed callbacks no longer delay the
+ * resubmission of transfers, the pool absorbs them instead. Completions
+ * never wait for the session: when it fell behind by a whole ring, the
+ * transfer's data is dropped, and the session reports the loss as a gap
+ * and counts the transfer as late.
+ */
+
+/* Number of ring slots per transfer, for the session to fall behind. */
+#define STREAM_RING_DEPTH	4
+
+/** @cond PRIVATE */
+struct sr_usb_stream {
+	struct sr_dev_inst *sdi;
+	struct sr_usb_dev_inst *usb;
+	struct sr_usb_stream_params params;
+	/* Transfers, NULL once freed. Holds up to max_transfers. */
+	struct libusb_transfer **transfers;
+	unsigned int num_transfers;
+	unsigned int submitted;
+	unsigned int empty_count;
+	int64_t last_time;
+	gint stopping;
+
+	/* Event thread mode. */
+	GThread *thread;
+	int thread_stop;
+	GSource *source;
+	GMainContext *context;
+	/* Completions, filled up to tail by the event thread. */
+	struct stream_chunk *ring;
+	guint ring_size;
+	gint ring_head;
+	gint ring_tail;
+	/* Completions dropped on a full ring, and the bytes they carried. */
+	gint overruns;
+	gint overrun_bytes;
+	/* Dropped transfers which weren't resubmitted, for the session. */
+	GMutex overflow_mutex;
+	GSList *overflow;
+};
+
+struct stream_chunk {
+	/* The transfer, if it was not resubmitted. */
+	struct libusb_transfer *transfer;
+	enum libusb_transfer_status status;
+	gboolean resubmitted;
+	void *buffer;
+	int length;
+};
+
+struct stream_source {
+	GSource base;
+	struct sr_usb_stream *stream;
+	struct sr_session *session;
+};
+/** @endcond */
+
+static void LIBUSB_CALL stream_receive(struct libusb_transfer *transfer);
+static void LIBUSB_CALL stream_receive_threaded(struct libusb_transfer *transfer);
+
+static void stream_transfer_free(struct sr_usb_stream *stream,
+		struct libusb_transfer *transfer)
+{
+	unsigned int i;
+
+	sr_usb_xfer_buf_release(transfer->buffer);
+	transfer->buffer = NULL;
+	libusb_free_transfer(transfer);
+
+	for (i = 0; i < stream->num_transfers; i++) {
+		if (stream->transfers[i] == transfer) {
+			stream->transfers[i] = NULL;
+			break;
+		}
+	}
+
+	/* The event source finishes streams which have an event thread. */
+	if (--stream->submitted || stream->thread)
+		return;
+
+	/* This was the last transfer, the stream is done. */
+	if (stream->params.done_cb)
+		stream->params.done_cb(stream->sdi, stream->params.cb_data);
+	g_free(stream->transfers);
+	g_free(stream);
+}
+
+static int stream_submit(struct sr_usb_stream *stream, unsigned int timeout)
+{
+	struct sr_dev_inst *sdi;
+	struct libusb_transfer *transfer;
+	unsigned char *buf;
+	int ret;
+
+	sdi = stream->sdi;
+
+	if (!(buf = sr_usb_xfer_pool_get(stream->params.pool))) {
+		sr_err("USB transfer buffer malloc failed.");
+		return SR_ERR_MALLOC;
+	}
+	transfer = libusb_alloc_transfer(0);
+	libusb_fill_bulk_transfer(transfer, stream->usb->devhdl,
+		stream->params.endpoint, buf,
+		sr_usb_xfer_pool_buffer_size(stream->params.pool),
+		stream->params.event_thread ? stream_receive_threaded : stream_receive,
+		stream, timeout);
+	SR_PROBE2(usb_transfer_submit, transfer->endpoint, transfer->length);
+	if ((ret = libusb_submit_transfer(transfer)) != 0) {
+		sr_err("Failed to submit transfer: %s.", libusb_error_name(ret));
+		libusb_free_transfer(transfer);
+		sr_usb_xfer_buf_release(buf);
+		return SR_ERR;
+	}
+	stream->transfers[stream->num_transfers++] = transfer;
+	stream->submitted++;
+	if (stream->submitted > sdi->stats.max_transfers)
+		sdi->stats.max_transfers = stream->submitted;
+
+	return SR_OK;
+}
+
+static void stream_resubmit(struct sr_usb_stream *stream,
+		struct libusb_transfer *transfer)
+{
+	struct sr_dev_inst *sdi;
+	int ret;
+
+	sdi = stream->sdi;
+
+	SR_PROBE2(usb_transfer_submit, transfer->endpoint, transfer->length);
+	if ((ret = libusb_submit_transfer(transfer)) == LIBUSB_SUCCESS) {
+		sdi->stats.resubmitted_transfers++;
+		return;
+	}
+
+	sr_err("%s: %s", __func__, libusb_error_name(ret));
+	sdi->stats.dropped_transfers++;
+	stream_transfer_free(stream, transfer);
+}
+
+/* Tell consumers that the data of a transfer was lost. */
+static void stream_gap(struct sr_usb_stream *stream, int length,
+		enum sr_gap_reason reason)
+{
+	uint64_t num_samples;
+
+	num_samples = 0;
+	if (stream->params.unitsize && length > 0)
+		num_samples = length / stream->params.unitsize;
+	std_session_send_df_gap(stream->sdi, num_samples, reason);
+}
+
+static void stream_adapt(struct sr_usb_stream *stream, gboolean empty)
+{
+	struct sr_dev_inst *sdi;
+	const struct sr_usb_stream_params *params;
+	int64_t now, slack;
+	unsigned int i, n, timeout;
+	gboolean late;
+
+	sdi = stream->sdi;
+	params = &stream->params;
+
+	late = FALSE;
+	if (!empty && params->bytes_per_ms) {
+		now = g_get_monotonic_time();
+		if (stream->last_time) {
+			slack = (int64_t)stream->submitted *
+				sr_usb_xfer_pool_buffer_size(params->pool) *
+				1000 / params->bytes_per_ms / 2;
+			late = now - stream->last_time > slack;
+		}
+		stream->last_time = now;
+		if (late)
+			sdi->stats.late_transfers++;
+	}
+
+	if (!(empty || late) || stream->stopping)
+		return;
+	if (stream->num_transfers >= params->max_transfers)
+		return;
+
+	/* Grow the queue by a quarter, within the array's capacity. */
+	n = MAX(stream->submitted / 4, 1);
+	n = MIN(n, params->max_transfers - stream->num_transfers);
+	for (i = 0; i < n; i++) {
+		/* Transfers at the end of the queue wait longer. */
+		timeout = params->timeout * (stream->submitted + 1) /
+			params->num_transfers;
+		if (stream_submit(stream, timeout) != SR_OK)
+			break;
+	}
+	sr_dbg("%s transfer, %u transfers in flight now.",
+		empty ? "Empty" : "Late", stream->submitted);
+}
+
+static void LIBUSB_CALL stream_receive(struct libusb_transfer *transfer)
+{
+	struct sr_usb_stream *stream;
+	struct sr_dev_inst *sdi;
+	struct sr_packet_buffer *xfer_buf;
+	gboolean packet_has_error, more;
+
+	stream = transfer->user_data;
+	sdi = stream->sdi;
+	SR_PROBE3(usb_transfer_complete, transfer->endpoint, transfer->status,
+		transfer->actual_length);
+
+	/* Just free transfers which come in after the stream stopped. */
+	if (stream->stopping) {
+		stream_transfer_free(stream, transfer);
+		return;
+	}
+
+	sr_spew("Stream transfer: status %s, received %d bytes.",
+		libusb_error_name(transfer->status), transfer->actual_length);
+
+	packet_has_error = FALSE;
+	switch (transfer->status) {
+	case LIBUSB_TRANSFER_NO_DEVICE:
+		stream_gap(stream, 0, SR_GAP_ABORTED);
+		sr_usb_stream_stop(stream);
+		stream_transfer_free(stream, transfer);
+		return;
+	case LIBUSB_TRANSFER_COMPLETED:
+	case LIBUSB_TRANSFER_TIMED_OUT: /* We may have received some data though. */
+		break;
+	default:
+		packet_has_error = TRUE;
+		break;
+	}
+
+	if (transfer->actual_length == 0 || packet_has_error) {
+		stream->empty_count++;
+		sdi->stats.empty_transfers++;
+		if (packet_has_error)
+			stream_gap(stream, transfer->actual_length,
+				SR_GAP_TRANSFER);
+		if (stream->params.max_empty &&
+				stream->empty_count > stream->params.max_empty) {
+			/* The device gave up, end the stream short. */
+			stream_gap(stream, 0, SR_GAP_ABORTED);
+			sr_usb_stream_stop(stream);
+			stream_transfer_free(stream, transfer);
+		} else {
+			stream_adapt(stream, TRUE);
+			stream_resubmit(stream, transfer);
+		}
+		return;
+	}
+	stream->empty_count = 0;
+	sdi->stats.transfers++;
+	stream_adapt(stream, FALSE);
+
+	xfer_buf = NULL;
+	if (stream->params.zero_copy) {
+		/* Let consumers retain the transfer's data without copying it. */
+		xfer_buf = sr_packet_buffer_new(transfer->buffer,
+			transfer->length, sr_usb_xfer_buf_release);
+		sr_session_send_buffer_set(sdi->session, xfer_buf);
+	}
+
+	more = stream->params.data_cb(sdi, transfer->buffer,
+		transfer->actual_length, stream->params.cb_data);
+
+	/*
+	 * Keep using the transfer's buffer unless a consumer still holds
+	 * on to its data. Continue with a fresh buffer in that case.
+	 */
+	if (xfer_buf) {
+		sr_session_send_buffer_set(sdi->session, NULL);
+		if (!sr_packet_buffer_reclaim(xfer_buf)) {
+			transfer->buffer = sr_usb_xfer_pool_get(stream->params.pool);
+			if (!transfer->buffer) {
+				sr_err("Failed to allocate transfer buffer.");
+				more = FALSE;
+			}
+		}
+	}
+
+	if (!more || stream->stopping) {
+		sr_usb_stream_stop(stream);
+		stream_transfer_free(stream, transfer);
+		return;
+	}
+	stream_resubmit(stream, transfer);
+}
+
+/* Drops a completion which doesn't fit in the ring. */
+static void stream_overrun(struct sr_usb_stream *stream,
+		struct libusb_transfer *transfer)
+{
+	if (transfer->status == LIBUSB_TRANSFER_COMPLETED ||
+			transfer->status == LIBUSB_TRANSFER_TIMED_OUT) {
+		g_atomic_int_inc(&stream->overruns);
+		g_atomic_int_add(&stream->overrun_bytes, transfer->actual_length);
+	}
+
+	/* Reuse the buffer, its data is lost anyway. */
+	if (transfer->status != LIBUSB_TRANSFER_NO_DEVICE &&
+			transfer->status != LIBUSB_TRANSFER_CANCELLED &&
+			!g_atomic_int_get(&stream->stopping)) {
+		SR_PROBE2(usb_transfer_submit, transfer->endpoint,
+			transfer->length);
+		if (libusb_submit_transfer(transfer) == LIBUSB_SUCCESS)
+			return;
+	}
+
+	/* Only the session's thread frees transfers. */
+	g_mutex_lock(&stream->overflow_mutex);
+	stream->overflow = g_slist_prepend(stream->overflow, transfer);
+	g_mutex_unlock(&stream->overflow_mutex);
+	g_main_context_wakeup(stream->context);
+}
+
+/* Runs on the event thread, or wherever libusb events get handled. */
+static void LIBUSB_CALL stream_receive_threaded(struct libusb_transfer *transfer)
+{
+	struct sr_usb_stream *stream;
+	struct stream_chunk *chunk;
+	void *buf;
+	guint tail;
+
+	stream = transfer->user_data;
+	SR_PROBE3(usb_transfer_complete, transfer->endpoint, transfer->status,
+		transfer->actual_length);
+
+	tail = g_atomic_int_get(&stream->ring_tail);
+	if (tail - (guint)g_atomic_int_get(&stream->ring_head) >= stream->ring_size) {
+		/*
+		 * The session fell behind by a whole ring. Don't wait for
+		 * it, this may well run on the session's own thread.
+		 */
+		stream_overrun(stream, transfer);
+		return;
+	}
+	chunk = &stream->ring[tail & (stream->ring_size - 1)];
+	chunk->transfer = transfer;
+	chunk->status = transfer->status;
+	chunk->resubmitted = FALSE;
+	chunk->buffer = transfer->buffer;
+	chunk->length = transfer->actual_length;
+
+	/* Keep the transfer going with a fresh buffer, if there is one. */
+	transfer->buffer = NULL;
+	if (transfer->status != LIBUSB_TRANSFER_NO_DEVICE &&
+			transfer->status != LIBUSB_TRANSFER_CANCELLED &&
+			!g_atomic_int_get(&stream->stopping)) {
+		if (transfer->actual_length) {
+			buf = sr_usb_xfer_pool_get(stream->params.pool);
+		} else {
+			/* Nothing to pass on, keep the buffer. */
+			buf = chunk->buffer;
+			chunk->buffer = NULL;
+		}
+		if (buf) {
+			transfer->buffer = buf;
+			SR_PROBE2(usb_transfer_submit, transfer->endpoint,
+				transfer->length);
+			if (libusb_submit_transfer(transfer) == LIBUSB_SUCCESS) {
+				chunk->transfer = NULL;
+				chunk->resubmitted = TRUE;
+			} else {
+				transfer->buffer = NULL;
+				if (chunk->buffer)
+					sr_usb_xfer_buf_release(buf);
+				else
+					chunk->buffer = buf;
+			}
+		}
+	}
+
+	g_atomic_int_set(&stream->ring_tail, tail + 1);
+	g_main_context_wakeup(stream->context);
+}
+
+/* Handles a completion on the session's thread. */
+static void stream_process_chunk(struct sr_usb_stream *stream,
+		struct stream_chunk *chunk)
+{
+	struct sr_dev_inst *sdi;
+	struct sr_packet_buffer *xfer_buf;
+	gboolean more;
+
+	sdi = stream->sdi;
+
+	if (chunk->resubmitted)
+		sdi->stats.resubmitted_transfers++;
+	else if (!g_atomic_int_get(&stream->stopping) &&
+			chunk->status != LIBUSB_TRANSFER_NO_DEVICE)
+		sdi->stats.dropped_transfers++;
+
+	if (g_atomic_int_get(&stream->stopping)) {
+		sr_usb_xfer_buf_release(chunk->buffer);
+	} else if (chunk->status == LIBUSB_TRANSFER_NO_DEVICE) {
+		sr_usb_xfer_buf_release(chunk->buffer);
+		stream_gap(stream, 0, SR_GAP_ABORTED);
+		sr_usb_stream_stop(stream);
+	} else if (!chunk->length || (chunk->status != LIBUSB_TRANSFER_COMPLETED &&
+			chunk->status != LIBUSB_TRANSFER_TIMED_OUT)) {
+		sr_usb_xfer_buf_release(chunk->buffer);
+		stream->empty_count++;
+		sdi->stats.empty_transfers++;
+		if (chunk->status != LIBUSB_TRANSFER_COMPLETED &&
+				chunk->status != LIBUSB_TRANSFER_TIMED_OUT)
+			stream_gap(stream, chunk->length, SR_GAP_TRANSFER);
+		if (stream->params.max_empty &&
+				stream->empty_count > stream->params.max_empty) {
+			stream_gap(stream, 0, SR_GAP_ABORTED);
+			sr_usb_stream_stop(stream);
+		} else {
+			stream_adapt(stream, TRUE);
+		}
+	} else {
+		stream->empty_count = 0;
+		sdi->stats.transfers++;
+		stream_adapt(stream, FALSE);
+
+		xfer_buf = NULL;
+		if (stream->params.zero_copy) {
+			xfer_buf = sr_packet_buffer_new(chunk->buffer,
+				sr_usb_xfer_pool_buffer_size(stream->params.pool),
+				sr_usb_xfer_buf_release);
+			sr_session_send_buffer_set(sdi->session, xfer_buf);
+		}
+		more = stream->params.data_cb(sdi, chunk->buffer,
+			chunk->length, stream->params.cb_data);
+		if (xfer_buf) {
+			sr_session_send_buffer_set(sdi->session, NULL);
+			/* Consumers which hold on to the data release it. */
+			if (sr_packet_buffer_reclaim(xfer_buf))
+				sr_usb_xfer_buf_release(chunk->buffer);
+		} else {
+			sr_usb_xfer_buf_release(chunk->buffer);
+		}
+		if (!more)
+			sr_usb_stream_stop(stream);
+	}
+
+	if (chunk->transfer)
+		stream_transfer_free(stream, chunk->transfer);
+}
+
+/* Accounts for the completions which the ring couldn't take. */
+static void stream_process_overruns(struct sr_usb_stream *stream)
+{
+	struct sr_dev_inst *sdi;
+	struct libusb_transfer *transfer;
+	GSList *overflow, *l;
+	int count, length;
+
+	sdi = stream->sdi;
+
+	if ((count = g_atomic_int_get(&stream->overruns))) {
+		length = g_atomic_int_get(&stream->overrun_bytes);
+		g_atomic_int_add(&stream->overruns, -count);
+		g_atomic_int_add(&stream->overrun_bytes, -length);
+		sdi->stats.late_transfers += count;
+		sr_dbg("Session fell behind, dropped %d transfers.", count);
+		if (!g_atomic_int_get(&stream->stopping))
+			stream_gap(stream, length, SR_GAP_TRANSFER);
+	}
+
+	g_mutex_lock(&stream->overflow_mutex);
+	overflow = stream->overflow;
+	stream->overflow = NULL;
+	g_mutex_unlock(&stream->overflow_mutex);
+
+	for (l = overflow; l; l = l->next) {
+		transfer = l->data;
+		if (!g_atomic_int_get(&stream->stopping)) {
+			if (transfer->status == LIBUSB_TRANSFER_NO_DEVICE) {
+				stream_gap(stream, 0, SR_GAP_ABORTED);
+				sr_usb_stream_stop(stream);
+			} else {
+				sdi->stats.dropped_transfers++;
+			}
+		}
+		stream_transfer_free(stream, transfer);
+	}
+	g_slist_free(overflow);
+}
+
+static gboolean stream_source_pending(struct sr_usb_stream *stream)
+{
+	return g_atomic_int_get(&stream->ring_tail) != stream->ring_head ||
+		g_atomic_int_get(&stream->overruns) ||
+		g_atomic_pointer_get(&stream->overflow);
+}
+
+static gboolean stream_source_prepare(GSource *source, int *timeout)
+{
+	*timeout = -1;
+
+	return stream_source_pending(((struct stream_source *)source)->stream);
+}
+
+static gboolean stream_source_check(GSource *source)
+{
+	return stream_source_pending(((struct stream_source *)source)->stream);
+}
+
+static void stream_destroy(struct sr_usb_stream *stream, gboolean done);
+
+static gboolean stream_source_dispatch(GSource *source,
+		GSourceFunc callback, void *user_data)
+{
+	struct sr_usb_stream *stream;
+	guint head, tail;
+
+	(void)callback;
+	(void)user_data;
+
+	stream = ((struct stream_source *)source)->stream;
+
+	stream_process_overruns(stream);
+	if (!stream->submitted) {
+		stream_destroy(stream, TRUE);
+		return G_SOURCE_REMOVE;
+	}
+
+	head = stream->ring_head;
+	tail = g_atomic_int_get(&stream->ring_tail);
+	while (head != tail) {
+		stream_process_chunk(stream,
+			&stream->ring[head & (stream->ring_size - 1)]);
+		g_atomic_int_set(&stream->ring_head, ++head);
+		if (!stream->submitted) {
+			/* This was the last transfer, the stream is done. */
+			stream_destroy(stream, TRUE);
+			return G_SOURCE_REMOVE;
+		}
+	}
+
+	return G_SOURCE_CONTINUE;
+}
+
+static void stream_source_finalize(GSource *source)
+{
+	struct stream_source *ssource;
+
+	ssource = (struct stream_source *)source;
+	sr_session_source_destroyed(ssource->session, ssource->stream, source);
+}
+
+static void raise_thread_priority(void)
+{
+#ifdef _WIN32
+	if (!SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL))
+		sr_dbg("Cannot raise the USB event thread's priority.");
+#elif defined(HAVE_PTHREAD_SETSCHEDPARAM)
+	struct sched_param param;
+
+	memset(&param, 0, sizeof(param));
+	param.sched_priority = sched_get_priority_min(SCHED_RR);
+	if (pthread_setschedparam(pthread_self(), SCHED_RR, &param) != 0)
+		sr_dbg("Cannot raise the USB event thread's priority.");
+#endif
+}
+
+static gpointer stream_event_thread(gpointer data)
+{
+	struct sr_usb_stream *stream;
+	struct drv_context *drvc;
+	const struct sr_thread_sched *sched;
+	struct timeval tv;
+
+	stream = data;
+	drvc = stream->sdi->driver->context;
+
+	/* Use the session's settings, or run above normal threads. */
+	sched = sr_session_thread_sched_get(stream->sdi->session,
+		SR_THREAD_USB_EVENTS);
+	if (sched)
+		sr_thread_sched_apply(sched, "USB event");
+	else
+		raise_thread_priority();
+	while (!g_atomic_int_get(&stream->thread_stop)) {
+		tv.tv_sec = 0;
+		tv.tv_usec = 100 * 1000;
+		libusb_handle_events_timeout_completed(drvc->sr_ctx->libusb_ctx,
+			&tv, &stream->thread_stop);
+	}
+
+	return NULL;
+}
+
+static int stream_thread_start(struct sr_usb_stream *stream)
+{
+	static GSourceFuncs stream_source_funcs = {
+		.prepare  = &stream_source_prepare,
+		.check    = &stream_source_check,
+		.dispatch = &stream_source_dispatch,
+		.finalize = &stream_source_finalize
+	};
+	struct stream_source *ssource;
+	struct sr_session *session;
+	GError *error;
+	int ret;
+
+	session = stream->sdi->session;
+
+	g_mutex_init(&stream->overflow_mutex);
+	stream->ring_size = 1;
+	while (stream->ring_size < STREAM_RING_DEPTH * stream->params.max_transfers)
+		stream->ring_size <<= 1;
+	stream->ring = g_malloc0(stream->ring_size * sizeof(stream->ring[0]));
+
+	stream->source = g_source_new(&stream_source_funcs, sizeof(*ssource));
+	ssource = (struct stream_source *)stream->source;
+	ssource->stream = stream;
+	ssource->session = session;
+	g_source_set_name(stream->source, "usb-stream");
+	g_source_set_priority(stream->source, G_PRIORITY_HIGH);
+	ret = sr_session_source_add_internal(session, stream, stream->source);
+	if (ret != SR_OK) {
+		g_source_unref(stream->source);
+		return ret;
+	}
+	stream->context = g_main_context_ref(g_source_get_context(stream->source));
+
+	error = NULL;
+	stream->thread = g_thread_try_new("usb-events", stream_event_thread,
+		stream, &error);
+	if (!stream->thread) {
+		sr_err("Cannot start the USB event thread: %s.", error->message);
+		g_error_free(error);
+		sr_session_source_remove_internal(session, stream);
+		g_main_context_unref(stream->context);
+		g_source_unref(stream->source);
+		return SR_ERR;
+	}
+
+	return SR_OK;
+}
+
+static void stream_destroy(struct sr_usb_stream *stream, gboolean done)
+{
+	struct sr_session *session;
+
+	session = stream->sdi->session;
+
+	g_atomic_int_set(&stream->thread_stop, 1);
+	g_thread_join(stream->thread);
+
+	if (done && stream->params.done_cb)
+		stream->params.done_cb(stream->sdi, stream->params.cb_data);
+
+	sr_session_source_remove_internal(session, stream);
+	g_source_unref(stream->source);
+	g_main_context_unref(stream->context);
+	g_mutex_clear(&stream->overflow_mutex);
+	g_free(stream->ring);
+	g_free(stream->transfers);
+	g_free(stream);
+}
+
+/**
+ * Start streaming from a bulk IN endpoint.
+ *
+ * Submits params->num_transfers transfers of the pool's buffer size.
+ * The data callback gets the data of every transfer which carried any,
+ * and stops the stream by returning FALSE. The done callback runs after
+ * all transfers have come back, from the libusb event handling.
+ *
+ * @param sdi The device instance, its conn must be an open USB device.
+ * @param params The stream parameters, which get copied.
+ * @param stream Returns the stream, which is valid until the done
+ *               callback returns. It's NULL when the done callback
+ *               won't run.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval SR_ERR Submitting the transfers failed. When some transfers
+ *                were submitted, the stream is returned all the same,
+ *                and the done callback runs once they have been
+ *                cancelled.
+ *
+ * @private
+ */
+SR_PRIV int sr_usb_stream_start(struct sr_dev_inst *sdi,
+		const struct sr_usb_stream_params *params,
+		struct sr_usb_stream **stream)
+{
+	struct sr_usb_stream *s;
+	unsigned int i;
+	int ret;
+
+	if (!sdi || !sdi->conn || !params || !params->pool ||
+			!params->data_cb || !params->num_transfers || !stream)
+		return SR_ERR_ARG;
+	*stream = NULL;
+
+	s = g_malloc0(sizeof(*s));
+	s->sdi = sdi;
+	s->usb = sdi->conn;
+	s->params = *params;
+	if (s->params.max_transfers < s->params.num_transfers)
+		s->params.max_transfers = s->params.num_transfers;
+	s->transfers = g_malloc0(s->params.max_transfers * sizeof(s->transfers[0]));
+
+	if (s->params.event_thread && (ret = stream_thread_start(s)) != SR_OK) {
+		g_mutex_clear(&s->overflow_mutex);
+		g_free(s->ring);
+		g_free(s->transfers);
+		g_free(s);
+		return ret;
+	}
+
+	for (i = 0; i < s->params.num_transfers; i++) {
+		sr_dbg("Submitting transfer %u.", i);
+		if ((ret = stream_submit(s, s->params.timeout)) == SR_OK)
+			continue;
+		if (!s->submitted) {
+			if (s->thread)
+				stream_destroy(s, FALSE);
+			else {
+				g_free(s->transfers);
+				g_free(s);
+			}
+			return ret;
+		}
+		*stream = s;
+		sr_usb_stream_stop(s);
+		return ret;
+	}
+	*stream = s;
+
+	return SR_OK;
+}
+
+/**
+ * Stop a stream, cancel all of its transfers.
+ *
+ * The done callback runs once they have come back. It's fine to call
+ * this several times, also from the data callback.
+ *
+ * @param stream The stream. Can be NULL.
+ *
+ * @private
+ */
+SR_PRIV void sr_usb_stream_stop(struct sr_usb_stream *stream)
+{
+	unsigned int i;
+
+	if (!stream || g_atomic_int_get(&stream->stopping))
+		return;
+
+	g_atomic_int_set(&stream->stopping, TRUE);
+	for (i = stream->num_transfers; i > 0; i--) {
+		if (stream->transfers[i - 1])
+			libusb_cancel_transfer(stream->transfers[i - 1]);
+	}
+}
@@ -19,6 +19,7 @@
 
 #include <config.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 #include <check.h>
 #include <libsigrok/libsigrok.h>
@@ -428,6 +429,145 @@ START_TEST(test_analog_to_float_conv)
 }
 END_TEST
 
+START_TEST(test_analog_to_float_prepared)
+{
+	int ret;
+	unsigned int i;
+	uint8_t data[37 * 2];
+	float fout[37];
+	struct sr_channel ch;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+
+	for (i = 0; i < ARRAY_SIZE(data); i++)
+		data[i] = i * 7;
+
+	sr_analog_init_(&analog, &encoding, &meaning, &spec, 3);
+	analog.num_samples = ARRAY_SIZE(fout);
+	analog.data = data;
+	meaning.channels = g_slist_append(NULL, &ch);
+	encoding.is_float = FALSE;
+	encoding.unitsize = 1;
+	encoding.scale.p = 1;
+	encoding.scale.q = 4;
+	encoding.offset.p = 3;
+	encoding.offset.q = 1;
+
+	ret = sr_analog_to_float_prepared(&analog, fout);
+	fail_unless(ret == SR_OK, "unsigned 8 bit conversion failed: %d.", ret);
+	for (i = 0; i < ARRAY_SIZE(fout); i++)
+		fail_unless(fout[i] == (float)(data[i] / 4.0 + 3),
+			"u8 %u: %f", i, fout[i]);
+
+	/* A changed encoding must pick its own conversion. */
+	encoding.is_signed = TRUE;
+	ret = sr_analog_to_float_prepared(&analog, fout);
+	fail_unless(ret == SR_OK, "signed 8 bit conversion failed: %d.", ret);
+	for (i = 0; i < ARRAY_SIZE(fout); i++)
+		fail_unless(fout[i] == (float)((int8_t)data[i] / 4.0 + 3),
+			"i8 %u: %f", i, fout[i]);
+
+	encoding.unitsize = 2;
+	ret = sr_analog_to_float_prepared(&analog, fout);
+	fail_unless(ret == SR_OK, "signed 16 bit conversion failed: %d.", ret);
+	for (i = 0; i < ARRAY_SIZE(fout); i++)
+		fail_unless(fout[i] == (float)((int16_t)(data[2 * i] |
+			data[2 * i + 1] << 8) / 4.0 + 3), "i16 %u: %f", i, fout[i]);
+
+	g_slist_free(meaning.channels);
+}
+END_TEST
+
+START_TEST(test_analog_to_double)
+{
+	int ret;
+	unsigned int i;
+	size_t count;
+	const void *raw;
+	struct sr_rational scale;
+	double dout[3];
+	struct sr_channel ch;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+	/* Values which don't fit the precision of a float. */
+	const int32_t v[] = {16777217, -16777219, 2147483647};
+
+	sr_analog_init_(&analog, &encoding, &meaning, &spec, 0);
+	analog.num_samples = ARRAY_SIZE(v);
+	analog.data = (void *)v;
+	meaning.channels = g_slist_append(NULL, &ch);
+	encoding.is_float = FALSE;
+	encoding.is_signed = TRUE;
+	encoding.unitsize = sizeof(int32_t);
+#ifdef WORDS_BIGENDIAN
+	encoding.is_bigendian = TRUE;
+#endif
+
+	ret = sr_analog_to_double(&analog, dout);
+	fail_unless(ret == SR_OK, "sr_analog_to_double() failed: %d.", ret);
+	for (i = 0; i < ARRAY_SIZE(v); i++)
+		fail_unless(dout[i] == v[i], "%f != %d", dout[i], v[i]);
+
+	ret = sr_analog_get_raw(&analog, &raw, &count, &scale, NULL);
+	fail_unless(ret == SR_OK, "sr_analog_get_raw() failed: %d.", ret);
+	fail_unless(raw == v && count == ARRAY_SIZE(v));
+	fail_unless(scale.p == 1 && scale.q == 1);
+
+	/* Samples in the foreign byte order can't be passed through. */
+	encoding.is_bigendian = !encoding.is_bigendian;
+	ret = sr_analog_get_raw(&analog, &raw, &count, NULL, NULL);
+	fail_unless(ret == SR_ERR);
+
+	g_slist_free(meaning.channels);
+}
+END_TEST
+
+START_TEST(test_analog_to_float_planar)
+{
+	int ret;
+	unsigned int i;
+	float fout[6];
+	struct sr_channel ch1, ch2;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+	/* Three samples of two channels, each sample followed by a pad. */
+	const int8_t planar[] = {1, 2, 3, 4, 5, 6};
+	const int8_t padded[] = {1, 99, 2, 99, 3, 99, 4, 99, 5, 99, 6, 99};
+	const float expected[] = {1, 4, 2, 5, 3, 6};
+
+	sr_analog_init_(&analog, &encoding, &meaning, &spec, 0);
+	analog.num_samples = 3;
+	meaning.channels = g_slist_append(NULL, &ch1);
+	meaning.channels = g_slist_append(meaning.channels, &ch2);
+	encoding.is_float = FALSE;
+	encoding.is_signed = TRUE;
+	encoding.unitsize = 1;
+
+	analog.data = (void *)planar;
+	encoding.is_planar = TRUE;
+	ret = sr_analog_to_float(&analog, fout);
+	fail_unless(ret == SR_OK, "planar conversion failed: %d.", ret);
+	for (i = 0; i < ARRAY_SIZE(fout); i++)
+		fail_unless(fout[i] == expected[i], "planar %u: %f", i, fout[i]);
+
+	analog.data = (void *)padded;
+	encoding.sample_stride = 2;
+	encoding.channel_stride = 6;
+	ret = sr_analog_to_float_prepared(&analog, fout);
+	fail_unless(ret == SR_OK, "strided conversion failed: %d.", ret);
+	for (i = 0; i < ARRAY_SIZE(fout); i++)
+		fail_unless(fout[i] == expected[i], "strided %u: %f", i, fout[i]);
+
+	g_slist_free(meaning.channels);
+}
+END_TEST
+
 START_TEST(test_analog_si_prefix)
 {
 	struct {
@@ -478,6 +618,40 @@ START_TEST(test_analog_si_prefix)
 }
 END_TEST
 
+START_TEST(test_analog_format_values)
+{
+	int ret;
+	GString *out;
+	struct sr_channel ch1, ch2;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+	const float v[] = {0.0123, 2000, NAN, 5};
+
+	ch1.name = "A";
+	ch2.name = "B";
+	sr_analog_init_(&analog, &encoding, &meaning, &spec, 3);
+	analog.num_samples = 2;
+	meaning.channels = g_slist_append(NULL, &ch1);
+	meaning.channels = g_slist_append(meaning.channels, &ch2);
+	meaning.unit = SR_UNIT_VOLT;
+	meaning.mqflags = SR_MQFLAG_DC;
+
+	out = g_string_new(NULL);
+	ret = sr_analog_format_values(&analog, v, 3, out);
+	fail_unless(ret == SR_OK);
+	fail_unless(!strcmp(out->str, "A: 12 mV DC\nB: 2.000000 kV DC\n"
+		"A: nan V DC\nB: 5.000 V DC\n"), "Unexpected output: %s", out->str);
+	g_string_free(out, TRUE);
+
+	ret = sr_analog_format_values(&analog, v, 3, NULL);
+	fail_unless(ret == SR_ERR_ARG);
+
+	g_slist_free(meaning.channels);
+}
+END_TEST
+
 START_TEST(test_analog_si_prefix_null)
 {
 	float value = 1.23;
@@ -634,6 +808,19 @@ START_TEST(test_mult_rational)
 			"sr_rational_mult() failed: [%d] %ld/%lu != %ld/%lu.",
 			i, res.p, res.q, r[i][2].p, r[i][2].q);
 	}
+
+#ifdef HAVE___INT128_T
+	{
+		/* Products of odd factors only, need a full reduction. */
+		const struct sr_rational a = { 7450580596923828125ll, 3 };
+		const struct sr_rational b = { 3, 7450580596923828125ull };
+		const struct sr_rational one = { 1, 1 };
+		struct sr_rational res;
+
+		fail_unless(sr_rational_mult(&res, &a, &b) == SR_OK);
+		fail_unless(sr_rational_eq(&res, &one) == 1);
+	}
+#endif
 }
 END_TEST
 
@@ -681,6 +868,89 @@ START_TEST(test_div_rational)
 }
 END_TEST
 
+/*
+ * Check the analog-to-logic conversions on more samples than fit in a
+ * vector, with a Schmitt trigger state carried across calls.
+ */
+START_TEST(test_a2l)
+{
+	int ret;
+	unsigned int i;
+	float f[37];
+	uint8_t out[ARRAY_SIZE(f)], state, expect;
+	struct sr_channel ch;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+
+	sr_analog_init_(&analog, &encoding, &meaning, &spec, 3);
+	analog.num_samples = ARRAY_SIZE(f);
+	analog.data = f;
+	meaning.channels = g_slist_append(NULL, &ch);
+	for (i = 0; i < ARRAY_SIZE(f); i++)
+		f[i] = (i % 10) / 10.0;
+
+	ret = sr_a2l_threshold(&analog, 0.5, out, ARRAY_SIZE(f));
+	fail_unless(ret == SR_OK, "sr_a2l_threshold() failed: %d.", ret);
+	for (i = 0; i < ARRAY_SIZE(f); i++)
+		fail_unless(out[i] == (f[i] >= 0.5), "Sample %u: %u.", i, out[i]);
+
+	state = 1;
+	ret = sr_a2l_schmitt_trigger(&analog, 0.25, 0.75, &state, out,
+		ARRAY_SIZE(f));
+	fail_unless(ret == SR_OK, "sr_a2l_schmitt_trigger() failed: %d.", ret);
+	expect = 1;
+	for (i = 0; i < ARRAY_SIZE(f); i++) {
+		if (f[i] < 0.25)
+			expect = 0;
+		else if (f[i] > 0.75)
+			expect = 1;
+		fail_unless(out[i] == expect, "Sample %u: %u.", i, out[i]);
+	}
+	fail_unless(state == expect);
+
+	g_slist_free(meaning.channels);
+}
+END_TEST
+
+START_TEST(test_a2l_multi)
+{
+	int ret;
+	unsigned int i, c;
+	float f[3 * 37];
+	const float thresholds[] = {0.2, 0.5, 0.8};
+	uint8_t out[37], expect;
+	struct sr_channel ch[3];
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+
+	sr_analog_init_(&analog, &encoding, &meaning, &spec, 3);
+	analog.num_samples = ARRAY_SIZE(out);
+	analog.data = f;
+	meaning.channels = NULL;
+	for (c = 0; c < ARRAY_SIZE(ch); c++)
+		meaning.channels = g_slist_append(meaning.channels, &ch[c]);
+	for (i = 0; i < ARRAY_SIZE(f); i++)
+		f[i] = (i % 11) / 10.0;
+
+	ret = sr_a2l_threshold_multi(&analog, thresholds, out, ARRAY_SIZE(out));
+	fail_unless(ret == SR_OK, "sr_a2l_threshold_multi() failed: %d.", ret);
+	for (i = 0; i < ARRAY_SIZE(out); i++) {
+		expect = 0;
+		for (c = 0; c < ARRAY_SIZE(ch); c++) {
+			if (f[3 * i + c] >= thresholds[c])
+				expect |= 1 << c;
+		}
+		fail_unless(out[i] == expect, "Sample %u: %02x.", i, out[i]);
+	}
+
+	g_slist_free(meaning.channels);
+}
+END_TEST
+
 Suite *suite_analog(void)
 {
 	Suite *s;
@@ -694,11 +964,15 @@ Suite *suite_analog(void)
 	tcase_add_test(tc, test_analog_to_float);
 	tcase_add_test(tc, test_analog_to_float_null);
 	tcase_add_test(tc, test_analog_to_float_conv);
+	tcase_add_test(tc, test_analog_to_float_prepared);
+	tcase_add_test(tc, test_analog_to_double);
+	tcase_add_test(tc, test_analog_to_float_planar);
 	suite_add_tcase(s, tc);
 
 	tc = tcase_create("analog_si_unit");
 	tcase_add_test(tc, test_analog_si_prefix);
 	tcase_add_test(tc, test_analog_si_prefix_null);
+	tcase_add_test(tc, test_analog_format_values);
 	tcase_add_test(tc, test_analog_unit_to_string);
 	tcase_add_test(tc, test_analog_unit_to_string_null);
 	suite_add_tcase(s, tc);
@@ -711,5 +985,10 @@ Suite *suite_analog(void)
 	tcase_add_test(tc, test_div_rational);
 	suite_add_tcase(s, tc);
 
+	tc = tcase_create("a2l");
+	tcase_add_test(tc, test_a2l);
+	tcase_add_test(tc, test_a2l_multi);
+	suite_add_tcase(s, tc);
+
 	return s;
 }
@@ -0,0 +1,569 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Micro-benchmarks of the core hot paths: analog conversion per
+ * encoding, analog to logic thresholds, the soft trigger, the logic
+ * feed queue, the session bus with transforms and callbacks, and packet
+ * copies. Each benchmark repeats its operation for a minimum time and
+ * reports the time per sample, and the heap allocations per operation.
+ *
+ * The soft trigger and sr_session_send() are private to the library,
+ * so this program links libsigrok statically. With --csv, the results
+ * are printed as comma separated values, for regression tracking.
+ *
+ * Build with "make tests/bench_core", or build and run with
+ * "make bench". Run with --help for options.
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+static gint64 num_samples = 64 * 1024;
+static gint min_time_ms = 200;
+static gboolean csv;
+static gchar *filter;
+
+static GOptionEntry entries[] = {
+	{ "samples", 'n', 0, G_OPTION_ARG_INT64, &num_samples,
+		"Samples per operation (default 65536)", "N" },
+	{ "time", 't', 0, G_OPTION_ARG_INT, &min_time_ms,
+		"Minimum time per benchmark in ms (default 200)", "MS" },
+	{ "csv", 'c', 0, G_OPTION_ARG_NONE, &csv,
+		"Print comma separated values", NULL },
+	{ "filter", 'f', 0, G_OPTION_ARG_STRING, &filter,
+		"Only run benchmarks whose name contains this", "TEXT" },
+	{ NULL, 0, 0, 0, NULL, NULL, NULL }
+};
+
+/*
+ * Count the heap allocations of the process, including those of GLib,
+ * by wrapping the allocator. Only possible with glibc, elsewhere the
+ * allocations are reported as unknown.
+ */
+#ifdef __GLIBC__
+#define HAVE_ALLOC_COUNT 1
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+static volatile gint alloc_count;
+
+void *malloc(size_t size)
+{
+	g_atomic_int_inc(&alloc_count);
+	return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+	g_atomic_int_inc(&alloc_count);
+	return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+	if (!ptr)
+		g_atomic_int_inc(&alloc_count);
+	return __libc_realloc(ptr, size);
+}
+#else
+#define HAVE_ALLOC_COUNT 0
+
+static volatile gint alloc_count;
+#endif
+
+struct bench {
+	struct sr_context *ctx;
+	struct sr_session *session;
+	struct sr_dev_inst *sdi;
+	GSList *logic_channels;
+	struct sr_channel *analog_channel;
+	GSList *analog_channels;
+	uint8_t *logic;
+	uint8_t *raw;
+	float *floats;
+	uint8_t *out;
+};
+
+/* Called repeatedly; returns FALSE on failure. */
+typedef gboolean (*bench_fn)(struct bench *b, void *data);
+
+static void report(const char *name, uint64_t ops, double seconds,
+		uint64_t allocs)
+{
+	double ns;
+
+	ns = seconds * 1e9 / ((double)ops * num_samples);
+	if (csv) {
+		if (HAVE_ALLOC_COUNT)
+			printf("%s,%.4f,%.2f\n", name, ns, (double)allocs / ops);
+		else
+			printf("%s,%.4f,\n", name, ns);
+	} else {
+		if (HAVE_ALLOC_COUNT)
+			printf("%-36s %12.4f %12.2f\n", name, ns, (double)allocs / ops);
+		else
+			printf("%-36s %12.4f %12s\n", name, ns, "-");
+	}
+}
+
+static void run(struct bench *b, const char *name, bench_fn fn, void *data)
+{
+	gint64 start, elapsed;
+	uint64_t ops;
+	gint allocs;
+
+	if (filter && !strstr(name, filter))
+		return;
+
+	/* Warm up caches, pools and lazily allocated buffers. */
+	if (!fn(b, data)) {
+		if (csv)
+			printf("%s,,\n", name);
+		else
+			printf("%-36s %12s\n", name, "failed");
+		return;
+	}
+
+	ops = 0;
+	allocs = g_atomic_int_get(&alloc_count);
+	start = g_get_monotonic_time();
+	do {
+		fn(b, data);
+		ops++;
+		elapsed = g_get_monotonic_time() - start;
+	} while (elapsed < min_time_ms * 1000);
+	allocs = g_atomic_int_get(&alloc_count) - allocs;
+
+	report(name, ops, elapsed / 1e6, allocs);
+}
+
+/* Sample data which changes every few samples, the same for each run. */
+static void gen_data(struct bench *b)
+{
+	GRand *rand;
+	size_t i;
+
+	rand = g_rand_new_with_seed(42);
+	b->logic = g_malloc((size_t)num_samples);
+	b->raw = g_malloc((size_t)num_samples * sizeof(double));
+	b->floats = g_malloc((size_t)num_samples * sizeof(float));
+	b->out = g_malloc((size_t)num_samples * sizeof(double));
+	b->logic[0] = 0;
+	for (i = 1; i < (size_t)num_samples; i++) {
+		b->logic[i] = b->logic[i - 1];
+		if (g_rand_int_range(rand, 0, 16) == 0)
+			b->logic[i] ^= 1 << g_rand_int_range(rand, 0, 8);
+	}
+	for (i = 0; i < (size_t)num_samples * sizeof(double); i++)
+		b->raw[i] = g_rand_int_range(rand, 0, 256);
+	for (i = 0; i < (size_t)num_samples; i++)
+		b->floats[i] = g_rand_double_range(rand, -5.0, 5.0);
+	g_rand_free(rand);
+}
+
+static int gen_device(struct bench *b)
+{
+	GSList *l;
+	struct sr_channel *ch;
+	char name[16];
+	int i, ret;
+
+	if ((ret = sr_session_new(b->ctx, &b->session)) != SR_OK)
+		return ret;
+	b->sdi = sr_dev_inst_user_new("sigrok", "bench", NULL);
+	for (i = 0; i < 8; i++) {
+		snprintf(name, sizeof(name), "D%d", i);
+		sr_dev_inst_channel_add(b->sdi, i, SR_CHANNEL_LOGIC, name);
+	}
+	sr_dev_inst_channel_add(b->sdi, 8, SR_CHANNEL_ANALOG, "A0");
+	for (l = sr_dev_inst_channels_get(b->sdi); l; l = l->next) {
+		ch = l->data;
+		if (ch->type == SR_CHANNEL_LOGIC)
+			b->logic_channels = g_slist_append(b->logic_channels, ch);
+		else
+			b->analog_channel = ch;
+	}
+	b->analog_channels = g_slist_append(NULL, b->analog_channel);
+
+	return sr_session_dev_add(b->session, b->sdi);
+}
+
+/*--- Analog conversion -----------------------------------------------------*/
+
+struct analog_bench {
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+};
+
+static void analog_init(struct bench *b, struct analog_bench *ab,
+		void *data, int unitsize, gboolean is_float, gboolean is_signed,
+		gboolean is_bigendian, int scale_p, int scale_q)
+{
+	memset(ab, 0, sizeof(*ab));
+	ab->encoding.unitsize = unitsize;
+	ab->encoding.is_float = is_float;
+	ab->encoding.is_signed = is_signed;
+	ab->encoding.is_bigendian = is_bigendian;
+	ab->encoding.digits = 3;
+	ab->encoding.is_digits_decimal = TRUE;
+	ab->encoding.scale.p = scale_p;
+	ab->encoding.scale.q = scale_q;
+	ab->encoding.offset.p = 0;
+	ab->encoding.offset.q = 1;
+	ab->meaning.mq = SR_MQ_VOLTAGE;
+	ab->meaning.unit = SR_UNIT_VOLT;
+	ab->meaning.channels = b->analog_channels;
+	ab->spec.spec_digits = 3;
+	ab->analog.data = data;
+	ab->analog.num_samples = num_samples;
+	ab->analog.encoding = &ab->encoding;
+	ab->analog.meaning = &ab->meaning;
+	ab->analog.spec = &ab->spec;
+}
+
+static gboolean bench_to_float(struct bench *b, void *data)
+{
+	struct analog_bench *ab;
+
+	ab = data;
+
+	return sr_analog_to_float(&ab->analog, (float *)b->out) == SR_OK;
+}
+
+static gboolean bench_threshold(struct bench *b, void *data)
+{
+	struct analog_bench *ab;
+
+	ab = data;
+
+	return sr_a2l_threshold(&ab->analog, 0.5, b->out, num_samples) == SR_OK;
+}
+
+static void bench_analog(struct bench *b)
+{
+	static const struct {
+		const char *name;
+		int unitsize;
+		gboolean is_float, is_signed, is_bigendian;
+		int scale_p, scale_q;
+	} encodings[] = {
+		{ "float", 4, TRUE, TRUE, FALSE, 1, 1 },
+		{ "float_scaled", 4, TRUE, TRUE, FALSE, 1, 1000 },
+		{ "float_be", 4, TRUE, TRUE, TRUE, 1, 1 },
+		{ "double", 8, TRUE, TRUE, FALSE, 1, 1 },
+		{ "u8_scaled", 1, FALSE, FALSE, FALSE, 1, 256 },
+		{ "s16_scaled", 2, FALSE, TRUE, FALSE, 1, 32768 },
+		{ "s16_be_scaled", 2, FALSE, TRUE, TRUE, 1, 32768 },
+		{ "s32_scaled", 4, FALSE, TRUE, FALSE, 1, 65536 },
+	};
+	struct analog_bench ab;
+	char name[64];
+	size_t i;
+
+	for (i = 0; i < G_N_ELEMENTS(encodings); i++) {
+		analog_init(b, &ab, encodings[i].is_float &&
+			encodings[i].unitsize == 4 && !encodings[i].is_bigendian ?
+			(void *)b->floats : (void *)b->raw,
+			encodings[i].unitsize, encodings[i].is_float,
+			encodings[i].is_signed, encodings[i].is_bigendian,
+			encodings[i].scale_p, encodings[i].scale_q);
+		snprintf(name, sizeof(name), "analog_to_float/%s",
+			encodings[i].name);
+		run(b, name, bench_to_float, &ab);
+	}
+
+	analog_init(b, &ab, b->floats, 4, TRUE, TRUE, FALSE, 1, 1);
+	run(b, "a2l_threshold/float", bench_threshold, &ab);
+	analog_init(b, &ab, b->raw, 2, FALSE, TRUE, FALSE, 1, 32768);
+	run(b, "a2l_threshold/s16", bench_threshold, &ab);
+}
+
+/*--- Soft trigger ----------------------------------------------------------*/
+
+struct trigger_bench {
+	struct sr_trigger *trigger;
+	struct soft_trigger_logic *stl;
+};
+
+static gboolean bench_trigger(struct bench *b, void *data)
+{
+	struct trigger_bench *tb;
+	int offset, pre_trigger_samples, ret;
+
+	tb = data;
+	for (offset = 0; offset < num_samples; offset += ret + 1) {
+		ret = soft_trigger_logic_check(tb->stl, b->logic + offset,
+			num_samples - offset, &pre_trigger_samples);
+		if (ret < -1)
+			return FALSE;
+		if (ret == -1)
+			break;
+		/* Start over after a match, like a new acquisition would. */
+		soft_trigger_logic_free(tb->stl);
+		tb->stl = soft_trigger_logic_new(b->sdi, tb->trigger, 0);
+	}
+
+	return TRUE;
+}
+
+/*
+ * Trigger shapes, as a string per stage of a match type per channel:
+ * '0', '1', 'r' (rising), 'f' (falling), 'e' (edge) or 'x' (any).
+ */
+static void bench_triggers(struct bench *b)
+{
+	static const struct {
+		const char *name;
+		const char *stages[3];
+	} shapes[] = {
+		{ "level_1ch", { "1xxxxxxx" } },
+		{ "level_8ch", { "10110100" } },
+		{ "edge_1ch", { "rxxxxxxx" } },
+		{ "edge_level", { "r0x1xxxx" } },
+		{ "any_edge_8ch", { "eeeeeeee" } },
+		{ "stages_3", { "1x0xxxxx", "xrxxxxxx", "xxxxfxxx" } },
+	};
+	static const int types[256] = {
+		['0'] = SR_TRIGGER_ZERO,
+		['1'] = SR_TRIGGER_ONE,
+		['r'] = SR_TRIGGER_RISING,
+		['f'] = SR_TRIGGER_FALLING,
+		['e'] = SR_TRIGGER_EDGE,
+	};
+	struct trigger_bench tb;
+	struct sr_trigger_stage *stage;
+	GSList *l;
+	char name[64];
+	size_t i, s, c;
+
+	for (i = 0; i < G_N_ELEMENTS(shapes); i++) {
+		tb.trigger = sr_trigger_new(NULL);
+		for (s = 0; s < G_N_ELEMENTS(shapes[i].stages); s++) {
+			if (!shapes[i].stages[s])
+				break;
+			stage = sr_trigger_stage_add(tb.trigger);
+			l = b->logic_channels;
+			for (c = 0; shapes[i].stages[s][c]; c++, l = l->next) {
+				if (!types[(uint8_t)shapes[i].stages[s][c]])
+					continue;
+				sr_trigger_match_add(stage, l->data,
+					types[(uint8_t)shapes[i].stages[s][c]], 0);
+			}
+		}
+		tb.stl = soft_trigger_logic_new(b->sdi, tb.trigger, 0);
+		snprintf(name, sizeof(name), "soft_trigger/%s", shapes[i].name);
+		if (tb.stl)
+			run(b, name, bench_trigger, &tb);
+		soft_trigger_logic_free(tb.stl);
+		sr_trigger_free(tb.trigger);
+	}
+}
+
+/*--- Feed queue ------------------------------------------------------------*/
+
+struct feed_bench {
+	struct feed_queue_logic *q;
+	size_t count;
+};
+
+static gboolean bench_feed_queue(struct bench *b, void *data)
+{
+	struct feed_bench *fb;
+	size_t offset;
+
+	fb = data;
+	for (offset = 0; offset < (size_t)num_samples; offset += fb->count) {
+		if (feed_queue_logic_submit(fb->q, b->logic + offset,
+				MIN(fb->count, num_samples - offset)) != SR_OK)
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+static void bench_feed_queues(struct bench *b)
+{
+	static const size_t counts[] = { 1, 64, 4096 };
+	struct feed_bench fb;
+	char name[64];
+	size_t i;
+
+	for (i = 0; i < G_N_ELEMENTS(counts); i++) {
+		fb.q = feed_queue_logic_alloc(b->sdi, 16 * 1024, 1);
+		fb.count = counts[i];
+		snprintf(name, sizeof(name), "feed_queue_logic/submit_%zu",
+			counts[i]);
+		run(b, name, bench_feed_queue, &fb);
+		feed_queue_logic_flush(fb.q);
+		feed_queue_logic_free(fb.q);
+	}
+}
+
+/*--- Session bus and packets -----------------------------------------------*/
+
+static void count_packet(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	(void)sdi;
+	(void)packet;
+
+	(*(uint64_t *)cb_data)++;
+}
+
+static gboolean bench_send(struct bench *b, void *data)
+{
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic logic;
+
+	(void)data;
+
+	logic.length = num_samples;
+	logic.unitsize = 1;
+	logic.data = b->logic;
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+
+	return sr_session_send(b->sdi, &packet) == SR_OK;
+}
+
+static void bench_session(struct bench *b)
+{
+	static const int counts[][2] = {
+		/* Transforms, callbacks. */
+		{ 0, 1 }, { 0, 4 }, { 1, 1 }, { 4, 1 }, { 4, 4 },
+	};
+	const struct sr_transform_module *nop;
+	GSList *l;
+	uint64_t received;
+	char name[64];
+	size_t i;
+	int t, c;
+
+	nop = sr_transform_find("nop");
+	received = 0;
+	for (i = 0; i < G_N_ELEMENTS(counts); i++) {
+		for (t = 0; t < counts[i][0] && nop; t++)
+			sr_transform_new(nop, NULL, b->sdi);
+		for (c = 0; c < counts[i][1]; c++)
+			sr_session_datafeed_callback_add(b->session,
+				count_packet, &received);
+		snprintf(name, sizeof(name), "session_send/%dt_%dcb",
+			counts[i][0], counts[i][1]);
+		run(b, name, bench_send, NULL);
+		sr_session_datafeed_callback_remove_all(b->session);
+		for (l = b->session->transforms; l; l = l->next)
+			sr_transform_free(l->data);
+		g_slist_free(b->session->transforms);
+		b->session->transforms = NULL;
+	}
+}
+
+static gboolean bench_packet_copy(struct bench *b, void *data)
+{
+	struct sr_datafeed_packet *copy;
+	int ret;
+
+	(void)b;
+
+	if ((ret = sr_packet_copy(data, &copy)) != SR_OK)
+		return FALSE;
+	sr_packet_free(copy);
+
+	return TRUE;
+}
+
+static void bench_packets(struct bench *b)
+{
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic logic;
+	struct analog_bench ab;
+
+	logic.length = num_samples;
+	logic.unitsize = 1;
+	logic.data = b->logic;
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+	run(b, "packet_copy/logic", bench_packet_copy, &packet);
+
+	analog_init(b, &ab, b->floats, 4, TRUE, TRUE, FALSE, 1, 1);
+	packet.type = SR_DF_ANALOG;
+	packet.payload = &ab.analog;
+	run(b, "packet_copy/analog", bench_packet_copy, &packet);
+}
+
+int main(int argc, char **argv)
+{
+	struct bench b;
+	GOptionContext *octx;
+	GError *error;
+
+	error = NULL;
+	octx = g_option_context_new("- benchmark libsigrok core hot paths");
+	g_option_context_add_main_entries(octx, entries, NULL);
+	if (!g_option_context_parse(octx, &argc, &argv, &error)) {
+		fprintf(stderr, "%s\n", error->message);
+		return 1;
+	}
+	g_option_context_free(octx);
+	if (num_samples < 8 || num_samples > G_MAXINT || min_time_ms < 1) {
+		fprintf(stderr, "Invalid benchmark parameters.\n");
+		return 1;
+	}
+
+	memset(&b, 0, sizeof(b));
+	if (sr_init(&b.ctx) != SR_OK)
+		return 1;
+	sr_log_loglevel_set(SR_LOG_ERR);
+	if (gen_device(&b) != SR_OK) {
+		fprintf(stderr, "Failed to set up the benchmark device.\n");
+		sr_exit(b.ctx);
+		return 1;
+	}
+	gen_data(&b);
+
+	if (csv)
+		printf("benchmark,ns_per_sample,allocs_per_op\n");
+	else
+		printf("%-36s %12s %12s\n", "benchmark", "ns/sample", "allocs/op");
+
+	bench_analog(&b);
+	bench_triggers(&b);
+	bench_feed_queues(&b);
+	bench_session(&b);
+	bench_packets(&b);
+
+	g_slist_free(b.logic_channels);
+	g_slist_free(b.analog_channels);
+	g_free(b.logic);
+	g_free(b.raw);
+	g_free(b.floats);
+	g_free(b.out);
+	sr_session_destroy(b.session);
+	sr_exit(b.ctx);
+
+	return 0;
+}
@@ -0,0 +1,486 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Benchmark of the input modules. Generates a file of each supported
+ * format in memory, once with dense and once with sparse value changes,
+ * and feeds it through sr_input_send() in chunks, like frontends read
+ * files. A datafeed callback counts the samples and drops them. Reports
+ * the input MB/s and the samples/s of each module.
+ *
+ * Build and run with "make bench-input", run with --help for options.
+ */
+
+#include <config.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include <libsigrok/libsigrok.h>
+
+#define CHUNK_SIZE (4 * 1024 * 1024)
+#define SAMPLERATE SR_MHZ(1)
+
+static gint size_mb = 16;
+static gint num_channels = 8;
+static gdouble dense = 0.5;
+static gdouble sparse = 0.001;
+static gchar *module_id;
+
+static GOptionEntry entries[] = {
+	{ "size", 's', 0, G_OPTION_ARG_INT, &size_mb,
+		"Size of each generated file in MB (default 16)", "MB" },
+	{ "channels", 'c', 0, G_OPTION_ARG_INT, &num_channels,
+		"Number of channels, where the format allows (default 8)", "N" },
+	{ "dense", 'd', 0, G_OPTION_ARG_DOUBLE, &dense,
+		"Probability of a value change per sample, dense (default 0.5)", "D" },
+	{ "sparse", 'p', 0, G_OPTION_ARG_DOUBLE, &sparse,
+		"Probability of a value change per sample, sparse (default 0.001)", "D" },
+	{ "module", 'm', 0, G_OPTION_ARG_STRING, &module_id,
+		"Only run this input module", "ID" },
+	{ NULL, 0, 0, 0, NULL, NULL, NULL }
+};
+
+/* A signal of num_channels bits, which changes at random. */
+struct signal {
+	GRand *rand;
+	double density;
+	uint64_t value;
+};
+
+struct bench_result {
+	uint64_t samples;
+	double seconds;
+	gboolean failed;
+};
+
+static void signal_init(struct signal *sig, double density)
+{
+	sig->rand = g_rand_new_with_seed(42);
+	sig->density = density;
+	sig->value = 0;
+}
+
+/*
+ * Number of samples until the signal changes, at least 1. Then flips
+ * one of its bits.
+ */
+static uint64_t signal_next(struct signal *sig, int width)
+{
+	double u;
+	uint64_t gap;
+
+	gap = 1;
+	if (sig->density < 1) {
+		u = g_rand_double_range(sig->rand, 1e-12, 1);
+		gap += (uint64_t)(log(u) / log(1 - sig->density));
+	}
+	sig->value ^= UINT64_C(1) << g_rand_int_range(sig->rand, 0, width);
+
+	return gap;
+}
+
+static void put_u16le(GString *s, uint16_t v)
+{
+	g_string_append_c(s, v & 0xff);
+	g_string_append_c(s, v >> 8);
+}
+
+static void put_u32le(GString *s, uint32_t v)
+{
+	put_u16le(s, v & 0xffff);
+	put_u16le(s, v >> 16);
+}
+
+static void put_u64le(GString *s, uint64_t v)
+{
+	put_u32le(s, v & 0xffffffff);
+	put_u32le(s, v >> 32);
+}
+
+static void put_dblle(GString *s, double v)
+{
+	uint64_t bits;
+
+	memcpy(&bits, &v, sizeof(bits));
+	put_u64le(s, bits);
+}
+
+static void patch_u32le(GString *s, size_t pos, uint32_t v)
+{
+	v = GUINT32_TO_LE(v);
+	memcpy(s->str + pos, &v, sizeof(v));
+}
+
+static void patch_u64le(GString *s, size_t pos, uint64_t v)
+{
+	v = GUINT64_TO_LE(v);
+	memcpy(s->str + pos, &v, sizeof(v));
+}
+
+static void patch_dblle(GString *s, size_t pos, double v)
+{
+	uint64_t bits;
+
+	memcpy(&bits, &v, sizeof(bits));
+	patch_u64le(s, pos, bits);
+}
+
+static void gen_binary(GString *s, struct signal *sig, size_t size)
+{
+	uint64_t gap;
+	int unitsize, i;
+
+	unitsize = (num_channels + 7) / 8;
+	while (s->len < size) {
+		for (gap = signal_next(sig, num_channels); gap; gap--) {
+			for (i = 0; i < unitsize; i++)
+				g_string_append_c(s, sig->value >> (8 * i));
+		}
+	}
+}
+
+static void gen_csv(GString *s, struct signal *sig, size_t size)
+{
+	uint64_t gap;
+	int i;
+
+	for (i = 0; i < num_channels; i++)
+		g_string_append_printf(s, "%sD%d", i ? "," : "", i);
+	g_string_append_c(s, '\n');
+	while (s->len < size) {
+		for (gap = signal_next(sig, num_channels); gap; gap--) {
+			for (i = 0; i < num_channels; i++) {
+				if (i)
+					g_string_append_c(s, ',');
+				g_string_append_c(s, sig->value >> i & 1 ? '1' : '0');
+			}
+			g_string_append_c(s, '\n');
+		}
+	}
+}
+
+static void gen_vcd(GString *s, struct signal *sig, size_t size)
+{
+	uint64_t time, prev;
+	int i;
+
+	g_string_append(s, "$timescale 1 us $end\n$scope module bench $end\n");
+	for (i = 0; i < num_channels; i++)
+		g_string_append_printf(s, "$var wire 1 n%d D%d $end\n", i, i);
+	g_string_append(s, "$upscope $end\n$enddefinitions $end\n#0\n");
+	for (i = 0; i < num_channels; i++)
+		g_string_append_printf(s, "0n%d\n", i);
+	time = 0;
+	while (s->len < size) {
+		prev = sig->value;
+		time += signal_next(sig, num_channels);
+		g_string_append_printf(s, "#%" PRIu64 "\n", time);
+		for (i = 0; i < num_channels; i++) {
+			if ((prev ^ sig->value) >> i & 1)
+				g_string_append_printf(s, "%cn%d\n",
+					sig->value >> i & 1 ? '1' : '0', i);
+		}
+	}
+	g_string_append_printf(s, "#%" PRIu64 "\n", time + 1);
+}
+
+/* Logic 2 export of a digital channel, one file per channel. */
+static void gen_saleae(GString *s, struct signal *sig, size_t size)
+{
+	uint64_t count, time;
+	size_t end_pos, count_pos;
+
+	g_string_append(s, "<SALEAE>");
+	put_u32le(s, 0);
+	put_u32le(s, 0);
+	put_u32le(s, 0);
+	put_dblle(s, 0);
+	end_pos = s->len;
+	put_dblle(s, 0);
+	count_pos = s->len;
+	put_u64le(s, 0);
+	count = time = 0;
+	while (s->len < size) {
+		time += signal_next(sig, 1);
+		put_dblle(s, (double)time / SAMPLERATE);
+		count++;
+	}
+	patch_dblle(s, end_pos, (double)(time + 1) / SAMPLERATE);
+	patch_u64le(s, count_pos, count);
+}
+
+static void gen_logicport(GString *s, struct signal *sig, size_t size)
+{
+	GString *lines;
+	uint64_t num_lines, gap;
+	int channels, i;
+
+	channels = MIN(num_channels, 34);
+	lines = g_string_sized_new(size);
+	num_lines = 0;
+	while (lines->len < size) {
+		gap = signal_next(sig, channels);
+		for (i = 0; i < channels; i++)
+			g_string_append_printf(lines, "%s%c", i ? "," : "",
+				sig->value >> i & 1 ? '1' : '0');
+		g_string_append_printf(lines, ",%" PRIu64 "\r\n", gap);
+		num_lines++;
+	}
+
+	g_string_append(s, "Version\x11" "1.3\x11" "1\x11 CAUTION: Do not "
+		"change the contents of this file.\r\n");
+	g_string_append(s, "AcquiredSamplePeriod\x11" "1E-06\r\n");
+	g_string_append_printf(s, "SampleData\x11%d\x11%" PRIu64 "\r\n{\r\n",
+		channels, num_lines);
+	for (i = 0; i < channels; i++)
+		g_string_append_printf(s, "D%d,", i);
+	g_string_append(s, "Count\r\n");
+	g_string_append_len(s, lines->str, lines->len);
+	g_string_append(s, "}\r\nAcquiredChannelList");
+	for (i = 0; i < channels; i++)
+		g_string_append(s, "\x11True");
+	g_string_append(s, "\r\nNotesString\x11\r\n");
+	g_string_free(lines, TRUE);
+}
+
+/* iprobe data, with one record per value change. */
+static void gen_trace32(GString *s, struct signal *sig, size_t size)
+{
+	static const char name[] = "trace32 iprobe data";
+	uint64_t timestamp;
+	uint32_t count;
+
+	g_string_append(s, name);
+	g_string_append_c(s, '\x1a');
+	g_string_set_size(s, 0x50);
+	memset(s->str + sizeof(name), 0, 0x50 - sizeof(name));
+	s->str[0x36] = 0x0a;
+	s->str[0x38] = 11;
+
+	/* 64 timestamp ticks per sample at the default samplerate. */
+	count = 0;
+	timestamp = 0;
+	while (s->len < size) {
+		put_u64le(s, timestamp);
+		put_u16le(s, sig->value & 0xffff);
+		g_string_append_c(s, sig->value >> 16 & 1);
+		timestamp += 64 * signal_next(sig, 17);
+		count++;
+	}
+	patch_u32le(s, 0x3c, count);
+	patch_u32le(s, 0x40, count - 1);
+}
+
+static void gen_wav(GString *s, struct signal *sig, size_t size)
+{
+	uint64_t gap;
+	uint32_t data_size;
+	int i;
+
+	g_string_append(s, "RIFF");
+	put_u32le(s, 0);
+	g_string_append(s, "WAVEfmt ");
+	put_u32le(s, 16);
+	put_u16le(s, 1);
+	put_u16le(s, num_channels);
+	put_u32le(s, SAMPLERATE);
+	put_u32le(s, SAMPLERATE * 2 * num_channels);
+	put_u16le(s, 2 * num_channels);
+	put_u16le(s, 16);
+	g_string_append(s, "data");
+	put_u32le(s, 0);
+	while (s->len < size) {
+		for (gap = signal_next(sig, num_channels); gap; gap--) {
+			for (i = 0; i < num_channels; i++)
+				put_u16le(s, sig->value >> i & 1 ? 0x4000 : 0xc000);
+		}
+	}
+
+	data_size = s->len - 44;
+	patch_u32le(s, 4, data_size + 36);
+	patch_u32le(s, 40, data_size);
+}
+
+static const struct {
+	const char *id;
+	void (*gen)(GString *s, struct signal *sig, size_t size);
+} formats[] = {
+	{ "binary", gen_binary },
+	{ "csv", gen_csv },
+	{ "logicport", gen_logicport },
+	{ "saleae", gen_saleae },
+	{ "trace32_ad", gen_trace32 },
+	{ "vcd", gen_vcd },
+	{ "wav", gen_wav },
+};
+
+static void count_samples(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	const struct sr_datafeed_logic *logic;
+	const struct sr_datafeed_analog *analog;
+	uint64_t *samples;
+
+	(void)sdi;
+
+	samples = cb_data;
+	if (packet->type == SR_DF_LOGIC) {
+		logic = packet->payload;
+		if (logic->unitsize)
+			*samples += logic->length / logic->unitsize;
+	} else if (packet->type == SR_DF_ANALOG) {
+		analog = packet->payload;
+		*samples += analog->num_samples;
+	}
+}
+
+static GHashTable *module_options(const char *id)
+{
+	GHashTable *options;
+
+	options = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+		(GDestroyNotify)g_variant_unref);
+	if (!strcmp(id, "binary")) {
+		g_hash_table_insert(options, g_strdup("numchannels"),
+			g_variant_ref_sink(g_variant_new_int32(num_channels)));
+	} else if (!strcmp(id, "saleae")) {
+		g_hash_table_insert(options, g_strdup("samplerate"),
+			g_variant_ref_sink(g_variant_new_uint64(SAMPLERATE)));
+	} else if (!strcmp(id, "csv")) {
+		g_hash_table_insert(options, g_strdup("samplerate"),
+			g_variant_ref_sink(g_variant_new_uint64(SAMPLERATE)));
+	}
+
+	return options;
+}
+
+static void run_module(struct sr_context *ctx, const struct sr_input_module *imod,
+		const GString *file, struct bench_result *res)
+{
+	struct sr_session *session;
+	const struct sr_input *in;
+	struct sr_dev_inst *sdi;
+	GHashTable *options;
+	GString *chunk;
+	gboolean added;
+	gint64 start;
+	size_t pos, len;
+	int ret;
+
+	memset(res, 0, sizeof(*res));
+	options = module_options(sr_input_id_get(imod));
+	in = sr_input_new(imod, options);
+	g_hash_table_destroy(options);
+	if (!in) {
+		res->failed = TRUE;
+		return;
+	}
+	sr_session_new(ctx, &session);
+	sr_session_datafeed_callback_add(session, count_samples, &res->samples);
+
+	/* Chunks are copied out of the file, like reading it would. */
+	chunk = g_string_sized_new(CHUNK_SIZE);
+	added = FALSE;
+	ret = SR_OK;
+	start = g_get_monotonic_time();
+	for (pos = 0; pos < file->len && ret == SR_OK; pos += len) {
+		len = MIN(CHUNK_SIZE, file->len - pos);
+		g_string_truncate(chunk, 0);
+		g_string_append_len(chunk, file->str + pos, len);
+		ret = sr_input_send(in, chunk);
+		if (!added && (sdi = sr_input_dev_inst_get(in))) {
+			sr_session_dev_add(session, sdi);
+			added = TRUE;
+		}
+	}
+	if (ret == SR_OK)
+		ret = sr_input_end(in);
+	res->seconds = (g_get_monotonic_time() - start) / 1e6;
+	res->failed = ret != SR_OK || !res->samples;
+
+	g_string_free(chunk, TRUE);
+	sr_input_free(in);
+	sr_session_destroy(session);
+}
+
+int main(int argc, char **argv)
+{
+	const struct sr_input_module *imod;
+	struct sr_context *sr_ctx;
+	struct bench_result res;
+	struct signal sig;
+	GOptionContext *octx;
+	GError *error;
+	GString *file;
+	double densities[2];
+	size_t i, d;
+
+	error = NULL;
+	octx = g_option_context_new("- benchmark libsigrok input modules");
+	g_option_context_add_main_entries(octx, entries, NULL);
+	if (!g_option_context_parse(octx, &argc, &argv, &error)) {
+		fprintf(stderr, "%s\n", error->message);
+		return 1;
+	}
+	g_option_context_free(octx);
+	if (size_mb < 1 || num_channels < 1 || num_channels > 64 ||
+			dense <= 0 || dense > 1 || sparse <= 0 || sparse > 1) {
+		fprintf(stderr, "Invalid benchmark parameters.\n");
+		return 1;
+	}
+
+	if (sr_init(&sr_ctx) != SR_OK)
+		return 1;
+	sr_log_loglevel_set(SR_LOG_ERR);
+
+	printf("%d MB per file, %d channels, density %g (dense) and %g (sparse)\n",
+		size_mb, num_channels, dense, sparse);
+	printf("%-12s %-7s %10s %10s %12s\n", "module", "density",
+		"seconds", "MB/s", "Msamples/s");
+
+	densities[0] = dense;
+	densities[1] = sparse;
+	for (i = 0; i < G_N_ELEMENTS(formats); i++) {
+		if (module_id && strcmp(module_id, formats[i].id))
+			continue;
+		if (!(imod = sr_input_find((char *)formats[i].id)))
+			continue;
+		for (d = 0; d < G_N_ELEMENTS(densities); d++) {
+			signal_init(&sig, densities[d]);
+			file = g_string_sized_new((size_t)size_mb * 1000 * 1000);
+			formats[i].gen(file, &sig, (size_t)size_mb * 1000 * 1000);
+			g_rand_free(sig.rand);
+			run_module(sr_ctx, imod, file, &res);
+			if (res.failed) {
+				printf("%-12s %-7s %10s\n", formats[i].id,
+					d ? "sparse" : "dense", "failed");
+			} else {
+				printf("%-12s %-7s %10.3f %10.1f %12.2f\n",
+					formats[i].id, d ? "sparse" : "dense",
+					res.seconds, file->len / 1e6 / res.seconds,
+					res.samples / res.seconds / 1e6);
+			}
+			g_string_free(file, TRUE);
+		}
+	}
+
+	sr_exit(sr_ctx);
+
+	return 0;
+}
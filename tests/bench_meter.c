@@ -0,0 +1,391 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Benchmark and fuzzer of the serial multimeter and LCR meter parsers.
+ *
+ * Replays a captured byte stream of a meter through a pseudo terminal,
+ * so the stream takes the path of real meter data: the serial layer, its
+ * RX queue, packet framing, and the chip parser of the driver (the
+ * dmm_info / lcr_info tables of the serial-dmm and serial-lcr drivers,
+ * each entry of which is a driver of its own). Reports the time to sync
+ * in the scan, and the packets/s of an acquisition.
+ *
+ * With --garbage, random bytes follow each repetition of the capture.
+ * The acquisition then runs a second time, the packets which are lost
+ * per garbage burst are the parser's resync cost.
+ *
+ * Without a capture, random bytes get fed to the scan of each meter
+ * driver (or the one of --driver). None of them should detect a
+ * device, or crash.
+ *
+ * Build with "make tests/bench_meter", run with --help for options.
+ */
+
+/* Needed for posix_openpt() and cfmakeraw(). */
+#define _DEFAULT_SOURCE
+#define _XOPEN_SOURCE 700
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include <libsigrok/libsigrok.h>
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+static gchar *driver_id;
+static gchar *capture_file;
+static gint garbage = 0;
+static gint64 num_packets = 1000;
+
+static GOptionEntry entries[] = {
+	{ "driver", 'd', 0, G_OPTION_ARG_STRING, &driver_id,
+		"Only run this driver", "ID" },
+	{ "file", 'f', 0, G_OPTION_ARG_FILENAME, &capture_file,
+		"Captured meter byte stream to replay", "FILE" },
+	{ "garbage", 'g', 0, G_OPTION_ARG_INT, &garbage,
+		"Random bytes after each repetition (default 0)", "N" },
+	{ "packets", 'n', 0, G_OPTION_ARG_INT64, &num_packets,
+		"Packets per acquisition (default 1000)", "N" },
+	{ NULL, 0, 0, 0, NULL, NULL, NULL }
+};
+
+/* Feeds the stream to the master side of the pty, until stopped. */
+struct feeder {
+	int master;
+	const uint8_t *data;
+	size_t len;
+	size_t garbage;
+	GRand *rand;
+	gint stop;
+	gint repetitions;
+	GThread *thread;
+};
+
+struct bench_result {
+	double scan_seconds;
+	uint64_t packets;
+	uint64_t repetitions;
+	double seconds;
+	gboolean found;
+	gboolean failed;
+};
+
+static gboolean write_all(struct feeder *f, const uint8_t *buf, size_t len)
+{
+	struct pollfd pfd;
+	ssize_t ret;
+
+	while (len) {
+		if (g_atomic_int_get(&f->stop))
+			return FALSE;
+		pfd.fd = f->master;
+		pfd.events = POLLOUT;
+		if (poll(&pfd, 1, 100) <= 0)
+			continue;
+		ret = write(f->master, buf, len);
+		if (ret < 0 && (errno == EAGAIN || errno == EINTR))
+			continue;
+		if (ret < 0)
+			return FALSE;
+		buf += ret;
+		len -= ret;
+	}
+
+	return TRUE;
+}
+
+static gpointer feeder_thread(gpointer data)
+{
+	struct feeder *f;
+	uint8_t random[256];
+	size_t left, n, i;
+
+	f = data;
+	while (!g_atomic_int_get(&f->stop)) {
+		if (f->len && !write_all(f, f->data, f->len))
+			break;
+		left = f->len ? f->garbage : sizeof(random);
+		while (left) {
+			n = MIN(left, sizeof(random));
+			for (i = 0; i < n; i++)
+				random[i] = g_rand_int(f->rand);
+			if (!write_all(f, random, n))
+				return NULL;
+			left -= n;
+		}
+		g_atomic_int_inc(&f->repetitions);
+	}
+
+	return NULL;
+}
+
+/* Open a pty which passes the bytes 1:1, and return its slave's name. */
+static char *open_pty(int *master, int *slave)
+{
+	struct termios tio;
+	char *name;
+
+	if ((*master = posix_openpt(O_RDWR | O_NOCTTY)) < 0)
+		return NULL;
+	if (grantpt(*master) < 0 || unlockpt(*master) < 0 ||
+			!(name = ptsname(*master))) {
+		close(*master);
+		return NULL;
+	}
+	name = g_strdup(name);
+	/* Keep the slave open, it would lose the raw mode when closed. */
+	if ((*slave = open(name, O_RDWR | O_NOCTTY)) < 0 ||
+			tcgetattr(*slave, &tio) < 0) {
+		close(*master);
+		g_free(name);
+		return NULL;
+	}
+	cfmakeraw(&tio);
+	tcsetattr(*slave, TCSANOW, &tio);
+	fcntl(*master, F_SETFL, fcntl(*master, F_GETFL) | O_NONBLOCK);
+
+	return name;
+}
+
+static void count_packets(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	(void)sdi;
+
+	if (packet->type == SR_DF_ANALOG)
+		(*(uint64_t *)cb_data)++;
+}
+
+/* Scan the driver with the pty as its port, and run an acquisition. */
+static void run_driver(struct sr_context *ctx, struct sr_dev_driver *driver,
+		const uint8_t *data, size_t len, size_t garbage_len,
+		struct bench_result *res)
+{
+	struct feeder f;
+	struct sr_config src;
+	struct sr_session *session;
+	struct sr_dev_inst *sdi;
+	GSList *options, *devices;
+	char *port;
+	int slave;
+	gint64 start;
+
+	memset(res, 0, sizeof(*res));
+	memset(&f, 0, sizeof(f));
+	if (!(port = open_pty(&f.master, &slave))) {
+		res->failed = TRUE;
+		return;
+	}
+	f.data = data;
+	f.len = len;
+	f.garbage = garbage_len;
+	f.rand = g_rand_new_with_seed(42);
+	f.thread = g_thread_new("feeder", feeder_thread, &f);
+
+	src.key = SR_CONF_CONN;
+	src.data = g_variant_new_string(port);
+	options = g_slist_append(NULL, &src);
+	start = g_get_monotonic_time();
+	if (sr_driver_init(ctx, driver) == SR_OK)
+		devices = sr_driver_scan(driver, options);
+	else
+		devices = NULL;
+	res->scan_seconds = (g_get_monotonic_time() - start) / 1e6;
+	g_slist_free(options);
+	g_variant_unref(g_variant_ref_sink(src.data));
+
+	if (devices && len) {
+		res->found = TRUE;
+		sdi = devices->data;
+		sr_session_new(ctx, &session);
+		sr_session_dev_add(session, sdi);
+		sr_session_datafeed_callback_add(session, count_packets,
+			&res->packets);
+		sr_config_set(sdi, NULL, SR_CONF_LIMIT_SAMPLES,
+			g_variant_new_uint64(num_packets));
+		g_atomic_int_set(&f.repetitions, 0);
+		start = g_get_monotonic_time();
+		if (sr_session_start(session) == SR_OK)
+			sr_session_run(session);
+		else
+			res->failed = TRUE;
+		res->seconds = (g_get_monotonic_time() - start) / 1e6;
+		res->repetitions = g_atomic_int_get(&f.repetitions);
+		sr_session_destroy(session);
+	} else if (devices) {
+		/* Random data must not look like a meter. */
+		res->found = TRUE;
+		res->failed = TRUE;
+	}
+	g_slist_free(devices);
+	sr_dev_clear(driver);
+
+	g_atomic_int_set(&f.stop, 1);
+	g_thread_join(f.thread);
+	g_rand_free(f.rand);
+	close(slave);
+	close(f.master);
+	g_free(port);
+}
+
+/* Meter drivers take a serial port, and list as multimeter or LCR meter. */
+static gboolean is_meter_driver(struct sr_dev_driver *driver)
+{
+	GArray *opts;
+	gboolean serial, meter;
+	uint32_t key;
+	guint i;
+
+	serial = meter = FALSE;
+	if ((opts = sr_driver_scan_options_list(driver))) {
+		for (i = 0; i < opts->len; i++) {
+			key = g_array_index(opts, uint32_t, i);
+			serial |= key == SR_CONF_SERIALCOMM;
+		}
+		g_array_free(opts, TRUE);
+	}
+	if ((opts = sr_dev_options(driver, NULL, NULL))) {
+		for (i = 0; i < opts->len; i++) {
+			key = g_array_index(opts, uint32_t, i);
+			meter |= key == SR_CONF_MULTIMETER;
+			meter |= key == SR_CONF_LCRMETER;
+		}
+		g_array_free(opts, TRUE);
+	}
+
+	return serial && meter;
+}
+
+static void print_result(const char *name, const struct bench_result *res,
+		const struct bench_result *clean)
+{
+	double per_rep, clean_per_rep;
+
+	if (!res->found) {
+		printf("%-24s %10.3f %10s\n", name, res->scan_seconds,
+			capture_file ? "no sync" : "ok");
+		return;
+	}
+	if (res->failed || !res->seconds) {
+		printf("%-24s %10.3f %10s\n", name, res->scan_seconds,
+			capture_file ? "failed" : "FALSE SYNC");
+		return;
+	}
+	per_rep = res->repetitions ?
+		(double)res->packets / res->repetitions : 0;
+	printf("%-24s %10.3f %10" PRIu64 " %10.3f %12.1f %10.2f",
+		name, res->scan_seconds, res->packets, res->seconds,
+		res->packets / res->seconds, per_rep);
+	if (clean && clean->repetitions && clean->packets) {
+		clean_per_rep = (double)clean->packets / clean->repetitions;
+		printf(" %10.2f", clean_per_rep - per_rep);
+	}
+	printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+	struct sr_dev_driver **drivers;
+	struct sr_context *sr_ctx;
+	struct bench_result res, clean;
+	GOptionContext *octx;
+	GError *error;
+	gchar *data;
+	gsize len;
+	size_t i;
+	const char *name;
+
+	error = NULL;
+	octx = g_option_context_new("- benchmark libsigrok meter parsers");
+	g_option_context_add_main_entries(octx, entries, NULL);
+	if (!g_option_context_parse(octx, &argc, &argv, &error)) {
+		fprintf(stderr, "%s\n", error->message);
+		return 1;
+	}
+	g_option_context_free(octx);
+	if (garbage < 0 || num_packets < 1) {
+		fprintf(stderr, "Invalid benchmark parameters.\n");
+		return 1;
+	}
+
+	data = NULL;
+	len = 0;
+	if (capture_file) {
+		if (!driver_id) {
+			fprintf(stderr, "A capture needs its --driver.\n");
+			return 1;
+		}
+		if (!g_file_get_contents(capture_file, &data, &len, &error) || !len) {
+			fprintf(stderr, "Cannot read %s: %s\n", capture_file,
+				error ? error->message : "empty file");
+			return 1;
+		}
+	}
+
+	if (sr_init(&sr_ctx) != SR_OK)
+		return 1;
+	sr_log_loglevel_set(SR_LOG_ERR);
+
+	if (capture_file)
+		printf("%s, %zu bytes, %d garbage bytes per repetition, "
+			"%" G_GINT64_FORMAT " packets\n", capture_file,
+			(size_t)len, garbage, num_packets);
+	else
+		printf("Feeding random data to the scans\n");
+	printf("%-24s %10s %10s %10s %12s %10s %10s\n", "driver", "scan s",
+		"packets", "seconds", "packets/s", "pkts/rep", "lost/burst");
+
+	drivers = sr_driver_list(sr_ctx);
+	for (i = 0; drivers[i]; i++) {
+		name = drivers[i]->name;
+		if (driver_id && strcmp(driver_id, name))
+			continue;
+		if (!driver_id && !is_meter_driver(drivers[i]))
+			continue;
+		run_driver(sr_ctx, drivers[i], (const uint8_t *)data, len,
+			0, &clean);
+		print_result(name, &clean, NULL);
+		if (!capture_file || !garbage || !clean.found || clean.failed)
+			continue;
+		run_driver(sr_ctx, drivers[i], (const uint8_t *)data, len,
+			garbage, &res);
+		print_result("  with garbage", &res, &clean);
+	}
+
+	g_free(data);
+	sr_exit(sr_ctx);
+
+	return 0;
+}
+
+#else
+
+int main(void)
+{
+	fprintf(stderr, "The meter benchmark needs pseudo terminals.\n");
+
+	return 1;
+}
+
+#endif
@@ -0,0 +1,369 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Benchmark of the output modules. Feeds synthetic logic and analog
+ * packets through each module and reports the throughput, as well as
+ * the peak memory use of the process which ran the module.
+ *
+ * Build with "make tests/bench_output", run with --help for options.
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#ifndef _WIN32
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+#include <libsigrok/libsigrok.h>
+
+static gint unitsize = 1;
+static gint num_analog = 1;
+static gint64 num_samples = 10 * 1000 * 1000;
+static gint packet_samples = 64 * 1024;
+static gdouble density = 0.01;
+static gchar *module_id;
+
+static GOptionEntry entries[] = {
+	{ "unitsize", 'u', 0, G_OPTION_ARG_INT, &unitsize,
+		"Bytes per logic sample (default 1)", "N" },
+	{ "analog", 'a', 0, G_OPTION_ARG_INT, &num_analog,
+		"Number of analog channels (default 1)", "N" },
+	{ "samples", 'n', 0, G_OPTION_ARG_INT64, &num_samples,
+		"Number of samples (default 10000000)", "N" },
+	{ "packet", 'p', 0, G_OPTION_ARG_INT, &packet_samples,
+		"Samples per packet (default 65536)", "N" },
+	{ "density", 'd', 0, G_OPTION_ARG_DOUBLE, &density,
+		"Probability of a value change per sample (default 0.01)", "D" },
+	{ "module", 'm', 0, G_OPTION_ARG_STRING, &module_id,
+		"Only run this output module", "ID" },
+	{ NULL, 0, 0, 0, NULL, NULL, NULL }
+};
+
+struct bench_data {
+	struct sr_dev_inst *sdi;
+	GSList *analog_channels;
+	uint8_t *logic;
+	float *analog;
+};
+
+struct bench_result {
+	uint64_t out_bytes;
+	double seconds;
+	long peak_kib;
+	gboolean failed;
+};
+
+static int count_output(const struct sr_output *o, const uint8_t *data,
+		size_t length, void *cb_data)
+{
+	(void)o;
+	(void)data;
+
+	*(uint64_t *)cb_data += length;
+
+	return SR_OK;
+}
+
+/* Sample data with the requested change density, the same for each run. */
+static void gen_data(struct bench_data *bd)
+{
+	GRand *rand;
+	size_t i;
+	int j;
+	float level;
+
+	rand = g_rand_new_with_seed(42);
+	bd->logic = g_malloc0((size_t)packet_samples * unitsize);
+	for (i = 1; i < (size_t)packet_samples; i++) {
+		memcpy(bd->logic + i * unitsize, bd->logic + (i - 1) * unitsize, unitsize);
+		for (j = 0; j < unitsize * 8; j++) {
+			if (g_rand_double(rand) < density)
+				bd->logic[i * unitsize + j / 8] ^= 1 << (j % 8);
+		}
+	}
+	bd->analog = g_malloc((size_t)packet_samples * sizeof(float));
+	level = 0;
+	for (i = 0; i < (size_t)packet_samples; i++) {
+		if (g_rand_double(rand) < density)
+			level = g_rand_double_range(rand, -5.0, 5.0);
+		bd->analog[i] = level;
+	}
+	g_rand_free(rand);
+}
+
+static void gen_device(struct bench_data *bd)
+{
+	GSList *l;
+	char name[16];
+	int i;
+
+	bd->sdi = sr_dev_inst_user_new("sigrok", "bench", NULL);
+	for (i = 0; i < unitsize * 8; i++) {
+		snprintf(name, sizeof(name), "D%d", i);
+		sr_dev_inst_channel_add(bd->sdi, i, SR_CHANNEL_LOGIC, name);
+	}
+	for (i = 0; i < num_analog; i++) {
+		snprintf(name, sizeof(name), "A%d", i);
+		sr_dev_inst_channel_add(bd->sdi, unitsize * 8 + i,
+			SR_CHANNEL_ANALOG, name);
+	}
+	for (l = sr_dev_inst_channels_get(bd->sdi); l; l = l->next) {
+		if (((struct sr_channel *)l->data)->type == SR_CHANNEL_ANALOG)
+			bd->analog_channels = g_slist_append(bd->analog_channels, l->data);
+	}
+}
+
+static int send_packet(const struct sr_output *o, int type, const void *payload)
+{
+	struct sr_datafeed_packet packet;
+	GString *out;
+	int ret;
+
+	packet.type = type;
+	packet.payload = payload;
+	out = NULL;
+	ret = sr_output_send(o, &packet, &out);
+	if (out)
+		g_string_free(out, TRUE);
+
+	return ret;
+}
+
+static int feed(const struct sr_output *o, struct bench_data *bd)
+{
+	struct sr_datafeed_header header;
+	struct sr_datafeed_meta meta;
+	struct sr_config src;
+	struct sr_datafeed_logic logic;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+	GSList *l, *one;
+	int64_t left;
+	int count, ret;
+
+	memset(&header, 0, sizeof(header));
+	header.feed_version = 1;
+	if ((ret = send_packet(o, SR_DF_HEADER, &header)) != SR_OK)
+		return ret;
+
+	src.key = SR_CONF_SAMPLERATE;
+	src.data = g_variant_new_uint64(SR_MHZ(1));
+	meta.config = g_slist_append(NULL, &src);
+	ret = send_packet(o, SR_DF_META, &meta);
+	g_slist_free(meta.config);
+	g_variant_unref(g_variant_ref_sink(src.data));
+	if (ret != SR_OK)
+		return ret;
+
+	memset(&encoding, 0, sizeof(encoding));
+	encoding.unitsize = sizeof(float);
+	encoding.is_signed = TRUE;
+	encoding.is_float = TRUE;
+#ifdef WORDS_BIGENDIAN
+	encoding.is_bigendian = TRUE;
+#endif
+	encoding.digits = 3;
+	encoding.is_digits_decimal = TRUE;
+	encoding.scale.p = encoding.scale.q = 1;
+	encoding.offset.q = 1;
+	memset(&meaning, 0, sizeof(meaning));
+	meaning.mq = SR_MQ_VOLTAGE;
+	meaning.unit = SR_UNIT_VOLT;
+	spec.spec_digits = 3;
+	analog.data = bd->analog;
+	analog.encoding = &encoding;
+	analog.meaning = &meaning;
+	analog.spec = &spec;
+
+	logic.unitsize = unitsize;
+	logic.data = bd->logic;
+	for (left = num_samples; left > 0; left -= count) {
+		count = MIN(left, packet_samples);
+		logic.length = (uint64_t)count * unitsize;
+		if ((ret = send_packet(o, SR_DF_LOGIC, &logic)) != SR_OK)
+			return ret;
+		/* One packet per analog channel, like most devices send. */
+		for (l = bd->analog_channels; l; l = l->next) {
+			one = g_slist_append(NULL, l->data);
+			meaning.channels = one;
+			analog.num_samples = count;
+			ret = send_packet(o, SR_DF_ANALOG, &analog);
+			g_slist_free(one);
+			if (ret != SR_OK)
+				return ret;
+		}
+	}
+
+	return send_packet(o, SR_DF_END, NULL);
+}
+
+static void remove_tree(const char *path)
+{
+	GDir *dir;
+	const char *name;
+	char *sub;
+
+	if ((dir = g_dir_open(path, 0, NULL))) {
+		while ((name = g_dir_read_name(dir))) {
+			sub = g_build_filename(path, name, NULL);
+			remove_tree(sub);
+			g_free(sub);
+		}
+		g_dir_close(dir);
+	}
+	g_remove(path);
+}
+
+static long peak_memory_kib(void)
+{
+#ifndef _WIN32
+	struct rusage ru;
+
+	if (getrusage(RUSAGE_SELF, &ru) == 0)
+		return ru.ru_maxrss;
+#endif
+	return -1;
+}
+
+static void run_module(const struct sr_output_module *omod,
+		struct bench_data *bd, struct bench_result *res)
+{
+	const struct sr_output *o;
+	char *tmpdir, *filename;
+	gint64 start;
+
+	memset(res, 0, sizeof(*res));
+	tmpdir = g_dir_make_tmp("sigrok-bench-XXXXXX", NULL);
+	filename = g_build_filename(tmpdir ? tmpdir : ".", "out", NULL);
+
+	o = sr_output_new(omod, NULL, bd->sdi, filename);
+	if (!o) {
+		res->failed = TRUE;
+	} else {
+		sr_output_set_writer(o, count_output, &res->out_bytes);
+		start = g_get_monotonic_time();
+		res->failed = feed(o, bd) != SR_OK;
+		sr_output_free(o);
+		res->seconds = (g_get_monotonic_time() - start) / 1e6;
+	}
+	res->peak_kib = peak_memory_kib();
+
+	if (tmpdir)
+		remove_tree(tmpdir);
+	g_free(filename);
+	g_free(tmpdir);
+}
+
+/* Run each module in a process of its own, for its own peak memory. */
+static void run_isolated(const struct sr_output_module *omod,
+		struct bench_data *bd, struct bench_result *res)
+{
+#ifndef _WIN32
+	int fds[2], status;
+	pid_t pid;
+
+	if (pipe(fds) == 0 && (pid = fork()) >= 0) {
+		if (pid == 0) {
+			close(fds[0]);
+			run_module(omod, bd, res);
+			if (write(fds[1], res, sizeof(*res)) != sizeof(*res))
+				_exit(1);
+			_exit(0);
+		}
+		close(fds[1]);
+		if (read(fds[0], res, sizeof(*res)) != sizeof(*res)) {
+			memset(res, 0, sizeof(*res));
+			res->failed = TRUE;
+		}
+		close(fds[0]);
+		waitpid(pid, &status, 0);
+		return;
+	}
+#endif
+	run_module(omod, bd, res);
+}
+
+int main(int argc, char **argv)
+{
+	const struct sr_output_module **outputs;
+	struct sr_context *sr_ctx;
+	struct bench_data bd;
+	struct bench_result res;
+	GOptionContext *octx;
+	GError *error;
+	double in_mb;
+	size_t i;
+
+	error = NULL;
+	octx = g_option_context_new("- benchmark libsigrok output modules");
+	g_option_context_add_main_entries(octx, entries, NULL);
+	if (!g_option_context_parse(octx, &argc, &argv, &error)) {
+		fprintf(stderr, "%s\n", error->message);
+		return 1;
+	}
+	g_option_context_free(octx);
+	if (unitsize < 1 || num_analog < 0 || num_samples < 1 ||
+			packet_samples < 1 || density < 0 || density > 1) {
+		fprintf(stderr, "Invalid benchmark parameters.\n");
+		return 1;
+	}
+
+	if (sr_init(&sr_ctx) != SR_OK)
+		return 1;
+	sr_log_loglevel_set(SR_LOG_ERR);
+
+	memset(&bd, 0, sizeof(bd));
+	gen_device(&bd);
+	gen_data(&bd);
+	in_mb = (double)num_samples * (unitsize + num_analog * sizeof(float)) / 1e6;
+
+	printf("%" G_GINT64_FORMAT " samples, %d logic bytes and %d analog "
+		"channels per sample, %.1f MB input, density %g\n",
+		num_samples, unitsize, num_analog, in_mb, density);
+	printf("%-16s %10s %10s %12s %12s %10s\n", "module", "seconds",
+		"MB/s", "Msamples/s", "output MB", "peak KiB");
+
+	outputs = sr_output_list();
+	for (i = 0; outputs[i]; i++) {
+		if (module_id && strcmp(module_id, sr_output_id_get(outputs[i])))
+			continue;
+		run_isolated(outputs[i], &bd, &res);
+		if (res.failed) {
+			printf("%-16s %10s\n", sr_output_id_get(outputs[i]), "failed");
+			continue;
+		}
+		printf("%-16s %10.3f %10.1f %12.2f %12.1f %10ld\n",
+			sr_output_id_get(outputs[i]), res.seconds,
+			in_mb / res.seconds, num_samples / res.seconds / 1e6,
+			res.out_bytes / 1e6, res.peak_kib);
+	}
+
+	g_slist_free(bd.analog_channels);
+	g_free(bd.logic);
+	g_free(bd.analog);
+	sr_exit(sr_ctx);
+
+	return 0;
+}
@@ -0,0 +1,421 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * End-to-end benchmark of the acquisition pipeline. The demo driver
+ * feeds a session, which runs the selected transforms and passes the
+ * packets on to an output module. Each output module runs in a process
+ * of its own, and the sustained samples/s, the CPU time per wall clock
+ * time (cores busy) and the peak memory use are reported.
+ *
+ * By default the demo driver runs unthrottled, which measures the most
+ * the pipeline can take. With --realtime, it sends at the samplerate
+ * instead, through asynchronous dispatch with the drop policy, and the
+ * packets which the pipeline dropped for not keeping up are reported.
+ *
+ * The presets reflect typical workloads:
+ *   logic16  16 logic channels at 100 MHz.
+ *   scope4   4 analog channels at 10 MHz.
+ *
+ * Build and run with "make bench-pipeline", run with --help for options.
+ */
+
+#include <config.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#ifndef _WIN32
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+#include <libsigrok/libsigrok.h>
+
+struct preset {
+	const char *name;
+	int num_logic;
+	int num_analog;
+	uint64_t samplerate;
+	uint64_t samples;
+};
+
+static const struct preset presets[] = {
+	{ "logic16", 16, 0, SR_MHZ(100), 100 * 1000 * 1000 },
+	{ "scope4", 0, 4, SR_MHZ(10), 10 * 1000 * 1000 },
+};
+
+static gchar *preset_name;
+static gint64 num_samples;
+static gchar *transform_ids;
+static gchar *output_ids;
+static gboolean realtime;
+static gint async_depth = 256;
+
+static GOptionEntry entries[] = {
+	{ "preset", 'P', 0, G_OPTION_ARG_STRING, &preset_name,
+		"Workload: logic16 or scope4 (default logic16)", "NAME" },
+	{ "samples", 'n', 0, G_OPTION_ARG_INT64, &num_samples,
+		"Number of samples (default: per preset)", "N" },
+	{ "transforms", 't', 0, G_OPTION_ARG_STRING, &transform_ids,
+		"Comma separated transform modules, e.g. invert,scale", "IDS" },
+	{ "outputs", 'o', 0, G_OPTION_ARG_STRING, &output_ids,
+		"Comma separated output modules (default null,srzip,vcd,csv)", "IDS" },
+	{ "realtime", 'r', 0, G_OPTION_ARG_NONE, &realtime,
+		"Send at the samplerate, and report dropped packets", NULL },
+	{ "async", 'a', 0, G_OPTION_ARG_INT, &async_depth,
+		"Dispatch queue depth with --realtime (default 256)", "N" },
+	{ NULL, 0, 0, 0, NULL, NULL, NULL }
+};
+
+struct bench_result {
+	uint64_t samples;
+	uint64_t out_bytes;
+	uint64_t dropped;
+	double seconds;
+	double cores;
+	long peak_kib;
+	gboolean failed;
+};
+
+struct bench_run {
+	const struct preset *preset;
+	const struct sr_output *o;
+	struct bench_result *res;
+	/* Analog values, across all channels. */
+	uint64_t values;
+};
+
+static int count_output(const struct sr_output *o, const uint8_t *data,
+		size_t length, void *cb_data)
+{
+	(void)o;
+	(void)data;
+
+	*(uint64_t *)cb_data += length;
+
+	return SR_OK;
+}
+
+static void datafeed_in(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	const struct sr_datafeed_logic *logic;
+	const struct sr_datafeed_analog *analog;
+	struct bench_run *run;
+	GString *out;
+
+	(void)sdi;
+
+	run = cb_data;
+	if (packet->type == SR_DF_LOGIC) {
+		logic = packet->payload;
+		run->res->samples += logic->length / logic->unitsize;
+	} else if (packet->type == SR_DF_ANALOG && !run->preset->num_logic) {
+		analog = packet->payload;
+		run->values += (uint64_t)analog->num_samples
+			* g_slist_length(analog->meaning->channels);
+		run->res->samples = run->values / run->preset->num_analog;
+	}
+
+	out = NULL;
+	if (sr_output_send(run->o, packet, &out) != SR_OK)
+		run->res->failed = TRUE;
+	if (out)
+		g_string_free(out, TRUE);
+}
+
+static struct sr_dev_inst *scan_demo(struct sr_context *ctx,
+		const struct preset *preset)
+{
+	struct sr_dev_driver **drivers, *driver;
+	struct sr_config logic_src, analog_src;
+	struct sr_dev_inst *sdi;
+	GSList *options, *devices;
+	int i;
+
+	driver = NULL;
+	drivers = sr_driver_list(ctx);
+	for (i = 0; drivers && drivers[i]; i++) {
+		if (!strcmp(drivers[i]->name, "demo"))
+			driver = drivers[i];
+	}
+	if (!driver || sr_driver_init(ctx, driver) != SR_OK)
+		return NULL;
+
+	logic_src.key = SR_CONF_NUM_LOGIC_CHANNELS;
+	logic_src.data = g_variant_ref_sink(g_variant_new_int32(preset->num_logic));
+	analog_src.key = SR_CONF_NUM_ANALOG_CHANNELS;
+	analog_src.data = g_variant_ref_sink(g_variant_new_int32(preset->num_analog));
+	options = g_slist_append(NULL, &logic_src);
+	options = g_slist_append(options, &analog_src);
+	devices = sr_driver_scan(driver, options);
+	g_slist_free(options);
+	g_variant_unref(logic_src.data);
+	g_variant_unref(analog_src.data);
+
+	sdi = devices ? devices->data : NULL;
+	g_slist_free(devices);
+
+	return sdi;
+}
+
+/* Instantiate the transforms in --transforms, in order. */
+static gboolean add_transforms(const struct sr_dev_inst *sdi, GSList **list)
+{
+	const struct sr_transform_module *tmod;
+	const struct sr_transform *t;
+	char **ids;
+	gboolean ok;
+	int i;
+
+	if (!transform_ids || !transform_ids[0])
+		return TRUE;
+
+	ids = g_strsplit(transform_ids, ",", 0);
+	for (i = 0; ids[i]; i++) {
+		if (!(tmod = sr_transform_find(ids[i]))) {
+			fprintf(stderr, "Unknown transform module '%s'.\n", ids[i]);
+			break;
+		}
+		if (!(t = sr_transform_new(tmod, NULL, sdi)))
+			break;
+		*list = g_slist_append(*list, (gpointer)t);
+	}
+	ok = !ids[i];
+	g_strfreev(ids);
+
+	return ok;
+}
+
+static double cpu_seconds(void)
+{
+#ifndef _WIN32
+	struct rusage ru;
+
+	if (getrusage(RUSAGE_SELF, &ru) == 0)
+		return ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6
+			+ ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+#endif
+	return 0;
+}
+
+static long peak_memory_kib(void)
+{
+#ifndef _WIN32
+	struct rusage ru;
+
+	if (getrusage(RUSAGE_SELF, &ru) == 0)
+		return ru.ru_maxrss;
+#endif
+	return -1;
+}
+
+static void remove_tree(const char *path)
+{
+	GDir *dir;
+	const char *name;
+	char *sub;
+
+	if ((dir = g_dir_open(path, 0, NULL))) {
+		while ((name = g_dir_read_name(dir))) {
+			sub = g_build_filename(path, name, NULL);
+			remove_tree(sub);
+			g_free(sub);
+		}
+		g_dir_close(dir);
+	}
+	g_remove(path);
+}
+
+static gboolean configure(struct sr_dev_inst *sdi, const struct preset *preset)
+{
+	if (sr_config_set(sdi, NULL, SR_CONF_SAMPLERATE,
+			g_variant_new_uint64(preset->samplerate)) != SR_OK)
+		return FALSE;
+	if (sr_config_set(sdi, NULL, SR_CONF_LIMIT_SAMPLES,
+			g_variant_new_uint64(num_samples)) != SR_OK)
+		return FALSE;
+	if (sr_config_set(sdi, NULL, SR_CONF_UNTHROTTLED,
+			g_variant_new_boolean(!realtime)) != SR_OK)
+		return FALSE;
+
+	return TRUE;
+}
+
+static void run_output(struct sr_context *ctx, const struct preset *preset,
+		const struct sr_output_module *omod, struct bench_result *res)
+{
+	struct sr_dispatch_stats stats;
+	struct sr_session *session;
+	struct sr_dev_inst *sdi;
+	struct bench_run run;
+	GSList *transforms, *l;
+	char *tmpdir, *filename;
+	gint64 start;
+	double cpu;
+
+	memset(res, 0, sizeof(*res));
+	memset(&run, 0, sizeof(run));
+	run.preset = preset;
+	run.res = res;
+	transforms = NULL;
+	session = NULL;
+	tmpdir = g_dir_make_tmp("sigrok-bench-XXXXXX", NULL);
+	filename = g_build_filename(tmpdir ? tmpdir : ".", "out", NULL);
+
+	res->failed = TRUE;
+	if (!(sdi = scan_demo(ctx, preset)) || sr_dev_open(sdi) != SR_OK)
+		goto done;
+	if (!configure(sdi, preset))
+		goto done;
+	sr_session_new(ctx, &session);
+	sr_session_dev_add(session, sdi);
+	if (realtime && sr_session_dispatch_async_set(session, async_depth,
+			SR_DISPATCH_DROP) != SR_OK)
+		goto done;
+	if (!add_transforms(sdi, &transforms))
+		goto done;
+	if (!(run.o = sr_output_new(omod, NULL, sdi, filename)))
+		goto done;
+	sr_output_set_writer(run.o, count_output, &res->out_bytes);
+	sr_session_datafeed_callback_add(session, datafeed_in, &run);
+
+	res->failed = FALSE;
+	cpu = cpu_seconds();
+	start = g_get_monotonic_time();
+	if (sr_session_start(session) != SR_OK || sr_session_run(session) != SR_OK)
+		res->failed = TRUE;
+	res->seconds = (g_get_monotonic_time() - start) / 1e6;
+	if (res->seconds > 0)
+		res->cores = (cpu_seconds() - cpu) / res->seconds;
+	if (sr_session_dispatch_stats_get(session, &stats) == SR_OK)
+		res->dropped = stats.dropped;
+	sr_output_free(run.o);
+
+done:
+	if (session)
+		sr_session_destroy(session);
+	for (l = transforms; l; l = l->next)
+		sr_transform_free(l->data);
+	g_slist_free(transforms);
+	if (sdi)
+		sr_dev_close(sdi);
+	res->peak_kib = peak_memory_kib();
+	if (tmpdir)
+		remove_tree(tmpdir);
+	g_free(filename);
+	g_free(tmpdir);
+}
+
+/* Run each module in a process of its own, for its own peak memory. */
+static void run_isolated(struct sr_context *ctx, const struct preset *preset,
+		const struct sr_output_module *omod, struct bench_result *res)
+{
+#ifndef _WIN32
+	int fds[2], status;
+	pid_t pid;
+
+	if (pipe(fds) == 0 && (pid = fork()) >= 0) {
+		if (pid == 0) {
+			close(fds[0]);
+			run_output(ctx, preset, omod, res);
+			if (write(fds[1], res, sizeof(*res)) != sizeof(*res))
+				_exit(1);
+			_exit(0);
+		}
+		close(fds[1]);
+		if (read(fds[0], res, sizeof(*res)) != sizeof(*res)) {
+			memset(res, 0, sizeof(*res));
+			res->failed = TRUE;
+		}
+		close(fds[0]);
+		waitpid(pid, &status, 0);
+		return;
+	}
+#endif
+	run_output(ctx, preset, omod, res);
+}
+
+int main(int argc, char **argv)
+{
+	const struct sr_output_module *omod;
+	const struct preset *preset;
+	struct sr_context *sr_ctx;
+	struct bench_result res;
+	GOptionContext *octx;
+	GError *error;
+	char **ids;
+	size_t i;
+
+	error = NULL;
+	octx = g_option_context_new("- benchmark the libsigrok pipeline");
+	g_option_context_add_main_entries(octx, entries, NULL);
+	if (!g_option_context_parse(octx, &argc, &argv, &error)) {
+		fprintf(stderr, "%s\n", error->message);
+		return 1;
+	}
+	g_option_context_free(octx);
+
+	preset = NULL;
+	for (i = 0; i < G_N_ELEMENTS(presets); i++) {
+		if (!strcmp(preset_name ? preset_name : "logic16", presets[i].name))
+			preset = &presets[i];
+	}
+	if (!preset || num_samples < 0 || async_depth < 1) {
+		fprintf(stderr, "Invalid benchmark parameters.\n");
+		return 1;
+	}
+	if (!num_samples)
+		num_samples = preset->samples;
+
+	if (sr_init(&sr_ctx) != SR_OK)
+		return 1;
+	sr_log_loglevel_set(SR_LOG_ERR);
+
+	printf("Preset %s: %d logic, %d analog channels at %" PRIu64 " Hz, "
+		"%" G_GINT64_FORMAT " samples, %s, transforms: %s\n",
+		preset->name, preset->num_logic, preset->num_analog,
+		preset->samplerate, num_samples,
+		realtime ? "realtime" : "unthrottled",
+		transform_ids && transform_ids[0] ? transform_ids : "none");
+	printf("%-12s %10s %12s %8s %12s %10s %10s\n", "output", "seconds",
+		"Msamples/s", "cores", "output MB", "dropped", "peak KiB");
+
+	ids = g_strsplit(output_ids ? output_ids : "null,srzip,vcd,csv", ",", 0);
+	for (i = 0; ids[i]; i++) {
+		if (!(omod = sr_output_find(ids[i]))) {
+			printf("%-12s %10s\n", ids[i], "unknown");
+			continue;
+		}
+		run_isolated(sr_ctx, preset, omod, &res);
+		if (res.failed) {
+			printf("%-12s %10s\n", ids[i], "failed");
+			continue;
+		}
+		printf("%-12s %10.3f %12.2f %8.2f %12.1f %10" PRIu64 " %10ld\n",
+			ids[i], res.seconds, res.samples / res.seconds / 1e6,
+			res.cores, res.out_bytes / 1e6, res.dropped, res.peak_kib);
+	}
+	g_strfreev(ids);
+
+	sr_exit(sr_ctx);
+
+	return 0;
+}
@@ -0,0 +1,620 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Latency and throughput benchmark of the SCPI layer, against a mock
+ * instrument which listens on a local TCP port.
+ *
+ * The mock instrument answers "*IDN?", "*OPC?", queries of previously
+ * set values ("CHAN1:SCAL 0.5" makes "CHAN1:SCAL?" return "0.5"), and
+ * ":WAV:DATA?" with a definite length block of --payload bytes. Each
+ * response is delayed by --latency microseconds, like the processing
+ * time of a real instrument. With --script, the responses are read from
+ * a file of "<query> <response>" lines, where a response of "#block"
+ * or "#block <bytes>" sends a definite length block. With --rigol, each
+ * response is framed for the "tcp-rigol" transport.
+ *
+ * The client measures the round trip time of queries and the block
+ * throughput via sr_scpi_get_block_into() and, with --work microseconds
+ * of processing per block, the gain of sr_scpi_get_block_pipelined().
+ * With --serve, only the mock instrument runs, for use with drivers,
+ * e.g. "sigrok-cli -d <driver>:conn=tcp-raw/127.0.0.1/<port>". With
+ * --connect, the client benchmarks another instrument instead.
+ *
+ * The SCPI API is private to the library, so this program links
+ * libsigrok statically. VXI-11 and USBTMC have no loopback device, so
+ * only the TCP transports are covered.
+ *
+ * Build with "make tests/bench_scpi", or build and run with
+ * "make bench-scpi". Run with --help for options.
+ */
+
+#include <config.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <glib.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+#include "scpi.h"
+
+#define IDN_RESPONSE "sigrok,Mock SCPI instrument,0,1.0"
+#define BLOCK_COMMAND ":WAV:DATA?"
+#define CONFIG_QUERY ":TIM:SCAL?"
+
+static gint64 latency_us;
+static gint64 payload_size = 1024 * 1024;
+static gint64 work_us;
+static gint min_time_ms = 500;
+static gint port;
+static gboolean rigol;
+static gboolean serve;
+static gboolean csv;
+static gchar *script;
+static gchar *connect_resource;
+static gchar *filter;
+
+static GOptionEntry entries[] = {
+	{ "latency", 'l', 0, G_OPTION_ARG_INT64, &latency_us,
+		"Mock response latency in us (default 0)", "US" },
+	{ "payload", 'p', 0, G_OPTION_ARG_INT64, &payload_size,
+		"Mock block size in bytes (default 1048576)", "BYTES" },
+	{ "work", 'w', 0, G_OPTION_ARG_INT64, &work_us,
+		"Client processing time per block in us (default 0)", "US" },
+	{ "time", 't', 0, G_OPTION_ARG_INT, &min_time_ms,
+		"Minimum time per benchmark in ms (default 500)", "MS" },
+	{ "script", 's', 0, G_OPTION_ARG_FILENAME, &script,
+		"Mock responses, lines of \"<query> <response>\"", "FILE" },
+	{ "rigol", 'r', 0, G_OPTION_ARG_NONE, &rigol,
+		"Frame responses for the tcp-rigol transport", NULL },
+	{ "serve", 'S', 0, G_OPTION_ARG_NONE, &serve,
+		"Only run the mock instrument", NULL },
+	{ "port", 'P', 0, G_OPTION_ARG_INT, &port,
+		"Mock port (default: any free port)", "PORT" },
+	{ "connect", 'C', 0, G_OPTION_ARG_STRING, &connect_resource,
+		"Benchmark this SCPI resource instead of the mock", "RESOURCE" },
+	{ "csv", 'c', 0, G_OPTION_ARG_NONE, &csv,
+		"Print comma separated values", NULL },
+	{ "filter", 'f', 0, G_OPTION_ARG_STRING, &filter,
+		"Only run benchmarks whose name contains this", "TEXT" },
+	{ NULL, 0, 0, 0, NULL, NULL, NULL }
+};
+
+struct mock {
+	int listen_fd;
+	int port;
+	/* Scripted responses, keyed by the upper case query. */
+	GHashTable *rules;
+	/* Values of set commands, keyed by the upper case query. */
+	GHashTable *values;
+	/* Encoded blocks, keyed by their data size. */
+	GHashTable *blocks;
+	GThread *thread;
+};
+
+/* A definite length block: "#<digits><length><data>\n". */
+static GByteArray *block_new(size_t size)
+{
+	GByteArray *block;
+	char header[32];
+	size_t i, len;
+
+	len = snprintf(header, sizeof(header), "#%d%zu",
+		(int)snprintf(NULL, 0, "%zu", size), size);
+	block = g_byte_array_sized_new(len + size + 1);
+	g_byte_array_append(block, (const guint8 *)header, len);
+	g_byte_array_set_size(block, len + size);
+	/* A sawtooth, like a waveform of 8-bit samples. */
+	for (i = 0; i < size; i++)
+		block->data[len + i] = i & 0xff;
+	g_byte_array_append(block, (const guint8 *)"\n", 1);
+
+	return block;
+}
+
+static void block_free(void *data)
+{
+	g_byte_array_free(data, TRUE);
+}
+
+static int send_all(int fd, const void *data, size_t len)
+{
+	const uint8_t *p;
+	ssize_t ret;
+
+	p = data;
+	while (len) {
+		ret = send(fd, p, len, MSG_NOSIGNAL);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret <= 0)
+			return -1;
+		p += ret;
+		len -= ret;
+	}
+
+	return 0;
+}
+
+static int mock_respond(int fd, const void *data, size_t len)
+{
+	uint8_t frame[4];
+
+	if (latency_us)
+		g_usleep(latency_us);
+	if (rigol) {
+		WL32(frame, len);
+		if (send_all(fd, frame, sizeof(frame)) < 0)
+			return -1;
+	}
+
+	return send_all(fd, data, len);
+}
+
+static int mock_respond_block(struct mock *m, int fd, size_t size)
+{
+	GByteArray *block;
+
+	block = g_hash_table_lookup(m->blocks, GSIZE_TO_POINTER(size));
+	if (!block) {
+		block = block_new(size);
+		g_hash_table_insert(m->blocks, GSIZE_TO_POINTER(size), block);
+	}
+
+	return mock_respond(fd, block->data, block->len);
+}
+
+static int mock_respond_string(int fd, const char *s)
+{
+	char *line;
+	int ret;
+
+	line = g_strconcat(s, "\n", NULL);
+	ret = mock_respond(fd, line, strlen(line));
+	g_free(line);
+
+	return ret;
+}
+
+static int mock_command(struct mock *m, int fd, char *line)
+{
+	const char *response;
+	char *arg, *header;
+	uint64_t size;
+	int ret;
+
+	g_strstrip(line);
+	if (!*line)
+		return 0;
+	if ((arg = strpbrk(line, " \t"))) {
+		*arg++ = '\0';
+		g_strstrip(arg);
+	}
+	header = g_ascii_strup(line, -1);
+
+	ret = 0;
+	if (!g_str_has_suffix(header, "?")) {
+		/* A set command, remember the value for its query. */
+		if (arg)
+			g_hash_table_replace(m->values,
+				g_strconcat(header, "?", NULL), g_strdup(arg));
+	} else if ((response = g_hash_table_lookup(m->rules, header))) {
+		if (g_str_has_prefix(response, "#block")) {
+			size = g_ascii_strtoull(response + 6, NULL, 10);
+			ret = mock_respond_block(m, fd,
+				size ? size : (uint64_t)payload_size);
+		} else {
+			ret = mock_respond_string(fd, response);
+		}
+	} else if ((response = g_hash_table_lookup(m->values, header))) {
+		ret = mock_respond_string(fd, response);
+	} else if (!strcmp(header, BLOCK_COMMAND)) {
+		ret = mock_respond_block(m, fd, payload_size);
+	} else if (!strcmp(header, "*IDN?")) {
+		ret = mock_respond_string(fd, IDN_RESPONSE);
+	} else {
+		/* Unknown queries get an answer, so clients don't time out. */
+		ret = mock_respond_string(fd, "0");
+	}
+	g_free(header);
+
+	return ret;
+}
+
+/* Answer the commands of one client, until it disconnects. */
+static void mock_serve_client(struct mock *m, int fd)
+{
+	GString *buf;
+	char chunk[4096], *nl;
+	ssize_t len;
+	int one;
+
+	one = 1;
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	buf = g_string_sized_new(sizeof(chunk));
+	for (;;) {
+		len = recv(fd, chunk, sizeof(chunk), 0);
+		if (len < 0 && errno == EINTR)
+			continue;
+		if (len <= 0)
+			break;
+		g_string_append_len(buf, chunk, len);
+		while ((nl = memchr(buf->str, '\n', buf->len))) {
+			*nl = '\0';
+			if (mock_command(m, fd, buf->str) < 0)
+				goto out;
+			g_string_erase(buf, 0, nl - buf->str + 1);
+		}
+	}
+out:
+	g_string_free(buf, TRUE);
+	close(fd);
+}
+
+static gpointer mock_thread(gpointer data)
+{
+	struct mock *m;
+	int fd;
+
+	m = data;
+	do {
+		fd = accept(m->listen_fd, NULL, NULL);
+		if (fd < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+		mock_serve_client(m, fd);
+	} while (serve);
+
+	return NULL;
+}
+
+static int mock_load_script(struct mock *m, const char *filename)
+{
+	char *contents, **lines, *line, *response;
+	GError *error;
+	size_t i;
+
+	error = NULL;
+	if (!g_file_get_contents(filename, &contents, NULL, &error)) {
+		fprintf(stderr, "%s\n", error->message);
+		g_error_free(error);
+		return -1;
+	}
+	lines = g_strsplit(contents, "\n", 0);
+	g_free(contents);
+	for (i = 0; lines[i]; i++) {
+		line = g_strstrip(lines[i]);
+		if (!*line || *line == '#')
+			continue;
+		if (!(response = strpbrk(line, " \t"))) {
+			fprintf(stderr, "%s:%zu: No response.\n", filename, i + 1);
+			g_strfreev(lines);
+			return -1;
+		}
+		*response++ = '\0';
+		g_hash_table_replace(m->rules, g_ascii_strup(line, -1),
+			g_strdup(g_strstrip(response)));
+	}
+	g_strfreev(lines);
+
+	return 0;
+}
+
+static int mock_start(struct mock *m)
+{
+	struct sockaddr_in addr;
+	socklen_t addrlen;
+	int one;
+
+	m->rules = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+	m->values = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+	m->blocks = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL,
+		block_free);
+	g_hash_table_insert(m->values, g_strdup("*OPC?"), g_strdup("1"));
+	g_hash_table_insert(m->values, g_strdup(CONFIG_QUERY), g_strdup("1.0E-3"));
+	if (script && mock_load_script(m, script) < 0)
+		return -1;
+
+	if ((m->listen_fd = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
+		perror("socket");
+		return -1;
+	}
+	one = 1;
+	setsockopt(m->listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons(port);
+	if (bind(m->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0
+			|| listen(m->listen_fd, 1) < 0) {
+		perror("bind");
+		close(m->listen_fd);
+		return -1;
+	}
+	addrlen = sizeof(addr);
+	getsockname(m->listen_fd, (struct sockaddr *)&addr, &addrlen);
+	m->port = ntohs(addr.sin_port);
+
+	m->thread = g_thread_new("mock-scpi", mock_thread, m);
+
+	return 0;
+}
+
+static void mock_stop(struct mock *m)
+{
+	/* Wake up accept() in case the client never connected. */
+	shutdown(m->listen_fd, SHUT_RDWR);
+	g_thread_join(m->thread);
+	close(m->listen_fd);
+	g_hash_table_destroy(m->rules);
+	g_hash_table_destroy(m->values);
+	g_hash_table_destroy(m->blocks);
+}
+
+struct bench {
+	struct sr_scpi_dev_inst *scpi;
+	GByteArray *block;
+	/* Round trip times in us, of one benchmark. */
+	GArray *times;
+	uint64_t bytes;
+};
+
+typedef gboolean (*bench_fn)(struct bench *b);
+
+static int cmp_time(gconstpointer a, gconstpointer b)
+{
+	gint64 ta, tb;
+
+	ta = *(const gint64 *)a;
+	tb = *(const gint64 *)b;
+
+	return ta < tb ? -1 : ta > tb;
+}
+
+static void report(struct bench *b, const char *name, double seconds)
+{
+	gint64 *t, median, p99;
+	double mbps;
+	guint n;
+
+	n = b->times->len;
+	g_array_sort(b->times, cmp_time);
+	t = (gint64 *)b->times->data;
+	median = t[n / 2];
+	p99 = t[MIN(n - 1, n * 99 / 100)];
+	mbps = b->bytes / seconds / (1024 * 1024);
+
+	if (csv) {
+		printf("%s,%u,%" G_GINT64_FORMAT ",%" G_GINT64_FORMAT ",",
+			name, n, median, p99);
+		if (b->bytes)
+			printf("%.2f\n", mbps);
+		else
+			printf("\n");
+	} else {
+		printf("%-28s %10u %10" G_GINT64_FORMAT " %10" G_GINT64_FORMAT,
+			name, n, median, p99);
+		if (b->bytes)
+			printf(" %10.2f\n", mbps);
+		else
+			printf(" %10s\n", "-");
+	}
+}
+
+static void run(struct bench *b, const char *name, bench_fn fn)
+{
+	gint64 start, op_start, now, t;
+
+	if (filter && !strstr(name, filter))
+		return;
+
+	/* Warm up the connection and the receive buffers. */
+	if (!fn(b)) {
+		if (csv)
+			printf("%s,,,,\n", name);
+		else
+			printf("%-28s %10s\n", name, "failed");
+		return;
+	}
+
+	g_array_set_size(b->times, 0);
+	b->bytes = 0;
+	start = now = g_get_monotonic_time();
+	do {
+		op_start = now;
+		if (!fn(b))
+			break;
+		now = g_get_monotonic_time();
+		t = now - op_start;
+		g_array_append_val(b->times, t);
+	} while (now - start < min_time_ms * 1000);
+
+	if (b->times->len)
+		report(b, name, (now - start) / 1e6);
+}
+
+static gboolean bench_idn(struct bench *b)
+{
+	char *response;
+	int ret;
+
+	response = NULL;
+	ret = sr_scpi_get_string(b->scpi, "*IDN?", &response);
+	g_free(response);
+
+	return ret == SR_OK;
+}
+
+static gboolean bench_config(struct bench *b)
+{
+	double value;
+
+	return sr_scpi_get_double(b->scpi, CONFIG_QUERY, &value) == SR_OK;
+}
+
+static gboolean bench_set_opc(struct bench *b)
+{
+	if (sr_scpi_send(b->scpi, ":CHAN1:SCAL 0.5") != SR_OK)
+		return FALSE;
+
+	return sr_scpi_get_opc(b->scpi) == SR_OK;
+}
+
+static void process_block(struct bench *b)
+{
+	b->bytes += b->block->len;
+	if (work_us)
+		g_usleep(work_us);
+}
+
+static gboolean bench_block(struct bench *b)
+{
+	if (sr_scpi_get_block_into(b->scpi, BLOCK_COMMAND, b->block) != SR_OK)
+		return FALSE;
+	process_block(b);
+
+	return TRUE;
+}
+
+/*
+ * Blocks are requested back to back, with the next request sent before
+ * the current block is processed. One request is outstanding, which is
+ * read without a command first.
+ */
+static gboolean bench_block_pipelined(struct bench *b)
+{
+	gboolean sent;
+
+	if (sr_scpi_send(b->scpi, BLOCK_COMMAND) != SR_OK)
+		return FALSE;
+	if (sr_scpi_get_block_pipelined(b->scpi, NULL, b->block,
+			BLOCK_COMMAND, &sent) != SR_OK || !sent)
+		return FALSE;
+	process_block(b);
+	if (sr_scpi_get_block_pipelined(b->scpi, NULL, b->block,
+			NULL, NULL) != SR_OK)
+		return FALSE;
+	process_block(b);
+
+	return TRUE;
+}
+
+static void run_benchmarks(struct bench *b)
+{
+	static const char *const cached[] = { CONFIG_QUERY, NULL };
+
+	if (csv)
+		printf("benchmark,ops,median_us,p99_us,mb_per_s\n");
+	else
+		printf("%-28s %10s %10s %10s %10s\n", "benchmark", "ops",
+			"median us", "p99 us", "MB/s");
+
+	run(b, "idn", bench_idn);
+	run(b, "config", bench_config);
+	run(b, "set_opc", bench_set_opc);
+	sr_scpi_cache_enable(b->scpi, cached, 1000);
+	run(b, "config_cached", bench_config);
+	sr_scpi_cache_enable(b->scpi, NULL, 0);
+	run(b, "get_block", bench_block);
+	/* Each operation reads two blocks. */
+	run(b, "get_block_pipelined_x2", bench_block_pipelined);
+}
+
+int main(int argc, char **argv)
+{
+	struct sr_context *ctx;
+	struct mock m;
+	struct bench b;
+	GOptionContext *octx;
+	GError *error;
+	char *resource;
+	int ret;
+
+	error = NULL;
+	octx = g_option_context_new("- benchmark the SCPI layer against a mock instrument");
+	g_option_context_add_main_entries(octx, entries, NULL);
+	if (!g_option_context_parse(octx, &argc, &argv, &error)) {
+		fprintf(stderr, "%s\n", error->message);
+		return 1;
+	}
+	g_option_context_free(octx);
+	if (latency_us < 0 || work_us < 0 || payload_size < 1
+			|| payload_size > G_MAXINT || min_time_ms < 1
+			|| port < 0 || port > 65535
+			|| (serve && connect_resource)) {
+		fprintf(stderr, "Invalid benchmark parameters.\n");
+		return 1;
+	}
+
+	memset(&m, 0, sizeof(m));
+	if (!connect_resource && mock_start(&m) < 0)
+		return 1;
+	if (serve) {
+		printf("Mock SCPI instrument at tcp-%s/127.0.0.1/%d\n",
+			rigol ? "rigol" : "raw", m.port);
+		fflush(stdout);
+		g_thread_join(m.thread);
+		return 0;
+	}
+
+	if (sr_init(&ctx) != SR_OK)
+		return 1;
+	sr_log_loglevel_set(SR_LOG_ERR);
+
+	if (connect_resource)
+		resource = g_strdup(connect_resource);
+	else
+		resource = g_strdup_printf("tcp-%s/127.0.0.1/%d",
+			rigol ? "rigol" : "raw", m.port);
+	memset(&b, 0, sizeof(b));
+	ret = 1;
+	if (!(b.scpi = scpi_dev_inst_new(NULL, resource, NULL))) {
+		fprintf(stderr, "Invalid SCPI resource '%s'.\n", resource);
+		goto out;
+	}
+	if (sr_scpi_open(b.scpi) != SR_OK) {
+		fprintf(stderr, "Failed to open '%s'.\n", resource);
+		sr_scpi_free(b.scpi);
+		goto out;
+	}
+	b.block = g_byte_array_new();
+	b.times = g_array_new(FALSE, FALSE, sizeof(gint64));
+
+	run_benchmarks(&b);
+
+	sr_scpi_close(b.scpi);
+	sr_scpi_free(b.scpi);
+	g_byte_array_free(b.block, TRUE);
+	g_array_free(b.times, TRUE);
+	ret = 0;
+out:
+	/* Closing the connection ends the mock's client loop. */
+	if (!connect_resource)
+		mock_stop(&m);
+	g_free(resource);
+	sr_exit(ctx);
+
+	return ret;
+}
@@ -231,6 +231,50 @@ START_TEST(test_endian_write_inc)
 }
 END_TEST
 
+/* Transitions are found across packets, and in the packets' tails. */
+START_TEST(test_logic_edges)
+{
+	static const uint8_t data1[] = {
+		0x00, 0x00, 0x01, 0x01, 0x03, 0x03, 0x03, 0x03,
+		0x03, 0x02,
+	};
+	static const uint8_t data2[] = {
+		0x00, 0x00, 0x00,
+	};
+	static const uint64_t ch0[] = { 2, 9 };
+	static const uint64_t ch1[] = { 4, 10 };
+	struct sr_logic_edge_index *index;
+	struct sr_datafeed_logic logic;
+	const uint64_t *samples;
+	uint64_t count;
+
+	index = sr_logic_edge_index_new(0x03);
+	fail_unless(index != NULL);
+
+	logic.unitsize = 1;
+	logic.length = sizeof(data1);
+	logic.data = (void *)data1;
+	fail_unless(sr_logic_edges_find(index, &logic) == SR_OK);
+	logic.length = sizeof(data2);
+	logic.data = (void *)data2;
+	fail_unless(sr_logic_edges_find(index, &logic) == SR_OK);
+
+	fail_unless(sr_logic_edge_index_get(index, 0, &samples, &count) == SR_OK);
+	fail_unless(count == ARRAY_SIZE(ch0));
+	fail_unless(memcmp(samples, ch0, sizeof(ch0)) == 0);
+	fail_unless(sr_logic_edge_index_get(index, 1, &samples, &count) == SR_OK);
+	fail_unless(count == ARRAY_SIZE(ch1));
+	fail_unless(memcmp(samples, ch1, sizeof(ch1)) == 0);
+	fail_unless(sr_logic_edge_index_get(index, 2, &samples, &count) == SR_ERR_ARG);
+
+	sr_logic_edge_index_clear(index);
+	fail_unless(sr_logic_edge_index_get(index, 0, &samples, &count) == SR_OK);
+	fail_unless(count == 0);
+
+	sr_logic_edge_index_free(index);
+}
+END_TEST
+
 Suite *suite_conv(void)
 {
 	Suite *s;
@@ -246,5 +290,9 @@ Suite *suite_conv(void)
 	tcase_add_test(tc, test_endian_write_inc);
 	suite_add_tcase(s, tc);
 
+	tc = tcase_create("logic");
+	tcase_add_test(tc, test_logic_edges);
+	suite_add_tcase(s, tc);
+
 	return s;
 }
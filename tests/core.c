@@ -162,6 +162,108 @@ START_TEST(test_exit_null)
 }
 END_TEST
 
+static int count_messages(void *cb_data, int loglevel, const char *format,
+		va_list args)
+{
+	(void)loglevel;
+	(void)format;
+	(void)args;
+
+	g_atomic_int_inc((gint *)cb_data);
+
+	return SR_OK;
+}
+
+/* Check that asynchronously logged messages reach the callback. */
+START_TEST(test_log_async)
+{
+	int ret;
+	gint count;
+
+	count = 0;
+	sr_log_callback_set(count_messages, &count);
+	ret = sr_log_async_start(16);
+	fail_unless(ret == SR_OK, "sr_log_async_start() failed: %d.", ret);
+	ret = sr_log_async_start(16);
+	fail_unless(ret != SR_OK, "Second sr_log_async_start() should fail.");
+
+	/* Logs a debug message. */
+	sr_log_loglevel_set(SR_LOG_DBG);
+	sr_log_loglevel_set(SR_LOG_NONE);
+
+	ret = sr_log_async_stop();
+	fail_unless(ret == SR_OK, "sr_log_async_stop() failed: %d.", ret);
+	sr_log_callback_set_default();
+	fail_unless(g_atomic_int_get(&count) == 1,
+		"Expected 1 message, got %d.", count);
+}
+END_TEST
+
+static void *test_alloc(size_t size, void *cb_data)
+{
+	(void)cb_data;
+
+	return g_malloc(size);
+}
+
+static void test_free(void *buf, size_t size, void *cb_data)
+{
+	(void)size;
+	(void)cb_data;
+
+	g_free(buf);
+}
+
+/* Check the argument checks of the sample buffer settings. */
+START_TEST(test_buffer_settings)
+{
+	int ret;
+
+	sr_log_loglevel_set(SR_LOG_NONE);
+
+	ret = sr_buffer_hugepages_set(SR_HUGEPAGES_TRANSPARENT);
+	fail_unless(ret == SR_OK, "sr_buffer_hugepages_set() failed: %d.", ret);
+	ret = sr_buffer_hugepages_set(SR_HUGEPAGES_NONE);
+	fail_unless(ret == SR_OK, "sr_buffer_hugepages_set() failed: %d.", ret);
+	ret = sr_buffer_hugepages_set(0);
+	fail_unless(ret == SR_ERR_ARG, "Invalid mode should fail.");
+
+	ret = sr_buffer_allocator_set(test_alloc, NULL, NULL);
+	fail_unless(ret == SR_ERR_ARG, "Lone alloc callback should fail.");
+	ret = sr_buffer_allocator_set(NULL, test_free, NULL);
+	fail_unless(ret == SR_ERR_ARG, "Lone free callback should fail.");
+	ret = sr_buffer_allocator_set(test_alloc, test_free, NULL);
+	fail_unless(ret == SR_OK, "sr_buffer_allocator_set() failed: %d.", ret);
+	ret = sr_buffer_allocator_set(NULL, NULL, NULL);
+	fail_unless(ret == SR_OK, "sr_buffer_allocator_set() failed: %d.", ret);
+}
+END_TEST
+
+/* Check the memory accounting counters and budget. */
+START_TEST(test_mem_stats)
+{
+	struct sr_mem_stats stats;
+	int ret;
+
+	sr_log_loglevel_set(SR_LOG_NONE);
+
+	ret = sr_mem_stats_get(SR_MEM_PACKETS, &stats);
+	fail_unless(ret == SR_OK, "sr_mem_stats_get() failed: %d.", ret);
+	fail_unless(stats.peak >= stats.bytes);
+	ret = sr_mem_stats_get(SR_MEM_TRANSFERS, &stats);
+	fail_unless(ret == SR_OK, "sr_mem_stats_get() failed: %d.", ret);
+	ret = sr_mem_stats_get(0, &stats);
+	fail_unless(ret == SR_ERR_ARG, "Invalid kind should fail.");
+	ret = sr_mem_stats_get(SR_MEM_OUTPUT, NULL);
+	fail_unless(ret == SR_ERR_ARG, "NULL stats should fail.");
+
+	ret = sr_mem_budget_set(64 * 1024 * 1024);
+	fail_unless(ret == SR_OK, "sr_mem_budget_set() failed: %d.", ret);
+	ret = sr_mem_budget_set(0);
+	fail_unless(ret == SR_OK, "sr_mem_budget_set() failed: %d.", ret);
+}
+END_TEST
+
 Suite *suite_core(void)
 {
 	Suite *s;
@@ -179,5 +281,14 @@ Suite *suite_core(void)
 	tcase_add_test(tc, test_exit_null);
 	suite_add_tcase(s, tc);
 
+	tc = tcase_create("log");
+	tcase_add_test(tc, test_log_async);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("buffer");
+	tcase_add_test(tc, test_buffer_settings);
+	tcase_add_test(tc, test_mem_stats);
+	suite_add_tcase(s, tc);
+
 	return s;
 }
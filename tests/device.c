@@ -61,6 +61,28 @@ START_TEST(test_channel_add)
 }
 END_TEST
 
+START_TEST(test_channel_by_name)
+{
+	struct sr_dev_inst *sdi;
+	struct sr_channel *ch;
+
+	sdi = sr_dev_inst_user_new("Vendor", "Model", "Version");
+	fail_unless(sdi != NULL, "sr_dev_inst_user_new() failed.");
+	sr_dev_inst_channel_add(sdi, 0, SR_CHANNEL_LOGIC, "D1");
+	fail_unless(sr_dev_inst_channel_by_name(sdi, "A1") == NULL);
+
+	/* Channels added after a lookup must be found, too. */
+	sr_dev_inst_channel_add(sdi, 1, SR_CHANNEL_ANALOG, "A1");
+	ch = sr_dev_inst_channel_by_name(sdi, "A1");
+	fail_unless(ch != NULL, "Channel A1 not found.");
+	fail_unless(ch->type == SR_CHANNEL_ANALOG);
+
+	sr_dev_channel_name_set(ch, "A2");
+	fail_unless(sr_dev_inst_channel_by_name(sdi, "A1") == NULL);
+	fail_unless(sr_dev_inst_channel_by_name(sdi, "A2") == ch);
+}
+END_TEST
+
 Suite *suite_device(void)
 {
 	Suite *s;
@@ -76,5 +98,9 @@ Suite *suite_device(void)
 	tcase_add_test(tc, test_channel_add);
 	suite_add_tcase(s, tc);
 
+	tc = tcase_create("sr_dev_inst_channel_by_name");
+	tcase_add_test(tc, test_channel_by_name);
+	suite_add_tcase(s, tc);
+
 	return s;
 }
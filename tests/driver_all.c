@@ -40,6 +40,88 @@ START_TEST(test_driver_init_all)
 }
 END_TEST
 
+#ifdef HAVE_HW_DEMO
+static void scan_all_cb(struct sr_dev_driver *driver, GSList *devices,
+		void *cb_data)
+{
+	(void)driver;
+
+	*(unsigned int *)cb_data += g_slist_length(devices);
+}
+
+/* Check whether scanning several drivers at once finds their devices. */
+START_TEST(test_driver_scan_all)
+{
+	struct sr_dev_driver *drivers[2];
+	GSList *devices;
+	unsigned int num_cb;
+
+	drivers[0] = srtest_driver_get("demo");
+	drivers[1] = NULL;
+	srtest_driver_init(srtest_ctx, drivers[0]);
+
+	num_cb = 0;
+	devices = sr_driver_scan_all(drivers, NULL, 0, scan_all_cb, &num_cb);
+	fail_unless(devices != NULL, "No demo device found.");
+	fail_unless(num_cb == g_slist_length(devices),
+		"Callback saw %u devices, %u returned.", num_cb,
+		g_slist_length(devices));
+	g_slist_free(devices);
+}
+END_TEST
+
+/* Check that sr_config_get_many() answers valid keys only. */
+START_TEST(test_config_get_many)
+{
+	struct sr_dev_driver *driver;
+	struct sr_dev_inst *sdi;
+	struct sr_config configs[3];
+	GSList *devices;
+	int ret;
+
+	driver = srtest_driver_get("demo");
+	srtest_driver_init(srtest_ctx, driver);
+	devices = sr_driver_scan(driver, NULL);
+	fail_unless(devices != NULL, "No demo device found.");
+	sdi = devices->data;
+
+	configs[0].key = SR_CONF_SAMPLERATE;
+	configs[1].key = SR_CONF_PROBE_FACTOR;
+	configs[2].key = SR_CONF_LIMIT_SAMPLES;
+	ret = sr_config_get_many(driver, sdi, NULL, configs, 3);
+	fail_unless(ret == SR_OK, "sr_config_get_many() failed: %d.", ret);
+	fail_unless(configs[0].data != NULL, "No samplerate.");
+	fail_unless(configs[1].data == NULL, "Unpublished key answered.");
+	fail_unless(configs[2].data != NULL, "No sample limit.");
+	g_variant_unref(configs[0].data);
+	g_variant_unref(configs[2].data);
+	g_slist_free(devices);
+}
+END_TEST
+
+/* Check that repeated lists of the same options are consistent. */
+START_TEST(test_config_list_repeated)
+{
+	struct sr_dev_driver *driver;
+	GVariant *gvar[2];
+	int i, ret;
+
+	driver = srtest_driver_get("demo");
+	srtest_driver_init(srtest_ctx, driver);
+
+	for (i = 0; i < 2; i++) {
+		ret = sr_config_list(driver, NULL, NULL,
+			SR_CONF_SCAN_OPTIONS, &gvar[i]);
+		fail_unless(ret == SR_OK, "sr_config_list() failed: %d.", ret);
+		fail_unless(!g_variant_is_floating(gvar[i]));
+	}
+	fail_unless(g_variant_equal(gvar[0], gvar[1]), "Lists differ.");
+	g_variant_unref(gvar[0]);
+	g_variant_unref(gvar[1]);
+}
+END_TEST
+#endif
+
 /*
  * Check whether setting a samplerate works.
  *
@@ -70,6 +152,11 @@ Suite *suite_driver_all(void)
 	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
 	tcase_add_test(tc, test_driver_available);
 	tcase_add_test(tc, test_driver_init_all);
+#ifdef HAVE_HW_DEMO
+	tcase_add_test(tc, test_driver_scan_all);
+	tcase_add_test(tc, test_config_get_many);
+	tcase_add_test(tc, test_config_list_repeated);
+#endif
 	// TODO: Currently broken.
 	// tcase_add_test(tc, test_config_get_set_samplerate);
 	suite_add_tcase(s, tc);
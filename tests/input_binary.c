@@ -20,6 +20,7 @@
 #include <config.h>
 #include <check.h>
 #include <glib/gstdio.h>
+#include <unistd.h>
 #include <libsigrok/libsigrok.h>
 #include "lib.h"
 
@@ -308,6 +309,111 @@ START_TEST(test_input_binary_hello_world)
 }
 END_TEST
 
+START_TEST(test_input_binary_file)
+{
+	const struct sr_input_module *imod;
+	struct sr_input *in;
+	struct sr_session *session;
+	struct sr_dev_inst *sdi;
+	char *filename;
+	int fd, ret;
+
+	fd = g_file_open_tmp("sr-test-binary-XXXXXX", &filename, NULL);
+	fail_unless(fd >= 0, "Failed to create temporary file.");
+	fail_unless(write(fd, "Hello world", 11) == 11);
+	close(fd);
+
+	df_packet_counter = sample_counter = 0;
+	have_seen_df_end = FALSE;
+	logic_channellist = NULL;
+	check_to_perform = CHECK_HELLO_WORLD;
+	expected_samples = 11;
+	expected_samplerate = NULL;
+
+	imod = sr_input_find("binary");
+	fail_unless(imod != NULL, "Failed to find input module.");
+	in = sr_input_new(imod, NULL);
+	fail_unless(in != NULL, "Failed to create input instance.");
+
+	/* The first call only makes the device instance ready. */
+	ret = sr_input_send_file(in, filename);
+	fail_unless(ret == SR_OK, "sr_input_send_file() error: %d", ret);
+	sdi = sr_input_dev_inst_get(in);
+	fail_unless(sdi != NULL, "Device instance not ready.");
+
+	sr_session_new(srtest_ctx, &session);
+	sr_session_datafeed_callback_add(session, datafeed_in, NULL);
+	sr_session_dev_add(session, sdi);
+
+	ret = sr_input_send_file(in, filename);
+	fail_unless(ret == SR_OK, "sr_input_send_file() error: %d", ret);
+	ret = sr_input_end(in);
+	fail_unless(ret == SR_OK, "sr_input_end() error: %d", ret);
+	fail_unless(have_seen_df_end, "No SR_DF_END received.");
+
+	sr_input_free(in);
+	sr_session_destroy(session);
+	g_unlink(filename);
+	g_free(filename);
+}
+END_TEST
+
+/* Check that data sent in pieces of partial samples gets reassembled. */
+START_TEST(test_input_binary_send_data)
+{
+	const struct sr_input_module *imod;
+	struct sr_input *in;
+	struct sr_session *session;
+	struct sr_dev_inst *sdi;
+	GHashTable *options;
+	uint8_t buf[12];
+	int ret;
+
+	memset(buf, 0xff, sizeof(buf));
+	df_packet_counter = sample_counter = 0;
+	have_seen_df_end = FALSE;
+	logic_channellist = NULL;
+	check_to_perform = -1;
+	expected_samples = 6;
+	expected_samplerate = NULL;
+
+	/* Two bytes per sample. */
+	options = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+			(GDestroyNotify)g_variant_unref);
+	g_hash_table_insert(options, g_strdup("numchannels"),
+		g_variant_ref_sink(g_variant_new_int32(16)));
+
+	imod = sr_input_find("binary");
+	fail_unless(imod != NULL, "Failed to find input module.");
+	in = sr_input_new(imod, options);
+	fail_unless(in != NULL, "Failed to create input instance.");
+
+	/* The first call only makes the device instance ready. */
+	ret = sr_input_send_data(in, buf, 3);
+	fail_unless(ret == SR_OK, "sr_input_send_data() error: %d", ret);
+	sdi = sr_input_dev_inst_get(in);
+	fail_unless(sdi != NULL, "Device instance not ready.");
+
+	sr_session_new(srtest_ctx, &session);
+	sr_session_datafeed_callback_add(session, datafeed_in, NULL);
+	sr_session_dev_add(session, sdi);
+
+	ret = sr_input_send_data(in, buf + 3, 5);
+	fail_unless(ret == SR_OK, "sr_input_send_data() error: %d", ret);
+	ret = sr_input_send_data(in, buf + 8, 4);
+	fail_unless(ret == SR_OK, "sr_input_send_data() error: %d", ret);
+	ret = sr_input_send_data(in, NULL, 1);
+	fail_unless(ret == SR_ERR_ARG, "NULL data should fail.");
+	ret = sr_input_end(in);
+	fail_unless(ret == SR_OK, "sr_input_end() error: %d", ret);
+	fail_unless(have_seen_df_end, "No SR_DF_END received.");
+
+	sr_input_free(in);
+	sr_session_destroy(session);
+	g_hash_table_destroy(options);
+}
+END_TEST
+
 Suite *suite_input_binary(void)
 {
 	Suite *s;
@@ -321,6 +427,8 @@ Suite *suite_input_binary(void)
 	tcase_add_test(tc, test_input_binary_all_high);
 	tcase_add_loop_test(tc, test_input_binary_all_high_loop, 1, 10);
 	tcase_add_test(tc, test_input_binary_hello_world);
+	tcase_add_test(tc, test_input_binary_file);
+	tcase_add_test(tc, test_input_binary_send_data);
 	suite_add_tcase(s, tc);
 
 	return s;
@@ -20,6 +20,7 @@
 #include <config.h>
 #include <stdlib.h>
 #include <check.h>
+#include <glib.h>
 #include <libsigrok/libsigrok.h>
 #include "lib.h"
 
@@ -29,6 +30,9 @@ int main(void)
 	Suite *s;
 	SRunner *srunner;
 
+	/* Have sr_init() check all drivers and modules. */
+	g_setenv("SIGROK_SANITY_CHECKS", "1", TRUE);
+
 	s = suite_create("mastersuite");
 	srunner = srunner_create(s);
 
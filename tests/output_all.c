@@ -18,7 +18,9 @@
  */
 
 #include <config.h>
+#include <float.h>
 #include <stdlib.h>
+#include <string.h>
 #include <check.h>
 #include <libsigrok/libsigrok.h>
 #include "lib.h"
@@ -96,6 +98,347 @@ START_TEST(test_output_options)
 }
 END_TEST
 
+/* Check whether an output group passes packets to all its members. */
+START_TEST(test_output_group)
+{
+	struct sr_dev_inst *sdi;
+	const struct sr_output *o[3];
+	struct sr_output_group *group;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic logic;
+	GString *outs[3];
+	uint8_t data[64];
+	int i, ret;
+
+	sdi = sr_dev_inst_user_new("Vendor", "Model", "Version");
+	sr_dev_inst_channel_add(sdi, 0, SR_CHANNEL_LOGIC, "D0");
+	group = sr_output_group_new();
+	fail_unless(group != NULL, "sr_output_group_new() failed.");
+	for (i = 0; i < 3; i++) {
+		o[i] = sr_output_new(sr_output_find("bits"), NULL, sdi, NULL);
+		fail_unless(o[i] != NULL, "sr_output_new() failed.");
+		ret = sr_output_group_add(group, o[i]);
+		fail_unless(ret == SR_OK, "sr_output_group_add() failed.");
+	}
+
+	for (i = 0; i < (int)sizeof(data); i++)
+		data[i] = i & 1;
+	logic.length = sizeof(data);
+	logic.unitsize = 1;
+	logic.data = data;
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+	ret = sr_output_group_send(group, &packet, outs);
+	fail_unless(ret == SR_OK, "sr_output_group_send() failed.");
+	for (i = 0; i < 3; i++) {
+		fail_unless(outs[i] != NULL, "Missing output of member %d.", i);
+		fail_unless(!strcmp(outs[i]->str, outs[0]->str),
+			"Member %d has different output.", i);
+	}
+	fail_unless(strstr(outs[0]->str, "01010101") != NULL,
+		"Unexpected output '%s'.", outs[0]->str);
+	for (i = 0; i < 3; i++)
+		g_string_free(outs[i], TRUE);
+
+	sr_output_group_free(group);
+	for (i = 0; i < 3; i++)
+		sr_output_free(o[i]);
+}
+END_TEST
+
+static int srnet_packets, srnet_logic_bytes;
+static uint64_t srnet_samplerate;
+static gboolean srnet_trigger, srnet_end;
+
+static void srnet_datafeed_in(const struct sr_dev_inst *sdi,
+	const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	const struct sr_datafeed_meta *meta;
+	const struct sr_datafeed_logic *logic;
+	struct sr_config *src;
+
+	(void)sdi;
+	(void)cb_data;
+
+	if (srnet_packets++ == 0)
+		fail_unless(packet->type == SR_DF_HEADER,
+			"The first packet must be an SR_DF_HEADER.");
+	switch (packet->type) {
+	case SR_DF_META:
+		meta = packet->payload;
+		src = meta->config->data;
+		if (src->key == SR_CONF_SAMPLERATE)
+			srnet_samplerate = g_variant_get_uint64(src->data);
+		break;
+	case SR_DF_LOGIC:
+		logic = packet->payload;
+		fail_unless(logic->unitsize == 1, "Wrong unitsize.");
+		fail_unless(((uint8_t *)logic->data)[0] == srnet_logic_bytes % 256,
+			"Wrong data.");
+		srnet_logic_bytes += logic->length;
+		break;
+	case SR_DF_TRIGGER:
+		fail_unless(srnet_logic_bytes == 64,
+			"The trigger is not after the first packet.");
+		srnet_trigger = TRUE;
+		break;
+	case SR_DF_END:
+		srnet_end = TRUE;
+		break;
+	}
+}
+
+/* Check that the srnet input reads back what the srnet output wrote. */
+START_TEST(test_output_srnet)
+{
+	struct sr_dev_inst *sdi, *in_sdi;
+	const struct sr_output *o;
+	struct sr_input *in;
+	struct sr_session *session;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_header header;
+	struct sr_datafeed_meta meta;
+	struct sr_datafeed_logic logic;
+	struct sr_config src;
+	GString *out, *stream;
+	uint8_t data[128];
+	int i, ret;
+
+	sdi = sr_dev_inst_user_new("Vendor", "Model", "Version");
+	for (i = 0; i < 8; i++)
+		sr_dev_inst_channel_add(sdi, i, SR_CHANNEL_LOGIC, "D");
+	o = sr_output_new(sr_output_find("srnet"), NULL, sdi, NULL);
+	fail_unless(o != NULL, "sr_output_new() failed.");
+	for (i = 0; i < (int)sizeof(data); i++)
+		data[i] = i;
+
+	stream = g_string_new(NULL);
+	for (i = 0; i < 6; i++) {
+		switch (i) {
+		case 0:
+			header.feed_version = 1;
+			header.starttime.tv_sec = 1;
+			header.starttime.tv_usec = 0;
+			packet.type = SR_DF_HEADER;
+			packet.payload = &header;
+			break;
+		case 1:
+			src.key = SR_CONF_SAMPLERATE;
+			src.data = g_variant_ref_sink(g_variant_new_uint64(SR_MHZ(1)));
+			meta.config = g_slist_append(NULL, &src);
+			packet.type = SR_DF_META;
+			packet.payload = &meta;
+			break;
+		case 2:
+		case 4:
+			logic.length = 64;
+			logic.unitsize = 1;
+			logic.data = data + (i == 4 ? 64 : 0);
+			packet.type = SR_DF_LOGIC;
+			packet.payload = &logic;
+			break;
+		case 3:
+			packet.type = SR_DF_TRIGGER;
+			packet.payload = NULL;
+			break;
+		case 5:
+			packet.type = SR_DF_END;
+			packet.payload = NULL;
+			break;
+		}
+		out = NULL;
+		ret = sr_output_send(o, &packet, &out);
+		fail_unless(ret == SR_OK, "sr_output_send() failed: %d.", ret);
+		if (out) {
+			g_string_append_len(stream, out->str, out->len);
+			g_string_free(out, TRUE);
+		}
+		if (i == 1) {
+			g_slist_free(meta.config);
+			g_variant_unref(src.data);
+		}
+	}
+	sr_output_free(o);
+
+	in = sr_input_new(sr_input_find("srnet"), NULL);
+	fail_unless(in != NULL, "sr_input_new() failed.");
+	ret = sr_input_send(in, stream);
+	fail_unless(ret == SR_OK, "sr_input_send() failed: %d.", ret);
+	in_sdi = sr_input_dev_inst_get(in);
+	fail_unless(in_sdi != NULL, "Device instance not ready.");
+	fail_unless(g_slist_length(sr_dev_inst_channels_get(in_sdi)) == 8,
+		"Wrong number of channels.");
+
+	srnet_packets = srnet_logic_bytes = 0;
+	srnet_samplerate = 0;
+	srnet_trigger = srnet_end = FALSE;
+	sr_session_new(srtest_ctx, &session);
+	sr_session_datafeed_callback_add(session, srnet_datafeed_in, NULL);
+	sr_session_dev_add(session, in_sdi);
+	ret = sr_input_end(in);
+	fail_unless(ret == SR_OK, "sr_input_end() failed: %d.", ret);
+	fail_unless(srnet_samplerate == SR_MHZ(1), "Wrong samplerate.");
+	fail_unless(srnet_logic_bytes == 128, "Got %d bytes of logic data.",
+		srnet_logic_bytes);
+	fail_unless(srnet_trigger, "No SR_DF_TRIGGER received.");
+	fail_unless(srnet_end, "No SR_DF_END received.");
+
+	sr_input_free(in);
+	sr_session_destroy(session);
+	g_string_free(stream, TRUE);
+}
+END_TEST
+
+/*
+ * Send one analog channel of values to the csv output, and check that
+ * each one is formatted like printf("%g") in the C locale does.
+ */
+static void csv_check_values(const float *values, size_t count)
+{
+	struct sr_dev_inst *sdi;
+	const struct sr_output *o;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_header header;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+	GHashTable *options;
+	GString *out, *text;
+	char expected[G_ASCII_DTOSTR_BUF_SIZE];
+	char **lines;
+	size_t i;
+	int ret;
+
+	sdi = sr_dev_inst_user_new("Vendor", "Model", "Version");
+	sr_dev_inst_channel_add(sdi, 0, SR_CHANNEL_ANALOG, "A0");
+	options = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+			(GDestroyNotify)g_variant_unref);
+	g_hash_table_insert(options, g_strdup("header"),
+		g_variant_ref_sink(g_variant_new_boolean(FALSE)));
+	g_hash_table_insert(options, g_strdup("label"),
+		g_variant_ref_sink(g_variant_new_string("off")));
+	o = sr_output_new(sr_output_find("csv"), options, sdi, NULL);
+	fail_unless(o != NULL, "sr_output_new() failed.");
+
+	memset(&encoding, 0, sizeof(encoding));
+	encoding.unitsize = sizeof(float);
+	encoding.is_signed = TRUE;
+	encoding.is_float = TRUE;
+#ifdef WORDS_BIGENDIAN
+	encoding.is_bigendian = TRUE;
+#endif
+	encoding.digits = 6;
+	encoding.is_digits_decimal = TRUE;
+	encoding.scale.p = encoding.scale.q = 1;
+	encoding.offset.p = 0;
+	encoding.offset.q = 1;
+	memset(&meaning, 0, sizeof(meaning));
+	meaning.mq = SR_MQ_VOLTAGE;
+	meaning.unit = SR_UNIT_VOLT;
+	meaning.channels = sr_dev_inst_channels_get(sdi);
+	memset(&spec, 0, sizeof(spec));
+	spec.spec_digits = 6;
+	analog.data = (void *)values;
+	analog.num_samples = count;
+	analog.encoding = &encoding;
+	analog.meaning = &meaning;
+	analog.spec = &spec;
+
+	text = g_string_new(NULL);
+	for (i = 0; i < 3; i++) {
+		switch (i) {
+		case 0:
+			header.feed_version = 1;
+			header.starttime.tv_sec = 1;
+			header.starttime.tv_usec = 0;
+			packet.type = SR_DF_HEADER;
+			packet.payload = &header;
+			break;
+		case 1:
+			packet.type = SR_DF_ANALOG;
+			packet.payload = &analog;
+			break;
+		case 2:
+			packet.type = SR_DF_END;
+			packet.payload = NULL;
+			break;
+		}
+		out = NULL;
+		ret = sr_output_send(o, &packet, &out);
+		fail_unless(ret == SR_OK, "sr_output_send() failed: %d.", ret);
+		if (out) {
+			g_string_append_len(text, out->str, out->len);
+			g_string_free(out, TRUE);
+		}
+	}
+
+	lines = g_strsplit(text->str, "\n", 0);
+	fail_unless(g_strv_length(lines) == count + 1,
+		"Got %u lines for %zu values.", g_strv_length(lines), count);
+	for (i = 0; i < count; i++) {
+		g_ascii_formatd(expected, sizeof(expected), "%g", values[i]);
+		fail_unless(!strcmp(lines[i], expected),
+			"Value %zu is '%s', expected '%s'.", i, lines[i], expected);
+	}
+	fail_unless(!*lines[count], "Trailing text '%s'.", lines[count]);
+
+	g_strfreev(lines);
+	g_string_free(text, TRUE);
+	sr_output_free(o);
+	g_hash_table_destroy(options);
+}
+
+static float float_from_bits(uint32_t bits)
+{
+	float value;
+
+	memcpy(&value, &bits, sizeof(value));
+
+	return value;
+}
+
+/* Check the csv output's float formatting against printf("%g"). */
+START_TEST(test_output_csv_float)
+{
+	static const float values[] = {
+		0.0, -0.0, 1.0, -1.0, 0.5, -2.5, 3.14159265, 0.1,
+		/* Integers around the 6 significant digits. */
+		100000, 123456, 999999, 1000000, 1234567, 16777216,
+		/* Rounding up into the next power of ten. */
+		999999.4, 999999.5, -999999.5, 99999.95, 9.999995,
+		9.99999e-5, 9.999995e-5,
+		/* Switching between fixed and exponent notation. */
+		0.0001, 0.00001, 0.000123456, 123456.5, 1234565,
+		/* Large and small exponents. */
+		1e-10, 1e10, 1e22, 1e23, 1e-37, 1e38,
+		FLT_MAX, -FLT_MAX, FLT_MIN, -FLT_MIN, FLT_EPSILON,
+	};
+	static const uint32_t bits[] = {
+		/* Denormals. */
+		0x00000001, 0x80000001, 0x00012345, 0x007fffff, 0x807fffff,
+		/* Infinities and NaNs, with both signs. */
+		0x7f800000, 0xff800000, 0x7fc00000, 0xffc00000, 0x7f800001,
+	};
+	float random[20000];
+	GRand *rand;
+	size_t i;
+
+	csv_check_values(values, G_N_ELEMENTS(values));
+
+	for (i = 0; i < G_N_ELEMENTS(bits); i++)
+		random[i] = float_from_bits(bits[i]);
+	csv_check_values(random, G_N_ELEMENTS(bits));
+
+	/* Any bit pattern, covering all exponents and signs. */
+	rand = g_rand_new_with_seed(27);
+	for (i = 0; i < G_N_ELEMENTS(random); i++)
+		random[i] = float_from_bits(g_rand_int(rand));
+	g_rand_free(rand);
+	csv_check_values(random, G_N_ELEMENTS(random));
+}
+END_TEST
+
 Suite *suite_output_all(void)
 {
 	Suite *s;
@@ -110,6 +453,17 @@ Suite *suite_output_all(void)
 	tcase_add_test(tc, test_output_desc);
 	tcase_add_test(tc, test_output_find);
 	tcase_add_test(tc, test_output_options);
+	tcase_add_test(tc, test_output_group);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("csv");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_output_csv_float);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("srnet");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_output_srnet);
 	suite_add_tcase(s, tc);
 
 	return s;
@@ -19,6 +19,7 @@
 
 #include <config.h>
 #include <stdlib.h>
+#include <string.h>
 #include <check.h>
 #include <libsigrok/libsigrok.h>
 #include "lib.h"
@@ -185,6 +186,477 @@ START_TEST(test_session_trigger_get_null)
 }
 END_TEST
 
+/*
+ * Check whether sr_packet_ref() retains an independent copy of a logic
+ * packet which is not currently being sent, and sr_packet_unref() of
+ * that copy works.
+ */
+START_TEST(test_packet_ref_unref)
+{
+	int ret;
+	uint8_t data[] = { 0x01, 0x02, 0x03, 0x04, };
+	struct sr_datafeed_logic logic;
+	struct sr_datafeed_packet packet, *ref;
+	const struct sr_datafeed_logic *ref_logic;
+	int64_t timestamp;
+	uint64_t sample_index;
+
+	logic.length = sizeof(data);
+	logic.unitsize = 1;
+	logic.data = data;
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+
+	ret = sr_packet_ref(NULL, &packet, &ref);
+	fail_unless(ret == SR_OK, "sr_packet_ref() failed: %d.", ret);
+	fail_unless(ref != NULL);
+	fail_unless(ref->type == SR_DF_LOGIC);
+	ref_logic = ref->payload;
+	fail_unless(ref_logic->length == logic.length);
+	fail_unless(ref_logic->unitsize == logic.unitsize);
+	fail_unless(ref_logic->data != logic.data);
+	data[0] = 0xff;
+	fail_unless(memcmp(ref_logic->data, "\x01\x02\x03\x04", 4) == 0);
+	/* Packets not sent on a session bus have no time. */
+	ret = sr_packet_timestamp_get(NULL, ref, &timestamp, &sample_index);
+	fail_unless(ret == SR_OK, "sr_packet_timestamp_get() failed: %d.", ret);
+	fail_unless(timestamp == 0 && sample_index == 0);
+	/* Neither is the caller's own packet tracked. */
+	ret = sr_packet_timestamp_get(NULL, &packet, &timestamp, NULL);
+	fail_unless(ret == SR_ERR_NA, "untracked packet: %d.", ret);
+	sr_packet_unref(ref);
+
+	/* Bogus arguments, must not segfault. */
+	ret = sr_packet_ref(NULL, NULL, &ref);
+	fail_unless(ret == SR_ERR_ARG);
+	ret = sr_packet_ref(NULL, &packet, NULL);
+	fail_unless(ret == SR_ERR_ARG);
+	ret = sr_packet_timestamp_get(NULL, NULL, &timestamp, NULL);
+	fail_unless(ret == SR_ERR_ARG);
+	sr_packet_unref(NULL);
+}
+END_TEST
+
+/* Check whether packet copies reuse pooled memory. */
+START_TEST(test_packet_copy_pool)
+{
+	int ret, i;
+	uint8_t data[100];
+	struct sr_datafeed_logic logic;
+	struct sr_datafeed_packet packet, *copy;
+	const struct sr_datafeed_logic *copy_logic;
+	struct sr_packet_pool_stats before, after;
+
+	memset(data, 0x55, sizeof(data));
+	logic.length = sizeof(data);
+	logic.unitsize = 1;
+	logic.data = data;
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+
+	ret = sr_packet_pool_stats_get(&before);
+	fail_unless(ret == SR_OK, "sr_packet_pool_stats_get() failed: %d.", ret);
+	for (i = 0; i < 4; i++) {
+		ret = sr_packet_copy(&packet, &copy);
+		fail_unless(ret == SR_OK, "sr_packet_copy() failed: %d.", ret);
+		copy_logic = copy->payload;
+		fail_unless(copy_logic->length == logic.length);
+		fail_unless(memcmp(copy_logic->data, data, sizeof(data)) == 0);
+		sr_packet_free(copy);
+	}
+	sr_packet_pool_stats_get(&after);
+	fail_unless(after.hits > before.hits, "Pooled memory was not reused.");
+
+	sr_packet_pool_trim();
+	sr_packet_pool_stats_get(&after);
+	fail_unless(after.cached_bytes == 0);
+
+	/* Bogus arguments, must not segfault. */
+	ret = sr_packet_pool_stats_get(NULL);
+	fail_unless(ret == SR_ERR_ARG);
+}
+END_TEST
+
+/* Check whether change-only logic packets can be copied. */
+START_TEST(test_packet_copy_edges)
+{
+	int ret;
+	uint64_t offsets[] = { 0, 10, 250, };
+	uint8_t values[] = { 0x00, 0x01, 0x03, };
+	struct sr_datafeed_logic_edges edges;
+	struct sr_datafeed_packet packet, *copy;
+	const struct sr_datafeed_logic_edges *copy_edges;
+
+	edges.num_samples = 1000;
+	edges.unitsize = 1;
+	edges.num_edges = 3;
+	edges.offsets = offsets;
+	edges.values = values;
+	packet.type = SR_DF_LOGIC_EDGES;
+	packet.payload = &edges;
+
+	ret = sr_packet_copy(&packet, &copy);
+	fail_unless(ret == SR_OK, "sr_packet_copy() failed: %d.", ret);
+	fail_unless(copy->type == SR_DF_LOGIC_EDGES);
+	copy_edges = copy->payload;
+	fail_unless(copy_edges->num_samples == edges.num_samples);
+	fail_unless(copy_edges->num_edges == edges.num_edges);
+	fail_unless(copy_edges->offsets != offsets);
+	fail_unless(memcmp(copy_edges->offsets, offsets, sizeof(offsets)) == 0);
+	fail_unless(memcmp(copy_edges->values, values, sizeof(values)) == 0);
+	sr_packet_free(copy);
+}
+END_TEST
+
+/* Check whether frame packets are copied with and without segment info. */
+START_TEST(test_packet_copy_frame)
+{
+	int ret;
+	struct sr_datafeed_frame frame;
+	struct sr_datafeed_packet packet, *copy;
+	const struct sr_datafeed_frame *copy_frame;
+
+	packet.type = SR_DF_FRAME_BEGIN;
+	packet.payload = NULL;
+	ret = sr_packet_copy(&packet, &copy);
+	fail_unless(ret == SR_OK, "sr_packet_copy() failed: %d.", ret);
+	fail_unless(copy->payload == NULL);
+	sr_packet_free(copy);
+
+	frame.index = 7;
+	frame.has_time = TRUE;
+	frame.time = 0.25;
+	packet.payload = &frame;
+	ret = sr_packet_copy(&packet, &copy);
+	fail_unless(ret == SR_OK, "sr_packet_copy() failed: %d.", ret);
+	copy_frame = copy->payload;
+	fail_unless(copy_frame && copy_frame != &frame);
+	fail_unless(copy_frame->index == 7);
+	fail_unless(copy_frame->has_time);
+	fail_unless(copy_frame->time == 0.25);
+	sr_packet_free(copy);
+}
+END_TEST
+
+/* Check whether gap packets are copied. */
+START_TEST(test_packet_copy_gap)
+{
+	int ret;
+	struct sr_datafeed_gap gap;
+	struct sr_datafeed_packet packet, *copy;
+	const struct sr_datafeed_gap *copy_gap;
+
+	gap.sample_index = 4096;
+	gap.num_samples = 512;
+	gap.reason = SR_GAP_TRANSFER;
+	packet.type = SR_DF_GAP;
+	packet.payload = &gap;
+	ret = sr_packet_copy(&packet, &copy);
+	fail_unless(ret == SR_OK, "sr_packet_copy() failed: %d.", ret);
+	copy_gap = copy->payload;
+	fail_unless(copy_gap && copy_gap != &gap);
+	fail_unless(copy_gap->sample_index == 4096);
+	fail_unless(copy_gap->num_samples == 512);
+	fail_unless(copy_gap->reason == SR_GAP_TRANSFER);
+	sr_packet_free(copy);
+}
+END_TEST
+
+/* Check whether the async dispatch settings are validated. */
+START_TEST(test_session_dispatch_async_set)
+{
+	int ret;
+	struct sr_session *sess;
+	struct sr_dispatch_stats stats;
+
+	sr_session_new(srtest_ctx, &sess);
+
+	ret = sr_session_dispatch_async_set(sess, 64, SR_DISPATCH_BLOCK);
+	fail_unless(ret == SR_OK, "sr_session_dispatch_async_set() failed: %d.", ret);
+	ret = sr_session_dispatch_async_set(sess, 64, SR_DISPATCH_DROP);
+	fail_unless(ret == SR_OK, "sr_session_dispatch_async_set() failed: %d.", ret);
+	ret = sr_session_dispatch_async_set(sess, 0, SR_DISPATCH_BLOCK);
+	fail_unless(ret == SR_OK, "sr_session_dispatch_async_set() failed: %d.", ret);
+
+	ret = sr_session_dispatch_stats_get(sess, &stats);
+	fail_unless(ret == SR_OK, "sr_session_dispatch_stats_get() failed: %d.", ret);
+	fail_unless(stats.queued == 0 && stats.dropped == 0);
+
+	/* Bogus arguments, must not segfault. */
+	ret = sr_session_dispatch_async_set(NULL, 64, SR_DISPATCH_BLOCK);
+	fail_unless(ret == SR_ERR_ARG);
+	ret = sr_session_dispatch_async_set(sess, 64, 0);
+	fail_unless(ret == SR_ERR_ARG);
+	ret = sr_session_dispatch_stats_get(NULL, &stats);
+	fail_unless(ret == SR_ERR_ARG);
+	ret = sr_session_dispatch_stats_get(sess, NULL);
+	fail_unless(ret == SR_ERR_ARG);
+
+	sr_session_destroy(sess);
+}
+END_TEST
+
+static void dummy_datafeed_cb(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	(void)sdi;
+	(void)packet;
+	(void)cb_data;
+}
+
+static void dummy_batch_cb(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packets, size_t num_packets,
+		void *cb_data)
+{
+	(void)sdi;
+	(void)packets;
+	(void)num_packets;
+	(void)cb_data;
+}
+
+/* Check whether batch callbacks can be added. */
+START_TEST(test_session_batch_callback_add)
+{
+	int ret;
+	struct sr_session *sess;
+
+	sr_session_new(srtest_ctx, &sess);
+
+	ret = sr_session_datafeed_batch_callback_add(sess, dummy_batch_cb, NULL);
+	fail_unless(ret == SR_OK, "Adding a batch callback failed: %d.", ret);
+
+	/* Bogus arguments, must not segfault. */
+	ret = sr_session_datafeed_batch_callback_add(sess, NULL, NULL);
+	fail_unless(ret == SR_ERR_ARG);
+	ret = sr_session_datafeed_batch_callback_add(NULL, dummy_batch_cb, NULL);
+	fail_unless(ret != SR_OK);
+
+	sr_session_destroy(sess);
+}
+END_TEST
+
+/* Check whether callback worker threads can be set up and torn down. */
+START_TEST(test_session_callback_threads_set)
+{
+	int ret;
+	struct sr_session *sess;
+
+	sr_session_new(srtest_ctx, &sess);
+
+	ret = sr_session_datafeed_callback_add_thread_safe(sess,
+			dummy_datafeed_cb, NULL);
+	fail_unless(ret == SR_OK, "Adding a thread-safe callback failed: %d.", ret);
+	ret = sr_session_callback_threads_set(sess, 2);
+	fail_unless(ret == SR_OK, "sr_session_callback_threads_set() failed: %d.", ret);
+	ret = sr_session_callback_threads_set(sess, 4);
+	fail_unless(ret == SR_OK, "sr_session_callback_threads_set() failed: %d.", ret);
+
+	/* Bogus arguments, must not segfault. */
+	ret = sr_session_callback_threads_set(NULL, 2);
+	fail_unless(ret == SR_ERR_ARG);
+	ret = sr_session_datafeed_callback_add_thread_safe(sess, NULL, NULL);
+	fail_unless(ret == SR_ERR_ARG);
+
+	/* Destroying the session must shut down the workers. */
+	sr_session_destroy(sess);
+}
+END_TEST
+
+/* Check whether device threads can be toggled while stopped. */
+START_TEST(test_session_dev_threads_set)
+{
+	int ret;
+	struct sr_session *sess;
+
+	sr_session_new(srtest_ctx, &sess);
+
+	ret = sr_session_dev_threads_set(sess, TRUE);
+	fail_unless(ret == SR_OK, "sr_session_dev_threads_set() failed: %d.", ret);
+	ret = sr_session_dev_threads_set(sess, FALSE);
+	fail_unless(ret == SR_OK, "sr_session_dev_threads_set() failed: %d.", ret);
+
+	/* Bogus arguments, must not segfault. */
+	ret = sr_session_dev_threads_set(NULL, TRUE);
+	fail_unless(ret == SR_ERR_ARG);
+
+	sr_session_destroy(sess);
+}
+END_TEST
+
+/* Check whether thread scheduling settings are validated. */
+START_TEST(test_session_thread_sched_set)
+{
+	int ret;
+	struct sr_session *sess;
+	struct sr_thread_sched sched;
+
+	sr_session_new(srtest_ctx, &sess);
+
+	sched.rt_priority = 50;
+	sched.cpu_mask = 0x3;
+	ret = sr_session_thread_sched_set(sess, SR_THREAD_USB_EVENTS, &sched);
+	fail_unless(ret == SR_OK, "sr_session_thread_sched_set() failed: %d.", ret);
+	ret = sr_session_thread_sched_set(sess, SR_THREAD_USB_EVENTS, NULL);
+	fail_unless(ret == SR_OK, "sr_session_thread_sched_set() failed: %d.", ret);
+
+	/* Bogus arguments, must not segfault. */
+	sched.rt_priority = 100;
+	ret = sr_session_thread_sched_set(sess, SR_THREAD_DEVICE, &sched);
+	fail_unless(ret == SR_ERR_ARG);
+	ret = sr_session_thread_sched_set(sess, 0, NULL);
+	fail_unless(ret == SR_ERR_ARG);
+	ret = sr_session_thread_sched_set(NULL, SR_THREAD_DEVICE, NULL);
+	fail_unless(ret == SR_ERR_ARG);
+
+	sr_session_destroy(sess);
+}
+END_TEST
+
+/* Check whether event backends can be selected. */
+START_TEST(test_session_event_backend_set)
+{
+	int ret;
+	struct sr_session *sess;
+
+	sr_session_new(srtest_ctx, &sess);
+
+	ret = sr_session_event_backend_set(sess, SR_EVENT_BACKEND_EPOLL);
+	fail_unless(ret == SR_OK || ret == SR_ERR_NA,
+		"sr_session_event_backend_set() failed: %d.", ret);
+	ret = sr_session_event_backend_set(sess, SR_EVENT_BACKEND_GLIB);
+	fail_unless(ret == SR_OK, "sr_session_event_backend_set() failed: %d.", ret);
+
+	/* Bogus arguments, must not segfault. */
+	ret = sr_session_event_backend_set(NULL, SR_EVENT_BACKEND_GLIB);
+	fail_unless(ret == SR_ERR_ARG);
+	ret = sr_session_event_backend_set(sess, 0);
+	fail_unless(ret == SR_ERR_ARG);
+
+	sr_session_destroy(sess);
+}
+END_TEST
+
+/* Check whether the packet trace can be enabled, drained and disabled. */
+START_TEST(test_session_trace)
+{
+	int ret;
+	struct sr_session *sess;
+	struct sr_trace_record records[4];
+	size_t num_read;
+	uint64_t lost;
+
+	sr_session_new(srtest_ctx, &sess);
+
+	ret = sr_session_trace_set(sess, 16);
+	fail_unless(ret == SR_OK, "sr_session_trace_set() failed: %d.", ret);
+	ret = sr_session_trace_read(sess, records, 4, &num_read, &lost);
+	fail_unless(ret == SR_OK, "sr_session_trace_read() failed: %d.", ret);
+	fail_unless(num_read == 0 && lost == 0);
+	ret = sr_session_trace_set(sess, 0);
+	fail_unless(ret == SR_OK, "sr_session_trace_set() failed: %d.", ret);
+	ret = sr_session_trace_read(sess, records, 4, &num_read, NULL);
+	fail_unless(ret == SR_OK && num_read == 0);
+
+	/* Bogus arguments, must not segfault. */
+	ret = sr_session_trace_set(NULL, 16);
+	fail_unless(ret == SR_ERR_ARG);
+	ret = sr_session_trace_read(NULL, records, 4, &num_read, NULL);
+	fail_unless(ret == SR_ERR_ARG);
+	ret = sr_session_trace_read(sess, NULL, 4, &num_read, NULL);
+	fail_unless(ret == SR_ERR_ARG);
+	ret = sr_session_trace_read(sess, records, 4, NULL, NULL);
+	fail_unless(ret == SR_ERR_ARG);
+
+	sr_session_destroy(sess);
+}
+END_TEST
+
+/* Check whether statistics report the session's datafeed callbacks. */
+START_TEST(test_session_stats_get)
+{
+	int ret;
+	struct sr_session *sess;
+	struct sr_session_stats *stats;
+	struct sr_call_stats *call_stats;
+
+	sr_session_new(srtest_ctx, &sess);
+	sr_session_datafeed_callback_add(sess, dummy_datafeed_cb, sess);
+
+	ret = sr_session_stats_get(sess, &stats);
+	fail_unless(ret == SR_OK, "sr_session_stats_get() failed: %d.", ret);
+	fail_unless(stats->devices == NULL);
+	fail_unless(stats->transforms == NULL);
+	fail_unless(g_slist_length(stats->callbacks) == 1);
+	call_stats = stats->callbacks->data;
+	fail_unless(call_stats->cb_data == sess);
+	fail_unless(call_stats->calls == 0 && call_stats->time_us == 0);
+	sr_session_stats_free(stats);
+
+	/* Bogus arguments, must not segfault. */
+	ret = sr_session_stats_get(NULL, &stats);
+	fail_unless(ret == SR_ERR_ARG);
+	ret = sr_session_stats_get(sess, NULL);
+	fail_unless(ret == SR_ERR_ARG);
+	sr_session_stats_free(NULL);
+
+	sr_session_destroy(sess);
+}
+END_TEST
+
+/* Check whether logic samples are read back from a capture store. */
+START_TEST(test_capture_store_logic)
+{
+	int ret;
+	struct sr_capture_store *store;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic logic;
+	uint16_t samples[1000], buf[600], unitsize;
+	unsigned int i, p;
+
+	store = sr_capture_store_new();
+	fail_unless(store != NULL);
+
+	/* Long runs, so that complete blocks are compressed. */
+	for (i = 0; i < G_N_ELEMENTS(samples); i++)
+		samples[i] = (i / 100) & 1 ? 0x8001 : 0x0002;
+	logic.length = sizeof(samples);
+	logic.unitsize = sizeof(samples[0]);
+	logic.data = samples;
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+	for (p = 0; p < 200; p++) {
+		ret = sr_capture_store_add(store, &packet);
+		fail_unless(ret == SR_OK, "sr_capture_store_add() failed: %d.", ret);
+	}
+
+	fail_unless(sr_capture_store_logic_samples(store, &unitsize) == 200000);
+	fail_unless(unitsize == 2);
+	fail_unless(sr_capture_store_size(store) < sizeof(samples) * 200);
+
+	/* Ranges across block boundaries, and in the last partial block. */
+	ret = sr_capture_store_logic_read(store, 65300, 600, (uint8_t *)buf);
+	fail_unless(ret == SR_OK, "sr_capture_store_logic_read() failed: %d.", ret);
+	for (i = 0; i < G_N_ELEMENTS(buf); i++)
+		fail_unless(buf[i] == samples[(65300 + i) % 1000]);
+	ret = sr_capture_store_logic_read(store, 199400, 600, (uint8_t *)buf);
+	fail_unless(ret == SR_OK, "sr_capture_store_logic_read() failed: %d.", ret);
+	for (i = 0; i < G_N_ELEMENTS(buf); i++)
+		fail_unless(buf[i] == samples[(199400 + i) % 1000]);
+
+	/* Bogus arguments, must not segfault. */
+	ret = sr_capture_store_logic_read(store, 199500, 600, (uint8_t *)buf);
+	fail_unless(ret == SR_ERR_ARG);
+	logic.unitsize = 1;
+	ret = sr_capture_store_add(store, &packet);
+	fail_unless(ret == SR_ERR_DATA);
+	ret = sr_capture_store_add(NULL, &packet);
+	fail_unless(ret == SR_ERR_ARG);
+
+	sr_capture_store_free(store);
+	sr_capture_store_free(NULL);
+}
+END_TEST
+
 Suite *suite_session(void)
 {
 	Suite *s;
@@ -209,5 +681,38 @@ Suite *suite_session(void)
 	tcase_add_test(tc, test_session_trigger_get_null);
 	suite_add_tcase(s, tc);
 
+	tc = tcase_create("packet_ref");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_packet_ref_unref);
+	tcase_add_test(tc, test_packet_copy_pool);
+	tcase_add_test(tc, test_packet_copy_edges);
+	tcase_add_test(tc, test_packet_copy_frame);
+	tcase_add_test(tc, test_packet_copy_gap);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("dispatch");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_session_dispatch_async_set);
+	tcase_add_test(tc, test_session_callback_threads_set);
+	tcase_add_test(tc, test_session_batch_callback_add);
+	tcase_add_test(tc, test_session_dev_threads_set);
+	tcase_add_test(tc, test_session_event_backend_set);
+	tcase_add_test(tc, test_session_thread_sched_set);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("trace");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_session_trace);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("stats");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_session_stats_get);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("capture_store");
+	tcase_add_test(tc, test_capture_store_logic);
+	suite_add_tcase(s, tc);
+
 	return s;
 }
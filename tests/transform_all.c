@@ -18,11 +18,588 @@
  */
 
 #include <config.h>
+#include <inttypes.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <check.h>
 #include <libsigrok/libsigrok.h>
 #include "lib.h"
 
+/* What reached the session's datafeed callback, after the transforms. */
+struct feed {
+	unsigned int num_packets;
+	unsigned int num_headers;
+	unsigned int num_ends;
+	gboolean end_last;
+	uint64_t samplerate;
+	/* Logic bytes, their unitsize, and the length of every packet. */
+	GByteArray *logic;
+	uint16_t unitsize;
+	GArray *logic_lengths;
+	/* Analog values as floats, and the mqflags of every value. */
+	GArray *analog;
+	GArray *analog_flags;
+	GArray *analog_lengths;
+	/* Run at the header, to check what consumers see of the sdi. */
+	void (*check_header)(const struct sr_dev_inst *sdi);
+};
+
+static void feed_init(struct feed *f)
+{
+	memset(f, 0, sizeof(*f));
+	f->logic = g_byte_array_new();
+	f->logic_lengths = g_array_new(FALSE, FALSE, sizeof(size_t));
+	f->analog = g_array_new(FALSE, FALSE, sizeof(float));
+	f->analog_flags = g_array_new(FALSE, FALSE, sizeof(uint64_t));
+	f->analog_lengths = g_array_new(FALSE, FALSE, sizeof(size_t));
+}
+
+static void feed_clear(struct feed *f)
+{
+	g_byte_array_free(f->logic, TRUE);
+	g_array_free(f->logic_lengths, TRUE);
+	g_array_free(f->analog, TRUE);
+	g_array_free(f->analog_flags, TRUE);
+	g_array_free(f->analog_lengths, TRUE);
+}
+
+static void feed_in(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	const struct sr_datafeed_meta *meta;
+	const struct sr_datafeed_logic *logic;
+	const struct sr_datafeed_analog *analog;
+	struct sr_config *src;
+	struct feed *f;
+	uint64_t flags;
+	size_t n, i;
+	float *values;
+	GSList *l;
+
+	f = cb_data;
+	if (f->num_packets++ == 0)
+		fail_unless(packet->type == SR_DF_HEADER,
+			"The first packet must be an SR_DF_HEADER.");
+	fail_unless(!f->num_ends, "Packet of type %d after SR_DF_END.",
+		packet->type);
+
+	switch (packet->type) {
+	case SR_DF_HEADER:
+		f->num_headers++;
+		if (f->check_header)
+			f->check_header(sdi);
+		break;
+	case SR_DF_META:
+		meta = packet->payload;
+		for (l = meta->config; l; l = l->next) {
+			src = l->data;
+			if (src->key == SR_CONF_SAMPLERATE)
+				f->samplerate = g_variant_get_uint64(src->data);
+		}
+		break;
+	case SR_DF_LOGIC:
+		logic = packet->payload;
+		fail_unless(logic->unitsize != 0);
+		fail_unless(logic->length % logic->unitsize == 0);
+		fail_unless(!f->logic->len || f->unitsize == logic->unitsize,
+			"Logic unitsize changed from %d to %d.",
+			f->unitsize, logic->unitsize);
+		f->unitsize = logic->unitsize;
+		g_byte_array_append(f->logic, logic->data, logic->length);
+		n = logic->length;
+		g_array_append_val(f->logic_lengths, n);
+		break;
+	case SR_DF_ANALOG:
+		analog = packet->payload;
+		n = analog->num_samples *
+			MAX(g_slist_length(analog->meaning->channels), 1);
+		values = g_malloc_n(n, sizeof(float));
+		fail_unless(sr_analog_to_float(analog, values) == SR_OK);
+		g_array_append_vals(f->analog, values, n);
+		flags = analog->meaning->mqflags;
+		for (i = 0; i < n; i++)
+			g_array_append_val(f->analog_flags, flags);
+		n = analog->num_samples;
+		g_array_append_val(f->analog_lengths, n);
+		g_free(values);
+		break;
+	case SR_DF_END:
+		f->num_ends++;
+		break;
+	default:
+		break;
+	}
+}
+
+static GHashTable *options_new(void)
+{
+	return g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+		(GDestroyNotify)g_variant_unref);
+}
+
+static void option_set(GHashTable *options, const char *key, GVariant *value)
+{
+	g_hash_table_insert(options, g_strdup(key), g_variant_ref_sink(value));
+}
+
+/*
+ * Run data through an input module and a transform, in packets of at
+ * most 'chunk' bytes, and collect what reaches the session's callback.
+ * The input module's sdi is checked with 'check_sdi' after the run.
+ */
+static void feed_run(const char *input, GHashTable *input_options,
+		const char *transform, GHashTable *transform_options,
+		const uint8_t *data, size_t length, size_t chunk, struct feed *f,
+		void (*check_sdi)(const struct sr_dev_inst *sdi))
+{
+	const struct sr_transform *t;
+	struct sr_session *session;
+	struct sr_dev_inst *sdi;
+	struct sr_input *in;
+	size_t i;
+	int ret;
+
+	in = sr_input_new(sr_input_find((char *)input), input_options);
+	fail_unless(in != NULL, "Failed to create '%s' input.", input);
+	sdi = sr_input_dev_inst_get(in);
+
+	sr_session_new(srtest_ctx, &session);
+	sr_session_datafeed_callback_add(session, feed_in, f);
+	sr_session_dev_add(session, sdi);
+	t = sr_transform_new(sr_transform_find(transform),
+		transform_options, sdi);
+	fail_unless(t != NULL, "Failed to create '%s' transform.", transform);
+
+	/* The first call only makes the sdi ready, without any data. */
+	ret = sr_input_send_data(in, NULL, 0);
+	fail_unless(ret == SR_OK, "sr_input_send_data() error: %d", ret);
+	for (i = 0; i < length; i += chunk) {
+		ret = sr_input_send_data(in, data + i, MIN(chunk, length - i));
+		fail_unless(ret == SR_OK, "sr_input_send_data() error: %d", ret);
+	}
+	ret = sr_input_end(in);
+	fail_unless(ret == SR_OK, "sr_input_end() error: %d", ret);
+
+	fail_unless(f->num_headers == 1, "Got %u headers.", f->num_headers);
+	fail_unless(f->num_ends == 1, "Got %u ends.", f->num_ends);
+	if (check_sdi)
+		check_sdi(sdi);
+
+	sr_transform_free(t);
+	sr_input_free(in);
+	sr_session_destroy(session);
+}
+
+/* Interleaved little endian floats, as the raw_analog input takes them. */
+static uint8_t *floats_new(const float *values, size_t count)
+{
+	uint8_t *buf;
+	uint32_t word;
+	size_t i;
+
+	buf = g_malloc(count * sizeof(float));
+	for (i = 0; i < count; i++) {
+		memcpy(&word, &values[i], sizeof(word));
+		word = GUINT32_TO_LE(word);
+		memcpy(buf + i * sizeof(word), &word, sizeof(word));
+	}
+
+	return buf;
+}
+
+static GHashTable *analog_options_new(int num_channels, uint64_t samplerate)
+{
+	GHashTable *options;
+
+	options = options_new();
+	option_set(options, "numchannels", g_variant_new_int32(num_channels));
+	option_set(options, "samplerate", g_variant_new_uint64(samplerate));
+	option_set(options, "format", g_variant_new_string("FLOAT_LE"));
+
+	return options;
+}
+
+static GHashTable *logic_options_new(int num_channels, uint64_t samplerate)
+{
+	GHashTable *options;
+
+	options = options_new();
+	option_set(options, "numchannels", g_variant_new_int32(num_channels));
+	option_set(options, "samplerate", g_variant_new_uint64(samplerate));
+
+	return options;
+}
+
+static gboolean close_to(float value, float expected)
+{
+	float diff, tolerance;
+
+	diff = value - expected;
+	tolerance = 1e-5 * MAX(expected, -expected) + 1e-6;
+
+	return diff <= tolerance && diff >= -tolerance;
+}
+
+/* Check that decimate keeps every Nth logic sample, across packets. */
+START_TEST(test_transform_decimate_logic)
+{
+	GHashTable *in_opts, *t_opts;
+	struct feed f;
+	uint8_t data[100];
+	unsigned int i;
+
+	for (i = 0; i < sizeof(data); i++)
+		data[i] = i;
+	in_opts = logic_options_new(8, 3000);
+	t_opts = options_new();
+	option_set(t_opts, "factor", g_variant_new_uint64(3));
+	option_set(t_opts, "mode", g_variant_new_string("pick"));
+
+	feed_init(&f);
+	feed_run("binary", in_opts, "decimate", t_opts, data, sizeof(data), 7,
+		&f, NULL);
+
+	fail_unless(f.samplerate == 1000, "Samplerate is %" PRIu64 ".",
+		f.samplerate);
+	fail_unless(f.unitsize == 1);
+	fail_unless(f.logic->len == 34, "Got %u samples.", f.logic->len);
+	for (i = 0; i < f.logic->len; i++)
+		fail_unless(f.logic->data[i] == i * 3,
+			"Sample %u is %d.", i, f.logic->data[i]);
+
+	feed_clear(&f);
+	g_hash_table_destroy(t_opts);
+	g_hash_table_destroy(in_opts);
+}
+END_TEST
+
+/* Check the average and minmax modes of decimate on two channels. */
+START_TEST(test_transform_decimate_analog)
+{
+	static const char *modes[] = { "average", "minmax" };
+	GHashTable *in_opts, *t_opts;
+	float values[2 * 42], *out, exp0, exp1;
+	struct feed f;
+	uint8_t *data;
+	unsigned int m, i, w;
+
+	/* The last two samples are no complete window, they are dropped. */
+	for (i = 0; i < 42; i++) {
+		values[i * 2] = i;
+		values[i * 2 + 1] = -2.0 * i;
+	}
+	data = floats_new(values, G_N_ELEMENTS(values));
+	in_opts = analog_options_new(2, 4000);
+
+	for (m = 0; m < G_N_ELEMENTS(modes); m++) {
+		t_opts = options_new();
+		option_set(t_opts, "factor", g_variant_new_uint64(4));
+		option_set(t_opts, "mode", g_variant_new_string(modes[m]));
+
+		/* Packets of 5 samples, windows span packets. */
+		feed_init(&f);
+		feed_run("raw_analog", in_opts, "decimate", t_opts, data,
+			sizeof(values), 5 * 2 * sizeof(float), &f, NULL);
+
+		out = (float *)f.analog->data;
+		if (m == 0) {
+			fail_unless(f.samplerate == 1000);
+			fail_unless(f.analog->len == 10 * 2,
+				"Got %u values.", f.analog->len);
+			for (w = 0; w < 10; w++) {
+				exp0 = w * 4 + 1.5;
+				exp1 = -2 * exp0;
+				fail_unless(close_to(out[w * 2], exp0) &&
+					close_to(out[w * 2 + 1], exp1),
+					"Window %u is %f/%f.", w,
+					out[w * 2], out[w * 2 + 1]);
+			}
+		} else {
+			fail_unless(f.samplerate == 2000);
+			fail_unless(f.analog->len == 10 * 2 * 2,
+				"Got %u values.", f.analog->len);
+			for (w = 0; w < 10; w++) {
+				/* Minimum, then maximum of both channels. */
+				fail_unless(out[w * 4] == w * 4);
+				fail_unless(out[w * 4 + 1] == -2.0 * (w * 4 + 3));
+				fail_unless(out[w * 4 + 2] == w * 4 + 3);
+				fail_unless(out[w * 4 + 3] == -2.0 * (w * 4));
+			}
+		}
+
+		feed_clear(&f);
+		g_hash_table_destroy(t_opts);
+	}
+
+	g_hash_table_destroy(in_opts);
+	g_free(data);
+}
+END_TEST
+
+/* The end of the stream restores the device's channels. */
+static void check_channels_unchanged(const struct sr_dev_inst *sdi)
+{
+	const struct sr_channel *ch;
+	unsigned int i;
+	char name[8];
+	GSList *l;
+
+	l = sr_dev_inst_channels_get(sdi);
+	fail_unless(g_slist_length(l) == 12);
+	for (i = 0; l; l = l->next, i++) {
+		ch = l->data;
+		snprintf(name, sizeof(name), "%u", i);
+		fail_unless(ch->index == (int)i && !strcmp(ch->name, name),
+			"Channel %u is %s (index %d).", i, ch->name, ch->index);
+		fail_unless(ch->enabled);
+	}
+}
+
+/* During the stream, the selected channels are at their packed bits. */
+static void check_channels_published(const struct sr_dev_inst *sdi)
+{
+	const struct sr_channel *ch;
+	GSList *l;
+	int bit;
+
+	for (l = sr_dev_inst_channels_get(sdi); l; l = l->next) {
+		ch = l->data;
+		if (!strcmp(ch->name, "1"))
+			bit = 0;
+		else if (!strcmp(ch->name, "5"))
+			bit = 1;
+		else if (!strcmp(ch->name, "10"))
+			bit = 2;
+		else
+			bit = -1;
+		if (bit < 0) {
+			fail_unless(!ch->enabled, "Channel %s is enabled.",
+				ch->name);
+			continue;
+		}
+		fail_unless(ch->enabled && ch->index == bit,
+			"Channel %s has index %d, expected %d.",
+			ch->name, ch->index, bit);
+	}
+}
+
+/* Check that subset packs the selected channels in their order. */
+START_TEST(test_transform_subset)
+{
+	GHashTable *in_opts, *t_opts;
+	uint8_t data[2 * 64], expected;
+	struct feed f;
+	unsigned int i, sample;
+
+	/* 12 channels, two bytes per sample. */
+	for (i = 0; i < 64; i++) {
+		sample = (i * 0x9e5) & 0xfff;
+		data[i * 2] = sample & 0xff;
+		data[i * 2 + 1] = sample >> 8;
+	}
+	in_opts = logic_options_new(12, 1000);
+	t_opts = options_new();
+	/* The order of the names doesn't matter. */
+	option_set(t_opts, "channels", g_variant_new_string("10,1,5"));
+
+	feed_init(&f);
+	f.check_header = check_channels_published;
+	feed_run("binary", in_opts, "subset", t_opts, data, sizeof(data), 10,
+		&f, check_channels_unchanged);
+
+	fail_unless(f.samplerate == 1000);
+	fail_unless(f.unitsize == 1, "Unitsize is %d.", f.unitsize);
+	fail_unless(f.logic->len == 64, "Got %u samples.", f.logic->len);
+	for (i = 0; i < 64; i++) {
+		sample = data[i * 2] | data[i * 2 + 1] << 8;
+		expected = ((sample >> 1) & 1) | ((sample >> 5) & 1) << 1 |
+			((sample >> 10) & 1) << 2;
+		fail_unless(f.logic->data[i] == expected,
+			"Sample %u is 0x%02x, expected 0x%02x.", i,
+			f.logic->data[i], expected);
+	}
+
+	feed_clear(&f);
+	g_hash_table_destroy(t_opts);
+	g_hash_table_destroy(in_opts);
+}
+END_TEST
+
+/* Check that a2l sends one logic sample per window, with all channels. */
+START_TEST(test_transform_a2l)
+{
+	GHashTable *in_opts;
+	float values[2 * 40];
+	struct feed f;
+	uint8_t *data, expected;
+	unsigned int i;
+
+	for (i = 0; i < 40; i++) {
+		values[i * 2] = (i % 3 == 0) ? 1.0 : 0.0;
+		values[i * 2 + 1] = (i % 5 < 2) ? 0.75 : 0.25;
+	}
+	data = floats_new(values, G_N_ELEMENTS(values));
+	in_opts = analog_options_new(2, 1000);
+
+	/* The default threshold of 0.5, packets of 7 samples. */
+	feed_init(&f);
+	feed_run("raw_analog", in_opts, "a2l", NULL, data, sizeof(values),
+		7 * 2 * sizeof(float), &f, NULL);
+
+	fail_unless(f.unitsize == 1, "Unitsize is %d.", f.unitsize);
+	fail_unless(f.logic->len == 40, "Got %u samples.", f.logic->len);
+	for (i = 0; i < 40; i++) {
+		expected = (i % 3 == 0) | (i % 5 < 2) << 1;
+		fail_unless(f.logic->data[i] == expected,
+			"Sample %u is 0x%02x, expected 0x%02x.", i,
+			f.logic->data[i], expected);
+	}
+	/* The analog samples are passed on. */
+	fail_unless(f.analog->len == G_N_ELEMENTS(values),
+		"Got %u analog values.", f.analog->len);
+	fail_unless(!memcmp(f.analog->data, values, sizeof(values)));
+
+	feed_clear(&f);
+	g_hash_table_destroy(in_opts);
+	g_free(data);
+}
+END_TEST
+
+static GHashTable *repacketize_options_new(uint64_t samples)
+{
+	GHashTable *options;
+
+	/* A latency way beyond the test, only blocks and ends matter. */
+	options = options_new();
+	option_set(options, "samples", g_variant_new_uint64(samples));
+	option_set(options, "latency", g_variant_new_uint64(3600 * 1000));
+
+	return options;
+}
+
+/* Check that repacketize sends whole blocks, and the rest before END. */
+START_TEST(test_transform_repacketize)
+{
+	GHashTable *in_opts, *t_opts;
+	uint8_t data[100], *fdata;
+	float values[2 * 45];
+	struct feed f;
+	unsigned int i;
+	size_t len;
+
+	for (i = 0; i < sizeof(data); i++)
+		data[i] = i ^ 0x5a;
+	in_opts = logic_options_new(8, 1000);
+	t_opts = repacketize_options_new(16);
+
+	feed_init(&f);
+	feed_run("binary", in_opts, "repacketize", t_opts, data, sizeof(data),
+		7, &f, NULL);
+
+	fail_unless(f.logic->len == sizeof(data));
+	fail_unless(!memcmp(f.logic->data, data, sizeof(data)));
+	fail_unless(f.logic_lengths->len == 7, "Got %u packets.",
+		f.logic_lengths->len);
+	for (i = 0; i < f.logic_lengths->len; i++) {
+		len = g_array_index(f.logic_lengths, size_t, i);
+		fail_unless(len == (i < 6 ? 16 : 4),
+			"Packet %u has %zu samples.", i, len);
+	}
+
+	feed_clear(&f);
+	g_hash_table_destroy(t_opts);
+	g_hash_table_destroy(in_opts);
+
+	for (i = 0; i < G_N_ELEMENTS(values); i++)
+		values[i] = i * 0.25;
+	fdata = floats_new(values, G_N_ELEMENTS(values));
+	in_opts = analog_options_new(2, 1000);
+	t_opts = repacketize_options_new(8);
+
+	feed_init(&f);
+	feed_run("raw_analog", in_opts, "repacketize", t_opts, fdata,
+		sizeof(values), 5 * 2 * sizeof(float), &f, NULL);
+
+	fail_unless(f.analog->len == G_N_ELEMENTS(values));
+	fail_unless(!memcmp(f.analog->data, values, sizeof(values)));
+	fail_unless(f.analog_lengths->len == 6, "Got %u packets.",
+		f.analog_lengths->len);
+	for (i = 0; i < f.analog_lengths->len; i++) {
+		len = g_array_index(f.analog_lengths, size_t, i);
+		fail_unless(len == (i < 5 ? 8 : 5),
+			"Packet %u has %zu samples.", i, len);
+	}
+
+	feed_clear(&f);
+	g_hash_table_destroy(t_opts);
+	g_hash_table_destroy(in_opts);
+	g_free(fdata);
+}
+END_TEST
+
+/* Check the statistics of windows which span packets. */
+START_TEST(test_transform_stats)
+{
+	static const uint64_t flags[] = {
+		SR_MQFLAG_MIN, SR_MQFLAG_MAX, SR_MQFLAG_AVG, SR_MQFLAG_RMS,
+	};
+	GHashTable *in_opts, *t_opts;
+	float values[22], *out, exp[4];
+	unsigned int i, s, w, n;
+	struct feed f;
+	uint64_t mqflags;
+	uint8_t *data;
+	double sum_sq;
+
+	/* The last two samples are no complete window, they are dropped. */
+	for (i = 0; i < G_N_ELEMENTS(values); i++)
+		values[i] = (i % 2) ? i : -1.0 * i;
+	data = floats_new(values, G_N_ELEMENTS(values));
+	in_opts = analog_options_new(1, 1000);
+	t_opts = options_new();
+	option_set(t_opts, "window", g_variant_new_uint64(4));
+	option_set(t_opts, "stats", g_variant_new_string("min,max,mean,rms"));
+
+	feed_init(&f);
+	feed_run("raw_analog", in_opts, "stats", t_opts, data, sizeof(values),
+		3 * sizeof(float), &f, NULL);
+
+	out = (float *)f.analog->data;
+	fail_unless(f.analog->len == 5 * 4, "Got %u values.", f.analog->len);
+	for (s = 0; s < G_N_ELEMENTS(flags); s++) {
+		w = 0;
+		for (i = 0; i < f.analog->len; i++) {
+			mqflags = g_array_index(f.analog_flags, uint64_t, i);
+			if (!(mqflags & flags[s]))
+				continue;
+			fail_unless(w < 5, "Too many windows.");
+			exp[0] = -1.0 * (w * 4 + 2);
+			exp[1] = w * 4 + 3;
+			exp[2] = (-(w * 4.0) + (w * 4 + 1) - (w * 4 + 2) +
+				(w * 4 + 3)) / 4;
+			for (sum_sq = 0, n = 0; n < 4; n++)
+				sum_sq += (double)(w * 4 + n) * (w * 4 + n);
+			exp[3] = sum_sq / 4;
+			if (s == 3)
+				fail_unless(close_to(out[i] * out[i], exp[3]),
+					"RMS of window %u is %f.", w, out[i]);
+			else
+				fail_unless(close_to(out[i], exp[s]),
+					"Statistic %u of window %u is %f.",
+					s, w, out[i]);
+			w++;
+		}
+		fail_unless(w == 5, "Statistic %u has %u windows.", s, w);
+	}
+
+	feed_clear(&f);
+	g_hash_table_destroy(t_opts);
+	g_hash_table_destroy(in_opts);
+	g_free(data);
+}
+END_TEST
+
 /* Check whether at least one transform module is available. */
 START_TEST(test_transform_available)
 {
@@ -93,6 +670,12 @@ START_TEST(test_transform_options)
 
 	opt = sr_transform_options_get(sr_transform_find("nop"));
 	fail_unless(opt == NULL, "Transform module 'nop' doesn't have options.");
+
+	opt = sr_transform_options_get(sr_transform_find("subset"));
+	fail_unless(opt != NULL, "Transform module 'subset' has options.");
+	fail_unless(!strcmp(opt[0]->id, "channels"));
+	fail_unless(opt[1] == NULL);
+	sr_transform_options_free(opt);
 }
 END_TEST
 
@@ -112,5 +695,15 @@ Suite *suite_transform_all(void)
 	tcase_add_test(tc, test_transform_options);
 	suite_add_tcase(s, tc);
 
+	tc = tcase_create("behaviour");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_transform_decimate_logic);
+	tcase_add_test(tc, test_transform_decimate_analog);
+	tcase_add_test(tc, test_transform_subset);
+	tcase_add_test(tc, test_transform_a2l);
+	tcase_add_test(tc, test_transform_repacketize);
+	tcase_add_test(tc, test_transform_stats);
+	suite_add_tcase(s, tc);
+
 	return s;
 }
@@ -18,9 +18,12 @@
  */
 
 #include <config.h>
+#include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <check.h>
+#include <glib/gstdio.h>
 #include <libsigrok/libsigrok.h>
 #include "lib.h"
 
@@ -30,6 +33,11 @@
 #define NUM_MATCHES 70
 #define NUM_CHANNELS NUM_MATCHES
 
+/* Samples of the session files which the search tests write. */
+#define SEARCH_SAMPLES 5000
+/* Chunk size of those, so matches also straddle chunks. */
+#define SEARCH_CHUNK_SIZE 1024
+
 /* Check whether creating/freeing triggers with valid names works. */
 START_TEST(test_trigger_new_free)
 {
@@ -249,6 +257,238 @@ START_TEST(test_trigger_match_add_bogus)
 }
 END_TEST
 
+/* One match of a search test stage. */
+struct search_match {
+	int channel;
+	int type;
+};
+
+static void search_packet_send(const struct sr_output *o, int type,
+		const void *payload)
+{
+	struct sr_datafeed_packet packet;
+	GString *out;
+
+	packet.type = type;
+	packet.payload = payload;
+	out = NULL;
+	fail_unless(sr_output_send(o, &packet, &out) == SR_OK,
+		"sr_output_send() failed.");
+	if (out)
+		g_string_free(out, TRUE);
+}
+
+/* Write samples to a session file, in packets of uneven sizes. */
+static void search_file_write(const char *filename, int unitsize,
+		const uint8_t *samples, size_t num_samples)
+{
+	const struct sr_output *o;
+	struct sr_dev_inst *sdi;
+	struct sr_datafeed_header header;
+	struct sr_datafeed_logic logic;
+	GHashTable *options;
+	size_t offset, count;
+	char name[8];
+	int i;
+
+	sdi = sr_dev_inst_user_new("Vendor", "Model", "Version");
+	for (i = 0; i < unitsize * 8; i++) {
+		snprintf(name, sizeof(name), "D%d", i);
+		sr_dev_inst_channel_add(sdi, i, SR_CHANNEL_LOGIC, name);
+	}
+	options = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+		(GDestroyNotify)g_variant_unref);
+	g_hash_table_insert(options, "chunksize",
+		g_variant_ref_sink(g_variant_new_uint32(SEARCH_CHUNK_SIZE)));
+	o = sr_output_new(sr_output_find("srzip"), options, sdi, filename);
+	fail_unless(o != NULL, "sr_output_new() failed.");
+
+	memset(&header, 0, sizeof(header));
+	header.feed_version = 1;
+	search_packet_send(o, SR_DF_HEADER, &header);
+	logic.unitsize = unitsize;
+	for (offset = 0; offset < num_samples; offset += count) {
+		count = MIN(num_samples - offset, (size_t)(1 + rand() % 700));
+		logic.length = count * unitsize;
+		logic.data = (uint8_t *)samples + offset * unitsize;
+		search_packet_send(o, SR_DF_LOGIC, &logic);
+	}
+	search_packet_send(o, SR_DF_END, NULL);
+
+	sr_output_free(o);
+	g_hash_table_destroy(options);
+}
+
+/* Whether sample n matches the stage, checked one sample at a time. */
+static gboolean search_sample_matches(const uint8_t *samples, int unitsize,
+		size_t n, const struct search_match *matches, int num_matches)
+{
+	int i, bit, cur, prev;
+
+	for (i = 0; i < num_matches; i++) {
+		bit = matches[i].channel;
+		cur = (samples[n * unitsize + bit / 8] >> (bit % 8)) & 1;
+		if (matches[i].type == SR_TRIGGER_ZERO ||
+				matches[i].type == SR_TRIGGER_ONE) {
+			if (cur != (matches[i].type == SR_TRIGGER_ONE))
+				return FALSE;
+			continue;
+		}
+		/* The first sample has no previous one for an edge. */
+		if (!n)
+			return FALSE;
+		prev = (samples[(n - 1) * unitsize + bit / 8] >> (bit % 8)) & 1;
+		if (matches[i].type == SR_TRIGGER_RISING && (prev || !cur))
+			return FALSE;
+		if (matches[i].type == SR_TRIGGER_FALLING && (!prev || cur))
+			return FALSE;
+		if (matches[i].type == SR_TRIGGER_EDGE && prev == cur)
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+/*
+ * Search a session file with a single stage trigger, and check the
+ * matches against a scan of one sample at a time.
+ */
+static void search_check(int unitsize, const uint8_t *samples,
+		size_t num_samples, const struct search_match *matches,
+		int num_matches)
+{
+	struct sr_session *session;
+	struct sr_trigger *trigger;
+	struct sr_trigger_stage *stage;
+	struct sr_channel *ch;
+	GSList *devices, *channels;
+	uint64_t *found, num_found, expected;
+	char *dir, *filename;
+	size_t n;
+	int i;
+
+	dir = g_dir_make_tmp("sigrok-test-XXXXXX", NULL);
+	fail_unless(dir != NULL, "Cannot create a temporary directory.");
+	filename = g_build_filename(dir, "search.sr", NULL);
+	search_file_write(filename, unitsize, samples, num_samples);
+
+	fail_unless(sr_session_load(srtest_ctx, filename, &session) == SR_OK);
+	fail_unless(sr_session_dev_list(session, &devices) == SR_OK);
+	fail_unless(devices != NULL, "The session has no device.");
+	channels = sr_dev_inst_channels_get(devices->data);
+	trigger = sr_trigger_new(NULL);
+	stage = sr_trigger_stage_add(trigger);
+	for (i = 0; i < num_matches; i++) {
+		ch = g_slist_nth_data(channels, matches[i].channel);
+		fail_unless(ch != NULL);
+		fail_unless(sr_trigger_match_add(stage, ch,
+			matches[i].type, 0) == SR_OK);
+	}
+	g_slist_free(devices);
+
+	fail_unless(sr_session_search(session, trigger, 0, &found,
+		&num_found) == SR_OK);
+	expected = 0;
+	for (n = 0; n < num_samples; n++) {
+		if (!search_sample_matches(samples, unitsize, n,
+				matches, num_matches))
+			continue;
+		fail_unless(expected < num_found,
+			"Missed the match at sample %zu.", n);
+		fail_unless(found[expected] == n,
+			"Match at sample %" PRIu64 ", expected %zu.",
+			found[expected], n);
+		expected++;
+	}
+	fail_unless(expected == num_found, "Found %" PRIu64
+		" matches, expected %" PRIu64 ".", num_found, expected);
+
+	g_free(found);
+	sr_trigger_free(trigger);
+	sr_session_destroy(session);
+	g_remove(filename);
+	g_rmdir(dir);
+	g_free(filename);
+	g_free(dir);
+}
+
+/* Check the search on random data, against a sample by sample scan. */
+START_TEST(test_trigger_search_random)
+{
+	struct search_match matches[3];
+	uint8_t *samples;
+	size_t n;
+	int unitsize, density, num_matches, first, round, i;
+
+	srand(1);
+	samples = g_malloc(SEARCH_SAMPLES * 4);
+	for (round = 0; round < 24; round++) {
+		unitsize = 1 << (round % 3);
+		/* Sparse, busy and random bits, sparse ones most often. */
+		density = round % 4;
+		for (n = 0; n < SEARCH_SAMPLES * (size_t)unitsize; n++) {
+			if ((density == 0 || density == 3) && n >= (size_t)unitsize)
+				samples[n] = rand() % 300 ? samples[n - unitsize] :
+					(uint8_t)rand();
+			else if (density == 0 || density == 3)
+				samples[n] = 0;
+			else if (density == 1)
+				samples[n] = rand() % 2 ? 0xff : 0x00;
+			else
+				samples[n] = rand();
+		}
+		/* Distinct channels, at most one match each. */
+		num_matches = 1 + rand() % 3;
+		first = rand() % (unitsize * 8);
+		for (i = 0; i < num_matches; i++) {
+			matches[i].channel = (first + i * 3) % (unitsize * 8);
+			matches[i].type = SR_TRIGGER_ZERO + rand() % 5;
+		}
+		search_check(unitsize, samples, SEARCH_SAMPLES, matches,
+			num_matches);
+	}
+	g_free(samples);
+}
+END_TEST
+
+/*
+ * Check that rising edges are found right at and next to the boundaries
+ * of words, vectors and chunks, where the scan switches how it checks.
+ */
+START_TEST(test_trigger_search_boundaries)
+{
+	static const size_t positions[] = {
+		1, 7, 8, 9, 15, 16, 17, 31, 32, 33, 63, 64, 65,
+		SEARCH_CHUNK_SIZE - 1, SEARCH_CHUNK_SIZE, SEARCH_CHUNK_SIZE + 1,
+	};
+	struct search_match match;
+	uint8_t *samples;
+	size_t num_samples, n;
+	unsigned int p;
+	int unitsize;
+
+	num_samples = 4 * SEARCH_CHUNK_SIZE;
+	samples = g_malloc(num_samples * 4);
+	for (unitsize = 1; unitsize <= 4; unitsize *= 2) {
+		match.channel = unitsize * 8 - 1;
+		match.type = SR_TRIGGER_RISING;
+		/* The edge at each position, then at each byte offset. */
+		for (p = 0; p < ARRAY_SIZE(positions); p++) {
+			memset(samples, 0, num_samples * unitsize);
+			for (n = positions[p]; n < num_samples; n++)
+				samples[n * unitsize + unitsize - 1] = 0x80;
+			search_check(unitsize, samples, num_samples, &match, 1);
+			memset(samples, 0, num_samples * unitsize);
+			n = positions[p] / unitsize;
+			memset(samples + n * unitsize, 0xff,
+				(num_samples - n) * unitsize);
+			search_check(unitsize, samples, num_samples, &match, 1);
+		}
+	}
+	g_free(samples);
+}
+END_TEST
+
 Suite *suite_trigger(void)
 {
 	Suite *s;
@@ -276,5 +516,12 @@ Suite *suite_trigger(void)
 	tcase_add_test(tc, test_trigger_match_add_bogus);
 	suite_add_tcase(s, tc);
 
+	tc = tcase_create("search");
+	tcase_set_timeout(tc, 0);
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_trigger_search_random);
+	tcase_add_test(tc, test_trigger_search_boundaries);
+	suite_add_tcase(s, tc);
+
 	return s;
 }
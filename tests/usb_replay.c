@@ -0,0 +1,1078 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Record and replay of USB transfers, for benchmarking and profiling
+ * USB drivers without the devices.
+ *
+ * This is a shim for libusb, to be preloaded into a program which uses
+ * libsigrok. With SR_USB_RECORD=<file>, the devices and transfers of a
+ * real acquisition get recorded: the device lists with their
+ * descriptors, string descriptors, control and bulk transfers, and the
+ * completions of asynchronous transfers with their data.
+ *
+ * With SR_USB_REPLAY=<file>, the shim takes the place of the devices.
+ * Device lists and synchronous transfers return what was recorded, and
+ * submitted transfers complete with the recorded data, in the order in
+ * which they completed per endpoint. The driver's transfer callbacks,
+ * its sample conversion and the session run as with the device. By
+ * default transfers complete as fast as the driver submits them. With
+ * SR_USB_REPLAY_TIMING=original they complete at the recorded times.
+ * Transfers beyond the end of the recording fail with
+ * LIBUSB_TRANSFER_NO_DEVICE.
+ *
+ *   LD_PRELOAD=tests/.libs/libsigrok_usb_replay.so \
+ *     SR_USB_RECORD=la.usbrec sigrok-cli -d fx2lafw --samples 10m ...
+ *   LD_PRELOAD=tests/.libs/libsigrok_usb_replay.so \
+ *     SR_USB_REPLAY=la.usbrec sigrok-cli -d fx2lafw --samples 10m ...
+ *
+ * The replay has to be run with the options of the recording. Control
+ * transfers are matched by their setup fields, the replay fails those
+ * which weren't recorded. Firmware uploads are replayed like any other
+ * control transfer, and so is the renumeration which follows them.
+ *
+ * Build with "make tests/libsigrok_usb_replay.la".
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <config.h>
+#include <dlfcn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include <libusb.h>
+
+#define FILE_MAGIC "SRUSBREC"
+#define FILE_VERSION 1
+#define MAX_PORTS 7
+
+enum rec_type {
+	REC_DEVICES = 1,
+	REC_STRING,
+	REC_CONTROL,
+	REC_BULK,
+	REC_TRANSFER,
+};
+
+/* A recorded device, also the device which the replay hands out. */
+struct fake_dev {
+	uint8_t bus, address;
+	uint8_t num_ports;
+	uint8_t ports[MAX_PORTS];
+	struct libusb_device_descriptor desc;
+	int refcount;
+};
+
+struct fake_handle {
+	struct fake_dev *dev;
+};
+
+struct rec {
+	enum rec_type type;
+	int64_t time_us;
+	uint8_t bus, address;
+	/* Setup of control transfers, endpoint and type of others. */
+	uint8_t request_type, request;
+	uint16_t value, index, length;
+	uint8_t endpoint, xfer_type;
+	int32_t status, ret, actual;
+	/* REC_DEVICES: the devices of the list. */
+	GPtrArray *devs;
+	const uint8_t *data;
+	size_t data_len;
+	gboolean used;
+};
+
+/* A submitted transfer, which the replay has yet to complete. */
+struct pending {
+	struct libusb_transfer *transfer;
+	gboolean cancelled;
+};
+
+static enum { MODE_OFF, MODE_RECORD, MODE_REPLAY } mode;
+static GMutex lock;
+static int64_t start_us;
+
+/* Recording. */
+static FILE *rec_file;
+static GHashTable *rec_callbacks;
+
+/* Replay. */
+static gboolean original_timing;
+static gchar *replay_buf;
+static GPtrArray *recs;
+/* Records per type, and the first unused one of each. */
+static GPtrArray *recs_by_type[REC_TRANSFER + 1];
+static guint first_unused[REC_TRANSFER + 1];
+static guint next_devices;
+static GPtrArray *last_devices;
+static GQueue replay_pending = G_QUEUE_INIT;
+static int64_t replay_t0, rec_t0;
+
+static void shim_init(void);
+
+#define REAL(name) \
+	static __typeof__(name) *real_##name; \
+	if (!real_##name) \
+		real_##name = (__typeof__(name) *)dlsym(RTLD_NEXT, #name); \
+	shim_init()
+
+/*--- File format -----------------------------------------------------------*/
+
+static void put_u8(GByteArray *b, uint8_t v)
+{
+	g_byte_array_append(b, &v, 1);
+}
+
+static void put_u16(GByteArray *b, uint16_t v)
+{
+	v = GUINT16_TO_LE(v);
+	g_byte_array_append(b, (uint8_t *)&v, sizeof(v));
+}
+
+static void put_u32(GByteArray *b, uint32_t v)
+{
+	v = GUINT32_TO_LE(v);
+	g_byte_array_append(b, (uint8_t *)&v, sizeof(v));
+}
+
+static void put_u64(GByteArray *b, uint64_t v)
+{
+	v = GUINT64_TO_LE(v);
+	g_byte_array_append(b, (uint8_t *)&v, sizeof(v));
+}
+
+static uint8_t get_u8(const uint8_t **p)
+{
+	return *(*p)++;
+}
+
+static uint16_t get_u16(const uint8_t **p)
+{
+	uint16_t v;
+
+	memcpy(&v, *p, sizeof(v));
+	*p += sizeof(v);
+
+	return GUINT16_FROM_LE(v);
+}
+
+static uint32_t get_u32(const uint8_t **p)
+{
+	uint32_t v;
+
+	memcpy(&v, *p, sizeof(v));
+	*p += sizeof(v);
+
+	return GUINT32_FROM_LE(v);
+}
+
+static uint64_t get_u64(const uint8_t **p)
+{
+	uint64_t v;
+
+	memcpy(&v, *p, sizeof(v));
+	*p += sizeof(v);
+
+	return GUINT64_FROM_LE(v);
+}
+
+static void put_desc(GByteArray *b, const struct libusb_device_descriptor *d)
+{
+	put_u8(b, d->bLength);
+	put_u8(b, d->bDescriptorType);
+	put_u16(b, d->bcdUSB);
+	put_u8(b, d->bDeviceClass);
+	put_u8(b, d->bDeviceSubClass);
+	put_u8(b, d->bDeviceProtocol);
+	put_u8(b, d->bMaxPacketSize0);
+	put_u16(b, d->idVendor);
+	put_u16(b, d->idProduct);
+	put_u16(b, d->bcdDevice);
+	put_u8(b, d->iManufacturer);
+	put_u8(b, d->iProduct);
+	put_u8(b, d->iSerialNumber);
+	put_u8(b, d->bNumConfigurations);
+}
+
+static void get_desc(const uint8_t **p, struct libusb_device_descriptor *d)
+{
+	d->bLength = get_u8(p);
+	d->bDescriptorType = get_u8(p);
+	d->bcdUSB = get_u16(p);
+	d->bDeviceClass = get_u8(p);
+	d->bDeviceSubClass = get_u8(p);
+	d->bDeviceProtocol = get_u8(p);
+	d->bMaxPacketSize0 = get_u8(p);
+	d->idVendor = get_u16(p);
+	d->idProduct = get_u16(p);
+	d->bcdDevice = get_u16(p);
+	d->iManufacturer = get_u8(p);
+	d->iProduct = get_u8(p);
+	d->iSerialNumber = get_u8(p);
+	d->bNumConfigurations = get_u8(p);
+}
+
+/* Device descriptors take 18 bytes in the file, as on the wire. */
+#define DESC_SIZE 18
+#define DEV_SIZE (3 + MAX_PORTS + DESC_SIZE)
+
+/*
+ * Records are a type, the size of what follows the header, and the
+ * time since the start of the recording. The fixed fields of all types
+ * and the data follow.
+ */
+#define HDR_SIZE 16
+#define FIXED_SIZE 24
+
+static void rec_write(enum rec_type type, const struct rec *r,
+		const GByteArray *extra, const uint8_t *data, size_t data_len)
+{
+	GByteArray *b;
+
+	b = g_byte_array_new();
+	put_u32(b, type);
+	put_u32(b, FIXED_SIZE + (extra ? extra->len : 0) + data_len);
+	put_u64(b, g_get_monotonic_time() - start_us);
+	put_u8(b, r->bus);
+	put_u8(b, r->address);
+	put_u8(b, r->request_type);
+	put_u8(b, r->request);
+	put_u16(b, r->value);
+	put_u16(b, r->index);
+	put_u16(b, r->length);
+	put_u8(b, r->endpoint);
+	put_u8(b, r->xfer_type);
+	put_u32(b, r->status);
+	put_u32(b, r->ret);
+	put_u32(b, r->actual);
+	if (extra)
+		g_byte_array_append(b, extra->data, extra->len);
+	if (data_len)
+		g_byte_array_append(b, data, data_len);
+
+	g_mutex_lock(&lock);
+	if (fwrite(b->data, 1, b->len, rec_file) != b->len)
+		fprintf(stderr, "usb_replay: Failed to write the recording.\n");
+	g_mutex_unlock(&lock);
+	g_byte_array_free(b, TRUE);
+}
+
+static void rec_free(void *data)
+{
+	struct rec *r;
+
+	r = data;
+	if (r->devs)
+		g_ptr_array_free(r->devs, TRUE);
+	g_free(r);
+}
+
+static gboolean replay_load(const char *filename)
+{
+	struct rec *r;
+	struct fake_dev *dev;
+	const uint8_t *p, *end, *next;
+	gsize len;
+	uint32_t size, count, i;
+
+	if (!g_file_get_contents(filename, &replay_buf, &len, NULL)) {
+		fprintf(stderr, "usb_replay: Cannot read %s.\n", filename);
+		return FALSE;
+	}
+	p = (const uint8_t *)replay_buf;
+	end = p + len;
+	if (len < 12 || memcmp(p, FILE_MAGIC, 8)) {
+		fprintf(stderr, "usb_replay: %s is no recording.\n", filename);
+		return FALSE;
+	}
+	p += 8;
+	if (get_u32(&p) != FILE_VERSION) {
+		fprintf(stderr, "usb_replay: Unsupported recording version.\n");
+		return FALSE;
+	}
+
+	recs = g_ptr_array_new_with_free_func(rec_free);
+	for (i = 0; i <= REC_TRANSFER; i++)
+		recs_by_type[i] = g_ptr_array_new();
+	while (end - p >= HDR_SIZE + FIXED_SIZE) {
+		r = g_malloc0(sizeof(*r));
+		r->type = get_u32(&p);
+		size = get_u32(&p);
+		r->time_us = get_u64(&p);
+		if (size < FIXED_SIZE || size > (size_t)(end - p)) {
+			g_free(r);
+			break;
+		}
+		next = p + size;
+		r->bus = get_u8(&p);
+		r->address = get_u8(&p);
+		r->request_type = get_u8(&p);
+		r->request = get_u8(&p);
+		r->value = get_u16(&p);
+		r->index = get_u16(&p);
+		r->length = get_u16(&p);
+		r->endpoint = get_u8(&p);
+		r->xfer_type = get_u8(&p);
+		r->status = get_u32(&p);
+		r->ret = get_u32(&p);
+		r->actual = get_u32(&p);
+		if (r->type == REC_DEVICES) {
+			count = r->ret;
+			if ((size_t)(next - p) < (size_t)count * DEV_SIZE) {
+				g_free(r);
+				break;
+			}
+			r->devs = g_ptr_array_new_with_free_func(g_free);
+			for (i = 0; i < count; i++) {
+				dev = g_malloc0(sizeof(*dev));
+				dev->bus = get_u8(&p);
+				dev->address = get_u8(&p);
+				dev->num_ports = MIN(get_u8(&p), MAX_PORTS);
+				memcpy(dev->ports, p, MAX_PORTS);
+				p += MAX_PORTS;
+				get_desc(&p, &dev->desc);
+				g_ptr_array_add(r->devs, dev);
+			}
+		}
+		r->data = p;
+		r->data_len = next - p;
+		p = next;
+		g_ptr_array_add(recs, r);
+		if (r->type >= REC_DEVICES && r->type <= REC_TRANSFER)
+			g_ptr_array_add(recs_by_type[r->type], r);
+	}
+
+	return TRUE;
+}
+
+/* The first unused record of a type which matches, NULL if none. */
+static struct rec *replay_find(enum rec_type type, const struct rec *key,
+		gboolean (*match)(const struct rec *, const struct rec *))
+{
+	GPtrArray *a;
+	struct rec *r;
+	guint i;
+
+	a = recs_by_type[type];
+	for (i = first_unused[type]; i < a->len; i++) {
+		r = g_ptr_array_index(a, i);
+		if (!r->used && match(r, key))
+			return r;
+	}
+
+	return NULL;
+}
+
+static void replay_use(struct rec *r)
+{
+	GPtrArray *a;
+
+	r->used = TRUE;
+	a = recs_by_type[r->type];
+	while (first_unused[r->type] < a->len &&
+			((struct rec *)g_ptr_array_index(a,
+			first_unused[r->type]))->used)
+		first_unused[r->type]++;
+}
+
+/*--- Setup -----------------------------------------------------------------*/
+
+static void shim_init(void)
+{
+	static gsize done;
+	const char *rec_name, *replay_name, *timing;
+
+	if (!g_once_init_enter(&done))
+		return;
+
+	start_us = g_get_monotonic_time();
+	rec_name = g_getenv("SR_USB_RECORD");
+	replay_name = g_getenv("SR_USB_REPLAY");
+	timing = g_getenv("SR_USB_REPLAY_TIMING");
+	if (replay_name && replay_load(replay_name)) {
+		mode = MODE_REPLAY;
+		original_timing = timing && !strcmp(timing, "original");
+		last_devices = g_ptr_array_new();
+	} else if (rec_name) {
+		rec_file = fopen(rec_name, "wb");
+		if (rec_file) {
+			fwrite(FILE_MAGIC, 1, 8, rec_file);
+			fwrite(&(uint32_t){ GUINT32_TO_LE(FILE_VERSION) }, 4, 1,
+				rec_file);
+			rec_callbacks = g_hash_table_new(NULL, NULL);
+			mode = MODE_RECORD;
+		} else {
+			fprintf(stderr, "usb_replay: Cannot create %s.\n", rec_name);
+		}
+	}
+
+	g_once_init_leave(&done, 1);
+}
+
+static __attribute__((destructor)) void shim_exit(void)
+{
+	if (rec_file)
+		fclose(rec_file);
+}
+
+static struct fake_dev *fake_dev(libusb_device *dev)
+{
+	return (struct fake_dev *)dev;
+}
+
+static struct fake_dev *fake_handle_dev(libusb_device_handle *hdl)
+{
+	return ((struct fake_handle *)hdl)->dev;
+}
+
+/* Bus and address of a real device handle, for the records. */
+static void real_handle_ids(libusb_device_handle *hdl, struct rec *r)
+{
+	libusb_device *dev;
+
+	REAL(libusb_get_device);
+	REAL(libusb_get_bus_number);
+	REAL(libusb_get_device_address);
+
+	dev = real_libusb_get_device(hdl);
+	r->bus = real_libusb_get_bus_number(dev);
+	r->address = real_libusb_get_device_address(dev);
+}
+
+/*--- Devices ---------------------------------------------------------------*/
+
+ssize_t libusb_get_device_list(libusb_context *ctx, libusb_device ***list)
+{
+	struct libusb_device_descriptor desc;
+	struct fake_dev *dev;
+	struct rec r, *rd;
+	GByteArray *extra;
+	uint8_t ports[MAX_PORTS];
+	ssize_t count, i;
+	guint j;
+	int n;
+
+	REAL(libusb_get_device_list);
+	REAL(libusb_get_device_descriptor);
+	REAL(libusb_get_bus_number);
+	REAL(libusb_get_device_address);
+	REAL(libusb_get_port_numbers);
+
+	if (mode == MODE_REPLAY) {
+		/* Lists follow the recorded ones, the last one stays. */
+		g_mutex_lock(&lock);
+		for (; next_devices < recs->len; next_devices++) {
+			rd = g_ptr_array_index(recs, next_devices);
+			if (rd->type == REC_DEVICES) {
+				g_ptr_array_set_size(last_devices, 0);
+				for (j = 0; j < rd->devs->len; j++)
+					g_ptr_array_add(last_devices,
+						g_ptr_array_index(rd->devs, j));
+				next_devices++;
+				break;
+			}
+		}
+		*list = g_malloc0_n(last_devices->len + 1, sizeof(**list));
+		for (i = 0; i < (ssize_t)last_devices->len; i++) {
+			dev = g_ptr_array_index(last_devices, i);
+			dev->refcount++;
+			(*list)[i] = (libusb_device *)dev;
+		}
+		count = last_devices->len;
+		g_mutex_unlock(&lock);
+		return count;
+	}
+
+	count = real_libusb_get_device_list(ctx, list);
+	if (mode != MODE_RECORD || count < 0)
+		return count;
+
+	memset(&r, 0, sizeof(r));
+	r.ret = count;
+	extra = g_byte_array_new();
+	for (i = 0; i < count; i++) {
+		memset(&desc, 0, sizeof(desc));
+		real_libusb_get_device_descriptor((*list)[i], &desc);
+		memset(ports, 0, sizeof(ports));
+		n = real_libusb_get_port_numbers((*list)[i], ports, MAX_PORTS);
+		put_u8(extra, real_libusb_get_bus_number((*list)[i]));
+		put_u8(extra, real_libusb_get_device_address((*list)[i]));
+		put_u8(extra, MAX(n, 0));
+		g_byte_array_append(extra, ports, MAX_PORTS);
+		put_desc(extra, &desc);
+	}
+	rec_write(REC_DEVICES, &r, extra, NULL, 0);
+	g_byte_array_free(extra, TRUE);
+
+	return count;
+}
+
+void libusb_free_device_list(libusb_device **list, int unref_devices)
+{
+	size_t i;
+
+	REAL(libusb_free_device_list);
+
+	if (mode != MODE_REPLAY) {
+		real_libusb_free_device_list(list, unref_devices);
+		return;
+	}
+	if (!list)
+		return;
+	if (unref_devices) {
+		for (i = 0; list[i]; i++)
+			fake_dev(list[i])->refcount--;
+	}
+	g_free(list);
+}
+
+libusb_device *libusb_ref_device(libusb_device *dev)
+{
+	REAL(libusb_ref_device);
+
+	if (mode != MODE_REPLAY)
+		return real_libusb_ref_device(dev);
+	fake_dev(dev)->refcount++;
+
+	return dev;
+}
+
+void libusb_unref_device(libusb_device *dev)
+{
+	REAL(libusb_unref_device);
+
+	if (mode != MODE_REPLAY) {
+		real_libusb_unref_device(dev);
+		return;
+	}
+	/* Devices stay with their records, for lists to come. */
+	if (dev)
+		fake_dev(dev)->refcount--;
+}
+
+int libusb_get_device_descriptor(libusb_device *dev,
+		struct libusb_device_descriptor *desc)
+{
+	REAL(libusb_get_device_descriptor);
+
+	if (mode != MODE_REPLAY)
+		return real_libusb_get_device_descriptor(dev, desc);
+	*desc = fake_dev(dev)->desc;
+
+	return LIBUSB_SUCCESS;
+}
+
+uint8_t libusb_get_bus_number(libusb_device *dev)
+{
+	REAL(libusb_get_bus_number);
+
+	if (mode != MODE_REPLAY)
+		return real_libusb_get_bus_number(dev);
+
+	return fake_dev(dev)->bus;
+}
+
+uint8_t libusb_get_device_address(libusb_device *dev)
+{
+	REAL(libusb_get_device_address);
+
+	if (mode != MODE_REPLAY)
+		return real_libusb_get_device_address(dev);
+
+	return fake_dev(dev)->address;
+}
+
+int libusb_get_port_numbers(libusb_device *dev, uint8_t *port_numbers,
+		int port_numbers_len)
+{
+	struct fake_dev *fd;
+
+	REAL(libusb_get_port_numbers);
+
+	if (mode != MODE_REPLAY)
+		return real_libusb_get_port_numbers(dev, port_numbers,
+			port_numbers_len);
+	fd = fake_dev(dev);
+	if (fd->num_ports > port_numbers_len)
+		return LIBUSB_ERROR_OVERFLOW;
+	memcpy(port_numbers, fd->ports, fd->num_ports);
+
+	return fd->num_ports;
+}
+
+int libusb_open(libusb_device *dev, libusb_device_handle **dev_handle)
+{
+	struct fake_handle *hdl;
+
+	REAL(libusb_open);
+
+	if (mode != MODE_REPLAY)
+		return real_libusb_open(dev, dev_handle);
+	hdl = g_malloc0(sizeof(*hdl));
+	hdl->dev = fake_dev(dev);
+	hdl->dev->refcount++;
+	*dev_handle = (libusb_device_handle *)hdl;
+
+	return LIBUSB_SUCCESS;
+}
+
+void libusb_close(libusb_device_handle *dev_handle)
+{
+	REAL(libusb_close);
+
+	if (mode != MODE_REPLAY) {
+		real_libusb_close(dev_handle);
+		return;
+	}
+	if (!dev_handle)
+		return;
+	fake_handle_dev(dev_handle)->refcount--;
+	g_free(dev_handle);
+}
+
+libusb_device *libusb_get_device(libusb_device_handle *dev_handle)
+{
+	REAL(libusb_get_device);
+
+	if (mode != MODE_REPLAY)
+		return real_libusb_get_device(dev_handle);
+
+	return (libusb_device *)fake_handle_dev(dev_handle);
+}
+
+/* Interface and configuration changes always work in the replay. */
+#define REPLAY_SUCCEED(name) \
+int name(libusb_device_handle *dev_handle, int arg) \
+{ \
+	REAL(name); \
+	if (mode != MODE_REPLAY) \
+		return real_##name(dev_handle, arg); \
+	return LIBUSB_SUCCESS; \
+}
+
+REPLAY_SUCCEED(libusb_claim_interface)
+REPLAY_SUCCEED(libusb_release_interface)
+REPLAY_SUCCEED(libusb_detach_kernel_driver)
+REPLAY_SUCCEED(libusb_set_configuration)
+
+int libusb_kernel_driver_active(libusb_device_handle *dev_handle,
+		int interface_number)
+{
+	REAL(libusb_kernel_driver_active);
+
+	if (mode != MODE_REPLAY)
+		return real_libusb_kernel_driver_active(dev_handle,
+			interface_number);
+
+	return 0;
+}
+
+unsigned char *libusb_dev_mem_alloc(libusb_device_handle *dev_handle,
+		size_t length)
+{
+	REAL(libusb_dev_mem_alloc);
+
+	/* Callers fall back to the heap. */
+	if (mode == MODE_REPLAY)
+		return NULL;
+
+	return real_libusb_dev_mem_alloc(dev_handle, length);
+}
+
+/*--- Synchronous transfers -------------------------------------------------*/
+
+static gboolean match_string(const struct rec *r, const struct rec *key)
+{
+	return r->bus == key->bus && r->address == key->address &&
+		r->index == key->index;
+}
+
+int libusb_get_string_descriptor_ascii(libusb_device_handle *dev_handle,
+		uint8_t desc_index, unsigned char *data, int length)
+{
+	struct fake_dev *dev;
+	struct rec key, *r;
+	int ret;
+
+	REAL(libusb_get_string_descriptor_ascii);
+
+	memset(&key, 0, sizeof(key));
+	key.index = desc_index;
+	if (mode == MODE_REPLAY) {
+		dev = fake_handle_dev(dev_handle);
+		key.bus = dev->bus;
+		key.address = dev->address;
+		g_mutex_lock(&lock);
+		r = replay_find(REC_STRING, &key, match_string);
+		if (r)
+			replay_use(r);
+		g_mutex_unlock(&lock);
+		if (!r)
+			return LIBUSB_ERROR_IO;
+		if (r->ret < 0)
+			return r->ret;
+		ret = MIN((int)r->data_len, length);
+		memcpy(data, r->data, ret);
+		return ret;
+	}
+
+	ret = real_libusb_get_string_descriptor_ascii(dev_handle, desc_index,
+		data, length);
+	if (mode == MODE_RECORD) {
+		real_handle_ids(dev_handle, &key);
+		key.ret = ret;
+		rec_write(REC_STRING, &key, NULL, data, MAX(ret, 0));
+	}
+
+	return ret;
+}
+
+static gboolean match_control(const struct rec *r, const struct rec *key)
+{
+	return r->bus == key->bus && r->address == key->address &&
+		r->request_type == key->request_type &&
+		r->request == key->request && r->value == key->value &&
+		r->index == key->index && r->length == key->length;
+}
+
+int libusb_control_transfer(libusb_device_handle *dev_handle,
+		uint8_t request_type, uint8_t bRequest, uint16_t wValue,
+		uint16_t wIndex, unsigned char *data, uint16_t wLength,
+		unsigned int timeout)
+{
+	struct fake_dev *dev;
+	struct rec key, *r;
+	gboolean in;
+	int ret;
+
+	REAL(libusb_control_transfer);
+
+	memset(&key, 0, sizeof(key));
+	key.request_type = request_type;
+	key.request = bRequest;
+	key.value = wValue;
+	key.index = wIndex;
+	key.length = wLength;
+	in = (request_type & LIBUSB_ENDPOINT_DIR_MASK) == LIBUSB_ENDPOINT_IN;
+	if (mode == MODE_REPLAY) {
+		dev = fake_handle_dev(dev_handle);
+		key.bus = dev->bus;
+		key.address = dev->address;
+		g_mutex_lock(&lock);
+		r = replay_find(REC_CONTROL, &key, match_control);
+		if (r)
+			replay_use(r);
+		g_mutex_unlock(&lock);
+		if (!r) {
+			fprintf(stderr, "usb_replay: No recorded control transfer "
+				"%02x %02x %04x %04x.\n", request_type, bRequest,
+				wValue, wIndex);
+			return LIBUSB_ERROR_IO;
+		}
+		if (in && r->ret > 0)
+			memcpy(data, r->data, MIN((size_t)r->ret, r->data_len));
+		return r->ret;
+	}
+
+	ret = real_libusb_control_transfer(dev_handle, request_type, bRequest,
+		wValue, wIndex, data, wLength, timeout);
+	if (mode == MODE_RECORD) {
+		real_handle_ids(dev_handle, &key);
+		key.ret = ret;
+		/* Only the device's answers are needed for the replay. */
+		rec_write(REC_CONTROL, &key, NULL, data, in ? MAX(ret, 0) : 0);
+	}
+
+	return ret;
+}
+
+static gboolean match_endpoint(const struct rec *r, const struct rec *key)
+{
+	return r->bus == key->bus && r->address == key->address &&
+		r->endpoint == key->endpoint;
+}
+
+int libusb_bulk_transfer(libusb_device_handle *dev_handle,
+		unsigned char endpoint, unsigned char *data, int length,
+		int *actual_length, unsigned int timeout)
+{
+	struct fake_dev *dev;
+	struct rec key, *r;
+	gboolean in;
+	int ret, transferred;
+
+	REAL(libusb_bulk_transfer);
+
+	memset(&key, 0, sizeof(key));
+	key.endpoint = endpoint;
+	in = (endpoint & LIBUSB_ENDPOINT_DIR_MASK) == LIBUSB_ENDPOINT_IN;
+	if (mode == MODE_REPLAY) {
+		dev = fake_handle_dev(dev_handle);
+		key.bus = dev->bus;
+		key.address = dev->address;
+		g_mutex_lock(&lock);
+		r = replay_find(REC_BULK, &key, match_endpoint);
+		if (r)
+			replay_use(r);
+		g_mutex_unlock(&lock);
+		if (!r)
+			return LIBUSB_ERROR_NO_DEVICE;
+		transferred = MIN(r->actual, length);
+		if (in)
+			memcpy(data, r->data, MIN((size_t)transferred, r->data_len));
+		if (actual_length)
+			*actual_length = transferred;
+		return r->ret;
+	}
+
+	transferred = 0;
+	ret = real_libusb_bulk_transfer(dev_handle, endpoint, data, length,
+		&transferred, timeout);
+	if (actual_length)
+		*actual_length = transferred;
+	if (mode == MODE_RECORD) {
+		real_handle_ids(dev_handle, &key);
+		key.ret = ret;
+		key.actual = transferred;
+		rec_write(REC_BULK, &key, NULL, data, in ? transferred : 0);
+	}
+
+	return ret;
+}
+
+/*--- Asynchronous transfers ------------------------------------------------*/
+
+/* Record a completed transfer, then hand it to the driver's callback. */
+static void LIBUSB_CALL record_callback(struct libusb_transfer *transfer)
+{
+	libusb_transfer_cb_fn callback;
+	struct rec r;
+	gboolean in;
+
+	g_mutex_lock(&lock);
+	callback = g_hash_table_lookup(rec_callbacks, transfer);
+	g_hash_table_remove(rec_callbacks, transfer);
+	g_mutex_unlock(&lock);
+
+	memset(&r, 0, sizeof(r));
+	real_handle_ids(transfer->dev_handle, &r);
+	r.endpoint = transfer->endpoint;
+	r.xfer_type = transfer->type;
+	r.status = transfer->status;
+	r.ret = transfer->length;
+	r.actual = transfer->actual_length;
+	in = (transfer->endpoint & LIBUSB_ENDPOINT_DIR_MASK) == LIBUSB_ENDPOINT_IN;
+	rec_write(REC_TRANSFER, &r, NULL, transfer->buffer,
+		in && transfer->actual_length > 0 ? transfer->actual_length : 0);
+
+	transfer->callback = callback;
+	callback(transfer);
+}
+
+int libusb_submit_transfer(struct libusb_transfer *transfer)
+{
+	struct pending *p;
+	int ret;
+
+	REAL(libusb_submit_transfer);
+
+	if (mode == MODE_REPLAY) {
+		p = g_malloc0(sizeof(*p));
+		p->transfer = transfer;
+		g_mutex_lock(&lock);
+		if (!replay_t0)
+			replay_t0 = g_get_monotonic_time();
+		g_queue_push_tail(&replay_pending, p);
+		g_mutex_unlock(&lock);
+		return LIBUSB_SUCCESS;
+	}
+	if (mode != MODE_RECORD)
+		return real_libusb_submit_transfer(transfer);
+
+	g_mutex_lock(&lock);
+	g_hash_table_insert(rec_callbacks, transfer, transfer->callback);
+	g_mutex_unlock(&lock);
+	transfer->callback = record_callback;
+	ret = real_libusb_submit_transfer(transfer);
+	if (ret != LIBUSB_SUCCESS) {
+		g_mutex_lock(&lock);
+		transfer->callback = g_hash_table_lookup(rec_callbacks, transfer);
+		g_hash_table_remove(rec_callbacks, transfer);
+		g_mutex_unlock(&lock);
+	}
+
+	return ret;
+}
+
+int libusb_cancel_transfer(struct libusb_transfer *transfer)
+{
+	struct pending *p;
+	GList *l;
+
+	REAL(libusb_cancel_transfer);
+
+	if (mode != MODE_REPLAY)
+		return real_libusb_cancel_transfer(transfer);
+
+	g_mutex_lock(&lock);
+	for (l = replay_pending.head; l; l = l->next) {
+		p = l->data;
+		if (p->transfer == transfer) {
+			p->cancelled = TRUE;
+			g_mutex_unlock(&lock);
+			return LIBUSB_SUCCESS;
+		}
+	}
+	g_mutex_unlock(&lock);
+
+	return LIBUSB_ERROR_NOT_FOUND;
+}
+
+/* The record a pending transfer completes with, NULL past the end. */
+static struct rec *pending_rec(const struct pending *p)
+{
+	struct fake_dev *dev;
+	struct rec key;
+
+	dev = fake_handle_dev(p->transfer->dev_handle);
+	memset(&key, 0, sizeof(key));
+	key.bus = dev->bus;
+	key.address = dev->address;
+	key.endpoint = p->transfer->endpoint;
+
+	return replay_find(REC_TRANSFER, &key, match_endpoint);
+}
+
+/* Microseconds until the first pending transfer is due, -1 if none. */
+static int64_t replay_due(void)
+{
+	struct pending *p;
+	struct rec *r;
+	int64_t due;
+
+	if (!(p = g_queue_peek_head(&replay_pending)))
+		return -1;
+	if (!original_timing || p->cancelled || !(r = pending_rec(p)))
+		return 0;
+	if (!rec_t0)
+		rec_t0 = r->time_us;
+	due = replay_t0 + (r->time_us - rec_t0) - g_get_monotonic_time();
+
+	return MAX(due, 0);
+}
+
+/*
+ * Complete the transfers which are due, up to those which were pending
+ * on entry. The callbacks usually resubmit, those wait for the next
+ * round of event handling.
+ */
+static int replay_events(int *completed)
+{
+	struct libusb_transfer *transfer;
+	struct pending *p;
+	struct rec *r;
+	guint count;
+	gboolean in;
+
+	g_mutex_lock(&lock);
+	count = g_queue_get_length(&replay_pending);
+	g_mutex_unlock(&lock);
+
+	while (count--) {
+		g_mutex_lock(&lock);
+		if (replay_due() != 0) {
+			g_mutex_unlock(&lock);
+			break;
+		}
+		p = g_queue_pop_head(&replay_pending);
+		transfer = p->transfer;
+		r = p->cancelled ? NULL : pending_rec(p);
+		if (r)
+			replay_use(r);
+		g_mutex_unlock(&lock);
+
+		in = (transfer->endpoint & LIBUSB_ENDPOINT_DIR_MASK) ==
+			LIBUSB_ENDPOINT_IN;
+		if (p->cancelled) {
+			transfer->status = LIBUSB_TRANSFER_CANCELLED;
+			transfer->actual_length = 0;
+		} else if (!r) {
+			transfer->status = LIBUSB_TRANSFER_NO_DEVICE;
+			transfer->actual_length = 0;
+		} else {
+			transfer->status = r->status;
+			transfer->actual_length = MIN(r->actual, transfer->length);
+			if (in)
+				memcpy(transfer->buffer, r->data,
+					MIN((size_t)transfer->actual_length,
+					r->data_len));
+		}
+		g_free(p);
+		transfer->callback(transfer);
+		if (completed)
+			*completed = 1;
+	}
+
+	return LIBUSB_SUCCESS;
+}
+
+int libusb_handle_events_timeout_completed(libusb_context *ctx,
+		struct timeval *tv, int *completed)
+{
+	REAL(libusb_handle_events_timeout_completed);
+
+	if (mode == MODE_REPLAY && !g_queue_is_empty(&replay_pending))
+		return replay_events(completed);
+
+	return real_libusb_handle_events_timeout_completed(ctx, tv, completed);
+}
+
+int libusb_handle_events_timeout(libusb_context *ctx, struct timeval *tv)
+{
+	REAL(libusb_handle_events_timeout);
+
+	if (mode == MODE_REPLAY && !g_queue_is_empty(&replay_pending))
+		return replay_events(NULL);
+
+	return real_libusb_handle_events_timeout(ctx, tv);
+}
+
+/* Wake up the event loop when the next replayed transfer is due. */
+int libusb_get_next_timeout(libusb_context *ctx, struct timeval *tv)
+{
+	int64_t due;
+
+	REAL(libusb_get_next_timeout);
+
+	if (mode == MODE_REPLAY) {
+		g_mutex_lock(&lock);
+		due = replay_due();
+		g_mutex_unlock(&lock);
+		if (due >= 0) {
+			tv->tv_sec = due / G_USEC_PER_SEC;
+			tv->tv_usec = due % G_USEC_PER_SEC;
+			return 1;
+		}
+	}
+
+	return real_libusb_get_next_timeout(ctx, tv);
+}